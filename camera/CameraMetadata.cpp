@@ -17,6 +17,8 @@
 // #define LOG_NDEBUG 0
 
 #define LOG_TAG "Camera2-Metadata"
+#include <algorithm>
+
 #include <utils/Log.h>
 #include <utils/Errors.h>
 
@@ -33,22 +35,22 @@ typedef Parcel::WritableBlob WritableBlob;
 typedef Parcel::ReadableBlob ReadableBlob;
 
 CameraMetadata::CameraMetadata() :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false), mTagIndexValid(false), mLookupCount(0) {
 }
 
 CameraMetadata::CameraMetadata(size_t entryCapacity, size_t dataCapacity) :
-        mLocked(false)
+        mLocked(false), mTagIndexValid(false), mLookupCount(0)
 {
     mBuffer = allocate_camera_metadata(entryCapacity, dataCapacity);
 }
 
 CameraMetadata::CameraMetadata(const CameraMetadata &other) :
-        mLocked(false) {
+        mLocked(false), mTagIndexValid(false), mLookupCount(0) {
     mBuffer = clone_camera_metadata(other.mBuffer);
 }
 
 CameraMetadata::CameraMetadata(camera_metadata_t *buffer) :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false), mTagIndexValid(false), mLookupCount(0) {
     acquire(buffer);
 }
 
@@ -101,6 +103,7 @@ camera_metadata_t* CameraMetadata::release() {
     }
     camera_metadata_t *released = mBuffer;
     mBuffer = NULL;
+    invalidateTagIndex();
     return released;
 }
 
@@ -113,6 +116,7 @@ void CameraMetadata::clear() {
         free_camera_metadata(mBuffer);
         mBuffer = NULL;
     }
+    invalidateTagIndex();
 }
 
 void CameraMetadata::acquire(camera_metadata_t *buffer) {
@@ -148,6 +152,7 @@ status_t CameraMetadata::append(const camera_metadata_t* other) {
     size_t extraEntries = get_camera_metadata_entry_count(other);
     size_t extraData = get_camera_metadata_data_count(other);
     resizeIfNeeded(extraEntries, extraData);
+    invalidateTagIndex();
 
     return append_camera_metadata(mBuffer, other);
 }
@@ -166,6 +171,7 @@ status_t CameraMetadata::sort() {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
+    invalidateTagIndex();
     return sort_camera_metadata(mBuffer);
 }
 
@@ -320,10 +326,17 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
 
     if (res == OK) {
         camera_metadata_entry_t entry;
-        res = find_camera_metadata_entry(mBuffer, tag, &entry);
+        res = findEntry(tag, &entry);
         if (res == NAME_NOT_FOUND) {
             res = add_camera_metadata_entry(mBuffer,
                     tag, data, data_count);
+            if (res == OK && mTagIndexValid) {
+                // New entries go at the end of the buffer
+                std::pair<uint32_t, uint32_t> indexEntry(tag,
+                        get_camera_metadata_entry_count(mBuffer) - 1);
+                mTagIndex.insert(std::upper_bound(mTagIndex.begin(), mTagIndex.end(),
+                        indexEntry), indexEntry);
+            }
         } else if (res == OK) {
             res = update_camera_metadata_entry(mBuffer,
                     entry.index, data, data_count, NULL);
@@ -350,7 +363,7 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
 
 bool CameraMetadata::exists(uint32_t tag) const {
     camera_metadata_ro_entry entry;
-    return find_camera_metadata_ro_entry(mBuffer, tag, &entry) == 0;
+    return findEntry(tag, &entry) == 0;
 }
 
 camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
@@ -361,7 +374,7 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
         entry.count = 0;
         return entry;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
+    res = findEntry(tag, &entry);
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -372,7 +385,7 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
 camera_metadata_ro_entry_t CameraMetadata::find(uint32_t tag) const {
     status_t res;
     camera_metadata_ro_entry entry;
-    res = find_camera_metadata_ro_entry(mBuffer, tag, &entry);
+    res = findEntry(tag, &entry);
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -387,7 +400,7 @@ status_t CameraMetadata::erase(uint32_t tag) {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
+    res = findEntry(tag, &entry);
     if (res == NAME_NOT_FOUND) {
         return OK;
     } else if (res != OK) {
@@ -399,7 +412,16 @@ status_t CameraMetadata::erase(uint32_t tag) {
         return res;
     }
     res = delete_camera_metadata_entry(mBuffer, entry.index);
-    if (res != OK) {
+    if (res == OK && mTagIndexValid) {
+        // Later entries each move down by one
+        uint32_t erased = static_cast<uint32_t>(entry.index);
+        mTagIndex.erase(std::remove_if(mTagIndex.begin(), mTagIndex.end(),
+                [erased](const std::pair<uint32_t, uint32_t>& e) { return e.second == erased; }),
+                mTagIndex.end());
+        for (auto& indexEntry : mTagIndex) {
+            if (indexEntry.second > erased) indexEntry.second--;
+        }
+    } else if (res != OK) {
         ALOGE("%s: Error deleting entry %s.%s (%x): %s %d",
                 __FUNCTION__,
                 get_local_camera_metadata_section_name(tag, mBuffer),
@@ -409,6 +431,57 @@ status_t CameraMetadata::erase(uint32_t tag) {
     return res;
 }
 
+status_t CameraMetadata::findEntry(uint32_t tag, camera_metadata_entry_t *entry) {
+    if (!mTagIndexValid) {
+        if (mBuffer == NULL || ++mLookupCount < kTagIndexLookupThreshold) {
+            return find_camera_metadata_entry(mBuffer, tag, entry);
+        }
+
+        size_t count = get_camera_metadata_entry_count(mBuffer);
+        mTagIndex.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            camera_metadata_ro_entry_t indexed;
+            get_camera_metadata_ro_entry(mBuffer, i, &indexed);
+            mTagIndex[i] = std::make_pair(indexed.tag, static_cast<uint32_t>(i));
+        }
+        std::sort(mTagIndex.begin(), mTagIndex.end());
+        mTagIndexValid = true;
+    }
+
+    ssize_t index = findIndexedEntry(tag);
+    if (index < 0) {
+        return NAME_NOT_FOUND;
+    }
+    return get_camera_metadata_entry(mBuffer, index, entry);
+}
+
+status_t CameraMetadata::findEntry(uint32_t tag, camera_metadata_ro_entry_t *entry) const {
+    if (!mTagIndexValid) {
+        return find_camera_metadata_ro_entry(mBuffer, tag, entry);
+    }
+
+    ssize_t index = findIndexedEntry(tag);
+    if (index < 0) {
+        return NAME_NOT_FOUND;
+    }
+    return get_camera_metadata_ro_entry(mBuffer, index, entry);
+}
+
+ssize_t CameraMetadata::findIndexedEntry(uint32_t tag) const {
+    auto it = std::lower_bound(mTagIndex.begin(), mTagIndex.end(),
+            std::make_pair(tag, static_cast<uint32_t>(0)));
+    if (it == mTagIndex.end() || it->first != tag) {
+        return NAME_NOT_FOUND;
+    }
+    return it->second;
+}
+
+void CameraMetadata::invalidateTagIndex() {
+    mTagIndex.clear();
+    mTagIndexValid = false;
+    mLookupCount = 0;
+}
+
 void CameraMetadata::dump(int fd, int verbosity, int indentation) const {
     dump_indented_camera_metadata(mBuffer, fd, verbosity, indentation);
 }
@@ -695,6 +768,9 @@ void CameraMetadata::swap(CameraMetadata& other) {
 
     other.mBuffer = thisBuf;
     mBuffer = otherBuf;
+    std::swap(mTagIndex, other.mTagIndex);
+    std::swap(mTagIndexValid, other.mTagIndexValid);
+    std::swap(mLookupCount, other.mLookupCount);
 }
 
 status_t CameraMetadata::getTagFromName(const char *name,
@@ -19,6 +19,9 @@
 
 #include "system/camera_metadata.h"
 
+#include <utility>
+#include <vector>
+
 #include <utils/String8.h>
 #include <utils/Vector.h>
 #include <binder/Parcelable.h>
@@ -224,6 +227,23 @@ class CameraMetadata: public Parcelable {
     camera_metadata_t *mBuffer;
     mutable bool       mLocked;
 
+    /**
+     * Sorted (tag, entry index) pairs for mBuffer. Built once enough non-const
+     * lookups hit the same buffer, kept up to date by update() and erase(), and
+     * dropped by anything else that adds, removes or reorders entries. Const
+     * lookups use it when present but never build it, so shared const metadata
+     * stays safe to read from several threads.
+     */
+    static const uint32_t kTagIndexLookupThreshold = 8;
+    std::vector<std::pair<uint32_t, uint32_t>> mTagIndex;
+    bool               mTagIndexValid;
+    uint32_t           mLookupCount;
+
+    status_t findEntry(uint32_t tag, camera_metadata_entry_t *entry);
+    status_t findEntry(uint32_t tag, camera_metadata_ro_entry_t *entry) const;
+    ssize_t  findIndexedEntry(uint32_t tag) const;
+    void     invalidateTagIndex();
+
     /**
      * Check if tag has a given type
      */
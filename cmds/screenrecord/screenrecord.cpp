@@ -79,6 +79,7 @@ static AString gCodecName = "";         // codec name override
 static bool gSizeSpecified = false;     // was size explicitly requested?
 static bool gWantInfoScreen = false;    // do we want initial info screen?
 static bool gWantFrameTime = false;     // do we want times on each frame?
+static bool gBench = false;             // report encode fps and frame latency
 static uint32_t gVideoWidth = 0;        // default width+height
 static uint32_t gVideoHeight = 0;
 static uint32_t gBitRate = 20000000;     // 20Mbps
@@ -333,6 +334,44 @@ static status_t prepareVirtualDisplay(const DisplayInfo& mainDpyInfo,
     return NO_ERROR;
 }
 
+/*
+ * Encoder throughput and latency, accumulated over a reporting interval.
+ */
+struct BenchStats {
+    BenchStats() { reset(systemTime(CLOCK_MONOTONIC)); }
+
+    void reset(int64_t nowNsec) {
+        startNsec = nowNsec;
+        numFrames = 0;
+        latencySumUsec = 0;
+        latencyMaxUsec = 0;
+    }
+
+    // Records an encoded frame captured at ptsUsec (monotonic).
+    void addFrame(int64_t ptsUsec) {
+        int64_t latencyUsec = systemTime(SYSTEM_TIME_MONOTONIC) / 1000 - ptsUsec;
+        numFrames++;
+        latencySumUsec += latencyUsec;
+        if (latencyUsec > latencyMaxUsec) {
+            latencyMaxUsec = latencyUsec;
+        }
+    }
+
+    void print(const char* label, int64_t nowNsec) const {
+        double elapsedSec = (nowNsec - startNsec) / 1000000000.0;
+        printf("%s: %u frames, %.2f fps, latency avg %.2fms max %.2fms\n",
+                label, numFrames, elapsedSec > 0 ? numFrames / elapsedSec : 0.0,
+                numFrames > 0 ? latencySumUsec / (numFrames * 1000.0) : 0.0,
+                latencyMaxUsec / 1000.0);
+        fflush(stdout);
+    }
+
+    int64_t startNsec;
+    uint32_t numFrames;
+    int64_t latencySumUsec;
+    int64_t latencyMaxUsec;
+};
+
 /*
  * Runs the MediaCodec encoder, sending the output to the MediaMuxer.  The
  * input frames are coming from the virtual display as fast as SurfaceFlinger
@@ -352,6 +391,7 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
     int64_t startWhenNsec = systemTime(CLOCK_MONOTONIC);
     int64_t endWhenNsec = startWhenNsec + seconds_to_nanoseconds(gTimeLimitSec);
     DisplayInfo mainDpyInfo;
+    BenchStats benchInterval, benchTotal;
 
     assert((rawFp == NULL && muxer != NULL) || (rawFp != NULL && muxer == NULL));
 
@@ -451,6 +491,11 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
                     }
                 }
                 debugNumFrames++;
+
+                if (gBench && (flags & MediaCodec::BUFFER_FLAG_CODECCONFIG) == 0) {
+                    benchInterval.addFrame(ptsUsec);
+                    benchTotal.addFrame(ptsUsec);
+                }
             }
             err = encoder->releaseOutputBuffer(bufIndex);
             if (err != NO_ERROR) {
@@ -502,6 +547,14 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
                     "Got weird result %d from dequeueOutputBuffer\n", err);
             return err;
         }
+
+        if (gBench) {
+            int64_t nowNsec = systemTime(CLOCK_MONOTONIC);
+            if (nowNsec - benchInterval.startNsec >= seconds_to_nanoseconds(1)) {
+                benchInterval.print("bench", nowNsec);
+                benchInterval.reset(nowNsec);
+            }
+        }
     }
 
     ALOGV("Encoder stopping (req=%d)", gStopRequested);
@@ -511,6 +564,9 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
                         systemTime(CLOCK_MONOTONIC) - startWhenNsec));
         fflush(stdout);
     }
+    if (gBench) {
+        benchTotal.print("bench total", systemTime(CLOCK_MONOTONIC));
+    }
     return NO_ERROR;
 }
 
@@ -523,8 +579,8 @@ static FILE* prepareRawOutput(const char* fileName) {
     FILE* rawFp = NULL;
 
     if (strcmp(fileName, "-") == 0) {
-        if (gVerbose) {
-            fprintf(stderr, "ERROR: verbose output and '-' not compatible");
+        if (gVerbose || gBench) {
+            fprintf(stderr, "ERROR: verbose/bench output and '-' not compatible");
             return NULL;
         }
         rawFp = stdout;
@@ -655,8 +711,16 @@ static status_t recordScreen(const char* fileName) {
         }
     } else {
         // Use the encoder's input surface as the virtual display surface.
+        // SurfaceFlinger composites straight into the encoder's buffers, and
+        // any scaling or rotation is done by the display projection, so no
+        // GLES pass is involved.
         bufferProducer = encoderInputSurface;
     }
+    if (gVerbose || gBench) {
+        printf("Virtual display renders %s\n",
+                overlay != NULL ? "through GLES overlay" : "directly to encoder");
+        fflush(stdout);
+    }
 
     // Configure virtual display.
     sp<IBinder> dpy;
@@ -902,6 +966,8 @@ static void usage() {
         "    in videos captured to illustrate bugs.\n"
         "--time-limit TIME\n"
         "    Set the maximum recording time, in seconds.  Default / maximum is %d.\n"
+        "--bench\n"
+        "    Report encoded frames per second and capture-to-encode latency on stdout.\n"
         "--verbose\n"
         "    Display interesting information on stdout.\n"
         "--help\n"
@@ -932,6 +998,7 @@ int main(int argc, char* const argv[]) {
         { "codec-name",         required_argument,  NULL, 'N' },
         { "monotonic-time",     no_argument,        NULL, 'm' },
         { "persistent-surface", no_argument,        NULL, 'p' },
+        { "bench",              no_argument,        NULL, 'B' },
         { NULL,                 0,                  NULL, 0 }
     };
 
@@ -1020,6 +1087,9 @@ int main(int argc, char* const argv[]) {
         case 'p':
             gPersistentSurface = true;
             break;
+        case 'B':
+            gBench = true;
+            break;
         default:
             if (ic != '?') {
                 fprintf(stderr, "getopt_long returned unexpected value 0x%x\n", ic);
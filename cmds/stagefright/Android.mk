@@ -153,6 +153,30 @@ include $(BUILD_EXECUTABLE)
 
 include $(CLEAR_VARS)
 
+LOCAL_SRC_FILES:=               \
+        transcode.cpp           \
+        Transcoder.cpp          \
+
+LOCAL_SHARED_LIBRARIES := \
+        libstagefright liblog libutils libbinder libstagefright_foundation \
+        libmedia libmediaextractor libgui
+
+LOCAL_C_INCLUDES:= \
+        frameworks/av/media/libstagefright \
+        frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= transcode
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
 LOCAL_SRC_FILES:= \
         filters/argbtorgba.rs \
         filters/nightvision.rs \
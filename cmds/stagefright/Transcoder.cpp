@@ -0,0 +1,462 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "Transcoder"
+#include <utils/Log.h>
+
+#include "Transcoder.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <OMX_IVCommon.h>
+#include <gui/Surface.h>
+#include <media/MediaCodecBuffer.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/NuMediaExtractor.h>
+
+namespace android {
+
+// audio samples are copied through this buffer, as in the muxer tool.
+static const size_t kAudioBufferSize = 1024 * 1024;
+
+// how long to wait for a codec when none of the stages could make progress.
+static const int64_t kIdleWaitUs = 5000ll;
+
+Transcoder::Config::Config()
+    : mVideoMime("video/avc"),
+      mVideoBitrate(0),
+      mIFrameIntervalS(1),
+      mCopyAudio(true),
+      mContainer(MediaMuxer::OUTPUT_FORMAT_MPEG_4) {
+}
+
+Transcoder::Transcoder(
+        const char *inputPath, const char *outputPath, const Config &config)
+    : mInputPath(inputPath),
+      mOutputPath(outputPath),
+      mConfig(config),
+      mVideoTrack(-1),
+      mAudioTrack(-1),
+      mMuxerVideoTrack(-1),
+      mMuxerAudioTrack(-1),
+      mMuxerStarted(false) {
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+Transcoder::~Transcoder() {
+    teardown();
+}
+
+status_t Transcoder::run() {
+    int64_t startUs = ALooper::GetNowUs();
+
+    status_t err = setup();
+    if (err == OK) {
+        err = transcode();
+    }
+    teardown();
+
+    mStats.mTotalUs = ALooper::GetNowUs() - startUs;
+    if (mStats.mFirstFrameUs > 0) {
+        mStats.mFirstFrameUs -= startUs;
+    }
+    return err;
+}
+
+status_t Transcoder::setup() {
+    mExtractor = new NuMediaExtractor;
+    status_t err = mExtractor->setDataSource(NULL /* httpService */, mInputPath.c_str());
+    if (err != OK) {
+        ALOGE("unable to open %s (%d)", mInputPath.c_str(), err);
+        return err;
+    }
+
+    sp<AMessage> videoFormat;
+    sp<AMessage> audioFormat;
+    for (size_t i = 0; i < mExtractor->countTracks(); ++i) {
+        sp<AMessage> format;
+        AString mime;
+        if (mExtractor->getTrackFormat(i, &format) != OK
+                || !format->findString("mime", &mime)) {
+            continue;
+        }
+        if (mVideoTrack < 0 && !strncasecmp(mime.c_str(), "video/", 6)) {
+            mVideoTrack = i;
+            videoFormat = format;
+        } else if (mConfig.mCopyAudio && mAudioTrack < 0
+                && !strncasecmp(mime.c_str(), "audio/", 6)) {
+            mAudioTrack = i;
+            audioFormat = format;
+        }
+    }
+    if (mVideoTrack < 0) {
+        ALOGE("%s has no video track", mInputPath.c_str());
+        return ERROR_UNSUPPORTED;
+    }
+
+    int32_t width, height;
+    AString videoMime;
+    CHECK(videoFormat->findString("mime", &videoMime));
+    if (!videoFormat->findInt32("width", &width) || !videoFormat->findInt32("height", &height)) {
+        return ERROR_MALFORMED;
+    }
+    int32_t frameRate;
+    if (!videoFormat->findInt32("frame-rate", &frameRate) || frameRate <= 0) {
+        frameRate = 30;
+    }
+    int32_t bitrate = mConfig.mVideoBitrate;
+    if (bitrate <= 0 && !videoFormat->findInt32("bitrate", &bitrate)) {
+        // roughly 0.13 bits per pixel at 30 fps
+        bitrate = width * height * 4;
+    }
+
+    mLooper = new ALooper;
+    mLooper->setName("transcoder");
+    mLooper->start();
+
+    mEncoder = MediaCodec::CreateByType(mLooper, mConfig.mVideoMime, true /* encoder */, &err);
+    if (mEncoder == NULL) {
+        ALOGE("no encoder for %s (%d)", mConfig.mVideoMime.c_str(), err);
+        return err == OK ? ERROR_UNSUPPORTED : err;
+    }
+    sp<AMessage> encoderFormat = new AMessage;
+    encoderFormat->setString("mime", mConfig.mVideoMime);
+    encoderFormat->setInt32("width", width);
+    encoderFormat->setInt32("height", height);
+    encoderFormat->setInt32("color-format", OMX_COLOR_FormatAndroidOpaque);
+    encoderFormat->setInt32("bitrate", bitrate);
+    encoderFormat->setFloat("frame-rate", frameRate);
+    encoderFormat->setInt32("i-frame-interval", mConfig.mIFrameIntervalS);
+    err = mEncoder->configure(encoderFormat, NULL, NULL, MediaCodec::CONFIGURE_FLAG_ENCODE);
+    if (err != OK) {
+        ALOGE("failed to configure the encoder (%d)", err);
+        return err;
+    }
+    sp<IGraphicBufferProducer> bufferProducer;
+    err = mEncoder->createInputSurface(&bufferProducer);
+    if (err != OK) {
+        ALOGE("failed to create the encoder input surface (%d)", err);
+        return err;
+    }
+    mSurface = new Surface(bufferProducer);
+
+    mDecoder = MediaCodec::CreateByType(mLooper, videoMime, false /* encoder */, &err);
+    if (mDecoder == NULL) {
+        ALOGE("no decoder for %s (%d)", videoMime.c_str(), err);
+        return err == OK ? ERROR_UNSUPPORTED : err;
+    }
+    err = mDecoder->configure(videoFormat, mSurface, NULL, 0);
+    if (err != OK) {
+        ALOGE("failed to configure the decoder (%d)", err);
+        return err;
+    }
+
+    int fd = open(mOutputPath.c_str(), O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR,
+            S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        ALOGE("couldn't open %s", mOutputPath.c_str());
+        return -errno;
+    }
+    mMuxer = new MediaMuxer(fd, mConfig.mContainer);
+    close(fd);
+
+    int32_t rotationDegrees;
+    if (videoFormat->findInt32("rotation-degrees", &rotationDegrees)) {
+        mMuxer->setOrientationHint(rotationDegrees);
+    }
+
+    if (mAudioTrack >= 0) {
+        mMuxerAudioTrack = mMuxer->addTrack(audioFormat);
+        if (mMuxerAudioTrack < 0) {
+            ALOGW("audio track of %s unsupported by muxer, dropping it", mInputPath.c_str());
+            mAudioTrack = -1;
+        } else {
+            mAudioBuffer = new ABuffer(kAudioBufferSize);
+        }
+    }
+
+    if ((err = mExtractor->selectTrack(mVideoTrack)) != OK
+            || (mAudioTrack >= 0 && (err = mExtractor->selectTrack(mAudioTrack)) != OK)) {
+        return err;
+    }
+
+    if ((err = mEncoder->start()) != OK || (err = mDecoder->start()) != OK) {
+        ALOGE("failed to start the codecs (%d)", err);
+        return err;
+    }
+    return OK;
+}
+
+void Transcoder::teardown() {
+    if (mDecoder != NULL) {
+        mDecoder->release();
+        mDecoder.clear();
+    }
+    if (mEncoder != NULL) {
+        mEncoder->release();
+        mEncoder.clear();
+    }
+    mSurface.clear();
+    if (mMuxer != NULL) {
+        if (mMuxerStarted) {
+            mMuxer->stop();
+            mMuxerStarted = false;
+        }
+        mMuxer.clear();
+    }
+    mPendingAudio.clear();
+    mExtractor.clear();
+    if (mLooper != NULL) {
+        mLooper->stop();
+        mLooper.clear();
+    }
+}
+
+status_t Transcoder::transcode() {
+    bool inputDone = false;
+    bool decoderDone = false;
+    bool encoderDone = false;
+
+    while (!encoderDone) {
+        bool progress = false;
+        status_t err = feedDecoder(&progress, &inputDone);
+        if (err == OK && !decoderDone) {
+            err = drainDecoder(&progress, &decoderDone);
+        }
+        if (err == OK) {
+            err = drainEncoder(&progress, &encoderDone);
+        }
+        if (err != OK) {
+            ALOGE("transcoding %s failed (%d)", mInputPath.c_str(), err);
+            return err;
+        }
+
+        if (!progress && !encoderDone) {
+            // every stage is waiting on a codec; block on the encoder output, which is the
+            // last one to get anything done.
+            err = drainEncoder(&progress, &encoderDone, kIdleWaitUs);
+            if (err != OK) {
+                ALOGE("transcoding %s failed (%d)", mInputPath.c_str(), err);
+                return err;
+            }
+        }
+    }
+    return OK;
+}
+
+status_t Transcoder::feedDecoder(bool *progress, bool *inputDone) {
+    if (*inputDone) {
+        return OK;
+    }
+
+    size_t trackIndex;
+    if (mExtractor->getSampleTrackIndex(&trackIndex) != OK) {
+        size_t index;
+        if (mDecoder->dequeueInputBuffer(&index) != OK) {
+            return OK;  // try again once the decoder consumed some input
+        }
+        *inputDone = true;
+        *progress = true;
+        return mDecoder->queueInputBuffer(index, 0, 0, 0, MediaCodec::BUFFER_FLAG_EOS);
+    }
+
+    int64_t timeUs;
+    status_t err;
+    if ((ssize_t)trackIndex == mVideoTrack) {
+        size_t index;
+        err = mDecoder->dequeueInputBuffer(&index);
+        if (err == -EAGAIN) {
+            return OK;
+        } else if (err != OK) {
+            return err;
+        }
+        sp<MediaCodecBuffer> buffer;
+        if ((err = mDecoder->getInputBuffer(index, &buffer)) != OK) {
+            return err;
+        }
+        sp<ABuffer> abuffer = new ABuffer(buffer->base(), buffer->capacity());
+
+        int64_t readStartUs = ALooper::GetNowUs();
+        err = mExtractor->readSampleData(abuffer);
+        if (err == OK) {
+            err = mExtractor->getSampleTime(&timeUs);
+        }
+        mStats.mExtractorUs += ALooper::GetNowUs() - readStartUs;
+        if (err != OK) {
+            return err;
+        }
+        err = mDecoder->queueInputBuffer(index, 0, abuffer->size(), timeUs, 0);
+    } else if ((ssize_t)trackIndex == mAudioTrack) {
+        int64_t readStartUs = ALooper::GetNowUs();
+        err = mExtractor->readSampleData(mAudioBuffer);
+        sp<MetaData> meta;
+        if (err == OK) {
+            err = mExtractor->getSampleTime(&timeUs);
+        }
+        if (err == OK) {
+            err = mExtractor->getSampleMeta(&meta);
+        }
+        mStats.mExtractorUs += ALooper::GetNowUs() - readStartUs;
+        if (err != OK) {
+            return err;
+        }
+        int32_t isSync;
+        uint32_t flags = 0;
+        if (meta->findInt32(kKeyIsSyncFrame, &isSync) && isSync != 0) {
+            flags |= MediaCodec::BUFFER_FLAG_SYNCFRAME;
+        }
+        err = writeAudio(mAudioBuffer, timeUs, flags);
+    } else {
+        err = OK;
+    }
+    if (err == OK) {
+        ++mStats.mSamplesRead;
+        mExtractor->advance();
+        *progress = true;
+    }
+    return err;
+}
+
+status_t Transcoder::drainDecoder(bool *progress, bool *decoderDone) {
+    size_t index, offset, size;
+    int64_t timeUs;
+    uint32_t flags;
+    status_t err = mDecoder->dequeueOutputBuffer(&index, &offset, &size, &timeUs, &flags);
+    if (err == -EAGAIN) {
+        return OK;
+    } else if (err == INFO_FORMAT_CHANGED || err == INFO_OUTPUT_BUFFERS_CHANGED) {
+        *progress = true;
+        return OK;
+    } else if (err != OK) {
+        return err;
+    }
+
+    *progress = true;
+    if (size > 0) {
+        // the frame goes to the encoder's input surface with its original timestamp
+        err = mDecoder->renderOutputBufferAndRelease(index, timeUs * 1000ll);
+        ++mStats.mFramesDecoded;
+    } else {
+        err = mDecoder->releaseOutputBuffer(index);
+    }
+    if (err == OK && (flags & MediaCodec::BUFFER_FLAG_EOS)) {
+        *decoderDone = true;
+        err = mEncoder->signalEndOfInputStream();
+    }
+    return err;
+}
+
+status_t Transcoder::drainEncoder(bool *progress, bool *encoderDone, int64_t timeoutUs) {
+    size_t index, offset, size;
+    int64_t timeUs;
+    uint32_t flags;
+    status_t err = mEncoder->dequeueOutputBuffer(
+            &index, &offset, &size, &timeUs, &flags, timeoutUs);
+    if (err == -EAGAIN) {
+        return OK;
+    } else if (err == INFO_OUTPUT_BUFFERS_CHANGED) {
+        *progress = true;
+        return OK;
+    } else if (err == INFO_FORMAT_CHANGED) {
+        *progress = true;
+        if (mMuxerStarted) {
+            ALOGW("ignoring encoder format change after the muxer started");
+            return OK;
+        }
+        sp<AMessage> format;
+        if ((err = mEncoder->getOutputFormat(&format)) != OK) {
+            return err;
+        }
+        mMuxerVideoTrack = mMuxer->addTrack(format);
+        if (mMuxerVideoTrack < 0) {
+            ALOGE("encoded video unsupported by muxer");
+            return (status_t)mMuxerVideoTrack;
+        }
+        if ((err = mMuxer->start()) != OK) {
+            return err;
+        }
+        mMuxerStarted = true;
+        while (!mPendingAudio.empty()) {
+            const PendingSample &sample = *mPendingAudio.begin();
+            if ((err = writeAudio(sample.mBuffer, sample.mTimeUs, sample.mFlags)) != OK) {
+                return err;
+            }
+            mPendingAudio.erase(mPendingAudio.begin());
+        }
+        return OK;
+    } else if (err != OK) {
+        return err;
+    }
+
+    *progress = true;
+    if (size > 0 && !(flags & MediaCodec::BUFFER_FLAG_CODECCONFIG)) {
+        if (!mMuxerStarted) {
+            mEncoder->releaseOutputBuffer(index);
+            ALOGE("encoder produced data before its output format");
+            return ERROR_MALFORMED;
+        }
+        sp<MediaCodecBuffer> buffer;
+        if ((err = mEncoder->getOutputBuffer(index, &buffer)) != OK) {
+            return err;
+        }
+        if (mStats.mFramesEncoded++ == 0) {
+            mStats.mFirstFrameUs = ALooper::GetNowUs();
+        }
+        // writeSampleData() returns once the writer consumed the sample, so the codec
+        // buffer can be used without a copy.
+        sp<ABuffer> abuffer = new ABuffer(buffer->base() + offset, size);
+        int64_t muxStartUs = ALooper::GetNowUs();
+        err = mMuxer->writeSampleData(abuffer, mMuxerVideoTrack, timeUs,
+                flags & MediaCodec::BUFFER_FLAG_SYNCFRAME);
+        mStats.mMuxerUs += ALooper::GetNowUs() - muxStartUs;
+        mStats.mBytesMuxed += size;
+    }
+    status_t releaseErr = mEncoder->releaseOutputBuffer(index);
+    if (err == OK) {
+        err = releaseErr;
+    }
+    if (err == OK && (flags & MediaCodec::BUFFER_FLAG_EOS)) {
+        *encoderDone = true;
+    }
+    return err;
+}
+
+status_t Transcoder::writeAudio(const sp<ABuffer> &buffer, int64_t timeUs, uint32_t flags) {
+    if (!mMuxerStarted) {
+        PendingSample sample;
+        sample.mBuffer = ABuffer::CreateAsCopy(buffer->data(), buffer->size());
+        sample.mTimeUs = timeUs;
+        sample.mFlags = flags;
+        mPendingAudio.push_back(sample);
+        return OK;
+    }
+    int64_t muxStartUs = ALooper::GetNowUs();
+    status_t err = mMuxer->writeSampleData(buffer, mMuxerAudioTrack, timeUs, flags);
+    mStats.mMuxerUs += ALooper::GetNowUs() - muxStartUs;
+    mStats.mBytesMuxed += buffer->size();
+    return err;
+}
+
+}  // namespace android
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRANSCODER_H_
+
+#define TRANSCODER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+struct ABuffer;
+struct ALooper;
+struct AMessage;
+struct MediaCodec;
+struct NuMediaExtractor;
+class Surface;
+
+// Transcodes the first video track of a file, and copies its first audio track, into a new
+// file. The decoder renders straight into the input surface of the encoder, so the frames
+// never leave graphic buffers.
+// run() blocks until the output is complete; several Transcoders may run concurrently on
+// different threads.
+struct Transcoder : public RefBase {
+    struct Config {
+        Config();
+
+        AString mVideoMime;
+        int32_t mVideoBitrate;          // bits per second, <= 0 to keep the source bitrate
+        int32_t mIFrameIntervalS;
+        bool mCopyAudio;
+        MediaMuxer::OutputFormat mContainer;
+    };
+
+    // Per-stage counters, for reporting throughput.
+    struct Stats {
+        size_t mSamplesRead;            // extractor samples, all tracks
+        int64_t mExtractorUs;           // time spent reading samples
+        size_t mFramesDecoded;
+        size_t mFramesEncoded;
+        size_t mBytesMuxed;
+        int64_t mMuxerUs;               // time spent writing samples
+        int64_t mFirstFrameUs;          // from start to the first encoded frame
+        int64_t mTotalUs;
+    };
+
+    Transcoder(const char *inputPath, const char *outputPath, const Config &config);
+
+    status_t run();
+
+    const Stats &stats() const { return mStats; }
+
+protected:
+    virtual ~Transcoder();
+
+private:
+    struct PendingSample {
+        sp<ABuffer> mBuffer;
+        int64_t mTimeUs;
+        uint32_t mFlags;
+    };
+
+    AString mInputPath;
+    AString mOutputPath;
+    Config mConfig;
+    Stats mStats;
+
+    sp<ALooper> mLooper;
+    sp<NuMediaExtractor> mExtractor;
+    sp<MediaCodec> mDecoder;
+    sp<MediaCodec> mEncoder;
+    sp<Surface> mSurface;
+    sp<MediaMuxer> mMuxer;
+
+    ssize_t mVideoTrack;
+    ssize_t mAudioTrack;
+    ssize_t mMuxerVideoTrack;
+    ssize_t mMuxerAudioTrack;
+    bool mMuxerStarted;
+    sp<ABuffer> mAudioBuffer;
+
+    // audio samples read before the encoder output format, and thus the muxer, was known
+    List<PendingSample> mPendingAudio;
+
+    status_t setup();
+    status_t transcode();
+    void teardown();
+
+    status_t feedDecoder(bool *progress, bool *inputDone);
+    status_t drainDecoder(bool *progress, bool *decoderDone);
+    status_t drainEncoder(bool *progress, bool *encoderDone, int64_t timeoutUs = 0);
+    status_t writeAudio(const sp<ABuffer> &buffer, int64_t timeUs, uint32_t flags);
+
+    DISALLOW_EVIL_CONSTRUCTORS(Transcoder);
+};
+
+}  // namespace android
+
+#endif  // TRANSCODER_H_
@@ -17,6 +17,7 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "codec"
 #include <inttypes.h>
+#include <vector>
 #include <utils/Log.h>
 
 #include "SimplePlayer.h"
@@ -47,7 +48,8 @@ static void usage(const char *me) {
                     "\t\t[-p] playback\n"
                     "\t\t[-S] allocate buffers from a surface\n"
                     "\t\t[-R] render output to surface (enables -S)\n"
-                    "\t\t[-T] use render timestamps (enables -R)\n",
+                    "\t\t[-T] use render timestamps (enables -R)\n"
+                    "\t\t[-b count] queue and dequeue up to count buffers per call\n",
                     me);
     exit(1);
 }
@@ -58,6 +60,7 @@ struct CodecState {
     sp<MediaCodec> mCodec;
     Vector<sp<MediaCodecBuffer> > mInBuffers;
     Vector<sp<MediaCodecBuffer> > mOutBuffers;
+    Vector<size_t> mAvailInBuffers;     // dequeued but not yet filled
     bool mSignalledInputEOS;
     bool mSawOutputEOS;
     int64_t mNumBuffersDecoded;
@@ -74,7 +77,8 @@ static int decode(
         bool useVideo,
         const android::sp<android::Surface> &surface,
         bool renderSurface,
-        bool useTimestamp) {
+        bool useTimestamp,
+        size_t batchSize) {
     using namespace android;
 
     static int64_t kTimeout = 500ll;
@@ -155,6 +159,68 @@ static int decode(
               state->mInBuffers.size(), state->mOutBuffers.size());
     }
 
+    auto drainOutputBuffer = [&](CodecState *state, const MediaCodec::BufferDescriptor &buffer) {
+        const size_t index = buffer.mIndex;
+        int64_t presentationTimeUs = buffer.mPresentationTimeUs;
+
+        ALOGV("draining output buffer %zu, time = %lld us",
+              index, (long long)presentationTimeUs);
+
+        ++state->mNumBuffersDecoded;
+        state->mNumBytesDecoded += buffer.mSize;
+
+        status_t err;
+        if (surface == NULL || !renderSurface) {
+            err = state->mCodec->releaseOutputBuffer(index);
+        } else if (useTimestamp) {
+            if (startTimeRender == -1) {
+                // begin rendering 2 vsyncs (~33ms) after first decode
+                startTimeRender =
+                        systemTime(SYSTEM_TIME_MONOTONIC) + 33000000
+                        - (presentationTimeUs * 1000);
+            }
+            presentationTimeUs =
+                    (presentationTimeUs * 1000) + startTimeRender;
+            err = state->mCodec->renderOutputBufferAndRelease(
+                    index, presentationTimeUs);
+        } else {
+            err = state->mCodec->renderOutputBufferAndRelease(index);
+        }
+
+        CHECK_EQ(err, (status_t)OK);
+
+        if (buffer.mFlags & MediaCodec::BUFFER_FLAG_EOS) {
+            ALOGV("reached EOS on output.");
+
+            state->mSawOutputEOS = true;
+        }
+    };
+
+    // In batched mode, get all the input buffers available with a single call
+    std::vector<size_t> inIndices(batchSize);
+    auto dequeueInputBuffers = [&](CodecState *state) {
+        size_t count = 0;
+        status_t err;
+        if (batchSize > 1) {
+            err = state->mCodec->dequeueInputBuffers(
+                    inIndices.data(), batchSize, &count, kTimeout);
+        } else {
+            err = state->mCodec->dequeueInputBuffer(&inIndices[0], kTimeout);
+            count = err == OK ? 1 : 0;
+        }
+        if (err == OK) {
+            for (size_t j = 0; j < count; ++j) {
+                state->mAvailInBuffers.push_back(inIndices[j]);
+            }
+        } else {
+            CHECK_EQ(err, -EAGAIN);
+        }
+    };
+
+    std::vector<MediaCodec::BufferDescriptor> inBuffers;
+    inBuffers.reserve(batchSize);
+    std::vector<MediaCodec::BufferDescriptor> outBuffers(batchSize);
+
     bool sawInputEOS = false;
 
     for (;;) {
@@ -168,10 +234,17 @@ static int decode(
             } else {
                 CodecState *state = &stateByTrack.editValueFor(trackIndex);
 
-                size_t index;
-                err = state->mCodec->dequeueInputBuffer(&index, kTimeout);
+                if (state->mAvailInBuffers.isEmpty()) {
+                    dequeueInputBuffers(state);
+                }
+
+                // fill as many buffers as we have for consecutive samples of this track
+                inBuffers.clear();
+                size_t sampleTrackIndex = trackIndex;
+                while (!state->mAvailInBuffers.isEmpty() && sampleTrackIndex == trackIndex) {
+                    size_t index = state->mAvailInBuffers[0];
+                    state->mAvailInBuffers.removeAt(0);
 
-                if (err == OK) {
                     ALOGV("filling input buffer %zu", index);
 
                     const sp<MediaCodecBuffer> &buffer = state->mInBuffers.itemAt(index);
@@ -185,20 +258,33 @@ static int decode(
                     err = extractor->getSampleTime(&timeUs);
                     CHECK_EQ(err, (status_t)OK);
 
-                    uint32_t bufferFlags = 0;
+                    MediaCodec::BufferDescriptor desc;
+                    desc.mIndex = index;
+                    desc.mOffset = 0;
+                    desc.mSize = buffer->size();
+                    desc.mPresentationTimeUs = timeUs;
+                    desc.mFlags = 0;
+                    inBuffers.push_back(desc);
 
-                    err = state->mCodec->queueInputBuffer(
-                            index,
-                            0 /* offset */,
-                            buffer->size(),
-                            timeUs,
-                            bufferFlags);
+                    extractor->advance();
+                    if (extractor->getSampleTrackIndex(&sampleTrackIndex) != OK) {
+                        break;
+                    }
+                }
 
+                if (batchSize > 1 && !inBuffers.empty()) {
+                    size_t queued;
+                    err = state->mCodec->queueInputBuffers(
+                            inBuffers.data(), inBuffers.size(), &queued);
+                    CHECK_EQ(err, (status_t)OK);
+                } else if (!inBuffers.empty()) {
+                    err = state->mCodec->queueInputBuffer(
+                            inBuffers[0].mIndex,
+                            inBuffers[0].mOffset,
+                            inBuffers[0].mSize,
+                            inBuffers[0].mPresentationTimeUs,
+                            inBuffers[0].mFlags);
                     CHECK_EQ(err, (status_t)OK);
-
-                    extractor->advance();
-                } else {
-                    CHECK_EQ(err, -EAGAIN);
                 }
             }
         } else {
@@ -206,14 +292,17 @@ static int decode(
                 CodecState *state = &stateByTrack.editValueAt(i);
 
                 if (!state->mSignalledInputEOS) {
-                    size_t index;
-                    status_t err =
-                        state->mCodec->dequeueInputBuffer(&index, kTimeout);
+                    if (state->mAvailInBuffers.isEmpty()) {
+                        dequeueInputBuffers(state);
+                    }
+
+                    if (!state->mAvailInBuffers.isEmpty()) {
+                        size_t index = state->mAvailInBuffers[0];
+                        state->mAvailInBuffers.removeAt(0);
 
-                    if (err == OK) {
                         ALOGV("signalling input EOS on track %zu", i);
 
-                        err = state->mCodec->queueInputBuffer(
+                        status_t err = state->mCodec->queueInputBuffer(
                                 index,
                                 0 /* offset */,
                                 0 /* size */,
@@ -223,8 +312,6 @@ static int decode(
                         CHECK_EQ(err, (status_t)OK);
 
                         state->mSignalledInputEOS = true;
-                    } else {
-                        CHECK_EQ(err, -EAGAIN);
                     }
                 }
             }
@@ -250,45 +337,22 @@ static int decode(
                 continue;
             }
 
-            size_t index;
-            size_t offset;
-            size_t size;
-            int64_t presentationTimeUs;
-            uint32_t flags;
-            status_t err = state->mCodec->dequeueOutputBuffer(
-                    &index, &offset, &size, &presentationTimeUs, &flags,
-                    kTimeout);
+            MediaCodec::BufferDescriptor *buffers = outBuffers.data();
+            size_t count = 0;
+            status_t err;
+            if (batchSize > 1) {
+                err = state->mCodec->dequeueOutputBuffers(buffers, batchSize, &count, kTimeout);
+            } else {
+                err = state->mCodec->dequeueOutputBuffer(
+                        &buffers[0].mIndex, &buffers[0].mOffset, &buffers[0].mSize,
+                        &buffers[0].mPresentationTimeUs, &buffers[0].mFlags,
+                        kTimeout);
+                count = err == OK ? 1 : 0;
+            }
 
             if (err == OK) {
-                ALOGV("draining output buffer %zu, time = %lld us",
-                      index, (long long)presentationTimeUs);
-
-                ++state->mNumBuffersDecoded;
-                state->mNumBytesDecoded += size;
-
-                if (surface == NULL || !renderSurface) {
-                    err = state->mCodec->releaseOutputBuffer(index);
-                } else if (useTimestamp) {
-                    if (startTimeRender == -1) {
-                        // begin rendering 2 vsyncs (~33ms) after first decode
-                        startTimeRender =
-                                systemTime(SYSTEM_TIME_MONOTONIC) + 33000000
-                                - (presentationTimeUs * 1000);
-                    }
-                    presentationTimeUs =
-                            (presentationTimeUs * 1000) + startTimeRender;
-                    err = state->mCodec->renderOutputBufferAndRelease(
-                            index, presentationTimeUs);
-                } else {
-                    err = state->mCodec->renderOutputBufferAndRelease(index);
-                }
-
-                CHECK_EQ(err, (status_t)OK);
-
-                if (flags & MediaCodec::BUFFER_FLAG_EOS) {
-                    ALOGV("reached EOS on output.");
-
-                    state->mSawOutputEOS = true;
+                for (size_t j = 0; j < count; ++j) {
+                    drainOutputBuffer(state, buffers[j]);
                 }
             } else if (err == INFO_OUTPUT_BUFFERS_CHANGED) {
                 ALOGV("INFO_OUTPUT_BUFFERS_CHANGED");
@@ -309,6 +373,8 @@ static int decode(
 
     int64_t elapsedTimeUs = ALooper::GetNowUs() - startTimeUs;
 
+    printf("%.3f sec elapsed, up to %zu buffers per call\n", elapsedTimeUs * 1E-6, batchSize);
+
     for (size_t i = 0; i < stateByTrack.size(); ++i) {
         CodecState *state = &stateByTrack.editValueAt(i);
 
@@ -344,10 +410,20 @@ int main(int argc, char **argv) {
     bool useSurface = false;
     bool renderSurface = false;
     bool useTimestamp = false;
+    size_t batchSize = 1;
 
     int res;
-    while ((res = getopt(argc, argv, "havpSDRT")) >= 0) {
+    while ((res = getopt(argc, argv, "havpSDRTb:")) >= 0) {
         switch (res) {
+            case 'b':
+            {
+                int count = atoi(optarg);
+                if (count < 1) {
+                    usage(me);
+                }
+                batchSize = count;
+                break;
+            }
             case 'a':
             {
                 useAudio = true;
@@ -451,7 +527,7 @@ int main(int argc, char **argv) {
         player->reset();
     } else {
         decode(looper, argv[0], useAudio, useVideo, surface, renderSurface,
-                useTimestamp);
+                useTimestamp, batchSize);
     }
 
     if (playback || (useSurface && useVideo)) {
@@ -611,7 +611,7 @@ static void usage(const char *me) {
     fprintf(stderr, "usage: %s [options] [input_filename]\n", me);
     fprintf(stderr, "       -h(elp)\n");
     fprintf(stderr, "       -a(udio)\n");
-    fprintf(stderr, "       -n repetitions\n");
+    fprintf(stderr, "       -n repetitions (with -t: frames to extract and time per file)\n");
     fprintf(stderr, "       -l(ist) components\n");
     fprintf(stderr, "       -m max-number-of-frames-to-decode in each pass\n");
     fprintf(stderr, "       -b bug to reproduce\n");
@@ -897,6 +897,27 @@ int main(int argc, char **argv) {
                             frame->mWidth, frame->mHeight), 0);
             }
 
+            if (mem != NULL && gNumRepetitions > 1) {
+                // time frames spread over the whole file, as a gallery
+                // scrubbing through it would ask for them
+                const char *value = retriever->extractMetadata(METADATA_KEY_DURATION);
+                int64_t durationUs = (value != NULL) ? atoll(value) * 1000ll : 0;
+                int64_t startUs = getNowUs();
+                long numFrames = 0;
+                for (long i = 0; i < gNumRepetitions; ++i) {
+                    if (retriever->getFrameAtTime(durationUs * i / gNumRepetitions,
+                            MediaSource::ReadOptions::SEEK_CLOSEST_SYNC,
+                            HAL_PIXEL_FORMAT_RGB_565,
+                            false /*metaOnly*/) != NULL) {
+                        ++numFrames;
+                    }
+                }
+                int64_t delayUs = getNowUs() - startUs;
+                printf("extracted %ld of %ld frames in %" PRId64 " ms (%" PRId64 " ms each)\n",
+                        numFrames, gNumRepetitions, delayUs / 1000,
+                        delayUs / 1000 / gNumRepetitions);
+            }
+
             {
                 mem = retriever->extractAlbumArt();
 
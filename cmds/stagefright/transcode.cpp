@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "transcode"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <utils/Log.h>
+
+#include "Transcoder.h"
+
+#include <binder/ProcessState.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Mutex.h>
+#include <utils/Thread.h>
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-j jobs] [-m mime] [-b bitrate] [-i interval] [-n] [-w]"
+                    " -o <output dir> <input file>...\n", me);
+    fprintf(stderr, "       -j number of files transcoded concurrently (default 2)\n");
+    fprintf(stderr, "       -m video mime type of the output (default video/avc)\n");
+    fprintf(stderr, "       -b video bitrate in kbps (default: keep the source bitrate)\n");
+    fprintf(stderr, "       -i sync frame interval in seconds (default 1)\n");
+    fprintf(stderr, "       -n drop the audio instead of copying it\n");
+    fprintf(stderr, "       -w mux into WebM container (default is MP4)\n");
+    fprintf(stderr, "       -o directory for the output files\n");
+
+    exit(1);
+}
+
+namespace {
+
+struct Job {
+    AString mInput;
+    AString mOutput;
+    status_t mResult;
+    Transcoder::Stats mStats;
+};
+
+// Worker threads take the next job until there are none left.
+struct JobQueue {
+    JobQueue(std::vector<Job> *jobs, const Transcoder::Config &config)
+        : mJobs(jobs), mConfig(config), mNext(0) {
+    }
+
+    Job *next() {
+        Mutex::Autolock autoLock(mLock);
+        return mNext < mJobs->size() ? &(*mJobs)[mNext++] : NULL;
+    }
+
+    const Transcoder::Config &config() const { return mConfig; }
+
+private:
+    Mutex mLock;
+    std::vector<Job> *mJobs;
+    const Transcoder::Config mConfig;
+    size_t mNext;
+};
+
+struct Worker : public Thread {
+    explicit Worker(JobQueue *queue) : Thread(false /* canCallJava */), mQueue(queue) {
+    }
+
+private:
+    JobQueue *mQueue;
+
+    virtual bool threadLoop() {
+        Job *job = mQueue->next();
+        if (job == NULL) {
+            return false;
+        }
+        sp<Transcoder> transcoder =
+                new Transcoder(job->mInput.c_str(), job->mOutput.c_str(), mQueue->config());
+        job->mResult = transcoder->run();
+        job->mStats = transcoder->stats();
+        return true;
+    }
+};
+
+void printStats(const Job &job) {
+    const Transcoder::Stats &stats = job.mStats;
+    if (job.mResult != OK) {
+        printf("%s: FAILED (%d)\n", job.mInput.c_str(), job.mResult);
+        return;
+    }
+    double totalS = stats.mTotalUs / 1E6;
+    printf("%s -> %s: %.2f s\n", job.mInput.c_str(), job.mOutput.c_str(), totalS);
+    printf("    extractor: %zu samples, %.1f ms busy\n",
+            stats.mSamplesRead, stats.mExtractorUs / 1E3);
+    printf("    decoder:   %zu frames, %.2f fps\n",
+            stats.mFramesDecoded, totalS > 0 ? stats.mFramesDecoded / totalS : 0.);
+    printf("    encoder:   %zu frames, %.2f fps, first frame after %.1f ms\n",
+            stats.mFramesEncoded, totalS > 0 ? stats.mFramesEncoded / totalS : 0.,
+            stats.mFirstFrameUs / 1E3);
+    printf("    muxer:     %.2f MB, %.1f ms busy\n",
+            stats.mBytesMuxed / 1E6, stats.mMuxerUs / 1E3);
+}
+
+}  // unnamed namespace
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    Transcoder::Config config;
+    const char *outputDir = NULL;
+    int numJobs = 2;
+
+    int res;
+    while ((res = getopt(argc, argv, "h?j:m:b:i:nwo:")) >= 0) {
+        switch (res) {
+            case 'j':
+            {
+                numJobs = atoi(optarg);
+                break;
+            }
+
+            case 'm':
+            {
+                config.mVideoMime = optarg;
+                break;
+            }
+
+            case 'b':
+            {
+                config.mVideoBitrate = atoi(optarg) * 1000;
+                break;
+            }
+
+            case 'i':
+            {
+                config.mIFrameIntervalS = atoi(optarg);
+                break;
+            }
+
+            case 'n':
+            {
+                config.mCopyAudio = false;
+                break;
+            }
+
+            case 'w':
+            {
+                config.mContainer = MediaMuxer::OUTPUT_FORMAT_WEBM;
+                break;
+            }
+
+            case 'o':
+            {
+                outputDir = optarg;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 || outputDir == NULL || numJobs < 1) {
+        usage(me);
+    }
+
+    std::vector<Job> jobs(argc);
+    const char *extension =
+            config.mContainer == MediaMuxer::OUTPUT_FORMAT_WEBM ? "webm" : "mp4";
+    for (int i = 0; i < argc; ++i) {
+        AString input(argv[i]);
+        const char *slash = strrchr(argv[i], '/');
+        const char *base = slash != NULL ? slash + 1 : argv[i];
+        const char *dot = strrchr(base, '.');
+        AString name(base, (dot != NULL && dot != base) ? dot - base : strlen(base));
+        jobs[i].mInput = input;
+        jobs[i].mOutput = AStringPrintf("%s/%s.%s", outputDir, name.c_str(), extension);
+        jobs[i].mResult = OK;
+        memset(&jobs[i].mStats, 0, sizeof(jobs[i].mStats));
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    JobQueue queue(&jobs, config);
+    int64_t startUs = ALooper::GetNowUs();
+
+    std::vector<sp<Worker> > workers;
+    for (int i = 0; i < numJobs && (size_t)i < jobs.size(); ++i) {
+        sp<Worker> worker = new Worker(&queue);
+        worker->run("transcode");
+        workers.push_back(worker);
+    }
+    for (const sp<Worker> &worker : workers) {
+        worker->join();
+    }
+
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+    int failures = 0;
+    size_t totalFrames = 0;
+    for (const Job &job : jobs) {
+        printStats(job);
+        if (job.mResult != OK) {
+            ++failures;
+        }
+        totalFrames += job.mStats.mFramesEncoded;
+    }
+    printf("%zu files, %d failed, %zu frames in %.2f s: %.2f fps with %d jobs\n",
+            jobs.size(), failures, totalFrames, elapsedUs / 1E6,
+            elapsedUs > 0 ? totalFrames * 1E6 / elapsedUs : 0., numJobs);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -294,12 +294,14 @@ status_t CryptoHal::toSharedBuffer(const sp<IMemory>& memory, int32_t seqNum, ::
     }
 
     // memory must be in one of the heaps that have been set
-    if (mHeapBases.indexOfKey(seqNum) < 0) {
+    ssize_t index = mHeapBases.indexOfKey(seqNum);
+    if (index < 0) {
         return UNKNOWN_ERROR;
     }
+    const HeapBase &heapBase = mHeapBases.valueAt(index);
 
     // heap must be the same size as the one that was set in setHeapBase
-    if (mHeapBases.valueFor(seqNum).getSize() != heap->getSize()) {
+    if (heapBase.getSize() != heap->getSize()) {
         android_errorWriteLog(0x534e4554, "76221123");
         return UNKNOWN_ERROR;
      }
@@ -312,7 +314,7 @@ status_t CryptoHal::toSharedBuffer(const sp<IMemory>& memory, int32_t seqNum, ::
         return UNKNOWN_ERROR;
     }
 
-    buffer->bufferId = mHeapBases.valueFor(seqNum).getBufferId();
+    buffer->bufferId = heapBase.getBufferId();
     buffer->offset = offset >= 0 ? offset : 0;
     buffer->size = size;
     return OK;
@@ -351,14 +353,14 @@ ssize_t CryptoHal::decrypt(const uint8_t keyId[16], const uint8_t iv[16],
     hPattern.encryptBlocks = pattern.mEncryptBlocks;
     hPattern.skipBlocks = pattern.mSkipBlocks;
 
-    std::vector<SubSample> stdSubSamples;
+    // Reuse the subsample storage across calls rather than allocating per sample
+    mSubSamples.resize(numSubSamples);
     for (size_t i = 0; i < numSubSamples; i++) {
-        SubSample subSample;
-        subSample.numBytesOfClearData = subSamples[i].mNumBytesOfClearData;
-        subSample.numBytesOfEncryptedData = subSamples[i].mNumBytesOfEncryptedData;
-        stdSubSamples.push_back(subSample);
+        mSubSamples[i].numBytesOfClearData = subSamples[i].mNumBytesOfClearData;
+        mSubSamples[i].numBytesOfEncryptedData = subSamples[i].mNumBytesOfEncryptedData;
     }
-    auto hSubSamples = hidl_vec<SubSample>(stdSubSamples);
+    hidl_vec<SubSample> hSubSamples;
+    hSubSamples.setToExternal(mSubSamples.data(), mSubSamples.size());
 
     int32_t heapSeqNum = source.mHeapSeqNum;
     bool secure;
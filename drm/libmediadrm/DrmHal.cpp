@@ -250,6 +250,10 @@ struct DrmSessionClient : public DrmSessionClientInterface {
             return true;
         }
         status_t err = drm->closeSession(sessionId);
+        {
+            Mutex::Autolock autoLock(drm->mLock);
+            drm->mMetrics.AddSessionReclaim(sessionId, false, err == OK);
+        }
         if (err != OK) {
             return false;
         }
@@ -553,6 +557,7 @@ status_t DrmHal::openSession(DrmPlugin::SecurityLevel level,
         Vector<uint8_t> &sessionId) {
     Mutex::Autolock autoLock(mLock);
     INIT_CHECK();
+    EventTimer<status_t> openSessionTimer(&mMetrics.mOpenSessionTimeUs);
 
     SecurityLevel hSecurityLevel;
     bool setSecurityLevel = true;
@@ -577,6 +582,7 @@ status_t DrmHal::openSession(DrmPlugin::SecurityLevel level,
         setSecurityLevel = false;
         break;
     default:
+        openSessionTimer.SetAttribute(ERROR_DRM_CANNOT_HANDLE);
         return ERROR_DRM_CANNOT_HANDLE;
     }
 
@@ -617,6 +623,7 @@ status_t DrmHal::openSession(DrmPlugin::SecurityLevel level,
             // deadlock.
             retry = DrmSessionManager::Instance()->reclaimSession(getCallingPid());
             mLock.lock();
+            mMetrics.AddSessionReclaim(Vector<uint8_t>(), true, retry);
         } else {
             retry = false;
         }
@@ -630,6 +637,7 @@ status_t DrmHal::openSession(DrmPlugin::SecurityLevel level,
     }
 
     mMetrics.mOpenSessionCounter.Increment(err);
+    openSessionTimer.SetAttribute(err);
     return err;
 }
 
@@ -193,6 +193,25 @@ void SetValue(const String16 &name, DrmMetricGroup::ValueType type,
     }
 }
 
+void SetDistributionMetric(
+    const android::EventStatistics &stats, const android::status_t status,
+    DrmFrameworkMetrics::DistributionMetric *metric) {
+    metric->set_min(stats.min);
+    metric->set_max(stats.max);
+    metric->set_mean(stats.mean);
+    metric->set_operation_count(stats.count);
+    metric->set_variance(stats.sum_squared_deviation / stats.count);
+    metric->mutable_attributes()->set_error_code(status);
+
+    size_t buckets = android::kEventHistogramBuckets;
+    while (buckets > 0 && stats.histogram[buckets - 1] == 0) {
+        buckets--;
+    }
+    for (size_t i = 0; i < buckets; i++) {
+        metric->add_histogram_counts(stats.histogram[i]);
+    }
+}
+
 inline String16 MakeIndexString(unsigned int index) {
   std::string str("[");
   str.append(std::to_string(index));
@@ -206,6 +225,7 @@ namespace android {
 
 MediaDrmMetrics::MediaDrmMetrics()
     : mOpenSessionCounter("drm.mediadrm.open_session", "status"),
+      mOpenSessionTimeUs("drm.mediadrm.open_session_time", "status"),
       mCloseSessionCounter("drm.mediadrm.close_session", "status"),
       mGetKeyRequestTimeUs("drm.mediadrm.get_key_request", "status"),
       mProvideKeyResponseTimeUs("drm.mediadrm.provide_key_response", "status"),
@@ -237,6 +257,16 @@ void MediaDrmMetrics::SetSessionEnd(const android::Vector<uint8_t> &sessionId) {
     }
 }
 
+void MediaDrmMetrics::AddSessionReclaim(
+    const android::Vector<uint8_t> &sessionId, bool requested,
+    bool succeeded) {
+    if (mSessionReclaims.size() >= kMaxSessionReclaims) {
+        mSessionReclaims.pop_front();
+    }
+    mSessionReclaims.push_back({GetCurrentTimeMs(), ToHexString(sessionId),
+                                requested, succeeded});
+}
+
 void MediaDrmMetrics::Export(PersistableBundle *metrics) {
     if (!metrics) {
         ALOGE("metrics was unexpectedly null.");
@@ -322,26 +352,20 @@ status_t MediaDrmMetrics::GetSerializedMetrics(std::string *serializedMetrics) {
 
     mGetKeyRequestTimeUs.ExportValues(
         [&](const status_t status, const EventStatistics &stats) {
-            DrmFrameworkMetrics::DistributionMetric *metric =
-                metrics.add_get_key_request_time_us();
-            metric->set_min(stats.min);
-            metric->set_max(stats.max);
-            metric->set_mean(stats.mean);
-            metric->set_operation_count(stats.count);
-            metric->set_variance(stats.sum_squared_deviation / stats.count);
-            metric->mutable_attributes()->set_error_code(status);
+            SetDistributionMetric(stats, status,
+                                  metrics.add_get_key_request_time_us());
         });
 
     mProvideKeyResponseTimeUs.ExportValues(
         [&](const status_t status, const EventStatistics &stats) {
-            DrmFrameworkMetrics::DistributionMetric *metric =
-                metrics.add_provide_key_response_time_us();
-            metric->set_min(stats.min);
-            metric->set_max(stats.max);
-            metric->set_mean(stats.mean);
-            metric->set_operation_count(stats.count);
-            metric->set_variance(stats.sum_squared_deviation / stats.count);
-            metric->mutable_attributes()->set_error_code(status);
+            SetDistributionMetric(stats, status,
+                                  metrics.add_provide_key_response_time_us());
+        });
+
+    mOpenSessionTimeUs.ExportValues(
+        [&](const status_t status, const EventStatistics &stats) {
+            SetDistributionMetric(stats, status,
+                                  metrics.add_open_session_time_us());
         });
 
     for (const auto &sessionLifespan : mSessionLifespans) {
@@ -353,6 +377,17 @@ status_t MediaDrmMetrics::GetSerializedMetrics(std::string *serializedMetrics) {
             sessionLifespan.second.second);
     }
 
+    for (const auto &reclaim : mSessionReclaims) {
+        DrmFrameworkMetrics::SessionReclaim *record =
+            metrics.add_session_reclaims();
+        record->set_time_ms(reclaim.timeMs);
+        if (!reclaim.sessionIdHex.empty()) {
+            record->set_session_id(reclaim.sessionIdHex);
+        }
+        record->set_requested(reclaim.requested);
+        record->set_succeeded(reclaim.succeeded);
+    }
+
     if (!metrics.SerializeToString(serializedMetrics)) {
         ALOGE("Failed to serialize metrics.");
         return UNKNOWN_ERROR;
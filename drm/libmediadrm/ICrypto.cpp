@@ -325,13 +325,13 @@ status_t BnCrypto::onTransact(
 
             SourceBuffer source;
 
-            source.mSharedMemory =
-                interface_cast<IMemory>(data.readStrongBinder());
+            sp<IBinder> sourceBinder = data.readStrongBinder();
+            source.mHeapSeqNum = data.readInt32();
+            source.mSharedMemory = getMemory(sourceBinder, source.mHeapSeqNum);
             if (source.mSharedMemory == NULL) {
                 reply->writeInt32(BAD_VALUE);
                 return OK;
             }
-            source.mHeapSeqNum = data.readInt32();
 
             int32_t offset = data.readInt32();
 
@@ -357,7 +357,7 @@ status_t BnCrypto::onTransact(
                 }
             } else if (destination.mType == kDestinationTypeSharedMemory) {
                 destination.mSharedMemory =
-                        interface_cast<IMemory>(data.readStrongBinder());
+                        getMemory(data.readStrongBinder(), source.mHeapSeqNum);
                 if (destination.mSharedMemory == NULL) {
                     reply->writeInt32(BAD_VALUE);
                     return OK;
@@ -458,6 +458,10 @@ status_t BnCrypto::onTransact(
         {
             CHECK_INTERFACE(ICrypto, data, reply);
             int32_t seqNum = data.readInt32();
+            {
+                Mutex::Autolock autoLock(mMemoryLock);
+                mMemories.erase(seqNum);
+            }
             unsetHeap(seqNum);
             return OK;
         }
@@ -467,4 +471,32 @@ status_t BnCrypto::onTransact(
     }
 }
 
+sp<IMemory> BnCrypto::getMemory(const sp<IBinder> &binder, int32_t heapSeqNum) {
+    static const size_t kMaxHeaps = 16;
+    static const size_t kMaxMemoriesPerHeap = 64;
+
+    if (binder == NULL) {
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(mMemoryLock);
+    if (mMemories.size() >= kMaxHeaps && mMemories.count(heapSeqNum) == 0) {
+        mMemories.clear();
+    }
+    std::map<sp<IBinder>, sp<IMemory>> &memories = mMemories[heapSeqNum];
+    auto it = memories.find(binder);
+    if (it != memories.end()) {
+        return it->second;
+    }
+
+    sp<IMemory> memory = interface_cast<IMemory>(binder);
+    if (memory != NULL) {
+        if (memories.size() >= kMaxMemoriesPerHeap) {
+            memories.clear();
+        }
+        memories.emplace(binder, memory);
+    }
+    return memory;
+}
+
 }  // namespace android
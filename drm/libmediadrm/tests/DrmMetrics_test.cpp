@@ -336,6 +336,7 @@ TEST_F(MediaDrmMetricsTest, TimeMetricsProtoSerialization) {
     double time = 0;
     for (int i = 0; i < 5; i++) {
       time += 1.0;
+      metrics.mOpenSessionTimeUs.Record(time, s);
       metrics.mGetKeyRequestTimeUs.Record(time, s);
       metrics.mProvideKeyResponseTimeUs.Record(time, s);
     }
@@ -351,18 +352,32 @@ TEST_F(MediaDrmMetricsTest, TimeMetricsProtoSerialization) {
       "get_key_request_time_us { "
       "  min: 1 max: 5 mean: 3.5 variance: 1 operation_count: 5 "
       "  attributes { error_code: -0x7FFFFFF8 } "
+      "  histogram_counts: [0, 1, 2, 2] "
       "} "
       "get_key_request_time_us { "
       "  min: 1 max: 5 mean: 3.5 variance: 1 operation_count: 5 "
       "  attributes { error_code: 0 } "
+      "  histogram_counts: [0, 1, 2, 2] "
       "} "
       "provide_key_response_time_us { "
       "  min: 1 max: 5 mean: 3.5 variance: 1 operation_count: 5 "
       "  attributes { error_code: -0x7FFFFFF8 } "
+      "  histogram_counts: [0, 1, 2, 2] "
       "} "
       "provide_key_response_time_us { "
       "  min: 1 max: 5 mean: 3.5 variance: 1 operation_count: 5 "
       "  attributes { error_code: 0 } "
+      "  histogram_counts: [0, 1, 2, 2] "
+      "} "
+      "open_session_time_us { "
+      "  min: 1 max: 5 mean: 3.5 variance: 1 operation_count: 5 "
+      "  attributes { error_code: -0x7FFFFFF8 } "
+      "  histogram_counts: [0, 1, 2, 2] "
+      "} "
+      "open_session_time_us { "
+      "  min: 1 max: 5 mean: 3.5 variance: 1 operation_count: 5 "
+      "  attributes { error_code: 0 } "
+      "  histogram_counts: [0, 1, 2, 2] "
       "} ";
 
   DrmFrameworkMetrics expectedMetricsProto;
@@ -417,6 +432,57 @@ TEST_F(MediaDrmMetricsTest, SessionLifetimeProtoSerialization) {
       << diffString;
 }
 
+TEST_F(MediaDrmMetricsTest, SessionReclaimProtoSerialization) {
+  // Use the fake so the clock is predictable;
+  FakeMediaDrmMetrics metrics;
+
+  android::Vector<uint8_t> sessionId;
+  sessionId.push_back(1);
+  sessionId.push_back(2);
+
+  metrics.AddSessionReclaim(android::Vector<uint8_t>(), true, false);
+  metrics.AddSessionReclaim(sessionId, false, true);
+
+  std::string serializedMetrics;
+  ASSERT_EQ(OK, metrics.GetSerializedMetrics(&serializedMetrics));
+
+  DrmFrameworkMetrics metricsProto;
+  ASSERT_TRUE(metricsProto.ParseFromString(serializedMetrics));
+
+  std::string expectedMetrics =
+      "session_reclaims { time_ms: 0 requested: true succeeded: false } "
+      "session_reclaims { "
+      "  time_ms: 1 session_id: '0102' requested: false succeeded: true "
+      "} ";
+
+  DrmFrameworkMetrics expectedMetricsProto;
+  ASSERT_TRUE(TextFormat::MergeFromString(expectedMetrics, &expectedMetricsProto));
+
+  std::string diffString;
+  MessageDifferencer differ;
+  differ.ReportDifferencesToString(&diffString);
+  ASSERT_TRUE(differ.Compare(expectedMetricsProto, metricsProto))
+      << diffString;
+}
+
+TEST_F(MediaDrmMetricsTest, SessionReclaimsBounded) {
+  FakeMediaDrmMetrics metrics;
+
+  for (int i = 0; i < 100; i++) {
+    metrics.AddSessionReclaim(android::Vector<uint8_t>(), true, true);
+  }
+
+  std::string serializedMetrics;
+  ASSERT_EQ(OK, metrics.GetSerializedMetrics(&serializedMetrics));
+
+  DrmFrameworkMetrics metricsProto;
+  ASSERT_TRUE(metricsProto.ParseFromString(serializedMetrics));
+  ASSERT_EQ(64, metricsProto.session_reclaims_size());
+  // The oldest records are dropped.
+  EXPECT_EQ(36U, metricsProto.session_reclaims(0).time_ms());
+  EXPECT_EQ(99U, metricsProto.session_reclaims(63).time_ms());
+}
+
 TEST_F(MediaDrmMetricsTest, HidlToBundleMetricsEmpty) {
   hidl_vec<DrmMetricGroup> hidlMetricGroups;
   PersistableBundle bundleMetricGroups;
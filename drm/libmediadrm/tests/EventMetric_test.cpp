@@ -96,6 +96,40 @@ TEST(EventMetricTest, StringDataType) {
   EXPECT_EQ(4, values["b"].count);
 }
 
+TEST(EventMetricTest, Histogram) {
+  EventMetric<int> metric("MyMetricName", "MetricAttributeName");
+
+  metric.Record(0.5, 0);
+  metric.Record(1, 0);
+  metric.Record(3, 0);
+  metric.Record(4, 0);
+  metric.Record(1000, 0);
+  metric.Record(1e12, 0);
+
+  std::map<int, EventStatistics> values;
+  metric.ExportValues(
+      [&] (int attribute_value, const EventStatistics& value) {
+          values[attribute_value] = value;
+      });
+
+  ASSERT_EQ(1u, values.size());
+  const EventStatistics& stats = values[0];
+  EXPECT_EQ(1, stats.histogram[0]);
+  EXPECT_EQ(1, stats.histogram[1]);
+  EXPECT_EQ(1, stats.histogram[2]);
+  EXPECT_EQ(1, stats.histogram[3]);
+  // 1000 is in [512, 1024).
+  EXPECT_EQ(1, stats.histogram[10]);
+  // Values beyond the last bucket are counted in it.
+  EXPECT_EQ(1, stats.histogram[kEventHistogramBuckets - 1]);
+
+  int64_t total = 0;
+  for (size_t i = 0; i < kEventHistogramBuckets; i++) {
+    total += stats.histogram[i];
+  }
+  EXPECT_EQ(stats.count, total);
+}
+
 // Helper class that allows us to mock the clock.
 template<typename AttributeType>
 class MockEventTimer : public EventTimer<AttributeType> {
@@ -622,9 +622,12 @@ public:
 
     /* getVolume() updates the last volume/xoffset state so it is not
      * const, even though logically it may be viewed as const.
+     *
+     * The volume is that at aheadFrames track frames after trackFrameCount,
+     * e.g. at the end of the buffer about to be mixed.
      */
     std::pair<T /* volume */, bool /* active */> getVolume(
-            int64_t trackFrameCount, double trackSampleRate) {
+            int64_t trackFrameCount, double trackSampleRate, int64_t aheadFrames = 0) {
         if ((getFlags() & VolumeShaper::Operation::FLAG_DELAY) != 0) {
             // We haven't had PLAY called yet, so just return the value
             // as if PLAY were called just now.
@@ -641,8 +644,15 @@ public:
             updatePosition(frameCount, sampleRate, mDelayXOffset);
             mStartFrame = frameCount;
         }
-        VS_LOG("frameCount: %lld", (long long)frameCount);
-        const S x = mXTranslate((T)frameCount);
+        int64_t evaluateFrame = frameCount;
+        if (!clockTime) {
+            evaluateFrame += aheadFrames;
+        } else if (trackSampleRate > 0) {
+            evaluateFrame += (int64_t)(aheadFrames * 1000000 / trackSampleRate);
+        }
+        VS_LOG("frameCount: %lld  aheadFrames: %lld",
+                (long long)frameCount, (long long)aheadFrames);
+        const S x = mXTranslate((T)evaluateFrame);
         VS_LOG("translation to normalized time: %f", x);
 
         std::tuple<T /* volume */, S /* position */, bool /* active */> vt =
@@ -902,15 +912,18 @@ public:
 
     /* getVolume() is not const, as it updates internal state.
      * Once called, any VolumeShapers not already started begin running.
+     * A non-zero aheadFrames evaluates the VolumeShapers that many frames
+     * after trackFrameCount, see VolumeShaper::getVolume().
      */
-    std::pair<T /* volume */, bool /* active */> getVolume(int64_t trackFrameCount) {
+    std::pair<T /* volume */, bool /* active */> getVolume(
+            int64_t trackFrameCount, int64_t aheadFrames = 0) {
         AutoMutex _l(mLock);
         mLastFrame = trackFrameCount;
         T volume(1);
         size_t activeCount = 0;
         for (auto it = mVolumeShapers.begin(); it != mVolumeShapers.end();) {
             const std::pair<T, bool> shaperVolume =
-                    it->getVolume(trackFrameCount, mSampleRate);
+                    it->getVolume(trackFrameCount, mSampleRate, aheadFrames);
             volume *= shaperVolume.first;
             activeCount += shaperVolume.second;
             ++it;
@@ -119,7 +119,17 @@ struct AudioTrackSharedStatic {
                     mPosLoopQueue;
 };
 
-typedef SingleStateQueue<AudioPlaybackRate> PlaybackRateQueue;
+// The mix parameters of an AudioTrack, pushed as a whole by the client and
+// applied as a whole by the server in the next mix cycle.
+// Since this is located in shared memory, there are no constructors.
+struct AudioTrackMixParameters {
+    gain_minifloat_packed_t mVolumeLR;
+    uint16_t                mSendLevel;     // Fixed point U4.12 so 0x1000 means 1.0
+    uint16_t                mPad;           // unused
+    AudioPlaybackRate       mPlaybackRate;
+};
+
+typedef SingleStateQueue<AudioTrackMixParameters> MixParametersQueue;
 
 typedef SingleStateQueue<ExtendedTimestamp> ExtendedTimestampQueue;
 
@@ -169,12 +179,8 @@ private:
                 uint32_t    mSampleRate;    // AudioTrack only: client's requested sample rate in Hz
                                             // or 0 == default. Write-only client, read-only server.
 
-                PlaybackRateQueue::Shared mPlaybackRateQueue;
-
                 // client write-only, server read-only
-                uint16_t    mSendLevel;      // Fixed point U4.12 so 0x1000 means 1.0
-
-                uint16_t    mPad2 __attribute__((__unused__)); // unused
+                MixParametersQueue::Shared mMixParametersQueue;
 
                 // server write-only, client read
                 ExtendedTimestampQueue::Shared mExtendedTimestampQueue;
@@ -361,7 +367,11 @@ public:
             size_t frameSize, bool clientInServer = false)
         : ClientProxy(cblk, buffers, frameCount, frameSize, true /*isOut*/,
           clientInServer),
-          mPlaybackRateMutator(&cblk->mPlaybackRateQueue) {
+          mMixParametersMutator(&cblk->mMixParametersQueue) {
+        mMixParameters.mVolumeLR = GAIN_MINIFLOAT_PACKED_UNITY;
+        mMixParameters.mSendLevel = 0;
+        mMixParameters.mPad = 0;
+        mMixParameters.mPlaybackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
     }
 
     virtual ~AudioTrackClientProxy() { }
@@ -369,14 +379,20 @@ public:
     // No barriers on the following operations, so the ordering of loads/stores
     // with respect to other parameters is UNPREDICTABLE. That's considered safe.
 
+    // The send level, stereo gains and playback rate are pushed together to the server,
+    // which applies the last complete set once per mix cycle.
+
     // caller must limit to 0.0 <= sendLevel <= 1.0
     void        setSendLevel(float sendLevel) {
-        mCblk->mSendLevel = uint16_t(sendLevel * 0x1000);
+        mMixParameters.mSendLevel = uint16_t(sendLevel * 0x1000);
+        mMixParametersMutator.push(mMixParameters);
     }
 
     // set stereo gains
     void        setVolumeLR(gain_minifloat_packed_t volumeLR) {
-        mCblk->mVolumeLR = volumeLR;
+        mCblk->mVolumeLR = volumeLR;    // for the FastMixer
+        mMixParameters.mVolumeLR = volumeLR;
+        mMixParametersMutator.push(mMixParameters);
     }
 
     void        setSampleRate(uint32_t sampleRate) {
@@ -384,7 +400,19 @@ public:
     }
 
     void        setPlaybackRate(const AudioPlaybackRate& playbackRate) {
-        mPlaybackRateMutator.push(playbackRate);
+        mMixParameters.mPlaybackRate = playbackRate;
+        mMixParametersMutator.push(mMixParameters);
+    }
+
+    // Set all of the above with a single push, so that the server never applies part of them.
+    // caller must limit to 0.0 <= sendLevel <= 1.0
+    void        setMixParameters(gain_minifloat_packed_t volumeLR, float sendLevel,
+                        const AudioPlaybackRate& playbackRate) {
+        mCblk->mVolumeLR = volumeLR;
+        mMixParameters.mVolumeLR = volumeLR;
+        mMixParameters.mSendLevel = uint16_t(sendLevel * 0x1000);
+        mMixParameters.mPlaybackRate = playbackRate;
+        mMixParametersMutator.push(mMixParameters);
     }
 
     // Sends flush and stop position information from the client to the server,
@@ -402,6 +430,11 @@ public:
         return mCblk->u.mStreaming.mUnderrunCount;
     }
 
+    // Copies to dst the oldest frames, up to maxFrames, that were released by the client but
+    // not yet consumed by the server, and returns the number of frames copied.
+    // Used to carry pending data over to a new control block when a track is restored.
+    size_t      copyUnconsumedFrames(void *dst, size_t maxFrames) const;
+
     bool        clearStreamEndDone();   // and return previous value
 
     bool        getStreamEndDone() const;
@@ -409,7 +442,8 @@ public:
     status_t    waitStreamEndDone(const struct timespec *requested);
 
 private:
-    PlaybackRateQueue::Mutator   mPlaybackRateMutator;
+    AudioTrackMixParameters      mMixParameters;    // last pushed to the server
+    MixParametersQueue::Mutator  mMixParametersMutator;
 };
 
 class StaticAudioTrackClientProxy : public AudioTrackClientProxy {
@@ -570,10 +604,13 @@ public:
     AudioTrackServerProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
             size_t frameSize, bool clientInServer = false, uint32_t sampleRate = 0)
         : ServerProxy(cblk, buffers, frameCount, frameSize, true /*isOut*/, clientInServer),
-          mPlaybackRateObserver(&cblk->mPlaybackRateQueue),
+          mMixParametersObserver(&cblk->mMixParametersQueue),
           mUnderrunCount(0), mUnderrunning(false), mDrained(true) {
         mCblk->mSampleRate = sampleRate;
-        mPlaybackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
+        mMixParameters.mVolumeLR = GAIN_MINIFLOAT_PACKED_UNITY;
+        mMixParameters.mSendLevel = 0;
+        mMixParameters.mPad = 0;
+        mMixParameters.mPlaybackRate = AUDIO_PLAYBACK_RATE_DEFAULT;
     }
 protected:
     virtual ~AudioTrackServerProxy() { }
@@ -581,7 +618,8 @@ protected:
 public:
     // return value of these methods must be validated by the caller
     uint32_t    getSampleRate() const { return mCblk->mSampleRate; }
-    uint16_t    getSendLevel_U4_12() const { return mCblk->mSendLevel; }
+    uint16_t    getSendLevel_U4_12() const { return mMixParameters.mSendLevel; }
+    // Latest stereo gains, may be called from the FastMixer.
     gain_minifloat_packed_t getVolumeLR() const { return mCblk->mVolumeLR; }
 
     // estimated total number of filled frames available to server to read,
@@ -608,8 +646,12 @@ public:
     // and thus which resulted in an underrun.
     virtual uint32_t    getUnderrunFrames() const { return mCblk->u.mStreaming.mUnderrunFrames; }
 
+    // Return the stereo gains, send level and playback rate read atomically, as last set
+    // together by the client. Not multi-thread safe on server side.
+    AudioTrackMixParameters getMixParameters();
+
     // Return the playback speed and pitch read atomically. Not multi-thread safe on server side.
-    AudioPlaybackRate getPlaybackRate();
+    AudioPlaybackRate getPlaybackRate() { return getMixParameters().mPlaybackRate; }
 
     // Set the internal drain state of the track buffer from the timestamp received.
     virtual void        setDrained(bool drained) {
@@ -629,8 +671,8 @@ public:
     virtual void        start();
 
 private:
-    AudioPlaybackRate             mPlaybackRate;  // last observed playback rate
-    PlaybackRateQueue::Observer   mPlaybackRateObserver;
+    AudioTrackMixParameters       mMixParameters; // last observed mix parameters
+    MixParametersQueue::Observer  mMixParametersObserver;
 
     // Last client stop-at position when start() was called. Used for streaming AudioTracks.
     std::atomic<int32_t>          mStopLast{0};
@@ -29,7 +29,9 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/MetaDataUtils.h>
+#include <utils/Mutex.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -38,7 +40,7 @@ public:
     AACSource(
             DataSourceBase *source,
             MetaDataBase &meta,
-            const Vector<uint64_t> &offset_vector,
+            const sp<ADTSFrameIndex> &frame_index,
             int64_t frame_duration_us);
 
     virtual status_t start(MetaDataBase *params = NULL);
@@ -58,11 +60,12 @@ private:
     MetaDataBase mMeta;
 
     off64_t mOffset;
+    int64_t mCurrentFrame;
     int64_t mCurrentTimeUs;
     bool mStarted;
     MediaBufferGroup *mGroup;
 
-    Vector<uint64_t> mOffsetVector;
+    sp<ADTSFrameIndex> mFrameIndex;
     int64_t mFrameDurationUs;
 
     AACSource(const AACSource &);
@@ -132,6 +135,110 @@ static size_t getAdtsFrameLength(DataSourceBase *source, off64_t offset, size_t*
     return frameSize;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Sparse index of the ADTS frames in a stream, holding the offset of every
+// kFramesPerEntry-th frame. It is filled in lazily: by the frames the sources
+// read during playback, and by header-only scans when a seek lands beyond the
+// part of the stream seen so far. A frame between two entries is found by
+// walking the headers forward from the entry before it.
+//
+// Shared by the extractor and its sources, which may read concurrently.
+struct ADTSFrameIndex : public RefBase {
+    static const int64_t kFramesPerEntry = 64;
+
+    ADTSFrameIndex(DataSourceBase *source, off64_t firstFrameOffset)
+        : mDataSource(source),
+          mFirstFrameOffset(firstFrameOffset),
+          mNumFrames(0),
+          mEndOffset(firstFrameOffset),
+          mReachedEnd(false) {
+    }
+
+    off64_t firstFrameOffset() const { return mFirstFrameOffset; }
+
+    // Scans ahead until at least 'numFrames' frames are indexed or the end
+    // of the stream is reached. Returns the number of frames indexed.
+    int64_t scanTo(int64_t numFrames, off64_t *endOffset, bool *reachedEnd) {
+        Mutex::Autolock autoLock(mLock);
+        scanTo_l(numFrames);
+        *endOffset = mEndOffset;
+        *reachedEnd = mReachedEnd;
+        return mNumFrames;
+    }
+
+    // Records the frame the caller just read, if it is the next one past the
+    // indexed part of the stream.
+    void noteFrame(int64_t frame, off64_t offset, size_t frameSize) {
+        Mutex::Autolock autoLock(mLock);
+        if (frame == mNumFrames && offset == mEndOffset) {
+            addFrame_l(frameSize);
+        }
+    }
+
+    // Returns the offset of frame 'frame', or ERROR_END_OF_STREAM if the
+    // stream ends before it.
+    status_t findFrame(int64_t frame, off64_t *offset) {
+        Mutex::Autolock autoLock(mLock);
+        if (frame >= mNumFrames) {
+            scanTo_l(frame + 1);
+            if (frame >= mNumFrames) {
+                return ERROR_END_OF_STREAM;
+            }
+        }
+
+        off64_t pos = mEntries.itemAt(frame / kFramesPerEntry);
+        for (int64_t i = frame % kFramesPerEntry; i > 0; --i) {
+            size_t frameSize = getAdtsFrameLength(mDataSource, pos, NULL);
+            if (frameSize == 0) {
+                // These headers were valid when indexed, so this is a read failure
+                return ERROR_IO;
+            }
+            pos += frameSize;
+        }
+        *offset = pos;
+        return OK;
+    }
+
+private:
+    Mutex mLock;
+    DataSourceBase *mDataSource;
+    const off64_t mFirstFrameOffset;
+
+    // offset of frame i * kFramesPerEntry
+    Vector<off64_t> mEntries;
+    // # of frames walked from the start of the stream, and where the next one begins
+    int64_t mNumFrames;
+    off64_t mEndOffset;
+    bool mReachedEnd;
+
+    void addFrame_l(size_t frameSize) {
+        if (mNumFrames % kFramesPerEntry == 0) {
+            mEntries.push(mEndOffset);
+        }
+        mEndOffset += frameSize;
+        ++mNumFrames;
+    }
+
+    void scanTo_l(int64_t numFrames) {
+        while (!mReachedEnd && mNumFrames < numFrames) {
+            size_t frameSize = getAdtsFrameLength(mDataSource, mEndOffset, NULL);
+            if (frameSize == 0) {
+                mReachedEnd = true;
+                break;
+            }
+            addFrame_l(frameSize);
+        }
+    }
+
+    ADTSFrameIndex(const ADTSFrameIndex &);
+    ADTSFrameIndex &operator=(const ADTSFrameIndex &);
+};
+
+// Frames scanned at open; the duration of longer streams is estimated from
+// the average size of these.
+static const int64_t kMaxInitialScanFrames = 2000;
+
 AACExtractor::AACExtractor(
         DataSourceBase *source, off64_t offset)
     : mDataSource(source),
@@ -153,28 +260,26 @@ AACExtractor::AACExtractor(
 
     MakeAACCodecSpecificData(mMeta, profile, sf_index, channel);
 
-    off64_t streamSize, numFrames = 0;
-    size_t frameSize = 0;
-    int64_t duration = 0;
+    mFrameIndex = new ADTSFrameIndex(mDataSource, offset);
 
+    off64_t streamSize;
     if (mDataSource->getSize(&streamSize) == OK) {
-         while (offset < streamSize) {
-            if ((frameSize = getAdtsFrameLength(source, offset, NULL)) == 0) {
+        off64_t endOffset;
+        bool reachedEnd;
+        int64_t numFrames = mFrameIndex->scanTo(kMaxInitialScanFrames, &endOffset, &reachedEnd);
+
+        if (reachedEnd) {
+            if (endOffset < streamSize) {
                 ALOGW("prematured AAC stream (%lld vs %lld)",
-                        (long long)offset, (long long)streamSize);
-                break;
+                        (long long)endOffset, (long long)streamSize);
             }
-
-            mOffsetVector.push(offset);
-
-            offset += frameSize;
-            numFrames ++;
+        } else if (endOffset > offset) {
+            numFrames = (streamSize - offset) * numFrames / (endOffset - offset);
         }
 
         // Round up and get the duration
         mFrameDurationUs = (1024 * 1000000ll + (sr - 1)) / sr;
-        duration = numFrames * mFrameDurationUs;
-        mMeta.setInt64(kKeyDuration, duration);
+        mMeta.setInt64(kKeyDuration, numFrames * mFrameDurationUs);
     }
 
     mInitCheck = OK;
@@ -201,7 +306,7 @@ MediaTrack *AACExtractor::getTrack(size_t index) {
         return NULL;
     }
 
-    return new AACSource(mDataSource, mMeta, mOffsetVector, mFrameDurationUs);
+    return new AACSource(mDataSource, mMeta, mFrameIndex, mFrameDurationUs);
 }
 
 status_t AACExtractor::getTrackMetaData(MetaDataBase &meta, size_t index, uint32_t /* flags */) {
@@ -221,15 +326,16 @@ const size_t AACSource::kMaxFrameSize = 8192;
 AACSource::AACSource(
         DataSourceBase *source,
         MetaDataBase &meta,
-        const Vector<uint64_t> &offset_vector,
+        const sp<ADTSFrameIndex> &frame_index,
         int64_t frame_duration_us)
     : mDataSource(source),
       mMeta(meta),
       mOffset(0),
+      mCurrentFrame(0),
       mCurrentTimeUs(0),
       mStarted(false),
       mGroup(NULL),
-      mOffsetVector(offset_vector),
+      mFrameIndex(frame_index),
       mFrameDurationUs(frame_duration_us) {
 }
 
@@ -242,12 +348,8 @@ AACSource::~AACSource() {
 status_t AACSource::start(MetaDataBase * /* params */) {
     CHECK(!mStarted);
 
-    if (mOffsetVector.empty()) {
-        mOffset = 0;
-    } else {
-        mOffset = mOffsetVector.itemAt(0);
-    }
-
+    mOffset = mFrameIndex->firstFrameOffset();
+    mCurrentFrame = 0;
     mCurrentTimeUs = 0;
     mGroup = new MediaBufferGroup;
     mGroup->add_buffer(MediaBufferBase::Create(kMaxFrameSize));
@@ -280,13 +382,18 @@ status_t AACSource::read(
     if (options && options->getSeekTo(&seekTimeUs, &mode)) {
         if (mFrameDurationUs > 0) {
             int64_t seekFrame = seekTimeUs / mFrameDurationUs;
-            if (seekFrame < 0 || seekFrame >= (int64_t)mOffsetVector.size()) {
+            if (seekFrame < 0) {
                 android_errorWriteLog(0x534e4554, "70239507");
                 return ERROR_MALFORMED;
             }
+            off64_t seekOffset;
+            status_t err = mFrameIndex->findFrame(seekFrame, &seekOffset);
+            if (err != OK) {
+                return err;
+            }
+            mOffset = seekOffset;
+            mCurrentFrame = seekFrame;
             mCurrentTimeUs = seekFrame * mFrameDurationUs;
-
-            mOffset = mOffsetVector.itemAt(seekFrame);
         }
     }
 
@@ -314,7 +421,10 @@ status_t AACSource::read(
     buffer->meta_data().setInt64(kKeyTime, mCurrentTimeUs);
     buffer->meta_data().setInt32(kKeyIsSyncFrame, 1);
 
+    mFrameIndex->noteFrame(mCurrentFrame, mOffset, frameSize);
+
     mOffset += frameSize;
+    ++mCurrentFrame;
     mCurrentTimeUs += mFrameDurationUs;
 
     *out = buffer;
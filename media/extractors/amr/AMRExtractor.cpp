@@ -27,7 +27,9 @@
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/Mutex.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -37,8 +39,7 @@ public:
             DataSourceBase *source,
             MetaDataBase &meta,
             bool isWide,
-            const off64_t *offset_table,
-            size_t offset_table_length);
+            const sp<AMRFrameIndex> &frame_index);
 
     virtual status_t start(MetaDataBase *params = NULL);
     virtual status_t stop();
@@ -57,12 +58,12 @@ private:
     bool mIsWide;
 
     off64_t mOffset;
+    int64_t mCurrentFrame;
     int64_t mCurrentTimeUs;
     bool mStarted;
     MediaBufferGroup *mGroup;
 
-    off64_t mOffsetTable[OFFSET_TABLE_LEN];
-    size_t mOffsetTableLength;
+    sp<AMRFrameIndex> mFrameIndex;
 
     AMRSource(const AMRSource &);
     AMRSource &operator=(const AMRSource &);
@@ -117,6 +118,112 @@ static status_t getFrameSizeByOffset(DataSourceBase *source,
     return OK;
 }
 
+// Sparse index of the frames in a stream, holding the offset of every
+// kFramesPerEntry-th frame (one per second). It is filled in lazily: by the
+// frames the sources read during playback, and by header-only scans when a
+// seek lands beyond the part of the stream seen so far. A frame between two
+// entries is found by walking the headers forward from the entry before it.
+//
+// Shared by the extractor and its sources, which may read concurrently.
+struct AMRFrameIndex : public RefBase {
+    static const int64_t kFramesPerEntry = 50;
+
+    AMRFrameIndex(DataSourceBase *source, bool isWide)
+        : mDataSource(source),
+          mIsWide(isWide),
+          mNumFrames(0),
+          mEndOffset(firstFrameOffset()),
+          mReachedEnd(false) {
+    }
+
+    off64_t firstFrameOffset() const { return mIsWide ? 9 : 6; }
+
+    // Scans ahead until at least 'numFrames' frames are indexed or the end
+    // of the stream is reached. Returns the number of frames indexed.
+    int64_t scanTo(int64_t numFrames, off64_t *endOffset, bool *reachedEnd) {
+        Mutex::Autolock autoLock(mLock);
+        scanTo_l(numFrames);
+        *endOffset = mEndOffset;
+        *reachedEnd = mReachedEnd;
+        return mNumFrames;
+    }
+
+    // Records the frame the caller just read, if it is the next one past the
+    // indexed part of the stream.
+    void noteFrame(int64_t frame, off64_t offset, size_t frameSize) {
+        Mutex::Autolock autoLock(mLock);
+        if (frame == mNumFrames && offset == mEndOffset) {
+            addFrame_l(frameSize);
+        }
+    }
+
+    // Returns the offset of frame 'frame', or ERROR_END_OF_STREAM if the
+    // stream ends before it.
+    status_t findFrame(int64_t frame, off64_t *offset) {
+        Mutex::Autolock autoLock(mLock);
+        if (frame >= mNumFrames) {
+            scanTo_l(frame + 1);
+            if (frame >= mNumFrames) {
+                return ERROR_END_OF_STREAM;
+            }
+        }
+
+        off64_t pos = mEntries.itemAt(frame / kFramesPerEntry);
+        for (int64_t i = frame % kFramesPerEntry; i > 0; --i) {
+            size_t frameSize;
+            status_t err = getFrameSizeByOffset(mDataSource, pos, mIsWide, &frameSize);
+            if (err != OK) {
+                return err;
+            }
+            pos += frameSize;
+        }
+        *offset = pos;
+        return OK;
+    }
+
+private:
+    Mutex mLock;
+    DataSourceBase *mDataSource;
+    const bool mIsWide;
+
+    // offset of frame i * kFramesPerEntry
+    Vector<off64_t> mEntries;
+    // # of frames walked from the start of the stream, and where the next one begins
+    int64_t mNumFrames;
+    off64_t mEndOffset;
+    bool mReachedEnd;
+
+    void addFrame_l(size_t frameSize) {
+        if (mNumFrames % kFramesPerEntry == 0) {
+            mEntries.push(mEndOffset);
+        }
+        mEndOffset += frameSize;
+        ++mNumFrames;
+    }
+
+    void scanTo_l(int64_t numFrames) {
+        while (!mReachedEnd && mNumFrames < numFrames) {
+            size_t frameSize;
+            status_t err = getFrameSizeByOffset(mDataSource, mEndOffset, mIsWide, &frameSize);
+            if (err != OK) {
+                if (err != ERROR_END_OF_STREAM) {
+                    ALOGW("stopped indexing at offset %lld: %d", (long long)mEndOffset, err);
+                }
+                mReachedEnd = true;
+                break;
+            }
+            addFrame_l(frameSize);
+        }
+    }
+
+    AMRFrameIndex(const AMRFrameIndex &);
+    AMRFrameIndex &operator=(const AMRFrameIndex &);
+};
+
+// Frames scanned at open; the duration of longer streams is estimated from
+// the average size of these.
+static const int64_t kMaxInitialScanFrames = 3000;
+
 static bool SniffAMR(
         DataSourceBase *source, bool *isWide, float *confidence) {
     char header[9];
@@ -146,8 +253,7 @@ static bool SniffAMR(
 
 AMRExtractor::AMRExtractor(DataSourceBase *source)
     : mDataSource(source),
-      mInitCheck(NO_INIT),
-      mOffsetTableLength(0) {
+      mInitCheck(NO_INIT) {
     float confidence;
     if (!SniffAMR(mDataSource, &mIsWide, &confidence)) {
         return;
@@ -160,32 +266,20 @@ AMRExtractor::AMRExtractor(DataSourceBase *source)
     mMeta.setInt32(kKeyChannelCount, 1);
     mMeta.setInt32(kKeySampleRate, mIsWide ? 16000 : 8000);
 
-    off64_t offset = mIsWide ? 9 : 6;
-    off64_t streamSize;
-    size_t frameSize, numFrames = 0;
-    int64_t duration = 0;
+    mFrameIndex = new AMRFrameIndex(mDataSource, mIsWide);
 
+    off64_t streamSize;
     if (mDataSource->getSize(&streamSize) == OK) {
-         while (offset < streamSize) {
-             status_t status = getFrameSizeByOffset(source, offset, mIsWide, &frameSize);
-             if (status == ERROR_END_OF_STREAM) {
-                 break;
-             } else if (status != OK) {
-                return;
-            }
+        off64_t offset = mFrameIndex->firstFrameOffset();
+        off64_t endOffset;
+        bool reachedEnd;
+        int64_t numFrames = mFrameIndex->scanTo(kMaxInitialScanFrames, &endOffset, &reachedEnd);
 
-            if ((numFrames % 50 == 0) && (numFrames / 50 < OFFSET_TABLE_LEN)) {
-                CHECK_EQ(mOffsetTableLength, numFrames / 50);
-                mOffsetTable[mOffsetTableLength] = offset - (mIsWide ? 9: 6);
-                mOffsetTableLength ++;
-            }
-
-            offset += frameSize;
-            duration += 20000;  // Each frame is 20ms
-            numFrames ++;
+        if (!reachedEnd && endOffset > offset) {
+            numFrames = (streamSize - offset) * numFrames / (endOffset - offset);
         }
 
-        mMeta.setInt64(kKeyDuration, duration);
+        mMeta.setInt64(kKeyDuration, numFrames * 20000);  // Each frame is 20ms
     }
 
     mInitCheck = OK;
@@ -213,8 +307,7 @@ MediaTrack *AMRExtractor::getTrack(size_t index) {
         return NULL;
     }
 
-    return new AMRSource(mDataSource, mMeta, mIsWide,
-            mOffsetTable, mOffsetTableLength);
+    return new AMRSource(mDataSource, mMeta, mIsWide, mFrameIndex);
 }
 
 status_t AMRExtractor::getTrackMetaData(MetaDataBase &meta, size_t index, uint32_t /* flags */) {
@@ -230,18 +323,16 @@ status_t AMRExtractor::getTrackMetaData(MetaDataBase &meta, size_t index, uint32
 
 AMRSource::AMRSource(
         DataSourceBase *source, MetaDataBase &meta,
-        bool isWide, const off64_t *offset_table, size_t offset_table_length)
+        bool isWide, const sp<AMRFrameIndex> &frame_index)
     : mDataSource(source),
       mMeta(meta),
       mIsWide(isWide),
       mOffset(mIsWide ? 9 : 6),
+      mCurrentFrame(0),
       mCurrentTimeUs(0),
       mStarted(false),
       mGroup(NULL),
-      mOffsetTableLength(offset_table_length) {
-    if (mOffsetTableLength > 0 && mOffsetTableLength <= OFFSET_TABLE_LEN) {
-        memcpy ((char*)mOffsetTable, (char*)offset_table, sizeof(off64_t) * mOffsetTableLength);
-    }
+      mFrameIndex(frame_index) {
 }
 
 AMRSource::~AMRSource() {
@@ -253,7 +344,8 @@ AMRSource::~AMRSource() {
 status_t AMRSource::start(MetaDataBase * /* params */) {
     CHECK(!mStarted);
 
-    mOffset = mIsWide ? 9 : 6;
+    mOffset = mFrameIndex->firstFrameOffset();
+    mCurrentFrame = 0;
     mCurrentTimeUs = 0;
     mGroup = new MediaBufferGroup;
     mGroup->add_buffer(MediaBufferBase::Create(128));
@@ -283,26 +375,17 @@ status_t AMRSource::read(
 
     int64_t seekTimeUs;
     ReadOptions::SeekMode mode;
-    if (mOffsetTableLength > 0 && options && options->getSeekTo(&seekTimeUs, &mode)) {
-        size_t size;
-        int64_t seekFrame = seekTimeUs / 20000ll;  // 20ms per frame.
-        mCurrentTimeUs = seekFrame * 20000ll;
-
-        size_t index = seekFrame < 0 ? 0 : seekFrame / 50;
-        if (index >= mOffsetTableLength) {
-            index = mOffsetTableLength - 1;
-        }
+    if (options && options->getSeekTo(&seekTimeUs, &mode)) {
+        int64_t seekFrame = seekTimeUs < 0 ? 0 : seekTimeUs / 20000ll;  // 20ms per frame.
 
-        mOffset = mOffsetTable[index] + (mIsWide ? 9 : 6);
-
-        for (size_t i = 0; i< seekFrame - index * 50; i++) {
-            status_t err;
-            if ((err = getFrameSizeByOffset(mDataSource, mOffset,
-                            mIsWide, &size)) != OK) {
-                return err;
-            }
-            mOffset += size;
+        off64_t seekOffset;
+        status_t err = mFrameIndex->findFrame(seekFrame, &seekOffset);
+        if (err != OK) {
+            return err;
         }
+        mOffset = seekOffset;
+        mCurrentFrame = seekFrame;
+        mCurrentTimeUs = seekFrame * 20000ll;
     }
 
     uint8_t header;
@@ -352,7 +435,10 @@ status_t AMRSource::read(
     buffer->meta_data().setInt64(kKeyTime, mCurrentTimeUs);
     buffer->meta_data().setInt32(kKeyIsSyncFrame, 1);
 
+    mFrameIndex->noteFrame(mCurrentFrame, mOffset, frameSize);
+
     mOffset += frameSize;
+    ++mCurrentFrame;
     mCurrentTimeUs += 20000;  // Each frame is 20ms
 
     *out = buffer;
@@ -21,12 +21,13 @@
 #include <utils/Errors.h>
 #include <media/MediaExtractor.h>
 #include <media/stagefright/MetaDataBase.h>
+#include <utils/RefBase.h>
 
 namespace android {
 
+struct AMRFrameIndex;
 struct AMessage;
 class String8;
-#define OFFSET_TABLE_LEN    300
 
 class AMRExtractor : public MediaExtractor {
 public:
@@ -48,8 +49,7 @@ private:
     status_t mInitCheck;
     bool mIsWide;
 
-    off64_t mOffsetTable[OFFSET_TABLE_LEN]; //5 min
-    size_t mOffsetTableLength;
+    sp<AMRFrameIndex> mFrameIndex;
 
     AMRExtractor(const AMRExtractor &);
     AMRExtractor &operator=(const AMRExtractor &);
@@ -22,6 +22,7 @@
 // libFLAC parser
 #include "FLAC/stream_decoder.h"
 
+#include <cutils/properties.h>
 #include <media/DataSourceBase.h>
 #include <media/MediaTrack.h>
 #include <media/VorbisComment.h>
@@ -32,6 +33,7 @@
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/MediaBufferBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -42,7 +44,8 @@ class FLACSource : public MediaTrack {
 public:
     FLACSource(
             DataSourceBase *dataSource,
-            MetaDataBase &meta);
+            MetaDataBase &meta,
+            bool outputCompressed);
 
     virtual status_t start(MetaDataBase *params);
     virtual status_t stop();
@@ -60,6 +63,7 @@ private:
     FLACParser *mParser;
     bool mInitCheck;
     bool mStarted;
+    bool mOutputCompressed;
 
     // no copy constructor or assignment
     FLACSource(const FLACSource &);
@@ -104,9 +108,11 @@ public:
     FLAC__uint64 getTotalSamples() const {
         return mStreamInfo.total_samples;
     }
+    // upper bound on the size of an encoded frame
+    size_t getMaxFrameSize() const;
 
-    // media buffers
-    void allocateBuffers();
+    // media buffers, holding either decoded PCM or encoded frames
+    void allocateBuffers(bool compressed = false);
     void releaseBuffers();
     MediaBufferBase *readBuffer() {
         return readBuffer(false, 0LL);
@@ -114,6 +120,12 @@ public:
     MediaBufferBase *readBuffer(FLAC__uint64 sample) {
         return readBuffer(true, sample);
     }
+    MediaBufferBase *readFrame() {
+        return readFrame(false, 0LL);
+    }
+    MediaBufferBase *readFrame(FLAC__uint64 sample) {
+        return readFrame(true, sample);
+    }
 
 private:
     DataSourceBase *mDataSource;
@@ -146,8 +158,57 @@ private:
     // most recent error reported by libFLAC parser
     FLAC__StreamDecoderErrorStatus mErrorStatus;
 
+    // the longest possible frame header, sync code to CRC-8 inclusive
+    static const size_t kMaxFrameHeaderSize = 16;
+    // bytes read at a time while looking for the start of a frame
+    static const size_t kFrameProbeSize = 16 * 1024;
+    // a seek walks the frames once it has narrowed the range down to this
+    static const off64_t kMaxBisectSpan = 64 * 1024;
+    static const size_t kMaxFrameIndexSize = 4096;
+
+    // Frames seen so far, from the SEEKTABLE or probed by a seek, sorted by
+    // sample number and at least mFrameIndexInterval samples apart.
+    struct FrameIndexEntry {
+        FLAC__uint64 mSample;
+        off64_t mOffset;
+    };
+    Vector<FrameIndexEntry> mFrameIndex;
+    FLAC__uint64 mFrameIndexInterval;
+    Vector<FrameIndexEntry> mSeekPoints;
+    // offset of the first frame, or -1 if unknown
+    off64_t mFirstFrameOffset;
+
+    // next frame to emit when reading encoded frames
+    off64_t mNextFrameOffset;
+    FLAC__uint64 mNextFrameSample;
+    Vector<uint8_t> mFrameScratch;
+
     status_t init();
     MediaBufferBase *readBuffer(bool doSeek, FLAC__uint64 sample);
+    MediaBufferBase *readFrame(bool doSeek, FLAC__uint64 sample);
+
+    // Parses the frame header at |data|, which must be consistent with
+    // STREAMINFO and start a frame between |minSample| and |maxSample|.
+    bool parseFrameHeader(
+            const uint8_t *data, size_t size,
+            FLAC__uint64 minSample, FLAC__uint64 maxSample,
+            FLAC__uint64 *sample, unsigned *blocksize) const;
+    // Returns the offset in |data| of the first frame header as above, or -1.
+    ssize_t findFrameHeader(
+            const uint8_t *data, size_t size,
+            FLAC__uint64 minSample, FLAC__uint64 maxSample,
+            FLAC__uint64 *sample, unsigned *blocksize) const;
+    // Returns the offset of the first frame header as above starting in
+    // [offset, limit), or -1; a negative |limit| means the end of the source.
+    off64_t findNextFrame(
+            off64_t offset, off64_t limit,
+            FLAC__uint64 minSample, FLAC__uint64 maxSample,
+            FLAC__uint64 *sample, unsigned *blocksize);
+    // Finds the frame holding |sample| without decoding, bisecting between
+    // the known frames around it first.
+    bool findFrameForSample(
+            FLAC__uint64 sample, off64_t *offset, FLAC__uint64 *frameSample);
+    void addFrameIndexEntry(FLAC__uint64 sample, off64_t offset);
 
     // no copy constructor or assignment
     FLACParser(const FLACParser &);
@@ -359,6 +420,22 @@ void FLACParser::metadataCallback(const FLAC__StreamMetadata *metadata)
         }
         }
         break;
+    case FLAC__METADATA_TYPE_SEEKTABLE:
+        {
+        // offsets are relative to the first frame, which is not known yet
+        const FLAC__StreamMetadata_SeekTable *st = &metadata->data.seek_table;
+        for (unsigned i = 0; i < st->num_points; ++i) {
+            const FLAC__StreamMetadata_SeekPoint *point = &st->points[i];
+            if (point->sample_number == FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER) {
+                continue;
+            }
+            FrameIndexEntry entry;
+            entry.mSample = point->sample_number;
+            entry.mOffset = point->stream_offset;
+            mSeekPoints.push(entry);
+        }
+        }
+        break;
     case FLAC__METADATA_TYPE_PICTURE:
         if (mFileMetadata != 0) {
             const FLAC__StreamMetadata_Picture *p = &metadata->data.picture;
@@ -501,7 +578,11 @@ FLACParser::FLACParser(
       mStreamInfoValid(false),
       mWriteRequested(false),
       mWriteCompleted(false),
-      mErrorStatus((FLAC__StreamDecoderErrorStatus) -1)
+      mErrorStatus((FLAC__StreamDecoderErrorStatus) -1),
+      mFrameIndexInterval(0),
+      mFirstFrameOffset(-1),
+      mNextFrameOffset(-1),
+      mNextFrameSample(0)
 {
     ALOGV("FLACParser::FLACParser");
     memset(&mStreamInfo, 0, sizeof(mStreamInfo));
@@ -537,6 +618,8 @@ status_t FLACParser::init()
             mDecoder, FLAC__METADATA_TYPE_PICTURE);
     FLAC__stream_decoder_set_metadata_respond(
             mDecoder, FLAC__METADATA_TYPE_VORBIS_COMMENT);
+    FLAC__stream_decoder_set_metadata_respond(
+            mDecoder, FLAC__METADATA_TYPE_SEEKTABLE);
     FLAC__StreamDecoderInitStatus initStatus;
     initStatus = FLAC__stream_decoder_init_stream(
             mDecoder,
@@ -628,14 +711,42 @@ status_t FLACParser::init()
     if (mFileMetadata != 0) {
         mFileMetadata->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_FLAC);
     }
+    // seed the frame index with the first frame and the SEEKTABLE
+    FLAC__uint64 firstFrameOffset;
+    if (FLAC__stream_decoder_get_decode_position(mDecoder, &firstFrameOffset)) {
+        mFirstFrameOffset = firstFrameOffset;
+        mNextFrameOffset = mFirstFrameOffset;
+        mFrameIndexInterval = getSampleRate();
+        addFrameIndexEntry(0, mFirstFrameOffset);
+        for (size_t i = 0; i < mSeekPoints.size(); ++i) {
+            addFrameIndexEntry(mSeekPoints[i].mSample,
+                    mFirstFrameOffset + mSeekPoints[i].mOffset);
+        }
+    }
+    mSeekPoints.clear();
     return OK;
 }
 
-void FLACParser::allocateBuffers()
+size_t FLACParser::getMaxFrameSize() const
+{
+    if (mStreamInfo.max_framesize != 0) {
+        return mStreamInfo.max_framesize;
+    }
+    // Verbatim subframes, the side channel having one more bit per sample,
+    // plus generous room for the frame and subframe headers and footer.
+    return (getMaxBlockSize() * getChannels() * (getBitsPerSample() + 1) + 7) / 8
+            + kMaxFrameHeaderSize + getChannels() + 2;
+}
+
+void FLACParser::allocateBuffers(bool compressed)
 {
     CHECK(mGroup == NULL);
     mGroup = new MediaBufferGroup;
-    mMaxBufferSize = getMaxBlockSize() * getChannels() * sizeof(short);
+    if (compressed) {
+        mMaxBufferSize = getMaxFrameSize();
+    } else {
+        mMaxBufferSize = getMaxBlockSize() * getChannels() * sizeof(short);
+    }
     mGroup->add_buffer(MediaBufferBase::Create(mMaxBufferSize));
 }
 
@@ -650,7 +761,32 @@ MediaBufferBase *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
 {
     mWriteRequested = true;
     mWriteCompleted = false;
-    if (doSeek) {
+    // samples at the start of the decoded frame that precede the seek target
+    unsigned skip = 0;
+    off64_t frameOffset;
+    FLAC__uint64 frameSample;
+    if (doSeek && findFrameForSample(sample, &frameOffset, &frameSample)) {
+        // Decode from the frame holding the target; libFLAC's own seek would
+        // decode a frame at every step of its bisection.
+        if (!FLAC__stream_decoder_flush(mDecoder)) {
+            ALOGE("FLACParser::readBuffer flush failed");
+            return NULL;
+        }
+        mCurrentPos = frameOffset;
+        mEOF = false;
+        if (!FLAC__stream_decoder_process_single(mDecoder)) {
+            ALOGE("FLACParser::readBuffer process_single after seek failed");
+            return NULL;
+        }
+        if (mWriteCompleted
+                && mWriteHeader.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER
+                && mWriteHeader.number.sample_number <= sample
+                && sample - mWriteHeader.number.sample_number < mWriteHeader.blocksize) {
+            skip = sample - mWriteHeader.number.sample_number;
+        }
+        ALOGV("FLACParser::readBuffer seek to sample %lld at offset %lld",
+                (long long)sample, (long long)frameOffset);
+    } else if (doSeek) {
         // We implement the seek callback, so this works without explicit flush
         if (!FLAC__stream_decoder_seek_absolute(mDecoder, sample)) {
             ALOGE("FLACParser::readBuffer seek to sample %lld failed", (long long)sample);
@@ -688,31 +824,418 @@ MediaBufferBase *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
     if (err != OK) {
         return NULL;
     }
-    size_t bufferSize = blocksize * getChannels() * sizeof(short);
+    size_t bufferSize = (blocksize - skip) * getChannels() * sizeof(short);
     CHECK(bufferSize <= mMaxBufferSize);
     short *data = (short *) buffer->data();
     buffer->set_range(0, bufferSize);
     // copy PCM from FLAC write buffer to our media buffer, with interleaving
-    (*mCopy)(data, mWriteBuffer, blocksize, getChannels());
+    const int *src[kMaxChannels];
+    for (unsigned c = 0; c < getChannels(); ++c) {
+        src[c] = mWriteBuffer[c] + skip;
+    }
+    (*mCopy)(data, src, blocksize - skip, getChannels());
     // fill in buffer metadata
     CHECK(mWriteHeader.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
-    FLAC__uint64 sampleNumber = mWriteHeader.number.sample_number;
+    FLAC__uint64 sampleNumber = mWriteHeader.number.sample_number + skip;
     int64_t timeUs = (1000000LL * sampleNumber) / getSampleRate();
     buffer->meta_data().setInt64(kKeyTime, timeUs);
     buffer->meta_data().setInt32(kKeyIsSyncFrame, 1);
     return buffer;
 }
 
+MediaBufferBase *FLACParser::readFrame(bool doSeek, FLAC__uint64 sample)
+{
+    if (doSeek) {
+        if (sample >= getTotalSamples() && getTotalSamples() != 0) {
+            ALOGV("FLACParser::readFrame seek to end of stream");
+            return NULL;
+        }
+        if (!findFrameForSample(sample, &mNextFrameOffset, &mNextFrameSample)) {
+            ALOGE("FLACParser::readFrame seek to sample %lld failed", (long long)sample);
+            return NULL;
+        }
+    }
+    if (mNextFrameOffset < 0) {
+        return NULL;
+    }
+    // Read as much as the largest frame plus the header of the next one, so
+    // that the end of the frame can be found without reading it twice.
+    size_t readSize = mMaxBufferSize + kMaxFrameHeaderSize;
+    if (mFrameScratch.size() < readSize) {
+        mFrameScratch.resize(readSize);
+    }
+    uint8_t *scratch = mFrameScratch.editArray();
+    ssize_t n = mDataSource->readAt(mNextFrameOffset, scratch, readSize);
+    FLAC__uint64 frameSample;
+    unsigned blocksize;
+    if (n < (ssize_t)kMaxFrameHeaderSize && n > 0) {
+        // the last frame may be shorter than the longest header
+        memset(scratch + n, 0, kMaxFrameHeaderSize - n);
+    }
+    if (n <= 0 || !parseFrameHeader(scratch, kMaxFrameHeaderSize,
+            mNextFrameSample, mNextFrameSample, &frameSample, &blocksize)) {
+        ALOGV("FLACParser::readFrame no frame at offset %lld", (long long)mNextFrameOffset);
+        return NULL;
+    }
+    // the frame ends where a header for the following samples starts
+    FLAC__uint64 nextSample = frameSample + blocksize;
+    FLAC__uint64 unused;
+    unsigned unusedBlocksize;
+    ssize_t frameSize = findFrameHeader(scratch + 1, n - 1,
+            nextSample, nextSample, &unused, &unusedBlocksize);
+    if (frameSize >= 0) {
+        frameSize += 1;
+    } else if (n < (ssize_t)readSize) {
+        // end of stream
+        frameSize = n;
+    } else {
+        ALOGE("FLACParser::readFrame frame at offset %lld is too large",
+                (long long)mNextFrameOffset);
+        return NULL;
+    }
+    if ((size_t)frameSize > mMaxBufferSize) {
+        ALOGE("FLACParser::readFrame frame size %zd exceeds %zu", frameSize, mMaxBufferSize);
+        return NULL;
+    }
+    CHECK(mGroup != NULL);
+    MediaBufferBase *buffer;
+    status_t err = mGroup->acquire_buffer(&buffer);
+    if (err != OK) {
+        return NULL;
+    }
+    memcpy(buffer->data(), scratch, frameSize);
+    buffer->set_range(0, frameSize);
+    int64_t timeUs = (1000000LL * frameSample) / getSampleRate();
+    buffer->meta_data().setInt64(kKeyTime, timeUs);
+    buffer->meta_data().setInt32(kKeyIsSyncFrame, 1);
+    mNextFrameOffset += frameSize;
+    mNextFrameSample = nextSample;
+    return buffer;
+}
+
+// CRC-8 with polynomial x^8 + x^2 + x + 1, as protects FLAC frame headers
+static uint8_t crc8(const uint8_t *data, size_t size) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+bool FLACParser::parseFrameHeader(
+        const uint8_t *data, size_t size,
+        FLAC__uint64 minSample, FLAC__uint64 maxSample,
+        FLAC__uint64 *sample, unsigned *blocksize) const
+{
+    // sync code, reserved bit and blocking strategy
+    if (size < 5 || data[0] != 0xff || (data[1] & 0xfe) != 0xf8) {
+        return false;
+    }
+    bool variableBlocksize = data[1] & 1;
+    unsigned blocksizeCode = data[2] >> 4;
+    unsigned sampleRateCode = data[2] & 0x0f;
+    unsigned channelCode = data[3] >> 4;
+    unsigned sampleSizeCode = (data[3] >> 1) & 7;
+    if (blocksizeCode == 0 || sampleRateCode == 0x0f || (data[3] & 1)) {
+        return false;
+    }
+
+    // channels and bit depth, unless reserved, must agree with STREAMINFO
+    unsigned channels = channelCode < 8 ? channelCode + 1 : (channelCode < 11 ? 2 : 0);
+    static const unsigned kSampleSizes[8] = { 0, 8, 12, 0, 16, 20, 24, 0 };
+    if (channels != getChannels()
+            || (sampleSizeCode != 0 && kSampleSizes[sampleSizeCode] != getBitsPerSample())) {
+        return false;
+    }
+
+    // UTF-8 like coded frame or sample number
+    size_t pos = 4;
+    FLAC__uint64 number = data[pos++];
+    unsigned extraBytes = 0;
+    if (number >= 0x80) {
+        if (number < 0xc0 || number == 0xff) {
+            return false;
+        }
+        while (number & (0x40 >> extraBytes)) {
+            ++extraBytes;
+        }
+        number &= 0x3f >> extraBytes;
+    }
+    if (pos + extraBytes > size) {
+        return false;
+    }
+    for (unsigned i = 0; i < extraBytes; ++i) {
+        if ((data[pos] & 0xc0) != 0x80) {
+            return false;
+        }
+        number = (number << 6) | (data[pos++] & 0x3f);
+    }
+
+    // block size
+    unsigned frameBlocksize;
+    if (blocksizeCode == 1) {
+        frameBlocksize = 192;
+    } else if (blocksizeCode <= 5) {
+        frameBlocksize = 576 << (blocksizeCode - 2);
+    } else if (blocksizeCode == 6) {
+        if (pos + 1 > size) {
+            return false;
+        }
+        frameBlocksize = data[pos++] + 1;
+    } else if (blocksizeCode == 7) {
+        if (pos + 2 > size) {
+            return false;
+        }
+        frameBlocksize = ((data[pos] << 8) | data[pos + 1]) + 1;
+        pos += 2;
+    } else {
+        frameBlocksize = 256 << (blocksizeCode - 8);
+    }
+    if (frameBlocksize > getMaxBlockSize()) {
+        return false;
+    }
+
+    // sample rate
+    static const unsigned kSampleRates[12] = {
+        0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000 };
+    unsigned sampleRate;
+    if (sampleRateCode < 12) {
+        sampleRate = kSampleRates[sampleRateCode];
+    } else {
+        unsigned length = sampleRateCode == 12 ? 1 : 2;
+        if (pos + length > size) {
+            return false;
+        }
+        sampleRate = length == 1 ? data[pos] * 1000 : (data[pos] << 8) | data[pos + 1];
+        if (sampleRateCode == 14) {
+            sampleRate *= 10;
+        }
+        pos += length;
+    }
+    if (sampleRate != 0 && sampleRate != getSampleRate()) {
+        return false;
+    }
+
+    if (pos + 1 > size || crc8(data, pos) != data[pos]) {
+        return false;
+    }
+
+    if (!variableBlocksize) {
+        // fixed-blocksize streams number their frames instead
+        number *= mStreamInfo.min_blocksize;
+    }
+    if (number < minSample || number > maxSample
+            || (getTotalSamples() != 0 && number >= getTotalSamples())) {
+        return false;
+    }
+    *sample = number;
+    *blocksize = frameBlocksize;
+    return true;
+}
+
+ssize_t FLACParser::findFrameHeader(
+        const uint8_t *data, size_t size,
+        FLAC__uint64 minSample, FLAC__uint64 maxSample,
+        FLAC__uint64 *sample, unsigned *blocksize) const
+{
+    const uint8_t *ptr = data;
+    const uint8_t *end = data + size;
+    while (end - ptr >= 2) {
+        ptr = (const uint8_t *)memchr(ptr, 0xff, end - ptr - 1);
+        if (ptr == NULL) {
+            break;
+        }
+        if ((ptr[1] & 0xfe) == 0xf8
+                && parseFrameHeader(ptr, end - ptr, minSample, maxSample, sample, blocksize)) {
+            return ptr - data;
+        }
+        ++ptr;
+    }
+    return -1;
+}
+
+off64_t FLACParser::findNextFrame(
+        off64_t offset, off64_t limit,
+        FLAC__uint64 minSample, FLAC__uint64 maxSample,
+        FLAC__uint64 *sample, unsigned *blocksize)
+{
+    uint8_t buffer[kFrameProbeSize];
+    while (limit < 0 || offset < limit) {
+        ssize_t n = mDataSource->readAt(offset, buffer, sizeof(buffer));
+        if (n < 2) {
+            break;
+        }
+        // a header cut off at the end of the block is found in the next one
+        size_t searchSize = n;
+        if (n == (ssize_t)sizeof(buffer)) {
+            searchSize -= kMaxFrameHeaderSize - 1;
+        }
+        if (limit >= 0 && (off64_t)searchSize > limit - offset) {
+            searchSize = limit - offset;
+        }
+        ssize_t found = findFrameHeader(
+                buffer, n, minSample, maxSample, sample, blocksize);
+        if (found >= 0 && (size_t)found < searchSize) {
+            return offset + found;
+        }
+        if (n < (ssize_t)sizeof(buffer)) {
+            break;
+        }
+        offset += searchSize;
+    }
+    return -1;
+}
+
+bool FLACParser::findFrameForSample(
+        FLAC__uint64 sample, off64_t *offset, FLAC__uint64 *frameSample)
+{
+    if (mFrameIndex.isEmpty()
+            || (getTotalSamples() != 0 && sample >= getTotalSamples())) {
+        return false;
+    }
+
+    // Narrow the range to bisect down to the known frames around the target.
+    size_t left = 0;
+    size_t right_plus_one = mFrameIndex.size();
+    while (left < right_plus_one) {
+        size_t center = left + (right_plus_one - left) / 2;
+        if (mFrameIndex.itemAt(center).mSample <= sample) {
+            left = center + 1;
+        } else {
+            right_plus_one = center;
+        }
+    }
+    // the first frame is always indexed, at sample 0
+    FrameIndexEntry lo = mFrameIndex.itemAt(left - 1);
+    off64_t hi;
+    FLAC__uint64 hiSample;
+    if (left < mFrameIndex.size()) {
+        hi = mFrameIndex.itemAt(left).mOffset;
+        hiSample = mFrameIndex.itemAt(left).mSample;
+    } else if (mDataSource->getSize(&hi) == OK && getTotalSamples() != 0) {
+        hiSample = getTotalSamples();
+    } else {
+        // without an end to bisect to, leave it to libFLAC
+        return false;
+    }
+
+    // The target frame starts at or after |lo| and before |hi|. Probe where
+    // the target would be at a constant bitrate, but no closer to the ends
+    // than a sixteenth of the range, so that each probe narrows it down.
+    unsigned blocksize;
+    while (hi - lo.mOffset > kMaxBisectSpan && hiSample > lo.mSample) {
+        off64_t span = hi - lo.mOffset;
+        off64_t mid = lo.mOffset + (off64_t)((double)span
+                * (sample - lo.mSample) / (hiSample - lo.mSample));
+        if (mid < lo.mOffset + span / 16) {
+            mid = lo.mOffset + span / 16;
+        } else if (mid > hi - span / 16) {
+            mid = hi - span / 16;
+        }
+        FLAC__uint64 probeSample;
+        off64_t probe = findNextFrame(
+                mid, hi, lo.mSample + 1, hiSample - 1, &probeSample, &blocksize);
+        if (probe < 0) {
+            hi = mid;
+            continue;
+        }
+        addFrameIndexEntry(probeSample, probe);
+        if (probeSample <= sample) {
+            lo.mSample = probeSample;
+            lo.mOffset = probe;
+        } else {
+            hi = probe;
+            hiSample = probeSample;
+        }
+    }
+
+    // Few frames are left, walk them. Each must be followed by the frame for
+    // the samples after it, which rules out sync codes in the audio data.
+    FLAC__uint64 frameStart;
+    uint8_t header[kMaxFrameHeaderSize];
+    ssize_t n = mDataSource->readAt(lo.mOffset, header, sizeof(header));
+    if (n <= 0) {
+        return false;
+    }
+    memset(header + n, 0, sizeof(header) - n);
+    if (!parseFrameHeader(header, sizeof(header), lo.mSample, lo.mSample,
+            &frameStart, &blocksize)) {
+        ALOGW("no frame at offset %lld", (long long)lo.mOffset);
+        return false;
+    }
+    while (lo.mSample + blocksize <= sample) {
+        FLAC__uint64 nextSample = lo.mSample + blocksize;
+        off64_t next = findNextFrame(
+                lo.mOffset + 1, -1, nextSample, nextSample, &frameStart, &blocksize);
+        if (next < 0) {
+            // past the last frame: settle for it
+            break;
+        }
+        lo.mSample = nextSample;
+        lo.mOffset = next;
+    }
+    addFrameIndexEntry(lo.mSample, lo.mOffset);
+
+    *offset = lo.mOffset;
+    *frameSample = lo.mSample;
+    return true;
+}
+
+void FLACParser::addFrameIndexEntry(FLAC__uint64 sample, off64_t offset)
+{
+    size_t left = 0;
+    size_t right_plus_one = mFrameIndex.size();
+    while (left < right_plus_one) {
+        size_t center = left + (right_plus_one - left) / 2;
+        if (mFrameIndex.itemAt(center).mSample < sample) {
+            left = center + 1;
+        } else {
+            right_plus_one = center;
+        }
+    }
+    // keep the entries spread out, and ignore frames that contradict them
+    if (left > 0 && (sample < mFrameIndex.itemAt(left - 1).mSample + mFrameIndexInterval
+            || offset <= mFrameIndex.itemAt(left - 1).mOffset)) {
+        return;
+    }
+    if (left < mFrameIndex.size()
+            && (sample + mFrameIndexInterval > mFrameIndex.itemAt(left).mSample
+            || offset >= mFrameIndex.itemAt(left).mOffset)) {
+        return;
+    }
+    FrameIndexEntry entry;
+    entry.mSample = sample;
+    entry.mOffset = offset;
+    mFrameIndex.insertAt(entry, left);
+
+    // Limit the memory spent on the index by dropping every other entry,
+    // but never the first frame, and spacing new ones twice as far apart.
+    if (mFrameIndex.size() > kMaxFrameIndexSize) {
+        for (size_t i = mFrameIndex.size() - 1; i > 0; i -= 2) {
+            mFrameIndex.removeAt(i);
+            if (i < 2) {
+                break;
+            }
+        }
+        mFrameIndexInterval *= 2;
+    }
+}
+
 // FLACsource
 
 FLACSource::FLACSource(
         DataSourceBase *dataSource,
-        MetaDataBase &trackMetadata)
+        MetaDataBase &trackMetadata,
+        bool outputCompressed)
     : mDataSource(dataSource),
       mTrackMetadata(trackMetadata),
       mParser(0),
       mInitCheck(false),
-      mStarted(false)
+      mStarted(false),
+      mOutputCompressed(outputCompressed)
 {
     ALOGV("FLACSource::FLACSource");
     // re-use the same track metadata passed into constructor from FLACExtractor
@@ -734,7 +1257,7 @@ status_t FLACSource::start(MetaDataBase * /* params */)
     ALOGV("FLACSource::start");
 
     CHECK(!mStarted);
-    mParser->allocateBuffers();
+    mParser->allocateBuffers(mOutputCompressed);
     mStarted = true;
 
     return OK;
@@ -775,10 +1298,10 @@ status_t FLACSource::read(
                 sample = mParser->getTotalSamples();
             }
         }
-        buffer = mParser->readBuffer(sample);
+        buffer = mOutputCompressed ? mParser->readFrame(sample) : mParser->readBuffer(sample);
     // otherwise read sequentially
     } else {
-        buffer = mParser->readBuffer();
+        buffer = mOutputCompressed ? mParser->readFrame() : mParser->readBuffer();
     }
     *outBuffer = buffer;
     return buffer != NULL ? (status_t) OK : (status_t) ERROR_END_OF_STREAM;
@@ -790,12 +1313,29 @@ FLACExtractor::FLACExtractor(
         DataSourceBase *dataSource)
     : mDataSource(dataSource),
       mParser(nullptr),
-      mInitCheck(false)
+      mInitCheck(false),
+      mOutputCompressed(false)
 {
     ALOGV("FLACExtractor::FLACExtractor");
     // FLACParser will fill in the metadata for us
     mParser = new FLACParser(mDataSource, &mFileMetadata, &mTrackMetadata);
     mInitCheck = mParser->initCheck();
+
+    // Optionally leave decoding to a FLAC decoder, which runs at the codec's
+    // priority and may be offloaded, rather than in the extractor.
+    if (mInitCheck == OK && property_get_bool("media.stagefright.flac.compressed", false)) {
+        // The decoder wants the stream marker and the STREAMINFO block, which
+        // always comes first, flagged as the last metadata block.
+        uint8_t header[4 + 4 + 34];
+        if (mDataSource->readAt(0, header, sizeof(header)) == (ssize_t)sizeof(header)) {
+            header[4] |= 0x80;
+            mTrackMetadata.setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_FLAC);
+            mTrackMetadata.remove(kKeyPcmEncoding);
+            mTrackMetadata.setData(kKeyFlacMetadata, 0, header, sizeof(header));
+            mTrackMetadata.setInt32(kKeyMaxInputSize, mParser->getMaxFrameSize());
+            mOutputCompressed = true;
+        }
+    }
 }
 
 FLACExtractor::~FLACExtractor()
@@ -814,7 +1354,7 @@ MediaTrack *FLACExtractor::getTrack(size_t index)
     if (mInitCheck != OK || index > 0) {
         return NULL;
     }
-    return new FLACSource(mDataSource, mTrackMetadata);
+    return new FLACSource(mDataSource, mTrackMetadata, mOutputCompressed);
 }
 
 status_t FLACExtractor::getTrackMetaData(
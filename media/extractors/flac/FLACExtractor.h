@@ -49,6 +49,8 @@ private:
 
     // There is only one track
     MetaDataBase mTrackMetadata;
+    // whether the track carries encoded frames rather than PCM
+    bool mOutputCompressed;
 
     FLACExtractor(const FLACExtractor &);
     FLACExtractor &operator=(const FLACExtractor &);
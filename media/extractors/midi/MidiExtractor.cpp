@@ -20,6 +20,7 @@
 
 #include "MidiExtractor.h"
 
+#include <cutils/properties.h>
 #include <media/MidiIoWrapper.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -27,11 +28,29 @@
 #include <media/stagefright/MetaData.h>
 #include <media/MediaTrack.h>
 #include <libsonivox/eas_reverb.h>
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
 
 namespace android {
 
-// how many Sonivox output buffers to aggregate into one MediaBufferBase
+// minimum number of Sonivox output buffers to aggregate into one MediaBufferBase
 static const int NUM_COMBINE_BUFFERS = 4;
+// upper bound of the render-ahead, in Sonivox output buffers
+static const int MAX_COMBINE_BUFFERS = 256;
+// output buffers in flight, so that rendering can go on while one is consumed
+static const int NUM_OUTPUT_BUFFERS = 2;
+
+static inline int32_t getRenderAheadMsSetting() {
+    return property_get_int32("media.stagefright.midi.render_ms", 100 /* default_value */);
+}
+
+// Ringtones and notifications open many short files in a row. Synth
+// instances are kept after their file is closed and reused by the next
+// engine instead of going through EAS_Init() again, which includes the
+// engine created only to sniff the file.
+static const size_t kMaxIdleEasData = 2;
+static Mutex sIdleEasDataLock;
+static Vector<EAS_DATA_HANDLE> sIdleEasData;
 
 class MidiSource : public MediaTrack {
 
@@ -149,11 +168,12 @@ MidiEngine::MidiEngine(DataSourceBase *dataSource,
             mEasData(NULL),
             mEasHandle(NULL),
             mEasConfig(NULL),
-            mIsInitialized(false) {
+            mIsInitialized(false),
+            mMixBuffersPerRead(NUM_COMBINE_BUFFERS) {
     mIoWrapper = new MidiIoWrapper(dataSource);
-    // spin up a new EAS engine
+    // spin up an EAS engine
     EAS_I32 temp;
-    EAS_RESULT result = EAS_Init(&mEasData);
+    EAS_RESULT result = acquireEasData(&mEasData);
 
     if (result == EAS_SUCCESS) {
         result = EAS_OpenFile(mEasData, mIoWrapper->getLocator(), &mEasHandle);
@@ -185,16 +205,46 @@ MidiEngine::MidiEngine(DataSourceBase *dataSource,
 }
 
 MidiEngine::~MidiEngine() {
+    bool reusable = true;
     if (mEasHandle) {
-        EAS_CloseFile(mEasData, mEasHandle);
+        reusable = EAS_CloseFile(mEasData, mEasHandle) == EAS_SUCCESS;
     }
     if (mEasData) {
-        EAS_Shutdown(mEasData);
+        if (reusable) {
+            recycleEasData(mEasData);
+        } else {
+            EAS_Shutdown(mEasData);
+        }
     }
     delete mGroup;
     delete mIoWrapper;
 }
 
+// static
+EAS_RESULT MidiEngine::acquireEasData(EAS_DATA_HANDLE *easData) {
+    {
+        Mutex::Autolock autoLock(sIdleEasDataLock);
+        if (!sIdleEasData.empty()) {
+            *easData = sIdleEasData.top();
+            sIdleEasData.pop();
+            return EAS_SUCCESS;
+        }
+    }
+    return EAS_Init(easData);
+}
+
+// static
+void MidiEngine::recycleEasData(EAS_DATA_HANDLE easData) {
+    {
+        Mutex::Autolock autoLock(sIdleEasDataLock);
+        if (sIdleEasData.size() < kMaxIdleEasData) {
+            sIdleEasData.push(easData);
+            return;
+        }
+    }
+    EAS_Shutdown(easData);
+}
+
 status_t MidiEngine::initCheck() {
     return mIsInitialized ? OK : UNKNOWN_ERROR;
 }
@@ -204,11 +254,25 @@ status_t MidiEngine::allocateBuffers() {
     EAS_SetParameter(mEasData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_PRESET, EAS_PARAM_REVERB_CHAMBER);
     EAS_SetParameter(mEasData, EAS_MODULE_REVERB, EAS_PARAM_REVERB_BYPASS, EAS_FALSE);
 
+    // Render ahead in large blocks so that playback needs fewer reads and
+    // wakeups. EAS renders 16-bit PCM, which the mixer takes as is.
+    int64_t framesAhead =
+            (int64_t)getRenderAheadMsSetting() * mEasConfig->sampleRate / 1000;
+    mMixBuffersPerRead = (int)((framesAhead + mEasConfig->mixBufferSize - 1)
+            / mEasConfig->mixBufferSize);
+    if (mMixBuffersPerRead < NUM_COMBINE_BUFFERS) {
+        mMixBuffersPerRead = NUM_COMBINE_BUFFERS;
+    } else if (mMixBuffersPerRead > MAX_COMBINE_BUFFERS) {
+        mMixBuffersPerRead = MAX_COMBINE_BUFFERS;
+    }
+
     mGroup = new MediaBufferGroup;
     int bufsize = sizeof(EAS_PCM)
-            * mEasConfig->mixBufferSize * mEasConfig->numChannels * NUM_COMBINE_BUFFERS;
-    ALOGV("using %d byte buffer", bufsize);
-    mGroup->add_buffer(MediaBufferBase::Create(bufsize));
+            * mEasConfig->mixBufferSize * mEasConfig->numChannels * mMixBuffersPerRead;
+    ALOGV("using %d x %d byte buffers", NUM_OUTPUT_BUFFERS, bufsize);
+    for (int i = 0; i < NUM_OUTPUT_BUFFERS; i++) {
+        mGroup->add_buffer(MediaBufferBase::Create(bufsize));
+    }
     return OK;
 }
 
@@ -243,7 +307,7 @@ MediaBufferBase* MidiEngine::readBuffer() {
 
     EAS_PCM* p = (EAS_PCM*) buffer->data();
     int numBytesOutput = 0;
-    for (int i = 0; i < NUM_COMBINE_BUFFERS; i++) {
+    for (int i = 0; i < mMixBuffersPerRead; i++) {
         EAS_I32 numRendered;
         EAS_RESULT result = EAS_Render(mEasData, p, mEasConfig->mixBufferSize, &numRendered);
         if (result != EAS_SUCCESS) {
@@ -253,6 +317,12 @@ MediaBufferBase* MidiEngine::readBuffer() {
         }
         p += numRendered * mEasConfig->numChannels;
         numBytesOutput += numRendered * mEasConfig->numChannels * sizeof(EAS_PCM);
+
+        // don't render the silence that follows the end of the file
+        EAS_State(mEasData, mEasHandle, &state);
+        if ((state == EAS_STATE_STOPPED) || (state == EAS_STATE_ERROR)) {
+            break;
+        }
     }
     buffer->set_range(0, numBytesOutput);
     ALOGV("readBuffer: returning %zd in buffer %p", buffer->range_length(), buffer);
@@ -48,6 +48,11 @@ private:
     EAS_HANDLE mEasHandle;
     const S_EAS_LIB_CONFIG* mEasConfig;
     bool mIsInitialized;
+    // number of Sonivox mix buffers rendered into each output buffer
+    int mMixBuffersPerRead;
+
+    static EAS_RESULT acquireEasData(EAS_DATA_HANDLE *easData);
+    static void recycleEasData(EAS_DATA_HANDLE easData);
 };
 
 class MidiExtractor : public MediaExtractor {
@@ -119,6 +119,9 @@ private:
     long mBlockEntryIndex;
 
     void advance_l();
+    void seekWithClusterIndex_l(
+            int64_t seekTimeUs, int64_t seekTimeNs, bool isVideo,
+            int64_t *actualFrameTimeUs);
 
     BlockIterator(const BlockIterator &);
     BlockIterator &operator=(const BlockIterator &);
@@ -158,6 +161,9 @@ private:
     status_t advance();
 
     status_t setWebmBlockCryptoInfo(MediaBufferBase *mbuf);
+    status_t convertNALFrame(
+            const uint8_t *srcPtr, size_t srcSize,
+            MediaBufferBase *frame, MediaBufferBase **out);
     status_t readBlock();
     void clearPendingFrames();
 
@@ -357,6 +363,7 @@ void BlockIterator::advance_l() {
             CHECK(!nextCluster->EOS());
 
             mCluster = nextCluster;
+            mExtractor->addClusterToIndex_l(mCluster);
 
             res = mCluster->Parse(pos, len);
             ALOGV("Parse (2) returned %ld", res);
@@ -390,6 +397,7 @@ void BlockIterator::reset() {
     mCluster = mExtractor->mSegment->GetFirst();
     mBlockEntry = NULL;
     mBlockEntryIndex = 0;
+    mExtractor->addClusterToIndex_l(mCluster);
 
     do {
         advance_l();
@@ -452,12 +460,18 @@ void BlockIterator::seek(
         }
 
         if (!pCues) {
-            ALOGE("No Cues in file");
+            ALOGV("No Cues in file, seeking through cluster index");
+            seekWithClusterIndex_l(seekTimeUs, seekTimeNs,
+                    pSegment->GetTracks()->GetTrackByNumber(mTrackNum)->GetType() == 1,
+                    actualFrameTimeUs);
             return;
         }
     }
     else if (!pSH) {
-        ALOGE("No SeekHead");
+        ALOGV("No SeekHead, seeking through cluster index");
+        seekWithClusterIndex_l(seekTimeUs, seekTimeNs,
+                pSegment->GetTracks()->GetTrackByNumber(mTrackNum)->GetType() == 1,
+                actualFrameTimeUs);
         return;
     }
 
@@ -511,6 +525,7 @@ void BlockIterator::seek(
 
     CHECK(mCluster);
     CHECK(!mCluster->EOS());
+    mExtractor->addClusterToIndex_l(mCluster);
 
     // mBlockEntryIndex starts at 0 but m_block starts at 1
     CHECK_GT(pTP->m_block, 0);
@@ -534,6 +549,94 @@ void BlockIterator::seek(
     }
 }
 
+void BlockIterator::seekWithClusterIndex_l(
+        int64_t seekTimeUs, int64_t seekTimeNs, bool isVideo,
+        int64_t *actualFrameTimeUs) {
+    // Video lands on the last key frame at or before the seek time. If the
+    // cluster found through the index has none before that time, look in
+    // up to this many preceding clusters before settling for the first key
+    // frame after it.
+    static const size_t kMaxClusterBacktrack = 16;
+
+    ssize_t index = mExtractor->extendClusterIndex_l(seekTimeNs);
+    if (index < 0) {
+        ALOGE("Did not locate a cluster for seeking");
+        return;
+    }
+
+    size_t backtrack = 0;
+    for (;;) {
+        const mkvparser::Cluster *start = mExtractor->mClusterIndex.itemAt(index);
+
+        const mkvparser::Cluster *keyCluster = NULL;
+        long keyEntryIndex = 0;
+        int64_t keyTimeUs = -1ll;
+
+        mCluster = start;
+        mBlockEntry = NULL;
+        mBlockEntryIndex = 0;
+        for (;;) {
+            advance_l();
+
+            if (eos()) break;
+
+            const mkvparser::Block *b = block();
+            int64_t frameTimeUs = (b->GetTime(mCluster) + 500LL) / 1000LL;
+            if (!isVideo) {
+                // Same as with Cues: first frame at or after the seek time.
+                if (frameTimeUs >= seekTimeUs) {
+                    *actualFrameTimeUs = frameTimeUs;
+                    return;
+                }
+                continue;
+            }
+
+            if (b->GetTime(mCluster) > seekTimeNs && keyCluster != NULL) {
+                break;
+            }
+            if (b->IsKey()) {
+                if (b->GetTime(mCluster) > seekTimeNs) {
+                    // No key frame before the seek time in these clusters.
+                    break;
+                }
+                keyCluster = mCluster;
+                keyEntryIndex = mBlockEntryIndex - 1;
+                keyTimeUs = frameTimeUs;
+            }
+        }
+
+        if (keyCluster != NULL) {
+            mCluster = keyCluster;
+            mBlockEntryIndex = keyEntryIndex;
+            advance_l();
+            *actualFrameTimeUs = keyTimeUs;
+            ALOGV("Requested seek point: %" PRId64 " actual: %" PRId64,
+                  seekTimeUs, *actualFrameTimeUs);
+            return;
+        }
+
+        if (!isVideo || index == 0 || backtrack++ == kMaxClusterBacktrack) {
+            break;
+        }
+        --index;
+    }
+
+    // Accept the first key frame after where the search started.
+    mCluster = mExtractor->mClusterIndex.itemAt(index);
+    mBlockEntry = NULL;
+    mBlockEntryIndex = 0;
+    for (;;) {
+        advance_l();
+
+        if (eos()) break;
+
+        if (!isVideo || block()->IsKey()) {
+            *actualFrameTimeUs = (block()->GetTime(mCluster) + 500LL) / 1000LL;
+            break;
+        }
+    }
+}
+
 const mkvparser::Block *BlockIterator::block() const {
     CHECK(!eos());
 
@@ -721,6 +824,7 @@ status_t MatroskaSource::readBlock() {
     const mkvparser::Block *block = mBlockIter.block();
 
     int64_t timeUs = mBlockIter.blockTimeUs();
+    bool convertNALs = (mType == AVC || mType == HEVC) && mNALSizeLen != 0;
 
     for (int i = 0; i < block->GetFrameCount(); ++i) {
         MatroskaExtractor::TrackInfo *trackInfo = &mExtractor->mTracks.editItemAt(mTrackIndex);
@@ -730,6 +834,30 @@ status_t MatroskaSource::readBlock() {
             return ERROR_MALFORMED;
         }
 
+        if (convertNALs && trackInfo->mHeaderLen == 0
+                && !(mExtractor->mIsWebm && trackInfo->mEncrypted)) {
+            // Fast path for sources that keep the file in memory: convert the
+            // NAL fragments straight from the source into the output buffer
+            // instead of reading the frame into an intermediate buffer first.
+            const uint8_t *src;
+            if (frame.len > 0 && mExtractor->mDataSource->borrowAt(
+                    frame.pos, &src, len) == (ssize_t)len) {
+                MediaBufferBase *mbuf;
+                status_t err = convertNALFrame(src, len, NULL, &mbuf);
+                if (err != OK) {
+                    clearPendingFrames();
+
+                    mBlockIter.advance();
+                    return err;
+                }
+
+                mbuf->meta_data().setInt64(kKeyTime, timeUs);
+                mbuf->meta_data().setInt32(kKeyIsSyncFrame, block->IsKey());
+                mPendingFrames.push_back(mbuf);
+                continue;
+            }
+        }
+
         len += trackInfo->mHeaderLen;
         MediaBufferBase *mbuf = MediaBufferBase::Create(len);
         uint8_t *data = static_cast<uint8_t *>(mbuf->data());
@@ -747,8 +875,21 @@ status_t MatroskaSource::readBlock() {
             err = setWebmBlockCryptoInfo(mbuf);
         }
 
+        if (err == OK && convertNALs) {
+            MediaBufferBase *converted;
+            err = convertNALFrame(
+                    (const uint8_t *)mbuf->data() + mbuf->range_offset(),
+                    mbuf->range_length(), mbuf, &converted);
+            if (err == OK && converted != mbuf) {
+                converted->meta_data().setInt64(kKeyTime, timeUs);
+                converted->meta_data().setInt32(kKeyIsSyncFrame, block->IsKey());
+                mbuf->release();
+                mbuf = converted;
+            }
+        }
+
         if (err != OK) {
-            mPendingFrames.clear();
+            clearPendingFrames();
 
             mBlockIter.advance();
             mbuf->release();
@@ -803,30 +944,29 @@ status_t MatroskaSource::read(
     MediaBufferBase *frame = *mPendingFrames.begin();
     mPendingFrames.erase(mPendingFrames.begin());
 
-    if ((mType != AVC && mType != HEVC) || mNALSizeLen == 0) {
-        if (targetSampleTimeUs >= 0ll) {
-            frame->meta_data().setInt64(
-                    kKeyTargetTime, targetSampleTimeUs);
-        }
-
-        *out = frame;
-
-        return OK;
+    if (targetSampleTimeUs >= 0ll) {
+        frame->meta_data().setInt64(
+                kKeyTargetTime, targetSampleTimeUs);
     }
 
-    // Each input frame contains one or more NAL fragments, each fragment
-    // is prefixed by mNALSizeLen bytes giving the fragment length,
-    // followed by a corresponding number of bytes containing the fragment.
-    // We output all these fragments into a single large buffer separated
-    // by startcodes (0x00 0x00 0x00 0x01).
-    //
-    // When mNALSizeLen is 0, we assume the data is already in the format
-    // desired.
+    *out = frame;
 
-    const uint8_t *srcPtr =
-        (const uint8_t *)frame->data() + frame->range_offset();
+    return OK;
+}
 
-    size_t srcSize = frame->range_length();
+// Each input frame contains one or more NAL fragments, each fragment
+// is prefixed by mNALSizeLen bytes giving the fragment length,
+// followed by a corresponding number of bytes containing the fragment.
+// We output all these fragments into a single large buffer separated
+// by startcodes (0x00 0x00 0x00 0x01).
+//
+// |frame| is the buffer holding |srcPtr| if any; it is reused as the output
+// when the conversion can be done in place. Otherwise a new buffer is
+// returned and |frame| is left to the caller.
+status_t MatroskaSource::convertNALFrame(
+        const uint8_t *srcPtr, size_t srcSize,
+        MediaBufferBase *frame, MediaBufferBase **out) {
+    *out = NULL;
 
     size_t dstSize = 0;
     MediaBufferBase *buffer = NULL;
@@ -847,9 +987,9 @@ status_t MatroskaSource::read(
             }
 
             if (srcOffset + mNALSizeLen + NALsize <= srcOffset + mNALSizeLen) {
-                frame->release();
-                frame = NULL;
-
+                if (buffer != NULL && buffer != frame) {
+                    buffer->release();
+                }
                 return ERROR_MALFORMED;
             } else if (srcOffset + mNALSizeLen + NALsize > srcSize) {
                 break;
@@ -874,17 +1014,16 @@ status_t MatroskaSource::read(
         if (srcOffset < srcSize) {
             // There were trailing bytes or not enough data to complete
             // a fragment.
-
-            frame->release();
-            frame = NULL;
-
+            if (buffer != NULL && buffer != frame) {
+                buffer->release();
+            }
             return ERROR_MALFORMED;
         }
 
         if (pass == 0) {
             dstSize = dstOffset;
 
-            if (dstSize == srcSize && mNALSizeLen == 4) {
+            if (frame != NULL && dstSize == srcSize && mNALSizeLen == 4) {
                 // In this special case we can re-use the input buffer by substituting
                 // each 4-byte nal size with a 4-byte start code
                 buffer = frame;
@@ -892,28 +1031,10 @@ status_t MatroskaSource::read(
                 buffer = MediaBufferBase::Create(dstSize);
             }
 
-            int64_t timeUs;
-            CHECK(frame->meta_data().findInt64(kKeyTime, &timeUs));
-            int32_t isSync;
-            CHECK(frame->meta_data().findInt32(kKeyIsSyncFrame, &isSync));
-
-            buffer->meta_data().setInt64(kKeyTime, timeUs);
-            buffer->meta_data().setInt32(kKeyIsSyncFrame, isSync);
-
             dstPtr = (uint8_t *)buffer->data();
         }
     }
 
-    if (frame != buffer) {
-        frame->release();
-        frame = NULL;
-    }
-
-    if (targetSampleTimeUs >= 0ll) {
-        buffer->meta_data().setInt64(
-                kKeyTargetTime, targetSampleTimeUs);
-    }
-
     *out = buffer;
 
     return OK;
@@ -988,6 +1109,85 @@ MatroskaExtractor::MatroskaExtractor(DataSourceBase *source)
     addTracks();
 }
 
+void MatroskaExtractor::addClusterToIndex_l(const mkvparser::Cluster *cluster) {
+    if (cluster == NULL || cluster->EOS()) {
+        return;
+    }
+
+    const long long position = cluster->GetPosition();
+    size_t lo = 0;
+    size_t hi = mClusterIndex.size();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const long long midPosition = mClusterIndex.itemAt(mid)->GetPosition();
+        if (midPosition == position) {
+            return;
+        } else if (midPosition < position) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    mClusterIndex.insertAt(cluster, lo);
+}
+
+// Returns the index of the last indexed cluster starting at or before
+// |timeNs|, or of the first one if all start later, or -1 if there are none.
+ssize_t MatroskaExtractor::findClusterInIndex_l(long long timeNs) const {
+    if (mClusterIndex.isEmpty()) {
+        return -1;
+    }
+
+    size_t lo = 0;
+    size_t hi = mClusterIndex.size();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (mClusterIndex.itemAt(mid)->GetTime() <= timeNs) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo == 0 ? 0 : lo - 1;
+}
+
+// Makes sure the clusters between the closest indexed one and |timeNs| are
+// indexed as well, walking cluster headers only, and returns the index of the
+// cluster to start a seek to |timeNs| from.
+ssize_t MatroskaExtractor::extendClusterIndex_l(long long timeNs) {
+    if (mClusterIndex.isEmpty()) {
+        addClusterToIndex_l(mSegment->GetFirst());
+    }
+
+    ssize_t index = findClusterInIndex_l(timeNs);
+    if (index < 0) {
+        return index;
+    }
+
+    const mkvparser::Cluster *cluster = mClusterIndex.itemAt(index);
+    for (;;) {
+        const mkvparser::Cluster *next;
+        long long pos;
+        long len;
+        if (mSegment->ParseNext(cluster, next, pos, len) != 0
+                || next == NULL || next->EOS()) {
+            break;
+        }
+
+        const long long nextTimeNs = next->GetTime();
+        if (nextTimeNs < 0) {
+            break;
+        }
+        addClusterToIndex_l(next);
+        if (nextTimeNs > timeNs) {
+            break;
+        }
+        cluster = next;
+    }
+
+    return findClusterInIndex_l(timeNs);
+}
+
 MatroskaExtractor::~MatroskaExtractor() {
     delete mSegment;
     mSegment = NULL;
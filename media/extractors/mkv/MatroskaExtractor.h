@@ -84,6 +84,10 @@ private:
     bool mIsWebm;
     int64_t mSeekPreRollNs;
 
+    // Clusters seen so far, ordered by file position. Filled in as tracks
+    // are read and while seeking, and used to seek files without Cues.
+    Vector<const mkvparser::Cluster *> mClusterIndex;
+
     status_t synthesizeAVCC(TrackInfo *trackInfo, size_t index);
     status_t initTrackInfo(
             const mkvparser::Track *track,
@@ -96,6 +100,10 @@ private:
             MetaDataBase &meta);
     bool isLiveStreaming() const;
 
+    void addClusterToIndex_l(const mkvparser::Cluster *cluster);
+    ssize_t findClusterInIndex_l(long long timeNs) const;
+    ssize_t extendClusterIndex_l(long long timeNs);
+
     MatroskaExtractor(const MatroskaExtractor &);
     MatroskaExtractor &operator=(const MatroskaExtractor &);
 };
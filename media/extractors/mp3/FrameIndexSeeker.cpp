@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameIndexSeeker"
+
+#include <inttypes.h>
+
+#include <utils/Log.h>
+
+#include "FrameIndexSeeker.h"
+
+#include <media/stagefright/foundation/avc_utils.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ByteUtils.h>
+#include <media/DataSourceBase.h>
+
+namespace android {
+
+// Same as the mask MP3Extractor uses to tell frames of the stream apart
+// from garbage.
+static const uint32_t kMask = 0xfffe0c00;
+
+// Serializes all access to a data source shared with the indexing thread.
+class FrameIndexSeeker::SerializedSource : public DataSourceBase {
+public:
+    explicit SerializedSource(DataSourceBase *source)
+        : mSource(source) {
+    }
+
+    virtual ~SerializedSource() {}
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        Mutex::Autolock autoLock(mLock);
+        return mSource->readAt(offset, data, size);
+    }
+
+    virtual ssize_t borrowAt(off64_t offset, const uint8_t **data, size_t size) {
+        Mutex::Autolock autoLock(mLock);
+        return mSource->borrowAt(offset, data, size);
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        Mutex::Autolock autoLock(mLock);
+        return mSource->getSize(size);
+    }
+
+    virtual bool getUri(char *uriString, size_t bufferSize) {
+        Mutex::Autolock autoLock(mLock);
+        return mSource->getUri(uriString, bufferSize);
+    }
+
+    virtual uint32_t flags() {
+        Mutex::Autolock autoLock(mLock);
+        return mSource->flags();
+    }
+
+    virtual void close() {
+        Mutex::Autolock autoLock(mLock);
+        mSource->close();
+    }
+
+private:
+    DataSourceBase *mSource;
+    Mutex mLock;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SerializedSource);
+};
+
+// static
+FrameIndexSeeker *FrameIndexSeeker::CreateFromSource(
+        DataSourceBase *source, off64_t first_frame_pos, uint32_t fixed_header) {
+    size_t frameSize;
+    int sampleRate;
+    int numSamples;
+    if (!GetMPEGAudioFrameSize(
+                fixed_header, &frameSize, &sampleRate, NULL, NULL, &numSamples)
+            || sampleRate <= 0 || numSamples <= 0) {
+        return NULL;
+    }
+
+    return new FrameIndexSeeker(
+            source, first_frame_pos, fixed_header, sampleRate, numSamples);
+}
+
+FrameIndexSeeker::FrameIndexSeeker(
+        DataSourceBase *source, off64_t first_frame_pos, uint32_t fixed_header,
+        int sample_rate, int samples_per_frame)
+    : mSource(new SerializedSource(source)),
+      mFirstFramePos(first_frame_pos),
+      mFixedHeader(fixed_header),
+      mSampleRate(sample_rate),
+      mSamplesPerFrame(samples_per_frame),
+      mNumFrames(0),
+      mComplete(false),
+      mStopping(false) {
+}
+
+FrameIndexSeeker::~FrameIndexSeeker() {
+    mStopping = true;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    delete mSource;
+    mSource = NULL;
+}
+
+DataSourceBase *FrameIndexSeeker::getDataSource() {
+    return mSource;
+}
+
+void FrameIndexSeeker::start() {
+    Mutex::Autolock autoLock(mLock);
+    if (!mThread.joinable()) {
+        mThread = std::thread(&FrameIndexSeeker::threadLoop, this);
+    }
+}
+
+bool FrameIndexSeeker::getDuration(int64_t *durationUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mComplete || mNumFrames == 0) {
+        return false;
+    }
+
+    *durationUs = mNumFrames * mSamplesPerFrame * 1000000ll / mSampleRate;
+
+    return true;
+}
+
+bool FrameIndexSeeker::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+    if (*timeUs > INT64_MAX / mSampleRate) {
+        return false;
+    }
+
+    int64_t frame = 0;
+    if (*timeUs > 0) {
+        frame = *timeUs * mSampleRate / (1000000ll * mSamplesPerFrame);
+    }
+
+    Entry entry;
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (frame >= mNumFrames) {
+            if (!mComplete || mNumFrames == 0) {
+                return false;
+            }
+            frame = mNumFrames - 1;
+        }
+
+        // find the last entry at or before the target frame
+        size_t lo = 0;
+        size_t hi = mEntries.size();
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (mEntries[mid].frame <= frame) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        entry = mEntries[lo];
+    }
+
+    // Walk the few frames between the index entry and the target. There is
+    // no garbage in between, but settle for the entry itself if the stream
+    // changed under us.
+    off64_t offset = entry.offset;
+    for (int64_t i = entry.frame; i < frame; ++i) {
+        uint8_t header[4];
+        size_t frameSize = 0;
+        if (mSource->readAt(offset, header, sizeof(header)) == (ssize_t)sizeof(header)) {
+            frameSize = getFrameSize(header);
+        }
+        if (frameSize == 0) {
+            frame = entry.frame;
+            offset = entry.offset;
+            break;
+        }
+        offset += frameSize;
+    }
+
+    *pos = offset;
+    *timeUs = frame * mSamplesPerFrame * 1000000ll / mSampleRate;
+
+    return true;
+}
+
+size_t FrameIndexSeeker::getFrameSize(const uint8_t *ptr) const {
+    uint32_t header = U32_AT(ptr);
+
+    size_t frameSize;
+    if ((header & kMask) != (mFixedHeader & kMask)
+            || !GetMPEGAudioFrameSize(header, &frameSize)) {
+        return 0;
+    }
+
+    return frameSize;
+}
+
+void FrameIndexSeeker::threadLoop() {
+    uint8_t *buffer = new uint8_t[kScanBlockSize];
+    Vector<Entry> entries;
+    int64_t numFrames = 0;
+    int64_t lastEntryFrame = 0;
+    off64_t pos = mFirstFramePos;
+    // the first frame always gets an entry
+    bool synced = false;
+    bool complete = false;
+
+    while (!mStopping) {
+        ssize_t n = mSource->readAt(pos, buffer, kScanBlockSize);
+        if (n < 4) {
+            complete = (n >= 0);
+            break;
+        }
+        bool eos = ((size_t)n < kScanBlockSize);
+
+        size_t offset = 0;
+        while (offset + 4 <= (size_t)n) {
+            size_t frameSize = getFrameSize(&buffer[offset]);
+
+            if (frameSize > 0 && !synced) {
+                // After losing sync, only trust a header that is followed
+                // by another one, like Resync() does.
+                if (offset + frameSize + 4 > (size_t)n) {
+                    // Look again from here with the successor in the block,
+                    // or give up on the unconfirmed tail of the stream.
+                    break;
+                }
+                if (getFrameSize(&buffer[offset + frameSize]) == 0) {
+                    frameSize = 0;
+                }
+            }
+
+            if (frameSize > 0) {
+                if (!synced || numFrames - lastEntryFrame >= kFramesPerEntry) {
+                    Entry entry = { numFrames, pos + offset };
+                    entries.push(entry);
+                    lastEntryFrame = numFrames;
+                }
+                ++numFrames;
+                offset += frameSize;
+                synced = true;
+                continue;
+            }
+
+            synced = false;
+            ssize_t skip = FindMPEGAudioSyncWord(&buffer[offset + 1], n - offset - 1);
+            if (skip < 0) {
+                // Keep the last bytes, they may start a header that
+                // continues in the next block.
+                offset = n - 3;
+                break;
+            }
+            offset += 1 + skip;
+        }
+
+        {
+            Mutex::Autolock autoLock(mLock);
+            mEntries.appendVector(entries);
+            mNumFrames = numFrames;
+        }
+        entries.clear();
+
+        if (eos) {
+            complete = true;
+            break;
+        }
+        pos += offset;
+    }
+
+    delete[] buffer;
+    buffer = NULL;
+
+    Mutex::Autolock autoLock(mLock);
+    mComplete = complete;
+
+    ALOGV("indexed %" PRId64 " frames up to offset %lld%s",
+            numFrames, (long long)pos, complete ? "" : " (incomplete)");
+}
+
+}  // namespace android
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_INDEX_SEEKER_H_
+
+#define FRAME_INDEX_SEEKER_H_
+
+#include "MP3Seeker.h"
+
+#include <atomic>
+#include <thread>
+
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+class DataSourceBase;
+
+// Seeker for streams without a XING or VBRI table of contents. Once started,
+// a background thread walks the frame headers of the whole stream and records
+// the offset of every kFramesPerEntry-th frame, and of every frame where it
+// regained sync after garbage in the stream. Seeks within the part indexed
+// so far land on the exact frame containing the requested time; seeks beyond
+// it fail, so that the caller falls back to a bitrate based estimate.
+//
+// The indexing thread shares the data source with the track, which may not
+// be safe for concurrent use, so all reads of it must go through the source
+// returned by getDataSource() once the seeker has been created.
+struct FrameIndexSeeker : public MP3Seeker {
+    static FrameIndexSeeker *CreateFromSource(
+            DataSourceBase *source, off64_t first_frame_pos, uint32_t fixed_header);
+
+    virtual ~FrameIndexSeeker();
+
+    DataSourceBase *getDataSource();
+
+    // Starts indexing if it has not been started yet.
+    void start();
+
+    virtual bool getDuration(int64_t *durationUs);
+    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+
+private:
+    class SerializedSource;
+
+    struct Entry {
+        int64_t frame;
+        off64_t offset;
+    };
+
+    static const int64_t kFramesPerEntry = 32;
+    static const size_t kScanBlockSize = 64 * 1024;
+
+    SerializedSource *mSource;
+    off64_t mFirstFramePos;
+    uint32_t mFixedHeader;
+    int mSampleRate;
+    int mSamplesPerFrame;
+
+    Mutex mLock;
+    // guarded by mLock
+    Vector<Entry> mEntries;
+    int64_t mNumFrames;
+    bool mComplete;
+
+    std::atomic<bool> mStopping;
+    std::thread mThread;
+
+    FrameIndexSeeker(
+            DataSourceBase *source, off64_t first_frame_pos, uint32_t fixed_header,
+            int sample_rate, int samples_per_frame);
+
+    void threadLoop();
+
+    // Returns the size of the frame whose header starts at |ptr| if the
+    // header matches the fixed header, or 0.
+    size_t getFrameSize(const uint8_t *ptr) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(FrameIndexSeeker);
+};
+
+}  // namespace android
+
+#endif  // FRAME_INDEX_SEEKER_H_
@@ -20,6 +20,7 @@
 
 #include "MP3Extractor.h"
 
+#include "FrameIndexSeeker.h"
 #include "ID3.h"
 #include "VBRISeeker.h"
 #include "XINGSeeker.h"
@@ -258,7 +259,8 @@ MP3Extractor::MP3Extractor(
       mDataSource(source),
       mFirstFramePos(-1),
       mFixedHeader(0),
-      mSeeker(NULL) {
+      mSeeker(NULL),
+      mFrameIndexSeeker(NULL) {
 
     off64_t pos = 0;
     off64_t post_id3_pos;
@@ -297,7 +299,18 @@ MP3Extractor::MP3Extractor(
         }
     }
 
-    if (mSeeker != NULL) {
+    if (mSeeker == NULL
+            && (mDataSource->flags() & DataSourceBase::kIsLocalFileSource)) {
+        // Without a table of contents, index the frames ourselves once a
+        // track is requested. From here on all reads go through the seeker's
+        // source, which the indexing thread shares.
+        mFrameIndexSeeker = FrameIndexSeeker::CreateFromSource(
+                mDataSource, mFirstFramePos, mFixedHeader);
+        if (mFrameIndexSeeker != NULL) {
+            mDataSource = mFrameIndexSeeker->getDataSource();
+            mSeeker = mFrameIndexSeeker;
+        }
+    } else if (mSeeker != NULL) {
         // While it is safe to send the XING/VBRI frame to the decoder, this will
         // result in an extra 1152 samples being output. In addition, the bitrate
         // of the Xing header might not match the rest of the file, which could
@@ -415,6 +428,10 @@ MediaTrack *MP3Extractor::getTrack(size_t index) {
         return NULL;
     }
 
+    if (mFrameIndexSeeker != NULL) {
+        mFrameIndexSeeker->start();
+    }
+
     return new MP3Source(
             mMeta, mDataSource, mFirstFramePos, mFixedHeader,
             mSeeker);
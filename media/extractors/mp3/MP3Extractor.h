@@ -26,6 +26,7 @@ namespace android {
 
 struct AMessage;
 class DataSourceBase;
+struct FrameIndexSeeker;
 struct MP3Seeker;
 class String8;
 struct Mp3Meta;
@@ -50,6 +51,8 @@ private:
     MetaDataBase mMeta;
     uint32_t mFixedHeader;
     MP3Seeker *mSeeker;
+    // Same object as mSeeker when the stream has no XING/VBRI header
+    FrameIndexSeeker *mFrameIndexSeeker;
 
     MP3Extractor(const MP3Extractor &);
     MP3Extractor &operator=(const MP3Extractor &);
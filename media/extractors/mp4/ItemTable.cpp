@@ -18,6 +18,8 @@
 #define LOG_TAG "ItemTable"
 
 #include <ItemTable.h>
+#include <algorithm>
+#include <vector>
 #include <media/DataSourceBase.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/MediaErrors.h>
@@ -44,7 +46,7 @@ struct ImageItem {
     ImageItem(uint32_t _type, uint32_t _id, bool _hidden) :
             type(_type), itemId(_id), hidden(_hidden),
             rows(0), columns(0), width(0), height(0), rotation(0),
-            offset(0), size(0), nextTileIndex(0) {}
+            offset(0), size(0), nextTileIndex(0), resolved(false), resolveStatus(OK) {}
 
     bool isGrid() const {
         return type == FOURCC('g', 'r', 'i', 'd');
@@ -78,8 +80,21 @@ struct ImageItem {
     Vector<uint32_t> dimgRefs;
     Vector<uint32_t> cdscRefs;
     size_t nextTileIndex;
+
+    // indices into the item properties, applied when the item is resolved
+    Vector<uint16_t> properties;
+    bool resolved;
+    status_t resolveStatus;
 };
 
+static ImageItem *findImageItemById(
+        Vector<ImageItem> &imageItems,
+        const std::unordered_map<uint32_t, uint32_t> &itemIdToIndex,
+        uint32_t itemId) {
+    auto it = itemIdToIndex.find(itemId);
+    return it == itemIdToIndex.end() ? NULL : &imageItems.editItemAt(it->second);
+}
+
 struct ExifItem {
     off64_t offset;
     size_t size;
@@ -479,8 +494,9 @@ struct ItemReference : public Box, public RefBase {
     uint32_t itemId() { return mItemId; }
 
     void apply(
-            KeyedVector<uint32_t, ImageItem> &itemIdToItemMap,
-            KeyedVector<uint32_t, ExifItem> &itemIdToExifMap) const;
+            Vector<ImageItem> &imageItems,
+            const std::unordered_map<uint32_t, uint32_t> &itemIdToIndex,
+            const std::unordered_map<uint32_t, ExifItem> &itemIdToExifMap) const;
 
 private:
     uint32_t mItemId;
@@ -491,100 +507,93 @@ private:
 };
 
 void ItemReference::apply(
-        KeyedVector<uint32_t, ImageItem> &itemIdToItemMap,
-        KeyedVector<uint32_t, ExifItem> &itemIdToExifMap) const {
+        Vector<ImageItem> &imageItems,
+        const std::unordered_map<uint32_t, uint32_t> &itemIdToIndex,
+        const std::unordered_map<uint32_t, ExifItem> &itemIdToExifMap) const {
     ALOGV("attach reference type 0x%x to item id %d)", type(), mItemId);
 
     switch(type()) {
     case FOURCC('d', 'i', 'm', 'g'): {
-        ssize_t itemIndex = itemIdToItemMap.indexOfKey(mItemId);
+        ImageItem *derivedImage = findImageItemById(imageItems, itemIdToIndex, mItemId);
 
         // ignore non-image items
-        if (itemIndex < 0) {
+        if (derivedImage == NULL) {
             return;
         }
 
-        ImageItem &derivedImage = itemIdToItemMap.editValueAt(itemIndex);
-        if (!derivedImage.dimgRefs.empty()) {
+        if (!derivedImage->dimgRefs.empty()) {
             ALOGW("dimgRefs not clean!");
         }
-        derivedImage.dimgRefs.appendVector(mRefs);
+        derivedImage->dimgRefs.appendVector(mRefs);
 
         for (size_t i = 0; i < mRefs.size(); i++) {
-            itemIndex = itemIdToItemMap.indexOfKey(mRefs[i]);
+            ImageItem *sourceImage = findImageItemById(imageItems, itemIdToIndex, mRefs[i]);
 
             // ignore non-image items
-            if (itemIndex < 0) {
+            if (sourceImage == NULL) {
                 continue;
             }
-            ImageItem &sourceImage = itemIdToItemMap.editValueAt(itemIndex);
 
             // mark the source image of the derivation as hidden
-            sourceImage.hidden = true;
+            sourceImage->hidden = true;
         }
         break;
     }
     case FOURCC('t', 'h', 'm', 'b'): {
-        ssize_t itemIndex = itemIdToItemMap.indexOfKey(mItemId);
+        ImageItem *thumbImage = findImageItemById(imageItems, itemIdToIndex, mItemId);
 
         // ignore non-image items
-        if (itemIndex < 0) {
+        if (thumbImage == NULL) {
             return;
         }
 
         // mark thumbnail image as hidden, these can be retrieved if the client
         // request thumbnail explicitly, but won't be exposed as displayables.
-        ImageItem &thumbImage = itemIdToItemMap.editValueAt(itemIndex);
-        thumbImage.hidden = true;
+        thumbImage->hidden = true;
 
         for (size_t i = 0; i < mRefs.size(); i++) {
-            itemIndex = itemIdToItemMap.indexOfKey(mRefs[i]);
+            ImageItem *masterImage = findImageItemById(imageItems, itemIdToIndex, mRefs[i]);
 
             // ignore non-image items
-            if (itemIndex < 0) {
+            if (masterImage == NULL) {
                 continue;
             }
             ALOGV("Image item id %d uses thumbnail item id %d", mRefs[i], mItemId);
-            ImageItem &masterImage = itemIdToItemMap.editValueAt(itemIndex);
-            if (!masterImage.thumbnails.empty()) {
+            if (!masterImage->thumbnails.empty()) {
                 ALOGW("already has thumbnails!");
             }
-            masterImage.thumbnails.push_back(mItemId);
+            masterImage->thumbnails.push_back(mItemId);
         }
         break;
     }
     case FOURCC('c', 'd', 's', 'c'): {
-        ssize_t itemIndex = itemIdToExifMap.indexOfKey(mItemId);
-
         // ignore non-exif block items
-        if (itemIndex < 0) {
+        if (itemIdToExifMap.find(mItemId) == itemIdToExifMap.end()) {
             return;
         }
 
         for (size_t i = 0; i < mRefs.size(); i++) {
-            itemIndex = itemIdToItemMap.indexOfKey(mRefs[i]);
+            ImageItem *image = findImageItemById(imageItems, itemIdToIndex, mRefs[i]);
 
             // ignore non-image items
-            if (itemIndex < 0) {
+            if (image == NULL) {
                 continue;
             }
             ALOGV("Image item id %d uses metadata item id %d", mRefs[i], mItemId);
-            ImageItem &image = itemIdToItemMap.editValueAt(itemIndex);
-            image.cdscRefs.push_back(mItemId);
+            image->cdscRefs.push_back(mItemId);
         }
         break;
     }
     case FOURCC('a', 'u', 'x', 'l'): {
-        ssize_t itemIndex = itemIdToItemMap.indexOfKey(mItemId);
+        ImageItem *auxImage = findImageItemById(imageItems, itemIdToIndex, mItemId);
 
         // ignore non-image items
-        if (itemIndex < 0) {
+        if (auxImage == NULL) {
             return;
         }
 
         // mark auxiliary image as hidden
-        ImageItem &auxImage = itemIdToItemMap.editValueAt(itemIndex);
-        auxImage.hidden = true;
+        auxImage->hidden = true;
         break;
     }
     default:
@@ -673,7 +682,7 @@ struct AssociationEntry {
 };
 
 struct ItemProperty : public RefBase {
-    ItemProperty() {}
+    ItemProperty() : mOffset(0), mSize(0), mParsed(false), mParseStatus(OK) {}
 
     virtual void attachTo(ImageItem &/*image*/) const {
         ALOGW("Unrecognized property");
@@ -683,7 +692,26 @@ struct ItemProperty : public RefBase {
         return OK;
     }
 
+    // Properties are only located while parsing 'ipco', and parsed when
+    // first attached to an item.
+    void setLocation(off64_t offset, size_t size) {
+        mOffset = offset;
+        mSize = size;
+    }
+    status_t parseIfNeeded() {
+        if (!mParsed) {
+            mParseStatus = parse(mOffset, mSize);
+            mParsed = true;
+        }
+        return mParseStatus;
+    }
+
 private:
+    off64_t mOffset;
+    size_t mSize;
+    bool mParsed;
+    status_t mParseStatus;
+
     DISALLOW_EVIL_CONSTRUCTORS(ItemProperty);
 };
 
@@ -956,10 +984,7 @@ status_t IpcoBox::onChunkData(uint32_t type, off64_t offset, size_t size) {
             break;
         }
     }
-    status_t err = itemProperty->parse(offset, size);
-    if (err != OK) {
-        return err;
-    }
+    itemProperty->setLocation(offset, size);
     mItemProperties->push_back(itemProperty);
     return OK;
 }
@@ -1202,7 +1227,8 @@ ItemTable::ItemTable(DataSourceBase *source)
       mIdatOffset(0),
       mIdatSize(0),
       mImageItemsValid(false),
-      mCurrentItemIndex(0) {
+      mCurrentItemIndex(0),
+      mPrimaryImageIndex(0) {
     mRequiredBoxes.insert('iprp');
     mRequiredBoxes.insert('iloc');
     mRequiredBoxes.insert('pitm');
@@ -1347,8 +1373,18 @@ status_t ItemTable::buildImageItemsIfPossible(uint32_t type) {
 
     ALOGV("building image table...");
 
-    for (size_t i = 0; i < mItemInfos.size(); i++) {
-        const ItemInfo &info = mItemInfos[i];
+    // Items are indexed in item id order; for duplicate ids the first one in
+    // 'iinf' wins.
+    std::vector<size_t> infoOrder(mItemInfos.size());
+    for (size_t i = 0; i < infoOrder.size(); i++) {
+        infoOrder[i] = i;
+    }
+    std::stable_sort(infoOrder.begin(), infoOrder.end(), [this](size_t a, size_t b) {
+        return mItemInfos[a].itemId < mItemInfos[b].itemId;
+    });
+
+    for (size_t i = 0; i < infoOrder.size(); i++) {
+        const ItemInfo &info = mItemInfos[infoOrder[i]];
 
         // Only handle 3 types of items, all others are ignored:
         //   'grid': derived image from tiles
@@ -1360,8 +1396,7 @@ status_t ItemTable::buildImageItemsIfPossible(uint32_t type) {
             continue;
         }
 
-        ssize_t itemIndex = mItemIdToItemMap.indexOfKey(info.itemId);
-        if (itemIndex >= 0) {
+        if (mItemIdToIndex.find(info.itemId) != mItemIdToIndex.end()) {
             ALOGW("ignoring duplicate image item id %d", info.itemId);
             continue;
         }
@@ -1387,7 +1422,7 @@ status_t ItemTable::buildImageItemsIfPossible(uint32_t type) {
                         .offset = offset,
                         .size = size,
                 };
-                mItemIdToExifMap.add(info.itemId, exifItem);
+                mItemIdToExifMap[info.itemId] = exifItem;
             }
             continue;
         }
@@ -1396,41 +1431,43 @@ status_t ItemTable::buildImageItemsIfPossible(uint32_t type) {
 
         ALOGV("adding %s: itemId %d", image.isGrid() ? "grid" : "image", info.itemId);
 
-        if (image.isGrid()) {
-            // ImageGrid struct is at least 8-byte, at most 12-byte (if flags&1)
-            if (size < 8 || size > 12) {
-                return ERROR_MALFORMED;
-            }
-            uint8_t buf[12];
-            if (!mDataSource->readAt(offset, buf, size)) {
-                return ERROR_IO;
-            }
+        // for grids this locates the ImageGrid struct, read when resolved
+        image.offset = offset;
+        image.size = size;
 
-            image.rows = buf[2] + 1;
-            image.columns = buf[3] + 1;
-
-            ALOGV("rows %d, columans %d", image.rows, image.columns);
-        } else {
-            image.offset = offset;
-            image.size = size;
-        }
-        mItemIdToItemMap.add(info.itemId, image);
+        mItemIdToIndex[info.itemId] = mImageItems.size();
+        mImageItems.push_back(image);
     }
 
     for (size_t i = 0; i < mAssociations.size(); i++) {
-        attachProperty(mAssociations[i]);
+        const AssociationEntry &association = mAssociations[i];
+        ImageItem *image = findImageItemById(mImageItems, mItemIdToIndex, association.itemId);
+
+        // ignore non-image items
+        if (image == NULL) {
+            continue;
+        }
+
+        if (association.index >= mItemProperties.size()) {
+            ALOGW("Ignoring invalid property index %d", association.index);
+            continue;
+        }
+        image->properties.push_back(association.index);
     }
 
     for (size_t i = 0; i < mItemReferences.size(); i++) {
-        mItemReferences[i]->apply(mItemIdToItemMap, mItemIdToExifMap);
+        mItemReferences[i]->apply(mImageItems, mItemIdToIndex, mItemIdToExifMap);
     }
 
     bool foundPrimary = false;
-    for (size_t i = 0; i < mItemIdToItemMap.size(); i++) {
+    for (size_t i = 0; i < mImageItems.size(); i++) {
         // add all non-hidden images, also add the primary even if it's marked
         // hidden, in case the primary is set to a thumbnail
-        bool isPrimary = (mItemIdToItemMap[i].itemId == mPrimaryItemId);
-        if (!mItemIdToItemMap[i].hidden || isPrimary) {
+        bool isPrimary = (mImageItems[i].itemId == mPrimaryItemId);
+        if (!mImageItems[i].hidden || isPrimary) {
+            if (isPrimary) {
+                mPrimaryImageIndex = mDisplayables.size();
+            }
             mDisplayables.push_back(i);
         }
         foundPrimary |= isPrimary;
@@ -1445,31 +1482,87 @@ status_t ItemTable::buildImageItemsIfPossible(uint32_t type) {
 
     // if the primary item id is invalid, set primary to the first displayable
     if (!foundPrimary) {
-        mPrimaryItemId = mItemIdToItemMap[mDisplayables[0]].itemId;
+        mPrimaryItemId = mImageItems[mDisplayables[0]].itemId;
+        mPrimaryImageIndex = 0;
+    }
+
+    // Resolve the primary image and its thumbnail now, everything else is
+    // resolved when it is first asked for.
+    status_t err = resolveImageItem(mDisplayables[mPrimaryImageIndex]);
+    if (err != OK) {
+        return err;
+    }
+    const ImageItem &primary = mImageItems[mDisplayables[mPrimaryImageIndex]];
+    if (!primary.thumbnails.empty()) {
+        const ImageItem *thumbnail;
+        if (resolveImageItemById(primary.thumbnails[0], &thumbnail) != OK) {
+            ALOGW("failed to resolve thumbnail of the primary image");
+        }
     }
 
     mImageItemsValid = true;
     return OK;
 }
 
-void ItemTable::attachProperty(const AssociationEntry &association) {
-    ssize_t itemIndex = mItemIdToItemMap.indexOfKey(association.itemId);
+ssize_t ItemTable::indexOfItemId(uint32_t itemId) const {
+    auto it = mItemIdToIndex.find(itemId);
+    return it == mItemIdToIndex.end() ? NAME_NOT_FOUND : (ssize_t)it->second;
+}
 
-    // ignore non-image items
-    if (itemIndex < 0) {
-        return;
+// Reads the grid layout and parses and attaches the properties of an item,
+// once. The result is remembered, so a broken item fails consistently.
+status_t ItemTable::resolveImageItem(uint32_t itemIndex) {
+    ImageItem &image = mImageItems.editItemAt(itemIndex);
+    if (image.resolved) {
+        return image.resolveStatus;
     }
+    image.resolved = true;
+
+    if (image.isGrid()) {
+        // ImageGrid struct is at least 8-byte, at most 12-byte (if flags&1)
+        if (image.size < 8 || image.size > 12) {
+            image.resolveStatus = ERROR_MALFORMED;
+            return image.resolveStatus;
+        }
+        uint8_t buf[12];
+        if (!mDataSource->readAt(image.offset, buf, image.size)) {
+            image.resolveStatus = ERROR_IO;
+            return image.resolveStatus;
+        }
 
-    uint16_t propertyIndex = association.index;
-    if (propertyIndex >= mItemProperties.size()) {
-        ALOGW("Ignoring invalid property index %d", propertyIndex);
-        return;
+        image.rows = buf[2] + 1;
+        image.columns = buf[3] + 1;
+
+        ALOGV("rows %d, columans %d", image.rows, image.columns);
     }
 
-    ALOGV("attach property %d to item id %d)",
-            propertyIndex, association.itemId);
+    for (size_t i = 0; i < image.properties.size(); i++) {
+        uint16_t propertyIndex = image.properties[i];
+        status_t err = mItemProperties[propertyIndex]->parseIfNeeded();
+        if (err != OK) {
+            image.resolveStatus = err;
+            return err;
+        }
+
+        ALOGV("attach property %d to item id %d)", propertyIndex, image.itemId);
 
-    mItemProperties[propertyIndex]->attachTo(mItemIdToItemMap.editValueAt(itemIndex));
+        mItemProperties[propertyIndex]->attachTo(image);
+    }
+
+    return OK;
+}
+
+status_t ItemTable::resolveImageItemById(uint32_t itemId, const ImageItem **image) {
+    ssize_t itemIndex = indexOfItemId(itemId);
+    if (itemIndex < 0) {
+        return NAME_NOT_FOUND;
+    }
+    status_t err = resolveImageItem(itemIndex);
+    if (err != OK) {
+        return err;
+    }
+    *image = &mImageItems[itemIndex];
+    return OK;
 }
 
 uint32_t ItemTable::countImages() const {
@@ -1488,15 +1581,17 @@ sp<MetaData> ItemTable::getImageMeta(const uint32_t imageIndex) {
     const uint32_t itemIndex = mDisplayables[imageIndex];
     ALOGV("image[%u]: item index %u", imageIndex, itemIndex);
 
-    const ImageItem *image = &mItemIdToItemMap[itemIndex];
+    if (resolveImageItem(itemIndex) != OK) {
+        return NULL;
+    }
+    const ImageItem *image = &mImageItems[itemIndex];
 
-    ssize_t tileItemIndex = -1;
+    const ImageItem *tile = NULL;
     if (image->isGrid()) {
         if (image->dimgRefs.empty()) {
             return NULL;
         }
-        tileItemIndex = mItemIdToItemMap.indexOfKey(image->dimgRefs[0]);
-        if (tileItemIndex < 0) {
+        if (resolveImageItemById(image->dimgRefs[0], &tile) != OK) {
             return NULL;
         }
     }
@@ -1525,16 +1620,15 @@ sp<MetaData> ItemTable::getImageMeta(const uint32_t imageIndex) {
     meta->setInt32(kKeyMaxInputSize, image->width * image->height * 1.5);
 
     if (!image->thumbnails.empty()) {
-        ssize_t thumbItemIndex = mItemIdToItemMap.indexOfKey(image->thumbnails[0]);
-        if (thumbItemIndex >= 0) {
-            const ImageItem &thumbnail = mItemIdToItemMap[thumbItemIndex];
-
-            meta->setInt32(kKeyThumbnailWidth, thumbnail.width);
-            meta->setInt32(kKeyThumbnailHeight, thumbnail.height);
+        const ImageItem *thumbnail;
+        if (resolveImageItemById(image->thumbnails[0], &thumbnail) == OK
+                && thumbnail->hvcc != NULL) {
+            meta->setInt32(kKeyThumbnailWidth, thumbnail->width);
+            meta->setInt32(kKeyThumbnailHeight, thumbnail->height);
             meta->setData(kKeyThumbnailHVCC, kTypeHVCC,
-                    thumbnail.hvcc->data(), thumbnail.hvcc->size());
-            ALOGV("image[%u]: thumbnail: size %dx%d, item index %zd",
-                    imageIndex, thumbnail.width, thumbnail.height, thumbItemIndex);
+                    thumbnail->hvcc->data(), thumbnail->hvcc->size());
+            ALOGV("image[%u]: thumbnail: size %dx%d, item id %u",
+                    imageIndex, thumbnail->width, thumbnail->height, thumbnail->itemId);
         } else {
             ALOGW("%s: Referenced thumbnail does not exist!", __FUNCTION__);
         }
@@ -1545,7 +1639,7 @@ sp<MetaData> ItemTable::getImageMeta(const uint32_t imageIndex) {
         meta->setInt32(kKeyGridCols, image->columns);
 
         // point image to the first tile for grid size and HVCC
-        image = &mItemIdToItemMap.editValueAt(tileItemIndex);
+        image = tile;
         meta->setInt32(kKeyTileWidth, image->width);
         meta->setInt32(kKeyTileHeight, image->height);
         meta->setInt32(kKeyMaxInputSize, image->width * image->height * 1.5);
@@ -1591,13 +1685,13 @@ status_t ItemTable::findThumbnailItem(const uint32_t imageIndex, uint32_t *itemI
 
     uint32_t masterItemIndex = mDisplayables[imageIndex];
 
-    const ImageItem &masterImage = mItemIdToItemMap[masterItemIndex];
+    const ImageItem &masterImage = mImageItems[masterItemIndex];
     if (masterImage.thumbnails.empty()) {
         *itemIndex = masterItemIndex;
         return OK;
     }
 
-    ssize_t thumbItemIndex = mItemIdToItemMap.indexOfKey(masterImage.thumbnails[0]);
+    ssize_t thumbItemIndex = indexOfItemId(masterImage.thumbnails[0]);
     if (thumbItemIndex < 0) {
         // Do not return the master image in this case, fail it so that the
         // thumbnail extraction code knows we really don't have it.
@@ -1615,34 +1709,34 @@ status_t ItemTable::getImageOffsetAndSize(
     }
 
     if (itemIndex != NULL) {
-        if (*itemIndex >= mItemIdToItemMap.size()) {
+        if (*itemIndex >= mImageItems.size()) {
             ALOGE("%s: Bad item index!", __FUNCTION__);
             return BAD_VALUE;
         }
         mCurrentItemIndex = *itemIndex;
     }
 
-    ImageItem &image = mItemIdToItemMap.editValueAt(mCurrentItemIndex);
+    ImageItem &image = mImageItems.editItemAt(mCurrentItemIndex);
     if (image.isGrid()) {
         uint32_t tileItemId;
         status_t err = image.getNextTileItemId(&tileItemId, itemIndex != NULL);
         if (err != OK) {
             return err;
         }
-        ssize_t tileItemIndex = mItemIdToItemMap.indexOfKey(tileItemId);
+        ssize_t tileItemIndex = indexOfItemId(tileItemId);
         if (tileItemIndex < 0) {
             return ERROR_END_OF_STREAM;
         }
-        *offset = mItemIdToItemMap[tileItemIndex].offset;
-        *size = mItemIdToItemMap[tileItemIndex].size;
+        *offset = mImageItems[tileItemIndex].offset;
+        *size = mImageItems[tileItemIndex].size;
     } else {
         if (itemIndex == NULL) {
             // For single images, we only allow it to be read once, after that
             // it's EOS.  New item index must be requested each time.
             return ERROR_END_OF_STREAM;
         }
-        *offset = mItemIdToItemMap[mCurrentItemIndex].offset;
-        *size = mItemIdToItemMap[mCurrentItemIndex].size;
+        *offset = mImageItems[mCurrentItemIndex].offset;
+        *size = mImageItems[mCurrentItemIndex].size;
     }
 
     return OK;
@@ -1653,26 +1747,26 @@ status_t ItemTable::getExifOffsetAndSize(off64_t *offset, size_t *size) {
         return INVALID_OPERATION;
     }
 
-    ssize_t itemIndex = mItemIdToItemMap.indexOfKey(mPrimaryItemId);
+    ssize_t itemIndex = indexOfItemId(mPrimaryItemId);
 
     // this should not happen, something's seriously wrong.
     if (itemIndex < 0) {
         return INVALID_OPERATION;
     }
 
-    const ImageItem &image = mItemIdToItemMap[itemIndex];
+    const ImageItem &image = mImageItems[itemIndex];
     if (image.cdscRefs.size() == 0) {
         return NAME_NOT_FOUND;
     }
 
-    ssize_t exifIndex = mItemIdToExifMap.indexOfKey(image.cdscRefs[0]);
-    if (exifIndex < 0) {
+    auto exif = mItemIdToExifMap.find(image.cdscRefs[0]);
+    if (exif == mItemIdToExifMap.end()) {
         return NAME_NOT_FOUND;
     }
 
     // skip the first 4-byte of the offset to TIFF header
-    *offset = mItemIdToExifMap[exifIndex].offset + 4;
-    *size = mItemIdToExifMap[exifIndex].size - 4;
+    *offset = exif->second.offset + 4;
+    *size = exif->second.size - 4;
     return OK;
 }
 
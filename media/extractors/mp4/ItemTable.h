@@ -18,6 +18,7 @@
 #define ITEM_TABLE_H_
 
 #include <set>
+#include <unordered_map>
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <utils/KeyedVector.h>
@@ -51,6 +52,7 @@ public:
 
     bool isValid() { return mImageItemsValid; }
     uint32_t countImages() const;
+    uint32_t getPrimaryImageIndex() const { return mPrimaryImageIndex; }
     sp<MetaData> getImageMeta(const uint32_t imageIndex);
     status_t findImageItem(const uint32_t imageIndex, uint32_t *itemIndex);
     status_t findThumbnailItem(const uint32_t imageIndex, uint32_t *itemIndex);
@@ -79,8 +81,13 @@ private:
 
     bool mImageItemsValid;
     uint32_t mCurrentItemIndex;
-    KeyedVector<uint32_t, ImageItem> mItemIdToItemMap;
-    KeyedVector<uint32_t, ExifItem> mItemIdToExifMap;
+    uint32_t mPrimaryImageIndex;
+    // Image items in item id order. Only their locations and references are
+    // known after parsing; properties and grid layouts are resolved on first
+    // use by resolveImageItem(), up front only for the primary and its thumbnail.
+    Vector<ImageItem> mImageItems;
+    std::unordered_map<uint32_t, uint32_t> mItemIdToIndex;
+    std::unordered_map<uint32_t, ExifItem> mItemIdToExifMap;
     Vector<uint32_t> mDisplayables;
 
     status_t parseIlocBox(off64_t offset, size_t size);
@@ -90,8 +97,10 @@ private:
     status_t parseIdatBox(off64_t offset, size_t size);
     status_t parseIrefBox(off64_t offset, size_t size);
 
-    void attachProperty(const AssociationEntry &association);
     status_t buildImageItemsIfPossible(uint32_t type);
+    ssize_t indexOfItemId(uint32_t itemId) const;
+    status_t resolveImageItem(uint32_t itemIndex);
+    status_t resolveImageItemById(uint32_t itemId, const ImageItem **image);
 
     DISALLOW_EVIL_CONSTRUCTORS(ItemTable);
 };
@@ -17,9 +17,12 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "MPEG4Extractor"
 
+#include <algorithm>
 #include <ctype.h>
 #include <inttypes.h>
+#include <list>
 #include <memory>
+#include <vector>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -86,6 +89,9 @@ public:
 
     virtual status_t read(MediaBufferBase **buffer, const ReadOptions *options = NULL);
     virtual bool supportNonblockingRead() { return true; }
+    virtual status_t readMultiple(
+            Vector<MediaBufferBase *> *buffers, uint32_t maxNumBuffers,
+            size_t maxBytes, const ReadOptions *options = NULL);
     virtual status_t fragmentedRead(MediaBufferBase **buffer, const ReadOptions *options = NULL);
 
     virtual ~MPEG4Source();
@@ -108,6 +114,23 @@ private:
     int32_t mLastParsedTrackId;
     int32_t mTrackId;
 
+    // Start time and moof offset of each sidx segment, filled on first seek.
+    Vector<int64_t> mSegmentStartTimesUs;
+    Vector<off64_t> mSegmentStartOffsets;
+
+    // Without sidx, fragments that start with a sample of this track, in
+    // file order. Times are in track timescale and on the same base as
+    // mCurrentTime. Unless it came from mfra, the index covers a contiguous
+    // run of fragments from the first moof. It is extended while playing
+    // and when a seek lands past its end.
+    struct FragmentEntry {
+        uint32_t mTime;
+        off64_t mMoofOffset;
+    };
+    Vector<FragmentEntry> mFragments;
+    bool mFragmentIndexComplete;
+    bool mTriedRandomAccessIndex;
+
     int32_t mCryptoMode;    // passed in from extractor
     int32_t mDefaultIVSize; // passed in from extractor
     uint8_t mCryptoKey[16]; // passed in from extractor
@@ -140,6 +163,8 @@ private:
     bool mIsHeif;
     sp<ItemTable> mItemTable;
 
+    status_t read_l(MediaBufferBase **buffer, const ReadOptions *options);
+
     size_t parseNALSize(const uint8_t *data) const;
     status_t parseChunk(off64_t *offset);
     status_t parseTrackFragmentHeader(off64_t offset, off64_t size);
@@ -149,6 +174,13 @@ private:
     status_t parseClearEncryptedSizes(off64_t offset, bool isSubsampleEncryption, uint32_t flags);
     status_t parseSampleEncryption(off64_t offset);
 
+    status_t loadFragment(off64_t moofOffset);
+    status_t seekToSegment(int64_t seekTimeUs, ReadOptions::SeekMode mode);
+    status_t seekToFragment(int64_t seekTimeUs, ReadOptions::SeekMode mode);
+    void recordFragment(uint32_t time, off64_t moofOffset);
+    status_t extendFragmentIndex(uint32_t targetTime);
+    void loadRandomAccessIndex();
+
     struct TrackFragmentHeaderInfo {
         enum Flags {
             kBaseDataOffsetPresent         = 0x01,
@@ -204,6 +236,10 @@ struct CachedRangedDataSource : public DataSourceBase {
 
     status_t setCachedRange(off64_t offset, size_t size, bool assumeSourceOwnershipOnSuccess);
 
+    // Serves the range from |data|, which is shared rather than copied.
+    void setSharedCachedRange(
+            off64_t offset, const std::shared_ptr<const std::vector<uint8_t>> &data);
+
 
 private:
     Mutex mLock;
@@ -213,6 +249,7 @@ private:
     off64_t mCachedOffset;
     size_t mCachedSize;
     uint8_t *mCache;
+    std::shared_ptr<const std::vector<uint8_t>> mSharedCache;
 
     void clearCache();
 
@@ -236,10 +273,12 @@ CachedRangedDataSource::~CachedRangedDataSource() {
 }
 
 void CachedRangedDataSource::clearCache() {
-    if (mCache) {
+    if (mSharedCache != nullptr) {
+        mSharedCache.reset();
+    } else if (mCache) {
         free(mCache);
-        mCache = NULL;
     }
+    mCache = NULL;
 
     mCachedOffset = 0;
     mCachedSize = 0;
@@ -250,13 +289,16 @@ status_t CachedRangedDataSource::initCheck() const {
 }
 
 ssize_t CachedRangedDataSource::readAt(off64_t offset, void *data, size_t size) {
-    Mutex::Autolock autoLock(mLock);
+    {
+        Mutex::Autolock autoLock(mLock);
 
-    if (isInRange(mCachedOffset, mCachedSize, offset, size)) {
-        memcpy(data, &mCache[offset - mCachedOffset], size);
-        return size;
+        if (isInRange(mCachedOffset, mCachedSize, offset, size)) {
+            memcpy(data, &mCache[offset - mCachedOffset], size);
+            return size;
+        }
     }
 
+    // Don't serialize reads of other tracks' sample data behind the cache.
     return mSource->readAt(offset, data, size);
 }
 
@@ -295,6 +337,125 @@ status_t CachedRangedDataSource::setCachedRange(off64_t offset,
     return OK;
 }
 
+void CachedRangedDataSource::setSharedCachedRange(
+        off64_t offset, const std::shared_ptr<const std::vector<uint8_t>> &data) {
+    Mutex::Autolock autoLock(mLock);
+
+    clearCache();
+
+    mSharedCache = data;
+    mCache = const_cast<uint8_t *>(data->data());
+    mCachedOffset = offset;
+    mCachedSize = data->size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Process wide LRU cache of recently parsed moov boxes. The metadata
+// retriever, the scanner and playback tend to open the same file in a row,
+// and re-reading a large moov through the data source is what dominates
+// those opens. Entries are revalidated against a handful of spans read
+// from the source, so a modified file is not served stale data.
+struct MoovCache {
+    static MoovCache &Get() {
+        static MoovCache *sCache = new MoovCache;
+        return *sCache;
+    }
+
+    std::shared_ptr<const std::vector<uint8_t>> lookup(
+            DataSourceBase *source, off64_t fileSize, off64_t offset, size_t size);
+
+    void insert(off64_t fileSize, off64_t offset,
+            const std::shared_ptr<const std::vector<uint8_t>> &data);
+
+    // Boxes larger than this are not worth the address space.
+    static constexpr size_t kMaxEntrySize = 4 * 1024 * 1024;
+
+private:
+    static constexpr size_t kCapacity = 16 * 1024 * 1024;
+    static constexpr size_t kNumCheckSpans = 16;
+    static constexpr size_t kCheckSpanSize = 256;
+
+    struct Entry {
+        off64_t mFileSize;
+        off64_t mOffset;
+        std::shared_ptr<const std::vector<uint8_t>> mData;
+    };
+
+    Mutex mLock;
+    std::list<Entry> mEntries;  // most recently used first
+    size_t mTotalSize = 0;
+
+    static bool matches(DataSourceBase *source, off64_t offset,
+            const std::vector<uint8_t> &data);
+};
+
+// static
+bool MoovCache::matches(
+        DataSourceBase *source, off64_t offset, const std::vector<uint8_t> &data) {
+    if (data.size() <= kNumCheckSpans * kCheckSpanSize) {
+        std::vector<uint8_t> current(data.size());
+        return source->readAt(offset, current.data(), current.size())
+                        == (ssize_t)current.size()
+                && current == data;
+    }
+
+    // Spans spread evenly over the box.
+    uint8_t span[kCheckSpanSize];
+    size_t step = (data.size() - kCheckSpanSize) / (kNumCheckSpans - 1);
+    for (size_t i = 0; i < kNumCheckSpans; ++i) {
+        size_t pos = i * step;
+        if (source->readAt(offset + pos, span, kCheckSpanSize) != (ssize_t)kCheckSpanSize
+                || memcmp(span, &data[pos], kCheckSpanSize)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> MoovCache::lookup(
+        DataSourceBase *source, off64_t fileSize, off64_t offset, size_t size) {
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+            if (it->mFileSize == fileSize && it->mOffset == offset
+                    && it->mData->size() == size) {
+                data = it->mData;
+                mEntries.splice(mEntries.begin(), mEntries, it);
+                break;
+            }
+        }
+    }
+
+    // Validate outside the lock, this reads from the source.
+    if (data != nullptr && !matches(source, offset, *data)) {
+        ALOGV("cached moov at %lld no longer matches", (long long)offset);
+        data.reset();
+    }
+    return data;
+}
+
+void MoovCache::insert(off64_t fileSize, off64_t offset,
+        const std::shared_ptr<const std::vector<uint8_t>> &data) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (it->mFileSize == fileSize && it->mOffset == offset) {
+            mTotalSize -= it->mData->size();
+            mEntries.erase(it);
+            break;
+        }
+    }
+
+    mEntries.push_front(Entry { fileSize, offset, data });
+    mTotalSize += data->size();
+    while (mTotalSize > kCapacity && !mEntries.empty()) {
+        mTotalSize -= mEntries.back().mData->size();
+        mEntries.pop_back();
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 static const bool kUseHexDump = false;
@@ -356,6 +517,7 @@ MPEG4Extractor::MPEG4Extractor(DataSourceBase *source, const char *mime)
       mMdatFound(false),
       mDataSource(source),
       mCachedSource(NULL),
+      mMoovCached(false),
       mInitCheck(NO_INIT),
       mHeaderTimescale(0),
       mIsQT(false),
@@ -386,9 +548,8 @@ MPEG4Extractor::~MPEG4Extractor() {
 }
 
 uint32_t MPEG4Extractor::flags() const {
-    return CAN_PAUSE |
-            ((mMoofOffset == 0 || mSidxEntries.size() != 0) ?
-                    (CAN_SEEK_BACKWARD | CAN_SEEK_FORWARD | CAN_SEEK) : 0);
+    // Fragmented files without sidx are seekable through the fragment index.
+    return CAN_PAUSE | CAN_SEEK_BACKWARD | CAN_SEEK_FORWARD | CAN_SEEK;
 }
 
 status_t MPEG4Extractor::getMetaData(MetaDataBase &meta) {
@@ -436,7 +597,7 @@ status_t MPEG4Extractor::getTrackMetaData(
         --index;
     }
 
-    if (track == NULL) {
+    if (track == NULL || resolveHeifTrackMeta(track) != OK) {
         return UNKNOWN_ERROR;
     }
 
@@ -601,12 +762,18 @@ status_t MPEG4Extractor::readMetaData() {
             mFileMetaData.setInt64(kKeyExifOffset, (int64_t)exifOffset);
             mFileMetaData.setInt64(kKeyExifSize, (int64_t)exifSize);
         }
+        // Only the primary image meta is read now; image collections can be
+        // large, so the other tracks get theirs when they are first used.
+        uint32_t primaryImageIndex = mItemTable->getPrimaryImageIndex();
         for (uint32_t imageIndex = 0;
                 imageIndex < mItemTable->countImages(); imageIndex++) {
-            sp<MetaData> meta = mItemTable->getImageMeta(imageIndex);
-            if (meta == NULL) {
-                ALOGE("heif image %u has no meta!", imageIndex);
-                continue;
+            sp<MetaData> meta;
+            if (imageIndex == primaryImageIndex) {
+                meta = mItemTable->getImageMeta(imageIndex);
+                if (meta == NULL) {
+                    ALOGE("heif image %u has no meta!", imageIndex);
+                    continue;
+                }
             }
             // Some heif files advertise image sequence brands (eg. 'hevc') in
             // ftyp box, but don't have any valid tracks in them. Instead of
@@ -628,7 +795,13 @@ status_t MPEG4Extractor::readMetaData() {
             }
             mLastTrack = track;
 
-            track->meta = *(meta.get());
+            if (meta != NULL) {
+                track->meta = *(meta.get());
+                track->heif_meta_pending = false;
+            } else {
+                track->meta.setCString(kKeyMIMEType, MEDIA_MIMETYPE_IMAGE_ANDROID_HEIC);
+                track->heif_meta_pending = true;
+            }
             track->meta.setInt32(kKeyTrackID, imageIndex);
             track->includes_expensive_metadata = false;
             track->skipTrack = false;
@@ -679,6 +852,52 @@ status_t MPEG4Extractor::readMetaData() {
     return mInitCheck;
 }
 
+status_t MPEG4Extractor::resolveHeifTrackMeta(Track *track) {
+    if (!track->heif_meta_pending) {
+        return OK;
+    }
+
+    int32_t imageIndex;
+    CHECK(track->meta.findInt32(kKeyTrackID, &imageIndex));
+    sp<MetaData> meta = mItemTable->getImageMeta(imageIndex);
+    if (meta == NULL) {
+        ALOGE("heif image %d has no meta!", imageIndex);
+        return ERROR_MALFORMED;
+    }
+    track->meta = *(meta.get());
+    track->meta.setInt32(kKeyTrackID, imageIndex);
+    track->heif_meta_pending = false;
+    return OK;
+}
+
+void MPEG4Extractor::cacheMoov(off64_t offset, uint64_t size) {
+    off64_t fileSize;
+    if (size > MoovCache::kMaxEntrySize || mDataSource->getSize(&fileSize) != OK) {
+        return;
+    }
+
+    MoovCache &cache = MoovCache::Get();
+    std::shared_ptr<const std::vector<uint8_t>> data =
+            cache.lookup(mDataSource, fileSize, offset, size);
+    if (data == nullptr) {
+        // Worth doing even if this file is never reopened: one read of the
+        // box instead of one per child box and sample table.
+        std::shared_ptr<std::vector<uint8_t>> moov =
+                std::make_shared<std::vector<uint8_t>>();
+        moov->resize(size);
+        if (mDataSource->readAt(offset, moov->data(), size) != (ssize_t)size) {
+            return;
+        }
+        data = moov;
+        cache.insert(fileSize, offset, data);
+    }
+
+    CachedRangedDataSource *cachedSource = new CachedRangedDataSource(mDataSource);
+    cachedSource->setSharedCachedRange(offset, data);
+    mDataSource = mCachedSource = cachedSource;
+    mMoovCached = true;
+}
+
 struct PathAdder {
     PathAdder(Vector<uint32_t> *path, uint32_t chunkType)
         : mPath(path) {
@@ -871,6 +1090,10 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 return ERROR_MALFORMED;
             }
 
+            if (chunk_type == FOURCC('m', 'o', 'o', 'v') && mCachedSource == NULL) {
+                cacheMoov(*offset, chunk_size);
+            }
+
             if (chunk_type == FOURCC('m', 'o', 'o', 'f') && !mMoofFound) {
                 // store the offset of the first segment
                 mMoofFound = true;
@@ -880,7 +1103,8 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
             if (chunk_type == FOURCC('s', 't', 'b', 'l')) {
                 ALOGV("sampleTable chunk is %" PRIu64 " bytes long.", chunk_size);
 
-                if (mDataSource->flags()
+                // Nothing to do if the whole moov is already in memory.
+                if (!mMoovCached && mDataSource->flags()
                         & (DataSourceBase::kWantsPrefetching
                             | DataSourceBase::kIsCachingDataSource)) {
                     CachedRangedDataSource *cachedSource =
@@ -926,6 +1150,7 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 track->meta.setCString(kKeyMIMEType, "application/octet-stream");
                 track->has_elst = false;
                 track->subsample_encryption = false;
+                track->heif_meta_pending = false;
             }
 
             off64_t stop_offset = *offset + chunk_size;
@@ -3372,7 +3597,7 @@ MediaTrack *MPEG4Extractor::getTrack(size_t index) {
         --index;
     }
 
-    if (track == NULL) {
+    if (track == NULL || resolveHeifTrackMeta(track) != OK) {
         return NULL;
     }
 
@@ -3849,6 +4074,8 @@ MPEG4Source::MPEG4Source(
       mCurrentMoofOffset(firstMoofOffset),
       mNextMoofOffset(-1),
       mCurrentTime(0),
+      mFragmentIndexComplete(false),
+      mTriedRandomAccessIndex(false),
       mDefaultEncryptedByteBlock(0),
       mDefaultSkipByteBlock(0),
       mCurrentSampleInfoAllocSize(0),
@@ -3925,7 +4152,11 @@ MPEG4Source::MPEG4Source(
 status_t MPEG4Source::init() {
     if (mFirstMoofOffset != 0) {
         off64_t offset = mFirstMoofOffset;
-        return parseChunk(&offset);
+        status_t err = parseChunk(&offset);
+        if (err == OK && !mCurrentSamples.isEmpty()) {
+            recordFragment(0, mFirstMoofOffset);
+        }
+        return err;
     }
     return OK;
 }
@@ -4667,7 +4898,42 @@ size_t MPEG4Source::parseNALSize(const uint8_t *data) const {
 status_t MPEG4Source::read(
         MediaBufferBase **out, const ReadOptions *options) {
     Mutex::Autolock autoLock(mLock);
+    return read_l(out, options);
+}
+
+status_t MPEG4Source::readMultiple(
+        Vector<MediaBufferBase *> *buffers, uint32_t maxNumBuffers,
+        size_t maxBytes, const ReadOptions *options) {
+    // Same as the default, but takes the lock once for the whole batch.
+    Mutex::Autolock autoLock(mLock);
+
+    ReadOptions opts;
+    if (options != NULL) {
+        opts = *options;
+    }
 
+    status_t err = OK;
+    size_t numBytes = 0;
+    for (uint32_t i = 0; i < maxNumBuffers && numBytes < maxBytes; ++i) {
+        MediaBufferBase *buffer = NULL;
+        err = read_l(&buffer, &opts);
+        if (i == 0) {
+            opts.clearNonPersistent();
+            opts.setNonBlocking();
+        } else if (err == WOULD_BLOCK) {
+            err = OK;
+        }
+        if (err != OK || buffer == NULL) {
+            break;
+        }
+        buffers->push_back(buffer);
+        numBytes += buffer->range_length();
+    }
+    return err;
+}
+
+status_t MPEG4Source::read_l(
+        MediaBufferBase **out, const ReadOptions *options) {
     CHECK(mStarted);
 
     if (options != nullptr && options->getNonBlocking() && !mGroup->has_buffers()) {
@@ -5009,6 +5275,261 @@ status_t MPEG4Source::read(
     }
 }
 
+status_t MPEG4Source::loadFragment(off64_t moofOffset) {
+    mCurrentMoofOffset = moofOffset;
+    mNextMoofOffset = -1;
+    mCurrentSamples.clear();
+    mCurrentSampleIndex = 0;
+    return parseChunk(&moofOffset);
+}
+
+status_t MPEG4Source::seekToSegment(int64_t seekTimeUs, ReadOptions::SeekMode mode) {
+    size_t numSegments = mSegments.size();
+    if (mSegmentStartTimesUs.size() != numSegments + 1) {
+        mSegmentStartTimesUs.clear();
+        mSegmentStartOffsets.clear();
+        int64_t totalTime = 0;
+        off64_t totalOffset = mFirstMoofOffset;
+        for (size_t i = 0; i < numSegments; i++) {
+            mSegmentStartTimesUs.push(totalTime);
+            mSegmentStartOffsets.push(totalOffset);
+            totalTime += mSegments[i].mDurationUs;
+            totalOffset += mSegments[i].mSize;
+        }
+        mSegmentStartTimesUs.push(totalTime);
+        mSegmentStartOffsets.push(totalOffset);
+    }
+
+    // First segment ending after the requested time, or the end.
+    const int64_t *starts = mSegmentStartTimesUs.array();
+    size_t i = std::upper_bound(starts + 1, starts + numSegments + 1, seekTimeUs)
+            - (starts + 1);
+    if (i < numSegments) {
+        // The requested time is somewhere in this segment
+        if ((mode == ReadOptions::SEEK_NEXT_SYNC && seekTimeUs > starts[i]) ||
+            (mode == ReadOptions::SEEK_CLOSEST_SYNC &&
+            (seekTimeUs - starts[i]) > (starts[i + 1] - seekTimeUs))) {
+            // requested next sync, or closest sync and it was closer to the end of
+            // this segment
+            ++i;
+        }
+    }
+
+    status_t err = loadFragment(mSegmentStartOffsets[i]);
+    if (err != OK) {
+        return err;
+    }
+    mCurrentTime = starts[i] * mTimescale / 1000000ll;
+    return OK;
+}
+
+void MPEG4Source::recordFragment(uint32_t time, off64_t moofOffset) {
+    if (mFragmentIndexComplete || mSegments.size() != 0) {
+        return;
+    }
+    if (mFragments.isEmpty() || (moofOffset > mFragments.top().mMoofOffset
+            && time >= mFragments.top().mTime)) {
+        FragmentEntry entry = { time, moofOffset };
+        mFragments.push(entry);
+    }
+}
+
+status_t MPEG4Source::extendFragmentIndex(uint32_t targetTime) {
+    off64_t offset = mFirstMoofOffset;
+    uint32_t time = 0;
+    if (!mFragments.isEmpty()) {
+        offset = mFragments.top().mMoofOffset;
+        time = mFragments.top().mTime;
+    }
+
+    // Walk the moofs until a fragment starting after the target is indexed,
+    // SEEK_NEXT_SYNC and SEEK_CLOSEST_SYNC need it.
+    while (!mFragmentIndexComplete
+            && (mFragments.isEmpty() || mFragments.top().mTime <= targetTime)) {
+        status_t err = loadFragment(offset);
+        if (err != OK) {
+            return err;
+        }
+        if (!mCurrentSamples.isEmpty()) {
+            recordFragment(time, offset);
+        }
+
+        uint64_t endTime = time;
+        for (size_t i = 0; i < mCurrentSamples.size(); ++i) {
+            endTime += mCurrentSamples[i].duration;
+        }
+        if (mNextMoofOffset <= offset || endTime > UINT32_MAX) {
+            mFragmentIndexComplete = true;
+            break;
+        }
+        offset = mNextMoofOffset;
+        time = endTime;
+    }
+    return OK;
+}
+
+void MPEG4Source::loadRandomAccessIndex() {
+    // A fixed size mfro box at the very end of the file gives the size of
+    // the mfra box; its tfra boxes list sync samples as (time, moof offset).
+    off64_t fileSize;
+    uint8_t mfro[16];
+    if (mDataSource->getSize(&fileSize) != OK || fileSize < (off64_t)sizeof(mfro)
+            || mDataSource->readAt(fileSize - sizeof(mfro), mfro, sizeof(mfro))
+                    != (ssize_t)sizeof(mfro)
+            || U32_AT(mfro) != sizeof(mfro) || U32_AT(&mfro[4]) != FOURCC('m', 'f', 'r', 'o')) {
+        return;
+    }
+    uint32_t mfraSize = U32_AT(&mfro[12]);
+    uint32_t hdr[2];
+    off64_t mfraOffset = fileSize - mfraSize;
+    if (mfraSize < 8 + sizeof(mfro) || mfraSize > fileSize
+            || mDataSource->readAt(mfraOffset, hdr, 8) != 8
+            || ntohl(hdr[0]) != mfraSize || ntohl(hdr[1]) != FOURCC('m', 'f', 'r', 'a')) {
+        return;
+    }
+
+    off64_t offset = mfraOffset + 8;
+    off64_t stopOffset = fileSize - sizeof(mfro);
+    while (offset + 8 <= stopOffset) {
+        if (mDataSource->readAt(offset, hdr, 8) != 8) {
+            return;
+        }
+        uint32_t boxSize = ntohl(hdr[0]);
+        if (boxSize < 8 || boxSize > stopOffset - offset) {
+            return;
+        }
+        uint8_t header[16];
+        if (ntohl(hdr[1]) != FOURCC('t', 'f', 'r', 'a') || boxSize < 8 + sizeof(header)
+                || mDataSource->readAt(offset + 8, header, sizeof(header))
+                        != (ssize_t)sizeof(header)
+                || U32_AT(&header[4]) != (uint32_t)mTrackId) {
+            offset += boxSize;
+            continue;
+        }
+
+        bool is64 = header[0] == 1;
+        uint32_t lengths = U32_AT(&header[8]);
+        size_t trafLen = ((lengths >> 4) & 3) + 1;
+        size_t trunLen = ((lengths >> 2) & 3) + 1;
+        size_t sampleLen = (lengths & 3) + 1;
+        size_t entrySize = (is64 ? 16 : 8) + trafLen + trunLen + sampleLen;
+        uint32_t numEntries = U32_AT(&header[12]);
+        if (numEntries == 0
+                || numEntries > (boxSize - 8 - sizeof(header)) / entrySize) {
+            return;
+        }
+
+        size_t tableSize = numEntries * entrySize;
+        std::unique_ptr<uint8_t[]> table(new (std::nothrow) uint8_t[tableSize]);
+        if (table == NULL || mDataSource->readAt(offset + 8 + sizeof(header),
+                table.get(), tableSize) != (ssize_t)tableSize) {
+            return;
+        }
+
+        auto readVar = [](const uint8_t *p, size_t len) {
+            uint32_t x = 0;
+            for (size_t i = 0; i < len; ++i) {
+                x = (x << 8) | p[i];
+            }
+            return x;
+        };
+
+        // Only fragments starting with a sync sample are seek targets.
+        Vector<FragmentEntry> fragments;
+        uint64_t baseTime = 0;
+        for (uint32_t i = 0; i < numEntries; ++i) {
+            const uint8_t *p = &table[i * entrySize];
+            uint64_t time = is64 ? U64_AT(p) : U32_AT(p);
+            uint64_t moofOffset = is64 ? U64_AT(p + 8) : U32_AT(p + 4);
+            p += is64 ? 16 : 8;
+            uint32_t trunNumber = readVar(p + trafLen, trunLen);
+            uint32_t sampleNumber = readVar(p + trafLen + trunLen, sampleLen);
+            if (trunNumber != 1 || sampleNumber != 1) {
+                continue;
+            }
+
+            if (fragments.isEmpty()) {
+                // Times must be relative to the first moof, like mCurrentTime.
+                if (moofOffset != (uint64_t)mFirstMoofOffset) {
+                    return;
+                }
+                baseTime = time;
+            } else if (moofOffset <= (uint64_t)fragments.top().mMoofOffset
+                    || time < baseTime + fragments.top().mTime) {
+                ALOGW("tfra is not in increasing order, ignoring it");
+                return;
+            }
+            if (time - baseTime > UINT32_MAX) {
+                break;
+            }
+            FragmentEntry entry = { (uint32_t)(time - baseTime), (off64_t)moofOffset };
+            fragments.push(entry);
+        }
+
+        if (!fragments.isEmpty()) {
+            ALOGV("using tfra with %zu fragments for track %d",
+                    fragments.size(), mTrackId);
+            mFragments = fragments;
+            mFragmentIndexComplete = true;
+        }
+        return;
+    }
+}
+
+status_t MPEG4Source::seekToFragment(int64_t seekTimeUs, ReadOptions::SeekMode mode) {
+    if (!mTriedRandomAccessIndex) {
+        mTriedRandomAccessIndex = true;
+        loadRandomAccessIndex();
+    }
+
+    uint64_t seekTime = seekTimeUs > 0 ? seekTimeUs * mTimescale / 1000000ll : 0;
+    if (seekTime > UINT32_MAX) {
+        seekTime = UINT32_MAX;
+    }
+
+    if (!mFragmentIndexComplete
+            && (mFragments.isEmpty() || mFragments.top().mTime <= seekTime)) {
+        status_t err = extendFragmentIndex(seekTime);
+        if (err != OK && mFragments.isEmpty()) {
+            return err;
+        }
+    }
+
+    if (mFragments.isEmpty()) {
+        // Nothing to seek to, start over from the first fragment.
+        status_t err = loadFragment(mFirstMoofOffset);
+        if (err != OK) {
+            return err;
+        }
+        mCurrentTime = 0;
+        return OK;
+    }
+
+    // Last fragment starting at or before the requested time.
+    const FragmentEntry *entries = mFragments.array();
+    size_t numEntries = mFragments.size();
+    size_t i = std::upper_bound(entries, entries + numEntries, seekTime,
+            [](uint64_t time, const FragmentEntry &entry) {
+                return time < entry.mTime;
+            }) - entries;
+    i = i > 0 ? i - 1 : 0;
+
+    if (i + 1 < numEntries) {
+        if ((mode == ReadOptions::SEEK_NEXT_SYNC && seekTime > entries[i].mTime) ||
+            (mode == ReadOptions::SEEK_CLOSEST_SYNC &&
+            (seekTime - entries[i].mTime) > (entries[i + 1].mTime - seekTime))) {
+            ++i;
+        }
+    }
+
+    status_t err = loadFragment(entries[i].mMoofOffset);
+    if (err != OK) {
+        return err;
+    }
+    mCurrentTime = entries[i].mTime;
+    return OK;
+}
+
 status_t MPEG4Source::fragmentedRead(
         MediaBufferBase **out, const ReadOptions *options) {
 
@@ -5024,48 +5545,10 @@ status_t MPEG4Source::fragmentedRead(
     ReadOptions::SeekMode mode;
     if (options && options->getSeekTo(&seekTimeUs, &mode)) {
 
-        int numSidxEntries = mSegments.size();
-        if (numSidxEntries != 0) {
-            int64_t totalTime = 0;
-            off64_t totalOffset = mFirstMoofOffset;
-            for (int i = 0; i < numSidxEntries; i++) {
-                const SidxEntry *se = &mSegments[i];
-                if (totalTime + se->mDurationUs > seekTimeUs) {
-                    // The requested time is somewhere in this segment
-                    if ((mode == ReadOptions::SEEK_NEXT_SYNC && seekTimeUs > totalTime) ||
-                        (mode == ReadOptions::SEEK_CLOSEST_SYNC &&
-                        (seekTimeUs - totalTime) > (totalTime + se->mDurationUs - seekTimeUs))) {
-                        // requested next sync, or closest sync and it was closer to the end of
-                        // this segment
-                        totalTime += se->mDurationUs;
-                        totalOffset += se->mSize;
-                    }
-                    break;
-                }
-                totalTime += se->mDurationUs;
-                totalOffset += se->mSize;
-            }
-            mCurrentMoofOffset = totalOffset;
-            mNextMoofOffset = -1;
-            mCurrentSamples.clear();
-            mCurrentSampleIndex = 0;
-            status_t err = parseChunk(&totalOffset);
-            if (err != OK) {
-                return err;
-            }
-            mCurrentTime = totalTime * mTimescale / 1000000ll;
-        } else {
-            // without sidx boxes, we can only seek to 0
-            mCurrentMoofOffset = mFirstMoofOffset;
-            mNextMoofOffset = -1;
-            mCurrentSamples.clear();
-            mCurrentSampleIndex = 0;
-            off64_t tmp = mCurrentMoofOffset;
-            status_t err = parseChunk(&tmp);
-            if (err != OK) {
-                return err;
-            }
-            mCurrentTime = 0;
+        status_t err = mSegments.size() != 0
+                ? seekToSegment(seekTimeUs, mode) : seekToFragment(seekTimeUs, mode);
+        if (err != OK) {
+            return err;
         }
 
         if (mBuffer != NULL) {
@@ -5100,6 +5583,7 @@ status_t MPEG4Source::fragmentedRead(
             if (mCurrentSampleIndex >= mCurrentSamples.size()) {
                 return ERROR_END_OF_STREAM;
             }
+            recordFragment(mCurrentTime, mCurrentMoofOffset);
         }
 
         const Sample *smpl = &mCurrentSamples[mCurrentSampleIndex];
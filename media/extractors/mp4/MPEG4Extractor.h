@@ -86,6 +86,9 @@ private:
         int64_t elst_media_time;
         uint64_t elst_segment_duration;
         bool subsample_encryption;
+        // HEIF image track whose meta is only read from the item table when
+        // the track is first used.
+        bool heif_meta_pending;
     };
 
     Vector<SidxEntry> mSidxEntries;
@@ -99,6 +102,7 @@ private:
 
     DataSourceBase *mDataSource;
     CachedRangedDataSource *mCachedSource;
+    bool mMoovCached;  // mCachedSource covers the whole moov box
     status_t mInitCheck;
     uint32_t mHeaderTimescale;
     bool mIsQT;
@@ -118,7 +122,9 @@ private:
     KeyedVector<uint32_t, AString> mMetaKeyMap;
 
     status_t readMetaData();
+    status_t resolveHeifTrackMeta(Track *track);
     status_t parseChunk(off64_t *offset, int depth);
+    void cacheMoov(off64_t offset, uint64_t size);
     status_t parseITunesMetaData(off64_t offset, size_t size);
     status_t parseColorInfo(off64_t offset, size_t size);
     status_t parse3GPPMetaData(off64_t offset, size_t size, int depth);
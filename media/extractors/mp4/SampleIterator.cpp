@@ -20,6 +20,8 @@
 
 #include "SampleIterator.h"
 
+#include <algorithm>
+
 #include <arpa/inet.h>
 
 #include <media/DataSourceBase.h>
@@ -75,6 +77,8 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
     }
 
     if (sampleIndex >= mStopChunkSampleIndex) {
+        seekChunkRange(sampleIndex);
+
         status_t err;
         if ((err = findChunkRange(sampleIndex)) != OK) {
             ALOGE("findChunkRange failed");
@@ -93,10 +97,13 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
         (sampleIndex - mFirstChunkSampleIndex) / mSamplesPerChunk
         + mFirstChunk;
 
-    if (!mInitialized || chunk != mCurrentChunkIndex) {
+    bool sameChunk = mInitialized && chunk == mCurrentChunkIndex;
+    if (!sameChunk) {
         status_t err;
         if ((err = getChunkOffset(chunk, &mCurrentChunkOffset)) != OK) {
             ALOGE("getChunkOffset return error");
+            // The cached chunk is gone, don't let the next seek reuse it.
+            mInitialized = false;
             return err;
         }
 
@@ -112,6 +119,7 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
                             firstChunkSampleIndex + i, &sampleSize)) != OK) {
                 ALOGE("getSampleSizeDirect return error");
                 mCurrentChunkSampleSizes.clear();
+                mInitialized = false;
                 return err;
             }
 
@@ -124,18 +132,20 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
     uint32_t chunkRelativeSampleIndex =
         (sampleIndex - mFirstChunkSampleIndex) % mSamplesPerChunk;
 
-    mCurrentSampleOffset = mCurrentChunkOffset;
-    for (uint32_t i = 0; i < chunkRelativeSampleIndex; ++i) {
-        mCurrentSampleOffset += mCurrentChunkSampleSizes[i];
+    off64_t sampleOffset;
+    if (sameChunk && chunkRelativeSampleIndex > 0
+            && mCurrentSampleIndex + 1 == sampleIndex) {
+        // Sequential advance within the chunk.
+        sampleOffset = mCurrentSampleOffset + mCurrentSampleSize;
+    } else {
+        sampleOffset = mCurrentChunkOffset;
+        for (uint32_t i = 0; i < chunkRelativeSampleIndex; ++i) {
+            sampleOffset += mCurrentChunkSampleSizes[i];
+        }
     }
 
-    mCurrentSampleSize = mCurrentChunkSampleSizes[chunkRelativeSampleIndex];
-    if (sampleIndex < mTTSSampleIndex) {
-        mTimeToSampleIndex = 0;
-        mTTSSampleIndex = 0;
-        mTTSSampleTime = 0;
-        mTTSCount = 0;
-        mTTSDuration = 0;
+    if (sampleIndex < mTTSSampleIndex || sampleIndex - mTTSSampleIndex >= mTTSCount) {
+        seekTimeToSample(sampleIndex);
     }
 
     status_t err;
@@ -145,6 +155,8 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
         return err;
     }
 
+    mCurrentSampleOffset = sampleOffset;
+    mCurrentSampleSize = mCurrentChunkSampleSizes[chunkRelativeSampleIndex];
     mCurrentSampleIndex = sampleIndex;
 
     mInitialized = true;
@@ -152,6 +164,63 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
     return OK;
 }
 
+void SampleIterator::seekChunkRange(uint32_t sampleIndex) {
+    // Last checkpoint starting at or before sampleIndex.
+    size_t k = std::upper_bound(
+            mSampleToChunkCheckpoints.array(),
+            mSampleToChunkCheckpoints.array() + mSampleToChunkCheckpoints.size(),
+            sampleIndex) - mSampleToChunkCheckpoints.array();
+    if (k == 0) {
+        return;
+    }
+    --k;
+
+    uint32_t entry = k * kCheckpointInterval;
+    if (sampleIndex >= mFirstChunkSampleIndex && entry <= mSampleToChunkIndex) {
+        // Walking on from the current entry is at least as close.
+        return;
+    }
+
+    // findChunkRange() picks up at |entry| from here.
+    mSampleToChunkIndex = entry;
+    mFirstChunkSampleIndex = mSampleToChunkCheckpoints[k];
+    mStopChunkSampleIndex = mSampleToChunkCheckpoints[k];
+}
+
+void SampleIterator::seekTimeToSample(uint32_t sampleIndex) {
+    size_t k = std::upper_bound(
+            mTimeToSampleCheckpoints.array(),
+            mTimeToSampleCheckpoints.array() + mTimeToSampleCheckpoints.size(),
+            sampleIndex,
+            [](uint32_t index, const TimeToSampleCheckpoint &checkpoint) {
+                return index < checkpoint.mSampleIndex;
+            }) - mTimeToSampleCheckpoints.array();
+
+    if (k == 0) {
+        if (sampleIndex < mTTSSampleIndex) {
+            mTimeToSampleIndex = 0;
+            mTTSSampleIndex = 0;
+            mTTSSampleTime = 0;
+            mTTSCount = 0;
+            mTTSDuration = 0;
+        }
+        return;
+    }
+    --k;
+
+    uint32_t entry = k * kCheckpointInterval;
+    if (sampleIndex >= mTTSSampleIndex && entry < mTimeToSampleIndex) {
+        return;
+    }
+
+    // findSampleTimeAndDuration() loads |entry| next.
+    mTimeToSampleIndex = entry;
+    mTTSSampleIndex = mTimeToSampleCheckpoints[k].mSampleIndex;
+    mTTSSampleTime = mTimeToSampleCheckpoints[k].mSampleTime;
+    mTTSCount = 0;
+    mTTSDuration = 0;
+}
+
 status_t SampleIterator::findChunkRange(uint32_t sampleIndex) {
     CHECK(sampleIndex >= mFirstChunkSampleIndex);
 
@@ -169,6 +238,12 @@ status_t SampleIterator::findChunkRange(uint32_t sampleIndex) {
         mSamplesPerChunk = entry->samplesPerChunk;
         mChunkDesc = entry->chunkDesc;
 
+        if (mSampleToChunkIndex % kCheckpointInterval == 0
+                && mSampleToChunkIndex / kCheckpointInterval
+                        == mSampleToChunkCheckpoints.size()) {
+            mSampleToChunkCheckpoints.push(mFirstChunkSampleIndex);
+        }
+
         if (mSampleToChunkIndex + 1 < mTable->mNumSampleToChunkOffsets) {
             mStopChunk = entry[1].startChunk;
 
@@ -322,6 +397,13 @@ status_t SampleIterator::findSampleTimeAndDuration(
         mTTSSampleIndex += mTTSCount;
         mTTSSampleTime += mTTSCount * mTTSDuration;
 
+        if (mTimeToSampleIndex % kCheckpointInterval == 0
+                && mTimeToSampleIndex / kCheckpointInterval
+                        == mTimeToSampleCheckpoints.size()) {
+            TimeToSampleCheckpoint checkpoint = { mTTSSampleIndex, mTTSSampleTime };
+            mTimeToSampleCheckpoints.push(checkpoint);
+        }
+
         mTTSCount = mTable->mTimeToSample[2 * mTimeToSampleIndex];
         mTTSDuration = mTable->mTimeToSample[2 * mTimeToSampleIndex + 1];
 
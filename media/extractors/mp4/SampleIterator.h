@@ -68,7 +68,20 @@ private:
     uint32_t mCurrentSampleTime;
     uint32_t mCurrentSampleDuration;
 
+    // Every kCheckpointInterval-th stsc and stts entry walked so far is
+    // remembered together with its first sample, so seeks restart from the
+    // nearest checkpoint instead of from the start of the table.
+    enum { kCheckpointInterval = 32 };
+    struct TimeToSampleCheckpoint {
+        uint32_t mSampleIndex;
+        uint32_t mSampleTime;
+    };
+    Vector<uint32_t> mSampleToChunkCheckpoints;
+    Vector<TimeToSampleCheckpoint> mTimeToSampleCheckpoints;
+
     void reset();
+    void seekChunkRange(uint32_t sampleIndex);
+    void seekTimeToSample(uint32_t sampleIndex);
     status_t findChunkRange(uint32_t sampleIndex);
     status_t getChunkOffset(uint32_t chunk, off64_t *offset);
     status_t findSampleTimeAndDuration(uint32_t sampleIndex, uint32_t *time, uint32_t *duration);
@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <limits>
 
 #include "SampleTable.h"
@@ -128,7 +129,8 @@ SampleTable::SampleTable(DataSourceBase *source)
       mHasTimeToSample(false),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
-      mSampleTimeEntries(NULL),
+      mSampleTimes(NULL),
+      mSampleTimeOrder(NULL),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
       mCompositionDeltaLookup(new CompositionDeltaLookup),
@@ -157,8 +159,11 @@ SampleTable::~SampleTable() {
     delete[] mCompositionTimeDeltaEntries;
     mCompositionTimeDeltaEntries = NULL;
 
-    delete[] mSampleTimeEntries;
-    mSampleTimeEntries = NULL;
+    delete[] mSampleTimes;
+    mSampleTimes = NULL;
+
+    delete[] mSampleTimeOrder;
+    mSampleTimeOrder = NULL;
 
     delete mSampleIterator;
     mSampleIterator = NULL;
@@ -598,16 +603,54 @@ status_t SampleTable::getMaxSampleSize(size_t *max_size) {
 
     *max_size = 0;
 
-    for (uint32_t i = 0; i < mNumSampleSizes; ++i) {
-        size_t sample_size;
-        status_t err = getSampleSize_l(i, &sample_size);
+    if (mNumSampleSizes == 0) {
+        return OK;
+    }
 
-        if (err != OK) {
-            return err;
+    if (mDefaultSampleSize > 0) {
+        *max_size = mDefaultSampleSize;
+        return OK;
+    }
+
+    // This runs for every track while the moov is parsed, i.e. also when only
+    // the metadata is wanted (media scanner, metadata retriever), so read the
+    // table in blocks rather than one entry at a time.
+    uint8_t buffer[kSampleSizeReadSize];
+    uint64_t tableSize = ((uint64_t)mNumSampleSizes * mSampleSizeFieldSize + 7) / 8;
+    uint32_t sampleIndex = 0;
+    for (uint64_t pos = 0; pos < tableSize;) {
+        size_t n = std::min<uint64_t>(tableSize - pos, sizeof(buffer));
+        if (mDataSource->readAt(mSampleSizeOffset + 12 + pos, buffer, n) < (ssize_t)n) {
+            return ERROR_IO;
         }
+        pos += n;
+
+        // the block size is a multiple of every field size
+        for (size_t i = 0; i < n && sampleIndex < mNumSampleSizes;) {
+            size_t sample_size;
+            switch (mSampleSizeFieldSize) {
+                case 32:
+                    sample_size = U32_AT(&buffer[i]);
+                    i += 4;
+                    break;
+                case 16:
+                    sample_size = U16_AT(&buffer[i]);
+                    i += 2;
+                    break;
+                case 8:
+                    sample_size = buffer[i];
+                    i += 1;
+                    break;
+                default:
+                    CHECK_EQ(mSampleSizeFieldSize, 4u);
+                    sample_size = (sampleIndex & 1) ? buffer[i++] & 0x0f : buffer[i] >> 4;
+                    break;
+            }
+            ++sampleIndex;
 
-        if (sample_size > *max_size) {
-            *max_size = sample_size;
+            if (sample_size > *max_size) {
+                *max_size = sample_size;
+            }
         }
     }
 
@@ -618,49 +661,38 @@ uint32_t abs_difference(uint32_t time1, uint32_t time2) {
     return time1 > time2 ? time1 - time2 : time2 - time1;
 }
 
-// static
-int SampleTable::CompareIncreasingTime(const void *_a, const void *_b) {
-    const SampleTimeEntry *a = (const SampleTimeEntry *)_a;
-    const SampleTimeEntry *b = (const SampleTimeEntry *)_b;
-
-    if (a->mCompositionTime < b->mCompositionTime) {
-        return -1;
-    } else if (a->mCompositionTime > b->mCompositionTime) {
-        return 1;
-    }
-
-    return 0;
-}
-
 void SampleTable::buildSampleEntriesTable() {
     Mutex::Autolock autoLock(mLock);
 
-    if (mSampleTimeEntries != NULL || mNumSampleSizes == 0) {
+    if (mSampleTimes != NULL || mNumSampleSizes == 0) {
         if (mNumSampleSizes == 0) {
             ALOGE("b/23247055, mNumSampleSizes(%u)", mNumSampleSizes);
         }
         return;
     }
 
-    mTotalSize += (uint64_t)mNumSampleSizes * sizeof(SampleTimeEntry);
+    mTotalSize += (uint64_t)mNumSampleSizes * sizeof(uint32_t);
     if (mTotalSize > kMaxTotalSize) {
         ALOGE("Sample entry table size would make sample table too large.\n"
               "    Requested sample entry table size = %llu\n"
               "    Eventual sample table size >= %llu\n"
               "    Allowed sample table size = %llu\n",
-              (unsigned long long)mNumSampleSizes * sizeof(SampleTimeEntry),
+              (unsigned long long)mNumSampleSizes * sizeof(uint32_t),
               (unsigned long long)mTotalSize,
               (unsigned long long)kMaxTotalSize);
         return;
     }
 
-    mSampleTimeEntries = new (std::nothrow) SampleTimeEntry[mNumSampleSizes];
-    if (!mSampleTimeEntries) {
+    uint32_t *sampleTimes = new (std::nothrow) uint32_t[mNumSampleSizes];
+    if (!sampleTimes) {
         ALOGE("Cannot allocate sample entry table with %llu entries.",
                 (unsigned long long)mNumSampleSizes);
         return;
     }
 
+    // Samples not covered by a malformed stts keep time 0, as before.
+    memset(sampleTimes, 0, mNumSampleSizes * sizeof(uint32_t));
+
     uint32_t sampleIndex = 0;
     uint32_t sampleTime = 0;
 
@@ -674,8 +706,6 @@ void SampleTable::buildSampleEntriesTable() {
                 // is well-formed, but you know... there's (gasp) malformed
                 // content out there.
 
-                mSampleTimeEntries[sampleIndex].mSampleIndex = sampleIndex;
-
                 int32_t compTimeDelta =
                     mCompositionDeltaLookup->getCompositionTimeOffset(
                             sampleIndex);
@@ -695,7 +725,7 @@ void SampleTable::buildSampleEntriesTable() {
                     compTimeDelta = 0;
                 }
 
-                mSampleTimeEntries[sampleIndex].mCompositionTime =
+                sampleTimes[sampleIndex] =
                         compTimeDelta > 0 ? sampleTime + compTimeDelta:
                                 sampleTime - (-compTimeDelta);
             }
@@ -711,8 +741,44 @@ void SampleTable::buildSampleEntriesTable() {
         }
     }
 
-    qsort(mSampleTimeEntries, mNumSampleSizes, sizeof(SampleTimeEntry),
-          CompareIncreasingTime);
+    if (std::is_sorted(sampleTimes, sampleTimes + mNumSampleSizes)) {
+        mSampleTimes = sampleTimes;
+        return;
+    }
+
+    mTotalSize += (uint64_t)mNumSampleSizes * sizeof(uint32_t);
+    if (mTotalSize > kMaxTotalSize) {
+        ALOGE("Sample order table size would make sample table too large.");
+        delete[] sampleTimes;
+        return;
+    }
+
+    uint32_t *order = new (std::nothrow) uint32_t[mNumSampleSizes];
+    uint32_t *sortedTimes = new (std::nothrow) uint32_t[mNumSampleSizes];
+    if (!order || !sortedTimes) {
+        ALOGE("Cannot allocate sample order table with %llu entries.",
+                (unsigned long long)mNumSampleSizes);
+        delete[] order;
+        delete[] sortedTimes;
+        delete[] sampleTimes;
+        return;
+    }
+
+    for (uint32_t i = 0; i < mNumSampleSizes; ++i) {
+        order[i] = i;
+    }
+    std::sort(order, order + mNumSampleSizes,
+            [sampleTimes](uint32_t a, uint32_t b) {
+                return sampleTimes[a] < sampleTimes[b]
+                        || (sampleTimes[a] == sampleTimes[b] && a < b);
+            });
+    for (uint32_t i = 0; i < mNumSampleSizes; ++i) {
+        sortedTimes[i] = sampleTimes[order[i]];
+    }
+    delete[] sampleTimes;
+
+    mSampleTimes = sortedTimes;
+    mSampleTimeOrder = order;
 }
 
 status_t SampleTable::findSampleAtTime(
@@ -720,7 +786,7 @@ status_t SampleTable::findSampleAtTime(
         uint32_t *sample_index, uint32_t flags) {
     buildSampleEntriesTable();
 
-    if (mSampleTimeEntries == NULL) {
+    if (mSampleTimes == NULL) {
         return ERROR_OUT_OF_RANGE;
     }
 
@@ -728,7 +794,7 @@ status_t SampleTable::findSampleAtTime(
         if (req_time >= mNumSampleSizes) {
             return ERROR_OUT_OF_RANGE;
         }
-        *sample_index = mSampleTimeEntries[req_time].mSampleIndex;
+        *sample_index = getSampleIndexForTimeIndex(req_time);
         return OK;
     }
 
@@ -744,7 +810,7 @@ status_t SampleTable::findSampleAtTime(
         } else if (req_time > centerTime) {
             left = center + 1;
         } else {
-            *sample_index = mSampleTimeEntries[center].mSampleIndex;
+            *sample_index = getSampleIndexForTimeIndex(center);
             return OK;
         }
     }
@@ -793,7 +859,7 @@ status_t SampleTable::findSampleAtTime(
         }
     }
 
-    *sample_index = mSampleTimeEntries[closestIndex].mSampleIndex;
+    *sample_index = getSampleIndexForTimeIndex(closestIndex);
     return OK;
 }
 
@@ -978,9 +1044,12 @@ status_t SampleTable::getMetaDataForSample(
             // Every sample is a sync sample.
             *isSyncSample = true;
         } else {
-            size_t i = (mLastSyncSampleIndex < mNumSyncSamples)
-                    && (mSyncSamples[mLastSyncSampleIndex] <= sampleIndex)
-                ? mLastSyncSampleIndex : 0;
+            size_t i = mLastSyncSampleIndex;
+            if (i >= mNumSyncSamples || mSyncSamples[i] > sampleIndex) {
+                // Seeked backwards, don't rescan from the start.
+                i = std::lower_bound(mSyncSamples, mSyncSamples + mNumSyncSamples,
+                        sampleIndex) - mSyncSamples;
+            }
 
             while (i < mNumSyncSamples && mSyncSamples[i] < sampleIndex) {
                 ++i;
@@ -99,6 +99,9 @@ private:
     // Limit the total size of all internal tables to 200MiB.
     static const size_t kMaxTotalSize = 200 * (1 << 20);
 
+    // bytes of the sample size table read at a time by getMaxSampleSize()
+    static const size_t kSampleSizeReadSize = 4096;
+
     DataSourceBase *mDataSource;
     Mutex mLock;
 
@@ -118,11 +121,12 @@ private:
     uint32_t mTimeToSampleCount;
     uint32_t* mTimeToSample;
 
-    struct SampleTimeEntry {
-        uint32_t mSampleIndex;
-        uint32_t mCompositionTime;
-    };
-    SampleTimeEntry *mSampleTimeEntries;
+    // Composition time index, sorted by increasing composition time and kept
+    // as separate columns. mSampleTimeOrder maps a position in mSampleTimes
+    // back to the sample index; it is NULL when composition order equals
+    // decoding order, which is the common case without B-frames.
+    uint32_t *mSampleTimes;
+    uint32_t *mSampleTimeOrder;
 
     int32_t *mCompositionTimeDeltaEntries;
     size_t mNumCompositionTimeDeltaEntries;
@@ -150,16 +154,18 @@ private:
     // normally we don't round
     inline uint64_t getSampleTime(
             size_t sample_index, uint64_t scale_num, uint64_t scale_den) const {
-        return (sample_index < (size_t)mNumSampleSizes && mSampleTimeEntries != NULL
+        return (sample_index < (size_t)mNumSampleSizes && mSampleTimes != NULL
                 && scale_den != 0)
-                ? (mSampleTimeEntries[sample_index].mCompositionTime * scale_num) / scale_den : 0;
+                ? (mSampleTimes[sample_index] * scale_num) / scale_den : 0;
+    }
+
+    inline uint32_t getSampleIndexForTimeIndex(uint32_t time_index) const {
+        return mSampleTimeOrder != NULL ? mSampleTimeOrder[time_index] : time_index;
     }
 
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
     int32_t getCompositionTimeOffset(uint32_t sampleIndex);
 
-    static int CompareIncreasingTime(const void *, const void *);
-
     void buildSampleEntriesTable();
 
     SampleTable(const SampleTable &);
@@ -29,6 +29,7 @@
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/avc_utils.h>
 #include <media/stagefright/foundation/ByteUtils.h>
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/MediaDefs.h>
@@ -40,6 +41,16 @@
 
 namespace android {
 
+// How much data we're reading at a time
+static const size_t kChunkSize = 65536;
+
+// Minimum distance between two entries of a track's seek index
+static const int64_t kMinSeekPointSpacingUs = 500000ll;
+
+// Maximum number of PES start times remembered while waiting for the
+// access units that begin in them
+static const size_t kMaxPendingPESOffsets = 64;
+
 struct MPEG2PSExtractor::Track : public MediaTrack, public RefBase {
     Track(MPEG2PSExtractor *extractor,
           unsigned stream_id, unsigned stream_type);
@@ -64,10 +75,19 @@ private:
     ElementaryStreamQueue *mQueue;
     sp<AnotherPacketSource> mSource;
 
+    // Time of a sync access unit -> offset of the pack to restart
+    // parsing from to get it again. Guarded by the extractor's mLock.
+    KeyedVector<int64_t, off64_t> mSeekPoints;
+    // PES start time -> offset of its pack, until its access unit is out
+    KeyedVector<int64_t, off64_t> mPESOffsets;
+
     status_t appendPESData(
             unsigned PTS_DTS_flags,
             uint64_t PTS, uint64_t DTS,
-            const uint8_t *data, size_t size);
+            const uint8_t *data, size_t size,
+            off64_t packOffset);
+    void addSeekPoint(const sp<ABuffer> &accessUnit);
+    void flush();
 
     DISALLOW_EVIL_CONSTRUCTORS(Track);
 };
@@ -100,7 +120,9 @@ MPEG2PSExtractor::MPEG2PSExtractor(DataSourceBase *source)
       mFinalResult(OK),
       mBuffer(new ABuffer(0)),
       mScanning(true),
-      mProgramStreamMapValid(false) {
+      mProgramStreamMapValid(false),
+      mPackOffset(0),
+      mSeekTrack(NULL) {
     for (size_t i = 0; i < 500; ++i) {
         if (feedMore() != OK) {
             break;
@@ -116,6 +138,19 @@ MPEG2PSExtractor::MPEG2PSExtractor(DataSourceBase *source)
         }
     }
 
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        const char *mime;
+        if (mTracks.valueAt(i)->getFormat(meta) == OK
+                && meta.findCString(kKeyMIMEType, &mime)
+                && !strncasecmp("video/", mime, 6)) {
+            mSeekTrack = mTracks.valueAt(i).get();
+            break;
+        }
+    }
+    if (mSeekTrack == NULL && mTracks.size() > 0) {
+        mSeekTrack = mTracks.valueAt(0).get();
+    }
+
     mScanning = false;
 }
 
@@ -151,47 +186,207 @@ status_t MPEG2PSExtractor::getMetaData(MetaDataBase &meta) {
 }
 
 uint32_t MPEG2PSExtractor::flags() const {
-    return CAN_PAUSE;
+    return CAN_PAUSE | CAN_SEEK_BACKWARD | CAN_SEEK_FORWARD | CAN_SEEK;
 }
 
 status_t MPEG2PSExtractor::feedMore() {
     Mutex::Autolock autoLock(mLock);
 
-    // How much data we're reading at a time
-    static const size_t kChunkSize = 8192;
+    return feedMore_l();
+}
 
+status_t MPEG2PSExtractor::feedMore_l() {
     for (;;) {
         status_t err = dequeueChunk();
 
-        if (err == -EAGAIN && mFinalResult == OK) {
-            memmove(mBuffer->base(), mBuffer->data(), mBuffer->size());
-            mBuffer->setRange(0, mBuffer->size());
+        if (err != -EAGAIN) {
+            if (err != OK) {
+                mFinalResult = err;
+            }
+            return err;
+        }
+
+        if (mFinalResult != OK) {
+            return mFinalResult;
+        }
+
+        memmove(mBuffer->base(), mBuffer->data(), mBuffer->size());
+        mBuffer->setRange(0, mBuffer->size());
+
+        if (mBuffer->size() + kChunkSize > mBuffer->capacity()) {
+            size_t newCapacity = mBuffer->capacity() + kChunkSize;
+            sp<ABuffer> newBuffer = new ABuffer(newCapacity);
+            memcpy(newBuffer->data(), mBuffer->data(), mBuffer->size());
+            newBuffer->setRange(0, mBuffer->size());
+            mBuffer = newBuffer;
+        }
+
+        ssize_t n = mDataSource->readAt(
+                mOffset, mBuffer->data() + mBuffer->size(), kChunkSize);
+
+        if (n < 0) {
+            mFinalResult = (status_t)n;
+            return mFinalResult;
+        }
 
-            if (mBuffer->size() + kChunkSize > mBuffer->capacity()) {
-                size_t newCapacity = mBuffer->capacity() + kChunkSize;
-                sp<ABuffer> newBuffer = new ABuffer(newCapacity);
-                memcpy(newBuffer->data(), mBuffer->data(), mBuffer->size());
-                newBuffer->setRange(0, mBuffer->size());
-                mBuffer = newBuffer;
+        // keep a short read at the end of the file, it still needs parsing
+        mBuffer->setRange(mBuffer->offset(), mBuffer->size() + n);
+        mOffset += n;
+
+        if (n < (ssize_t)kChunkSize) {
+            mFinalResult = ERROR_END_OF_STREAM;
+        }
+    }
+}
+
+status_t MPEG2PSExtractor::feedUntilBufferAvailable_l(
+        const sp<AnotherPacketSource> &source) {
+    status_t finalResult;
+    while (!source->hasBufferAvailable(&finalResult)) {
+        if (finalResult != OK) {
+            return finalResult;
+        }
+
+        status_t err = feedMore_l();
+        if (err != OK) {
+            source->signalEOS(err);
+        }
+    }
+
+    return OK;
+}
+
+status_t MPEG2PSExtractor::seek(
+        int64_t seekTimeUs, MediaTrack::ReadOptions::SeekMode seekMode) {
+    Mutex::Autolock autoLock(mLock);
+
+    const KeyedVector<int64_t, off64_t> &points = mSeekTrack->mSeekPoints;
+
+    // The index is only built as far as the stream has been parsed. To seek
+    // beyond that, parse on while throwing the access units away.
+    while ((points.isEmpty() || seekTimeUs > points.keyAt(points.size() - 1))
+            && mFinalResult == OK) {
+        status_t err = feedMore_l();
+        for (size_t i = 0; i < mTracks.size(); ++i) {
+            mTracks.editValueAt(i)->flush();
+        }
+        if (err != OK) {
+            break;
+        }
+    }
+
+    if (points.isEmpty()) {
+        ALOGW("No sync point to seek to; starting over.");
+        restartAt_l(0);
+        return OK;
+    }
+
+    // index of the first sync point after seekTimeUs
+    size_t lo = 0;
+    size_t hi = points.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (points.keyAt(mid) <= seekTimeUs) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t index = lo;
+
+    switch (seekMode) {
+        case MediaTrack::ReadOptions::SEEK_NEXT_SYNC:
+            if (index == points.size()
+                    || (index > 0 && points.keyAt(index - 1) == seekTimeUs)) {
+                --index;
+            }
+            break;
+        case MediaTrack::ReadOptions::SEEK_CLOSEST_SYNC:
+            if (index == points.size()
+                    || (index > 0 && seekTimeUs - points.keyAt(index - 1)
+                            <= points.keyAt(index) - seekTimeUs)) {
+                --index;
             }
+            break;
+        case MediaTrack::ReadOptions::SEEK_CLOSEST:
+            ALOGW("seekMode not supported: %d; falling back to PREVIOUS_SYNC",
+                    seekMode);
+            // fall-through
+        case MediaTrack::ReadOptions::SEEK_PREVIOUS_SYNC:
+            if (index > 0) {
+                --index;
+            }
+            break;
+        default:
+            return ERROR_UNSUPPORTED;
+    }
+
+    ALOGV("seeking to %" PRId64 " us at offset %lld for %" PRId64 " us",
+            points.keyAt(index), (long long)points.valueAt(index), seekTimeUs);
 
-            ssize_t n = mDataSource->readAt(
-                    mOffset, mBuffer->data() + mBuffer->size(), kChunkSize);
+    restartAt_l(points.valueAt(index));
 
-            if (n < (ssize_t)kChunkSize) {
-                mFinalResult = (n < 0) ? (status_t)n : ERROR_END_OF_STREAM;
-                return mFinalResult;
+    // Fast-forward to sync frame.
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        const sp<AnotherPacketSource> &source = mTracks.valueAt(i)->mSource;
+        if (source == NULL) {
+            continue;
+        }
+        while (feedUntilBufferAvailable_l(source) == OK) {
+            sp<AMessage> meta = source->getMetaAfterLastDequeued(0);
+            if (meta == NULL) {
+                return UNKNOWN_ERROR;
             }
+            int32_t sync;
+            if (meta->findInt32("isSync", &sync) && sync) {
+                break;
+            }
+            sp<ABuffer> buffer;
+            status_t err = source->dequeueAccessUnit(&buffer);
+            if (err != OK) {
+                return err;
+            }
+        }
+    }
 
-            mBuffer->setRange(mBuffer->offset(), mBuffer->size() + n);
-            mOffset += n;
-        } else if (err != OK) {
-            mFinalResult = err;
-            return err;
-        } else {
-            return OK;
+    return OK;
+}
+
+void MPEG2PSExtractor::restartAt_l(off64_t offset) {
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        mTracks.editValueAt(i)->flush();
+    }
+
+    mBuffer->setRange(0, 0);
+    mOffset = offset;
+    mPackOffset = offset;
+    mFinalResult = OK;
+}
+
+// Skips to the next pack, system header or PES start code in mBuffer,
+// leaving the bytes that could still begin one if there is none.
+bool MPEG2PSExtractor::resync() {
+    const uint8_t *data = mBuffer->data();
+    size_t size = mBuffer->size();
+
+    size_t offset = 0;
+    for (;;) {
+        const uint8_t *startCode = findStartCode(data + offset, size - offset);
+        if (startCode == NULL) {
+            offset = size - 2;
+            break;
+        }
+        offset = startCode - data;
+        if (offset + 3 >= size || data[offset + 3] >= 0xb9) {
+            break;
         }
+        ++offset;
     }
+
+    ALOGW("skipped %zu bytes looking for a start code", offset);
+    mBuffer->setRange(mBuffer->offset() + offset, size - offset);
+
+    return mBuffer->size() >= 4;
 }
 
 status_t MPEG2PSExtractor::dequeueChunk() {
@@ -199,8 +394,10 @@ status_t MPEG2PSExtractor::dequeueChunk() {
         return -EAGAIN;
     }
 
-    if (memcmp("\x00\x00\x01", mBuffer->data(), 3)) {
-        return ERROR_MALFORMED;
+    if (memcmp("\x00\x00\x01", mBuffer->data(), 3) || mBuffer->data()[3] < 0xb9) {
+        if (!resync()) {
+            return -EAGAIN;
+        }
     }
 
     unsigned chunkType = mBuffer->data()[3];
@@ -248,6 +445,8 @@ ssize_t MPEG2PSExtractor::dequeuePack() {
 
     unsigned pack_stuffing_length = mBuffer->data()[13] & 7;
 
+    mPackOffset = mOffset - mBuffer->size();
+
     return pack_stuffing_length + 14;
 }
 
@@ -563,7 +762,8 @@ ssize_t MPEG2PSExtractor::dequeuePES() {
         if (index >= 0) {
             err =
                 mTracks.editValueAt(index)->appendPESData(
-                    PTS_DTS_flags, PTS, DTS, br.data(), dataLength);
+                    PTS_DTS_flags, PTS, DTS, br.data(), dataLength,
+                    mPackOffset);
         }
 
         br.skipBits(dataLength * 8);
@@ -667,6 +867,18 @@ status_t MPEG2PSExtractor::Track::read(
         return NO_INIT;
     }
 
+    // The seek track performs seek requests for all tracks, while the
+    // others ignore them.
+    int64_t seekTimeUs;
+    ReadOptions::SeekMode seekMode;
+    if (options && options->getSeekTo(&seekTimeUs, &seekMode)
+            && mExtractor->mSeekTrack == this) {
+        status_t err = mExtractor->seek(seekTimeUs, seekMode);
+        if (err != OK) {
+            return err;
+        }
+    }
+
     status_t finalResult;
     while (!mSource->hasBufferAvailable(&finalResult)) {
         if (finalResult != OK) {
@@ -686,7 +898,8 @@ status_t MPEG2PSExtractor::Track::read(
 status_t MPEG2PSExtractor::Track::appendPESData(
         unsigned PTS_DTS_flags,
         uint64_t PTS, uint64_t /* DTS */,
-        const uint8_t *data, size_t size) {
+        const uint8_t *data, size_t size,
+        off64_t packOffset) {
     if (mQueue == NULL) {
         return OK;
     }
@@ -694,6 +907,13 @@ status_t MPEG2PSExtractor::Track::appendPESData(
     int64_t timeUs;
     if (PTS_DTS_flags == 2 || PTS_DTS_flags == 3) {
         timeUs = (PTS * 100) / 9;
+
+        if (mPESOffsets.indexOfKey(timeUs) < 0) {
+            if (mPESOffsets.size() >= kMaxPendingPESOffsets) {
+                mPESOffsets.removeItemsAt(0);
+            }
+            mPESOffsets.add(timeUs, packOffset);
+        }
     } else {
         timeUs = 0;
     }
@@ -706,6 +926,8 @@ status_t MPEG2PSExtractor::Track::appendPESData(
 
     sp<ABuffer> accessUnit;
     while ((accessUnit = mQueue->dequeueAccessUnit()) != NULL) {
+        addSeekPoint(accessUnit);
+
         if (mSource == NULL) {
             sp<MetaData> meta = mQueue->getFormat();
 
@@ -723,6 +945,43 @@ status_t MPEG2PSExtractor::Track::appendPESData(
     return OK;
 }
 
+void MPEG2PSExtractor::Track::addSeekPoint(const sp<ABuffer> &accessUnit) {
+    int64_t timeUs;
+    if (!accessUnit->meta()->findInt64("timeUs", &timeUs)) {
+        return;
+    }
+
+    int32_t sync;
+    ssize_t index = mPESOffsets.indexOfKey(timeUs);
+    if (index >= 0
+            && accessUnit->meta()->findInt32("isSync", &sync) && sync
+            && (mSeekPoints.isEmpty() || timeUs >=
+                    mSeekPoints.keyAt(mSeekPoints.size() - 1) + kMinSeekPointSpacingUs)) {
+        mSeekPoints.add(timeUs, mPESOffsets.valueAt(index));
+    }
+
+    // Any access unit starting at an earlier time is either out already or
+    // a reordered, non-sync one that won't be indexed.
+    while (!mPESOffsets.isEmpty() && mPESOffsets.keyAt(0) <= timeUs) {
+        mPESOffsets.removeItemsAt(0);
+    }
+}
+
+// Drops all data queued before a change of the read position.
+void MPEG2PSExtractor::Track::flush() {
+    mPESOffsets.clear();
+
+    if (mQueue != NULL) {
+        mQueue->clear(false /* clearFormat */);
+    }
+
+    if (mSource != NULL) {
+        sp<MetaData> format = mSource->getFormat();
+        mSource->clear();
+        mSource->setFormat(format);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 MPEG2PSExtractor::WrappedTrack::WrappedTrack(
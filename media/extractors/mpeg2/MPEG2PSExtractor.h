@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/ABase.h>
 #include <media/MediaExtractor.h>
+#include <media/MediaTrack.h>
 #include <media/stagefright/MetaDataBase.h>
 #include <utils/threads.h>
 #include <utils/KeyedVector.h>
@@ -28,6 +29,7 @@ namespace android {
 
 struct ABuffer;
 struct AMessage;
+struct AnotherPacketSource;
 struct Track;
 class String8;
 
@@ -62,12 +64,25 @@ private:
     bool mProgramStreamMapValid;
     KeyedVector<unsigned, unsigned> mStreamTypeByESID;
 
+    // Offset of the pack the data at the front of mBuffer belongs to
+    off64_t mPackOffset;
+
+    // Track whose sync points seeks go to (video if present), or NULL
+    Track *mSeekTrack;
+
     status_t feedMore();
+    status_t feedMore_l();
+    status_t feedUntilBufferAvailable_l(const sp<AnotherPacketSource> &source);
+
+    status_t seek(int64_t seekTimeUs,
+            MediaTrack::ReadOptions::SeekMode seekMode);
+    void restartAt_l(off64_t offset);
 
     status_t dequeueChunk();
     ssize_t dequeuePack();
     ssize_t dequeueSystemHeader();
     ssize_t dequeuePES();
+    bool resync();
 
     DISALLOW_EVIL_CONSTRUCTORS(MPEG2PSExtractor);
 };
@@ -110,6 +110,13 @@ protected:
         int64_t mTimeUs;
     };
 
+    // bytes read at a time while looking for the start of a page
+    static const size_t kPageProbeSize = 1024;
+    // a seek walks the pages once it has narrowed the range down to this
+    static const size_t kMaxBisectSpan = 32 * 1024;
+    static const size_t kMaxTOCSize = 8192;
+    static const int64_t kMinTOCIntervalUs = 1000000ll;
+
     DataSourceBase *mSource;
     off64_t mOffset;
     Page mCurrentPage;
@@ -132,11 +139,20 @@ protected:
     MetaDataBase mMeta;
     MetaDataBase mFileMeta;
 
+    // Pages seen so far, whether read for playback or probed by a seek,
+    // sorted by offset and at least mTOCIntervalUs apart.
     Vector<TOCEntry> mTableOfContents;
+    int64_t mTOCIntervalUs;
 
     ssize_t readPage(off64_t offset, Page *page);
     status_t findNextPage(off64_t startOffset, off64_t *pageOffset);
 
+    void addTOCEntry(off64_t pageOffset, uint64_t granulePos);
+
+    // Finds the first page at or after |lo| whose last sample is at or after
+    // |timeUs|, bisecting the byte range [lo, hi) first.
+    status_t findPageAtTime(int64_t timeUs, off64_t lo, off64_t hi, off64_t *pageOffset);
+
     virtual int64_t getTimeUsOfGranule(uint64_t granulePos) const = 0;
 
     // Extract codec format, metadata tags, and various codec specific data;
@@ -162,8 +178,6 @@ protected:
 
     status_t findPrevGranulePosition(off64_t pageOffset, uint64_t *granulePos);
 
-    void buildTableOfContents();
-
     MyOggExtractor(const MyOggExtractor &);
     MyOggExtractor &operator=(const MyOggExtractor &);
 };
@@ -311,7 +325,8 @@ MyOggExtractor::MyOggExtractor(
       mMimeType(mimeType),
       mNumHeaders(numHeaders),
       mSeekPreRollUs(seekPreRollUs),
-      mFirstDataOffset(-1) {
+      mFirstDataOffset(-1),
+      mTOCIntervalUs(kMinTOCIntervalUs) {
     mCurrentPage.mNumSegments = 0;
 
     vorbis_info_init(&mVi);
@@ -332,9 +347,11 @@ status_t MyOggExtractor::findNextPage(
         off64_t startOffset, off64_t *pageOffset) {
     *pageOffset = startOffset;
 
+    // Look for the capture pattern a block at a time rather than a byte at a
+    // time; on a network source each read may be a round trip.
+    uint8_t buffer[kPageProbeSize];
     for (;;) {
-        char signature[4];
-        ssize_t n = mSource->readAt(*pageOffset, &signature, 4);
+        ssize_t n = mSource->readAt(*pageOffset, buffer, sizeof(buffer));
 
         if (n < 4) {
             *pageOffset = 0;
@@ -342,7 +359,9 @@ status_t MyOggExtractor::findNextPage(
             return (n < 0) ? n : (status_t)ERROR_END_OF_STREAM;
         }
 
-        if (!memcmp(signature, "OggS", 4)) {
+        const uint8_t *signature = (const uint8_t *)memmem(buffer, n, "OggS", 4);
+        if (signature != NULL) {
+            *pageOffset += signature - buffer;
             if (*pageOffset > startOffset) {
                 ALOGV("skipped %lld bytes of junk to reach next frame",
                      (long long)(*pageOffset - startOffset));
@@ -351,7 +370,8 @@ status_t MyOggExtractor::findNextPage(
             return OK;
         }
 
-        ++*pageOffset;
+        // the pattern may straddle the end of the block
+        *pageOffset += n - 3;
     }
 }
 
@@ -419,7 +439,37 @@ status_t MyOggExtractor::seekToTime(int64_t timeUs) {
         timeUs = 0;
     }
 
-    if (mTableOfContents.isEmpty()) {
+    // Narrow the range to bisect down to the known pages around the target.
+    off64_t lo = mFirstDataOffset;
+    off64_t hi = -1;
+    size_t left = 0;
+    size_t right_plus_one = mTableOfContents.size();
+    while (left < right_plus_one) {
+        size_t center = left + (right_plus_one - left) / 2;
+
+        if (mTableOfContents.itemAt(center).mTimeUs < timeUs) {
+            left = center + 1;
+        } else {
+            right_plus_one = center;
+        }
+    }
+    if (left > 0) {
+        lo = mTableOfContents.itemAt(left - 1).mPageOffset;
+    }
+    if (left < mTableOfContents.size()) {
+        hi = mTableOfContents.itemAt(left).mPageOffset;
+    }
+
+    // Bisecting past the known pages is only worth it where reaching the end
+    // was cheap enough to find the duration; on a streamed source every probe
+    // may be a new request, so estimate the offset from the bitrate instead.
+    off64_t size;
+    int64_t durationUs;
+    if (hi < 0 && mMeta.findInt64(kKeyDuration, &durationUs) && mSource->getSize(&size) == OK) {
+        hi = size;
+    }
+
+    if (hi < 0) {
         // Perform approximate seeking based on avg. bitrate.
         uint64_t bps = approxBitrate();
         if (bps <= 0) {
@@ -432,33 +482,71 @@ status_t MyOggExtractor::seekToTime(int64_t timeUs) {
         return seekToOffset(pos);
     }
 
-    size_t left = 0;
-    size_t right_plus_one = mTableOfContents.size();
-    while (left < right_plus_one) {
-        size_t center = left + (right_plus_one - left) / 2;
+    off64_t pageOffset;
+    status_t err = findPageAtTime(timeUs, lo, hi, &pageOffset);
+    if (err != OK) {
+        return err;
+    }
 
-        const TOCEntry &entry = mTableOfContents.itemAt(center);
+    ALOGV("seeking to page at offset %lld (%zu pages known)",
+         (long long)pageOffset, mTableOfContents.size());
 
-        if (timeUs < entry.mTimeUs) {
-            right_plus_one = center;
-        } else if (timeUs > entry.mTimeUs) {
-            left = center + 1;
+    return seekToOffset(pageOffset);
+}
+
+status_t MyOggExtractor::findPageAtTime(
+        int64_t timeUs, off64_t lo, off64_t hi, off64_t *pageOffset) {
+    // The target page starts at or after |lo|, and at or before the first
+    // page starting at or after |hi|.
+    Page page;
+    while (hi - lo > (off64_t)kMaxBisectSpan) {
+        off64_t mid = lo + (hi - lo) / 2;
+        off64_t offset;
+        if (findNextPage(mid, &offset) != OK || offset >= hi) {
+            hi = mid;
+            continue;
+        }
+
+        // pages on which no packet ends carry no granule position
+        ssize_t n;
+        while ((n = readPage(offset, &page)) > 0 && offset < hi
+                && page.mGranulePosition == (uint64_t)-1) {
+            offset += n;
+        }
+        if (n <= 0 || offset >= hi) {
+            hi = mid;
+            continue;
+        }
+        addTOCEntry(offset, page.mGranulePosition);
+
+        if (getTimeUsOfGranule(page.mGranulePosition) < timeUs) {
+            lo = offset + n;
         } else {
-            left = center;
-            break;
+            hi = offset;
         }
     }
 
-    if (left == mTableOfContents.size()) {
-        --left;
+    // Few pages are left, walk them.
+    off64_t offset;
+    status_t err = findNextPage(lo, &offset);
+    if (err != OK) {
+        return err;
+    }
+    *pageOffset = offset;
+    ssize_t n;
+    while ((n = readPage(offset, &page)) > 0) {
+        *pageOffset = offset;
+        if (page.mGranulePosition != (uint64_t)-1) {
+            addTOCEntry(offset, page.mGranulePosition);
+            if (getTimeUsOfGranule(page.mGranulePosition) >= timeUs) {
+                break;
+            }
+        }
+        offset += n;
     }
 
-    const TOCEntry &entry = mTableOfContents.itemAt(left);
-
-    ALOGV("seeking to entry %zu / %zu at offset %lld",
-         left, mTableOfContents.size(), (long long)entry.mPageOffset);
-
-    return seekToOffset(entry.mPageOffset);
+    // past the last page: settle for it
+    return OK;
 }
 
 status_t MyOggExtractor::seekToOffset(off64_t offset) {
@@ -796,6 +884,8 @@ status_t MyOggExtractor::_readNextPacket(MediaBufferBase **out, bool calcVorbisT
             return n < 0 ? n : (status_t)ERROR_END_OF_STREAM;
         }
 
+        addTOCEntry(mOffset, mCurrentPage.mGranulePosition);
+
         // Prevent a harmless unsigned integer overflow by clamping to 0
         if (mCurrentPage.mGranulePosition >= mPrevGranulePosition) {
             mCurrentPageSamples =
@@ -866,49 +956,55 @@ status_t MyOggExtractor::init() {
         int64_t durationUs = getTimeUsOfGranule(lastGranulePosition);
 
         mMeta.setInt64(kKeyDuration, durationUs);
-
-        buildTableOfContents();
     }
 
     return OK;
 }
 
-void MyOggExtractor::buildTableOfContents() {
-    off64_t offset = mFirstDataOffset;
-    Page page;
-    ssize_t pageSize;
-    while ((pageSize = readPage(offset, &page)) > 0) {
-        mTableOfContents.push();
+void MyOggExtractor::addTOCEntry(off64_t pageOffset, uint64_t granulePos) {
+    if (mFirstDataOffset < 0 || pageOffset < mFirstDataOffset
+            || granulePos == (uint64_t)-1) {
+        return;
+    }
+    int64_t timeUs = getTimeUsOfGranule(granulePos);
 
-        TOCEntry &entry =
-            mTableOfContents.editItemAt(mTableOfContents.size() - 1);
+    size_t left = 0;
+    size_t right_plus_one = mTableOfContents.size();
+    while (left < right_plus_one) {
+        size_t center = left + (right_plus_one - left) / 2;
 
-        entry.mPageOffset = offset;
-        entry.mTimeUs = getTimeUsOfGranule(page.mGranulePosition);
+        if (mTableOfContents.itemAt(center).mPageOffset < pageOffset) {
+            left = center + 1;
+        } else {
+            right_plus_one = center;
+        }
+    }
 
-        offset += (size_t)pageSize;
+    // keep the entries spread out, and ignore pages that contradict them
+    if (left > 0 && timeUs < mTableOfContents.itemAt(left - 1).mTimeUs + mTOCIntervalUs) {
+        return;
+    }
+    if (left < mTableOfContents.size()
+            && timeUs + mTOCIntervalUs > mTableOfContents.itemAt(left).mTimeUs) {
+        return;
     }
 
-    // Limit the maximum amount of RAM we spend on the table of contents,
-    // if necessary thin out the table evenly to trim it down to maximum
-    // size.
+    TOCEntry entry;
+    entry.mPageOffset = pageOffset;
+    entry.mTimeUs = timeUs;
+    mTableOfContents.insertAt(entry, left);
 
-    static const size_t kMaxTOCSize = 8192;
+    // Limit the maximum amount of RAM we spend on the table of contents by
+    // dropping every other entry and spacing new ones twice as far apart.
     static const size_t kMaxNumTOCEntries = kMaxTOCSize / sizeof(TOCEntry);
-
-    size_t numerator = mTableOfContents.size();
-
-    if (numerator > kMaxNumTOCEntries) {
-        size_t denom = numerator - kMaxNumTOCEntries;
-
-        size_t accum = 0;
-        for (ssize_t i = mTableOfContents.size() - 1; i >= 0; --i) {
-            accum += denom;
-            if (accum >= numerator) {
-                mTableOfContents.removeAt(i);
-                accum -= numerator;
+    if (mTableOfContents.size() > kMaxNumTOCEntries) {
+        for (size_t i = mTableOfContents.size() - 1; i > 0; i -= 2) {
+            mTableOfContents.removeAt(i);
+            if (i < 2) {
+                break;
             }
         }
+        mTOCIntervalUs *= 2;
     }
 }
 
@@ -77,6 +77,10 @@ protected:
 
 private:
     static const size_t kMaxFrameSize;
+    // buffers of high resolution streams hold at least this many frames
+    static const size_t kMinFramesPerBuffer = 4096;
+    // upper limit on a buffer size requested through start()
+    static const size_t kMaxBufferSize = 1 << 20;
 
     DataSourceBase *mDataSource;
     MetaDataBase &mMeta;
@@ -90,6 +94,17 @@ private:
     MediaBufferGroup *mGroup;
     off64_t mCurrentPos;
 
+    // PCM is output as float rather than 16 bit if requested in start()
+    bool mOutputFloat;
+    size_t mBufferSize;
+    // holds the data read from sources that cannot lend it, when the
+    // conversion to the output encoding expands it
+    uint8_t *mReadBuffer;
+
+    bool isPCM() const;
+    size_t getOutputBytesPerSample() const;
+    size_t getBufferSize(size_t requestedSize) const;
+
     WAVSource(const WAVSource &);
     WAVSource &operator=(const WAVSource &);
 };
@@ -361,11 +376,15 @@ WAVSource::WAVSource(
       mOffset(offset),
       mSize(size),
       mStarted(false),
-      mGroup(NULL) {
+      mGroup(NULL),
+      mOutputFloat(false),
+      mBufferSize(0),
+      mReadBuffer(NULL) {
     CHECK(mMeta.findInt32(kKeySampleRate, &mSampleRate));
     CHECK(mMeta.findInt32(kKeyChannelCount, &mNumChannels));
 
-    mMeta.setInt32(kKeyMaxInputSize, kMaxFrameSize);
+    mBufferSize = getBufferSize(0);
+    mMeta.setInt32(kKeyMaxInputSize, mBufferSize);
 }
 
 WAVSource::~WAVSource() {
@@ -374,19 +393,79 @@ WAVSource::~WAVSource() {
     }
 }
 
-status_t WAVSource::start(MetaDataBase * /* params */) {
+bool WAVSource::isPCM() const {
+    return mWaveFormat == WAVE_FORMAT_PCM || mWaveFormat == WAVE_FORMAT_IEEE_FLOAT;
+}
+
+size_t WAVSource::getOutputBytesPerSample() const {
+    if (!isPCM()) {
+        return 1;
+    }
+    return mOutputFloat ? sizeof(float) : sizeof(int16_t);
+}
+
+size_t WAVSource::getBufferSize(size_t requestedSize) const {
+    if (!isPCM()) {
+        // 8 bit G.711 used to be read in half buffers, keep its decoder's input small
+        return mBitsPerSample == 8 ? kMaxFrameSize / 2 : kMaxFrameSize;
+    }
+
+    const size_t outputFrameSize = mNumChannels * getOutputBytesPerSample();
+    size_t bufferSize = kMaxFrameSize;
+    if (requestedSize > 0) {
+        bufferSize = requestedSize < kMaxBufferSize ? requestedSize : kMaxBufferSize;
+    } else if (bufferSize < kMinFramesPerBuffer * outputFrameSize) {
+        // small buffers mean many reads per second for high resolution streams
+        bufferSize = kMinFramesPerBuffer * outputFrameSize;
+    }
+
+    // hold only whole frames
+    bufferSize -= bufferSize % outputFrameSize;
+    return bufferSize > 0 ? bufferSize : outputFrameSize;
+}
+
+status_t WAVSource::start(MetaDataBase *params) {
     ALOGV("WAVSource::start");
 
     CHECK(!mStarted);
 
-    // some WAV files may have large audio buffers that use shared memory transfer.
-    mGroup = new MediaBufferGroup(4 /* buffers */, kMaxFrameSize);
-
-    if (mBitsPerSample == 8) {
-        // As a temporary buffer for 8->16 bit conversion.
-        mGroup->add_buffer(MediaBufferBase::Create(kMaxFrameSize));
+    // The consumer may ask for float PCM, and for the size of the buffers,
+    // e.g. to match the frame count it renders at a time.
+    int32_t pcmEncoding;
+    if (params != NULL && isPCM() && params->findInt32(kKeyPcmEncoding, &pcmEncoding)) {
+        if (pcmEncoding == kAudioEncodingPcmFloat || pcmEncoding == kAudioEncodingPcm16bit) {
+            mOutputFloat = (pcmEncoding == kAudioEncodingPcmFloat);
+            mMeta.setInt32(kKeyPcmEncoding, pcmEncoding);
+        } else {
+            ALOGW("ignoring unsupported PCM encoding %d", pcmEncoding);
+        }
+    }
+    int32_t requestedSize = 0;
+    if (params == NULL || !params->findInt32(kKeyMaxInputSize, &requestedSize)
+            || requestedSize < 0) {
+        requestedSize = 0;
+    }
+    mBufferSize = getBufferSize(requestedSize);
+    mMeta.setInt32(kKeyMaxInputSize, mBufferSize);
+
+    // Data that shrinks when converted is read into the buffer and converted
+    // in place, so make room for a full buffer's worth of it.
+    size_t capacity = mBufferSize;
+    if (isPCM()) {
+        const size_t inputBytesPerSample = mBitsPerSample >> 3;
+        const size_t maxBytesToRead =
+                mBufferSize / getOutputBytesPerSample() * inputBytesPerSample;
+        if (maxBytesToRead > capacity) {
+            capacity = maxBytesToRead;
+        } else if (maxBytesToRead < capacity) {
+            // data that grows is read aside first
+            mReadBuffer = new uint8_t[maxBytesToRead];
+        }
     }
 
+    // some WAV files may have large audio buffers that use shared memory transfer.
+    mGroup = new MediaBufferGroup(4 /* buffers */, capacity);
+
     mCurrentPos = mOffset;
 
     mStarted = true;
@@ -402,6 +481,9 @@ status_t WAVSource::stop() {
     delete mGroup;
     mGroup = NULL;
 
+    delete[] mReadBuffer;
+    mReadBuffer = NULL;
+
     mStarted = false;
 
     return OK;
@@ -447,10 +529,12 @@ status_t WAVSource::read(
         return err;
     }
 
-    // make sure that maxBytesToRead is multiple of 3, in 24-bit case
-    size_t maxBytesToRead =
-        mBitsPerSample == 8 ? kMaxFrameSize / 2 : 
-        (mBitsPerSample == 24 ? 3*(kMaxFrameSize/3): kMaxFrameSize);
+    const size_t inputBytesPerSample = mBitsPerSample >> 3;
+    size_t maxBytesToRead = mBufferSize;
+    if (isPCM()) {
+        // as many whole frames as fit into the buffer once converted
+        maxBytesToRead = mBufferSize / getOutputBytesPerSample() * inputBytesPerSample;
+    }
 
     size_t maxBytesAvailable =
         (mCurrentPos - mOffset >= (off64_t)mSize)
@@ -473,9 +557,37 @@ status_t WAVSource::read(
         maxBytesToRead -= maxBytesToRead % inputUnitFrameSize;
     }
 
-    ssize_t n = mDataSource->readAt(
-            mCurrentPos, buffer->data(),
-            maxBytesToRead);
+    // 16 bit PCM, and float PCM output as float, pass through unchanged
+    const bool convert = isPCM()
+            && !(mWaveFormat == WAVE_FORMAT_PCM && mBitsPerSample == 16 && !mOutputFloat)
+            && !(mWaveFormat == WAVE_FORMAT_IEEE_FLOAT && mOutputFloat);
+
+    ssize_t n;
+    const uint8_t *src = NULL;
+    if (convert) {
+        // Convert straight out of sources that keep the data in memory, such
+        // as mapped files. Other sources are read into the buffer and
+        // converted in place, unless the conversion expands the data.
+        n = maxBytesToRead > 0
+                ? mDataSource->borrowAt(mCurrentPos, &src, maxBytesToRead) : 0;
+        if (n > 0 && inputBytesPerSample != 3
+                && ((uintptr_t)src & (inputBytesPerSample - 1)) != 0) {
+            // samples must be aligned to be converted in place of the source
+            n = ERROR_UNSUPPORTED;
+        }
+        if (n < 0) {
+            uint8_t *dst = mReadBuffer != NULL ? mReadBuffer : (uint8_t *)buffer->data();
+            n = mDataSource->readAt(mCurrentPos, dst, maxBytesToRead);
+            src = dst;
+        }
+        if (n > 0) {
+            n -= n % (mNumChannels * inputBytesPerSample);
+        }
+    } else {
+        n = mDataSource->readAt(
+                mCurrentPos, buffer->data(),
+                maxBytesToRead);
+    }
 
     if (n <= 0) {
         buffer->release();
@@ -486,40 +598,32 @@ status_t WAVSource::read(
 
     buffer->set_range(0, n);
 
-    // TODO: add capability to return data as float PCM instead of 16 bit PCM.
-    if (mWaveFormat == WAVE_FORMAT_PCM) {
-        if (mBitsPerSample == 8) {
-            // Convert 8-bit unsigned samples to 16-bit signed.
-
-            // Create new buffer with 2 byte wide samples
-            MediaBufferBase *tmp;
-            CHECK_EQ(mGroup->acquire_buffer(&tmp), (status_t)OK);
-            tmp->set_range(0, 2 * n);
-
-            memcpy_to_i16_from_u8((int16_t *)tmp->data(), (const uint8_t *)buffer->data(), n);
-            buffer->release();
-            buffer = tmp;
-        } else if (mBitsPerSample == 24) {
-            // Convert 24-bit signed samples to 16-bit signed in place
-            const size_t numSamples = n / 3;
-
-            memcpy_to_i16_from_p24((int16_t *)buffer->data(), (const uint8_t *)buffer->data(), numSamples);
-            buffer->set_range(0, 2 * numSamples);
-        }  else if (mBitsPerSample == 32) {
-            // Convert 32-bit signed samples to 16-bit signed in place
-            const size_t numSamples = n / 4;
-
-            memcpy_to_i16_from_i32((int16_t *)buffer->data(), (const int32_t *)buffer->data(), numSamples);
-            buffer->set_range(0, 2 * numSamples);
-        }
-    } else if (mWaveFormat == WAVE_FORMAT_IEEE_FLOAT) {
-        if (mBitsPerSample == 32) {
-            // Convert 32-bit float samples to 16-bit signed in place
-            const size_t numSamples = n / 4;
-
-            memcpy_to_i16_from_float((int16_t *)buffer->data(), (const float *)buffer->data(), numSamples);
-            buffer->set_range(0, 2 * numSamples);
+    if (convert) {
+        const size_t numSamples = n / inputBytesPerSample;
+        void *dst = buffer->data();
+
+        if (mOutputFloat) {
+            if (mBitsPerSample == 8) {
+                memcpy_to_float_from_u8((float *)dst, src, numSamples);
+            } else if (mBitsPerSample == 16) {
+                memcpy_to_float_from_i16((float *)dst, (const int16_t *)src, numSamples);
+            } else if (mBitsPerSample == 24) {
+                memcpy_to_float_from_p24((float *)dst, src, numSamples);
+            } else {
+                memcpy_to_float_from_i32((float *)dst, (const int32_t *)src, numSamples);
+            }
+        } else {
+            if (mWaveFormat == WAVE_FORMAT_IEEE_FLOAT) {
+                memcpy_to_i16_from_float((int16_t *)dst, (const float *)src, numSamples);
+            } else if (mBitsPerSample == 8) {
+                memcpy_to_i16_from_u8((int16_t *)dst, src, numSamples);
+            } else if (mBitsPerSample == 24) {
+                memcpy_to_i16_from_p24((int16_t *)dst, src, numSamples);
+            } else {
+                memcpy_to_i16_from_i32((int16_t *)dst, (const int32_t *)src, numSamples);
+            }
         }
+        buffer->set_range(0, numSamples * getOutputBytesPerSample());
     }
 
     int64_t timeStampUs = 0;
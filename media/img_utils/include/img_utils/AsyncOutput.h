@@ -0,0 +1,108 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMG_UTILS_ASYNC_OUTPUT_H
+#define IMG_UTILS_ASYNC_OUTPUT_H
+
+#include <img_utils/Output.h>
+
+#include <cutils/compiler.h>
+#include <utils/Errors.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+namespace android {
+namespace img_utils {
+
+/**
+ * Output that gathers writes into fixed-size chunks and hands them to a writer
+ * thread, which passes them on to the wrapped Output in the order they were written.
+ *
+ * This lets the caller keep producing strip data (e.g. unpacking a RAW buffer in a
+ * StripSource) while earlier chunks are being written to disk, and coalesces the
+ * many small element writes done by EndianOutput into large writes.  At most
+ * maxPendingChunks chunks are queued at once; write blocks while the queue is full.
+ *
+ * Errors from the wrapped Output are returned by the next call to write, or by close.
+ */
+class ANDROID_API AsyncOutput : public Output {
+    public:
+        static const size_t DEFAULT_CHUNK_SIZE = 1 << 20; // 1MB
+        static const size_t DEFAULT_MAX_PENDING_CHUNKS = 4;
+
+        /**
+         * Wrap the given Output.  The wrapped Output must outlive this object.
+         */
+        explicit AsyncOutput(Output* out, size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                size_t maxPendingChunks = DEFAULT_MAX_PENDING_CHUNKS);
+
+        virtual ~AsyncOutput();
+
+        /**
+         * Open the wrapped Output and start the writer thread.
+         *
+         * Returns OK on success, or a negative error code.
+         */
+        virtual status_t open();
+
+        /**
+         * Queue count bytes from the given buffer, starting at the given offset.
+         *
+         * Returns OK on success, or a negative error code.
+         */
+        virtual status_t write(const uint8_t* buf, size_t offset, size_t count);
+
+        /**
+         * Write out all queued bytes, stop the writer thread, and close the
+         * wrapped Output.
+         *
+         * Returns OK on success, or a negative error code.
+         */
+        virtual status_t close();
+
+    private:
+        status_t queueChunk();
+        void writerLoop();
+
+        Output* mOutput;
+        const size_t mChunkSize;
+        const size_t mMaxPendingChunks;
+
+        // Chunk being filled by the caller
+        std::vector<uint8_t> mCurrent;
+
+        std::mutex mLock;
+        std::condition_variable mCondition;
+        // Guarded by mLock
+        std::deque<std::vector<uint8_t>> mPending;
+        std::vector<std::vector<uint8_t>> mFreeChunks;
+        bool mClosing;
+        status_t mError;
+
+        std::thread mWriter;
+        bool mOpen;
+};
+
+} /*namespace img_utils*/
+} /*namespace android*/
+
+#endif /*IMG_UTILS_ASYNC_OUTPUT_H*/
@@ -78,6 +78,9 @@ class ANDROID_API OpcodeListBuilder : public LightRefBase<OpcodeListBuilder> {
          * CFA layout must match the layout of the shading map passed into the
          * lensShadingMap parameter.
          *
+         * The serialized opcodes are cached, and reused when called again with the
+         * same parameters and lens shading map.
+         *
          * Returns OK on success, or a negative error code.
          */
         virtual status_t addGainMapsForMetadata(uint32_t lsmWidth,
@@ -197,6 +200,15 @@ class ANDROID_API OpcodeListBuilder : public LightRefBase<OpcodeListBuilder> {
 
         status_t addOpcodePreamble(uint32_t opcodeId);
 
+        status_t buildGainMapsForMetadata(uint32_t lsmWidth,
+                                          uint32_t lsmHeight,
+                                          uint32_t activeAreaTop,
+                                          uint32_t activeAreaLeft,
+                                          uint32_t activeAreaBottom,
+                                          uint32_t activeAreaRight,
+                                          CfaLayout cfa,
+                                          const float* lensShadingMap);
+
 };
 
 } /*namespace img_utils*/
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AsyncOutput"
+
+#include <img_utils/AsyncOutput.h>
+
+#include <utils/Log.h>
+
+#include <algorithm>
+
+namespace android {
+namespace img_utils {
+
+AsyncOutput::AsyncOutput(Output* out, size_t chunkSize, size_t maxPendingChunks)
+        : mOutput(out), mChunkSize(std::max<size_t>(1, chunkSize)),
+          mMaxPendingChunks(std::max<size_t>(1, maxPendingChunks)), mClosing(false),
+          mError(OK), mOpen(false) {}
+
+AsyncOutput::~AsyncOutput() {
+    if (mOpen) {
+        ALOGW("%s: Destructor called while still open.", __FUNCTION__);
+        close();
+    }
+}
+
+status_t AsyncOutput::open() {
+    if (mOpen) {
+        ALOGW("%s: Open called when already open.", __FUNCTION__);
+        return OK;
+    }
+
+    status_t res = mOutput->open();
+    if (res != OK) {
+        return res;
+    }
+
+    mCurrent.clear();
+    mCurrent.reserve(mChunkSize);
+    mPending.clear();
+    mClosing = false;
+    mError = OK;
+    mWriter = std::thread(&AsyncOutput::writerLoop, this);
+    mOpen = true;
+    return OK;
+}
+
+status_t AsyncOutput::write(const uint8_t* buf, size_t offset, size_t count) {
+    if (!mOpen) {
+        ALOGE("%s: Could not write, output not open.", __FUNCTION__);
+        return BAD_VALUE;
+    }
+
+    const uint8_t* src = buf + offset;
+    while (count > 0) {
+        size_t toCopy = std::min(count, mChunkSize - mCurrent.size());
+        mCurrent.insert(mCurrent.end(), src, src + toCopy);
+        src += toCopy;
+        count -= toCopy;
+
+        if (mCurrent.size() == mChunkSize) {
+            status_t res = queueChunk();
+            if (res != OK) {
+                return res;
+            }
+        }
+    }
+    return OK;
+}
+
+status_t AsyncOutput::close() {
+    if (!mOpen) {
+        ALOGW("%s: Close called when already closed.", __FUNCTION__);
+        return OK;
+    }
+
+    if (!mCurrent.empty()) {
+        queueChunk();
+    }
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        mClosing = true;
+    }
+    mCondition.notify_all();
+    mWriter.join();
+    mOpen = false;
+
+    status_t res = mOutput->close();
+    return (mError != OK) ? mError : res;
+}
+
+status_t AsyncOutput::queueChunk() {
+    std::unique_lock<std::mutex> l(mLock);
+    mCondition.wait(l, [this] {
+        return mPending.size() < mMaxPendingChunks || mError != OK;
+    });
+    if (mError != OK) {
+        mCurrent.clear();
+        return mError;
+    }
+
+    mPending.push_back(std::move(mCurrent));
+    if (mFreeChunks.empty()) {
+        mCurrent = std::vector<uint8_t>();
+        mCurrent.reserve(mChunkSize);
+    } else {
+        mCurrent = std::move(mFreeChunks.back());
+        mFreeChunks.pop_back();
+    }
+    l.unlock();
+    mCondition.notify_all();
+    return OK;
+}
+
+void AsyncOutput::writerLoop() {
+    std::unique_lock<std::mutex> l(mLock);
+    while (true) {
+        mCondition.wait(l, [this] { return !mPending.empty() || mClosing; });
+        if (mPending.empty()) {
+            break;
+        }
+
+        std::vector<uint8_t> chunk = std::move(mPending.front());
+        mPending.pop_front();
+        bool failed = (mError != OK);
+        l.unlock();
+
+        // Keep draining after a failure so that the producer is never left blocked
+        size_t size = chunk.size();
+        status_t res = failed ? OK : mOutput->write(chunk.data(), 0, size);
+        chunk.clear();
+
+        l.lock();
+        if (res != OK) {
+            ALOGE("%s: Write of %zu byte chunk failed: %d", __FUNCTION__, size, res);
+            mError = res;
+        }
+        mFreeChunks.push_back(std::move(chunk));
+        mCondition.notify_all();
+    }
+}
+
+} /*namespace img_utils*/
+} /*namespace android*/
@@ -19,12 +19,35 @@
 #include <inttypes.h>
 
 #include <algorithm>
+#include <mutex>
 #include <vector>
 #include <math.h>
 
 namespace android {
 namespace img_utils {
 
+namespace {
+
+/**
+ * The gain map opcodes serialized by the last successful addGainMapsForMetadata call,
+ * along with the inputs they were built from.  The lens shading map rarely changes
+ * between consecutive captures, so a burst of DNGs can reuse the opcodes as-is.
+ */
+struct GainMapCache {
+    std::mutex lock;
+    uint32_t params[7] = {};
+    std::vector<float> lensShadingMap;
+    std::vector<uint8_t> opcodes;
+    uint32_t count = 0;
+};
+
+GainMapCache& getGainMapCache() {
+    static GainMapCache cache;
+    return cache;
+}
+
+} // anonymous namespace
+
 OpcodeListBuilder::OpcodeListBuilder() : mCount(0), mOpList(), mEndianOut(&mOpList, BIG) {
     if(mEndianOut.open() != OK) {
         ALOGE("%s: Open failed.", __FUNCTION__);
@@ -60,6 +83,47 @@ status_t OpcodeListBuilder::addGainMapsForMetadata(uint32_t lsmWidth,
                                                    uint32_t activeAreaRight,
                                                    CfaLayout cfa,
                                                    const float* lensShadingMap) {
+    const uint32_t params[] = {lsmWidth, lsmHeight, activeAreaTop, activeAreaLeft,
+            activeAreaBottom, activeAreaRight, static_cast<uint32_t>(cfa)};
+    const size_t lsmMapSize = lsmWidth * lsmHeight * 4;
+    GainMapCache& cache = getGainMapCache();
+
+    {
+        std::lock_guard<std::mutex> l(cache.lock);
+        if (cache.count > 0 && std::equal(params, params + NELEMS(params), cache.params) &&
+                cache.lensShadingMap.size() == lsmMapSize &&
+                std::equal(lensShadingMap, lensShadingMap + lsmMapSize,
+                        cache.lensShadingMap.begin())) {
+            status_t err = mEndianOut.write(cache.opcodes.data(), 0, cache.opcodes.size());
+            if (err == OK) {
+                mCount += cache.count;
+            }
+            return err;
+        }
+    }
+
+    size_t startSize = mOpList.getSize();
+    uint32_t startCount = mCount;
+    status_t err = buildGainMapsForMetadata(lsmWidth, lsmHeight, activeAreaTop, activeAreaLeft,
+            activeAreaBottom, activeAreaRight, cfa, lensShadingMap);
+    if (err != OK) return err;
+
+    std::lock_guard<std::mutex> l(cache.lock);
+    std::copy(params, params + NELEMS(params), cache.params);
+    cache.lensShadingMap.assign(lensShadingMap, lensShadingMap + lsmMapSize);
+    cache.opcodes.assign(mOpList.getArray() + startSize, mOpList.getArray() + mOpList.getSize());
+    cache.count = mCount - startCount;
+    return OK;
+}
+
+status_t OpcodeListBuilder::buildGainMapsForMetadata(uint32_t lsmWidth,
+                                                     uint32_t lsmHeight,
+                                                     uint32_t activeAreaTop,
+                                                     uint32_t activeAreaLeft,
+                                                     uint32_t activeAreaBottom,
+                                                     uint32_t activeAreaRight,
+                                                     CfaLayout cfa,
+                                                     const float* lensShadingMap) {
     uint32_t activeAreaWidth = activeAreaRight - activeAreaLeft;
     uint32_t activeAreaHeight = activeAreaBottom - activeAreaTop;
     double spacingV = 1.0 / std::max(1u, lsmHeight - 1);
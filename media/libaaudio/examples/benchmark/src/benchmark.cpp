@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measure callback timing, XRuns and client CPU load of AAudio streams
+// on the MMAP EXCLUSIVE, MMAP SHARED and legacy paths.
+// Results are printed as "RESULT: {path}.{direction}.{name} = {value}" lines.
+// src/benchmark.sh also measures the round trip latency with aaudio_loopback.
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include <aaudio/AAudio.h>
+#include <aaudio/AAudioTesting.h>
+
+#include "AAudioArgsParser.h"
+#include "AAudioExampleUtils.h"
+
+// Tag for machine readable results as property = value pairs
+#define RESULT_TAG              "RESULT: "
+#define APP_VERSION             "0.1.0"
+
+// Ignore the callbacks while the stream is starting up.
+constexpr int32_t kNumCallbacksToDiscard = 50;
+// Enough for 24 frame bursts at 48000 Hz.
+constexpr int32_t kMaxCallbacksPerSecond = 2000;
+
+enum benchmark_path_t {
+    PATH_MMAP_EXCLUSIVE,
+    PATH_MMAP_SHARED,
+    PATH_LEGACY,
+    PATH_COUNT
+};
+
+static const char *getPathText(int path) {
+    switch (path) {
+        case PATH_MMAP_EXCLUSIVE:
+            return "mmap_exclusive";
+        case PATH_MMAP_SHARED:
+            return "mmap_shared";
+        case PATH_LEGACY:
+            return "legacy";
+        default:
+            return "unknown";
+    }
+}
+
+// Written only by the callback thread while the stream is running.
+struct BenchmarkData {
+    std::vector<int64_t> callbackNanos;    // CLOCK_MONOTONIC at callback entry
+    std::vector<int64_t> cpuNanos;         // callback thread CPU time at callback entry
+    std::vector<int32_t> numFrames;
+    int32_t              callbackCount = 0;
+    int32_t              bytesPerFrame = 0;
+    aaudio_result_t      error = AAUDIO_OK;
+};
+
+static aaudio_data_callback_result_t MyDataCallbackProc(
+        AAudioStream *stream,
+        void *userData,
+        void *audioData,
+        int32_t numFrames) {
+    BenchmarkData *data = (BenchmarkData *) userData;
+    const int32_t index = data->callbackCount;
+    if (index >= (int32_t) data->callbackNanos.size()) {
+        return AAUDIO_CALLBACK_RESULT_STOP;
+    }
+    data->callbackNanos[index] = getNanoseconds();
+    data->cpuNanos[index] = getNanoseconds(CLOCK_THREAD_CPUTIME_ID);
+    data->numFrames[index] = numFrames;
+    data->callbackCount = index + 1;
+
+    // Play silence. The input data is discarded.
+    if (AAudioStream_getDirection(stream) == AAUDIO_DIRECTION_OUTPUT) {
+        memset(audioData, 0, numFrames * data->bytesPerFrame);
+    }
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+static void MyErrorCallbackProc(
+        AAudioStream *stream __unused,
+        void *userData,
+        aaudio_result_t error) {
+    BenchmarkData *data = (BenchmarkData *) userData;
+    data->error = error;
+}
+
+// Return the value at the given percentile, rearranging values.
+static int64_t getPercentile(std::vector<int64_t> &values, int percent) {
+    if (values.empty()) {
+        return 0;
+    }
+    const size_t index = std::min(values.size() - 1, values.size() * percent / 100);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void printResult(const char *prefix, const char *name, double value) {
+    printf(RESULT_TAG "%s.%s = %.3f\n", prefix, name, value);
+}
+
+static void printResult(const char *prefix, const char *name, int64_t value) {
+    printf(RESULT_TAG "%s.%s = %lld\n", prefix, name, (long long) value);
+}
+
+/**
+ * Open a stream on one path, run it and print the results.
+ * @return AAUDIO_OK, or an error if the stream could not be run
+ */
+static aaudio_result_t runBenchmark(const AAudioArgsParser &argParser,
+                                    int path,
+                                    aaudio_direction_t direction) {
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "%s.%s", getPathText(path),
+             direction == AAUDIO_DIRECTION_INPUT ? "input" : "output");
+
+    AAudioParameters parameters = argParser;
+    parameters.setSharingMode(path == PATH_MMAP_EXCLUSIVE
+                              ? AAUDIO_SHARING_MODE_EXCLUSIVE
+                              : AAUDIO_SHARING_MODE_SHARED);
+    AAudio_setMMapPolicy(path == PATH_LEGACY ? AAUDIO_POLICY_NEVER : AAUDIO_POLICY_ALWAYS);
+
+    BenchmarkData data;
+    const int32_t maxCallbacks = kNumCallbacksToDiscard
+            + argParser.getDurationSeconds() * kMaxCallbacksPerSecond;
+    data.callbackNanos.resize(maxCallbacks);
+    data.cpuNanos.resize(maxCallbacks);
+    data.numFrames.resize(maxCallbacks);
+
+    AAudioStreamBuilder *builder = nullptr;
+    AAudioStream *stream = nullptr;
+    int64_t framesPerBurst = 0;
+    int32_t sampleRate = 0;
+
+    aaudio_result_t result = AAudio_createStreamBuilder(&builder);
+    if (result != AAUDIO_OK) {
+        goto finish;
+    }
+    parameters.applyParameters(builder);
+    AAudioStreamBuilder_setDirection(builder, direction);
+    AAudioStreamBuilder_setDataCallback(builder, MyDataCallbackProc, &data);
+    AAudioStreamBuilder_setErrorCallback(builder, MyErrorCallbackProc, &data);
+
+    result = AAudioStreamBuilder_openStream(builder, &stream);
+    AAudioStreamBuilder_delete(builder);
+    if (result != AAUDIO_OK) {
+        goto finish;
+    }
+    // The policy only asks for MMAP, the sharing mode may still fall back.
+    if (AAudioStream_isMMapUsed(stream) != (path != PATH_LEGACY)
+            || AAudioStream_getSharingMode(stream) != parameters.getSharingMode()) {
+        printf("%s: stream opened on another path, MMAP = %d, sharing = %s\n", prefix,
+               AAudioStream_isMMapUsed(stream),
+               getSharingModeText(AAudioStream_getSharingMode(stream)));
+        result = AAUDIO_ERROR_UNAVAILABLE;
+        goto finish;
+    }
+
+    data.bytesPerFrame = AAudioStream_getChannelCount(stream)
+            * (AAudioStream_getFormat(stream) == AAUDIO_FORMAT_PCM_I16
+               ? sizeof(int16_t) : sizeof(float));
+    sampleRate = AAudioStream_getSampleRate(stream);
+    framesPerBurst = AAudioStream_getFramesPerBurst(stream);
+    if (argParser.getNumberOfBursts() != AAUDIO_UNSPECIFIED) {
+        AAudioStream_setBufferSizeInFrames(stream,
+                                           argParser.getNumberOfBursts() * framesPerBurst);
+    }
+
+    result = AAudioStream_requestStart(stream);
+    if (result != AAUDIO_OK) {
+        goto finish;
+    }
+    sleep(argParser.getDurationSeconds());
+    result = AAudioStream_requestStop(stream);
+    if (result != AAUDIO_OK) {
+        goto finish;
+    }
+    if (data.error != AAUDIO_OK) {
+        result = data.error;
+        goto finish;
+    }
+    if (data.callbackCount <= kNumCallbacksToDiscard + 1) {
+        printf("%s: only %d callbacks\n", prefix, data.callbackCount);
+        result = AAUDIO_ERROR_TIMEOUT;
+        goto finish;
+    }
+    {
+        // Compare the time between callbacks with the time to play or record
+        // the frames passed by the previous one.
+        std::vector<int64_t> jitterNanos;
+        double sumJitterNanos = 0.0;
+        int32_t minFrames = INT32_MAX;
+        int32_t maxFrames = 0;
+        const int32_t first = kNumCallbacksToDiscard;
+        const int32_t last = data.callbackCount - 1;
+        for (int32_t i = first + 1; i <= last; i++) {
+            const int64_t expectedNanos = data.numFrames[i - 1] * NANOS_PER_SECOND / sampleRate;
+            const int64_t jitter = llabs(data.callbackNanos[i] - data.callbackNanos[i - 1]
+                                         - expectedNanos);
+            jitterNanos.push_back(jitter);
+            sumJitterNanos += jitter;
+        }
+        int64_t framesProcessed = 0;
+        for (int32_t i = first; i < last; i++) {
+            minFrames = std::min(minFrames, data.numFrames[i]);
+            maxFrames = std::max(maxFrames, data.numFrames[i]);
+            framesProcessed += data.numFrames[i];
+        }
+        const int64_t elapsedNanos = data.callbackNanos[last] - data.callbackNanos[first];
+        const int64_t cpuNanos = data.cpuNanos[last] - data.cpuNanos[first];
+        const double bursts = (double) framesProcessed / framesPerBurst;
+
+        printResult(prefix, "sample.rate", (int64_t) sampleRate);
+        printResult(prefix, "burst.frames", framesPerBurst);
+        printResult(prefix, "buffer.frames",
+                    (int64_t) AAudioStream_getBufferSizeInFrames(stream));
+        printResult(prefix, "callback.count", (int64_t) (last - first));
+        printResult(prefix, "callback.frames.min", (int64_t) minFrames);
+        printResult(prefix, "callback.frames.max", (int64_t) maxFrames);
+        printResult(prefix, "jitter.usec.mean",
+                    sumJitterNanos / jitterNanos.size() / NANOS_PER_MICROSECOND);
+        printResult(prefix, "jitter.usec.p50",
+                    (double) getPercentile(jitterNanos, 50) / NANOS_PER_MICROSECOND);
+        printResult(prefix, "jitter.usec.p99",
+                    (double) getPercentile(jitterNanos, 99) / NANOS_PER_MICROSECOND);
+        printResult(prefix, "jitter.usec.max",
+                    (double) *std::max_element(jitterNanos.begin(), jitterNanos.end())
+                    / NANOS_PER_MICROSECOND);
+        // XRuns are counted from the start, including the warm up.
+        printResult(prefix, "xrun.count", (int64_t) AAudioStream_getXRunCount(stream));
+        // CPU used by the callback thread, which also moves the data for MMAP streams.
+        printResult(prefix, "cpu.usec.per.burst",
+                    bursts > 0 ? cpuNanos / bursts / NANOS_PER_MICROSECOND : 0.0);
+        printResult(prefix, "cpu.percent",
+                    elapsedNanos > 0 ? 100.0 * cpuNanos / elapsedNanos : 0.0);
+    }
+
+finish:
+    printResult(prefix, "available", (int64_t) (result == AAUDIO_OK));
+    if (result != AAUDIO_OK) {
+        printf("%s: ERROR %d = %s\n", prefix, result, AAudio_convertResultToText(result));
+    }
+    if (stream != nullptr) {
+        AAudioStream_close(stream);
+    }
+    return result;
+}
+
+static void usage() {
+    printf("Usage: aaudio_benchmark [OPTION]...\n\n");
+    AAudioArgsParser::usage();
+    printf("      -I                measure input streams instead of output streams\n");
+    printf("      -t{paths}         paths to measure, default is esl\n");
+    printf("          e for MMAP EXCLUSIVE\n");
+    printf("          s for MMAP SHARED\n");
+    printf("          l for legacy\n");
+    printf("      The -m and -x options are ignored, each path sets them.\n");
+    printf("Example:  aaudio_benchmark -s10 -n2 -tes\n");
+}
+
+int main(int argc, const char **argv)
+{
+    AAudioArgsParser argParser;
+    aaudio_direction_t direction = AAUDIO_DIRECTION_OUTPUT;
+    bool paths[PATH_COUNT] = {true, true, true};
+    int failures = 0;
+
+    // Make printf print immediately so that debug info is not stuck
+    // in a buffer if we hang or crash.
+    setvbuf(stdout, NULL, _IONBF, (size_t) 0);
+
+    printf("%s - AAudio benchmark V" APP_VERSION "\n", argv[0]);
+
+    // MMAP needs low latency, so make it the default.
+    argParser.setPerformanceMode(AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (argParser.parseArg(arg)) {
+            // Handle options that are not handled by the ArgParser
+            if (arg[0] == '-') {
+                char option = arg[1];
+                switch (option) {
+                    case 'I':
+                        direction = AAUDIO_DIRECTION_INPUT;
+                        break;
+                    case 't':
+                        std::fill(paths, paths + PATH_COUNT, false);
+                        for (const char *c = &arg[2]; *c != '\0'; c++) {
+                            switch (*c) {
+                                case 'e':
+                                    paths[PATH_MMAP_EXCLUSIVE] = true;
+                                    break;
+                                case 's':
+                                    paths[PATH_MMAP_SHARED] = true;
+                                    break;
+                                case 'l':
+                                    paths[PATH_LEGACY] = true;
+                                    break;
+                                default:
+                                    usage();
+                                    exit(EXIT_FAILURE);
+                            }
+                        }
+                        break;
+                    default:
+                        usage();
+                        exit(EXIT_FAILURE);
+                        break;
+                }
+            } else {
+                usage();
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    printf(RESULT_TAG "benchmark.version = " APP_VERSION "\n");
+    for (int path = 0; path < PATH_COUNT; path++) {
+        if (paths[path] && runBenchmark(argParser, path, direction) != AAUDIO_OK) {
+            failures++;
+        }
+    }
+    AAudio_setMMapPolicy(AAUDIO_UNSPECIFIED);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,39 @@
+#!/system/bin/sh
+# Benchmark AAudio on the MMAP EXCLUSIVE, MMAP SHARED and legacy paths.
+# Measures callback jitter, XRuns and client CPU per burst with aaudio_benchmark,
+# for output and input, then the round trip latency with aaudio_loopback.
+# The round trip needs a loopback dongle or cable, skip it with NO_LOOPBACK=1.
+#
+# To run the script, enter these commands once:
+#    adb push benchmark.sh /data/
+# For each run:
+#    adb shell sh /data/benchmark.sh
+#    adb pull /data/benchmark_report.txt
+#
+# Every line of the report is "{path}.{direction}.{name} = {value}",
+# for example "mmap_shared.output.jitter.usec.p99 = 312.500".
+# Paths that cannot be opened report "{path}.{direction}.available = 0".
+
+BENCHMARK=/data/nativetest/aaudio_benchmark/aaudio_benchmark
+LOOPBACK=/data/nativetest/aaudio_loopback/aaudio_loopback
+REPORT=/data/benchmark_report.txt
+SECONDS_PER_TEST=10
+OPTIONS="-pl -n2"
+
+results() {
+    # Keep only machine readable results, with an optional prefix.
+    grep "^RESULT: " | sed -e "s/^RESULT: /$1/"
+}
+
+rm -f ${REPORT}
+${BENCHMARK} ${OPTIONS} -s${SECONDS_PER_TEST} | results >> ${REPORT}
+${BENCHMARK} ${OPTIONS} -s${SECONDS_PER_TEST} -I | results >> ${REPORT}
+
+if [ -z "${NO_LOOPBACK}" ]; then
+    # aaudio_loopback selects the path with the MMAP policy and the sharing modes.
+    ${LOOPBACK} ${OPTIONS} -Pl -te -m3 -x -X | results "mmap_exclusive.loopback." >> ${REPORT}
+    ${LOOPBACK} ${OPTIONS} -Pl -te -m3       | results "mmap_shared.loopback."    >> ${REPORT}
+    ${LOOPBACK} ${OPTIONS} -Pl -te -m1       | results "legacy.loopback."         >> ${REPORT}
+fi
+
+cat ${REPORT}
@@ -708,6 +708,12 @@ int32_t AudioStreamInternal::getBufferSize() const {
     return mAudioEndpoint.getBufferSizeInFrames();
 }
 
+int32_t AudioStreamInternal::getRecommendedBufferSize() const {
+    int32_t recommendedFrames = mClockModel.getRecommendedBufferSizeInFrames();
+    int32_t maximumSize = getBufferCapacity();
+    return (recommendedFrames > maximumSize) ? maximumSize : recommendedFrames;
+}
+
 int32_t AudioStreamInternal::getBufferCapacity() const {
     return mAudioEndpoint.getBufferCapacityInFrames();
 }
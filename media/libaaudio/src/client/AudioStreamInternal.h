@@ -65,6 +65,26 @@ public:
 
     int32_t getBufferSize() const override;
 
+    /**
+     * @return the smallest buffer size that covers the jitter of the timestamps
+     *         measured so far, within the capacity
+     */
+    int32_t getRecommendedBufferSize() const;
+
+    /**
+     * @return true once enough timestamps were received for getRecommendedBufferSize()
+     */
+    bool isRecommendedBufferSizeKnown() const {
+        return mClockModel.isJitterKnown();
+    }
+
+    /**
+     * @return the estimated lateness of the timestamps from the service or the HAL
+     */
+    int64_t getJitterNanos() const {
+        return mClockModel.getJitterNanos();
+    }
+
     int32_t getBufferCapacity() const override;
 
     int32_t getFramesPerBurst() const override;
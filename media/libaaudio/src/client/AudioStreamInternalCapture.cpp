@@ -162,6 +162,20 @@ aaudio_result_t AudioStreamInternalCapture::readNowWithConversion(void *buffer,
 
     mAudioEndpoint.getFullFramesAvailable(&wrappingBuffer);
 
+    if (mFrameConsumer != nullptr && !needsFormatConversion()) {
+        int32_t framesAvailable = 0;
+        for (int partIndex = 0; partIndex < WrappingBuffer::SIZE; partIndex++) {
+            framesAvailable += std::max(0, wrappingBuffer.numFrames[partIndex]);
+        }
+        int32_t framesProcessed = std::min(numFrames, framesAvailable);
+        if (framesProcessed > 0) {
+            // The frames stay valid until the read index is advanced.
+            mFrameConsumer->onFramesCaptured(wrappingBuffer, framesProcessed);
+            mAudioEndpoint.advanceReadIndex(framesProcessed);
+        }
+        return framesProcessed;
+    }
+
     // Read data in one or two parts.
     for (int partIndex = 0; framesLeft > 0 && partIndex < WrappingBuffer::SIZE; partIndex++) {
         int32_t framesToProcess = framesLeft;
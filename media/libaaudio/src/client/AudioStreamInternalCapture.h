@@ -27,6 +27,21 @@ using android::IAAudioService;
 
 namespace aaudio {
 
+/**
+ * Receives captured frames where they lie in the MMAP buffer, so that they can be
+ * passed on without being copied into an intermediate buffer first.
+ */
+class CaptureFrameConsumer {
+public:
+    virtual ~CaptureFrameConsumer() = default;
+
+    /**
+     * @param parts one or two contiguous regions holding the frames, in order
+     * @param numFrames total number of frames, which may be less than the regions hold
+     */
+    virtual void onFramesCaptured(const android::WrappingBuffer &parts, int32_t numFrames) = 0;
+};
+
 class AudioStreamInternalCapture : public AudioStreamInternal {
 public:
     AudioStreamInternalCapture(AAudioServiceInterface  &serviceInterface, bool inService = false);
@@ -44,6 +59,22 @@ public:
     aaudio_direction_t getDirection() const override {
         return AAUDIO_DIRECTION_INPUT;
     }
+
+    /**
+     * @return true if read() converts the data from the device format
+     */
+    bool needsFormatConversion() const {
+        return getDeviceFormat() != getFormat();
+    }
+
+    /**
+     * While set, and if no format conversion is needed, read() hands the frames to
+     * the consumer in place and leaves the caller's buffer untouched.
+     * Must not be changed while a read() is in progress.
+     */
+    void setFrameConsumer(CaptureFrameConsumer *consumer) {
+        mFrameConsumer = consumer;
+    }
 protected:
 
     void advanceClientToMatchServerPosition() override;
@@ -70,6 +101,8 @@ private:
     aaudio_result_t readNowWithConversion(void *buffer, int32_t numFrames);
 
     int64_t       mLastFramesWritten = 0; // used to prevent retrograde motion
+
+    CaptureFrameConsumer *mFrameConsumer = nullptr;
 };
 
 } /* namespace aaudio */
@@ -19,6 +19,7 @@
 #include <log/log.h>
 
 #include <stdint.h>
+#include <string.h>
 
 #include "utility/AudioClock.h"
 #include "IsochronousClockModel.h"
@@ -34,7 +35,10 @@ IsochronousClockModel::IsochronousClockModel()
         , mFramesPerBurst(64)
         , mMaxLatenessInNanos(0)
         , mState(STATE_STOPPED)
+        , mLatenessCount(0)
+        , mJitterNanos(0)
 {
+    resetLateness();
 }
 
 IsochronousClockModel::~IsochronousClockModel() {
@@ -102,6 +106,7 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
         }
         break;
     case STATE_RUNNING:
+        addLateness(nanosDelta - expectedNanosDelta);
         if (nanosDelta < expectedNanosDelta) {
             // Earlier than expected timestamp.
             // This data is probably more accurate so use it.
@@ -126,19 +131,80 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
 
 void IsochronousClockModel::setSampleRate(int32_t sampleRate) {
     mSampleRate = sampleRate;
-    update();
+    resetLateness(); // the histogram bins depend on the burst duration
 }
 
 void IsochronousClockModel::setFramesPerBurst(int32_t framesPerBurst) {
     mFramesPerBurst = framesPerBurst;
-    update();
+    resetLateness();
 }
 
 void IsochronousClockModel::update() {
     int64_t nanosLate = convertDeltaPositionToTime(mFramesPerBurst); // uses mSampleRate
+    // Once the jitter is known, tolerate it rather than moving the model for every
+    // timestamp that is late by more than a burst.
+    if (isJitterKnown() && mJitterNanos > nanosLate) {
+        nanosLate = mJitterNanos;
+    }
     mMaxLatenessInNanos = (nanosLate > MIN_LATENESS_NANOS) ? nanosLate : MIN_LATENESS_NANOS;
 }
 
+void IsochronousClockModel::resetLateness() {
+    memset(mLatenessHistogram, 0, sizeof(mLatenessHistogram));
+    mLatenessCount = 0;
+    mJitterNanos = convertDeltaPositionToTime(mFramesPerBurst);
+    update();
+}
+
+void IsochronousClockModel::addLateness(int64_t nanosLate) {
+    const int64_t nanosPerBurst = convertDeltaPositionToTime(mFramesPerBurst);
+    if (nanosPerBurst <= 0) {
+        return;
+    }
+    int64_t bin = (nanosLate > 0) ? (nanosLate * kLatenessBinsPerBurst) / nanosPerBurst : 0;
+    if (bin >= kLatenessBins) {
+        bin = kLatenessBins - 1;
+    }
+    mLatenessHistogram[bin]++;
+    if (++mLatenessCount >= kLatenessMaxCount) {
+        mLatenessCount = 0;
+        for (int32_t &count : mLatenessHistogram) {
+            count /= 2;
+            mLatenessCount += count;
+        }
+    }
+    if (!isJitterKnown()) {
+        return;
+    }
+
+    // upper edge of the bin holding the percentile
+    const int32_t threshold = (mLatenessCount * kJitterPercentile + 99) / 100;
+    int32_t sum = 0;
+    int32_t percentileBin = 0;
+    for (; percentileBin < kLatenessBins - 1; percentileBin++) {
+        sum += mLatenessHistogram[percentileBin];
+        if (sum >= threshold) {
+            break;
+        }
+    }
+    mJitterNanos = ((percentileBin + 1) * nanosPerBurst) / kLatenessBinsPerBurst;
+    update();
+}
+
+int64_t IsochronousClockModel::getJitterNanos() const {
+    return mJitterNanos;
+}
+
+int32_t IsochronousClockModel::getRecommendedBufferSizeInFrames() const {
+    const int64_t nanosPerBurst = convertDeltaPositionToTime(mFramesPerBurst);
+    if (nanosPerBurst <= 0) {
+        return mFramesPerBurst;
+    }
+    // one burst in transfer, plus enough whole bursts to cover the jitter
+    const int64_t jitterBursts = (mJitterNanos + nanosPerBurst - 1) / nanosPerBurst;
+    return (int32_t) ((1 + jitterBursts) * mFramesPerBurst);
+}
+
 int64_t IsochronousClockModel::convertDeltaPositionToTime(int64_t framesDelta) const {
     return (AAUDIO_NANOS_PER_SECOND * framesDelta) / mSampleRate;
 }
@@ -186,4 +252,5 @@ void IsochronousClockModel::dump() const {
     ALOGD("mFramesPerBurst      = %6d", mFramesPerBurst);
     ALOGD("mMaxLatenessInNanos  = %6d", mMaxLatenessInNanos);
     ALOGD("mState               = %6d", mState);
+    ALOGD("mJitterNanos         = %6d%s", (int) mJitterNanos, isJitterKnown() ? "" : " (default)");
 }
@@ -90,6 +90,29 @@ public:
      */
     int64_t convertDeltaTimeToPosition(int64_t nanosDelta) const;
 
+    /**
+     * The lateness of the timestamps relative to the model is learned while running.
+     * Older timestamps are progressively forgotten so that this follows the current load.
+     *
+     * @return true if enough timestamps were received to estimate the jitter
+     */
+    bool isJitterKnown() const {
+        return mLatenessCount >= kLatenessMinCount;
+    }
+
+    /**
+     * @return the lateness of 99% of the recent timestamps, or one burst until it is known
+     */
+    int64_t getJitterNanos() const;
+
+    /**
+     * The smallest buffer that covers one burst plus the jitter of the timestamps,
+     * in whole bursts.
+     *
+     * @return recommended buffer size in frames
+     */
+    int32_t getRecommendedBufferSizeInFrames() const;
+
     void dump() const;
 
 private:
@@ -100,6 +123,15 @@ private:
         STATE_RUNNING
     };
 
+    // Histogram of the lateness, up to 4 bursts in bins of an eighth of a burst.
+    // The last bin also counts anything later.
+    static constexpr int32_t kLatenessBinsPerBurst = 8;
+    static constexpr int32_t kLatenessBins = 4 * kLatenessBinsPerBurst;
+    // All counts are halved when they reach this total.
+    static constexpr int32_t kLatenessMaxCount = 1024;
+    static constexpr int32_t kLatenessMinCount = 64;
+    static constexpr int32_t kJitterPercentile = 99;
+
     int64_t             mMarkerFramePosition;
     int64_t             mMarkerNanoTime;
     int32_t             mSampleRate;
@@ -107,7 +139,14 @@ private:
     int32_t             mMaxLatenessInNanos;
     clock_model_state_t mState;
 
+    int32_t             mLatenessHistogram[kLatenessBins];
+    int32_t             mLatenessCount;     // sum of mLatenessHistogram
+    int64_t             mJitterNanos;       // cached getJitterNanos()
+
     void update();
+
+    void resetLateness();
+    void addLateness(int64_t nanosLate);
 };
 
 } /* namespace aaudio */
@@ -27,6 +27,7 @@
 #include "FifoControllerBase.h"
 #include "FifoController.h"
 #include "FifoControllerIndirect.h"
+#include "FifoControllerMultiWriter.h"
 #include "FifoBuffer.h"
 
 using namespace android; // TODO just import names needed
@@ -69,6 +70,29 @@ FifoBuffer::FifoBuffer( int32_t   bytesPerFrame,
     mStorageOwned = false;
 }
 
+FifoBuffer::FifoBuffer( int32_t   bytesPerFrame,
+                        fifo_frames_t   capacityInFrames,
+                        fifo_counter_t *  readIndexAddress,
+                        fifo_counter_t *  writeIndexAddress,
+                        fifo_counter_t *  reserveIndexAddress,
+                        void *  dataStorageAddress
+                        )
+        : mFrameCapacity(capacityInFrames)
+        , mBytesPerFrame(bytesPerFrame)
+        , mStorage(static_cast<uint8_t *>(dataStorageAddress))
+        , mFramesReadCount(0)
+        , mFramesUnderrunCount(0)
+        , mUnderrunCount(0)
+{
+    mMultiWriterFifo = new FifoControllerMultiWriter(capacityInFrames,
+                                                     capacityInFrames,
+                                                     readIndexAddress,
+                                                     writeIndexAddress,
+                                                     reserveIndexAddress);
+    mFifo = mMultiWriterFifo;
+    mStorageOwned = false;
+}
+
 FifoBuffer::~FifoBuffer() {
     if (mStorageOwned) {
         delete[] mStorage;
@@ -154,12 +178,33 @@ fifo_frames_t FifoBuffer::read(void *buffer, fifo_frames_t numFrames) {
 
 fifo_frames_t FifoBuffer::write(const void *buffer, fifo_frames_t numFrames) {
     WrappingBuffer wrappingBuffer;
+    getEmptyRoomAvailable(&wrappingBuffer);
+    fifo_frames_t framesWritten = copyToWrappingBuffer(wrappingBuffer, buffer, numFrames);
+    mFifo->advanceWriteIndex(framesWritten);
+    return framesWritten;
+}
+
+fifo_frames_t FifoBuffer::writeAtomically(const void *buffer, fifo_frames_t numFrames) {
+    if (mMultiWriterFifo == nullptr || numFrames <= 0) {
+        return 0;
+    }
+    fifo_counter_t counter = mMultiWriterFifo->reserveWrite(numFrames);
+    if (counter < 0) {
+        return 0;
+    }
+    WrappingBuffer wrappingBuffer;
+    fillWrappingBuffer(&wrappingBuffer, numFrames, (fifo_frames_t) (counter % mFrameCapacity));
+    copyToWrappingBuffer(wrappingBuffer, buffer, numFrames);
+    mMultiWriterFifo->commitWrite(counter, numFrames);
+    return numFrames;
+}
+
+fifo_frames_t FifoBuffer::copyToWrappingBuffer(const WrappingBuffer &wrappingBuffer,
+                                               const void *buffer, fifo_frames_t numFrames) {
     uint8_t *source = (uint8_t *) buffer;
     fifo_frames_t framesLeft = numFrames;
 
-    getEmptyRoomAvailable(&wrappingBuffer);
-
-    // Read data in one or two parts.
+    // Write data in one or two parts.
     int partIndex = 0;
     while (framesLeft > 0 && partIndex < WrappingBuffer::SIZE) {
         fifo_frames_t framesToWrite = framesLeft;
@@ -178,9 +223,7 @@ fifo_frames_t FifoBuffer::write(const void *buffer, fifo_frames_t numFrames) {
         }
         partIndex++;
     }
-    fifo_frames_t framesWritten = numFrames - framesLeft;
-    mFifo->advanceWriteIndex(framesWritten);
-    return framesWritten;
+    return numFrames - framesLeft;
 }
 
 fifo_frames_t FifoBuffer::readNow(void *buffer, fifo_frames_t numFrames) {
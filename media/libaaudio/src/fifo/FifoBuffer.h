@@ -23,6 +23,8 @@
 
 namespace android {
 
+class FifoControllerMultiWriter;
+
 /**
  * Structure that represents a region in a circular buffer that might be at the
  * end of the array and split in two.
@@ -45,6 +47,17 @@ public:
                fifo_counter_t *writeCounterAddress,
                void *dataStorageAddress);
 
+    /**
+     * FIFO in shared memory that several writers may use at once with writeAtomically().
+     * See FifoControllerMultiWriter.
+     */
+    FifoBuffer(int32_t bytesPerFrame,
+               fifo_frames_t capacityInFrames,
+               fifo_counter_t *readCounterAddress,
+               fifo_counter_t *writeCounterAddress,
+               fifo_counter_t *reserveCounterAddress,
+               void *dataStorageAddress);
+
     ~FifoBuffer();
 
     int32_t convertFramesToBytes(fifo_frames_t frames);
@@ -53,6 +66,15 @@ public:
 
     fifo_frames_t write(const void *source, fifo_frames_t framesToWrite);
 
+    /**
+     * Write all of the frames or none of them, for example a whole burst, so that the
+     * reader never sees a partial block from one writer interleaved with another.
+     * Only for a FIFO constructed with a reserve counter, other writers may call this
+     * at the same time but must not call write().
+     * @return framesToWrite, or 0 if there is not enough room
+     */
+    fifo_frames_t writeAtomically(const void *source, fifo_frames_t framesToWrite);
+
     fifo_frames_t getThreshold();
 
     void setThreshold(fifo_frames_t threshold);
@@ -121,11 +143,16 @@ private:
     void fillWrappingBuffer(WrappingBuffer *wrappingBuffer,
                             int32_t framesAvailable, int32_t startIndex);
 
+    // copy up to numFrames into the parts of wrappingBuffer, return frames copied
+    fifo_frames_t copyToWrappingBuffer(const WrappingBuffer &wrappingBuffer,
+                                       const void *buffer, fifo_frames_t numFrames);
+
     const fifo_frames_t mFrameCapacity;
     const int32_t mBytesPerFrame;
     uint8_t *mStorage;
     bool mStorageOwned; // did this object allocate the storage?
     FifoControllerBase *mFifo;
+    FifoControllerMultiWriter *mMultiWriterFifo = nullptr; // same as mFifo, if multi-writer
     fifo_counter_t mFramesReadCount;
     fifo_counter_t mFramesUnderrunCount;
     int32_t mUnderrunCount; // need? just use frames
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIFO_FIFO_CONTROLLER_MULTI_WRITER_H
+#define FIFO_FIFO_CONTROLLER_MULTI_WRITER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <sched.h>
+
+#include "FifoControllerIndirect.h"
+
+namespace android {
+
+/**
+ * A FifoControllerIndirect that several threads or processes may write to at once.
+ *
+ * A writer claims a span of frames with reserveWrite(), fills it, then publishes it
+ * with commitWrite(). The write counter seen by the single reader only advances over
+ * committed spans, in reservation order, so a writer may wait in commitWrite() for an
+ * earlier one. A writer must therefore commit every span it reserved, without blocking
+ * in between. advanceWriteIndex() must not be used on this FIFO.
+ */
+class FifoControllerMultiWriter : public FifoControllerIndirect {
+
+public:
+    FifoControllerMultiWriter(fifo_frames_t capacity,
+                              fifo_frames_t threshold,
+                              fifo_counter_t * readCounterAddress,
+                              fifo_counter_t * writeCounterAddress,
+                              fifo_counter_t * reserveCounterAddress)
+        : FifoControllerIndirect(capacity, threshold, readCounterAddress, writeCounterAddress)
+        , mReserveCounterAddress((std::atomic<fifo_counter_t> *) reserveCounterAddress)
+    {
+        mReserveCounterAddress->store(0, std::memory_order_relaxed);
+    }
+    virtual ~FifoControllerMultiWriter() {};
+
+    /**
+     * Reserve all of numFrames or nothing.
+     * @return counter of the first frame reserved, or -1 if there is not enough room
+     */
+    fifo_counter_t reserveWrite(fifo_frames_t numFrames) {
+        fifo_counter_t reserved = mReserveCounterAddress->load(std::memory_order_relaxed);
+        do {
+            const fifo_frames_t empty =
+                    (fifo_frames_t) (getThreshold() - (reserved - getReadCounter()));
+            if (numFrames > empty) {
+                return -1;
+            }
+        } while (!mReserveCounterAddress->compare_exchange_weak(reserved, reserved + numFrames,
+                std::memory_order_relaxed));
+        return reserved;
+    }
+
+    /**
+     * Publish frames reserved by reserveWrite() once they are written.
+     * @param counter returned by reserveWrite()
+     * @param numFrames passed to reserveWrite()
+     */
+    void commitWrite(fifo_counter_t counter, fifo_frames_t numFrames) {
+        // wait for the writers that reserved before us
+        while (getWriteCounter() != counter) {
+            sched_yield();
+        }
+        setWriteCounter(counter + numFrames);
+    }
+
+private:
+    std::atomic<fifo_counter_t> * mReserveCounterAddress;
+};
+
+}  // android
+
+#endif //FIFO_FIFO_CONTROLLER_MULTI_WRITER_H
@@ -18,6 +18,8 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
+#include <inttypes.h>
 #include <stdint.h>
 
 #include <aaudio/AAudio.h>
@@ -28,6 +30,7 @@
 
 #include "core/AudioStream.h"
 #include "legacy/AudioStreamLegacy.h"
+#include "utility/AudioClock.h"
 
 using namespace android;
 using namespace aaudio;
@@ -103,6 +106,8 @@ void AudioStreamLegacy::processCallbackCommon(aaudio_callback_operation_t opcode
                     return;
                 }
 
+                const int64_t startNanos = AudioClock::getNanoseconds();
+
                 // If the caller specified an exact size then use a block size adapter.
                 if (mBlockAdapter != nullptr) {
                     int32_t byteCount = audioBuffer->frameCount * getBytesPerDeviceFrame();
@@ -113,6 +118,7 @@ void AudioStreamLegacy::processCallbackCommon(aaudio_callback_operation_t opcode
                     callbackResult = callDataCallbackFrames((uint8_t *)audioBuffer->raw,
                                                             audioBuffer->frameCount);
                 }
+                updateCallbackTimingStats(startNanos, AudioClock::getNanoseconds());
                 if (callbackResult == AAUDIO_CALLBACK_RESULT_CONTINUE) {
                     audioBuffer->size = audioBuffer->frameCount * getBytesPerDeviceFrame();
                 } else { // STOP or invalid result
@@ -142,6 +148,52 @@ void AudioStreamLegacy::processCallbackCommon(aaudio_callback_operation_t opcode
     }
 }
 
+int32_t AudioStreamLegacy::chooseCallbackBlockFrames(bool hasCallback, bool isFast) {
+    if (mCallbackBufferSize != AAUDIO_UNSPECIFIED) {
+        return mCallbackBufferSize;
+    }
+    // The FAST mixer runs once per burst. Feeding it in whole bursts keeps the
+    // app from being called with the odd sizes left over at the buffer wrap.
+    if (hasCallback && isFast && getFramesPerBurst() > 0) {
+        return getFramesPerBurst();
+    }
+    return AAUDIO_UNSPECIFIED;
+}
+
+void AudioStreamLegacy::resetCallbackTimingStats() {
+    mCallbackCount = 0;
+    mLastCallbackNanos = 0;
+    mMinCallbackIntervalNanos = INT64_MAX;
+    mMaxCallbackIntervalNanos = 0;
+    mSumCallbackIntervalNanos = 0;
+    mMaxCallbackDurationNanos = 0;
+}
+
+void AudioStreamLegacy::updateCallbackTimingStats(int64_t startNanos, int64_t endNanos) {
+    if (mCallbackCount > 0) {
+        int64_t intervalNanos = startNanos - mLastCallbackNanos;
+        mMinCallbackIntervalNanos = std::min(mMinCallbackIntervalNanos, intervalNanos);
+        mMaxCallbackIntervalNanos = std::max(mMaxCallbackIntervalNanos, intervalNanos);
+        mSumCallbackIntervalNanos += intervalNanos;
+    }
+    mMaxCallbackDurationNanos = std::max(mMaxCallbackDurationNanos, endNanos - startNanos);
+    mLastCallbackNanos = startNanos;
+    mCallbackCount++;
+}
+
+void AudioStreamLegacy::logCallbackTimingStats() {
+    if (mCallbackCount < 2) {
+        return;
+    }
+    ALOGD("%s() %" PRId64 " callbacks, interval min/avg/max = %" PRId64 "/%" PRId64 "/%" PRId64
+          " usec, longest callback %" PRId64 " usec",
+          __func__, mCallbackCount,
+          mMinCallbackIntervalNanos / AAUDIO_NANOS_PER_MICROSECOND,
+          mSumCallbackIntervalNanos / (mCallbackCount - 1) / AAUDIO_NANOS_PER_MICROSECOND,
+          mMaxCallbackIntervalNanos / AAUDIO_NANOS_PER_MICROSECOND,
+          mMaxCallbackDurationNanos / AAUDIO_NANOS_PER_MICROSECOND);
+}
+
 aaudio_result_t AudioStreamLegacy::checkForDisconnectRequest(bool errorCallbackEnabled) {
     if (mRequestDisconnect.isRequested()) {
         ALOGD("checkForDisconnectRequest() mRequestDisconnect acknowledged");
@@ -121,6 +121,18 @@ protected:
 
     void forceDisconnect(bool errorCallbackEnabled = true);
 
+    /*
+     * Pick the number of frames to pass to the data callback.
+     * Without a size requested by the app, a FAST stream is still called with
+     * whole bursts so that the app runs once per mixer period.
+     * @return frames per callback or AAUDIO_UNSPECIFIED for whatever the client delivers
+     */
+    int32_t chooseCallbackBlockFrames(bool hasCallback, bool isFast);
+
+    // Call before the callbacks start and after they stopped.
+    void resetCallbackTimingStats();
+    void logCallbackTimingStats();
+
     int64_t incrementFramesWritten(int32_t frames) {
         return mFramesWritten.increment(frames);
     }
@@ -139,6 +151,17 @@ protected:
     const android::sp<StreamDeviceCallback>   mDeviceCallback;
 
     AtomicRequestor            mRequestDisconnect;
+
+private:
+    void updateCallbackTimingStats(int64_t startNanos, int64_t endNanos);
+
+    // Timing of the data callbacks, only written by the callback thread.
+    int64_t                    mCallbackCount = 0;
+    int64_t                    mLastCallbackNanos = 0;
+    int64_t                    mMinCallbackIntervalNanos = 0;
+    int64_t                    mMaxCallbackIntervalNanos = 0;
+    int64_t                    mSumCallbackIntervalNanos = 0;
+    int64_t                    mMaxCallbackDurationNanos = 0;
 };
 
 } /* namespace aaudio */
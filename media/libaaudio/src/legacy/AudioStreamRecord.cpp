@@ -205,8 +205,11 @@ aaudio_result_t AudioStreamRecord::open(const AudioStreamBuilder& builder)
     setSampleRate(actualSampleRate);
 
     // We may need to pass the data through a block size adapter to guarantee constant size.
-    if (mCallbackBufferSize != AAUDIO_UNSPECIFIED) {
-        int callbackSizeBytes = getBytesPerFrame() * mCallbackBufferSize;
+    // The blocks are cut before any format conversion so they are sized in device frames.
+    int32_t callbackBlockFrames = chooseCallbackBlockFrames(
+            callback != nullptr, (mAudioRecord->getFlags() & AUDIO_INPUT_FLAG_FAST) != 0);
+    if (callbackBlockFrames != AAUDIO_UNSPECIFIED) {
+        int callbackSizeBytes = getBytesPerDeviceFrame() * callbackBlockFrames;
         mFixedBlockWriter.open(callbackSizeBytes);
         mBlockAdapter = &mFixedBlockWriter;
     } else {
@@ -329,6 +332,8 @@ aaudio_result_t AudioStreamRecord::requestStart()
         return AAudioConvert_androidToAAudioResult(err);
     }
 
+    resetCallbackTimingStats();
+
     // Enable callback before starting AudioTrack to avoid shutting
     // down because of a race condition.
     mCallbackEnabled.store(true);
@@ -350,6 +355,7 @@ aaudio_result_t AudioStreamRecord::requestStop() {
     mTimestampPosition.set(getFramesRead());
     mAudioRecord->stop();
     mCallbackEnabled.store(false);
+    logCallbackTimingStats();
     mFramesWritten.reset32(); // service writes frames, service position reset on flush
     mTimestampPosition.reset32();
     // Pass false to prevent errorCallback from being called after disconnect
@@ -194,8 +194,10 @@ aaudio_result_t AudioStreamTrack::open(const AudioStreamBuilder& builder)
     setSampleRate(actualSampleRate);
 
     // We may need to pass the data through a block size adapter to guarantee constant size.
-    if (mCallbackBufferSize != AAUDIO_UNSPECIFIED) {
-        int callbackSizeBytes = getBytesPerFrame() * mCallbackBufferSize;
+    int32_t callbackBlockFrames = chooseCallbackBlockFrames(
+            callback != nullptr, (mAudioTrack->getFlags() & AUDIO_OUTPUT_FLAG_FAST) != 0);
+    if (callbackBlockFrames != AAUDIO_UNSPECIFIED) {
+        int callbackSizeBytes = getBytesPerDeviceFrame() * callbackBlockFrames;
         mFixedBlockReader.open(callbackSizeBytes);
         mBlockAdapter = &mFixedBlockReader;
     } else {
@@ -277,6 +279,8 @@ aaudio_result_t AudioStreamTrack::requestStart() {
         return AAudioConvert_androidToAAudioResult(err);
     }
 
+    resetCallbackTimingStats();
+
     // Enable callback before starting AudioTrack to avoid shutting
     // down because of a race condition.
     mCallbackEnabled.store(true);
@@ -298,6 +302,7 @@ aaudio_result_t AudioStreamTrack::requestPause() {
     setState(AAUDIO_STREAM_STATE_PAUSING);
     mAudioTrack->pause();
     mCallbackEnabled.store(false);
+    logCallbackTimingStats();
     status_t err = mAudioTrack->getPosition(&mPositionWhenPausing);
     if (err != OK) {
         return AAudioConvert_androidToAAudioResult(err);
@@ -332,6 +337,7 @@ aaudio_result_t AudioStreamTrack::requestStop() {
     mTimestampPosition.reset32();
     mAudioTrack->stop();
     mCallbackEnabled.store(false);
+    logCallbackTimingStats();
     return checkForDisconnectRequest(false);;
 }
 
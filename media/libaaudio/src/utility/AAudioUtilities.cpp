@@ -700,6 +700,18 @@ int32_t AAudioProperty_getHardwareBurstMinMicros() {
     return prop;
 }
 
+int32_t AAudioProperty_getEndpointCacheMillis() {
+    const int32_t defaultMillis = 3000; // arbitrary, covers a typical pause and resume
+    const int32_t maxMillis = 60 * 1000; // arbitrary
+    int32_t prop = property_get_int32(AAUDIO_PROP_ENDPOINT_CACHE_MSEC, defaultMillis);
+    if (prop < 0 || prop > maxMillis) {
+        ALOGE("AAudioProperty_getEndpointCacheMillis: invalid = %d, use %d",
+              prop, defaultMillis);
+        prop = defaultMillis;
+    }
+    return prop;
+}
+
 aaudio_result_t AAudio_isFlushAllowed(aaudio_stream_state_t state) {
     aaudio_result_t result = AAUDIO_OK;
     switch (state) {
@@ -302,6 +302,17 @@ int32_t AAudioProperty_getMinimumSleepMicros();
  */
 int32_t AAudioProperty_getHardwareBurstMinMicros();
 
+#define AAUDIO_PROP_ENDPOINT_CACHE_MSEC    "aaudio.endpoint_cache_msec"
+
+/**
+ * Read system property.
+ * This is how long the AAudio service keeps a shared endpoint open after its last stream
+ * was closed, so that a stream reopened soon after does not pay the MMAP open latency again.
+ *
+ * @return number of milliseconds to keep an unused shared endpoint, 0 to close it immediately
+ */
+int32_t AAudioProperty_getEndpointCacheMillis();
+
 
 /**
  * Is flush allowed for the given state?
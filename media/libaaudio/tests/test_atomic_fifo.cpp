@@ -18,10 +18,13 @@
 
 #include <gtest/gtest.h>
 #include <stdlib.h>
+#include <thread>
+#include <vector>
 
 #include "fifo/FifoBuffer.h"
 #include "fifo/FifoController.h"
 
+using android::fifo_counter_t;
 using android::fifo_frames_t;
 using android::FifoController;
 using android::FifoBuffer;
@@ -227,3 +230,63 @@ TEST(test_fifo_buffer, fifo_random_threshold) {
     TestFifoBuffer tester(capacity, threshold);
     tester.checkRandomWriteRead();
 }
+
+// Several threads write tagged bursts with writeAtomically() while one thread reads.
+// Every burst must come out whole and in order for its writer.
+TEST(test_fifo_buffer, fifo_multi_writer) {
+    constexpr int kCapacity = 64;
+    constexpr int kBurst = 12; // does not divide the capacity, so bursts wrap
+    constexpr int kWriters = 4;
+    constexpr int kBurstsPerWriter = 2000;
+
+    fifo_counter_t readCounter = 0;
+    fifo_counter_t writeCounter = 0;
+    fifo_counter_t reserveCounter = 0;
+    int32_t storage[kCapacity];
+    FifoBuffer fifoBuffer(sizeof(int32_t), kCapacity,
+                          &readCounter, &writeCounter, &reserveCounter, storage);
+
+    std::vector<std::thread> writers;
+    for (int writer = 0; writer < kWriters; writer++) {
+        writers.emplace_back([&fifoBuffer, writer]() {
+            int32_t burst[kBurst];
+            for (int i = 0; i < kBurstsPerWriter; i++) {
+                for (int j = 0; j < kBurst; j++) {
+                    burst[j] = (writer << 24) | (i << 4) | j;
+                }
+                while (fifoBuffer.writeAtomically(burst, kBurst) == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    int nextBurst[kWriters] = {};
+    int32_t burst[kBurst];
+    for (int total = 0; total < kWriters * kBurstsPerWriter; total++) {
+        while (fifoBuffer.getFifoControllerBase()->getFullFramesAvailable() < kBurst) {
+            std::this_thread::yield();
+        }
+        ASSERT_EQ(kBurst, fifoBuffer.read(burst, kBurst));
+        const int writer = burst[0] >> 24;
+        ASSERT_GE(writer, 0);
+        ASSERT_LT(writer, kWriters);
+        for (int j = 0; j < kBurst; j++) {
+            ASSERT_EQ((writer << 24) | (nextBurst[writer] << 4) | j, burst[j]);
+        }
+        nextBurst[writer]++;
+    }
+    for (std::thread &writer : writers) {
+        writer.join();
+    }
+    EXPECT_EQ(0, fifoBuffer.getFifoControllerBase()->getFullFramesAvailable());
+    for (int writer = 0; writer < kWriters; writer++) {
+        EXPECT_EQ(kBurstsPerWriter, nextBurst[writer]);
+    }
+
+    // all or nothing
+    int32_t tooBig[kCapacity + 1] = {};
+    EXPECT_EQ(0, fifoBuffer.writeAtomically(tooBig, kCapacity + 1));
+    EXPECT_EQ(kCapacity, fifoBuffer.writeAtomically(tooBig, kCapacity));
+    EXPECT_EQ(0, fifoBuffer.writeAtomically(tooBig, 1));
+}
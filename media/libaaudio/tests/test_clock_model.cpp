@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "client/IsochronousClockModel.h"
+#include "utility/AudioClock.h"
+
+using namespace aaudio;
+
+static constexpr int32_t kSampleRate = 48000;
+static constexpr int32_t kFramesPerBurst = 96;     // 2 msec
+static constexpr int64_t kNanosPerBurst = AAUDIO_NANOS_PER_SECOND * kFramesPerBurst / kSampleRate;
+
+// Feed timestamps one burst apart, every period-th of them late by lateNanos.
+static void runBursts(IsochronousClockModel *model, int32_t bursts,
+                      int64_t lateNanos, int32_t period) {
+    model->setSampleRate(kSampleRate);
+    model->setFramesPerBurst(kFramesPerBurst);
+    const int64_t startNanos = AAUDIO_NANOS_PER_SECOND;
+    model->start(startNanos);
+    for (int32_t i = 0; i < bursts; i++) {
+        const int64_t nanoTime = startNanos + i * kNanosPerBurst
+                + ((i % period == period - 1) ? lateNanos : 0);
+        model->processTimestamp((int64_t) i * kFramesPerBurst, nanoTime);
+    }
+}
+
+TEST(test_clock_model, jitter_unknown_until_running) {
+    IsochronousClockModel model;
+    runBursts(&model, 10, 0, 1);
+    EXPECT_FALSE(model.isJitterKnown());
+    EXPECT_EQ(kNanosPerBurst, model.getJitterNanos());
+    EXPECT_EQ(2 * kFramesPerBurst, model.getRecommendedBufferSizeInFrames());
+}
+
+TEST(test_clock_model, regular_timestamps_have_small_jitter) {
+    IsochronousClockModel model;
+    runBursts(&model, 1000, 0, 1);
+    ASSERT_TRUE(model.isJitterKnown());
+    EXPECT_LT(model.getJitterNanos(), kNanosPerBurst / 2);
+    EXPECT_EQ(2 * kFramesPerBurst, model.getRecommendedBufferSizeInFrames());
+}
+
+TEST(test_clock_model, late_timestamps_grow_the_buffer) {
+    IsochronousClockModel model;
+    // every fifth timestamp is two and a half bursts late
+    runBursts(&model, 1000, kNanosPerBurst * 5 / 2, 5);
+    ASSERT_TRUE(model.isJitterKnown());
+    EXPECT_GE(model.getJitterNanos(), kNanosPerBurst * 5 / 2);
+    EXPECT_GE(model.getRecommendedBufferSizeInFrames(), 4 * kFramesPerBurst);
+}
+
+TEST(test_clock_model, burst_change_resets_jitter) {
+    IsochronousClockModel model;
+    runBursts(&model, 1000, kNanosPerBurst * 2, 5);
+    ASSERT_TRUE(model.isJitterKnown());
+    model.setFramesPerBurst(kFramesPerBurst * 2);
+    EXPECT_FALSE(model.isJitterKnown());
+}
@@ -21,6 +21,7 @@
 #include <inttypes.h>
 #include <math.h>
 #include <sys/resource.h>
+#include <vector>
 
 #include <audio_utils/clock.h>
 #include <audio_utils/primitives.h>
@@ -118,23 +119,34 @@ status_t AudioTrack::getMinFrameCount(
     //          audio_format_t format
     //          audio_channel_mask_t channelMask
     //          audio_output_flags_t flags (FAST)
+    if (streamType == AUDIO_STREAM_DEFAULT) {
+        streamType = AUDIO_STREAM_MUSIC;
+    }
+    // Resolve the output once: the per stream type queries would each ask the audio policy
+    // service for it, while the per output queries are answered from the cached
+    // I/O descriptors kept up to date by ioConfigChanged().
+    audio_io_handle_t output = AudioSystem::getOutput(streamType);
+    if (output == AUDIO_IO_HANDLE_NONE) {
+        ALOGE("Unable to get output for stream type %d", streamType);
+        return PERMISSION_DENIED;
+    }
     uint32_t afSampleRate;
     status_t status;
-    status = AudioSystem::getOutputSamplingRate(&afSampleRate, streamType);
+    status = AudioSystem::getSamplingRate(output, &afSampleRate);
     if (status != NO_ERROR) {
         ALOGE("Unable to query output sample rate for stream type %d; status %d",
                 streamType, status);
         return status;
     }
     size_t afFrameCount;
-    status = AudioSystem::getOutputFrameCount(&afFrameCount, streamType);
+    status = AudioSystem::getFrameCount(output, &afFrameCount);
     if (status != NO_ERROR) {
         ALOGE("Unable to query output frame count for stream type %d; status %d",
                 streamType, status);
         return status;
     }
     uint32_t afLatency;
-    status = AudioSystem::getOutputLatency(&afLatency, streamType);
+    status = AudioSystem::getLatency(output, &afLatency);
     if (status != NO_ERROR) {
         ALOGE("Unable to query output latency for stream type %d; status %d",
                 streamType, status);
@@ -1029,6 +1041,28 @@ status_t AudioTrack::setPlaybackRate(const AudioPlaybackRate &playbackRate)
     if (isAudioPlaybackRateEqual(playbackRate, mPlaybackRate)) {
         return NO_ERROR;
     }
+    AudioPlaybackRate playbackRateTemp;
+    uint32_t effectiveRate;
+    status_t status = validatePlaybackRate_l(playbackRate, &playbackRateTemp, &effectiveRate);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    mPlaybackRate = playbackRate;
+    //set effective rates
+    mProxy->setPlaybackRate(playbackRateTemp);
+    mProxy->setSampleRate(effectiveRate); // FIXME: not quite "atomic" with setPlaybackRate
+
+    if (mTrackOffloaded &&
+        !isAudioPlaybackRateEqual(mPlaybackRate, AUDIO_PLAYBACK_RATE_DEFAULT)) {
+        ALOGD("invalidate track-offloaded track on setPlaybackRate");
+        android_atomic_or(CBLK_INVALID, &mCblk->mFlags);
+    }
+    return NO_ERROR;
+}
+
+status_t AudioTrack::validatePlaybackRate_l(const AudioPlaybackRate &playbackRate,
+        AudioPlaybackRate *effectivePlaybackRate, uint32_t *effectiveSampleRate)
+{
     if (isOffloadedOrDirect_l()) {
         return INVALID_OPERATION;
     }
@@ -1074,16 +1108,8 @@ status_t AudioTrack::setPlaybackRate(const AudioPlaybackRate &playbackRate)
                         playbackRate.mSpeed, playbackRate.mPitch);
         return BAD_VALUE;
     }
-    mPlaybackRate = playbackRate;
-    //set effective rates
-    mProxy->setPlaybackRate(playbackRateTemp);
-    mProxy->setSampleRate(effectiveRate); // FIXME: not quite "atomic" with setPlaybackRate
-
-    if (mTrackOffloaded &&
-        !isAudioPlaybackRateEqual(mPlaybackRate, AUDIO_PLAYBACK_RATE_DEFAULT)) {
-        ALOGD("invalidate track-offloaded track on setPlaybackRate");
-        android_atomic_or(CBLK_INVALID, &mCblk->mFlags);
-    }
+    *effectivePlaybackRate = playbackRateTemp;
+    *effectiveSampleRate = effectiveRate;
     return NO_ERROR;
 }
 
@@ -1093,6 +1119,50 @@ const AudioPlaybackRate& AudioTrack::getPlaybackRate() const
     return mPlaybackRate;
 }
 
+status_t AudioTrack::setMixParameters(float left, float right, float level,
+        const AudioPlaybackRate &playbackRate)
+{
+    if (isnanf(left) || left < GAIN_FLOAT_ZERO || left > GAIN_FLOAT_UNITY ||
+            isnanf(right) || right < GAIN_FLOAT_ZERO || right > GAIN_FLOAT_UNITY ||
+            isnanf(level) || level < GAIN_FLOAT_ZERO || level > GAIN_FLOAT_UNITY) {
+        return BAD_VALUE;
+    }
+
+    AutoMutex lock(mLock);
+    const bool playbackRateChanged = !isAudioPlaybackRateEqual(playbackRate, mPlaybackRate);
+    AudioPlaybackRate playbackRateTemp = mPlaybackRate;
+    uint32_t effectiveRate = 0;
+    if (playbackRateChanged) {
+        status_t status = validatePlaybackRate_l(playbackRate, &playbackRateTemp, &effectiveRate);
+        if (status != NO_ERROR) {
+            return status;
+        }
+    } else {
+        playbackRateTemp.mSpeed = adjustSpeed(mPlaybackRate.mSpeed, mPlaybackRate.mPitch);
+        playbackRateTemp.mPitch = adjustPitch(mPlaybackRate.mPitch);
+    }
+
+    mVolume[AUDIO_INTERLEAVE_LEFT] = left;
+    mVolume[AUDIO_INTERLEAVE_RIGHT] = right;
+    mSendLevel = level;
+    mPlaybackRate = playbackRate;
+    mProxy->setMixParameters(gain_minifloat_pack(gain_from_float(left), gain_from_float(right)),
+            level, playbackRateTemp);
+    if (playbackRateChanged) {
+        mProxy->setSampleRate(effectiveRate);
+        if (mTrackOffloaded &&
+            !isAudioPlaybackRateEqual(mPlaybackRate, AUDIO_PLAYBACK_RATE_DEFAULT)) {
+            ALOGD("invalidate track-offloaded track on setMixParameters");
+            android_atomic_or(CBLK_INVALID, &mCblk->mFlags);
+        }
+    }
+
+    if (isOffloaded_l()) {
+        mAudioTrack->signal();
+    }
+    return NO_ERROR;
+}
+
 ssize_t AudioTrack::getBufferSizeInFrames()
 {
     AutoMutex lock(mLock);
@@ -1651,11 +1721,6 @@ status_t AudioTrack::createTrack_l()
         mProxy = mStaticProxy;
     }
 
-    mProxy->setVolumeLR(gain_minifloat_pack(
-            gain_from_float(mVolume[AUDIO_INTERLEAVE_LEFT]),
-            gain_from_float(mVolume[AUDIO_INTERLEAVE_RIGHT])));
-
-    mProxy->setSendLevel(mSendLevel);
     const uint32_t effectiveSampleRate = adjustSampleRate(mSampleRate, mPlaybackRate.mPitch);
     const float effectiveSpeed = adjustSpeed(mPlaybackRate.mSpeed, mPlaybackRate.mPitch);
     const float effectivePitch = adjustPitch(mPlaybackRate.mPitch);
@@ -1664,7 +1729,10 @@ status_t AudioTrack::createTrack_l()
     AudioPlaybackRate playbackRateTemp = mPlaybackRate;
     playbackRateTemp.mSpeed = effectiveSpeed;
     playbackRateTemp.mPitch = effectivePitch;
-    mProxy->setPlaybackRate(playbackRateTemp);
+    mProxy->setMixParameters(gain_minifloat_pack(
+            gain_from_float(mVolume[AUDIO_INTERLEAVE_LEFT]),
+            gain_from_float(mVolume[AUDIO_INTERLEAVE_RIGHT])),
+            mSendLevel, playbackRateTemp);
     mProxy->setMinimum(mNotificationFramesAct);
 
     mDeathNotifier = new DeathNotifier(this);
@@ -2332,6 +2400,17 @@ status_t AudioTrack::restoreTrack_l(const char *from)
         staticPosition = mStaticProxy->getPosition().unsignedValue();
     }
 
+    // Save the frames written by the client but not yet played by the invalidated track,
+    // so that the new track starts with them instead of an empty buffer.
+    // The old shared memory is kept mapped until createTrack_l() replaces it.
+    // A flush can only be pending when the track is not active.
+    std::vector<uint8_t> pendingData;
+    size_t pendingFrames = 0;
+    if (mSharedBuffer == 0 && mState == STATE_ACTIVE && mProxy != 0) {
+        pendingData.resize(mProxy->frameCount() * mFrameSize);
+        pendingFrames = mProxy->copyUnconsumedFrames(pendingData.data(), mProxy->frameCount());
+    }
+
     // See b/74409267. Connecting to a BT A2DP device supporting multiple codecs
     // causes a lot of churn on the service side, and it can reject starting
     // playback of a previously created track. May also apply to other cases.
@@ -2356,9 +2435,24 @@ retry:
     } else {
         // take the frames that will be lost by track recreation into account in saved position
         // For streaming tracks, this is the amount we obtained from the user/client
-        // (not the number actually consumed at the server - those are already lost).
+        // less the pending frames copied to the new track, which the server will consume again.
+        size_t restoredFrames = 0;
         if (mStaticProxy == 0) {
+            while (restoredFrames < pendingFrames) {
+                Proxy::Buffer buffer;
+                buffer.mFrameCount = pendingFrames - restoredFrames;
+                if (mProxy->obtainBuffer(&buffer, &ClientProxy::kNonBlocking) != NO_ERROR) {
+                    break;
+                }
+                memcpy(buffer.mRaw, &pendingData[restoredFrames * mFrameSize],
+                        buffer.mFrameCount * mFrameSize);
+                restoredFrames += buffer.mFrameCount;
+                mProxy->releaseBuffer(&buffer);
+            }
+            ALOGV_IF(restoredFrames > 0, "%s(): restored %zu pending frames",
+                    __func__, restoredFrames);
             mPosition = mReleased;
+            mPosition -= restoredFrames;
         }
         // Continue playback from last known position and restore loop.
         if (mStaticProxy != 0) {
@@ -2394,7 +2488,7 @@ retry:
         }
         // server resets to zero so we offset
         mFramesWrittenServerOffset =
-                mStaticProxy.get() != nullptr ? staticPosition : mFramesWritten;
+                mStaticProxy.get() != nullptr ? staticPosition : mFramesWritten - restoredFrames;
         mFramesWrittenAtRestore = mFramesWrittenServerOffset;
     }
     if (result != NO_ERROR) {
@@ -20,7 +20,9 @@
 #include <private/media/AudioTrackShared.h>
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <linux/futex.h>
+#include <string.h>
 #include <sys/syscall.h>
 
 namespace android {
@@ -47,7 +49,7 @@ static uint32_t incrementSequence(uint32_t self, uint32_t other) {
 
 audio_track_cblk_t::audio_track_cblk_t()
     : mServer(0), mFutex(0), mMinimum(0)
-    , mVolumeLR(GAIN_MINIFLOAT_PACKED_UNITY), mSampleRate(0), mSendLevel(0)
+    , mVolumeLR(GAIN_MINIFLOAT_PACKED_UNITY), mSampleRate(0)
     , mBufferSizeInFrames(0)
     , mFlags(0)
 {
@@ -439,6 +441,24 @@ void AudioTrackClientProxy::sendStreamingFlushStop(bool flush)
     }
 }
 
+size_t AudioTrackClientProxy::copyUnconsumedFrames(void *dst, size_t maxFrames) const
+{
+    const int32_t front = android_atomic_acquire_load(&mCblk->u.mStreaming.mFront);
+    const int32_t rear = mCblk->u.mStreaming.mRear;
+    const ssize_t filled = rear - front;
+    if (filled <= 0 || (size_t) filled > mFrameCount) {
+        return 0;
+    }
+    const size_t frames = std::min((size_t) filled, maxFrames);
+    const size_t index = front & (mFrameCountP2 - 1);
+    const size_t part1 = std::min(frames, mFrameCountP2 - index);
+    memcpy(dst, (char *) mBuffers + index * mFrameSize, part1 * mFrameSize);
+    if (frames > part1) {
+        memcpy((char *) dst + part1 * mFrameSize, mBuffers, (frames - part1) * mFrameSize);
+    }
+    return frames;
+}
+
 bool AudioTrackClientProxy::clearStreamEndDone() {
     return (android_atomic_and(~CBLK_STREAM_END_DONE, &mCblk->mFlags) & CBLK_STREAM_END_DONE) != 0;
 }
@@ -972,10 +992,10 @@ void AudioTrackServerProxy::tallyUnderrunFrames(uint32_t frameCount)
     }
 }
 
-AudioPlaybackRate AudioTrackServerProxy::getPlaybackRate()
+AudioTrackMixParameters AudioTrackServerProxy::getMixParameters()
 {   // do not call from multiple threads without holding lock
-    mPlaybackRateObserver.poll(mPlaybackRate);
-    return mPlaybackRate;
+    mMixParametersObserver.poll(mMixParameters);
+    return mMixParameters;
 }
 
 // ---------------------------------------------------------------------------
@@ -23,6 +23,10 @@
 #include <media/AudioPolicyHelper.h>
 #include "media/ToneGenerator.h"
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 
 namespace android {
 
@@ -1328,14 +1332,7 @@ void ToneGenerator::audioCallback(int event, void* user, void *info) {
             // If segment,  ON -> OFF transition : ramp volume down
             if (lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[0] != 0) {
                 lWaveCmd = WaveGenerator::WAVEGEN_STOP;
-                unsigned int lFreqIdx = 0;
-                unsigned short lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[lFreqIdx];
-
-                while (lFrequency != 0) {
-                    WaveGenerator *lpWaveGen = lpToneGen->mWaveGens.valueFor(lFrequency);
-                    lpWaveGen->getSamples(lpOut, lGenSmp, lWaveCmd);
-                    lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[++lFreqIdx];
-                }
+                lpToneGen->getSamples(lpOut, lGenSmp, lWaveCmd);
                 ALOGV("ON->OFF, lGenSmp: %d, lReqSmp: %d", lGenSmp, lReqSmp);
             }
 
@@ -1414,14 +1411,7 @@ void ToneGenerator::audioCallback(int event, void* user, void *info) {
 
         if (lGenSmp) {
             // If samples must be generated, call all active wave generators and acumulate waves in lpOut
-            unsigned int lFreqIdx = 0;
-            unsigned short lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[lFreqIdx];
-
-            while (lFrequency != 0) {
-                WaveGenerator *lpWaveGen = lpToneGen->mWaveGens.valueFor(lFrequency);
-                lpWaveGen->getSamples(lpOut, lGenSmp, lWaveCmd);
-                lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[++lFreqIdx];
-            }
+            lpToneGen->getSamples(lpOut, lGenSmp, lWaveCmd);
         }
 
         lNumSmp -= lReqSmp;
@@ -1534,10 +1524,14 @@ bool ToneGenerator::prepareWave() {
                                 TONEGEN_GAIN/lNumWaves);
                 mWaveGens.add(frequency, lpWaveGen);
             }
+            // Resolve the generators of the segment once, not in each callback
+            mSegmentWaveGens[segmentIdx][freqIdx] = mWaveGens.valueFor(frequency);
             frequency = mpNewToneDesc->segments[segmentIdx].waveFreq[++freqIdx];
         }
+        mSegmentWaveGens[segmentIdx][freqIdx] = NULL;
         segmentIdx++;
     }
+    mSegmentWaveGens[segmentIdx][0] = NULL;
 
     // Initialize tone sequencer
     mTotalSmp = 0;
@@ -1603,6 +1597,26 @@ void ToneGenerator::clearWaveGens() {
     mWaveGens.clear();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        ToneGenerator::getSamples()
+//
+//    Description:    Accumulates in outBuffer the samples of all the wave generators of
+//        the current segment.
+//
+//    Input:
+//        outBuffer:      Output buffer where to accumulate samples.
+//        count:          number of samples to produce.
+//        command:        special action requested (see enum gen_command).
+//
+//    Output:
+//        none
+//
+////////////////////////////////////////////////////////////////////////////////
+void ToneGenerator::getSamples(short *outBuffer, unsigned int count, unsigned int command) {
+    WaveGenerator::getSamples(mSegmentWaveGens[mCurSegment], outBuffer, count, command);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //    Method:       ToneGenerator::getToneForRegion()
@@ -1762,4 +1776,99 @@ void ToneGenerator::WaveGenerator::getSamples(short *outBuffer,
     mS2 = lS2;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        WaveGenerator::getSamples()
+//
+//    Description:    Generates count samples of the sum of several sine waves and
+//        accumulates result in outBuffer. The generators are updated together for
+//        each sample instead of one after the other over the whole buffer.
+//        Gives the same result as calling getSamples() on each generator.
+//
+//    Input:
+//        waveGens:       NULL terminated list of at most TONEGEN_MAX_WAVES generators.
+//        outBuffer:      Output buffer where to accumulate samples.
+//        count:          number of samples to produce.
+//        command:        special action requested (see enum gen_command).
+//
+//    Output:
+//        none
+//
+////////////////////////////////////////////////////////////////////////////////
+void ToneGenerator::WaveGenerator::getSamples(WaveGenerator * const *waveGens,
+        short *outBuffer, unsigned int count, unsigned int command) {
+    // The volume ramp of WAVEGEN_STOP needs more than 32 bits, it only lasts one buffer
+    if (command == WAVEGEN_STOP) {
+        for (; *waveGens != NULL; waveGens++) {
+            (*waveGens)->getSamples(outBuffer, count, command);
+        }
+        return;
+    }
+
+    // Unused generators have all their values at 0 and produce silence.
+    // All intermediate values fit in 32 bits: |A1| < 2^15, |S1|, |S2| <= GEN_AMP and
+    // amplitude < 2^15.
+    int32_t lS1[TONEGEN_MAX_WAVES + 1] = {}, lS2[TONEGEN_MAX_WAVES + 1] = {};
+    int32_t lA1[TONEGEN_MAX_WAVES + 1] = {}, lAmplitude[TONEGEN_MAX_WAVES + 1] = {};
+    unsigned int numGens = 0;
+    for (; waveGens[numGens] != NULL; numGens++) {
+        WaveGenerator *lpWaveGen = waveGens[numGens];
+        if (command == WAVEGEN_START) {
+            lpWaveGen->mS1 = 0;
+            lpWaveGen->mS2 = lpWaveGen->mS2_0;
+        }
+        lS1[numGens] = (int32_t)lpWaveGen->mS1;
+        lS2[numGens] = (int32_t)lpWaveGen->mS2;
+        lA1[numGens] = lpWaveGen->mA1_Q14;
+        lAmplitude[numGens] = lpWaveGen->mAmplitude_Q15;
+    }
+    if (numGens == 0) {
+        return;
+    }
+
+    // Summing before the conversion to short gives the same result as adding each
+    // generator to outBuffer as a short, as both are modulo 2^16.
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    static_assert(TONEGEN_MAX_WAVES + 1 == 4, "one generator per lane");
+    int32x4_t vS1 = vld1q_s32(lS1);
+    int32x4_t vS2 = vld1q_s32(lS2);
+    const int32x4_t vA1 = vld1q_s32(lA1);
+    const int32x4_t vAmplitude = vld1q_s32(lAmplitude);
+    while (count) {
+        count--;
+        int32x4_t vSample = vsubq_s32(vshrq_n_s32(vmulq_s32(vA1, vS1), S_Q14), vS2);
+        // shift delay
+        vS2 = vS1;
+        vS1 = vSample;
+        vSample = vshrq_n_s32(vmulq_s32(vAmplitude, vSample), S_Q15);
+        int32x2_t vSum = vadd_s32(vget_low_s32(vSample), vget_high_s32(vSample));
+        vSum = vpadd_s32(vSum, vSum);
+        *outBuffer = (short)(*outBuffer + vget_lane_s32(vSum, 0));  // put result in buffer
+        outBuffer++;
+    }
+    vst1q_s32(lS1, vS1);
+    vst1q_s32(lS2, vS2);
+#else
+    while (count) {
+        count--;
+        int32_t sum = 0;
+        for (unsigned int i = 0; i < TONEGEN_MAX_WAVES + 1; i++) {
+            int32_t Sample = ((lA1[i] * lS1[i]) >> S_Q14) - lS2[i];
+            // shift delay
+            lS2[i] = lS1[i];
+            lS1[i] = Sample;
+            sum += (lAmplitude[i] * Sample) >> S_Q15;
+        }
+        *outBuffer = (short)(*outBuffer + sum);  // put result in buffer
+        outBuffer++;
+    }
+#endif
+
+    // save status
+    for (unsigned int i = 0; i < numGens; i++) {
+        waveGens[i]->mS1 = lS1[i];
+        waveGens[i]->mS2 = lS2[i];
+    }
+}
+
 }  // end namespace android
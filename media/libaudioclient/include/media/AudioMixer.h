@@ -101,6 +101,8 @@ public:
         pthread_once(&sOnceControl, &sInitRoutine);
     }
 
+    ~AudioMixer();
+
     // Create a new track in the mixer.
     //
     // \param name        a unique user-provided integer associated with the track.
@@ -132,11 +134,22 @@ public:
     void        setBufferProvider(int name, AudioBufferProvider* bufferProvider);
 
     void        process() {
+        if (mTrackTiming) {
+            processTimed();
+            return;
+        }
         (this->*mHook)();
     }
 
     size_t      getUnreleasedFrames(int name) const;
 
+    // Per track cost sampling. While enabled, process() also measures the time spent
+    // mixing each enabled track, which getTrackMixNs() returns until the next process().
+    // Meant to be turned on for one buffer every so often, as it reads the clock
+    // around every track.
+    void        setTrackTiming(bool enabled) { mTrackTiming = enabled; }
+    int64_t     getTrackMixNs(int name) const;
+
     std::string trackNames() const {
         std::stringstream ss;
         for (const auto &pair : mTracks) {
@@ -149,6 +162,23 @@ public:
         mNBLogWriter = logWriter;
     }
 
+    // Partitioned mixing for outputs with many tracks.
+    //
+    // While at least minTracks tracks are enabled, the tracks of each main buffer
+    // are split between numWorkers worker threads and the thread calling process(),
+    // each mixing into a partial bus, and the partial buses are then summed.
+    // Tracks with an aux buffer are always mixed by the calling thread, as the aux
+    // buffer is shared. Worker i is pinned to cpus[i] if given.
+    // minTracks or numWorkers of 0 turns it off, which is the default.
+    //
+    // \return OK        on success.
+    //         BAD_VALUE if there are more cpus than workers.
+    status_t    setParallelMix(size_t minTracks, size_t numWorkers,
+                        const std::vector<int> &cpus);
+
+    // Thread ids of the parallel mix workers, for the caller to adjust their priority.
+    std::vector<pid_t> parallelMixTids() const;
+
     static inline bool isValidFormat(audio_format_t format) {
         switch (format) {
         case AUDIO_FORMAT_PCM_8_BIT:
@@ -216,6 +246,7 @@ private:
     struct Track {
         Track()
             : bufferProvider(nullptr)
+            , mMixNs(0)
         {
             // TODO: move additional initialization here.
         }
@@ -336,6 +367,8 @@ private:
 
         AudioPlaybackRate    mPlaybackRate;
 
+        int64_t              mMixNs;        // time spent mixing in the last timed process()
+
     private:
         // hooks
         void track__genericResample(int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
@@ -368,6 +401,13 @@ private:
     void process__genericNoResampling();
     void process__genericResampling();
     void process__oneTrack16BitsStereoNoResampling();
+    void process__parallel();
+
+    // process() with the time spent on each enabled track recorded in its mMixNs.
+    void processTimed();
+
+    // Mixes numFrames of the track into outTemp, in the track's mixer input format.
+    void mixTrack(Track *t, int32_t *outTemp, int32_t *resampleTemp, size_t numFrames);
 
     template <int MIXTYPE, typename TO, typename TI, typename TA>
     void process__noResampleOneTrack();
@@ -393,6 +433,20 @@ private:
     std::unique_ptr<int32_t[]> mOutputTemp;
     std::unique_ptr<int32_t[]> mResampleTemp;
 
+    // Worker threads and per partition buffers for process__parallel(),
+    // partition 0 is mixed by the thread calling process().
+    class MixWorkers;
+    struct Partition {
+        std::unique_ptr<int32_t[]> mBus;
+        std::unique_ptr<int32_t[]> mResampleTemp;
+        std::vector<Track *> mTracks;
+    };
+    std::unique_ptr<MixWorkers> mWorkers;
+    std::vector<Partition> mPartitions;
+    size_t mParallelMinTracks = 0;
+
+    bool mTrackTiming = false;           // see setTrackTiming()
+
     // track names grouped by main buffer, in no particular order of main buffer.
     // however names for a particular main buffer are in order (by construction).
     std::unordered_map<void * /* mainBuffer */, std::vector<int /* name */>> mGroups;
@@ -713,7 +713,7 @@ private:
             // mAnalyticsItem alloc failure will be flagged in the constructor
             // don't log empty records
             if (mAnalyticsItem->count() > 0) {
-                mAnalyticsItem->selfrecord();
+                mAnalyticsItem->selfrecordBatched();
             }
         }
         void gather(const AudioRecord *record);
@@ -469,6 +469,16 @@ public:
     /* Return current playback rate */
             const AudioPlaybackRate& getPlaybackRate() const;
 
+    /* Set the volume, auxiliary effect send level and playback rate together, with the
+     * same constraints as setVolume(), setAuxEffectSendLevel() and setPlaybackRate().
+     * The server applies all of them in the same mix cycle, and at the cost of a
+     * single update of the shared control block, which suits clients that change
+     * the parameters of many tracks at a time, such as games positioning sounds.
+     * Nothing is changed if any of the parameters is rejected.
+     */
+            status_t    setMixParameters(float left, float right, float level,
+                                const AudioPlaybackRate &playbackRate);
+
     /* Enables looping and sets the start and end points of looping.
      * Only supported for static buffer mode.
      *
@@ -994,6 +1004,12 @@ protected:
             // check sample rate and speed is compatible with AudioTrack
             bool     isSampleRateSpeedAllowed_l(uint32_t sampleRate, float speed);
 
+            // check a new playback rate and return the effective one sent to the server,
+            // as well as the effective sample rate emulating the pitch
+            status_t validatePlaybackRate_l(const AudioPlaybackRate &playbackRate,
+                                            AudioPlaybackRate *effectivePlaybackRate,
+                                            uint32_t *effectiveSampleRate);
+
             void     restartIfDisabled();
 
             void     updateRoutedDeviceId_l();
@@ -1204,7 +1220,7 @@ private:
             // mAnalyticsItem alloc failure will be flagged in the constructor
             // don't log empty records
             if (mAnalyticsItem->count() > 0) {
-                mAnalyticsItem->selfrecord();
+                mAnalyticsItem->selfrecordBatched();
             }
         }
         void gather(const AudioTrack *track);
@@ -303,6 +303,7 @@ private:
     bool prepareWave();
     unsigned int numWaves(unsigned int segmentIdx);
     void clearWaveGens();
+    void getSamples(short *outBuffer, unsigned int count, unsigned int command);
     tone_type getToneForRegion(tone_type toneType);
 
     // WaveGenerator generates a single sine wave
@@ -321,6 +322,11 @@ private:
         void getSamples(short *outBuffer, unsigned int count,
                 unsigned int command);
 
+        // Accumulates in outBuffer the sum of the NULL terminated list of at most
+        // TONEGEN_MAX_WAVES waveGens, in a single pass over the buffer.
+        static void getSamples(WaveGenerator * const *waveGens, short *outBuffer,
+                unsigned int count, unsigned int command);
+
     private:
         static const short GEN_AMP = 32000;  // amplitude of generator
         static const short S_Q14 = 14;  // shift for Q14
@@ -334,6 +340,8 @@ private:
     };
 
     KeyedVector<unsigned short, WaveGenerator *> mWaveGens;  // list of active wave generators.
+    // wave generators of each segment of the active tone, NULL terminated, set by prepareWave()
+    WaveGenerator *mSegmentWaveGens[TONEGEN_MAX_SEGMENTS+1][TONEGEN_MAX_WAVES+1];
 };
 
 }
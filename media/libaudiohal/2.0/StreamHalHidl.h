@@ -130,6 +130,11 @@ class StreamOutHalHidl : public StreamOutHalInterface, public StreamHalHidl {
     // Write audio buffer to driver.
     virtual status_t write(const void *buffer, size_t bytes, size_t *written);
 
+    // Zero copy write directly into the data message queue.
+    virtual status_t reserveWrite(size_t bytes, void **buffer, size_t *reserved,
+                                  size_t *lastWritten);
+    virtual status_t commitWrite(size_t bytes);
+
     // Return the number of audio frames written by the audio dsp to DAC since
     // the output has exited standby.
     virtual status_t getRenderPosition(uint32_t *dspFrames);
@@ -182,6 +187,14 @@ class StreamOutHalHidl : public StreamOutHalInterface, public StreamHalHidl {
     std::unique_ptr<StatusMQ> mStatusMQ;
     std::atomic<pid_t> mWriterClient;
     EventFlag* mEfGroup;
+    // State of the write committed by commitWrite() that the HAL has not reported yet.
+    bool mWritePending;
+    size_t mPendingWriteBytes;
+    nsecs_t mPendingWriteStartNs;
+    // Outcome of that write, returned by the next reserveWrite().
+    status_t mLastWriteStatus;
+    size_t mLastWritten;
+    void *mReservedBuffer;
 
     // Can not be constructed directly by clients.
     StreamOutHalHidl(const sp<IStreamOut>& stream);
@@ -192,6 +205,8 @@ class StreamOutHalHidl : public StreamOutHalInterface, public StreamHalHidl {
     status_t callWriterThread(
             WriteCommand cmd, const char* cmdName,
             const uint8_t* data, size_t dataSize, WriterCallback callback);
+    status_t waitWriterStatus(const char* cmdName, WriterCallback callback);
+    void completePendingWrite();
     status_t prepareForWriting(size_t bufferSize);
 };
 
@@ -17,6 +17,9 @@
 #ifndef ANDROID_HARDWARE_STREAM_POWER_LOG_H
 #define ANDROID_HARDWARE_STREAM_POWER_LOG_H
 
+#include <atomic>
+#include <stdio.h>
+
 #include <audio_utils/clock.h>
 #include <audio_utils/PowerLog.h>
 #include <cutils/properties.h>
@@ -29,7 +32,10 @@ public:
     StreamPowerLog() :
         mIsUserDebugOrEngBuild(is_userdebug_or_eng_build()),
         mPowerLog(nullptr),
-        mFrameSize(0) {
+        mFrameSize(0),
+        mWriteCount(0),
+        mWriteLatencySumNs(0),
+        mWriteLatencyMaxNs(0) {
         // use init() to set up the power log.
     }
 
@@ -59,11 +65,18 @@ public:
         // mPowerLog may be NULL (not the right build, format not accepted, etc.).
     }
 
-    // Dump the power log to fd.
+    // Dump the power log and the write latency to fd.
     void dump(int fd) const {
         // OK for null mPowerLog
         (void)power_log_dump(
                 mPowerLog, fd, "      " /* prefix */, kPowerLogLines, 0 /* limit_ns */);
+        const int64_t writeCount = mWriteCount.load(std::memory_order_relaxed);
+        if (writeCount > 0) {
+            dprintf(fd, "      Write latency: %lld writes, average %.3f ms, max %.3f ms\n",
+                    (long long)writeCount,
+                    mWriteLatencySumNs.load(std::memory_order_relaxed) * 1e-6 / writeCount,
+                    mWriteLatencyMaxNs.load(std::memory_order_relaxed) * 1e-6);
+        }
     }
 
     // Log the audio data contained in buffer.
@@ -74,6 +87,17 @@ public:
         }
     }
 
+    // Log the time the driver took to consume a write, called by the writer only.
+    void logWriteLatency(int64_t latencyNs) {
+        mWriteCount.store(mWriteCount.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+        mWriteLatencySumNs.store(mWriteLatencySumNs.load(std::memory_order_relaxed) + latencyNs,
+                                 std::memory_order_relaxed);
+        if (latencyNs > mWriteLatencyMaxNs.load(std::memory_order_relaxed)) {
+            mWriteLatencyMaxNs.store(latencyNs, std::memory_order_relaxed);
+        }
+    }
+
     bool isUserDebugOrEngBuild() const {
         return mIsUserDebugOrEngBuild;
     }
@@ -95,6 +119,10 @@ private:
     const bool mIsUserDebugOrEngBuild;
     power_log_t *mPowerLog;
     size_t mFrameSize;
+    // Unlike the power log, kept on all builds as they are cheap. Read by dump().
+    std::atomic<int64_t> mWriteCount;
+    std::atomic<int64_t> mWriteLatencySumNs;
+    std::atomic<int64_t> mWriteLatencyMaxNs;
 };
 
 } // namespace android
@@ -21,6 +21,7 @@
 #include <hwbinder/IPCThreadState.h>
 #include <mediautils/SchedulingPolicyService.h>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 
 #include "DeviceHalHidl.h"
 #include "EffectHalHidl.h"
@@ -292,7 +293,9 @@ struct StreamOutCallback : public IStreamOutCallback {
 }  // namespace
 
 StreamOutHalHidl::StreamOutHalHidl(const sp<IStreamOut>& stream)
-        : StreamHalHidl(stream.get()), mStream(stream), mWriterClient(0), mEfGroup(nullptr) {
+        : StreamHalHidl(stream.get()), mStream(stream), mWriterClient(0), mEfGroup(nullptr),
+          mWritePending(false), mPendingWriteBytes(0), mPendingWriteStartNs(0),
+          mLastWriteStatus(OK), mLastWritten(0), mReservedBuffer(nullptr) {
 }
 
 StreamOutHalHidl::~StreamOutHalHidl() {
@@ -359,6 +362,7 @@ status_t StreamOutHalHidl::write(const void *buffer, size_t bytes, size_t *writt
         }
     }
 
+    const nsecs_t startNs = systemTime();
     status = callWriterThread(
             WriteCommand::WRITE, "write", static_cast<const uint8_t*>(buffer), bytes,
             [&] (const WriteStatus& writeStatus) {
@@ -368,13 +372,100 @@ status_t StreamOutHalHidl::write(const void *buffer, size_t bytes, size_t *writt
                         "hal reports more bytes written than asked for: %lld > %lld",
                         (long long)*written, (long long)bytes);
             });
+    mStreamPowerLog.logWriteLatency(systemTime() - startNs);
     mStreamPowerLog.log(buffer, *written);
     return status;
 }
 
+status_t StreamOutHalHidl::reserveWrite(
+        size_t bytes, void **buffer, size_t *reserved, size_t *lastWritten) {
+    if (mStream == 0) return NO_INIT;
+    // Non-blocking writes complete through the callback, they go through write().
+    if (mCallback.unsafe_get()) return INVALID_OPERATION;
+    *buffer = nullptr;
+    *reserved = 0;
+    *lastWritten = 0;
+
+    status_t status;
+    if (!mDataMQ) {
+        // Same sizing as in write(), the reservation may get smaller than the buffer.
+        size_t bufferSize;
+        if ((status = getCachedBufferSize(&bufferSize)) != OK) {
+            return status;
+        }
+        if (bytes > bufferSize) bufferSize = bytes;
+        if ((status = prepareForWriting(bufferSize)) != OK) {
+            return status;
+        }
+    }
+
+    completePendingWrite();
+    *lastWritten = mLastWritten;
+    status = mLastWriteStatus;
+    mLastWritten = 0;
+    mLastWriteStatus = OK;
+    if (status != OK) {
+        return status;
+    }
+
+    size_t availableToWrite = mDataMQ->availableToWrite();
+    if (bytes > availableToWrite) bytes = availableToWrite;
+    DataMQ::MemTransaction tx;
+    if (bytes > 0 && mDataMQ->beginWrite(bytes, &tx)) {
+        // Only the first region is contiguous, the rest is reserved by the next call.
+        const DataMQ::MemRegion& region = tx.getFirstRegion();
+        mReservedBuffer = region.getAddress();
+        *buffer = mReservedBuffer;
+        *reserved = region.getLength();
+    }
+    return OK;
+}
+
+status_t StreamOutHalHidl::commitWrite(size_t bytes) {
+    if (mStream == 0) return NO_INIT;
+    if (!mDataMQ || mWritePending) return INVALID_OPERATION;
+
+    WriteCommand cmd = WriteCommand::WRITE;
+    if (!mCommandMQ->write(&cmd)) {
+        ALOGE("command message queue write failed for \"commitWrite\"");
+        return -EAGAIN;
+    }
+    if (bytes > 0 && !mDataMQ->commitWrite(bytes)) {
+        ALOGE("data message queue commit of %lld bytes failed", (long long)bytes);
+        bytes = 0;
+    }
+    mStreamPowerLog.log(mReservedBuffer, bytes);
+    mReservedBuffer = nullptr;
+    mEfGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::NOT_EMPTY));
+
+    // The status is read by the next call to the writer thread.
+    mWritePending = true;
+    mPendingWriteBytes = bytes;
+    mPendingWriteStartNs = systemTime();
+    return OK;
+}
+
+void StreamOutHalHidl::completePendingWrite() {
+    if (!mWritePending) return;
+    mWritePending = false;
+    mLastWritten = 0;
+    mLastWriteStatus = waitWriterStatus(
+            "commitWrite",
+            [&] (const WriteStatus& writeStatus) {
+                mLastWritten = writeStatus.reply.written;
+                // Diagnostics of the cause of b/35813113.
+                ALOGE_IF(mLastWritten > mPendingWriteBytes,
+                        "hal reports more bytes written than asked for: %lld > %lld",
+                        (long long)mLastWritten, (long long)mPendingWriteBytes);
+            });
+    mStreamPowerLog.logWriteLatency(systemTime() - mPendingWriteStartNs);
+}
+
 status_t StreamOutHalHidl::callWriterThread(
         WriteCommand cmd, const char* cmdName,
         const uint8_t* data, size_t dataSize, StreamOutHalHidl::WriterCallback callback) {
+    // The writer thread replies in order, collect the reply to a committed write first.
+    completePendingWrite();
     if (!mCommandMQ->write(&cmd)) {
         ALOGE("command message queue write failed for \"%s\"", cmdName);
         return -EAGAIN;
@@ -391,7 +482,11 @@ status_t StreamOutHalHidl::callWriterThread(
         }
     }
     mEfGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::NOT_EMPTY));
+    return waitWriterStatus(cmdName, callback);
+}
 
+status_t StreamOutHalHidl::waitWriterStatus(
+        const char* cmdName, StreamOutHalHidl::WriterCallback callback) {
     // TODO: Remove manual event flag handling once blocking MQ is implemented. b/33815422
     uint32_t efState = 0;
 retry:
@@ -19,6 +19,7 @@
 
 #include <hardware/audio.h>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 
 #include "DeviceHalLocal.h"
 #include "StreamHalLocal.h"
@@ -139,7 +140,9 @@ status_t StreamOutHalLocal::setVolume(float left, float right) {
 }
 
 status_t StreamOutHalLocal::write(const void *buffer, size_t bytes, size_t *written) {
+    const nsecs_t startNs = systemTime();
     ssize_t writeResult = mStream->write(mStream, buffer, bytes);
+    mStreamPowerLog.logWriteLatency(systemTime() - startNs);
     if (writeResult > 0) {
         *written = writeResult;
         mStreamPowerLog.log(buffer, *written);
@@ -150,6 +153,15 @@ status_t StreamOutHalLocal::write(const void *buffer, size_t bytes, size_t *writ
     }
 }
 
+status_t StreamOutHalLocal::reserveWrite(size_t /*bytes*/, void ** /*buffer*/,
+                                         size_t * /*reserved*/, size_t * /*lastWritten*/) {
+    return INVALID_OPERATION;
+}
+
+status_t StreamOutHalLocal::commitWrite(size_t /*bytes*/) {
+    return INVALID_OPERATION;
+}
+
 status_t StreamOutHalLocal::getRenderPosition(uint32_t *dspFrames) {
     return mStream->get_render_position(mStream, dspFrames);
 }
@@ -106,6 +106,11 @@ class StreamOutHalLocal : public StreamOutHalInterface, public StreamHalLocal {
     // Write audio buffer to driver.
     virtual status_t write(const void *buffer, size_t bytes, size_t *written);
 
+    // Zero copy write, not supported by legacy HALs.
+    virtual status_t reserveWrite(size_t bytes, void **buffer, size_t *reserved,
+                                  size_t *lastWritten);
+    virtual status_t commitWrite(size_t bytes);
+
     // Return the number of audio frames written by the audio dsp to DAC since
     // the output has exited standby.
     virtual status_t getRenderPosition(uint32_t *dspFrames);
@@ -112,6 +112,18 @@ class StreamOutHalInterface : public virtual StreamHalInterface {
     // Write audio buffer to driver.
     virtual status_t write(const void *buffer, size_t bytes, size_t *written) = 0;
 
+    // Zero copy write: render directly into the buffer shared with the driver.
+    // reserveWrite() returns in *buffer up to 'bytes' contiguous bytes of that buffer and
+    // their count in *reserved, which may be less than requested.
+    // commitWrite() then hands the first 'bytes' of them to the driver without waiting for
+    // it to consume them: the next reserveWrite() waits for this, and returns the status of
+    // that write and in *lastWritten the number of bytes the driver took.
+    // Both return INVALID_OPERATION if not supported by the stream, write() must then be used.
+    // Do not mix with write() on the same stream.
+    virtual status_t reserveWrite(size_t bytes, void **buffer, size_t *reserved,
+                                  size_t *lastWritten) = 0;
+    virtual status_t commitWrite(size_t bytes) = 0;
+
     // Return the number of audio frames written by the audio dsp to DAC since
     // the output has exited standby.
     virtual status_t getRenderPosition(uint32_t *dspFrames) = 0;
@@ -46,6 +46,9 @@ LOCAL_CFLAGS := -Werror -Wall
 # uncomment to disable NEON on architectures that actually do support NEON, for benchmarking
 #LOCAL_CFLAGS += -DUSE_NEON=false
 
+# uncomment to keep the SSE resampler kernels on x86 CPUs that support AVX2/FMA, for benchmarking
+#LOCAL_CFLAGS += -DUSE_AVX2=false
+
 include $(BUILD_SHARED_LIBRARY)
 
 include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -18,14 +18,25 @@
 #define LOG_TAG "AudioMixer"
 //#define LOG_NDEBUG 0
 
+#include <errno.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <sched.h>
 #include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 #include <utils/Errors.h>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 
 #include <cutils/compiler.h>
 #include <utils/Debug.h>
@@ -37,6 +48,8 @@
 #include <media/AudioMixer.h>
 
 #include "AudioMixerOps.h"
+#include "AudioMixerOpsNeon.h"
+#include "AudioMixerOpsSSE.h"
 
 // The FCC_2 macro refers to the Fixed Channel Count of 2 for the legacy integer mixer.
 #ifndef FCC_2
@@ -93,6 +106,150 @@ static inline audio_format_t selectMixerInFormat(audio_format_t inputFormat __un
     return kUseFloat && kUseNewMixer ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
 }
 
+// Threads which mix partitions of the tracks for process__parallel().
+// run() hands work to the workers and mixes partition 0 itself, the workers
+// otherwise sleep on a condition so an idle mixer costs nothing.
+class AudioMixer::MixWorkers {
+public:
+    MixWorkers(size_t numWorkers, const std::vector<int> &cpus)
+        : mTids(numWorkers, 0) {
+        for (size_t i = 0; i < numWorkers; ++i) {
+            mThreads.emplace_back(&MixWorkers::threadLoop, this, i,
+                    i < cpus.size() ? cpus[i] : -1);
+        }
+        // wait for the tids, so that the owner can set the priority right away.
+        std::unique_lock<std::mutex> lock(mLock);
+        mDoneCond.wait(lock, [this] {
+            return std::find(mTids.begin(), mTids.end(), 0) == mTids.end();
+        });
+    }
+
+    ~MixWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mExit = true;
+        }
+        mWorkCond.notify_all();
+        for (auto &thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    size_t size() const {
+        return mThreads.size();
+    }
+
+    std::vector<pid_t> tids() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mTids;
+    }
+
+    // Calls work(i) for i in [0, count], 0 on the calling thread and the others
+    // on workers 0 to count - 1, and returns once all of them are done.
+    void run(size_t count, const std::function<void(size_t)> &work) {
+        LOG_ALWAYS_FATAL_IF(count > mThreads.size(), "%zu > %zu workers",
+                count, mThreads.size());
+        if (count > 0) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mWork = &work;
+            mCount = count;
+            mPending = count;
+            ++mGeneration;
+        }
+        if (count > 0) {
+            mWorkCond.notify_all();
+        }
+        work(0);
+        if (count > 0) {
+            std::unique_lock<std::mutex> lock(mLock);
+            mDoneCond.wait(lock, [this] { return mPending == 0; });
+            mWork = nullptr;
+        }
+    }
+
+private:
+    void threadLoop(size_t index, int cpu) {
+        char name[16];
+        snprintf(name, sizeof(name), "AudioMixer%zu", index);
+        pthread_setname_np(pthread_self(), name);
+        if (cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            if (sched_setaffinity(0 /* self */, sizeof(set), &set) != 0) {
+                ALOGW("cannot pin mix worker %zu to cpu %d: %s", index, cpu, strerror(errno));
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mLock);
+        mTids[index] = gettid();
+        mDoneCond.notify_all();
+
+        uint32_t generation = mGeneration;
+        for (;;) {
+            mWorkCond.wait(lock, [this, generation] {
+                return mExit || mGeneration != generation;
+            });
+            if (mExit) {
+                break;
+            }
+            generation = mGeneration;
+            if (index >= mCount) {
+                continue;   // not needed for this run
+            }
+            const std::function<void(size_t)> *work = mWork;
+            lock.unlock();
+            (*work)(index + 1);
+            lock.lock();
+            if (--mPending == 0) {
+                mDoneCond.notify_all();
+            }
+        }
+    }
+
+    std::mutex mLock;
+    std::condition_variable mWorkCond;  // for the workers, a new run or exit
+    std::condition_variable mDoneCond;  // for the owner, all tids known or run done
+    const std::function<void(size_t)> *mWork = nullptr;
+    size_t mCount = 0;          // number of workers taking part in the current run
+    size_t mPending = 0;        // number of those not done yet
+    uint32_t mGeneration = 0;   // incremented for each run
+    bool mExit = false;
+    std::vector<pid_t> mTids;
+    std::vector<std::thread> mThreads;
+};
+
+AudioMixer::~AudioMixer()
+{
+}
+
+status_t AudioMixer::setParallelMix(size_t minTracks, size_t numWorkers,
+        const std::vector<int> &cpus)
+{
+    if (cpus.size() > numWorkers) {
+        return BAD_VALUE;
+    }
+    mWorkers.reset();
+    mPartitions.clear();
+    mParallelMinTracks = 0;
+    if (minTracks > 0 && numWorkers > 0) {
+        mWorkers.reset(new MixWorkers(numWorkers, cpus));
+        mPartitions.resize(numWorkers + 1);
+        for (Partition &partition : mPartitions) {
+            partition.mBus.reset(new int32_t[MAX_NUM_CHANNELS * mFrameCount]);
+            partition.mResampleTemp.reset(new int32_t[MAX_NUM_CHANNELS * mFrameCount]);
+        }
+        mParallelMinTracks = minTracks;
+    }
+    invalidate();
+    return OK;
+}
+
+std::vector<pid_t> AudioMixer::parallelMixTids() const
+{
+    return mWorkers != nullptr ? mWorkers->tids() : std::vector<pid_t>();
+}
+
 status_t AudioMixer::create(
         int name, audio_channel_mask_t channelMask, audio_format_t format, int sessionId)
 {
@@ -263,14 +420,23 @@ status_t AudioMixer::Track::prepareForDownmix()
     if (audio_channel_mask_get_representation(channelMask)
                 == AUDIO_CHANNEL_REPRESENTATION_POSITION
             && DownmixerBufferProvider::isMultichannelCapable()) {
-        mDownmixerBufferProvider.reset(new DownmixerBufferProvider(channelMask,
-                mMixerChannelMask,
-                AUDIO_FORMAT_PCM_16_BIT /* TODO: use mMixerInFormat, now only PCM 16 */,
-                sampleRate, sessionId, kCopyBufferFrameCount));
-        if (static_cast<DownmixerBufferProvider *>(mDownmixerBufferProvider.get())->isValid()) {
-            mDownmixRequiresFormat = AUDIO_FORMAT_PCM_16_BIT; // PCM 16 bit required for downmix
-            reconfigureBufferProviders();
-            return NO_ERROR;
+        // The downmixer effect processes float when built for it, which spares the
+        // conversions around it, otherwise only PCM 16 bit.
+        const audio_format_t downmixFormats[] = { mMixerInFormat, AUDIO_FORMAT_PCM_16_BIT };
+        for (size_t i = 0; i < sizeof(downmixFormats) / sizeof(downmixFormats[0]); i++) {
+            const audio_format_t downmixFormat = downmixFormats[i];
+            if (i > 0 && downmixFormat == mMixerInFormat) {
+                continue; // already tried
+            }
+            mDownmixerBufferProvider.reset(new DownmixerBufferProvider(channelMask,
+                    mMixerChannelMask, downmixFormat,
+                    sampleRate, sessionId, kCopyBufferFrameCount));
+            if (static_cast<DownmixerBufferProvider *>(
+                    mDownmixerBufferProvider.get())->isValid()) {
+                mDownmixRequiresFormat = downmixFormat;
+                reconfigureBufferProviders();
+                return NO_ERROR;
+            }
         }
         // mDownmixerBufferProvider reset below.
     }
@@ -816,6 +982,15 @@ size_t AudioMixer::getUnreleasedFrames(int name) const
     return 0;
 }
 
+int64_t AudioMixer::getTrackMixNs(int name) const
+{
+    const auto it = mTracks.find(name);
+    if (it != mTracks.end()) {
+        return it->second->mMixNs;
+    }
+    return 0;
+}
+
 void AudioMixer::setBufferProvider(int name, AudioBufferProvider* bufferProvider)
 {
     LOG_ALWAYS_FATAL_IF(!exists(name), "invalid name: %d", name);
@@ -938,6 +1113,13 @@ void AudioMixer::process__validate()
         }
     }
 
+    // the generic hooks handle any mix of tracks, as does the partitioned one.
+    if (mParallelMinTracks > 0 && mEnabled.size() >= mParallelMinTracks
+            && (mHook == &AudioMixer::process__genericResampling
+                    || mHook == &AudioMixer::process__genericNoResampling)) {
+        mHook = &AudioMixer::process__parallel;
+    }
+
     ALOGV("mixer configuration change: %zu "
         "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d",
         mEnabled.size(), all16BitsStereoNoResample, resampling, volumeRamp);
@@ -1320,6 +1502,7 @@ void AudioMixer::process__genericNoResampling()
             memset(outTemp, 0, sizeof(outTemp));
             for (const int name : group) {
                 const std::shared_ptr<Track> &t = mTracks[name];
+                const nsecs_t start = CC_UNLIKELY(mTrackTiming) ? systemTime() : 0;
                 int32_t *aux = NULL;
                 if (CC_UNLIKELY(t->needs & NEEDS_AUX)) {
                     aux = t->auxBuffer + numFrames;
@@ -1353,6 +1536,9 @@ void AudioMixer::process__genericNoResampling()
                         t->frameCount = t->buffer.frameCount;
                     }
                 }
+                if (CC_UNLIKELY(mTrackTiming)) {
+                    t->mMixNs += systemTime() - start;
+                }
             }
 
             const std::shared_ptr<Track> &t1 = mTracks[group[0]];
@@ -1387,41 +1573,125 @@ void AudioMixer::process__genericResampling()
         // clear temp buffer
         memset(outTemp, 0, sizeof(*outTemp) * t1->mMixerChannelCount * mFrameCount);
         for (const int name : group) {
-            const std::shared_ptr<Track> &t = mTracks[name];
-            int32_t *aux = NULL;
-            if (CC_UNLIKELY(t->needs & NEEDS_AUX)) {
-                aux = t->auxBuffer;
-            }
+            mixTrack(mTracks[name].get(), outTemp, mResampleTemp.get() /* naked ptr */,
+                    numFrames);
+        }
+        convertMixerFormat(t1->mainBuffer, t1->mMixerFormat,
+                outTemp, t1->mMixerInFormat, numFrames * t1->mMixerChannelCount);
+    }
+}
 
-            // this is a little goofy, on the resampling case we don't
-            // acquire/release the buffers because it's done by
-            // the resampler.
-            if (t->needs & NEEDS_RESAMPLE) {
-                (t.get()->*t->hook)(outTemp, numFrames, mResampleTemp.get() /* naked ptr */, aux);
-            } else {
+void AudioMixer::mixTrack(Track *t, int32_t *outTemp, int32_t *resampleTemp, size_t numFrames)
+{
+    const nsecs_t start = CC_UNLIKELY(mTrackTiming) ? systemTime() : 0;
+    int32_t *aux = NULL;
+    if (CC_UNLIKELY(t->needs & NEEDS_AUX)) {
+        aux = t->auxBuffer;
+    }
 
-                size_t outFrames = 0;
+    // this is a little goofy, on the resampling case we don't
+    // acquire/release the buffers because it's done by
+    // the resampler.
+    if (t->needs & NEEDS_RESAMPLE) {
+        (t->*t->hook)(outTemp, numFrames, resampleTemp, aux);
+    } else {
 
-                while (outFrames < numFrames) {
-                    t->buffer.frameCount = numFrames - outFrames;
-                    t->bufferProvider->getNextBuffer(&t->buffer);
-                    t->mIn = t->buffer.raw;
-                    // t->mIn == nullptr can happen if the track was flushed just after having
-                    // been enabled for mixing.
-                    if (t->mIn == nullptr) break;
+        size_t outFrames = 0;
+
+        while (outFrames < numFrames) {
+            t->buffer.frameCount = numFrames - outFrames;
+            t->bufferProvider->getNextBuffer(&t->buffer);
+            t->mIn = t->buffer.raw;
+            // t->mIn == nullptr can happen if the track was flushed just after having
+            // been enabled for mixing.
+            if (t->mIn == nullptr) break;
 
-                    (t.get()->*t->hook)(
-                            outTemp + outFrames * t->mMixerChannelCount, t->buffer.frameCount,
-                            mResampleTemp.get() /* naked ptr */,
-                            aux != nullptr ? aux + outFrames : nullptr);
-                    outFrames += t->buffer.frameCount;
+            (t->*t->hook)(
+                    outTemp + outFrames * t->mMixerChannelCount, t->buffer.frameCount,
+                    resampleTemp,
+                    aux != nullptr ? aux + outFrames : nullptr);
+            outFrames += t->buffer.frameCount;
+
+            t->bufferProvider->releaseBuffer(&t->buffer);
+        }
+    }
+    if (CC_UNLIKELY(mTrackTiming)) {
+        t->mMixNs += systemTime() - start;
+    }
+}
 
-                    t->bufferProvider->releaseBuffer(&t->buffer);
+// generic code with the tracks of each main buffer split between the workers
+void AudioMixer::process__parallel()
+{
+    ALOGVV("process__parallel\n");
+    const size_t numFrames = mFrameCount;
+
+    for (const auto &pair : mGroups) {
+        const auto &group = pair.second;
+        const std::shared_ptr<Track> &t1 = mTracks[group[0]];
+        const size_t sampleCount = numFrames * t1->mMixerChannelCount;
+        const size_t numPartitions = std::min(mPartitions.size(), group.size());
+
+        // the resampling tracks are dealt out first as they cost the most,
+        // aux tracks stay on this thread.
+        for (Partition &partition : mPartitions) {
+            partition.mTracks.clear();
+        }
+        size_t next = 0;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const int name : group) {
+                Track *t = mTracks[name].get();
+                if (CC_UNLIKELY(t->needs & NEEDS_AUX)) {
+                    if (pass == 0) {
+                        mPartitions[0].mTracks.push_back(t);
+                    }
+                } else if (((t->needs & NEEDS_RESAMPLE) != 0) == (pass == 0)) {
+                    mPartitions[next].mTracks.push_back(t);
+                    next = (next + 1) % numPartitions;
+                }
+            }
+        }
+
+        mWorkers->run(numPartitions - 1, [this, sampleCount, numFrames](size_t index) {
+            Partition &partition = mPartitions[index];
+            memset(partition.mBus.get(), 0, sizeof(int32_t) * sampleCount);
+            for (Track *t : partition.mTracks) {
+                mixTrack(t, partition.mBus.get(), partition.mResampleTemp.get(), numFrames);
+            }
+        });
+
+        // sum the partial buses into the first one.
+        int32_t *bus = mPartitions[0].mBus.get();
+        for (size_t i = 1; i < numPartitions; ++i) {
+            const int32_t *partial = mPartitions[i].mBus.get();
+            if (t1->mMixerInFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                float *sum = reinterpret_cast<float *>(bus);
+                const float *in = reinterpret_cast<const float *>(partial);
+                for (size_t j = 0; j < sampleCount; ++j) {
+                    sum[j] += in[j];
+                }
+            } else {
+                for (size_t j = 0; j < sampleCount; ++j) {
+                    bus[j] += partial[j];
                 }
             }
         }
         convertMixerFormat(t1->mainBuffer, t1->mMixerFormat,
-                outTemp, t1->mMixerInFormat, numFrames * t1->mMixerChannelCount);
+                bus, t1->mMixerInFormat, sampleCount);
+    }
+}
+
+void AudioMixer::processTimed()
+{
+    for (const int name : mEnabled) {
+        mTracks[name]->mMixNs = 0;
+    }
+    const nsecs_t start = systemTime();
+    (this->*mHook)();
+    // the one track hooks don't go through mixTrack(), and with a single track
+    // all of the mix is its cost anyway.
+    if (mEnabled.size() == 1) {
+        mTracks[mEnabled[0]]->mMixNs = systemTime() - start;
     }
 }
 
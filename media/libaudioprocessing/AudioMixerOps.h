@@ -19,6 +19,24 @@
 
 namespace android {
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#ifndef USE_NEON
+#define USE_NEON (true)
+#endif
+#else
+#define USE_NEON (false)
+#endif
+#if USE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSSE3__)  // Should be supported in x86 ABI for both 32 & 64-bit.
+#define USE_SSE (true)
+#include <tmmintrin.h>
+#else
+#define USE_SSE (false)
+#endif
+
 /* Behavior of is_same<>::value is true if the types are identical,
  * false otherwise. Identical to the STL std::is_same.
  */
@@ -230,6 +248,148 @@ enum {
     MIXTYPE_MULTI_SAVEONLY_MONOVOL,
 };
 
+/* VolumeMultiAccel is the hook for vector versions of volumeRampMulti and
+ * volumeMulti without an aux buffer. It is specialized for float volume
+ * and output in AudioMixerOpsNeon.h and AudioMixerOpsSSE.h; a method returns
+ * false if it does not handle the MIXTYPE and channel count, in which case
+ * the scalar loops are used.
+ */
+template <int MIXTYPE, int NCHAN,
+        typename TO, typename TI, typename TV>
+struct VolumeMultiAccel {
+    static inline bool volumeRampMulti(TO* /* out */, size_t /* frameCount */,
+            const TI* /* in */, TV* /* vol */, const TV* /* volinc */) {
+        return false;
+    }
+
+    static inline bool volumeMulti(TO* /* out */, size_t /* frameCount */,
+            const TI* /* in */, const TV* /* vol */) {
+        return false;
+    }
+};
+
+/* VolumeMultiVector implements VolumeMultiAccel for float output and volume
+ * with 4 lane float vectors. V supplies the vector type and its operations:
+ *
+ *   V::vec                   4 x float
+ *   V::load(const float *)   unaligned load
+ *   V::load(const int16_t *) unaligned load of 4 samples, converted to float
+ *   V::store(float *, vec)   unaligned store
+ *   V::dup(float)            all lanes set to the value
+ *   V::add(vec, vec), V::mul(vec, vec)
+ *
+ * MIXTYPE_MONOEXPAND is left to the scalar version. Products are formed in
+ * the same order as MixMul so that only the volume ramp may differ from the
+ * scalar result, as each lane adds a multiple of the increment.
+ */
+template <typename V, int MIXTYPE, int NCHAN, typename TI>
+struct VolumeMultiVector {
+    typedef typename V::vec vec;
+
+    static constexpr bool kSaveOnly = MIXTYPE == MIXTYPE_MULTI_SAVEONLY
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL;
+    static constexpr bool kMonoVol = MIXTYPE == MIXTYPE_MULTI_MONOVOL
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL;
+    static constexpr bool kSupported = MIXTYPE != MIXTYPE_MONOEXPAND;
+
+    static inline vec mul(const TI *in, vec vol) {
+        vec prod = V::mul(V::load(in), vol);
+        if (is_same<TI, int16_t>::value) {
+            prod = V::mul(prod, V::dup(1. / (1 << 15)));
+        }
+        return prod;
+    }
+
+    static inline void save(float *out, vec value) {
+        V::store(out, kSaveOnly ? value : V::add(V::load(out), value));
+    }
+
+    static inline void save(float *out, float value) {
+        *out = kSaveOnly ? value : *out + value;
+    }
+
+    static inline bool volumeRampMulti(float *out, size_t frameCount,
+            const TI *in, float *vol, const float *volinc) {
+        if (!kSupported) {
+            return false;
+        }
+        if (kMonoVol) {
+            if (NCHAN < 4) {
+                return false;
+            }
+            // one frame at a time, as all of its channels share the volume.
+            do {
+                const vec v = V::dup(vol[0]);
+                int i = 0;
+                for (; i + 4 <= NCHAN; i += 4) {
+                    save(out + i, mul(in + i, v));
+                }
+                for (; i < NCHAN; ++i) {
+                    save(out + i, MixMul<float, TI, float>(in[i], vol[0]));
+                }
+                out += NCHAN;
+                in += NCHAN;
+                vol[0] += volinc[0];
+            } while (--frameCount);
+            return true;
+        }
+        if (NCHAN != 1 && NCHAN != 2) {
+            return false;
+        }
+        // 4 / NCHAN frames per vector, each lane ramping on its own.
+        static constexpr size_t kFrames = 4 / NCHAN;
+        float lanes[4];
+        float steps[4];
+        for (int i = 0; i < 4; ++i) {
+            lanes[i] = vol[i % NCHAN] + volinc[i % NCHAN] * (i / NCHAN);
+            steps[i] = volinc[i % NCHAN] * kFrames;
+        }
+        vec v = V::load(lanes);
+        const vec step = V::load(steps);
+        for (; frameCount >= kFrames; frameCount -= kFrames) {
+            save(out, mul(in, v));
+            v = V::add(v, step);
+            out += 4;
+            in += 4;
+        }
+        V::store(lanes, v);
+        for (int i = 0; i < NCHAN; ++i) {
+            vol[i] = lanes[i];
+        }
+        for (; frameCount > 0; --frameCount) {
+            for (int i = 0; i < NCHAN; ++i) {
+                save(out++, MixMul<float, TI, float>(*in++, vol[i]));
+                vol[i] += volinc[i];
+            }
+        }
+        return true;
+    }
+
+    static inline bool volumeMulti(float *out, size_t frameCount,
+            const TI *in, const float *vol) {
+        if (!kSupported || (!kMonoVol && NCHAN != 1 && NCHAN != 2)) {
+            return false;
+        }
+        // the volume repeats every 4 samples, so the frames are one array.
+        const bool stereo = !kMonoVol && NCHAN == 2;
+        float lanes[4];
+        for (int i = 0; i < 4; ++i) {
+            lanes[i] = vol[stereo ? i & 1 : 0];
+        }
+        const vec v = V::load(lanes);
+        size_t samples = frameCount * NCHAN;
+        for (; samples >= 4; samples -= 4) {
+            save(out, mul(in, v));
+            out += 4;
+            in += 4;
+        }
+        for (size_t i = 0; i < samples; ++i) {
+            save(out++, MixMul<float, TI, float>(*in++, lanes[i & 3]));
+        }
+        return true;
+    }
+};
+
 /*
  * The volumeRampMulti and volumeRamp functions take a MIXTYPE
  * which indicates the per-frame mixing and accumulation strategy.
@@ -325,6 +485,10 @@ inline void volumeRampMulti(TO* out, size_t frameCount,
             vola[0] += volainc;
         } while (--frameCount);
     } else {
+        if (VolumeMultiAccel<MIXTYPE, NCHAN, TO, TI, TV>::volumeRampMulti(
+                out, frameCount, in, vol, volinc)) {
+            return;
+        }
         do {
             switch (MIXTYPE) {
             case MIXTYPE_MULTI:
@@ -412,6 +576,10 @@ inline void volumeMulti(TO* out, size_t frameCount,
             *aux++ += MixMul<TA, TA, TAV>(auxaccum, vola);
         } while (--frameCount);
     } else {
+        if (VolumeMultiAccel<MIXTYPE, NCHAN, TO, TI, TV>::volumeMulti(
+                out, frameCount, in, vol)) {
+            return;
+        }
         do {
             switch (MIXTYPE) {
             case MIXTYPE_MULTI:
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MIXER_OPS_NEON_H
+#define ANDROID_AUDIO_MIXER_OPS_NEON_H
+
+namespace android {
+
+// depends on AudioMixerOps.h
+
+#if USE_NEON
+
+//
+// NEON specializations are enabled for volumeRampMulti() and volumeMulti() in AudioMixerOps.h
+//
+
+struct MixerOpsNeon {
+    typedef float32x4_t vec;
+
+    static inline vec load(const float *in) {
+        return vld1q_f32(in);
+    }
+
+    static inline vec load(const int16_t *in) {
+        return vcvtq_f32_s32(vmovl_s16(vld1_s16(in)));
+    }
+
+    static inline void store(float *out, vec value) {
+        vst1q_f32(out, value);
+    }
+
+    static inline vec dup(float value) {
+        return vdupq_n_f32(value);
+    }
+
+    static inline vec add(vec a, vec b) {
+        return vaddq_f32(a, b);
+    }
+
+    static inline vec mul(vec a, vec b) {
+        return vmulq_f32(a, b);
+    }
+};
+
+template <int MIXTYPE, int NCHAN>
+struct VolumeMultiAccel<MIXTYPE, NCHAN, float, float, float>
+        : public VolumeMultiVector<MixerOpsNeon, MIXTYPE, NCHAN, float> {
+};
+
+template <int MIXTYPE, int NCHAN>
+struct VolumeMultiAccel<MIXTYPE, NCHAN, float, int16_t, float>
+        : public VolumeMultiVector<MixerOpsNeon, MIXTYPE, NCHAN, int16_t> {
+};
+
+#endif //USE_NEON
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_MIXER_OPS_NEON_H*/
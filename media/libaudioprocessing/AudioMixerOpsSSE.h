@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MIXER_OPS_SSE_H
+#define ANDROID_AUDIO_MIXER_OPS_SSE_H
+
+namespace android {
+
+// depends on AudioMixerOps.h
+
+#if USE_SSE
+
+//
+// SSEx specializations are enabled for volumeRampMulti() and volumeMulti() in AudioMixerOps.h
+//
+
+struct MixerOpsSSE {
+    typedef __m128 vec;
+
+    static inline vec load(const float *in) {
+        return _mm_loadu_ps(in);
+    }
+
+    static inline vec load(const int16_t *in) {
+        // sign extend into the upper halves of the 32 bit lanes.
+        const __m128i s16 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in));
+        return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16));
+    }
+
+    static inline void store(float *out, vec value) {
+        _mm_storeu_ps(out, value);
+    }
+
+    static inline vec dup(float value) {
+        return _mm_set1_ps(value);
+    }
+
+    static inline vec add(vec a, vec b) {
+        return _mm_add_ps(a, b);
+    }
+
+    static inline vec mul(vec a, vec b) {
+        return _mm_mul_ps(a, b);
+    }
+};
+
+template <int MIXTYPE, int NCHAN>
+struct VolumeMultiAccel<MIXTYPE, NCHAN, float, float, float>
+        : public VolumeMultiVector<MixerOpsSSE, MIXTYPE, NCHAN, float> {
+};
+
+template <int MIXTYPE, int NCHAN>
+struct VolumeMultiAccel<MIXTYPE, NCHAN, float, int16_t, float>
+        : public VolumeMultiVector<MixerOpsSSE, MIXTYPE, NCHAN, int16_t> {
+};
+
+#endif //USE_SSE
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_MIXER_OPS_SSE_H*/
@@ -33,6 +33,7 @@
 #include "AudioResamplerFirProcess.h"
 #include "AudioResamplerFirProcessNeon.h"
 #include "AudioResamplerFirProcessSSE.h"
+#include "AudioResamplerFirProcessAvx2.h"
 #include "AudioResamplerFirGen.h" // requires math.h
 #include "AudioResamplerDyn.h"
 
@@ -178,12 +179,93 @@ void AudioResamplerDyn<TC, TI, TO>::Constants::set(
     mHalfNumCoefs = halfNumCoefs;
 }
 
+template<typename TC, typename TI, typename TO>
+Mutex AudioResamplerDyn<TC, TI, TO>::FilterBank::sLock;
+
+template<typename TC, typename TI, typename TO>
+KeyedVector<typename AudioResamplerDyn<TC, TI, TO>::FilterBank::Design,
+        wp<typename AudioResamplerDyn<TC, TI, TO>::FilterBank> >
+        AudioResamplerDyn<TC, TI, TO>::FilterBank::sFilterBanks;
+
+template<typename TC, typename TI, typename TO>
+bool AudioResamplerDyn<TC, TI, TO>::FilterBank::Design::operator<(
+        const Design& other) const
+{
+    if (mPhases != other.mPhases) {
+        return mPhases < other.mPhases;
+    }
+    if (mHalfLength != other.mHalfLength) {
+        return mHalfLength < other.mHalfLength;
+    }
+    if (mStopBandAtten != other.mStopBandAtten) {
+        return mStopBandAtten < other.mStopBandAtten;
+    }
+    return mFcr < other.mFcr;
+}
+
+// static
+template<typename TC, typename TI, typename TO>
+sp<typename AudioResamplerDyn<TC, TI, TO>::FilterBank>
+AudioResamplerDyn<TC, TI, TO>::FilterBank::get(int phases, int halfLength,
+        double stopBandAtten, double fcr, double attenuation)
+{
+    const Design design = { phases, halfLength, stopBandAtten, fcr };
+    {
+        Mutex::Autolock _l(sLock);
+        ssize_t index = sFilterBanks.indexOfKey(design);
+        if (index >= 0) {
+            sp<FilterBank> filterBank = sFilterBanks.valueAt(index).promote();
+            if (filterBank != 0) {
+                ALOGV("sharing filter L:%d  hnc:%d", phases, halfLength);
+                return filterBank;
+            }
+        }
+    }
+
+    // design the filter without holding the lock, it takes milliseconds.
+    TC *coefs = nullptr;
+    int ret = posix_memalign(
+            reinterpret_cast<void **>(&coefs),
+            CACHE_LINE_SIZE /* alignment */,
+            (phases + 1) * halfLength * sizeof(TC));
+    LOG_ALWAYS_FATAL_IF(ret != 0, "Cannot allocate buffer memory, ret %d", ret);
+    firKaiserGen(coefs, phases, halfLength, stopBandAtten, fcr, attenuation);
+    sp<FilterBank> filterBank = new FilterBank(design, coefs);
+
+    Mutex::Autolock _l(sLock);
+    ssize_t index = sFilterBanks.indexOfKey(design);
+    if (index >= 0) {
+        // someone else may have designed the same filter in the meantime.
+        sp<FilterBank> other = sFilterBanks.valueAt(index).promote();
+        if (other != 0) {
+            return other; // ours is released outside of the lock.
+        }
+        sFilterBanks.replaceValueAt(index, filterBank);
+    } else {
+        sFilterBanks.add(design, filterBank);
+    }
+    return filterBank;
+}
+
+template<typename TC, typename TI, typename TO>
+AudioResamplerDyn<TC, TI, TO>::FilterBank::~FilterBank()
+{
+    {
+        Mutex::Autolock _l(sLock);
+        ssize_t index = sFilterBanks.indexOfKey(mDesign);
+        // the entry may already belong to a filter bank that replaced this one.
+        if (index >= 0 && sFilterBanks.valueAt(index).unsafe_get() == this) {
+            sFilterBanks.removeItemsAt(index);
+        }
+    }
+    free(mCoefs);
+}
+
 template<typename TC, typename TI, typename TO>
 AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
         int inChannelCount, int32_t sampleRate, src_quality quality)
     : AudioResampler(inChannelCount, sampleRate, quality),
-      mResampleFunc(0), mFilterSampleRate(0), mFilterQuality(DEFAULT_QUALITY),
-    mCoefBuffer(NULL)
+      mResampleFunc(0), mFilterSampleRate(0), mFilterQuality(DEFAULT_QUALITY)
 {
     mVolumeSimd[0] = mVolumeSimd[1] = 0;
     // The AudioResampler base class assumes we are always ready for 1:1 resampling.
@@ -206,7 +288,6 @@ AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
 template<typename TC, typename TI, typename TO>
 AudioResamplerDyn<TC, TI, TO>::~AudioResamplerDyn()
 {
-    free(mCoefBuffer);
 }
 
 template<typename TC, typename TI, typename TO>
@@ -262,24 +343,14 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
     const int phases = c.mL;
     const int halfLength = c.mHalfNumCoefs;
 
-    // create buffer
-    TC *coefs = nullptr;
-    int ret = posix_memalign(
-            reinterpret_cast<void **>(&coefs),
-            CACHE_LINE_SIZE /* alignment */,
-            (phases + 1) * halfLength * sizeof(TC));
-    LOG_ALWAYS_FATAL_IF(ret != 0, "Cannot allocate buffer memory, ret %d", ret);
-    c.mFirCoefs = coefs;
-    free(mCoefBuffer);
-    mCoefBuffer = coefs;
-
     // square the computed minimum passband value (extra safety).
     double attenuation =
             computeWindowedSincMinimumPassbandValue(stopBandAtten);
     attenuation *= attenuation;
 
-    // design filter
-    firKaiserGen(coefs, phases, halfLength, stopBandAtten, fcr, attenuation);
+    // design filter, or share the one of another resampler
+    mFilterBank = FilterBank::get(phases, halfLength, stopBandAtten, fcr, attenuation);
+    c.mFirCoefs = mFilterBank->coefs();
 
     // update the design criteria
     mNormalizedCutoffFrequency = fcr;
@@ -305,7 +376,8 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
 
     const int32_t passSteps = 1000;
 
-    testFir(coefs, c.mL, c.mHalfNumCoefs, fp, fs, passSteps, passSteps * c.ML /*stopSteps*/,
+    testFir(c.mFirCoefs, c.mL, c.mHalfNumCoefs, fp, fs,
+            passSteps, passSteps * c.ML /*stopSteps*/,
             passMin, passMax, passRipple, stopMax, stopRipple);
     ALOGD("passband(%lf, %lf): %.8lf %.8lf %.8lf\n", 0., fp, passMin, passMax, passRipple);
     ALOGD("stopband(%lf, %lf): %.8lf %.3lf\n", fs, 0.5, stopMax, stopRipple);
@@ -494,67 +566,83 @@ void AudioResamplerDyn<TC, TI, TO>::setSampleRate(int32_t inSampleRate)
     LOG_ALWAYS_FATAL_IF(stride < 16, "Resampler stride must be 16 or more");
     LOG_ALWAYS_FATAL_IF(mChannelCount < 1 || mChannelCount > 8,
             "Resampler channels(%d) must be between 1 to 8", mChannelCount);
+#if USE_AVX2
+    // x86 builds only assume SSSE3, use the AVX2/FMA kernels if the CPU has them.
+    typedef typename FirKernelsAvx2For<TC, TI, TO>::type Avx2Kernels;
+    if (!is_same<Avx2Kernels, FirKernels>::value && CpuSupportsAvx2Fma()) {
+        setResampleFunc<Avx2Kernels>(locked);
+    } else
+#endif
+    {
+        setResampleFunc<FirKernels>(locked);
+    }
+#ifdef DEBUG_RESAMPLER
+    printf("channels:%d  %s  stride:%d  %s  coef:%d  shift:%d\n",
+            mChannelCount, locked ? "locked" : "interpolated",
+            stride, useS32 ? "S32" : "S16", 2*c.mHalfNumCoefs, c.mShift);
+#endif
+}
+
+template<typename TC, typename TI, typename TO>
+template<typename KERNELS>
+void AudioResamplerDyn<TC, TI, TO>::setResampleFunc(bool locked)
+{
     // stride 16 (falls back to stride 2 for machines that do not support NEON)
     if (locked) {
         switch (mChannelCount) {
         case 1:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<1, true, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<1, true, 16, KERNELS>;
             break;
         case 2:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<2, true, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<2, true, 16, KERNELS>;
             break;
         case 3:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<3, true, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<3, true, 16, KERNELS>;
             break;
         case 4:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<4, true, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<4, true, 16, KERNELS>;
             break;
         case 5:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<5, true, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<5, true, 16, KERNELS>;
             break;
         case 6:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<6, true, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<6, true, 16, KERNELS>;
             break;
         case 7:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<7, true, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<7, true, 16, KERNELS>;
             break;
         case 8:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<8, true, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<8, true, 16, KERNELS>;
             break;
         }
     } else {
         switch (mChannelCount) {
         case 1:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<1, false, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<1, false, 16, KERNELS>;
             break;
         case 2:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<2, false, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<2, false, 16, KERNELS>;
             break;
         case 3:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<3, false, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<3, false, 16, KERNELS>;
             break;
         case 4:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<4, false, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<4, false, 16, KERNELS>;
             break;
         case 5:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<5, false, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<5, false, 16, KERNELS>;
             break;
         case 6:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<6, false, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<6, false, 16, KERNELS>;
             break;
         case 7:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<7, false, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<7, false, 16, KERNELS>;
             break;
         case 8:
-            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<8, false, 16>;
+            mResampleFunc = &AudioResamplerDyn<TC, TI, TO>::resample<8, false, 16, KERNELS>;
             break;
         }
     }
-#ifdef DEBUG_RESAMPLER
-    printf("channels:%d  %s  stride:%d  %s  coef:%d  shift:%d\n",
-            mChannelCount, locked ? "locked" : "interpolated",
-            stride, useS32 ? "S32" : "S16", 2*c.mHalfNumCoefs, c.mShift);
-#endif
 }
 
 template<typename TC, typename TI, typename TO>
@@ -565,7 +653,7 @@ size_t AudioResamplerDyn<TC, TI, TO>::resample(int32_t* out, size_t outFrameCoun
 }
 
 template<typename TC, typename TI, typename TO>
-template<int CHANNELS, bool LOCKED, int STRIDE>
+template<int CHANNELS, bool LOCKED, int STRIDE, typename KERNELS>
 size_t AudioResamplerDyn<TC, TI, TO>::resample(TO* out, size_t outFrameCount,
         AudioBufferProvider* provider)
 {
@@ -654,7 +742,7 @@ size_t AudioResamplerDyn<TC, TI, TO>::resample(TO* out, size_t outFrameCount,
             //        "  phaseFraction:%u  phaseWrapLimit:%u",
             //        inFrameCount, outputIndex, outFrameCount, phaseFraction, phaseWrapLimit);
             ALOG_ASSERT(phaseFraction < phaseWrapLimit);
-            fir<CHANNELS, LOCKED, STRIDE>(
+            fir<CHANNELS, LOCKED, STRIDE, KERNELS>(
                     &out[outputIndex],
                     phaseFraction, phaseWrapLimit,
                     coefShift, halfNumCoefs, coefs,
@@ -22,6 +22,9 @@
 #include <android/log.h>
 
 #include <media/AudioResampler.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
 
 namespace android {
 
@@ -104,6 +107,47 @@ private:
            const TC* mFirCoefs;     // polyphase filter bank
     };
 
+    /*
+     * A polyphase filter bank designed by createKaiserFir().
+     *
+     * The filter only depends on its design parameters, so filter banks are
+     * shared process wide by all the resamplers which need the same one, e.g.
+     * all tracks played at 44.1 kHz by a 48 kHz mixer, and freed when the last
+     * one lets go. A resampler sharing a bank does not pay for designing it.
+     */
+    class FilterBank : public RefBase {
+    public:
+        // returns a cached filter bank matching the design, or designs a new one.
+        static sp<FilterBank> get(int phases, int halfLength,
+                double stopBandAtten, double fcr, double attenuation);
+
+        const TC* coefs() const {
+            return mCoefs;
+        }
+
+    private:
+        struct Design {
+            int mPhases;
+            int mHalfLength;
+            double mStopBandAtten;
+            double mFcr;
+
+            bool operator<(const Design& other) const;
+        };
+
+        FilterBank(const Design& design, TC* coefs)
+            : mDesign(design), mCoefs(coefs) {
+        }
+        virtual ~FilterBank();
+
+        // live filter banks by design, protected by sLock.
+        static Mutex sLock;
+        static KeyedVector<Design, wp<FilterBank> > sFilterBanks;
+
+        const Design mDesign;
+        TC* const mCoefs;
+    };
+
     class InBuffer { // buffer management for input type TI
     public:
         InBuffer();
@@ -147,9 +191,14 @@ private:
 
     void createKaiserFir(Constants &c, double stopBandAtten, double fcr);
 
-    template<int CHANNELS, bool LOCKED, int STRIDE>
+    // KERNELS is the FirKernels set used for the dot products, see AudioResamplerFirProcess.h
+    template<int CHANNELS, bool LOCKED, int STRIDE, typename KERNELS>
     size_t resample(TO* out, size_t outFrameCount, AudioBufferProvider* provider);
 
+    // sets mResampleFunc for mChannelCount
+    template<typename KERNELS>
+    void setResampleFunc(bool locked);
+
     // define a pointer to member function type for resample
     typedef size_t (AudioResamplerDyn<TC, TI, TO>::*resample_ABP_t)(TO* out,
             size_t outFrameCount, AudioBufferProvider* provider);
@@ -161,7 +210,7 @@ private:
      resample_ABP_t mResampleFunc;     // called function for resampling
             int32_t mFilterSampleRate; // designed filter sample rate.
         src_quality mFilterQuality;    // designed filter quality.
-              void* mCoefBuffer;       // if a filter is created, this is not null
+    sp<FilterBank> mFilterBank;        // if a filter is created, this is not null
 
     // Property selected design parameters.
               // This will enable fixed high quality resampling.
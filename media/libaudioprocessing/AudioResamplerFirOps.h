@@ -43,6 +43,19 @@ namespace android {
 #define USE_SSE (false)
 #endif
 
+// AVX2/FMA kernels are built next to the SSE ones and are only used
+// if the CPU supports them, see AudioResamplerFirProcessAvx2.h.
+#ifndef USE_AVX2
+#if USE_SSE && defined(__GNUC__)
+#define USE_AVX2 (true)
+#else
+#define USE_AVX2 (false)
+#endif
+#endif
+#if USE_AVX2
+#include <immintrin.h>
+#endif
+
 template<typename T, typename U>
 struct is_same
 {
@@ -309,6 +309,46 @@ void Process(TO* const out,
             volumeLR);
 }
 
+/*
+ * The set of Process() and ProcessL() kernels used by fir().
+ *
+ * FirKernels uses the ones selected at compile time (with the NEON and SSE
+ * specializations). Kernels that depend on CPU features only known at run time,
+ * such as FirKernelsAvx2, provide the same two static functions and are
+ * chosen when the resampler is configured.
+ */
+struct FirKernels {
+    template <int CHANNELS, int STRIDE, typename TC, typename TI, typename TO>
+    static inline
+    void processL(TO* const out,
+            int count,
+            const TC* coefsP,
+            const TC* coefsN,
+            const TI* sP,
+            const TI* sN,
+            const TO* const volumeLR)
+    {
+        ProcessL<CHANNELS, STRIDE>(out, count, coefsP, coefsN, sP, sN, volumeLR);
+    }
+
+    template <int CHANNELS, int STRIDE, typename TC, typename TI, typename TO, typename TINTERP>
+    static inline
+    void process(TO* const out,
+            int count,
+            const TC* coefsP,
+            const TC* coefsN,
+            const TC* coefsP1,
+            const TC* coefsN1,
+            const TI* sP,
+            const TI* sN,
+            TINTERP lerpP,
+            const TO* const volumeLR)
+    {
+        Process<CHANNELS, STRIDE>(out, count, coefsP, coefsN, coefsP1, coefsN1, sP, sN,
+                lerpP, volumeLR);
+    }
+};
+
 /*
  * Calculates a single output frame from input sample pointer.
  *
@@ -369,9 +409,12 @@ void Process(TO* const out,
  * For floating point, lerpP is the fractional phase scaled to [0.0, 1.0):
  *
  * lerpP = (phase << 32 - coefShift) / (1 << 32); // floating point equivalent
+ *
+ * KERNELS selects the dot product functions, see FirKernels.
  */
 
-template<int CHANNELS, bool LOCKED, int STRIDE, typename TC, typename TI, typename TO>
+template<int CHANNELS, bool LOCKED, int STRIDE, typename KERNELS = FirKernels,
+        typename TC, typename TI, typename TO>
 static inline
 void fir(TO* const out,
         const uint32_t phase, const uint32_t phaseWrapLimit,
@@ -394,7 +437,7 @@ void fir(TO* const out,
         const TI* sN = samples + CHANNELS;
 
         // dot product filter.
-        ProcessL<CHANNELS, STRIDE>(out,
+        KERNELS::template processL<CHANNELS, STRIDE>(out,
                 halfNumCoefs, coefsP, coefsN, sP, sN, volumeLR);
     } else {
         // interpolated polyphase
@@ -422,13 +465,13 @@ void fir(TO* const out,
             static const TC scale = 1. / (65536. * 65536.); // scale phase bits to [0.0, 1.0)
             TC lerpP = TC(phase << (sizeof(phase)*8 - coefShift)) * scale;
 
-            Process<CHANNELS, STRIDE>(out,
+            KERNELS::template process<CHANNELS, STRIDE>(out,
                     halfNumCoefs, coefsP, coefsN, coefsP1, coefsN1, sP, sN, lerpP, volumeLR);
         } else {
             uint32_t lerpP = phase << (sizeof(phase)*8 - coefShift)
                     >> ((sizeof(phase)-sizeof(*coefs))*8 + 1);
 
-            Process<CHANNELS, STRIDE>(out,
+            KERNELS::template process<CHANNELS, STRIDE>(out,
                     halfNumCoefs, coefsP, coefsN, coefsP1, coefsN1, sP, sN, lerpP, volumeLR);
         }
     }
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_AVX2_H
+#define ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_AVX2_H
+
+namespace android {
+
+// depends on AudioResamplerFirOps.h, AudioResamplerFirProcess.h
+
+#if USE_AVX2
+
+//
+// AVX2/FMA kernels for float, used through FirKernelsAvx2 instead of FirKernels
+// when CpuSupportsAvx2Fma(). The x86 ABI only guarantees SSSE3, so these are
+// compiled for the newer instruction set function by function and cannot be
+// inlined into the resampler loop: each call computes a whole output frame.
+//
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+static inline bool CpuSupportsAvx2Fma()
+{
+    static const bool supported = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }();
+    return supported;
+}
+
+// Loads one frame of more than two channels, lanes past CHANNELS are masked out.
+template <int CHANNELS>
+AVX2_TARGET
+static inline __m256 LoadFrameAvx2(const float* s, __m256i frameMask)
+{
+    return CHANNELS == 8 ? _mm256_loadu_ps(s) : _mm256_maskload_ps(s, frameMask);
+}
+
+template <int CHANNELS, bool FIXED>
+AVX2_TARGET
+static void ProcessAvx2(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS > 0 && CHANNELS <= 8, "CHANNELS must be 1 to 8");
+
+    __m256 interp;
+    if (!FIXED) {
+        interp = _mm256_set1_ps(lerpP);
+    }
+
+    // four independent accumulators to cover the FMA latency
+    __m256 accP0 = _mm256_setzero_ps();
+    __m256 accP1 = _mm256_setzero_ps();
+    __m256 accN0 = _mm256_setzero_ps();
+    __m256 accN1 = _mm256_setzero_ps();
+
+    // more than two channels: one frame per vector, lanes past CHANNELS are masked
+    const __m256i frameMask = _mm256_cmpgt_epi32(
+            _mm256_set1_epi32(CHANNELS), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    if (CHANNELS <= 2) {
+        sP -= CHANNELS*(8-1);   // adjust sP for a loop iteration of eight
+    }
+
+    do {
+        __m256 posCoef = _mm256_loadu_ps(coefsP);
+        __m256 negCoef = _mm256_loadu_ps(coefsN);
+        coefsP += 8;
+        coefsN += 8;
+
+        if (!FIXED) { // interpolate
+            __m256 posCoef1 = _mm256_loadu_ps(coefsP1);
+            __m256 negCoef1 = _mm256_loadu_ps(coefsN1);
+            coefsP1 += 8;
+            coefsN1 += 8;
+
+            // posCoef = interp * (posCoef1 - posCoef) + posCoef
+            // negCoef = interp * (negCoef - negCoef1) + negCoef1
+            posCoef = _mm256_fmadd_ps(interp, _mm256_sub_ps(posCoef1, posCoef), posCoef);
+            negCoef = _mm256_fmadd_ps(interp, _mm256_sub_ps(negCoef, negCoef1), negCoef1);
+        }
+
+        switch (CHANNELS) {
+        case 1: {
+            // reverse the positives so that they line up with their coefficients
+            __m256 posSamp = _mm256_permutevar8x32_ps(_mm256_loadu_ps(sP),
+                    _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+            __m256 negSamp = _mm256_loadu_ps(sN);
+            sP -= 8;
+            sN += 8;
+
+            accP0 = _mm256_fmadd_ps(posSamp, posCoef, accP0);
+            accN0 = _mm256_fmadd_ps(negSamp, negCoef, accN0);
+        } break;
+        case 2: {
+            // keep the samples interleaved and pair up the coefficients instead,
+            // posSamp0 holds frames 7 to 4 and posSamp1 frames 3 to 0.
+            __m256 posSamp0 = _mm256_loadu_ps(sP);
+            __m256 posSamp1 = _mm256_loadu_ps(sP + 8);
+            __m256 negSamp0 = _mm256_loadu_ps(sN);
+            __m256 negSamp1 = _mm256_loadu_ps(sN + 8);
+            sP -= 16;
+            sN += 16;
+
+            accP0 = _mm256_fmadd_ps(posSamp0, _mm256_permutevar8x32_ps(posCoef,
+                    _mm256_setr_epi32(7, 7, 6, 6, 5, 5, 4, 4)), accP0);
+            accP1 = _mm256_fmadd_ps(posSamp1, _mm256_permutevar8x32_ps(posCoef,
+                    _mm256_setr_epi32(3, 3, 2, 2, 1, 1, 0, 0)), accP1);
+            accN0 = _mm256_fmadd_ps(negSamp0, _mm256_permutevar8x32_ps(negCoef,
+                    _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3)), accN0);
+            accN1 = _mm256_fmadd_ps(negSamp1, _mm256_permutevar8x32_ps(negCoef,
+                    _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7)), accN1);
+        } break;
+        default: {
+            // broadcast the coefficients from memory, which is cheaper than permuting them
+            float __attribute__((aligned(32))) pos[8];
+            float __attribute__((aligned(32))) neg[8];
+            _mm256_store_ps(pos, posCoef);
+            _mm256_store_ps(neg, negCoef);
+            for (int i = 0; i < 8; i += 2) {
+                accP0 = _mm256_fmadd_ps(LoadFrameAvx2<CHANNELS>(sP, frameMask),
+                        _mm256_broadcast_ss(pos + i), accP0);
+                accP1 = _mm256_fmadd_ps(LoadFrameAvx2<CHANNELS>(sP - CHANNELS, frameMask),
+                        _mm256_broadcast_ss(pos + i + 1), accP1);
+                accN0 = _mm256_fmadd_ps(LoadFrameAvx2<CHANNELS>(sN, frameMask),
+                        _mm256_broadcast_ss(neg + i), accN0);
+                accN1 = _mm256_fmadd_ps(LoadFrameAvx2<CHANNELS>(sN + CHANNELS, frameMask),
+                        _mm256_broadcast_ss(neg + i + 1), accN1);
+                sP -= 2*CHANNELS;
+                sN += 2*CHANNELS;
+            }
+        } break;
+        }
+    } while (count -= 8);
+
+    __m256 accum = _mm256_add_ps(_mm256_add_ps(accP0, accP1), _mm256_add_ps(accN0, accN1));
+
+    if (CHANNELS > 2) {
+        // as in ProcessBase(), the output is overwritten and volumeLR[0] applies to all channels
+        _mm256_maskstore_ps(out, frameMask,
+                _mm256_mul_ps(accum, _mm256_set1_ps(volumeLR[0])));
+        return;
+    }
+
+    // combine and funnel down accumulator
+    __m128 outAccum = _mm_add_ps(_mm256_castps256_ps128(accum), _mm256_extractf128_ps(accum, 1));
+    outAccum = _mm_add_ps(outAccum, _mm_movehl_ps(outAccum, outAccum));
+    if (CHANNELS == 1) {
+        // duplicate to both L and R
+        outAccum = _mm_add_ps(outAccum, _mm_shuffle_ps(outAccum, outAccum, 0x11));
+    }
+    // else L and R are already in place, having been accumulated in alternate lanes
+
+    // multiply by volume and save
+    __m128 vLR = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(volumeLR));
+    __m128 outSamp = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(out));
+    outSamp = _mm_fmadd_ps(outAccum, vLR, outSamp);
+    _mm_storel_pi(reinterpret_cast<__m64*>(out), outSamp);
+}
+
+#undef AVX2_TARGET
+
+struct FirKernelsAvx2 : public FirKernels {
+    using FirKernels::processL;
+    using FirKernels::process;
+
+    // more specialized than the FirKernels templates, so preferred for float
+    template <int CHANNELS, int STRIDE>
+    static inline
+    void processL(float* const out,
+            int count,
+            const float* coefsP,
+            const float* coefsN,
+            const float* sP,
+            const float* sN,
+            const float* const volumeLR)
+    {
+        ProcessAvx2<CHANNELS, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+    }
+
+    template <int CHANNELS, int STRIDE>
+    static inline
+    void process(float* const out,
+            int count,
+            const float* coefsP,
+            const float* coefsN,
+            const float* coefsP1,
+            const float* coefsN1,
+            const float* sP,
+            const float* sN,
+            float lerpP,
+            const float* const volumeLR)
+    {
+        ProcessAvx2<CHANNELS, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+    }
+};
+
+// The kernels to use for the <TC, TI, TO> resampler on a CPU with AVX2/FMA.
+// The integer resamplers keep the SSE ones.
+template<typename TC, typename TI, typename TO>
+struct FirKernelsAvx2For {
+    typedef FirKernels type;
+};
+
+template<>
+struct FirKernelsAvx2For<float, float, float> {
+    typedef FirKernelsAvx2 type;
+};
+
+#endif //USE_AVX2
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_AVX2_H*/
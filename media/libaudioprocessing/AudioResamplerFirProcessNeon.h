@@ -1149,6 +1149,141 @@ inline void Process<2, 16>(int32_t* const out,
 #endif
 }
 
+// Loads and stores the first N (1 to 4) floats of a frame, without touching the rest.
+template <int N>
+static inline float32x4_t LoadPartialNeon(const float* s)
+{
+    switch (N) {
+    case 1:
+        return vld1q_lane_f32(s, vdupq_n_f32(0), 0);
+    case 2:
+        return vcombine_f32(vld1_f32(s), vdup_n_f32(0));
+    case 3:
+        return vcombine_f32(vld1_f32(s), vld1_lane_f32(s + 2, vdup_n_f32(0), 0));
+    default:
+        return vld1q_f32(s);
+    }
+}
+
+template <int N>
+static inline void StorePartialNeon(float* out, float32x4_t v)
+{
+    switch (N) {
+    case 1:
+        vst1q_lane_f32(out, v, 0);
+        break;
+    case 2:
+        vst1_f32(out, vget_low_f32(v));
+        break;
+    case 3:
+        vst1_f32(out, vget_low_f32(v));
+        vst1q_lane_f32(out + 2, v, 2);
+        break;
+    default:
+        vst1q_f32(out, v);
+        break;
+    }
+}
+
+// acc[] += coef[LANE] * frame, the channels of the frame being spread over the lanes of acc[].
+template <int CHANNELS, int LANE>
+static inline void MacFrameNeon(float32x4_t* acc, float32x4_t coef, const float* s)
+{
+    const float32x2_t c = (LANE < 2) ? vget_low_f32(coef) : vget_high_f32(coef);
+    for (int i = 0; i < CHANNELS / 4; ++i) {
+        acc[i] = vmlaq_lane_f32(acc[i], vld1q_f32(s + 4 * i), c, LANE & 1);
+    }
+    if (CHANNELS & 3) {
+        acc[CHANNELS / 4] = vmlaq_lane_f32(acc[CHANNELS / 4],
+                LoadPartialNeon<CHANNELS & 3>(s + (CHANNELS & ~3)), c, LANE & 1);
+    }
+}
+
+// For more than two channels the frames are vectorized across channels rather than
+// deinterleaved, four taps per loop iteration. As in ProcessBase(), the output is
+// overwritten and volumeLR[0] applies to all channels.
+template <int CHANNELS, bool FIXED>
+static inline void ProcessNeonMultiChannel(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS > 2 && CHANNELS <= 8, "CHANNELS must be 3 to 8");
+    enum { VECTORS = (CHANNELS + 3) / 4 };
+
+    coefsP = (const float*)__builtin_assume_aligned(coefsP, 16);
+    coefsN = (const float*)__builtin_assume_aligned(coefsN, 16);
+
+    float32x2_t interp;
+    if (!FIXED) {
+        interp = vdup_n_f32(lerpP);
+        coefsP1 = (const float*)__builtin_assume_aligned(coefsP1, 16);
+        coefsN1 = (const float*)__builtin_assume_aligned(coefsN1, 16);
+    }
+
+    // with a single vector per frame, even and odd taps go to separate accumulators
+    // to shorten the dependency chains. More would not fit the registers.
+    float32x4_t accP0[VECTORS], accP1[VECTORS];
+    float32x4_t accN0[VECTORS], accN1[VECTORS];
+    for (int i = 0; i < VECTORS; ++i) {
+        accP0[i] = accP1[i] = accN0[i] = accN1[i] = vdupq_n_f32(0);
+    }
+    float32x4_t* const oddP = (VECTORS == 1) ? accP1 : accP0;
+    float32x4_t* const oddN = (VECTORS == 1) ? accN1 : accN0;
+
+    do {
+        float32x4_t posCoef = vld1q_f32(coefsP);
+        float32x4_t negCoef = vld1q_f32(coefsN);
+        coefsP += 4;
+        coefsN += 4;
+
+        if (!FIXED) { // interpolate, see ProcessNeonIntrinsic()
+            float32x4_t posCoef1 = vld1q_f32(coefsP1);
+            float32x4_t negCoef1 = vld1q_f32(coefsN1);
+            coefsP1 += 4;
+            coefsN1 += 4;
+
+            posCoef1 = vsubq_f32(posCoef1, posCoef);
+            negCoef = vsubq_f32(negCoef, negCoef1);
+
+            posCoef = vmlaq_lane_f32(posCoef, posCoef1, interp, 0);
+            negCoef = vmlaq_lane_f32(negCoef1, negCoef, interp, 0); // rev
+        }
+
+        MacFrameNeon<CHANNELS, 0>(accP0, posCoef, sP);
+        MacFrameNeon<CHANNELS, 0>(accN0, negCoef, sN);
+        MacFrameNeon<CHANNELS, 1>(oddP, posCoef, sP - CHANNELS);
+        MacFrameNeon<CHANNELS, 1>(oddN, negCoef, sN + CHANNELS);
+        MacFrameNeon<CHANNELS, 2>(accP0, posCoef, sP - 2*CHANNELS);
+        MacFrameNeon<CHANNELS, 2>(accN0, negCoef, sN + 2*CHANNELS);
+        MacFrameNeon<CHANNELS, 3>(oddP, posCoef, sP - 3*CHANNELS);
+        MacFrameNeon<CHANNELS, 3>(oddN, negCoef, sN + 3*CHANNELS);
+        sP -= 4*CHANNELS;
+        sN += 4*CHANNELS;
+    } while (count -= 4);
+
+    for (int i = 0; i < VECTORS; ++i) {
+        accP0[i] = vaddq_f32(vaddq_f32(accP0[i], accP1[i]), vaddq_f32(accN0[i], accN1[i]));
+    }
+
+    // multiply by volume and save
+    const float vol = volumeLR[0];
+    for (int i = 0; i < CHANNELS / 4; ++i) {
+        vst1q_f32(out + 4 * i, vmulq_n_f32(accP0[i], vol));
+    }
+    if (CHANNELS & 3) {
+        StorePartialNeon<CHANNELS & 3>(out + (CHANNELS & ~3),
+                vmulq_n_f32(accP0[CHANNELS / 4], vol));
+    }
+}
+
 template<>
 inline void ProcessL<1, 16>(float* const out,
         int count,
@@ -1207,6 +1342,45 @@ inline void Process<2, 16>(float* const out,
             lerpP, coefsP1, coefsN1);
 }
 
+#define PROCESS_NEON_MULTICHANNEL(CHANNELS) \
+template<> \
+inline void ProcessL<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* sP, \
+        const float* sN, \
+        const float* const volumeLR) \
+{ \
+    ProcessNeonMultiChannel<CHANNELS, true>(out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/); \
+} \
+\
+template<> \
+inline void Process<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* coefsP1, \
+        const float* coefsN1, \
+        const float* sP, \
+        const float* sN, \
+        float lerpP, \
+        const float* const volumeLR) \
+{ \
+    ProcessNeonMultiChannel<CHANNELS, false>(out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            lerpP, coefsP1, coefsN1); \
+}
+
+PROCESS_NEON_MULTICHANNEL(3)
+PROCESS_NEON_MULTICHANNEL(4)
+PROCESS_NEON_MULTICHANNEL(5)
+PROCESS_NEON_MULTICHANNEL(6)
+PROCESS_NEON_MULTICHANNEL(7)
+PROCESS_NEON_MULTICHANNEL(8)
+
+#undef PROCESS_NEON_MULTICHANNEL
+
 #endif //USE_NEON
 
 } // namespace android
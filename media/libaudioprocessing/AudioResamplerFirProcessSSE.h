@@ -150,6 +150,140 @@ static inline void ProcessSSEIntrinsic(float* out,
     _mm_storel_pi(reinterpret_cast<__m64*>(out), outSamp);
 }
 
+// Loads and stores the first N (1 to 4) floats of a frame, without touching the rest.
+template <int N>
+static inline __m128 LoadPartialSSE(const float* s)
+{
+    switch (N) {
+    case 1:
+        return _mm_load_ss(s);
+    case 2:
+        return _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(s));
+    case 3:
+        return _mm_movelh_ps(
+                _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(s)),
+                _mm_load_ss(s + 2));
+    default:
+        return _mm_loadu_ps(s);
+    }
+}
+
+template <int N>
+static inline void StorePartialSSE(float* out, __m128 v)
+{
+    switch (N) {
+    case 1:
+        _mm_store_ss(out, v);
+        break;
+    case 2:
+        _mm_storel_pi(reinterpret_cast<__m64*>(out), v);
+        break;
+    case 3:
+        _mm_storel_pi(reinterpret_cast<__m64*>(out), v);
+        _mm_store_ss(out + 2, _mm_movehl_ps(v, v));
+        break;
+    default:
+        _mm_storeu_ps(out, v);
+        break;
+    }
+}
+
+// acc[] += coef * frame, the channels of the frame being spread over the lanes of acc[].
+template <int CHANNELS>
+static inline void MacFrameSSE(__m128* acc, __m128 coef, const float* s)
+{
+    for (int i = 0; i < CHANNELS / 4; ++i) {
+        acc[i] = _mm_add_ps(acc[i], _mm_mul_ps(coef, _mm_loadu_ps(s + 4 * i)));
+    }
+    if (CHANNELS & 3) {
+        acc[CHANNELS / 4] = _mm_add_ps(acc[CHANNELS / 4],
+                _mm_mul_ps(coef, LoadPartialSSE<CHANNELS & 3>(s + (CHANNELS & ~3))));
+    }
+}
+
+// For more than two channels the frames are vectorized across channels rather than
+// deinterleaved, four taps per loop iteration. As in ProcessBase(), the output is
+// overwritten and volumeLR[0] applies to all channels.
+template <int CHANNELS, bool FIXED>
+static inline void ProcessSSEMultiChannel(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS > 2 && CHANNELS <= 8, "CHANNELS must be 3 to 8");
+    enum { VECTORS = (CHANNELS + 3) / 4 };
+
+    __m128 interp;
+    if (!FIXED) {
+        interp = _mm_set1_ps(lerpP);
+    }
+
+    // with a single vector per frame, even and odd taps go to separate accumulators
+    // to shorten the dependency chains. More would not fit the registers.
+    __m128 accP0[VECTORS], accP1[VECTORS];
+    __m128 accN0[VECTORS], accN1[VECTORS];
+    for (int i = 0; i < VECTORS; ++i) {
+        accP0[i] = accP1[i] = accN0[i] = accN1[i] = _mm_setzero_ps();
+    }
+    __m128* const oddP = (VECTORS == 1) ? accP1 : accP0;
+    __m128* const oddN = (VECTORS == 1) ? accN1 : accN0;
+
+    do {
+        __m128 posCoef = _mm_load_ps(coefsP);
+        __m128 negCoef = _mm_load_ps(coefsN);
+        coefsP += 4;
+        coefsN += 4;
+
+        if (!FIXED) { // interpolate, see ProcessSSEIntrinsic()
+            __m128 posCoef1 = _mm_load_ps(coefsP1);
+            __m128 negCoef1 = _mm_load_ps(coefsN1);
+            coefsP1 += 4;
+            coefsN1 += 4;
+
+            posCoef1 = _mm_sub_ps(posCoef1, posCoef);
+            negCoef = _mm_sub_ps(negCoef, negCoef1);
+
+            posCoef1 = _mm_mul_ps(posCoef1, interp);
+            negCoef = _mm_mul_ps(negCoef, interp);
+
+            posCoef = _mm_add_ps(posCoef1, posCoef);
+            negCoef = _mm_add_ps(negCoef, negCoef1);
+        }
+
+        MacFrameSSE<CHANNELS>(accP0, _mm_shuffle_ps(posCoef, posCoef, 0x00), sP);
+        MacFrameSSE<CHANNELS>(accN0, _mm_shuffle_ps(negCoef, negCoef, 0x00), sN);
+        MacFrameSSE<CHANNELS>(oddP, _mm_shuffle_ps(posCoef, posCoef, 0x55), sP - CHANNELS);
+        MacFrameSSE<CHANNELS>(oddN, _mm_shuffle_ps(negCoef, negCoef, 0x55), sN + CHANNELS);
+        MacFrameSSE<CHANNELS>(accP0, _mm_shuffle_ps(posCoef, posCoef, 0xAA), sP - 2*CHANNELS);
+        MacFrameSSE<CHANNELS>(accN0, _mm_shuffle_ps(negCoef, negCoef, 0xAA), sN + 2*CHANNELS);
+        MacFrameSSE<CHANNELS>(oddP, _mm_shuffle_ps(posCoef, posCoef, 0xFF), sP - 3*CHANNELS);
+        MacFrameSSE<CHANNELS>(oddN, _mm_shuffle_ps(negCoef, negCoef, 0xFF), sN + 3*CHANNELS);
+        sP -= 4*CHANNELS;
+        sN += 4*CHANNELS;
+    } while (count -= 4);
+
+    for (int i = 0; i < VECTORS; ++i) {
+        accP0[i] = _mm_add_ps(_mm_add_ps(accP0[i], accP1[i]), _mm_add_ps(accN0[i], accN1[i]));
+    }
+
+    // multiply by volume and save
+    const __m128 vol = _mm_set1_ps(volumeLR[0]);
+    for (int i = 0; i < CHANNELS / 4; ++i) {
+        _mm_storeu_ps(out + 4 * i, _mm_mul_ps(accP0[i], vol));
+    }
+    if (CHANNELS & 3) {
+        StorePartialSSE<CHANNELS & 3>(out + (CHANNELS & ~3),
+                _mm_mul_ps(accP0[CHANNELS / 4], vol));
+    }
+}
+
 template<>
 inline void ProcessL<1, 16>(float* const out,
         int count,
@@ -208,6 +342,45 @@ inline void Process<2, 16>(float* const out,
             lerpP, coefsP1, coefsN1);
 }
 
+#define PROCESS_SSE_MULTICHANNEL(CHANNELS) \
+template<> \
+inline void ProcessL<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* sP, \
+        const float* sN, \
+        const float* const volumeLR) \
+{ \
+    ProcessSSEMultiChannel<CHANNELS, true>(out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/); \
+} \
+\
+template<> \
+inline void Process<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* coefsP1, \
+        const float* coefsN1, \
+        const float* sP, \
+        const float* sN, \
+        float lerpP, \
+        const float* const volumeLR) \
+{ \
+    ProcessSSEMultiChannel<CHANNELS, false>(out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            lerpP, coefsP1, coefsN1); \
+}
+
+PROCESS_SSE_MULTICHANNEL(3)
+PROCESS_SSE_MULTICHANNEL(4)
+PROCESS_SSE_MULTICHANNEL(5)
+PROCESS_SSE_MULTICHANNEL(6)
+PROCESS_SSE_MULTICHANNEL(7)
+PROCESS_SSE_MULTICHANNEL(8)
+
+#undef PROCESS_SSE_MULTICHANNEL
+
 #endif //USE_SSE
 
 } // namespace android
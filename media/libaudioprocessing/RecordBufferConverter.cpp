@@ -74,6 +74,17 @@ void RecordBufferConverter::reset() {
     }
 }
 
+bool RecordBufferConverter::isSharableWith(const RecordBufferConverter &other) const {
+    return mResampler == NULL && other.mResampler == NULL
+            && initCheck() == NO_ERROR && other.initCheck() == NO_ERROR
+            && mSrcChannelMask == other.mSrcChannelMask
+            && mSrcFormat == other.mSrcFormat
+            && mSrcSampleRate == other.mSrcSampleRate
+            && mDstChannelMask == other.mDstChannelMask
+            && mDstFormat == other.mDstFormat
+            && mDstSampleRate == other.mDstSampleRate;
+}
+
 size_t RecordBufferConverter::convert(void *dst,
         AudioBufferProvider *provider, size_t frames)
 {
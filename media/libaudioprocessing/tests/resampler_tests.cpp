@@ -568,3 +568,36 @@ TEST(audioflinger_resampler, filterresponse) {
         }
     }
 }
+
+TEST(audioflinger_resampler, filtersharing) {
+    using ResamplerType = android::AudioResamplerDyn<float, float, float>;
+    auto createResampler = [](int inSampleRate) {
+        ResamplerType *resampler = static_cast<ResamplerType *>(
+                android::AudioResampler::create(
+                        AUDIO_FORMAT_PCM_FLOAT,
+                        2 /* channels */,
+                        48000 /* outputFreq */,
+                        android::AudioResampler::DYN_HIGH_QUALITY));
+        resampler->setSampleRate(inSampleRate);
+        return std::unique_ptr<ResamplerType>(resampler);
+    };
+
+    // resamplers with the same design share the filter
+    std::unique_ptr<ResamplerType> r1 = createResampler(44100);
+    std::unique_ptr<ResamplerType> r2 = createResampler(44100);
+    ASSERT_EQ(r1->getFilterCoefs(), r2->getFilterCoefs());
+
+    // a different ratio needs a filter of its own
+    std::unique_ptr<ResamplerType> r3 = createResampler(96000);
+    ASSERT_NE(r1->getFilterCoefs(), r3->getFilterCoefs());
+
+    // until its rate changes to the one of the others
+    r3->setSampleRate(44100);
+    ASSERT_EQ(r1->getFilterCoefs(), r3->getFilterCoefs());
+
+    // the filter outlives the resampler which designed it
+    r1.reset();
+    const float *coefs = r2->getFilterCoefs();
+    std::unique_ptr<ResamplerType> r4 = createResampler(44100);
+    ASSERT_EQ(coefs, r4->getFilterCoefs());
+}
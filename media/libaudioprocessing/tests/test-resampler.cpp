@@ -36,12 +36,13 @@ using namespace android;
 static bool gVerbose = false;
 
 static int usage(const char* name) {
-    fprintf(stderr,"Usage: %s [-p] [-f] [-F] [-v] [-c channels]"
+    fprintf(stderr,"Usage: %s [-p] [-b] [-f] [-F] [-v] [-c channels]"
                    " [-q {dq|lq|mq|hq|vhq|dlq|dmq|dhq}]"
                    " [-i input-sample-rate] [-o output-sample-rate]"
                    " [-O csv] [-P csv] [<input-file>]"
                    " <output-file>\n", name);
     fprintf(stderr,"    -p    enable profiling\n");
+    fprintf(stderr,"    -b    profile all qualities supporting -c and -F\n");
     fprintf(stderr,"    -f    enable filter profiling\n");
     fprintf(stderr,"    -F    enable floating point -q {dlq|dmq|dhq} only");
     fprintf(stderr,"    -v    verbose : log buffer provider calls\n");
@@ -104,6 +105,7 @@ int parseCSV(const char *string, Vector<int>& values)
 int main(int argc, char* argv[]) {
     const char* const progname = argv[0];
     bool profileResample = false;
+    bool profileAllQualities = false;
     bool profileFilter = false;
     bool useFloat = false;
     int channels = 1;
@@ -114,11 +116,14 @@ int main(int argc, char* argv[]) {
     Vector<int> Pvalues;
 
     int ch;
-    while ((ch = getopt(argc, argv, "pfFvc:q:i:o:O:P:")) != -1) {
+    while ((ch = getopt(argc, argv, "pbfFvc:q:i:o:O:P:")) != -1) {
         switch (ch) {
         case 'p':
             profileResample = true;
             break;
+        case 'b':
+            profileAllQualities = true;
+            break;
         case 'f':
             profileFilter = true;
             break;
@@ -378,30 +383,32 @@ int main(int argc, char* argv[]) {
     }
 
     void* output_vaddr = malloc(output_size);
-    AudioResampler* resampler = AudioResampler::create(format, channels,
-            output_freq, quality);
 
-    resampler->setSampleRate(input_freq);
-    resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
+    /*
+     * For profiling on mobile devices, upon experimentation
+     * it is better to run a few trials with a shorter loop limit,
+     * and take the minimum time.
+     *
+     * Long tests can cause CPU temperature to build up and thermal throttling
+     * to reduce CPU frequency.
+     *
+     * For frequency checks (index=0, or 1, etc.):
+     * "cat /sys/devices/system/cpu/cpu${index}/cpufreq/scaling_*_freq"
+     *
+     * For temperature checks (index=0, or 1, etc.):
+     * "cat /sys/class/thermal/thermal_zone${index}/temp"
+     *
+     * Another way to avoid thermal throttling is to fix the CPU frequency
+     * at a lower level which prevents excessive temperatures.
+     */
+    auto profile = [&](AudioResampler::src_quality profileQuality) {
+        // TODO fix legacy bug: reset does not clear buffers.
+        // use a resampler of its own rather than the one producing the output.
+        AudioResampler* resampler = AudioResampler::create(format, channels,
+                output_freq, profileQuality);
+        resampler->setSampleRate(input_freq);
+        resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
 
-    if (profileResample) {
-        /*
-         * For profiling on mobile devices, upon experimentation
-         * it is better to run a few trials with a shorter loop limit,
-         * and take the minimum time.
-         *
-         * Long tests can cause CPU temperature to build up and thermal throttling
-         * to reduce CPU frequency.
-         *
-         * For frequency checks (index=0, or 1, etc.):
-         * "cat /sys/devices/system/cpu/cpu${index}/cpufreq/scaling_*_freq"
-         *
-         * For temperature checks (index=0, or 1, etc.):
-         * "cat /sys/class/thermal/thermal_zone${index}/temp"
-         *
-         * Another way to avoid thermal throttling is to fix the CPU frequency
-         * at a lower level which prevents excessive temperatures.
-         */
         const int trials = 4;
         const int looplimit = 4;
         timespec start, end;
@@ -423,18 +430,41 @@ int main(int argc, char* argv[]) {
         }
         // Mfrms/s is "Millions of output frames per second".
         printf("quality: %d  channels: %d  msec: %" PRId64 "  Mfrms/s: %.2lf\n",
-                quality, channels, time/1000000, output_frames * looplimit / (time / 1e9) / 1e6);
+                profileQuality, channels, time/1000000,
+                output_frames * looplimit / (time / 1e9) / 1e6);
         resampler->reset();
-
-        // TODO fix legacy bug: reset does not clear buffers.
-        // delete and recreate resampler here.
         delete resampler;
-        resampler = AudioResampler::create(format, channels,
-                    output_freq, quality);
-        resampler->setSampleRate(input_freq);
-        resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
+    };
+
+    if (profileAllQualities) {
+        // only the dynamic resamplers handle float and more than two channels.
+        const AudioResampler::src_quality qualities[] = {
+            AudioResampler::LOW_QUALITY,
+            AudioResampler::MED_QUALITY,
+            AudioResampler::HIGH_QUALITY,
+            AudioResampler::VERY_HIGH_QUALITY,
+            AudioResampler::DYN_LOW_QUALITY,
+            AudioResampler::DYN_MED_QUALITY,
+            AudioResampler::DYN_HIGH_QUALITY,
+        };
+        for (AudioResampler::src_quality profileQuality : qualities) {
+            if ((useFloat || channels > 2)
+                    && profileQuality < AudioResampler::DYN_LOW_QUALITY) {
+                continue;
+            }
+            profile(profileQuality);
+        }
+    }
+    if (profileResample) {
+        profile(quality);
     }
 
+    AudioResampler* resampler = AudioResampler::create(format, channels,
+            output_freq, quality);
+
+    resampler->setSampleRate(input_freq);
+    resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
+
     memset(output_vaddr, 0, output_size);
     if (gVerbose) {
         printf("resample() %zu output frames\n", output_frames);
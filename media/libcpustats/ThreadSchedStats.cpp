@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ThreadSchedStats"
+//#define LOG_NDEBUG 0
+
+#include <sched.h>
+#include <time.h>
+
+#include <utils/Log.h>
+
+#include <cpustats/ThreadSchedStats.h>
+
+namespace android {
+
+static int64_t getNs(clockid_t clock)
+{
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) {
+        return -1;
+    }
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void ThreadSchedStats::willSleep(int64_t sleepNs)
+{
+    const int64_t nowNs = getNs(CLOCK_MONOTONIC);
+    mExpectedWakeNs = nowNs < 0 || sleepNs < 0 ? -1 : nowNs + sleepNs;
+}
+
+void ThreadSchedStats::didWake()
+{
+    mLastWakeupLatencyNs = -1;
+    if (mExpectedWakeNs >= 0) {
+        const int64_t nowNs = getNs(CLOCK_MONOTONIC);
+        if (nowNs >= 0) {
+            // waking up early is not a latency, e.g. a nanosleep() with coarse timer slack
+            mLastWakeupLatencyNs = nowNs > mExpectedWakeNs ? nowNs - mExpectedWakeNs : 0;
+            mWakeupLatencyNs.sample(mLastWakeupLatencyNs);
+        }
+        mExpectedWakeNs = -1;
+    }
+
+    const int64_t cpuNs = getNs(CLOCK_THREAD_CPUTIME_ID);
+    mLastCpuNs = -1;
+    if (cpuNs >= 0 && mPreviousCpuNs >= 0) {
+        mLastCpuNs = cpuNs - mPreviousCpuNs;
+        mCpuNs.sample(mLastCpuNs);
+    }
+    mPreviousCpuNs = cpuNs;
+
+#ifdef __linux__
+    const int cpu = sched_getcpu();
+    if (cpu >= 0) {
+        if (mCpu >= 0 && cpu != mCpu) {
+            ALOGV("migrated from CPU %d to %d", mCpu, cpu);
+            ++mMigrations;
+        }
+        mCpu = cpu;
+    }
+#endif
+}
+
+void ThreadSchedStats::reset()
+{
+    mExpectedWakeNs = -1;
+    mPreviousCpuNs = -1;
+    mCpu = -1;
+    mMigrations = 0;
+    mLastWakeupLatencyNs = -1;
+    mLastCpuNs = -1;
+    mWakeupLatencyNs.reset();
+    mCpuNs.reset();
+}
+
+}   // namespace android
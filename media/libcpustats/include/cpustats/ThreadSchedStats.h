@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _THREAD_SCHED_STATS_H
+#define _THREAD_SCHED_STATS_H
+
+#include <stdint.h>
+
+#include <cpustats/CentralTendencyStatistics.h>
+
+namespace android {
+
+// Track scheduling behavior of the current thread for cyclic threads that sleep for a known
+// duration between cycles: the wake-up latency, i.e. how late the thread actually ran compared
+// to when it asked to be woken up, the CPU time used per cycle, and the number of times the
+// thread was migrated to another CPU.
+// Usage: call willSleep() with the requested sleep duration just before sleeping, and
+// didWake() as soon as the thread runs again.  Cycles without a known sleep duration
+// (e.g. sched_yield or blocking I/O) may call didWake() alone to update the CPU time
+// and migration count without a latency sample.
+// There are no system calls other than clock_gettime() and sched_getcpu(), and no allocation,
+// so it may be used from real-time threads.
+// Like ThreadCpuUsage, this class is not thread-safe and may only be used by the current thread.
+
+class ThreadSchedStats
+{
+
+public:
+    ThreadSchedStats() :
+        mExpectedWakeNs(-1),
+        mPreviousCpuNs(-1),
+        mCpu(-1),
+        mMigrations(0),
+        mLastWakeupLatencyNs(-1),
+        mLastCpuNs(-1)
+        { }
+
+    ~ThreadSchedStats() { }
+
+    // Called just before sleeping for sleepNs nanoseconds of CLOCK_MONOTONIC.
+    void willSleep(int64_t sleepNs);
+
+    // Called as soon as possible after waking up.  Updates the latency and CPU time statistics,
+    // and the migration count.
+    void didWake();
+
+    // Forget a pending wake-up expectation, e.g. when the sleep was interrupted or skipped.
+    void cancelSleep() { mExpectedWakeNs = -1; }
+
+    // Wake-up latency in ns of the most recent cycle, or -1 if it had no expected wake-up time.
+    int64_t lastWakeupLatencyNs() const { return mLastWakeupLatencyNs; }
+
+    // Thread CPU time in ns between the two most recent calls to didWake(), or -1 if unknown.
+    int64_t lastCpuNs() const { return mLastCpuNs; }
+
+    // CPU the thread ran on at the most recent call to didWake(), or -1 if unknown.
+    int cpu() const { return mCpu; }
+
+    // Total number of times the thread was seen on a different CPU than at the previous wake-up.
+    uint32_t migrations() const { return mMigrations; }
+
+    // Statistics of wake-up latency and of CPU time per cycle, both in ns.
+    const CentralTendencyStatistics& wakeupLatencyNs() const { return mWakeupLatencyNs; }
+    const CentralTendencyStatistics& cpuNs() const { return mCpuNs; }
+
+    // Reset all statistics and counters, e.g. when the thread goes idle.
+    void reset();
+
+private:
+    int64_t  mExpectedWakeNs;       // CLOCK_MONOTONIC time requested by willSleep(), or -1
+    int64_t  mPreviousCpuNs;        // CLOCK_THREAD_CPUTIME_ID at previous didWake(), or -1
+    int      mCpu;                  // CPU at previous didWake(), or -1
+    uint32_t mMigrations;
+    int64_t  mLastWakeupLatencyNs;
+    int64_t  mLastCpuNs;
+    CentralTendencyStatistics mWakeupLatencyNs;
+    CentralTendencyStatistics mCpuNs;
+
+};  // class ThreadSchedStats
+
+}   // namespace android
+
+#endif //  _THREAD_SCHED_STATS_H
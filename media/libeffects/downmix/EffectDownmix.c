@@ -26,6 +26,10 @@
 
 #include "EffectDownmix.h"
 
+#if defined(BUILD_FLOAT) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#include <arm_neon.h>
+#endif
+
 // Do not submit with DOWNMIX_TEST_CHANNEL_INDEX defined, strictly for testing
 //#define DOWNMIX_TEST_CHANNEL_INDEX 0
 // Do not submit with DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER defined, strictly for testing
@@ -165,10 +169,17 @@ static bool Downmix_validChannelMask(uint32_t mask)
         return false;
     }
     // check against unsupported channels
+#ifdef BUILD_FLOAT
+    if (mask & ~kFoldable) {
+        ALOGE("Unsupported channels (beyond top back right)");
+        return false;
+    }
+#else
     if (mask & kUnsupported) {
         ALOGE("Unsupported channels (top or front left/right of center)");
         return false;
     }
+#endif
     // verify has FL/FR
     if ((mask & AUDIO_CHANNEL_OUT_STEREO) != AUDIO_CHANNEL_OUT_STEREO) {
         ALOGE("Front channels must be present");
@@ -436,7 +447,6 @@ static int Downmix_Process(effect_handle_t self,
 
     const bool accumulate =
             (pDwmModule->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
-    const uint32_t downmixInputChannelMask = pDwmModule->config.inputCfg.channels;
 
     switch(pDownmixer->type) {
 
@@ -461,38 +471,9 @@ static int Downmix_Process(effect_handle_t self,
           break;
 
       case DOWNMIX_TYPE_FOLD:
-#ifdef DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER
-          // bypass the optimized downmix routines for the common formats
-          if (!Downmix_foldGeneric(
-                  downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-              ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported",
-                    downmixInputChannelMask);
-              return -EINVAL;
-          }
-          break;
-#endif
-        // optimize for the common formats
-        switch((downmix_input_channel_mask_t)downmixInputChannelMask) {
-        case CHANNEL_MASK_QUAD_BACK:
-        case CHANNEL_MASK_QUAD_SIDE:
-            Downmix_foldFromQuad(pSrc, pDst, numFrames, accumulate);
-            break;
-        case CHANNEL_MASK_5POINT1_BACK:
-        case CHANNEL_MASK_5POINT1_SIDE:
-            Downmix_foldFrom5Point1(pSrc, pDst, numFrames, accumulate);
-            break;
-        case CHANNEL_MASK_7POINT1:
-            Downmix_foldFrom7Point1(pSrc, pDst, numFrames, accumulate);
-            break;
-        default:
-            if (!Downmix_foldGeneric(
-                    downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-                ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported",
-                      downmixInputChannelMask);
-                return -EINVAL;
-            }
-            break;
-        }
+        // the same matrix product for all the formats, the gains were computed when configuring
+        Downmix_foldMatrix(pDownmixer->fold_matrix, pDownmixer->input_channel_count,
+                pSrc, pDst, numFrames, accumulate);
         break;
 
       default:
@@ -703,7 +684,11 @@ int Downmix_Init(downmix_module_t *pDwmModule) {
     memset(&pDwmModule->context, 0, sizeof(downmix_object_t));
 
     pDwmModule->config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+#ifdef BUILD_FLOAT
+    pDwmModule->config.inputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+#else
     pDwmModule->config.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+#endif
     pDwmModule->config.inputCfg.channels = AUDIO_CHANNEL_OUT_7POINT1;
     pDwmModule->config.inputCfg.bufferProvider.getBuffer = NULL;
     pDwmModule->config.inputCfg.bufferProvider.releaseBuffer = NULL;
@@ -715,7 +700,11 @@ int Downmix_Init(downmix_module_t *pDwmModule) {
 
     // set a default value for the access mode, but should be overwritten by caller
     pDwmModule->config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_ACCUMULATE;
+#ifdef BUILD_FLOAT
+    pDwmModule->config.outputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+#else
     pDwmModule->config.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+#endif
     pDwmModule->config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
     pDwmModule->config.outputCfg.bufferProvider.getBuffer = NULL;
     pDwmModule->config.outputCfg.bufferProvider.releaseBuffer = NULL;
@@ -759,11 +748,17 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
 
     downmix_object_t *pDownmixer = &pDwmModule->context;
 
+#ifdef BUILD_FLOAT
+    const audio_format_t format = AUDIO_FORMAT_PCM_FLOAT;
+#else
+    const audio_format_t format = AUDIO_FORMAT_PCM_16_BIT;
+#endif
+
     // Check configuration compatibility with build options, and effect capabilities
     if (pConfig->inputCfg.samplingRate != pConfig->outputCfg.samplingRate
         || pConfig->outputCfg.channels != DOWNMIX_OUTPUT_CHANNELS
-        || pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT
-        || pConfig->outputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+        || pConfig->inputCfg.format != format
+        || pConfig->outputCfg.format != format) {
         ALOGE("Downmix_Configure error: invalid config");
         return -EINVAL;
     }
@@ -786,6 +781,9 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
         pDownmixer->input_channel_count =
                 audio_channel_count_from_out_mask(pConfig->inputCfg.channels);
     }
+#ifdef BUILD_FLOAT
+    Downmix_computeFoldMatrix(pConfig->inputCfg.channels, pDownmixer->fold_matrix);
+#endif
 
     Downmix_Reset(pDownmixer, init);
 
@@ -966,34 +964,6 @@ void Downmix_foldFromQuad(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool ac
         }
     }
 }
-#else
-void Downmix_foldFromQuad(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate) {
-    // sample at index 0 is FL
-    // sample at index 1 is FR
-    // sample at index 2 is RL
-    // sample at index 3 is RR
-    if (accumulate) {
-        while (numFrames) {
-            // FL + RL
-            pDst[0] = clamp_float(pDst[0] + ((pSrc[0] + pSrc[2]) / 2.0f));
-            // FR + RR
-            pDst[1] = clamp_float(pDst[1] + ((pSrc[1] + pSrc[3]) / 2.0f));
-            pSrc += 4;
-            pDst += 2;
-            numFrames--;
-        }
-    } else { // same code as above but without adding and clamping pDst[i] to itself
-        while (numFrames) {
-            // FL + RL
-            pDst[0] = clamp_float((pSrc[0] + pSrc[2]) / 2.0f);
-            // FR + RR
-            pDst[1] = clamp_float((pSrc[1] + pSrc[3]) / 2.0f);
-            pSrc += 4;
-            pDst += 2;
-            numFrames--;
-        }
-    }
-}
 #endif
 
 /*----------------------------------------------------------------------------
@@ -1058,51 +1028,6 @@ void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
         }
     }
 }
-#else
-void Downmix_foldFrom5Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate) {
-    LVM_FLOAT lt, rt, centerPlusLfeContrib; // samples in Q19.12 format
-    // sample at index 0 is FL
-    // sample at index 1 is FR
-    // sample at index 2 is FC
-    // sample at index 3 is LFE
-    // sample at index 4 is RL
-    // sample at index 5 is RR
-    // code is mostly duplicated between the two values of accumulate to avoid repeating the test
-    // for every sample
-    if (accumulate) {
-        while (numFrames) {
-            // centerPlusLfeContrib = FC(-3dB) + LFE(-3dB)
-            centerPlusLfeContrib = (pSrc[2] * MINUS_3_DB_IN_FLOAT)
-                    + (pSrc[3] * MINUS_3_DB_IN_FLOAT);
-            // FL + centerPlusLfeContrib + RL
-            lt = pSrc[0] + centerPlusLfeContrib + pSrc[4];
-            // FR + centerPlusLfeContrib + RR
-            rt = pSrc[1] + centerPlusLfeContrib + pSrc[5];
-            // accumulate in destination
-            pDst[0] = clamp_float(pDst[0] + (lt / 2.0f));
-            pDst[1] = clamp_float(pDst[1] + (rt / 2.0f));
-            pSrc += 6;
-            pDst += 2;
-            numFrames--;
-        }
-    } else { // same code as above but without adding and clamping pDst[i] to itself
-        while (numFrames) {
-            // centerPlusLfeContrib = FC(-3dB) + LFE(-3dB)
-            centerPlusLfeContrib = (pSrc[2] * MINUS_3_DB_IN_FLOAT)
-                    + (pSrc[3] * MINUS_3_DB_IN_FLOAT);
-            // FL + centerPlusLfeContrib + RL
-            lt = pSrc[0] + centerPlusLfeContrib + pSrc[4];
-            // FR + centerPlusLfeContrib + RR
-            rt = pSrc[1] + centerPlusLfeContrib + pSrc[5];
-            // store in destination
-            pDst[0] = clamp_float(lt / 2.0f); // differs from when accumulate is true above
-            pDst[1] = clamp_float(rt / 2.0f); // differs from when accumulate is true above
-            pSrc += 6;
-            pDst += 2;
-            numFrames--;
-        }
-    }
-}
 #endif
 
 /*----------------------------------------------------------------------------
@@ -1169,53 +1094,6 @@ void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
         }
     }
 }
-#else
-void Downmix_foldFrom7Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate) {
-    LVM_FLOAT lt, rt, centerPlusLfeContrib; // samples in Q19.12 format
-    // sample at index 0 is FL
-    // sample at index 1 is FR
-    // sample at index 2 is FC
-    // sample at index 3 is LFE
-    // sample at index 4 is RL
-    // sample at index 5 is RR
-    // sample at index 6 is SL
-    // sample at index 7 is SR
-    // code is mostly duplicated between the two values of accumulate to avoid repeating the test
-    // for every sample
-    if (accumulate) {
-        while (numFrames) {
-            // centerPlusLfeContrib = FC(-3dB) + LFE(-3dB)
-            centerPlusLfeContrib = (pSrc[2] * MINUS_3_DB_IN_Q19_12)
-                    + (pSrc[3] * MINUS_3_DB_IN_Q19_12);
-            // FL + centerPlusLfeContrib + SL + RL
-            lt = pSrc[0] + centerPlusLfeContrib + pSrc[6] + pSrc[4];
-            // FR + centerPlusLfeContrib + SR + RR
-            rt = pSrc[1] + centerPlusLfeContrib + pSrc[7] + pSrc[5];
-            //accumulate in destination
-            pDst[0] = clamp_float(pDst[0] + (lt / 2.0f));
-            pDst[1] = clamp_float(pDst[1] + (rt / 2.0f));
-            pSrc += 8;
-            pDst += 2;
-            numFrames--;
-        }
-    } else { // same code as above but without adding and clamping pDst[i] to itself
-        while (numFrames) {
-            // centerPlusLfeContrib = FC(-3dB) + LFE(-3dB)
-            centerPlusLfeContrib = (pSrc[2] * MINUS_3_DB_IN_FLOAT)
-                    + (pSrc[3] * MINUS_3_DB_IN_FLOAT);
-            // FL + centerPlusLfeContrib + SL + RL
-            lt = pSrc[0] + centerPlusLfeContrib + pSrc[6] + pSrc[4];
-            // FR + centerPlusLfeContrib + SR + RR
-            rt = pSrc[1] + centerPlusLfeContrib + pSrc[7] + pSrc[5];
-            // store in destination
-            pDst[0] = clamp_float(lt / 2.0f); // differs from when accumulate is true above
-            pDst[1] = clamp_float(rt / 2.0f); // differs from when accumulate is true above
-            pSrc += 8;
-            pDst += 2;
-            numFrames--;
-        }
-    }
-}
 #endif
 /*----------------------------------------------------------------------------
  * Downmix_foldGeneric()
@@ -1335,96 +1213,129 @@ bool Downmix_foldGeneric(
     }
     return true;
 }
-#else
-bool Downmix_foldGeneric(
-        uint32_t mask, LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate) {
+#endif
+#ifdef BUILD_FLOAT
+/*----------------------------------------------------------------------------
+ * Downmix_computeFoldMatrix()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * compute the left and right gains of each channel of a multichannel signal folded to stereo:
+ *  - left channels (FL, BL, SL, FLC, TFL, TBL) go to the left output
+ *  - right channels (FR, BR, SR, FRC, TFR, TBR) go to the right output
+ *  - center channels and LFE (FC, LFE, BC, TC, TFC, TBC) go to both outputs at -3dB
+ *  - the result is attenuated by 6dB, as done by the previous per layout downmixers
+ * Called when the input configuration changes so that processing is a single matrix product.
+ *
+ * Inputs:
+ *  mask       the channel mask of the signal to downmix
+ *
+ * Outputs:
+ *  matrix     left and right gains of each channel, in the order of the samples
+ *
+ * Returns: false if multichannel format is not supported
+ *
+ *----------------------------------------------------------------------------
+ */
+bool Downmix_computeFoldMatrix(uint32_t mask, LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2]) {
 
     if (!Downmix_validChannelMask(mask)) {
         return false;
     }
 
-    const bool hasSides = (mask & kSides) != 0;
-    const bool hasBacks = (mask & kBacks) != 0;
+    const uint32_t kLefts = AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_BACK_LEFT |
+            AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER |
+            AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT | AUDIO_CHANNEL_OUT_TOP_BACK_LEFT;
+    const uint32_t kRights = AUDIO_CHANNEL_OUT_FRONT_RIGHT | AUDIO_CHANNEL_OUT_BACK_RIGHT |
+            AUDIO_CHANNEL_OUT_SIDE_RIGHT | AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER |
+            AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT | AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT;
+
+    // samples are in the order of the channel mask bits
+    int index = 0;
+    for (uint32_t channel = 1; channel & kFoldable; channel <<= 1) {
+        if ((mask & channel) == 0) {
+            continue;
+        }
+        if (channel & kLefts) {
+            matrix[index][0] = 0.5f;
+            matrix[index][1] = 0.0f;
+        } else if (channel & kRights) {
+            matrix[index][0] = 0.0f;
+            matrix[index][1] = 0.5f;
+        } else {
+            matrix[index][0] = MINUS_3_DB_IN_FLOAT * 0.5f;
+            matrix[index][1] = MINUS_3_DB_IN_FLOAT * 0.5f;
+        }
+        index++;
+    }
+    for (; index < DOWNMIX_MAX_INPUT_CHANNELS; index++) {
+        matrix[index][0] = 0.0f;
+        matrix[index][1] = 0.0f;
+    }
+    return true;
+}
 
-    const int numChan = audio_channel_count_from_out_mask(mask);
-    const bool hasFC = ((mask & AUDIO_CHANNEL_OUT_FRONT_CENTER) == AUDIO_CHANNEL_OUT_FRONT_CENTER);
-    const bool hasLFE =
-            ((mask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY) == AUDIO_CHANNEL_OUT_LOW_FREQUENCY);
-    const bool hasBC = ((mask & AUDIO_CHANNEL_OUT_BACK_CENTER) == AUDIO_CHANNEL_OUT_BACK_CENTER);
-    // compute at what index each channel is: samples will be in the following order:
-    //   FL FR FC LFE BL BR BC SL SR
-    // when a channel is not present, its index is set to the same as the index of the preceding
-    // channel
-    const int indexFC  = hasFC    ? 2            : 1;        // front center
-    const int indexLFE = hasLFE   ? indexFC + 1  : indexFC;  // low frequency
-    const int indexBL  = hasBacks ? indexLFE + 1 : indexLFE; // back left
-    const int indexBR  = hasBacks ? indexBL + 1  : indexBL;  // back right
-    const int indexBC  = hasBC    ? indexBR + 1  : indexBR;  // back center
-    const int indexSL  = hasSides ? indexBC + 1  : indexBC;  // side left
-    const int indexSR  = hasSides ? indexSL + 1  : indexSL;  // side right
+/*----------------------------------------------------------------------------
+ * Downmix_foldMatrix()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * downmix to stereo a multichannel signal with the gains computed by
+ * Downmix_computeFoldMatrix(). Each frame is processed as one left/right vector
+ * accumulating the contribution of every input channel.
+ *
+ * Inputs:
+ *  matrix     left and right gains of each input channel
+ *  numChan    the number of channels of pSrc
+ *  pSrc       multichannel audio buffer to downmix
+ *  numFrames  the number of multichannel frames to downmix
+ *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
+ *               or overwrite pDst (when false)
+ *
+ * Outputs:
+ *  pDst       downmixed stereo audio samples
+ *
+ *----------------------------------------------------------------------------
+ */
+void Downmix_foldMatrix(LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2], uint32_t numChan,
+        LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate) {
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    float32x2_t gains[DOWNMIX_MAX_INPUT_CHANNELS];
+    for (uint32_t i = 0; i < numChan; i++) {
+        gains[i] = vld1_f32(matrix[i]);
+    }
+    const float32x2_t minusOne = vdup_n_f32(-1.0f);
+    const float32x2_t one = vdup_n_f32(1.0f);
 
-    LVM_FLOAT lt, rt, centersLfeContrib;
-    // code is mostly duplicated between the two values of accumulate to avoid repeating the test
-    // for every sample
-    if (accumulate) {
-        while (numFrames) {
-            // compute contribution of FC, BC and LFE
-            centersLfeContrib = 0;
-            if (hasFC)  { centersLfeContrib += pSrc[indexFC]; }
-            if (hasLFE) { centersLfeContrib += pSrc[indexLFE]; }
-            if (hasBC)  { centersLfeContrib += pSrc[indexBC]; }
-            centersLfeContrib *= MINUS_3_DB_IN_FLOAT;
-            // always has FL/FR
-            lt = pSrc[0];
-            rt = pSrc[1];
-            // mix in sides and backs
-            if (hasSides) {
-                lt += pSrc[indexSL];
-                rt += pSrc[indexSR];
-            }
-            if (hasBacks) {
-                lt += pSrc[indexBL];
-                rt += pSrc[indexBR];
-            }
-            lt += centersLfeContrib;
-            rt += centersLfeContrib;
-            // accumulate in destination
-            pDst[0] = clamp_float(pDst[0] + (lt / 2.0f));
-            pDst[1] = clamp_float(pDst[1] + (rt / 2.0f));
-            pSrc += numChan;
-            pDst += 2;
-            numFrames--;
+    while (numFrames) {
+        float32x2_t out = vmul_n_f32(gains[0], pSrc[0]);
+        for (uint32_t i = 1; i < numChan; i++) {
+            out = vmla_n_f32(out, gains[i], pSrc[i]);
         }
-    } else {
-        while (numFrames) {
-            // compute contribution of FC, BC and LFE
-            centersLfeContrib = 0;
-            if (hasFC)  { centersLfeContrib += pSrc[indexFC]; }
-            if (hasLFE) { centersLfeContrib += pSrc[indexLFE]; }
-            if (hasBC)  { centersLfeContrib += pSrc[indexBC]; }
-            centersLfeContrib *= MINUS_3_DB_IN_FLOAT;
-            // always has FL/FR
-            lt = pSrc[0];
-            rt = pSrc[1];
-            // mix in sides and backs
-            if (hasSides) {
-                lt += pSrc[indexSL];
-                rt += pSrc[indexSR];
-            }
-            if (hasBacks) {
-                lt += pSrc[indexBL];
-                rt += pSrc[indexBR];
-            }
-            lt += centersLfeContrib;
-            rt += centersLfeContrib;
-            // store in destination
-            pDst[0] = clamp_float(lt / 2.0f); // differs from when accumulate is true above
-            pDst[1] = clamp_float(rt / 2.0f); // differs from when accumulate is true above
-            pSrc += numChan;
-            pDst += 2;
-            numFrames--;
+        if (accumulate) {
+            out = vadd_f32(out, vld1_f32(pDst));
         }
+        vst1_f32(pDst, vmin_f32(vmax_f32(out, minusOne), one));
+        pSrc += numChan;
+        pDst += 2;
+        numFrames--;
     }
-    return true;
+#else
+    while (numFrames) {
+        LVM_FLOAT lt = matrix[0][0] * pSrc[0];
+        LVM_FLOAT rt = matrix[0][1] * pSrc[0];
+        for (uint32_t i = 1; i < numChan; i++) {
+            lt += matrix[i][0] * pSrc[i];
+            rt += matrix[i][1] * pSrc[i];
+        }
+        if (accumulate) {
+            lt += pDst[0];
+            rt += pDst[1];
+        }
+        pDst[0] = clamp_float(lt);
+        pDst[1] = clamp_float(rt);
+        pSrc += numChan;
+        pDst += 2;
+        numFrames--;
+    }
+#endif
 }
-#endif
\ No newline at end of file
+#endif
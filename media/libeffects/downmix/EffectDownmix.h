@@ -29,6 +29,9 @@
 #define DOWNMIX_OUTPUT_CHANNELS AUDIO_CHANNEL_OUT_STEREO
 #ifdef BUILD_FLOAT
 #define LVM_FLOAT float
+// number of channel positions the fold matrix covers, AUDIO_CHANNEL_OUT_FRONT_LEFT to
+// AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT
+#define DOWNMIX_MAX_INPUT_CHANNELS 18
 #endif
 typedef enum {
     DOWNMIX_STATE_UNINITIALIZED,
@@ -42,6 +45,10 @@ typedef struct {
     downmix_type_t type;
     bool apply_volume_correction;
     uint8_t input_channel_count;
+#ifdef BUILD_FLOAT
+    // left and right gains of each input channel, computed from the input channel mask
+    LVM_FLOAT fold_matrix[DOWNMIX_MAX_INPUT_CHANNELS][2];
+#endif
 } downmix_object_t;
 
 
@@ -53,6 +60,10 @@ typedef struct downmix_module_s {
 
 const uint32_t kSides = AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT;
 const uint32_t kBacks = AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT;
+#ifdef BUILD_FLOAT
+// channels the fold matrix handles, all the others are unsupported
+const uint32_t kFoldable = (AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT << 1) - 1;
+#endif
 const uint32_t kUnsupported =
         AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER | AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER |
         AUDIO_CHANNEL_OUT_TOP_CENTER |
@@ -98,11 +109,9 @@ int Downmix_Reset(downmix_object_t *pDownmixer, bool init);
 int Downmix_setParameter(downmix_object_t *pDownmixer, int32_t param, uint32_t size, void *pValue);
 int Downmix_getParameter(downmix_object_t *pDownmixer, int32_t param, uint32_t *pSize, void *pValue);
 #ifdef BUILD_FLOAT
-void Downmix_foldFromQuad(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
-void Downmix_foldFrom5Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
-void Downmix_foldFrom7Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
-bool Downmix_foldGeneric(
-        uint32_t mask, LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
+bool Downmix_computeFoldMatrix(uint32_t mask, LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2]);
+void Downmix_foldMatrix(LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2], uint32_t numChan,
+        LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
 #else
 void Downmix_foldFromQuad(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
 void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
@@ -74,6 +74,7 @@ void ChannelBuffer::initBuffers(unsigned int blockSize, unsigned int overlapSize
     input.resize(mBlockSize);
     output.resize(mBlockSize);
     outTail.resize(overlapSize);
+    complexTemp.resize(halfFftSize);
 
     //module vectors
     mPreEqFactorVector.resize(halfFftSize, 1.0);
@@ -172,6 +173,10 @@ void DPFrequency::configure(size_t blockSize, size_t overlapSize,
     mBlocksPerSecond = (float)mSamplingRate / (mBlockSize - mOverlapSize);
 
     fill_window(mVWindow, RDSP_WINDOW_HANNING_FLAT_TOP, mBlockSize, mOverlapSize);
+    mVWindowedInput.resize(mBlockSize);
+
+    //the input is real: only compute and keep the non-negative frequencies.
+    mFftServer.SetFlag(Eigen::FFT<float>::HalfSpectrum);
 
     //compute window rms for energy compensation
     mWindowRms = 0;
@@ -482,8 +487,9 @@ size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
     //##apply window
     Eigen::Map<Eigen::VectorXf> eWindow(&mVWindow[0], mVWindow.size());
     Eigen::Map<Eigen::VectorXf> eInput(&cb.input[0], cb.input.size());
+    Eigen::Map<Eigen::VectorXf> eWin(&mVWindowedInput[0], mVWindowedInput.size());
 
-    Eigen::VectorXf eWin = eInput.cwiseProduct(eWindow); //apply window
+    eWin = eInput.cwiseProduct(eWindow); //apply window, no allocation
 
     //##fft
     //Note: we are using eigen with the default scaling, which ensures that
@@ -492,7 +498,7 @@ size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
     mFftServer.fwd(cb.complexTemp, eWin);
 
     size_t cSize = cb.complexTemp.size();
-    size_t maxBin = std::min(cSize/2, mHalfFFTSize);
+    size_t maxBin = std::min(cSize - 1, mHalfFFTSize); //Nyquist bin excluded
 
     //== EqPre (always runs)
     for (size_t k = 0; k < maxBin; k++) {
@@ -509,11 +515,12 @@ size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
             float preGainFactor = dBtoLinear(pMbcBandParams->gainPreDb);
             float preGainSquared = preGainFactor * preGainFactor;
 
-            for (size_t k = pMbcBandParams->binStart; k <= pMbcBandParams->binStop; k++) {
+            for (size_t k = pMbcBandParams->binStart;
+                    k <= pMbcBandParams->binStop && k < cSize; k++) {
                 fEnergySum += std::norm(cb.complexTemp[k]) * preGainSquared; //mag squared
             }
 
-            //Eigen FFT is full spectrum, even if the source was real data.
+            //Eigen FFT only keeps half of the spectrum of the real data.
             // Each half spectrum has half the energy. This is taken into account with the * 2
             // factor in the energy computations.
             // energy = sqrt(sum_components_squared) number_points
@@ -570,7 +577,8 @@ size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
             newFactor *= dBtoLinear(pMbcBandParams->gainPostDb);
 
             //apply to this band
-            for (size_t k = pMbcBandParams->binStart; k <= pMbcBandParams->binStop; k++) {
+            for (size_t k = pMbcBandParams->binStart;
+                    k <= pMbcBandParams->binStop && k < cSize; k++) {
                 cb.complexTemp[k] *= newFactor;
             }
 
@@ -660,7 +668,7 @@ size_t DPFrequency::processLastStages(ChannelBuffer &cb) {
     //apply to all if != 1.0
     if (!compareEquality(outputGainFactor, 1.0f)) {
         size_t cSize = cb.complexTemp.size();
-        size_t maxBin = std::min(cSize/2, mHalfFFTSize);
+        size_t maxBin = std::min(cSize - 1, mHalfFFTSize); //Nyquist bin excluded
         for (size_t k = 0; k < maxBin; k++) {
             cb.complexTemp[k] *= outputGainFactor;
         }
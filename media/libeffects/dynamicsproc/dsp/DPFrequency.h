@@ -151,6 +151,7 @@ private:
 
     //dsp
     FloatVec mVWindow;  //window class.
+    FloatVec mVWindowedInput; //temp vector for the windowed input of the fft
     float mWindowRms;
     Eigen::FFT<float> mFftServer;
 };
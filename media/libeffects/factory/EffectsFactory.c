@@ -291,6 +291,15 @@ int EffectCreate(const effect_uuid_t *uuid, int32_t sessionId, int32_t ioId, eff
         }
     }
 
+    // libraries enumerated from the descriptor cache are opened on first use
+    if (l->handle == NULL) {
+        ret = openEffectLibrary(l);
+        if (ret != 0) {
+            ALOGW("EffectCreate() could not open library %s for fx %s", l->name, d->name);
+            goto exit;
+        }
+    }
+
     // create effect in library
     ret = l->desc->create_effect(uuid, sessionId, ioId, &itfe);
     if (ret != 0) {
@@ -556,7 +565,7 @@ int EffectDumpEffects(int fd) {
         l = (lib_entry_t *)e->object;
         list_elem_t *efx = l->effects;
         dprintf(fd, " Library %s\n", l->name);
-        dprintf(fd, "  path: %s\n", l->path);
+        dprintf(fd, "  path: %s%s\n", l->path, l->handle == NULL ? " (not opened yet)" : "");
         if (!efx) {
             dprintf(fd, "  (no effects)\n");
         }
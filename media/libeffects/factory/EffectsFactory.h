@@ -29,6 +29,10 @@ extern "C" {
 
 #define PROPERTY_IGNORE_EFFECTS "ro.audio.ignore_effects"
 
+// Descriptors of the effects found in the libraries during a previous boot.
+// Libraries whose descriptors are all cached are only opened on first effect creation.
+#define EFFECTS_DESCRIPTOR_CACHE_FILE "/data/vendor/audio/effects_descriptors.cache"
+
 typedef struct list_elem_s {
     void *object;
     struct list_elem_s *next;
@@ -47,7 +51,7 @@ typedef struct lib_entry_s {
     audio_effect_library_t *desc;
     char *name;
     char *path;
-    void *handle;
+    void *handle; // NULL until the library is opened, see openEffectLibrary()
     list_elem_t *effects; //list of effect_descriptor_t
     pthread_mutex_t lock;
 } lib_entry_t;
@@ -16,6 +16,8 @@
 
 #define LOG_TAG "EffectsFactoryState"
 
+#include <dlfcn.h>
+
 #include "EffectsFactoryState.h"
 
 #include "log/log.h"
@@ -70,6 +72,45 @@ int findEffect(const effect_uuid_t *type,
     return ret;
 }
 
+int openEffectLibrary(lib_entry_t *lib)
+{
+    void *hdl = dlopen(lib->path, RTLD_NOW);
+    if (hdl == NULL) {
+        ALOGE("Could not dlopen library %s: %s", lib->path, dlerror());
+        return -ENODEV;
+    }
+
+    audio_effect_library_t *desc =
+            (audio_effect_library_t *)dlsym(hdl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+    if (desc == NULL) {
+        ALOGE("Invalid effect library, failed not find symbol '%s' in %s: %s",
+              AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR, lib->path, dlerror());
+        dlclose(hdl);
+        return -EINVAL;
+    }
+
+    if (desc->tag != AUDIO_EFFECT_LIBRARY_TAG) {
+        ALOGE("Bad tag %#08x in description structure, expected %#08x for library %s",
+              desc->tag, AUDIO_EFFECT_LIBRARY_TAG, lib->path);
+        dlclose(hdl);
+        return -EINVAL;
+    }
+
+    uint32_t majorVersion = EFFECT_API_VERSION_MAJOR(desc->version);
+    uint32_t expectedMajorVersion = EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION);
+    if (majorVersion != expectedMajorVersion) {
+        ALOGE("Unsupported major version %#08x, expected %#08x for library %s",
+              majorVersion, expectedMajorVersion, lib->path);
+        dlclose(hdl);
+        return -EINVAL;
+    }
+
+    lib->handle = hdl;
+    lib->desc = desc;
+    ALOGV("openEffectLibrary() opened library %s", lib->path);
+    return 0;
+}
+
 int stringToUuid(const char *str, effect_uuid_t *uuid)
 {
     int tmp[10];
@@ -46,6 +46,10 @@ int findEffect(const effect_uuid_t *type,
                lib_entry_t **lib,
                effect_descriptor_t **desc);
 
+/** Opens the library at lib->path and fills its handle and desc.
+ *  Once the factory is initialized, must be called with gLibLock held. */
+int openEffectLibrary(lib_entry_t *lib);
+
 int stringToUuid(const char *str, effect_uuid_t *uuid);
 /** Used to log UUIDs */
 int uuidToString(const effect_uuid_t *uuid, char *str, size_t maxLen);
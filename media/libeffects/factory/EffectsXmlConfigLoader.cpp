@@ -17,10 +17,15 @@
 #define LOG_TAG "EffectsFactoryConfigLoader"
 //#define LOG_NDEBUG 0
 
-#include <dlfcn.h>
+#include <errno.h>
+#include <map>
 #include <set>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <sys/stat.h>
+#include <vector>
 
 #include <log/log.h>
 
@@ -55,55 +60,185 @@ bool resolveLibrary(const std::string& path, std::string* resolvedPath) {
     return false;
 }
 
-/** Loads a library given its relative path and stores the result in libEntry.
- * @return true on success with libEntry's path, handle and desc filled
- *         false on success with libEntry's path filled with the path of the failed lib
- * The caller MUST free the resources path (free) and handle (dlclose) if filled.
+/** Descriptors of the effects of each library, saved by a previous boot so that the effect
+ * enumeration does not need to open the libraries.
+ * An entry is only trusted while the library file keeps the size and modification time
+ * it had when the descriptors were queried.
  */
-bool loadLibrary(const char* relativePath, lib_entry_t* libEntry) noexcept {
+class DescriptorCache {
+public:
+    explicit DescriptorCache(const char* path) : mPath(path) {}
+
+    /** Reads the cache file, dropping the entries of libraries that changed since. */
+    void load();
+    /** Rewrites the cache file if any entry was added or dropped. */
+    void save() const;
+
+    /** @return true if the descriptors cached for this library are still valid. */
+    bool hasLibrary(const char* libPath) const {
+        return mLibraries.count(libPath) != 0;
+    }
+    /** @return true and fill desc if a valid descriptor for uuid is cached for the library. */
+    bool get(const char* libPath, const effect_uuid_t& uuid, effect_descriptor_t* desc) const;
+    void put(const char* libPath, const effect_descriptor_t& desc);
+
+private:
+    static constexpr uint32_t kMagic = 0x45465843; // 'EFXC'
+    static constexpr uint32_t kVersion = 1;
+
+    struct LibraryEntry {
+        int64_t mtime;
+        int64_t size;
+        std::vector<effect_descriptor_t> descriptors;
+    };
+
+    /** Fills the size and modification time of the library file. */
+    static bool statLibrary(const char* libPath, LibraryEntry* entry);
+
+    const std::string mPath;
+    std::map<std::string, LibraryEntry> mLibraries;
+    bool mModified = false;
+};
 
-    std::string absolutePath;
-    if (!resolveLibrary(relativePath, &absolutePath)) {
-        ALOGE("Could not find library in effect directories: %s", relativePath);
-        libEntry->path = strdup(relativePath);
+bool DescriptorCache::statLibrary(const char* libPath, LibraryEntry* entry) {
+    struct stat st;
+    if (stat(libPath, &st) != 0) {
         return false;
     }
-    const char* path = absolutePath.c_str();
-    libEntry->path = strdup(path);
-
-    // Make sure the lib is closed on early return
-    std::unique_ptr<void, decltype(dlclose)*> libHandle(dlopen(path, RTLD_NOW),
-                                                       dlclose);
-    if (libHandle == nullptr) {
-        ALOGE("Could not dlopen library %s: %s", path, dlerror());
-        return false;
+    entry->mtime = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    entry->size = st.st_size;
+    return true;
+}
+
+void DescriptorCache::load() {
+    std::unique_ptr<FILE, decltype(fclose)*> file(fopen(mPath.c_str(), "rb"), fclose);
+    if (file == nullptr) {
+        ALOGV("No effect descriptor cache at %s", mPath.c_str());
+        return;
     }
+    uint32_t header[3];
+    if (fread(header, sizeof(header), 1, file.get()) != 1 || header[0] != kMagic ||
+            header[1] != kVersion || header[2] != sizeof(effect_descriptor_t)) {
+        ALOGW("Ignoring effect descriptor cache %s with unexpected header", mPath.c_str());
+        mModified = true;
+        return;
+    }
+    uint32_t pathLength;
+    while (fread(&pathLength, sizeof(pathLength), 1, file.get()) == 1) {
+        std::string libPath(pathLength, '\0');
+        LibraryEntry cached;
+        uint32_t count;
+        if (pathLength == 0 || pathLength >= PATH_MAX ||
+                fread(&libPath[0], pathLength, 1, file.get()) != 1 ||
+                fread(&cached.mtime, sizeof(cached.mtime), 1, file.get()) != 1 ||
+                fread(&cached.size, sizeof(cached.size), 1, file.get()) != 1 ||
+                fread(&count, sizeof(count), 1, file.get()) != 1 ||
+                count > 1024) {
+            ALOGW("Truncated effect descriptor cache %s", mPath.c_str());
+            mModified = true;
+            return;
+        }
+        cached.descriptors.resize(count);
+        if (count != 0 && fread(cached.descriptors.data(), sizeof(effect_descriptor_t), count,
+                                file.get()) != count) {
+            ALOGW("Truncated effect descriptor cache %s", mPath.c_str());
+            mModified = true;
+            return;
+        }
+        LibraryEntry current;
+        if (!statLibrary(libPath.c_str(), &current) ||
+                current.mtime != cached.mtime || current.size != cached.size) {
+            ALOGV("Dropping stale cached descriptors of %s", libPath.c_str());
+            mModified = true;
+            continue;
+        }
+        mLibraries[libPath] = std::move(cached);
+    }
+    ALOGV("Loaded cached descriptors of %zu libraries", mLibraries.size());
+}
 
-    auto* description = static_cast<audio_effect_library_t*>(
-          dlsym(libHandle.get(), AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR));
-    if (description == nullptr) {
-        ALOGE("Invalid effect library, failed not find symbol '%s' in %s: %s",
-              AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR, path, dlerror());
-        return false;
+void DescriptorCache::save() const {
+    if (!mModified) {
+        return;
+    }
+    const std::string tmpPath = mPath + ".tmp";
+    std::unique_ptr<FILE, decltype(fclose)*> file(fopen(tmpPath.c_str(), "wb"), fclose);
+    if (file == nullptr) {
+        ALOGW("Could not write effect descriptor cache %s: %s", tmpPath.c_str(), strerror(errno));
+        return;
+    }
+    const uint32_t header[3] = {kMagic, kVersion, sizeof(effect_descriptor_t)};
+    bool ok = fwrite(header, sizeof(header), 1, file.get()) == 1;
+    for (auto& library : mLibraries) {
+        const uint32_t pathLength = library.first.size();
+        const uint32_t count = library.second.descriptors.size();
+        ok = ok && fwrite(&pathLength, sizeof(pathLength), 1, file.get()) == 1
+                && fwrite(library.first.data(), pathLength, 1, file.get()) == 1
+                && fwrite(&library.second.mtime, sizeof(int64_t), 1, file.get()) == 1
+                && fwrite(&library.second.size, sizeof(int64_t), 1, file.get()) == 1
+                && fwrite(&count, sizeof(count), 1, file.get()) == 1
+                && (count == 0 || fwrite(library.second.descriptors.data(),
+                                         sizeof(effect_descriptor_t), count, file.get()) == count);
+    }
+    ok = fflush(file.get()) == 0 && ok;
+    file.reset();
+    if (!ok || rename(tmpPath.c_str(), mPath.c_str()) != 0) {
+        ALOGW("Failed to save effect descriptor cache %s", mPath.c_str());
+        unlink(tmpPath.c_str());
     }
+}
 
-    if (description->tag != AUDIO_EFFECT_LIBRARY_TAG) {
-        ALOGE("Bad tag %#08x in description structure, expected %#08x for library %s",
-              description->tag, AUDIO_EFFECT_LIBRARY_TAG, path);
+bool DescriptorCache::get(const char* libPath, const effect_uuid_t& uuid,
+                          effect_descriptor_t* desc) const {
+    auto library = mLibraries.find(libPath);
+    if (library == mLibraries.end()) {
         return false;
     }
+    for (auto& cached : library->second.descriptors) {
+        if (memcmp(&cached.uuid, &uuid, sizeof(effect_uuid_t)) == 0) {
+            *desc = cached;
+            return true;
+        }
+    }
+    return false;
+}
+
+void DescriptorCache::put(const char* libPath, const effect_descriptor_t& desc) {
+    auto library = mLibraries.find(libPath);
+    if (library == mLibraries.end()) {
+        LibraryEntry entry;
+        if (!statLibrary(libPath, &entry)) {
+            return;
+        }
+        library = mLibraries.emplace(libPath, std::move(entry)).first;
+    }
+    library->second.descriptors.push_back(desc);
+    mModified = true;
+}
 
-    uint32_t majorVersion = EFFECT_API_VERSION_MAJOR(description->version);
-    uint32_t expectedMajorVersion = EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION);
-    if (majorVersion != expectedMajorVersion) {
-        ALOGE("Unsupported major version %#08x, expected %#08x for library %s",
-              majorVersion, expectedMajorVersion, path);
+/** Resolves a library given its relative path and stores the result in libEntry.
+ * The library is only opened if the descriptors of its effects are not cached, otherwise
+ * it will be opened when the first of its effects is created.
+ * @return true on success with libEntry's path filled, and handle and desc if opened
+ *         false on success with libEntry's path filled with the path of the failed lib
+ * The caller MUST free the resources path (free) and handle (dlclose) if filled.
+ */
+bool loadLibrary(const char* relativePath, lib_entry_t* libEntry,
+                 const DescriptorCache& cache) noexcept {
+
+    std::string absolutePath;
+    if (!resolveLibrary(relativePath, &absolutePath)) {
+        ALOGE("Could not find library in effect directories: %s", relativePath);
+        libEntry->path = strdup(relativePath);
         return false;
     }
+    libEntry->path = strdup(absolutePath.c_str());
 
-    libEntry->handle = libHandle.release();
-    libEntry->desc = description;
-    return true;
+    if (cache.hasLibrary(libEntry->path)) {
+        ALOGV("Deferring load of library %s", libEntry->path);
+        return true;
+    }
+    return openEffectLibrary(libEntry) == 0;
 }
 
 /** Because the structures will be destroyed by c code, using new to allocate shared structure
@@ -151,7 +286,7 @@ void listPush(UniqueCPtr<T>&& object, ListElem** list, pthread_mutex_t* mutex =
 
 size_t loadLibraries(const effectsConfig::Libraries& libs,
                      list_elem_t** libList, pthread_mutex_t* libListLock,
-                     list_elem_t** libFailedList)
+                     list_elem_t** libFailedList, const DescriptorCache& cache)
 {
     size_t nbSkippedElement = 0;
     for (auto& library : libs) {
@@ -162,7 +297,7 @@ size_t loadLibraries(const effectsConfig::Libraries& libs,
         libEntry->effects = nullptr;
         pthread_mutex_init(&libEntry->lock, nullptr);
 
-        if (!loadLibrary(library.path.c_str(), libEntry.get())) {
+        if (!loadLibrary(library.path.c_str(), libEntry.get(), cache)) {
             // Register library load failure
             listPush(std::move(libEntry), libFailedList);
             ++nbSkippedElement;
@@ -210,7 +345,7 @@ struct LoadEffectResult {
 };
 
 LoadEffectResult loadEffect(const EffectImpl& effect, const std::string& name,
-                            list_elem_t* libList) {
+                            list_elem_t* libList, DescriptorCache& cache) {
     LoadEffectResult result;
 
     // Find the effect library
@@ -223,12 +358,21 @@ LoadEffectResult loadEffect(const EffectImpl& effect, const std::string& name,
 
     result.effectDesc = makeUniqueC<effect_descriptor_t>();
 
-    // Get the effect descriptor
-    if (result.lib->desc->get_descriptor(&effect.uuid, result.effectDesc.get()) != 0) {
-        ALOGE("Error querying effect %s on lib %s",
-              uuidToString(effect.uuid), result.lib->name);
-        result.effectDesc.reset();
-        return result;
+    // Get the effect descriptor, opening the library if it is not cached
+    if (!cache.get(result.lib->path, effect.uuid, result.effectDesc.get())) {
+        if (result.lib->handle == nullptr && openEffectLibrary(result.lib) != 0) {
+            ALOGE("Could not open lib %s to query effect %s",
+                  result.lib->name, uuidToString(effect.uuid));
+            result.effectDesc.reset();
+            return result;
+        }
+        if (result.lib->desc->get_descriptor(&effect.uuid, result.effectDesc.get()) != 0) {
+            ALOGE("Error querying effect %s on lib %s",
+                  uuidToString(effect.uuid), result.lib->name);
+            result.effectDesc.reset();
+            return result;
+        }
+        cache.put(result.lib->path, *result.effectDesc);
     }
 
     // Dump effect for debug
@@ -257,12 +401,12 @@ LoadEffectResult loadEffect(const EffectImpl& effect, const std::string& name,
 }
 
 size_t loadEffects(const Effects& effects, list_elem_t* libList, list_elem_t** skippedEffects,
-                   list_sub_elem_t** subEffectList) {
+                   list_sub_elem_t** subEffectList, DescriptorCache& cache) {
     size_t nbSkippedElement = 0;
 
     for (auto& effect : effects) {
 
-        auto effectLoadResult = loadEffect(effect, effect.name, libList);
+        auto effectLoadResult = loadEffect(effect, effect.name, libList, cache);
         if (!effectLoadResult.success) {
             if (effectLoadResult.effectDesc != nullptr) {
                 listPush(std::move(effectLoadResult.effectDesc), skippedEffects);
@@ -272,8 +416,8 @@ size_t loadEffects(const Effects& effects, list_elem_t* libList, list_elem_t** s
         }
 
         if (effect.isProxy) {
-            auto swEffectLoadResult = loadEffect(effect.libSw, effect.name + " libsw", libList);
-            auto hwEffectLoadResult = loadEffect(effect.libHw, effect.name + " libhw", libList);
+            auto swEffectLoadResult = loadEffect(effect.libSw, effect.name + " libsw", libList, cache);
+            auto hwEffectLoadResult = loadEffect(effect.libHw, effect.name + " libhw", libList, cache);
             if (!swEffectLoadResult.success || !hwEffectLoadResult.success) {
                 // Push the main effect in the skipped list even if only a subeffect is invalid
                 // as the main effect is not usable without its subeffects.
@@ -321,10 +465,14 @@ extern "C" ssize_t EffectLoadXmlEffectConfig(const char* path)
         ALOGE("Failed to parse XML configuration file");
         return -1;
     }
+    DescriptorCache cache(EFFECTS_DESCRIPTOR_CACHE_FILE);
+    cache.load();
     result.nbSkippedElement += loadLibraries(result.parsedConfig->libraries,
-                                             &gLibraryList, &gLibLock, &gLibraryFailedList) +
+                                             &gLibraryList, &gLibLock, &gLibraryFailedList,
+                                             cache) +
                                loadEffects(result.parsedConfig->effects, gLibraryList,
-                                           &gSkippedEffects, &gSubEffectList);
+                                           &gSkippedEffects, &gSubEffectList, cache);
+    cache.save();
 
     ALOGE_IF(result.nbSkippedElement != 0, "%zu errors during loading of configuration: %s",
              result.nbSkippedElement,
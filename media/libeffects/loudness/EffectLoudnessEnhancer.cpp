@@ -61,6 +61,9 @@ struct LoudnessEnhancerContext {
     // in this implementation, there is no coupling between the compression on the left and right
     // channels
     le_fx::AdaptiveDynamicRangeCompression* mCompressor;
+    // interleaved float copy of the buffer being processed, grown as needed
+    float *mWorkBuffer;
+    size_t mWorkBufferFrames;
 };
 
 //
@@ -213,6 +216,8 @@ int LELib_Create(const effect_uuid_t *uuid,
     pContext->mState = LOUDNESS_ENHANCER_STATE_UNINITIALIZED;
 
     pContext->mCompressor = NULL;
+    pContext->mWorkBuffer = NULL;
+    pContext->mWorkBufferFrames = 0;
     ret = LE_init(pContext);
     if (ret < 0) {
         ALOGW("LELib_Create() init failed");
@@ -238,6 +243,9 @@ int LELib_Release(effect_handle_t handle) {
         return -EINVAL;
     }
     pContext->mState = LOUDNESS_ENHANCER_STATE_UNINITIALIZED;
+    delete[] pContext->mWorkBuffer;
+    pContext->mWorkBuffer = NULL;
+    pContext->mWorkBufferFrames = 0;
     if (pContext->mCompressor != NULL) {
         delete pContext->mCompressor;
         pContext->mCompressor = NULL;
@@ -283,16 +291,22 @@ int LE_process(
     }
 
     //ALOGV("LE about to process %d samples", inBuffer->frameCount);
-    uint16_t inIdx;
+    const size_t sampleCount = inBuffer->frameCount * 2;
+    if (inBuffer->frameCount > pContext->mWorkBufferFrames) {
+        delete[] pContext->mWorkBuffer;
+        pContext->mWorkBuffer = new float[sampleCount];
+        pContext->mWorkBufferFrames = inBuffer->frameCount;
+    }
+    float *work = pContext->mWorkBuffer;
     float inputAmp = pow(10, pContext->mTargetGainmB/2000.0f);
-    float leftSample, rightSample;
-    for (inIdx = 0 ; inIdx < inBuffer->frameCount ; inIdx++) {
+    for (size_t i = 0; i < sampleCount; i++) {
         // makeup gain is applied on the input of the compressor
-        leftSample  = inputAmp * (float)inBuffer->s16[2*inIdx];
-        rightSample = inputAmp * (float)inBuffer->s16[2*inIdx +1];
-        pContext->mCompressor->Compress(&leftSample, &rightSample);
-        inBuffer->s16[2*inIdx]    = (int16_t) leftSample;
-        inBuffer->s16[2*inIdx +1] = (int16_t) rightSample;
+        work[i] = inputAmp * (float)inBuffer->s16[i];
+    }
+    pContext->mCompressor->CompressStereo(work, inBuffer->frameCount);
+    for (size_t i = 0; i < sampleCount; i++) {
+        // the compressor output is limited to the 16 bit range
+        inBuffer->s16[i] = (int16_t) work[i];
     }
 
     if (inBuffer->raw != outBuffer->raw) {
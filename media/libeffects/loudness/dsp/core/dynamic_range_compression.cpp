@@ -15,6 +15,7 @@
  */
 //#define LOG_NDEBUG 0
 
+#include <algorithm>
 #include <cmath>
 
 #include "common/core/math.h"
@@ -69,6 +70,8 @@ bool AdaptiveDynamicRangeCompression::Initialize(
   } else {
     alpha_release_ = 0.0f;
   }
+  alpha_attack_block_ = std::pow(alpha_attack_, kSubBlockFrames);
+  alpha_release_block_ = std::pow(alpha_release_, kSubBlockFrames);
   // Feed-forward topology
   slope_ = 1.0f / kCompressionRatio - 1.0f;
   return true;
@@ -136,5 +139,48 @@ void AdaptiveDynamicRangeCompression::Compress(float *x1, float *x2) {
   }
 }
 
+void AdaptiveDynamicRangeCompression::CompressStereo(float *x,
+                                                     size_t frame_count) {
+  size_t frame = 0;
+  for (; frame + kSubBlockFrames <= frame_count; frame += kSubBlockFrames) {
+    float *block = x + 2 * frame;
+    // Taking the maximum amplitude of both channels over the sub-block
+    float max_abs_x = kMinLogAbsValue;
+    for (size_t i = 0; i < 2 * kSubBlockFrames; ++i) {
+      max_abs_x = std::max(max_abs_x, std::fabs(block[i]));
+    }
+    const float max_abs_x_dB = math::fast_log(max_abs_x);
+    // Subtract Threshold from log-encoded input to get the amount of overshoot
+    const float overshoot = max_abs_x_dB - knee_threshold_;
+    // Hard half-wave rectifier
+    const float rect = std::max(overshoot, 0.0f);
+    // Multiply rectified overshoot with slope
+    const float cv = rect * slope_;
+    const float prev_state = state_;
+    if (cv <= state_) {
+      state_ = alpha_attack_block_ * state_ + (1.0f - alpha_attack_block_) * cv;
+    } else {
+      state_ = alpha_release_block_ * state_ +
+          (1.0f - alpha_release_block_) * cv;
+    }
+    const float target_gain = compressor_gain_ * std::exp(state_ - prev_state);
+    // Interpolate the gain linearly across the sub-block
+    const float gain_step = (target_gain - compressor_gain_) / kSubBlockFrames;
+    for (size_t i = 0; i < kSubBlockFrames; ++i) {
+      const float gain = compressor_gain_ + gain_step * (i + 1);
+      block[2 * i] = std::min(std::max(block[2 * i] * gain, -kFixedPointLimit),
+                              kFixedPointLimit);
+      block[2 * i + 1] = std::min(
+          std::max(block[2 * i + 1] * gain, -kFixedPointLimit),
+          kFixedPointLimit);
+    }
+    compressor_gain_ = target_gain;
+  }
+  // Remaining frames go through the per-sample detector
+  for (; frame < frame_count; ++frame) {
+    Compress(&x[2 * frame], &x[2 * frame + 1]);
+  }
+}
+
 }  // namespace le_fx
 
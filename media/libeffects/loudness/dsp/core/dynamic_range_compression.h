@@ -58,6 +58,12 @@ class AdaptiveDynamicRangeCompression {
   // Stereo channel version of the compressor
   void Compress(float *x1, float *x2);
 
+  // Block version of the stereo compressor, working in place on `frame_count`
+  // interleaved frames. The envelope is updated once per kSubBlockFrames from
+  // the peak of the sub-block and the gain is interpolated linearly across it,
+  // so that the per-sample work has no log(.) or exp(.) and can be vectorized.
+  void CompressStereo(float *x, size_t frame_count);
+
   // This version is slower than Compress(.) but faster than CompressSlow(.)
   float CompressNormalSpeed(float x);
 
@@ -91,6 +97,8 @@ class AdaptiveDynamicRangeCompression {
   static const float kTauAttack;
   // The release time of the envelope detector
   static const float kTauRelease;
+  // Number of frames sharing one envelope update in CompressStereo(.)
+  static const size_t kSubBlockFrames = 16;
 
   float sampling_rate_;
   // the internal state of the envelope detector
@@ -101,6 +109,9 @@ class AdaptiveDynamicRangeCompression {
   float alpha_attack_;
   // release constant for exponential dumping
   float alpha_release_;
+  // attack and release constants over kSubBlockFrames samples
+  float alpha_attack_block_;
+  float alpha_release_block_;
   float slope_;
   // The knee threshold
   float knee_threshold_;
@@ -66,6 +66,7 @@ LOCAL_SRC_FILES:= \
     Common/src/BQ_1I_D16F32Css_TRC_WRA_01_init.c \
     Common/src/PK_2I_D32F32C30G11_TRC_WRA_01.c \
     Common/src/PK_2I_D32F32C14G11_TRC_WRA_01.c \
+    Common/src/PK_2I_D32F32C14G11_Cascade_TRC_WRA_01.c \
     Common/src/PK_2I_D32F32CssGss_TRC_WRA_01_Init.c \
     Common/src/PK_2I_D32F32CllGss_TRC_WRA_01_Init.c \
     Common/src/Int16LShiftToInt32_16x32.c \
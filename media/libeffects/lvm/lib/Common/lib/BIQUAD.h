@@ -527,6 +527,12 @@ void PK_2I_D32F32C14G11_TRC_WRA_01( Biquad_FLOAT_Instance_t       *pInstance,
                                     LVM_FLOAT               *pDataIn,
                                     LVM_FLOAT               *pDataOut,
                                     LVM_INT16               NrSamples);
+/* NrSections PK_2I_D32F32C14G11_TRC_WRA_01 filters in series, in a single pass */
+void PK_2I_D32F32C14G11_Cascade_TRC_WRA_01( Biquad_FLOAT_Instance_t   **ppInstances,
+                                            LVM_INT16                 NrSections,
+                                            LVM_FLOAT                 *pDataIn,
+                                            LVM_FLOAT                 *pDataOut,
+                                            LVM_INT16                 NrSamples);
 #else
 void PK_2I_D32F32C14G11_TRC_WRA_01 (        Biquad_Instance_t       *pInstance,
                                             LVM_INT32                    *pDataIn,
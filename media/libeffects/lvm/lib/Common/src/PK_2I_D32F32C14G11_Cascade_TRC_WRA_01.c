@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BIQUAD.h"
+#include "PK_2I_D32F32CssGss_TRC_WRA_01_Private.h"
+#include "LVM_Macros.h"
+#include "VectorArithmetic.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**************************************************************************
+ Cascade of NrSections PK_2I_D32F32C14G11_TRC_WRA_01 filters, processed
+ one sample at a time through all the sections instead of one section at
+ a time through the whole buffer: the data is read and written once, and
+ the filter states stay in registers for the duration of the call.
+ The left and right channels are processed together as a pair of lanes.
+
+ Same coefficient and delay layout as PK_2I_D32F32C14G11_TRC_WRA_01, and
+ the same order of operations, so the output is identical to running the
+ sections one after the other.
+ pDataIn and pDataOut may be the same buffer.
+***************************************************************************/
+#ifdef BUILD_FLOAT
+
+#define PK_CASCADE_MAX_SECTIONS 8   /* sections kept in registers per pass */
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+static void PK_2I_D32F32C14G11_Cascade_Pass(Biquad_FLOAT_Instance_t   **ppInstances,
+                                            LVM_INT16                 NrSections,
+                                            LVM_FLOAT                 *pDataIn,
+                                            LVM_FLOAT                 *pDataOut,
+                                            LVM_INT16                 NrSamples)
+{
+    float32x2_t x1[PK_CASCADE_MAX_SECTIONS], x2[PK_CASCADE_MAX_SECTIONS];
+    float32x2_t y1[PK_CASCADE_MAX_SECTIONS], y2[PK_CASCADE_MAX_SECTIONS];
+    float32x2_t a0[PK_CASCADE_MAX_SECTIONS], b2[PK_CASCADE_MAX_SECTIONS];
+    float32x2_t b1[PK_CASCADE_MAX_SECTIONS], g[PK_CASCADE_MAX_SECTIONS];
+    LVM_INT16 ii, s;
+
+    for (s = 0; s < NrSections; s++)
+    {
+        PFilter_State_Float pBiquadState = (PFilter_State_Float) ppInstances[s];
+        x1[s] = vld1_f32(&pBiquadState->pDelays[0]);   /* x(n-1)L, x(n-1)R */
+        x2[s] = vld1_f32(&pBiquadState->pDelays[2]);   /* x(n-2)L, x(n-2)R */
+        y1[s] = vld1_f32(&pBiquadState->pDelays[4]);   /* y(n-1)L, y(n-1)R */
+        y2[s] = vld1_f32(&pBiquadState->pDelays[6]);   /* y(n-2)L, y(n-2)R */
+        a0[s] = vdup_n_f32(pBiquadState->coefs[0]);
+        b2[s] = vdup_n_f32(pBiquadState->coefs[1]);
+        b1[s] = vdup_n_f32(pBiquadState->coefs[2]);
+        g[s] = vdup_n_f32(pBiquadState->coefs[3]);
+    }
+
+    for (ii = NrSamples; ii != 0; ii--)
+    {
+        float32x2_t xn = vld1_f32(pDataIn);
+        pDataIn += 2;
+        for (s = 0; s < NrSections; s++)
+        {
+            /* yn = A0 * (x(n) - x(n-2)) + (-B2 * y(n-2)) + (-B1 * y(n-1)) */
+            float32x2_t yn = vmul_f32(vsub_f32(xn, x2[s]), a0[s]);
+            yn = vadd_f32(yn, vmul_f32(y2[s], b2[s]));
+            yn = vadd_f32(yn, vmul_f32(y1[s], b1[s]));
+
+            /* update the delays */
+            y2[s] = y1[s];
+            y1[s] = yn;
+            x2[s] = x1[s];
+            x1[s] = xn;
+
+            /* ynO = Gain * yn + x(n), input of the next section */
+            xn = vadd_f32(vmul_f32(yn, g[s]), xn);
+        }
+        vst1_f32(pDataOut, xn);
+        pDataOut += 2;
+    }
+
+    for (s = 0; s < NrSections; s++)
+    {
+        PFilter_State_Float pBiquadState = (PFilter_State_Float) ppInstances[s];
+        vst1_f32(&pBiquadState->pDelays[0], x1[s]);
+        vst1_f32(&pBiquadState->pDelays[2], x2[s]);
+        vst1_f32(&pBiquadState->pDelays[4], y1[s]);
+        vst1_f32(&pBiquadState->pDelays[6], y2[s]);
+    }
+}
+#else
+static void PK_2I_D32F32C14G11_Cascade_Pass(Biquad_FLOAT_Instance_t   **ppInstances,
+                                            LVM_INT16                 NrSections,
+                                            LVM_FLOAT                 *pDataIn,
+                                            LVM_FLOAT                 *pDataOut,
+                                            LVM_INT16                 NrSamples)
+{
+    /* per section: x(n-1)L, x(n-1)R, x(n-2)L, x(n-2)R, y(n-1)L, y(n-1)R, y(n-2)L, y(n-2)R */
+    LVM_FLOAT delays[PK_CASCADE_MAX_SECTIONS][8];
+    LVM_FLOAT coefs[PK_CASCADE_MAX_SECTIONS][4];
+    LVM_INT16 ii, s, k;
+
+    for (s = 0; s < NrSections; s++)
+    {
+        PFilter_State_Float pBiquadState = (PFilter_State_Float) ppInstances[s];
+        for (k = 0; k < 8; k++)
+        {
+            delays[s][k] = pBiquadState->pDelays[k];
+        }
+        for (k = 0; k < 4; k++)
+        {
+            coefs[s][k] = pBiquadState->coefs[k];
+        }
+    }
+
+    for (ii = NrSamples; ii != 0; ii--)
+    {
+        LVM_FLOAT xnL = pDataIn[0];
+        LVM_FLOAT xnR = pDataIn[1];
+        pDataIn += 2;
+        for (s = 0; s < NrSections; s++)
+        {
+            LVM_FLOAT *d = delays[s];
+            LVM_FLOAT *c = coefs[s];
+            LVM_FLOAT ynL = (xnL - d[2]) * c[0] + d[6] * c[1] + d[4] * c[2];
+            LVM_FLOAT ynR = (xnR - d[3]) * c[0] + d[7] * c[1] + d[5] * c[2];
+
+            d[7] = d[5];
+            d[6] = d[4];
+            d[3] = d[1];
+            d[2] = d[0];
+            d[5] = ynR;
+            d[4] = ynL;
+            d[0] = xnL;
+            d[1] = xnR;
+
+            xnL = ynL * c[3] + xnL;
+            xnR = ynR * c[3] + xnR;
+        }
+        pDataOut[0] = xnL;
+        pDataOut[1] = xnR;
+        pDataOut += 2;
+    }
+
+    for (s = 0; s < NrSections; s++)
+    {
+        PFilter_State_Float pBiquadState = (PFilter_State_Float) ppInstances[s];
+        for (k = 0; k < 8; k++)
+        {
+            pBiquadState->pDelays[k] = delays[s][k];
+        }
+    }
+}
+#endif
+
+void PK_2I_D32F32C14G11_Cascade_TRC_WRA_01 ( Biquad_FLOAT_Instance_t   **ppInstances,
+                                             LVM_INT16                 NrSections,
+                                             LVM_FLOAT                 *pDataIn,
+                                             LVM_FLOAT                 *pDataOut,
+                                             LVM_INT16                 NrSamples)
+    {
+        LVM_INT16 s;
+
+        if (NrSections == 0)
+        {
+            if (pDataIn != pDataOut)
+            {
+                Copy_Float(pDataIn, pDataOut, (LVM_INT16)(2 * NrSamples));
+            }
+            return;
+        }
+
+        /* Longer cascades take several passes, the later ones in place */
+        for (s = 0; s < NrSections; s += PK_CASCADE_MAX_SECTIONS)
+        {
+            LVM_INT16 n = NrSections - s;
+            if (n > PK_CASCADE_MAX_SECTIONS)
+            {
+                n = PK_CASCADE_MAX_SECTIONS;
+            }
+            PK_2I_D32F32C14G11_Cascade_Pass(ppInstances + s, n,
+                                            s == 0 ? pDataIn : pDataOut, pDataOut, NrSamples);
+        }
+    }
+#endif
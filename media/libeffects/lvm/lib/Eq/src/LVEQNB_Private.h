@@ -50,6 +50,7 @@ extern "C" {
 #define LVEQNB_SCRATCH_ALIGN        4                   /* 32-bit alignment for long data */
 
 #define LVEQNB_BYPASS_MIXER_TC      100                 /* Bypass Mixer TC */
+#define LVEQNB_CASCADE_BANDS        8                   /* Bands filtered in a single pass */
 
 /****************************************************************************************/
 /*                                                                                      */
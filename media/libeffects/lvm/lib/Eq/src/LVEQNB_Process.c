@@ -102,10 +102,14 @@ LVEQNB_ReturnStatus_en LVEQNB_Process(LVEQNB_Handle_t       hInstance,
                    pScratch,                  /* Destination */
                    (LVM_INT16)(2 * NumSamples)); /* Left and Right */
         /*
-         * For each section execte the filter unless the gain is 0dB
+         * Execute the filters of all the sections unless the gain is 0dB, as a cascade
+         * processed in a single pass over the data for up to LVEQNB_CASCADE_BANDS sections
          */
         if (pInstance->NBands != 0)
         {
+            Biquad_FLOAT_Instance_t   *pCascade[LVEQNB_CASCADE_BANDS];
+            LVM_INT16                 NrCascade = 0;
+
             for (i = 0; i < pInstance->NBands; i++)
             {
                 /*
@@ -126,16 +130,24 @@ LVEQNB_ReturnStatus_en LVEQNB_Process(LVEQNB_Handle_t       hInstance,
                     {
                         case LVEQNB_SinglePrecision_Float:
                         {
-                            PK_2I_D32F32C14G11_TRC_WRA_01(pBiquad,
-                                                          (LVM_FLOAT *)pScratch,
-                                                          (LVM_FLOAT *)pScratch,
-                                                          (LVM_INT16)NumSamples);
+                            pCascade[NrCascade++] = pBiquad;
                             break;
                         }
                         default:
                             break;
                     }
                 }
+
+                if ((NrCascade == LVEQNB_CASCADE_BANDS) ||
+                    ((NrCascade != 0) && (i == pInstance->NBands - 1)))
+                {
+                    PK_2I_D32F32C14G11_Cascade_TRC_WRA_01(pCascade,
+                                                          NrCascade,
+                                                          (LVM_FLOAT *)pScratch,
+                                                          (LVM_FLOAT *)pScratch,
+                                                          (LVM_INT16)NumSamples);
+                    NrCascade = 0;
+                }
             }
         }
 
@@ -37,6 +37,8 @@
 
 // maximum number of sessions
 #define PREPROC_NUM_SESSIONS 8
+// number of ProcessStream() calls (10 ms each) between two processing time reports
+#define PREPROC_PROC_TIME_REPORT_PERIOD 1000
 
 // types of pre processing modules
 enum preproc_id
@@ -132,6 +134,9 @@ struct preproc_session_s {
     size_t revBufSize;                  // reverse channel input buffer size
     size_t framesRev;                   // number of frames in reverse channel input buffer
     SpeexResamplerState *revResampler;  // handle on reverse channel input speex resampler
+    uint32_t procCount;                 // number of ProcessStream() calls since last report
+    nsecs_t procTimeNs;                 // time spent in ProcessStream() since last report
+    nsecs_t procTimeMaxNs;              // longest ProcessStream() call since last report
 };
 
 #ifdef DUAL_MIC_TEST
@@ -864,6 +869,9 @@ extern "C" int Session_CreateEffect(preproc_session_t *session,
         session->processedMsk = 0;
         session->revEnabledMsk = 0;
         session->revProcessedMsk = 0;
+        session->procCount = 0;
+        session->procTimeNs = 0;
+        session->procTimeMaxNs = 0;
         session->inResampler = NULL;
         session->inBuf = NULL;
         session->inBufSize = 0;
@@ -1122,6 +1130,9 @@ void Session_SetProcEnabled(preproc_session_t *session, uint32_t procId, bool en
             }
         }
         session->enabledMsk |= (1 << procId);
+        session->procCount = 0;
+        session->procTimeNs = 0;
+        session->procTimeMaxNs = 0;
         if (HasReverseStream(procId)) {
             session->framesRev = 0;
             if (session->revResampler != NULL) {
@@ -1333,7 +1344,36 @@ int PreProcessingFx_Process(effect_handle_t     self,
         }
         session->procFrame->samples_per_channel_ = session->apmFrameCount;
 
+        // All enabled pre processors run in the same ProcessStream() call on the same
+        // frame, so the conversions above and below are done once per session.
+        nsecs_t procStartNs = systemTime(SYSTEM_TIME_MONOTONIC);
         effect->session->apm->ProcessStream(session->procFrame);
+        nsecs_t procTimeNs = systemTime(SYSTEM_TIME_MONOTONIC) - procStartNs;
+        session->procTimeNs += procTimeNs;
+        if (procTimeNs > session->procTimeMaxNs) {
+            session->procTimeMaxNs = procTimeNs;
+        }
+        if (++session->procCount == PREPROC_PROC_TIME_REPORT_PERIOD) {
+            ALOGV("PreProcessingFx_Process session %d enabledMsk %08x: %u frames "
+                  "average %lld us max %lld us", session->id, session->enabledMsk,
+                  session->procCount,
+                  (long long)(ns2us(session->procTimeNs) / session->procCount),
+                  (long long)ns2us(session->procTimeMaxNs));
+            session->procCount = 0;
+            session->procTimeNs = 0;
+            session->procTimeMaxNs = 0;
+        }
+
+        // Without output resampler, write the processed frame straight to the output
+        // buffer when it fits and nothing is pending in front of it.
+        if (session->outResampler == NULL && session->framesOut == 0 &&
+                framesRq - framesWr >= session->frameCount) {
+            memcpy(outBuffer->s16 + framesWr * session->outChannelCount,
+                   session->procFrame->data_,
+                   session->frameCount * session->outChannelCount * sizeof(int16_t));
+            outBuffer->frameCount += session->frameCount;
+            return 0;
+        }
 
         if (session->outBufSize < session->framesOut + session->frameCount) {
             int16_t *buf;
@@ -11,6 +11,7 @@ LOCAL_CFLAGS+= -O2 -fvisibility=hidden
 LOCAL_CFLAGS += -Wall -Werror
 
 LOCAL_SHARED_LIBRARIES := \
+	libaudioutils \
 	libcutils \
 	liblog \
 	libdl
@@ -29,6 +29,14 @@
 #include <log/log.h>
 
 #include <audio_effects/effect_visualizer.h>
+#include <audio_utils/fixedfft.h>
+
+// Returns the FFT of the current capture, computed once for all the clients of the effect
+// instead of by each of them. The reply is the FFT, in the format of Visualizer::getFft(),
+// followed by the waveform it was computed from if replySize is twice the capture size.
+#ifndef VISUALIZER_CMD_CAPTURE_FFT
+#define VISUALIZER_CMD_CAPTURE_FFT (EFFECT_CMD_FIRST_PROPRIETARY + 2)
+#endif
 
 extern "C" {
 
@@ -90,6 +98,10 @@ struct VisualizerContext {
     uint8_t mMeasurementWindowSizeInBuffers;
     uint8_t mMeasurementBufferIdx;
     BufferStats mPastMeasurements[MEASUREMENT_WINDOW_MAX_SIZE_IN_BUFFERS];
+    // last FFT computed and the waveform it was computed from, mFftSize 0 if none
+    uint32_t mFftSize;
+    uint8_t mFftWaveform[VISUALIZER_CAPTURE_SIZE_MAX];
+    uint8_t mFft[VISUALIZER_CAPTURE_SIZE_MAX];
 };
 
 //
@@ -120,6 +132,92 @@ void Visualizer_reset(VisualizerContext *pContext)
     pContext->mBufferUpdateTime.tv_sec = 0;
     pContext->mLatency = 0;
     memset(pContext->mCaptureBuf, 0x80, CAPTURE_BUF_SIZE);
+    pContext->mFftSize = 0;
+}
+
+// Copies the current capture, pContext->mCaptureSize bytes, to pWaveform.
+void Visualizer_capture(VisualizerContext *pContext, uint8_t *pWaveform)
+{
+    uint32_t captureSize = pContext->mCaptureSize;
+    if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
+        const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
+
+        // if audio framework has stopped playing audio although the effect is still
+        // active we must clear the capture buffer to return silence
+        if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
+                (pContext->mBufferUpdateTime.tv_sec != 0) &&
+                (deltaMs > MAX_STALL_TIME_MS)) {
+                ALOGV("capture going to idle");
+                pContext->mBufferUpdateTime.tv_sec = 0;
+                memset(pWaveform, 0x80, captureSize);
+        } else {
+            int32_t latencyMs = pContext->mLatency;
+            latencyMs -= deltaMs;
+            if (latencyMs < 0) {
+                latencyMs = 0;
+            }
+            uint32_t deltaSmpl = captureSize
+                    + pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
+
+            // large sample rate, latency, or capture size, could cause overflow.
+            // do not offset more than the size of buffer.
+            if (deltaSmpl > CAPTURE_BUF_SIZE) {
+                android_errorWriteLog(0x534e4554, "31781965");
+                deltaSmpl = CAPTURE_BUF_SIZE;
+            }
+
+            int32_t capturePoint;
+            //capturePoint = (int32_t)pContext->mCaptureIdx - deltaSmpl;
+            __builtin_sub_overflow((int32_t)pContext->mCaptureIdx, deltaSmpl, &capturePoint);
+            // a negative capturePoint means we wrap the buffer.
+            if (capturePoint < 0) {
+                uint32_t size = -capturePoint;
+                if (size > captureSize) {
+                    size = captureSize;
+                }
+                memcpy(pWaveform,
+                       pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
+                       size);
+                pWaveform += size;
+                captureSize -= size;
+                capturePoint = 0;
+            }
+            memcpy(pWaveform,
+                   pContext->mCaptureBuf + capturePoint,
+                   captureSize);
+        }
+
+        pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+    } else {
+        memset(pWaveform, 0x80, captureSize);
+    }
+}
+
+// Computes in pFft the FFT of size bytes of 8-bit waveform, as Visualizer::doFft() does.
+void Visualizer_fft(const uint8_t *pWaveform, uint8_t *pFft, uint32_t size)
+{
+    int32_t workspace[VISUALIZER_CAPTURE_SIZE_MAX >> 1];
+    int32_t nonzero = 0;
+
+    for (uint32_t i = 0; i < size; i += 2) {
+        workspace[i >> 1] =
+                ((pWaveform[i] ^ 0x80) << 24) | ((pWaveform[i + 1] ^ 0x80) << 8);
+        nonzero |= workspace[i >> 1];
+    }
+
+    if (nonzero) {
+        fixed_fft_real(size >> 1, workspace);
+    }
+
+    for (uint32_t i = 0; i < size; i += 2) {
+        short tmp = workspace[i >> 1] >> 21;
+        while (tmp > 127 || tmp < -128) tmp >>= 1;
+        pFft[i] = tmp;
+        tmp = workspace[i >> 1];
+        tmp >>= 5;
+        while (tmp > 127 || tmp < -128) tmp >>= 1;
+        pFft[i + 1] = tmp;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -217,6 +315,7 @@ int Visualizer_init(VisualizerContext *pContext)
     pContext->mMeasurementMode = MEASUREMENT_MODE_NONE;
     pContext->mMeasurementWindowSizeInBuffers = MEASUREMENT_WINDOW_MAX_SIZE_IN_BUFFERS;
     pContext->mMeasurementBufferIdx = 0;
+    pContext->mFftSize = 0;
     for (uint32_t i=0 ; i<pContext->mMeasurementWindowSizeInBuffers ; i++) {
         pContext->mPastMeasurements[i].mIsValid = false;
         pContext->mPastMeasurements[i].mPeakU16 = 0;
@@ -567,59 +666,30 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
                     *replySize, captureSize);
             return -EINVAL;
         }
-        if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
-            const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
-
-            // if audio framework has stopped playing audio although the effect is still
-            // active we must clear the capture buffer to return silence
-            if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
-                    (pContext->mBufferUpdateTime.tv_sec != 0) &&
-                    (deltaMs > MAX_STALL_TIME_MS)) {
-                    ALOGV("capture going to idle");
-                    pContext->mBufferUpdateTime.tv_sec = 0;
-                    memset(pReplyData, 0x80, captureSize);
-            } else {
-                int32_t latencyMs = pContext->mLatency;
-                latencyMs -= deltaMs;
-                if (latencyMs < 0) {
-                    latencyMs = 0;
-                }
-                uint32_t deltaSmpl = captureSize
-                        + pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
-
-                // large sample rate, latency, or capture size, could cause overflow.
-                // do not offset more than the size of buffer.
-                if (deltaSmpl > CAPTURE_BUF_SIZE) {
-                    android_errorWriteLog(0x534e4554, "31781965");
-                    deltaSmpl = CAPTURE_BUF_SIZE;
-                }
-
-                int32_t capturePoint;
-                //capturePoint = (int32_t)pContext->mCaptureIdx - deltaSmpl;
-                __builtin_sub_overflow((int32_t)pContext->mCaptureIdx, deltaSmpl, &capturePoint);
-                // a negative capturePoint means we wrap the buffer.
-                if (capturePoint < 0) {
-                    uint32_t size = -capturePoint;
-                    if (size > captureSize) {
-                        size = captureSize;
-                    }
-                    memcpy(pReplyData,
-                           pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
-                           size);
-                    pReplyData = (char *)pReplyData + size;
-                    captureSize -= size;
-                    capturePoint = 0;
-                }
-                memcpy(pReplyData,
-                       pContext->mCaptureBuf + capturePoint,
-                       captureSize);
-            }
+        Visualizer_capture(pContext, (uint8_t *)pReplyData);
+        } break;
 
-            pContext->mLastCaptureIdx = pContext->mCaptureIdx;
-        } else {
-            memset(pReplyData, 0x80, captureSize);
+    case VISUALIZER_CMD_CAPTURE_FFT: {
+        uint32_t captureSize = pContext->mCaptureSize;
+        if (pReplyData == NULL || replySize == NULL ||
+                (*replySize != captureSize && *replySize != 2 * captureSize)) {
+            ALOGV("VISUALIZER_CMD_CAPTURE_FFT() error *replySize %" PRIu32
+                    " captureSize %" PRIu32, *replySize, captureSize);
+            return -EINVAL;
+        }
+        uint8_t waveform[VISUALIZER_CAPTURE_SIZE_MAX];
+        Visualizer_capture(pContext, waveform);
+        // clients polling at the same rate mostly get the same capture
+        if (pContext->mFftSize != captureSize ||
+                memcmp(waveform, pContext->mFftWaveform, captureSize) != 0) {
+            Visualizer_fft(waveform, pContext->mFft, captureSize);
+            memcpy(pContext->mFftWaveform, waveform, captureSize);
+            pContext->mFftSize = captureSize;
+        }
+        memcpy(pReplyData, pContext->mFft, captureSize);
+        if (*replySize == 2 * captureSize) {
+            memcpy((uint8_t *)pReplyData + captureSize, waveform, captureSize);
         }
-
         } break;
 
     case VISUALIZER_CMD_MEASURE: {
@@ -49,6 +49,12 @@ enum {
     SHARED_BUFFER_INDEX,
 };
 
+// Buffer metadata encoding, written ahead of the metadata of each buffer.
+enum {
+    FULL_META,
+    COMPACT_META,
+};
+
 class RemoteMediaBufferWrapper : public MediaBuffer {
 public:
     RemoteMediaBufferWrapper(const sp<IMemory> &mem)
@@ -175,13 +181,21 @@ public:
                 size_t length = reply.readInt32();
                 buf = new RemoteMediaBufferWrapper(mem);
                 buf->set_range(offset, length);
-                buf->meta_data().updateFromParcel(reply);
+                if (reply.readInt32() == COMPACT_META) {
+                    buf->meta_data().updateFromCompactParcel(reply);
+                } else {
+                    buf->meta_data().updateFromParcel(reply);
+                }
             } else { // INLINE_BUFFER
                 int32_t len = reply.readInt32();
                 ALOGV("INLINE_BUFFER status %d and len %d", ret, len);
                 buf = new MediaBuffer(len);
                 reply.read(buf->data(), len);
-                buf->meta_data().updateFromParcel(reply);
+                if (reply.readInt32() == COMPACT_META) {
+                    buf->meta_data().updateFromCompactParcel(reply);
+                } else {
+                    buf->meta_data().updateFromParcel(reply);
+                }
             }
             buffers->push_back(buf);
             ++bufferCount;
@@ -339,16 +353,29 @@ status_t BnMediaSource::onTransact(
                     data.readUint32(&len) == NO_ERROR
                     && len == sizeof(opts)
                     && data.read((void *)&opts, len) == NO_ERROR;
+            if (!useOptions) {
+                opts.reset();
+            }
 
             mGroup->signalBufferReturned(nullptr);
             mIndexCache.gc();
             size_t inlineTransferSize = 0;
             status_t ret = NO_ERROR;
             uint32_t bufferCount = 0;
+            // Buffers sent so far can't be returned before this transaction
+            // completes, so once one is out only nonblocking reads are safe.
+            const bool forceNonBlocking = supportNonblockingRead() && !opts.getNonBlocking();
             for (; bufferCount < maxNumBuffers; ++bufferCount, ++mBuffersSinceStop) {
                 MediaBuffer *buf = nullptr;
-                ret = read((MediaBufferBase **)&buf, useOptions ? &opts : nullptr);
+                ret = read((MediaBufferBase **)&buf,
+                        useOptions || bufferCount > 0 ? &opts : nullptr);
                 opts.clearNonPersistent(); // Remove options that only apply to first buffer.
+                if (forceNonBlocking) {
+                    opts.setNonBlocking();
+                    if (ret == WOULD_BLOCK && bufferCount > 0) {
+                        ret = NO_ERROR;
+                    }
+                }
                 if (ret != NO_ERROR || buf == nullptr) {
                     break;
                 }
@@ -414,7 +441,13 @@ status_t BnMediaSource::onTransact(
                     }
                     reply->writeInt32(offset);
                     reply->writeInt32(length);
-                    buf->meta_data().writeToParcel(*reply);
+                    if (buf->meta_data().isCompactable()) {
+                        reply->writeInt32(COMPACT_META);
+                        buf->meta_data().writeCompactToParcel(*reply);
+                    } else {
+                        reply->writeInt32(FULL_META);
+                        buf->meta_data().writeToParcel(*reply);
+                    }
                     transferBuf->addRemoteRefcount(1);
                     if (transferBuf != buf) {
                         transferBuf->release(); // release local ref
@@ -427,7 +460,13 @@ status_t BnMediaSource::onTransact(
                             buf, buf->mMemory->size(), length);
                     reply->writeInt32(INLINE_BUFFER);
                     reply->writeByteArray(length, (uint8_t*)buf->data() + offset);
-                    buf->meta_data().writeToParcel(*reply);
+                    if (buf->meta_data().isCompactable()) {
+                        reply->writeInt32(COMPACT_META);
+                        buf->meta_data().writeCompactToParcel(*reply);
+                    } else {
+                        reply->writeInt32(FULL_META);
+                        buf->meta_data().writeToParcel(*reply);
+                    }
                     inlineTransferSize += length;
                     if (inlineTransferSize > kInlineMaxTransfer) {
                         maxNumBuffers = 0; // stop readMultiple if inline transfer is too large.
@@ -23,6 +23,7 @@ namespace android {
 
 const char kPolicySupportsMultipleSecureCodecs[] = "supports-multiple-secure-codecs";
 const char kPolicySupportsSecureWithNonSecureCodec[] = "supports-secure-with-non-secure-codec";
+const char kPolicyMaxVideoCodecLoad[] = "max-video-codec-load";
 
 MediaResourcePolicy::MediaResourcePolicy() {}
 
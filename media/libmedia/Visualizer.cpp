@@ -28,6 +28,11 @@
 #include <audio_utils/fixedfft.h>
 #include <utils/Thread.h>
 
+// Also defined by the visualizer effect, see EffectVisualizer.cpp
+#ifndef VISUALIZER_CMD_CAPTURE_FFT
+#define VISUALIZER_CMD_CAPTURE_FFT (EFFECT_CMD_FIRST_PROPRIETARY + 2)
+#endif
+
 namespace android {
 
 // ---------------------------------------------------------------------------
@@ -44,7 +49,8 @@ Visualizer::Visualizer (const String16& opPackageName,
         mScalingMode(VISUALIZER_SCALING_MODE_NORMALIZED),
         mMeasurementMode(MEASUREMENT_MODE_NONE),
         mCaptureCallBack(NULL),
-        mCaptureCbkUser(NULL)
+        mCaptureCbkUser(NULL),
+        mEffectFft(true)
 {
     initCaptureSize();
 }
@@ -287,17 +293,48 @@ status_t Visualizer::getFft(uint8_t *fft)
 
     status_t status = NO_ERROR;
     if (mEnabled) {
-        uint8_t buf[mCaptureSize];
-        status = getWaveForm(buf);
-        if (status == NO_ERROR) {
-            status = doFft(fft, buf);
-        }
+        status = captureFft(fft, NULL);
     } else {
         memset(fft, 0, mCaptureSize);
     }
     return status;
 }
 
+status_t Visualizer::captureFft(uint8_t *fft, uint8_t *waveform)
+{
+    if (mEffectFft) {
+        // the effect computes the FFT once for all its clients
+        uint8_t buf[2 * mCaptureSize];
+        uint32_t replySize = waveform != NULL ? 2 * mCaptureSize : mCaptureSize;
+        status_t status = command(VISUALIZER_CMD_CAPTURE_FFT, 0, NULL, &replySize, buf);
+        ALOGV("captureFft() command returned %d", status);
+        if (status != BAD_VALUE) {
+            if (status == NO_ERROR && replySize == 0) {
+                status = NOT_ENOUGH_DATA;
+            }
+            if (status == NO_ERROR) {
+                memcpy(fft, buf, mCaptureSize);
+                if (waveform != NULL) {
+                    memcpy(waveform, buf + mCaptureSize, mCaptureSize);
+                }
+            }
+            return status;
+        }
+        ALOGV("captureFft() not supported by the effect");
+        mEffectFft = false;
+    }
+
+    uint8_t buf[mCaptureSize];
+    if (waveform == NULL) {
+        waveform = buf;
+    }
+    status_t status = getWaveForm(waveform);
+    if (status == NO_ERROR) {
+        status = doFft(fft, waveform);
+    }
+    return status;
+}
+
 status_t Visualizer::doFft(uint8_t *fft, uint8_t *waveform)
 {
     int32_t workspace[mCaptureSize >> 1];
@@ -335,13 +372,15 @@ void Visualizer::periodicCapture()
         (mCaptureFlags & (CAPTURE_WAVEFORM|CAPTURE_FFT)) &&
         mCaptureSize != 0) {
         uint8_t waveform[mCaptureSize];
-        status_t status = getWaveForm(waveform);
-        if (status != NO_ERROR) {
-            return;
-        }
         uint8_t fft[mCaptureSize];
-        if (mCaptureFlags & CAPTURE_FFT) {
-            status = doFft(fft, waveform);
+        status_t status;
+        if ((mCaptureFlags & CAPTURE_FFT) && mEnabled) {
+            status = captureFft(fft, (mCaptureFlags & CAPTURE_WAVEFORM) ? waveform : NULL);
+        } else {
+            status = getWaveForm(waveform);
+            if (status == NO_ERROR && (mCaptureFlags & CAPTURE_FFT)) {
+                status = doFft(fft, waveform);
+            }
         }
         if (status != NO_ERROR) {
             return;
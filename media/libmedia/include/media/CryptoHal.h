@@ -98,6 +98,9 @@ private:
     uint32_t mNextBufferId;
     int32_t mHeapSeqNum;
 
+    // Scratch storage for the subsamples passed to the plugin, guarded by mLock
+    std::vector<drm::V1_0::SubSample> mSubSamples;
+
     Vector<sp<ICryptoFactory>> makeCryptoFactories();
     sp<ICryptoPlugin> makeCryptoPlugin(const sp<ICryptoFactory>& factory,
             const uint8_t uuid[16], const void *initData, size_t size);
@@ -171,6 +171,9 @@ struct DrmHal : public BnDrm,
     virtual void binderDied(const wp<IBinder> &the_late_who);
 
 private:
+    // Records reclaims of this instance's sessions in mMetrics.
+    friend struct DrmSessionClient;
+
     static Mutex mLock;
 
     sp<DrmSessionClientInterface> mDrmSessionClient;
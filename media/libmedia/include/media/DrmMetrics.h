@@ -17,6 +17,7 @@
 #ifndef DRM_METRICS_H_
 #define DRM_METRICS_H_
 
+#include <deque>
 #include <map>
 
 #include <android/hardware/drm/1.0/types.h>
@@ -38,6 +39,8 @@ class MediaDrmMetrics {
   virtual ~MediaDrmMetrics() {};
   // Count of openSession calls.
   CounterMetric<status_t> mOpenSessionCounter;
+  // Timing of openSession calls.
+  EventMetric<status_t> mOpenSessionTimeUs;
   // Count of closeSession calls.
   CounterMetric<status_t> mCloseSessionCounter;
   // Count and timing of getKeyRequest calls.
@@ -64,6 +67,13 @@ class MediaDrmMetrics {
   // Adds a session end time record.
   void SetSessionEnd(const Vector<uint8_t>& sessionId);
 
+  // Adds a session reclaim record. |requested| is true if this instance asked
+  // for a session of another client to be reclaimed, in which case
+  // |sessionId| is empty, and false if its own session |sessionId| was
+  // reclaimed. Only the most recent kMaxSessionReclaims records are kept.
+  void AddSessionReclaim(const Vector<uint8_t>& sessionId, bool requested,
+                         bool succeeded);
+
   // The app package name is the application package name that is using the
   // instance. The app package name is held here for convenience. It is not
   // serialized or exported with the metrics.
@@ -125,10 +135,22 @@ class MediaDrmMetrics {
   virtual int64_t GetCurrentTimeMs();
 
  private:
+  static const size_t kMaxSessionReclaims = 64;
+
+  struct SessionReclaim {
+    int64_t timeMs;
+    std::string sessionIdHex;
+    bool requested;
+    bool succeeded;
+  };
+
   // Session lifetimes. A pair of values representing the milliseconds since
   // epoch, UTC. The first value is the start time, the second is the end time.
   std::map<std::string, std::pair<int64_t, int64_t>> mSessionLifespans;
 
+  // Recent session reclaims, oldest first.
+  std::deque<SessionReclaim> mSessionReclaims;
+
   String8 mAppPackageName;
 };
 
@@ -19,8 +19,26 @@
 #include <media/MediaAnalyticsItem.h>
 #include <utils/Timers.h>
 
+#include <cmath>
+
 namespace android {
 
+// The number of buckets in EventStatistics::histogram. Bucket 0 counts values
+// less than 1, bucket i counts values in [2^(i-1), 2^i). The last bucket also
+// counts all larger values.
+constexpr size_t kEventHistogramBuckets = 32;
+
+// Returns the index of the histogram bucket that |value| is counted in.
+inline size_t GetEventHistogramBucket(double value) {
+  if (!(value >= 1)) {
+    return 0;
+  }
+  int exponent;
+  std::frexp(value, &exponent);
+  return exponent < static_cast<int>(kEventHistogramBuckets)
+      ? exponent : kEventHistogramBuckets - 1;
+}
+
 // This is a simple holder for the statistics recorded in EventMetric.
 struct EventStatistics {
   // The count of times the event occurred.
@@ -36,6 +54,10 @@ struct EventStatistics {
   // this value.
   //    var = sum_squared_deviation / count;
   double sum_squared_deviation;
+
+  // The count of values recorded in each power of two bucket. See
+  // kEventHistogramBuckets for the bucket boundaries.
+  int64_t histogram[kEventHistogramBuckets];
 };
 
 // The EventMetric class is used to accumulate stats about an event over time.
@@ -95,6 +117,7 @@ class EventMetric {
 
       stats->min = stats->min < value ? stats->min : value;
       stats->max = stats->max > value ? stats->max : value;
+      stats->histogram[GetEventHistogramBucket(value)]++;
     } else {
       std::unique_ptr<EventStatistics> stats =
           std::make_unique<EventStatistics>();
@@ -103,6 +126,7 @@ class EventMetric {
       stats->max = value;
       stats->mean = value;
       stats->sum_squared_deviation = 0;
+      stats->histogram[GetEventHistogramBucket(value)] = 1;
       values_[attribute] = std::move(stats);
     }
   };
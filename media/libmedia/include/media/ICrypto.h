@@ -15,9 +15,13 @@
  */
 
 #include <binder/IInterface.h>
+#include <binder/IMemory.h>
 #include <cutils/native_handle.h>
 #include <media/hardware/CryptoAPI.h>
 #include <media/stagefright/foundation/ABase.h>
+#include <utils/threads.h>
+
+#include <map>
 
 #ifndef ANDROID_ICRYPTO_H_
 
@@ -90,6 +94,15 @@ struct BnCrypto : public BnInterface<ICrypto> {
 private:
     void readVector(const Parcel &data, Vector<uint8_t> &vector) const;
     void writeVector(Parcel *reply, Vector<uint8_t> const &vector) const;
+
+    sp<IMemory> getMemory(const sp<IBinder> &binder, int32_t heapSeqNum);
+
+    // Memory passed to decrypt, by heap. Codecs carve their input buffers from a
+    // heap registered with setHeap and pass the same few IMemory objects for
+    // every sample. Reusing the proxies avoids a getMemory() call back into the
+    // client for each source and destination. Entries are dropped with their heap.
+    Mutex mMemoryLock;
+    std::map<int32_t, std::map<sp<IBinder>, sp<IMemory>>> mMemories;
 };
 
 }  // namespace android
@@ -31,6 +31,8 @@ public:
         kNonSecureCodec,
         kGraphicMemory,
         kCpuBoost,
+        // Decoding/encoding load of a video codec session in macroblocks per second
+        kVideoCodecLoad,
     };
 
     enum SubType {
@@ -62,6 +64,7 @@ inline static const char *asString(MediaResource::Type i, const char *def = "??"
         case MediaResource::kSecureCodec:    return "secure-codec";
         case MediaResource::kNonSecureCodec: return "non-secure-codec";
         case MediaResource::kGraphicMemory:  return "graphic-memory";
+        case MediaResource::kVideoCodecLoad: return "video-codec-load";
         default:                             return def;
     }
 }
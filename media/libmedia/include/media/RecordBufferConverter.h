@@ -78,6 +78,12 @@ public:
     // called to reset resampler buffers on record track discontinuity
     void reset();
 
+    // returns true if 'other' converts the same input to the same output, and neither keeps
+    // state between calls (no resampler): the output of one can then be copied for the other.
+    bool isSharableWith(const RecordBufferConverter &other) const;
+
+    size_t getDstFrameSize() const { return mDstFrameSize; }
+
 private:
     // format conversion when not using resampler
     void convertNoResampler(void *dst, const void *src, size_t frames);
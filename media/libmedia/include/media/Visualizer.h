@@ -157,6 +157,9 @@ private:
     };
 
     status_t doFft(uint8_t *fft, uint8_t *waveform);
+    // gets the FFT computed by the effect, and the capture it was computed from if waveform
+    // is not NULL. Computes them with getWaveForm() and doFft() if the effect can't.
+    status_t captureFft(uint8_t *fft, uint8_t *waveform);
     void periodicCapture();
     uint32_t initCaptureSize();
 
@@ -170,6 +173,7 @@ private:
     void *mCaptureCbkUser;
     sp<CaptureThread> mCaptureThread;
     uint32_t mCaptureFlags;
+    bool mEffectFft; // false once the effect has rejected VISUALIZER_CMD_CAPTURE_FFT
 };
 
 
@@ -177,7 +177,12 @@ enum media_parameter_keys {
     KEY_PARAMETER_PLAYBACK_RATE_PERMILLE = 1300,                // set only
 
     // Set a Parcel containing the value of a parcelled Java AudioAttribute instance
-    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400                       // set only
+    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400,                      // set only
+
+    // Set a Parcel containing two int64_t: the common clock time in microseconds at which the
+    // media time in microseconds that follows should be presented. Audio playback is then kept
+    // aligned to the network synchronized common clock. A negative common time disables it.
+    KEY_PARAMETER_COMMON_TIME_ANCHOR = 1500                     // set only
 };
 
 // Keep INVOKE_ID_* in sync with MediaPlayer.java.
@@ -17,6 +17,8 @@
 #define LOG_TAG "MediaBufferGroup"
 #include <utils/Log.h>
 
+#include <algorithm>
+#include <deque>
 #include <list>
 
 #include <binder/MemoryDealer.h>
@@ -40,7 +42,21 @@ struct MediaBufferGroup::InternalData {
     Mutex mLock;
     Condition mCondition;
     size_t mGrowthLimit;  // Do not automatically grow group larger than this.
+    size_t mWaiters;      // Number of acquire_buffer() calls blocked on mCondition.
     std::list<MediaBufferBase *> mBuffers;
+
+    // Buffers in the order they were returned. Entries are only hints: a buffer
+    // may have been acquired again by a full scan, or may still be held
+    // remotely, so they are re-validated when popped.
+    std::deque<MediaBufferBase *> mReturned;
+
+    InternalData() : mGrowthLimit(0), mWaiters(0) { }
+
+    // Must be called before a buffer of the group is released for good.
+    void forgetReturned_l(MediaBufferBase *buffer) {
+        mReturned.erase(std::remove(mReturned.begin(), mReturned.end(), buffer),
+                mReturned.end());
+    }
 };
 
 MediaBufferGroup::MediaBufferGroup(size_t growthLimit)
@@ -128,6 +144,7 @@ void MediaBufferGroup::add_buffer(MediaBufferBase *buffer) {
             && mInternal->mBuffers.size() >= mInternal->mGrowthLimit
             && it != mInternal->mBuffers.end();) {
         if ((*it)->refcount() == 0) {
+            mInternal->forgetReturned_l(*it);
             (*it)->setObserver(nullptr);
             (*it)->release();
             it = mInternal->mBuffers.erase(it);
@@ -138,6 +155,9 @@ void MediaBufferGroup::add_buffer(MediaBufferBase *buffer) {
 
     buffer->setObserver(this);
     mInternal->mBuffers.emplace_back(buffer);
+    if (buffer->refcount() == 0) {
+        mInternal->mReturned.push_back(buffer);
+    }
 }
 
 bool MediaBufferGroup::has_buffers() {
@@ -156,8 +176,26 @@ status_t MediaBufferGroup::acquire_buffer(
         MediaBufferBase **out, bool nonBlocking, size_t requestedSize) {
     Mutex::Autolock autoLock(mInternal->mLock);
     for (;;) {
-        size_t smallest = requestedSize;
         MediaBufferBase *buffer = nullptr;
+
+        // Fast path: O(1) pick of a recently returned buffer. Stale or too
+        // small entries are dropped; the full scan below still sees them.
+        while (!mInternal->mReturned.empty()) {
+            MediaBufferBase *returned = mInternal->mReturned.front();
+            mInternal->mReturned.pop_front();
+            if (returned->refcount() == 0 && returned->size() >= requestedSize) {
+                buffer = returned;
+                break;
+            }
+        }
+        if (buffer != nullptr) {
+            buffer->add_ref();
+            buffer->reset();
+            *out = buffer;
+            return OK;
+        }
+
+        size_t smallest = requestedSize;
         auto free = mInternal->mBuffers.end();
         for (auto it = mInternal->mBuffers.begin(); it != mInternal->mBuffers.end(); ++it) {
             if ((*it)->refcount() == 0) {
@@ -188,6 +226,7 @@ status_t MediaBufferGroup::acquire_buffer(
                 if (free != mInternal->mBuffers.end()) {
                     ALOGV("reallocate buffer, requested size %zu vs available %zu",
                             requestedSize, (*free)->size());
+                    mInternal->forgetReturned_l(*free);
                     (*free)->setObserver(nullptr);
                     (*free)->release();
                     *free = buffer; // in-place replace
@@ -208,7 +247,9 @@ status_t MediaBufferGroup::acquire_buffer(
             return WOULD_BLOCK;
         }
         // All buffers are in use, block until one of them is returned.
+        ++mInternal->mWaiters;
         mInternal->mCondition.wait(mInternal->mLock);
+        --mInternal->mWaiters;
     }
     // Never gets here.
 }
@@ -217,9 +258,15 @@ size_t MediaBufferGroup::buffers() const {
     return mInternal->mBuffers.size();
 }
 
-void MediaBufferGroup::signalBufferReturned(MediaBufferBase *) {
+void MediaBufferGroup::signalBufferReturned(MediaBufferBase *buffer) {
     Mutex::Autolock autoLock(mInternal->mLock);
-    mInternal->mCondition.signal();
+    // nullptr means a remote release; the next acquire_buffer() scan finds it
+    if (buffer != nullptr) {
+        mInternal->mReturned.push_back(buffer);
+    }
+    if (mInternal->mWaiters > 0) {
+        mInternal->mCondition.signal();
+    }
 }
 
 }  // namespace android
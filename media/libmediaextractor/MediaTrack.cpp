@@ -15,6 +15,7 @@
  */
 
 #include <media/MediaTrack.h>
+#include <media/stagefright/MediaBufferBase.h>
 
 namespace android {
 
@@ -22,6 +23,37 @@ MediaTrack::MediaTrack() {}
 
 MediaTrack::~MediaTrack() {}
 
+status_t MediaTrack::readMultiple(
+        Vector<MediaBufferBase *> *buffers, uint32_t maxNumBuffers,
+        size_t maxBytes, const ReadOptions *options) {
+    ReadOptions opts;
+    if (options != NULL) {
+        opts = *options;
+    }
+    if (!supportNonblockingRead() && maxNumBuffers > 1) {
+        maxNumBuffers = 1;
+    }
+
+    status_t err = OK;
+    size_t numBytes = 0;
+    for (uint32_t i = 0; i < maxNumBuffers && numBytes < maxBytes; ++i) {
+        MediaBufferBase *buffer = NULL;
+        err = read(&buffer, &opts);
+        if (i == 0) {
+            opts.clearNonPersistent();
+            opts.setNonBlocking();
+        } else if (err == WOULD_BLOCK) {
+            err = OK;
+        }
+        if (err != OK || buffer == NULL) {
+            break;
+        }
+        buffers->push_back(buffer);
+        numBytes += buffer->range_length();
+    }
+    return err;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 MediaTrack::ReadOptions::ReadOptions() {
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/MetaData.h>
@@ -32,19 +33,36 @@
 namespace android {
 
 
-MetaData::MetaData() {
+MetaData::MetaData()
+    : mCachedGeneration(0) {
 }
 
 MetaData::MetaData(const MetaData &from)
-    : MetaDataBase(from) {
+    : MetaDataBase(from),
+      mCachedGeneration(0) {
 }
 MetaData::MetaData(const MetaDataBase &from)
-    : MetaDataBase(from) {
+    : MetaDataBase(from),
+      mCachedGeneration(0) {
 }
 
 MetaData::~MetaData() {
 }
 
+sp<AMessage> MetaData::getCachedMessage() const {
+    Mutex::Autolock autoLock(mCacheLock);
+    if (mCachedMessage == NULL || mCachedGeneration != generation()) {
+        return NULL;
+    }
+    return mCachedMessage;
+}
+
+void MetaData::setCachedMessage(const sp<AMessage> &msg) {
+    Mutex::Autolock autoLock(mCacheLock);
+    mCachedMessage = msg;
+    mCachedGeneration = generation();
+}
+
 /* static */
 sp<MetaData> MetaData::createFromParcel(const Parcel &parcel) {
 
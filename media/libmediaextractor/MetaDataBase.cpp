@@ -24,6 +24,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <atomic>
+#include <new>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
@@ -31,6 +34,40 @@
 
 namespace android {
 
+namespace {
+
+struct CompactKey {
+    uint32_t mKey;
+    uint32_t mType;
+};
+
+// Keys that may appear in the compact encoding, in wire order. Append only;
+// the index of a key is its bit in the presence mask.
+const CompactKey kCompactKeys[] = {
+    { kKeyTime,             MetaDataBase::TYPE_INT64 },
+    { kKeyDecodingTime,     MetaDataBase::TYPE_INT64 },
+    { kKeyDuration,         MetaDataBase::TYPE_INT64 },
+    { kKeyTargetTime,       MetaDataBase::TYPE_INT64 },
+    { kKeyIsSyncFrame,      MetaDataBase::TYPE_INT32 },
+    { kKeyIsCodecConfig,    MetaDataBase::TYPE_INT32 },
+    { kKeyIsUnreadable,     MetaDataBase::TYPE_INT32 },
+    { kKeyValidSamples,     MetaDataBase::TYPE_INT32 },
+    { kKeyTemporalLayerId,  MetaDataBase::TYPE_INT32 },
+};
+
+const size_t kNumCompactKeys = sizeof(kCompactKeys) / sizeof(kCompactKeys[0]);
+
+ssize_t findCompactKey(uint32_t key) {
+    for (size_t i = 0; i < kNumCompactKeys; ++i) {
+        if (kCompactKeys[i].mKey == key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
 struct MetaDataBase::typed_data {
     typed_data();
     ~typed_data();
@@ -45,12 +82,25 @@ struct MetaDataBase::typed_data {
     String8 asString(bool verbose) const;
 
 private:
+    // Values too large for the reservoir (codec specific data, long strings)
+    // live in a reference counted block that copies of the item share. A
+    // block is never written after setData() fills it; setting a new value
+    // drops the reference and allocates a new block.
+    struct alignas(16) SharedStorage {
+        std::atomic<int32_t> mRefs;
+
+        void *data() {
+            return this + 1;
+        }
+    };
+
     uint32_t mType;
     size_t mSize;
 
+    // large enough for all the fixed-size types, including Rect
     union {
-        void *ext_data;
-        float reservoir;
+        SharedStorage *ext_data;
+        int64_t reservoir[2];
     } u;
 
     bool usesReservoir() const {
@@ -58,14 +108,15 @@ private:
     }
 
     void *allocateStorage(size_t size);
+    void shareStorage(const typed_data &from);
     void freeStorage();
 
     void *storage() {
-        return usesReservoir() ? &u.reservoir : u.ext_data;
+        return usesReservoir() ? (void *)u.reservoir : u.ext_data->data();
     }
 
     const void *storage() const {
-        return usesReservoir() ? &u.reservoir : u.ext_data;
+        return usesReservoir() ? (const void *)u.reservoir : u.ext_data->data();
     }
 };
 
@@ -75,6 +126,20 @@ struct MetaDataBase::Rect {
 
 
 struct MetaDataBase::MetaDataInternal {
+    MetaDataInternal() : mGeneration(0), mCompactMask(0) {}
+
+    uint32_t mGeneration;
+
+    // The per-sample keys in kCompactKeys are kept here instead of in mItems
+    // when they have their usual type, so that setting and finding them never
+    // touches the map. Bit i of mCompactMask tells whether kCompactKeys[i] is
+    // set. A key is never in both places.
+    uint32_t mCompactMask;
+    union {
+        int32_t int32Value;
+        int64_t int64Value;
+    } mCompactValues[kNumCompactKeys];
+
     KeyedVector<uint32_t, MetaDataBase::typed_data> mItems;
 };
 
@@ -84,12 +149,13 @@ MetaDataBase::MetaDataBase()
 }
 
 MetaDataBase::MetaDataBase(const MetaDataBase &from)
-    : mInternalData(new MetaDataInternal()) {
-    mInternalData->mItems = from.mInternalData->mItems;
+    : mInternalData(new MetaDataInternal(*from.mInternalData)) {
 }
 
 MetaDataBase& MetaDataBase::operator = (const MetaDataBase &rhs) {
-    this->mInternalData->mItems = rhs.mInternalData->mItems;
+    uint32_t generation = mInternalData->mGeneration;
+    *this->mInternalData = *rhs.mInternalData;
+    mInternalData->mGeneration = generation + 1;
     return *this;
 }
 
@@ -99,10 +165,19 @@ MetaDataBase::~MetaDataBase() {
 }
 
 void MetaDataBase::clear() {
+    ++mInternalData->mGeneration;
+    mInternalData->mCompactMask = 0;
     mInternalData->mItems.clear();
 }
 
 bool MetaDataBase::remove(uint32_t key) {
+    ssize_t index = findCompactKey(key);
+    if (index >= 0 && (mInternalData->mCompactMask & (1u << index))) {
+        mInternalData->mCompactMask &= ~(1u << index);
+        ++mInternalData->mGeneration;
+        return true;
+    }
+
     ssize_t i = mInternalData->mItems.indexOfKey(key);
 
     if (i < 0) {
@@ -110,6 +185,7 @@ bool MetaDataBase::remove(uint32_t key) {
     }
 
     mInternalData->mItems.removeItemsAt(i);
+    ++mInternalData->mGeneration;
 
     return true;
 }
@@ -249,6 +325,32 @@ bool MetaDataBase::setData(
         uint32_t key, uint32_t type, const void *data, size_t size) {
     bool overwrote_existing = true;
 
+    ++mInternalData->mGeneration;
+
+    ssize_t index = findCompactKey(key);
+    if (index >= 0) {
+        uint32_t bit = 1u << index;
+        bool wasCompact = (mInternalData->mCompactMask & bit) != 0;
+        size_t compactSize = kCompactKeys[index].mType == TYPE_INT64
+                ? sizeof(int64_t) : sizeof(int32_t);
+        if (type == kCompactKeys[index].mType && size == compactSize) {
+            if (!wasCompact) {
+                // drop any value of another type from the map
+                overwrote_existing = remove(key);
+            }
+            memcpy(&mInternalData->mCompactValues[index], data, size);
+            mInternalData->mCompactMask |= bit;
+            return overwrote_existing;
+        }
+        mInternalData->mCompactMask &= ~bit;
+        if (wasCompact) {
+            typed_data item;
+            item.setData(type, data, size);
+            mInternalData->mItems.add(key, item);
+            return true;
+        }
+    }
+
     ssize_t i = mInternalData->mItems.indexOfKey(key);
     if (i < 0) {
         typed_data item;
@@ -266,6 +368,19 @@ bool MetaDataBase::setData(
 
 bool MetaDataBase::findData(uint32_t key, uint32_t *type,
                         const void **data, size_t *size) const {
+    ssize_t index = findCompactKey(key);
+    if (index >= 0 && (mInternalData->mCompactMask & (1u << index))) {
+        *type = kCompactKeys[index].mType;
+        if (*type == TYPE_INT64) {
+            *data = &mInternalData->mCompactValues[index].int64Value;
+            *size = sizeof(int64_t);
+        } else {
+            *data = &mInternalData->mCompactValues[index].int32Value;
+            *size = sizeof(int32_t);
+        }
+        return true;
+    }
+
     ssize_t i = mInternalData->mItems.indexOfKey(key);
 
     if (i < 0) {
@@ -280,6 +395,11 @@ bool MetaDataBase::findData(uint32_t key, uint32_t *type,
 }
 
 bool MetaDataBase::hasData(uint32_t key) const {
+    ssize_t index = findCompactKey(key);
+    if (index >= 0 && (mInternalData->mCompactMask & (1u << index))) {
+        return true;
+    }
+
     ssize_t i = mInternalData->mItems.indexOfKey(key);
 
     if (i < 0) {
@@ -289,6 +409,10 @@ bool MetaDataBase::hasData(uint32_t key) const {
     return true;
 }
 
+uint32_t MetaDataBase::generation() const {
+    return mInternalData->mGeneration;
+}
+
 MetaDataBase::typed_data::typed_data()
     : mType(0),
       mSize(0) {
@@ -301,11 +425,7 @@ MetaDataBase::typed_data::~typed_data() {
 MetaDataBase::typed_data::typed_data(const typed_data &from)
     : mType(from.mType),
       mSize(0) {
-
-    void *dst = allocateStorage(from.mSize);
-    if (dst) {
-        memcpy(dst, from.storage(), mSize);
-    }
+    shareStorage(from);
 }
 
 MetaDataBase::typed_data &MetaDataBase::typed_data::operator=(
@@ -313,10 +433,7 @@ MetaDataBase::typed_data &MetaDataBase::typed_data::operator=(
     if (this != &from) {
         clear();
         mType = from.mType;
-        void *dst = allocateStorage(from.mSize);
-        if (dst) {
-            memcpy(dst, from.storage(), mSize);
-        }
+        shareStorage(from);
     }
 
     return *this;
@@ -351,23 +468,37 @@ void *MetaDataBase::typed_data::allocateStorage(size_t size) {
     mSize = size;
 
     if (usesReservoir()) {
-        return &u.reservoir;
+        return u.reservoir;
     }
 
-    u.ext_data = malloc(mSize);
-    if (u.ext_data == NULL) {
+    void *block = malloc(sizeof(SharedStorage) + mSize);
+    if (block == NULL) {
         ALOGE("Couldn't allocate %zu bytes for item", size);
         mSize = 0;
+        return u.reservoir;
+    }
+    u.ext_data = new (block) SharedStorage;
+    u.ext_data->mRefs.store(1, std::memory_order_relaxed);
+    return u.ext_data->data();
+}
+
+void MetaDataBase::typed_data::shareStorage(const typed_data &from) {
+    mSize = from.mSize;
+    if (usesReservoir()) {
+        memcpy(u.reservoir, from.u.reservoir, sizeof(u.reservoir));
+    } else {
+        u.ext_data = from.u.ext_data;
+        u.ext_data->mRefs.fetch_add(1, std::memory_order_relaxed);
     }
-    return u.ext_data;
 }
 
 void MetaDataBase::typed_data::freeStorage() {
     if (!usesReservoir()) {
-        if (u.ext_data) {
+        if (u.ext_data->mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            u.ext_data->~SharedStorage();
             free(u.ext_data);
-            u.ext_data = NULL;
         }
+        u.ext_data = NULL;
     }
 
     mSize = 0;
@@ -436,6 +567,20 @@ String8 MetaDataBase::toString() const {
             s.append(", ");
         }
     }
+    for (size_t i = 0; i < kNumCompactKeys; ++i) {
+        if (!(mInternalData->mCompactMask & (1u << i))) {
+            continue;
+        }
+        uint32_t type;
+        const void *data;
+        size_t size;
+        findData(kCompactKeys[i].mKey, &type, &data, &size);
+        typed_data item;
+        item.setData(type, data, size);
+        char cc[5];
+        MakeFourCCString(kCompactKeys[i].mKey, cc);
+        s.appendFormat("%s%s: %s", s.isEmpty() ? "" : ", ", cc, item.asString(false).string());
+    }
     return s;
 }
 
@@ -447,22 +592,45 @@ void MetaDataBase::dumpToLog() const {
         const typed_data &item = mInternalData->mItems.valueAt(i);
         ALOGI("%s: %s", cc, item.asString(true /* verbose */).string());
     }
+    for (size_t i = 0; i < kNumCompactKeys; ++i) {
+        if (!(mInternalData->mCompactMask & (1u << i))) {
+            continue;
+        }
+        uint32_t type;
+        const void *data;
+        size_t size;
+        findData(kCompactKeys[i].mKey, &type, &data, &size);
+        typed_data item;
+        item.setData(type, data, size);
+        char cc[5];
+        MakeFourCCString(kCompactKeys[i].mKey, cc);
+        ALOGI("%s: %s", cc, item.asString(true /* verbose */).string());
+    }
 }
 
 status_t MetaDataBase::writeToParcel(Parcel &parcel) {
     status_t ret;
-    size_t numItems = mInternalData->mItems.size();
+    size_t numMapItems = mInternalData->mItems.size();
+    size_t numItems = numMapItems + __builtin_popcount(mInternalData->mCompactMask);
     ret = parcel.writeUint32(uint32_t(numItems));
     if (ret) {
         return ret;
     }
-    for (size_t i = 0; i < numItems; i++) {
-        int32_t key = mInternalData->mItems.keyAt(i);
-        const typed_data &item = mInternalData->mItems.valueAt(i);
+    for (size_t i = 0, compact = 0; i < numItems; i++) {
+        int32_t key;
         uint32_t type;
         const void *data;
         size_t size;
-        item.getData(&type, &data, &size);
+        if (i < numMapItems) {
+            key = mInternalData->mItems.keyAt(i);
+            mInternalData->mItems.valueAt(i).getData(&type, &data, &size);
+        } else {
+            while (!(mInternalData->mCompactMask & (1u << compact))) {
+                ++compact;
+            }
+            key = kCompactKeys[compact++].mKey;
+            findData(key, &type, &data, &size);
+        }
         ret = parcel.writeInt32(key);
         if (ret) {
             return ret;
@@ -529,5 +697,59 @@ status_t MetaDataBase::updateFromParcel(const Parcel &parcel) {
     return UNKNOWN_ERROR;
 }
 
+
+bool MetaDataBase::isCompactable() const {
+    // compact keys of their usual type never reach the map
+    return mInternalData->mItems.isEmpty();
+}
+
+status_t MetaDataBase::writeCompactToParcel(Parcel &parcel) const {
+    if (!isCompactable()) {
+        return INVALID_OPERATION;
+    }
+
+    uint32_t mask = mInternalData->mCompactMask;
+    status_t ret = parcel.writeUint32(mask);
+    for (size_t i = 0; ret == OK && i < kNumCompactKeys; ++i) {
+        if (mask & (1u << i)) {
+            if (kCompactKeys[i].mType == TYPE_INT64) {
+                ret = parcel.writeInt64(mInternalData->mCompactValues[i].int64Value);
+            } else {
+                ret = parcel.writeInt64(mInternalData->mCompactValues[i].int32Value);
+            }
+        }
+    }
+    return ret;
+}
+
+status_t MetaDataBase::updateFromCompactParcel(const Parcel &parcel) {
+    uint32_t mask;
+    status_t ret = parcel.readUint32(&mask);
+    if (ret != OK) {
+        ALOGW("no compact metadata in parcel");
+        return ret;
+    }
+    if (mask >> kNumCompactKeys) {
+        ALOGW("unknown keys in compact metadata (mask 0x%x)", mask);
+        return BAD_VALUE;
+    }
+    for (size_t i = 0; i < kNumCompactKeys; ++i) {
+        if (!(mask & (1u << i))) {
+            continue;
+        }
+        int64_t value;
+        ret = parcel.readInt64(&value);
+        if (ret != OK) {
+            return ret;
+        }
+        if (kCompactKeys[i].mType == TYPE_INT64) {
+            setInt64(kCompactKeys[i].mKey, value);
+        } else {
+            setInt32(kCompactKeys[i].mKey, (int32_t)value);
+        }
+    }
+    return OK;
+}
+
 }  // namespace android
 
@@ -18,7 +18,9 @@
 
 #define DATA_SOURCE_BASE_H_
 
+#include <stdint.h>
 #include <sys/types.h>
+#include <media/stagefright/MediaErrors.h>
 #include <utils/Errors.h>
 
 namespace android {
@@ -44,6 +46,16 @@ public:
     // beyond, the end of the source.
     virtual ssize_t readAt(off64_t offset, void *data, size_t size) = 0;
 
+    // Zero-copy alternative to readAt() for sources that keep their content
+    // in memory. On success *data points at up to |size| bytes starting at
+    // |offset| and the number of bytes available there is returned; the
+    // pointer stays valid for the lifetime of the source. Sources that cannot
+    // lend their storage return ERROR_UNSUPPORTED and callers use readAt().
+    virtual ssize_t borrowAt(off64_t /* offset */, const uint8_t ** /* data */,
+            size_t /* size */) {
+        return ERROR_UNSUPPORTED;
+    }
+
     // Convenience methods:
     bool getUInt16(off64_t offset, uint16_t *x);
     bool getUInt24(off64_t offset, uint32_t *x); // 3 byte int, returned as a 32-bit int
@@ -113,6 +113,21 @@ struct MediaTrack
     virtual status_t read(
             MediaBufferBase **buffer, const ReadOptions *options = NULL) = 0;
 
+    // Returns true if |read| supports the nonblocking option, otherwise false.
+    virtual bool supportNonblockingRead() { return false; }
+
+    // Appends up to |maxNumBuffers| new buffers to |buffers|, stopping early
+    // once |maxBytes| of data have been returned, a read fails or, after
+    // the first buffer, a read would block. Persistent options apply to all
+    // reads; non-persistent options (e.g. seek) apply only to the first.
+    // Returns the status of the read that ended the batch, OK if it ended
+    // on a limit. Buffers read before an error are still returned.
+    // Tracks without nonblocking reads only return one buffer per call,
+    // since holding on to more could exhaust their buffer group.
+    virtual status_t readMultiple(
+            Vector<MediaBufferBase *> *buffers, uint32_t maxNumBuffers,
+            size_t maxBytes, const ReadOptions *options = NULL);
+
     virtual ~MediaTrack();
 
 private:
@@ -22,22 +22,34 @@
 
 #include <stdint.h>
 
+#include <utils/Mutex.h>
 #include <utils/RefBase.h>
 #include <utils/String8.h>
 #include <media/stagefright/MetaDataBase.h>
 
 namespace android {
 
+struct AMessage;
+
 class MetaData final : public MetaDataBase, public RefBase {
 public:
     MetaData();
     MetaData(const MetaData &from);
     MetaData(const MetaDataBase &from);
 
+    // The AMessage format last converted from this metadata, or NULL if the
+    // metadata has changed since. Callers must not modify it.
+    sp<AMessage> getCachedMessage() const;
+    void setCachedMessage(const sp<AMessage> &msg);
+
 protected:
     virtual ~MetaData();
 
 private:
+    mutable Mutex mCacheLock;
+    sp<AMessage> mCachedMessage;
+    uint32_t mCachedGeneration;
+
     friend class BnMediaSource;
     friend class BpMediaSource;
     friend class BpMediaExtractor;
@@ -296,6 +296,10 @@ public:
 
     bool hasData(uint32_t key) const;
 
+    // Changes whenever the contents change, so that data derived from them
+    // can be cached.
+    uint32_t generation() const;
+
     String8 toString() const;
     void dumpToLog() const;
 
@@ -311,6 +315,14 @@ private:
     MetaDataInternal *mInternalData;
     status_t writeToParcel(Parcel &parcel);
     status_t updateFromParcel(const Parcel &parcel);
+
+    // Per-buffer metadata usually only carries a handful of int32/int64
+    // timing and flag keys. For those a fixed layout (presence mask followed
+    // by the values) is much cheaper to marshal than the generic key/type/
+    // size encoding used by writeToParcel().
+    bool isCompactable() const;
+    status_t writeCompactToParcel(Parcel &parcel) const;
+    status_t updateFromCompactParcel(const Parcel &parcel);
 };
 
 }  // namespace android
@@ -41,6 +41,7 @@ namespace android {
 enum {
     GENERATE_UNIQUE_SESSIONID = IBinder::FIRST_CALL_TRANSACTION,
     SUBMIT_ITEM,
+    SUBMIT_BATCH,
 };
 
 class BpMediaAnalyticsService: public BpInterface<IMediaAnalyticsService>
@@ -106,6 +107,23 @@ public:
         return sessionid;
     }
 
+    virtual void submitBatch(const std::vector<MediaAnalyticsItem *> &items)
+    {
+        Parcel data;
+
+        data.writeInterfaceToken(IMediaAnalyticsService::getInterfaceDescriptor());
+        data.writeInt32(items.size());
+        for (MediaAnalyticsItem *item : items) {
+            item->writeToParcel(&data);
+        }
+
+        // oneway, so the caller never waits on the service
+        status_t err = remote()->transact(SUBMIT_BATCH, data, NULL, IBinder::FLAG_ONEWAY);
+        if (err != NO_ERROR) {
+            ALOGW("bad response from service for submitBatch, err=%d", err);
+        }
+    }
+
 };
 
 IMPLEMENT_META_INTERFACE(MediaAnalyticsService, "android.media.IMediaAnalyticsService");
@@ -156,6 +174,33 @@ status_t BnMediaAnalyticsService::onTransact(
             return NO_ERROR;
         } break;
 
+        case SUBMIT_BATCH: {
+            CHECK_INTERFACE(IMediaAnalyticsService, data, reply);
+
+            int32_t count = data.readInt32();
+            if (count < 0 || (size_t) count > kMaxBatchSize) {
+                ALOGW("rejecting batch of %d records from pid %d", count, clientPid);
+                return BAD_VALUE;
+            }
+
+            std::vector<MediaAnalyticsItem *> items;
+            items.reserve(count);
+            for (int32_t i = 0; i < count; i++) {
+                MediaAnalyticsItem *item = new MediaAnalyticsItem;
+                if (item->readFromParcel(data) != 0) {
+                    delete item;
+                    break;
+                }
+                item->setPid(clientPid);
+                items.push_back(item);
+            }
+
+            // submitBatch() takes over ownership of the items
+            submitBatch(items);
+
+            return NO_ERROR;
+        } break;
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -22,6 +22,14 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <binder/Parcel.h>
 #include <utils/Errors.h>
 #include <utils/Log.h>
@@ -861,6 +869,114 @@ bool MediaAnalyticsItem::selfrecord(bool forcenew) {
     }
 }
 
+// Records from selfrecordBatched() are pushed onto a lock-free list; a
+// flusher thread, started on first use, takes the whole list and hands it
+// to the service in oneway submitBatch() calls. It flushes once
+// kBatchSize records are queued, or kBatchDelay after the first one.
+// Only the rare wakeups of the flusher take a lock.
+struct BatchNode {
+    MediaAnalyticsItem *item;
+    BatchNode *next;
+};
+
+static const int32_t kBatchSize = 32;
+// beyond this many queued records, new ones are dropped
+static const int32_t kMaxBatchPending = 512;
+static const std::chrono::milliseconds kBatchDelay(1000);
+
+struct BatchQueue {
+    std::atomic<BatchNode *> head{nullptr};
+    std::atomic<int32_t> pending{0};
+    std::mutex lock;
+    std::condition_variable condition;
+    std::once_flag threadOnce;
+};
+
+// never destroyed, as the flusher thread outlives static destructors
+static BatchQueue *sBatchQueue = new BatchQueue;
+
+bool MediaAnalyticsItem::selfrecordBatched() {
+
+    if (!isEnabled()) {
+        return false;
+    }
+
+    int32_t pending = sBatchQueue->pending.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (pending > kMaxBatchPending) {
+        sBatchQueue->pending.fetch_sub(1, std::memory_order_relaxed);
+        std::string p = this->toString();
+        ALOGW("Batch full, dropping: %s", p.c_str());
+        return false;
+    }
+
+    BatchNode *node = new BatchNode;
+    node->item = dup();
+    node->next = sBatchQueue->head.load(std::memory_order_relaxed);
+    while (!sBatchQueue->head.compare_exchange_weak(node->next, node,
+            std::memory_order_release, std::memory_order_relaxed)) {
+    }
+
+    std::call_once(sBatchQueue->threadOnce, [] {
+        std::thread(&MediaAnalyticsItem::batchLoop).detach();
+    });
+    // taking the lock here means the flusher can't miss the wakeup
+    if (pending == 1 || pending == kBatchSize) {
+        std::lock_guard<std::mutex> l(sBatchQueue->lock);
+        sBatchQueue->condition.notify_one();
+    }
+    return true;
+}
+
+// static
+void MediaAnalyticsItem::batchLoop() {
+    std::unique_lock<std::mutex> l(sBatchQueue->lock);
+    while (true) {
+        sBatchQueue->condition.wait(l, [] {
+            return sBatchQueue->pending.load(std::memory_order_relaxed) > 0;
+        });
+        sBatchQueue->condition.wait_for(l, kBatchDelay, [] {
+            return sBatchQueue->pending.load(std::memory_order_relaxed) >= kBatchSize;
+        });
+        l.unlock();
+        flushBatch();
+        l.lock();
+    }
+}
+
+// static
+void MediaAnalyticsItem::flushBatch() {
+    BatchNode *node = sBatchQueue->head.exchange(nullptr, std::memory_order_acquire);
+    std::vector<MediaAnalyticsItem *> items;
+    while (node != nullptr) {
+        BatchNode *next = node->next;
+        items.push_back(node->item);
+        delete node;
+        node = next;
+    }
+    if (items.empty()) {
+        return;
+    }
+    sBatchQueue->pending.fetch_sub((int32_t) items.size(), std::memory_order_relaxed);
+    // the list is newest first
+    std::reverse(items.begin(), items.end());
+
+    sp<IMediaAnalyticsService> svc = getInstance();
+    if (svc != NULL) {
+        const size_t maxBatch = IMediaAnalyticsService::kMaxBatchSize;
+        for (size_t i = 0; i < items.size(); i += maxBatch) {
+            size_t end = std::min(items.size(), i + maxBatch);
+            svc->submitBatch(std::vector<MediaAnalyticsItem *>(
+                    items.begin() + i, items.begin() + end));
+        }
+    } else {
+        ALOGW("Unable to record %zu batched records", items.size());
+    }
+
+    for (MediaAnalyticsItem *item : items) {
+        delete item;
+    }
+}
+
 // get a connection we can reuse for most of our lifetime
 // static
 sp<IMediaAnalyticsService> MediaAnalyticsItem::sAnalyticsService;
@@ -22,6 +22,7 @@
 #include <binder/Parcel.h>
 
 #include <sys/types.h>
+#include <vector>
 #include <utils/Errors.h>
 #include <utils/Log.h>
 #include <utils/RefBase.h>
@@ -52,6 +53,14 @@ public:
     // caller continues to own the passed item
     virtual MediaAnalyticsItem::SessionID_t submit(MediaAnalyticsItem *item, bool forcenew) = 0;
 
+    // most records a single submitBatch() may carry
+    static const size_t kMaxBatchSize = 64;
+
+    // submit several complete records in one oneway call; nothing is
+    // returned, and records that fail validation are silently dropped.
+    // caller continues to own the passed items
+    virtual void submitBatch(const std::vector<MediaAnalyticsItem *> &items) = 0;
+
 };
 
 // ----------------------------------------------------------------------------
@@ -37,6 +37,7 @@ class Parcel;
 class MediaAnalyticsItem {
 
     friend class MediaAnalyticsService;
+    friend class MediaAnalyticsStore;
     friend class IMediaAnalyticsService;
     friend class MediaMetricsJNI;
     friend class MetricsSummarizer;
@@ -141,6 +142,13 @@ class MediaAnalyticsItem {
         bool selfrecord(bool);
         bool selfrecord();
 
+        // like selfrecord(), but queues a copy of the record and returns
+        // without a binder call. Queued records are sent to the service
+        // together, once enough have gathered or shortly after the first.
+        // Meant for components that submit often or from teardown paths.
+        // caller retains ownership of 'this'.
+        bool selfrecordBatched();
+
         // remove indicated attributes and their values
         // filterNot() could also be called keepOnly()
         // return value is # attributes removed
@@ -206,6 +214,10 @@ class MediaAnalyticsItem {
         static sp<IMediaAnalyticsService> getInstance();
         static void dropInstance();
 
+        // support for selfrecordBatched()
+        static void batchLoop();
+        static void flushBatch();
+
         // tracking information
         SessionID_t mSessionID;         // grouping similar records
         nsecs_t mTimestamp;             // ns, system_time_monotonic
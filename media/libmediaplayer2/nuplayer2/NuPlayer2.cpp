@@ -216,6 +216,7 @@ NuPlayer2::NuPlayer2(pid_t pid, uid_t uid, const sp<MediaClock> &mediaClock)
       mOffloadAudio(false),
       mAudioDecoderGeneration(0),
       mVideoDecoderGeneration(0),
+      mRendererFlags(0),
       mRendererGeneration(0),
       mLastStartedPlayingTimeNs(0),
       mPreviousSeekTimeUs(0),
@@ -225,6 +226,7 @@ NuPlayer2::NuPlayer2(pid_t pid, uid_t uid, const sp<MediaClock> &mediaClock)
       mScanSourcesGeneration(0),
       mPollDurationGeneration(0),
       mTimedTextGeneration(0),
+      mTimedTextCache(new TextDescriptionsCache),
       mFlushingAudio(NONE),
       mFlushingVideo(NONE),
       mResumePending(false),
@@ -853,6 +855,7 @@ void NuPlayer2::onMessageReceived(const sp<AMessage> &msg) {
                             && info->findInt32("type", &type)
                             && type == MEDIA_TRACK_TYPE_TIMEDTEXT) {
                         ++mTimedTextGeneration;
+                        mTimedTextCache->clear();
                     }
                 }
             } else {
@@ -1654,14 +1657,30 @@ void NuPlayer2::onStart() {
         flags |= Renderer::FLAG_OFFLOAD_AUDIO;
     }
 
-    sp<AMessage> notify = new AMessage(kWhatRendererNotify, this);
-    ++mRendererGeneration;
-    notify->setInt32("generation", mRendererGeneration);
-    mRenderer = new Renderer(mAudioSink, mMediaClock, notify, flags);
-    mRendererLooper = new ALooper;
-    mRendererLooper->setName("NuPlayerRenderer");
-    mRendererLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
-    mRendererLooper->registerHandler(mRenderer);
+    if (mRenderer != NULL && flags == mRendererFlags && !mOffloadAudio) {
+        // Moving on to the next data source. The renderer was flushed along with
+        // the decoders; keeping it also keeps the audio sink open, which is only
+        // reopened if the new decoder's PCM format differs.
+        ALOGV("onStart: reusing renderer");
+    } else {
+        if (mRendererLooper != NULL) {
+            if (mRenderer != NULL) {
+                mRendererLooper->unregisterHandler(mRenderer->id());
+            }
+            mRendererLooper->stop();
+            mRendererLooper.clear();
+        }
+
+        sp<AMessage> notify = new AMessage(kWhatRendererNotify, this);
+        ++mRendererGeneration;
+        notify->setInt32("generation", mRendererGeneration);
+        mRenderer = new Renderer(mAudioSink, mMediaClock, notify, flags);
+        mRendererFlags = flags;
+        mRendererLooper = new ALooper;
+        mRendererLooper->setName("NuPlayerRenderer");
+        mRendererLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
+        mRendererLooper->registerHandler(mRenderer);
+    }
 
     status_t err = mRenderer->setPlaybackSettings(mPlaybackSettings);
     if (err != OK) {
@@ -2286,7 +2305,13 @@ void NuPlayer2::getStats(Vector<sp<AMessage> > *mTrackStats) {
 
     mTrackStats->clear();
     if (mVideoDecoder != NULL) {
-        mTrackStats->push_back(mVideoDecoder->getStats());
+        sp<AMessage> videoStats = mVideoDecoder->getStats();
+        int64_t numJudderFrames;
+        if (mRenderer != NULL
+                && mRenderer->getNumJudderFrames(&numJudderFrames) == OK) {
+            videoStats->setInt64("frames-judder", numJudderFrames);
+        }
+        mTrackStats->push_back(videoStats);
     }
     if (mAudioDecoder != NULL) {
         mTrackStats->push_back(mAudioDecoder->getStats());
@@ -2455,8 +2480,6 @@ void NuPlayer2::performPlayNextDataSource() {
     ++mScanSourcesGeneration;
     mScanSourcesPending = false;
 
-    ++mRendererGeneration;
-
     if (mSource != NULL) {
         mSource->stop();
     }
@@ -2892,7 +2915,7 @@ void NuPlayer2::sendTimedTextData(const sp<ABuffer> &buffer) {
         } else {
             flag |= TextDescriptions::LOCAL_DESCRIPTIONS;
         }
-        TextDescriptions::getParcelOfDescriptions(
+        mTimedTextCache->getParcelOfDescriptions(
                 (const uint8_t *)data, size, flag, timeUs / 1000, &parcel);
     }
 
@@ -36,6 +36,7 @@ struct MediaClock;
 struct MediaHTTPService;
 class MetaData;
 struct NuPlayer2Driver;
+struct TextDescriptionsCache;
 
 struct NuPlayer2 : public AHandler {
     explicit NuPlayer2(pid_t pid, uid_t uid, const sp<MediaClock> &mediaClock);
@@ -171,6 +172,7 @@ private:
     sp<CCDecoder> mCCDecoder;
     sp<Renderer> mRenderer;
     sp<ALooper> mRendererLooper;
+    uint32_t mRendererFlags;
     int32_t mAudioDecoderGeneration;
     int32_t mVideoDecoderGeneration;
     int32_t mRendererGeneration;
@@ -196,6 +198,7 @@ private:
 
     int32_t mPollDurationGeneration;
     int32_t mTimedTextGeneration;
+    sp<TextDescriptionsCache> mTimedTextCache;
 
     enum FlushStatus {
         NONE,
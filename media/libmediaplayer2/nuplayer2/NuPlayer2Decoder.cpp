@@ -52,6 +52,11 @@ static float kDisplayRefreshingRate = 60.f; // TODO: get this from the display
 // the source.
 static float kDefaultVideoFrameRateTotal = 30.f;
 
+// Non-reference video frames are skipped before decode while the renderer is
+// more than kLateFrameDropStartUs behind, until it is within kLateFrameDropStopUs.
+static const int64_t kLateFrameDropStartUs = 100000ll;
+static const int64_t kLateFrameDropStopUs = 40000ll;
+
 static inline bool getAudioDeepBufferSetting() {
     return property_get_bool("media.stagefright.audio.deep", false /* default_value */);
 }
@@ -75,10 +80,14 @@ NuPlayer2::Decoder::Decoder(
       mNumFramesTotal(0ll),
       mNumInputFramesDropped(0ll),
       mNumOutputFramesDropped(0ll),
+      mNumLateFramesDropped(0ll),
       mVideoWidth(0),
       mVideoHeight(0),
       mIsAudio(true),
       mIsVideoAVC(false),
+      mIsVideoHEVC(false),
+      mDroppingLateFrames(false),
+      mMaxVideoTemporalId(0),
       mIsSecure(false),
       mIsEncrypted(false),
       mIsEncryptedObservedEarlier(false),
@@ -107,6 +116,7 @@ sp<AMessage> NuPlayer2::Decoder::getStats() const {
     mStats->setInt64("frames-total", mNumFramesTotal);
     mStats->setInt64("frames-dropped-input", mNumInputFramesDropped);
     mStats->setInt64("frames-dropped-output", mNumOutputFramesDropped);
+    mStats->setInt64("frames-dropped-late", mNumLateFramesDropped);
     return mStats;
 }
 
@@ -298,6 +308,9 @@ void NuPlayer2::Decoder::onConfigure(const sp<AMessage> &format) {
 
     mIsAudio = !strncasecmp("audio/", mime.c_str(), 6);
     mIsVideoAVC = !strcasecmp(MEDIA_MIMETYPE_VIDEO_AVC, mime.c_str());
+    mIsVideoHEVC = !strcasecmp(MEDIA_MIMETYPE_VIDEO_HEVC, mime.c_str());
+    mDroppingLateFrames = false;
+    mMaxVideoTemporalId = 0;
 
     mComponentName = mime;
     mComponentName.append(" decoder");
@@ -515,6 +528,7 @@ void NuPlayer2::Decoder::doFlush(bool notifyComplete) {
     }
     releaseAndResetMediaBuffers();
     mPaused = true;
+    mDroppingLateFrames = false;
 }
 
 
@@ -869,6 +883,35 @@ void NuPlayer2::Decoder::releaseAndResetMediaBuffers() {
     mSkipRenderingUntilMediaTimeUs = -1;
 }
 
+bool NuPlayer2::Decoder::shouldDropLateFrame(const sp<ABuffer> &accessUnit) {
+    // Start skipping non-reference frames ahead of the codec once the renderer
+    // falls well behind, and keep skipping them until it has nearly caught up,
+    // so that decode time goes to the frames that will still be shown.
+    int64_t lateByUs = mRenderer->getVideoLateByUs();
+    if (!mDroppingLateFrames && lateByUs > kLateFrameDropStartUs) {
+        ALOGV("[%s] video late by %lld us, dropping non-reference frames",
+                mComponentName.c_str(), (long long)lateByUs);
+        mDroppingLateFrames = true;
+    } else if (mDroppingLateFrames && lateByUs < kLateFrameDropStopUs) {
+        ALOGV("[%s] video caught up, %lld late frames dropped so far",
+                mComponentName.c_str(), (long long)mNumLateFramesDropped);
+        mDroppingLateFrames = false;
+    }
+
+    if (mIsVideoHEVC) {
+        // A sub-layer non-reference picture may still be referenced by higher
+        // sub-layers, so only skip those of the highest sub-layer seen.
+        unsigned temporalId = 0;
+        bool isReference = IsHEVCReferenceFrame(accessUnit, &temporalId);
+        if (temporalId > mMaxVideoTemporalId) {
+            mMaxVideoTemporalId = temporalId;
+        }
+        return mDroppingLateFrames && !isReference && temporalId == mMaxVideoTemporalId;
+    }
+
+    return mDroppingLateFrames && mIsVideoAVC && !IsAVCReferenceFrame(accessUnit);
+}
+
 bool NuPlayer2::Decoder::isStaleReply(const sp<AMessage> &msg) {
     int32_t generation;
     CHECK(msg->findInt32("generation", &generation));
@@ -952,10 +995,9 @@ status_t NuPlayer2::Decoder::fetchInputData(sp<AMessage> &reply) {
 
             int32_t layerId = 0;
             bool haveLayerId = accessUnit->meta()->findInt32("temporal-layer-id", &layerId);
-            if (mRenderer->getVideoLateByUs() > 100000ll
-                    && mIsVideoAVC
-                    && !IsAVCReferenceFrame(accessUnit)) {
+            if (shouldDropLateFrame(accessUnit)) {
                 dropAccessUnit = true;
+                ++mNumLateFramesDropped;
             } else if (haveLayerId && mNumVideoTemporalLayerTotal > 1) {
                 // Add only one layer each time.
                 if (layerId > mCurrentMaxVideoTemporalLayerId + 1
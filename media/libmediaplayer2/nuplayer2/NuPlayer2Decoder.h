@@ -95,10 +95,14 @@ private:
     int64_t mNumFramesTotal;
     int64_t mNumInputFramesDropped;
     int64_t mNumOutputFramesDropped;
+    int64_t mNumLateFramesDropped;
     int32_t mVideoWidth;
     int32_t mVideoHeight;
     bool mIsAudio;
     bool mIsVideoAVC;
+    bool mIsVideoHEVC;
+    bool mDroppingLateFrames;
+    unsigned mMaxVideoTemporalId;
     bool mIsSecure;
     bool mIsEncrypted;
     bool mIsEncryptedObservedEarlier;
@@ -126,6 +130,7 @@ private:
 
     void releaseAndResetMediaBuffers();
     bool isStaleReply(const sp<AMessage> &msg);
+    bool shouldDropLateFrame(const sp<ABuffer> &accessUnit);
 
     void doFlush(bool notifyComplete);
     status_t fetchInputData(sp<AMessage> &reply);
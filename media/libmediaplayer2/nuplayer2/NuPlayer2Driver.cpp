@@ -99,6 +99,8 @@ static const char *kPlayerErrorCode = "android.media.mediaplayer.errcode";
 // NB: These are not yet exposed as public Java API constants.
 static const char *kPlayerErrorState = "android.media.mediaplayer.errstate";
 static const char *kPlayerDataSourceType = "android.media.mediaplayer.dataSource";
+static const char *kPlayerFramesJudder = "android.media.mediaplayer.judder";
+static const char *kPlayerFramesDroppedLate = "android.media.mediaplayer.droppedLate";
 //
 static const char *kPlayerRebuffering = "android.media.mediaplayer.rebufferingMs";
 static const char *kPlayerRebufferingCount = "android.media.mediaplayer.rebuffers";
@@ -516,6 +518,16 @@ void NuPlayer2Driver::updateMetrics(const char *where) {
                 mAnalyticsItem->setInt64(kPlayerFrames, numFramesTotal);
                 mAnalyticsItem->setInt64(kPlayerFramesDropped, numFramesDropped);
 
+                int64_t numFramesDroppedLate;
+                if (stats->findInt64("frames-dropped-late", &numFramesDroppedLate)) {
+                    mAnalyticsItem->setInt64(kPlayerFramesDroppedLate, numFramesDroppedLate);
+                }
+
+                int64_t numFramesJudder;
+                if (stats->findInt64("frames-judder", &numFramesJudder)) {
+                    mAnalyticsItem->setInt64(kPlayerFramesJudder, numFramesJudder);
+                }
+
 
             } else if (mime.startsWith("audio/")) {
                 mAnalyticsItem->setCString(kPlayerAMime, mime.c_str());
@@ -562,7 +574,7 @@ void NuPlayer2Driver::logMetrics(const char *where) {
     // So the canonical "empty" record has 3 elements in it.
     if (mAnalyticsItem->count() > 3) {
 
-        mAnalyticsItem->selfrecord();
+        mAnalyticsItem->selfrecordBatched();
 
         // re-init in case we prepare() and start() again.
         delete mAnalyticsItem ;
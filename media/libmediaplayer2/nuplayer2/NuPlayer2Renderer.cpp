@@ -285,6 +285,19 @@ status_t NuPlayer2::Renderer::onGetSyncSettings(
     return OK;
 }
 
+status_t NuPlayer2::Renderer::getNumJudderFrames(int64_t *numJudderFrames) {
+    sp<AMessage> msg = new AMessage(kWhatGetJudderFrames, this);
+    sp<AMessage> response;
+    status_t err = msg->postAndAwaitResponse(&response);
+    if (err == OK && response != NULL) {
+        CHECK(response->findInt32("err", &err));
+        if (err == OK) {
+            CHECK(response->findInt64("judder-frames", numJudderFrames));
+        }
+    }
+    return err;
+}
+
 void NuPlayer2::Renderer::flush(bool audio, bool notifyComplete) {
     {
         Mutex::Autolock autoLock(mLock);
@@ -692,6 +705,22 @@ void NuPlayer2::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatGetJudderFrames:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            sp<AMessage> response = new AMessage;
+            if (mVideoScheduler != NULL) {
+                response->setInt64("judder-frames", mVideoScheduler->getNumJudderFrames());
+                response->setInt32("err", OK);
+            } else {
+                response->setInt32("err", NO_INIT);
+            }
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatFlush:
         {
             onFlush(msg);
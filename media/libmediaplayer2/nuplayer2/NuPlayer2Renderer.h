@@ -57,6 +57,9 @@ struct NuPlayer2::Renderer : public AHandler {
     status_t setSyncSettings(const AVSyncSettings &sync, float videoFpsHint);
     status_t getSyncSettings(AVSyncSettings *sync /* nonnull */, float *videoFps /* nonnull */);
 
+    // returns the number of video frames that were held off their cadence
+    status_t getNumJudderFrames(int64_t *numJudderFrames /* nonnull */);
+
     void flush(bool audio, bool notifyComplete);
 
     void signalTimeDiscontinuity();
@@ -132,6 +135,7 @@ private:
         kWhatDisableOffloadAudio = 'noOA',
         kWhatEnableOffloadAudio  = 'enOA',
         kWhatSetVideoFrameRate   = 'sVFR',
+        kWhatGetJudderFrames     = 'gJdF',
     };
 
     // if mBuffer != nullptr, it's a buffer containing real data.
@@ -597,19 +597,10 @@ void NuPlayer2::RTSPSource2::onMessageReceived(const sp<AMessage> &msg) {
             }
 
             if (mTSParser != NULL) {
-                size_t offset = 0;
-                status_t err = OK;
-                while (offset + 188 <= accessUnit->size()) {
-                    err = mTSParser->feedTSPacket(
-                            accessUnit->data() + offset, 188);
-                    if (err != OK) {
-                        break;
-                    }
-
-                    offset += 188;
-                }
+                status_t err = mTSParser->feedTSPackets(
+                        accessUnit->data(), accessUnit->size());
 
-                if (offset < accessUnit->size()) {
+                if (err != OK || accessUnit->size() % 188 != 0) {
                     err = ERROR_MALFORMED;
                 }
 
@@ -69,6 +69,11 @@ static const float kTypicalDisplayRefreshingRate = 60.f;
 static const float kMinTypicalDisplayRefreshingRate = kTypicalDisplayRefreshingRate / 2;
 static const int kMaxNumVideoTemporalLayers = 8;
 
+// Whether camera recording frames may be sent straight to the encoder's input surface.
+static inline bool getCameraToEncoderSurfaceSetting() {
+    return property_get_bool("media.stagefright.camera-direct-surface", false);
+}
+
 // key for media statistics
 static const char *kKeyRecorder = "recorder";
 // attrs for media statistics
@@ -118,6 +123,7 @@ StagefrightRecorder::StagefrightRecorder(const String16 &opPackageName)
       mOutputFd(-1),
       mAudioSource((audio_source_t)AUDIO_SOURCE_CNT), // initialize with invalid value
       mVideoSource(VIDEO_SOURCE_LIST_END),
+      mCameraToEncoderSurface(false),
       mStarted(false),
       mSelectedDeviceId(AUDIO_PORT_HANDLE_NONE),
       mDeviceCallbackEnabled(false) {
@@ -620,6 +626,25 @@ status_t StagefrightRecorder::setParamInterleaveDuration(int32_t durationUs) {
     return OK;
 }
 
+status_t StagefrightRecorder::setParamFragmentDuration(int64_t durationUs) {
+    ALOGV("setParamFragmentDuration: %lld us", (long long)durationUs);
+    if (durationUs < 0) {
+        ALOGE("Fragment duration is negative: %lld us", (long long)durationUs);
+        return BAD_VALUE;
+    } else if (durationUs > 0 && durationUs < 500000) {  // 500 ms
+        // The moof overhead would count for a significant portion of the
+        // saved contents
+        ALOGE("Fragment duration is too small: %lld us", (long long)durationUs);
+        return BAD_VALUE;
+    } else if (durationUs > 10000000) {  // 10 seconds
+        // A whole fragment is kept in memory before being written out
+        ALOGE("Fragment duration is too large: %lld us", (long long)durationUs);
+        return BAD_VALUE;
+    }
+    mFragmentDurationUs = durationUs;
+    return OK;
+}
+
 // If seconds <  0, only the first frame is I frame, and rest are all P frames
 // If seconds == 0, all frames are encoded as I frames. No P frames
 // If seconds >  0, it is the time spacing (seconds) between 2 neighboring I frames
@@ -773,6 +798,11 @@ status_t StagefrightRecorder::setParameter(
         if (safe_strtoi32(value.string(), &durationUs)) {
             return setParamInterleaveDuration(durationUs);
         }
+    } else if (key == "fragment-duration-us") {
+        int64_t durationUs;
+        if (safe_strtoi64(value.string(), &durationUs)) {
+            return setParamFragmentDuration(durationUs);
+        }
     } else if (key == "param-movie-time-scale") {
         int32_t timeScale;
         if (safe_strtoi32(value.string(), &timeScale)) {
@@ -1013,6 +1043,14 @@ status_t StagefrightRecorder::start() {
             sp<MetaData> meta = new MetaData;
             setupMPEG4orWEBMMetaData(&meta);
             status = mWriter->start(meta.get());
+            if (status == OK && mCameraToEncoderSurface) {
+                // the encoder does not pull from the camera in this mode
+                status = mCameraSource->start(meta.get());
+                if (status != OK) {
+                    ALOGE("Failed to start camera for encoder surface: %d", status);
+                    mWriter->stop();
+                }
+            }
             break;
         }
 
@@ -1706,7 +1744,27 @@ status_t StagefrightRecorder::setupVideoEncoder(
         }
     }
 
-    if (cameraSource != NULL) {
+    // Let the camera render into the encoder's input surface if it delivers frames through a
+    // buffer queue anyway. This skips the per-frame metadata wrapping and buffer hand-off in
+    // CameraSource. Time lapse needs CameraSource to pick the frames, so it is excluded.
+    bool cameraToEncoderSurface = cameraSource != NULL
+            && cameraSource.get() == mCameraSource.get()
+            && mMetaDataStoredInVideoBuffers == kMetadataBufferTypeANWBuffer
+            && getCameraToEncoderSurfaceSetting();
+
+    if (cameraToEncoderSurface) {
+        sp<MetaData> meta = cameraSource->getFormat();
+
+        int32_t width, height;
+        CHECK(meta->findInt32(kKeyWidth, &width));
+        CHECK(meta->findInt32(kKeyHeight, &height));
+
+        format->setInt32("width", width);
+        format->setInt32("height", height);
+        format->setInt32("stride", width);
+        format->setInt32("slice-height", height);
+        format->setInt32("color-format", OMX_COLOR_FormatAndroidOpaque);
+    } else if (cameraSource != NULL) {
         sp<MetaData> meta = cameraSource->getFormat();
 
         int32_t width, height, stride, sliceHeight, colorFormat;
@@ -1795,7 +1853,7 @@ status_t StagefrightRecorder::setupVideoEncoder(
         format->setInt32("android._prefer-b-frames", preferBFrames);
     }
 
-    if (mMetaDataStoredInVideoBuffers != kMetadataBufferTypeInvalid) {
+    if (mMetaDataStoredInVideoBuffers != kMetadataBufferTypeInvalid && !cameraToEncoderSurface) {
         format->setInt32("android._input-metadata-buffer-type", mMetaDataStoredInVideoBuffers);
     }
 
@@ -1805,15 +1863,21 @@ status_t StagefrightRecorder::setupVideoEncoder(
     }
 
     uint32_t flags = 0;
-    if (cameraSource == NULL) {
+    if (cameraSource == NULL || cameraToEncoderSurface) {
         flags |= MediaCodecSource::FLAG_USE_SURFACE_INPUT;
     } else {
         // require dataspace setup even if not using surface input
         format->setInt32("android._using-recorder", 1);
     }
 
+    if (mOutputFormat == OUTPUT_FORMAT_RTP_AVP || mOutputFormat == OUTPUT_FORMAT_MPEG2TS) {
+        // streaming outputs: let the encoder back off when the network can't keep up
+        flags |= MediaCodecSource::FLAG_ADAPTIVE_BITRATE;
+    }
+
     sp<MediaCodecSource> encoder = MediaCodecSource::Create(
-            mLooper, format, cameraSource, mPersistentSurface, flags);
+            mLooper, format, cameraToEncoderSurface ? sp<MediaSource>() : cameraSource,
+            cameraToEncoderSurface ? sp<PersistentSurface>() : mPersistentSurface, flags);
     if (encoder == NULL) {
         ALOGE("Failed to create video encoder");
         // When the encoder fails to be created, we need
@@ -1825,9 +1889,18 @@ status_t StagefrightRecorder::setupVideoEncoder(
         return UNKNOWN_ERROR;
     }
 
-    if (cameraSource == NULL) {
+    if (cameraToEncoderSurface) {
+        status_t err = mCameraSource->setEncoderInputSurface(encoder->getGraphicBufferProducer());
+        if (err != OK) {
+            ALOGE("Failed to route camera to encoder input surface: %d", err);
+            cameraSource->stop();
+            return err;
+        }
+        ALOGI("Camera renders directly to the video encoder input surface");
+    } else if (cameraSource == NULL) {
         mGraphicBufferProducer = encoder->getGraphicBufferProducer();
     }
+    mCameraToEncoderSurface = cameraToEncoderSurface;
 
     *source = encoder;
 
@@ -1918,6 +1991,9 @@ status_t StagefrightRecorder::setupMPEG4orWEBMRecording() {
         if (mInterleaveDurationUs > 0) {
             mp4writer->setInterleaveDuration(mInterleaveDurationUs);
         }
+        if (mFragmentDurationUs > 0) {
+            mp4writer->setFragmentDuration(mFragmentDurationUs);
+        }
         if (mLongitudex10000 > -3600000 && mLatitudex10000 > -3600000) {
             mp4writer->setGeoData(mLatitudex10000, mLongitudex10000);
         }
@@ -2089,6 +2165,10 @@ status_t StagefrightRecorder::stop() {
         mWriter.clear();
     }
 
+    if (mCameraToEncoderSurface && mCameraSource != NULL) {
+        mCameraSource->stop();
+    }
+
     // account for the last 'segment' -- whether paused or recording
     if (mPauseStartTimeUs != 0) {
         // we were paused
@@ -2166,6 +2246,7 @@ status_t StagefrightRecorder::reset() {
     mAudioChannels = 1;
     mAudioBitRate  = 12200;
     mInterleaveDurationUs = 0;
+    mFragmentDurationUs = 0;
     mIFramesIntervalSec = 1;
     mAudioSourceNode = 0;
     mUse64BitFileOffset = false;
@@ -2198,6 +2279,7 @@ status_t StagefrightRecorder::reset() {
     mOutputFd = -1;
 
     mCameraSource = NULL;
+    mCameraToEncoderSurface = false;
 
     return OK;
 }
@@ -2311,6 +2393,8 @@ status_t StagefrightRecorder::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     Interleave duration (us): %d\n", mInterleaveDurationUs);
     result.append(buffer);
+    snprintf(buffer, SIZE, "     Fragment duration (us): %" PRId64 "\n", mFragmentDurationUs);
+    result.append(buffer);
     snprintf(buffer, SIZE, "     Progress notification: %" PRId64 " us\n", mTrackEveryTimeDurationUs);
     result.append(buffer);
     snprintf(buffer, SIZE, "   Audio\n");
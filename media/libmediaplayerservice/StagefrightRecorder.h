@@ -112,6 +112,7 @@ protected:
     int32_t mAudioChannels;
     int32_t mSampleRate;
     int32_t mInterleaveDurationUs;
+    int64_t mFragmentDurationUs;
     int32_t mIFramesIntervalSec;
     int32_t mCameraId;
     int32_t mVideoEncoderProfile;
@@ -138,6 +139,9 @@ protected:
     int64_t mTimeBetweenCaptureUs;
     sp<CameraSourceTimeLapse> mCameraSourceTimeLapse;
     sp<CameraSource> mCameraSource;
+    // True if mCameraSource renders into the video encoder's input surface, in
+    // which case the recorder starts and stops the camera itself.
+    bool mCameraToEncoderSurface;
     String8 mParams;
 
     MetadataBufferType mMetaDataStoredInVideoBuffers;
@@ -200,6 +204,7 @@ protected:
     status_t setParamVideoRotation(int32_t degrees);
     status_t setParamTrackTimeStatus(int64_t timeDurationUs);
     status_t setParamInterleaveDuration(int32_t durationUs);
+    status_t setParamFragmentDuration(int64_t durationUs);
     status_t setParam64BitFileOffset(bool use64BitFileOffset);
     status_t setParamMaxFileDurationUs(int64_t timeUs);
     status_t setParamMaxFileSizeBytes(int64_t bytes);
@@ -51,6 +51,12 @@ static const int kInitialMarkMs        = 5000;  // 5secs
 //static const int kPausePlaybackMarkMs  = 2000;  // 2secs
 static const int kResumePlaybackMarkMs = 15000;  // 15secs
 
+// Local playback keeps each of the audio and video tracks read ahead up to
+// kReadAheadMarkUs or kMaxReadAheadBytes, whichever comes first, and resumes
+// reading once less than half of kReadAheadMarkUs is left.
+static const int64_t kReadAheadMarkUs = 2000000ll;  // 2secs
+static const size_t kMaxReadAheadBytes = 16 * 1024 * 1024;
+
 NuPlayer::GenericSource::GenericSource(
         const sp<AMessage> &notify,
         bool uidValid,
@@ -338,6 +344,8 @@ bool NuPlayer::GenericSource::isStreaming() const {
 
 NuPlayer::GenericSource::~GenericSource() {
     ALOGV("~GenericSource");
+    stopReader(&mAudioTrack);
+    stopReader(&mVideoTrack);
     if (mLooper != NULL) {
         mLooper->unregisterHandler(id());
         mLooper->stop();
@@ -345,6 +353,25 @@ NuPlayer::GenericSource::~GenericSource() {
     resetDataSource();
 }
 
+void NuPlayer::GenericSource::startReader(Track *track, const char *name) {
+    if (track->mReadLooper != NULL) {
+        return;
+    }
+    track->mReadLooper = new ALooper;
+    track->mReadLooper->setName(name);
+    track->mReadLooper->start();
+
+    track->mReader = new AHandlerReflector<GenericSource>(this);
+    track->mReadLooper->registerHandler(track->mReader);
+}
+
+void NuPlayer::GenericSource::stopReader(Track *track) {
+    if (track->mReadLooper != NULL) {
+        track->mReadLooper->unregisterHandler(track->mReader->id());
+        track->mReadLooper->stop();
+    }
+}
+
 void NuPlayer::GenericSource::prepareAsync() {
     Mutex::Autolock _l(mLock);
     ALOGV("prepareAsync: (looper: %d)", (mLooper != NULL));
@@ -355,6 +382,9 @@ void NuPlayer::GenericSource::prepareAsync() {
         mLooper->start();
 
         mLooper->registerHandler(this);
+
+        startReader(&mAudioTrack, "generic-audio");
+        startReader(&mVideoTrack, "generic-video");
     }
 
     sp<AMessage> msg = new AMessage(kWhatPrepareAsync, this);
@@ -853,7 +883,9 @@ status_t NuPlayer::GenericSource::dequeueAccessUnit(
     // start pulling in more buffers if cache is running low
     // so that decoder has less chance of being starved
     if (!mIsStreaming) {
-        if (track->mPackets->getAvailableBufferCount(&finalResult) < 2) {
+        if (track->mPackets->getAvailableBufferCount(&finalResult) < 2
+                || track->mPackets->getBufferedDurationUs(&finalResult)
+                        < kReadAheadMarkUs / 2) {
             postReadBuffer(audio? MEDIA_TRACK_TYPE_AUDIO : MEDIA_TRACK_TYPE_VIDEO);
         }
     } else {
@@ -1293,7 +1325,13 @@ int32_t NuPlayer::GenericSource::getDataGeneration(media_track_type type) const
 void NuPlayer::GenericSource::postReadBuffer(media_track_type trackType) {
     if ((mPendingReadBufferTypes & (1 << trackType)) == 0) {
         mPendingReadBufferTypes |= (1 << trackType);
-        sp<AMessage> msg = new AMessage(kWhatReadBuffer, this);
+        sp<AHandler> reader = this;
+        if (trackType == MEDIA_TRACK_TYPE_AUDIO && mAudioTrack.mReader != NULL) {
+            reader = mAudioTrack.mReader;
+        } else if (trackType == MEDIA_TRACK_TYPE_VIDEO && mVideoTrack.mReader != NULL) {
+            reader = mVideoTrack.mReader;
+        }
+        sp<AMessage> msg = new AMessage(kWhatReadBuffer, reader);
         msg->setInt32("trackType", trackType);
         msg->post();
     }
@@ -1337,6 +1375,11 @@ void NuPlayer::GenericSource::readBuffer(
             TRESPASS();
     }
 
+    // Keep to the lock order, mReadLock before mLock.
+    mLock.unlock();
+    Mutex::Autolock _rl(track->mReadLock);
+    mLock.lock();
+
     if (track->mSource == NULL) {
         return;
     }
@@ -1360,7 +1403,8 @@ void NuPlayer::GenericSource::readBuffer(
     }
 
     int32_t generation = getDataGeneration(trackType);
-    for (size_t numBuffers = 0; numBuffers < maxBuffers; ) {
+    size_t numBuffers = 0;
+    while (numBuffers < maxBuffers) {
         Vector<MediaBufferBase *> mediaBuffers;
         status_t err = NO_ERROR;
 
@@ -1483,6 +1527,15 @@ void NuPlayer::GenericSource::readBuffer(
         }
 
         postReadBuffer(trackType);
+    } else if (numBuffers > 0 && generation == getDataGeneration(trackType)
+        && (trackType == MEDIA_TRACK_TYPE_VIDEO || trackType == MEDIA_TRACK_TYPE_AUDIO)) {
+        // keep reading ahead on this track's looper until the watermark
+        status_t finalResult;
+        int64_t durationUs = track->mPackets->getBufferedDurationUs(&finalResult);
+        if (finalResult == OK && durationUs < kReadAheadMarkUs
+                && track->mPackets->getBufferedBytes() < kMaxReadAheadBytes) {
+            postReadBuffer(trackType);
+        }
     }
 }
 
@@ -25,6 +25,7 @@
 
 #include <media/mediaplayer.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/foundation/AHandlerReflector.h>
 
 namespace android {
 
@@ -122,6 +123,13 @@ private:
         size_t mIndex;
         sp<IMediaSource> mSource;
         sp<AnotherPacketSource> mPackets;
+
+        // Audio and video are read ahead on their own loopers, so that a slow
+        // read of one track does not hold up the other. mReadLock serializes
+        // the reads of mSource, and is always acquired before mLock.
+        Mutex mReadLock;
+        sp<ALooper> mReadLooper;
+        sp<AHandlerReflector<GenericSource> > mReader;
     };
 
     Vector<sp<IMediaSource> > mSources;
@@ -174,6 +182,9 @@ private:
 
     sp<ALooper> mLooper;
 
+    void startReader(Track *track, const char *name);
+    void stopReader(Track *track);
+
     void resetDataSource();
 
     status_t initFromDataSource();
@@ -239,6 +250,8 @@ private:
 
     status_t checkDrmInfo();
 
+    friend struct AHandlerReflector<GenericSource>;
+
     DISALLOW_EVIL_CONSTRUCTORS(GenericSource);
 };
 
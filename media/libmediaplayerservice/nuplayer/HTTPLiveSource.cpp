@@ -184,6 +184,19 @@ sp<AMessage> NuPlayer::HTTPLiveSource::getTrackInfo(size_t trackIndex) const {
     return mLiveSession->getTrackInfo(trackIndex);
 }
 
+sp<AMessage> NuPlayer::HTTPLiveSource::getStats() const {
+    if (mLiveSession == NULL) {
+        return NULL;
+    }
+
+    AString trace;
+    mLiveSession->dumpAbrTrace(&trace);
+
+    sp<AMessage> stats = new AMessage;
+    stats->setString("abr-trace", trace);
+    return stats;
+}
+
 ssize_t NuPlayer::HTTPLiveSource::getSelectedTrack(media_track_type type) const {
     if (mLiveSession == NULL) {
         return -1;
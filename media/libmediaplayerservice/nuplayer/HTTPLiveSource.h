@@ -54,6 +54,7 @@ struct NuPlayer::HTTPLiveSource : public NuPlayer::Source {
     virtual status_t seekTo(
             int64_t seekTimeUs,
             MediaPlayerSeekMode mode = MediaPlayerSeekMode::SEEK_PREVIOUS_SYNC) override;
+    virtual sp<AMessage> getStats() const override;
 
 protected:
     virtual ~HTTPLiveSource();
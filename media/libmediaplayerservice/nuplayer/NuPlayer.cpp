@@ -65,6 +65,10 @@
 
 namespace android {
 
+static inline bool getFastStartSetting() {
+    return property_get_bool("media.stagefright.fast-start", false /* default_value */);
+}
+
 struct NuPlayer::Action : public RefBase {
     Action() {}
 
@@ -211,12 +215,15 @@ NuPlayer::NuPlayer(pid_t pid, const sp<MediaClock> &mediaClock)
       mScanSourcesGeneration(0),
       mPollDurationGeneration(0),
       mTimedTextGeneration(0),
+      mTimedTextCache(new TextDescriptionsCache),
       mFlushingAudio(NONE),
       mFlushingVideo(NONE),
       mResumePending(false),
       mVideoScalingMode(NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW),
       mPlaybackSettings(AUDIO_PLAYBACK_RATE_DEFAULT),
       mVideoFpsHint(-1.f),
+      mCommonTimeAnchorUs(-1),
+      mCommonTimeAnchorMediaUs(-1),
       mStarted(false),
       mPrepared(false),
       mResetting(false),
@@ -460,6 +467,13 @@ status_t NuPlayer::setSyncSettings(const AVSyncSettings &sync, float videoFpsHin
     return err;
 }
 
+void NuPlayer::setCommonTimeAnchor(int64_t commonTimeUs, int64_t mediaTimeUs) {
+    sp<AMessage> msg = new AMessage(kWhatSetCommonTimeAnchor, this);
+    msg->setInt64("commonTimeUs", commonTimeUs);
+    msg->setInt64("mediaTimeUs", mediaTimeUs);
+    msg->post();
+}
+
 status_t NuPlayer::getSyncSettings(
         AVSyncSettings *sync /* nonnull */, float *videoFps /* nonnull */) {
     sp<AMessage> msg = new AMessage(kWhatGetSyncSettings, this);
@@ -735,6 +749,7 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
                             && info->findInt32("type", &type)
                             && type == MEDIA_TRACK_TYPE_TIMEDTEXT) {
                         ++mTimedTextGeneration;
+                        mTimedTextCache->clear();
                     }
                 }
             } else {
@@ -978,6 +993,18 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetCommonTimeAnchor:
+        {
+            CHECK(msg->findInt64("commonTimeUs", &mCommonTimeAnchorUs));
+            CHECK(msg->findInt64("mediaTimeUs", &mCommonTimeAnchorMediaUs));
+            ALOGV("kWhatSetCommonTimeAnchor %lld -> %lld",
+                    (long long)mCommonTimeAnchorMediaUs, (long long)mCommonTimeAnchorUs);
+            if (mRenderer != NULL) {
+                mRenderer->setCommonTimeAnchor(mCommonTimeAnchorUs, mCommonTimeAnchorMediaUs);
+            }
+            break;
+        }
+
         case kWhatGetSyncSettings:
         {
             sp<AReplyToken> replyID;
@@ -1507,11 +1534,23 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
 
             trackStats->clear();
             if (mVideoDecoder != NULL) {
-                trackStats->push_back(mVideoDecoder->getStats());
+                sp<AMessage> videoStats = mVideoDecoder->getStats();
+                int64_t numJudderFrames;
+                if (mRenderer != NULL
+                        && mRenderer->getNumJudderFrames(&numJudderFrames) == OK) {
+                    videoStats->setInt64("frames-judder", numJudderFrames);
+                }
+                trackStats->push_back(videoStats);
             }
             if (mAudioDecoder != NULL) {
                 trackStats->push_back(mAudioDecoder->getStats());
             }
+            if (mSource != NULL) {
+                sp<AMessage> sourceStats = mSource->getStats();
+                if (sourceStats != NULL) {
+                    trackStats->push_back(sourceStats);
+                }
+            }
 
             // respond for synchronization
             sp<AMessage> response = new AMessage;
@@ -1636,6 +1675,12 @@ void NuPlayer::onStart(int64_t startPositionUs, MediaPlayerSeekMode mode) {
         ALOGV("onStart: Disabling mOffloadAudio now that the source is protected.");
     }
 
+    if (mOffloadAudio && mAudioDecoder != NULL) {
+        // An audio decoder instantiated ahead of start decodes to PCM; keep it.
+        ALOGV("onStart: Disabling mOffloadAudio for the audio decoder instantiated earlier.");
+        mOffloadAudio = false;
+    }
+
     if (mOffloadAudio) {
         flags |= Renderer::FLAG_OFFLOAD_AUDIO;
     }
@@ -1662,6 +1707,10 @@ void NuPlayer::onStart(int64_t startPositionUs, MediaPlayerSeekMode mode) {
         mRenderer->setVideoFrameRate(rate);
     }
 
+    if (mCommonTimeAnchorUs >= 0) {
+        mRenderer->setCommonTimeAnchor(mCommonTimeAnchorUs, mCommonTimeAnchorMediaUs);
+    }
+
     if (mVideoDecoder != NULL) {
         mVideoDecoder->setRenderer(mRenderer);
     }
@@ -1957,6 +2006,33 @@ void NuPlayer::determineAudioModeChange(const sp<AMessage> &audioFormat) {
     }
 }
 
+void NuPlayer::instantiateDecodersForFastStart() {
+    // Allocate and configure the codecs while the client is still between
+    // prepare and start, instead of on the first source scan after start.
+    // Without a renderer the decoders run until they hold all of their
+    // output; it is handed to the renderer created in onStart(), so the first
+    // video frame is up as soon as playback starts.
+    if (mSurface != NULL && mVideoDecoder == NULL) {
+        status_t err = instantiateDecoder(false /* audio */, &mVideoDecoder);
+        ALOGV_IF(err != OK, "fast start: no video decoder yet (%d)", err);
+    }
+
+    if (mAudioSink != NULL && mAudioDecoder == NULL) {
+        sp<MetaData> audioMeta = mSource->getFormatMeta(true /* audio */);
+        bool hasVideo = (mSource->getFormat(false /* audio */) != NULL);
+        // Offloaded audio needs a pass-through decoder feeding the renderer,
+        // which is left to onStart().
+        if (audioMeta != NULL
+                && !canOffloadStream(audioMeta, hasVideo, mSource->isStreaming(),
+                        mAudioSink->getAudioStreamType())) {
+            mOffloadAudio = false;
+            status_t err = instantiateDecoder(
+                    true /* audio */, &mAudioDecoder, false /* checkAudioModeChange */);
+            ALOGV_IF(err != OK, "fast start: no audio decoder yet (%d)", err);
+        }
+    }
+}
+
 status_t NuPlayer::instantiateDecoder(
         bool audio, sp<DecoderBase> *decoder, bool checkAudioModeChange) {
     // The audio decoder could be cleared by tear down. If still in shut down
@@ -2572,6 +2648,9 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
                 processDeferredActions();
             } else {
                 mPrepared = true;
+                if (getFastStartSetting()) {
+                    instantiateDecodersForFastStart();
+                }
             }
 
             sp<NuPlayerDriver> driver = mDriver.promote();
@@ -2873,7 +2952,7 @@ void NuPlayer::sendTimedTextData(const sp<ABuffer> &buffer) {
         } else {
             flag |= TextDescriptions::LOCAL_DESCRIPTIONS;
         }
-        TextDescriptions::getParcelOfDescriptions(
+        mTimedTextCache->getParcelOfDescriptions(
                 (const uint8_t *)data, size, flag, timeUs / 1000, &parcel);
     }
 
@@ -33,6 +33,7 @@ class IDataSource;
 struct MediaClock;
 class MetaData;
 struct NuPlayerDriver;
+struct TextDescriptionsCache;
 
 struct NuPlayer : public AHandler {
     explicit NuPlayer(pid_t pid, const sp<MediaClock> &mediaClock);
@@ -66,6 +67,9 @@ struct NuPlayer : public AHandler {
     status_t setSyncSettings(const AVSyncSettings &sync, float videoFpsHint);
     status_t getSyncSettings(AVSyncSettings *sync /* nonnull */, float *videoFps /* nonnull */);
 
+    // Presents mediaTimeUs at commonTimeUs on the common clock, see Renderer.
+    void setCommonTimeAnchor(int64_t commonTimeUs, int64_t mediaTimeUs);
+
     void start();
 
     void pause();
@@ -165,6 +169,7 @@ protected:
         kWhatReleaseDrm                 = 'rDrm',
         kWhatMediaClockNotify           = 'mckN',
         kWhatGetStats                   = 'gSts',
+        kWhatSetCommonTimeAnchor        = 'sCTA',
     };
 
     wp<NuPlayerDriver> mDriver;
@@ -208,6 +213,7 @@ protected:
 
     int32_t mPollDurationGeneration;
     int32_t mTimedTextGeneration;
+    sp<TextDescriptionsCache> mTimedTextCache;
 
     enum FlushStatus {
         NONE,
@@ -238,6 +244,8 @@ protected:
     AudioPlaybackRate mPlaybackSettings;
     AVSyncSettings mSyncSettings;
     float mVideoFpsHint;
+    int64_t mCommonTimeAnchorUs;
+    int64_t mCommonTimeAnchorMediaUs;
     bool mStarted;
     bool mPrepared;
     bool mResetting;
@@ -294,6 +302,7 @@ protected:
             bool audio, sp<DecoderBase> *decoder, bool checkAudioModeChange = true);
 
     status_t onInstantiateSecureDecoders();
+    void instantiateDecodersForFastStart();
 
     void updateVideoSize(
             const sp<AMessage> &inputFormat,
@@ -33,6 +33,9 @@ namespace android {
 // In CEA-708B, the maximum bandwidth of CC is set to 9600bps.
 static const size_t kMaxBandwithSizeBytes = 9600 / 8;
 
+// Initial size of the pending payload storage, about a second of captions.
+static const size_t kInitialCCDataSize = kMaxBandwithSizeBytes;
+
 struct CCData {
     CCData(uint8_t type, uint8_t data1, uint8_t data2)
         : mType(type), mData1(data1), mData2(data2) {
@@ -119,8 +122,10 @@ static void dumpBytePair(const sp<ABuffer> &ccBuf) {
 
 NuPlayer::CCDecoder::CCDecoder(const sp<AMessage> &notify)
     : mNotify(notify),
+      mCCData(new ABuffer(kInitialCCDataSize)),
       mSelectedTrack(-1),
       mDTVCCPacket(new ABuffer(kMaxBandwithSizeBytes)) {
+    mCCData->setRange(0, 0);
     mDTVCCPacket->setRange(0, 0);
 
     // In CEA-608, streams from packets which have the value 0 of cc_type contain CC1 and CC2, and
@@ -195,7 +200,7 @@ status_t NuPlayer::CCDecoder::selectTrack(size_t index, bool select) {
     }
 
     // Clear the previous track payloads
-    mCCMap.clear();
+    clearCCData();
 
     return OK;
 }
@@ -359,7 +364,10 @@ bool NuPlayer::CCDecoder::parseMPEGCCData(int64_t timeUs, const uint8_t *data, s
         return false;
     }
 
-    sp<ABuffer> line21CCBuf = NULL;
+    bool queueLine21 = isSelected() && mTracks[mSelectedTrack].mTrackType == kTrackTypeCEA608;
+    // cc_count is a 5-bit field, so the pairs of one access unit fit on the stack.
+    uint8_t line21Data[31 * sizeof(CCData)];
+    size_t line21Size = 0;
 
     for (size_t i = 0; i < cc_count; ++i) {
         br.skipBits(5);
@@ -398,14 +406,10 @@ bool NuPlayer::CCDecoder::parseMPEGCCData(int64_t timeUs, const uint8_t *data, s
                     getTrackIndex(kTrackTypeCEA608, channel, &trackAdded);
                 }
 
-                if (isSelected() && mTracks[mSelectedTrack].mTrackType == kTrackTypeCEA608
+                if (queueLine21
                         && mTracks[mSelectedTrack].mTrackChannel == mLine21Channels[cc_type]) {
-                    if (line21CCBuf == NULL) {
-                        line21CCBuf = new ABuffer((cc_count - i) * sizeof(CCData));
-                        line21CCBuf->setRange(0, 0);
-                    }
-                    memcpy(line21CCBuf->data() + line21CCBuf->size(), &cc, sizeof(cc));
-                    line21CCBuf->setRange(0, line21CCBuf->size() + sizeof(CCData));
+                    memcpy(line21Data + line21Size, &cc, sizeof(cc));
+                    line21Size += sizeof(cc);
                 }
             } else {
                 br.skipBits(16);
@@ -419,9 +423,8 @@ bool NuPlayer::CCDecoder::parseMPEGCCData(int64_t timeUs, const uint8_t *data, s
         }
     }
 
-    if (isSelected() && mTracks[mSelectedTrack].mTrackType == kTrackTypeCEA608
-            && line21CCBuf != NULL && line21CCBuf->size() > 0) {
-        mCCMap.add(timeUs, line21CCBuf);
+    if (line21Size > 0) {
+        queueCCData(timeUs, appendCCData(line21Data, line21Size), line21Size);
     }
 
     return trackAdded;
@@ -464,9 +467,7 @@ bool NuPlayer::CCDecoder::parseDTVCCPacket(int64_t timeUs, const uint8_t *data,
         if (block_size > 0) {
             size_t trackIndex = getTrackIndex(kTrackTypeCEA708, service_number, &trackAdded);
             if (mSelectedTrack == (ssize_t)trackIndex) {
-                sp<ABuffer> ccPacket = new ABuffer(block_size);
-                memcpy(ccPacket->data(), br.data(), block_size);
-                mCCMap.add(timeUs, ccPacket);
+                queueCCData(timeUs, appendCCData(br.data(), block_size), block_size);
             }
         }
         br.skipBits(block_size * 8);
@@ -494,6 +495,65 @@ size_t NuPlayer::CCDecoder::getTrackIndex(
     return mTrackIndices.valueAt(index);
 }
 
+// appends |size| bytes to the pending payload storage and returns their offset.
+// The storage may be compacted, so the bytes must be queued before the next append.
+size_t NuPlayer::CCDecoder::appendCCData(const void *data, size_t size) {
+    if (mPendingCC.empty()) {
+        mCCData->setRange(0, 0);
+    }
+
+    if (mCCData->size() + size > mCCData->capacity()) {
+        // Keep only the bytes still referenced by pending entries, in order,
+        // and grow the storage if that is still not enough.
+        size_t live = 0;
+        for (size_t i = 0; i < mPendingCC.size(); ++i) {
+            live += mPendingCC[i].mSize;
+        }
+        size_t capacity = mCCData->capacity();
+        while (live + size > capacity) {
+            capacity *= 2;
+        }
+
+        sp<ABuffer> compacted = new ABuffer(capacity);
+        compacted->setRange(0, 0);
+        for (size_t i = 0; i < mPendingCC.size(); ++i) {
+            PendingCC &entry = mPendingCC.editItemAt(i);
+            memcpy(compacted->data() + compacted->size(),
+                    mCCData->data() + entry.mOffset, entry.mSize);
+            entry.mOffset = compacted->size();
+            compacted->setRange(0, compacted->size() + entry.mSize);
+        }
+        mCCData = compacted;
+    }
+
+    size_t offset = mCCData->size();
+    memcpy(mCCData->data() + offset, data, size);
+    mCCData->setRange(0, offset + size);
+    return offset;
+}
+
+// queues a payload for display at |timeUs|. Payloads with the same timestamp
+// are kept in arrival order and delivered together.
+void NuPlayer::CCDecoder::queueCCData(int64_t timeUs, size_t offset, size_t size) {
+    PendingCC entry;
+    entry.mTimeUs = timeUs;
+    entry.mOffset = offset;
+    entry.mSize = size;
+
+    // Access units mostly arrive in presentation order; otherwise the entry
+    // is only a few positions away from the end.
+    size_t index = mPendingCC.size();
+    while (index > 0 && mPendingCC[index - 1].mTimeUs > timeUs) {
+        --index;
+    }
+    mPendingCC.insertAt(entry, index);
+}
+
+void NuPlayer::CCDecoder::clearCCData() {
+    mPendingCC.clear();
+    mCCData->setRange(0, 0);
+}
+
 void NuPlayer::CCDecoder::decode(const sp<ABuffer> &accessUnit) {
     if (extractFromMPEGUserData(accessUnit) || extractFromSEI(accessUnit)) {
         sp<AMessage> msg = mNotify->dup();
@@ -508,34 +568,31 @@ void NuPlayer::CCDecoder::display(int64_t timeUs) {
         return;
     }
 
-    ssize_t index = mCCMap.indexOfKey(timeUs);
-    if (index < 0) {
+    // Deliver everything queued up to and including timeUs in one buffer.
+    size_t count = 0;
+    size_t size = 0;
+    bool found = false;
+    while (count < mPendingCC.size() && mPendingCC[count].mTimeUs <= timeUs) {
+        found |= mPendingCC[count].mTimeUs == timeUs;
+        size += mPendingCC[count].mSize;
+        ++count;
+    }
+
+    if (!found) {
         ALOGV("cc for timestamp %" PRId64 " not found", timeUs);
         return;
     }
 
-    sp<ABuffer> ccBuf;
-
-    if (index == 0) {
-        ccBuf = mCCMap.valueAt(index);
-    } else {
-        size_t size = 0;
-
-        for (ssize_t i = 0; i <= index; ++i) {
-            size += mCCMap.valueAt(i)->size();
-        }
-
-        ccBuf = new ABuffer(size);
+    if (size > 0) {
+        sp<ABuffer> ccBuf = new ABuffer(size);
         ccBuf->setRange(0, 0);
 
-        for (ssize_t i = 0; i <= index; ++i) {
-            sp<ABuffer> buf = mCCMap.valueAt(i);
-            memcpy(ccBuf->data() + ccBuf->size(), buf->data(), buf->size());
-            ccBuf->setRange(0, ccBuf->size() + buf->size());
+        for (size_t i = 0; i < count; ++i) {
+            const PendingCC &entry = mPendingCC[i];
+            memcpy(ccBuf->data() + ccBuf->size(), mCCData->data() + entry.mOffset, entry.mSize);
+            ccBuf->setRange(0, ccBuf->size() + entry.mSize);
         }
-    }
 
-    if (ccBuf->size() > 0) {
 #if 0
         dumpBytePair(ccBuf);
 #endif
@@ -551,11 +608,14 @@ void NuPlayer::CCDecoder::display(int64_t timeUs) {
     }
 
     // remove all entries before timeUs
-    mCCMap.removeItemsAt(0, index + 1);
+    mPendingCC.removeItemsAt(0, count);
+    if (mPendingCC.empty()) {
+        mCCData->setRange(0, 0);
+    }
 }
 
 void NuPlayer::CCDecoder::flush() {
-    mCCMap.clear();
+    clearCCData();
     mDTVCCPacket->setRange(0, 0);
 }
 
@@ -62,8 +62,20 @@ private:
         inline bool operator!=(const NuPlayer::CCDecoder::CCTrack& rhs) const;
     };
 
+    // Caption payload of the selected track for one access unit, stored in
+    // mCCData at [mOffset, mOffset + mSize).
+    struct PendingCC {
+        int64_t mTimeUs;
+        size_t mOffset;
+        size_t mSize;
+    };
+
     sp<AMessage> mNotify;
-    KeyedVector<int64_t, sp<ABuffer> > mCCMap;
+    // Payloads waiting for display(), sorted by mTimeUs. The bytes live in
+    // mCCData, which is reused across frames instead of allocating a buffer
+    // per access unit.
+    Vector<PendingCC> mPendingCC;
+    sp<ABuffer> mCCData;
     ssize_t mSelectedTrack;
     KeyedVector<CCTrack, size_t> mTrackIndices;
     Vector<CCTrack> mTracks;
@@ -77,6 +89,11 @@ private:
     bool isTrackValid(size_t index) const;
     size_t getTrackIndex(int32_t trackType, size_t channel, bool *trackAdded);
 
+    // Pending payload storage
+    size_t appendCCData(const void *data, size_t size);
+    void queueCCData(int64_t timeUs, size_t offset, size_t size);
+    void clearCCData();
+
     // Extract from H.264 SEIs
     bool extractFromSEI(const sp<ABuffer> &accessUnit);
     bool parseSEINalUnit(int64_t timeUs, const uint8_t *data, size_t size);
@@ -54,6 +54,11 @@ static float kDisplayRefreshingRate = 60.f; // TODO: get this from the display
 // the source.
 static float kDefaultVideoFrameRateTotal = 30.f;
 
+// Non-reference video frames are skipped before decode while the renderer is
+// more than kLateFrameDropStartUs behind, until it is within kLateFrameDropStopUs.
+static const int64_t kLateFrameDropStartUs = 100000ll;
+static const int64_t kLateFrameDropStopUs = 40000ll;
+
 static inline bool getAudioDeepBufferSetting() {
     return property_get_bool("media.stagefright.audio.deep", false /* default_value */);
 }
@@ -77,10 +82,14 @@ NuPlayer::Decoder::Decoder(
       mNumFramesTotal(0ll),
       mNumInputFramesDropped(0ll),
       mNumOutputFramesDropped(0ll),
+      mNumLateFramesDropped(0ll),
       mVideoWidth(0),
       mVideoHeight(0),
       mIsAudio(true),
       mIsVideoAVC(false),
+      mIsVideoHEVC(false),
+      mDroppingLateFrames(false),
+      mMaxVideoTemporalId(0),
       mIsSecure(false),
       mIsEncrypted(false),
       mIsEncryptedObservedEarlier(false),
@@ -112,6 +121,7 @@ sp<AMessage> NuPlayer::Decoder::getStats() const {
     mStats->setInt64("frames-total", mNumFramesTotal);
     mStats->setInt64("frames-dropped-input", mNumInputFramesDropped);
     mStats->setInt64("frames-dropped-output", mNumOutputFramesDropped);
+    mStats->setInt64("frames-dropped-late", mNumLateFramesDropped);
     return mStats;
 }
 
@@ -147,6 +157,15 @@ void NuPlayer::Decoder::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
+            if (mRenderer == NULL
+                    && (cbID == MediaCodec::CB_OUTPUT_AVAILABLE
+                            || cbID == MediaCodec::CB_OUTPUT_FORMAT_CHANGED)) {
+                // Decoding ahead of start; hand the output over once the
+                // renderer is set.
+                mPendingOutputMessages.push_back(msg);
+                break;
+            }
+
             switch (cbID) {
                 case MediaCodec::CB_INPUT_AVAILABLE:
                 {
@@ -291,11 +310,16 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
 
     mIsAudio = !strncasecmp("audio/", mime.c_str(), 6);
     mIsVideoAVC = !strcasecmp(MEDIA_MIMETYPE_VIDEO_AVC, mime.c_str());
+    mIsVideoHEVC = !strcasecmp(MEDIA_MIMETYPE_VIDEO_HEVC, mime.c_str());
+    mDroppingLateFrames = false;
+    mMaxVideoTemporalId = 0;
 
     mComponentName = mime;
     mComponentName.append(" decoder");
     ALOGV("[%s] onConfigure (surface=%p)", mComponentName.c_str(), mSurface.get());
 
+    int64_t configureStartUs = ALooper::GetNowUs();
+
     mCodec = AVUtils::get()->createCustomComponentByName(mCodecLooper, mime.c_str(), false /* encoder */, format);
     if (mCodec == NULL) {
     mCodec = MediaCodec::CreateByType(
@@ -387,6 +411,8 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
 
     releaseAndResetMediaBuffers();
 
+    mStats->setInt64("codec-init-ms", (ALooper::GetNowUs() - configureStartUs + 500) / 1000);
+
     mPaused = false;
     mResumePending = false;
 }
@@ -458,6 +484,15 @@ void NuPlayer::Decoder::onSetParameters(const sp<AMessage> &params) {
 
 void NuPlayer::Decoder::onSetRenderer(const sp<Renderer> &renderer) {
     mRenderer = renderer;
+
+    if (mRenderer == NULL) {
+        return;
+    }
+    while (!mPendingOutputMessages.empty()) {
+        sp<AMessage> msg = *mPendingOutputMessages.begin();
+        mPendingOutputMessages.erase(mPendingOutputMessages.begin());
+        onMessageReceived(msg);
+    }
 }
 
 void NuPlayer::Decoder::onResume(bool notifyComplete) {
@@ -500,6 +535,7 @@ void NuPlayer::Decoder::doFlush(bool notifyComplete) {
     }
     releaseAndResetMediaBuffers();
     mPaused = true;
+    mDroppingLateFrames = false;
 }
 
 
@@ -849,6 +885,7 @@ void NuPlayer::Decoder::releaseAndResetMediaBuffers() {
     }
 
     mPendingInputMessages.clear();
+    mPendingOutputMessages.clear();
     mDequeuedInputBuffers.clear();
     mSkipRenderingUntilMediaTimeUs = -1;
 }
@@ -861,6 +898,35 @@ void NuPlayer::Decoder::requestCodecNotification() {
     }
 }
 
+bool NuPlayer::Decoder::shouldDropLateFrame(const sp<ABuffer> &accessUnit) {
+    // Start skipping non-reference frames ahead of the codec once the renderer
+    // falls well behind, and keep skipping them until it has nearly caught up,
+    // so that decode time goes to the frames that will still be shown.
+    int64_t lateByUs = mRenderer != NULL ? mRenderer->getVideoLateByUs() : 0;
+    if (!mDroppingLateFrames && lateByUs > kLateFrameDropStartUs) {
+        ALOGV("[%s] video late by %lld us, dropping non-reference frames",
+                mComponentName.c_str(), (long long)lateByUs);
+        mDroppingLateFrames = true;
+    } else if (mDroppingLateFrames && lateByUs < kLateFrameDropStopUs) {
+        ALOGV("[%s] video caught up, %lld late frames dropped so far",
+                mComponentName.c_str(), (long long)mNumLateFramesDropped);
+        mDroppingLateFrames = false;
+    }
+
+    if (mIsVideoHEVC) {
+        // A sub-layer non-reference picture may still be referenced by higher
+        // sub-layers, so only skip those of the highest sub-layer seen.
+        unsigned temporalId = 0;
+        bool isReference = IsHEVCReferenceFrame(accessUnit, &temporalId);
+        if (temporalId > mMaxVideoTemporalId) {
+            mMaxVideoTemporalId = temporalId;
+        }
+        return mDroppingLateFrames && !isReference && temporalId == mMaxVideoTemporalId;
+    }
+
+    return mDroppingLateFrames && mIsVideoAVC && !IsAVCReferenceFrame(accessUnit);
+}
+
 bool NuPlayer::Decoder::isStaleReply(const sp<AMessage> &msg) {
     int32_t generation;
     CHECK(msg->findInt32("generation", &generation));
@@ -945,10 +1011,9 @@ status_t NuPlayer::Decoder::fetchInputData(sp<AMessage> &reply) {
 
             int32_t layerId = 0;
             bool haveLayerId = accessUnit->meta()->findInt32("temporal-layer-id", &layerId);
-            if (mRenderer->getVideoLateByUs() > 100000ll
-                    && mIsVideoAVC
-                    && !IsAVCReferenceFrame(accessUnit)) {
+            if (shouldDropLateFrame(accessUnit)) {
                 dropAccessUnit = true;
+                ++mNumLateFramesDropped;
             } else if (haveLayerId && mNumVideoTemporalLayerTotal > 1) {
                 // Add only one layer each time.
                 if (layerId > mCurrentMaxVideoTemporalLayerId + 1
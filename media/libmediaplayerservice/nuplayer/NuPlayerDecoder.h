@@ -78,6 +78,8 @@ protected:
     sp<ALooper> mCodecLooper;
 
     List<sp<AMessage> > mPendingInputMessages;
+    // codec output that arrived before a renderer was set
+    List<sp<AMessage> > mPendingOutputMessages;
 
     Vector<sp<MediaCodecBuffer> > mInputBuffers;
     Vector<sp<MediaCodecBuffer> > mOutputBuffers;
@@ -93,10 +95,14 @@ protected:
     int64_t mNumFramesTotal;
     int64_t mNumInputFramesDropped;
     int64_t mNumOutputFramesDropped;
+    int64_t mNumLateFramesDropped;
     int32_t mVideoWidth;
     int32_t mVideoHeight;
     bool mIsAudio;
     bool mIsVideoAVC;
+    bool mIsVideoHEVC;
+    bool mDroppingLateFrames;
+    unsigned mMaxVideoTemporalId;
     bool mIsSecure;
     bool mIsEncrypted;
     bool mIsEncryptedObservedEarlier;
@@ -125,6 +131,7 @@ protected:
     void releaseAndResetMediaBuffers();
     void requestCodecNotification();
     bool isStaleReply(const sp<AMessage> &msg);
+    bool shouldDropLateFrame(const sp<ABuffer> &accessUnit);
 
     void doFlush(bool notifyComplete);
     status_t fetchInputData(sp<AMessage> &reply);
@@ -18,6 +18,7 @@
 #define LOG_TAG "NuPlayerDecoderPassThrough"
 #include <utils/Log.h>
 #include <inttypes.h>
+#include <algorithm>
 
 #include "NuPlayerDecoderPassThrough.h"
 
@@ -29,22 +30,32 @@
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AUtils.h>
 #include <media/stagefright/MediaErrors.h>
 
 #include "ATSParser.h"
 
 namespace android {
 
-// TODO optimize buffer size for power consumption
-// The offload read buffer size is 32 KB but 24 KB uses less power.
-static const size_t kMaxCachedBytes = 200000;
+// Compressed data is aggregated into chunks the size of the offload buffer,
+// so that each refill of the DSP takes one write. Without a known buffer
+// size this falls back to 24 KB, which used less power than the 32 KB read
+// buffer size.
+static const size_t kMinAggregateBufferSizeBytes = 24 * 1024;
+static const size_t kMaxAggregateBufferSizeBytes = 256 * 1024;
+
+// Up to kMaxCachedDurationUs of data is kept queued at the stream bitrate,
+// and refilled in batches once half of it has been consumed.
+static const size_t kMinCachedBytes = 200000;
+static const size_t kMaxCachedBytes = 2 * 1024 * 1024;
+static const int64_t kMaxCachedDurationUs = 10000000ll;
 
 NuPlayer::DecoderPassThrough::DecoderPassThrough(
         const sp<AMessage> &notify,
         const sp<Source> &source,
         const sp<Renderer> &renderer)
     : DecoderBase(notify),
-      mAggregateBufferSizeBytes(24 * 1024),
+      mAggregateBufferSizeBytes(kMinAggregateBufferSizeBytes),
       mSource(source),
       mRenderer(renderer),
       mSkipRenderingUntilMediaTimeUs(-1ll),
@@ -52,6 +63,7 @@ NuPlayer::DecoderPassThrough::DecoderPassThrough(
       mPendingAudioErr(OK),
       mPendingBuffersToDrain(0),
       mCachedBytes(0),
+      mMaxCachedBytes(kMinCachedBytes),
       mComponentName("pass through decoder") {
     ALOGW_IF(renderer == NULL, "expect a non-NULL renderer");
 }
@@ -79,7 +91,43 @@ void NuPlayer::DecoderPassThrough::onConfigure(const sp<AMessage> &format) {
             AUDIO_OUTPUT_FLAG_NONE /* flags */, NULL /* isOffloaded */, mSource->isStreaming());
     if (err != OK) {
         handleError(err);
+        return;
+    }
+
+    int32_t bitrate = 0;
+    format->findInt32("bitrate", &bitrate);
+    updateBufferSizes(bitrate, mRenderer->getOffloadBufferSize());
+
+    AString mime;
+    if (format->findString("mime", &mime)) {
+        mStats->setString("mime", mime.c_str());
     }
+    mStats->setString("component-name", mComponentName.c_str());
+}
+
+void NuPlayer::DecoderPassThrough::updateBufferSizes(int32_t bitrate, size_t offloadBufferSize) {
+    mAggregateBufferSizeBytes = kMinAggregateBufferSizeBytes;
+    if (offloadBufferSize > mAggregateBufferSizeBytes) {
+        mAggregateBufferSizeBytes = std::min(offloadBufferSize, kMaxAggregateBufferSizeBytes);
+    }
+
+    mMaxCachedBytes = kMinCachedBytes;
+    if (bitrate > 0) {
+        size_t bytes = (int64_t)bitrate * kMaxCachedDurationUs / 8000000ll;
+        mMaxCachedBytes = std::max(mMaxCachedBytes, std::min(bytes, kMaxCachedBytes));
+    }
+    // keep a few aggregates in flight
+    mMaxCachedBytes = std::max(mMaxCachedBytes, 4 * mAggregateBufferSizeBytes);
+
+    // The AP is woken each time the DSP has played out its buffer.
+    if (bitrate > 0 && offloadBufferSize > 0) {
+        mStats->setInt32("offload-wakeups-per-min",
+                (int32_t)divUp((int64_t)bitrate * 60 / 8, (int64_t)offloadBufferSize));
+    }
+
+    ALOGV("[%s] bitrate %d, offload buffer %zu: aggregate %zu, max cached %zu",
+            mComponentName.c_str(), bitrate, offloadBufferSize,
+            mAggregateBufferSizeBytes, mMaxCachedBytes);
 }
 
 void NuPlayer::DecoderPassThrough::onSetParameters(const sp<AMessage> &/*params*/) {
@@ -103,7 +151,7 @@ bool NuPlayer::DecoderPassThrough::isDoneFetching() const {
     ALOGV("[%s] mCachedBytes = %zu, mReachedEOS = %d mPaused = %d",
             mComponentName.c_str(), mCachedBytes, mReachedEOS, mPaused);
 
-    return mCachedBytes >= kMaxCachedBytes || mReachedEOS || mPaused;
+    return mCachedBytes >= mMaxCachedBytes || mReachedEOS || mPaused;
 }
 
 /*
@@ -356,7 +404,9 @@ void NuPlayer::DecoderPassThrough::onBufferConsumed(int32_t size) {
     mCachedBytes -= size;
     ALOGV("onBufferConsumed: #ToDrain = %zu, cachedBytes = %zu",
             mPendingBuffersToDrain, mCachedBytes);
-    onRequestInputBuffers();
+    if (mCachedBytes < mMaxCachedBytes / 2) {
+        onRequestInputBuffers();
+    }
 }
 
 void NuPlayer::DecoderPassThrough::onResume(bool notifyComplete) {
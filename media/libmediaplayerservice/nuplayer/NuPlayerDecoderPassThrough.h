@@ -66,10 +66,12 @@ private:
     // when the power investigation is done.
     size_t  mPendingBuffersToDrain;
     size_t  mCachedBytes;
+    size_t  mMaxCachedBytes;
     AString mComponentName;
 
     bool isStaleReply(const sp<AMessage> &msg);
     bool isDoneFetching() const;
+    void updateBufferSizes(int32_t bitrate, size_t offloadBufferSize);
 
     status_t dequeueAccessUnit(sp<ABuffer> *accessUnit);
     status_t fetchInputData(sp<AMessage> &reply);
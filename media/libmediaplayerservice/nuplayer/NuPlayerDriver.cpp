@@ -64,6 +64,12 @@ static const char *kPlayerErrorCode = "android.media.mediaplayer.errcode";
     // NB: These are not yet exposed as public Java API constants.
 static const char *kPlayerErrorState = "android.media.mediaplayer.errstate";
 static const char *kPlayerDataSourceType = "android.media.mediaplayer.dataSource";
+static const char *kPlayerFramesJudder = "android.media.mediaplayer.judder";
+static const char *kPlayerFramesDroppedLate = "android.media.mediaplayer.droppedLate";
+static const char *kPlayerPrepareMs = "android.media.mediaplayer.prepareMs";
+static const char *kPlayerFirstFrameMs = "android.media.mediaplayer.firstFrameMs";
+static const char *kPlayerVCodecInitMs = "android.media.mediaplayer.video.codecInitMs";
+static const char *kPlayerACodecInitMs = "android.media.mediaplayer.audio.codecInitMs";
 //
 static const char *kPlayerRebuffering = "android.media.mediaplayer.rebufferingMs";
 static const char *kPlayerRebufferingCount = "android.media.mediaplayer.rebuffers";
@@ -82,6 +88,8 @@ NuPlayerDriver::NuPlayerDriver(pid_t pid)
       mRebufferingTimeUs(0),
       mRebufferingEvents(0),
       mRebufferingAtExit(false),
+      mPrepareStartTimeUs(-1),
+      mStartTimeUs(-1),
       mLooper(new ALooper),
       mMediaClock(new MediaClock),
       mPlayer(AVNuFactory::get()->createNuPlayer(pid, mMediaClock)),
@@ -280,6 +288,7 @@ status_t NuPlayerDriver::prepare_l() {
     switch (mState) {
         case STATE_UNPREPARED:
             mState = STATE_PREPARING;
+            mPrepareStartTimeUs = ALooper::GetNowUs();
 
             // Make sure we're not posting any notifications, success or
             // failure information is only communicated through our result
@@ -313,6 +322,7 @@ status_t NuPlayerDriver::prepareAsync() {
     switch (mState) {
         case STATE_UNPREPARED:
             mState = STATE_PREPARING;
+            mPrepareStartTimeUs = ALooper::GetNowUs();
             mIsAsyncPrepare = true;
             mPlayer->prepareAsync();
             return OK;
@@ -354,6 +364,9 @@ status_t NuPlayerDriver::start_l() {
         case STATE_STOPPED_AND_PREPARED:
         case STATE_PREPARED:
         {
+            if (mState == STATE_PREPARED) {
+                mStartTimeUs = ALooper::GetNowUs();
+            }
             mPlayer->start();
 
             // fall through
@@ -579,12 +592,32 @@ void NuPlayerDriver::updateMetrics(const char *where) {
                 mAnalyticsItem->setInt64(kPlayerFrames, numFramesTotal);
                 mAnalyticsItem->setInt64(kPlayerFramesDropped, numFramesDropped);
 
+                int64_t codecInitMs;
+                if (stats->findInt64("codec-init-ms", &codecInitMs)) {
+                    mAnalyticsItem->setInt64(kPlayerVCodecInitMs, codecInitMs);
+                }
+
+                int64_t numFramesDroppedLate;
+                if (stats->findInt64("frames-dropped-late", &numFramesDroppedLate)) {
+                    mAnalyticsItem->setInt64(kPlayerFramesDroppedLate, numFramesDroppedLate);
+                }
+
+                int64_t numFramesJudder;
+                if (stats->findInt64("frames-judder", &numFramesJudder)) {
+                    mAnalyticsItem->setInt64(kPlayerFramesJudder, numFramesJudder);
+                }
+
 
             } else if (mime.startsWith("audio/")) {
                 mAnalyticsItem->setCString(kPlayerAMime, mime.c_str());
                 if (!name.empty()) {
                     mAnalyticsItem->setCString(kPlayerACodec, name.c_str());
                 }
+
+                int64_t codecInitMs;
+                if (stats->findInt64("codec-init-ms", &codecInitMs)) {
+                    mAnalyticsItem->setInt64(kPlayerACodecInitMs, codecInitMs);
+                }
             }
         }
     }
@@ -627,7 +660,7 @@ void NuPlayerDriver::logMetrics(const char *where) {
     // So the canonical "empty" record has 3 elements in it.
     if (mAnalyticsItem->count() > 3) {
 
-        mAnalyticsItem->selfrecord();
+        mAnalyticsItem->selfrecordBatched();
 
         // re-init in case we prepare() and start() again.
         delete mAnalyticsItem ;
@@ -767,8 +800,16 @@ void NuPlayerDriver::setAudioSink(const sp<AudioSink> &audioSink) {
     mAudioSink = audioSink;
 }
 
-status_t NuPlayerDriver::setParameter(
-        int /* key */, const Parcel & /* request */) {
+status_t NuPlayerDriver::setParameter(int key, const Parcel &request) {
+    if (key == KEY_PARAMETER_COMMON_TIME_ANCHOR) {
+        int64_t commonTimeUs, mediaTimeUs;
+        if (request.readInt64(&commonTimeUs) != OK || request.readInt64(&mediaTimeUs) != OK) {
+            return BAD_VALUE;
+        }
+        mPlayer->setCommonTimeAnchor(commonTimeUs, mediaTimeUs);
+        return OK;
+    }
+
     return INVALID_OPERATION;
 }
 
@@ -942,6 +983,18 @@ status_t NuPlayerDriver::dump(
                      numFramesTotal == 0
                             ? 0.0 : (double)(numFramesDropped * 100) / numFramesTotal);
             logString.append(buf);
+        } else if (mime.startsWith("audio/")) {
+            int32_t wakeupsPerMinute;
+            if (stats->findInt32("offload-wakeups-per-min", &wakeupsPerMinute)) {
+                snprintf(buf, sizeof(buf), "    offloadWakeupsPerMinute(%d)\n",
+                         wakeupsPerMinute);
+                logString.append(buf);
+            }
+        }
+
+        AString abrTrace;
+        if (stats->findString("abr-trace", &abrTrace)) {
+            logString.append(abrTrace);
         }
     }
 
@@ -1014,6 +1067,19 @@ void NuPlayerDriver::notifyListener_l(
             break;
         }
 
+        case MEDIA_INFO:
+        {
+            // time from the first start() to the first video frame on screen
+            if (ext1 == MEDIA_INFO_RENDERING_START && mStartTimeUs >= 0) {
+                if (mAnalyticsItem != NULL) {
+                    mAnalyticsItem->setInt64(kPlayerFirstFrameMs,
+                            (ALooper::GetNowUs() - mStartTimeUs + 500) / 1000);
+                }
+                mStartTimeUs = -1;
+            }
+            break;
+        }
+
         default:
             break;
     }
@@ -1051,6 +1117,11 @@ void NuPlayerDriver::notifyPrepareCompleted(status_t err) {
     mAsyncResult = err;
 
     if (err == OK) {
+        if (mAnalyticsItem != NULL && mPrepareStartTimeUs >= 0) {
+            mAnalyticsItem->setInt64(kPlayerPrepareMs,
+                    (ALooper::GetNowUs() - mPrepareStartTimeUs + 500) / 1000);
+        }
+
         // update state before notifying client, so that if client calls back into NuPlayerDriver
         // in response, NuPlayerDriver has the right state
         mState = STATE_PREPARED;
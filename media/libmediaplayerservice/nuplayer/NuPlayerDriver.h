@@ -133,6 +133,8 @@ private:
     int64_t mRebufferingTimeUs;
     int32_t mRebufferingEvents;
     bool mRebufferingAtExit;
+    int64_t mPrepareStartTimeUs;
+    int64_t mStartTimeUs;
     // <<<
 
     sp<ALooper> mLooper;
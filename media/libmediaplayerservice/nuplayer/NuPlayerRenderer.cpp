@@ -31,6 +31,7 @@
 #include <media/stagefright/Utils.h>
 #include <media/stagefright/VideoFrameScheduler.h>
 #include <media/MediaCodecBuffer.h>
+#include <common_time/cc_helper.h>
 
 #include <inttypes.h>
 #include "mediaplayerservice/AVNuExtensions.h"
@@ -71,12 +72,24 @@ static inline int32_t getAudioSinkPcmMsSetting() {
 // Maximum time in paused state when offloading audio decompression. When elapsed, the AudioSink
 // is closed to allow the audio DSP to power down.
 static const int64_t kOffloadPauseMaxUs = 10000000ll;
+// Minimum time in paused state before the offloaded AudioSink is closed.
+static const int64_t kOffloadPauseMinUs = 3000000ll;
 
 // Maximum allowed delay from AudioSink, 1.5 seconds.
 static const int64_t kMaxAllowedAudioSinkDelayUs = 1500000ll;
 
 static const int64_t kMinimumAudioClockUpdatePeriodUs = 20 /* msec */ * 1000;
 
+// Common time playback: how often the presented audio is compared to the common clock,
+// the error below which no correction is made, and the error above which audio is dropped
+// or silence is inserted instead of correcting through the playback rate.
+static const int64_t kCommonTimeCheckPeriodUs = 100000ll;
+static const int64_t kCommonTimeToleranceUs = 250ll;
+static const int64_t kCommonTimeMaxRateCorrectedErrorUs = 20000ll;
+// Rate corrections remove the error over about this long, within +/- kCommonTimeMaxRateAdjust.
+static const int64_t kCommonTimeCorrectionPeriodUs = 2000000ll;
+static const float kCommonTimeMaxRateAdjust = 0.005f;
+
 // static
 const NuPlayer::Renderer::PcmInfo NuPlayer::Renderer::AUDIO_PCMINFO_INITIALIZER = {
         AUDIO_CHANNEL_NONE,
@@ -135,6 +148,12 @@ NuPlayer::Renderer::Renderer(
       mLastAudioBufferDrained(0),
       mUseAudioCallback(false),
       mWakeLock(new AWakeLock()),
+      mCCHelper(NULL),
+      mCommonTimeAnchorUs(-1),
+      mCommonTimeAnchorMediaUs(-1),
+      mCommonTimeStartPending(false),
+      mCommonTimeRateAdjust(0.f),
+      mNextCommonTimeCheckUs(-1),
       mNeedVideoClearAnchor(false) {
     CHECK(mediaClock != NULL);
     mPlaybackRate = mPlaybackSettings.mSpeed;
@@ -156,6 +175,7 @@ NuPlayer::Renderer::~Renderer() {
     }
     mWakeLock.clear();
     mVideoScheduler.clear();
+    delete mCCHelper;
     mNotify.clear();
     mAudioSink.clear();
 }
@@ -215,6 +235,7 @@ status_t NuPlayer::Renderer::onConfigPlayback(const AudioPlaybackRate &rate /* s
     if (!mHasAudio) {
         mNeedVideoClearAnchor = true;
     }
+    mCommonTimeRateAdjust = 0.f;
     mPlaybackSettings = rate;
     mPlaybackRate = rate.mSpeed;
     mMediaClock->setPlaybackRate(mPlaybackRate);
@@ -235,7 +256,8 @@ status_t NuPlayer::Renderer::getPlaybackSettings(AudioPlaybackRate *rate /* nonn
 }
 
 status_t NuPlayer::Renderer::onGetPlaybackSettings(AudioPlaybackRate *rate /* nonnull */) {
-    if (mAudioSink != NULL && mAudioSink->ready()) {
+    // the audiosink rate includes the common time correction, which is not reported.
+    if (mAudioSink != NULL && mAudioSink->ready() && mCommonTimeRateAdjust == 0.f) {
         status_t err = mAudioSink->getPlaybackRate(rate);
         if (err == OK) {
             if (!isAudioPlaybackRateEqual(*rate, mPlaybackSettings)) {
@@ -293,6 +315,19 @@ status_t NuPlayer::Renderer::onGetSyncSettings(
     return OK;
 }
 
+status_t NuPlayer::Renderer::getNumJudderFrames(int64_t *numJudderFrames) {
+    sp<AMessage> msg = new AMessage(kWhatGetJudderFrames, this);
+    sp<AMessage> response;
+    status_t err = msg->postAndAwaitResponse(&response);
+    if (err == OK && response != NULL) {
+        CHECK(response->findInt32("err", &err));
+        if (err == OK) {
+            CHECK(response->findInt64("judder-frames", numJudderFrames));
+        }
+    }
+    return err;
+}
+
 void NuPlayer::Renderer::flush(bool audio, bool notifyComplete) {
     {
         Mutex::Autolock autoLock(mLock);
@@ -344,6 +379,13 @@ void NuPlayer::Renderer::setVideoFrameRate(float fps) {
 }
 
 // Called on any threads without mLock acquired.
+void NuPlayer::Renderer::setCommonTimeAnchor(int64_t commonTimeUs, int64_t mediaTimeUs) {
+    sp<AMessage> msg = new AMessage(kWhatSetCommonTimeAnchor, this);
+    msg->setInt64("commonTimeUs", commonTimeUs);
+    msg->setInt64("mediaTimeUs", mediaTimeUs);
+    msg->post();
+}
+
 status_t NuPlayer::Renderer::getCurrentPosition(int64_t *mediaUs) {
     status_t result = mMediaClock->getMediaTime(ALooper::GetNowUs(), mediaUs);
     if (result == OK) {
@@ -402,6 +444,17 @@ int64_t NuPlayer::Renderer::getVideoLateByUs() {
     return mVideoLateByUs;
 }
 
+size_t NuPlayer::Renderer::getOffloadBufferSize() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (!offloadingAudio()) {
+            return 0;
+        }
+    }
+    ssize_t size = mAudioSink->bufferSize();
+    return size > 0 ? size : 0;
+}
+
 status_t NuPlayer::Renderer::openAudioSink(
         const sp<AMessage> &format,
         bool offloadOnly,
@@ -490,6 +543,15 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetCommonTimeAnchor:
+        {
+            int64_t commonTimeUs, mediaTimeUs;
+            CHECK(msg->findInt64("commonTimeUs", &commonTimeUs));
+            CHECK(msg->findInt64("mediaTimeUs", &mediaTimeUs));
+            onSetCommonTimeAnchor(commonTimeUs, mediaTimeUs);
+            break;
+        }
+
         case kWhatCloseAudioSink:
         {
             sp<AReplyToken> replyID;
@@ -702,6 +764,22 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatGetJudderFrames:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            sp<AMessage> response = new AMessage;
+            if (mVideoScheduler != NULL) {
+                response->setInt64("judder-frames", mVideoScheduler->getNumJudderFrames());
+                response->setInt32("err", OK);
+            } else {
+                response->setInt32("err", NO_INIT);
+            }
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatFlush:
         {
             onFlush(msg);
@@ -1005,6 +1083,13 @@ bool NuPlayer::Renderer::onDrainAudioQueue() {
         return false;
     }
 
+    if (isCommonTimeActive() && !mPaused) {
+        if (mCommonTimeStartPending && !scheduleCommonTimeStart()) {
+            return false;
+        }
+        syncToCommonTime();
+    }
+
 #if 0
     ssize_t numFramesAvailableToWrite =
         mAudioSink->frameCount() - (mNumFramesWritten - numFramesPlayed);
@@ -1642,6 +1727,8 @@ void NuPlayer::Renderer::onFlush(const sp<AMessage> &msg) {
             mNumFramesWritten = 0;
         }
         mNextAudioClockUpdateTimeUs = -1;
+        // the media time jumps, so schedule the start against the common clock again.
+        mCommonTimeStartPending = mCommonTimeAnchorUs >= 0;
     } else {
         flushQueue(&mVideoQueue);
 
@@ -1800,6 +1887,9 @@ void NuPlayer::Renderer::onResume() {
         if (mAudioSink != NULL && mAudioSink->ready()) {
             mAudioSink->setPlaybackRate(mPlaybackSettings);
         }
+        // the common clock kept running while paused.
+        mCommonTimeRateAdjust = 0.f;
+        mCommonTimeStartPending = mCommonTimeAnchorUs >= 0;
 
         mMediaClock->setPlaybackRate(mPlaybackRate);
 
@@ -1820,6 +1910,212 @@ void NuPlayer::Renderer::onSetVideoFrameRate(float fps) {
     mVideoScheduler->init(fps);
 }
 
+void NuPlayer::Renderer::onSetCommonTimeAnchor(int64_t commonTimeUs, int64_t mediaTimeUs) {
+    if (commonTimeUs < 0) {
+        ALOGV("common time playback disabled");
+        setCommonTimeRateAdjust(0.f);
+        mCommonTimeAnchorUs = -1;
+        mCommonTimeStartPending = false;
+        return;
+    }
+
+    if (mCCHelper == NULL) {
+        mCCHelper = new CCHelper();
+    }
+    ALOGV("presenting media time %lld at common time %lld",
+            (long long)mediaTimeUs, (long long)commonTimeUs);
+    mCommonTimeAnchorUs = commonTimeUs;
+    mCommonTimeAnchorMediaUs = mediaTimeUs;
+    mNextCommonTimeCheckUs = -1;
+
+    // Before the first write the start is scheduled, afterwards the new
+    // anchor is reached through the regular drift correction.
+    Mutex::Autolock autoLock(mLock);
+    mCommonTimeStartPending = mNumFramesWritten == 0;
+    postDrainAudioQueue_l();
+}
+
+// Common time playback needs control over each PCM write, which offloaded
+// audio and the audio callback mode do not give.
+bool NuPlayer::Renderer::isCommonTimeActive() const {
+    return mCommonTimeAnchorUs >= 0 && !offloadingAudio() && !mUseAudioCallback
+            && audio_is_linear_pcm(mCurrentPcmInfo.mFormat)
+            && mCurrentPcmInfo.mFormat != AUDIO_FORMAT_PCM_8_BIT;
+}
+
+// Returns the media time that should be presented at nowUs on the system clock.
+status_t NuPlayer::Renderer::getCommonTimeMediaUs(int64_t nowUs, int64_t *mediaUs) {
+    bool valid;
+    uint32_t timelineId;
+    uint64_t freq;
+    if (mCCHelper->isCommonTimeValid(&valid, &timelineId) != OK || !valid
+            || mCCHelper->getCommonFreq(&freq) != OK || freq == 0) {
+        return NO_INIT;
+    }
+
+    // Take the system time halfway through the binder call.
+    int64_t beforeUs = ALooper::GetNowUs();
+    int64_t commonTime;
+    status_t err = mCCHelper->getCommonTime(&commonTime);
+    int64_t afterUs = ALooper::GetNowUs();
+    if (err != OK) {
+        return err;
+    }
+
+    int64_t commonUs = (commonTime / (int64_t)freq) * 1000000ll
+            + (commonTime % (int64_t)freq) * 1000000ll / (int64_t)freq;
+    commonUs += nowUs - (beforeUs + afterUs) / 2;
+    *mediaUs = mCommonTimeAnchorMediaUs
+            + (int64_t)((commonUs - mCommonTimeAnchorUs) * mPlaybackSettings.mSpeed);
+    return OK;
+}
+
+// Holds the first audio write until it would be presented at its common time,
+// or drops the audio that is already late. Returns true once audio can be written.
+bool NuPlayer::Renderer::scheduleCommonTimeStart() {
+    if (mAudioQueue.empty() || mAudioQueue.begin()->mBuffer == NULL) {
+        return true;
+    }
+
+    QueueEntry *entry = &*mAudioQueue.begin();
+    int64_t mediaTimeUs;
+    CHECK(entry->mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
+    if (entry->mOffset > 0) {
+        mediaTimeUs += getDurationUsIfPlayedAtSampleRate(entry->mOffset / mAudioSink->frameSize());
+    }
+
+    int64_t nowUs = ALooper::GetNowUs();
+    int64_t targetMediaUs;
+    if (getCommonTimeMediaUs(nowUs, &targetMediaUs) != OK) {
+        ALOGW("common time is not available, starting audio now");
+        mCommonTimeStartPending = false;
+        return true;
+    }
+
+    // The first sample is heard about one sink latency after it is written.
+    int64_t waitUs = (int64_t)((mediaTimeUs - targetMediaUs) / mPlaybackSettings.mSpeed)
+            - mAudioSink->latency() * 1000ll;
+    if (waitUs > 0) {
+        ALOGV("holding audio for %lld us to start at common time", (long long)waitUs);
+        Mutex::Autolock autoLock(mLock);
+        postDrainAudioQueue_l(waitUs);
+        return false;
+    }
+
+    dropAudioUs(-waitUs);
+    mCommonTimeStartPending = false;
+    mNextCommonTimeCheckUs = -1;
+    return true;
+}
+
+// Compares the presented audio, which anchors mMediaClock from the AudioTrack
+// timestamps, with the common clock and corrects the difference.
+void NuPlayer::Renderer::syncToCommonTime() {
+    int64_t nowUs = ALooper::GetNowUs();
+    if (mNextAudioClockUpdateTimeUs < 0 || mUseVirtualAudioSink
+            || nowUs < mNextCommonTimeCheckUs) {
+        return;
+    }
+    mNextCommonTimeCheckUs = nowUs + kCommonTimeCheckPeriodUs;
+
+    int64_t presentedMediaUs, targetMediaUs;
+    if (mMediaClock->getMediaTime(nowUs, &presentedMediaUs) != OK
+            || getCommonTimeMediaUs(nowUs, &targetMediaUs) != OK) {
+        return;
+    }
+
+    // positive when audio is presented too early
+    int64_t errorUs = presentedMediaUs - targetMediaUs;
+    ALOGV("common time error %lld us", (long long)errorUs);
+
+    if (errorUs > kCommonTimeMaxRateCorrectedErrorUs) {
+        setCommonTimeRateAdjust(0.f);
+        insertSilenceUs(errorUs);
+    } else if (errorUs < -kCommonTimeMaxRateCorrectedErrorUs) {
+        setCommonTimeRateAdjust(0.f);
+        dropAudioUs(-errorUs);
+    } else if (errorUs <= kCommonTimeToleranceUs && errorUs >= -kCommonTimeToleranceUs) {
+        setCommonTimeRateAdjust(0.f);
+    } else {
+        float adjust = (float)-errorUs / kCommonTimeCorrectionPeriodUs;
+        setCommonTimeRateAdjust(
+                std::min(std::max(adjust, -kCommonTimeMaxRateAdjust), kCommonTimeMaxRateAdjust));
+    }
+}
+
+void NuPlayer::Renderer::setCommonTimeRateAdjust(float adjust) {
+    if (adjust == mCommonTimeRateAdjust || mAudioSink == NULL || !mAudioSink->ready()) {
+        return;
+    }
+
+    // Change speed and pitch together so that the track resamples instead of time stretching.
+    AudioPlaybackRate rate = mPlaybackSettings;
+    rate.mSpeed *= 1.f + adjust;
+    rate.mPitch *= 1.f + adjust;
+    if (mAudioSink->setPlaybackRate(rate) == OK) {
+        mCommonTimeRateAdjust = adjust;
+    }
+}
+
+// Drops up to durationUs of queued audio, stopping at EOS and format changes.
+void NuPlayer::Renderer::dropAudioUs(int64_t durationUs) {
+    int32_t sampleRate = mCurrentPcmInfo.mSampleRate;
+    size_t frameSize = mAudioSink->frameSize();
+    if (sampleRate <= 0 || frameSize == 0) {
+        return;
+    }
+    size_t dropBytes = (size_t)(durationUs * sampleRate / 1000000ll) * frameSize;
+    size_t droppedBytes = 0;
+
+    Mutex::Autolock autoLock(mLock);
+    while (dropBytes > 0 && !mAudioQueue.empty()) {
+        QueueEntry *entry = &*mAudioQueue.begin();
+        if (entry->mBuffer == NULL) {
+            break;
+        }
+
+        size_t remainder = entry->mBuffer->size() - entry->mOffset;
+        if (remainder > dropBytes) {
+            entry->mOffset += dropBytes;
+            droppedBytes += dropBytes;
+            break;
+        }
+
+        dropBytes -= remainder;
+        droppedBytes += remainder;
+        entry->mNotifyConsumed->post();
+        mAudioQueue.erase(mAudioQueue.begin());
+    }
+
+    ALOGV("dropped %zu bytes to catch up with common time", droppedBytes);
+}
+
+// Writes up to durationUs of silence, which delays the following audio.
+void NuPlayer::Renderer::insertSilenceUs(int64_t durationUs) {
+    int32_t sampleRate = mCurrentPcmInfo.mSampleRate;
+    size_t frameSize = mAudioSink->frameSize();
+    if (sampleRate <= 0 || frameSize == 0) {
+        return;
+    }
+
+    static const uint8_t kSilence[4096] = {};
+    size_t bytes = (size_t)(durationUs * sampleRate / 1000000ll) * frameSize;
+    while (bytes > 0) {
+        size_t copy = std::min(bytes, sizeof(kSilence) / frameSize * frameSize);
+        ssize_t written = mAudioSink->write(kSilence, copy, false /* blocking */);
+        if (written <= 0) {
+            break;
+        }
+        // the silence counts as written audio, so that the pending playout
+        // duration and the media clock anchors account for it.
+        mNumFramesWritten += written / frameSize;
+        bytes -= written;
+        if ((size_t)written != copy) {
+            break;
+        }
+    }
+}
+
 int32_t NuPlayer::Renderer::getQueueGeneration(bool audio) {
     Mutex::Autolock autoLock(mLock);
     return (audio ? mAudioQueueGeneration : mVideoQueueGeneration);
@@ -1864,12 +2160,27 @@ void NuPlayer::Renderer::onAudioTearDown(AudioTearDownReason reason) {
 void NuPlayer::Renderer::startAudioOffloadPauseTimeout() {
     if (offloadingAudio()) {
         int64_t pauseTimeOutDuration = property_get_int64(
-            "vendor.audio.offload.pstimeout.secs",(kOffloadPauseMaxUs/1000000)/*default*/);
+            "vendor.audio.offload.pstimeout.secs", -1 /* default */);
+        int64_t pauseTimeoutUs = pauseTimeOutDuration >= 0
+                ? pauseTimeOutDuration * 1000000 : getOffloadPauseTimeoutUs();
         mWakeLock->acquire();
         sp<AMessage> msg = new AMessage(kWhatAudioOffloadPauseTimeout, this);
         msg->setInt32("drainGeneration", mAudioOffloadPauseTimeoutGeneration);
-        msg->post(pauseTimeOutDuration*1000000);
+        msg->post(pauseTimeoutUs);
+    }
+}
+
+int64_t NuPlayer::Renderer::getOffloadPauseTimeoutUs() {
+    // The wake lock is held for as long as the timeout, while resuming after the
+    // tear down costs about one refill of the DSP buffer. Past the time that
+    // buffer takes to play, staying awake costs more than the refill.
+    size_t bufferSize = getOffloadBufferSize();
+    if (bufferSize == 0 || mCurrentOffloadInfo.bit_rate == 0) {
+        return kOffloadPauseMaxUs;
     }
+    int64_t bufferDurationUs =
+        (int64_t)bufferSize * 8000000ll / mCurrentOffloadInfo.bit_rate;
+    return std::min(std::max(bufferDurationUs, kOffloadPauseMinUs), kOffloadPauseMaxUs);
 }
 
 void NuPlayer::Renderer::cancelAudioOffloadPauseTimeout() {
@@ -26,6 +26,7 @@
 namespace android {
 
 class  AWakeLock;
+class CCHelper;
 struct MediaClock;
 class MediaCodecBuffer;
 struct VideoFrameScheduler;
@@ -57,6 +58,9 @@ struct NuPlayer::Renderer : public AHandler {
     status_t setSyncSettings(const AVSyncSettings &sync, float videoFpsHint);
     status_t getSyncSettings(AVSyncSettings *sync /* nonnull */, float *videoFps /* nonnull */);
 
+    // returns the number of video frames that were held off their cadence
+    status_t getNumJudderFrames(int64_t *numJudderFrames /* nonnull */);
+
     void flush(bool audio, bool notifyComplete);
 
     void signalTimeDiscontinuity();
@@ -69,9 +73,18 @@ struct NuPlayer::Renderer : public AHandler {
 
     void setVideoFrameRate(float fps);
 
+    // Presents mediaTimeUs at commonTimeUs on the network synchronized common clock,
+    // and keeps PCM audio aligned to it by adjusting the playback rate slightly, or by
+    // dropping or inserting audio for larger errors. Video follows the audio clock.
+    // A negative commonTimeUs disables common time playback.
+    void setCommonTimeAnchor(int64_t commonTimeUs, int64_t mediaTimeUs);
+
     status_t getCurrentPosition(int64_t *mediaUs);
     int64_t getVideoLateByUs();
 
+    // returns the size of the audio sink buffer in bytes when offloading, or 0
+    size_t getOffloadBufferSize();
+
     status_t openAudioSink(
             const sp<AMessage> &format,
             bool offloadOnly,
@@ -131,6 +144,8 @@ protected:
         kWhatDisableOffloadAudio = 'noOA',
         kWhatEnableOffloadAudio  = 'enOA',
         kWhatSetVideoFrameRate   = 'sVFR',
+        kWhatGetJudderFrames     = 'gJdF',
+        kWhatSetCommonTimeAnchor = 'sCTA',
     };
 
     // if mBuffer != nullptr, it's a buffer containing real data.
@@ -219,6 +234,14 @@ protected:
 
     sp<AWakeLock> mWakeLock;
 
+    // Common time playback, modified on only renderer's thread.
+    CCHelper *mCCHelper;
+    int64_t mCommonTimeAnchorUs;        // negative when disabled
+    int64_t mCommonTimeAnchorMediaUs;
+    bool mCommonTimeStartPending;       // the first audio write has not been scheduled yet
+    float mCommonTimeRateAdjust;        // relative correction applied on top of mPlaybackSettings
+    int64_t mNextCommonTimeCheckUs;
+
     status_t getCurrentPositionOnLooper(int64_t *mediaUs);
     status_t getCurrentPositionOnLooper(
             int64_t *mediaUs, int64_t nowUs, bool allowPastQueuedVideo = false);
@@ -262,6 +285,14 @@ protected:
     void onPause();
     void onResume();
     void onSetVideoFrameRate(float fps);
+    void onSetCommonTimeAnchor(int64_t commonTimeUs, int64_t mediaTimeUs);
+    bool isCommonTimeActive() const;
+    status_t getCommonTimeMediaUs(int64_t nowUs, int64_t *mediaUs);
+    bool scheduleCommonTimeStart();
+    void syncToCommonTime();
+    void setCommonTimeRateAdjust(float adjust);
+    void dropAudioUs(int64_t durationUs);
+    void insertSilenceUs(int64_t durationUs);
     int32_t getQueueGeneration(bool audio);
     int32_t getDrainGeneration(bool audio);
     bool getSyncQueues();
@@ -291,6 +322,7 @@ protected:
 
     void startAudioOffloadPauseTimeout();
     void cancelAudioOffloadPauseTimeout();
+    int64_t getOffloadPauseTimeoutUs();
 
     int64_t getDurationUsIfPlayedAtSampleRate(uint32_t numFrames);
 
@@ -132,6 +132,11 @@ struct NuPlayer::Source : public AHandler {
 
     virtual void setOffloadAudio(bool /* offload */) {}
 
+    // Returns source specific statistics for dumpsys, or NULL if none.
+    virtual sp<AMessage> getStats() const {
+        return NULL;
+    }
+
     // Modular DRM
     virtual status_t prepareDrm(
             const uint8_t /*uuid*/[16], const Vector<uint8_t> &/*drmSessionId*/,
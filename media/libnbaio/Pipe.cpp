@@ -37,6 +37,24 @@ Pipe::Pipe(size_t maxFrames, const NBAIO_Format& format, void *buffer) :
 {
 }
 
+Pipe::Pipe(size_t maxFrames, const NBAIO_Format& format, Shared *shared) :
+        NBAIO_Sink(format),
+        mMaxFrames(roundup(maxFrames)),
+        mBuffer(shared->mBuffer),
+        mFifo(mMaxFrames, Format_frameSize(format), mBuffer, shared->mRear,
+                NULL /*throttlesFront*/),
+        mFifoWriter(mFifo),
+        mReaders(0),
+        mFreeBufferInDestructor(false)
+{
+}
+
+// static
+size_t Pipe::sharedSize(size_t maxFrames, const NBAIO_Format& format)
+{
+    return sizeof(Shared) + roundup(maxFrames) * Format_frameSize(format);
+}
+
 Pipe::~Pipe()
 {
     ALOG_ASSERT(android_atomic_acquire_load(&mReaders) == 0);
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SharedPipeReader"
+//#define LOG_NDEBUG 0
+
+#include <cutils/compiler.h>
+#include <utils/Log.h>
+#include <media/nbaio/SharedPipeReader.h>
+#include <audio_utils/roundup.h>
+
+namespace android {
+
+SharedPipeReader::SharedPipeReader(size_t maxFrames, const NBAIO_Format& format,
+        Pipe::Shared *shared) :
+        NBAIO_Source(format),
+        mMaxFrames(roundup(maxFrames)),
+        mFifo(mMaxFrames, Format_frameSize(format), shared->mBuffer, shared->mRear,
+                NULL /*throttlesFront*/),
+        // the writer may have been running for a while, skip what it wrote so far
+        mFifoReader(mFifo, false /*throttlesWriter*/, true /*flush*/),
+        mFramesOverrun(0),
+        mOverruns(0)
+{
+}
+
+SharedPipeReader::~SharedPipeReader()
+{
+}
+
+ssize_t SharedPipeReader::checkOverrun(ssize_t ret, size_t lost)
+{
+    if (ret == -EOVERFLOW || lost > 0) {
+        mFramesOverrun += lost;
+        ++mOverruns;
+        ret = OVERRUN;
+    }
+    return ret;
+}
+
+ssize_t SharedPipeReader::availableToRead()
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    size_t lost;
+    return checkOverrun(mFifoReader.available(&lost), lost);
+}
+
+ssize_t SharedPipeReader::read(void *buffer, size_t count)
+{
+    size_t lost;
+    ssize_t actual = checkOverrun(mFifoReader.read(buffer, count, NULL /*timeout*/, &lost), lost);
+    ALOG_ASSERT(actual <= (ssize_t) count);
+    if (actual <= 0) {
+        return actual;
+    }
+    mFramesRead += (size_t) actual;
+    return actual;
+}
+
+ssize_t SharedPipeReader::flush()
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    size_t lost;
+    ssize_t flushed = checkOverrun(mFifoReader.flush(&lost), lost);
+    if (flushed <= 0) {
+        return flushed;
+    }
+    mFramesRead += (size_t) flushed;  // we consider flushed frames as read, but not lost frames
+    return flushed;
+}
+
+ssize_t SharedPipeReader::obtain(audio_utils_iovec iovec[2], size_t count)
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    size_t lost;
+    return checkOverrun(mFifoReader.obtain(iovec, count, NULL /*timeout*/, &lost), lost);
+}
+
+void SharedPipeReader::release(size_t count)
+{
+    mFifoReader.release(count);
+    mFramesRead += count;
+}
+
+}   // namespace android
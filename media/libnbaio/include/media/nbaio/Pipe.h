@@ -35,6 +35,24 @@ public:
     // which must be of size roundup(maxFrames) * Format_frameSize(format) bytes.
     Pipe(size_t maxFrames, const NBAIO_Format& format, void *buffer = NULL);
 
+    // Layout of a pipe in shared memory, so that readers in other processes can attach to it
+    // with SharedPipeReader. Must be POD.
+    // Exactly one process must explicitly call the constructor or use placement new.
+    struct Shared {
+        Shared() /* mRear initialized via default constructor */ { }
+        /*virtual*/ ~Shared() { }
+
+        audio_utils_fifo_index  mRear;      // index one frame past the end of most recent write
+        char                    mBuffer[0]; // roundup(maxFrames) frames
+    };
+
+    // Returns the number of bytes of shared memory needed for a Pipe of maxFrames in format.
+    static size_t sharedSize(size_t maxFrames, const NBAIO_Format& format);
+
+    // Same as above, but the buffer and write index are in shared memory, see Shared.
+    // shared must be at least sharedSize(maxFrames, format) bytes and is not freed by destructor.
+    Pipe(size_t maxFrames, const NBAIO_Format& format, Shared *shared);
+
     // If a buffer was specified in the constructor, it is not automatically freed by destructor.
     virtual ~Pipe();
 
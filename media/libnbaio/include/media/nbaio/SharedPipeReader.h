@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_SHARED_PIPE_READER_H
+#define ANDROID_AUDIO_SHARED_PIPE_READER_H
+
+#include "Pipe.h"
+
+namespace android {
+
+// SharedPipeReader reads a Pipe constructed on Pipe::Shared memory, possibly from another
+// process than the writer. As for PipeReader, the writer is never throttled and data not read
+// quickly enough is lost. It is safe for only a single thread.
+class SharedPipeReader : public NBAIO_Source {
+
+public:
+
+    // maxFrames and format must be those the Pipe was constructed with, and shared the mapping
+    // of the same Pipe::Shared. Reading starts at the most recent write.
+    SharedPipeReader(size_t maxFrames, const NBAIO_Format& format, Pipe::Shared *shared);
+    virtual ~SharedPipeReader();
+
+    // NBAIO_Port interface
+
+    //virtual ssize_t negotiate(const NBAIO_Format offers[], size_t numOffers,
+    //                          NBAIO_Format counterOffers[], size_t& numCounterOffers);
+    //virtual NBAIO_Format format() const;
+
+    // NBAIO_Source interface
+
+    //virtual size_t framesRead() const;
+    virtual int64_t framesOverrun() { return mFramesOverrun; }
+    virtual int64_t overruns()  { return mOverruns; }
+
+    virtual ssize_t availableToRead();
+
+    virtual ssize_t read(void *buffer, size_t count);
+
+    virtual ssize_t flush();
+
+    // NBAIO_Source end
+
+    // Zero copy alternative to read(): up to count frames are made available in place in the
+    // shared buffer, as at most 2 regions because of wraparound. Returns the number of frames
+    // obtained or a negative error as for read(). The frames must be released before the
+    // next call, and are reported as read on release.
+    ssize_t obtain(audio_utils_iovec iovec[2], size_t count);
+    void    release(size_t count);
+
+private:
+    ssize_t     checkOverrun(ssize_t ret, size_t lost);
+
+    const size_t    mMaxFrames;     // always a power of 2
+    audio_utils_fifo        mFifo;
+    audio_utils_fifo_reader mFifoReader;
+    int64_t     mFramesOverrun;
+    int64_t     mOverruns;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_SHARED_PIPE_READER_H
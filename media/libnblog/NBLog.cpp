@@ -32,6 +32,7 @@
 #include <string.h>
 #include <sys/prctl.h>
 #include <time.h>
+#include <unistd.h>
 #include <new>
 #include <audio_utils/roundup.h>
 #include <media/nblog/NBLog.h>
@@ -809,6 +810,8 @@ void NBLog::MergeReader::getAndProcessSnapshot(NBLog::Reader::Snapshot &snapshot
 {
     String8 timestamp, body;
 
+    retainForExport(snapshot);
+
     for (auto entry = snapshot.begin(); entry != snapshot.end();) {
         switch (entry->type) {
         case EVENT_START_FMT:
@@ -870,6 +873,61 @@ void NBLog::MergeReader::dump(int fd, int indent) {
     ReportPerformance::dump(fd, indent, mThreadPerformanceAnalysis);
 }
 
+constexpr char NBLog::MergeReader::kExportMagic[4];
+
+void NBLog::MergeReader::retainForExport(Snapshot &snapshot)
+{
+    const uint8_t *begin = snapshot.begin();
+    const uint8_t *end = snapshot.end();
+    if (begin == nullptr || end <= begin) {
+        return;
+    }
+    std::vector<uint8_t> chunk(begin, end);
+    AutoMutex _l(mExportLock);
+    mExportSize += chunk.size();
+    mExportChunks.push_back(std::move(chunk));
+    // snapshots start and end on entry boundaries, so dropping whole ones keeps the rest valid
+    while (mExportSize > kExportBufferSize && mExportChunks.size() > 1) {
+        mExportSize -= mExportChunks.front().size();
+        mExportChunks.pop_front();
+    }
+}
+
+void NBLog::MergeReader::dumpBinary(int fd)
+{
+    std::vector<uint8_t> out(kExportMagic, kExportMagic + sizeof(kExportMagic));
+    auto append = [&out](const void *data, size_t size) {
+        const uint8_t *bytes = (const uint8_t *) data;
+        out.insert(out.end(), bytes, bytes + size);
+    };
+    append(&kExportVersion, sizeof(kExportVersion));
+
+    // FIXME Needs a lock, as for handleAuthor()
+    const uint32_t authors = mNamedReaders.size();
+    append(&authors, sizeof(authors));
+    for (const auto &namedReader : mNamedReaders) {
+        const uint8_t length = strnlen(namedReader.name(), UINT8_MAX);
+        append(&length, sizeof(length));
+        append(namedReader.name(), length);
+    }
+
+    AutoMutex _l(mExportLock);
+    const uint32_t size = mExportSize;
+    append(&size, sizeof(size));
+    for (const auto &chunk : mExportChunks) {
+        append(chunk.data(), chunk.size());
+    }
+
+    for (size_t written = 0; written < out.size(); ) {
+        const ssize_t ret = write(fd, out.data() + written, out.size() - written);
+        if (ret <= 0) {
+            ALOGW("dumpBinary failed after %zu of %zu bytes", written, out.size());
+            break;
+        }
+        written += ret;
+    }
+}
+
 // Writes a string to the console
 void NBLog::Reader::dumpLine(const String8 &timestamp, String8 &body)
 {
@@ -1099,7 +1157,7 @@ const std::vector<NBLog::NamedReader>& NBLog::Merger::getNamedReaders() const {
 // ---------------------------------------------------------------------------
 
 NBLog::MergeReader::MergeReader(const void *shared, size_t size, Merger &merger)
-    : Reader(shared, size), mNamedReaders(merger.getNamedReaders()) {}
+    : Reader(shared, size), mNamedReaders(merger.getNamedReaders()), mExportSize(0) {}
 
 void NBLog::MergeReader::handleAuthor(const NBLog::AbstractEntry &entry, String8 *body) {
     int author = entry.author();
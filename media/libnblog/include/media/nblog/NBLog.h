@@ -537,6 +537,21 @@ public:
         MergeReader(const void *shared, size_t size, Merger &merger);
 
         void dump(int fd, int indent = 0);
+
+        // Write the most recent merged entries as they are, for offline analysis by
+        // tools/nblog_analyzer. All values are in host byte order:
+        //    * kExportMagic, 4 bytes
+        //    * kExportVersion, uint32_t
+        //    * number of authors, uint32_t
+        //    * for each author in author index order: name length, uint8_t, then the name
+        //      without NUL terminator
+        //    * length of the entries in bytes, uint32_t
+        //    * the entries, in the merged log representation described above
+        void dumpBinary(int fd);
+
+        static constexpr char     kExportMagic[4] = {'N', 'B', 'L', 'G'};
+        static const uint32_t     kExportVersion = 1;
+
         // process a particular snapshot of the reader
         void getAndProcessSnapshot(Snapshot & snap);
         // call getSnapshot of the content of the reader's buffer and process the data
@@ -555,6 +570,16 @@ public:
         // handle author entry by looking up the author's name and appending it to the body
         // returns number of bytes read from fmtEntry
         void handleAuthor(const AbstractEntry &fmtEntry, String8 *body);
+
+        // keep the entries of a snapshot for dumpBinary(), dropping the oldest snapshots
+        // once more than kExportBufferSize bytes are kept
+        void retainForExport(Snapshot &snapshot);
+
+        static const size_t kExportBufferSize = 256 * 1024;
+
+        Mutex                              mExportLock;    // protects the following
+        std::deque<std::vector<uint8_t>>   mExportChunks;  // whole entries of each snapshot
+        size_t                             mExportSize;    // total bytes in mExportChunks
     };
 
     // MergeThread is a thread that contains a Merger. It works as a retriggerable one-shot:
@@ -495,6 +495,11 @@ private:
 ////////////////////////////////////////////////////////////////////////////////
 
 struct ACodec::FlushingState : public ACodec::BaseState {
+    // fewest output buffers the component must have after a flush for us
+    // to leave the rest with the native window
+    static const size_t kMinOutputBuffersToDeferReclaim = 2;
+
+
     explicit FlushingState(ACodec *codec);
 
 protected:
@@ -509,6 +514,10 @@ protected:
 private:
     bool mFlushComplete[2];
 
+    // when the flush started, and when the component finished flushing both ports
+    int64_t mStartTimeUs;
+    int64_t mPortsFlushedTimeUs;
+
     void changeStateIfWeOwnAllBuffers();
 
     DISALLOW_EVIL_CONSTRUCTORS(FlushingState);
@@ -569,6 +578,7 @@ ACodec::ACodec()
       mDequeueCounter(0),
       mMetadataBuffersToSubmit(0),
       mNumUndequeuedBuffers(0),
+      mDeferredNativeWindowReclaim(false),
       mRepeatFrameDelayUs(-1ll),
       mMaxPtsGapUs(0ll),
       mMaxFps(-1),
@@ -904,6 +914,12 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
                     conversionBufferSize = converter->sourceSize(bufSize);
                 } else {
                     conversionBufferSize = converter->targetSize(bufSize);
+                    if (conversionBufferSize <= bufSize) {
+                        // narrowing output conversions are done in place in
+                        // the codec buffer, which is then handed out as is
+                        converter = NULL;
+                        conversionBufferSize = 0;
+                    }
                 }
             }
 
@@ -1007,7 +1023,7 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
 
                     // if we require conversion, allocate conversion buffer for client use;
                     // otherwise, reuse codec buffer
-                    if (mConverter[portIndex] != NULL) {
+                    if (converter != NULL) {
                         CHECK_GT(conversionBufferSize, (size_t)0);
                         bool success;
                         mAllocator[portIndex]->allocate(
@@ -4875,6 +4891,32 @@ void ACodec::waitUntilAllPossibleNativeWindowBuffersAreReturnedToUs() {
     }
 }
 
+void ACodec::reclaimDeferredNativeWindowBuffer() {
+    if (!mDeferredNativeWindowReclaim) {
+        return;
+    }
+
+    if (mNativeWindow == NULL
+            || countBuffersOwnedByNativeWindow() <= mNumUndequeuedBuffers) {
+        mDeferredNativeWindowReclaim = false;
+        return;
+    }
+
+    BufferInfo *info = dequeueBufferFromNativeWindow();
+    if (info == NULL) {
+        mDeferredNativeWindowReclaim = false;
+        return;
+    }
+
+    ALOGV("[%s] calling fillBuffer %u for reclaimed buffer",
+            mComponentName.c_str(), info->mBufferID);
+    info->checkWriteFence("reclaimDeferredNativeWindowBuffer");
+    status_t err = fillBuffer(info);
+    if (err != OK) {
+        signalError(OMX_ErrorUndefined, makeNoSideEffectStatus(err));
+    }
+}
+
 bool ACodec::allYourBuffersAreBelongToUs(
         OMX_U32 portIndex) {
     for (size_t i = 0; i < mBuffers[portIndex].size(); ++i) {
@@ -6206,6 +6248,14 @@ bool ACodec::BaseState::onOMXFillBufferDone(
                 buffer->meta()->setInt32("rangeLength", rangeLength);
             } else if (buffer->base() == info->mCodecData->base()) {
                 buffer->setRange(rangeOffset, rangeLength);
+                const sp<DataConverter> &converter = mCodec->mConverter[kPortIndexOutput];
+                if (converter != NULL && converter->targetSize(rangeLength) <= rangeLength) {
+                    status_t err = converter->convertInPlace(buffer);
+                    if (err != OK) {
+                        mCodec->signalError(OMX_ErrorUndefined, makeNoSideEffectStatus(err));
+                        return true;
+                    }
+                }
             } else {
                 info->mCodecData->setRange(rangeOffset, rangeLength);
                 // in this case we know that mConverter is not null
@@ -6398,6 +6448,10 @@ void ACodec::BaseState::onOutputBufferDrained(const sp<AMessage> &msg) {
                         mCodec->signalError(OMX_ErrorUndefined, makeNoSideEffectStatus(err));
                     }
                 }
+
+                // Catch up on the buffers a flush left with the native window,
+                // one per drained frame.
+                mCodec->reclaimDeferredNativeWindowBuffer();
             }
             break;
         }
@@ -7243,6 +7297,7 @@ bool ACodec::ExecutingState::onMessageReceived(const sp<AMessage> &msg) {
                     mCodec->mBuffers[kPortIndexOutput].size());
 
             mActive = false;
+            mCodec->mDeferredNativeWindowReclaim = false;
 
             status_t err = mCodec->mOMXNode->sendCommand(OMX_CommandFlush, OMX_ALL);
             if (err != OK) {
@@ -7884,6 +7939,7 @@ bool ACodec::ExecutingState::onOMXEvent(
 
             if (data2 == 0 || data2 == OMX_IndexParamPortDefinition) {
                 mCodec->mMetadataBuffersToSubmit = 0;
+                mCodec->mDeferredNativeWindowReclaim = false;
                 CHECK_EQ(mCodec->mOMXNode->sendCommand(
                             OMX_CommandPortDisable, kPortIndexOutput),
                          (status_t)OK);
@@ -8251,6 +8307,8 @@ void ACodec::FlushingState::stateEntered() {
     ALOGV("[%s] Now Flushing", mCodec->mComponentName.c_str());
 
     mFlushComplete[kPortIndexInput] = mFlushComplete[kPortIndexOutput] = false;
+    mStartTimeUs = ALooper::GetNowUs();
+    mPortsFlushedTimeUs = -1;
 }
 
 bool ACodec::FlushingState::onMessageReceived(const sp<AMessage> &msg) {
@@ -8317,6 +8375,7 @@ bool ACodec::FlushingState::onOMXEvent(
                 mFlushComplete[data2] = true;
 
                 if (mFlushComplete[kPortIndexInput] && mFlushComplete[kPortIndexOutput]) {
+                    mPortsFlushedTimeUs = ALooper::GetNowUs();
                     changeStateIfWeOwnAllBuffers();
                 }
             } else if (data2 == OMX_ALL) {
@@ -8375,9 +8434,33 @@ void ACodec::FlushingState::changeStateIfWeOwnAllBuffers() {
     if (mFlushComplete[kPortIndexInput]
             && mFlushComplete[kPortIndexOutput]
             && mCodec->allYourBuffersAreBelongToUs()) {
+        int64_t buffersReturnedTimeUs = ALooper::GetNowUs();
+
         // We now own all buffers except possibly those still queued with
-        // the native window for rendering. Let's get those back as well.
-        mCodec->waitUntilAllPossibleNativeWindowBuffersAreReturnedToUs();
+        // the native window for rendering. Those hold frames from before
+        // the flush, and waiting for the window to release them delays the
+        // first frames after a seek. As long as the component has enough
+        // buffers to decode into, leave them attached and take them back
+        // one by one as output is drained.
+        size_t ownedByUs = mCodec->mBuffers[kPortIndexOutput].size()
+                - mCodec->countBuffersOwnedByNativeWindow();
+        if (mCodec->mNativeWindow != NULL
+                && !mCodec->storingMetadataInDecodedBuffers()
+                && ownedByUs >= kMinOutputBuffersToDeferReclaim) {
+            mCodec->mDeferredNativeWindowReclaim = true;
+        } else {
+            mCodec->waitUntilAllPossibleNativeWindowBuffersAreReturnedToUs();
+        }
+
+        int64_t nowUs = ALooper::GetNowUs();
+        int64_t portsFlushedTimeUs =
+            mPortsFlushedTimeUs >= 0 ? mPortsFlushedTimeUs : buffersReturnedTimeUs;
+        sp<AMessage> phases = new AMessage;
+        phases->setInt64("ports-flushed-us", portsFlushedTimeUs - mStartTimeUs);
+        phases->setInt64("buffers-returned-us", buffersReturnedTimeUs - portsFlushedTimeUs);
+        phases->setInt64("surface-reclaimed-us", nowUs - buffersReturnedTimeUs);
+        phases->setInt64("total-us", nowUs - mStartTimeUs);
+        mCodec->mCallback->onFlushPhasesMeasured(phases);
 
         mCodec->mRenderTracker.clear(systemTime(CLOCK_MONOTONIC));
 
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AsyncChunkWriter"
+#include <utils/Log.h>
+
+#include "include/AsyncChunkWriter.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaErrors.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace android {
+
+AsyncChunkWriter::AsyncChunkWriter(int fd, size_t maxPendingBytes)
+    : mFd(fd),
+      mMaxPendingBytes(maxPendingBytes),
+      mStagingOffset(0),
+      mPendingBytes(0),
+      mWriting(false),
+      mDone(false),
+      mError(OK),
+      mThreadStarted(false),
+      mPreallocate(true),
+      mAllocatedEnd(-1) {
+    if (mMaxPendingBytes < kBufferSize) {
+        mMaxPendingBytes = kBufferSize;
+    }
+}
+
+AsyncChunkWriter::~AsyncChunkWriter() {
+    stop();
+}
+
+status_t AsyncChunkWriter::start() {
+    if (mThreadStarted) {
+        return INVALID_OPERATION;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    int res = pthread_create(&mThread, &attr, ThreadWrapper, this);
+    pthread_attr_destroy(&attr);
+
+    if (res != 0) {
+        ALOGE("failed to start the writer thread (%d)", res);
+        return -res;
+    }
+
+    mThreadStarted = true;
+    return OK;
+}
+
+status_t AsyncChunkWriter::stop() {
+    if (!mThreadStarted) {
+        return OK;
+    }
+
+    status_t err = flush();
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mDone = true;
+        mCondition.broadcast();
+    }
+
+    void *dummy;
+    pthread_join(mThread, &dummy);
+    mThreadStarted = false;
+
+    if (mAllocatedEnd >= 0) {
+        // Blocks allocated past the end of the file stay allocated until
+        // it is truncated.
+        struct stat64 st;
+        if (fstat64(mFd, &st) == 0) {
+            ftruncate64(mFd, st.st_size);
+        }
+        mAllocatedEnd = -1;
+    }
+
+    return err;
+}
+
+void AsyncChunkWriter::write(off64_t offset, const void *data, size_t size) {
+    const uint8_t *ptr = (const uint8_t *)data;
+
+    while (size > 0) {
+        if (mStaging != NULL
+                && mStagingOffset + (off64_t)mStaging->size() != offset) {
+            submitStaging();
+        }
+
+        if (mStaging == NULL) {
+            mStaging = acquireBuffer();
+            mStagingOffset = offset;
+        }
+
+        size_t copy = mStaging->capacity() - mStaging->size();
+        if (copy > size) {
+            copy = size;
+        }
+
+        memcpy(mStaging->data() + mStaging->size(), ptr, copy);
+        mStaging->setRange(0, mStaging->size() + copy);
+
+        ptr += copy;
+        offset += copy;
+        size -= copy;
+
+        if (mStaging->size() == mStaging->capacity()) {
+            submitStaging();
+        }
+    }
+}
+
+status_t AsyncChunkWriter::flush() {
+    submitStaging();
+
+    Mutex::Autolock autoLock(mLock);
+    while (!mQueue.empty() || mWriting) {
+        mCondition.wait(mLock);
+    }
+
+    return mError;
+}
+
+sp<ABuffer> AsyncChunkWriter::acquireBuffer() {
+    sp<ABuffer> buffer;
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (!mFreeBuffers.isEmpty()) {
+            buffer = mFreeBuffers.top();
+            mFreeBuffers.pop();
+        }
+    }
+
+    if (buffer == NULL) {
+        buffer = new ABuffer(kBufferSize);
+    }
+    buffer->setRange(0, 0);
+
+    return buffer;
+}
+
+void AsyncChunkWriter::submitStaging() {
+    if (mStaging == NULL) {
+        return;
+    }
+
+    if (mStaging->size() == 0) {
+        mStaging.clear();
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    while (mPendingBytes > 0
+            && mPendingBytes + mStaging->size() > mMaxPendingBytes) {
+        ALOGV("%zu bytes pending, waiting for the writer", mPendingBytes);
+        mCondition.wait(mLock);
+    }
+
+    Request request;
+    request.mOffset = mStagingOffset;
+    request.mBuffer = mStaging;
+    mQueue.push_back(request);
+
+    mPendingBytes += mStaging->size();
+    mCondition.broadcast();
+
+    mStaging.clear();
+}
+
+void AsyncChunkWriter::preallocate(off64_t offset, size_t size) {
+    if (!mPreallocate) {
+        return;
+    }
+
+    if (mAllocatedEnd < 0) {
+        mAllocatedEnd = offset;
+    }
+
+    if (offset + (off64_t)size <= mAllocatedEnd) {
+        return;
+    }
+
+    // Reserving the space in large extents up front avoids allocating
+    // blocks with every write and keeps the file contiguous.
+    off64_t end = offset + size + kPreallocateBytes;
+    if (fallocate64(mFd, FALLOC_FL_KEEP_SIZE, mAllocatedEnd, end - mAllocatedEnd) < 0) {
+        ALOGV("not preallocating (%s)", strerror(errno));
+        mPreallocate = false;
+        return;
+    }
+
+    mAllocatedEnd = end;
+}
+
+status_t AsyncChunkWriter::writeFully(
+        off64_t offset, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = pwrite64(mFd, data, size, offset);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            ALOGE("failed to write %zu bytes at %lld (%s)",
+                    size, (long long)offset, n < 0 ? strerror(errno) : "EOF");
+            return n < 0 ? -errno : ERROR_IO;
+        }
+
+        data += n;
+        offset += n;
+        size -= n;
+    }
+
+    return OK;
+}
+
+// static
+void *AsyncChunkWriter::ThreadWrapper(void *me) {
+    static_cast<AsyncChunkWriter *>(me)->threadFunc();
+    return NULL;
+}
+
+void AsyncChunkWriter::threadFunc() {
+    prctl(PR_SET_NAME, (unsigned long)"AsyncChunkWriter", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        while (mQueue.empty() && !mDone) {
+            mCondition.wait(mLock);
+        }
+
+        if (mQueue.empty()) {
+            break;
+        }
+
+        Request request = *mQueue.begin();
+        mQueue.erase(mQueue.begin());
+        mWriting = true;
+
+        mLock.unlock();
+
+        const sp<ABuffer> &buffer = request.mBuffer;
+        preallocate(request.mOffset, buffer->size());
+        status_t err = writeFully(request.mOffset, buffer->data(), buffer->size());
+
+        mLock.lock();
+
+        mWriting = false;
+        mPendingBytes -= buffer->size();
+        if (err != OK && mError == OK) {
+            mError = err;
+        }
+
+        if (mFreeBuffers.size() * kBufferSize < mMaxPendingBytes) {
+            mFreeBuffers.push(buffer);
+        }
+
+        mCondition.broadcast();
+    }
+}
+
+}  // namespace android
@@ -226,7 +226,9 @@ CameraSource::CameraSource(
       mNumFramesDropped(0),
       mNumGlitches(0),
       mGlitchDurationThresholdUs(200000),
-      mCollectStats(false) {
+      mCollectStats(false),
+      mTotalEncodeLatencyUs(0),
+      mMaxEncodeLatencyUs(0) {
     mVideoSize.width  = -1;
     mVideoSize.height = -1;
 
@@ -738,7 +740,16 @@ status_t CameraSource::startCameraRecording() {
     int64_t token = IPCThreadState::self()->clearCallingIdentity();
     status_t err;
 
-    if (mVideoBufferMode == hardware::ICamera::VIDEO_BUFFER_MODE_BUFFER_QUEUE) {
+    if (mVideoBufferMode == hardware::ICamera::VIDEO_BUFFER_MODE_BUFFER_QUEUE
+            && mEncoderInputSurface != NULL) {
+        // Frames go straight from the camera to the encoder.
+        err = mCamera->setVideoTarget(mEncoderInputSurface);
+        if (err != OK) {
+            ALOGE("%s: Failed to set encoder input surface as video target: %s (err=%d)",
+                    __FUNCTION__, strerror(-err), err);
+            return err;
+        }
+    } else if (mVideoBufferMode == hardware::ICamera::VIDEO_BUFFER_MODE_BUFFER_QUEUE) {
         // Initialize buffer queue.
         err = initBufferQueue(mVideoSize.width, mVideoSize.height, mEncoderFormat,
                 (android_dataspace_t)mEncoderDataSpace,
@@ -922,6 +933,10 @@ status_t CameraSource::reset() {
             ALOGI("Frames received/encoded/dropped: %d/%d/%d in %" PRId64 " us",
                     mNumFramesReceived, mNumFramesEncoded, mNumFramesDropped,
                     mLastFrameTimestampUs - mFirstFrameTimeUs);
+            if (mNumFramesEncoded > 0) {
+                ALOGI("Capture-to-encode latency avg/max: %" PRId64 "/%" PRId64 " us",
+                        mTotalEncodeLatencyUs / mNumFramesEncoded, mMaxEncodeLatencyUs);
+            }
         }
 
         if (mNumGlitches > 0) {
@@ -939,6 +954,7 @@ status_t CameraSource::reset() {
 
     mVideoBufferConsumer.clear();
     mVideoBufferProducer.clear();
+    mEncoderInputSurface.clear();
     releaseCamera();
 
     ALOGD("reset: X");
@@ -1064,6 +1080,20 @@ void CameraSource::signalBufferReturned(MediaBufferBase *buffer) {
             releaseOneRecordingFrame((*it));
             mFramesBeingEncoded.erase(it);
             ++mNumFramesEncoded;
+
+            // kKeyTime is the capture time shifted by the initial delay
+            int64_t frameTimeUs;
+            if (buffer->meta_data().findInt64(kKeyTime, &frameTimeUs)) {
+                int64_t latencyUs = systemTime() / 1000
+                        - (frameTimeUs - mStartTimeUs + mFirstFrameTimeUs);
+                if (latencyUs >= 0) {
+                    mTotalEncodeLatencyUs += latencyUs;
+                    if (latencyUs > mMaxEncodeLatencyUs) {
+                        mMaxEncodeLatencyUs = latencyUs;
+                    }
+                    ALOGV("capture-to-encode latency %" PRId64 " us", latencyUs);
+                }
+            }
             buffer->setObserver(0);
             buffer->release();
             mFrameCompleteCondition.signal();
@@ -1085,6 +1115,11 @@ status_t CameraSource::read(
         return ERROR_UNSUPPORTED;
     }
 
+    if (mEncoderInputSurface != NULL) {
+        // frames are delivered to the encoder's input surface instead
+        return ERROR_UNSUPPORTED;
+    }
+
     sp<IMemory> frame;
     int64_t frameTime;
 
@@ -1120,6 +1155,17 @@ status_t CameraSource::read(
     return OK;
 }
 
+status_t CameraSource::setEncoderInputSurface(const sp<IGraphicBufferProducer>& surface) {
+    Mutex::Autolock autoLock(mLock);
+    if (mStarted || surface == NULL
+            || mVideoBufferMode != hardware::ICamera::VIDEO_BUFFER_MODE_BUFFER_QUEUE) {
+        return INVALID_OPERATION;
+    }
+
+    mEncoderInputSurface = surface;
+    return OK;
+}
+
 status_t CameraSource::setStopTimeUs(int64_t stopTimeUs) {
     Mutex::Autolock autoLock(mLock);
     ALOGV("Set stoptime: %lld us", (long long)stopTimeUs);
@@ -46,12 +46,29 @@ status_t DataConverter::convert(const sp<MediaCodecBuffer> &source, sp<MediaCode
     return err;
 }
 
+status_t DataConverter::convertInPlace(const sp<MediaCodecBuffer> &buffer) {
+    size_t size = targetSize(buffer->size());
+    status_t err = OK;
+    if (size > buffer->size()) {
+        ALOGE("converted size (%zu) is greater than data size (%zu)", size, buffer->size());
+        err = INVALID_OPERATION;
+    } else {
+        err = safeConvertInPlace(buffer);
+    }
+    buffer->setRange(buffer->offset(), err == OK ? size : 0);
+    return err;
+}
+
 status_t DataConverter::safeConvert(
         const sp<MediaCodecBuffer> &source, sp<MediaCodecBuffer> &target) {
     memcpy(target->base(), source->data(), source->size());
     return OK;
 }
 
+status_t DataConverter::safeConvertInPlace(const sp<MediaCodecBuffer> & /* buffer */) {
+    return OK;
+}
+
 size_t DataConverter::sourceSize(size_t targetSize) {
     return targetSize;
 }
@@ -132,18 +149,26 @@ AudioConverter* AudioConverter::Create(AudioEncoding source, AudioEncoding targe
 }
 
 status_t AudioConverter::safeConvert(const sp<MediaCodecBuffer> &src, sp<MediaCodecBuffer> &tgt) {
+    return convertSamples(tgt->base(), src->data(), src->size());
+}
+
+status_t AudioConverter::safeConvertInPlace(const sp<MediaCodecBuffer> &buffer) {
+    return convertSamples(buffer->data(), buffer->data(), buffer->size());
+}
+
+status_t AudioConverter::convertSamples(void *dst, const void *src, size_t size) {
     if (mTo == kAudioEncodingPcm8bit && mFrom == kAudioEncodingPcm16bit) {
-        memcpy_to_u8_from_i16((uint8_t*)tgt->base(), (const int16_t*)src->data(), src->size() / 2);
+        memcpy_to_u8_from_i16((uint8_t*)dst, (const int16_t*)src, size / 2);
     } else if (mTo == kAudioEncodingPcm8bit && mFrom == kAudioEncodingPcmFloat) {
-        memcpy_to_u8_from_float((uint8_t*)tgt->base(), (const float*)src->data(), src->size() / 4);
+        memcpy_to_u8_from_float((uint8_t*)dst, (const float*)src, size / 4);
     } else if (mTo == kAudioEncodingPcm16bit && mFrom == kAudioEncodingPcm8bit) {
-        memcpy_to_i16_from_u8((int16_t*)tgt->base(), (const uint8_t*)src->data(), src->size());
+        memcpy_to_i16_from_u8((int16_t*)dst, (const uint8_t*)src, size);
     } else if (mTo == kAudioEncodingPcm16bit && mFrom == kAudioEncodingPcmFloat) {
-        memcpy_to_i16_from_float((int16_t*)tgt->base(), (const float*)src->data(), src->size() / 4);
+        memcpy_to_i16_from_float((int16_t*)dst, (const float*)src, size / 4);
     } else if (mTo == kAudioEncodingPcmFloat && mFrom == kAudioEncodingPcm8bit) {
-        memcpy_to_float_from_u8((float*)tgt->base(), (const uint8_t*)src->data(), src->size());
+        memcpy_to_float_from_u8((float*)dst, (const uint8_t*)src, size);
     } else if (mTo == kAudioEncodingPcmFloat && mFrom == kAudioEncodingPcm16bit) {
-        memcpy_to_float_from_i16((float*)tgt->base(), (const int16_t*)src->data(), src->size() / 2);
+        memcpy_to_float_from_i16((float*)dst, (const int16_t*)src, size / 2);
     } else {
         audio_format_t srcFormat = getAudioFormat(mFrom);
         audio_format_t dstFormat = getAudioFormat(mTo);
@@ -151,9 +176,8 @@ status_t AudioConverter::safeConvert(const sp<MediaCodecBuffer> &src, sp<MediaCo
         if ((srcFormat == AUDIO_FORMAT_INVALID) || (dstFormat == AUDIO_FORMAT_INVALID))
             return INVALID_OPERATION;
 
-        size_t frames = src->size() / audio_bytes_per_sample(srcFormat);
-        memcpy_by_audio_format((void*)tgt->base(), dstFormat, (void*)src->data(),
-                srcFormat, frames);
+        size_t frames = size / audio_bytes_per_sample(srcFormat);
+        memcpy_by_audio_format(dst, dstFormat, src, srcFormat, frames);
     }
     return OK;
 }
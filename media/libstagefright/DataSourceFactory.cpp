@@ -19,6 +19,7 @@
 #include "include/HTTPBase.h"
 #include "include/NuCachedSource2.h"
 
+#include <cutils/properties.h>
 #include <media/MediaHTTPConnection.h>
 #include <media/MediaHTTPService.h>
 #include <media/stagefright/DataSourceFactory.h>
@@ -29,6 +30,11 @@
 
 namespace android {
 
+// Number of additional connections NuCachedSource2 uses to fetch ranges
+// ahead of the read position, 0 to use only one connection.
+static const char *kPropCacheRangeConnections = "media.stagefright.cache-range-connections";
+static const int32_t kMaxCacheRangeConnections = 4;
+
 // static
 sp<DataSource> DataSourceFactory::CreateFromURI(
         const sp<MediaHTTPService> &httpService,
@@ -78,10 +84,29 @@ sp<DataSource> DataSourceFactory::CreateFromURI(
             *contentType = httpSource->getMIMEType();
         }
 
-        source = NuCachedSource2::Create(
+        sp<NuCachedSource2> cachedSource = NuCachedSource2::Create(
                 httpSource,
                 cacheConfig.isEmpty() ? NULL : cacheConfig.string(),
                 disconnectAtHighwatermark);
+
+        int32_t numRangeConnections = property_get_int32(kPropCacheRangeConnections, 0);
+        if (numRangeConnections > kMaxCacheRangeConnections) {
+            numRangeConnections = kMaxCacheRangeConnections;
+        }
+        for (int32_t i = 0; i < numRangeConnections && !disconnectAtHighwatermark; ++i) {
+            sp<MediaHTTPConnection> conn = httpService->makeHTTPConnection();
+            if (conn == NULL) {
+                break;
+            }
+            sp<HTTPBase> rangeSource = new MediaHTTP(conn);
+            if (rangeSource->connect(uri, &nonCacheSpecificHeaders) != OK) {
+                ALOGW("Failed to connect additional http source!");
+                break;
+            }
+            cachedSource->addRangeSource(rangeSource);
+        }
+
+        source = cachedSource;
     } else if (!strncasecmp("data:", uri, 5)) {
         source = DataURISource::Create(uri);
     } else {
@@ -19,6 +19,7 @@
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/base64.h>
+#include <media/stagefright/MediaErrors.h>
 
 namespace android {
 
@@ -34,28 +35,9 @@ sp<DataURISource> DataURISource::Create(const char *uri) {
         return NULL;
     }
 
-    sp<ABuffer> buffer;
-
     AString tmp(&uri[5], commaPos - &uri[5]);
 
-    if (tmp.endsWith(";base64")) {
-        AString encoded(commaPos + 1);
-
-        // Strip CR and LF...
-        for (size_t i = encoded.size(); i > 0;) {
-            i--;
-            if (encoded.c_str()[i] == '\r' || encoded.c_str()[i] == '\n') {
-                encoded.erase(i, 1);
-            }
-        }
-
-        buffer = decodeBase64(encoded);
-
-        if (buffer == NULL) {
-            ALOGE("Malformed base64 encoded content found.");
-            return NULL;
-        }
-    } else {
+    if (!tmp.endsWith(";base64")) {
 #if 0
         size_t dataLen = strlen(uri) - tmp.size() - 6;
         buffer = new ABuffer(dataLen);
@@ -69,13 +51,51 @@ sp<DataURISource> DataURISource::Create(const char *uri) {
 #endif
     }
 
+    const char *data = commaPos + 1;
+    size_t dataLen = strlen(data);
+
+    // Strip CR and LF...
+    AString encoded;
+    if (strpbrk(data, "\r\n") == NULL) {
+        encoded.setTo(data, dataLen);
+    } else {
+        char *stripped = new char[dataLen];
+        size_t n = 0;
+        for (size_t i = 0; i < dataLen; ++i) {
+            if (data[i] != '\r' && data[i] != '\n') {
+                stripped[n++] = data[i];
+            }
+        }
+        encoded.setTo(stripped, n);
+        delete[] stripped;
+    }
+
+    // The payload itself is only decoded as it is read, see readAt().
+    size_t n = encoded.size();
+    if ((n % 4) != 0) {
+        ALOGE("Malformed base64 encoded content found.");
+        return NULL;
+    }
+
+    size_t padding = 0;
+    while (padding < 3 && padding < n && encoded.c_str()[n - 1 - padding] == '=') {
+        ++padding;
+    }
+
     // We don't really care about charset or mime type.
 
-    return new DataURISource(buffer);
+    return new DataURISource(encoded, (n / 4) * 3 - padding);
 }
 
-DataURISource::DataURISource(const sp<ABuffer> &buffer)
-    : mBuffer(buffer) {
+DataURISource::DataURISource(const AString &encoded, size_t decodedSize)
+    : mEncoded(encoded),
+      mDecodedSize(decodedSize),
+      mBlockOffset(-1) {
+    size_t blockSize = kDecodedBlockSize;
+    if (blockSize > decodedSize) {
+        blockSize = decodedSize;
+    }
+    mBlock = new ABuffer(blockSize);
 }
 
 DataURISource::~DataURISource() {
@@ -86,22 +106,65 @@ status_t DataURISource::initCheck() const {
 }
 
 ssize_t DataURISource::readAt(off64_t offset, void *data, size_t size) {
-    if ((offset < 0) || (offset >= (off64_t)mBuffer->size())) {
+    if ((offset < 0) || (offset >= (off64_t)mDecodedSize)) {
         return 0;
     }
 
-    size_t copy = mBuffer->size() - offset;
-    if (copy > size) {
-        copy = size;
+    Mutex::Autolock autoLock(mLock);
+
+    size_t copied = 0;
+    while (copied < size && offset < (off64_t)mDecodedSize) {
+        if (mBlockOffset < 0 || offset < mBlockOffset
+                || offset >= mBlockOffset + (off64_t)mBlock->size()) {
+            status_t err = decodeBlock_l(offset);
+            if (err != OK) {
+                return copied > 0 ? (ssize_t)copied : err;
+            }
+        }
+
+        size_t copy = mBlockOffset + mBlock->size() - offset;
+        if (copy > size - copied) {
+            copy = size - copied;
+        }
+
+        memcpy((uint8_t *)data + copied, mBlock->data() + (offset - mBlockOffset), copy);
+
+        copied += copy;
+        offset += copy;
+    }
+
+    return copied;
+}
+
+status_t DataURISource::decodeBlock_l(off64_t offset) {
+    off64_t blockOffset = (offset / kDecodedBlockSize) * kDecodedBlockSize;
+    size_t encodedOffset = (blockOffset / 3) * 4;
+    size_t encodedSize = mEncoded.size() - encodedOffset;
+    if (encodedSize > (kDecodedBlockSize / 3) * 4) {
+        encodedSize = (kDecodedBlockSize / 3) * 4;
+    }
+
+    mBlockOffset = -1;
+    mBlock->setRange(0, mBlock->capacity());
+
+    // Padding is only allowed at the very end, so every block but the last
+    // one has to decode to a full block.
+    ssize_t decoded = decodeBase64(
+            mEncoded.c_str() + encodedOffset, encodedSize, mBlock->data());
+    bool isLastBlock = (encodedOffset + encodedSize == mEncoded.size());
+    if (decoded < 0 || (!isLastBlock && (size_t)decoded != kDecodedBlockSize)) {
+        ALOGE("Malformed base64 encoded content found.");
+        return ERROR_MALFORMED;
     }
 
-    memcpy(data, mBuffer->data() + offset, copy);
+    mBlock->setRange(0, decoded);
+    mBlockOffset = blockOffset;
 
-    return copy;
+    return OK;
 }
 
 status_t DataURISource::getSize(off64_t *size) {
-    *size = mBuffer->size();
+    *size = mDecodedSize;
 
     return OK;
 }
@@ -18,18 +18,30 @@
 #define LOG_TAG "FileSource"
 #include <utils/Log.h>
 
+#include <algorithm>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/FileSource.h>
 #include <media/stagefright/Utils.h>
+#include <cutils/properties.h>
 #include <private/android_filesystem_config.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
 namespace android {
 
+// Mapping everything is fine on 64-bit, 32-bit processes only map files
+// small enough not to fragment their address space.
+static const int64_t kMaxMapSize =
+        sizeof(void *) >= 8 ? INT64_MAX : 64ll * 1024 * 1024;
+
+// How far ahead of the current read position pages are requested.
+static const int64_t kReadaheadBytes = 1024 * 1024;
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
@@ -39,7 +51,12 @@ FileSource::FileSource(const char *filename)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mMapBase(NULL),
+      mMapSize(0),
+      mMapData(NULL),
+      mReadaheadStart(0),
+      mReadaheadEnd(0) {
 
     if (filename) {
         mName = String8::format("FileSource(%s)", filename);
@@ -49,6 +66,7 @@ FileSource::FileSource(const char *filename)
 
     if (mFd >= 0) {
         mLength = lseek64(mFd, 0, SEEK_END);
+        mapFile();
     } else {
         ALOGE("Failed to open file '%s'. (%s)", filename, strerror(errno));
     }
@@ -63,7 +81,12 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL) {
+      mDrmBuf(NULL),
+      mMapBase(NULL),
+      mMapSize(0),
+      mMapData(NULL),
+      mReadaheadStart(0),
+      mReadaheadEnd(0) {
     ALOGV("fd=%d (%s), offset=%lld, length=%lld",
             fd, nameForFd(fd).c_str(), (long long) offset, (long long) length);
 
@@ -98,9 +121,12 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
             (long long) mOffset,
             (long long) mLength);
 
+    mapFile();
 }
 
 FileSource::~FileSource() {
+    unmapFile();
+
     if (mFd >= 0) {
         ::close(mFd);
         mFd = -1;
@@ -128,6 +154,93 @@ status_t FileSource::initCheck() const {
     return mFd >= 0 ? OK : NO_INIT;
 }
 
+void FileSource::mapFile() {
+    if (!property_get_bool("media.stagefright.mmap-filesource", true)) {
+        return;
+    }
+
+    // Only regular files: their size is known and stable, unlike pipes or
+    // sockets handed to us as fds.
+    struct stat s;
+    if (mFd < 0 || fstat(mFd, &s) != 0 || !S_ISREG(s.st_mode)
+            || mLength <= 0 || mOffset + mLength > s.st_size) {
+        return;
+    }
+
+    const int64_t pageSize = sysconf(_SC_PAGESIZE);
+    const int64_t alignedOffset = mOffset - (mOffset % pageSize);
+    const int64_t mapSize = mLength + (mOffset - alignedOffset);
+    if (mapSize > kMaxMapSize || (uint64_t)mapSize > SIZE_MAX) {
+        return;
+    }
+
+    void *base = mmap64(NULL, mapSize, PROT_READ, MAP_SHARED, mFd, alignedOffset);
+    if (base == MAP_FAILED) {
+        ALOGV("mmap of %s failed (%s), using read()", mName.c_str(), strerror(errno));
+        return;
+    }
+    // Extraction and thumbnailing mostly move forward through the file.
+    madvise(base, mapSize, MADV_SEQUENTIAL);
+
+    mMapBase = base;
+    mMapSize = mapSize;
+    mMapData = (const uint8_t *)base + (mOffset - alignedOffset);
+    mReadaheadStart = mReadaheadEnd = 0;
+}
+
+void FileSource::unmapFile() {
+    if (mMapBase != NULL) {
+        munmap(mMapBase, mMapSize);
+        mMapBase = NULL;
+        mMapSize = 0;
+        mMapData = NULL;
+    }
+}
+
+bool FileSource::isMappedLocked() const {
+    // Container based DRM content has to go through the DRM framework.
+    return mMapData != NULL && (mDecryptHandle == NULL
+            || mDecryptHandle->decryptApiType != DecryptApiType::CONTAINER_BASED);
+}
+
+void FileSource::readaheadLocked(off64_t offset, size_t size) {
+    if (offset >= mReadaheadStart && offset + (int64_t)size <= mReadaheadEnd) {
+        return;
+    }
+
+    // Follow the reader: request the window starting at this read, so a seek
+    // moves the readahead along with it.
+    const uintptr_t pageMask = sysconf(_SC_PAGESIZE) - 1;
+    int64_t end = offset + std::max((int64_t)size, kReadaheadBytes);
+    if (end > mLength) {
+        end = mLength;
+    }
+    uintptr_t start = (uintptr_t)(mMapData + offset) & ~pageMask;
+    madvise((void *)start, (uintptr_t)(mMapData + end) - start, MADV_WILLNEED);
+
+    mReadaheadStart = offset;
+    mReadaheadEnd = end;
+}
+
+ssize_t FileSource::borrowAt(off64_t offset, const uint8_t **data, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!isMappedLocked() || offset < 0) {
+        return ERROR_UNSUPPORTED;
+    }
+    if (offset >= mLength) {
+        return 0;
+    }
+    uint64_t numAvailable = mLength - offset;
+    if ((uint64_t)size > numAvailable) {
+        size = numAvailable;
+    }
+
+    readaheadLocked(offset, size);
+    *data = mMapData + offset;
+    return size;
+}
+
 ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
     if (mFd < 0) {
         return NO_INIT;
@@ -148,6 +261,10 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
     if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
             == mDecryptHandle->decryptApiType) {
         return readAtDRM(offset, data, size);
+   } else if (mMapData != NULL && offset >= 0) {
+        readaheadLocked(offset, size);
+        memcpy(data, mMapData + offset, size);
+        return size;
    } else {
         off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
         if (result == -1) {
@@ -18,8 +18,10 @@
 #define LOG_TAG "FrameDecoder"
 
 #include "include/FrameDecoder.h"
+#include <algorithm>
 #include <binder/MemoryBase.h>
 #include <binder/MemoryHeapBase.h>
+#include <cutils/properties.h>
 #include <gui/Surface.h>
 #include <inttypes.h>
 #include <media/ICrypto.h>
@@ -31,20 +33,29 @@
 #include <media/stagefright/ColorConverter.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecList.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/Utils.h>
 #include <private/media/VideoFrame.h>
 #include <utils/Log.h>
+#include <unistd.h>
 
 namespace android {
 
 static const int64_t kBufferTimeOutUs = 10000ll; // 10 msec
 static const size_t kRetryCount = 50; // must be >0
+static const int32_t kMaxImageDecoders = 4;
+static const size_t kMaxConvertThreads = 4;
+
+static size_t getNumCpuCores() {
+    long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+    return numCores > 0 ? (size_t)numCores : 1;
+}
 
 sp<IMemory> allocVideoFrame(const sp<MetaData>& trackMeta,
         int32_t width, int32_t height, int32_t tileWidth, int32_t tileHeight,
-        int32_t dstBpp, bool metaOnly = false) {
+        int32_t dstBpp, bool metaOnly = false, int32_t downscale = 1) {
     int32_t rotationAngle;
     if (!trackMeta->findInt32(kKeyRotation, &rotationAngle)) {
         rotationAngle = 0;  // By default, no rotation
@@ -69,6 +80,8 @@ sp<IMemory> allocVideoFrame(const sp<MetaData>& trackMeta,
                 && displayWidth > 0 && displayHeight > 0
                 && width > 0 && height > 0) {
         ALOGV("found display size %dx%d", displayWidth, displayHeight);
+        displayWidth /= downscale;
+        displayHeight /= downscale;
     } else {
         displayWidth = width;
         displayHeight = height;
@@ -114,6 +127,16 @@ bool findGridInfo(const sp<MetaData> &trackMeta,
         && trackMeta->findInt32(kKeyGridCols, gridCols) && (*gridCols > 0);
 }
 
+// Clips a region to a width x height frame, and moves its top-left corner
+// back onto a multiple of align. Returns false if nothing is left of it.
+static bool clipRegion(FrameRect *region, int32_t width, int32_t height, int32_t align) {
+    region->left = std::max(region->left, 0) / align * align;
+    region->top = std::max(region->top, 0) / align * align;
+    region->right = std::min(region->right, width);
+    region->bottom = std::min(region->bottom, height);
+    return region->left < region->right && region->top < region->bottom;
+}
+
 bool getDstColorFormat(
         android_pixel_format_t colorFormat,
         OMX_COLOR_FORMATTYPE *dstFormat,
@@ -181,20 +204,64 @@ FrameDecoder::FrameDecoder(
     : mIDRSent(false),
       mComponentName(componentName),
       mTrackMeta(trackMeta),
+      mFrameMeta(trackMeta),
       mSource(source),
       mDstFormat(OMX_COLOR_Format16bitRGB565),
       mDstBpp(2),
+      mHasRegion(false),
+      mRegion({0, 0, 0, 0}),
+      mTargetWidth(0),
+      mTargetHeight(0),
+      mNumInputsQueued(0),
+      mNumOutputsReceived(0),
       mHaveMoreInputs(true),
       mFirstSample(true) {
 }
 
 FrameDecoder::~FrameDecoder() {
-    if (mDecoder != NULL) {
-        mDecoder->release();
+    if (!mDecoders.empty()) {
+        for (size_t i = 0; i < mDecoders.size(); ++i) {
+            mDecoders[i]->release();
+        }
         mSource->stop();
     }
 }
 
+void FrameDecoder::setRegion(const FrameRect &region) {
+    mHasRegion = true;
+    mRegion = region;
+
+    // the display size of the track does not apply to a part of it
+    mFrameMeta = new MetaData(*mTrackMeta);
+    mFrameMeta->remove(kKeyDisplayWidth);
+    mFrameMeta->remove(kKeyDisplayHeight);
+}
+
+void FrameDecoder::setTargetSize(int32_t targetWidth, int32_t targetHeight) {
+    mTargetWidth = targetWidth;
+    mTargetHeight = targetHeight;
+}
+
+int32_t FrameDecoder::getDownscaleFactor(int32_t width, int32_t height) const {
+    if (mTargetWidth <= 0 || mTargetHeight <= 0) {
+        return 1;
+    }
+
+    int32_t targetWidth = mTargetWidth;
+    int32_t targetHeight = mTargetHeight;
+    int32_t rotationAngle;
+    if (mTrackMeta->findInt32(kKeyRotation, &rotationAngle)
+            && (rotationAngle == 90 || rotationAngle == 270)) {
+        std::swap(targetWidth, targetHeight);
+    }
+
+    int32_t factor = 1;
+    while (width / (factor * 2) >= targetWidth && height / (factor * 2) >= targetHeight) {
+        factor *= 2;
+    }
+    return factor;
+}
+
 status_t FrameDecoder::init(
         int64_t frameTimeUs, size_t numFrames, int option, int colorFormat) {
     if (!getDstColorFormat(
@@ -240,11 +307,69 @@ status_t FrameDecoder::init(
         decoder->release();
         return err;
     }
-    mDecoder = decoder;
+    mDecoders.push_back(decoder);
+
+    // The extra instances are optional: the codec, or the resource manager, may
+    // refuse them, in which case we decode with what we have.
+    size_t numDecoders = onGetDecoderCount();
+    while (mDecoders.size() < numDecoders) {
+        decoder = MediaCodec::CreateByComponentName(looper, mComponentName, &err);
+        if (decoder.get() == NULL || err != OK) {
+            break;
+        }
+        err = decoder->configure(
+                videoFormat->dup(), NULL /* surface */, NULL /* crypto */, 0 /* flags */);
+        if (err == OK) {
+            err = decoder->start();
+        }
+        if (err != OK) {
+            decoder->release();
+            break;
+        }
+        mDecoders.push_back(decoder);
+    }
+    ALOGV("decoding with %zu of %zu instances of %s",
+            mDecoders.size(), numDecoders, mComponentName.c_str());
+    mOutputFormats.resize(mDecoders.size());
 
     return OK;
 }
 
+status_t FrameDecoder::reinit(
+        int64_t frameTimeUs, size_t numFrames, int option, int colorFormat) {
+    if (mDecoders.empty() || !onCanReuseFor(option)) {
+        return INVALID_OPERATION;
+    }
+    if (!getDstColorFormat(
+            (android_pixel_format_t)colorFormat, &mDstFormat, &mDstBpp)) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    MediaSource::ReadOptions readOptions;
+    if (onGetFormatAndSeekOptions(frameTimeUs, numFrames, option, &readOptions) == NULL) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    // drops whatever the last request left queued, including its EOS; the
+    // output formats stay valid as the configuration is the same
+    for (size_t i = 0; i < mDecoders.size(); ++i) {
+        status_t err = mDecoders[i]->flush();
+        if (err != OK) {
+            ALOGW("flush returned error %d (%s)", err, asString(err));
+            return err;
+        }
+    }
+
+    mReadOptions = readOptions;
+    mFrames.clear();
+    mNumInputsQueued = 0;
+    mNumOutputsReceived = 0;
+    mHaveMoreInputs = true;
+    mFirstSample = true;
+    mIDRSent = false;
+    return OK;
+}
+
 sp<IMemory> FrameDecoder::extractFrame(FrameRect *rect) {
     status_t err = onExtractRect(rect);
     if (err == OK) {
@@ -282,7 +407,8 @@ status_t FrameDecoder::extractInternal() {
         // outputs. After getting each output, come back and queue the inputs
         // again to keep the decoder busy.
         while (mHaveMoreInputs) {
-            err = mDecoder->dequeueInputBuffer(&index, 0);
+            const sp<MediaCodec> &decoder = mDecoders[mNumInputsQueued % mDecoders.size()];
+            err = decoder->dequeueInputBuffer(&index, 0);
             if (err != OK) {
                 ALOGV("Timed out waiting for input");
                 if (retriesLeft) {
@@ -291,7 +417,7 @@ status_t FrameDecoder::extractInternal() {
                 break;
             }
             sp<MediaCodecBuffer> codecBuffer;
-            err = mDecoder->getInputBuffer(index, &codecBuffer);
+            err = decoder->getInputBuffer(index, &codecBuffer);
             if (err != OK) {
                 ALOGE("failed to get input buffer %zu", index);
                 break;
@@ -299,7 +425,13 @@ status_t FrameDecoder::extractInternal() {
 
             MediaBufferBase *mediaBuffer = NULL;
 
-            err = mSource->read(&mediaBuffer, &mReadOptions);
+            // samples that are not needed are read past without being decoded
+            while ((err = mSource->read(&mediaBuffer, &mReadOptions)) == OK
+                    && onSkipInput()) {
+                mReadOptions.clearSeekTo();
+                mediaBuffer->release();
+                mediaBuffer = NULL;
+            }
             mReadOptions.clearSeekTo();
             if (err != OK) {
                 ALOGW("Input Error or EOS");
@@ -335,12 +467,13 @@ status_t FrameDecoder::extractInternal() {
                 ALOGV("QueueInput: size=%zu ts=%" PRId64 " us flags=%x",
                         codecBuffer->size(), ptsUs, flags);
 
-                err = mDecoder->queueInputBuffer(
+                err = decoder->queueInputBuffer(
                         index,
                         codecBuffer->offset(),
                         codecBuffer->size(),
                         ptsUs,
                         flags);
+                ++mNumInputsQueued;
 
                 if (flags & MediaCodec::BUFFER_FLAG_EOS) {
                     mHaveMoreInputs = false;
@@ -348,10 +481,14 @@ status_t FrameDecoder::extractInternal() {
             }
         }
 
+        // outputs come from the instances in the order the inputs were queued
+        size_t decoderIndex = mNumOutputsReceived % mDecoders.size();
+        const sp<MediaCodec> &decoder = mDecoders[decoderIndex];
+        sp<AMessage> &outputFormat = mOutputFormats[decoderIndex];
         while (err == OK) {
             size_t offset, size;
             // wait for a decoded buffer
-            err = mDecoder->dequeueOutputBuffer(
+            err = decoder->dequeueOutputBuffer(
                     &index,
                     &offset,
                     &size,
@@ -361,7 +498,7 @@ status_t FrameDecoder::extractInternal() {
 
             if (err == INFO_FORMAT_CHANGED) {
                 ALOGV("Received format change");
-                err = mDecoder->getOutputFormat(&mOutputFormat);
+                err = decoder->getOutputFormat(&outputFormat);
             } else if (err == INFO_OUTPUT_BUFFERS_CHANGED) {
                 ALOGV("Output buffers changed");
                 err = OK;
@@ -374,13 +511,14 @@ status_t FrameDecoder::extractInternal() {
                     // from the extractor, decode to the specified frame. Otherwise we're done.
                     ALOGV("Received an output buffer, timeUs=%lld", (long long)ptsUs);
                     sp<MediaCodecBuffer> videoFrameBuffer;
-                    err = mDecoder->getOutputBuffer(index, &videoFrameBuffer);
+                    err = decoder->getOutputBuffer(index, &videoFrameBuffer);
                     if (err != OK) {
                         ALOGE("failed to get output buffer %zu", index);
                         break;
                     }
-                    err = onOutputReceived(videoFrameBuffer, mOutputFormat, ptsUs, &done);
-                    mDecoder->releaseOutputBuffer(index);
+                    err = onOutputReceived(videoFrameBuffer, outputFormat, ptsUs, &done);
+                    decoder->releaseOutputBuffer(index);
+                    ++mNumOutputsReceived;
                 } else {
                     ALOGW("Received error %d (%s) instead of output", err, asString(err));
                     done = true;
@@ -411,6 +549,16 @@ VideoFrameDecoder::VideoFrameDecoder(
       mNumFramesDecoded(0) {
 }
 
+static bool isSeekModeClosest(int seekMode) {
+    return seekMode == MediaSource::ReadOptions::SEEK_CLOSEST
+            || seekMode == MediaSource::ReadOptions::SEEK_FRAME_INDEX;
+}
+
+bool VideoFrameDecoder::onCanReuseFor(int seekMode) {
+    // the sync modes configure the codec for a single frame
+    return isSeekModeClosest(seekMode) == isSeekModeClosest(mSeekMode);
+}
+
 sp<AMessage> VideoFrameDecoder::onGetFormatAndSeekOptions(
         int64_t frameTimeUs, size_t numFrames, int seekMode, MediaSource::ReadOptions *options) {
     mSeekMode = static_cast<MediaSource::ReadOptions::SeekMode>(seekMode);
@@ -420,6 +568,8 @@ sp<AMessage> VideoFrameDecoder::onGetFormatAndSeekOptions(
         return NULL;
     }
     mNumFrames = numFrames;
+    mNumFramesDecoded = 0;
+    mTargetTimeUs = -1ll;
 
     const char *mime;
     if (!trackMeta()->findCString(kKeyMIMEType, &mime)) {
@@ -516,30 +666,55 @@ status_t VideoFrameDecoder::onOutputReceived(
         crop_bottom = height - 1;
     }
 
-    sp<IMemory> frameMem = allocVideoFrame(
-            trackMeta(),
-            (crop_right - crop_left + 1),
-            (crop_bottom - crop_top + 1),
-            0,
-            0,
-            dstBpp());
-    addFrame(frameMem);
-    VideoFrame* frame = static_cast<VideoFrame*>(frameMem->pointer());
-
     int32_t srcFormat;
     CHECK(outputFormat->findInt32("color-format", &srcFormat));
 
     ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
+    converter.setMaxThreads(kMaxConvertThreads);
 
     if (converter.isValid()) {
-        converter.convert(
+        int32_t cropWidth = crop_right - crop_left + 1;
+        int32_t cropHeight = crop_bottom - crop_top + 1;
+        FrameRect roi = {0, 0, cropWidth, cropHeight};
+        if (hasRegion()) {
+            roi = region();
+            if (!clipRegion(&roi, cropWidth, cropHeight, 2)) {
+                ALOGE("region is outside of the frame");
+                return ERROR_UNSUPPORTED;
+            }
+        }
+
+        int32_t downscale = 1;
+        if (converter.isDownscaleValid()) {
+            downscale = getDownscaleFactor(roi.right - roi.left, roi.bottom - roi.top);
+            clipRegion(&roi, cropWidth, cropHeight, std::max(downscale, 2));
+        }
+        crop_left += roi.left;
+        crop_top += roi.top;
+        crop_right = crop_left + (roi.right - roi.left) - 1;
+        crop_bottom = crop_top + (roi.bottom - roi.top) - 1;
+
+        sp<IMemory> frameMem = allocVideoFrame(
+                frameMeta(),
+                (roi.right - roi.left) / downscale,
+                (roi.bottom - roi.top) / downscale,
+                0,
+                0,
+                dstBpp(),
+                false /*metaOnly*/,
+                downscale);
+        addFrame(frameMem);
+        VideoFrame* frame = static_cast<VideoFrame*>(frameMem->pointer());
+
+        converter.convertDownscaled(
                 (const uint8_t *)videoFrameBuffer->data(),
                 stride, slice_height,
                 crop_left, crop_top, crop_right, crop_bottom,
                 frame->getFlattenedData(),
                 frame->mWidth,
                 frame->mHeight,
-                crop_left, crop_top, crop_right, crop_bottom);
+                0, 0, frame->mWidth - 1, frame->mHeight - 1,
+                downscale);
         return OK;
     }
 
@@ -563,7 +738,13 @@ ImageDecoder::ImageDecoder(
       mTileWidth(0),
       mTileHeight(0),
       mTilesDecoded(0),
-      mTargetTiles(0) {
+      mTargetTiles(0),
+      mTilesRead(0),
+      mRoi({0, 0, 0, 0}),
+      mDownscale(1) {
+}
+
+ImageDecoder::~ImageDecoder() {
 }
 
 sp<AMessage> ImageDecoder::onGetFormatAndSeekOptions(
@@ -620,7 +801,26 @@ sp<AMessage> ImageDecoder::onGetFormatAndSeekOptions(
             overrideMeta = trackMeta();
         }
     }
-    mTargetTiles = mGridCols * mGridRows;
+
+    mRoi = {0, 0, mWidth, mHeight};
+    if (hasRegion()) {
+        mRoi = region();
+        if (!clipRegion(&mRoi, mWidth, mHeight, 2)) {
+            ALOGE("region is outside of the image");
+            return NULL;
+        }
+    }
+    // tiles have to start on whole pixels of the downscaled image
+    mDownscale = getDownscaleFactor(mRoi.right - mRoi.left, mRoi.bottom - mRoi.top);
+    while (mDownscale > 1 && (mTileWidth % mDownscale || mTileHeight % mDownscale)) {
+        mDownscale /= 2;
+    }
+    clipRegion(&mRoi, mWidth, mHeight, std::max(mDownscale, 2));
+
+    mTargetTiles = 0;
+    for (int32_t tile = 0; tile < mGridCols * mGridRows; ++tile) {
+        mTargetTiles += isTileInRoi(tile);
+    }
 
     sp<AMessage> videoFormat;
     if (convertMetaDataToMessage(overrideMeta, &videoFormat) != OK) {
@@ -640,6 +840,40 @@ sp<AMessage> ImageDecoder::onGetFormatAndSeekOptions(
     return videoFormat;
 }
 
+size_t ImageDecoder::onGetDecoderCount() {
+    // Every tile of a grid is coded on its own, so the tiles can be spread over
+    // several instances of the codec. Only do this with software codecs, a
+    // hardware codec would just be shared with the other instances.
+    int32_t numTiles = mGridRows * mGridCols;
+    if (numTiles <= 1 || !MediaCodecList::isSoftwareCodec(componentName())) {
+        return 1;
+    }
+    int32_t maxDecoders = property_get_int32(
+            "media.stagefright.image.max_decoders", kMaxImageDecoders);
+    return std::max(1, std::min(std::min(numTiles, maxDecoders),
+            (int32_t)getNumCpuCores()));
+}
+
+bool ImageDecoder::isTileInRoi(int32_t tile) const {
+    int32_t tileWidth = mTileWidth > 0 ? mTileWidth : mWidth;
+    int32_t tileHeight = mTileHeight > 0 ? mTileHeight : mHeight;
+    int32_t left = tile % mGridCols * tileWidth;
+    int32_t top = tile / mGridCols * tileHeight;
+    return left < mRoi.right && left + tileWidth > mRoi.left
+            && top < mRoi.bottom && top + tileHeight > mRoi.top;
+}
+
+bool ImageDecoder::onSkipInput() {
+    // every sample of the image track is one tile of the grid, in raster order
+    int32_t tile = mTilesRead++;
+    if (!isTileInRoi(tile)) {
+        ALOGV("skipping tile %d outside of the region", tile);
+        return true;
+    }
+    mQueuedTiles.push_back(tile);
+    return false;
+}
+
 status_t ImageDecoder::onExtractRect(FrameRect *rect) {
     // TODO:
     // This callback is for verifying whether we can decode the rect,
@@ -654,10 +888,14 @@ status_t ImageDecoder::onExtractRect(FrameRect *rect) {
         if (mTilesDecoded > 0) {
             return ERROR_UNSUPPORTED;
         }
-        mTargetTiles = mGridRows * mGridCols;
         return OK;
     }
 
+    // sequential decoding works on the full-size image only
+    if (hasRegion() || mDownscale > 1) {
+        return ERROR_UNSUPPORTED;
+    }
+
     if (mTileWidth <= 0 || mTileHeight <=0) {
         return ERROR_UNSUPPORTED;
     }
@@ -692,25 +930,34 @@ status_t ImageDecoder::onOutputReceived(
     CHECK(outputFormat->findInt32("stride", &stride));
     CHECK(outputFormat->findInt32("slice-height", &slice_height));
 
+    int32_t srcFormat;
+    CHECK(outputFormat->findInt32("color-format", &srcFormat));
+
+    if (!mConverter) {
+        // the same converter, and its threads, are used for all the tiles
+        mConverter.reset(new ColorConverter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat()));
+        mConverter->setMaxThreads(kMaxConvertThreads);
+    }
+
     if (mFrame == NULL) {
+        if (!mConverter->isDownscaleValid()) {
+            mDownscale = 1;
+        }
+        bool fullSize = !hasRegion() && mDownscale == 1;
         sp<IMemory> frameMem = allocVideoFrame(
-                trackMeta(), mWidth, mHeight, mTileWidth, mTileHeight, dstBpp());
+                frameMeta(),
+                (mRoi.right - mRoi.left) / mDownscale,
+                (mRoi.bottom - mRoi.top) / mDownscale,
+                fullSize ? mTileWidth : 0,
+                fullSize ? mTileHeight : 0,
+                dstBpp(),
+                false /*metaOnly*/,
+                mDownscale);
         mFrame = static_cast<VideoFrame*>(frameMem->pointer());
 
         addFrame(frameMem);
     }
 
-    int32_t srcFormat;
-    CHECK(outputFormat->findInt32("color-format", &srcFormat));
-
-    ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
-
-    int32_t dstLeft, dstTop, dstRight, dstBottom;
-    dstLeft = mTilesDecoded % mGridCols * width;
-    dstTop = mTilesDecoded / mGridCols * height;
-    dstRight = dstLeft + width - 1;
-    dstBottom = dstTop + height - 1;
-
     int32_t crop_left, crop_top, crop_right, crop_bottom;
     if (!outputFormat->findRect("crop", &crop_left, &crop_top, &crop_right, &crop_bottom)) {
         crop_left = crop_top = 0;
@@ -718,28 +965,41 @@ status_t ImageDecoder::onOutputReceived(
         crop_bottom = height - 1;
     }
 
-    // apply crop on bottom-right
-    // TODO: need to move this into the color converter itself.
-    if (dstRight >= mWidth) {
-        crop_right = mWidth - dstLeft - 1;
-        dstRight = dstLeft + crop_right;
-    }
-    if (dstBottom >= mHeight) {
-        crop_bottom = mHeight - dstTop - 1;
-        dstBottom = dstTop + crop_bottom;
-    }
+    // the part of the tile that is inside the region, in image coordinates;
+    // this also crops the tiles on the bottom-right to the image size
+    int32_t tile = mQueuedTiles[mTilesDecoded];
+    int32_t tileLeft = tile % mGridCols * width;
+    int32_t tileTop = tile / mGridCols * height;
+    int32_t left = std::max(tileLeft, mRoi.left);
+    int32_t top = std::max(tileTop, mRoi.top);
+    int32_t right = std::min(tileLeft + crop_right - crop_left + 1, mRoi.right);
+    int32_t bottom = std::min(tileTop + crop_bottom - crop_top + 1, mRoi.bottom);
+
+    crop_left += left - tileLeft;
+    crop_top += top - tileTop;
+    crop_right = crop_left + (right - left) - 1;
+    crop_bottom = crop_top + (bottom - top) - 1;
 
     *done = (++mTilesDecoded >= mTargetTiles);
 
-    if (converter.isValid()) {
-        converter.convert(
+    if (mConverter->isValid()) {
+        if (right - left < mDownscale || bottom - top < mDownscale) {
+            // nothing of this tile is left after downscaling
+            return OK;
+        }
+        int32_t dstLeft = (left - mRoi.left) / mDownscale;
+        int32_t dstTop = (top - mRoi.top) / mDownscale;
+        mConverter->convertDownscaled(
                 (const uint8_t *)videoFrameBuffer->data(),
                 stride, slice_height,
                 crop_left, crop_top, crop_right, crop_bottom,
                 mFrame->getFlattenedData(),
                 mFrame->mWidth,
                 mFrame->mHeight,
-                dstLeft, dstTop, dstRight, dstBottom);
+                dstLeft, dstTop,
+                dstLeft + (right - left) / mDownscale - 1,
+                dstTop + (bottom - top) / mDownscale - 1,
+                mDownscale);
         return OK;
     }
 
@@ -48,6 +48,7 @@
 #include <media/mediarecorder.h>
 #include <cutils/properties.h>
 
+#include "include/AsyncChunkWriter.h"
 #include "include/ESDS.h"
 #include "include/HevcUtils.h"
 
@@ -118,8 +119,13 @@ public:
 
     int64_t getDurationUs() const;
     int64_t getEstimatedTrackSizeBytes() const;
+    int64_t getSampleTableSizeBytes() const;
+    int64_t getTrackHeaderSizeBytes() const;
+    int64_t estimateSampleTableBytesPerSecond() const;
     int32_t getMetaSizeIncrease(int32_t angle, int32_t trackCount) const;
     void writeTrackHeader(bool use32BitOffset = true);
+    void writeTrexBox();
+    void writeTrafBox(const Fragment &fragment, off64_t *dataOffsetPos);
     int64_t getMinCttsOffsetTimeUs();
     void bufferChunk(int64_t timestampUs);
     bool isAvc() const { return mIsAvc; }
@@ -153,7 +159,8 @@ private:
             : mElementCapacity(elementCapacity),
             mTotalNumTableEntries(0),
             mNumValuesInCurrEntry(0),
-            mCurrTableEntriesElement(NULL) {
+            mCurrTableEntriesElement(NULL),
+            mDiscarded(false) {
             CHECK_GT(mElementCapacity, 0u);
             // Ensure no integer overflow on allocation in add().
             CHECK_LT(ENTRY_SIZE, UINT32_MAX / mElementCapacity);
@@ -173,6 +180,7 @@ private:
         // @arg value must be in network byte order
         // @arg pos location the value must be in.
         void set(const TYPE& value, uint32_t pos) {
+            CHECK(!mDiscarded);
             CHECK_LT(pos, mTotalNumTableEntries * ENTRY_SIZE);
 
             typename List<TYPE *>::iterator it = mTableEntryList.begin();
@@ -192,6 +200,7 @@ private:
         // @arg pos location the value must be in.
         // @return true if a value is found.
         bool get(TYPE& value, uint32_t pos) const {
+            CHECK(!mDiscarded);
             if (pos >= mTotalNumTableEntries * ENTRY_SIZE) {
                 return false;
             }
@@ -212,6 +221,7 @@ private:
         // adjusts all values by |adjust(value)|
         void adjustEntries(
                 std::function<void(size_t /* ix */, TYPE(& /* entry */)[ENTRY_SIZE])> update) {
+            CHECK(!mDiscarded);
             size_t nEntries = mTotalNumTableEntries + mNumValuesInCurrEntry / ENTRY_SIZE;
             size_t ix = 0;
             for (TYPE *entryArray : mTableEntryList) {
@@ -251,6 +261,7 @@ private:
         // 2. followed by the values in the table enties in order
         // @arg writer the writer to actual write to the storage
         void write(MPEG4Writer *writer) const {
+            CHECK(!mDiscarded);
             CHECK_EQ(mNumValuesInCurrEntry % ENTRY_SIZE, 0u);
             uint32_t nEntries = mTotalNumTableEntries;
             writer->writeInt32(nEntries);
@@ -270,12 +281,25 @@ private:
         // Return the number of entries in the table.
         uint32_t count() const { return mTotalNumTableEntries; }
 
+        // Free all but the element being filled while still counting the
+        // entries, for tables that are never written out. The values can
+        // not be accessed or written afterwards.
+        void discard() {
+            while (mTableEntryList.size() > 1) {
+                typename List<TYPE *>::iterator it = mTableEntryList.begin();
+                delete[] (*it);
+                mTableEntryList.erase(it);
+                mDiscarded = true;
+            }
+        }
+
     private:
         uint32_t         mElementCapacity;  // # entries in an element
         uint32_t         mTotalNumTableEntries;
         uint32_t         mNumValuesInCurrEntry;  // up to ENTRY_SIZE
         TYPE             *mCurrTableEntriesElement;
         mutable List<TYPE *>     mTableEntryList;
+        bool             mDiscarded;
 
         DISALLOW_EVIL_CONSTRUCTORS(ListTableEntries);
     };
@@ -326,6 +350,11 @@ private:
     int64_t mMinCttsOffsetTicks;
     int64_t mMaxCttsOffsetTicks;
 
+    // Fragmented recording
+    Fragment mFragment;                 // Being collected
+    int64_t mFragmentDecodeTimeTicks;   // Of the last sample added
+    int64_t mFirstCompositionOffsetTicks;
+
     // Save the last 10 frames' timestamp and frame type for debug.
     struct TimestampDebugHelperEntry {
         int64_t pts;
@@ -424,6 +453,13 @@ private:
     bool isTrackMalFormed() const;
     void sendTrackSummary(bool hasMultipleTracks);
 
+    void addFragmentSample(
+            MediaBuffer *buffer, bool usePrefix, size_t sampleSize,
+            int64_t timestampUs, int64_t durationTicks,
+            int64_t compositionOffsetTicks, bool isSync);
+    void bufferFragment();
+    void discardTableEntries();
+
     // Write the boxes
     void writeStcoBox(bool use32BitOffset);
     void writeStscBox();
@@ -515,6 +551,9 @@ void MPEG4Writer::initInternal(int fd, bool isFirstSession) {
     mAssociationEntryCount = 0;
     mNumGrids = 0;
     mHasRefs = false;
+    mIsFragmented = false;
+    mMoovWritten = false;
+    mFragmentSequenceNumber = 0;
 
     // Following variables only need to be set for the first recording session.
     // And they will stay the same for all the recording sessions.
@@ -528,6 +567,7 @@ void MPEG4Writer::initInternal(int fd, bool isFirstSession) {
         mAreGeoTagsAvailable = false;
         mSwitchPending = false;
         mIsFileSizeLimitExplicitlyRequested = false;
+        mFragmentDurationUs = 0;
     }
 
     mLastAudioTimeStampUs = 0;
@@ -734,69 +774,55 @@ int64_t MPEG4Writer::estimateFileLevelMetaSize(MetaData *params) {
 }
 
 int64_t MPEG4Writer::estimateMoovBoxSize(int32_t bitRate) {
-    // This implementation is highly experimental/heurisitic.
+    // The sample tables make up nearly all of the moov, and they grow at a
+    // rate that can be told from each track's format: see
+    // Track::estimateSampleTableBytesPerSecond(). What is left to guess is
+    // how long the recording is going to be.
     //
-    // Statistical analysis shows that metadata usually accounts
-    // for a small portion of the total file size, usually < 0.6%.
-
-    // The default MIN_MOOV_BOX_SIZE is set to 0.6% x 1MB / 2,
-    // where 1MB is the common file size limit for MMS application.
-    // The default MAX _MOOV_BOX_SIZE value is based on about 3
-    // minute video recording with a bit rate about 3 Mbps, because
-    // statistics also show that most of the video captured are going
-    // to be less than 3 minutes.
-
-    // If the estimation is wrong, we will pay the price of wasting
-    // some reserved space. This should not happen so often statistically.
-    int32_t factor = mUse32BitOffset? 1: 2;
+    // The default recording duration is 3 minutes, because statistics show
+    // that most of the video captured are going to be less than that. Longer
+    // recordings without a duration or file size limit will end up with the
+    // moov at the end of the file, see updateMoovReservation().
     static const int64_t MIN_MOOV_BOX_SIZE = 3 * 1024;  // 3 KB
-    static const int64_t MAX_MOOV_BOX_SIZE = (180 * 3000000 * 6LL / 8000);
-    int64_t size = MIN_MOOV_BOX_SIZE;
-
-    // Max file size limit is set
-    if (mMaxFileSizeLimitBytes != 0 && mIsFileSizeLimitExplicitlyRequested) {
-        size = mMaxFileSizeLimitBytes * 6 / 1000;
-    }
+    static const int64_t DEFAULT_DURATION_US = 180000000LL;  // 3 minutes
+    int64_t durationUs = DEFAULT_DURATION_US;
 
     // Max file duration limit is set
     if (mMaxFileDurationLimitUs != 0) {
-        if (bitRate > 0) {
-            int64_t size2 =
-                ((mMaxFileDurationLimitUs / 1000) * bitRate * 6) / 8000000;
-            if (mMaxFileSizeLimitBytes != 0 && mIsFileSizeLimitExplicitlyRequested) {
-                // When both file size and duration limits are set,
-                // we use the smaller limit of the two.
-                if (size > size2) {
-                    size = size2;
-                }
-            } else {
-                // Only max file duration limit is set
-                size = size2;
-            }
+        durationUs = mMaxFileDurationLimitUs;
+    }
+
+    // Max file size limit is set. When both file size and duration limits
+    // are set, we use the smaller limit of the two.
+    if (mMaxFileSizeLimitBytes != 0 && mIsFileSizeLimitExplicitlyRequested && bitRate > 0) {
+        int64_t durationUs2 = (mMaxFileSizeLimitBytes * 8000000LL) / bitRate;
+        if (mMaxFileDurationLimitUs == 0 || durationUs2 < durationUs) {
+            durationUs = durationUs2;
         }
     }
 
-    if (size < MIN_MOOV_BOX_SIZE) {
-        size = MIN_MOOV_BOX_SIZE;
+    int64_t size = 0;
+    for (List<Track *>::iterator it = mTracks.begin();
+         it != mTracks.end(); ++it) {
+        if (!(*it)->isHeic()) {
+            size += (*it)->estimateSampleTableBytesPerSecond() * durationUs / 1000000LL
+                    + (*it)->getTrackHeaderSizeBytes();
+        }
     }
 
-    // Any long duration recording will be probably end up with
-    // non-streamable mp4 file.
-    if (size > MAX_MOOV_BOX_SIZE) {
-        size = MAX_MOOV_BOX_SIZE;
+    if (size < MIN_MOOV_BOX_SIZE) {
+        size = MIN_MOOV_BOX_SIZE;
     }
 
-    // Account for the extra stuff (Geo, meta keys, etc.)
-    size += mMoovExtraSize;
+    // Account for the mvhd and the extra stuff (Geo, meta keys, etc.)
+    size += 108 + mMoovExtraSize;
 
     ALOGI("limits: %" PRId64 "/%" PRId64 " bytes/us, bit rate: %d bps and the"
-         " estimated moov size %" PRId64 " bytes",
-         mMaxFileSizeLimitBytes, mMaxFileDurationLimitUs, bitRate, size);
-
-    int64_t estimatedSize = factor * size;
-    CHECK_GE(estimatedSize, 8);
+         " estimated moov size %" PRId64 " bytes for %" PRId64 " us",
+         mMaxFileSizeLimitBytes, mMaxFileDurationLimitUs, bitRate, size, durationUs);
 
-    return estimatedSize;
+    // 8 bytes for the free box that follows the moov.
+    return size + 8;
 }
 
 status_t MPEG4Writer::start(MetaData *param) {
@@ -867,6 +893,12 @@ status_t MPEG4Writer::start(MetaData *param) {
     CHECK_GT(mTimeScale, 0);
     ALOGV("movie time scale: %d", mTimeScale);
 
+    // Image items live in the file-level meta, which is written at the end.
+    mIsFragmented = mFragmentDurationUs > 0 && mHasMoovBox && !mHasFileLevelMeta;
+    if (mFragmentDurationUs > 0 && !mIsFragmented) {
+        ALOGW("Fragmented recording is not supported for images");
+    }
+
     /*
      * When the requested file size limit is small, the priority
      * is to meet the file size limit requirement, rather than
@@ -874,8 +906,10 @@ status_t MPEG4Writer::start(MetaData *param) {
      * whether the actual recorded file is streamable or not.
      */
     mStreamableFile =
-        (mMaxFileSizeLimitBytes != 0 &&
+        !mIsFragmented &&
+        (mMaxFileSizeLimitBytes == 0 ||
          mMaxFileSizeLimitBytes >= kMinStreamableFileSizeInBytes);
+    mMoovReservationExceeded = false;
 
     /*
      * mWriteBoxToMemory is true if the amount of data in a file-level meta or
@@ -948,13 +982,23 @@ status_t MPEG4Writer::start(MetaData *param) {
 
     mOffset = mMdatOffset;
     lseek64(mFd, mMdatOffset, SEEK_SET);
-    if (mUse32BitOffset) {
+    if (mIsFragmented) {
+        // The moov and the moof/mdat pairs are written by the writer thread.
+    } else if (mUse32BitOffset) {
         write("????mdat", 8);
     } else {
         write("\x00\x00\x00\x01mdat????????", 16);
     }
 
-    status_t err = startWriterThread();
+    // Samples are written to the file asynchronously from here on.
+    mChunkWriter = new AsyncChunkWriter(mFd);
+    status_t err = mChunkWriter->start();
+    if (err != OK) {
+        mChunkWriter.clear();
+        return err;
+    }
+
+    err = startWriterThread();
     if (err != OK) {
         return err;
     }
@@ -1048,7 +1092,20 @@ void MPEG4Writer::writeCompositionMatrix(int degrees) {
     writeInt32(0x40000000);  // w
 }
 
+void MPEG4Writer::stopChunkWriter() {
+    if (mChunkWriter == NULL) {
+        return;
+    }
+
+    status_t err = mChunkWriter->stop();
+    if (err != OK) {
+        ALOGE("Failed to write out all samples (%d)", err);
+    }
+    mChunkWriter.clear();
+}
+
 void MPEG4Writer::release() {
+    stopChunkWriter();
     close(mFd);
     mFd = -1;
     mInitCheck = NO_INIT;
@@ -1125,6 +1182,7 @@ status_t MPEG4Writer::reset(bool stopSource) {
     }
 
     stopWriterThread();
+    stopChunkWriter();
 
     // Do not write out movie header on error.
     if (err != OK) {
@@ -1132,6 +1190,12 @@ status_t MPEG4Writer::reset(bool stopSource) {
         return err;
     }
 
+    // Everything has been written out by the writer thread already.
+    if (mIsFragmented) {
+        release();
+        return OK;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     if (mUse32BitOffset) {
         lseek64(mFd, mMdatOffset, SEEK_SET);
@@ -1271,21 +1335,24 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
         writeUdtaBox();
     }
     writeMoovLevelMetaBox();
-    // Loop through all the tracks to get the global time offset if there is
-    // any ctts table appears in a video track.
-    int64_t minCttsOffsetTimeUs = kMaxCttsOffsetTimeUs;
-    for (List<Track *>::iterator it = mTracks.begin();
-        it != mTracks.end(); ++it) {
-        if (!(*it)->isHeic()) {
-            minCttsOffsetTimeUs =
-                std::min(minCttsOffsetTimeUs, (*it)->getMinCttsOffsetTimeUs());
+    // Fragments carry their composition offsets in the trun instead.
+    if (!mIsFragmented) {
+        // Loop through all the tracks to get the global time offset if there is
+        // any ctts table appears in a video track.
+        int64_t minCttsOffsetTimeUs = kMaxCttsOffsetTimeUs;
+        for (List<Track *>::iterator it = mTracks.begin();
+            it != mTracks.end(); ++it) {
+            if (!(*it)->isHeic()) {
+                minCttsOffsetTimeUs =
+                    std::min(minCttsOffsetTimeUs, (*it)->getMinCttsOffsetTimeUs());
+            }
         }
+        ALOGI("Ajust the moov start time from %lld us -> %lld us",
+                (long long)mStartTimestampUs,
+                (long long)(mStartTimestampUs + minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs));
+        // Adjust the global start time.
+        mStartTimestampUs += minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs;
     }
-    ALOGI("Ajust the moov start time from %lld us -> %lld us",
-            (long long)mStartTimestampUs,
-            (long long)(mStartTimestampUs + minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs));
-    // Adjust the global start time.
-    mStartTimestampUs += minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs;
 
     for (List<Track *>::iterator it = mTracks.begin();
         it != mTracks.end(); ++it) {
@@ -1293,6 +1360,15 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
             (*it)->writeTrackHeader(mUse32BitOffset);
         }
     }
+
+    if (mIsFragmented) {
+        beginBox("mvex");
+        for (List<Track *>::iterator it = mTracks.begin();
+            it != mTracks.end(); ++it) {
+            (*it)->writeTrexBox();
+        }
+        endBox();  // mvex
+    }
     endBox();  // moov
 }
 
@@ -1325,6 +1401,9 @@ void MPEG4Writer::writeFtypBox(MetaData *param) {
             writeFourcc("isom");
             writeFourcc("mp42");
         }
+        if (mIsFragmented) {
+            writeFourcc("iso6");
+        }
     }
 
     endBox();
@@ -1363,6 +1442,17 @@ status_t MPEG4Writer::setInterleaveDuration(uint32_t durationUs) {
     return OK;
 }
 
+status_t MPEG4Writer::setFragmentDuration(int64_t durationUs) {
+    if (durationUs < 0) {
+        return BAD_VALUE;
+    }
+    if (mStarted) {
+        return INVALID_OPERATION;
+    }
+    mFragmentDurationUs = durationUs;
+    return OK;
+}
+
 void MPEG4Writer::lock() {
     mLock.lock();
 }
@@ -1379,15 +1469,12 @@ off64_t MPEG4Writer::addSample_l(
         addMultipleLengthPrefixedSamples_l(buffer);
     } else {
         if (isExif) {
-            ::write(mFd, &kTiffHeaderOffset, 4); // exif_tiff_header_offset field
-            mOffset += 4;
+            writeSampleData_l(&kTiffHeaderOffset, 4); // exif_tiff_header_offset field
         }
 
-        ::write(mFd,
+        writeSampleData_l(
               (const uint8_t *)buffer->data() + buffer->range_offset(),
               buffer->range_length());
-
-        mOffset += buffer->range_length();
     }
 
     *bytesWritten = mOffset - old_offset;
@@ -1436,30 +1523,40 @@ void MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
     size_t length = buffer->range_length();
 
     if (mUse4ByteNalLength) {
-        uint8_t x = length >> 24;
-        ::write(mFd, &x, 1);
-        x = (length >> 16) & 0xff;
-        ::write(mFd, &x, 1);
-        x = (length >> 8) & 0xff;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-
-        ::write(mFd,
-              (const uint8_t *)buffer->data() + buffer->range_offset(),
-              length);
-
-        mOffset += length + 4;
+        uint8_t x[4];
+        x[0] = length >> 24;
+        x[1] = (length >> 16) & 0xff;
+        x[2] = (length >> 8) & 0xff;
+        x[3] = length & 0xff;
+        writeSampleData_l(x, 4);
     } else {
         CHECK_LT(length, 65536u);
 
-        uint8_t x = length >> 8;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-        ::write(mFd, (const uint8_t *)buffer->data() + buffer->range_offset(), length);
-        mOffset += length + 2;
+        uint8_t x[2];
+        x[0] = length >> 8;
+        x[1] = length & 0xff;
+        writeSampleData_l(x, 2);
     }
+
+    writeSampleData_l(
+            (const uint8_t *)buffer->data() + buffer->range_offset(), length);
+}
+
+void MPEG4Writer::writeSampleData_l(const void *data, size_t size) {
+    CHECK(mChunkWriter != NULL);
+    mChunkWriter->write(mOffset, data, size);
+    mOffset += size;
+}
+
+// Fills in a field that has been written already and returns to mOffset.
+void MPEG4Writer::writeInt32At(off64_t offset, int32_t x) {
+    CHECK(!mWriteBoxToMemory);
+    CHECK_LE(offset + 4, mOffset);
+
+    x = htonl(x);
+    lseek64(mFd, offset, SEEK_SET);
+    ::write(mFd, &x, 4);
+    lseek64(mFd, mOffset, SEEK_SET);
 }
 
 size_t MPEG4Writer::write(
@@ -1677,6 +1774,37 @@ bool MPEG4Writer::isFileStreamable() const {
     return mStreamableFile;
 }
 
+/*
+ * Checks the sample tables as they grow against the space reserved for the
+ * moov, once they no longer fit the moov goes to the end of the file and
+ * needs to be accounted for in the file size.
+ */
+bool MPEG4Writer::updateMoovReservation() {
+    if (!mStreamableFile || mMoovReservationExceeded) {
+        return false;
+    }
+
+    int64_t moovSizeBytes = 108 + mMoovExtraSize + 8;
+    if (mHasFileLevelMeta) {
+        // The file-level meta shares the reserved space.
+        moovSizeBytes += estimateFileLevelMetaSize(mStartMeta.get());
+    }
+    for (List<Track *>::iterator it = mTracks.begin();
+         it != mTracks.end(); ++it) {
+        if (!(*it)->isHeic()) {
+            moovSizeBytes += (*it)->getSampleTableSizeBytes()
+                    + (*it)->getTrackHeaderSizeBytes();
+        }
+    }
+
+    if (moovSizeBytes > mInMemoryCacheSize) {
+        ALOGW("The moov (%" PRId64 " bytes) outgrew the reserved %" PRId64 " bytes, "
+                "it will be written at the end", moovSizeBytes, (int64_t)mInMemoryCacheSize);
+        mMoovReservationExceeded = true;
+    }
+    return !mMoovReservationExceeded;
+}
+
 bool MPEG4Writer::exceedsFileSizeLimit() {
     // No limit
     if (mMaxFileSizeLimitBytes == 0) {
@@ -1795,6 +1923,9 @@ MPEG4Writer::Track::Track(
       mMinCttsOffsetTimeUs(0),
       mMinCttsOffsetTicks(0),
       mMaxCttsOffsetTicks(0),
+      mFragment(this),
+      mFragmentDecodeTimeTicks(0),
+      mFirstCompositionOffsetTicks(0),
       mCodecSpecificData(NULL),
       mCodecSpecificDataSize(0),
       mGotAllCodecSpecificData(false),
@@ -1905,22 +2036,77 @@ void MPEG4Writer::Track::resetInternal() {
 void MPEG4Writer::Track::updateTrackSizeEstimate() {
     mEstimatedTrackSizeBytes = mMdatSizeBytes;  // media data size
 
-    if (!isHeic() && !mOwner->isFileStreamable()) {
-        uint32_t stcoBoxCount = (mOwner->use32BitFileOffset()
-                                ? mStcoTableEntries->count()
-                                : mCo64TableEntries->count());
-        int64_t stcoBoxSizeBytes = stcoBoxCount * 4;
-        int64_t stszBoxSizeBytes = mSamplesHaveSameSize? 4: (mStszTableEntries->count() * 4);
-
+    if (!isHeic() && !mOwner->updateMoovReservation()) {
         // Reserved free space is not large enough to hold
         // all meta data and thus wasted.
-        mEstimatedTrackSizeBytes += mStscTableEntries->count() * 12 +  // stsc box size
-                                    mStssTableEntries->count() * 4 +   // stss box size
-                                    mSttsTableEntries->count() * 8 +   // stts box size
-                                    mCttsTableEntries->count() * 8 +   // ctts box size
-                                    stcoBoxSizeBytes +           // stco box size
-                                    stszBoxSizeBytes;            // stsz box size
+        mEstimatedTrackSizeBytes += getSampleTableSizeBytes();
+    }
+}
+
+int64_t MPEG4Writer::Track::getSampleTableSizeBytes() const {
+    uint32_t stcoBoxCount = (mOwner->use32BitFileOffset()
+                            ? mStcoTableEntries->count()
+                            : mCo64TableEntries->count());
+    int64_t stcoBoxSizeBytes = stcoBoxCount * (mOwner->use32BitFileOffset() ? 4 : 8);
+    int64_t stszBoxSizeBytes = mSamplesHaveSameSize? 4: (mStszTableEntries->count() * 4);
+
+    return mStscTableEntries->count() * 12 +  // stsc box size
+           mStssTableEntries->count() * 4 +   // stss box size
+           mSttsTableEntries->count() * 8 +   // stts box size
+           mCttsTableEntries->count() * 8 +   // ctts box size
+           stcoBoxSizeBytes +           // stco box size
+           stszBoxSizeBytes;            // stsz box size
+}
+
+// Everything in the trak but the sample tables, the box headers included.
+int64_t MPEG4Writer::Track::getTrackHeaderSizeBytes() const {
+    return 512 + mCodecSpecificDataSize;
+}
+
+/*
+ * Worst case growth of the sample tables, see getSampleTableSizeBytes():
+ * every sample gets a stsz entry, and video samples may each need their own
+ * stts and ctts entry with variable frame rates and B frames. A stss entry
+ * is expected about every second. Every chunk adds a stco and a stsc entry.
+ */
+int64_t MPEG4Writer::Track::estimateSampleTableBytesPerSecond() const {
+    int64_t samplesPerSecond;
+    int64_t bytesPerSample = 4;  // stsz
+    if (mIsVideo) {
+        int32_t frameRate;
+        if (!mMeta->findInt32(kKeyFrameRate, &frameRate) || frameRate <= 0) {
+            frameRate = 30;
+        }
+        samplesPerSecond = frameRate;
+        bytesPerSample += 8 + 8;  // stts, ctts
+    } else if (mIsAudio) {
+        const char *mime;
+        CHECK(mMeta->findCString(kKeyMIMEType, &mime));
+        int32_t sampleRate;
+        if (!strcasecmp(MEDIA_MIMETYPE_AUDIO_AMR_NB, mime) ||
+                !strcasecmp(MEDIA_MIMETYPE_AUDIO_AMR_WB, mime)) {
+            samplesPerSecond = 50;  // 20ms frames
+        } else if (mMeta->findInt32(kKeySampleRate, &sampleRate) && sampleRate > 0) {
+            samplesPerSecond = divUp(sampleRate, 1024);  // AAC frame size
+        } else {
+            samplesPerSecond = 48;
+        }
+    } else {
+        samplesPerSecond = 30;
     }
+
+    int64_t chunksPerSecond = samplesPerSecond;
+    int64_t interleaveDurationUs = mOwner->interleaveDuration();
+    if (mOwner->numTracks() == 1) {
+        chunksPerSecond = 0;
+    } else if (interleaveDurationUs > 0) {
+        chunksPerSecond = std::min(samplesPerSecond, divUp(1000000LL, interleaveDurationUs));
+    }
+    int64_t bytesPerChunk = 12 + (mOwner->use32BitFileOffset() ? 4 : 8);  // stsc, stco
+
+    return samplesPerSecond * bytesPerSample
+            + (mIsVideo ? 4 : 0)  // stss
+            + chunksPerSecond * bytesPerChunk;
 }
 
 void MPEG4Writer::Track::addOneStscTableEntry(
@@ -2338,12 +2524,129 @@ bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
     return false;
 }
 
+void MPEG4Writer::bufferFragment(const Fragment& fragment) {
+    ALOGV("bufferFragment: %p", fragment.mTrack);
+    Mutex::Autolock autolock(mLock);
+    CHECK_EQ(mDone, false);
+
+    for (List<Track *>::iterator it = mTracksBeforeMoov.begin();
+         it != mTracksBeforeMoov.end(); ++it) {
+        if (*it == fragment.mTrack) {
+            mTracksBeforeMoov.erase(it);
+            break;
+        }
+    }
+
+    if (!fragment.mSamples.empty()) {
+        mFragments.push_back(fragment);
+    }
+    mChunkReadyCondition.signal();
+}
+
+bool MPEG4Writer::findFragmentToWrite(Fragment *fragment) {
+    // The moov needs the codec specific data and start time of every track,
+    // hold the fragments back until all of them have sent their first one.
+    if (!mTracksBeforeMoov.empty() || mFragments.empty()) {
+        return false;
+    }
+
+    *fragment = *mFragments.begin();
+    mFragments.erase(mFragments.begin());
+    return true;
+}
+
+void MPEG4Writer::writeFragmentedMoovBox() {
+    if (mMoovWritten) {
+        return;
+    }
+
+    lseek64(mFd, mOffset, SEEK_SET);
+    writeMoovBox(0 /* durationUs */);
+    mMoovWritten = true;
+}
+
+void MPEG4Writer::writeFragmentToFile(Fragment *fragment) {
+    ALOGV("writeFragmentToFile: %" PRId64 " from %s track",
+        fragment->mTimeStampUs, fragment->mTrack->getTrackType());
+
+    writeFragmentedMoovBox();
+
+    lseek64(mFd, mOffset, SEEK_SET);
+    off64_t moofOffset = mOffset;
+    off64_t dataOffsetPos;
+    beginBox("moof");
+        beginBox("mfhd");
+        writeInt32(0);                         // version=0, flags=0
+        writeInt32(++mFragmentSequenceNumber);
+        endBox();  // mfhd
+        fragment->mTrack->writeTrafBox(*fragment, &dataOffsetPos);
+    endBox();  // moof
+
+    // The samples follow the mdat header.
+    writeInt32At(dataOffsetPos, mOffset + 8 - moofOffset);
+
+    off64_t mdatOffset = mOffset;
+    writeInt32(0);
+    writeFourcc("mdat");
+
+    while (!fragment->mSamples.empty()) {
+        List<FragmentSample>::iterator it = fragment->mSamples.begin();
+
+        size_t bytesWritten;
+        addSample_l(it->mBuffer, it->mUsePrefix, false /* isExif */, &bytesWritten);
+
+        it->mBuffer->release();
+        it->mBuffer = NULL;
+        fragment->mSamples.erase(it);
+    }
+
+    writeInt32At(mdatOffset, mOffset - mdatOffset);
+}
+
+void MPEG4Writer::writeAllFragments() {
+    ALOGV("writeAllFragments");
+    size_t outstandingFragments = 0;
+    while (!mFragments.empty()) {
+        writeFragmentToFile(&*mFragments.begin());
+        mFragments.erase(mFragments.begin());
+        ++outstandingFragments;
+    }
+
+    // Nothing may have been recorded at all.
+    writeFragmentedMoovBox();
+
+    sendSessionSummary();
+
+    mChunkInfos.clear();
+    mTracksBeforeMoov.clear();
+    ALOGD("%zu fragments are written in the last batch", outstandingFragments);
+}
+
 void MPEG4Writer::threadFunc() {
     ALOGV("threadFunc");
 
     prctl(PR_SET_NAME, (unsigned long)"MPEG4Writer", 0, 0, 0);
 
     Mutex::Autolock autoLock(mLock);
+    while (!mDone && mIsFragmented) {
+        Fragment fragment;
+        bool fragmentFound = false;
+
+        while (!mDone && !(fragmentFound = findFragmentToWrite(&fragment))) {
+            mChunkReadyCondition.wait(mLock);
+        }
+
+        if (fragmentFound) {
+            if (mIsRealTimeRecording) {
+                mLock.unlock();
+            }
+            writeFragmentToFile(&fragment);
+            if (mIsRealTimeRecording) {
+                mLock.lock();
+            }
+        }
+    }
+
     while (!mDone) {
         Chunk chunk;
         bool chunkFound = false;
@@ -2367,7 +2670,11 @@ void MPEG4Writer::threadFunc() {
         }
     }
 
-    writeAllChunks();
+    if (mIsFragmented) {
+        writeAllFragments();
+    } else {
+        writeAllChunks();
+    }
 }
 
 status_t MPEG4Writer::startWriterThread() {
@@ -2383,6 +2690,9 @@ status_t MPEG4Writer::startWriterThread() {
         info.mPrevChunkTimestampUs = 0;
         info.mMaxInterChunkDurUs = 0;
         mChunkInfos.push_back(info);
+        if (mIsFragmented) {
+            mTracksBeforeMoov.push_back(*it);
+        }
     }
 
     pthread_attr_t attr;
@@ -2455,6 +2765,8 @@ status_t MPEG4Writer::Track::start(MetaData *params) {
     mMdatSizeBytes = 0;
     mMaxChunkDurationUs = 0;
     mLastDecodingTimeUs = -1;
+    mFragmentDecodeTimeTicks = 0;
+    mFirstCompositionOffsetTicks = 0;
 
     pthread_create(&mThread, &attr, ThreadWrapper, this);
     pthread_attr_destroy(&attr);
@@ -2929,6 +3241,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     int32_t count = 0;
     const int64_t interleaveDurationUs = mOwner->interleaveDuration();
     const bool hasMultipleTracks = (mOwner->numTracks() > 1);
+    const bool isFragmented = mOwner->isFragmented();
     int64_t chunkTimestampUs = 0;
     int32_t nChunks = 0;
     int32_t nActualFrames = 0;        // frames containing non-CSD data (non-0 length)
@@ -2945,6 +3258,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     int64_t currCttsOffsetTimeTicks = 0;   // Timescale based ticks
     int64_t lastCttsOffsetTimeTicks = -1;  // Timescale based ticks
     int32_t cttsSampleCount = 0;           // Sample count in the current ctts table entry
+    int64_t compositionOffsetTicks = 0;    // Presentation - decoding time
     uint32_t lastSamplesPerChunk = 0;
 
     if (mIsAudio) {
@@ -3213,6 +3527,8 @@ status_t MPEG4Writer::Track::threadEntry() {
                     mIsMalformed = true;
                     break;
                 }
+                compositionOffsetTicks = currCttsOffsetTimeTicks -
+                        (kMaxCttsOffsetTimeUs * mTimeScale + 500000LL) / 1000000LL;
 
                 if (mStszTableEntries->count() == 0) {
                     // Force the first ctts table entry to have one single entry
@@ -3332,7 +3648,11 @@ status_t MPEG4Writer::Track::threadEntry() {
                 trackProgressStatus(timestampUs);
             }
         }
-        if (!hasMultipleTracks) {
+        if (isFragmented) {
+            addFragmentSample(copy, usePrefix, sampleSize, timestampUs,
+                    currDurationTicks, compositionOffsetTicks, !mIsVideo || isSync);
+            copy = NULL;
+        } else if (!hasMultipleTracks) {
             size_t bytesWritten;
             off64_t offset = mOwner->addSample_l(copy, usePrefix, isExif, &bytesWritten);
 
@@ -3350,32 +3670,32 @@ status_t MPEG4Writer::Track::threadEntry() {
             copy->release();
             copy = NULL;
             continue;
-        }
-
-        mChunkSamples.push_back(copy);
-        if (mIsHeic) {
-            bufferChunk(0 /*timestampUs*/);
-            ++nChunks;
-        } else if (interleaveDurationUs == 0) {
-            addOneStscTableEntry(++nChunks, 1);
-            bufferChunk(timestampUs);
         } else {
-            if (chunkTimestampUs == 0) {
-                chunkTimestampUs = timestampUs;
+            mChunkSamples.push_back(copy);
+            if (mIsHeic) {
+                bufferChunk(0 /*timestampUs*/);
+                ++nChunks;
+            } else if (interleaveDurationUs == 0) {
+                addOneStscTableEntry(++nChunks, 1);
+                bufferChunk(timestampUs);
             } else {
-                int64_t chunkDurationUs = timestampUs - chunkTimestampUs;
-                if (chunkDurationUs > interleaveDurationUs) {
-                    if (chunkDurationUs > mMaxChunkDurationUs) {
-                        mMaxChunkDurationUs = chunkDurationUs;
-                    }
-                    ++nChunks;
-                    if (nChunks == 1 ||  // First chunk
-                        lastSamplesPerChunk != mChunkSamples.size()) {
-                        lastSamplesPerChunk = mChunkSamples.size();
-                        addOneStscTableEntry(nChunks, lastSamplesPerChunk);
-                    }
-                    bufferChunk(timestampUs);
+                if (chunkTimestampUs == 0) {
                     chunkTimestampUs = timestampUs;
+                } else {
+                    int64_t chunkDurationUs = timestampUs - chunkTimestampUs;
+                    if (chunkDurationUs > interleaveDurationUs) {
+                        if (chunkDurationUs > mMaxChunkDurationUs) {
+                            mMaxChunkDurationUs = chunkDurationUs;
+                        }
+                        ++nChunks;
+                        if (nChunks == 1 ||  // First chunk
+                            lastSamplesPerChunk != mChunkSamples.size()) {
+                            lastSamplesPerChunk = mChunkSamples.size();
+                            addOneStscTableEntry(nChunks, lastSamplesPerChunk);
+                        }
+                        bufferChunk(timestampUs);
+                        chunkTimestampUs = timestampUs;
+                    }
                 }
             }
         }
@@ -3441,6 +3761,14 @@ status_t MPEG4Writer::Track::threadEntry() {
         }
 
         mTrackDurationUs += lastDurationUs;
+
+        if (isFragmented) {
+            if (!mFragment.mSamples.empty()) {
+                (--mFragment.mSamples.end())->mDuration = lastDurationTicks;
+            }
+            bufferFragment();
+            mOwner->bufferFragment(Fragment(this));
+        }
     }
     mReachedEOS = true;
 
@@ -3603,6 +3931,71 @@ void MPEG4Writer::Track::bufferChunk(int64_t timestampUs) {
     mChunkSamples.clear();
 }
 
+/*
+ * A sample's duration is only known once the next one arrives, which is also
+ * when a fragment that has lasted long enough gets closed. Video fragments
+ * always start with a sync sample so that each can be decoded on its own.
+ */
+void MPEG4Writer::Track::addFragmentSample(
+        MediaBuffer *buffer, bool usePrefix, size_t sampleSize,
+        int64_t timestampUs, int64_t durationTicks,
+        int64_t compositionOffsetTicks, bool isSync) {
+    if (mStszTableEntries->count() == 1) {
+        // Present the first sample at the start of the track.
+        mFirstCompositionOffsetTicks = compositionOffsetTicks;
+    }
+    mFragmentDecodeTimeTicks += durationTicks;
+
+    if (!mFragment.mSamples.empty()) {
+        (--mFragment.mSamples.end())->mDuration = durationTicks;
+
+        if (isSync &&
+                timestampUs - mFragment.mTimeStampUs >= mOwner->fragmentDuration()) {
+            bufferFragment();
+        }
+    }
+
+    if (mFragment.mSamples.empty()) {
+        mFragment.mTimeStampUs = timestampUs;
+        mFragment.mDecodeTimeTicks = mFragmentDecodeTimeTicks;
+    }
+
+    FragmentSample sample;
+    sample.mBuffer = buffer;
+    sample.mUsePrefix = usePrefix;
+    sample.mSize = sampleSize;
+    sample.mDuration = 0;
+    sample.mCompositionOffset = compositionOffsetTicks - mFirstCompositionOffsetTicks;
+    sample.mIsSync = isSync;
+    mFragment.mSamples.push_back(sample);
+}
+
+void MPEG4Writer::Track::bufferFragment() {
+    if (mFragment.mSamples.empty()) {
+        return;
+    }
+
+    ALOGV("bufferFragment: %zu %s samples at %" PRId64 " us",
+            mFragment.mSamples.size(), getTrackType(), mFragment.mTimeStampUs);
+
+    mOwner->bufferFragment(mFragment);
+    mFragment.mSamples.clear();
+
+    // The fragments describe their own samples, the tables are only kept
+    // for their counts.
+    discardTableEntries();
+}
+
+void MPEG4Writer::Track::discardTableEntries() {
+    mStszTableEntries->discard();
+    mStcoTableEntries->discard();
+    mCo64TableEntries->discard();
+    mStscTableEntries->discard();
+    mStssTableEntries->discard();
+    mSttsTableEntries->discard();
+    mCttsTableEntries->discard();
+}
+
 int64_t MPEG4Writer::Track::getDurationUs() const {
     return mTrackDurationUs + getStartTimeOffsetTimeUs();
 }
@@ -3731,6 +4124,28 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
         writeMetadataFourCCBox();
     }
     mOwner->endBox();  // stsd
+    if (mOwner->isFragmented()) {
+        // The samples are all described by the fragments.
+        mOwner->beginBox("stts");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stts
+        mOwner->beginBox("stsc");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stsc
+        mOwner->beginBox("stsz");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // sample size
+        mOwner->writeInt32(0);  // sample count
+        mOwner->endBox();  // stsz
+        mOwner->beginBox("stco");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stco
+        mOwner->endBox();  // stbl
+        return;
+    }
     writeSttsBox();
     if (mIsVideo) {
         writeCttsBox();
@@ -3965,7 +4380,8 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId);      // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    // The duration of a fragmented track is the sum of its fragments'.
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -4038,7 +4454,7 @@ void MPEG4Writer::Track::writeHdlrBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(uint32_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     int64_t mdhdDuration = (trakDurationUs * mTimeScale + 5E5) / 1E6;
     mOwner->beginBox("mdhd");
 
@@ -4247,6 +4663,70 @@ void MPEG4Writer::Track::writeStcoBox(bool use32BitOffset) {
     mOwner->endBox();  // stco or co64
 }
 
+void MPEG4Writer::Track::writeTrexBox() {
+    mOwner->beginBox("trex");
+    mOwner->writeInt32(0);        // version=0, flags=0
+    mOwner->writeInt32(mTrackId);
+    mOwner->writeInt32(1);        // default sample description index
+    mOwner->writeInt32(0);        // default sample duration
+    mOwner->writeInt32(0);        // default sample size
+    mOwner->writeInt32(0);        // default sample flags
+    mOwner->endBox();  // trex
+}
+
+/*
+ * Writes the run of samples in |fragment|, whose data is to follow the moof
+ * in an mdat. The data offset is not known yet, it is left as 0 for the caller
+ * to fill in at |*dataOffsetPos|.
+ */
+void MPEG4Writer::Track::writeTrafBox(const Fragment &fragment, off64_t *dataOffsetPos) {
+    bool hasNegativeOffset = false;
+    for (List<FragmentSample>::const_iterator it = fragment.mSamples.begin();
+         it != fragment.mSamples.end(); ++it) {
+        if (it->mCompositionOffset < 0) {
+            hasNegativeOffset = true;
+            break;
+        }
+    }
+
+    mOwner->beginBox("traf");
+    mOwner->beginBox("tfhd");
+    mOwner->writeInt32(0x020000);             // version=0, flags=default-base-is-moof
+    mOwner->writeInt32(mTrackId);
+    mOwner->endBox();  // tfhd
+
+    mOwner->beginBox("tfdt");
+    mOwner->writeInt32((1 << 24));            // version=1, flags=0
+    mOwner->writeInt64(getStartTimeOffsetScaledTime() + fragment.mDecodeTimeTicks);
+    mOwner->endBox();  // tfdt
+
+    // data offset, sample duration, size and flags, composition time offset
+    uint32_t flags = 0x000001 | 0x000100 | 0x000200 | 0x000400;
+    if (mIsVideo) {
+        flags |= 0x000800;
+    }
+    // Version 1 has signed composition time offsets.
+    uint32_t version = hasNegativeOffset ? 1 : 0;
+    mOwner->beginBox("trun");
+    mOwner->writeInt32((version << 24) | flags);
+    mOwner->writeInt32(fragment.mSamples.size());
+    *dataOffsetPos = mOwner->mOffset;
+    mOwner->writeInt32(0);                    // data offset
+    for (List<FragmentSample>::const_iterator it = fragment.mSamples.begin();
+         it != fragment.mSamples.end(); ++it) {
+        mOwner->writeInt32(it->mDuration);
+        mOwner->writeInt32(it->mSize);
+        // sample_depends_on=2 for sync samples, otherwise sample_depends_on=1
+        // and sample_is_non_sync_sample=1
+        mOwner->writeInt32(it->mIsSync ? 0x02000000 : 0x01010000);
+        if (mIsVideo) {
+            mOwner->writeInt32(it->mCompositionOffset);
+        }
+    }
+    mOwner->endBox();  // trun
+    mOwner->endBox();  // traf
+}
+
 void MPEG4Writer::writeUdtaBox() {
     beginBox("udta");
     writeGeoDataBox();
@@ -24,8 +24,12 @@
 
 namespace android {
 
-MediaAdapter::MediaAdapter(const sp<MetaData> &meta)
-    : mCurrentMediaBuffer(NULL),
+// How long stop() waits for the reader to make progress on the queued buffers.
+static const nsecs_t kDrainTimeoutNs = 1000000000ll;
+
+MediaAdapter::MediaAdapter(const sp<MetaData> &meta, size_t maxQueuedBytes)
+    : mQueuedBytes(0),
+      mMaxQueuedBytes(maxQueuedBytes),
       mStarted(false),
       mOutputFormat(meta) {
 }
@@ -33,7 +37,7 @@ MediaAdapter::MediaAdapter(const sp<MetaData> &meta)
 MediaAdapter::~MediaAdapter() {
     Mutex::Autolock autoLock(mAdapterLock);
     mOutputFormat.clear();
-    CHECK(mCurrentMediaBuffer == NULL);
+    CHECK(mBufferQueue.empty());
 }
 
 status_t MediaAdapter::start(MetaData * /* params */) {
@@ -45,24 +49,33 @@ status_t MediaAdapter::start(MetaData * /* params */) {
 }
 
 status_t MediaAdapter::stop() {
-    MediaBuffer *currentBuffer = NULL;
+    List<MediaBuffer *> pendingBuffers;
     {
         Mutex::Autolock autoLock(mAdapterLock);
         if (mStarted) {
+            // Let the reader drain what was pushed before stop(), as long as
+            // it keeps making progress.
+            while (!mBufferQueue.empty()) {
+                if (mBufferReturnedCond.waitRelative(mAdapterLock, kDrainTimeoutNs) != OK) {
+                    ALOGW("dropping %zu buffers not read before stop",
+                            mBufferQueue.size());
+                    break;
+                }
+            }
             mStarted = false;
-            // If stop() happens immediately after a pushBuffer(), we should
-            // clean up the mCurrentMediaBuffer. But need to release without
-            // the lock as signalBufferReturned() will acquire the lock.
-            currentBuffer = mCurrentMediaBuffer;
-            mCurrentMediaBuffer = NULL;
+            // Release the leftovers without the lock, as
+            // signalBufferReturned() will acquire the lock.
+            pendingBuffers = mBufferQueue;
+            mBufferQueue.clear();
 
-            // While read() is still waiting, we should signal it to finish.
+            // While read() or pushBuffer() is still waiting, we should signal it to finish.
             mBufferReadCond.signal();
+            mBufferReturnedCond.broadcast();
         }
     }
-    if (currentBuffer != NULL) {
-        currentBuffer->release();
-        currentBuffer = NULL;
+    for (List<MediaBuffer *>::iterator it = pendingBuffers.begin();
+            it != pendingBuffers.end(); ++it) {
+        (*it)->release();
     }
     return OK;
 }
@@ -75,10 +88,12 @@ sp<MetaData> MediaAdapter::getFormat() {
 void MediaAdapter::signalBufferReturned(MediaBufferBase *buffer) {
     Mutex::Autolock autoLock(mAdapterLock);
     CHECK(buffer != NULL);
+    CHECK_GE(mQueuedBytes, buffer->size());
+    mQueuedBytes -= buffer->size();
     buffer->setObserver(0);
     buffer->release();
     ALOGV("buffer returned %p", buffer);
-    mBufferReturnedCond.signal();
+    mBufferReturnedCond.broadcast();
 }
 
 status_t MediaAdapter::read(
@@ -89,21 +104,20 @@ status_t MediaAdapter::read(
         return ERROR_END_OF_STREAM;
     }
 
-    while (mCurrentMediaBuffer == NULL && mStarted) {
+    while (mBufferQueue.empty() && mStarted) {
         ALOGV("waiting @ read()");
         mBufferReadCond.wait(mAdapterLock);
     }
 
     if (!mStarted) {
         ALOGV("read interrupted after stop");
-        CHECK(mCurrentMediaBuffer == NULL);
+        CHECK(mBufferQueue.empty());
         return ERROR_END_OF_STREAM;
     }
 
-    CHECK(mCurrentMediaBuffer != NULL);
-
-    *buffer = mCurrentMediaBuffer;
-    mCurrentMediaBuffer = NULL;
+    *buffer = *mBufferQueue.begin();
+    mBufferQueue.erase(mBufferQueue.begin());
+    mBufferReturnedCond.broadcast();
 
     return OK;
 }
@@ -115,19 +129,23 @@ status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
     }
 
     Mutex::Autolock autoLock(mAdapterLock);
+    // Always accept a buffer when nothing is queued, however large it is.
+    while (mStarted && mQueuedBytes > 0
+            && mQueuedBytes + buffer->size() > mMaxQueuedBytes) {
+        ALOGV("wait for queued buffers to drain @ pushBuffer! %p", buffer);
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
     if (!mStarted) {
         ALOGE("pushBuffer called before start");
+        buffer->release();
         return INVALID_OPERATION;
     }
-    mCurrentMediaBuffer = buffer;
-    mCurrentMediaBuffer->setObserver(this);
+    buffer->setObserver(this);
+    mQueuedBytes += buffer->size();
+    mBufferQueue.push_back(buffer);
     mBufferReadCond.signal();
 
-    ALOGV("wait for the buffer returned @ pushBuffer! %p", buffer);
-    mBufferReturnedCond.wait(mAdapterLock);
-
     return OK;
 }
 
 }  // namespace android
-
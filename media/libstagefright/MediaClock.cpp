@@ -30,6 +30,12 @@ namespace android {
 // If larger than this threshold, it's treated as discontinuity.
 static const int64_t kAnchorFluctuationAllowedUs = 10000ll;
 
+// Anchor updates that move the clock forward by less than this are treated as
+// drift and only applied in part, so the media time is slewed towards the new
+// anchor over a few updates rather than jumping to it.
+static const int64_t kAnchorSlewMaxUs = 40000ll;
+static const int64_t kAnchorSlewDivisor = 4;
+
 MediaClock::Timer::Timer(const sp<AMessage> &notify, int64_t mediaTimeUs, int64_t adjustRealUs)
     : mNotify(notify),
       mMediaTimeUs(mediaTimeUs),
@@ -42,7 +48,13 @@ MediaClock::MediaClock()
       mMaxTimeMediaUs(INT64_MAX),
       mStartingTimeMediaUs(-1),
       mPlaybackRate(1.0),
-      mGeneration(0) {
+      mGeneration(0),
+      mAnchorSeq(0),
+      mPublishedAnchorTimeMediaUs(-1),
+      mPublishedAnchorTimeRealUs(-1),
+      mPublishedMaxTimeMediaUs(INT64_MAX),
+      mPublishedStartingTimeMediaUs(-1),
+      mPublishedPlaybackRate(1.0) {
     mLooper = new ALooper;
     mLooper->setName("MediaClock");
     mLooper->start(false /* runOnCallingThread */,
@@ -66,19 +78,21 @@ void MediaClock::reset() {
     Mutex::Autolock autoLock(mLock);
     auto it = mTimers.begin();
     while (it != mTimers.end()) {
-        it->mNotify->setInt32("reason", TIMER_REASON_RESET);
-        it->mNotify->post();
+        it->second.mNotify->setInt32("reason", TIMER_REASON_RESET);
+        it->second.mNotify->post();
         it = mTimers.erase(it);
     }
     mMaxTimeMediaUs = INT64_MAX;
     mStartingTimeMediaUs = -1;
     updateAnchorTimesAndPlaybackRate_l(-1, -1, 1.0);
+    publishAnchor_l();
     ++mGeneration;
 }
 
 void MediaClock::setStartingTimeMedia(int64_t startingTimeMediaUs) {
     Mutex::Autolock autoLock(mLock);
     mStartingTimeMediaUs = startingTimeMediaUs;
+    publishAnchor_l();
 }
 
 void MediaClock::clearAnchor() {
@@ -106,6 +120,7 @@ void MediaClock::updateAnchor(
 
     if (maxTimeMediaUs != -1) {
         mMaxTimeMediaUs = maxTimeMediaUs;
+        publishAnchor_l();
     }
     if (mAnchorTimeRealUs != -1) {
         int64_t oldNowMediaUs =
@@ -114,6 +129,12 @@ void MediaClock::updateAnchor(
                 && nowMediaUs > oldNowMediaUs - kAnchorFluctuationAllowedUs) {
             return;
         }
+        // While playing, absorb small forward drift gradually. A paused clock
+        // must sit exactly on the rendered frame, so it is always stepped.
+        if (mPlaybackRate > 0.0 && nowMediaUs > oldNowMediaUs
+                && nowMediaUs < oldNowMediaUs + kAnchorSlewMaxUs) {
+            nowMediaUs = oldNowMediaUs + (nowMediaUs - oldNowMediaUs) / kAnchorSlewDivisor;
+        }
     }
     updateAnchorTimesAndPlaybackRate_l(nowMediaUs, nowUs, mPlaybackRate);
 
@@ -124,6 +145,7 @@ void MediaClock::updateAnchor(
 void MediaClock::updateMaxTimeMedia(int64_t maxTimeMediaUs) {
     Mutex::Autolock autoLock(mLock);
     mMaxTimeMediaUs = maxTimeMediaUs;
+    publishAnchor_l();
 }
 
 void MediaClock::setPlaybackRate(float rate) {
@@ -131,6 +153,8 @@ void MediaClock::setPlaybackRate(float rate) {
     Mutex::Autolock autoLock(mLock);
     if (mAnchorTimeRealUs == -1) {
         mPlaybackRate = rate;
+        publishAnchor_l();
+        rekeyTimers_l();
         return;
     }
 
@@ -149,8 +173,7 @@ void MediaClock::setPlaybackRate(float rate) {
 }
 
 float MediaClock::getPlaybackRate() const {
-    Mutex::Autolock autoLock(mLock);
-    return mPlaybackRate;
+    return mPublishedPlaybackRate.load(std::memory_order_acquire);
 }
 
 status_t MediaClock::getMediaTime(
@@ -159,23 +182,34 @@ status_t MediaClock::getMediaTime(
         return BAD_VALUE;
     }
 
-    Mutex::Autolock autoLock(mLock);
-    return getMediaTime_l(realUs, outMediaUs, allowPastMaxTime);
+    return GetMediaTime(readAnchor(), realUs, outMediaUs, allowPastMaxTime);
 }
 
 status_t MediaClock::getMediaTime_l(
         int64_t realUs, int64_t *outMediaUs, bool allowPastMaxTime) const {
-    if (mAnchorTimeRealUs == -1) {
+    Anchor anchor;
+    anchor.mAnchorTimeMediaUs = mAnchorTimeMediaUs;
+    anchor.mAnchorTimeRealUs = mAnchorTimeRealUs;
+    anchor.mMaxTimeMediaUs = mMaxTimeMediaUs;
+    anchor.mStartingTimeMediaUs = mStartingTimeMediaUs;
+    anchor.mPlaybackRate = mPlaybackRate;
+    return GetMediaTime(anchor, realUs, outMediaUs, allowPastMaxTime);
+}
+
+// static
+status_t MediaClock::GetMediaTime(
+        const Anchor &anchor, int64_t realUs, int64_t *outMediaUs, bool allowPastMaxTime) {
+    if (anchor.mAnchorTimeRealUs == -1) {
         return NO_INIT;
     }
 
-    int64_t mediaUs = mAnchorTimeMediaUs
-            + (realUs - mAnchorTimeRealUs) * (double)mPlaybackRate;
-    if (mediaUs > mMaxTimeMediaUs && !allowPastMaxTime) {
-        mediaUs = mMaxTimeMediaUs;
+    int64_t mediaUs = anchor.mAnchorTimeMediaUs
+            + (realUs - anchor.mAnchorTimeRealUs) * (double)anchor.mPlaybackRate;
+    if (mediaUs > anchor.mMaxTimeMediaUs && !allowPastMaxTime) {
+        mediaUs = anchor.mMaxTimeMediaUs;
     }
-    if (mediaUs < mStartingTimeMediaUs) {
-        mediaUs = mStartingTimeMediaUs;
+    if (mediaUs < anchor.mStartingTimeMediaUs) {
+        mediaUs = anchor.mStartingTimeMediaUs;
     }
     if (mediaUs < 0) {
         mediaUs = 0;
@@ -190,40 +224,75 @@ status_t MediaClock::getRealTimeFor(
         return BAD_VALUE;
     }
 
-    Mutex::Autolock autoLock(mLock);
-    if (mPlaybackRate == 0.0) {
+    Anchor anchor = readAnchor();
+    if (anchor.mPlaybackRate == 0.0) {
         return NO_INIT;
     }
 
     int64_t nowUs = ALooper::GetNowUs();
     int64_t nowMediaUs;
     status_t status =
-            getMediaTime_l(nowUs, &nowMediaUs, true /* allowPastMaxTime */);
+            GetMediaTime(anchor, nowUs, &nowMediaUs, true /* allowPastMaxTime */);
     if (status != OK) {
         return status;
     }
-    *outRealUs = (targetMediaUs - nowMediaUs) / (double)mPlaybackRate + nowUs;
+    *outRealUs = (targetMediaUs - nowMediaUs) / (double)anchor.mPlaybackRate + nowUs;
     return OK;
 }
 
+MediaClock::Anchor MediaClock::readAnchor() const {
+    Anchor anchor;
+    uint32_t seq;
+    do {
+        seq = mAnchorSeq.load(std::memory_order_acquire);
+        anchor.mAnchorTimeMediaUs =
+                mPublishedAnchorTimeMediaUs.load(std::memory_order_relaxed);
+        anchor.mAnchorTimeRealUs =
+                mPublishedAnchorTimeRealUs.load(std::memory_order_relaxed);
+        anchor.mMaxTimeMediaUs = mPublishedMaxTimeMediaUs.load(std::memory_order_relaxed);
+        anchor.mStartingTimeMediaUs =
+                mPublishedStartingTimeMediaUs.load(std::memory_order_relaxed);
+        anchor.mPlaybackRate = mPublishedPlaybackRate.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) != 0 || mAnchorSeq.load(std::memory_order_relaxed) != seq);
+    return anchor;
+}
+
+void MediaClock::publishAnchor_l() {
+    uint32_t seq = mAnchorSeq.load(std::memory_order_relaxed);
+    mAnchorSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mPublishedAnchorTimeMediaUs.store(mAnchorTimeMediaUs, std::memory_order_relaxed);
+    mPublishedAnchorTimeRealUs.store(mAnchorTimeRealUs, std::memory_order_relaxed);
+    mPublishedMaxTimeMediaUs.store(mMaxTimeMediaUs, std::memory_order_relaxed);
+    mPublishedStartingTimeMediaUs.store(mStartingTimeMediaUs, std::memory_order_relaxed);
+    mPublishedPlaybackRate.store(mPlaybackRate, std::memory_order_relaxed);
+    mAnchorSeq.store(seq + 2, std::memory_order_release);
+}
+
+// static
+int64_t MediaClock::GetTimerMediaUs(const Timer &timer, float playbackRate) {
+    double mediaUs = timer.mAdjustRealUs * (double)playbackRate + timer.mMediaTimeUs;
+    if (mediaUs > (double)INT64_MAX) {
+        return INT64_MAX;
+    } else if (mediaUs < (double)INT64_MIN) {
+        return INT64_MIN;
+    }
+    return mediaUs;
+}
+
 void MediaClock::addTimer(const sp<AMessage> &notify, int64_t mediaTimeUs,
                           int64_t adjustRealUs) {
     Mutex::Autolock autoLock(mLock);
 
-    bool updateTimer = (mPlaybackRate != 0.0);
-    if (updateTimer) {
-        auto it = mTimers.begin();
-        while (it != mTimers.end()) {
-            if (((it->mAdjustRealUs - (double)adjustRealUs) * (double)mPlaybackRate
-                + (it->mMediaTimeUs - mediaTimeUs)) <= 0) {
-                updateTimer = false;
-                break;
-            }
-            ++it;
-        }
-    }
+    Timer timer(notify, mediaTimeUs, adjustRealUs);
+    int64_t timerMediaUs = GetTimerMediaUs(timer, mPlaybackRate);
 
-    mTimers.emplace_back(notify, mediaTimeUs, adjustRealUs);
+    // Only a new earliest timer changes when the next wake up is due.
+    bool updateTimer = (mPlaybackRate != 0.0)
+            && (mTimers.empty() || timerMediaUs < mTimers.begin()->first);
+
+    mTimers.emplace(timerMediaUs, timer);
 
     if (updateTimer) {
         ++mGeneration;
@@ -261,47 +330,24 @@ void MediaClock::processTimers_l() {
         return;
     }
 
-    int64_t nextLapseRealUs = INT64_MAX;
-    std::multimap<int64_t, Timer> notifyList;
+    // mTimers is ordered by firing time, so the due timers are at its front.
     auto it = mTimers.begin();
-    while (it != mTimers.end()) {
-        double diff = it->mAdjustRealUs * (double)mPlaybackRate
-            + it->mMediaTimeUs - nowMediaTimeUs;
-        int64_t diffMediaUs;
-        if (diff > (double)INT64_MAX) {
-            diffMediaUs = INT64_MAX;
-        } else if (diff < (double)INT64_MIN) {
-            diffMediaUs = INT64_MIN;
-        } else {
-            diffMediaUs = diff;
-        }
-
-        if (diffMediaUs <= 0) {
-            notifyList.emplace(diffMediaUs, *it);
-            it = mTimers.erase(it);
-        } else {
-            if (mPlaybackRate != 0.0
-                && (double)diffMediaUs < INT64_MAX * (double)mPlaybackRate) {
-                int64_t targetRealUs = diffMediaUs / (double)mPlaybackRate;
-                if (targetRealUs < nextLapseRealUs) {
-                    nextLapseRealUs = targetRealUs;
-                }
-            }
-            ++it;
-        }
+    while (it != mTimers.end() && it->first <= nowMediaTimeUs) {
+        it->second.mNotify->setInt32("reason", TIMER_REASON_REACHED);
+        it->second.mNotify->post();
+        it = mTimers.erase(it);
     }
 
-    auto itNotify = notifyList.begin();
-    while (itNotify != notifyList.end()) {
-        itNotify->second.mNotify->setInt32("reason", TIMER_REASON_REACHED);
-        itNotify->second.mNotify->post();
-        itNotify = notifyList.erase(itNotify);
+    if (mTimers.empty() || mPlaybackRate == 0.0 || mAnchorTimeMediaUs < 0) {
+        return;
     }
 
-    if (mTimers.empty() || mPlaybackRate == 0.0 || mAnchorTimeMediaUs < 0
-        || nextLapseRealUs == INT64_MAX) {
+    int64_t diffMediaUs = mTimers.begin()->first - nowMediaTimeUs;
+    if (mTimers.begin()->first == INT64_MAX
+            || (double)diffMediaUs >= INT64_MAX * (double)mPlaybackRate) {
         return;
     }
+    int64_t nextLapseRealUs = diffMediaUs / (double)mPlaybackRate;
 
     sp<AMessage> msg = new AMessage(kWhatTimeIsUp, this);
     msg->setInt32("generation", mGeneration);
@@ -313,13 +359,30 @@ void MediaClock::updateAnchorTimesAndPlaybackRate_l(int64_t anchorTimeMediaUs,
     if (mAnchorTimeMediaUs != anchorTimeMediaUs
             || mAnchorTimeRealUs != anchorTimeRealUs
             || mPlaybackRate != playbackRate) {
+        bool rateChanged = (mPlaybackRate != playbackRate);
         mAnchorTimeMediaUs = anchorTimeMediaUs;
         mAnchorTimeRealUs = anchorTimeRealUs;
         mPlaybackRate = playbackRate;
+        publishAnchor_l();
+        if (rateChanged) {
+            rekeyTimers_l();
+        }
         notifyDiscontinuity_l();
     }
 }
 
+void MediaClock::rekeyTimers_l() {
+    if (mTimers.empty()) {
+        return;
+    }
+    // The firing order depends on the rate when timers have real time adjustments.
+    std::multimap<int64_t, Timer> timers;
+    for (auto it = mTimers.begin(); it != mTimers.end(); ++it) {
+        timers.emplace(GetTimerMediaUs(it->second, mPlaybackRate), it->second);
+    }
+    mTimers.swap(timers);
+}
+
 void MediaClock::setNotificationMessage(const sp<AMessage> &msg) {
     Mutex::Autolock autoLock(mLock);
     mNotify = msg;
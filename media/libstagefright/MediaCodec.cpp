@@ -95,6 +95,10 @@ static const char *kCodecLatencyAvg = "android.media.mediacodec.latency.avg";
 static const char *kCodecLatencyCount = "android.media.mediacodec.latency.n";
 static const char *kCodecLatencyHist = "android.media.mediacodec.latency.hist"; /* in us */
 static const char *kCodecLatencyUnknown = "android.media.mediacodec.latency.unknown";
+static const char *kCodecFlushCount = "android.media.mediacodec.flush.n";
+static const char *kCodecFlushMax = "android.media.mediacodec.flush.max";     /* in us */
+// summed per phase as "android.media.mediacodec.flush.<phase>", in us
+static const char *kCodecFlushPhasePrefix = "android.media.mediacodec.flush.";
 
 // the kCodecRecent* fields appear only in getMetrics() results
 static const char *kCodecRecentLatencyMax = "android.media.mediacodec.recent.max";      /* in us */
@@ -241,6 +245,7 @@ enum {
     kWhatStopCompleted       = 'scom',
     kWhatReleaseCompleted    = 'rcom',
     kWhatFlushCompleted      = 'fcom',
+    kWhatFlushPhasesMeasured = 'fphs',
     kWhatError               = 'erro',
     kWhatComponentAllocated  = 'cAll',
     kWhatComponentConfigured = 'cCon',
@@ -295,6 +300,7 @@ public:
     virtual void onStopCompleted() override;
     virtual void onReleaseCompleted() override;
     virtual void onFlushCompleted() override;
+    virtual void onFlushPhasesMeasured(const sp<AMessage> &phases) override;
     virtual void onError(status_t err, enum ActionCode actionCode) override;
     virtual void onComponentAllocated(const char *componentName) override;
     virtual void onComponentConfigured(
@@ -348,6 +354,13 @@ void CodecCallback::onFlushCompleted() {
     notify->post();
 }
 
+void CodecCallback::onFlushPhasesMeasured(const sp<AMessage> &phases) {
+    sp<AMessage> notify(mNotify->dup());
+    notify->setInt32("what", kWhatFlushPhasesMeasured);
+    notify->setMessage("phases", phases);
+    notify->post();
+}
+
 void CodecCallback::onError(status_t err, enum ActionCode actionCode) {
     sp<AMessage> notify(mNotify->dup());
     notify->setInt32("what", kWhatError);
@@ -525,6 +538,7 @@ MediaCodec::MediaCodec(const sp<ALooper> &looper, pid_t pid, uid_t uid)
       mVideoWidth(0),
       mVideoHeight(0),
       mRotationDegrees(0),
+      mVideoCodecLoad(0),
       mDequeueInputTimeoutGeneration(0),
       mDequeueInputReplyID(0),
       mDequeueOutputTimeoutGeneration(0),
@@ -593,6 +607,33 @@ void MediaCodec::updateAnalyticsItem() {
 #endif
 }
 
+void MediaCodec::onFlushPhasesMeasured(const sp<AMessage> &phases) {
+    if (mAnalyticsItem == NULL) {
+        return;
+    }
+
+    mAnalyticsItem->addInt64(kCodecFlushCount, 1);
+
+    for (size_t i = 0; i < phases->countEntries(); ++i) {
+        AMessage::Type type;
+        const char *name = phases->getEntryNameAt(i, &type);
+        int64_t durationUs;
+        if (type != AMessage::kTypeInt64 || !phases->findInt64(name, &durationUs)) {
+            continue;
+        }
+
+        std::string key = std::string(kCodecFlushPhasePrefix) + name;
+        mAnalyticsItem->addInt64(key.c_str(), durationUs);
+
+        if (!strcmp(name, "total-us")) {
+            int64_t maxUs;
+            if (!mAnalyticsItem->getInt64(kCodecFlushMax, &maxUs) || durationUs > maxUs) {
+                mAnalyticsItem->setInt64(kCodecFlushMax, durationUs);
+            }
+        }
+    }
+}
+
 void MediaCodec::updateEphemeralAnalytics(MediaAnalyticsItem *item) {
     ALOGD("MediaCodec::updateEphemeralAnalytics()");
 
@@ -637,7 +678,7 @@ void MediaCodec::flushAnalyticsItem() {
     if (mAnalyticsItem != NULL) {
         // don't log empty records
         if (mAnalyticsItem->count() > 0) {
-            mAnalyticsItem->selfrecord();
+            mAnalyticsItem->selfrecordBatched();
         }
         delete mAnalyticsItem;
         mAnalyticsItem = NULL;
@@ -1059,6 +1100,22 @@ status_t MediaCodec::configure(
             ALOGE("buffer size is too big, width=%d, height=%d", mVideoWidth, mVideoHeight);
             return BAD_VALUE;
         }
+
+        mVideoCodecLoad = 0;
+        if (mVideoWidth > 0 && mVideoHeight > 0) {
+            float frameRate;
+            int32_t frameRateInt;
+            if (format->findInt32("frame-rate", &frameRateInt)) {
+                frameRate = frameRateInt;
+            } else if (!format->findFloat("frame-rate", &frameRate)) {
+                frameRate = 30.0f;
+            }
+            if (frameRate > 0) {
+                uint64_t macroblocks =
+                        (uint64_t)((mVideoWidth + 15) / 16) * ((mVideoHeight + 15) / 16);
+                mVideoCodecLoad = (uint64_t)(macroblocks * frameRate + 0.5f);
+            }
+        }
     }
 
     msg->setMessage("format", format);
@@ -1084,6 +1141,14 @@ status_t MediaCodec::configure(
     // save msg for reset
     mConfigureMsg = msg;
 
+    if (mVideoCodecLoad > 0) {
+        // Ask for room up front if this session is predicted not to fit next to the
+        // running ones, instead of only after the allocation has failed.
+        Vector<MediaResource> load;
+        load.push_back(MediaResource(MediaResource::kVideoCodecLoad, mVideoCodecLoad));
+        mResourceManagerService->reclaimResource(load);
+    }
+
     status_t err;
     Vector<MediaResource> resources;
     MediaResource::Type type = (mFlags & kFlagIsSecure) ?
@@ -1238,6 +1303,9 @@ status_t MediaCodec::start() {
     // Don't know the buffer size at this point, but it's fine to use 1 because
     // the reclaimResource call doesn't consider the requester's buffer size for now.
     resources.push_back(MediaResource(MediaResource::kGraphicMemory, 1));
+    if (mVideoCodecLoad > 0) {
+        resources.push_back(MediaResource(MediaResource::kVideoCodecLoad, mVideoCodecLoad));
+    }
     for (int i = 0; i <= kMaxRetry; ++i) {
         if (i > 0) {
             // Don't try to reclaim resource for the first time.
@@ -1440,6 +1508,87 @@ status_t MediaCodec::dequeueOutputBuffer(
     return OK;
 }
 
+status_t MediaCodec::queueInputBuffers(
+        const BufferDescriptor *buffers,
+        size_t count,
+        size_t *queued,
+        AString *errorDetailMsg) {
+    if (errorDetailMsg != NULL) {
+        errorDetailMsg->clear();
+    }
+    *queued = 0;
+    if (count == 0) {
+        return OK;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffers, this);
+    msg->setPointer("buffers", (void *)buffers);
+    msg->setSize("count", count);
+    msg->setPointer("queued", queued);
+    msg->setPointer("errorDetailMsg", errorDetailMsg);
+
+    sp<AMessage> response;
+    return PostAndAwaitResponse(msg, &response);
+}
+
+status_t MediaCodec::dequeueInputBuffers(
+        size_t *indices, size_t maxCount, size_t *count, int64_t timeoutUs) {
+    *count = 0;
+    if (maxCount == 0) {
+        return BAD_VALUE;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatDequeueInputBuffers, this);
+    msg->setInt64("timeoutUs", timeoutUs);
+    msg->setPointer("indices", indices);
+    msg->setSize("maxCount", maxCount);
+
+    sp<AMessage> response;
+    status_t err;
+    if ((err = PostAndAwaitResponse(msg, &response)) != OK) {
+        return err;
+    }
+
+    if (!response->findSize("count", count)) {
+        // a single buffer, from the same path as dequeueInputBuffer()
+        CHECK(response->findSize("index", &indices[0]));
+        *count = 1;
+    }
+
+    return OK;
+}
+
+status_t MediaCodec::dequeueOutputBuffers(
+        BufferDescriptor *buffers, size_t maxCount, size_t *count, int64_t timeoutUs) {
+    *count = 0;
+    if (maxCount == 0) {
+        return BAD_VALUE;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatDequeueOutputBuffers, this);
+    msg->setInt64("timeoutUs", timeoutUs);
+    msg->setPointer("buffers", buffers);
+    msg->setSize("maxCount", maxCount);
+
+    sp<AMessage> response;
+    status_t err;
+    if ((err = PostAndAwaitResponse(msg, &response)) != OK) {
+        return err;
+    }
+
+    if (!response->findSize("count", count)) {
+        // a single buffer, from the same path as dequeueOutputBuffer()
+        CHECK(response->findSize("index", &buffers[0].mIndex));
+        CHECK(response->findSize("offset", &buffers[0].mOffset));
+        CHECK(response->findSize("size", &buffers[0].mSize));
+        CHECK(response->findInt64("timeUs", &buffers[0].mPresentationTimeUs));
+        CHECK(response->findInt32("flags", (int32_t *)&buffers[0].mFlags));
+        *count = 1;
+    }
+
+    return OK;
+}
+
 status_t MediaCodec::renderOutputBufferAndRelease(size_t index) {
     sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this);
     msg->setSize("index", index);
@@ -1778,6 +1927,79 @@ bool MediaCodec::handleDequeueOutputBuffer(const sp<AReplyToken> &replyID, bool
     return true;
 }
 
+// Returns true if a reply was posted: only when input buffers are available right away.
+// Errors and waiting are left to handleDequeueInputBuffer().
+bool MediaCodec::handleDequeueInputBuffers(
+        const sp<AMessage> &msg, const sp<AReplyToken> &replyID) {
+    if (!isExecuting() || (mFlags & (kFlagStickyError | kFlagDequeueInputPending))
+            || mAvailPortBuffers[kPortIndexInput].empty()) {
+        return false;
+    }
+
+    size_t *indices;
+    size_t maxCount;
+    CHECK(msg->findPointer("indices", (void **)&indices));
+    CHECK(msg->findSize("maxCount", &maxCount));
+
+    size_t count = 0;
+    while (count < maxCount) {
+        ssize_t index = dequeuePortBuffer(kPortIndexInput);
+        if (index < 0) {
+            break;
+        }
+        indices[count++] = index;
+    }
+
+    sp<AMessage> response = new AMessage;
+    response->setSize("count", count);
+    response->postReply(replyID);
+
+    return true;
+}
+
+// Same for output buffers, also leaving output format and buffer changes to
+// handleDequeueOutputBuffer().
+bool MediaCodec::handleDequeueOutputBuffers(
+        const sp<AMessage> &msg, const sp<AReplyToken> &replyID) {
+    if (!isExecuting()
+            || (mFlags & (kFlagStickyError | kFlagDequeueOutputPending
+                    | kFlagOutputBuffersChanged | kFlagOutputFormatChanged))
+            || mAvailPortBuffers[kPortIndexOutput].empty()) {
+        return false;
+    }
+
+    BufferDescriptor *buffers;
+    size_t maxCount;
+    CHECK(msg->findPointer("buffers", (void **)&buffers));
+    CHECK(msg->findSize("maxCount", &maxCount));
+
+    size_t count = 0;
+    while (count < maxCount) {
+        ssize_t index = dequeuePortBuffer(kPortIndexOutput);
+        if (index < 0) {
+            break;
+        }
+
+        const sp<MediaCodecBuffer> &buffer =
+            mPortBuffers[kPortIndexOutput][index].mData;
+        BufferDescriptor *desc = &buffers[count++];
+
+        desc->mIndex = index;
+        desc->mOffset = buffer->offset();
+        desc->mSize = buffer->size();
+        CHECK(buffer->meta()->findInt64("timeUs", &desc->mPresentationTimeUs));
+        CHECK(buffer->meta()->findInt32("flags", (int32_t *)&desc->mFlags));
+
+        statsBufferReceived(desc->mPresentationTimeUs);
+    }
+
+    sp<AMessage> response = new AMessage;
+    response->setSize("count", count);
+    response->postReply(replyID);
+
+    return true;
+}
+
 void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatCodecNotify:
@@ -2082,12 +2304,26 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                                 MediaResource::kGraphicMemory,
                                 MediaResource::kUnspecifiedSubType,
                                 getGraphicBufferSize());
+                        if (mVideoCodecLoad > 0) {
+                            addResource(
+                                    MediaResource::kVideoCodecLoad,
+                                    MediaResource::kVideoCodec,
+                                    mVideoCodecLoad);
+                        }
                     }
                     setState(STARTED);
                     (new AMessage)->postReply(mReplyID);
                     break;
                 }
 
+                case kWhatFlushPhasesMeasured:
+                {
+                    sp<AMessage> phases;
+                    CHECK(msg->findMessage("phases", &phases));
+                    onFlushPhasesMeasured(phases);
+                    break;
+                }
+
                 case kWhatOutputBuffersChanged:
                 {
                     mFlags |= kFlagOutputBuffersChanged;
@@ -2681,6 +2917,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
         }
 
         case kWhatDequeueInputBuffer:
+        case kWhatDequeueInputBuffers:
         {
             sp<AReplyToken> replyID;
             CHECK(msg->senderAwaitsResponse(&replyID));
@@ -2697,6 +2934,11 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
+            if (msg->what() == kWhatDequeueInputBuffers
+                    && handleDequeueInputBuffers(msg, replyID)) {
+                break;
+            }
+
             if (handleDequeueInputBuffer(replyID, true /* new request */)) {
                 break;
             }
@@ -2760,7 +3002,47 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatQueueInputBuffers:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            if (!isExecuting()) {
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagStickyError) {
+                PostReplyWithError(replyID, getStickyError());
+                break;
+            }
+
+            const BufferDescriptor *buffers;
+            size_t count;
+            size_t *queued;
+            CHECK(msg->findPointer("buffers", (void **)&buffers));
+            CHECK(msg->findSize("count", &count));
+            CHECK(msg->findPointer("queued", (void **)&queued));
+
+            // reuse the message for each buffer, as onQueueInputBuffer() expects
+            status_t err = OK;
+            size_t i = 0;
+            for (; i < count; ++i) {
+                msg->setSize("index", buffers[i].mIndex);
+                msg->setSize("offset", buffers[i].mOffset);
+                msg->setSize("size", buffers[i].mSize);
+                msg->setInt64("timeUs", buffers[i].mPresentationTimeUs);
+                msg->setInt32("flags", buffers[i].mFlags);
+                if ((err = onQueueInputBuffer(msg)) != OK) {
+                    break;
+                }
+            }
+            *queued = i;
+
+            PostReplyWithError(replyID, err);
+            break;
+        }
+
         case kWhatDequeueOutputBuffer:
+        case kWhatDequeueOutputBuffers:
         {
             sp<AReplyToken> replyID;
             CHECK(msg->senderAwaitsResponse(&replyID));
@@ -2771,6 +3053,11 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
+            if (msg->what() == kWhatDequeueOutputBuffers
+                    && handleDequeueOutputBuffers(msg, replyID)) {
+                break;
+            }
+
             if (handleDequeueOutputBuffer(replyID, true /* new request */)) {
                 break;
             }
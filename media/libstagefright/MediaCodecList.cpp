@@ -18,6 +18,7 @@
 #define LOG_TAG "MediaCodecList"
 #include <utils/Log.h>
 
+#include "MediaCodecListCache.h"
 #include "MediaCodecListOverrides.h"
 #include "StagefrightPluginLoader.h"
 
@@ -56,6 +57,25 @@ Mutex sRemoteInitMutex;
 constexpr const char* kProfilingResults =
         MediaCodecsXmlParser::defaultProfilingResultsXmlPath;
 
+constexpr const char* kCodecListCache = "/data/misc/media/media_codecs_cache.bin";
+
+bool isCacheEnabled() {
+    return property_get_bool("debug.stagefright.codeclistcache", true);
+}
+
+void updateCodecListCache(
+        size_t numBuilders, const sp<AMessage> &globalSettings,
+        const std::vector<sp<MediaCodecInfo>> &infos) {
+    if (!isCacheEnabled()) {
+        return;
+    }
+    // only processes allowed to write /data/misc/media (i.e. the media service) will
+    // succeed; everyone else just keeps using the list they built.
+    status_t err = writeCodecListCache(
+            kCodecListCache, getCodecListCacheVersion(numBuilders), globalSettings, infos);
+    ALOGV("writing codec list cache returned %d", err);
+}
+
 bool isProfilingNeeded() {
     int8_t value = property_get_bool("debug.stagefright.profilecodec", 0);
     if (value == 0) {
@@ -126,11 +146,13 @@ void *MediaCodecList::profilerThreadWrapper(void * /*arg*/) {
     ALOGV("Codec profiling started.");
     profileCodecs(infos, kProfilingResults);
     ALOGV("Codec profiling completed.");
-    codecList = new MediaCodecList(GetBuilders());
+    std::vector<MediaCodecListBuilderBase *> builders = GetBuilders();
+    codecList = new MediaCodecList(builders);
     if (codecList->initCheck() != OK) {
         ALOGW("Failed to parse profiling results.");
         return nullptr;
     }
+    updateCodecListCache(builders.size(), codecList->mGlobalSettings, codecList->mCodecInfos);
 
     {
         Mutex::Autolock autoLock(sInitMutex);
@@ -144,7 +166,28 @@ sp<IMediaCodecList> MediaCodecList::getLocalInstance() {
     Mutex::Autolock autoLock(sInitMutex);
 
     if (sCodecList == nullptr) {
-        MediaCodecList *codecList = new MediaCodecList(GetBuilders());
+        std::vector<MediaCodecListBuilderBase *> builders = GetBuilders();
+        MediaCodecList *codecList = nullptr;
+        if (isCacheEnabled()) {
+            sp<AMessage> globalSettings;
+            std::vector<sp<MediaCodecInfo>> infos;
+            status_t err = readCodecListCache(
+                    kCodecListCache, getCodecListCacheVersion(builders.size()),
+                    &globalSettings, &infos);
+            if (err == OK) {
+                ALOGV("loaded %zu codecs from cache", infos.size());
+                codecList = new MediaCodecList(globalSettings, std::move(infos));
+            } else if (err != NAME_NOT_FOUND) {
+                ALOGI("ignoring codec list cache (%d)", err);
+            }
+        }
+        if (codecList == nullptr) {
+            codecList = new MediaCodecList(builders);
+            if (codecList->initCheck() == OK) {
+                updateCodecListCache(
+                        builders.size(), codecList->mGlobalSettings, codecList->mCodecInfos);
+            }
+        }
         if (codecList->initCheck() == OK) {
             sCodecList = codecList;
 
@@ -227,6 +270,14 @@ MediaCodecList::MediaCodecList(std::vector<MediaCodecListBuilderBase*> builders)
             });
 }
 
+MediaCodecList::MediaCodecList(
+        const sp<AMessage> &globalSettings, std::vector<sp<MediaCodecInfo>> &&codecInfos)
+    : mInitCheck(OK),
+      mGlobalSettings(globalSettings),
+      mCodecInfos(std::move(codecInfos)) {
+    // the cache is written after sorting, so the infos are already in rank order
+}
+
 MediaCodecList::~MediaCodecList() {
 }
 
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaCodecListCache"
+#include <utils/Log.h>
+
+#include "MediaCodecListCache.h"
+
+#include <binder/Parcel.h>
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <xmlparser/include/media/stagefright/xmlparser/MediaCodecsXmlParser.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+namespace android {
+
+namespace {
+
+const int32_t kCacheMagic = 'MCLC';
+
+// bump this whenever the layout below, or the parcelling of MediaCodecInfo or AMessage
+// changes.
+const int32_t kCacheFormatVersion = 1;
+
+// a cache file larger than this is certainly not ours.
+const off_t kMaxCacheSize = 8 * 1024 * 1024;
+
+void appendFileStat(AString *version, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        version->append(AStringPrintf("%s:-;", path));
+        return;
+    }
+    version->append(AStringPrintf("%s:%lld:%lld.%09ld;",
+            path, (long long)st.st_size,
+            (long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec));
+}
+
+void appendProperty(AString *version, const char *key) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get(key, value, "");
+    version->append(AStringPrintf("%s=%s;", key, value));
+}
+
+}  // unnamed namespace
+
+AString getCodecListCacheVersion(size_t numBuilders) {
+    AString version = AStringPrintf("builders=%zu;", numBuilders);
+    appendProperty(&version, "ro.build.fingerprint");
+    appendProperty(&version, "ro.vendor.build.fingerprint");
+
+    // the main xml includes other files, so consider all media_codecs*.xml files
+    for (const char* const* dir = MediaCodecsXmlParser::defaultSearchDirs;
+            *dir != nullptr; ++dir) {
+        DIR *d = opendir(*dir);
+        if (d == nullptr) {
+            continue;
+        }
+        std::vector<std::string> names;
+        struct dirent *entry;
+        while ((entry = readdir(d)) != nullptr) {
+            AString name(entry->d_name);
+            if (name.startsWith("media_codecs") && name.endsWith(".xml")) {
+                names.push_back(entry->d_name);
+            }
+        }
+        closedir(d);
+        std::sort(names.begin(), names.end());
+        for (const std::string &name : names) {
+            appendFileStat(&version, (std::string(*dir) + "/" + name).c_str());
+        }
+    }
+    appendFileStat(&version, MediaCodecsXmlParser::defaultProfilingResultsXmlPath);
+    return version;
+}
+
+status_t readCodecListCache(
+        const char *path, const AString &version,
+        sp<AMessage> *globalSettings, std::vector<sp<MediaCodecInfo>> *infos) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? NAME_NOT_FOUND : -errno;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > kMaxCacheSize) {
+        close(fd);
+        return BAD_VALUE;
+    }
+    size_t size = (size_t)st.st_size;
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -errno;
+    }
+
+    Parcel parcel;
+    status_t err = parcel.setData((const uint8_t *)data, size);
+    munmap(data, size);
+    if (err != OK) {
+        return err;
+    }
+
+    if (parcel.readInt32() != kCacheMagic || parcel.readInt32() != kCacheFormatVersion) {
+        return BAD_VALUE;
+    }
+    AString cachedVersion = AString::FromParcel(parcel);
+    if (cachedVersion != version) {
+        ALOGV("codec list cache is stale");
+        return BAD_VALUE;
+    }
+
+    sp<AMessage> settings = AMessage::FromParcel(parcel);
+    int32_t count = parcel.readInt32();
+    if (settings == nullptr || count < 0) {
+        return BAD_VALUE;
+    }
+    std::vector<sp<MediaCodecInfo>> cachedInfos;
+    cachedInfos.reserve(count);
+    for (int32_t i = 0; i < count; ++i) {
+        sp<MediaCodecInfo> info = MediaCodecInfo::FromParcel(parcel);
+        if (info == nullptr) {
+            return BAD_VALUE;
+        }
+        cachedInfos.push_back(info);
+    }
+    if (parcel.dataAvail() != 0) {
+        return BAD_VALUE;
+    }
+
+    *globalSettings = settings;
+    infos->swap(cachedInfos);
+    return OK;
+}
+
+status_t writeCodecListCache(
+        const char *path, const AString &version,
+        const sp<AMessage> &globalSettings, const std::vector<sp<MediaCodecInfo>> &infos) {
+    Parcel parcel;
+    parcel.writeInt32(kCacheMagic);
+    parcel.writeInt32(kCacheFormatVersion);
+    version.writeToParcel(&parcel);
+    globalSettings->writeToParcel(&parcel);
+    parcel.writeInt32((int32_t)infos.size());
+    for (const sp<MediaCodecInfo> &info : infos) {
+        info->writeToParcel(&parcel);
+    }
+
+    // write to a temporary file and rename it, so that readers never see a partial cache
+    AString tmpPath = AStringPrintf("%s.tmp", path);
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+    const uint8_t *data = parcel.data();
+    size_t remaining = parcel.dataSize();
+    status_t err = OK;
+    while (remaining > 0) {
+        ssize_t written = write(fd, data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err = -errno;
+            break;
+        }
+        data += written;
+        remaining -= written;
+    }
+    if (err == OK && fsync(fd) != 0) {
+        err = -errno;
+    }
+    close(fd);
+    if (err == OK && rename(tmpPath.c_str(), path) != 0) {
+        err = -errno;
+    }
+    if (err != OK) {
+        unlink(tmpPath.c_str());
+    }
+    return err;
+}
+
+}  // namespace android
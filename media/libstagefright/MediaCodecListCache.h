@@ -0,0 +1,53 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_CODEC_LIST_CACHE_H_
+
+#define MEDIA_CODEC_LIST_CACHE_H_
+
+#include <media/MediaCodecInfo.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+
+#include <utils/Errors.h>
+#include <utils/StrongPointer.h>
+#include <vector>
+
+namespace android {
+
+// Binary cache of a fully built codec list (global settings and codec infos), so that the
+// xml parsing and the per-component capability queries only happen when something that
+// the list is built from has changed.
+
+// Returns a string identifying everything the codec list is built from: the build
+// fingerprints, and the size and modification time of the media_codecs xml files and
+// of the profiling results. A cache written with a different version string is stale.
+AString getCodecListCacheVersion(size_t numBuilders);
+
+// Loads the cache at |path| if it was written with |version|. Returns OK on success,
+// NAME_NOT_FOUND if there is no cache, and an error if the cache is stale or corrupt.
+status_t readCodecListCache(
+        const char *path, const AString &version,
+        sp<AMessage> *globalSettings, std::vector<sp<MediaCodecInfo>> *infos);
+
+// Writes the cache at |path| atomically, replacing any previous cache.
+status_t writeCodecListCache(
+        const char *path, const AString &version,
+        const sp<AMessage> &globalSettings, const std::vector<sp<MediaCodecInfo>> &infos);
+
+}  // namespace android
+
+#endif  // MEDIA_CODEC_LIST_CACHE_H_
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2018, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaCodecPool"
+#include <utils/Log.h>
+
+#include <algorithm>
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecPool.h>
+
+namespace android {
+
+static const int32_t kDefaultMaxSize = 2;
+static const int32_t kDefaultMaxIdleMs = 5000;
+
+static Mutex sInstanceLock;
+static sp<MediaCodecPool> sInstance;
+
+// static
+sp<MediaCodecPool> MediaCodecPool::getInstance() {
+    Mutex::Autolock autoLock(sInstanceLock);
+    if (sInstance == NULL) {
+        sInstance = new MediaCodecPool;
+        if (sInstance->mMaxSize > 0) {
+            sInstance->mLooper->start();
+            sInstance->mLooper->registerHandler(sInstance);
+        }
+    }
+    return sInstance;
+}
+
+MediaCodecPool::MediaCodecPool()
+    : mMaxSize(std::max(property_get_int32("media.codec.pool.size", kDefaultMaxSize), 0)),
+      mMaxIdleUs((int64_t)property_get_int32("media.codec.pool.idle_ms", kDefaultMaxIdleMs)
+              * 1000ll),
+      mLooper(new ALooper) {
+    mLooper->setName("MediaCodecPool");
+}
+
+MediaCodecPool::~MediaCodecPool() {
+    clear();
+}
+
+sp<MediaCodec> MediaCodecPool::acquire(
+        const sp<ALooper> &looper, const AString &mime, bool encoder,
+        int32_t maxWidth, int32_t maxHeight, status_t *err) {
+    std::list<sp<MediaCodec> > evicted;
+    sp<MediaCodec> codec;
+    {
+        Mutex::Autolock autoLock(mLock);
+        evict(&evicted, ALooper::GetNowUs());
+
+        // the smallest pooled codec that is large enough
+        std::list<Entry>::iterator best = mEntries.end();
+        for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+            if (it->mLooper == looper && it->mEncoder == encoder
+                    && !strcasecmp(it->mMime.c_str(), mime.c_str())
+                    && it->mMaxWidth >= maxWidth && it->mMaxHeight >= maxHeight
+                    && (best == mEntries.end()
+                            || (int64_t)it->mMaxWidth * it->mMaxHeight
+                                    < (int64_t)best->mMaxWidth * best->mMaxHeight)) {
+                best = it;
+            }
+        }
+        if (best != mEntries.end()) {
+            codec = best->mCodec;
+            mEntries.erase(best);
+        }
+    }
+    releaseAll(evicted);
+
+    // a pooled codec is gone if it was reclaimed by the ResourceManagerService
+    AString name;
+    if (codec != NULL && codec->getName(&name) == OK) {
+        ALOGV("reusing %s for %s", name.c_str(), mime.c_str());
+        if (err != NULL) {
+            *err = OK;
+        }
+        return codec;
+    } else if (codec != NULL) {
+        ALOGV("dropping reclaimed codec for %s", mime.c_str());
+        codec->release();
+    }
+
+    return MediaCodec::CreateByType(looper, mime, encoder, err);
+}
+
+void MediaCodecPool::recycle(
+        const sp<MediaCodec> &codec, const AString &mime, bool encoder,
+        int32_t maxWidth, int32_t maxHeight) {
+    sp<ALooper> looper = codec->looper();
+    if (mMaxSize == 0 || looper == NULL || codec->stop() != OK) {
+        codec->release();
+        return;
+    }
+
+    std::list<sp<MediaCodec> > evicted;
+    {
+        Mutex::Autolock autoLock(mLock);
+        const int64_t nowUs = ALooper::GetNowUs();
+
+        Entry entry;
+        entry.mCodec = codec;
+        entry.mLooper = looper;
+        entry.mMime = mime;
+        entry.mEncoder = encoder;
+        entry.mMaxWidth = maxWidth;
+        entry.mMaxHeight = maxHeight;
+        entry.mRecycledUs = nowUs;
+        mEntries.push_front(entry);
+
+        while (mEntries.size() > mMaxSize) {
+            evicted.push_back(mEntries.back().mCodec);
+            mEntries.pop_back();
+        }
+        evict(&evicted, nowUs);
+    }
+    releaseAll(evicted);
+
+    (new AMessage(kWhatEvict, this))->post(mMaxIdleUs);
+}
+
+void MediaCodecPool::clear() {
+    std::list<sp<MediaCodec> > evicted;
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (const Entry &entry : mEntries) {
+            evicted.push_back(entry.mCodec);
+        }
+        mEntries.clear();
+    }
+    releaseAll(evicted);
+}
+
+void MediaCodecPool::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatEvict:
+        {
+            std::list<sp<MediaCodec> > evicted;
+            {
+                Mutex::Autolock autoLock(mLock);
+                evict(&evicted, ALooper::GetNowUs());
+            }
+            releaseAll(evicted);
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+// moves the codecs idle for too long to |evicted|, to be released without holding mLock
+void MediaCodecPool::evict(std::list<sp<MediaCodec> > *evicted, int64_t nowUs) {
+    while (!mEntries.empty() && nowUs - mEntries.back().mRecycledUs >= mMaxIdleUs) {
+        evicted->push_back(mEntries.back().mCodec);
+        mEntries.pop_back();
+    }
+}
+
+// static
+void MediaCodecPool::releaseAll(const std::list<sp<MediaCodec> > &codecs) {
+    for (const sp<MediaCodec> &codec : codecs) {
+        codec->release();
+    }
+}
+
+}  // namespace android
@@ -20,6 +20,8 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include <gui/IGraphicBufferProducer.h>
 #include <gui/Surface.h>
 #include <media/ICrypto.h>
@@ -51,6 +53,18 @@ const int kStopTimeoutUs = 300000; // allow 1 sec for shutting down encoder
 // input source.
 const int kMaxStopTimeOffsetUs = 1000000;
 
+// Adaptive bitrate: step down when more than kAbrHighBacklogUs of encoded
+// data waits for the consumer, at most once per kAbrMinAdaptIntervalUs, and
+// step back up after the backlog stayed under kAbrLowBacklogUs for
+// kAbrRecoveryDelayUs. The gap between the two thresholds is the hysteresis.
+const int64_t kAbrHighBacklogUs = 1000000ll;
+const int64_t kAbrLowBacklogUs = 200000ll;
+const int64_t kAbrMinAdaptIntervalUs = 1000000ll;
+const int64_t kAbrRecoveryDelayUs = 5000000ll;
+// never go below a quarter of the configured bitrate, or half the frame rate
+const int32_t kAbrMaxBitrateReduction = 4;
+const float kAbrMaxFrameRateReduction = 2.0f;
+
 struct MediaCodecSource::Puller : public AHandler {
     explicit Puller(const sp<MediaSource> &source);
 
@@ -459,7 +473,14 @@ MediaCodecSource::MediaCodecSource(
       mGeneration(0),
       mPrevBufferTimestampUs(0),
       mIsHFR(false),
-      mBatchSize(0){
+      mBatchSize(0),
+      mTargetBitrate(0),
+      mCurrentBitrate(0),
+      mTargetFrameRate(0.0f),
+      mCurrentFrameRate(0.0f),
+      mLastFedTimeUs(-1ll),
+      mLastAdaptSystemTimeUs(-1ll),
+      mLowBacklogSinceSystemTimeUs(-1ll) {
     CHECK(mLooper != NULL);
 
     if (!(mFlags & FLAG_USE_SURFACE_INPUT)) {
@@ -501,6 +522,23 @@ status_t MediaCodecSource::initEncoder() {
     CHECK(mOutputFormat->findString("mime", &outputMIME));
     mIsVideo = outputMIME.startsWithIgnoreCase("video/");
 
+    if (mFlags & FLAG_ADAPTIVE_BITRATE) {
+        int32_t frameRate;
+        if (!mIsVideo || !mOutputFormat->findInt32("bitrate", &mTargetBitrate)
+                || mTargetBitrate <= 0) {
+            ALOGW("adaptive bitrate needs a video encoder with a bitrate, disabled");
+            mFlags &= ~FLAG_ADAPTIVE_BITRATE;
+        } else {
+            mCurrentBitrate = mTargetBitrate;
+            if (mOutputFormat->findInt32("frame-rate", &frameRate)) {
+                mTargetFrameRate = frameRate;
+            } else if (!mOutputFormat->findFloat("frame-rate", &mTargetFrameRate)) {
+                mTargetFrameRate = 0.0f;
+            }
+            mCurrentFrameRate = mTargetFrameRate;
+        }
+    }
+
     AString name;
     status_t err = NO_INIT;
     if (mOutputFormat->findString("testing-name", &name)) {
@@ -609,6 +647,68 @@ status_t MediaCodecSource::initEncoder() {
     return OK;
 }
 
+void MediaCodecSource::adaptToSinkBacklog(int64_t backlogUs) {
+    int64_t nowUs = systemTime() / 1000;
+    int32_t bitrate = mCurrentBitrate;
+    float frameRate = mCurrentFrameRate;
+
+    if (backlogUs >= kAbrHighBacklogUs) {
+        mLowBacklogSinceSystemTimeUs = -1ll;
+        if (mLastAdaptSystemTimeUs >= 0ll
+                && nowUs - mLastAdaptSystemTimeUs < kAbrMinAdaptIntervalUs) {
+            return;
+        }
+        if (mCurrentBitrate > mTargetBitrate / kAbrMaxBitrateReduction) {
+            bitrate = std::max(mTargetBitrate / kAbrMaxBitrateReduction,
+                    mCurrentBitrate / 4 * 3);
+        } else if (!(mFlags & FLAG_USE_SURFACE_INPUT)
+                && mCurrentFrameRate > mTargetFrameRate / kAbrMaxFrameRateReduction) {
+            // frames are dropped before the encoder in feedEncoderInputBuffers
+            frameRate = mTargetFrameRate / kAbrMaxFrameRateReduction;
+        } else {
+            return;
+        }
+    } else if (backlogUs <= kAbrLowBacklogUs) {
+        if (mLowBacklogSinceSystemTimeUs < 0ll) {
+            mLowBacklogSinceSystemTimeUs = nowUs;
+            return;
+        }
+        if (nowUs - mLowBacklogSinceSystemTimeUs < kAbrRecoveryDelayUs
+                || (mLastAdaptSystemTimeUs >= 0ll
+                        && nowUs - mLastAdaptSystemTimeUs < kAbrRecoveryDelayUs)) {
+            return;
+        }
+        if (mCurrentFrameRate < mTargetFrameRate) {
+            frameRate = mTargetFrameRate;
+        } else if (mCurrentBitrate < mTargetBitrate) {
+            bitrate = std::min(mTargetBitrate, mCurrentBitrate + mTargetBitrate / 8);
+        } else {
+            return;
+        }
+    } else {
+        // in between the thresholds: hold the current settings
+        mLowBacklogSinceSystemTimeUs = -1ll;
+        return;
+    }
+
+    ALOGI("[video] sink backlog %" PRId64 " ms: bitrate %d -> %d, frame rate %.1f -> %.1f",
+            backlogUs / 1000, mCurrentBitrate, bitrate, mCurrentFrameRate, frameRate);
+
+    if (bitrate != mCurrentBitrate) {
+        sp<AMessage> params = new AMessage;
+        params->setInt32("video-bitrate", bitrate);
+        status_t err = mEncoder->setParameters(params);
+        if (err != OK) {
+            ALOGW("failed to change bitrate (err %d), adaptive bitrate disabled", err);
+            mFlags &= ~FLAG_ADAPTIVE_BITRATE;
+            return;
+        }
+        mCurrentBitrate = bitrate;
+    }
+    mCurrentFrameRate = frameRate;
+    mLastAdaptSystemTimeUs = nowUs;
+}
+
 void MediaCodecSource::releaseEncoder() {
     if (mEncoder == NULL) {
         return;
@@ -716,6 +816,16 @@ status_t MediaCodecSource::feedEncoderInputBuffers() {
                     return OK;
                 }
             }
+            if (mCurrentFrameRate < mTargetFrameRate) {
+                // adaptive bitrate asked for a lower frame rate
+                if (mLastFedTimeUs >= 0ll
+                        && timeUs - mLastFedTimeUs < (int64_t)(1E6 / mCurrentFrameRate)) {
+                    mbuf->release();
+                    mAvailEncoderInputIndices.push_front(bufferIndex);
+                    continue;
+                }
+            }
+            mLastFedTimeUs = timeUs;
             mInputBufferTimeOffsetUs = AVUtils::get()->overwriteTimeOffset(mIsHFR,
                 mInputBufferTimeOffsetUs, &mPrevBufferTimestampUs, timeUs, mBatchSize);
             timeUs += mInputBufferTimeOffsetUs;
@@ -982,13 +1092,27 @@ void MediaCodecSource::onMessageReceived(const sp<AMessage> &msg) {
             }
             memcpy(mbuf->data(), outbuf->data(), outbuf->size());
 
+            int64_t backlogUs = -1ll;
             {
                 Mutexed<Output>::Locked output(mOutput);
                 output->mBufferQueue.push_back(mbuf);
                 output->mCond.signal();
+
+                MediaBufferBase *oldest = *output->mBufferQueue.begin();
+                int64_t oldestTimeUs;
+                int32_t isCodecConfig;
+                if ((mFlags & FLAG_ADAPTIVE_BITRATE)
+                        && !(flags & MediaCodec::BUFFER_FLAG_CODECCONFIG)
+                        && !oldest->meta_data().findInt32(kKeyIsCodecConfig, &isCodecConfig)
+                        && oldest->meta_data().findInt64(kKeyTime, &oldestTimeUs)) {
+                    backlogUs = timeUs - oldestTimeUs;
+                }
             }
 
             mEncoder->releaseOutputBuffer(index);
+            if (backlogUs >= 0ll) {
+                adaptToSinkBacklog(backlogUs);
+            }
        } else if (cbID == MediaCodec::CB_ERROR) {
             status_t err;
             CHECK(msg->findInt32("err", &err));
@@ -29,10 +29,21 @@
 #include <media/IMediaExtractorService.h>
 #include <cutils/properties.h>
 #include <utils/String8.h>
+#include <utils/Timers.h>
 #include <ziparchive/zip_archive.h>
 
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <ctype.h>
 #include <dirent.h>
 #include <dlfcn.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
 
 namespace android {
 
@@ -78,7 +89,7 @@ sp<IMediaExtractor> MediaExtractorFactory::CreateFromService(
     MediaExtractor::FreeMetaFunc freeMeta = nullptr;
     float confidence;
     sp<ExtractorPlugin> plugin;
-    creator = sniff(source.get(), &confidence, &meta, &freeMeta, plugin);
+    creator = sniff(source.get(), mime, &confidence, &meta, &freeMeta, plugin);
     if (!creator) {
         ALOGV("FAILED to autodetect media content.");
         return NULL;
@@ -102,14 +113,25 @@ void MediaExtractorFactory::LoadPlugins(const ::std::string& apkPath) {
     UpdateExtractors(apkPath.empty() ? nullptr : apkPath.c_str());
 }
 
+//static
+void MediaExtractorFactory::PreloadPlugins() {
+    UpdateExtractors(nullptr);
+}
+
 struct ExtractorPlugin : public RefBase {
     MediaExtractor::ExtractorDef def;
     void *libHandle;
     String8 libPath;
     String8 uuidString;
 
+    // sniffing statistics, for dump()
+    std::atomic<int64_t> sniffCount;
+    std::atomic<int64_t> sniffTimeNs;
+    std::atomic<int64_t> sniffWins;
+
     ExtractorPlugin(MediaExtractor::ExtractorDef definition, void *handle, String8 &path)
-        : def(definition), libHandle(handle), libPath(path) {
+        : def(definition), libHandle(handle), libPath(path),
+          sniffCount(0), sniffTimeNs(0), sniffWins(0) {
         for (size_t i = 0; i < sizeof MediaExtractor::ExtractorDef::extractor_uuid; i++) {
             uuidString.appendFormat("%02x", def.extractor_uuid.b[i]);
         }
@@ -125,66 +147,199 @@ struct ExtractorPlugin : public RefBase {
 Mutex MediaExtractorFactory::gPluginMutex;
 std::shared_ptr<List<sp<ExtractorPlugin>>> MediaExtractorFactory::gPlugins;
 bool MediaExtractorFactory::gPluginsRegistered = false;
+std::map<std::string, String8> MediaExtractorFactory::gSniffHints;
+std::map<std::string, MediaExtractorFactory::PluginCacheEntry> MediaExtractorFactory::gPluginCache;
+
+// Wraps the source while the sniffers run. The start of the source is read
+// once and handed to every sniffer from memory, so that their many small
+// header reads don't each go to a slow (e.g. HTTP or content provider)
+// source. Reads that reach past the window go to the source.
+class SniffDataSource : public DataSourceBase {
+public:
+    static const size_t kWindowSize = 64 * 1024;
+
+    explicit SniffDataSource(DataSourceBase *source)
+        : mSource(source),
+          mWindow(new uint8_t[kWindowSize]),
+          mWindowSize(0),
+          mSizeStatus(NO_INIT),
+          mSize(0) {
+        ssize_t n = mSource->readAt(0, mWindow.get(), kWindowSize);
+        if (n > 0) {
+            mWindowSize = n;
+        }
+    }
+
+    virtual ~SniffDataSource() {}
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (offset >= 0 && (size_t) offset <= mWindowSize && size <= mWindowSize - offset) {
+            memcpy(data, mWindow.get() + offset, size);
+            return size;
+        }
+        return mSource->readAt(offset, data, size);
+    }
+
+    // not served from the window: sniffers may keep borrowed pointers in
+    // their meta, which outlives this wrapper
+    virtual ssize_t borrowAt(off64_t offset, const uint8_t **data, size_t size) {
+        return mSource->borrowAt(offset, data, size);
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        if (mSizeStatus == NO_INIT) {
+            mSizeStatus = mSource->getSize(&mSize);
+        }
+        *size = mSize;
+        return mSizeStatus;
+    }
+
+    virtual bool getUri(char *uriString, size_t bufferSize) {
+        return mSource->getUri(uriString, bufferSize);
+    }
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+private:
+    DataSourceBase *mSource;
+    std::unique_ptr<uint8_t[]> mWindow;
+    size_t mWindowSize;
+    status_t mSizeStatus;
+    off64_t mSize;
+};
+
+// The MIME type the caller expects, or failing that the extension of the
+// source's URI, e.g. "ext:mp4". Empty if there is neither.
+static std::string getSniffHint(DataSourceBase *source, const char *mime) {
+    if (mime != NULL && *mime != '\0') {
+        return std::string("mime:") + mime;
+    }
+    char uri[PATH_MAX];
+    if (!source->getUri(uri, sizeof(uri))) {
+        return std::string();
+    }
+    const char *name = strrchr(uri, '/');
+    name = (name != NULL) ? name + 1 : uri;
+    const char *ext = strrchr(name, '.');
+    if (ext == NULL || ext[1] == '\0' || strlen(ext + 1) > 8) {
+        return std::string();
+    }
+    std::string hint("ext:");
+    for (const char *c = ext + 1; *c != '\0'; c++) {
+        hint += tolower(*c);
+    }
+    return hint;
+}
 
 // static
 MediaExtractor::CreatorFunc MediaExtractorFactory::sniff(
-        DataSourceBase *source, float *confidence, void **meta,
+        DataSourceBase *source, const char *mime, float *confidence, void **meta,
         MediaExtractor::FreeMetaFunc *freeMeta, sp<ExtractorPlugin> &plugin) {
     *confidence = 0.0f;
     *meta = nullptr;
 
+    std::string hint = getSniffHint(source, mime);
     std::shared_ptr<List<sp<ExtractorPlugin>>> plugins;
+    String8 hintedUuid;
     {
         Mutex::Autolock autoLock(gPluginMutex);
         if (!gPluginsRegistered) {
             return NULL;
         }
         plugins = gPlugins;
+        auto hinted = gSniffHints.find(hint);
+        if (!hint.empty() && hinted != gSniffHints.end()) {
+            hintedUuid = hinted->second;
+        }
     }
 
+    // Try the plugin that last won for this hint first, so that it can end
+    // the search early if it is certain. Ties still go to the plugin that
+    // comes first in registration order.
+    std::vector<std::pair<size_t, sp<ExtractorPlugin>>> order;
+    size_t index = 0;
+    for (auto it = plugins->begin(); it != plugins->end(); ++it, ++index) {
+        if (!hintedUuid.isEmpty() && (*it)->uuidString == hintedUuid) {
+            order.insert(order.begin(), std::make_pair(index, *it));
+        } else {
+            order.push_back(std::make_pair(index, *it));
+        }
+    }
+
+    SniffDataSource sniffSource(source);
     MediaExtractor::CreatorFunc curCreator = NULL;
     MediaExtractor::CreatorFunc bestCreator = NULL;
-    for (auto it = plugins->begin(); it != plugins->end(); ++it) {
+    size_t bestIndex = 0;
+    for (const auto &entry : order) {
+        const sp<ExtractorPlugin> &candidate = entry.second;
         float newConfidence;
         void *newMeta = nullptr;
         MediaExtractor::FreeMetaFunc newFreeMeta = nullptr;
-        if ((curCreator = (*it)->def.sniff(source, &newConfidence, &newMeta, &newFreeMeta))) {
-            if (newConfidence > *confidence) {
+        nsecs_t start = systemTime();
+        curCreator = candidate->def.sniff(&sniffSource, &newConfidence, &newMeta, &newFreeMeta);
+        candidate->sniffTimeNs += systemTime() - start;
+        candidate->sniffCount++;
+        if (curCreator) {
+            if (newConfidence > *confidence || (bestCreator != NULL
+                    && newConfidence == *confidence && entry.first < bestIndex)) {
                 *confidence = newConfidence;
                 if (*meta != nullptr && *freeMeta != nullptr) {
                     (*freeMeta)(*meta);
                 }
                 *meta = newMeta;
                 *freeMeta = newFreeMeta;
-                plugin = *it;
+                plugin = candidate;
                 bestCreator = curCreator;
+                bestIndex = entry.first;
             } else {
                 if (newMeta != nullptr && newFreeMeta != nullptr) {
                     newFreeMeta(newMeta);
                 }
             }
         }
+        if (bestCreator != NULL && *confidence >= 1.0f) {
+            // certain; no other sniffer can do better
+            break;
+        }
+    }
+
+    if (bestCreator != NULL) {
+        plugin->sniffWins++;
+        if (!hint.empty()) {
+            Mutex::Autolock autoLock(gPluginMutex);
+            if (gSniffHints.size() >= kMaxSniffHints
+                    && gSniffHints.find(hint) == gSniffHints.end()) {
+                gSniffHints.clear();
+            }
+            gSniffHints[hint] = plugin->uuidString;
+        }
     }
 
     return bestCreator;
 }
 
 // static
-void MediaExtractorFactory::RegisterExtractor(const sp<ExtractorPlugin> &plugin,
+bool MediaExtractorFactory::RegisterExtractor(const sp<ExtractorPlugin> &plugin,
         List<sp<ExtractorPlugin>> &pluginList) {
     // sanity check check struct version, uuid, name
     if (plugin->def.def_version == 0
             || plugin->def.def_version > MediaExtractor::EXTRACTORDEF_VERSION) {
         ALOGE("don't understand extractor format %u, ignoring.", plugin->def.def_version);
-        return;
+        return false;
     }
     if (memcmp(&plugin->def.extractor_uuid, "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16) == 0) {
         ALOGE("invalid UUID, ignoring");
-        return;
+        return false;
     }
     if (plugin->def.extractor_name == NULL || strlen(plugin->def.extractor_name) == 0) {
         ALOGE("extractors should have a name, ignoring");
-        return;
+        return false;
     }
 
     for (auto it = pluginList.begin(); it != pluginList.end(); ++it) {
@@ -203,12 +358,13 @@ void MediaExtractorFactory::RegisterExtractor(const sp<ExtractorPlugin> &plugin,
                         plugin->def.extractor_name,
                         plugin->def.extractor_version,
                         (*it)->def.extractor_version);
-                return;
+                return false;
             }
         }
     }
     ALOGV("registering extractor for %s", plugin->def.extractor_name);
     pluginList.push_back(plugin);
+    return true;
 }
 
 //static
@@ -268,14 +424,35 @@ void MediaExtractorFactory::RegisterExtractorsInSystem(
         struct dirent* libEntry;
         while ((libEntry = readdir(libDir))) {
             String8 libPath = String8(libDirPath) + "/" + libEntry->d_name;
+            struct stat st;
+            if (stat(libPath.string(), &st) != 0 || !S_ISREG(st.st_mode)) {
+                continue;
+            }
+
+            // The same library as in the last scan: reuse its plugin, or skip
+            // it without another dlopen if it wasn't a usable extractor.
+            PluginCacheEntry entry;
+            entry.size = st.st_size;
+            entry.mtimeNs = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+            auto cached = gPluginCache.find(libPath.string());
+            if (cached != gPluginCache.end() && cached->second.size == entry.size
+                    && cached->second.mtimeNs == entry.mtimeNs) {
+                if (cached->second.plugin != nullptr) {
+                    RegisterExtractor(cached->second.plugin, pluginList);
+                }
+                continue;
+            }
+
             void *libHandle = dlopen(libPath.string(), RTLD_NOW | RTLD_LOCAL);
             if (libHandle) {
                 MediaExtractor::GetExtractorDef getDef =
                     (MediaExtractor::GetExtractorDef) dlsym(libHandle, "GETEXTRACTORDEF");
                 if (getDef) {
                     ALOGV("registering sniffer for %s", libPath.string());
-                    RegisterExtractor(
-                            new ExtractorPlugin(getDef(), libHandle, libPath), pluginList);
+                    sp<ExtractorPlugin> plugin = new ExtractorPlugin(getDef(), libHandle, libPath);
+                    if (RegisterExtractor(plugin, pluginList)) {
+                        entry.plugin = plugin;
+                    }
                 } else {
                     ALOGW("%s does not contain sniffer", libPath.string());
                     dlclose(libHandle);
@@ -283,6 +460,7 @@ void MediaExtractorFactory::RegisterExtractorsInSystem(
             } else {
                 ALOGW("couldn't dlopen(%s) %s", libPath.string(), strerror(errno));
             }
+            gPluginCache[libPath.string()] = entry;
         }
 
         closedir(libDir);
@@ -334,6 +512,12 @@ status_t MediaExtractorFactory::dump(int fd, const Vector<String16>&) {
                     (*it)->uuidString.c_str(),
                     (*it)->def.extractor_version,
                     (*it)->libPath.c_str());
+            int64_t count = (*it)->sniffCount;
+            out.appendFormat("  %25s  sniffed %" PRId64 " times, avg %" PRId64 " us,"
+                    " won %" PRId64 "\n", "",
+                    count,
+                    count > 0 ? (int64_t) ns2us((*it)->sniffTimeNs / count) : (int64_t) 0,
+                    (int64_t) (*it)->sniffWins);
         }
     } else {
         out.append("  (no plugins registered)\n");
@@ -160,27 +160,33 @@ status_t MediaMuxer::stop() {
 
 status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
                                      int64_t timeUs, uint32_t flags) {
-    Mutex::Autolock autoLock(mMuxerLock);
-
     if (buffer.get() == NULL) {
         ALOGE("WriteSampleData() get an NULL buffer.");
         return -EINVAL;
     }
 
-    if (mState != STARTED) {
-        ALOGE("WriteSampleData() is called in invalid state %d", mState);
-        return INVALID_OPERATION;
-    }
+    sp<MediaAdapter> currentTrack;
+    {
+        Mutex::Autolock autoLock(mMuxerLock);
 
-    if (trackIndex >= mTrackList.size()) {
-        ALOGE("WriteSampleData() get an invalid index %zu", trackIndex);
-        return -EINVAL;
+        if (mState != STARTED) {
+            ALOGE("WriteSampleData() is called in invalid state %d", mState);
+            return INVALID_OPERATION;
+        }
+
+        if (trackIndex >= mTrackList.size()) {
+            ALOGE("WriteSampleData() get an invalid index %zu", trackIndex);
+            return -EINVAL;
+        }
+        currentTrack = mTrackList[trackIndex];
     }
 
-    MediaBuffer* mediaBuffer = new MediaBuffer(buffer);
+    // The caller may reuse the buffer once this returns, while the sample can
+    // still be queued in the track's MediaAdapter.
+    MediaBuffer* mediaBuffer = new MediaBuffer(buffer->size());
+    memcpy(mediaBuffer->data(), buffer->data(), buffer->size());
 
     mediaBuffer->add_ref(); // Released in MediaAdapter::signalBufferReturned().
-    mediaBuffer->set_range(buffer->offset(), buffer->size());
 
     MetaDataBase &sampleMetaData = mediaBuffer->meta_data();
     sampleMetaData.setInt64(kKeyTime, timeUs);
@@ -195,8 +201,8 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
         sampleMetaData.setInt32(kKeyIsMuxerData, 1);
     }
 
-    sp<MediaAdapter> currentTrack = mTrackList[trackIndex];
-    // This pushBuffer will wait until the mediaBuffer is consumed.
+    // Outside of mMuxerLock, so that a track waiting for its queue to drain
+    // doesn't hold up the others.
     return currentTrack->pushBuffer(mediaBuffer);
 }
 
@@ -25,6 +25,8 @@
 
 #include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaErrors.h>
 
@@ -43,6 +45,8 @@ struct PageCache {
     void releasePage(Page *page);
 
     void appendPage(Page *page);
+    // Moves all pages of |other| to the end of this cache.
+    void appendPagesFrom(PageCache *other);
     size_t releaseFromStart(size_t maxBytes);
 
     size_t totalSize() const {
@@ -112,6 +116,18 @@ void PageCache::appendPage(Page *page) {
     mActivePages.push_back(page);
 }
 
+void PageCache::appendPagesFrom(PageCache *other) {
+    List<Page *>::iterator it = other->mActivePages.begin();
+    while (it != other->mActivePages.end()) {
+        mActivePages.push_back(*it);
+        ++it;
+    }
+    other->mActivePages.clear();
+
+    mTotalSize += other->mTotalSize;
+    other->mTotalSize = 0;
+}
+
 size_t PageCache::releaseFromStart(size_t maxBytes) {
     size_t bytesReleased = 0;
 
@@ -179,6 +195,72 @@ void PageCache::copy(size_t from, void *data, size_t size) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Fetches one range at a time through its own connection.
+struct NuCachedSource2::RangeFetcher : public AHandler {
+    enum {
+        kWhatFetch = 'fetc',
+    };
+
+    RangeFetcher(const sp<DataSource> &source, const sp<AMessage> &notify)
+        : mSource(source),
+          mNotify(notify),
+          mLooper(new ALooper),
+          mBusy(false) {
+    }
+
+    sp<DataSource> mSource;
+    sp<AMessage> mNotify;
+    sp<ALooper> mLooper;
+    bool mBusy;  // guarded by NuCachedSource2::mLock
+
+    void fetch(off64_t offset, size_t size) {
+        sp<AMessage> msg = new AMessage(kWhatFetch, this);
+        msg->setInt64("offset", offset);
+        msg->setSize("size", size);
+        msg->post();
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        CHECK_EQ(msg->what(), (uint32_t)kWhatFetch);
+
+        int64_t offset;
+        size_t size;
+        CHECK(msg->findInt64("offset", &offset));
+        CHECK(msg->findSize("size", &size));
+
+        PageCache *cache = new PageCache(kPageSize);
+        status_t err = OK;
+        while (cache->totalSize() < size) {
+            size_t maxSize = size - cache->totalSize();
+            PageCache::Page *page = cache->acquirePage();
+            ssize_t n = mSource->readAt(
+                    offset + cache->totalSize(), page->mData,
+                    maxSize < kPageSize ? maxSize : kPageSize);
+            if (n <= 0) {
+                err = (n == 0) ? ERROR_END_OF_STREAM : n;
+                cache->releasePage(page);
+                break;
+            }
+            page->mSize = n;
+            cache->appendPage(page);
+        }
+
+        sp<AMessage> notify = mNotify->dup();
+        notify->setInt64("offset", offset);
+        notify->setSize("size", size);
+        notify->setPointer("cache", cache);
+        notify->setPointer("fetcher", this);
+        notify->setInt32("err", err);
+        notify->post();
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(RangeFetcher);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 NuCachedSource2::NuCachedSource2(
         const sp<DataSource> &source,
         const char *cacheConfig,
@@ -188,6 +270,8 @@ NuCachedSource2::NuCachedSource2(
       mLooper(new ALooper),
       mCache(new PageCache(kPageSize)),
       mCacheOffset(0),
+      mExtentBytes(0),
+      mWaitingForRange(false),
       mFinalStatus(OK),
       mLastAccessPos(0),
       mFetching(true),
@@ -229,11 +313,21 @@ NuCachedSource2::NuCachedSource2(
 }
 
 NuCachedSource2::~NuCachedSource2() {
+    for (size_t i = 0; i < mRangeFetchers.size(); ++i) {
+        mRangeFetchers[i]->mLooper->stop();
+        mRangeFetchers[i]->mLooper->unregisterHandler(mRangeFetchers[i]->id());
+    }
+
     mLooper->stop();
     mLooper->unregisterHandler(mReflector->id());
 
     delete mCache;
     mCache = NULL;
+
+    for (size_t i = 0; i < mExtents.size(); ++i) {
+        delete mExtents[i].mCache;
+    }
+    mExtents.clear();
 }
 
 // static
@@ -275,6 +369,30 @@ void NuCachedSource2::disconnect() {
         // pending reads to return more promptly
         static_cast<HTTPBase *>(mSource.get())->disconnect();
     }
+
+    Vector<sp<RangeFetcher> > rangeFetchers;
+    {
+        Mutex::Autolock autoLock(mLock);
+        rangeFetchers = mRangeFetchers;
+    }
+    for (size_t i = 0; i < rangeFetchers.size(); ++i) {
+        if (rangeFetchers[i]->mSource->flags() & kIsHTTPBasedSource) {
+            static_cast<HTTPBase *>(rangeFetchers[i]->mSource.get())->disconnect();
+        }
+    }
+}
+
+void NuCachedSource2::addRangeSource(const sp<DataSource> &source) {
+    sp<AMessage> notify = new AMessage(kWhatRangeFetched, mReflector);
+    sp<RangeFetcher> fetcher = new RangeFetcher(source, notify);
+
+    fetcher->mLooper->setName("NuCachedSource2Range");
+    fetcher->mLooper->registerHandler(fetcher);
+    // See the constructor on why this thread may need to call into java.
+    fetcher->mLooper->start(false /* runOnCallingThread */, true /* canCallJava */);
+
+    Mutex::Autolock autoLock(mLock);
+    mRangeFetchers.push(fetcher);
 }
 
 status_t NuCachedSource2::setCacheStatCollectFreq(int32_t freqMs) {
@@ -313,6 +431,12 @@ void NuCachedSource2::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatRangeFetched:
+        {
+            onRangeFetched(msg);
+            break;
+        }
+
         default:
             TRESPASS();
     }
@@ -357,10 +481,28 @@ void NuCachedSource2::fetchInternal() {
         }
     }
 
+    size_t size = kPageSize;
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        mergeExtents_l();
+
+        // Don't fetch what's cached already or being fetched through
+        // another connection.
+        off64_t offset = mCacheOffset + mCache->totalSize();
+        off64_t nextCachedOffset = nextCachedOffset_l(offset);
+        mWaitingForRange = (nextCachedOffset == offset);
+        if (mWaitingForRange) {
+            return;
+        } else if (nextCachedOffset > offset && nextCachedOffset - offset < (off64_t)size) {
+            size = nextCachedOffset - offset;
+        }
+    }
+
     PageCache::Page *page = mCache->acquirePage();
 
     ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+            mCacheOffset + mCache->totalSize(), page->mData, size);
 
     Mutex::Autolock autoLock(mLock);
 
@@ -416,7 +558,17 @@ void NuCachedSource2::onFetch() {
 
         mLastFetchTimeUs = ALooper::GetNowUs();
 
-        if (mFetching && mCache->totalSize() >= mHighwaterThresholdBytes) {
+        if (mFetching && !mRangeFetchers.isEmpty()) {
+            off64_t sourceSize;
+            if (mSource->getSize(&sourceSize) != OK) {
+                sourceSize = -1;
+            }
+
+            Mutex::Autolock autoLock(mLock);
+            scheduleRangeFetches_l(sourceSize);
+        }
+
+        if (mFetching && mCache->totalSize() + mExtentBytes >= mHighwaterThresholdBytes) {
             ALOGI("Cache full, done prefetching for now");
             mFetching = false;
 
@@ -437,6 +589,8 @@ void NuCachedSource2::onFetch() {
         if (mFinalStatus != OK && mNumRetriesLeft > 0) {
             // We failed this time and will try again in 3 seconds.
             delayUs = 3000000ll;
+        } else if (mWaitingForRange) {
+            delayUs = 10000ll;
         } else {
             delayUs = 0;
         }
@@ -507,6 +661,11 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
     size_t actualBytes = mCache->releaseFromStart(maxBytes);
     mCacheOffset += actualBytes;
 
+    // Leave room for at least the low watermark ahead of the read position.
+    if (mHighwaterThresholdBytes > mLowwaterThresholdBytes) {
+        evictExtents_l(mHighwaterThresholdBytes - mLowwaterThresholdBytes);
+    }
+
     ALOGI("restarting prefetcher, totalSize = %zu", mCache->totalSize());
     mFetching = true;
 }
@@ -533,6 +692,10 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         return size;
     }
 
+    if (readFromExtent_l(offset, data, size)) {
+        return size;
+    }
+
     sp<AMessage> msg = new AMessage(kWhatRead, mReflector);
     msg->setInt64("offset", offset);
     msg->setPointer("data", data);
@@ -601,6 +764,10 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
         return ERROR_END_OF_STREAM;
     }
 
+    if (readFromExtent_l(offset, data, size)) {
+        return size;
+    }
+
     if (!mFetching) {
         mLastAccessPos = offset;
         restartPrefetcherIfNecessary_l(
@@ -660,10 +827,27 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
 
     ALOGI("new range: offset= %lld", (long long)offset);
 
-    mCacheOffset = offset;
+    // Keep what's cached, it's likely to be read again when scrubbing or
+    // when the index is at the end of the file.
+    retainCache_l();
+
+    ssize_t index = findExtent_l(offset, 0);
+    if (index >= 0) {
+        // Continue extending the range this offset is in.
+        const Extent &extent = mExtents[index];
+        ALOGV("resuming cached range at %lld, size %zu",
+                (long long)extent.mOffset, extent.mCache->totalSize());
+
+        delete mCache;
+        mCache = extent.mCache;
+        mCacheOffset = extent.mOffset;
+        mExtentBytes -= mCache->totalSize();
+        mExtents.removeAt(index);
+    } else {
+        mCacheOffset = offset;
+    }
 
-    size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
+    evictExtents_l(mHighwaterThresholdBytes);
 
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
@@ -671,6 +855,237 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     return OK;
 }
 
+ssize_t NuCachedSource2::findExtent_l(off64_t offset, size_t size) const {
+    for (size_t i = 0; i < mExtents.size(); ++i) {
+        const Extent &extent = mExtents[i];
+        if (offset >= extent.mOffset
+                && offset + size <= extent.mOffset + extent.mCache->totalSize()) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool NuCachedSource2::readFromExtent_l(off64_t offset, void *data, size_t size) {
+    if (size == 0) {
+        return false;
+    }
+
+    ssize_t index = findExtent_l(offset, size);
+    if (index < 0) {
+        return false;
+    }
+
+    Extent *extent = &mExtents.editItemAt(index);
+    extent->mCache->copy(offset - extent->mOffset, data, size);
+    extent->mLastAccessUs = ALooper::GetNowUs();
+
+    return true;
+}
+
+void NuCachedSource2::retainCache_l() {
+    if (mCache->totalSize() == 0) {
+        return;
+    }
+
+    Extent extent;
+    extent.mOffset = mCacheOffset;
+    extent.mCache = mCache;
+    extent.mLastAccessUs = ALooper::GetNowUs();
+
+    size_t index = 0;
+    while (index < mExtents.size() && mExtents[index].mOffset < extent.mOffset) {
+        ++index;
+    }
+    mExtents.insertAt(extent, index);
+    mExtentBytes += mCache->totalSize();
+
+    mCache = new PageCache(kPageSize);
+}
+
+void NuCachedSource2::mergeExtents_l() {
+    off64_t end = mCacheOffset + mCache->totalSize();
+
+    for (size_t i = 0; i < mExtents.size();) {
+        if (mExtents[i].mOffset != end) {
+            ++i;
+            continue;
+        }
+
+        PageCache *cache = mExtents[i].mCache;
+        ALOGV("reached cached range at %lld, size %zu", (long long)end, cache->totalSize());
+
+        end += cache->totalSize();
+        mExtentBytes -= cache->totalSize();
+        mCache->appendPagesFrom(cache);
+        delete cache;
+        mExtents.removeAt(i);
+    }
+}
+
+void NuCachedSource2::evictExtents_l(size_t maxCachedBytes) {
+    while (!mExtents.isEmpty() && mCache->totalSize() + mExtentBytes > maxCachedBytes) {
+        size_t lru = 0;
+        for (size_t i = 1; i < mExtents.size(); ++i) {
+            if (mExtents[i].mLastAccessUs < mExtents[lru].mLastAccessUs) {
+                lru = i;
+            }
+        }
+
+        PageCache *cache = mExtents[lru].mCache;
+        ALOGV("releasing cached range at %lld, size %zu",
+                (long long)mExtents[lru].mOffset, cache->totalSize());
+
+        mExtentBytes -= cache->totalSize();
+        delete cache;
+        mExtents.removeAt(lru);
+    }
+}
+
+// Returns the offset of the first range at or after |offset| that is cached
+// or being fetched, or -1 if there is none.
+off64_t NuCachedSource2::nextCachedOffset_l(off64_t offset) const {
+    off64_t next = -1;
+    for (size_t i = 0; i < mExtents.size(); ++i) {
+        off64_t start = mExtents[i].mOffset;
+        if (start >= offset && (next < 0 || start < next)) {
+            next = start;
+        }
+    }
+    for (size_t i = 0; i < mPendingRanges.size(); ++i) {
+        off64_t start = mPendingRanges[i].mOffset;
+        if (start >= offset && (next < 0 || start < next)) {
+            next = start;
+        }
+    }
+    return next;
+}
+
+void NuCachedSource2::scheduleRangeFetches_l(off64_t sourceSize) {
+    if (mFinalStatus != OK || mDisconnecting) {
+        return;
+    }
+
+    size_t cachedBytes = mCache->totalSize() + mExtentBytes;
+    for (size_t i = 0; i < mPendingRanges.size(); ++i) {
+        cachedBytes += mPendingRanges[i].mSize;
+    }
+
+    // The range right after the cache is left to the main connection.
+    off64_t offset = mCacheOffset + mCache->totalSize() + kRangeSize;
+
+    for (size_t i = 0; i < mRangeFetchers.size(); ++i) {
+        if (mRangeFetchers[i]->mBusy) {
+            continue;
+        }
+
+        // Skip ranges that are cached or being fetched.
+        bool skipped;
+        do {
+            skipped = false;
+            for (size_t j = 0; j < mExtents.size(); ++j) {
+                off64_t end = mExtents[j].mOffset + mExtents[j].mCache->totalSize();
+                if (offset >= mExtents[j].mOffset && offset < end) {
+                    offset = end;
+                    skipped = true;
+                }
+            }
+            for (size_t j = 0; j < mPendingRanges.size(); ++j) {
+                off64_t end = mPendingRanges[j].mOffset + mPendingRanges[j].mSize;
+                if (offset >= mPendingRanges[j].mOffset && offset < end) {
+                    offset = end;
+                    skipped = true;
+                }
+            }
+        } while (skipped);
+
+        if (sourceSize >= 0 && offset >= sourceSize) {
+            return;
+        }
+
+        size_t size = kRangeSize;
+        off64_t nextCachedOffset = nextCachedOffset_l(offset);
+        if (nextCachedOffset > offset && nextCachedOffset - offset < (off64_t)size) {
+            size = nextCachedOffset - offset;
+        }
+        if (sourceSize >= 0 && sourceSize - offset < (off64_t)size) {
+            size = sourceSize - offset;
+        }
+
+        if (cachedBytes + size > mHighwaterThresholdBytes) {
+            return;
+        }
+
+        ALOGV("fetching range at %lld, size %zu", (long long)offset, size);
+
+        PendingRange range;
+        range.mOffset = offset;
+        range.mSize = size;
+        mPendingRanges.push(range);
+
+        mRangeFetchers[i]->mBusy = true;
+        mRangeFetchers[i]->fetch(offset, size);
+
+        cachedBytes += size;
+        offset += size;
+    }
+}
+
+void NuCachedSource2::onRangeFetched(const sp<AMessage> &msg) {
+    int64_t offset;
+    size_t size;
+    void *ptr;
+    int32_t err;
+    CHECK(msg->findInt64("offset", &offset));
+    CHECK(msg->findSize("size", &size));
+    CHECK(msg->findPointer("cache", &ptr));
+    PageCache *cache = static_cast<PageCache *>(ptr);
+    CHECK(msg->findPointer("fetcher", &ptr));
+    RangeFetcher *fetcher = static_cast<RangeFetcher *>(ptr);
+    CHECK(msg->findInt32("err", &err));
+
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mPendingRanges.size(); ++i) {
+        if (mPendingRanges[i].mOffset == offset) {
+            mPendingRanges.removeAt(i);
+            break;
+        }
+    }
+
+    // Errors that are not likely to go away, i.e. the server doesn't
+    // support range requests, leave the connection busy for good.
+    fetcher->mBusy = (err == ERROR_UNSUPPORTED || err == -EPIPE);
+    if (err != OK && err != ERROR_END_OF_STREAM) {
+        ALOGW("range fetch at %lld failed: %d", (long long)offset, err);
+    }
+
+    off64_t end = offset + cache->totalSize();
+    bool overlaps = (offset < mCacheOffset + (off64_t)mCache->totalSize() && end > mCacheOffset);
+    for (size_t i = 0; !overlaps && i < mExtents.size(); ++i) {
+        overlaps = (offset < mExtents[i].mOffset + (off64_t)mExtents[i].mCache->totalSize()
+                && end > mExtents[i].mOffset);
+    }
+
+    if (mDisconnecting || cache->totalSize() == 0 || overlaps) {
+        // The main connection got there first after a seek.
+        delete cache;
+        return;
+    }
+
+    Extent extent;
+    extent.mOffset = offset;
+    extent.mCache = cache;
+    extent.mLastAccessUs = ALooper::GetNowUs();
+
+    size_t index = 0;
+    while (index < mExtents.size() && mExtents[index].mOffset < offset) {
+        ++index;
+    }
+    mExtents.insertAt(extent, index);
+    mExtentBytes += cache->totalSize();
+}
+
 void NuCachedSource2::resumeFetchingIfNecessary() {
     Mutex::Autolock autoLock(mLock);
 
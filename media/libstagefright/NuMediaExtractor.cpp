@@ -23,11 +23,15 @@
 #include "include/ESDS.h"
 #include "include/NuCachedSource2.h"
 
+#include <cutils/properties.h>
+
 #include <media/DataSource.h>
 #include <media/MediaExtractor.h>
 #include <media/MediaSource.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSourceFactory.h>
 #include <media/stagefright/FileSource.h>
@@ -50,19 +54,279 @@ NuMediaExtractor::Sample::Sample(MediaBufferBase *buffer, int64_t timeUs)
       mSampleTimeUs(timeUs) {
 }
 
+// Reads samples of one track ahead of the consumer on its own looper thread.
+// All reads of the track's source, including seeks, happen on that thread so
+// the source is never accessed concurrently.
+struct NuMediaExtractor::TrackPrefetcher : public AHandler {
+    TrackPrefetcher(
+            const sp<IMediaSource> &source, size_t trackIndex,
+            size_t depth, size_t maxFetchCount);
+
+    status_t start();
+    void stop();
+
+    // Drops all queued samples and restarts reading at |timeUs|.
+    void seekTo(int64_t timeUs, MediaSource::ReadOptions::SeekMode mode);
+
+    // Blocks until a sample is available. Returns the final result of the
+    // track once all samples read before it have been dequeued.
+    status_t dequeue(Sample *sample);
+
+    void getStats(size_t *queuedSamples, size_t *depth, int64_t *underruns) const;
+
+protected:
+    virtual ~TrackPrefetcher();
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatFetch = 'fetc',
+        kWhatSeek  = 'seek',
+    };
+
+    sp<IMediaSource> mSource;
+    size_t mTrackIndex;
+    size_t mDepth;
+    size_t mMaxFetchCount;
+    sp<ALooper> mLooper;
+
+    mutable Mutex mLock;
+    Condition mCondition;
+    std::list<Sample> mQueue;
+    status_t mFinalResult;
+    bool mFetchPending;
+    bool mStopped;
+    int64_t mUnderruns;
+
+    void postFetch_l();
+    void flush_l();
+    void onFetch(const MediaSource::ReadOptions *seekOptions);
+
+    DISALLOW_EVIL_CONSTRUCTORS(TrackPrefetcher);
+};
+
+NuMediaExtractor::TrackPrefetcher::TrackPrefetcher(
+        const sp<IMediaSource> &source, size_t trackIndex,
+        size_t depth, size_t maxFetchCount)
+    : mSource(source),
+      mTrackIndex(trackIndex),
+      mDepth(depth),
+      mMaxFetchCount(maxFetchCount),
+      mFinalResult(OK),
+      mFetchPending(false),
+      mStopped(false),
+      mUnderruns(0) {
+}
+
+NuMediaExtractor::TrackPrefetcher::~TrackPrefetcher() {
+    flush_l();
+}
+
+status_t NuMediaExtractor::TrackPrefetcher::start() {
+    mLooper = new ALooper;
+    mLooper->setName("NuMediaExtractor prefetch");
+    status_t err = mLooper->start();
+    if (err != OK) {
+        mLooper.clear();
+        return err;
+    }
+    mLooper->registerHandler(this);
+
+    Mutex::Autolock autoLock(mLock);
+    postFetch_l();
+    return OK;
+}
+
+void NuMediaExtractor::TrackPrefetcher::stop() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mStopped = true;
+        flush_l();
+        mCondition.broadcast();
+    }
+
+    if (mLooper != NULL) {
+        // Waits for a read in flight to finish.
+        mLooper->unregisterHandler(id());
+        mLooper->stop();
+        mLooper.clear();
+    }
+}
+
+void NuMediaExtractor::TrackPrefetcher::seekTo(
+        int64_t timeUs, MediaSource::ReadOptions::SeekMode mode) {
+    sp<AMessage> msg = new AMessage(kWhatSeek, this);
+    msg->setInt64("timeUs", timeUs);
+    msg->setInt32("mode", mode);
+
+    sp<AMessage> response;
+    msg->postAndAwaitResponse(&response);
+}
+
+status_t NuMediaExtractor::TrackPrefetcher::dequeue(Sample *sample) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mQueue.empty() && mFinalResult == OK && !mStopped) {
+        ++mUnderruns;
+        postFetch_l();
+        while (mQueue.empty() && mFinalResult == OK && !mStopped) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    if (mQueue.empty()) {
+        return mStopped ? INVALID_OPERATION : mFinalResult;
+    }
+
+    *sample = mQueue.front();
+    mQueue.pop_front();
+    postFetch_l();
+    return OK;
+}
+
+void NuMediaExtractor::TrackPrefetcher::getStats(
+        size_t *queuedSamples, size_t *depth, int64_t *underruns) const {
+    Mutex::Autolock autoLock(mLock);
+
+    *queuedSamples = mQueue.size();
+    *depth = mDepth;
+    *underruns = mUnderruns;
+}
+
+void NuMediaExtractor::TrackPrefetcher::postFetch_l() {
+    if (mFetchPending || mStopped || mFinalResult != OK || mQueue.size() >= mDepth) {
+        return;
+    }
+    mFetchPending = true;
+    (new AMessage(kWhatFetch, this))->post();
+}
+
+void NuMediaExtractor::TrackPrefetcher::flush_l() {
+    for (auto it = mQueue.begin(); it != mQueue.end(); ++it) {
+        if (it->mBuffer != NULL) {
+            it->mBuffer->release();
+        }
+    }
+    mQueue.clear();
+}
+
+void NuMediaExtractor::TrackPrefetcher::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatFetch:
+        {
+            onFetch(NULL);
+            break;
+        }
+
+        case kWhatSeek:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            int64_t timeUs;
+            int32_t mode;
+            CHECK(msg->findInt64("timeUs", &timeUs));
+            CHECK(msg->findInt32("mode", &mode));
+
+            MediaSource::ReadOptions options;
+            options.setSeekTo(timeUs, (MediaSource::ReadOptions::SeekMode)mode);
+            onFetch(&options);
+
+            (new AMessage)->postReply(replyID);
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+void NuMediaExtractor::TrackPrefetcher::onFetch(
+        const MediaSource::ReadOptions *seekOptions) {
+    size_t count;
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (seekOptions != NULL) {
+            flush_l();
+            mFinalResult = OK;
+        } else {
+            mFetchPending = false;
+        }
+        if (mStopped || mFinalResult != OK || mQueue.size() >= mDepth) {
+            return;
+        }
+        count = mDepth - mQueue.size();
+        if (count > mMaxFetchCount) {
+            count = mMaxFetchCount;
+        }
+    }
+
+    MediaSource::ReadOptions options;
+    if (seekOptions != NULL) {
+        options = *seekOptions;
+    }
+
+    status_t err = OK;
+    Vector<MediaBufferBase *> mediaBuffers;
+    if (mSource->supportReadMultiple()) {
+        options.setNonBlocking();
+        err = mSource->readMultiple(&mediaBuffers, count, &options);
+    } else {
+        MediaBufferBase *mbuf = NULL;
+        err = mSource->read(&mbuf, &options);
+        if (err == OK && mbuf != NULL) {
+            mediaBuffers.push_back(mbuf);
+        }
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (err != OK && err != ERROR_END_OF_STREAM) {
+        ALOGW("read on track %zu failed with error %d", mTrackIndex, err);
+    }
+
+    bool releaseRemaining = mStopped || (err != OK && err != ERROR_END_OF_STREAM);
+    for (size_t id = 0; id < mediaBuffers.size(); ++id) {
+        int64_t timeUs;
+        MediaBufferBase *mbuf = mediaBuffers[id];
+        if (mbuf == NULL) {
+            continue;
+        }
+        if (releaseRemaining) {
+            mbuf->release();
+            continue;
+        }
+        if (mbuf->meta_data().findInt64(kKeyTime, &timeUs)) {
+            mQueue.emplace_back(mbuf, timeUs);
+        } else {
+            mbuf->meta_data().dumpToLog();
+            err = ERROR_MALFORMED;
+            mbuf->release();
+            releaseRemaining = true;
+        }
+    }
+
+    mFinalResult = err;
+    mCondition.broadcast();
+    postFetch_l();
+}
+
 NuMediaExtractor::NuMediaExtractor()
     : mTotalBitrate(-1ll),
-      mDurationUs(-1ll) {
+      mDurationUs(-1ll),
+      mPrefetchDepth(0) {
+    int32_t depth = property_get_int32("media.stagefright.extractor-prefetch", 0);
+    if (depth > 0 && depth <= kMaxPrefetchDepth) {
+        mPrefetchDepth = depth;
+    }
 }
 
 NuMediaExtractor::~NuMediaExtractor() {
     releaseAllTrackSamples();
 
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
-        TrackInfo *info = &mSelectedTracks.editItemAt(i);
-
-        status_t err = info->mSource->stop();
-        ALOGE_IF(err != OK, "error %d stopping track %zu", err, i);
+        stopTrack(&mSelectedTracks.editItemAt(i));
     }
 
     mSelectedTracks.clear();
@@ -397,6 +661,17 @@ status_t NuMediaExtractor::selectTrack(size_t index,
         info->mTrackFlags |= kIsVorbis;
     }
 
+    info->mPrefetcher.clear();
+    if (mPrefetchDepth > 0) {
+        sp<TrackPrefetcher> prefetcher = new TrackPrefetcher(
+                source, index, mPrefetchDepth, info->mMaxFetchCount);
+        if (prefetcher->start() == OK) {
+            info->mPrefetcher = prefetcher;
+        } else {
+            ALOGW("track %zu: prefetch unavailable", index);
+        }
+    }
+
     if (startTimeUs >= 0) {
         fetchTrackSamples(info, startTimeUs, mode);
     }
@@ -433,6 +708,10 @@ status_t NuMediaExtractor::unselectTrack(size_t index) {
 
     releaseTrackSamples(info);
 
+    if (info->mPrefetcher != NULL) {
+        info->mPrefetcher->stop();
+        info->mPrefetcher.clear();
+    }
     CHECK_EQ((status_t)OK, info->mSource->stop());
 
     mSelectedTracks.removeAt(i);
@@ -440,6 +719,16 @@ status_t NuMediaExtractor::unselectTrack(size_t index) {
     return OK;
 }
 
+void NuMediaExtractor::stopTrack(TrackInfo *info) {
+    if (info->mPrefetcher != NULL) {
+        info->mPrefetcher->stop();
+        info->mPrefetcher.clear();
+    }
+
+    status_t err = info->mSource->stop();
+    ALOGE_IF(err != OK, "error %d stopping track %zu", err, info->mTrackIndex);
+}
+
 void NuMediaExtractor::releaseOneSample(TrackInfo *info) {
     if (info == NULL || info->mSamples.empty()) {
         return;
@@ -512,6 +801,11 @@ void NuMediaExtractor::fetchTrackSamples(TrackInfo *info,
         return;
     }
 
+    if (info->mPrefetcher != NULL) {
+        fetchPrefetchedSample(info, seekTimeUs, mode);
+        return;
+    }
+
     MediaSource::ReadOptions options;
     if (seekTimeUs >= 0ll) {
         options.setSeekTo(seekTimeUs, mode);
@@ -570,6 +864,26 @@ void NuMediaExtractor::fetchTrackSamples(TrackInfo *info,
     }
 }
 
+void NuMediaExtractor::fetchPrefetchedSample(TrackInfo *info,
+        int64_t seekTimeUs, MediaSource::ReadOptions::SeekMode mode) {
+    if (seekTimeUs >= 0ll) {
+        releaseTrackSamples(info);
+        info->mFinalResult = OK;
+        info->mPrefetcher->seekTo(seekTimeUs, mode);
+    } else if (info->mFinalResult != OK || !info->mSamples.empty()) {
+        return;
+    }
+
+    // Only the head sample is moved over; the rest stays with the prefetcher.
+    Sample sample;
+    status_t err = info->mPrefetcher->dequeue(&sample);
+    if (err == OK) {
+        info->mSamples.push_back(sample);
+    } else {
+        info->mFinalResult = err;
+    }
+}
+
 status_t NuMediaExtractor::seekTo(
         int64_t timeUs, MediaSource::ReadOptions::SeekMode mode) {
     Mutex::Autolock autoLock(mLock);
@@ -770,6 +1084,42 @@ status_t NuMediaExtractor::getMetrics(Parcel *reply) {
     return status;
 }
 
+status_t NuMediaExtractor::setPrefetchDepth(size_t depth) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (depth > kMaxPrefetchDepth) {
+        return BAD_VALUE;
+    }
+
+    mPrefetchDepth = depth;
+    return OK;
+}
+
+status_t NuMediaExtractor::getPrefetchStats(
+        size_t index, size_t *queuedSamples, size_t *depth, int64_t *underruns) const {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
+        const TrackInfo &info = mSelectedTracks.itemAt(i);
+        if (info.mTrackIndex != index) {
+            continue;
+        }
+
+        if (info.mPrefetcher == NULL) {
+            *queuedSamples = 0;
+            *depth = 0;
+            *underruns = 0;
+        } else {
+            info.mPrefetcher->getStats(queuedSamples, depth, underruns);
+        }
+        // The head sample already handed over counts as queued.
+        *queuedSamples += info.mSamples.size();
+        return OK;
+    }
+
+    return -EINVAL;
+}
+
 bool NuMediaExtractor::getTotalBitrate(int64_t *bitrate) const {
     if (mTotalBitrate > 0) {
         *bitrate = mTotalBitrate;
@@ -80,7 +80,7 @@ RemoteMediaExtractor::~RemoteMediaExtractor() {
     if (MEDIA_LOG) {
         if (mAnalyticsItem != nullptr) {
             if (mAnalyticsItem->count() > 0) {
-                mAnalyticsItem->selfrecord();
+                mAnalyticsItem->selfrecordBatched();
             }
         }
     }
@@ -54,6 +54,24 @@ status_t RemoteMediaSource::read(
     return mSource->read(buffer, reinterpret_cast<const MediaSource::ReadOptions*>(options));
 }
 
+status_t RemoteMediaSource::readMultiple(
+        Vector<MediaBufferBase *> *buffers, uint32_t maxNumBuffers,
+        const MediaSource::ReadOptions *options) {
+    if (buffers == NULL || !buffers->isEmpty()) {
+        return BAD_VALUE;
+    }
+    return mSource->readMultiple(buffers, maxNumBuffers, SIZE_MAX,
+            reinterpret_cast<const MediaSource::ReadOptions*>(options));
+}
+
+bool RemoteMediaSource::supportReadMultiple() {
+    return true;
+}
+
+bool RemoteMediaSource::supportNonblockingRead() {
+    return mSource->supportNonblockingRead();
+}
+
 status_t RemoteMediaSource::pause() {
     return ERROR_UNSUPPORTED;
 }
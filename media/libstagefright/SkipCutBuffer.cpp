@@ -109,6 +109,21 @@ void SkipCutBuffer::submitInternal(const sp<T>& buffer) {
     }
 
 
+    // Once the stream is longer than the cut, the output is what the cutbuffer
+    // holds followed by all but the last mBackPadding bytes of the new data.
+    // Shift that data up in place instead of passing it through the cutbuffer,
+    // so that only the held and cut bytes are copied.
+    int32_t held = size();
+    if (buflen >= mBackPadding
+            && (size_t)held + buflen - mBackPadding <= buffer->capacity()) {
+        char *data = (char*) buffer->data();
+        write(data + buflen - mBackPadding, mBackPadding);
+        memmove((char*) buffer->base() + held, data, buflen - mBackPadding);
+        read((char*) buffer->base(), held);
+        buffer->setRange(0, held + buflen - mBackPadding);
+        return;
+    }
+
     // append data to cutbuffer
     char *src = (char*) buffer->data();
     write(src, buflen);
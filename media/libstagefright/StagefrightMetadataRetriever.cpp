@@ -314,13 +314,6 @@ status_t StagefrightMetadataRetriever::getFrameInternal(
         return UNKNOWN_ERROR;
     }
 
-    sp<IMediaSource> source = mExtractor->getTrack(i);
-
-    if (source.get() == NULL) {
-        ALOGV("unable to instantiate video track.");
-        return UNKNOWN_ERROR;
-    }
-
     const void *data;
     uint32_t type;
     size_t dataSize;
@@ -329,6 +322,24 @@ status_t StagefrightMetadataRetriever::getFrameInternal(
         mAlbumArt = MediaAlbumArt::fromData(dataSize, data);
     }
 
+    // Callers scrubbing through a file ask for many frames in a row; decode
+    // them with the codec and the track kept from the previous request
+    // rather than setting both up again each time.
+    if (mVideoDecoder != NULL) {
+        if (mVideoDecoder->reinit(timeUs, numFrames, option, colorFormat) == OK
+                && extractVideoFrames(mVideoDecoder, outFrame, outFrames) == OK) {
+            return OK;
+        }
+        mVideoDecoder.clear();
+    }
+
+    sp<IMediaSource> source = mExtractor->getTrack(i);
+
+    if (source.get() == NULL) {
+        ALOGV("unable to instantiate video track.");
+        return UNKNOWN_ERROR;
+    }
+
     const char *mime;
     CHECK(trackMeta->findCString(kKeyMIMEType, &mime));
 
@@ -341,19 +352,11 @@ status_t StagefrightMetadataRetriever::getFrameInternal(
 
     for (size_t i = 0; i < matchingCodecs.size(); ++i) {
         const AString &componentName = matchingCodecs[i];
-        VideoFrameDecoder decoder(componentName, trackMeta, source);
-        if (decoder.init(timeUs, numFrames, option, colorFormat) == OK) {
-            if (outFrame != NULL) {
-                *outFrame = decoder.extractFrame();
-                if (*outFrame != NULL) {
-                    return OK;
-                }
-            } else if (outFrames != NULL) {
-                status_t err = decoder.extractFrames(outFrames);
-                if (err == OK) {
-                    return OK;
-                }
-            }
+        sp<VideoFrameDecoder> decoder = new VideoFrameDecoder(componentName, trackMeta, source);
+        if (decoder->init(timeUs, numFrames, option, colorFormat) == OK
+                && extractVideoFrames(decoder, outFrame, outFrames) == OK) {
+            mVideoDecoder = decoder;
+            return OK;
         }
         ALOGV("%s failed to extract frame, trying next decoder.", componentName.c_str());
     }
@@ -362,6 +365,18 @@ status_t StagefrightMetadataRetriever::getFrameInternal(
     return UNKNOWN_ERROR;
 }
 
+status_t StagefrightMetadataRetriever::extractVideoFrames(
+        const sp<VideoFrameDecoder> &decoder,
+        sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames) {
+    if (outFrame != NULL) {
+        *outFrame = decoder->extractFrame();
+        return (*outFrame != NULL) ? OK : UNKNOWN_ERROR;
+    } else if (outFrames != NULL) {
+        return decoder->extractFrames(outFrames);
+    }
+    return BAD_VALUE;
+}
+
 MediaAlbumArt *StagefrightMetadataRetriever::extractAlbumArt() {
     ALOGV("extractAlbumArt (extractor: %s)", mExtractor.get() != NULL ? "YES" : "NO");
 
@@ -659,6 +674,9 @@ void StagefrightMetadataRetriever::clearMetadata() {
     mMetaData.clear();
     delete mAlbumArt;
     mAlbumArt = NULL;
+    mImageDecoder.clear();
+    mLastImageIndex = -1;
+    mVideoDecoder.clear();
 }
 
 }  // namespace android
@@ -584,6 +584,15 @@ status_t convertMetaDataToMessage(
         return BAD_VALUE;
     }
 
+    // Building the format parses the codec specific data, so reuse the last
+    // result while the metadata is unchanged. The csd buffers are shared
+    // with the cached copy.
+    sp<AMessage> cached = meta->getCachedMessage();
+    if (cached != NULL) {
+        *format = cached->dup();
+        return OK;
+    }
+
     const char *mime;
     if (!meta->findCString(kKeyMIMEType, &mime)) {
         return BAD_VALUE;
@@ -1101,6 +1110,7 @@ status_t convertMetaDataToMessage(
     }
 
      AVUtils::get()->convertMetaDataToMessage(meta, &msg);
+    meta->setCachedMessage(msg->dup());
     *format = msg;
 
     return OK;
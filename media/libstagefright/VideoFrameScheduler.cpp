@@ -332,15 +332,24 @@ nsecs_t VideoFrameScheduler::PLL::getPeriod() const {
 static const nsecs_t kDefaultVsyncPeriod = kNanosIn1s / 60;  // 60Hz
 static const nsecs_t kVsyncRefreshPeriod = kNanosIn1s;       // 1 sec
 
+// frame periods within 0.5% of a whole number of half vsyncs, up to 5 vsyncs,
+// are held for a fixed cadence
+static const nsecs_t kCadenceToleranceDiv = 200;
+static const size_t kMaxCadence = 10;
+
 VideoFrameScheduler::VideoFrameScheduler()
     : mVsyncTime(0),
       mVsyncPeriod(0),
       mVsyncRefreshAt(0),
       mLastVsyncTime(-1),
-      mTimeCorrection(0) {
+      mTimeCorrection(0),
+      mCadence(0),
+      mCadenceIndex(0),
+      mNumJudderFrames(0) {
 }
 
 void VideoFrameScheduler::updateVsync() {
+    nsecs_t lastVsyncPeriod = mVsyncPeriod;
     mVsyncRefreshAt = systemTime(SYSTEM_TIME_MONOTONIC) + kVsyncRefreshPeriod;
     mVsyncPeriod = 0;
     mVsyncTime = 0;
@@ -366,6 +375,31 @@ void VideoFrameScheduler::updateVsync() {
     } else {
         ALOGW("could not get surface mComposer service");
     }
+
+    // The display switched modes. The timing of the last frame, the running
+    // correction and the cadence are all in units of the old period.
+    if (lastVsyncPeriod != 0 && mVsyncPeriod != 0 && mVsyncPeriod != lastVsyncPeriod) {
+        ALOGV("vsync period changed %lld => %lld",
+                (long long)lastVsyncPeriod, (long long)mVsyncPeriod);
+        mLastVsyncTime = -1;
+        mTimeCorrection = 0;
+        mCadence = 0;
+        mCadenceIndex = 0;
+    }
+}
+
+size_t VideoFrameScheduler::getCadence(nsecs_t videoPeriod) const {
+    nsecs_t halfVsyncPeriod = mVsyncPeriod / 2;
+    nsecs_t cadence = divRound(videoPeriod, halfVsyncPeriod);
+    if (cadence < 2 || cadence > (nsecs_t)kMaxCadence) {
+        return 0;
+    }
+    nsecs_t error = videoPeriod - cadence * halfVsyncPeriod;
+    if (error > videoPeriod / kCadenceToleranceDiv
+            || -error > videoPeriod / kCadenceToleranceDiv) {
+        return 0;
+    }
+    return cadence;
 }
 
 void VideoFrameScheduler::init(float videoFps) {
@@ -373,6 +407,9 @@ void VideoFrameScheduler::init(float videoFps) {
 
     mLastVsyncTime = -1;
     mTimeCorrection = 0;
+    mCadence = 0;
+    mCadenceIndex = 0;
+    mNumJudderFrames = 0;
 
     mPll.reset(videoFps);
 }
@@ -380,6 +417,7 @@ void VideoFrameScheduler::init(float videoFps) {
 void VideoFrameScheduler::restart() {
     mLastVsyncTime = -1;
     mTimeCorrection = 0;
+    mCadenceIndex = 0;
 
     mPll.restart();
 }
@@ -391,6 +429,10 @@ nsecs_t VideoFrameScheduler::getVsyncPeriod() {
     return kDefaultVsyncPeriod;
 }
 
+int64_t VideoFrameScheduler::getNumJudderFrames() const {
+    return mNumJudderFrames;
+}
+
 float VideoFrameScheduler::getFrameRate() {
     nsecs_t videoPeriod = mPll.getPeriod();
     if (videoPeriod > 0) {
@@ -424,7 +466,40 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
     renderTime -= mVsyncPeriod / 2;
 
     const nsecs_t videoPeriod = mPll.addSample(origRenderTime);
-    if (videoPeriod > 0) {
+
+    size_t cadence = videoPeriod > 0 ? getCadence(videoPeriod) : 0;
+    if (cadence != mCadence) {
+        ALOGV("cadence %zu => %zu half vsyncs", mCadence, cadence);
+        mCadence = cadence;
+        mCadenceIndex = 0;
+    }
+
+    if (mCadence > 0 && mLastVsyncTime >= 0) {
+        // Hold the frames for a fixed pattern of vsyncs, e.g. 3, 2, 3, 2 for
+        // 3:2 pull-down, instead of letting the correction below pick one for
+        // every frame. Re-anchor if the pattern drifted from the render times.
+        nsecs_t vsyncs = mCadence / 2 + ((mCadence & 1) && (mCadenceIndex & 1) == 0);
+        nsecs_t cadenceVsyncTime = mLastVsyncTime + vsyncs * mVsyncPeriod;
+        nsecs_t nextVsyncTime =
+            renderTime + mVsyncPeriod - ((renderTime - mVsyncTime) % mVsyncPeriod);
+        nsecs_t drift = cadenceVsyncTime - nextVsyncTime;
+        if (drift <= mVsyncPeriod && -drift <= mVsyncPeriod) {
+            ++mCadenceIndex;
+            mLastVsyncTime = cadenceVsyncTime;
+            renderTime = cadenceVsyncTime - mVsyncPeriod / 2;
+            ATRACE_INT("FRAME_VSYNCS", vsyncs);
+            ALOGV("cadence render: %lld => %lld",
+                    (long long)origRenderTime, (long long)renderTime);
+            ATRACE_INT("FRAME_FLIP_IN(ms)", (renderTime - now) / 1000000);
+            return renderTime;
+        }
+        ALOGV("re-anchoring cadence, off by %lld",
+                (long long)drift);
+        ++mNumJudderFrames;
+        mCadenceIndex = 0;
+        mTimeCorrection = 0;
+        mLastVsyncTime = nextVsyncTime;
+    } else if (videoPeriod > 0) {
         // Smooth out rendering
         size_t N = 12;
         nsecs_t fiveSixthDev =
@@ -477,6 +552,12 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
                     ++vsyncsForLastFrame;
             }
             ATRACE_INT("FRAME_VSYNCS", vsyncsForLastFrame);
+
+            // frames should stay up for the frame period rounded down or up
+            if (vsyncsForLastFrame < minVsyncsPerFrame
+                    || vsyncsForLastFrame > minVsyncsPerFrame + 1) {
+                ++mNumJudderFrames;
+            }
         }
         mLastVsyncTime = nextVsyncTime;
     }
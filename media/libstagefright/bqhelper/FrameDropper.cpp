@@ -27,7 +27,8 @@ static const int64_t kMaxJitterUs = 2000;
 
 FrameDropper::FrameDropper()
     : mDesiredMinTimeUs(-1),
-      mMinIntervalUs(0) {
+      mMinIntervalUs(0),
+      mEncoderIntervalUs(0) {
 }
 
 FrameDropper::~FrameDropper() {
@@ -47,13 +48,23 @@ status_t FrameDropper::setMaxFrameRate(float maxFrameRate) {
     return OK;
 }
 
+void FrameDropper::setEncoderIntervalUs(int64_t intervalUs) {
+    mEncoderIntervalUs = intervalUs > 0 ? intervalUs : 0;
+}
+
 bool FrameDropper::shouldDrop(int64_t timeUs) {
-    if (mMinIntervalUs <= 0) {
+    if (disabled()) {
+        return false;
+    }
+
+    int64_t minIntervalUs =
+        mEncoderIntervalUs > mMinIntervalUs ? mEncoderIntervalUs : mMinIntervalUs;
+    if (minIntervalUs <= 0) {
         return false;
     }
 
     if (mDesiredMinTimeUs < 0) {
-        mDesiredMinTimeUs = timeUs + mMinIntervalUs;
+        mDesiredMinTimeUs = timeUs + minIntervalUs;
         ALOGV("first frame %lld, next desired frame %lld",
                 (long long)timeUs, (long long)mDesiredMinTimeUs);
         return false;
@@ -66,8 +77,8 @@ bool FrameDropper::shouldDrop(int64_t timeUs) {
         return true;
     }
 
-    int64_t n = (timeUs - mDesiredMinTimeUs + kMaxJitterUs) / mMinIntervalUs;
-    mDesiredMinTimeUs += (n + 1) * mMinIntervalUs;
+    int64_t n = (timeUs - mDesiredMinTimeUs + kMaxJitterUs) / minIntervalUs;
+    mDesiredMinTimeUs += (n + 1) * minIntervalUs;
     ALOGV("keep frame %lld, next desired frame %lld, diff %lld",
             (long long)timeUs, (long long)mDesiredMinTimeUs,
             (long long)(mDesiredMinTimeUs - timeUs));
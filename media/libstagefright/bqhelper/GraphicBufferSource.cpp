@@ -29,6 +29,7 @@
 #include <media/stagefright/foundation/ColorUtils.h>
 #include <media/stagefright/foundation/FileDescriptor.h>
 
+#include <cutils/properties.h>
 #include <media/hardware/MetadataBufferType.h>
 #include <ui/GraphicBuffer.h>
 #include <gui/BufferItem.h>
@@ -70,6 +71,17 @@ namespace {
 //
 // TODO: Justify the choice of this value, or make it configurable.
 constexpr double kTimestampFluctuation = 0.05;
+
+// Longest codec buffer return interval that is taken as a measure of encoder throughput. Longer
+// gaps are stalls of the producer rather than a slow encoder.
+constexpr int64_t kMaxEncoderIntervalUs = 1000000ll;
+
+// Measured encoder intervals decaying below this no longer throttle the frame rate.
+constexpr int64_t kMinEncoderIntervalUs = 1000ll;
+
+static inline bool getLoadAwareDropSetting() {
+    return property_get_bool("media.stagefright.gbs.load-aware-drop", true);
+}
 }
 
 /**
@@ -294,10 +306,14 @@ GraphicBufferSource::GraphicBufferSource() :
     mStopTimeUs(-1),
     mLastActionTimeUs(-1ll),
     mSkipFramesBeforeNs(-1ll),
+    mLoadAwareDropEnabled(getLoadAwareDropSetting()),
+    mLastBufferEmptiedUs(-1ll),
+    mEncoderIntervalUs(0ll),
     mFrameRepeatIntervalUs(-1ll),
     mRepeatLastFrameGeneration(0),
     mOutstandingFrameRepeatCount(0),
     mFrameRepeatBlockedOnCodecBuffer(false),
+    mComponentRepeatsFrames(true),
     mFps(-1.0),
     mCaptureFps(-1.0),
     mBaseCaptureUs(-1ll),
@@ -478,6 +494,9 @@ Status GraphicBufferSource::onInputBufferEmptied(codec_buffer_id bufferId, int f
 
     std::shared_ptr<AcquiredBuffer> buffer = mSubmittedCodecBuffers.valueAt(cbi);
 
+    // the encoder was holding every codec buffer while frames were waiting for it
+    bool saturated = mFreeCodecBuffers.empty() && haveAvailableBuffers_l();
+
     // Move buffer to available buffers
     mSubmittedCodecBuffers.removeItemsAt(cbi);
     mFreeCodecBuffers.push_back(bufferId);
@@ -510,6 +529,8 @@ Status GraphicBufferSource::onInputBufferEmptied(codec_buffer_id bufferId, int f
     // release codec reference for video buffer just in case remove does not it
     buffer.reset();
 
+    updateEncoderLoad_l(saturated);
+
     if (haveAvailableBuffers_l()) {
         // Fill this codec buffer.
         CHECK(!mEndOfStreamSent);
@@ -706,7 +727,7 @@ bool GraphicBufferSource::repeatLatestBuffer_l() {
     }
 
     // it is ok to update the timestamp of latest buffer as it is only used for submission
-    status_t err = submitBuffer_l(mLatestBuffer);
+    status_t err = submitBuffer_l(mLatestBuffer, true /* repeat */);
     if (err != OK) {
         return false;
     }
@@ -746,6 +767,42 @@ void GraphicBufferSource::queueFrameRepeat_l() {
     }
 }
 
+void GraphicBufferSource::updateEncoderLoad_l(bool saturated) {
+    int64_t nowUs = systemTime() / 1000;
+    int64_t lastUs = mLastBufferEmptiedUs;
+    mLastBufferEmptiedUs = nowUs;
+
+    // time lapse and slow motion rely on every captured frame being encoded
+    if (!mLoadAwareDropEnabled || mCaptureFps > 0.
+            || (mFrameDropper != NULL && mFrameDropper->disabled())) {
+        return;
+    }
+
+    if (saturated && lastUs >= 0ll) {
+        int64_t intervalUs = nowUs - lastUs;
+        if (intervalUs > kMaxEncoderIntervalUs) {
+            return;
+        }
+        mEncoderIntervalUs = mEncoderIntervalUs > 0ll
+                ? (mEncoderIntervalUs * 7 + intervalUs) / 8 : intervalUs;
+    } else if (mEncoderIntervalUs > 0ll) {
+        // the encoder has headroom; relax the limit gradually so that we do not oscillate
+        // between throttling and overloading it.
+        mEncoderIntervalUs -= mEncoderIntervalUs / 16;
+        if (mEncoderIntervalUs < kMinEncoderIntervalUs) {
+            mEncoderIntervalUs = 0ll;
+        }
+    } else {
+        return;
+    }
+
+    ALOGV("encoder interval %lld us (saturated=%d)", (long long)mEncoderIntervalUs, saturated);
+    if (mFrameDropper == NULL) {
+        mFrameDropper = new FrameDropper();
+    }
+    mFrameDropper->setEncoderIntervalUs(mEncoderIntervalUs);
+}
+
 bool GraphicBufferSource::calculateCodecTimestamp_l(
         nsecs_t bufferTimeNs, int64_t *codecTimeUs) {
     int64_t timeUs = bufferTimeNs / 1000;
@@ -805,7 +862,7 @@ bool GraphicBufferSource::calculateCodecTimestamp_l(
     return true;
 }
 
-status_t GraphicBufferSource::submitBuffer_l(const VideoBuffer &item) {
+status_t GraphicBufferSource::submitBuffer_l(const VideoBuffer &item, bool repeat) {
     CHECK(!mFreeCodecBuffers.empty());
     uint32_t codecBufferId = *mFreeCodecBuffers.begin();
 
@@ -829,8 +886,20 @@ status_t GraphicBufferSource::submitBuffer_l(const VideoBuffer &item) {
     // acquired GraphicBuffer.
     // TODO: this can be reworked globally to use ANWBuffer references
     sp<GraphicBuffer> graphicBuffer = buffer->getGraphicBuffer();
-    status_t err = mComponent->submitBuffer(
-            codecBufferId, graphicBuffer, codecTimeUs, buffer->getAcquireFenceFd());
+    status_t err = INVALID_OPERATION;
+    if (repeat && mComponentRepeatsFrames) {
+        // the codec already has the frame contents, so only signal the repeat. We still hold a
+        // reference to the buffer in mSubmittedCodecBuffers as the codec may read it again.
+        err = mComponent->submitRepeat(codecBufferId, codecTimeUs);
+        if (err == INVALID_OPERATION) {
+            ALOGV("component cannot repeat frames, resubmitting buffers instead");
+            mComponentRepeatsFrames = false;
+        }
+    }
+    if (err == INVALID_OPERATION) {
+        err = mComponent->submitBuffer(
+                codecBufferId, graphicBuffer, codecTimeUs, buffer->getAcquireFenceFd());
+    }
 
     if (err != OK) {
         ALOGW("WARNING: emptyGraphicBuffer failed: 0x%x", err);
@@ -1117,6 +1186,9 @@ status_t GraphicBufferSource::configure(
         mEndOfStreamSent = false;
         mSkipFramesBeforeNs = -1ll;
         mFrameDropper.clear();
+        mLastBufferEmptiedUs = -1ll;
+        mEncoderIntervalUs = 0ll;
+        mComponentRepeatsFrames = true;
         mFrameRepeatIntervalUs = -1ll;
         mRepeatLastFrameGeneration = 0;
         mOutstandingFrameRepeatCount = 0;
@@ -17,6 +17,7 @@
 #ifndef COMPONENT_WRAPPER_H_
 #define COMPONENT_WRAPPER_H_
 
+#include <utils/Errors.h>
 #include <utils/RefBase.h>
 #include <utils/StrongPointer.h>
 #include <ui/GraphicBuffer.h>
@@ -30,6 +31,13 @@ struct ComponentWrapper : public RefBase {
             int32_t bufferId, const sp<GraphicBuffer> &buffer = nullptr,
             int64_t timestamp = 0, int fenceFd = -1) = 0;
     virtual status_t submitEos(int32_t bufferId) = 0;
+    // Asks the component to re-encode the previously submitted frame at
+    // |timestamp| without handing it the graphic buffer again. Components that
+    // cannot repeat a frame on their own return INVALID_OPERATION, in which
+    // case the caller resubmits the buffer instead.
+    virtual status_t submitRepeat(int32_t /* bufferId */, int64_t /* timestamp */) {
+        return INVALID_OPERATION;
+    }
     virtual void dispatchDataSpaceChanged(
             int32_t dataSpace, int32_t aspects, int32_t pixelFormat) = 0;
 };
@@ -32,7 +32,14 @@ struct FrameDropper : public RefBase {
     // maxFrameRate required to be positive.
     status_t setMaxFrameRate(float maxFrameRate);
 
-    // Returns false if max frame rate has not been set via setMaxFrameRate.
+    // Sets the interval at which the encoder is measured to consume frames.
+    // While positive, frames arriving faster than this are also dropped, so
+    // the effective interval is the larger of this and the max frame rate
+    // interval. Pass 0 to stop throttling on encoder load.
+    void setEncoderIntervalUs(int64_t intervalUs);
+
+    // Returns false if neither a max frame rate nor an encoder interval has
+    // been set.
     bool shouldDrop(int64_t timeUs);
 
     // Returns true if all frame drop logic should be disabled.
@@ -44,6 +51,7 @@ protected:
 private:
     int64_t mDesiredMinTimeUs;
     int64_t mMinIntervalUs;
+    int64_t mEncoderIntervalUs;
 
     DISALLOW_EVIL_CONSTRUCTORS(FrameDropper);
 };
@@ -63,6 +63,7 @@ struct FrameDropper;
  * The source, furthermore, may choose to not encode (drop) frames if:
  *
  * - to throttle the frame rate (keep it under a certain limit)
+ * - the encoder is measured to consume frames slower than they arrive
  *
  * Finally the source may optionally hold onto the last non-discarded frame
  * (even if it was dropped) to reencode it after an interval if no further
@@ -317,10 +318,12 @@ private:
     bool fillCodecBuffer_l();
 
     // Calculates the media timestamp for |item| and on success it submits the buffer to the codec,
-    // while also keeping a reference for it in mSubmittedCodecBuffers.
+    // while also keeping a reference for it in mSubmittedCodecBuffers. If |repeat| is true, |item|
+    // is the previously submitted frame and the codec is asked to repeat it without receiving the
+    // buffer again, if it supports that.
     // Returns UNKNOWN_ERROR if the buffer was not submitted due to buffer timestamp. Otherwise,
     // it returns any submit success or error value returned by the codec.
-    status_t submitBuffer_l(const VideoBuffer &item);
+    status_t submitBuffer_l(const VideoBuffer &item, bool repeat = false);
 
     // Submits an empty buffer, with the EOS flag set if there is an available codec buffer and
     // sets mEndOfStreamSent flag. Does nothing if there is no codec buffer available.
@@ -398,6 +401,21 @@ private:
 
     sp<FrameDropper> mFrameDropper;
 
+    // Encoder load tracking
+    // ---------------------
+    // whether frames are dropped when the encoder cannot keep up with the producer
+    bool mLoadAwareDropEnabled;
+
+    // system time the encoder last returned a codec buffer (<0 if none yet)
+    int64_t mLastBufferEmptiedUs;
+
+    // smoothed interval at which the encoder consumes frames while saturated (0 if unknown)
+    int64_t mEncoderIntervalUs;
+
+    // updates the measured encoder interval when a codec buffer is returned. |saturated| is true
+    // if the encoder was holding all codec buffers at the time.
+    void updateEncoderLoad_l(bool saturated);
+
     sp<ALooper> mLooper;
     sp<AHandlerReflector<GraphicBufferSource> > mReflector;
 
@@ -416,6 +434,10 @@ private:
     // no codec buffer was available at the time.
     bool mFrameRepeatBlockedOnCodecBuffer;
 
+    // whether the component may be asked to repeat the previous frame itself instead of being
+    // handed the buffer again. Cleared once the component declines.
+    bool mComponentRepeatsFrames;
+
     // hold a reference to the last acquired (and not discarded) frame for frame repeating
     VideoBuffer mLatestBuffer;
 
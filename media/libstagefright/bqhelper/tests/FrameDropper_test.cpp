@@ -83,6 +83,15 @@ static const TestFrame testFramesVariableFps[] = {
     {3233333, false}, {3250000, true}, {3266667, false}, {3283333, true},
 };
 
+// 60fps input throttled by an encoder consuming a frame every 50ms
+static const TestFrame testFrames60FpsEncoderLimited[] = {
+    {1000000, false}, {1016667, true}, {1033333, true}, {1050000, false},
+    {1066667, true}, {1083333, true}, {1100000, false}, {1116667, true},
+    {1133333, true}, {1150000, false}, {1166667, true}, {1183333, true},
+    {1200000, false}, {1216667, true}, {1233333, true}, {1250000, false},
+    {1266667, true}, {1283333, true}, {1300000, false}, {1316667, true},
+};
+
 static const int kMaxTestJitterUs = 2000;
 // return one of 1000, 0, -1000 as jitter.
 static int GetJitter(size_t i) {
@@ -134,4 +143,15 @@ TEST_F(FrameDropperTest, TestVariableFps) {
     RunTest(testFramesVariableFps, ARRAY_SIZE(testFramesVariableFps));
 }
 
+TEST_F(FrameDropperTest, TestEncoderInterval) {
+    mFrameDropper->setEncoderIntervalUs(50000);
+    RunTest(testFrames60FpsEncoderLimited, ARRAY_SIZE(testFrames60FpsEncoderLimited));
+}
+
+TEST_F(FrameDropperTest, TestEncoderIntervalBelowMaxFrameRate) {
+    // the max frame rate still applies when the encoder keeps up
+    mFrameDropper->setEncoderIntervalUs(10000);
+    RunTest(testFrames60Fps, ARRAY_SIZE(testFrames60Fps));
+}
+
 } // namespace android
@@ -25,8 +25,85 @@
 #include "typedef.h"
 #include "basic_op.h"
 
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define CONVOLVE_SIMD
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CONVOLVE_SIMD
+#endif
+
 #define UNUSED(x) (void)(x)
 
+#ifdef CONVOLVE_SIMD
+
+/* Dot product of x[0..len-1] and r[0..len-1] accumulated on 32 bits.
+ * The caller guarantees that the sum of the absolute products is below 2^31,
+ * so that no partial sum can overflow, whatever the summation order. */
+static Word32 Dot_product_simd(const Word16 *x, const Word16 *r, Word32 len)
+{
+    Word32 i = 0;
+    Word32 s;
+#if defined(__aarch64__)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 8 <= len; i += 8)
+    {
+        int16x8_t vx = vld1q_s16(&x[i]);
+        int16x8_t vr = vld1q_s16(&r[i]);
+        acc = vmlal_s16(acc, vget_low_s16(vx), vget_low_s16(vr));
+        acc = vmlal_high_s16(acc, vx, vr);
+    }
+    s = vaddvq_s32(acc);
+#else
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 8 <= len; i += 8)
+    {
+        __m128i vx = _mm_loadu_si128((const __m128i *)&x[i]);
+        __m128i vr = _mm_loadu_si128((const __m128i *)&r[i]);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(vx, vr));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    s = _mm_cvtsi128_si32(acc);
+#endif
+    for (; i < len; i++)
+    {
+        s += vo_mult32(x[i], r[i]);
+    }
+    return s;
+}
+
+/* Returns 1 when no partial sum of any output of the convolution can leave
+ * the 32 bit range. The saturating additions of the reference code then never
+ * saturate, and a reordered summation gives bit exact results.
+ * Both the sum(|x|) * max(|h|) and the Cauchy-Schwarz bounds are tried. */
+static Word32 Convolve_cannot_saturate(const Word16 x[], const Word16 h[])
+{
+    Word32 i;
+    Word32 sumX = 0, maxH = 0;
+    long long energyX = 0, energyH = 0;
+    for (i = 0; i < 64; i++)
+    {
+        Word32 ax = x[i] < 0 ? -x[i] : x[i];
+        Word32 ah = h[i] < 0 ? -h[i] : h[i];
+        sumX += ax;
+        if (ah > maxH)
+        {
+            maxH = ah;
+        }
+        energyX += (long long)ax * ax;
+        energyH += (long long)ah * ah;
+    }
+    if ((long long)sumX * maxH <= MAX_32)
+    {
+        return 1;
+    }
+    /* sum(|x||h|) <= sqrt(energyX * energyH) < 2^31 */
+    return energyH == 0 || energyX < (1LL << 62) / energyH;
+}
+
+#endif /* CONVOLVE_SIMD */
+
 void Convolve (
         Word16 x[],        /* (i)     : input vector                           */
         Word16 h[],        /* (i)     : impulse response                       */
@@ -39,6 +116,23 @@ void Convolve (
     Word32 s;
         UNUSED(L);
 
+#ifdef CONVOLVE_SIMD
+    if (Convolve_cannot_saturate(x, h))
+    {
+        Word16 hr[64];     /* h reversed, so that both vectors are read forward */
+        for (i = 0; i < 64; i++)
+        {
+            hr[i] = h[63 - i];
+        }
+        for (n = 0; n < 64; n++)
+        {
+            s = Dot_product_simd(x, &hr[63 - n], n + 1);
+            y[n] = voround(L_shl(s, 1));
+        }
+        return;
+    }
+#endif
+
     for (n = 0; n < 64;)
     {
         tmpH = h+n;
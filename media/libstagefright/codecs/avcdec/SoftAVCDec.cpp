@@ -103,19 +103,6 @@ static void ivd_aligned_free(void *ctxt, void *buf) {
     return;
 }
 
-static size_t GetCPUCoreCount() {
-    long cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
-    return (size_t)cpuCoreCount;
-}
-
 void SoftAVC::logVersion() {
     ivd_ctl_getversioninfo_ip_t s_ctl_ip;
     ivd_ctl_getversioninfo_op_t s_ctl_op;
@@ -209,9 +196,10 @@ status_t SoftAVC::setNumCores() {
     ivdext_ctl_set_num_cores_ip_t s_set_cores_ip;
     ivdext_ctl_set_num_cores_op_t s_set_cores_op;
     IV_API_CALL_STATUS_T status;
+    mNumCores = getDecoderThreadCount(mWidth, mHeight, CODEC_MAX_NUM_CORES);
     s_set_cores_ip.e_cmd = IVD_CMD_VIDEO_CTL;
     s_set_cores_ip.e_sub_cmd = IVDEXT_CMD_CTL_SET_NUM_CORES;
-    s_set_cores_ip.u4_num_cores = MIN(mNumCores, CODEC_MAX_NUM_CORES);
+    s_set_cores_ip.u4_num_cores = mNumCores;
     s_set_cores_ip.u4_size = sizeof(ivdext_ctl_set_num_cores_ip_t);
     s_set_cores_op.u4_size = sizeof(ivdext_ctl_set_num_cores_op_t);
     status = ivdec_api_function(
@@ -251,7 +239,7 @@ status_t SoftAVC::setFlushMode() {
 status_t SoftAVC::initDecoder() {
     IV_API_CALL_STATUS_T status;
 
-    mNumCores = GetCPUCoreCount();
+    mNumCores = 1;
     mCodecCtx = NULL;
 
     mStride = outputBufferWidth();
@@ -494,6 +482,10 @@ void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
         mStride = outputBufferWidth();
         setParams(mStride);
     }
+    if (getDecoderThreadCount(mWidth, mHeight, CODEC_MAX_NUM_CORES) != mNumCores) {
+        /* Number of threads worth using changed with the stream size */
+        setNumCores();
+    }
 
     List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
     List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
@@ -19,6 +19,7 @@
 #include "mp4lib_int.h"
 
 #include "sad_inline.h"
+#include "sad_simd_inline.h"
 
 #define Cached_lx 176
 
@@ -85,7 +86,11 @@ extern "C"
 
         NUM_SAD_MB_CALL();
 
+#ifdef M4VENC_SAD_SIMD
+        x10 = sad_mb_simd(ref, blk, dmin, lx);
+#else
         x10 = simd_sad_mb(ref, blk, dmin, lx);
+#endif
 
         return x10;
     }
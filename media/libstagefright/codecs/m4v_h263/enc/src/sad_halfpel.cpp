@@ -31,6 +31,7 @@ Int SAD_Blk_HalfPel_C(UChar *ref,UChar *blk,Int dmin,Int width,Int rx,Int xh,Int
 #include "mp4def.h"
 #include "mp4lib_int.h"
 #include "sad_halfpel_inline.h"
+#include "sad_simd_inline.h"
 
 #ifdef _SAD_STAT
 ULong num_sad_HP_MB = 0;
@@ -231,6 +232,10 @@ extern "C"
 
         NUM_SAD_HP_MB_CALL();
 
+#ifdef M4VENC_SAD_SIMD
+        return sad_mb_halfpel_xhyh_simd(ref, blk, (Int)((ULong)dmin_rx >> 16), rx);
+#endif
+
         p1 = ref;
         p2 = ref + 1;
         p3 = ref + rx;
@@ -272,6 +277,10 @@ extern "C"
 
         NUM_SAD_HP_MB_CALL();
 
+#ifdef M4VENC_SAD_SIMD
+        return sad_mb_halfpel_yh_simd(ref, blk, (Int)((ULong)dmin_rx >> 16), rx);
+#endif
+
         p1 = ref;
         p2 = ref + rx; /* either left/right or top/bottom pixel */
         kk  = blk;
@@ -308,6 +317,10 @@ extern "C"
 
         NUM_SAD_HP_MB_CALL();
 
+#ifdef M4VENC_SAD_SIMD
+        return sad_mb_halfpel_xh_simd(ref, blk, (Int)((ULong)dmin_rx >> 16), rx);
+#endif
+
         p1 = ref;
         kk  = blk;
 
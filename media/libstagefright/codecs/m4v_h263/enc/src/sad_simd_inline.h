@@ -0,0 +1,192 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 1998-2009 PacketVideo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+/*********************************************************************************/
+/*  Filename: sad_simd_inline.h                                                 */
+/*  Description: NEON and SSE2 versions of the 16x16 integer-pel and half-pel   */
+/*               SAD used by the motion search. They return exactly what the C  */
+/*               versions return, including the early exit after the first row  */
+/*               that takes the SAD over dmin, so the search decisions and the  */
+/*               bitstream do not change.                                       */
+/*  Modified:                                                                   */
+/*********************************************************************************/
+#ifndef _SAD_SIMD_INLINE_H_
+#define _SAD_SIMD_INLINE_H_
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define M4VENC_SAD_SIMD
+#define M4VENC_SAD_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define M4VENC_SAD_SIMD
+#define M4VENC_SAD_SSE2
+#endif
+
+#ifdef M4VENC_SAD_SIMD
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifdef M4VENC_SAD_NEON
+    typedef uint8x16_t sad_vec_t;
+
+    __inline sad_vec_t sad_load16(const UChar *p)
+    {
+        return vld1q_u8(p);
+    }
+
+    __inline int32 sad_vec16(sad_vec_t a, sad_vec_t b)
+    {
+        uint16x8_t s16 = vpaddlq_u8(vabdq_u8(a, b));
+        uint64x2_t s64 = vpaddlq_u32(vpaddlq_u16(s16));
+        return (int32)(vgetq_lane_u64(s64, 0) + vgetq_lane_u64(s64, 1));
+    }
+
+    /* (a + b + 1) >> 1 */
+    __inline sad_vec_t sad_avg2(sad_vec_t a, sad_vec_t b)
+    {
+        return vrhaddq_u8(a, b);
+    }
+
+    /* (a + b + c + d + 2) >> 2 */
+    __inline sad_vec_t sad_avg4(sad_vec_t a, sad_vec_t b, sad_vec_t c, sad_vec_t d)
+    {
+        uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a), vget_low_u8(b)),
+                                  vaddl_u8(vget_low_u8(c), vget_low_u8(d)));
+        uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a), vget_high_u8(b)),
+                                  vaddl_u8(vget_high_u8(c), vget_high_u8(d)));
+        return vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2));
+    }
+#else /* M4VENC_SAD_SSE2 */
+    typedef __m128i sad_vec_t;
+
+    __inline sad_vec_t sad_load16(const UChar *p)
+    {
+        return _mm_loadu_si128((const __m128i *)p);
+    }
+
+    __inline int32 sad_vec16(sad_vec_t a, sad_vec_t b)
+    {
+        __m128i s = _mm_sad_epu8(a, b);
+        return _mm_cvtsi128_si32(s) + _mm_extract_epi16(s, 4);
+    }
+
+    __inline sad_vec_t sad_avg2(sad_vec_t a, sad_vec_t b)
+    {
+        return _mm_avg_epu8(a, b);
+    }
+
+    __inline sad_vec_t sad_avg4(sad_vec_t a, sad_vec_t b, sad_vec_t c, sad_vec_t d)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                                 _mm_unpacklo_epi8(b, zero)),
+                                   _mm_add_epi16(_mm_unpacklo_epi8(c, zero),
+                                                 _mm_unpacklo_epi8(d, zero)));
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                                 _mm_unpackhi_epi8(b, zero)),
+                                   _mm_add_epi16(_mm_unpackhi_epi8(c, zero),
+                                                 _mm_unpackhi_epi8(d, zero)));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+        return _mm_packus_epi16(lo, hi);
+    }
+#endif
+
+    /* blk is the 16x16 current macroblock with a stride of 16, as in simd_sad_mb() */
+    __inline int32 sad_mb_simd(UChar *ref, UChar *blk, Int dmin, Int lx)
+    {
+        int32 sad = 0;
+        Int i;
+
+        for (i = 0; i < 16; i++)
+        {
+            sad += sad_vec16(sad_load16(ref), sad_load16(blk));
+            if (sad > dmin)
+                break;
+            ref += lx;
+            blk += 16;
+        }
+        return sad;
+    }
+
+    __inline int32 sad_mb_halfpel_xh_simd(UChar *ref, UChar *blk, Int dmin, Int rx)
+    {
+        int32 sad = 0;
+        Int i;
+
+        for (i = 0; i < 16; i++)
+        {
+            sad_vec_t p = sad_avg2(sad_load16(ref), sad_load16(ref + 1));
+            sad += sad_vec16(p, sad_load16(blk));
+            if (sad > dmin)
+                break;
+            ref += rx;
+            blk += 16;
+        }
+        return sad;
+    }
+
+    __inline int32 sad_mb_halfpel_yh_simd(UChar *ref, UChar *blk, Int dmin, Int rx)
+    {
+        int32 sad = 0;
+        Int i;
+
+        for (i = 0; i < 16; i++)
+        {
+            sad_vec_t p = sad_avg2(sad_load16(ref), sad_load16(ref + rx));
+            sad += sad_vec16(p, sad_load16(blk));
+            if (sad > dmin)
+                break;
+            ref += rx;
+            blk += 16;
+        }
+        return sad;
+    }
+
+    __inline int32 sad_mb_halfpel_xhyh_simd(UChar *ref, UChar *blk, Int dmin, Int rx)
+    {
+        int32 sad = 0;
+        Int i;
+        /* the bottom row of one step is the top row of the next */
+        sad_vec_t t0 = sad_load16(ref), t1 = sad_load16(ref + 1);
+
+        for (i = 0; i < 16; i++)
+        {
+            ref += rx;
+            sad_vec_t b0 = sad_load16(ref), b1 = sad_load16(ref + 1);
+            sad += sad_vec16(sad_avg4(t0, t1, b0, b1), sad_load16(blk));
+            if (sad > dmin)
+                break;
+            t0 = b0;
+            t1 = b1;
+            blk += 16;
+        }
+        return sad;
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* M4VENC_SAD_SIMD */
+
+#endif /* _SAD_SIMD_INLINE_H_ */
@@ -30,6 +30,7 @@
 #include <stdint.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "mp4enc_api.h"
 
@@ -199,6 +200,9 @@ int main(int argc, char *argv[]) {
     int32_t frameSize = (width * height * 3) / 2;
     int32_t numFramesEncoded = 0;
 
+    // Time spent in the encoder only, excluding file I/O.
+    int64_t encodeTimeNs = 0;
+
     while (1) {
         // Read the input frame.
         int32_t bytesRead;
@@ -222,9 +226,14 @@ int main(int argc, char *argv[]) {
         int32_t nLayer = 0;
         MP4HintTrack hintTrack;
         int32_t dataLength = kOutputBufferSize;
-        if (!PVEncodeVideoFrame(&handle, &vin, &vout,
-                &modTimeMs, outputBuf, &dataLength, &nLayer) ||
-            !PVGetHintTrack(&handle, &hintTrack)) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool encoded = PVEncodeVideoFrame(&handle, &vin, &vout,
+                &modTimeMs, outputBuf, &dataLength, &nLayer);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        encodeTimeNs += (end.tv_sec - start.tv_sec) * 1000000000LL
+                + (end.tv_nsec - start.tv_nsec);
+        if (!encoded || !PVGetHintTrack(&handle, &hintTrack)) {
             fprintf(stderr, "Failed to encode frame or get hink track at "
                     " frame %d\n", numFramesEncoded);
             retVal = EXIT_FAILURE;
@@ -237,6 +246,11 @@ int main(int argc, char *argv[]) {
         fwrite(outputBuf, 1, dataLength, fpOutput);
     }
 
+    if (numFramesEncoded > 0 && encodeTimeNs > 0) {
+        printf("Encoded %d frames in %.3f ms, %.2f fps\n", numFramesEncoded,
+                encodeTimeNs / 1e6, numFramesEncoded * 1e9 / encodeTimeNs);
+    }
+
     // Close input and output file.
     fclose(fpInput);
     fclose(fpOutput);
@@ -76,6 +76,10 @@ Input
 #include "pvmp3_dec_defs.h"
 #include "pvmp3_tables.h"
 
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module1 specific macros here
@@ -112,6 +116,89 @@ Input
 ; FUNCTION CODE
 ----------------------------------------------------------------------------*/
 
+#if defined(__aarch64__)
+
+/*
+ *  Four lanes of fxp_mul32_Q32(), i.e. the top 32 bits of the 64 bit products.
+ *  The truncation is done per product and the accumulation wraps like the C
+ *  code, so the result is bit exact.
+ */
+static inline int32x4_t mul32_Q32x4(int32x4_t a, int32x4_t b)
+{
+    int64x2_t lo = vmull_s32(vget_low_s32(a), vget_low_s32(b));
+    int64x2_t hi = vmull_high_s32(a, b);
+    return vcombine_s32(vshrn_n_s64(lo, 32), vshrn_n_s64(hi, 32));
+}
+
+static inline int32x4_t reverse4(int32x4_t a)
+{
+    a = vrev64q_s32(a);
+    return vextq_s32(a, a, 2);
+}
+
+/*
+ *  Same as the j loop of pvmp3_polyphase_filter_window() for the four
+ *  subbands j0 .. j0 + 3 at once. The window coefficients of one subband
+ *  are consecutive, so four of them are loaded and transposed per group of
+ *  four coefficients.
+ */
+static void polyphase_filter_window_4(int32 *synth_buffer,
+                                      int16 *outPcm,
+                                      int32 numChannels,
+                                      int32 j0)
+{
+    const int32 *win = &pqmfSynthWin[(j0 - 1) << 4];
+    int32 *pt_1 = &synth_buffer[(SUBBANDS_NUMBER >> 1) + j0];
+    int32 *pt_2 = &synth_buffer[(SUBBANDS_NUMBER >> 1) - j0 - 3];
+    int32x4_t sum1 = vdupq_n_s32(0x00000020);
+    int32x4_t sum2 = vdupq_n_s32(0x00000020);
+
+    for (int32 q = 0; q < 4; q++)
+    {
+        /* w.val[n] holds coefficient 4*q + n of the four subbands */
+        int32x4_t r0 = vld1q_s32(win + (q << 2));
+        int32x4_t r1 = vld1q_s32(win + 16 + (q << 2));
+        int32x4_t r2 = vld1q_s32(win + 32 + (q << 2));
+        int32x4_t r3 = vld1q_s32(win + 48 + (q << 2));
+        int32x4x2_t t01 = vtrnq_s32(r0, r1);
+        int32x4x2_t t23 = vtrnq_s32(r2, r3);
+        int32x4_t w0 = vcombine_s32(vget_low_s32(t01.val[0]), vget_low_s32(t23.val[0]));
+        int32x4_t w1 = vcombine_s32(vget_low_s32(t01.val[1]), vget_low_s32(t23.val[1]));
+        int32x4_t w2 = vcombine_s32(vget_high_s32(t01.val[0]), vget_high_s32(t23.val[0]));
+        int32x4_t w3 = vcombine_s32(vget_high_s32(t01.val[1]), vget_high_s32(t23.val[1]));
+
+        int32 m = q << 1;
+        int32x4_t temp1 = vld1q_s32(&pt_1[SUBBANDS_NUMBER * m]);
+        int32x4_t temp3 = reverse4(vld1q_s32(&pt_2[SUBBANDS_NUMBER * (15 - m)]));
+        int32x4_t temp2 = reverse4(vld1q_s32(&pt_2[SUBBANDS_NUMBER * (m + 1)]));
+        int32x4_t temp4 = vld1q_s32(&pt_1[SUBBANDS_NUMBER * (14 - m)]);
+
+        sum1 = vaddq_s32(sum1, mul32_Q32x4(temp1, w0));
+        sum2 = vaddq_s32(sum2, mul32_Q32x4(temp3, w0));
+        sum2 = vaddq_s32(sum2, mul32_Q32x4(temp1, w1));
+        sum1 = vsubq_s32(sum1, mul32_Q32x4(temp3, w1));
+        sum1 = vaddq_s32(sum1, mul32_Q32x4(temp2, w2));
+        sum2 = vsubq_s32(sum2, mul32_Q32x4(temp4, w2));
+        sum2 = vaddq_s32(sum2, mul32_Q32x4(temp2, w3));
+        sum1 = vaddq_s32(sum1, mul32_Q32x4(temp4, w3));
+    }
+
+    /* saturate16(sum >> 6) */
+    int16 out1[4];
+    int16 out2[4];
+    vst1_s16(out1, vqmovn_s32(vshrq_n_s32(sum1, 6)));
+    vst1_s16(out2, vqmovn_s32(vshrq_n_s32(sum2, 6)));
+    for (int32 l = 0; l < 4; l++)
+    {
+        int32 k = (j0 + l) << (numChannels - 1);
+        outPcm[k] = out1[l];
+        outPcm[(numChannels<<5) - k] = out2[l];
+    }
+}
+
+#endif
+
+
 void pvmp3_polyphase_filter_window(int32 *synth_buffer,
                                    int16 *outPcm,
                                    int32 numChannels)
@@ -122,7 +209,18 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
     int32 i;
 
 
-    for (int16 j = 1; j < SUBBANDS_NUMBER / 2; j++)
+    int16 j = 1;
+
+#if defined(__aarch64__)
+    /* the vector version relies on a single pass of the i loop below per subband */
+    for (; j + 3 < SUBBANDS_NUMBER / 2; j += 4)
+    {
+        polyphase_filter_window_4(synth_buffer, outPcm, numChannels, j);
+    }
+    winPtr += (j - 1) << 4;
+#endif
+
+    for (; j < SUBBANDS_NUMBER / 2; j++)
     {
         sum1 = 0x00000020;
         sum2 = 0x00000020;
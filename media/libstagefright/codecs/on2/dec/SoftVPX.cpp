@@ -67,19 +67,6 @@ SoftVPX::~SoftVPX() {
     destroyDecoder();
 }
 
-static int GetCPUCoreCount() {
-    int cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %d", cpuCoreCount);
-    return cpuCoreCount;
-}
-
 bool SoftVPX::supportDescribeHdrStaticInfo() {
     return true;
 }
@@ -91,7 +78,9 @@ status_t SoftVPX::initDecoder() {
     vpx_codec_flags_t flags;
     memset(&cfg, 0, sizeof(vpx_codec_dec_cfg_t));
     memset(&flags, 0, sizeof(vpx_codec_flags_t));
-    cfg.threads = GetCPUCoreCount();
+    // tiles (VP9) and token partitions / macroblock rows (VP8) bound the useful number of
+    // threads by the stream itself, so give the decoder the whole budget.
+    cfg.threads = getDecoderThreadBudget();
 
     if (mFrameParallelMode) {
         flags |= VPX_CODEC_USE_FRAME_THREADING;
@@ -105,6 +94,17 @@ status_t SoftVPX::initDecoder() {
         return UNKNOWN_ERROR;
     }
 
+#ifdef VPX_CTRL_VP9D_SET_ROW_MT
+    // with row based multi-threading a frame with few tile columns (i.e. anything below
+    // 4K) still uses all the threads.
+    if (mMode == MODE_VP9 && cfg.threads > 1 && !mFrameParallelMode) {
+        vpx_err = vpx_codec_control((vpx_codec_ctx_t *)mCtx, VP9D_SET_ROW_MT, 1);
+        if (vpx_err != VPX_CODEC_OK) {
+            ALOGW("failed to enable row multi-threading (%d)", vpx_err);
+        }
+    }
+#endif
+
     return OK;
 }
 
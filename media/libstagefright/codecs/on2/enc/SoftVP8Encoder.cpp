@@ -84,6 +84,15 @@ vpx_codec_err_t SoftVP8Encoder::setCodecSpecificControls() {
                                                      mDCTPartitions);
     if (codec_return != VPX_CODEC_OK) {
         ALOGE("Error setting dct partitions for vpx encoder.");
+        return codec_return;
+    }
+    if (mBitrateControlMode == VPX_CBR) {
+        // A negative CPU_USED, set for CBR, lets libvpx adapt the speed itself.
+        mCpuUsed = mMinCpuUsed = mMaxCpuUsed = -8;
+    } else {
+        // Keep the default speed, and raise it only if frames are late.
+        mCpuUsed = mMinCpuUsed = 0;
+        mMaxCpuUsed = 12;
     }
     return codec_return;
 }
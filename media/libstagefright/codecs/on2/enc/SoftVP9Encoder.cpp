@@ -53,11 +53,21 @@ void SoftVP9Encoder::setCodecSpecificConfiguration() {
 }
 
 vpx_codec_err_t SoftVP9Encoder::setCodecSpecificControls() {
+    // Unless the client asked for tile columns, use as many as the encoder
+    // threads can work on in parallel. A tile column is at least 256 pixels
+    // wide, and the control takes the log2 of the column count.
+    int32_t tileColumns = mTileColumns;
+    if (tileColumns == 0) {
+        while ((mWidth >> (tileColumns + 1)) >= 256 &&
+                (1u << (tileColumns + 1)) <= mCodecConfiguration->g_threads) {
+            ++tileColumns;
+        }
+    }
     vpx_codec_err_t codecReturn = vpx_codec_control(
-            mCodecContext, VP9E_SET_TILE_COLUMNS, mTileColumns);
+            mCodecContext, VP9E_SET_TILE_COLUMNS, tileColumns);
     if (codecReturn != VPX_CODEC_OK) {
         ALOGE("Error setting VP9E_SET_TILE_COLUMNS to %d. vpx_codec_control() "
-              "returned %d", mTileColumns, codecReturn);
+              "returned %d", tileColumns, codecReturn);
         return codecReturn;
     }
     codecReturn = vpx_codec_control(
@@ -76,12 +86,16 @@ vpx_codec_err_t SoftVP9Encoder::setCodecSpecificControls() {
         return codecReturn;
     }
 
-    // For VP9, we always set CPU_USED to 8 (because the realtime default is 0
-    // which is too slow).
-    codecReturn = vpx_codec_control(mCodecContext, VP8E_SET_CPUUSED, 8);
+    // For VP9, we start with CPU_USED at 8 (because the realtime default is 0
+    // which is too slow), and let the deadline control trade speed back for
+    // quality down to 5 when frames encode well within the frame interval.
+    mCpuUsed = 8;
+    mMinCpuUsed = 5;
+    mMaxCpuUsed = 8;
+    codecReturn = vpx_codec_control(mCodecContext, VP8E_SET_CPUUSED, mCpuUsed);
     if (codecReturn != VPX_CODEC_OK) {
-        ALOGE("Error setting VP8E_SET_CPUUSED to 8. vpx_codec_control() "
-              "returned %d", codecReturn);
+        ALOGE("Error setting VP8E_SET_CPUUSED to %d. vpx_codec_control() "
+              "returned %d", mCpuUsed, codecReturn);
         return codecReturn;
     }
     return codecReturn;
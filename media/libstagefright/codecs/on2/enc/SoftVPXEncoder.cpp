@@ -23,6 +23,7 @@
 
 #include <utils/Log.h>
 #include <utils/misc.h>
+#include <utils/Timers.h>
 
 #include <media/hardware/HardwareAPI.h>
 #include <media/hardware/MetadataBufferType.h>
@@ -57,6 +58,14 @@ static int GetCPUCoreCount() {
     return cpuCoreCount;
 }
 
+// Frames encoded at a given speed before the deadline control reconsiders it.
+static const uint32_t kCpuUsedHoldFrames = 8;
+
+// Average encode time, in percent of the frame interval, above which the
+// encoder speed is raised and below which it is lowered.
+static const int64_t kCpuUsedRaisePercent = 85;
+static const int64_t kCpuUsedLowerPercent = 50;
+
 SoftVPXEncoder::SoftVPXEncoder(const char *name,
                                const OMX_CALLBACKTYPE *callbacks,
                                OMX_PTR appData,
@@ -86,7 +95,16 @@ SoftVPXEncoder::SoftVPXEncoder(const char *name,
       mTemporalPatternIdx(0),
       mLastTimestamp(0x7FFFFFFFFFFFFFFFLL),
       mConversionBuffer(NULL),
-      mKeyFrameRequested(false) {
+      mKeyFrameRequested(false),
+      mCpuUsed(0),
+      mMinCpuUsed(0),
+      mMaxCpuUsed(0),
+      mAvgEncodeTimeUs(0),
+      mFramesSinceCpuUsedChange(0),
+      mEncodedFrames(0),
+      mTotalEncodeTimeUs(0),
+      mMaxEncodeTimeUs(0),
+      mLateFrames(0) {
     memset(mTemporalLayerBitrateRatio, 0, sizeof(mTemporalLayerBitrateRatio));
     mTemporalLayerBitrateRatio[0] = 100;
 
@@ -125,7 +143,7 @@ status_t SoftVPXEncoder::initEncoder() {
 
     mCodecConfiguration->g_w = mWidth;
     mCodecConfiguration->g_h = mHeight;
-    mCodecConfiguration->g_threads = GetCPUCoreCount();
+    mCodecConfiguration->g_threads = getThreadCount();
     mCodecConfiguration->g_error_resilient = mErrorResilience;
 
     // OMX timebase unit is microsecond
@@ -291,6 +309,14 @@ status_t SoftVPXEncoder::initEncoder() {
         // The codec specific method would have logged the error.
         goto CLEAN_UP;
     }
+    ALOGD("VPx: %u threads, cpu-used %d, deadline range [%d, %d]",
+          mCodecConfiguration->g_threads, mCpuUsed, mMinCpuUsed, mMaxCpuUsed);
+    mAvgEncodeTimeUs = 0;
+    mFramesSinceCpuUsedChange = 0;
+    mEncodedFrames = 0;
+    mTotalEncodeTimeUs = 0;
+    mMaxEncodeTimeUs = 0;
+    mLateFrames = 0;
 
     if (mColorFormat != OMX_COLOR_FormatYUV420Planar || mInputDataIsMeta) {
         free(mConversionBuffer);
@@ -312,7 +338,76 @@ CLEAN_UP:
     return result;
 }
 
+uint32_t SoftVPXEncoder::getThreadCount() const {
+    // One thread per 320x240 worth of pixels is enough to hide the
+    // threading overhead at small resolutions.
+    const uint64_t pixelsPerThread = 320 * 240;
+    const uint64_t pixels = (uint64_t)mWidth * mHeight;
+    uint64_t threads = (pixels + pixelsPerThread - 1) / pixelsPerThread;
+    if (threads < 1) {
+        threads = 1;
+    }
+    const uint64_t cores = GetCPUCoreCount();
+    return (uint32_t)(threads < cores ? threads : cores);
+}
+
+void SoftVPXEncoder::updateCpuUsed(int64_t encodeTimeUs, uint32_t frameDurationUs) {
+    ++mEncodedFrames;
+    mTotalEncodeTimeUs += encodeTimeUs;
+    if (encodeTimeUs > mMaxEncodeTimeUs) {
+        mMaxEncodeTimeUs = encodeTimeUs;
+    }
+    if (encodeTimeUs > frameDurationUs) {
+        ++mLateFrames;
+    }
+    ALOGV("encoded frame in %lld us, interval %u us, cpu-used %d",
+          (long long)encodeTimeUs, frameDurationUs, mCpuUsed);
+
+    // exponential moving average with a weight of 1/8 for the new sample
+    mAvgEncodeTimeUs = mEncodedFrames == 1 ?
+            encodeTimeUs : mAvgEncodeTimeUs + (encodeTimeUs - mAvgEncodeTimeUs) / 8;
+
+    if (mMinCpuUsed >= mMaxCpuUsed || frameDurationUs == 0 ||
+            ++mFramesSinceCpuUsedChange < kCpuUsedHoldFrames) {
+        return;
+    }
+    int32_t cpuUsed = mCpuUsed;
+    if (mAvgEncodeTimeUs * 100 > frameDurationUs * kCpuUsedRaisePercent) {
+        if (cpuUsed < mMaxCpuUsed) {
+            ++cpuUsed;
+        }
+    } else if (mAvgEncodeTimeUs * 100 < frameDurationUs * kCpuUsedLowerPercent) {
+        if (cpuUsed > mMinCpuUsed) {
+            --cpuUsed;
+        }
+    }
+    if (cpuUsed == mCpuUsed) {
+        return;
+    }
+    vpx_codec_err_t codecReturn =
+            vpx_codec_control(mCodecContext, VP8E_SET_CPUUSED, cpuUsed);
+    if (codecReturn != VPX_CODEC_OK) {
+        ALOGW("Error setting VP8E_SET_CPUUSED to %d. vpx_codec_control() "
+              "returned %d", cpuUsed, codecReturn);
+        // stop adjusting the speed rather than retrying every frame
+        mMaxCpuUsed = mMinCpuUsed;
+        return;
+    }
+    ALOGV("cpu-used %d -> %d, average encode time %lld us, interval %u us",
+          mCpuUsed, cpuUsed, (long long)mAvgEncodeTimeUs, frameDurationUs);
+    mCpuUsed = cpuUsed;
+    mFramesSinceCpuUsedChange = 0;
+}
+
 status_t SoftVPXEncoder::releaseEncoder() {
+    if (mEncodedFrames > 0) {
+        ALOGD("VPx: encoded %u frames, average %lld us, max %lld us, "
+              "%u over the frame interval, final cpu-used %d",
+              mEncodedFrames, (long long)(mTotalEncodeTimeUs / mEncodedFrames),
+              (long long)mMaxEncodeTimeUs, mLateFrames, mCpuUsed);
+        mEncodedFrames = 0;
+    }
+
     if (mCodecContext != NULL) {
         vpx_codec_destroy(mCodecContext);
         delete mCodecContext;
@@ -716,6 +811,7 @@ void SoftVPXEncoder::onQueueFilled(OMX_U32 /* portIndex */) {
             frameDuration = (uint32_t)(((uint64_t)1000000 << 16) / framerate);
         }
         mLastTimestamp = inputBufferHeader->nTimeStamp;
+        const nsecs_t encodeStartNs = systemTime();
         codec_return = vpx_codec_encode(
                 mCodecContext,
                 &raw_frame,
@@ -731,6 +827,7 @@ void SoftVPXEncoder::onQueueFilled(OMX_U32 /* portIndex */) {
                    NULL);  // Notification data pointer
             return;
         }
+        updateCpuUsed(ns2us(systemTime() - encodeStartNs), frameDuration);
 
         vpx_codec_iter_t encoded_packet_iterator = NULL;
         const vpx_codec_cx_pkt_t* encoded_packet;
@@ -52,8 +52,10 @@ namespace android {
 //
 // Following settings are not configurable by the client
 //    - encoding deadline is realtime
-//    - multithreaded encoding utilizes a number of threads equal
-// to online cpu's available
+//    - multithreaded encoding utilizes one thread per 320x240 pixels,
+// up to the number of online cpu's available
+//    - the encoder speed (cpu-used) is raised when frames take longer
+// than the frame interval to encode, and lowered again when they are fast
 //    - the algorithm interface for encoder is decided by the sub-class in use
 //    - fractional bits of frame rate is discarded
 //    - OMX timestamps are in microseconds, therefore
@@ -110,6 +112,15 @@ protected:
     // Get current encode flags.
     virtual vpx_enc_frame_flags_t getEncodeFlags();
 
+    // Number of encoder threads for the current resolution, bounded by
+    // the number of online cpu's.
+    uint32_t getThreadCount() const;
+
+    // Accounts the time spent encoding the last frame and adjusts
+    // VP8E_SET_CPUUSED within [mMinCpuUsed, mMaxCpuUsed] so that the
+    // average encode time stays within the frame interval.
+    void updateCpuUsed(int64_t encodeTimeUs, uint32_t frameDurationUs);
+
     // Releases vpx encoder instance, with it's associated
     // data structures.
     //
@@ -245,6 +256,23 @@ protected:
 
     bool mKeyFrameRequested;
 
+    // Current encoder speed (VP8E_SET_CPUUSED) and the range the deadline
+    // control may move it in. Set by setCodecSpecificControls(); the control
+    // is disabled when the range is empty.
+    int32_t mCpuUsed;
+    int32_t mMinCpuUsed;
+    int32_t mMaxCpuUsed;
+
+    // Moving average of the per frame encode time, in microseconds.
+    int64_t mAvgEncodeTimeUs;
+    // Frames encoded since the last speed change.
+    uint32_t mFramesSinceCpuUsedChange;
+    // Encode time statistics reported on release.
+    uint32_t mEncodedFrames;
+    int64_t mTotalEncodeTimeUs;
+    int64_t mMaxEncodeTimeUs;
+    uint32_t mLateFrames;
+
     DISALLOW_EVIL_CONSTRUCTORS(SoftVPXEncoder);
 };
 
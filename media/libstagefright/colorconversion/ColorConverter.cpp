@@ -25,8 +25,11 @@
 
 #include "libyuv/convert_from.h"
 #include "libyuv/video_common.h"
+#include <utils/Thread.h>
+#include <algorithm>
 #include <functional>
 #include <sys/time.h>
+#include <unistd.h>
 
 #define USE_LIBYUV
 #define PERF_PROFILING 0
@@ -44,18 +47,143 @@
 
 namespace android {
 
+// Frames with fewer source rows than this per thread are not worth splitting.
+static const size_t kMinBandRows = 64;
+
+// Runs a batch of jobs on a few worker threads and on the calling thread.
+struct ColorConverter::BandPool {
+    explicit BandPool(size_t numThreads);
+    ~BandPool();
+
+    // runs job(0) .. job(numJobs - 1), returns the first error of any of them
+    status_t run(size_t numJobs, const std::function<status_t (size_t)> &job);
+
+private:
+    struct Worker : public Thread {
+        explicit Worker(BandPool *pool)
+            : Thread(false /* canCallJava */), mPool(pool) {}
+    private:
+        BandPool *mPool;
+        virtual bool threadLoop() { return mPool->runJob(true /* wait */); }
+    };
+
+    Mutex mLock;
+    Condition mJobsAvailable;
+    Condition mJobsDone;
+    std::vector<sp<Worker> > mWorkers;
+    bool mStopping;
+
+    // the batch being run, valid while mNextJob < mNumJobs
+    const std::function<status_t (size_t)> *mJob;
+    size_t mNumJobs;
+    size_t mNextJob;
+    size_t mNumJobsDone;
+    status_t mResult;
+
+    // runs one job, returns false when the pool is stopping
+    bool runJob(bool wait);
+
+    BandPool(const BandPool &);
+    BandPool &operator=(const BandPool &);
+};
+
+ColorConverter::BandPool::BandPool(size_t numThreads)
+    : mStopping(false),
+      mJob(NULL),
+      mNumJobs(0),
+      mNextJob(0),
+      mNumJobsDone(0),
+      mResult(OK) {
+    for (size_t i = 0; i < numThreads; ++i) {
+        sp<Worker> worker = new Worker(this);
+        if (worker->run("ColorConvert") != OK) {
+            break;
+        }
+        mWorkers.push_back(worker);
+    }
+}
+
+ColorConverter::BandPool::~BandPool() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mStopping = true;
+        mJobsAvailable.broadcast();
+    }
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->requestExitAndWait();
+    }
+}
+
+status_t ColorConverter::BandPool::run(
+        size_t numJobs, const std::function<status_t (size_t)> &job) {
+    Mutex::Autolock autoLock(mLock);
+
+    mJob = &job;
+    mNumJobs = numJobs;
+    mNextJob = 0;
+    mNumJobsDone = 0;
+    mResult = OK;
+    mJobsAvailable.broadcast();
+
+    // help out, then wait for the jobs the workers took
+    while (mNextJob < mNumJobs) {
+        mLock.unlock();
+        runJob(false /* wait */);
+        mLock.lock();
+    }
+    while (mNumJobsDone < mNumJobs) {
+        mJobsDone.wait(mLock);
+    }
+    mJob = NULL;
+    return mResult;
+}
+
+bool ColorConverter::BandPool::runJob(bool wait) {
+    Mutex::Autolock autoLock(mLock);
+    while (wait && !mStopping && mNextJob >= mNumJobs) {
+        mJobsAvailable.wait(mLock);
+    }
+    if (mStopping || mNextJob >= mNumJobs) {
+        return !mStopping;
+    }
+    size_t index = mNextJob++;
+    const std::function<status_t (size_t)> &job = *mJob;
+
+    mLock.unlock();
+    status_t err = job(index);
+    mLock.lock();
+
+    if (err != OK && mResult == OK) {
+        mResult = err;
+    }
+    if (++mNumJobsDone == mNumJobs) {
+        mJobsDone.signal();
+    }
+    return true;
+}
+
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
       mDstFormat(to),
-      mClip(NULL) {
+      mClip(NULL),
+      mMaxThreads(1) {
 }
 
 ColorConverter::~ColorConverter() {
+    // stop the workers before the lookup table they may use goes away
+    mBandPool.reset();
     delete[] mClip;
     mClip = NULL;
 }
 
+void ColorConverter::setMaxThreads(size_t maxThreads) {
+    long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+    mMaxThreads = std::max((size_t)1,
+            std::min(maxThreads, numCores > 0 ? (size_t)numCores : 1));
+    mBandPool.reset();
+}
+
 bool ColorConverter::isValid() const {
     switch (mSrcFormat) {
         case OMX_COLOR_FormatYUV420Planar16:
@@ -167,6 +295,91 @@ status_t ColorConverter::convert(
         return ERROR_UNSUPPORTED;
     }
 
+    return convertInBands(src, dst, 1 /* factor */);
+}
+
+bool ColorConverter::isDownscaleValid() const {
+    return mSrcFormat == OMX_COLOR_FormatYUV420Planar && isDstRGB();
+}
+
+status_t ColorConverter::convertDownscaled(
+        const void *srcBits,
+        size_t srcWidth, size_t srcHeight,
+        size_t srcCropLeft, size_t srcCropTop,
+        size_t srcCropRight, size_t srcCropBottom,
+        void *dstBits,
+        size_t dstWidth, size_t dstHeight,
+        size_t dstCropLeft, size_t dstCropTop,
+        size_t dstCropRight, size_t dstCropBottom,
+        size_t factor) {
+    if (factor <= 1) {
+        return convert(srcBits, srcWidth, srcHeight,
+                srcCropLeft, srcCropTop, srcCropRight, srcCropBottom,
+                dstBits, dstWidth, dstHeight,
+                dstCropLeft, dstCropTop, dstCropRight, dstCropBottom);
+    }
+
+    if (!isDownscaleValid()) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    BitmapParams src(
+            const_cast<void *>(srcBits),
+            srcWidth, srcHeight,
+            srcCropLeft, srcCropTop, srcCropRight, srcCropBottom, mSrcFormat);
+
+    BitmapParams dst(
+            dstBits,
+            dstWidth, dstHeight,
+            dstCropLeft, dstCropTop, dstCropRight, dstCropBottom, mDstFormat);
+
+    if (!((src.mCropLeft & 1) == 0 && (src.mCropTop & 1) == 0
+        && dst.cropWidth() * factor <= src.cropWidth()
+        && dst.cropHeight() * factor <= src.cropHeight())) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    return convertInBands(src, dst, factor);
+}
+
+status_t ColorConverter::convertInBands(
+        const BitmapParams &src, const BitmapParams &dst, size_t factor) {
+    size_t numBands = std::min(mMaxThreads,
+            std::max(dst.cropHeight() * factor / kMinBandRows, (size_t)1));
+    if (numBands <= 1) {
+        return convertBand(src, dst, factor);
+    }
+
+    // the workers share the lookup table, so it must exist before they start
+    initClip();
+    if (!mBandPool) {
+        mBandPool.reset(new BandPool(mMaxThreads - 1));
+    }
+
+    // bands start on even source rows so that they never split a chroma row,
+    // and on a multiple of the factor so that they never split a block
+    size_t dstBandRows = ((dst.cropHeight() + numBands - 1) / numBands + 1) & ~1;
+    numBands = (dst.cropHeight() + dstBandRows - 1) / dstBandRows;
+
+    return mBandPool->run(numBands, [&](size_t i) {
+        BitmapParams srcBand = src;
+        BitmapParams dstBand = dst;
+        dstBand.mCropTop = dst.mCropTop + i * dstBandRows;
+        srcBand.mCropTop = src.mCropTop + i * dstBandRows * factor;
+        if (i + 1 < numBands) {
+            dstBand.mCropBottom = dstBand.mCropTop + dstBandRows - 1;
+            srcBand.mCropBottom = srcBand.mCropTop + dstBandRows * factor - 1;
+        }
+        return convertBand(srcBand, dstBand, factor);
+    });
+}
+
+status_t ColorConverter::convertBand(
+        const BitmapParams &src, const BitmapParams &dst, size_t factor) {
+    if (factor > 1) {
+        return convertYUV420PlanarDownscaled(src, dst, factor);
+    }
+
     status_t err;
 
     switch (mSrcFormat) {
@@ -227,7 +440,7 @@ status_t ColorConverter::convertCbYCrY(
         + dst.mCropTop * dst.mWidth + dst.mCropLeft;
 
     const uint8_t *src_ptr = (const uint8_t *)src.mBits
-        + (src.mCropTop * dst.mWidth + src.mCropLeft) * 2;
+        + (src.mCropTop * src.mWidth + src.mCropLeft) * 2;
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
         for (size_t x = 0; x < src.cropWidth(); x += 2) {
@@ -313,109 +526,116 @@ status_t ColorConverter::convertYUV420PlanarUseLibYUV(
     return OK;
 }
 
-std::function<void (void *, void *, void *, size_t,
-                    signed *, signed *, signed *, signed *)>
-getReadFromSrc(OMX_COLOR_FORMATTYPE srcFormat) {
-    switch(srcFormat) {
-    case OMX_COLOR_FormatYUV420Planar:
-        return [](void *src_y, void *src_u, void *src_v, size_t x,
-                  signed *y1, signed *y2, signed *u, signed *v) {
-            *y1 = ((uint8_t*)src_y)[x] - 16;
-            *y2 = ((uint8_t*)src_y)[x + 1] - 16;
-            *u = ((uint8_t*)src_u)[x / 2] - 128;
-            *v = ((uint8_t*)src_v)[x / 2] - 128;
-        };
-    case OMX_COLOR_FormatYUV420Planar16:
-        return [](void *src_y, void *src_u, void *src_v, size_t x,
-                signed *y1, signed *y2, signed *u, signed *v) {
-            *y1 = (signed)(((uint16_t*)src_y)[x] >> 2) - 16;
-            *y2 = (signed)(((uint16_t*)src_y)[x + 1] >> 2) - 16;
-            *u = (signed)(((uint16_t*)src_u)[x / 2] >> 2) - 128;
-            *v = (signed)(((uint16_t*)src_v)[x / 2] >> 2) - 128;
-        };
-    default:
-        TRESPASS();
+// Sample readers and pixel writers for the YUV420Planar paths. They are plain
+// types rather than callbacks so that each pair of formats gets its own inner
+// loop, which the compiler can inline and vectorize.
+namespace {
+
+template <typename T, int kShift>
+struct ReadFromYUV420Planar {
+    static inline void read(const void *src_y, const void *src_u, const void *src_v,
+            size_t x, signed *y1, signed *y2, signed *u, signed *v) {
+        *y1 = (signed)(((const T *)src_y)[x] >> kShift) - 16;
+        *y2 = (signed)(((const T *)src_y)[x + 1] >> kShift) - 16;
+        *u = (signed)(((const T *)src_u)[x / 2] >> kShift) - 128;
+        *v = (signed)(((const T *)src_v)[x / 2] >> kShift) - 128;
     }
-    return nullptr;
-}
+};
 
-std::function<void (void *, bool, signed, signed, signed, signed, signed, signed)>
-getWriteToDst(OMX_COLOR_FORMATTYPE dstFormat, uint8_t *kAdjustedClip) {
-    switch (dstFormat) {
-    case OMX_COLOR_Format16bitRGB565:
-    {
-        return [kAdjustedClip](void *dst_ptr, bool uncropped,
-                               signed r1, signed g1, signed b1,
-                               signed r2, signed g2, signed b2) {
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
+typedef ReadFromYUV420Planar<uint8_t, 0> ReadFromYUV420Planar8;
+typedef ReadFromYUV420Planar<uint16_t, 2> ReadFromYUV420Planar16;
 
-            if (uncropped) {
-                uint32_t rgb2 =
-                    ((kAdjustedClip[r2] >> 3) << 11)
-                    | ((kAdjustedClip[g2] >> 2) << 5)
-                    | (kAdjustedClip[b2] >> 3);
+struct WriteToRGB565 {
+    static inline void write(const uint8_t *kAdjustedClip, void *dst_ptr, bool uncropped,
+            signed r1, signed g1, signed b1, signed r2, signed g2, signed b2) {
+        uint32_t rgb1 =
+            ((kAdjustedClip[r1] >> 3) << 11)
+            | ((kAdjustedClip[g1] >> 2) << 5)
+            | (kAdjustedClip[b1] >> 3);
 
-                *(uint32_t *)dst_ptr = (rgb2 << 16) | rgb1;
-            } else {
-                *(uint16_t *)dst_ptr = rgb1;
-            }
-        };
+        if (uncropped) {
+            uint32_t rgb2 =
+                ((kAdjustedClip[r2] >> 3) << 11)
+                | ((kAdjustedClip[g2] >> 2) << 5)
+                | (kAdjustedClip[b2] >> 3);
+
+            *(uint32_t *)dst_ptr = (rgb2 << 16) | rgb1;
+        } else {
+            *(uint16_t *)dst_ptr = rgb1;
+        }
     }
-    case OMX_COLOR_Format32BitRGBA8888:
-    {
-        return [kAdjustedClip](void *dst_ptr, bool uncropped,
-                               signed r1, signed g1, signed b1,
-                               signed r2, signed g2, signed b2) {
-            ((uint32_t *)dst_ptr)[0] =
-                    (kAdjustedClip[r1])
-                    | (kAdjustedClip[g1] << 8)
-                    | (kAdjustedClip[b1] << 16)
+};
+
+struct WriteToRGBA8888 {
+    static inline void write(const uint8_t *kAdjustedClip, void *dst_ptr, bool uncropped,
+            signed r1, signed g1, signed b1, signed r2, signed g2, signed b2) {
+        ((uint32_t *)dst_ptr)[0] =
+                (kAdjustedClip[r1])
+                | (kAdjustedClip[g1] << 8)
+                | (kAdjustedClip[b1] << 16)
+                | (0xFF << 24);
+
+        if (uncropped) {
+            ((uint32_t *)dst_ptr)[1] =
+                    (kAdjustedClip[r2])
+                    | (kAdjustedClip[g2] << 8)
+                    | (kAdjustedClip[b2] << 16)
                     | (0xFF << 24);
-
-            if (uncropped) {
-                ((uint32_t *)dst_ptr)[1] =
-                        (kAdjustedClip[r2])
-                        | (kAdjustedClip[g2] << 8)
-                        | (kAdjustedClip[b2] << 16)
-                        | (0xFF << 24);
-            }
-        };
+        }
     }
-    case OMX_COLOR_Format32bitBGRA8888:
-    {
-        return [kAdjustedClip](void *dst_ptr, bool uncropped,
-                               signed r1, signed g1, signed b1,
-                               signed r2, signed g2, signed b2) {
-            ((uint32_t *)dst_ptr)[0] =
-                    (kAdjustedClip[b1])
-                    | (kAdjustedClip[g1] << 8)
-                    | (kAdjustedClip[r1] << 16)
+};
+
+struct WriteToBGRA8888 {
+    static inline void write(const uint8_t *kAdjustedClip, void *dst_ptr, bool uncropped,
+            signed r1, signed g1, signed b1, signed r2, signed g2, signed b2) {
+        ((uint32_t *)dst_ptr)[0] =
+                (kAdjustedClip[b1])
+                | (kAdjustedClip[g1] << 8)
+                | (kAdjustedClip[r1] << 16)
+                | (0xFF << 24);
+
+        if (uncropped) {
+            ((uint32_t *)dst_ptr)[1] =
+                    (kAdjustedClip[b2])
+                    | (kAdjustedClip[g2] << 8)
+                    | (kAdjustedClip[r2] << 16)
                     | (0xFF << 24);
-
-            if (uncropped) {
-                ((uint32_t *)dst_ptr)[1] =
-                        (kAdjustedClip[b2])
-                        | (kAdjustedClip[g2] << 8)
-                        | (kAdjustedClip[r2] << 16)
-                        | (0xFF << 24);
-            }
-        };
+        }
     }
+};
+
+}  // namespace
+
+status_t ColorConverter::convertYUV420Planar(
+        const BitmapParams &src, const BitmapParams &dst) {
+    bool is16 = (mSrcFormat == OMX_COLOR_FormatYUV420Planar16);
+
+    switch (mDstFormat) {
+    case OMX_COLOR_Format16bitRGB565:
+        return is16
+                ? convertYUV420PlanarRows<ReadFromYUV420Planar16, WriteToRGB565>(src, dst)
+                : convertYUV420PlanarRows<ReadFromYUV420Planar8, WriteToRGB565>(src, dst);
+
+    case OMX_COLOR_Format32BitRGBA8888:
+        return is16
+                ? convertYUV420PlanarRows<ReadFromYUV420Planar16, WriteToRGBA8888>(src, dst)
+                : convertYUV420PlanarRows<ReadFromYUV420Planar8, WriteToRGBA8888>(src, dst);
+
+    case OMX_COLOR_Format32bitBGRA8888:
+        return is16
+                ? convertYUV420PlanarRows<ReadFromYUV420Planar16, WriteToBGRA8888>(src, dst)
+                : convertYUV420PlanarRows<ReadFromYUV420Planar8, WriteToBGRA8888>(src, dst);
+
     default:
         TRESPASS();
     }
-    return nullptr;
+    return ERROR_UNSUPPORTED;
 }
 
-status_t ColorConverter::convertYUV420Planar(
+template <typename Reader, typename Writer>
+status_t ColorConverter::convertYUV420PlanarRows(
         const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
-
-    auto readFromSrc = getReadFromSrc(mSrcFormat);
-    auto writeToDst = getWriteToDst(mDstFormat, kAdjustedClip);
+    const uint8_t *kAdjustedClip = initClip();
 
     uint8_t *dst_ptr = (uint8_t *)dst.mBits
             + dst.mCropTop * dst.mStride + dst.mCropLeft * dst.mBpp;
@@ -449,7 +669,7 @@ status_t ColorConverter::convertYUV420Planar(
             // clip range -278 .. 535
 
             signed y1, y2, u, v;
-            readFromSrc(src_y, src_u, src_v, x, &y1, &y2, &u, &v);
+            Reader::read(src_y, src_u, src_v, x, &y1, &y2, &u, &v);
 
             signed u_b = u * 517;
             signed u_g = -u * 100;
@@ -467,7 +687,8 @@ status_t ColorConverter::convertYUV420Planar(
             signed r2 = (tmp2 + v_r) / 256;
 
             bool uncropped = x + 1 < src.cropWidth();
-            writeToDst(dst_ptr + x * dst.mBpp, uncropped, r1, g1, b1, r2, g2, b2);
+            Writer::write(kAdjustedClip, dst_ptr + x * dst.mBpp, uncropped,
+                    r1, g1, b1, r2, g2, b2);
         }
 
         src_y += src.mStride;
@@ -483,6 +704,86 @@ status_t ColorConverter::convertYUV420Planar(
     return OK;
 }
 
+status_t ColorConverter::convertYUV420PlanarDownscaled(
+        const BitmapParams &src, const BitmapParams &dst, size_t factor) {
+    switch (mDstFormat) {
+    case OMX_COLOR_Format16bitRGB565:
+        return convertYUV420PlanarDownscaledRows<WriteToRGB565>(src, dst, factor);
+
+    case OMX_COLOR_Format32BitRGBA8888:
+        return convertYUV420PlanarDownscaledRows<WriteToRGBA8888>(src, dst, factor);
+
+    case OMX_COLOR_Format32bitBGRA8888:
+        return convertYUV420PlanarDownscaledRows<WriteToBGRA8888>(src, dst, factor);
+
+    default:
+        TRESPASS();
+    }
+    return ERROR_UNSUPPORTED;
+}
+
+template <typename Writer>
+status_t ColorConverter::convertYUV420PlanarDownscaledRows(
+        const BitmapParams &src, const BitmapParams &dst, size_t factor) {
+    const uint8_t *kAdjustedClip = initClip();
+
+    const uint8_t *src_y = (const uint8_t *)src.mBits;
+    const uint8_t *src_u = src_y + src.mStride * src.mHeight;
+    const uint8_t *src_v = src_u + (src.mStride / 2) * (src.mHeight / 2);
+
+    // every 2x2 luma block shares one chroma sample
+    size_t chromaFactor = factor / 2;
+    unsigned lumaCount = factor * factor;
+    unsigned chromaCount = chromaFactor * chromaFactor;
+    if (chromaFactor == 0) {
+        chromaFactor = chromaCount = 1;
+    }
+
+    uint8_t *dst_ptr = (uint8_t *)dst.mBits
+            + dst.mCropTop * dst.mStride + dst.mCropLeft * dst.mBpp;
+
+    for (size_t y = 0; y < dst.cropHeight(); ++y) {
+        size_t sy = src.mCropTop + y * factor;
+        for (size_t x = 0; x < dst.cropWidth(); ++x) {
+            size_t sx = src.mCropLeft + x * factor;
+
+            unsigned sumY = 0;
+            for (size_t j = 0; j < factor; ++j) {
+                const uint8_t *row = src_y + (sy + j) * src.mStride + sx;
+                for (size_t i = 0; i < factor; ++i) {
+                    sumY += row[i];
+                }
+            }
+
+            unsigned sumU = 0, sumV = 0;
+            for (size_t j = 0; j < chromaFactor; ++j) {
+                size_t offset = (sy / 2 + j) * (src.mStride / 2) + sx / 2;
+                for (size_t i = 0; i < chromaFactor; ++i) {
+                    sumU += src_u[offset + i];
+                    sumV += src_v[offset + i];
+                }
+            }
+
+            // same coefficients as convertYUV420Planar()
+            signed y1 = (signed)((sumY + lumaCount / 2) / lumaCount) - 16;
+            signed u = (signed)((sumU + chromaCount / 2) / chromaCount) - 128;
+            signed v = (signed)((sumV + chromaCount / 2) / chromaCount) - 128;
+
+            signed tmp = y1 * 298;
+            signed b = (tmp + u * 517) / 256;
+            signed g = (tmp - v * 208 - u * 100) / 256;
+            signed r = (tmp + v * 409) / 256;
+
+            Writer::write(kAdjustedClip, dst_ptr + x * dst.mBpp, false /* uncropped */,
+                    r, g, b, 0, 0, 0);
+        }
+
+        dst_ptr += dst.mStride;
+    }
+
+    return OK;
+}
+
 status_t ColorConverter::convertYUV420Planar16(
         const BitmapParams &src, const BitmapParams &dst) {
     if (mDstFormat == OMX_COLOR_FormatYUV444Y410) {
@@ -730,9 +1031,11 @@ status_t ColorConverter::convertQCOMYUV420SemiPlanar(
     const uint8_t *src_y =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
 
+    // chroma rows are interleaved pairs of samples, one row for every two rows
+    // of luma
     const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * src.mWidth + src.mCropLeft;
+        (const uint8_t *)src.mBits + src.mWidth * src.mHeight
+        + (src.mCropTop / 2) * src.mWidth + src.mCropLeft;
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
         for (size_t x = 0; x < src.cropWidth(); x += 2) {
@@ -798,9 +1101,11 @@ status_t ColorConverter::convertYUV420SemiPlanar(
     const uint8_t *src_y =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
 
+    // chroma rows are interleaved pairs of samples, one row for every two rows
+    // of luma
     const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * src.mWidth + src.mCropLeft;
+        (const uint8_t *)src.mBits + src.mWidth * src.mHeight
+        + (src.mCropTop / 2) * src.mWidth + src.mCropLeft;
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
         for (size_t x = 0; x < src.cropWidth(); x += 2) {
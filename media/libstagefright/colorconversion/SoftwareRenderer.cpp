@@ -29,8 +29,13 @@
 #include <ui/GraphicBuffer.h>
 #include <ui/Rect.h>
 
+#include "libyuv/convert.h"
+
 namespace android {
 
+// The decoder runs alongside the renderer, so leave it most of the cores.
+static const size_t kMaxConvertThreads = 2;
+
 static int ALIGN(int x, int y) {
     // y must be a power of 2.
     return (x + y - 1) & ~(y - 1);
@@ -118,11 +123,28 @@ void SoftwareRenderer::resetFormatIfChanged(
     int halFormat = HAL_PIXEL_FORMAT_RGB_565;
     size_t bufWidth = mCropWidth;
     size_t bufHeight = mCropHeight;
+    mYUVMode = None;
 
     // hardware has YUV12 and RGBA8888 support, so convert known formats
     {
         switch (mColorFormat) {
             case OMX_COLOR_FormatYUV420Planar:
+            {
+                // YV12 pads the chroma stride to 16, so a luma stride that is
+                // a multiple of 32 gives the same planes as the decoder output
+                // (apart from the order of U and V), and the window crop
+                // selects the picture.
+                halFormat = HAL_PIXEL_FORMAT_YV12;
+                if ((mWidth % 32) == 0 && (mHeight % 2) == 0) {
+                    mYUVMode = WholePlanes;
+                    bufWidth = mWidth;
+                    bufHeight = mHeight;
+                } else {
+                    bufWidth = (mCropWidth + 1) & ~1;
+                    bufHeight = (mCropHeight + 1) & ~1;
+                }
+                break;
+            }
             case OMX_COLOR_FormatYUV420SemiPlanar:
             case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
             {
@@ -183,6 +205,9 @@ void SoftwareRenderer::resetFormatIfChanged(
     CHECK(mCropWidth > 0);
     CHECK(mCropHeight > 0);
     CHECK(mConverter == NULL || mConverter->isValid());
+    if (mConverter != NULL) {
+        mConverter->setMaxThreads(kMaxConvertThreads);
+    }
 
     CHECK_EQ(0,
             native_window_set_usage(
@@ -264,7 +289,7 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
 
     GraphicBufferMapper &mapper = GraphicBufferMapper::get();
 
-    Rect bounds(mCropWidth, mCropHeight);
+    Rect bounds(buf->width, buf->height);
 
     void *dst;
     CHECK_EQ(0, mapper.lock(buf->handle,
@@ -273,7 +298,20 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
 
     // TODO move the other conversions also into ColorConverter, and
     // fix cropping issues (when mCropLeft/Top != 0 or mWidth != mCropWidth)
-    if (mConverter) {
+    if (mYUVMode == WholePlanes
+            && buf->stride == mWidth && buf->height == mHeight) {
+        // gralloc did not pad the buffer, so the planes line up
+        size_t lumaSize = mWidth * mHeight;
+        size_t chromaSize = lumaSize / 4;
+        const uint8_t *src_u = (const uint8_t *)data + lumaSize;
+        const uint8_t *src_v = src_u + chromaSize;
+        uint8_t *dst_v = (uint8_t *)dst + lumaSize;
+        uint8_t *dst_u = dst_v + chromaSize;
+
+        memcpy(dst, data, lumaSize);
+        memcpy(dst_v, src_v, chromaSize);
+        memcpy(dst_u, src_u, chromaSize);
+    } else if (mConverter) {
         mConverter->convert(
                 data,
                 mWidth, mHeight,
@@ -365,7 +403,7 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
                 + mWidth * mHeight;
 
         src_y += mCropLeft + mCropTop * mWidth;
-        src_uv += (mCropLeft + mCropTop * mWidth) / 2;
+        src_uv += (mCropLeft & ~1) + (mCropTop / 2) * mWidth;
 
         uint8_t *dst_y = (uint8_t *)dst;
 
@@ -379,24 +417,11 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
         dst_v += (mCropTop/2) * dst_c_stride + mCropLeft/2;
         dst_u += (mCropTop/2) * dst_c_stride + mCropLeft/2;
 
-        for (int y = 0; y < mCropHeight; ++y) {
-            memcpy(dst_y, src_y, mCropWidth);
-
-            src_y += mWidth;
-            dst_y += buf->stride;
-        }
-
-        for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
-            size_t tmp = (mCropWidth + 1) / 2;
-            for (size_t x = 0; x < tmp; ++x) {
-                dst_u[x] = src_uv[2 * x];
-                dst_v[x] = src_uv[2 * x + 1];
-            }
-
-            src_uv += mWidth;
-            dst_u += dst_c_stride;
-            dst_v += dst_c_stride;
-        }
+        // splits the interleaved chroma with SIMD where available
+        libyuv::NV12ToI420(
+                src_y, mWidth, src_uv, mWidth,
+                dst_y, buf->stride, dst_u, dst_c_stride, dst_v, dst_c_stride,
+                mCropWidth, mCropHeight);
     } else if (mColorFormat == OMX_COLOR_Format24bitRGB888) {
         uint8_t* srcPtr = (uint8_t*)data + mWidth * mCropTop * 3 + mCropLeft * 3;
         uint8_t* dstPtr = (uint8_t*)dst + buf->stride * mCropTop * 3 + mCropLeft * 3;
@@ -25,7 +25,12 @@ AAtomizer AAtomizer::gAtomizer;
 
 // static
 const char *AAtomizer::Atomize(const char *name) {
-    return gAtomizer.atomize(name);
+    return gAtomizer.atomize(name, Hash(name));
+}
+
+// static
+const char *AAtomizer::Atomize(const char *name, uint32_t hash) {
+    return gAtomizer.atomize(name, hash);
 }
 
 AAtomizer::AAtomizer() {
@@ -34,11 +39,11 @@ AAtomizer::AAtomizer() {
     }
 }
 
-const char *AAtomizer::atomize(const char *name) {
+const char *AAtomizer::atomize(const char *name, uint32_t hash) {
     Mutex::Autolock autoLock(mLock);
 
     const size_t n = mAtoms.size();
-    size_t index = AAtomizer::Hash(name) % n;
+    size_t index = hash % n;
     List<AString> &entry = mAtoms.editItemAt(index);
     List<AString>::iterator it = entry.begin();
     while (it != entry.end()) {
@@ -16,6 +16,9 @@
 
 #include "ABitReader.h"
 
+#include <endian.h>
+#include <string.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 
 namespace android {
@@ -33,25 +36,37 @@ ABitReader::~ABitReader() {
 
 bool ABitReader::fillReservoir() {
     if (mSize == 0) {
-        mOverRead = true;
         return false;
     }
 
-    mReservoir = 0;
-    size_t i;
-    for (i = 0; mSize > 0 && i < 4; ++i) {
-        mReservoir = (mReservoir << 8) | *mData;
-
-        ++mData;
-        --mSize;
+    size_t numBytes = (64 - mNumBitsLeft) / 8;
+    if (numBytes > mSize) {
+        numBytes = mSize;
+    }
+    size_t numBits = numBytes * 8;
+
+    if (mSize >= sizeof(uint64_t)) {
+        // one unaligned big-endian load for the whole refill
+        uint64_t word;
+        memcpy(&word, mData, sizeof(word));
+        word = be64toh(word);
+        if (numBits < 64) {
+            word >>= 64 - numBits;
+        }
+        mReservoir |= word << (64 - mNumBitsLeft - numBits);
+    } else {
+        for (size_t i = 0; i < numBytes; ++i) {
+            mReservoir |= (uint64_t)mData[i] << (56 - mNumBitsLeft - 8 * i);
+        }
     }
 
-    mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
+    mData += numBytes;
+    mSize -= numBytes;
+    mNumBitsLeft += numBits;
     return true;
 }
 
-uint32_t ABitReader::getBits(size_t n) {
+uint32_t ABitReader::getBitsSlow(size_t n) {
     uint32_t ret;
     CHECK(getBitsGraceful(n, &ret));
     return ret;
@@ -63,36 +78,36 @@ uint32_t ABitReader::getBitsWithFallback(size_t n, uint32_t fallback) {
     return ret;
 }
 
-bool ABitReader::getBitsGraceful(size_t n, uint32_t *out) {
-    if (n > 32) {
+bool ABitReader::getBitsGracefulSlow(size_t n, uint32_t *out) {
+    if (!peekBitsGracefulSlow(n, out)) {
+        if (n <= 32) {
+            mOverRead = true;
+        }
         return false;
     }
+    consumeBits(n);
+    return true;
+}
 
-    uint32_t result = 0;
-    while (n > 0) {
-        if (mNumBitsLeft == 0) {
-            if (!fillReservoir()) {
-                return false;
-            }
-        }
-
-        size_t m = n;
-        if (m > mNumBitsLeft) {
-            m = mNumBitsLeft;
-        }
-
-        result = (result << m) | (mReservoir >> (32 - m));
-        mReservoir <<= m;
-        mNumBitsLeft -= m;
+bool ABitReader::peekBitsGracefulSlow(size_t n, uint32_t *out) {
+    if (n > 32) {
+        return false;
+    }
+    if (n == 0) {
+        *out = 0;
+        return true;
+    }
 
-        n -= m;
+    // a refill leaves at least 57 bits in the reservoir unless the data runs out
+    if (n > mNumBitsLeft && (!fillReservoir() || n > mNumBitsLeft)) {
+        return false;
     }
 
-    *out = result;
+    *out = (uint32_t)(mReservoir >> (64 - n));
     return true;
 }
 
-bool ABitReader::skipBits(size_t n) {
+bool ABitReader::skipBitsSlow(size_t n) {
     uint32_t dummy;
     while (n > 32) {
         if (!getBitsGraceful(32, &dummy)) {
@@ -107,20 +122,74 @@ bool ABitReader::skipBits(size_t n) {
     return true;
 }
 
+bool ABitReader::getUEGraceful(uint32_t *out) {
+    if (mNumBitsLeft < 32) {
+        (void)fillReservoir();
+    }
+
+    // fast path: the whole code word is in the reservoir
+    if (mReservoir != 0) {
+        size_t numZeroes = __builtin_clzll(mReservoir);
+        size_t length = 2 * numZeroes + 1;
+        if (length <= mNumBitsLeft) {
+            // code word is 0..0 1 x..x, its value is (1 x..x) - 1
+            uint64_t code = mReservoir >> (64 - length);
+            consumeBits(length);
+            *out = (uint32_t)(code - 1);
+            return true;
+        }
+    }
+
+    // slow path: the code word straddles the end of the reservoir or is too long
+    size_t numZeroes = 0;
+    uint32_t bit;
+    while (true) {
+        if (!getBitsGraceful(1, &bit)) {
+            return false;
+        }
+        if (bit != 0) {
+            break;
+        }
+        ++numZeroes;
+    }
+
+    uint32_t x;
+    if (numZeroes >= 32) {
+        skipBits(numZeroes);
+        return false;
+    }
+    if (!getBitsGraceful(numZeroes, &x)) {
+        return false;
+    }
+    *out = x + (1u << numZeroes) - 1;
+    return true;
+}
+
+bool ABitReader::getSEGraceful(int32_t *out) {
+    uint32_t codeNum;
+    if (!getUEGraceful(&codeNum)) {
+        return false;
+    }
+    *out = (codeNum & 1) ? (int32_t)((codeNum >> 1) + 1) : -(int32_t)(codeNum >> 1);
+    return true;
+}
+
 void ABitReader::putBits(uint32_t x, size_t n) {
-    if (mOverRead) {
+    if (mOverRead || n == 0) {
         return;
     }
 
     CHECK_LE(n, 32u);
 
-    while (mNumBitsLeft + n > 32) {
+    while (mNumBitsLeft + n > 64) {
         mNumBitsLeft -= 8;
         --mData;
         ++mSize;
     }
+    // keep the unused bits zero so that refills can be or'ed in
+    mReservoir = mNumBitsLeft == 0 ? 0 : mReservoir & (~0ull << (64 - mNumBitsLeft));
 
-    mReservoir = (mReservoir >> n) | (x << (32 - n));
+    mReservoir = (mReservoir >> n) | ((uint64_t)x << (64 - n));
     mNumBitsLeft += n;
 }
 
@@ -171,13 +240,10 @@ bool NALBitReader::atLeastNumBitsLeft(size_t n) const {
 
 bool NALBitReader::fillReservoir() {
     if (mSize == 0) {
-        mOverRead = true;
         return false;
     }
 
-    mReservoir = 0;
-    size_t i = 0;
-    while (mSize > 0 && i < 4) {
+    while (mSize > 0 && mNumBitsLeft <= 56) {
         bool isEmulationPreventionByte = (mNumZeros >= 2 && *mData == 3);
 
         if (*mData == 0) {
@@ -188,16 +254,14 @@ bool NALBitReader::fillReservoir() {
 
         // skip emulation_prevention_three_byte
         if (!isEmulationPreventionByte) {
-            mReservoir = (mReservoir << 8) | *mData;
-            ++i;
+            mReservoir |= (uint64_t)*mData << (56 - mNumBitsLeft);
+            mNumBitsLeft += 8;
         }
 
         ++mData;
         --mSize;
     }
 
-    mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
     return true;
 }
 
@@ -0,0 +1,346 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AEpollReactor"
+#include <utils/Log.h>
+
+#include "AEpollReactor.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace android {
+
+static const int kMaxEventsPerWait = 32;
+
+static Mutex gSharedLock;
+static sp<AEpollReactor> *gSharedReactor = NULL;
+
+struct AEpollReactor::ReactorThread : public Thread {
+    explicit ReactorThread(AEpollReactor *reactor)
+        : mReactor(reactor) {
+    }
+
+private:
+    AEpollReactor *mReactor;
+
+    virtual bool threadLoop() {
+        mReactor->threadLoop();
+        return true;
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(ReactorThread);
+};
+
+AEpollReactor::AEpollReactor()
+    : mEpollFd(-1),
+      mWakeFd(-1),
+      mNextToken(kWakeToken + 1) {
+}
+
+AEpollReactor::~AEpollReactor() {
+    stop();
+}
+
+// static
+sp<AEpollReactor> AEpollReactor::GetShared() {
+    Mutex::Autolock autoLock(gSharedLock);
+
+    if (gSharedReactor == NULL) {
+        sp<AEpollReactor> reactor = new AEpollReactor;
+        status_t err = reactor->start("AEpollReactor", ANDROID_PRIORITY_AUDIO);
+        if (err != OK) {
+            ALOGE("failed to start the shared reactor (%d)", err);
+            return NULL;
+        }
+        // Never destroyed, clients may outlive static destructors.
+        gSharedReactor = new sp<AEpollReactor>(reactor);
+    }
+
+    return *gSharedReactor;
+}
+
+status_t AEpollReactor::start(const char *name, int32_t priority) {
+    if (mThread != NULL) {
+        return INVALID_OPERATION;
+    }
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0) {
+        return -errno;
+    }
+
+    mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mWakeFd < 0) {
+        status_t err = -errno;
+        close(mEpollFd);
+        mEpollFd = -1;
+        return err;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = kWakeToken;
+    CHECK_EQ(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event), 0);
+
+    mThread = new ReactorThread(this);
+
+    status_t err = mThread->run(name, priority);
+
+    if (err != OK) {
+        mThread.clear();
+
+        close(mWakeFd);
+        mWakeFd = -1;
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
+
+    return err;
+}
+
+status_t AEpollReactor::stop() {
+    if (mThread == NULL) {
+        return INVALID_OPERATION;
+    }
+
+    mThread->requestExit();
+    wake();
+    mThread->requestExitAndWait();
+
+    mThread.clear();
+
+    Mutex::Autolock autoLock(mLock);
+
+    mRegistrations.clear();
+    mTokensByFd.clear();
+
+    close(mWakeFd);
+    mWakeFd = -1;
+    close(mEpollFd);
+    mEpollFd = -1;
+
+    return OK;
+}
+
+status_t AEpollReactor::addFd(
+        int fd, uint32_t events, const sp<Callback> &callback,
+        int32_t *token) {
+    CHECK(callback != NULL);
+    return addRegistration(fd, events, false /* oneShot */, callback, NULL, token);
+}
+
+status_t AEpollReactor::addFd(
+        int fd, uint32_t events, const sp<AMessage> &notify,
+        int32_t *token) {
+    CHECK(notify != NULL);
+    return addRegistration(fd, events, true /* oneShot */, NULL, notify, token);
+}
+
+status_t AEpollReactor::addRegistration(
+        int fd, uint32_t events, bool oneShot,
+        const sp<Callback> &callback, const sp<AMessage> &notify,
+        int32_t *token) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mEpollFd < 0) {
+        return NO_INIT;
+    }
+
+    Registration reg;
+    reg.mFd = fd;
+    reg.mEpollEvents = EPOLLET;
+    if (events & kEventReadable) {
+        reg.mEpollEvents |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (events & kEventWritable) {
+        reg.mEpollEvents |= EPOLLOUT;
+    }
+    if (oneShot) {
+        reg.mEpollEvents |= EPOLLONESHOT;
+    }
+    reg.mCallback = callback;
+    reg.mNotify = notify;
+
+    int32_t newToken = mNextToken++;
+    if (mNextToken < 0) {
+        mNextToken = kWakeToken + 1;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = reg.mEpollEvents;
+    event.data.u64 = newToken;
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        status_t err = -errno;
+        ALOGE("failed to add fd %d (%s)", fd, strerror(errno));
+        return err;
+    }
+
+    ssize_t index = mTokensByFd.indexOfKey(fd);
+    if (index >= 0) {
+        // The previous owner closed it without removing it first.
+        ALOGV("fd %d reused, token %d => %d",
+                fd, mTokensByFd.valueAt(index), newToken);
+        mTokensByFd.replaceValueAt(index, newToken);
+    } else {
+        mTokensByFd.add(fd, newToken);
+    }
+    mRegistrations.add(newToken, reg);
+
+    *token = newToken;
+    return OK;
+}
+
+status_t AEpollReactor::rearm(int32_t token) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mRegistrations.indexOfKey(token);
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    const Registration &reg = mRegistrations.valueAt(index);
+    ssize_t fdIndex = mTokensByFd.indexOfKey(reg.mFd);
+    if (fdIndex < 0 || mTokensByFd.valueAt(fdIndex) != token) {
+        // closed and taken over by another registration.
+        return -EBADF;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = reg.mEpollEvents;
+    event.data.u64 = token;
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_MOD, reg.mFd, &event) < 0) {
+        return -errno;
+    }
+
+    return OK;
+}
+
+void AEpollReactor::removeFd(int32_t token) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mRegistrations.indexOfKey(token);
+    if (index < 0) {
+        return;
+    }
+
+    int fd = mRegistrations.valueAt(index).mFd;
+    mRegistrations.removeItemsAt(index);
+
+    ssize_t fdIndex = mTokensByFd.indexOfKey(fd);
+    if (fdIndex >= 0 && mTokensByFd.valueAt(fdIndex) == token) {
+        mTokensByFd.removeItemsAt(fdIndex);
+
+        // Fails harmlessly if the descriptor was already closed.
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL);
+    }
+}
+
+void AEpollReactor::wake() {
+    uint64_t one = 1;
+
+    ssize_t n;
+    do {
+        n = write(mWakeFd, &one, sizeof(one));
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        ALOGW("Error writing to eventfd (%s)", strerror(errno));
+    }
+}
+
+void AEpollReactor::threadLoop() {
+    struct epoll_event events[kMaxEventsPerWait];
+
+    int n = epoll_wait(mEpollFd, events, kMaxEventsPerWait, -1 /* timeout */);
+
+    if (n < 0) {
+        if (errno != EINTR) {
+            ALOGE("epoll_wait failed w/ error %d (%s)", errno, strerror(errno));
+        }
+        return;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        int32_t token = (int32_t)events[i].data.u64;
+
+        if (token == kWakeToken) {
+            uint64_t count;
+            ssize_t res;
+            do {
+                res = read(mWakeFd, &count, sizeof(count));
+            } while (res < 0 && errno == EINTR);
+
+            if (res < 0 && errno != EAGAIN) {
+                ALOGW("Error reading from eventfd (%s)", strerror(errno));
+            }
+            continue;
+        }
+
+        uint32_t mask = 0;
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+            mask |= kEventReadable;
+        }
+        if (events[i].events & EPOLLOUT) {
+            mask |= kEventWritable;
+        }
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            mask |= kEventError;
+        }
+
+        int fd;
+        sp<Callback> callback;
+        sp<AMessage> notify;
+        {
+            Mutex::Autolock autoLock(mLock);
+
+            ssize_t index = mRegistrations.indexOfKey(token);
+            if (index < 0) {
+                // removed since epoll_wait() returned.
+                continue;
+            }
+
+            const Registration &reg = mRegistrations.valueAt(index);
+            fd = reg.mFd;
+            callback = reg.mCallback;
+            notify = reg.mNotify;
+        }
+
+        if (callback != NULL) {
+            callback->onFdEvents(token, fd, mask);
+        } else {
+            sp<AMessage> msg = notify->dup();
+            msg->setInt32("token", token);
+            msg->setInt32("fd", fd);
+            msg->setInt32("events", mask);
+            msg->post();
+        }
+    }
+}
+
+}  // namespace android
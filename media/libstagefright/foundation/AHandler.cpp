@@ -18,24 +18,75 @@
 #define LOG_TAG "AHandler"
 #include <utils/Log.h>
 
+#include <string.h>
+
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/AMessage.h>
 
 namespace android {
 
-void AHandler::deliverMessage(const sp<AMessage> &msg) {
-    onMessageReceived(msg);
-    mMessageCounter++;
+// upper bounds of all but the last (open-ended) bucket
+// static
+const int64_t AHandler::LatencyHistogram::kBucketLimitsUs[kNumBuckets - 1] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+};
+
+void AHandler::LatencyHistogram::add(int64_t us) {
+    size_t i = 0;
+    while (i < kNumBuckets - 1 && us >= kBucketLimitsUs[i]) {
+        ++i;
+    }
+    ++mBuckets[i];
+    ++mCount;
+    mTotalUs += us;
+    if (us > mMaxUs) {
+        mMaxUs = us;
+    }
+}
+
+void AHandler::LatencyHistogram::clear() {
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mTotalUs = 0;
+    mMaxUs = 0;
+}
 
-    if (mVerboseStats) {
-        uint32_t what = msg->what();
-        ssize_t idx = mMessages.indexOfKey(what);
-        if (idx < 0) {
-            mMessages.add(what, 1);
+AString AHandler::LatencyHistogram::toString() const {
+    AString s = AStringPrintf("avg %lld us, max %lld us [",
+            (long long)(mCount == 0 ? 0 : mTotalUs / mCount), (long long)mMaxUs);
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+        if (i < kNumBuckets - 1) {
+            s.append(AStringPrintf(" <%lld:%u", (long long)kBucketLimitsUs[i], mBuckets[i]));
         } else {
-            mMessages.editValueAt(idx)++;
+            s.append(AStringPrintf(" >=%lld:%u", (long long)kBucketLimitsUs[i - 1], mBuckets[i]));
         }
     }
+    s.append(" ]");
+    return s;
+}
+
+void AHandler::deliverMessage(const sp<AMessage> &msg, int64_t queueDelayUs) {
+    if (!mVerboseStats) {
+        onMessageReceived(msg);
+        mMessageCounter++;
+        return;
+    }
+
+    // |msg| may be modified by the handler, so sample what() up front
+    uint32_t what = msg->what();
+    int64_t startUs = ALooper::GetNowUs();
+    onMessageReceived(msg);
+    int64_t executionUs = ALooper::GetNowUs() - startUs;
+    mMessageCounter++;
+
+    ssize_t idx = mMessages.indexOfKey(what);
+    if (idx < 0) {
+        idx = mMessages.add(what, DispatchStats());
+    }
+    DispatchStats &stats = mMessages.editValueAt(idx);
+    ++stats.mCount;
+    stats.mQueueDelay.add(queueDelayUs);
+    stats.mExecution.add(executionUs);
 }
 
 }  // namespace android
@@ -23,9 +23,12 @@
 
 #include <sys/time.h>
 
+#include <algorithm>
+
 #include "ALooper.h"
 
 #include "AHandler.h"
+#include "ALooperPool.h"
 #include "ALooperRoster.h"
 #include "AMessage.h"
 
@@ -70,7 +73,13 @@ int64_t ALooper::GetNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mNextSeqNo(0),
+      mRunningLocally(false),
+      mRunningOnPool(false),
+      mPoolBusy(false),
+      mPoolThreadId(NULL),
+      mPoolGeneration(0),
+      mPoolScheduledUs(-1) {
     // clean up stale AHandlers. Doing it here instead of in the destructor avoids
     // the side effect of objects being deleted from the unregister function recursively.
     gLooperRoster.unregisterStaleHandlers();
@@ -99,7 +108,7 @@ status_t ALooper::start(
         {
             Mutex::Autolock autoLock(mLock);
 
-            if (mThread != NULL || mRunningLocally) {
+            if (mThread != NULL || mRunningLocally || mRunningOnPool) {
                 return INVALID_OPERATION;
             }
 
@@ -114,7 +123,7 @@ status_t ALooper::start(
 
     Mutex::Autolock autoLock(mLock);
 
-    if (mThread != NULL || mRunningLocally) {
+    if (mThread != NULL || mRunningLocally || mRunningOnPool) {
         return INVALID_OPERATION;
     }
 
@@ -129,19 +138,53 @@ status_t ALooper::start(
     return err;
 }
 
+status_t ALooper::startOnSharedPool() {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mThread != NULL || mRunningLocally || mRunningOnPool) {
+        return INVALID_OPERATION;
+    }
+
+    mRunningOnPool = true;
+    if (!mEventQueue.empty()) {
+        schedulePoolLocked();
+    }
+
+    return OK;
+}
+
 status_t ALooper::stop() {
     sp<LooperThread> thread;
     bool runningLocally;
+    bool runningOnPool;
 
     {
         Mutex::Autolock autoLock(mLock);
 
+        runningOnPool = mRunningOnPool;
+        if (mRunningOnPool) {
+            mRunningOnPool = false;
+            ++mPoolGeneration;
+            mPoolScheduledUs = -1;
+            // like requestExitAndWait(), wait for a message in flight unless
+            // it is the one calling stop()
+            while (mPoolBusy && mPoolThreadId != androidGetThreadId()) {
+                mPoolIdleCondition.wait(mLock);
+            }
+        }
+
         thread = mThread;
         runningLocally = mRunningLocally;
         mThread.clear();
         mRunningLocally = false;
     }
 
+    if (runningOnPool) {
+        Mutex::Autolock autoLock(mRepliesLock);
+        mRepliesCondition.broadcast();
+        return OK;
+    }
+
     if (thread == NULL && !runningLocally) {
         return INVALID_OPERATION;
     }
@@ -175,24 +218,76 @@ void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
         whenUs = GetNowUs();
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
-    }
-
     Event event;
     event.mWhenUs = whenUs;
+    event.mSeqNo = mNextSeqNo++;
     event.mMessage = msg;
 
-    if (it == mEventQueue.begin()) {
-        mQueueChangedCondition.signal();
+    mEventQueue.push_back(event);
+    std::push_heap(mEventQueue.begin(), mEventQueue.end(), EventLater());
+
+    // only wake up the looper if the new event is now the earliest one
+    if (mEventQueue.front().mSeqNo == event.mSeqNo) {
+        if (mRunningOnPool) {
+            if (!mPoolBusy && (mPoolScheduledUs < 0 || whenUs < mPoolScheduledUs)) {
+                schedulePoolLocked();
+            }
+        } else {
+            mQueueChangedCondition.signal();
+        }
+    }
+}
+
+void ALooper::schedulePoolLocked() {
+    mPoolScheduledUs = mEventQueue.front().mWhenUs;
+    ALooperPool::Default()->schedule(this, mPoolScheduledUs, ++mPoolGeneration);
+}
+
+void ALooper::runOnPool(uint32_t generation) {
+    Event event;
+    int64_t queueDelayUs;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (!mRunningOnPool || mPoolBusy || generation != mPoolGeneration) {
+            return;
+        }
+        mPoolScheduledUs = -1;
+        if (mEventQueue.empty()) {
+            return;
+        }
+        int64_t whenUs = mEventQueue.front().mWhenUs;
+        int64_t nowUs = GetNowUs();
+        if (whenUs > nowUs) {
+            schedulePoolLocked();
+            return;
+        }
+
+        std::pop_heap(mEventQueue.begin(), mEventQueue.end(), EventLater());
+        event = mEventQueue.back();
+        mEventQueue.pop_back();
+        queueDelayUs = nowUs - whenUs;
+
+        mPoolBusy = true;
+        mPoolThreadId = androidGetThreadId();
     }
 
-    mEventQueue.insert(it, event);
+    // the pool worker holds a strong reference, so unlike in loop() this
+    // looper stays alive while delivering
+    event.mMessage->deliver(queueDelayUs);
+
+    Mutex::Autolock autoLock(mLock);
+    mPoolBusy = false;
+    mPoolThreadId = NULL;
+    mPoolIdleCondition.broadcast();
+    if (mRunningOnPool && !mEventQueue.empty()) {
+        schedulePoolLocked();
+    }
 }
 
 bool ALooper::loop() {
     Event event;
+    int64_t queueDelayUs;
 
     {
         Mutex::Autolock autoLock(mLock);
@@ -203,7 +298,7 @@ bool ALooper::loop() {
             mQueueChangedCondition.wait(mLock);
             return true;
         }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
+        int64_t whenUs = mEventQueue.front().mWhenUs;
         int64_t nowUs = GetNowUs();
 
         if (whenUs > nowUs) {
@@ -213,11 +308,13 @@ bool ALooper::loop() {
             return true;
         }
 
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
+        std::pop_heap(mEventQueue.begin(), mEventQueue.end(), EventLater());
+        event = mEventQueue.back();
+        mEventQueue.pop_back();
+        queueDelayUs = nowUs - whenUs;
     }
 
-    event.mMessage->deliver();
+    event.mMessage->deliver(queueDelayUs);
 
     // NOTE: It's important to note that at this point our "ALooper" object
     // may no longer exist (its final reference may have gone away while
@@ -240,7 +337,7 @@ status_t ALooper::awaitResponse(const sp<AReplyToken> &replyToken, sp<AMessage>
     while (!replyToken->retrieveReply(response)) {
         {
             Mutex::Autolock autoLock(mLock);
-            if (mThread == NULL) {
+            if (mThread == NULL && !mRunningOnPool) {
                 return -ENOENT;
             }
         }
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ALooperPool"
+#include <utils/Log.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "ALooperPool.h"
+
+#include "ADebug.h"
+#include "AString.h"
+
+namespace android {
+
+// Workers may block in postAndAwaitResponse() on behalf of a pooled handler,
+// so keep at least a couple of them even on single core devices.
+static const size_t kMinPoolThreads = 2;
+
+struct ALooperPool::WorkerThread : public Thread {
+    explicit WorkerThread(ALooperPool *pool)
+        : Thread(false /* canCallJava */),
+          mPool(pool) {
+    }
+
+    virtual bool threadLoop() {
+        return mPool->workerLoop();
+    }
+
+protected:
+    virtual ~WorkerThread() {}
+
+private:
+    ALooperPool *mPool;
+
+    DISALLOW_EVIL_CONSTRUCTORS(WorkerThread);
+};
+
+// never destroyed; loopers may be released from static destructors
+static Mutex gDefaultPoolLock;
+static ALooperPool *gDefaultPool = NULL;
+
+// static
+ALooperPool *ALooperPool::Default() {
+    Mutex::Autolock autoLock(gDefaultPoolLock);
+    if (gDefaultPool == NULL) {
+        long numCores = sysconf(_SC_NPROCESSORS_CONF);
+        gDefaultPool = new ALooperPool(numCores > 0 ? (size_t)numCores : 1);
+    }
+    return gDefaultPool;
+}
+
+// static
+void ALooperPool::DumpDefault(String8 *s) {
+    ALooperPool *pool;
+    {
+        Mutex::Autolock autoLock(gDefaultPoolLock);
+        pool = gDefaultPool;
+    }
+    if (pool != NULL) {
+        pool->dump(s);
+    }
+}
+
+ALooperPool::ALooperPool(size_t numThreads)
+    : mNextSeqNo(0),
+      mNumDispatched(0) {
+    numThreads = std::max(numThreads, kMinPoolThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        sp<WorkerThread> thread = new WorkerThread(this);
+        status_t err = thread->run(AStringPrintf("ALooperPool-%zu", i).c_str());
+        if (err != OK) {
+            ALOGE("failed to start pool worker %zu (%d)", i, err);
+            break;
+        }
+        mThreads.push_back(thread);
+    }
+    CHECK(!mThreads.isEmpty());
+}
+
+void ALooperPool::schedule(const wp<ALooper> &looper, int64_t whenUs, uint32_t generation) {
+    Mutex::Autolock autoLock(mLock);
+
+    Entry entry;
+    entry.mWhenUs = whenUs;
+    entry.mSeqNo = mNextSeqNo++;
+    entry.mLooper = looper;
+    entry.mGeneration = generation;
+
+    mQueue.push_back(entry);
+    std::push_heap(mQueue.begin(), mQueue.end(), EntryLater());
+
+    if (mQueue.front().mSeqNo == entry.mSeqNo) {
+        mQueueChangedCondition.signal();
+    }
+}
+
+bool ALooperPool::workerLoop() {
+    Entry entry;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mQueue.empty()) {
+            mQueueChangedCondition.wait(mLock);
+            return true;
+        }
+        int64_t whenUs = mQueue.front().mWhenUs;
+        int64_t nowUs = ALooper::GetNowUs();
+
+        if (whenUs > nowUs) {
+            int64_t delayUs = whenUs - nowUs;
+            mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+            return true;
+        }
+
+        std::pop_heap(mQueue.begin(), mQueue.end(), EntryLater());
+        entry = mQueue.back();
+        mQueue.pop_back();
+        ++mNumDispatched;
+
+        // hand off any other due work to the next idle worker
+        if (!mQueue.empty()) {
+            mQueueChangedCondition.signal();
+        }
+    }
+
+    sp<ALooper> looper = entry.mLooper.promote();
+    if (looper != NULL) {
+        looper->runOnPool(entry.mGeneration);
+    }
+
+    return true;
+}
+
+void ALooperPool::dump(String8 *s) {
+    Mutex::Autolock autoLock(mLock);
+    s->appendFormat(" shared looper pool: %zu threads, %zu scheduled, %llu dispatched\n",
+            mThreads.size(), mQueue.size(), (unsigned long long)mNumDispatched);
+}
+
+}  // namespace android
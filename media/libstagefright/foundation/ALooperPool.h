@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_LOOPER_POOL_H_
+
+#define A_LOOPER_POOL_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+#include <utils/threads.h>
+
+#include <vector>
+
+namespace android {
+
+// Process-wide set of worker threads that loopers started with
+// ALooper::startOnSharedPool() run on. Each looper schedules itself with the
+// time of its earliest event; a worker then delivers exactly one message of
+// that looper and lets the looper reschedule itself. A looper is never run by
+// two workers at once, so per-looper (and thus per-handler) ordering is kept.
+struct ALooperPool {
+    static ALooperPool *Default();
+
+    // dumps the default pool, if it has been created
+    static void DumpDefault(String8 *s);
+
+    void dump(String8 *s);
+
+private:
+    friend struct ALooper;  // schedule()
+
+    struct Entry {
+        int64_t mWhenUs;
+        uint64_t mSeqNo;
+        wp<ALooper> mLooper;
+        uint32_t mGeneration;
+    };
+
+    struct EntryLater {
+        bool operator()(const Entry &a, const Entry &b) const {
+            return a.mWhenUs > b.mWhenUs
+                    || (a.mWhenUs == b.mWhenUs && a.mSeqNo > b.mSeqNo);
+        }
+    };
+
+    struct WorkerThread;
+
+    Mutex mLock;
+    Condition mQueueChangedCondition;
+    std::vector<Entry> mQueue;  // min-heap on (mWhenUs, mSeqNo)
+    uint64_t mNextSeqNo;
+    uint64_t mNumDispatched;
+    Vector<sp<WorkerThread> > mThreads;
+
+    explicit ALooperPool(size_t numThreads);
+
+    // Schedules |looper| to be run at |whenUs|. The looper ignores runs whose
+    // |generation| is no longer current.
+    void schedule(const wp<ALooper> &looper, int64_t whenUs, uint32_t generation);
+
+    bool workerLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(ALooperPool);
+};
+
+}  // namespace android
+
+#endif  // A_LOOPER_POOL_H_
@@ -23,6 +23,7 @@
 
 #include "ADebug.h"
 #include "AHandler.h"
+#include "ALooperPool.h"
 #include "AMessage.h"
 
 namespace android {
@@ -129,6 +130,21 @@ void ALooperRoster::dump(int fd, const Vector<String16>& args) {
         s.append("(verbose stats collection enabled, stats will be cleared)\n");
     }
 
+    AMessage::PoolStats msgStats, tokenStats;
+    AMessage::GetPoolStats(&msgStats, &tokenStats);
+    s.appendFormat(" message pool: %llu hits, %llu misses, %llu recycled, %llu released,"
+            " %zu free\n",
+            (unsigned long long)msgStats.mHits, (unsigned long long)msgStats.mMisses,
+            (unsigned long long)msgStats.mRecycled, (unsigned long long)msgStats.mReleased,
+            msgStats.mFreeCount);
+    s.appendFormat(" reply token pool: %llu hits, %llu misses, %llu recycled, %llu released,"
+            " %zu free\n",
+            (unsigned long long)tokenStats.mHits, (unsigned long long)tokenStats.mMisses,
+            (unsigned long long)tokenStats.mRecycled, (unsigned long long)tokenStats.mReleased,
+            tokenStats.mFreeCount);
+
+    ALooperPool::DumpDefault(&s);
+
     Mutex::Autolock autoLock(mLock);
     size_t n = mHandlers.size();
     s.appendFormat(" %zu registered handlers:\n", n);
@@ -147,9 +163,12 @@ void ALooperRoster::dump(int fd, const Vector<String16>& args) {
                     for (size_t j = 0; j < handler->mMessages.size(); j++) {
                         char fourcc[15];
                         makeFourCC(handler->mMessages.keyAt(j), fourcc, sizeof(fourcc));
-                        s.appendFormat("\n    %s: %u",
-                                fourcc,
-                                handler->mMessages.valueAt(j));
+                        const AHandler::DispatchStats &stats = handler->mMessages.valueAt(j);
+                        s.appendFormat("\n    %s: %u", fourcc, stats.mCount);
+                        s.appendFormat("\n      queue delay: %s",
+                                stats.mQueueDelay.toString().c_str());
+                        s.appendFormat("\n      execution:   %s",
+                                stats.mExecution.toString().c_str());
                     }
                 } else {
                     handler->mMessages.clear();
@@ -24,6 +24,7 @@
 
 #include <binder/Parcel.h>
 #include <log/log.h>
+#include <utils/Mutex.h>
 
 #include "AAtomizer.h"
 #include "ABuffer.h"
@@ -38,6 +39,123 @@ namespace android {
 
 extern ALooperRoster gLooperRoster;
 
+namespace {
+
+// Bounded free list of fixed-size blocks. Objects of any other size (e.g.
+// subclasses) bypass the pool.
+struct FreeListPool {
+    FreeListPool(size_t blockSize, size_t capacity)
+        : mBlockSize(blockSize),
+          mCapacity(capacity),
+          mHead(NULL) {
+        memset(&mStats, 0, sizeof(mStats));
+    }
+
+    void *alloc(size_t size) {
+        if (size == mBlockSize) {
+            Mutex::Autolock autoLock(mLock);
+            if (mHead != NULL) {
+                Node *node = mHead;
+                mHead = node->mNext;
+                --mStats.mFreeCount;
+                ++mStats.mHits;
+                return node;
+            }
+            ++mStats.mMisses;
+        }
+        return ::operator new(size);
+    }
+
+    void release(void *ptr, size_t size) {
+        if (ptr == NULL) {
+            return;
+        }
+        if (size == mBlockSize) {
+            Mutex::Autolock autoLock(mLock);
+            if (mStats.mFreeCount < mCapacity) {
+                Node *node = static_cast<Node *>(ptr);
+                node->mNext = mHead;
+                mHead = node;
+                ++mStats.mFreeCount;
+                ++mStats.mRecycled;
+                return;
+            }
+            ++mStats.mReleased;
+        }
+        ::operator delete(ptr);
+    }
+
+    void getStats(AMessage::PoolStats *stats) {
+        Mutex::Autolock autoLock(mLock);
+        *stats = mStats;
+    }
+
+private:
+    struct Node {
+        Node *mNext;
+    };
+
+    const size_t mBlockSize;
+    const size_t mCapacity;
+
+    Mutex mLock;
+    Node *mHead;
+    AMessage::PoolStats mStats;
+
+    DISALLOW_EVIL_CONSTRUCTORS(FreeListPool);
+};
+
+enum {
+    kMaxPooledMessages = 256,
+    kMaxPooledReplyTokens = 64,
+};
+
+// The pools are intentionally leaked so that messages released by static
+// destructors during process exit still find a valid pool.
+FreeListPool &MessagePool() {
+    static FreeListPool *sPool =
+        new FreeListPool(sizeof(AMessage), kMaxPooledMessages);
+    return *sPool;
+}
+
+FreeListPool &ReplyTokenPool() {
+    static FreeListPool *sPool =
+        new FreeListPool(sizeof(AReplyToken), kMaxPooledReplyTokens);
+    return *sPool;
+}
+
+}  // namespace
+
+// static
+void *AReplyToken::operator new(size_t size) {
+    return ReplyTokenPool().alloc(size);
+}
+
+// static
+void AReplyToken::operator delete(void *ptr, size_t size) {
+    ReplyTokenPool().release(ptr, size);
+}
+
+// static
+void *AMessage::operator new(size_t size) {
+    return MessagePool().alloc(size);
+}
+
+// static
+void AMessage::operator delete(void *ptr, size_t size) {
+    MessagePool().release(ptr, size);
+}
+
+// static
+void AMessage::GetPoolStats(PoolStats *messageStats, PoolStats *replyTokenStats) {
+    if (messageStats != NULL) {
+        MessagePool().getStats(messageStats);
+    }
+    if (replyTokenStats != NULL) {
+        ReplyTokenPool().getStats(replyTokenStats);
+    }
+}
+
 status_t AReplyToken::setReply(const sp<AMessage> &reply) {
     if (mReplied) {
         ALOGE("trying to post a duplicate reply");
@@ -88,8 +206,7 @@ void AMessage::setTarget(const sp<const AHandler> &handler) {
 void AMessage::clear() {
     for (size_t i = 0; i < mNumItems; ++i) {
         Item *item = &mItems[i];
-        delete[] item->mName;
-        item->mName = NULL;
+        item->clearName();
         freeItemValue(item);
     }
     mNumItems = 0;
@@ -128,6 +245,7 @@ static int32_t gDupCalls = 1;
 static int32_t gAverageNumItems = 0;
 static int32_t gAverageNumChecks = 0;
 static int32_t gAverageNumMemChecks = 0;
+static int32_t gAverageNumAtomHits = 0;
 static int32_t gAverageDupItems = 0;
 static int32_t gLastChecked = -1;
 
@@ -135,33 +253,58 @@ static void reportStats() {
     int32_t time = (ALooper::GetNowUs() / 1000);
     if (time / 1000 != gLastChecked / 1000) {
         gLastChecked = time;
-        ALOGI("called findItemIx %zu times (for len=%.1f i=%.1f/%.1f mem) dup %zu times (for len=%.1f)",
+        ALOGI("called findItemIx %d times (for len=%.1f i=%.1f/%.1f mem/%.1f atom) "
+              "dup %d times (for len=%.1f)",
                 gFindItemCalls,
                 gAverageNumItems / (float)gFindItemCalls,
                 gAverageNumChecks / (float)gFindItemCalls,
                 gAverageNumMemChecks / (float)gFindItemCalls,
+                gAverageNumAtomHits / (float)gFindItemCalls,
                 gDupCalls,
                 gAverageDupItems / (float)gDupCalls);
         gFindItemCalls = gDupCalls = 1;
         gAverageNumItems = gAverageNumChecks = gAverageNumMemChecks = gAverageDupItems = 0;
+        gAverageNumAtomHits = 0;
         gLastChecked = time;
     }
 }
 #endif
 
-inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
+// static
+inline size_t AMessage::HashName(const char *name, uint32_t *hash) {
+    // must match AAtomizer::Hash()
+    uint32_t sum = 0;
+    const char *s = name;
+    while (*s != '\0') {
+        sum = (sum * 31) + *s;
+        ++s;
+    }
+    *hash = sum;
+    return s - name;
+}
+
+inline size_t AMessage::findItemIndex(const char *name, size_t len, uint32_t hash) const {
 #ifdef DUMP_STATS
     size_t memchecks = 0;
+    size_t atomhits = 0;
 #endif
     size_t i = 0;
     for (; i < mNumItems; i++) {
-        if (len != mItems[i].mNameLength) {
+        const Item &item = mItems[i];
+        if (hash != item.mNameHash || len != item.mNameLength) {
             continue;
         }
+        // callers commonly pass the same literal or atom the item was set with
+        if (item.mName == name) {
+#ifdef DUMP_STATS
+            ++atomhits;
+#endif
+            break;
+        }
 #ifdef DUMP_STATS
         ++memchecks;
 #endif
-        if (!memcmp(mItems[i].mName, name, len)) {
+        if (!memcmp(item.mName, name, len)) {
             break;
         }
     }
@@ -171,6 +314,7 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
         ++gFindItemCalls;
         gAverageNumItems += mNumItems;
         gAverageNumMemChecks += memchecks;
+        gAverageNumAtomHits += atomhits;
         gAverageNumChecks += i;
         reportStats();
     }
@@ -179,15 +323,48 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
 }
 
 // assumes item's name was uninitialized or NULL
-void AMessage::Item::setName(const char *name, size_t len) {
+void AMessage::Item::setName(const char *name, size_t len, uint32_t hash) {
+    mNameLength = len;
+    mNameHash = hash;
+    mNameOwned = false;
+    mName = AAtomizer::Atomize(name, hash);
+}
+
+// assumes item's name was uninitialized or NULL
+void AMessage::Item::setNameCopy(const char *name, size_t len, uint32_t hash) {
     mNameLength = len;
-    mName = new char[len + 1];
-    memcpy((void*)mName, name, len + 1);
+    mNameHash = hash;
+    mNameOwned = true;
+    char *copy = new char[len + 1];
+    memcpy(copy, name, len + 1);
+    mName = copy;
+}
+
+// assumes item's name was uninitialized or NULL
+void AMessage::Item::copyNameFrom(const Item &other) {
+    if (other.mNameOwned) {
+        setNameCopy(other.mName, other.mNameLength, other.mNameHash);
+    } else {
+        // atoms live forever and can be shared
+        mName = other.mName;
+        mNameLength = other.mNameLength;
+        mNameHash = other.mNameHash;
+        mNameOwned = false;
+    }
+}
+
+void AMessage::Item::clearName() {
+    if (mNameOwned) {
+        delete[] mName;
+    }
+    mName = NULL;
+    mNameOwned = false;
 }
 
 AMessage::Item *AMessage::allocateItem(const char *name) {
-    size_t len = strlen(name);
-    size_t i = findItemIndex(name, len);
+    uint32_t hash;
+    size_t len = HashName(name, &hash);
+    size_t i = findItemIndex(name, len, hash);
     Item *item;
 
     if (i < mNumItems) {
@@ -198,7 +375,7 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         i = mNumItems++;
         item = &mItems[i];
         item->mType = kTypeInt32;
-        item->setName(name, len);
+        item->setName(name, len, hash);
     }
 
     return item;
@@ -206,7 +383,9 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
 
 const AMessage::Item *AMessage::findItem(
         const char *name, Type type) const {
-    size_t i = findItemIndex(name, strlen(name));
+    uint32_t hash;
+    size_t len = HashName(name, &hash);
+    size_t i = findItemIndex(name, len, hash);
     if (i < mNumItems) {
         const Item *item = &mItems[i];
         return item->mType == type ? item : NULL;
@@ -216,7 +395,9 @@ const AMessage::Item *AMessage::findItem(
 }
 
 bool AMessage::findAsFloat(const char *name, float *value) const {
-    size_t i = findItemIndex(name, strlen(name));
+    uint32_t hash;
+    size_t len = HashName(name, &hash);
+    size_t i = findItemIndex(name, len, hash);
     if (i < mNumItems) {
         const Item *item = &mItems[i];
         switch (item->mType) {
@@ -243,7 +424,9 @@ bool AMessage::findAsFloat(const char *name, float *value) const {
 }
 
 bool AMessage::findAsInt64(const char *name, int64_t *value) const {
-    size_t i = findItemIndex(name, strlen(name));
+    uint32_t hash;
+    size_t len = HashName(name, &hash);
+    size_t i = findItemIndex(name, len, hash);
     if (i < mNumItems) {
         const Item *item = &mItems[i];
         switch (item->mType) {
@@ -261,7 +444,9 @@ bool AMessage::findAsInt64(const char *name, int64_t *value) const {
 }
 
 bool AMessage::contains(const char *name) const {
-    size_t i = findItemIndex(name, strlen(name));
+    uint32_t hash;
+    size_t len = HashName(name, &hash);
+    size_t i = findItemIndex(name, len, hash);
     return i < mNumItems;
 }
 
@@ -393,14 +578,14 @@ bool AMessage::findRect(
     return true;
 }
 
-void AMessage::deliver() {
+void AMessage::deliver(int64_t queueDelayUs) {
     sp<AHandler> handler = mHandler.promote();
     if (handler == NULL) {
         ALOGW("failed to deliver message as target handler %d is gone.", mTarget);
         return;
     }
 
-    handler->deliverMessage(this);
+    handler->deliverMessage(this, queueDelayUs);
 }
 
 status_t AMessage::post(int64_t delayUs) {
@@ -478,7 +663,7 @@ sp<AMessage> AMessage::dup() const {
         const Item *from = &mItems[i];
         Item *to = &msg->mItems[i];
 
-        to->setName(from->mName, from->mNameLength);
+        to->copyNameFrom(*from);
         to->mType = from->mType;
 
         switch (from->mType) {
@@ -742,7 +927,10 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
             }
         }
 
-        item->setName(name, strlen(name));
+        // names from a parcel are not interned to keep the atom table bounded
+        uint32_t hash;
+        size_t len = HashName(name, &hash);
+        item->setNameCopy(name, len, hash);
     }
 
     return msg;
@@ -990,13 +1178,13 @@ status_t AMessage::setEntryNameAt(size_t index, const char *name) {
     if (!strcmp(name, mItems[index].mName)) {
         return OK; // name has not changed
     }
-    size_t len = strlen(name);
-    if (findItemIndex(name, len) < mNumItems) {
+    uint32_t hash;
+    size_t len = HashName(name, &hash);
+    if (findItemIndex(name, len, hash) < mNumItems) {
         return ALREADY_EXISTS;
     }
-    delete[] mItems[index].mName;
-    mItems[index].mName = nullptr;
-    mItems[index].setName(name, len);
+    mItems[index].clearName();
+    mItems[index].setName(name, len, hash);
     return OK;
 }
 
@@ -1060,14 +1248,14 @@ status_t AMessage::removeEntryAt(size_t index) {
     }
     // delete entry data and objects
     --mNumItems;
-    delete[] mItems[index].mName;
-    mItems[index].mName = nullptr;
+    mItems[index].clearName();
     freeItemValue(&mItems[index]);
 
     // swap entry with last entry and clear last entry's data
     if (index < mNumItems) {
         mItems[index] = mItems[mNumItems];
         mItems[mNumItems].mName = nullptr;
+        mItems[mNumItems].mNameOwned = false;
         mItems[mNumItems].mType = kTypeInt32;
     }
     return OK;
@@ -1102,7 +1290,12 @@ void AMessage::extend(const sp<AMessage> &other) {
 }
 
 size_t AMessage::findEntryByName(const char *name) const {
-    return name == nullptr ? countEntries() : findItemIndex(name, strlen(name));
+    if (name == nullptr) {
+        return countEntries();
+    }
+    uint32_t hash;
+    size_t len = HashName(name, &hash);
+    return findItemIndex(name, len, hash);
 }
 
 }  // namespace android
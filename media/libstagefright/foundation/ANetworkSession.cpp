@@ -32,6 +32,7 @@
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AEpollReactor.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/ByteUtils.h>
 #include <media/stagefright/foundation/hexdump.h>
@@ -41,18 +42,16 @@ namespace android {
 static const size_t kMaxUDPSize = 1500;
 static const int32_t kMaxUDPRetries = 200;
 
-struct ANetworkSession::NetworkThread : public Thread {
-    explicit NetworkThread(ANetworkSession *session);
+struct ANetworkSession::SessionCallback : public AEpollReactor::Callback {
+    SessionCallback(ANetworkSession *owner, int32_t sessionID);
 
-protected:
-    virtual ~NetworkThread();
+    virtual void onFdEvents(int32_t token, int fd, uint32_t events);
 
 private:
-    ANetworkSession *mSession;
-
-    virtual bool threadLoop();
+    ANetworkSession *mOwner;
+    int32_t mSessionID;
 
-    DISALLOW_EVIL_CONSTRUCTORS(NetworkThread);
+    DISALLOW_EVIL_CONSTRUCTORS(SessionCallback);
 };
 
 struct ANetworkSession::Session : public RefBase {
@@ -85,6 +84,16 @@ struct ANetworkSession::Session : public RefBase {
     bool wantsToRead();
     bool wantsToWrite();
 
+    // Readiness reported by the (edge-triggered) reactor, cleared once an
+    // operation runs into EAGAIN.
+    void setReady(uint32_t events);
+    void clearReadReady();
+    bool canRead();
+    bool canWrite();
+
+    int32_t reactorToken() const;
+    void setReactorToken(int32_t token);
+
     status_t readMore();
     status_t writeMore();
 
@@ -115,6 +124,8 @@ private:
     sp<AMessage> mNotify;
     bool mSawReceiveFailure, mSawSendFailure;
     int32_t mUDPRetries;
+    bool mReadReady, mWriteReady;
+    int32_t mReactorToken;
 
     List<Fragment> mOutFragments;
 
@@ -131,17 +142,15 @@ private:
 };
 ////////////////////////////////////////////////////////////////////////////////
 
-ANetworkSession::NetworkThread::NetworkThread(ANetworkSession *session)
-    : mSession(session) {
+ANetworkSession::SessionCallback::SessionCallback(
+        ANetworkSession *owner, int32_t sessionID)
+    : mOwner(owner),
+      mSessionID(sessionID) {
 }
 
-ANetworkSession::NetworkThread::~NetworkThread() {
-}
-
-bool ANetworkSession::NetworkThread::threadLoop() {
-    mSession->threadLoop();
-
-    return true;
+void ANetworkSession::SessionCallback::onFdEvents(
+        int32_t /* token */, int /* fd */, uint32_t events) {
+    mOwner->onSessionEvents(mSessionID, events);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -159,6 +168,9 @@ ANetworkSession::Session::Session(
       mSawReceiveFailure(false),
       mSawSendFailure(false),
       mUDPRetries(kMaxUDPRetries),
+      mReadReady(false),
+      mWriteReady(false),
+      mReactorToken(-1),
       mLastStallReportUs(-1ll) {
     if (mState == CONNECTED) {
         struct sockaddr_in localAddr;
@@ -254,6 +266,35 @@ bool ANetworkSession::Session::wantsToWrite() {
             || (mState == DATAGRAM && !mOutFragments.empty()));
 }
 
+void ANetworkSession::Session::setReady(uint32_t events) {
+    if (events & (AEpollReactor::kEventReadable | AEpollReactor::kEventError)) {
+        mReadReady = true;
+    }
+    if (events & (AEpollReactor::kEventWritable | AEpollReactor::kEventError)) {
+        mWriteReady = true;
+    }
+}
+
+void ANetworkSession::Session::clearReadReady() {
+    mReadReady = false;
+}
+
+bool ANetworkSession::Session::canRead() {
+    return mReadReady && wantsToRead();
+}
+
+bool ANetworkSession::Session::canWrite() {
+    return mWriteReady && wantsToWrite();
+}
+
+int32_t ANetworkSession::Session::reactorToken() const {
+    return mReactorToken;
+}
+
+void ANetworkSession::Session::setReactorToken(int32_t token) {
+    mReactorToken = token;
+}
+
 status_t ANetworkSession::Session::readMore() {
     if (mState == DATAGRAM) {
         CHECK_EQ(mMode, MODE_DATAGRAM);
@@ -305,6 +346,7 @@ status_t ANetworkSession::Session::readMore() {
         } while (err == OK);
 
         if (err == -EAGAIN) {
+            mReadReady = false;
             err = OK;
         }
 
@@ -325,25 +367,32 @@ status_t ANetworkSession::Session::readMore() {
         return err;
     }
 
-    char tmp[512];
-    ssize_t n;
-    do {
-        n = recv(mSocket, tmp, sizeof(tmp), 0);
-    } while (n < 0 && errno == EINTR);
-
+    // Notifications are edge-triggered, drain the socket.
     status_t err = OK;
+    for (;;) {
+        char tmp[2048];
+        ssize_t n;
+        do {
+            n = recv(mSocket, tmp, sizeof(tmp), 0);
+        } while (n < 0 && errno == EINTR);
 
-    if (n > 0) {
-        mInBuffer.append(tmp, n);
+        if (n > 0) {
+            mInBuffer.append(tmp, n);
 
 #if 0
-        ALOGI("in:");
-        hexdump(tmp, n);
+            ALOGI("in:");
+            hexdump(tmp, n);
 #endif
-    } else if (n < 0) {
-        err = -errno;
-    } else {
-        err = -ECONNRESET;
+            continue;
+        }
+
+        err = (n < 0) ? -errno : -ECONNRESET;
+        break;
+    }
+
+    if (err == -EAGAIN) {
+        mReadReady = false;
+        err = OK;
     }
 
     if (mMode == MODE_DATAGRAM) {
@@ -570,6 +619,7 @@ status_t ANetworkSession::Session::writeMore() {
             if (!mOutFragments.empty()) {
                 ALOGI("%zu datagrams remain queued.", mOutFragments.size());
             }
+            mWriteReady = false;
             err = OK;
         }
 
@@ -612,6 +662,8 @@ status_t ANetworkSession::Session::writeMore() {
     CHECK_EQ(mState, CONNECTED);
     CHECK(!mOutFragments.empty());
 
+    // Keep sending until the socket buffer fills up, there won't be another
+    // notification before that.
     ssize_t n = -1;
     while (!mOutFragments.empty()) {
         const Fragment &frag = *mOutFragments.begin();
@@ -628,7 +680,7 @@ status_t ANetworkSession::Session::writeMore() {
                 frag.mBuffer->offset() + n, frag.mBuffer->size() - n);
 
         if (frag.mBuffer->size() > 0) {
-            break;
+            continue;
         }
 
         if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
@@ -646,6 +698,11 @@ status_t ANetworkSession::Session::writeMore() {
         err = -ECONNRESET;
     }
 
+    if (err == -EAGAIN) {
+        mWriteReady = false;
+        err = OK;
+    }
+
     if (err != OK) {
         notifyError(true /* send */, err, "Send failed.");
         mSawSendFailure = true;
@@ -788,7 +845,6 @@ void ANetworkSession::Session::notify(NotificationReason reason) {
 
 ANetworkSession::ANetworkSession()
     : mNextSessionID(1) {
-    mPipeFd[0] = mPipeFd[1] = -1;
 }
 
 ANetworkSession::~ANetworkSession() {
@@ -796,51 +852,77 @@ ANetworkSession::~ANetworkSession() {
 }
 
 status_t ANetworkSession::start() {
-    if (mThread != NULL) {
-        return INVALID_OPERATION;
-    }
+    Mutex::Autolock autoLock(mLock);
 
-    int res = pipe(mPipeFd);
-    if (res != 0) {
-        mPipeFd[0] = mPipeFd[1] = -1;
-        return -errno;
+    if (mReactor != NULL) {
+        return INVALID_OPERATION;
     }
 
-    mThread = new NetworkThread(this);
+    sp<AEpollReactor> reactor = new AEpollReactor;
 
-    status_t err = mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
+    status_t err = reactor->start("ANetworkSession", ANDROID_PRIORITY_AUDIO);
 
     if (err != OK) {
-        mThread.clear();
+        return err;
+    }
 
-        close(mPipeFd[0]);
-        close(mPipeFd[1]);
-        mPipeFd[0] = mPipeFd[1] = -1;
+    mReactor = reactor;
 
-        return err;
+    // Sessions created before we were started.
+    for (size_t i = 0; i < mSessions.size(); ++i) {
+        err = registerSession_l(mSessions.valueAt(i));
+
+        if (err != OK) {
+            ALOGE("failed to register session %d (%d)", mSessions.keyAt(i), err);
+        }
     }
 
     return OK;
 }
 
 status_t ANetworkSession::stop() {
-    if (mThread == NULL) {
-        return INVALID_OPERATION;
-    }
+    sp<AEpollReactor> reactor;
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (mReactor == NULL) {
+            return INVALID_OPERATION;
+        }
 
-    mThread->requestExit();
-    interrupt();
-    mThread->requestExitAndWait();
+        reactor = mReactor;
+        mReactor.clear();
 
-    mThread.clear();
+        for (size_t i = 0; i < mSessions.size(); ++i) {
+            mSessions.valueAt(i)->setReactorToken(-1);
+        }
+    }
 
-    close(mPipeFd[0]);
-    close(mPipeFd[1]);
-    mPipeFd[0] = mPipeFd[1] = -1;
+    // Not under mLock, the reactor thread may be waiting for it.
+    reactor->stop();
 
     return OK;
 }
 
+status_t ANetworkSession::registerSession_l(const sp<Session> &session) {
+    if (mReactor == NULL) {
+        // will be registered by start().
+        return OK;
+    }
+
+    int32_t token;
+    status_t err = mReactor->addFd(
+            session->socket(),
+            AEpollReactor::kEventReadable | AEpollReactor::kEventWritable,
+            new SessionCallback(this, session->sessionID()),
+            &token);
+
+    if (err == OK) {
+        session->setReactorToken(token);
+    }
+
+    return err;
+}
+
 status_t ANetworkSession::createRTSPClient(
         const char *host, unsigned port, const sp<AMessage> &notify,
         int32_t *sessionID) {
@@ -926,9 +1008,13 @@ status_t ANetworkSession::destroySession(int32_t sessionID) {
         return -ENOENT;
     }
 
-    mSessions.removeItemsAt(index);
+    const sp<Session> session = mSessions.valueAt(index);
+    if (mReactor != NULL && session->reactorToken() >= 0) {
+        // before the session closes the socket.
+        mReactor->removeFd(session->reactorToken());
+    }
 
-    interrupt();
+    mSessions.removeItemsAt(index);
 
     return OK;
 }
@@ -1139,7 +1225,13 @@ status_t ANetworkSession::createClientOrServer(
 
     mSessions.add(session->sessionID(), session);
 
-    interrupt();
+    err = registerSession_l(session);
+
+    if (err != OK) {
+        // The session owns (and closes) the socket now.
+        mSessions.removeItem(session->sessionID());
+        return err;
+    }
 
     *sessionID = session->sessionID();
 
@@ -1206,7 +1298,15 @@ status_t ANetworkSession::sendRequest(
 
     status_t err = session->sendRequest(data, size, timeValid, timeUs);
 
-    interrupt();
+    // Send right away if the socket can take it, otherwise the reactor
+    // tells us once it drained.
+    if (err == OK && session->canWrite()) {
+        status_t writeErr = session->writeMore();
+        if (writeErr != OK) {
+            ALOGE("writeMore on socket %d failed w/ error %d (%s)",
+                  session->socket(), writeErr, strerror(-writeErr));
+        }
+    }
 
     return err;
 }
@@ -1224,177 +1324,120 @@ status_t ANetworkSession::switchToWebSocketMode(int32_t sessionID) {
     return session->switchToWebSocketMode();
 }
 
-void ANetworkSession::interrupt() {
-    static const char dummy = 0;
+void ANetworkSession::onSessionEvents(int32_t sessionID, uint32_t events) {
+    Mutex::Autolock autoLock(mLock);
 
-    ssize_t n;
-    do {
-        n = write(mPipeFd[1], &dummy, 1);
-    } while (n < 0 && errno == EINTR);
+    ssize_t index = mSessions.indexOfKey(sessionID);
 
-    if (n < 0) {
-        ALOGW("Error writing to pipe (%s)", strerror(errno));
+    if (index < 0) {
+        // destroyed in the meantime.
+        return;
     }
-}
-
-void ANetworkSession::threadLoop() {
-    fd_set rs, ws;
-    FD_ZERO(&rs);
-    FD_ZERO(&ws);
-
-    FD_SET(mPipeFd[0], &rs);
-    int maxFd = mPipeFd[0];
-
-    {
-        Mutex::Autolock autoLock(mLock);
 
-        for (size_t i = 0; i < mSessions.size(); ++i) {
-            const sp<Session> &session = mSessions.valueAt(i);
-
-            int s = session->socket();
-
-            if (s < 0) {
-                continue;
-            }
+    sp<Session> session = mSessions.valueAt(index);
+    session->setReady(events);
 
-            if (session->wantsToRead()) {
-                FD_SET(s, &rs);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
+    processSession_l(session);
+}
 
-            if (session->wantsToWrite()) {
-                FD_SET(s, &ws);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
+void ANetworkSession::processSession_l(const sp<Session> &session) {
+    if (session->isRTSPServer() || session->isTCPDatagramServer()) {
+        if (session->canRead()) {
+            acceptConnections_l(session);
         }
-    }
-
-    int res = select(maxFd + 1, &rs, &ws, NULL, NULL /* tv */);
-
-    if (res == 0) {
         return;
     }
 
-    if (res < 0) {
-        if (errno == EINTR) {
-            return;
-        }
+    int s = session->socket();
 
-        ALOGE("select failed w/ error %d (%s)", errno, strerror(errno));
-        return;
+    // Writing first completes a pending connection, which enables reading.
+    if (session->canWrite()) {
+        status_t err = session->writeMore();
+        if (err != OK) {
+            ALOGE("writeMore on socket %d failed w/ error %d (%s)",
+                  s, err, strerror(-err));
+        }
     }
 
-    if (FD_ISSET(mPipeFd[0], &rs)) {
-        char c;
-        ssize_t n;
-        do {
-            n = read(mPipeFd[0], &c, 1);
-        } while (n < 0 && errno == EINTR);
-
-        if (n < 0) {
-            ALOGW("Error reading from pipe (%s)", strerror(errno));
+    if (session->canRead()) {
+        status_t err = session->readMore();
+        if (err != OK) {
+            ALOGE("readMore on socket %d failed w/ error %d (%s)",
+                  s, err, strerror(-err));
         }
-
-        --res;
     }
+}
 
-    {
-        Mutex::Autolock autoLock(mLock);
-
-        List<sp<Session> > sessionsToAdd;
-
-        for (size_t i = mSessions.size(); res > 0 && i > 0;) {
-            i--;
-            const sp<Session> &session = mSessions.valueAt(i);
+void ANetworkSession::acceptConnections_l(const sp<Session> &session) {
+    for (;;) {
+        struct sockaddr_in remoteAddr;
+        socklen_t remoteAddrLen = sizeof(remoteAddr);
 
-            int s = session->socket();
+        int clientSocket = accept(
+                session->socket(), (struct sockaddr *)&remoteAddr, &remoteAddrLen);
 
-            if (s < 0) {
+        if (clientSocket < 0) {
+            if (errno == EINTR) {
                 continue;
             }
 
-            if (FD_ISSET(s, &rs) || FD_ISSET(s, &ws)) {
-                --res;
+            if (errno == EAGAIN) {
+                session->clearReadReady();
+            } else {
+                ALOGE("accept returned error %d (%s)",
+                      errno, strerror(errno));
             }
+            break;
+        }
 
-            if (FD_ISSET(s, &rs)) {
-                if (session->isRTSPServer() || session->isTCPDatagramServer()) {
-                    struct sockaddr_in remoteAddr;
-                    socklen_t remoteAddrLen = sizeof(remoteAddr);
-
-                    int clientSocket = accept(
-                            s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
-
-                    if (clientSocket >= 0) {
-                        status_t err = MakeSocketNonBlocking(clientSocket);
-
-                        if (err != OK) {
-                            ALOGE("Unable to make client socket non blocking, "
-                                  "failed w/ error %d (%s)",
-                                  err, strerror(-err));
-
-                            close(clientSocket);
-                            clientSocket = -1;
-                        } else {
-                            in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
-
-                            ALOGI("incoming connection from %d.%d.%d.%d:%d "
-                                  "(socket %d)",
-                                  (addr >> 24),
-                                  (addr >> 16) & 0xff,
-                                  (addr >> 8) & 0xff,
-                                  addr & 0xff,
-                                  ntohs(remoteAddr.sin_port),
-                                  clientSocket);
-
-                            sp<Session> clientSession =
-                                new Session(
-                                        mNextSessionID++,
-                                        Session::CONNECTED,
-                                        clientSocket,
-                                        session->getNotificationMessage());
-
-                            clientSession->setMode(
-                                    session->isRTSPServer()
-                                        ? Session::MODE_RTSP
-                                        : Session::MODE_DATAGRAM);
-
-                            sessionsToAdd.push_back(clientSession);
-                        }
-                    } else {
-                        ALOGE("accept returned error %d (%s)",
-                              errno, strerror(errno));
-                    }
-                } else {
-                    status_t err = session->readMore();
-                    if (err != OK) {
-                        ALOGE("readMore on socket %d failed w/ error %d (%s)",
-                              s, err, strerror(-err));
-                    }
-                }
-            }
+        status_t err = MakeSocketNonBlocking(clientSocket);
 
-            if (FD_ISSET(s, &ws)) {
-                status_t err = session->writeMore();
-                if (err != OK) {
-                    ALOGE("writeMore on socket %d failed w/ error %d (%s)",
-                          s, err, strerror(-err));
-                }
-            }
+        if (err != OK) {
+            ALOGE("Unable to make client socket non blocking, "
+                  "failed w/ error %d (%s)",
+                  err, strerror(-err));
+
+            close(clientSocket);
+            clientSocket = -1;
+            continue;
         }
 
-        while (!sessionsToAdd.empty()) {
-            sp<Session> session = *sessionsToAdd.begin();
-            sessionsToAdd.erase(sessionsToAdd.begin());
+        in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
+
+        ALOGI("incoming connection from %d.%d.%d.%d:%d "
+              "(socket %d)",
+              (addr >> 24),
+              (addr >> 16) & 0xff,
+              (addr >> 8) & 0xff,
+              addr & 0xff,
+              ntohs(remoteAddr.sin_port),
+              clientSocket);
+
+        sp<Session> clientSession =
+            new Session(
+                    mNextSessionID++,
+                    Session::CONNECTED,
+                    clientSocket,
+                    session->getNotificationMessage());
+
+        clientSession->setMode(
+                session->isRTSPServer()
+                    ? Session::MODE_RTSP
+                    : Session::MODE_DATAGRAM);
 
-            mSessions.add(session->sessionID(), session);
+        mSessions.add(clientSession->sessionID(), clientSession);
 
-            ALOGI("added clientSession %d", session->sessionID());
+        err = registerSession_l(clientSession);
+
+        if (err != OK) {
+            ALOGE("failed to register clientSession %d (%d)",
+                  clientSession->sessionID(), err);
+
+            mSessions.removeItem(clientSession->sessionID());
+            continue;
         }
+
+        ALOGI("added clientSession %d", clientSession->sessionID());
     }
 }
 
@@ -28,35 +28,23 @@
 #include <media/stagefright/MetaData.h>
 #include <utils/misc.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
 unsigned parseUE(ABitReader *br) {
-    unsigned numZeroes = 0;
-    while (br->getBits(1) == 0) {
-        ++numZeroes;
-    }
-
-    unsigned x = br->getBits(numZeroes);
-
-    return x + (1u << numZeroes) - 1;
+    uint32_t x;
+    CHECK(br->getUEGraceful(&x));
+    return x;
 }
 
 unsigned parseUEWithFallback(ABitReader *br, unsigned fallback) {
-    unsigned numZeroes = 0;
-    while (br->getBitsWithFallback(1, 1) == 0) {
-        ++numZeroes;
-    }
     uint32_t x;
-    if (numZeroes < 32) {
-        if (br->getBitsGraceful(numZeroes, &x)) {
-            return x + (1u << numZeroes) - 1;
-        } else {
-            return fallback;
-        }
-    } else {
-        br->skipBits(numZeroes);
-        return fallback;
-    }
+    return br->getUEGraceful(&x) ? x : fallback;
 }
 
 signed parseSE(ABitReader *br) {
@@ -275,6 +263,49 @@ void FindAVCDimensions(
     }
 }
 
+const uint8_t *findStartCode(const uint8_t *data, size_t size) {
+    size_t offset = 0;
+
+#if defined(__SSE2__)
+    // for each of 16 positions i, test data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    for (; offset + 18 <= size; offset += 16) {
+        const uint8_t *p = data + offset;
+        __m128i z0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), zero);
+        __m128i z1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 1)), zero);
+        __m128i o2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 2)), one);
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(z0, z1), o2));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+    for (; offset + 18 <= size; offset += 16) {
+        const uint8_t *p = data + offset;
+        uint8x16_t z0 = vceqq_u8(vld1q_u8(p), zero);
+        uint8x16_t z1 = vceqq_u8(vld1q_u8(p + 1), zero);
+        uint8x16_t o2 = vceqq_u8(vld1q_u8(p + 2), one);
+        uint8x16_t hit = vandq_u8(vandq_u8(z0, z1), o2);
+        uint64x2_t hit64 = vreinterpretq_u64_u8(hit);
+        if ((vgetq_lane_u64(hit64, 0) | vgetq_lane_u64(hit64, 1)) != 0) {
+            // rare, let the scalar loop locate it
+            break;
+        }
+    }
+#endif
+
+    for (; offset + 2 < size; ++offset) {
+        if (data[offset + 2] == 0x01 && data[offset] == 0x00
+                && data[offset + 1] == 0x00) {
+            return data + offset;
+        }
+    }
+    return NULL;
+}
+
 status_t getNextNALUnit(
         const uint8_t **_data, size_t *_size,
         const uint8_t **nalStart, size_t *nalSize,
@@ -289,43 +320,26 @@ status_t getNextNALUnit(
         return -EAGAIN;
     }
 
-    size_t offset = 0;
-
     // A valid startcode consists of at least two 0x00 bytes followed by 0x01.
-    for (; offset + 2 < size; ++offset) {
-        if (data[offset + 2] == 0x01 && data[offset] == 0x00
-                && data[offset + 1] == 0x00) {
-            break;
-        }
-    }
-    if (offset + 2 >= size) {
-        *_data = &data[offset];
+    const uint8_t *startCode = findStartCode(data, size);
+    if (startCode == NULL) {
+        *_data = &data[size - 2];
         *_size = 2;
         return -EAGAIN;
     }
-    offset += 3;
+    size_t offset = startCode - data + 3;
 
     size_t startOffset = offset;
 
-    for (;;) {
-        while (offset < size && data[offset] != 0x01) {
-            ++offset;
-        }
-
-        if (offset == size) {
-            if (startCodeFollows) {
-                offset = size + 2;
-                break;
-            }
-
+    // |offset| ends up pointing at the 0x01 of the next start code
+    startCode = findStartCode(&data[startOffset], size - startOffset);
+    if (startCode != NULL) {
+        offset = startCode - data + 2;
+    } else {
+        if (!startCodeFollows) {
             return -EAGAIN;
         }
-
-        if (data[offset - 1] == 0x00 && data[offset - 2] == 0x00) {
-            break;
-        }
-
-        ++offset;
+        offset = size + 2;
     }
 
     size_t endOffset = offset - 2;
@@ -515,6 +529,39 @@ bool IsAVCReferenceFrame(const sp<ABuffer> &accessUnit) {
     return true;
 }
 
+bool IsHEVCReferenceFrame(const sp<ABuffer> &accessUnit, unsigned *temporalId) {
+    const uint8_t *data = accessUnit->data();
+    size_t size = accessUnit->size();
+    if (data == NULL) {
+        ALOGE("IsHEVCReferenceFrame: called on NULL data (%p, %zu)", accessUnit.get(), size);
+        return false;
+    }
+
+    const uint8_t *nalStart;
+    size_t nalSize;
+    while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
+        if (nalSize < 2) {
+            ALOGE("IsHEVCReferenceFrame: invalid nalSize: %zu (%p, %zu)",
+                    nalSize, accessUnit.get(), size);
+            return false;
+        }
+
+        unsigned nalType = (nalStart[0] >> 1) & 0x3f;
+
+        // VCL NAL units are types 0..31; types 0, 2, .., 14 (TRAIL_N, TSA_N,
+        // STSA_N, RADL_N, RASL_N and reserved) are sub-layer non-reference.
+        if (nalType < 32) {
+            if (temporalId != nullptr) {
+                unsigned temporalIdPlus1 = nalStart[1] & 7;
+                *temporalId = temporalIdPlus1 > 0 ? temporalIdPlus1 - 1 : 0;
+            }
+            return nalType > 14 || (nalType & 1);
+        }
+    }
+
+    return true;
+}
+
 uint32_t FindAVCLayerId(const uint8_t *data, size_t size) {
     CHECK(data != NULL);
 
@@ -769,5 +816,29 @@ bool GetMPEGAudioFrameSize(
     return true;
 }
 
+ssize_t FindMPEGAudioSyncWord(const uint8_t *data, size_t size) {
+    const uint8_t *ptr = data;
+    const uint8_t *end = data + size;
+
+    while (end - ptr >= 3) {
+        ptr = (const uint8_t *)memchr(ptr, 0xff, end - ptr - 2);
+        if (ptr == NULL) {
+            break;
+        }
+
+        if ((ptr[1] >> 5) == 0x07
+                && ((ptr[1] >> 3) & 3) != 1     // reserved ID
+                && ((ptr[1] >> 1) & 3) != 0     // reserved layer
+                && (ptr[2] >> 4) != 0x0f        // reserved bitrate index
+                && ((ptr[2] >> 2) & 3) != 3) {  // reserved sampling rate index
+            return ptr - data;
+        }
+
+        ++ptr;
+    }
+
+    return -1;
+}
+
 }  // namespace android
 
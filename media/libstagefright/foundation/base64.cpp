@@ -21,6 +21,78 @@
 
 namespace android {
 
+// 6-bit value of each base64 and base64url character. Anything else maps to
+// 0xff, and '=' to kPad; both have the top bits set, so one test over a
+// whole quantum catches them.
+static const uint8_t kPad = 0xfe;
+static const uint8_t kDecodeTable[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0x3e, 0xff, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xfe, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0x3f,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+ssize_t decodeBase64(const char *in, size_t n, uint8_t *out) {
+    if ((n % 4) != 0) {
+        return -1;
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    const uint8_t *src = (const uint8_t *)in;
+    uint8_t *dst = out;
+
+    // Every quantum but the last has no padding.
+    for (size_t i = 0; i < n / 4 - 1; ++i, src += 4, dst += 3) {
+        uint32_t a = kDecodeTable[src[0]];
+        uint32_t b = kDecodeTable[src[1]];
+        uint32_t c = kDecodeTable[src[2]];
+        uint32_t d = kDecodeTable[src[3]];
+        if ((a | b | c | d) & 0xc0) {
+            return -1;
+        }
+        uint32_t accum = (a << 18) | (b << 12) | (c << 6) | d;
+        dst[0] = accum >> 16;
+        dst[1] = (accum >> 8) & 0xff;
+        dst[2] = accum & 0xff;
+    }
+
+    size_t padding = 0;
+    while (padding < 3 && kDecodeTable[src[3 - padding]] == kPad) {
+        ++padding;
+    }
+
+    uint32_t accum = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        uint32_t value = 0;
+        if (i < 4 - padding) {
+            value = kDecodeTable[src[i]];
+            if (value & 0xc0) {
+                return -1;
+            }
+        }
+        accum = (accum << 6) | value;
+    }
+    if (padding < 3) { *dst++ = accum >> 16; }
+    if (padding < 2) { *dst++ = (accum >> 8) & 0xff; }
+    if (padding < 1) { *dst++ = accum & 0xff; }
+
+    return dst - out;
+}
+
 sp<ABuffer> decodeBase64(const AString &s) {
     size_t n = s.size();
 
@@ -50,40 +122,9 @@ sp<ABuffer> decodeBase64(const AString &s) {
     if (out == NULL || buffer->size() < outLen) {
         return NULL;
     }
-    size_t j = 0;
-    uint32_t accum = 0;
-    for (size_t i = 0; i < n; ++i) {
-        char c = s.c_str()[i];
-        unsigned value;
-        if (c >= 'A' && c <= 'Z') {
-            value = c - 'A';
-        } else if (c >= 'a' && c <= 'z') {
-            value = 26 + c - 'a';
-        } else if (c >= '0' && c <= '9') {
-            value = 52 + c - '0';
-        } else if (c == '+' || c == '-') {
-            value = 62;
-        } else if (c == '/' || c == '_') {
-            value = 63;
-        } else if (c != '=') {
-            return NULL;
-        } else {
-            if (i < n - padding) {
-                return NULL;
-            }
 
-            value = 0;
-        }
-
-        accum = (accum << 6) | value;
-
-        if (((i + 1) % 4) == 0) {
-            if (j < outLen) { out[j++] = (accum >> 16); }
-            if (j < outLen) { out[j++] = (accum >> 8) & 0xff; }
-            if (j < outLen) { out[j++] = accum & 0xff; }
-
-            accum = 0;
-        }
+    if (decodeBase64(s.c_str(), n, out) != (ssize_t)outLen) {
+        return NULL;
     }
 
     return buffer;
@@ -31,6 +31,11 @@ namespace android {
 struct AAtomizer {
     static const char *Atomize(const char *name);
 
+    // Same as above, for callers that already computed Hash(name).
+    static const char *Atomize(const char *name, uint32_t hash);
+
+    static uint32_t Hash(const char *s);
+
 private:
     static AAtomizer gAtomizer;
 
@@ -39,9 +44,7 @@ private:
 
     AAtomizer();
 
-    const char *atomize(const char *name);
-
-    static uint32_t Hash(const char *s);
+    const char *atomize(const char *name, uint32_t hash);
 
     DISALLOW_EVIL_CONSTRUCTORS(AAtomizer);
 };
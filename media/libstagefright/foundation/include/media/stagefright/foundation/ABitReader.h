@@ -37,14 +37,44 @@ public:
     // Tries to get |n| bits. If not successful, returns false. Otherwise, stores result in |out|
     // and returns true. Use !overRead() to determine if this call was successful. Reading 0 bits
     // will always succeed and write 0 in |out|.
-    bool getBitsGraceful(size_t n, uint32_t *out);
+    bool getBitsGraceful(size_t n, uint32_t *out) {
+        if (hasBitsForFastPath(n)) {
+            *out = takeBits(n);
+            return true;
+        }
+        return getBitsGracefulSlow(n, out);
+    }
 
     // Gets |n| bits and returns result. ABORTS if unsuccessful. Reading 0 bits will always
     // succeed.
-    uint32_t getBits(size_t n);
+    uint32_t getBits(size_t n) {
+        return hasBitsForFastPath(n) ? takeBits(n) : getBitsSlow(n);
+    }
+
+    // Tries to get the next |n| bits without consuming them. If not successful, returns false.
+    // Otherwise, stores result in |out| and returns true. Peeking is not an over-read.
+    bool peekBitsGraceful(size_t n, uint32_t *out) {
+        if (hasBitsForFastPath(n)) {
+            *out = (uint32_t)(mReservoir >> (64 - n));
+            return true;
+        }
+        return peekBitsGracefulSlow(n, out);
+    }
 
     // Tries to skip |n| bits. Returns true iff successful. Skipping 0 bits will always succeed.
-    bool skipBits(size_t n);
+    bool skipBits(size_t n) {
+        if (n <= mNumBitsLeft) {
+            consumeBits(n);
+            return true;
+        }
+        return skipBitsSlow(n);
+    }
+
+    // Tries to read an unsigned (ue(v)) or signed (se(v)) Exp-Golomb code of up to 32 bits. If
+    // not successful, returns false, which is also the case for codes whose value does not fit
+    // into 32 bits. Otherwise, stores result in |out| and returns true.
+    bool getUEGraceful(uint32_t *out);
+    bool getSEGraceful(int32_t *out);
 
     // "Puts" |n| bits with the value |x| back virtually into the bit stream. The put-back bits
     // are not actually written into the data, but are tracked in a separate buffer that can
@@ -63,12 +93,39 @@ protected:
     const uint8_t *mData;
     size_t mSize;
 
-    uint32_t mReservoir;  // left-aligned bits
+    uint64_t mReservoir;  // left-aligned bits, unused low bits are always zero
     size_t mNumBitsLeft;
     bool mOverRead;
 
+    // Appends as many whole bytes to the reservoir as fit. Returns false iff there was no more
+    // data. Does not mark the stream as over-read.
     virtual bool fillReservoir();
 
+    inline void consumeBits(size_t n) {
+        // n may be 64 if the reservoir was full
+        mReservoir = n < 64 ? mReservoir << n : 0;
+        mNumBitsLeft -= n;
+    }
+
+private:
+    // true iff 0 < n <= 32 and the reservoir holds at least n bits
+    inline bool hasBitsForFastPath(size_t n) const {
+        return n - 1 < mNumBitsLeft && n <= 32;
+    }
+
+    inline uint32_t takeBits(size_t n) {
+        uint32_t result = (uint32_t)(mReservoir >> (64 - n));
+        mReservoir <<= n;
+        mNumBitsLeft -= n;
+        return result;
+    }
+
+    // out-of-line paths that refill the reservoir
+    uint32_t getBitsSlow(size_t n);
+    bool getBitsGracefulSlow(size_t n, uint32_t *out);
+    bool peekBitsGracefulSlow(size_t n, uint32_t *out);
+    bool skipBitsSlow(size_t n);
+
     DISALLOW_EVIL_CONSTRUCTORS(ABitReader);
 };
 
@@ -43,6 +43,13 @@ struct ABuffer : public RefBase {
     // create buffer from dup of some memory block
     static sp<ABuffer> CreateAsCopy(const void *data, size_t capacity);
 
+    // Creates a buffer that shares |size| bytes of this buffer's storage,
+    // starting at |offset| relative to the current range, and keeps this
+    // buffer alive for as long as the slice exists. No data is copied, so
+    // writes through either buffer are visible in the other. The slice has its
+    // own range, int32 data and meta.
+    sp<ABuffer> slice(size_t offset, size_t size);
+
     void setInt32Data(int32_t data) { mInt32Data = data; }
     int32_t int32Data() const { return mInt32Data; }
 
@@ -63,6 +70,9 @@ private:
 
     bool mOwnsData;
 
+    // set for slices; owns the storage mData points into
+    sp<ABuffer> mParent;
+
     DISALLOW_EVIL_CONSTRUCTORS(ABuffer);
 };
 
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_EPOLL_REACTOR_H_
+
+#define A_EPOLL_REACTOR_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Thread.h>
+
+namespace android {
+
+struct AMessage;
+
+// Waits for activity on any number of file descriptors on a single thread
+// using edge-triggered epoll. Descriptors stay registered until removed, so
+// waiting costs nothing per descriptor. Since notifications are edge-triggered
+// a client has to consume the readiness it was told about (i.e. read or write
+// until EAGAIN) before it may expect to be notified again.
+struct AEpollReactor : public RefBase {
+    enum {
+        kEventReadable  = 1,
+        kEventWritable  = 2,
+        kEventError     = 4,
+    };
+
+    struct Callback : public RefBase {
+        Callback() {}
+
+        // Runs on the reactor thread, |events| is a mask of kEvent*.
+        virtual void onFdEvents(int32_t token, int fd, uint32_t events) = 0;
+
+    protected:
+        virtual ~Callback() {}
+
+    private:
+        DISALLOW_EVIL_CONSTRUCTORS(Callback);
+    };
+
+    AEpollReactor();
+
+    // A reactor shared by the whole process, started on first use.
+    static sp<AEpollReactor> GetShared();
+
+    status_t start(
+            const char *name = "AEpollReactor",
+            int32_t priority = PRIORITY_DEFAULT);
+    status_t stop();
+
+    // Registers |fd| for the kEventReadable/kEventWritable |events|, errors
+    // are always reported. |*token| identifies the registration from then on.
+    status_t addFd(
+            int fd, uint32_t events, const sp<Callback> &callback,
+            int32_t *token);
+
+    // Same, but posts a copy of |notify| with "token", "fd" and "events" set
+    // instead. Since the message is handled later, the registration is
+    // one-shot: nothing else is posted for it until rearm() is called, which
+    // the handler does once it is done with the descriptor. A descriptor that
+    // is still ready when rearmed is reported again right away.
+    status_t addFd(
+            int fd, uint32_t events, const sp<AMessage> &notify,
+            int32_t *token);
+    status_t rearm(int32_t token);
+
+    // The descriptor may already have been closed. Notifications on their way
+    // to the client when this is called may still be delivered.
+    void removeFd(int32_t token);
+
+protected:
+    virtual ~AEpollReactor();
+
+private:
+    struct ReactorThread;
+
+    enum {
+        kWakeToken = 0,
+    };
+
+    struct Registration {
+        int mFd;
+        uint32_t mEpollEvents;
+        sp<Callback> mCallback;
+        sp<AMessage> mNotify;
+    };
+
+    Mutex mLock;
+    sp<Thread> mThread;
+    int mEpollFd;
+    int mWakeFd;
+    int32_t mNextToken;
+    KeyedVector<int32_t, Registration> mRegistrations;
+    // The registration currently owning each descriptor, a descriptor can be
+    // closed and reused by another client before the first one removes it.
+    KeyedVector<int, int32_t> mTokensByFd;
+
+    status_t addRegistration(
+            int fd, uint32_t events, bool oneShot,
+            const sp<Callback> &callback, const sp<AMessage> &notify,
+            int32_t *token);
+    void wake();
+    void threadLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(AEpollReactor);
+};
+
+}  // namespace android
+
+#endif  // A_EPOLL_REACTOR_H_
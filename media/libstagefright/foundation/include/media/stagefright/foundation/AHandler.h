@@ -19,6 +19,7 @@
 #define A_HANDLER_H_
 
 #include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AString.h>
 #include <utils/KeyedVector.h>
 #include <utils/RefBase.h>
 
@@ -65,11 +66,42 @@ private:
         mLooper = looper;
     }
 
+    // Fixed-bucket latency histogram, collected only with verbose stats.
+    struct LatencyHistogram {
+        enum {
+            kNumBuckets = 10,
+        };
+
+        LatencyHistogram() { clear(); }
+
+        void add(int64_t us);
+        void clear();
+        AString toString() const;
+
+    private:
+        static const int64_t kBucketLimitsUs[kNumBuckets - 1];
+
+        uint32_t mBuckets[kNumBuckets];
+        uint32_t mCount;
+        int64_t mTotalUs;
+        int64_t mMaxUs;
+    };
+
+    // per-|what| queueing delay (time past the due time until dispatch) and
+    // onMessageReceived() execution time
+    struct DispatchStats {
+        uint32_t mCount;
+        LatencyHistogram mQueueDelay;
+        LatencyHistogram mExecution;
+
+        DispatchStats() : mCount(0) { }
+    };
+
     bool mVerboseStats;
     uint32_t mMessageCounter;
-    KeyedVector<uint32_t, uint32_t> mMessages;
+    KeyedVector<uint32_t, DispatchStats> mMessages;
 
-    void deliverMessage(const sp<AMessage> &msg);
+    void deliverMessage(const sp<AMessage> &msg, int64_t queueDelayUs);
 
     DISALLOW_EVIL_CONSTRUCTORS(AHandler);
 };
@@ -26,9 +26,12 @@
 #include <utils/RefBase.h>
 #include <utils/threads.h>
 
+#include <vector>
+
 namespace android {
 
 struct AHandler;
+struct ALooperPool;
 struct AMessage;
 struct AReplyToken;
 
@@ -50,6 +53,13 @@ struct ALooper : public RefBase {
             int32_t priority = PRIORITY_DEFAULT
             );
 
+    // Runs this looper on the process-wide shared thread pool instead of a
+    // dedicated thread. Messages are still delivered one at a time and in
+    // order, but handlers must not block for long (including waiting on
+    // replies from other pooled loopers), as that ties up a shared thread.
+    // Latency-critical loopers should keep using start().
+    status_t startOnSharedPool();
+
     status_t stop();
 
     static int64_t GetNowUs();
@@ -63,23 +73,46 @@ protected:
 
 private:
     friend struct AMessage;       // post()
+    friend struct ALooperPool;    // runOnPool()
 
     struct Event {
         int64_t mWhenUs;
+        // breaks ties between events due at the same time so that they are
+        // delivered in the order they were posted
+        uint64_t mSeqNo;
         sp<AMessage> mMessage;
     };
 
+    // heap comparator: orders the earliest (then oldest) event at the front
+    struct EventLater {
+        bool operator()(const Event &a, const Event &b) const {
+            return a.mWhenUs > b.mWhenUs
+                    || (a.mWhenUs == b.mWhenUs && a.mSeqNo > b.mSeqNo);
+        }
+    };
+
     Mutex mLock;
     Condition mQueueChangedCondition;
 
     AString mName;
 
-    List<Event> mEventQueue;
+    // binary min-heap on (mWhenUs, mSeqNo); posting and dequeuing are both
+    // O(log n) regardless of how many delayed messages are pending
+    std::vector<Event> mEventQueue;
+    uint64_t mNextSeqNo;
 
     struct LooperThread;
     sp<LooperThread> mThread;
     bool mRunningLocally;
 
+    // shared pool state, see startOnSharedPool()
+    bool mRunningOnPool;
+    bool mPoolBusy;                     // a pool worker is delivering a message
+    android_thread_id_t mPoolThreadId;  // that worker, while mPoolBusy
+    uint32_t mPoolGeneration;           // invalidates outdated pool schedules
+    int64_t mPoolScheduledUs;           // -1 if not scheduled on the pool
+    Condition mPoolIdleCondition;
+
     // use a separate lock for reply handling, as it is always on another thread
     // use a central lock, however, to avoid creating a mutex for each reply
     Mutex mRepliesLock;
@@ -103,6 +136,10 @@ private:
 
     bool loop();
 
+    // called by a pool worker; delivers at most one due message
+    void runOnPool(uint32_t generation);
+    void schedulePoolLocked();
+
     DISALLOW_EVIL_CONSTRUCTORS(ALooper);
 };
 
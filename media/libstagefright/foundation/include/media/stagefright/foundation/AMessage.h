@@ -57,6 +57,11 @@ private:
     }
     // sets the reply for this token. returns OK or error
     status_t setReply(const sp<AMessage> &reply);
+
+public:
+    // storage is recycled through a free list, see AMessage::GetPoolStats()
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
 };
 
 struct AMessage : public RefBase {
@@ -170,6 +175,21 @@ struct AMessage : public RefBase {
 
     AString debugString(int32_t indent = 0) const;
 
+    // AMessage and AReplyToken storage is recycled through bounded,
+    // process-wide free lists instead of going back to the allocator
+    // whenever the last strong reference is dropped.
+    struct PoolStats {
+        uint64_t mHits;      // allocations served from the free list
+        uint64_t mMisses;    // allocations that fell back to the heap
+        uint64_t mRecycled;  // objects returned to the free list
+        uint64_t mReleased;  // objects returned to the heap (free list full)
+        size_t mFreeCount;   // objects currently on the free list
+    };
+    static void GetPoolStats(PoolStats *messageStats, PoolStats *replyTokenStats);
+
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
     enum Type {
         kTypeInt32,
         kTypeInt64,
@@ -285,10 +305,18 @@ private:
             AString *stringValue;
             Rect rectValue;
         } u;
+        // Names are normally interned through AAtomizer and shared between
+        // messages; only names received from untrusted sources (parcels) are
+        // owned copies, so that remote peers cannot grow the atom table.
         const char *mName;
         size_t      mNameLength;
+        uint32_t    mNameHash;
+        bool        mNameOwned;
         Type mType;
-        void setName(const char *name, size_t len);
+        void setName(const char *name, size_t len, uint32_t hash);
+        void setNameCopy(const char *name, size_t len, uint32_t hash);
+        void copyNameFrom(const Item &other);
+        void clearName();
     };
 
     enum {
@@ -304,9 +332,13 @@ private:
     void setObjectInternal(
             const char *name, const sp<RefBase> &obj, Type type);
 
-    size_t findItemIndex(const char *name, size_t len) const;
+    size_t findItemIndex(const char *name, size_t len, uint32_t hash) const;
+
+    // Returns the length of |name| and its AAtomizer hash in |hash|.
+    static size_t HashName(const char *name, uint32_t *hash);
 
-    void deliver();
+    // |queueDelayUs| is how late the message is being delivered
+    void deliver(int64_t queueDelayUs);
 
     DISALLOW_EVIL_CONSTRUCTORS(AMessage);
 };
@@ -20,13 +20,14 @@
 
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
 #include <utils/RefBase.h>
-#include <utils/Thread.h>
 
 #include <netinet/in.h>
 
 namespace android {
 
+struct AEpollReactor;
 struct AMessage;
 
 // Helper class to manage a number of live sockets (datagram and stream-based)
@@ -94,16 +95,15 @@ protected:
     virtual ~ANetworkSession();
 
 private:
-    struct NetworkThread;
     struct Session;
+    struct SessionCallback;
 
     Mutex mLock;
-    sp<Thread> mThread;
+    // Waits on all sessions' sockets while started.
+    sp<AEpollReactor> mReactor;
 
     int32_t mNextSessionID;
 
-    int mPipeFd[2];
-
     KeyedVector<int32_t, sp<Session> > mSessions;
 
     enum Mode {
@@ -122,8 +122,10 @@ private:
             const sp<AMessage> &notify,
             int32_t *sessionID);
 
-    void threadLoop();
-    void interrupt();
+    status_t registerSession_l(const sp<Session> &session);
+    void onSessionEvents(int32_t sessionID, uint32_t events);
+    void processSession_l(const sp<Session> &session);
+    void acceptConnections_l(const sp<Session> &session);
 
     static status_t MakeSocketNonBlocking(int s);
 
@@ -75,6 +75,10 @@ inline void skipSE(ABitReader *br) {
     (void)parseSEWithFallback(br, 0);
 }
 
+// Returns a pointer to the first 3-byte start code prefix (00 00 01) in the |size| bytes at
+// |data|, or NULL if there is none. Scans 16 bytes per iteration on SSE2 and NEON.
+const uint8_t *findStartCode(const uint8_t *data, size_t size);
+
 status_t getNextNALUnit(
         const uint8_t **_data, size_t *_size,
         const uint8_t **nalStart, size_t *nalSize,
@@ -86,6 +90,12 @@ sp<ABuffer> MakeAVCCodecSpecificData(
 
 bool IsIDR(const uint8_t *data, size_t size);
 bool IsAVCReferenceFrame(const sp<ABuffer> &accessUnit);
+// Returns false iff the access unit is an HEVC sub-layer non-reference picture.
+// If temporalId is non-null, it is set to the TemporalId of its first VCL NAL.
+bool IsHEVCReferenceFrame(const sp<ABuffer> &accessUnit, unsigned *temporalId = nullptr);
+// Returns false iff the access unit is an HEVC sub-layer non-reference picture.
+// If temporalId is non-null, it is set to the TemporalId of its first VCL NAL.
+bool IsHEVCReferenceFrame(const sp<ABuffer> &accessUnit, unsigned *temporalId = nullptr);
 uint32_t FindAVCLayerId(const uint8_t *data, size_t size);
 
 const char *AVCProfileToString(uint8_t profile);
@@ -100,6 +110,11 @@ bool GetMPEGAudioFrameSize(
         int *out_sampling_rate = NULL, int *out_channels = NULL,
         int *out_bitrate = NULL, int *out_num_samples = NULL);
 
+// Returns the offset of the first byte sequence in |data| that looks like the
+// start of an MPEG audio frame header (sync word and no reserved fields), or
+// -1 if there is none. Only the first 3 bytes of the header are examined.
+ssize_t FindMPEGAudioSyncWord(const uint8_t *data, size_t size);
+
 }  // namespace android
 
 #endif  // AVC_UTILS_H_
@@ -26,6 +26,13 @@ struct ABuffer;
 struct AString;
 
 sp<ABuffer> decodeBase64(const AString &s);
+
+// Decodes n base64 or base64url characters, a multiple of 4 without any
+// whitespace, into out, which must have room for (n / 4) * 3 bytes. '='
+// padding is accepted in the last quantum only, so ranges of quanta can be
+// decoded separately. Returns the number of bytes written, or -1 if the
+// input is malformed.
+ssize_t decodeBase64(const char *in, size_t n, uint8_t *out);
 void encodeBase64(const void *data, size_t size, AString *out);
 
 void encodeBase64Url(const void *data, size_t size, AString *out);
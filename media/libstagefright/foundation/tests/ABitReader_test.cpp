@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ABitReader_test"
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ABitReader.h>
+
+namespace android {
+
+class ABitReaderTest : public ::testing::Test {
+};
+
+TEST_F(ABitReaderTest, GetAndPeekBits) {
+    static const uint8_t kData[] = {
+        0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x11, 0x22,
+    };
+    ABitReader br(kData, sizeof(kData));
+
+    uint32_t x;
+    ASSERT_TRUE(br.peekBitsGraceful(12, &x));
+    ASSERT_EQ(0x123u, x);
+    ASSERT_EQ(0x1u, br.getBits(4));
+    ASSERT_EQ(0x23456789u, br.getBits(32));
+    ASSERT_TRUE(br.skipBits(4));
+    ASSERT_EQ(0xbcdef011u, br.getBits(32));
+    ASSERT_EQ(8u, br.numBitsLeft());
+
+    br.putBits(0x1, 4);
+    ASSERT_EQ(0x12u, br.getBits(8));
+    ASSERT_EQ(0x2u, br.getBits(4));
+
+    // peeking past the end is not an over-read, getting is
+    ASSERT_FALSE(br.peekBitsGraceful(8, &x));
+    ASSERT_FALSE(br.overRead());
+    ASSERT_FALSE(br.getBitsGraceful(8, &x));
+    ASSERT_TRUE(br.overRead());
+}
+
+TEST_F(ABitReaderTest, ExpGolomb) {
+    // 1 010 011 00100 0001000 000000011111111 1, then zero padding
+    static const uint8_t kData[] = {
+        0xa6, 0x41, 0x00, 0x3f, 0xe0,
+    };
+    ABitReader br(kData, sizeof(kData));
+
+    uint32_t ue;
+    ASSERT_TRUE(br.getUEGraceful(&ue));
+    ASSERT_EQ(0u, ue);
+    ASSERT_TRUE(br.getUEGraceful(&ue));
+    ASSERT_EQ(1u, ue);
+
+    int32_t se;
+    ASSERT_TRUE(br.getSEGraceful(&se));
+    ASSERT_EQ(-1, se);
+    ASSERT_TRUE(br.getUEGraceful(&ue));
+    ASSERT_EQ(3u, ue);
+    ASSERT_TRUE(br.getUEGraceful(&ue));
+    ASSERT_EQ(7u, ue);
+    ASSERT_TRUE(br.getUEGraceful(&ue));
+    ASSERT_EQ(254u, ue);
+    ASSERT_TRUE(br.getUEGraceful(&ue));
+    ASSERT_EQ(0u, ue);
+
+    // only zero bits left
+    ASSERT_FALSE(br.getUEGraceful(&ue));
+}
+
+TEST_F(ABitReaderTest, NALEmulationPrevention) {
+    static const uint8_t kData[] = {
+        0x00, 0x00, 0x03, 0x01, 0xff,
+    };
+    NALBitReader br(kData, sizeof(kData));
+
+    ASSERT_EQ(0x000001u, br.getBits(24));
+    ASSERT_EQ(0xffu, br.getBits(8));
+}
+
+}  // namespace android
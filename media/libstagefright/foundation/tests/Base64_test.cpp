@@ -15,6 +15,8 @@
  */
 #include <utils/Log.h>
 
+#include <string.h>
+
 #include "gtest/gtest.h"
 
 #include <media/stagefright/foundation/ABuffer.h>
@@ -118,6 +120,27 @@ TEST_F(Base64Test, TestDecodeMalformedBase64) {
     }
 }
 
+TEST_F(Base64Test, TestDecodeBase64Ranges) {
+    const char *base64 = "SGVsbG8gRnJpZW5kIQ==";
+    const char *clearText = "Hello Friend!";
+    uint8_t out[15];
+
+    // Whole input.
+    ASSERT_EQ(decodeBase64(base64, 20, out), 13);
+    EXPECT_EQ(memcmp(out, clearText, 13), 0);
+
+    // Quanta decoded separately.
+    ASSERT_EQ(decodeBase64(base64, 8, out), 6);
+    EXPECT_EQ(memcmp(out, clearText, 6), 0);
+    ASSERT_EQ(decodeBase64(base64 + 8, 12, out), 7);
+    EXPECT_EQ(memcmp(out, clearText + 6, 7), 0);
+
+    // Length not a multiple of 4, or padding before the last quantum.
+    EXPECT_EQ(decodeBase64(base64, 18, out), -1);
+    EXPECT_EQ(decodeBase64("QQ==QUJD", 8, out), -1);
+    EXPECT_EQ(decodeBase64("QU=D", 4, out), -1);
+}
+
 TEST_F(Base64Test, TestEncodeBase64) {
     const AString clearText[] = {
         AString("Hello Friend!"),
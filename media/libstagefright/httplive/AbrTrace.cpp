@@ -0,0 +1,233 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AbrTrace"
+#include <utils/Log.h>
+
+#include "AbrTrace.h"
+
+#include <media/MediaAnalyticsItem.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+
+#include <inttypes.h>
+
+namespace android {
+
+static const char *kKeyHttpLive = "httplive";
+
+static const char *kHttpLiveSegments = "android.media.httplive.segments";
+static const char *kHttpLiveBytes = "android.media.httplive.bytes";
+static const char *kHttpLiveDownloadMs = "android.media.httplive.downloadMs";
+static const char *kHttpLiveThroughput = "android.media.httplive.throughputBps";
+static const char *kHttpLiveEstimate = "android.media.httplive.estimateBps";
+static const char *kHttpLiveVariant = "android.media.httplive.variantBps";
+static const char *kHttpLiveUpSwitches = "android.media.httplive.upSwitches";
+static const char *kHttpLiveDownSwitches = "android.media.httplive.downSwitches";
+static const char *kHttpLiveFallbacks = "android.media.httplive.fallbacks";
+static const char *kHttpLiveCanceled = "android.media.httplive.canceledSwitches";
+// the most recent entries of the ring, see appendEntry()
+static const char *kHttpLiveTrace = "android.media.httplive.trace";
+
+AbrTrace::AbrTrace()
+    : mStartTimeUs(ALooper::GetNowUs()),
+      mNextEntry(0),
+      mEstimatedBps(-1),
+      mBufferedUs(-1ll),
+      mVariantIndex(-1),
+      mVariantBps(-1),
+      mNumSegments(0),
+      mTotalBytes(0),
+      mTotalDelayUs(0) {
+    for (size_t i = 0; i <= kReasonCompleted; ++i) {
+        mNumSwitches[i] = 0;
+    }
+}
+
+AbrTrace::~AbrTrace() {
+}
+
+// static
+const char *AbrTrace::reasonString(SwitchReason reason) {
+    switch (reason) {
+        case kReasonInitial:    return "initial";
+        case kReasonUp:         return "up";
+        case kReasonDown:       return "down";
+        case kReasonFallback:   return "fallback";
+        case kReasonCanceled:   return "canceled";
+        case kReasonCompleted:  return "completed";
+        default:                return "unknown";
+    }
+}
+
+void AbrTrace::setSessionState(
+        int32_t estimatedBps, int64_t bufferedUs,
+        ssize_t variantIndex, int32_t variantBps) {
+    Mutex::Autolock autoLock(mLock);
+
+    mEstimatedBps = estimatedBps;
+    mBufferedUs = bufferedUs;
+    mVariantIndex = variantIndex;
+    mVariantBps = variantBps;
+}
+
+void AbrTrace::addSegment(size_t numBytes, int64_t delayUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    Entry entry;
+    entry.mType = kEntrySegment;
+    entry.mTimeUs = ALooper::GetNowUs();
+    entry.mEstimatedBps = mEstimatedBps;
+    entry.mBufferedUs = mBufferedUs;
+    entry.mVariantIndex = mVariantIndex;
+    entry.mNumBytes = numBytes;
+    entry.mDelayUs = delayUs;
+    entry.mReason = kReasonInitial;
+    entry.mFromIndex = -1;
+    addEntry_l(entry);
+
+    ++mNumSegments;
+    mTotalBytes += numBytes;
+    mTotalDelayUs += delayUs;
+}
+
+void AbrTrace::addSwitch(
+        SwitchReason reason, ssize_t fromIndex, ssize_t toIndex,
+        int32_t estimatedBps, int64_t bufferedUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    Entry entry;
+    entry.mType = kEntrySwitch;
+    entry.mTimeUs = ALooper::GetNowUs();
+    entry.mEstimatedBps = estimatedBps;
+    entry.mBufferedUs = bufferedUs;
+    entry.mVariantIndex = toIndex;
+    entry.mNumBytes = 0;
+    entry.mDelayUs = 0;
+    entry.mReason = reason;
+    entry.mFromIndex = fromIndex;
+    addEntry_l(entry);
+
+    ++mNumSwitches[reason];
+}
+
+void AbrTrace::addEntry_l(const Entry &entry) {
+    if (mEntries.size() < kMaxEntries) {
+        mEntries.push(entry);
+    } else {
+        mEntries.editItemAt(mNextEntry) = entry;
+    }
+    mNextEntry = (mNextEntry + 1) % kMaxEntries;
+}
+
+// Entries in chronological order.
+const AbrTrace::Entry &AbrTrace::entryAt_l(size_t index) const {
+    CHECK_LT(index, mEntries.size());
+    if (mEntries.size() < kMaxEntries) {
+        return mEntries.itemAt(index);
+    }
+    return mEntries.itemAt((mNextEntry + index) % kMaxEntries);
+}
+
+// static
+void AbrTrace::appendEntry(
+        AString *out, const Entry &entry, int64_t startTimeUs) {
+    char buf[160];
+    if (entry.mType == kEntrySegment) {
+        snprintf(buf, sizeof(buf),
+                "%.3f seg bytes=%zu ms=%" PRId64 " bps=%" PRId64
+                " est=%d buf=%" PRId64 "ms var=%zd",
+                (entry.mTimeUs - startTimeUs) / 1E6,
+                entry.mNumBytes,
+                entry.mDelayUs / 1000,
+                entry.mDelayUs > 0
+                        ? (int64_t)(entry.mNumBytes * 8E6 / entry.mDelayUs) : (int64_t)-1,
+                entry.mEstimatedBps,
+                entry.mBufferedUs < 0 ? (int64_t)-1 : entry.mBufferedUs / 1000,
+                entry.mVariantIndex);
+    } else {
+        snprintf(buf, sizeof(buf),
+                "%.3f switch %s %zd=>%zd est=%d buf=%" PRId64 "ms",
+                (entry.mTimeUs - startTimeUs) / 1E6,
+                reasonString(entry.mReason),
+                entry.mFromIndex,
+                entry.mVariantIndex,
+                entry.mEstimatedBps,
+                entry.mBufferedUs < 0 ? (int64_t)-1 : entry.mBufferedUs / 1000);
+    }
+    out->append(buf);
+}
+
+void AbrTrace::dump(AString *logString) const {
+    Mutex::Autolock autoLock(mLock);
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+            "  HLS: segments(%" PRId64 "), bytes(%" PRId64 "), "
+            "estimate(%d bps), variant(%zd @ %d bps)\n"
+            "    switches: up(%d), down(%d), fallback(%d), canceled(%d)\n",
+            mNumSegments, mTotalBytes, mEstimatedBps, mVariantIndex, mVariantBps,
+            mNumSwitches[kReasonUp], mNumSwitches[kReasonDown],
+            mNumSwitches[kReasonFallback], mNumSwitches[kReasonCanceled]);
+    logString->append(buf);
+
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        logString->append("    ");
+        appendEntry(logString, entryAt_l(i), mStartTimeUs);
+        logString->append("\n");
+    }
+}
+
+void AbrTrace::record() const {
+    if (!MediaAnalyticsItem::isEnabled()) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (mNumSegments == 0) {
+        ALOGV("nothing to record");
+        return;
+    }
+
+    MediaAnalyticsItem item(kKeyHttpLive);
+    item.setInt64(kHttpLiveSegments, mNumSegments);
+    item.setInt64(kHttpLiveBytes, mTotalBytes);
+    item.setInt64(kHttpLiveDownloadMs, mTotalDelayUs / 1000);
+    if (mTotalDelayUs > 0) {
+        item.setInt64(kHttpLiveThroughput, (int64_t)(mTotalBytes * 8E6 / mTotalDelayUs));
+    }
+    item.setInt32(kHttpLiveEstimate, mEstimatedBps);
+    item.setInt32(kHttpLiveVariant, mVariantBps);
+    item.setInt32(kHttpLiveUpSwitches, mNumSwitches[kReasonUp]);
+    item.setInt32(kHttpLiveDownSwitches, mNumSwitches[kReasonDown]);
+    item.setInt32(kHttpLiveFallbacks, mNumSwitches[kReasonFallback]);
+    item.setInt32(kHttpLiveCanceled, mNumSwitches[kReasonCanceled]);
+
+    AString trace;
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        if (i > 0) {
+            trace.append(";");
+        }
+        appendEntry(&trace, entryAt_l(i), mStartTimeUs);
+    }
+    item.setCString(kHttpLiveTrace, trace.c_str());
+
+    item.selfrecord();
+}
+
+}  // namespace android
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ABR_TRACE_H_
+
+#define ABR_TRACE_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Records the segment downloads and variant switches of a LiveSession in a
+// ring buffer, for dumpsys and for a MediaAnalyticsItem submitted when the
+// session is torn down. Segment downloads are reported from the fetcher
+// threads, everything else from the session's looper.
+struct AbrTrace : public RefBase {
+    enum SwitchReason {
+        kReasonInitial,
+        kReasonUp,
+        kReasonDown,
+        kReasonFallback,
+        kReasonCanceled,
+        kReasonCompleted,
+    };
+
+    AbrTrace();
+
+    // Latest view of the session, attached to subsequent segment entries.
+    void setSessionState(
+            int32_t estimatedBps, int64_t bufferedUs,
+            ssize_t variantIndex, int32_t variantBps);
+
+    void addSegment(size_t numBytes, int64_t delayUs);
+    void addSwitch(
+            SwitchReason reason, ssize_t fromIndex, ssize_t toIndex,
+            int32_t estimatedBps, int64_t bufferedUs);
+
+    void dump(AString *logString) const;
+
+    // Submits the session totals and the entries still in the ring.
+    void record() const;
+
+    static const char *reasonString(SwitchReason reason);
+
+protected:
+    virtual ~AbrTrace();
+
+private:
+    enum {
+        kMaxEntries = 64,
+    };
+
+    enum EntryType {
+        kEntrySegment,
+        kEntrySwitch,
+    };
+
+    struct Entry {
+        EntryType mType;
+        int64_t mTimeUs;
+        int32_t mEstimatedBps;
+        int64_t mBufferedUs;
+        ssize_t mVariantIndex;
+        // segment
+        size_t mNumBytes;
+        int64_t mDelayUs;
+        // switch
+        SwitchReason mReason;
+        ssize_t mFromIndex;
+    };
+
+    mutable Mutex mLock;
+    int64_t mStartTimeUs;
+    Vector<Entry> mEntries;
+    size_t mNextEntry;
+
+    int32_t mEstimatedBps;
+    int64_t mBufferedUs;
+    ssize_t mVariantIndex;
+    int32_t mVariantBps;
+
+    int64_t mNumSegments;
+    int64_t mTotalBytes;
+    int64_t mTotalDelayUs;
+    int32_t mNumSwitches[kReasonCompleted + 1];
+
+    void addEntry_l(const Entry &entry);
+    const Entry &entryAt_l(size_t index) const;
+    static void appendEntry(AString *out, const Entry &entry, int64_t startTimeUs);
+
+    DISALLOW_EVIL_CONSTRUCTORS(AbrTrace);
+};
+
+}  // namespace android
+
+#endif  // ABR_TRACE_H_
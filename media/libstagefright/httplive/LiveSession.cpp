@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "LiveSession.h"
+#include "AbrTrace.h"
 #include "HTTPDownloader.h"
 #include "M3UParser.h"
 #include "PlaylistFetcher.h"
@@ -287,6 +288,7 @@ LiveSession::LiveSession(
       mLastBandwidthBps(-1ll),
       mLastBandwidthStable(false),
       mBandwidthEstimator(new BandwidthEstimator()),
+      mAbrTrace(new AbrTrace()),
       mMaxWidth(720),
       mMaxHeight(480),
       mStreamMask(0),
@@ -301,6 +303,8 @@ LiveSession::LiveSession(
       mUpSwitchMark(kUpSwitchMarkUs),
       mDownSwitchMark(kDownSwitchMarkUs),
       mUpSwitchMargin(kUpSwitchMarginUs),
+      mPartHoldBackUs(-1ll),
+      mLastBufferedDurationUs(-1ll),
       mFirstTimeUsValid(false),
       mFirstTimeUs(0),
       mLastSeekTimeUs(0),
@@ -485,6 +489,13 @@ status_t LiveSession::getStreamFormatMeta(StreamType stream, sp<MetaData> *meta)
     } else if (stream == STREAMTYPE_VIDEO) {
         (*meta)->setInt32(kKeyMaxWidth, mMaxWidth);
         (*meta)->setInt32(kKeyMaxHeight, mMaxHeight);
+
+        // size the input buffers for a key frame of the largest variant
+        // (half of a raw 4:2:0 frame), so they need not grow on a switch
+        int32_t maxInputSize = 0;
+        (*meta)->findInt32(kKeyMaxInputSize, &maxInputSize);
+        (*meta)->setInt32(kKeyMaxInputSize,
+                max(maxInputSize, mMaxWidth * mMaxHeight * 3 / 4));
     }
 
     return OK;
@@ -732,6 +743,15 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
                 {
                     int64_t targetDurationUs;
                     CHECK(msg->findInt64("targetDurationUs", &targetDurationUs));
+
+                    // Low-latency playlists are played within PART-HOLD-BACK of
+                    // the live edge, so that's all that can be buffered instead
+                    // of about three target durations.
+                    if (msg->findInt64("partHoldBackUs", &mPartHoldBackUs)) {
+                        targetDurationUs = mPartHoldBackUs / 3;
+                    } else {
+                        mPartHoldBackUs = -1ll;
+                    }
                     mUpSwitchMark = min(kUpSwitchMarkUs, targetDurationUs * 7 / 4);
                     mDownSwitchMark = min(kDownSwitchMarkUs, targetDurationUs * 9 / 4);
                     mUpSwitchMargin = min(kUpSwitchMarginUs, targetDurationUs);
@@ -1053,6 +1073,7 @@ void LiveSession::onMasterPlaylistFetched(const sp<AMessage> &msg) {
 
     int32_t maxWidth = 0;
     int32_t maxHeight = 0;
+    bool missingResolution = false;
 
     if (mPlaylist->isVariantPlaylist()) {
         Vector<BandwidthItem> itemsWithVideo;
@@ -1069,11 +1090,12 @@ void LiveSession::onMasterPlaylistFetched(const sp<AMessage> &msg) {
             CHECK(meta->findInt32("bandwidth", (int32_t *)&item.mBandwidth));
 
             int32_t width, height;
-            if (meta->findInt32("width", &width)) {
+            if (meta->findInt32("width", &width)
+                    && meta->findInt32("height", &height)) {
                 maxWidth = max(maxWidth, width);
-            }
-            if (meta->findInt32("height", &height)) {
                 maxHeight = max(maxHeight, height);
+            } else if (mPlaylist->hasType(i, "video")) {
+                missingResolution = true;
             }
 
             mBandwidthItems.push(item);
@@ -1109,10 +1131,21 @@ void LiveSession::onMasterPlaylistFetched(const sp<AMessage> &msg) {
         mBandwidthItems.push(item);
     }
 
-    mMaxWidth = maxWidth > 0 ? maxWidth : mMaxWidth;
-    mMaxHeight = maxHeight > 0 ? maxHeight : mMaxHeight;
+    // The decoder is prepared for adaptive playback at this size, so that
+    // switching between variants does not reallocate its output buffers.
+    // Variants that don't advertise a resolution may be larger than the
+    // ones that do, so never go below the default for them.
+    if (missingResolution) {
+        mMaxWidth = max(mMaxWidth, maxWidth);
+        mMaxHeight = max(mMaxHeight, maxHeight);
+    } else {
+        mMaxWidth = maxWidth > 0 ? maxWidth : mMaxWidth;
+        mMaxHeight = maxHeight > 0 ? maxHeight : mMaxHeight;
+    }
 
     mPlaylist->pickRandomMediaItems();
+    mAbrTrace->addSwitch(AbrTrace::kReasonInitial,
+            -1, initialBandwidthIndex, -1, -1ll);
     changeConfiguration(
             0ll /* timeUs */, initialBandwidthIndex, false /* pickTrack */);
 }
@@ -1124,6 +1157,8 @@ void LiveSession::finishDisconnect() {
     // during disconnection either.
     cancelBandwidthSwitch();
 
+    mAbrTrace->record();
+
     // cancel buffer polling
     cancelPollBuffering();
 
@@ -1330,6 +1365,18 @@ float LiveSession::getAbortThreshold(
 
 void LiveSession::addBandwidthMeasurement(size_t numBytes, int64_t delayUs) {
     mBandwidthEstimator->addBandwidthMeasurement(numBytes, delayUs);
+    mAbrTrace->addSegment(numBytes, delayUs);
+}
+
+void LiveSession::dumpAbrTrace(AString *logString) const {
+    mAbrTrace->dump(logString);
+}
+
+void LiveSession::updateAbrTrace() {
+    mAbrTrace->setSessionState(
+            mLastBandwidthBps, mLastBufferedDurationUs, mCurBandwidthIndex,
+            mCurBandwidthIndex >= 0
+                    ? (int32_t)mBandwidthItems.itemAt(mCurBandwidthIndex).mBandwidth : -1);
 }
 
 ssize_t LiveSession::getLowestValidBandwidthIndex() const {
@@ -2051,6 +2098,9 @@ void LiveSession::tryToFinishBandwidthSwitch(const AString &oldUri) {
 
     ALOGI("#### Finished Bandwidth Switch: %zd => %zd",
             mOrigBandwidthIndex, mCurBandwidthIndex);
+    mAbrTrace->addSwitch(AbrTrace::kReasonCompleted,
+            mOrigBandwidthIndex, mCurBandwidthIndex,
+            mLastBandwidthBps, mLastBufferedDurationUs);
 
     mStreamMask = mNewStreamMask;
     mSwitchInProgress = false;
@@ -2149,6 +2199,9 @@ void LiveSession::cancelBandwidthSwitch(bool resume) {
 
     ALOGI("#### Canceled Bandwidth Switch: %zd => %zd",
             mOrigBandwidthIndex, mCurBandwidthIndex);
+    mAbrTrace->addSwitch(AbrTrace::kReasonCanceled,
+            mCurBandwidthIndex, mOrigBandwidthIndex,
+            mLastBandwidthBps, mLastBufferedDurationUs);
 
     mSwitchGeneration++;
     mSwitchInProgress = false;
@@ -2168,6 +2221,7 @@ bool LiveSession::checkBuffering(
     size_t activeCount, underflowCount, readyCount, downCount, upCount;
     activeCount = underflowCount = readyCount = downCount = upCount =0;
     int32_t minBufferPercent = -1;
+    int64_t minBufferedDurationUs = -1ll;
     int64_t durationUs;
     if (getDuration(&durationUs) != OK) {
         durationUs = -1;
@@ -2191,6 +2245,9 @@ bool LiveSession::checkBuffering(
         ALOGV("[%s] buffered %lld us",
                 getNameForStream(mPacketSources.keyAt(i)),
                 (long long)bufferedDurationUs);
+        if (minBufferedDurationUs < 0 || bufferedDurationUs < minBufferedDurationUs) {
+            minBufferedDurationUs = bufferedDurationUs;
+        }
         if (durationUs >= 0) {
             int32_t percent;
             if (mPacketSources[i]->isFinished(0 /* duration */)) {
@@ -2209,6 +2266,9 @@ bool LiveSession::checkBuffering(
             (mInPreparationPhase ?
                 mBufferingSettings.mInitialMarkMs :
                 mBufferingSettings.mResumePlaybackMarkMs) * 1000ll;
+        if (mPartHoldBackUs > 0 && readyMarkUs > mPartHoldBackUs) {
+            readyMarkUs = mPartHoldBackUs;
+        }
         if (bufferedDurationUs > readyMarkUs
                 || mPacketSources[i]->isFinished(0)) {
             ++readyCount;
@@ -2230,6 +2290,9 @@ bool LiveSession::checkBuffering(
         notifyBufferingUpdate(minBufferPercent);
     }
 
+    mLastBufferedDurationUs = minBufferedDurationUs;
+    updateAbrTrace();
+
     if (activeCount > 0) {
         up        = (upCount == activeCount);
         down      = (downCount > 0);
@@ -2291,6 +2354,9 @@ bool LiveSession::tryBandwidthFallback() {
     }
     if (mCurBandwidthIndex > mOrigBandwidthIndex) {
         // if we're switching up, simply cancel and resume old variant
+        mAbrTrace->addSwitch(AbrTrace::kReasonFallback,
+                mCurBandwidthIndex, mOrigBandwidthIndex,
+                mLastBandwidthBps, mLastBufferedDurationUs);
         cancelBandwidthSwitch(true /* resume */);
         return true;
     } else {
@@ -2299,6 +2365,9 @@ bool LiveSession::tryBandwidthFallback() {
         // not on that variant already.
         ssize_t lowestValid = getLowestValidBandwidthIndex();
         if (mCurBandwidthIndex > lowestValid) {
+            mAbrTrace->addSwitch(AbrTrace::kReasonFallback,
+                    mCurBandwidthIndex, lowestValid,
+                    mLastBandwidthBps, mLastBufferedDurationUs);
             cancelBandwidthSwitch();
             changeConfiguration(-1ll, lowestValid);
             return true;
@@ -2367,6 +2436,11 @@ bool LiveSession::switchBandwidthIfNeeded(bool bufferHigh, bool bufferLow) {
         // both enough buffer and enough bw.
         if ((canSwitchUp && bandwidthIndex > mCurBandwidthIndex)
          || (canSwitchDown && bandwidthIndex < mCurBandwidthIndex)) {
+            mAbrTrace->addSwitch(
+                    canSwitchUp ? AbrTrace::kReasonUp : AbrTrace::kReasonDown,
+                    mCurBandwidthIndex, bandwidthIndex,
+                    bandwidthBps, mLastBufferedDurationUs);
+
             // if not yet prepared, just restart again with new bw index.
             // this is faster and playback experience is cleaner.
             changeConfiguration(
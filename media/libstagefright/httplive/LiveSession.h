@@ -29,6 +29,7 @@
 namespace android {
 
 struct ABuffer;
+struct AbrTrace;
 struct AReplyToken;
 struct AnotherPacketSource;
 class DataSource;
@@ -100,6 +101,9 @@ struct LiveSession : public AHandler {
     bool isSeekable() const;
     bool hasDynamicDuration() const;
 
+    // Appends the recent segment downloads and variant switches.
+    void dumpAbrTrace(AString *logString) const;
+
     static const char *getKeyForStream(StreamType type);
     static const char *getNameForStream(StreamType type);
     static ATSParser::SourceType getSourceTypeForStream(StreamType type);
@@ -121,6 +125,7 @@ protected:
     virtual void onMessageReceived(const sp<AMessage> &msg);
 
     friend struct PlaylistFetcher;
+    friend struct SegmentPrefetcher;
 
     enum {
         kWhatConnect                    = 'conn',
@@ -211,6 +216,7 @@ protected:
     int32_t mLastBandwidthBps;
     bool mLastBandwidthStable;
     sp<BandwidthBaseEstimator> mBandwidthEstimator;
+    sp<AbrTrace> mAbrTrace;
 
     sp<M3UParser> mPlaylist;
     int32_t mMaxWidth;
@@ -248,6 +254,10 @@ protected:
     int64_t mUpSwitchMark;
     int64_t mDownSwitchMark;
     int64_t mUpSwitchMargin;
+    // PART-HOLD-BACK of a low-latency playlist, -1 otherwise.
+    int64_t mPartHoldBackUs;
+    // Lowest buffered duration across active streams at the last poll.
+    int64_t mLastBufferedDurationUs;
 
     sp<AReplyToken> mDisconnectReplyID;
     sp<AReplyToken> mSeekReplyID;
@@ -278,6 +288,7 @@ protected:
     float getAbortThreshold(
             ssize_t currentBWIndex, ssize_t targetBWIndex) const;
     void addBandwidthMeasurement(size_t numBytes, int64_t delayUs);
+    void updateAbrTrace();
     virtual size_t getBandwidthIndex(int32_t bandwidthBps);
     ssize_t getLowestValidBandwidthIndex() const;
     HLSTime latestMediaSegmentStartTime() const;
@@ -261,6 +261,11 @@ M3UParser::M3UParser(
       mTargetDurationUs(-1ll),
       mDiscontinuitySeq(0),
       mDiscontinuityCount(0),
+      mIsEncrypted(false),
+      mPartTargetDurationUs(-1ll),
+      mPartHoldBackUs(-1ll),
+      mCanBlockReload(false),
+      mHasPreloadHint(false),
       mSelectedIndex(-1) {
     mInitCheck = parse(data, size);
 }
@@ -305,6 +310,92 @@ void M3UParser::getSeqNumberRange(int32_t *firstSeq, int32_t *lastSeq) const {
     *lastSeq = mLastSeqNumber;
 }
 
+bool M3UParser::isEncrypted() const {
+    return mIsEncrypted;
+}
+
+int64_t M3UParser::getPartTargetDuration() const {
+    return mPartTargetDurationUs;
+}
+
+int64_t M3UParser::getPartHoldBack() const {
+    return mPartHoldBackUs;
+}
+
+bool M3UParser::canBlockReload() const {
+    return mCanBlockReload;
+}
+
+size_t M3UParser::getPartCount(int32_t seqNumber) const {
+    if (seqNumber < mFirstSeqNumber) {
+        return 0;
+    }
+
+    size_t itemIndex = seqNumber - mFirstSeqNumber;
+    size_t count = 0;
+    for (size_t i = 0; i < mParts.size(); ++i) {
+        if (mParts[i].mItemIndex == itemIndex) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+bool M3UParser::partAt(
+        int32_t seqNumber, size_t index, AString *uri, sp<AMessage> *meta) const {
+    if (uri) {
+        uri->clear();
+    }
+
+    if (meta) {
+        *meta = NULL;
+    }
+
+    if (seqNumber < mFirstSeqNumber) {
+        return false;
+    }
+
+    size_t itemIndex = seqNumber - mFirstSeqNumber;
+    for (size_t i = 0; i < mParts.size(); ++i) {
+        const Part &part = mParts[i];
+        if (part.mItemIndex != itemIndex || part.mPartIndex != index) {
+            continue;
+        }
+
+        if (uri) {
+            CHECK(MakeURL(mBaseURI.c_str(), part.mURI.c_str(), uri));
+        }
+
+        if (meta) {
+            *meta = part.mMeta;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool M3UParser::getPreloadHint(
+        int32_t *seqNumber, size_t *index, AString *uri, sp<AMessage> *meta) const {
+    if (!mHasPreloadHint) {
+        return false;
+    }
+
+    *seqNumber = mFirstSeqNumber + mPreloadHint.mItemIndex;
+    *index = mPreloadHint.mPartIndex;
+
+    if (uri) {
+        CHECK(MakeURL(mBaseURI.c_str(), mPreloadHint.mURI.c_str(), uri));
+    }
+
+    if (meta) {
+        *meta = mPreloadHint.mMeta;
+    }
+
+    return true;
+}
+
 sp<AMessage> M3UParser::meta() {
     return mMeta;
 }
@@ -573,6 +664,7 @@ status_t M3UParser::parse(const void *_data, size_t size) {
     const char *data = (const char *)_data;
     size_t offset = 0;
     uint64_t segmentRangeOffset = 0;
+    uint64_t partRangeOffset = 0;
     while (offset < size) {
         size_t offsetLF = offset;
         while (offsetLF < size && data[offsetLF] != '\n') {
@@ -615,6 +707,12 @@ status_t M3UParser::parse(const void *_data, size_t size) {
                     return ERROR_MALFORMED;
                 }
                 err = parseCipherInfo(line, &itemMeta, mBaseURI);
+
+                AString method;
+                if (err == OK && itemMeta->findString("cipher-method", &method)
+                        && method != "NONE") {
+                    mIsEncrypted = true;
+                }
             } else if (line.startsWith("#EXT-X-ENDLIST")) {
                 mIsComplete = true;
             } else if (line.startsWith("#EXT-X-PLAYLIST-TYPE:EVENT")) {
@@ -671,6 +769,23 @@ status_t M3UParser::parse(const void *_data, size_t size) {
                 }
             } else if (line.startsWith("#EXT-X-MEDIA")) {
                 err = parseMedia(line);
+            } else if (line.startsWith("#EXT-X-SERVER-CONTROL")) {
+                err = parseServerControl(line);
+            } else if (line.startsWith("#EXT-X-PART-INF")) {
+                if (mIsVariantPlaylist) {
+                    return ERROR_MALFORMED;
+                }
+                err = parsePartInf(line);
+            } else if (line.startsWith("#EXT-X-PART")) {
+                if (mIsVariantPlaylist) {
+                    return ERROR_MALFORMED;
+                }
+                err = parsePart(line, itemMeta, &partRangeOffset);
+            } else if (line.startsWith("#EXT-X-PRELOAD-HINT")) {
+                if (mIsVariantPlaylist) {
+                    return ERROR_MALFORMED;
+                }
+                err = parsePreloadHint(line);
             }
 
             if (err != OK) {
@@ -723,6 +838,17 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             mMeta->findInt32("media-sequence", &mFirstSeqNumber);
         }
         mLastSeqNumber = mFirstSeqNumber + mItems.size() - 1;
+
+        if (!mParts.isEmpty() && mPartTargetDurationUs < 0) {
+            ALOGW("Media playlist with parts missing #EXT-X-PART-INF, ignoring parts");
+            mParts.clear();
+            mHasPreloadHint = false;
+        }
+        if (mPartTargetDurationUs >= 0 && mPartHoldBackUs < 0) {
+            // Servers must not advertise less than twice the part target,
+            // three times is what's recommended.
+            mPartHoldBackUs = mPartTargetDurationUs * 3;
+        }
     }
 
     for (size_t i = 0; i < mItems.size(); ++i) {
@@ -1042,6 +1168,221 @@ status_t M3UParser::parseByteRange(
     return OK;
 }
 
+// static
+status_t M3UParser::parseAttributeList(
+        const AString &line, KeyedVector<AString, AString> *attrs) {
+    ssize_t colonPos = line.find(":");
+
+    if (colonPos < 0) {
+        return ERROR_MALFORMED;
+    }
+
+    size_t offset = colonPos + 1;
+
+    while (offset < line.size()) {
+        ssize_t end = FindNextUnquoted(line, ',', offset);
+        if (end < 0) {
+            end = line.size();
+        }
+
+        AString attr(line, offset, end - offset);
+        attr.trim();
+
+        offset = end + 1;
+
+        ssize_t equalPos = attr.find("=");
+        if (equalPos < 0) {
+            continue;
+        }
+
+        AString key(attr, 0, equalPos);
+        key.trim();
+
+        AString val(attr, equalPos + 1, attr.size() - equalPos - 1);
+        val.trim();
+
+        ALOGV("key=%s value=%s", key.c_str(), val.c_str());
+
+        key.tolower();
+        attrs->add(key, val);
+    }
+
+    return OK;
+}
+
+status_t M3UParser::parseServerControl(const AString &line) {
+    KeyedVector<AString, AString> attrs;
+    status_t err = parseAttributeList(line, &attrs);
+    if (err != OK) {
+        return err;
+    }
+
+    ssize_t index = attrs.indexOfKey(AString("can-block-reload"));
+    if (index >= 0) {
+        mCanBlockReload = !strcasecmp(attrs.valueAt(index).c_str(), "YES");
+    }
+
+    index = attrs.indexOfKey(AString("part-hold-back"));
+    if (index >= 0) {
+        double x;
+        err = ParseDouble(attrs.valueAt(index).c_str(), &x);
+        if (err != OK) {
+            return err;
+        }
+        mPartHoldBackUs = (int64_t)(x * 1E6);
+    }
+
+    return OK;
+}
+
+status_t M3UParser::parsePartInf(const AString &line) {
+    KeyedVector<AString, AString> attrs;
+    status_t err = parseAttributeList(line, &attrs);
+    if (err != OK) {
+        return err;
+    }
+
+    ssize_t index = attrs.indexOfKey(AString("part-target"));
+    if (index < 0) {
+        ALOGE("EXT-X-PART-INF without PART-TARGET.");
+        return ERROR_MALFORMED;
+    }
+
+    double x;
+    err = ParseDouble(attrs.valueAt(index).c_str(), &x);
+    if (err != OK) {
+        return err;
+    }
+    mPartTargetDurationUs = (int64_t)(x * 1E6);
+
+    return OK;
+}
+
+status_t M3UParser::parsePart(
+        const AString &line, const sp<AMessage> &itemMeta,
+        uint64_t *partRangeOffset) {
+    KeyedVector<AString, AString> attrs;
+    status_t err = parseAttributeList(line, &attrs);
+    if (err != OK) {
+        return err;
+    }
+
+    ssize_t uriIndex = attrs.indexOfKey(AString("uri"));
+    ssize_t durationIndex = attrs.indexOfKey(AString("duration"));
+    if (uriIndex < 0 || durationIndex < 0) {
+        ALOGE("Incomplete EXT-X-PART element.");
+        return ERROR_MALFORMED;
+    }
+
+    double x;
+    err = ParseDouble(attrs.valueAt(durationIndex).c_str(), &x);
+    if (err != OK) {
+        return err;
+    }
+
+    Part part;
+    part.mItemIndex = mItems.size();
+    part.mPartIndex = 0;
+    if (!mParts.isEmpty() && mParts.top().mItemIndex == part.mItemIndex) {
+        part.mPartIndex = mParts.top().mPartIndex + 1;
+    }
+    part.mURI = unquoteString(attrs.valueAt(uriIndex));
+    part.mMeta = new AMessage;
+    part.mMeta->setInt64("durationUs", (int64_t)(x * 1E6));
+    part.mMeta->setInt32("discontinuity-sequence",
+            mDiscontinuitySeq + mDiscontinuityCount);
+
+    // The first part of a segment carries the segment's discontinuity.
+    int32_t val;
+    if (part.mPartIndex == 0 && itemMeta != NULL
+            && itemMeta->findInt32("discontinuity", &val) && val != 0) {
+        part.mMeta->setInt32("discontinuity", true);
+    }
+
+    ssize_t index = attrs.indexOfKey(AString("independent"));
+    if (index >= 0 && !strcasecmp(attrs.valueAt(index).c_str(), "YES")) {
+        part.mMeta->setInt32("independent", true);
+    }
+
+    index = attrs.indexOfKey(AString("gap"));
+    if (index >= 0 && !strcasecmp(attrs.valueAt(index).c_str(), "YES")) {
+        part.mMeta->setInt32("gap", true);
+    }
+
+    index = attrs.indexOfKey(AString("byterange"));
+    if (index >= 0) {
+        if (part.mPartIndex == 0) {
+            *partRangeOffset = 0;
+        }
+
+        AString range("BYTERANGE:");
+        range.append(unquoteString(attrs.valueAt(index)));
+
+        uint64_t length, offset;
+        err = parseByteRange(range, *partRangeOffset, &length, &offset);
+        if (err != OK) {
+            return err;
+        }
+
+        part.mMeta->setInt64("range-offset", offset);
+        part.mMeta->setInt64("range-length", length);
+
+        *partRangeOffset = offset + length;
+    }
+
+    mParts.push(part);
+
+    return OK;
+}
+
+status_t M3UParser::parsePreloadHint(const AString &line) {
+    KeyedVector<AString, AString> attrs;
+    status_t err = parseAttributeList(line, &attrs);
+    if (err != OK) {
+        return err;
+    }
+
+    ssize_t typeIndex = attrs.indexOfKey(AString("type"));
+    ssize_t uriIndex = attrs.indexOfKey(AString("uri"));
+    if (typeIndex < 0 || uriIndex < 0) {
+        ALOGE("Incomplete EXT-X-PRELOAD-HINT element.");
+        return ERROR_MALFORMED;
+    }
+
+    if (strcasecmp(attrs.valueAt(typeIndex).c_str(), "PART")) {
+        // Only hints for parts are used.
+        return OK;
+    }
+
+    mPreloadHint.mItemIndex = mItems.size();
+    mPreloadHint.mPartIndex = 0;
+    if (!mParts.isEmpty() && mParts.top().mItemIndex == mPreloadHint.mItemIndex) {
+        mPreloadHint.mPartIndex = mParts.top().mPartIndex + 1;
+    }
+    mPreloadHint.mURI = unquoteString(attrs.valueAt(uriIndex));
+    mPreloadHint.mMeta = new AMessage;
+    mPreloadHint.mMeta->setInt32("discontinuity-sequence",
+            mDiscontinuitySeq + mDiscontinuityCount);
+
+    int64_t rangeOffset = 0, rangeLength = -1;
+    ssize_t index = attrs.indexOfKey(AString("byterange-start"));
+    if (index >= 0) {
+        rangeOffset = strtoll(attrs.valueAt(index).c_str(), NULL, 10);
+    }
+    index = attrs.indexOfKey(AString("byterange-length"));
+    if (index >= 0) {
+        rangeLength = strtoll(attrs.valueAt(index).c_str(), NULL, 10);
+    }
+    if (rangeOffset > 0 || rangeLength >= 0) {
+        mPreloadHint.mMeta->setInt64("range-offset", rangeOffset);
+        mPreloadHint.mMeta->setInt64("range-length", rangeLength);
+    }
+
+    mHasPreloadHint = true;
+
+    return OK;
+}
+
 status_t M3UParser::parseMedia(const AString &line) {
     ssize_t colonPos = line.find(":");
 
@@ -39,6 +39,19 @@ struct M3UParser : public RefBase {
     int64_t getTargetDuration() const;
     int32_t getFirstSeqNumber() const;
     void getSeqNumberRange(int32_t *firstSeq, int32_t *lastSeq) const;
+    bool isEncrypted() const;
+
+    // Low-latency HLS. Parts of the segment that is still being published
+    // belong to sequence number lastSeq + 1. The part target duration is -1
+    // for playlists without EXT-X-PART-INF.
+    int64_t getPartTargetDuration() const;
+    int64_t getPartHoldBack() const;
+    bool canBlockReload() const;
+    size_t getPartCount(int32_t seqNumber) const;
+    bool partAt(int32_t seqNumber, size_t index,
+            AString *uri, sp<AMessage> *meta = NULL) const;
+    bool getPreloadHint(int32_t *seqNumber, size_t *index,
+            AString *uri, sp<AMessage> *meta = NULL) const;
 
     sp<AMessage> meta();
 
@@ -67,6 +80,13 @@ private:
         AString makeURL(const char *baseURL) const;
     };
 
+    struct Part {
+        size_t mItemIndex;  // mItems.size() for the segment being published
+        size_t mPartIndex;
+        AString mURI;
+        sp<AMessage> mMeta;
+    };
+
     status_t mInitCheck;
 
     AString mBaseURI;
@@ -79,6 +99,14 @@ private:
     int64_t mTargetDurationUs;
     size_t mDiscontinuitySeq;
     int32_t mDiscontinuityCount;
+    bool mIsEncrypted;
+
+    int64_t mPartTargetDurationUs;
+    int64_t mPartHoldBackUs;
+    bool mCanBlockReload;
+    Vector<Part> mParts;
+    bool mHasPreloadHint;
+    Part mPreloadHint;
 
     sp<AMessage> mMeta;
     Vector<Item> mItems;
@@ -105,6 +133,16 @@ private:
             const AString &line, uint64_t curOffset,
             uint64_t *length, uint64_t *offset);
 
+    static status_t parseAttributeList(
+            const AString &line, KeyedVector<AString, AString> *attrs);
+
+    status_t parseServerControl(const AString &line);
+    status_t parsePartInf(const AString &line);
+    status_t parsePart(
+            const AString &line, const sp<AMessage> &itemMeta,
+            uint64_t *partRangeOffset);
+    status_t parsePreloadHint(const AString &line);
+
     status_t parseMedia(const AString &line);
 
     static status_t parseDiscontinuitySequence(const AString &line, size_t *seq);
@@ -23,6 +23,7 @@
 #include "HTTPDownloader.h"
 #include "LiveSession.h"
 #include "M3UParser.h"
+#include "SegmentPrefetcher.h"
 #include "include/ID3.h"
 #include "mpeg2ts/AnotherPacketSource.h"
 #include "mpeg2ts/HlsSampleDecryptor.h"
@@ -40,6 +41,7 @@
 #include <media/stagefright/Utils.h>
 #include <stagefright/AVExtensions.h>
 
+#include <cutils/properties.h>
 #include <ctype.h>
 #include <inttypes.h>
 
@@ -55,6 +57,16 @@ const int64_t PlaylistFetcher::kMaxMonitorDelayUs = 3000000ll;
 // LCM of 188 (size of a TS packet) & 1k works well
 const int32_t PlaylistFetcher::kDownloadBlockSize = 47 * 1024;
 
+// Number of upcoming segments fetched in parallel (0: off) and the number
+// of bytes they may hold.
+static const char *kPropPrefetchSegments = "media.httplive.prefetch-segments";
+static const char *kPropPrefetchBytes = "media.httplive.prefetch-bytes";
+static const int32_t kMaxPrefetchSegments = 8;
+static const int32_t kDefaultPrefetchBytes = 16 * 1024 * 1024;
+
+// Set to false to fetch low-latency playlists by whole segments.
+static const char *kPropLowLatency = "media.httplive.low-latency";
+
 struct PlaylistFetcher::DownloadState : public RefBase {
     DownloadState();
     void resetState();
@@ -148,6 +160,7 @@ PlaylistFetcher::PlaylistFetcher(
         int32_t id,
         int32_t subtitleGeneration)
     : mNotify(notify),
+      mPrefetchedSeqNumber(-1),
       mSession(session),
       mURI(uri),
       mFetcherID(id),
@@ -159,6 +172,12 @@ PlaylistFetcher::PlaylistFetcher(
       mLastPlaylistFetchTimeUs(-1ll),
       mPlaylistTimeUs(-1ll),
       mSeqNumber(-1),
+      mPartIndex(0),
+      mFetchingPart(false),
+      mPartIsPreloadHint(false),
+      mLowLatencyDisabled(!property_get_bool(kPropLowLatency, true)),
+      mBlockingReloadSeqNumber(-1),
+      mBlockingReloadPartIndex(-1),
       mNumRetries(0),
       mStartup(true),
       mIDRFound(false),
@@ -175,6 +194,7 @@ PlaylistFetcher::PlaylistFetcher(
       mFirstTimeUs(-1ll),
       mVideoBuffer(new AnotherPacketSource(NULL)),
       mAudioBuffer(new AnotherPacketSource(NULL)),
+      mAESKeyValid(false),
       mSampleAesKeyItemChanged(false),
       mThresholdRatio(-1.0f),
       mDownloadState(new DownloadState()),
@@ -182,11 +202,29 @@ PlaylistFetcher::PlaylistFetcher(
     memset(mPlaylistHash, 0, sizeof(mPlaylistHash));
     mHTTPDownloader = mSession->getHTTPDownloader();
 
+    int32_t prefetchSegments = property_get_int32(kPropPrefetchSegments, 0);
+    if (prefetchSegments > 0) {
+        if (prefetchSegments > kMaxPrefetchSegments) {
+            prefetchSegments = kMaxPrefetchSegments;
+        }
+        int32_t prefetchBytes =
+                property_get_int32(kPropPrefetchBytes, kDefaultPrefetchBytes);
+        mSegmentPrefetcher = new SegmentPrefetcher(
+                mSession, prefetchSegments, prefetchBytes > 0 ? prefetchBytes : 0);
+        if (mSegmentPrefetcher->start() != OK) {
+            mSegmentPrefetcher.clear();
+        }
+    }
+
     memset(mKeyData, 0, sizeof(mKeyData));
     memset(mAESInitVec, 0, sizeof(mAESInitVec));
+    memset(mAESKeyData, 0, sizeof(mAESKeyData));
 }
 
 PlaylistFetcher::~PlaylistFetcher() {
+    if (mSegmentPrefetcher != NULL) {
+        mSegmentPrefetcher->stop();
+    }
 }
 
 int32_t PlaylistFetcher::getFetcherID() const {
@@ -200,8 +238,9 @@ int64_t PlaylistFetcher::getSegmentStartTimeUs(int32_t seqNumber) const {
     mPlaylist->getSeqNumberRange(
             &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
 
+    // The segment being fetched as parts starts after the last one listed.
     CHECK_GE(seqNumber, firstSeqNumberInPlaylist);
-    CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
+    CHECK_LE(seqNumber, lastSeqNumberInPlaylist + (mFetchingPart ? 1 : 0));
 
     int64_t segmentStartUs = 0ll;
     for (int32_t index = 0;
@@ -227,6 +266,10 @@ int64_t PlaylistFetcher::getSegmentDurationUs(int32_t seqNumber) const {
             &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
 
     CHECK_GE(seqNumber, firstSeqNumberInPlaylist);
+    if (mFetchingPart && seqNumber == lastSeqNumberInPlaylist + 1) {
+        // Still being published, its duration is not known yet.
+        return mPlaylist->getTargetDuration();
+    }
     CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
 
     int32_t index = seqNumber - firstSeqNumberInPlaylist;
@@ -252,6 +295,15 @@ int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
         return (~0llu >> 1);
     }
 
+    int32_t seqNumber, partIndex;
+    if (getBlockingReloadTarget(&seqNumber, &partIndex)
+            && (seqNumber != mBlockingReloadSeqNumber
+                    || partIndex != mBlockingReloadPartIndex)) {
+        // The server holds the request until the part is available. If the
+        // last blocking reload didn't list it, fall back to polling.
+        return 0ll;
+    }
+
     int64_t targetDurationUs = mPlaylist->getTargetDuration();
 
     int64_t minPlaylistAgeUs;
@@ -297,6 +349,11 @@ int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
             break;
     }
 
+    // Parts are published about every part target duration.
+    if (isLowLatency() && minPlaylistAgeUs > mPlaylist->getPartTargetDuration()) {
+        minPlaylistAgeUs = mPlaylist->getPartTargetDuration();
+    }
+
     int64_t delayUs = mLastPlaylistFetchTimeUs + minPlaylistAgeUs - nowUs;
     return delayUs > 0ll ? delayUs : 0ll;
 }
@@ -308,7 +365,14 @@ status_t PlaylistFetcher::decryptBuffer(
     bool found = false;
     AString method;
 
-    for (ssize_t i = playlistIndex; i >= 0; --i) {
+    // The segment being fetched as parts has no item yet. Parts are only
+    // fetched from playlists without encryption.
+    ssize_t itemIndex = playlistIndex;
+    if (itemIndex >= (ssize_t)mPlaylist->size()) {
+        itemIndex = (ssize_t)mPlaylist->size() - 1;
+    }
+
+    for (ssize_t i = itemIndex; i >= 0; --i) {
         AString uri;
         CHECK(mPlaylist->itemAt(i, &uri, &itemMeta));
 
@@ -360,7 +424,10 @@ status_t PlaylistFetcher::decryptBuffer(
             return ERROR_MALFORMED;
         }
         key = new ABuffer(keyLen);
-        keySrc->readAt(0, key->data(), keyLen);
+        if (keySrc->readAt(0, key->data(), keyLen) != keyLen) {
+            ALOGE("Malformed cipher key data uri.");
+            return ERROR_MALFORMED;
+        }
         key->setRange(0, keyLen);
     } else {
         ssize_t err = mHTTPDownloader->fetchFile(keyURI.c_str(), &key);
@@ -451,10 +518,16 @@ status_t PlaylistFetcher::decryptBuffer(
     }
 
 
-    AES_KEY aes_key;
-    if (AES_set_decrypt_key(key->data(), 128, &aes_key) != 0) {
-        ALOGE("failed to set AES decryption key.");
-        return UNKNOWN_ERROR;
+    // A segment is decrypted chunk by chunk as it downloads, so keep the
+    // expanded key schedule around instead of rebuilding it for every chunk.
+    if (!mAESKeyValid || memcmp(mAESKeyData, key->data(), AES_BLOCK_SIZE) != 0) {
+        mAESKeyValid = false;
+        if (AES_set_decrypt_key(key->data(), 128, &mAESKey) != 0) {
+            ALOGE("failed to set AES decryption key.");
+            return UNKNOWN_ERROR;
+        }
+        memcpy(mAESKeyData, key->data(), AES_BLOCK_SIZE);
+        mAESKeyValid = true;
     }
 
     size_t n = buffer->size();
@@ -469,7 +542,7 @@ status_t PlaylistFetcher::decryptBuffer(
 
     AES_cbc_encrypt(
             buffer->data(), buffer->data(), buffer->size(),
-            &aes_key, mAESInitVec, AES_DECRYPT);
+            &mAESKey, mAESInitVec, AES_DECRYPT);
 
     return OK;
 }
@@ -525,6 +598,9 @@ void PlaylistFetcher::setStoppingThreshold(float thresholdRatio, bool disconnect
     }
     if (disconnect) {
         mHTTPDownloader->disconnect();
+        if (mSegmentPrefetcher != NULL) {
+            mSegmentPrefetcher->disconnect();
+        }
     }
 }
 
@@ -535,9 +611,15 @@ void PlaylistFetcher::resetStoppingThreshold(bool disconnect) {
     }
     if (disconnect) {
         mHTTPDownloader->disconnect();
+        if (mSegmentPrefetcher != NULL) {
+            mSegmentPrefetcher->disconnect();
+        }
     } else {
         // allow reconnect
         mHTTPDownloader->reconnect();
+        if (mSegmentPrefetcher != NULL) {
+            mSegmentPrefetcher->reconnect();
+        }
     }
 }
 
@@ -779,6 +861,8 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
         mStartTimeUs = startTimeUs;
         mFirstPTSValid = false;
         mSeqNumber = -1;
+        mPartIndex = 0;
+        mFetchingPart = false;
         mTimeChangeSignaled = false;
         mDownloadState->resetState();
     }
@@ -810,6 +894,10 @@ void PlaylistFetcher::onStop(const sp<AMessage> &msg) {
     mDownloadState->resetState();
     mPacketSources.clear();
     mStreamTypeMask = 0;
+    mPrefetchedSeqNumber = -1;
+    if (mSegmentPrefetcher != NULL) {
+        mSegmentPrefetcher->clear();
+    }
 
     resetStoppingThreshold(true /* disconnect */);
 }
@@ -927,9 +1015,21 @@ void PlaylistFetcher::onMonitorQueue() {
 
 status_t PlaylistFetcher::refreshPlaylist() {
     if (delayUsToRefreshPlaylist() <= 0) {
+        AString url = mURI;
+        int32_t seqNumber, partIndex;
+        if (getBlockingReloadTarget(&seqNumber, &partIndex)
+                && (seqNumber != mBlockingReloadSeqNumber
+                        || partIndex != mBlockingReloadPartIndex)) {
+            url.append(url.find("?") < 0 ? "?" : "&");
+            url.append(AStringPrintf("_HLS_msn=%d&_HLS_part=%d", seqNumber, partIndex));
+            FLOGV("blocking playlist reload for part %d.%d", seqNumber, partIndex);
+            mBlockingReloadSeqNumber = seqNumber;
+            mBlockingReloadPartIndex = partIndex;
+        }
+
         bool unchanged;
         sp<M3UParser> playlist = mHTTPDownloader->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged);
+                url.c_str(), mPlaylistHash, &unchanged);
 
         if (playlist == NULL) {
             if (unchanged) {
@@ -1026,9 +1126,103 @@ bool PlaylistFetcher::shouldPauseDownload() {
     return false;
 }
 
+bool PlaylistFetcher::isLowLatency() const {
+    return mPlaylist != NULL
+            && !mLowLatencyDisabled
+            && mPlaylist->getPartTargetDuration() > 0
+            && !mPlaylist->isEncrypted()
+            && mStreamTypeMask != LiveSession::STREAMTYPE_SUBTITLES;
+}
+
+bool PlaylistFetcher::getBlockingReloadTarget(
+        int32_t *seqNumber, int32_t *partIndex) const {
+    if (mSeqNumber < 0 || !isLowLatency() || !mPlaylist->canBlockReload()) {
+        return false;
+    }
+
+    int32_t firstSeqNumberInPlaylist, lastSeqNumberInPlaylist;
+    mPlaylist->getSeqNumberRange(
+            &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
+
+    *seqNumber = mSeqNumber;
+    *partIndex = mPartIndex;
+    if (*seqNumber <= lastSeqNumberInPlaylist) {
+        if (*partIndex == 0
+                || (size_t)*partIndex < mPlaylist->getPartCount(*seqNumber)) {
+            // Available already.
+            return false;
+        }
+        ++*seqNumber;
+        *partIndex = 0;
+    }
+
+    if (*seqNumber != lastSeqNumberInPlaylist + 1
+            || (size_t)*partIndex < mPlaylist->getPartCount(*seqNumber)) {
+        return false;
+    }
+
+    int32_t hintSeqNumber;
+    size_t hintPartIndex;
+    if (mPlaylist->getPreloadHint(&hintSeqNumber, &hintPartIndex, NULL /* uri */)
+            && hintSeqNumber == *seqNumber && (int32_t)hintPartIndex == *partIndex) {
+        // Requesting the hinted part blocks just as well.
+        return false;
+    }
+
+    return true;
+}
+
+// Starts at the latest independent part that's at least PART-HOLD-BACK
+// from the live edge. Returns false if not enough parts are listed.
+bool PlaylistFetcher::initPartForLiveStream(
+        int32_t firstSeqNumberInPlaylist,
+        int32_t lastSeqNumberInPlaylist) {
+    int64_t holdBackUs = mPlaylist->getPartHoldBack();
+    int64_t timeFromEndUs = 0;
+
+    for (int32_t seqNumber = lastSeqNumberInPlaylist + 1;
+            seqNumber >= firstSeqNumberInPlaylist; --seqNumber) {
+        size_t count = mPlaylist->getPartCount(seqNumber);
+        if (count == 0 && seqNumber <= lastSeqNumberInPlaylist) {
+            // Parts are only listed for the most recent segments.
+            break;
+        }
+
+        for (size_t i = count; i > 0;) {
+            --i;
+
+            sp<AMessage> partMeta;
+            CHECK(mPlaylist->partAt(seqNumber, i, NULL /* uri */, &partMeta));
+
+            int64_t partDurationUs;
+            CHECK(partMeta->findInt64("durationUs", &partDurationUs));
+            timeFromEndUs += partDurationUs;
+
+            // Segments start with an independent frame.
+            int32_t independent;
+            if (timeFromEndUs >= holdBackUs
+                    && (i == 0 || (partMeta->findInt32("independent", &independent)
+                            && independent))) {
+                mSeqNumber = seqNumber;
+                mPartIndex = i;
+                FLOGV("starting at part %d.%zu, %lld us from the end",
+                        seqNumber, i, (long long)timeFromEndUs);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 void PlaylistFetcher::initSeqNumberForLiveStream(
         int32_t &firstSeqNumberInPlaylist,
         int32_t &lastSeqNumberInPlaylist) {
+    if (isLowLatency()
+            && initPartForLiveStream(firstSeqNumberInPlaylist, lastSeqNumberInPlaylist)) {
+        return;
+    }
+
     // start at least 3 target durations from the end.
     int64_t timeFromEnd = 0;
     size_t index = mPlaylist->size();
@@ -1078,10 +1272,9 @@ bool PlaylistFetcher::initDownloadState(
         }
     }
 
-    mSegmentFirstPTS = -1ll;
-
     if (mPlaylist != NULL && mSeqNumber < 0) {
         CHECK_GE(mStartTimeUs, 0ll);
+        mPartIndex = 0;
 
         if (mSegmentStartTimeUs < 0) {
             if (!mPlaylist->isComplete() && !mPlaylist->isEvent()) {
@@ -1134,8 +1327,31 @@ bool PlaylistFetcher::initDownloadState(
         }
     }
 
+    // Low-latency playlists are fetched by parts at the live edge, once the
+    // segments listed in full are fetched.
+    mFetchingPart = false;
+    mPartIsPreloadHint = false;
+    if (err == OK && mPlaylist != NULL && mSeqNumber >= firstSeqNumberInPlaylist) {
+        if (mPartIndex > 0 && mSeqNumber <= lastSeqNumberInPlaylist
+                && (size_t)mPartIndex >= mPlaylist->getPartCount(mSeqNumber)) {
+            // All parts of this segment were fetched.
+            ++mSeqNumber;
+            mPartIndex = 0;
+        }
+        mFetchingPart = mPartIndex > 0
+                || (mSeqNumber == lastSeqNumberInPlaylist + 1 && isLowLatency());
+    }
+
+    if (!mFetchingPart || mPartIndex == 0) {
+        mSegmentFirstPTS = -1ll;
+    }
+
     // if mPlaylist is NULL then err must be non-OK; but the other way around might not be true
-    if (mSeqNumber < firstSeqNumberInPlaylist
+    if (mFetchingPart) {
+        if (!initPartDownload(uri, itemMeta, lastSeqNumberInPlaylist)) {
+            return false;
+        }
+    } else if (mSeqNumber < firstSeqNumberInPlaylist
             || mSeqNumber > lastSeqNumberInPlaylist
             || err != OK) {
         if ((err != OK || !mPlaylist->isComplete()) && mNumRetries < kMaxNumRetries) {
@@ -1187,6 +1403,7 @@ bool PlaylistFetcher::initDownloadState(
             if (mSeqNumber < firstSeqNumberInPlaylist) {
                 mSeqNumber = firstSeqNumberInPlaylist;
             }
+            mPartIndex = 0;
             discontinuity = true;
 
             // fall through
@@ -1230,10 +1447,12 @@ bool PlaylistFetcher::initDownloadState(
 
     mNumRetries = 0;
 
-    CHECK(mPlaylist->itemAt(
-                mSeqNumber - firstSeqNumberInPlaylist,
-                &uri,
-                &itemMeta));
+    if (!mFetchingPart) {
+        CHECK(mPlaylist->itemAt(
+                    mSeqNumber - firstSeqNumberInPlaylist,
+                    &uri,
+                    &itemMeta));
+    }
 
     CHECK(itemMeta->findInt32("discontinuity-sequence", &mDiscontinuitySeq));
 
@@ -1317,11 +1536,123 @@ bool PlaylistFetcher::initDownloadState(
         }
     }
 
-    FLOGV("fetching segment %d from (%d .. %d)",
-            mSeqNumber, firstSeqNumberInPlaylist, lastSeqNumberInPlaylist);
+    FLOGV("fetching segment %d%s from (%d .. %d)",
+            mSeqNumber, mFetchingPart ? AStringPrintf(" part %d", mPartIndex).c_str() : "",
+            firstSeqNumberInPlaylist, lastSeqNumberInPlaylist);
+    return true;
+}
+
+bool PlaylistFetcher::initPartDownload(
+        AString &uri,
+        sp<AMessage> &itemMeta,
+        int32_t lastSeqNumberInPlaylist) {
+    mPartIsPreloadHint = false;
+
+    int32_t hintSeqNumber;
+    size_t hintPartIndex;
+    if (!mPlaylist->partAt(mSeqNumber, mPartIndex, &uri, &itemMeta)) {
+        if (mPlaylist->getPreloadHint(&hintSeqNumber, &hintPartIndex, &uri, &itemMeta)
+                && hintSeqNumber == mSeqNumber && (int32_t)hintPartIndex == mPartIndex) {
+            // The server holds the response until the part is available.
+            mPartIsPreloadHint = true;
+        } else {
+            FLOGV("part %d.%d not yet available (last segment %d)",
+                    mSeqNumber, mPartIndex, lastSeqNumberInPlaylist);
+            mFetchingPart = false;
+            postMonitorQueue(delayUsToRefreshPlaylist());
+            return false;
+        }
+    }
+
+    int32_t val;
+    if (itemMeta->findInt32("gap", &val) && val != 0) {
+        FLOGV("skipping gap part %d.%d", mSeqNumber, mPartIndex);
+        ++mPartIndex;
+        mFetchingPart = false;
+        postMonitorQueue();
+        return false;
+    }
+
+    mNumRetries = 0;
     return true;
 }
 
+void PlaylistFetcher::prefetchSegments(int32_t firstSeqNumberInPlaylist) {
+    if (mSegmentPrefetcher == NULL || mPlaylist == NULL) {
+        return;
+    }
+
+    const int32_t lastSeqNumber = firstSeqNumberInPlaylist + (int32_t)mPlaylist->size() - 1;
+    if (mStopParams != NULL || mSeqNumber >= lastSeqNumber) {
+        // Don't fetch past a stopping point; nothing to fetch at the live edge.
+        mSegmentPrefetcher->trim(mSeqNumber, mSeqNumber);
+        return;
+    }
+
+    // Same rules as for the segments we download ourselves.
+    bool measureBandwidth = !mStartup
+            && (mStreamTypeMask
+                    & (LiveSession::STREAMTYPE_AUDIO | LiveSession::STREAMTYPE_VIDEO));
+
+    mSegmentPrefetcher->trim(mSeqNumber, lastSeqNumber);
+    for (int32_t seqNumber = mSeqNumber + 1; seqNumber <= lastSeqNumber; ++seqNumber) {
+        AString uri;
+        sp<AMessage> itemMeta;
+        if (!mPlaylist->itemAt(seqNumber - firstSeqNumberInPlaylist, &uri, &itemMeta)) {
+            break;
+        }
+
+        int32_t val;
+        if (itemMeta->findInt32("discontinuity", &val) && val != 0) {
+            // The next segment may need a different setup; stop here.
+            break;
+        }
+
+        int64_t rangeOffset, rangeLength;
+        if (!itemMeta->findInt64("range-offset", &rangeOffset)
+                || !itemMeta->findInt64("range-length", &rangeLength)) {
+            rangeOffset = 0;
+            rangeLength = -1;
+        }
+
+        mSegmentPrefetcher->prefetch(
+                seqNumber, uri, rangeOffset, rangeLength, measureBandwidth);
+    }
+}
+
+// Like HTTPDownloader::fetchBlock(), but serves the whole segment in one
+// block if it was prefetched.
+ssize_t PlaylistFetcher::fetchSegmentBlock(
+        const AString &uri, sp<ABuffer> *buffer,
+        int64_t rangeOffset, int64_t rangeLength,
+        bool connectHTTP, bool *prefetched) {
+    *prefetched = false;
+
+    if (connectHTTP) {
+        mPrefetchedSeqNumber = -1;
+        if (mSegmentPrefetcher != NULL && !mFetchingPart) {
+            sp<ABuffer> data = mSegmentPrefetcher->take(
+                    mSeqNumber, uri, rangeOffset, rangeLength);
+            if (data != NULL) {
+                FLOGV("using prefetched segment %d", mSeqNumber);
+                *buffer = data;
+                *prefetched = true;
+                mPrefetchedSeqNumber = mSeqNumber;
+                return data->size();
+            }
+        }
+    } else if (mPrefetchedSeqNumber == mSeqNumber) {
+        // The prefetched segment was served completely.
+        mPrefetchedSeqNumber = -1;
+        *prefetched = true;
+        return 0;
+    }
+
+    return mHTTPDownloader->fetchBlock(
+            uri.c_str(), buffer, rangeOffset, rangeLength, kDownloadBlockSize,
+            NULL /* actualURL */, connectHTTP);
+}
+
 void PlaylistFetcher::onDownloadNext() {
     AString uri;
     sp<AMessage> itemMeta;
@@ -1350,6 +1681,9 @@ void PlaylistFetcher::onDownloadNext() {
             return;
         }
         FLOGV("fetching: '%s'", uri.c_str());
+        if (!mFetchingPart) {
+            prefetchSegments(firstSeqNumberInPlaylist);
+        }
     }
 
     int64_t range_offset, range_length;
@@ -1365,9 +1699,9 @@ void PlaylistFetcher::onDownloadNext() {
     mLastIDRTimeUs = -1;
     do {
         int64_t startUs = ALooper::GetNowUs();
-        bytesRead = mHTTPDownloader->fetchBlock(
-                uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize,
-                NULL /* actualURL */, connectHTTP);
+        bool prefetched;
+        bytesRead = fetchSegmentBlock(
+                uri, &buffer, range_offset, range_length, connectHTTP, &prefetched);
         int64_t delayUs = ALooper::GetNowUs() - startUs;
 
         if (bytesRead == ERROR_NOT_CONNECTED) {
@@ -1382,8 +1716,9 @@ void PlaylistFetcher::onDownloadNext() {
 
         // add sample for bandwidth estimation, excluding samples from subtitles (as
         // its too small), or during startup/resumeUntil (when we could have more than
-        // one connection open which affects bandwidth)
-        if (!mStartup && mStopParams == NULL && bytesRead > 0
+        // one connection open which affects bandwidth). Prefetched segments
+        // were measured when they were downloaded.
+        if (!prefetched && !mPartIsPreloadHint && !mStartup && mStopParams == NULL && bytesRead > 0
                 && (mStreamTypeMask
                         & (LiveSession::STREAMTYPE_AUDIO
                         | LiveSession::STREAMTYPE_VIDEO))) {
@@ -1398,6 +1733,18 @@ void PlaylistFetcher::onDownloadNext() {
 
         CHECK(buffer != NULL);
 
+        if (mFetchingPart && tsBuffer == NULL && !bufferStartsWithTsSyncByte(buffer)) {
+            // Only transport streams can be parsed incrementally; fetch this
+            // segment, and the ones after it, in full.
+            ALOGW("part %d.%d is not a transport stream, not fetching parts",
+                    mSeqNumber, mPartIndex);
+            mLowLatencyDisabled = true;
+            mFetchingPart = false;
+            mPartIndex = 0;
+            postMonitorQueue();
+            return;
+        }
+
         size_t size = buffer->size();
         // Set decryption range.
         buffer->setRange(size - bytesRead, bytesRead);
@@ -1472,7 +1819,7 @@ void PlaylistFetcher::onDownloadNext() {
         }
     } while (bytesRead != 0);
 
-    if (bufferStartsWithTsSyncByte(buffer)) {
+    if (!mFetchingPart && bufferStartsWithTsSyncByte(buffer)) {
         // If we don't see a stream in the program table after fetching a full ts segment
         // mark it as nonexistent.
         ATSParser::SourceType srcTypes[] =
@@ -1540,7 +1887,11 @@ void PlaylistFetcher::onDownloadNext() {
         return;
     }
 
-    ++mSeqNumber;
+    if (mFetchingPart) {
+        ++mPartIndex;
+    } else {
+        ++mSeqNumber;
+    }
 
     // if adapting, pause after found the next starting point
     if (mSeekMode != LiveSession::kSeekModeExactPosition && startUp != mStartup) {
@@ -1611,6 +1962,7 @@ bool PlaylistFetcher::adjustSeqNumberWithAnchorTime(int64_t anchorTimeUs) {
     mSeqNumber = firstSeqNumberInPlaylist + index;
 
     if (mSeqNumber != oldSeqNumber) {
+        mPartIndex = 0;
         FLOGV("guessed wrong seg number: diff %lld out of [%lld, %lld]",
                 (long long) anchorTimeUs - mStartTimeUs,
                 (long long) minDiffUs,
@@ -1740,15 +2092,12 @@ status_t PlaylistFetcher::extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &bu
         mSampleAesKeyItemChanged = false;
     }
 
-    size_t offset = 0;
-    while (offset + 188 <= buffer->size()) {
-        status_t err = mTSParser->feedTSPacket(buffer->data() + offset, 188);
-
+    size_t offset = buffer->size() - buffer->size() % 188;
+    {
+        status_t err = mTSParser->feedTSPackets(buffer->data(), offset);
         if (err != OK) {
             return err;
         }
-
-        offset += 188;
     }
     // setRange to indicate consumed bytes.
     buffer->setRange(buffer->offset() + offset, buffer->size() - offset);
@@ -2316,6 +2665,9 @@ void PlaylistFetcher::updateTargetDuration() {
     sp<AMessage> msg = mNotify->dup();
     msg->setInt32("what", kWhatTargetDurationUpdate);
     msg->setInt64("targetDurationUs", mPlaylist->getTargetDuration());
+    if (isLowLatency()) {
+        msg->setInt64("partHoldBackUs", mPlaylist->getPartHoldBack());
+    }
     msg->post();
 }
 
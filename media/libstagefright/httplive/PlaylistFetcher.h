@@ -32,6 +32,7 @@ class DataSource;
 struct HTTPBase;
 struct LiveDataSource;
 struct M3UParser;
+struct SegmentPrefetcher;
 class String8;
 
 struct PlaylistFetcher : public AHandler {
@@ -117,6 +118,10 @@ protected:
     sp<AMessage> mStartTimeUsNotify;
 
     sp<HTTPDownloader> mHTTPDownloader;
+    // Fetches upcoming segments in parallel, NULL unless enabled.
+    sp<SegmentPrefetcher> mSegmentPrefetcher;
+    // Segment whose content was taken from mSegmentPrefetcher in one block.
+    int32_t mPrefetchedSeqNumber;
     sp<LiveSession> mSession;
     AString mURI;
 
@@ -143,6 +148,15 @@ protected:
     int64_t mPlaylistTimeUs;
     sp<M3UParser> mPlaylist;
     int32_t mSeqNumber;
+    // Low-latency HLS: number of parts of mSeqNumber fetched so far, 0 when
+    // fetching whole segments.
+    int32_t mPartIndex;
+    bool mFetchingPart;
+    bool mPartIsPreloadHint;
+    bool mLowLatencyDisabled;
+    // Last blocking playlist reload (_HLS_msn, _HLS_part) requested.
+    int32_t mBlockingReloadSeqNumber;
+    int32_t mBlockingReloadPartIndex;
     int32_t mNumRetries;
     bool mStartup;
     bool mIDRFound;
@@ -180,6 +194,10 @@ protected:
     // the last block of cipher text (cipher-block chaining).
     unsigned char mAESInitVec[AES_BLOCK_SIZE];
     unsigned char mKeyData[AES_BLOCK_SIZE];
+    // Expanded decryption key for full-segment AES-128, and the key it was built from.
+    AES_KEY mAESKey;
+    unsigned char mAESKeyData[AES_BLOCK_SIZE];
+    bool mAESKeyValid;
     bool mSampleAesKeyItemChanged;
     sp<AMessage> mSampleAesKeyItem;
 
@@ -213,6 +231,11 @@ protected:
     int64_t delayUsToRefreshPlaylist() const;
     status_t refreshPlaylist();
 
+    bool isLowLatency() const;
+    // Returns true if the next part to fetch isn't in the playlist yet and
+    // the server can hold a playlist request until it is.
+    bool getBlockingReloadTarget(int32_t *seqNumber, int32_t *partIndex) const;
+
     // Returns the media time in us of the segment specified by seqNumber.
     // This is computed by summing the durations of all segments before it.
     int64_t getSegmentStartTimeUs(int32_t seqNumber) const;
@@ -227,11 +250,24 @@ protected:
     void initSeqNumberForLiveStream(
             int32_t &firstSeqNumberInPlaylist,
             int32_t &lastSeqNumberInPlaylist);
+    bool initPartForLiveStream(
+            int32_t firstSeqNumberInPlaylist,
+            int32_t lastSeqNumberInPlaylist);
+    // Returns false if the download must wait, after scheduling a retry.
+    bool initPartDownload(
+            AString &uri,
+            sp<AMessage> &itemMeta,
+            int32_t lastSeqNumberInPlaylist);
     bool initDownloadState(
             AString &uri,
             sp<AMessage> &itemMeta,
             int32_t &firstSeqNumberInPlaylist,
             int32_t &lastSeqNumberInPlaylist);
+    void prefetchSegments(int32_t firstSeqNumberInPlaylist);
+    ssize_t fetchSegmentBlock(
+            const AString &uri, sp<ABuffer> *buffer,
+            int64_t rangeOffset, int64_t rangeLength,
+            bool connectHTTP, bool *prefetched);
 
     // Resume a fetcher to continue until the stopping point stored in msg.
     status_t onResumeUntil(const sp<AMessage> &msg);
@@ -0,0 +1,312 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SegmentPrefetcher"
+#include <utils/Log.h>
+
+#include "SegmentPrefetcher.h"
+#include "HTTPDownloader.h"
+#include "LiveSession.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaErrors.h>
+
+namespace android {
+
+// One connection with its own thread, fetching one segment at a time.
+struct SegmentPrefetcher::Slot : public AHandler {
+    enum {
+        kWhatFetch = 'fetc',
+    };
+
+    Slot(const sp<SegmentPrefetcher> &owner, size_t index,
+            const sp<HTTPDownloader> &downloader)
+        : mOwner(owner),
+          mIndex(index),
+          mDownloader(downloader),
+          mBusy(false) {
+    }
+
+    wp<SegmentPrefetcher> mOwner;
+    size_t mIndex;
+    sp<HTTPDownloader> mDownloader;
+    sp<ALooper> mLooper;
+    bool mBusy;  // guarded by the owner's mLock
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        CHECK_EQ(msg->what(), (uint32_t)kWhatFetch);
+
+        int32_t seqNumber;
+        AString uri;
+        int64_t rangeOffset, rangeLength;
+        CHECK(msg->findInt32("seqNumber", &seqNumber));
+        CHECK(msg->findString("uri", &uri));
+        CHECK(msg->findInt64("rangeOffset", &rangeOffset));
+        CHECK(msg->findInt64("rangeLength", &rangeLength));
+
+        sp<ABuffer> buffer;
+        int64_t startUs = ALooper::GetNowUs();
+        ssize_t bytesRead = mDownloader->fetchBlock(
+                uri.c_str(), &buffer, rangeOffset, rangeLength,
+                0 /* block_size */, NULL /* actualURL */, true /* reconnect */);
+        int64_t delayUs = ALooper::GetNowUs() - startUs;
+
+        sp<SegmentPrefetcher> owner = mOwner.promote();
+        if (owner != NULL) {
+            owner->onSegmentFetched(mIndex, seqNumber, uri, buffer, bytesRead, delayUs);
+        }
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(Slot);
+};
+
+SegmentPrefetcher::SegmentPrefetcher(
+        const sp<LiveSession> &session, size_t maxSegments, size_t maxBytes)
+    : mSession(session),
+      mMaxSegments(maxSegments),
+      mMaxBytes(maxBytes),
+      mBytesHeld(0),
+      mLastSegmentBytes(0),
+      mDisconnected(false) {
+}
+
+SegmentPrefetcher::~SegmentPrefetcher() {
+    stop();
+}
+
+status_t SegmentPrefetcher::start() {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mMaxSegments; ++i) {
+        sp<Slot> slot = new Slot(this, i, mSession->getHTTPDownloader());
+        slot->mLooper = new ALooper;
+        slot->mLooper->setName("segment prefetch");
+        status_t err = slot->mLooper->start();
+        if (err != OK) {
+            ALOGE("failed to start prefetch looper: %d", err);
+            break;
+        }
+        slot->mLooper->registerHandler(slot);
+        mSlots.push(slot);
+    }
+
+    return mSlots.isEmpty() ? UNKNOWN_ERROR : OK;
+}
+
+void SegmentPrefetcher::stop() {
+    Vector<sp<Slot> > slots;
+    {
+        Mutex::Autolock autoLock(mLock);
+        slots = mSlots;
+        mSlots.clear();
+    }
+
+    for (size_t i = 0; i < slots.size(); ++i) {
+        slots[i]->mDownloader->disconnect();
+    }
+    for (size_t i = 0; i < slots.size(); ++i) {
+        // Waits for a transfer in progress to be abandoned.
+        slots[i]->mLooper->unregisterHandler(slots[i]->id());
+        slots[i]->mLooper->stop();
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    mSegments.clear();
+    mBytesHeld = 0;
+    mDisconnected = true;
+    mCondition.broadcast();
+}
+
+void SegmentPrefetcher::disconnect() {
+    Mutex::Autolock autoLock(mLock);
+
+    mDisconnected = true;
+    for (size_t i = 0; i < mSlots.size(); ++i) {
+        mSlots[i]->mDownloader->disconnect();
+    }
+    mCondition.broadcast();
+}
+
+void SegmentPrefetcher::reconnect() {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mSlots.size(); ++i) {
+        mSlots[i]->mDownloader->reconnect();
+    }
+    mDisconnected = false;
+    startQueued_l();
+}
+
+void SegmentPrefetcher::prefetch(
+        int32_t seqNumber, const AString &uri,
+        int64_t rangeOffset, int64_t rangeLength,
+        bool measureBandwidth) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mSlots.isEmpty() || mSegments.count(seqNumber) > 0
+            || mSegments.size() >= mMaxSegments) {
+        return;
+    }
+
+    // Segments in flight are assumed to be as large as the last one.
+    size_t bytesPending = mBytesHeld;
+    for (auto it = mSegments.begin(); it != mSegments.end(); ++it) {
+        if (it->second.mState != DONE) {
+            bytesPending += mLastSegmentBytes;
+        }
+    }
+    if (bytesPending >= mMaxBytes) {
+        return;
+    }
+
+    Segment &segment = mSegments[seqNumber];
+    segment.mURI = uri;
+    segment.mRangeOffset = rangeOffset;
+    segment.mRangeLength = rangeLength;
+    segment.mMeasureBandwidth = measureBandwidth;
+    segment.mState = QUEUED;
+
+    startQueued_l();
+}
+
+void SegmentPrefetcher::startQueued_l() {
+    if (mDisconnected) {
+        return;
+    }
+
+    for (auto it = mSegments.begin(); it != mSegments.end(); ++it) {
+        if (it->second.mState != QUEUED) {
+            continue;
+        }
+
+        sp<Slot> slot;
+        for (size_t i = 0; i < mSlots.size(); ++i) {
+            if (!mSlots[i]->mBusy) {
+                slot = mSlots[i];
+                break;
+            }
+        }
+        if (slot == NULL) {
+            return;
+        }
+
+        ALOGV("prefetching segment %d", it->first);
+        slot->mBusy = true;
+        it->second.mState = FETCHING;
+
+        sp<AMessage> msg = new AMessage(Slot::kWhatFetch, slot);
+        msg->setInt32("seqNumber", it->first);
+        msg->setString("uri", it->second.mURI);
+        msg->setInt64("rangeOffset", it->second.mRangeOffset);
+        msg->setInt64("rangeLength", it->second.mRangeLength);
+        msg->post();
+    }
+}
+
+void SegmentPrefetcher::onSegmentFetched(
+        size_t slotIndex, int32_t seqNumber, const AString &uri,
+        const sp<ABuffer> &buffer, ssize_t bytesRead, int64_t delayUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (slotIndex < mSlots.size()) {
+        mSlots[slotIndex]->mBusy = false;
+    }
+
+    auto it = mSegments.find(seqNumber);
+    if (it != mSegments.end() && it->second.mState == FETCHING && it->second.mURI == uri) {
+        if (bytesRead >= 0 && buffer != NULL) {
+            ALOGV("prefetched segment %d, %zd bytes in %lld us",
+                    seqNumber, bytesRead, (long long)delayUs);
+            buffer->setRange(0, bytesRead);
+            it->second.mState = DONE;
+            it->second.mBuffer = buffer;
+            mBytesHeld += buffer->size();
+            mLastSegmentBytes = buffer->size();
+
+            if (it->second.mMeasureBandwidth && bytesRead > 0) {
+                mSession->addBandwidthMeasurement(bytesRead, delayUs);
+            }
+        } else {
+            ALOGV("failed to prefetch segment %d: %zd", seqNumber, bytesRead);
+            mSegments.erase(it);
+        }
+    }
+
+    mCondition.broadcast();
+    startQueued_l();
+}
+
+void SegmentPrefetcher::trim(int32_t firstSeqNumber, int32_t lastSeqNumber) {
+    Mutex::Autolock autoLock(mLock);
+
+    auto it = mSegments.begin();
+    while (it != mSegments.end()) {
+        if (it->first >= firstSeqNumber && it->first <= lastSeqNumber) {
+            ++it;
+            continue;
+        }
+        if (it->second.mState == DONE) {
+            mBytesHeld -= it->second.mBuffer->size();
+        }
+        it = mSegments.erase(it);
+    }
+}
+
+void SegmentPrefetcher::clear() {
+    trim(INT32_MAX, INT32_MIN);
+}
+
+sp<ABuffer> SegmentPrefetcher::take(
+        int32_t seqNumber, const AString &uri,
+        int64_t rangeOffset, int64_t rangeLength) {
+    Mutex::Autolock autoLock(mLock);
+
+    auto it = mSegments.find(seqNumber);
+    while (it != mSegments.end() && it->second.mState == FETCHING && !mDisconnected) {
+        mCondition.wait(mLock);
+        it = mSegments.find(seqNumber);
+    }
+
+    if (it == mSegments.end()) {
+        return NULL;
+    }
+
+    sp<ABuffer> buffer;
+    if (it->second.mState == DONE
+            && it->second.mURI == uri
+            && it->second.mRangeOffset == rangeOffset
+            && it->second.mRangeLength == rangeLength) {
+        buffer = it->second.mBuffer;
+    }
+
+    if (it->second.mState == DONE) {
+        mBytesHeld -= it->second.mBuffer->size();
+    }
+    if (it->second.mState != FETCHING) {
+        mSegments.erase(it);
+    }
+
+    return buffer;
+}
+
+}  // namespace android
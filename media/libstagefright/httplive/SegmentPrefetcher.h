@@ -0,0 +1,113 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEGMENT_PREFETCHER_H_
+
+#define SEGMENT_PREFETCHER_H_
+
+#include <map>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+struct HTTPDownloader;
+struct LiveSession;
+
+// Downloads upcoming media segments of a PlaylistFetcher ahead of time, each
+// on its own connection, so that a segment is already transferring while the
+// fetcher decrypts and parses the previous one. Bounded both in the number of
+// segments held or in flight and in the number of bytes held.
+struct SegmentPrefetcher : public RefBase {
+    SegmentPrefetcher(
+            const sp<LiveSession> &session, size_t maxSegments, size_t maxBytes);
+
+    status_t start();
+    void stop();
+
+    // Forwarded to the downloaders, see HTTPDownloader.
+    void disconnect();
+    void reconnect();
+
+    // Starts fetching segment |seqNumber| unless it is already prefetched or
+    // the budget is exhausted. If |measureBandwidth| is set, the transfer is
+    // reported to the session's bandwidth estimator.
+    void prefetch(
+            int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength,
+            bool measureBandwidth);
+
+    // Drops all segments outside [firstSeqNumber, lastSeqNumber].
+    void trim(int32_t firstSeqNumber, int32_t lastSeqNumber);
+    void clear();
+
+    // Returns the content of segment |seqNumber| if it was prefetched from
+    // the same location, waiting for a transfer in progress to complete.
+    // Returns NULL otherwise, including when the transfer failed.
+    sp<ABuffer> take(
+            int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength);
+
+protected:
+    virtual ~SegmentPrefetcher();
+
+private:
+    struct Slot;
+
+    enum State {
+        QUEUED,
+        FETCHING,
+        DONE,
+    };
+
+    struct Segment {
+        AString mURI;
+        int64_t mRangeOffset;
+        int64_t mRangeLength;
+        bool mMeasureBandwidth;
+        State mState;
+        sp<ABuffer> mBuffer;
+    };
+
+    sp<LiveSession> mSession;
+    size_t mMaxSegments;
+    size_t mMaxBytes;
+
+    Mutex mLock;
+    Condition mCondition;
+    Vector<sp<Slot> > mSlots;
+    std::map<int32_t, Segment> mSegments;
+    size_t mBytesHeld;
+    size_t mLastSegmentBytes;
+    bool mDisconnected;
+
+    void startQueued_l();
+    void onSegmentFetched(
+            size_t slotIndex, int32_t seqNumber, const AString &uri,
+            const sp<ABuffer> &buffer, ssize_t bytesRead, int64_t delayUs);
+
+    DISALLOW_EVIL_CONSTRUCTORS(SegmentPrefetcher);
+};
+
+}  // namespace android
+
+#endif  // SEGMENT_PREFETCHER_H_
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ASYNC_CHUNK_WRITER_H_
+
+#define ASYNC_CHUNK_WRITER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <pthread.h>
+#include <utils/Condition.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+
+// Writes data at given offsets of a file on a thread of its own, so that
+// storage latency spikes do not stall the caller. Contiguous writes are
+// coalesced into large buffers and up to |maxPendingBytes| may be queued,
+// beyond that write() blocks until the backlog has drained. The space
+// ahead of the data is preallocated where the file system supports it.
+//
+// write() and flush() must not be called concurrently.
+struct AsyncChunkWriter : public RefBase {
+    AsyncChunkWriter(int fd, size_t maxPendingBytes = kDefaultMaxPendingBytes);
+
+    status_t start();
+
+    void write(off64_t offset, const void *data, size_t size);
+
+    // Waits for everything written so far to reach the file, returns the
+    // first error encountered since start().
+    status_t flush();
+
+    // Flushes, then releases the preallocated space beyond the end of the
+    // file.
+    status_t stop();
+
+protected:
+    virtual ~AsyncChunkWriter();
+
+private:
+    enum {
+        // About a second of 4K high frame rate video.
+        kDefaultMaxPendingBytes = 16 * 1024 * 1024,
+        kBufferSize = 1024 * 1024,
+        kPreallocateBytes = 32 * 1024 * 1024,
+    };
+
+    struct Request {
+        off64_t mOffset;
+        sp<ABuffer> mBuffer;
+    };
+
+    int mFd;
+    size_t mMaxPendingBytes;
+
+    // Only touched by the caller of write().
+    sp<ABuffer> mStaging;
+    off64_t mStagingOffset;
+
+    Mutex mLock;
+    Condition mCondition;
+    List<Request> mQueue;
+    size_t mPendingBytes;
+    bool mWriting;
+    bool mDone;
+    status_t mError;
+    Vector<sp<ABuffer> > mFreeBuffers;
+
+    pthread_t mThread;
+    bool mThreadStarted;
+
+    // Only touched by the writer thread.
+    bool mPreallocate;
+    off64_t mAllocatedEnd;
+
+    sp<ABuffer> acquireBuffer();
+    void submitStaging();
+    void preallocate(off64_t offset, size_t size);
+    status_t writeFully(off64_t offset, const uint8_t *data, size_t size);
+
+    static void *ThreadWrapper(void *me);
+    void threadFunc();
+
+    DISALLOW_EVIL_CONSTRUCTORS(AsyncChunkWriter);
+};
+
+}  // namespace android
+
+#endif  // ASYNC_CHUNK_WRITER_H_
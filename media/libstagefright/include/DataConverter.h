@@ -32,10 +32,15 @@ struct DataConverter : public RefBase {
     virtual size_t targetSize(size_t sourceSize); // will clamp to SIZE_MAX
 
     status_t convert(const sp<MediaCodecBuffer> &source, sp<MediaCodecBuffer> &target);
+
+    // converts the data in 'buffer' without a second buffer; only possible
+    // if the converted data is no larger than the original
+    status_t convertInPlace(const sp<MediaCodecBuffer> &buffer);
     virtual ~DataConverter();
 
 protected:
     virtual status_t safeConvert(const sp<MediaCodecBuffer> &source, sp<MediaCodecBuffer> &target);
+    virtual status_t safeConvertInPlace(const sp<MediaCodecBuffer> &buffer);
 };
 
 // SampleConverterBase uses a ratio to calculate the source and target sizes
@@ -46,6 +51,7 @@ struct SampleConverterBase : public DataConverter {
 
 protected:
     virtual status_t safeConvert(const sp<MediaCodecBuffer> &source, sp<MediaCodecBuffer> &target) = 0;
+    virtual status_t safeConvertInPlace(const sp<MediaCodecBuffer> &buffer) = 0;
 
     // sourceSize = sourceSampleSize / targetSampleSize * targetSize
     SampleConverterBase(uint32_t sourceSampleSize, uint32_t targetSampleSize)
@@ -62,8 +68,13 @@ struct AudioConverter : public SampleConverterBase {
 
 protected:
     virtual status_t safeConvert(const sp<MediaCodecBuffer> &source, sp<MediaCodecBuffer> &target);
+    virtual status_t safeConvertInPlace(const sp<MediaCodecBuffer> &buffer);
 
 private:
+    // converts 'size' bytes of source samples; dst may equal src when
+    // narrowing
+    status_t convertSamples(void *dst, const void *src, size_t size);
+
     AudioConverter(
             AudioEncoding source, size_t sourceSample,
             AudioEncoding target, size_t targetSample)
@@ -29,6 +29,7 @@
 namespace android {
 
 struct AMessage;
+struct ColorConverter;
 class MediaCodecBuffer;
 class IMediaSource;
 class VideoFrame;
@@ -44,9 +45,25 @@ struct FrameDecoder : public RefBase {
             const sp<MetaData> &trackMeta,
             const sp<IMediaSource> &source);
 
+    // Limits the decode to a region of the frame, in the coordinates of the
+    // cropped frame. Must be called before init().
+    void setRegion(const FrameRect &region);
+
+    // Lets the frame be scaled down by a power of two, as long as it stays at
+    // least targetWidth x targetHeight once rotated for display. Must be called
+    // before init().
+    void setTargetSize(int32_t targetWidth, int32_t targetHeight);
+
     status_t init(
             int64_t frameTimeUs, size_t numFrames, int option, int colorFormat);
 
+    // Prepares a decoder that already extracted frames for another request
+    // to extract frames for this one, flushing and reusing its codecs and its
+    // started source instead of setting up new ones. Fails if the request
+    // needs the codecs configured differently; use a new decoder then.
+    status_t reinit(
+            int64_t frameTimeUs, size_t numFrames, int option, int colorFormat);
+
     sp<IMemory> extractFrame(FrameRect *rect = NULL);
 
     status_t extractFrames(std::vector<sp<IMemory> >* frames);
@@ -65,6 +82,20 @@ protected:
 
     virtual status_t onExtractRect(FrameRect *rect) = 0;
 
+    // Returns true if codecs configured for the last request can also serve a
+    // request with the given seek mode.
+    virtual bool onCanReuseFor(int /* seekMode */) { return false; }
+
+    // Number of codec instances to decode with. The samples are queued to the
+    // instances in turn, and the outputs are delivered to onOutputReceived() in
+    // the same order, so that more than one instance can only be used when all
+    // samples are sync samples.
+    virtual size_t onGetDecoderCount() { return 1; }
+
+    // Called for every sample read from the source, returns true if the sample
+    // should be dropped instead of being queued to the codec.
+    virtual bool onSkipInput() { return false; }
+
     virtual status_t onInputReceived(
             const sp<MediaCodecBuffer> &codecBuffer,
             MetaDataBase &sampleMeta,
@@ -77,9 +108,20 @@ protected:
             int64_t timeUs,
             bool *done) = 0;
 
+    const AString &componentName() const    { return mComponentName; }
     sp<MetaData> trackMeta()     const      { return mTrackMeta; }
     OMX_COLOR_FORMATTYPE dstFormat() const  { return mDstFormat; }
     int32_t dstBpp()             const      { return mDstBpp; }
+    bool hasRegion()             const      { return mHasRegion; }
+    const FrameRect &region()    const      { return mRegion; }
+
+    // meta to describe the output frame with, without the display size of the
+    // track if only a region of it is decoded
+    sp<MetaData> frameMeta()     const      { return mFrameMeta; }
+
+    // largest power of two to divide a width x height picture by that still
+    // meets the target size
+    int32_t getDownscaleFactor(int32_t width, int32_t height) const;
 
     void addFrame(const sp<IMemory> &frame) {
         mFrames.push_back(frame);
@@ -89,13 +131,20 @@ protected:
 private:
     AString mComponentName;
     sp<MetaData> mTrackMeta;
+    sp<MetaData> mFrameMeta;
     sp<IMediaSource> mSource;
     OMX_COLOR_FORMATTYPE mDstFormat;
     int32_t mDstBpp;
     std::vector<sp<IMemory> > mFrames;
+    bool mHasRegion;
+    FrameRect mRegion;
+    int32_t mTargetWidth;
+    int32_t mTargetHeight;
     MediaSource::ReadOptions mReadOptions;
-    sp<MediaCodec> mDecoder;
-    sp<AMessage> mOutputFormat;
+    std::vector<sp<MediaCodec> > mDecoders;
+    std::vector<sp<AMessage> > mOutputFormats;
+    size_t mNumInputsQueued;
+    size_t mNumOutputsReceived;
     bool mHaveMoreInputs;
     bool mFirstSample;
 
@@ -122,6 +171,8 @@ protected:
         return (rect == NULL) ? OK : ERROR_UNSUPPORTED;
     }
 
+    virtual bool onCanReuseFor(int seekMode) override;
+
     virtual status_t onInputReceived(
             const sp<MediaCodecBuffer> &codecBuffer,
             MetaDataBase &sampleMeta,
@@ -149,6 +200,8 @@ struct ImageDecoder : public FrameDecoder {
             const sp<IMediaSource> &source);
 
 protected:
+    virtual ~ImageDecoder();
+
     virtual sp<AMessage> onGetFormatAndSeekOptions(
             int64_t frameTimeUs,
             size_t numFrames,
@@ -163,6 +216,10 @@ protected:
             bool firstSample __unused,
             uint32_t *flags __unused) override { return OK; }
 
+    virtual size_t onGetDecoderCount() override;
+
+    virtual bool onSkipInput() override;
+
     virtual status_t onOutputReceived(
             const sp<MediaCodecBuffer> &videoFrameBuffer,
             const sp<AMessage> &outputFormat,
@@ -170,6 +227,7 @@ protected:
             bool *done) override;
 
 private:
+    std::unique_ptr<ColorConverter> mConverter;
     VideoFrame *mFrame;
     int32_t mWidth;
     int32_t mHeight;
@@ -179,6 +237,14 @@ private:
     int32_t mTileHeight;
     int32_t mTilesDecoded;
     int32_t mTargetTiles;
+    int32_t mTilesRead;
+    // tile index of every sample queued to the codecs, in queuing order
+    std::vector<int32_t> mQueuedTiles;
+    // the part of the image to decode, aligned for mDownscale
+    FrameRect mRoi;
+    int32_t mDownscale;
+
+    bool isTileInRoi(int32_t tile) const;
 };
 
 }  // namespace android
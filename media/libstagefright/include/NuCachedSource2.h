@@ -21,6 +21,7 @@
 #include <media/DataSource.h>
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AHandlerReflector.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -58,6 +59,11 @@ struct NuCachedSource2 : public DataSource {
 
     void resumeFetchingIfNecessary();
 
+    // Adds another connection to the same content, used to fetch ranges
+    // ahead of the read position in parallel. The source must support
+    // reading at arbitrary offsets.
+    void addRangeSource(const sp<DataSource> &source);
+
     // The following methods are supported only if the
     // data source is HTTP-based; otherwise, ERROR_UNSUPPORTED
     // is returned.
@@ -91,8 +97,14 @@ private:
     };
 
     enum {
-        kWhatFetchMore  = 'fetc',
-        kWhatRead       = 'read',
+        kWhatFetchMore      = 'fetc',
+        kWhatRead           = 'read',
+        kWhatRangeFetched   = 'rngf',
+    };
+
+    enum {
+        // Size of the ranges fetched through additional connections.
+        kRangeSize = 16 * kPageSize,
     };
 
     enum {
@@ -108,8 +120,33 @@ private:
     mutable Mutex mLock;
     Condition mCondition;
 
+    struct RangeFetcher;
+
+    // Cached byte range that isn't being extended.
+    struct Extent {
+        off64_t mOffset;
+        PageCache *mCache;
+        int64_t mLastAccessUs;
+    };
+
+    struct PendingRange {
+        off64_t mOffset;
+        size_t mSize;
+    };
+
+    // The range being extended by the prefetcher, from the last seek on.
     PageCache *mCache;
     off64_t mCacheOffset;
+
+    // Ranges cached earlier, disjoint from mCache and from each other and
+    // sorted by offset. They are released least recently used first, and
+    // merged into mCache once it reaches them.
+    Vector<Extent> mExtents;
+    size_t mExtentBytes;
+
+    Vector<sp<RangeFetcher> > mRangeFetchers;
+    Vector<PendingRange> mPendingRanges;
+    bool mWaitingForRange;
     status_t mFinalStatus;
     off64_t mLastAccessPos;
     sp<AMessage> mAsyncResult;
@@ -135,6 +172,16 @@ private:
     ssize_t readInternal(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
 
+    ssize_t findExtent_l(off64_t offset, size_t size) const;
+    bool readFromExtent_l(off64_t offset, void *data, size_t size);
+    void retainCache_l();
+    void mergeExtents_l();
+    void evictExtents_l(size_t maxCachedBytes);
+    off64_t nextCachedOffset_l(off64_t offset) const;
+
+    void scheduleRangeFetches_l(off64_t sourceSize);
+    void onRangeFetched(const sp<AMessage> &msg);
+
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
     void restartPrefetcherIfNecessary_l(
@@ -45,6 +45,9 @@ public:
 private:
     enum YUVMode {
         None,
+        // the window buffers have the same YV12 plane layout as the decoder
+        // output, so a frame is copied a whole plane at a time
+        WholePlanes,
     };
 
     OMX_COLOR_FORMATTYPE mColorFormat;
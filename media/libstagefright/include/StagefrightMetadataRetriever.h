@@ -28,6 +28,7 @@ namespace android {
 class DataSource;
 class MediaExtractor;
 struct ImageDecoder;
+struct VideoFrameDecoder;
 struct FrameRect;
 
 struct StagefrightMetadataRetriever : public MediaMetadataRetrieverBase {
@@ -65,13 +66,19 @@ private:
 
     sp<ImageDecoder> mImageDecoder;
     int mLastImageIndex;
+    // decoder of the last frame request, kept for the next one
+    sp<VideoFrameDecoder> mVideoDecoder;
     void parseMetaData();
-    // Delete album art and clear metadata.
+    // Delete album art, clear metadata and drop the decoders kept for the
+    // current source.
     void clearMetadata();
 
     status_t getFrameInternal(
             int64_t timeUs, int numFrames, int option, int colorFormat, bool metaOnly,
             sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames);
+    status_t extractVideoFrames(
+            const sp<VideoFrameDecoder> &decoder,
+            sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames);
     virtual sp<IMemory> getImageInternal(
             int index, int colorFormat, bool metaOnly, bool thumbnail, FrameRect* rect);
 
@@ -279,6 +279,9 @@ protected:
     IOMX::PortMode mPortMode[2];
     int32_t mMetadataBuffersToSubmit;
     size_t mNumUndequeuedBuffers;
+    // output buffers left with the native window by the last flush are
+    // still to be taken back
+    bool mDeferredNativeWindowReclaim;
     sp<DataConverter> mConverter[2];
 
     sp<IGraphicBufferSource> mGraphicBufferSource;
@@ -517,6 +520,10 @@ protected:
 
     void waitUntilAllPossibleNativeWindowBuffersAreReturnedToUs();
 
+    // Dequeues and submits one of the buffers left with the native window
+    // by a flush, if any are still outstanding.
+    void reclaimDeferredNativeWindowBuffer();
+
     size_t countBuffersOwnedByComponent(OMX_U32 portIndex) const;
     size_t countBuffersOwnedByNativeWindow() const;
 
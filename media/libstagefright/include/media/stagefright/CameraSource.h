@@ -131,6 +131,17 @@ public:
 
     virtual void notifyPerformanceMode() {}
 
+    /**
+     * Have the camera render recording frames straight into the encoder's
+     * input surface rather than handing them out through read(). Only
+     * supported when video buffers are received through a buffer queue
+     * (metaDataStoredInVideoBuffers() returns kMetadataBufferTypeANWBuffer).
+     * Must be called before start(); read() fails afterwards.
+     *
+     * @return OK on success, INVALID_OPERATION if not supported.
+     */
+    status_t setEncoderInputSurface(const sp<IGraphicBufferProducer>& surface);
+
 protected:
 
     /**
@@ -261,6 +272,9 @@ private:
     int32_t mNumGlitches;
     int64_t mGlitchDurationThresholdUs;
     bool mCollectStats;
+    // Capture-to-encode latency of the frames returned by the encoder.
+    int64_t mTotalEncodeLatencyUs;
+    int64_t mMaxEncodeLatencyUs;
 
     // The mode video buffers are received from camera. One of VIDEO_BUFFER_MODE_*.
     int32_t mVideoBufferMode;
@@ -284,6 +298,8 @@ private:
     // This is protected by mLock.
     KeyedVector<ANativeWindowBuffer*, BufferItem> mReceivedBufferItemMap;
     sp<BufferQueueListener> mBufferQueueListener;
+    // The encoder's input surface the camera renders to directly, if set.
+    sp<IGraphicBufferProducer> mEncoderInputSurface;
 
     Mutex mBatchLock; // protecting access to mInflightXXXXX members below
     // Start of members protected by mBatchLock
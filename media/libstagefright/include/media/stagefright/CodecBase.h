@@ -83,6 +83,14 @@ struct CodecBase : public AHandler, /* static */ ColorUtils {
          * Notify MediaCodec that flush operation is complete.
          */
         virtual void onFlushCompleted() = 0;
+        /**
+         * Notify MediaCodec of how long the phases of a flush took. Called
+         * right before onFlushCompleted() by codecs that measure them.
+         *
+         * @param phases  the phase durations in microseconds, as int64 entries
+         *                keyed by phase name.
+         */
+        virtual void onFlushPhasesMeasured(const sp<AMessage> &phases) = 0;
         /**
          * Notify MediaCodec that an error is occurred.
          *
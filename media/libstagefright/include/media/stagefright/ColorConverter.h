@@ -23,6 +23,8 @@
 #include <stdint.h>
 #include <utils/Errors.h>
 
+#include <memory>
+
 #include <OMX_Video.h>
 
 namespace android {
@@ -35,6 +37,11 @@ struct ColorConverter {
 
     bool isDstRGB() const;
 
+    // Lets convert() and convertDownscaled() split large frames into bands of
+    // rows that are converted on up to maxThreads threads, the calling thread
+    // included. The default is to convert on the calling thread only.
+    void setMaxThreads(size_t maxThreads);
+
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight,
@@ -45,6 +52,23 @@ struct ColorConverter {
             size_t dstCropLeft, size_t dstCropTop,
             size_t dstCropRight, size_t dstCropBottom);
 
+    // Whether convertDownscaled() supports this pair of formats.
+    bool isDownscaleValid() const;
+
+    // Like convert(), but the destination crop is the source crop scaled down by
+    // an integer factor. Each destination pixel is the average of a factor x factor
+    // block of source pixels, and is converted to RGB in the same pass.
+    status_t convertDownscaled(
+            const void *srcBits,
+            size_t srcWidth, size_t srcHeight,
+            size_t srcCropLeft, size_t srcCropTop,
+            size_t srcCropRight, size_t srcCropBottom,
+            void *dstBits,
+            size_t dstWidth, size_t dstHeight,
+            size_t dstCropLeft, size_t dstCropTop,
+            size_t dstCropRight, size_t dstCropBottom,
+            size_t factor);
+
 private:
     struct BitmapParams {
         BitmapParams(
@@ -64,17 +88,39 @@ private:
         size_t mBpp, mStride;
     };
 
+    struct BandPool;
+
     OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
     uint8_t *mClip;
+    size_t mMaxThreads;
+    std::unique_ptr<BandPool> mBandPool;
 
     uint8_t *initClip();
 
+    // splits the conversion into bands of rows and hands them to convertBand()
+    status_t convertInBands(
+            const BitmapParams &src, const BitmapParams &dst, size_t factor);
+
+    status_t convertBand(
+            const BitmapParams &src, const BitmapParams &dst, size_t factor);
+
     status_t convertCbYCrY(
             const BitmapParams &src, const BitmapParams &dst);
 
     status_t convertYUV420Planar(
             const BitmapParams &src, const BitmapParams &dst);
 
+    status_t convertYUV420PlanarDownscaled(
+            const BitmapParams &src, const BitmapParams &dst, size_t factor);
+
+    template <typename Reader, typename Writer>
+    status_t convertYUV420PlanarRows(
+            const BitmapParams &src, const BitmapParams &dst);
+
+    template <typename Writer>
+    status_t convertYUV420PlanarDownscaledRows(
+            const BitmapParams &src, const BitmapParams &dst, size_t factor);
+
     status_t convertYUV420PlanarUseLibYUV(
             const BitmapParams &src, const BitmapParams &dst);
 
@@ -20,6 +20,8 @@
 
 #include <media/DataSource.h>
 #include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/threads.h>
 
 namespace android {
 
@@ -36,9 +38,21 @@ protected:
     virtual ~DataURISource();
 
 private:
-    sp<ABuffer> mBuffer;
+    // Bytes decoded at a time by readAt(), a multiple of 3.
+    static const size_t kDecodedBlockSize = 48 * 1024;
 
-    DataURISource(const sp<ABuffer> &buffer);
+    // The base64 payload, stripped of CR and LF, decoded one block at a time
+    // as it is read.
+    AString mEncoded;
+    size_t mDecodedSize;
+
+    Mutex mLock;
+    sp<ABuffer> mBlock;
+    off64_t mBlockOffset;
+
+    DataURISource(const AString &encoded, size_t decodedSize);
+
+    status_t decodeBlock_l(off64_t offset);
 
     DISALLOW_EVIL_CONSTRUCTORS(DataURISource);
 };
@@ -37,6 +37,9 @@ public:
 
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
 
+    // Only succeeds while the file is memory-mapped and not DRM protected.
+    virtual ssize_t borrowAt(off64_t offset, const uint8_t **data, size_t size);
+
     virtual status_t getSize(off64_t *size);
 
     virtual uint32_t flags() {
@@ -61,6 +64,20 @@ private:
     Mutex mLock;
     String8 mName;
 
+    // Read-only mapping of regular files, see mapFile(). mMapData points at
+    // mOffset within the page aligned mapping at mMapBase.
+    void *mMapBase;
+    size_t mMapSize;
+    const uint8_t *mMapData;
+    // Range of the source already advised with MADV_WILLNEED.
+    int64_t mReadaheadStart;
+    int64_t mReadaheadEnd;
+
+    void mapFile();
+    void unmapFile();
+    void readaheadLocked(off64_t offset, size_t size);
+    bool isMappedLocked() const;
+
     /*for DRM*/
     sp<DecryptHandle> mDecryptHandle;
     DrmManagerClient *mDrmManagerClient;
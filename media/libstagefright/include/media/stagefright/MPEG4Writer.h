@@ -31,6 +31,7 @@ namespace android {
 struct AMessage;
 class MediaBuffer;
 struct ABuffer;
+struct AsyncChunkWriter;
 
 class MPEG4Writer : public MediaWriter {
 public:
@@ -61,6 +62,10 @@ public:
     void endBox();
     uint32_t interleaveDuration() const { return mInterleaveDurationUs; }
     status_t setInterleaveDuration(uint32_t duration);
+
+    // Records a fragmented file (moov first, then moof/mdat pairs of about
+    // |durationUs| each) instead of writing the moov at the end. 0 disables.
+    status_t setFragmentDuration(int64_t durationUs);
     int32_t getTimeScale() const { return mTimeScale; }
 
     status_t setGeoData(int latitudex10000, int longitudex10000);
@@ -107,6 +112,7 @@ protected:
     bool  mWriteBoxToMemory;
     off64_t mFreeBoxOffset;
     bool mStreamableFile;
+    volatile bool mMoovReservationExceeded;
     off64_t mMoovExtraSize;
     uint32_t mInterleaveDurationUs;
     int32_t mTimeScale;
@@ -116,6 +122,10 @@ protected:
     bool mAreGeoTagsAvailable;
     int32_t mStartTimeOffsetMs;
     bool mSwitchPending;
+    int64_t mFragmentDurationUs;
+    bool mIsFragmented;
+    bool mMoovWritten;
+    uint32_t mFragmentSequenceNumber;
 
     sp<ALooper> mLooper;
     sp<AHandlerReflector<MPEG4Writer> > mReflector;
@@ -161,11 +171,35 @@ protected:
 
     };
 
+    struct FragmentSample {
+        MediaBuffer         *mBuffer;
+        bool                mUsePrefix;
+        uint32_t            mSize;          // As written, including the prefix
+        uint32_t            mDuration;      // Track timescale based
+        int32_t             mCompositionOffset;
+        bool                mIsSync;
+    };
+    struct Fragment {
+        Track               *mTrack;        // Owner
+        int64_t             mTimeStampUs;   // Timestamp of the 1st sample
+        int64_t             mDecodeTimeTicks;  // Of the 1st sample, from the track start
+        List<FragmentSample> mSamples;      // Empty once the track is done
+
+        Fragment(): mTrack(NULL), mTimeStampUs(0), mDecodeTimeTicks(0) {}
+
+        explicit Fragment(Track *track)
+            : mTrack(track), mTimeStampUs(0), mDecodeTimeTicks(0) {
+        }
+    };
+
     bool            mIsFirstChunk;
     volatile bool   mDone;                  // Writer thread is done?
     pthread_t       mThread;                // Thread id for the writer
     List<ChunkInfo> mChunkInfos;            // Chunk infos
     Condition       mChunkReadyCondition;   // Signal that chunks are available
+    sp<AsyncChunkWriter> mChunkWriter;      // Writes the samples out
+    List<Fragment>  mFragments;             // Fragments to be written, in order
+    List<Track *>   mTracksBeforeMoov;      // Tracks the moov still waits for
 
     // HEIF writing
     typedef key_value_pair_t< const char *, Vector<uint16_t> > ItemRefs;
@@ -230,6 +264,14 @@ protected:
     // Actually write the given chunk to the file.
     void writeChunkToFile(Chunk* chunk);
 
+    // Fragmented recording counterparts of the above. An empty fragment tells
+    // that the track will not deliver any more.
+    void bufferFragment(const Fragment& fragment);
+    void writeAllFragments();
+    bool findFragmentToWrite(Fragment *fragment);
+    void writeFragmentToFile(Fragment *fragment);
+    void writeFragmentedMoovBox();
+
     // Adjust other track media clock (presumably wall clock)
     // based on audio track media clock with the drift time.
     int64_t mDriftTimeUs;
@@ -247,6 +289,9 @@ protected:
     // By default, real time recording is on.
     bool isRealTimeRecording() const;
 
+    bool isFragmented() const { return mIsFragmented; }
+    int64_t fragmentDuration() const { return mFragmentDurationUs; }
+
     void lock();
     void unlock();
 
@@ -257,6 +302,9 @@ protected:
 
     // Acquire lock before calling these methods
     off64_t addSample_l(MediaBuffer *buffer, bool usePrefix, bool isExif, size_t *bytesWritten);
+    void writeSampleData_l(const void *data, size_t size);
+    void writeInt32At(off64_t offset, int32_t x);
+    void stopChunkWriter();
     static void StripStartcode(MediaBuffer *buffer);
     virtual void addLengthPrefixedSample_l(MediaBuffer *buffer);
     void addMultipleLengthPrefixedSamples_l(MediaBuffer *buffer);
@@ -269,6 +317,7 @@ protected:
     bool exceedsFileDurationLimit();
     bool approachingFileSizeLimit();
     bool isFileStreamable() const;
+    bool updateMoovReservation();
     void trackProgressStatus(size_t trackId, int64_t timeUs, status_t err = OK);
     void writeCompositionMatrix(int32_t degrees);
     void writeMvhdBox(int64_t durationUs);
@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/List.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -29,8 +30,12 @@ namespace android {
 // Used only by the MediaMuxer for now.
 struct MediaAdapter : public MediaSource, public MediaBufferObserver {
 public:
+    static const size_t kDefaultMaxQueuedBytes = 4 * 1024 * 1024;
+
     // MetaData is used to set the format and returned at getFormat.
-    MediaAdapter(const sp<MetaData> &meta);
+    // Up to maxQueuedBytes of pushed buffers may wait for the reader.
+    MediaAdapter(const sp<MetaData> &meta,
+            size_t maxQueuedBytes = kDefaultMaxQueuedBytes);
     virtual ~MediaAdapter();
     /////////////////////////////////////////////////
     // Inherited functions from MediaSource
@@ -52,18 +57,23 @@ public:
     // Non-inherited functions:
     /////////////////////////////////////////////////
 
-    // pushBuffer() will wait for the read() finish, and read() will have a
-    // deep copy, such that after pushBuffer return, the buffer can be re-used.
+    // pushBuffer() takes over the caller's reference to the buffer and
+    // queues it for read(). It only waits while the buffers pushed earlier
+    // and not yet returned by the reader add up to more than maxQueuedBytes,
+    // so the caller must not touch the buffer's data afterwards.
     status_t pushBuffer(MediaBuffer *buffer);
 
 private:
     Mutex mAdapterLock;
     // Make sure the read() wait for the incoming buffer.
     Condition mBufferReadCond;
-    // Make sure the pushBuffer() wait for the current buffer consumed.
+    // Signaled whenever a buffer is read or returned, for pushBuffer() and stop().
     Condition mBufferReturnedCond;
 
-    MediaBuffer *mCurrentMediaBuffer;
+    List<MediaBuffer *> mBufferQueue;
+    // bytes pushed and not yet returned by the reader
+    size_t mQueuedBytes;
+    const size_t mMaxQueuedBytes;
 
     bool mStarted;
     sp<MetaData> mOutputFormat;
@@ -18,7 +18,8 @@
 
 #define MEDIA_CLOCK_H_
 
-#include <list>
+#include <atomic>
+#include <map>
 #include <media/stagefright/foundation/AHandler.h>
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
@@ -87,12 +88,37 @@ private:
         int64_t mAdjustRealUs;
     };
 
+    // Everything the time queries depend on.
+    struct Anchor {
+        int64_t mAnchorTimeMediaUs;
+        int64_t mAnchorTimeRealUs;
+        int64_t mMaxTimeMediaUs;
+        int64_t mStartingTimeMediaUs;
+        float mPlaybackRate;
+    };
+
+    static status_t GetMediaTime(
+            const Anchor &anchor,
+            int64_t realUs,
+            int64_t *outMediaUs,
+            bool allowPastMaxTime);
+
+    // media time at which |timer| fires at |playbackRate|
+    static int64_t GetTimerMediaUs(const Timer &timer, float playbackRate);
+
     status_t getMediaTime_l(
             int64_t realUs,
             int64_t *outMediaUs,
             bool allowPastMaxTime) const;
 
+    // Readers take a consistent copy of the anchor without mLock; writers
+    // hold mLock and call publishAnchor_l() after changing any of its fields.
+    Anchor readAnchor() const;
+    void publishAnchor_l();
+
     void processTimers_l();
+    // re-sorts mTimers after a change of mPlaybackRate
+    void rekeyTimers_l();
 
     void updateAnchorTimesAndPlaybackRate_l(
             int64_t anchorTimeMediaUs, int64_t anchorTimeRealUs , float playbackRate);
@@ -110,9 +136,18 @@ private:
     float mPlaybackRate;
 
     int32_t mGeneration;
-    std::list<Timer> mTimers;
+    // keyed by GetTimerMediaUs() at mPlaybackRate
+    std::multimap<int64_t, Timer> mTimers;
     sp<AMessage> mNotify;
 
+    // seqlock-protected copy of the anchor; odd mAnchorSeq means a write is in progress
+    std::atomic<uint32_t> mAnchorSeq;
+    std::atomic<int64_t> mPublishedAnchorTimeMediaUs;
+    std::atomic<int64_t> mPublishedAnchorTimeRealUs;
+    std::atomic<int64_t> mPublishedMaxTimeMediaUs;
+    std::atomic<int64_t> mPublishedStartingTimeMediaUs;
+    std::atomic<float> mPublishedPlaybackRate;
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaClock);
 };
 
@@ -161,6 +161,33 @@ struct MediaCodec : public AHandler {
             uint32_t *flags,
             int64_t timeoutUs = 0ll);
 
+    // Batched variants of the calls above, which queue or dequeue several buffers with a
+    // single round trip to the codec looper instead of one per buffer.
+    struct BufferDescriptor {
+        size_t mIndex;
+        size_t mOffset;
+        size_t mSize;
+        int64_t mPresentationTimeUs;
+        uint32_t mFlags;
+    };
+
+    // Queues count input buffers in order, stopping at the first one that fails.
+    // *queued is set to the number of buffers actually queued.
+    status_t queueInputBuffers(
+            const BufferDescriptor *buffers,
+            size_t count,
+            size_t *queued,
+            AString *errorDetailMsg = NULL);
+
+    // Waits up to timeoutUs for a buffer like dequeueInputBuffer() and dequeueOutputBuffer(),
+    // then also returns the other buffers already available, up to maxCount in total.
+    // Output format and buffer changes are returned as for dequeueOutputBuffer().
+    status_t dequeueInputBuffers(
+            size_t *indices, size_t maxCount, size_t *count, int64_t timeoutUs = 0ll);
+
+    status_t dequeueOutputBuffers(
+            BufferDescriptor *buffers, size_t maxCount, size_t *count, int64_t timeoutUs = 0ll);
+
     status_t renderOutputBufferAndRelease(size_t index, int64_t timestampNs);
     status_t renderOutputBufferAndRelease(size_t index);
     status_t releaseOutputBuffer(size_t index);
@@ -242,6 +269,9 @@ private:
         kWhatDequeueInputBuffer             = 'deqI',
         kWhatQueueInputBuffer               = 'queI',
         kWhatDequeueOutputBuffer            = 'deqO',
+        kWhatQueueInputBuffers              = 'quIs',
+        kWhatDequeueInputBuffers            = 'dqIs',
+        kWhatDequeueOutputBuffers           = 'dqOs',
         kWhatReleaseOutputBuffer            = 'relO',
         kWhatSignalEndOfInputStream         = 'eois',
         kWhatGetBuffers                     = 'getB',
@@ -341,6 +371,8 @@ private:
     int32_t mVideoWidth;
     int32_t mVideoHeight;
     int32_t mRotationDegrees;
+    // macroblocks per second of the configured video session, 0 if unknown
+    uint64_t mVideoCodecLoad;
 
     // initial create parameters
     AString mInitName;
@@ -402,6 +434,8 @@ private:
 
     bool handleDequeueInputBuffer(const sp<AReplyToken> &replyID, bool newRequest = false);
     bool handleDequeueOutputBuffer(const sp<AReplyToken> &replyID, bool newRequest = false);
+    bool handleDequeueInputBuffers(const sp<AMessage> &msg, const sp<AReplyToken> &replyID);
+    bool handleDequeueOutputBuffers(const sp<AMessage> &msg, const sp<AReplyToken> &replyID);
     void cancelPendingDequeueOperations();
 
     void extractCSD(const sp<AMessage> &format);
@@ -458,6 +492,9 @@ private:
     Mutex mLatencyLock;
     int64_t mLatencyUnknown;    // buffers for which we couldn't calculate latency
 
+    // accumulates the phase timings of a codec flush into the analytics item
+    void onFlushPhasesMeasured(const sp<AMessage> &phases);
+
     void statsBufferSent(int64_t presentationUs);
     void statsBufferReceived(int64_t presentationUs);
 
@@ -98,6 +98,12 @@ private:
      */
     MediaCodecList(std::vector<MediaCodecListBuilderBase*> builders);
 
+    /**
+     * This constructor takes a list loaded from the codec list cache.
+     */
+    MediaCodecList(
+            const sp<AMessage> &globalSettings, std::vector<sp<MediaCodecInfo>> &&codecInfos);
+
     ~MediaCodecList();
 
     status_t initCheck() const;
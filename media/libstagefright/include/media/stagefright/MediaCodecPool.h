@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_CODEC_POOL_H_
+
+#define MEDIA_CODEC_POOL_H_
+
+#include <list>
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Mutex.h>
+
+namespace android {
+
+struct ALooper;
+struct MediaCodec;
+
+// A process-wide pool of codecs that have been allocated and stopped, so that clients creating
+// many short lived codecs of the same kind, e.g. to preview clips, do not pay for allocating the
+// component every time. A recycled codec is stopped, which keeps its component allocated, and
+// only needs to be configured again.
+//
+// The pooled codecs keep their resources registered with the ResourceManagerService, which may
+// reclaim them for other processes as for any codec; reclaimed codecs are dropped from the pool.
+// Idle codecs are also released after media.codec.pool.idle_ms (5 seconds by default), and no
+// more than media.codec.pool.size (2 by default, 0 disables the pool) are kept.
+struct MediaCodecPool : public AHandler {
+    static sp<MediaCodecPool> getInstance();
+
+    // Returns a stopped codec for |mime| from the pool if one was recycled with at least the
+    // given maximum resolution, running on |looper|. Otherwise creates one, as
+    // MediaCodec::CreateByType() does.
+    sp<MediaCodec> acquire(
+            const sp<ALooper> &looper, const AString &mime, bool encoder,
+            int32_t maxWidth = 0, int32_t maxHeight = 0, status_t *err = NULL);
+
+    // Stops |codec|, last configured for |mime| and at most the given resolution, and keeps it
+    // for a later acquire(). Releases it instead if it cannot be stopped or the pool is full.
+    // The caller must not use |codec| afterwards.
+    void recycle(
+            const sp<MediaCodec> &codec, const AString &mime, bool encoder,
+            int32_t maxWidth = 0, int32_t maxHeight = 0);
+
+    // Releases all the pooled codecs.
+    void clear();
+
+protected:
+    virtual ~MediaCodecPool();
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatEvict = 'evic',
+    };
+
+    struct Entry {
+        sp<MediaCodec> mCodec;
+        sp<ALooper> mLooper;
+        AString mMime;
+        bool mEncoder;
+        int32_t mMaxWidth;
+        int32_t mMaxHeight;
+        int64_t mRecycledUs;
+    };
+
+    MediaCodecPool();
+
+    Mutex mLock;
+    std::list<Entry> mEntries;  // most recently recycled first
+    const size_t mMaxSize;
+    const int64_t mMaxIdleUs;
+    sp<ALooper> mLooper;        // for kWhatEvict
+
+    void evict(std::list<sp<MediaCodec> > *evicted, int64_t nowUs);
+    static void releaseAll(const std::list<sp<MediaCodec> > &codecs);
+
+    DISALLOW_EVIL_CONSTRUCTORS(MediaCodecPool);
+};
+
+}  // namespace android
+
+#endif  // MEDIA_CODEC_POOL_H_
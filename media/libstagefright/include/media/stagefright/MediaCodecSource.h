@@ -36,6 +36,10 @@ struct MediaCodecSource : public MediaSource,
     enum FlagBits {
         FLAG_USE_SURFACE_INPUT      = 1,
         FLAG_PREFER_SOFTWARE_CODEC  = 4,  // used for testing only
+        // Lower the video bitrate (and, for buffer input, the frame rate)
+        // while encoded buffers pile up unread by the consumer, and restore
+        // them once it has caught up.
+        FLAG_ADAPTIVE_BITRATE       = 8,
     };
 
     static sp<MediaCodecSource> Create(
@@ -118,6 +122,8 @@ private:
     void signalEOS(status_t err = ERROR_END_OF_STREAM);
     bool reachedEOS();
     status_t postSynchronouslyAndReturnError(const sp<AMessage> &msg);
+    // backlogUs is the time span of the encoded buffers not yet read
+    void adaptToSinkBacklog(int64_t backlogUs);
 
     sp<ALooper> mLooper;
     sp<ALooper> mCodecLooper;
@@ -164,6 +170,15 @@ private:
     bool mIsHFR;
     int32_t mBatchSize;
 
+    // adaptive bitrate state, see FLAG_ADAPTIVE_BITRATE
+    int32_t mTargetBitrate;
+    int32_t mCurrentBitrate;
+    float mTargetFrameRate;
+    float mCurrentFrameRate;
+    int64_t mLastFedTimeUs;
+    int64_t mLastAdaptSystemTimeUs;
+    int64_t mLowBacklogSinceSystemTimeUs;
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaCodecSource);
 };
 
@@ -20,9 +20,13 @@
 
 #include <stdio.h>
 
+#include <map>
+#include <string>
+
 #include <media/IMediaExtractor.h>
 #include <media/MediaExtractor.h>
 #include <utils/List.h>
+#include <utils/String8.h>
 
 namespace android {
 
@@ -36,6 +40,8 @@ public:
     static sp<IMediaExtractor> CreateFromService(
             const sp<DataSource> &source, const char *mime = NULL);
     static void LoadPlugins(const ::std::string& apkPath);
+    // Registers the built-in plugins ahead of the first request.
+    static void PreloadPlugins();
     static status_t dump(int fd, const Vector<String16>& args);
 
 private:
@@ -43,14 +49,30 @@ private:
     static std::shared_ptr<List<sp<ExtractorPlugin>>> gPlugins;
     static bool gPluginsRegistered;
 
+    // sniff hint (MIME type or file extension) -> uuid of the plugin that
+    // last won for it; guarded by gPluginMutex
+    static const size_t kMaxSniffHints = 64;
+    static std::map<std::string, String8> gSniffHints;
+
+    // library path -> what the last scan of the plugin directories found
+    // there, so that a rescan (e.g. for an update apk) doesn't dlopen the
+    // same libraries again; guarded by gPluginMutex
+    struct PluginCacheEntry {
+        off64_t size;
+        int64_t mtimeNs;
+        sp<ExtractorPlugin> plugin;  // null if not a usable extractor
+    };
+    static std::map<std::string, PluginCacheEntry> gPluginCache;
+
     static void RegisterExtractorsInApk(
             const char *apkPath, List<sp<ExtractorPlugin>> &pluginList);
     static void RegisterExtractorsInSystem(
             const char *libDirPath, List<sp<ExtractorPlugin>> &pluginList);
-    static void RegisterExtractor(
+    // returns whether the plugin was added to the list
+    static bool RegisterExtractor(
             const sp<ExtractorPlugin> &plugin, List<sp<ExtractorPlugin>> &pluginList);
 
-    static MediaExtractor::CreatorFunc sniff(DataSourceBase *source,
+    static MediaExtractor::CreatorFunc sniff(DataSourceBase *source, const char *mime,
             float *confidence, void **meta, MediaExtractor::FreeMetaFunc *freeMeta,
             sp<ExtractorPlugin> &plugin);
 
@@ -102,10 +102,10 @@ public:
 
     /**
      * Send a sample buffer for muxing.
-     * The buffer can be reused once this method returns. Typically,
-     * this function won't be blocked for very long, and thus there
-     * is no need to use a separate thread calling this method to
-     * push a buffer.
+     * The sample is copied, so the buffer can be reused once this method
+     * returns. Samples are queued per track for the writer; this call only
+     * blocks while its own track already has a few MB waiting, so threads
+     * feeding different tracks don't hold each other up.
      * @param buffer the incoming sample buffer.
      * @param trackIndex the buffer's track index number.
      * @param timeUs the buffer's time stamp.
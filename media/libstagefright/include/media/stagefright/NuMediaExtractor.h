@@ -32,6 +32,7 @@
 namespace android {
 
 struct ABuffer;
+struct ALooper;
 struct AMessage;
 class DataSource;
 struct MediaHTTPService;
@@ -97,6 +98,16 @@ struct NuMediaExtractor : public RefBase {
 
     bool getCachedDuration(int64_t *durationUs, bool *eos) const;
 
+    // Number of samples read ahead per selected track by a dedicated worker
+    // thread, so that consuming one track does not wait on the I/O of the
+    // others. 0 disables prefetching. Applies to tracks selected afterwards.
+    status_t setPrefetchDepth(size_t depth);
+
+    // Prefetch queue statistics of a selected track. |underruns| counts the
+    // samples that had to be waited for because the queue had run dry.
+    status_t getPrefetchStats(
+            size_t index, size_t *queuedSamples, size_t *depth, int64_t *underruns) const;
+
 protected:
     virtual ~NuMediaExtractor();
 
@@ -107,6 +118,7 @@ private:
 
     enum {
         kMaxTrackCount = 16384,
+        kMaxPrefetchDepth = 1024,
     };
 
     struct Sample {
@@ -116,8 +128,11 @@ private:
         int64_t mSampleTimeUs;
     };
 
+    struct TrackPrefetcher;
+
     struct TrackInfo {
         sp<IMediaSource> mSource;
+        sp<TrackPrefetcher> mPrefetcher;
         size_t mTrackIndex;
         media_track_type mTrackType;
         size_t mMaxFetchCount;
@@ -137,6 +152,7 @@ private:
     Vector<TrackInfo> mSelectedTracks;
     int64_t mTotalBitrate;  // in bits/sec
     int64_t mDurationUs;
+    size_t mPrefetchDepth;
 
     ssize_t fetchAllTrackSamples(
             int64_t seekTimeUs = -1ll,
@@ -148,6 +164,12 @@ private:
             MediaSource::ReadOptions::SeekMode mode =
                 MediaSource::ReadOptions::SEEK_CLOSEST_SYNC);
 
+    void fetchPrefetchedSample(
+            TrackInfo *info,
+            int64_t seekTimeUs,
+            MediaSource::ReadOptions::SeekMode mode);
+    void stopTrack(TrackInfo *info);
+
     void releaseOneSample(TrackInfo *info);
     void releaseTrackSamples(TrackInfo *info);
     void releaseAllTrackSamples();
@@ -37,6 +37,11 @@ public:
     virtual status_t read(
             MediaBufferBase **buffer,
             const MediaSource::ReadOptions *options = NULL);
+    virtual status_t readMultiple(
+            Vector<MediaBufferBase *> *buffers, uint32_t maxNumBuffers = 1,
+            const MediaSource::ReadOptions *options = nullptr);
+    virtual bool supportReadMultiple();
+    virtual bool supportNonblockingRead();
     virtual status_t pause();
     virtual status_t setStopTimeUs(int64_t stopTimeUs);
 
@@ -42,6 +42,10 @@ struct VideoFrameScheduler : public RefBase {
     // returns the current frames-per-second, or 0.f if not primed
     float getFrameRate();
 
+    // returns the number of frames since init() that stayed on the display
+    // for more or fewer vsyncs than the frame rate allows for
+    int64_t getNumJudderFrames() const;
+
     void release();
 
     static const size_t kHistorySize = 8;
@@ -83,6 +87,11 @@ private:
 
     void updateVsync();
 
+    // returns the frame period in half vsyncs if it is close enough to one to
+    // hold frames for a fixed pull-down cadence (e.g. 5 for 3:2 pull-down of
+    // 24fps at 60Hz, 10 for 5:5 at 120Hz), or 0
+    size_t getCadence(nsecs_t videoPeriod) const;
+
     nsecs_t mVsyncTime;        // vsync timing from display
     nsecs_t mVsyncPeriod;
     nsecs_t mVsyncRefreshAt;   // next time to refresh timing info
@@ -90,6 +99,11 @@ private:
     nsecs_t mLastVsyncTime;    // estimated vsync time for last frame
     nsecs_t mTimeCorrection;   // running adjustment
 
+    size_t  mCadence;          // frame period in half vsyncs, or 0 if none
+    size_t  mCadenceIndex;     // frames since the cadence was anchored
+
+    int64_t mNumJudderFrames;  // frames held off the cadence
+
     PLL mPll;                  // PLL for video frame rate based on render time
 
     sp<ISurfaceComposer> mComposer;
@@ -93,6 +93,10 @@ struct ATSParser::Program : public RefBase {
 
     unsigned number() const { return mProgramNumber; }
 
+    bool hasPID(unsigned pid) const {
+        return mStreams.indexOfKey(pid) >= 0;
+    }
+
     void updateProgramMapPID(unsigned programMapPID) {
         mProgramMapPID = programMapPID;
     }
@@ -215,7 +219,6 @@ private:
     sp<MemoryDealer> mDealer;
     sp<HidlMemory> mHidlMemory;
     hardware::cas::native::V1_0::SharedBuffer mDescramblerSrcBuffer;
-    sp<ABuffer> mDescrambledBuffer;
     List<SubSampleInfo> mSubSamples;
     sp<IDescrambler> mDescrambler;
 
@@ -834,7 +837,7 @@ bool ATSParser::Stream::ensureBufferCapacity(size_t neededSize) {
     ALOGV("ensureBufferCapacity: current size %zu, new size %zu, scrambled %d",
             mBuffer == NULL ? 0 : mBuffer->capacity(), neededSize, mScrambled);
 
-    sp<ABuffer> newBuffer, newScrambledBuffer;
+    sp<ABuffer> newBuffer;
     sp<IMemory> newMem;
     sp<MemoryDealer> newDealer;
     if (mScrambled) {
@@ -844,18 +847,9 @@ bool ATSParser::Stream::ensureBufferCapacity(size_t neededSize) {
         neededSize = (neededSize + 65535) & ~65535;
         newDealer = new MemoryDealer(neededSize, "ATSParser");
         newMem = newDealer->allocate(neededSize);
-        newScrambledBuffer = new ABuffer(newMem->pointer(), newMem->size());
-
-        if (mDescrambledBuffer != NULL) {
-            memcpy(newScrambledBuffer->data(),
-                    mDescrambledBuffer->data(), mDescrambledBuffer->size());
-            newScrambledBuffer->setRange(0, mDescrambledBuffer->size());
-        } else {
-            newScrambledBuffer->setRange(0, 0);
+        if (newMem == NULL) {
+            return false;
         }
-        mMem = newMem;
-        mDealer = newDealer;
-        mDescrambledBuffer = newScrambledBuffer;
 
         ssize_t offset;
         size_t size;
@@ -864,6 +858,19 @@ bool ATSParser::Stream::ensureBufferCapacity(size_t neededSize) {
             return false;
         }
 
+        // The PES payload is accumulated straight into the memory shared
+        // with the descrambler, which then descrambles it in place.
+        newBuffer = new ABuffer(newMem->pointer(), newMem->size());
+        if (mBuffer != NULL) {
+            memcpy(newBuffer->data(), mBuffer->data(), mBuffer->size());
+            newBuffer->setRange(0, mBuffer->size());
+        } else {
+            newBuffer->setRange(0, 0);
+        }
+        mBuffer = newBuffer;
+        mMem = newMem;
+        mDealer = newDealer;
+
         mHidlMemory = fromHeap(heap);
         mDescramblerSrcBuffer.heapBase = *mHidlMemory;
         mDescramblerSrcBuffer.offset = (uint64_t) offset;
@@ -871,11 +878,12 @@ bool ATSParser::Stream::ensureBufferCapacity(size_t neededSize) {
 
         ALOGD("[stream %d] created shared buffer for descrambling, offset %zd, size %zu",
                 mElementaryPID, offset, size);
-    } else {
-        // Align to multiples of 64K.
-        neededSize = (neededSize + 65535) & ~65535;
+        return true;
     }
 
+    // Align to multiples of 64K.
+    neededSize = (neededSize + 65535) & ~65535;
+
     newBuffer = new ABuffer(neededSize);
     if (mBuffer != NULL) {
         memcpy(newBuffer->data(), mBuffer->data(), mBuffer->size());
@@ -1356,7 +1364,7 @@ status_t ATSParser::Stream::flushScrambled(SyncEvent *event) {
         return UNKNOWN_ERROR;
     }
 
-    if (mDescrambledBuffer == NULL || mMem == NULL) {
+    if (mMem == NULL) {
         ALOGE("received scrambled packets without shared memory!");
 
         return UNKNOWN_ERROR;
@@ -1403,9 +1411,6 @@ status_t ATSParser::Stream::flushScrambled(SyncEvent *event) {
 
     // Perform the 1st pass descrambling if needed
     if (descrambleBytes > 0) {
-        memcpy(mDescrambledBuffer->data(), mBuffer->data(), descrambleBytes);
-        mDescrambledBuffer->setRange(0, descrambleBytes);
-
         hidl_vec<SubSample> subSamples;
         subSamples.resize(descrambleSubSamples);
 
@@ -1459,7 +1464,6 @@ status_t ATSParser::Stream::flushScrambled(SyncEvent *event) {
 
         ALOGV("[stream %d] descramble succeeded, %d bytes",
                 mElementaryPID, bytesWritten);
-        memcpy(mBuffer->data(), mDescrambledBuffer->data(), descrambleBytes);
     }
 
     if (mQueue->isScrambled()) {
@@ -1676,6 +1680,7 @@ ATSParser::ATSParser(uint32_t flags)
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
     mCasManager = new CasManager();
+    invalidatePIDFilter();
 }
 
 ATSParser::~ATSParser() {
@@ -1692,11 +1697,82 @@ status_t ATSParser::feedTSPacket(const void *data, size_t size,
     return parseTS(&br, event);
 }
 
+status_t ATSParser::feedTSPackets(const uint8_t *data, size_t size) {
+    // Headers are decoded in batches ahead of the per-packet work.
+    static const size_t kBatchSize = 64;
+    static const uint16_t kErrorPID = 0xffff;
+    uint16_t PIDs[kBatchSize];
+
+    size_t numPackets = size / kTSPacketSize;
+    while (numPackets > 0) {
+        size_t n = numPackets < kBatchSize ? numPackets : kBatchSize;
+
+        size_t numValid = 0;
+        const uint8_t *packet = data;
+        for (; numValid < n; ++numValid, packet += kTSPacketSize) {
+            if (packet[0] != 0x47u) {
+                break;
+            }
+            // Packets with transport_error_indicator set are marked with
+            // an out of range PID.
+            PIDs[numValid] = (packet[1] & 0x80)
+                    ? kErrorPID : ((packet[1] & 0x1f) << 8 | packet[2]);
+        }
+
+        packet = data;
+        for (size_t i = 0; i < numValid; ++i, packet += kTSPacketSize) {
+            unsigned PID = PIDs[i];
+            if (PID == kErrorPID) {
+                // silently ignore, as parseTS() does.
+                continue;
+            }
+            if (!isPIDHandled(PID)) {
+                ++mNumTSPacketsParsed;
+                continue;
+            }
+
+            ABitReader br(packet, kTSPacketSize);
+            status_t err = parseTS(&br, NULL);
+            if (err != OK) {
+                return err;
+            }
+        }
+
+        if (numValid < n) {
+            ALOGE("[error] feedTSPackets: return error as sync_byte=0x%x",
+                    data[numValid * kTSPacketSize]);
+            return BAD_VALUE;
+        }
+
+        data += n * kTSPacketSize;
+        numPackets -= n;
+    }
+
+    return OK;
+}
+
+void ATSParser::invalidatePIDFilter() {
+    memset(mPIDFilter, kPIDUnknown, sizeof(mPIDFilter));
+}
+
+bool ATSParser::isPIDHandled(unsigned PID) {
+    if (mPIDFilter[PID] == kPIDUnknown) {
+        bool handled = mPSISections.indexOfKey(PID) >= 0
+                || mCasManager->handlesPID(PID);
+        for (size_t i = 0; !handled && i < mPrograms.size(); ++i) {
+            handled = mPrograms.itemAt(i)->hasPID(PID);
+        }
+        mPIDFilter[PID] = handled ? kPIDHandled : kPIDIgnored;
+    }
+    return mPIDFilter[PID] == kPIDHandled;
+}
+
 status_t ATSParser::setMediaCas(const sp<ICas> &cas) {
     status_t err = mCasManager->setMediaCas(cas);
     if (err != OK) {
         return err;
     }
+    invalidatePIDFilter();
     for (size_t i = 0; i < mPrograms.size(); ++i) {
         mPrograms.editItemAt(i)->updateCasSessions();
     }
@@ -1869,6 +1945,9 @@ status_t ATSParser::parsePID(
         }
         ABitReader sectionBits(section->data(), section->size());
 
+        // Programs, streams and CA PIDs only change through PSI sections.
+        invalidatePIDFilter();
+
         if (PID == 0) {
             parseProgramAssociationTable(&sectionBits);
         } else {
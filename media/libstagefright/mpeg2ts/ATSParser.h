@@ -121,6 +121,13 @@ struct ATSParser : public RefBase {
     status_t feedTSPacket(
             const void *data, size_t size, SyncEvent *event = NULL);
 
+    // Feed size / kTSPacketSize consecutive TS packets into the parser.
+    // Packet headers are validated and decoded a batch at a time, and
+    // packets of PIDs the parser does not handle are dropped without being
+    // parsed further. Stops at, and returns, the first error; the packets
+    // before it have been consumed. No sync events are reported.
+    status_t feedTSPackets(const uint8_t *data, size_t size);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -191,6 +198,17 @@ private:
 
     size_t mNumTSPacketsParsed;
 
+    // Per-PID cache of whether the parser handles packets of that PID.
+    enum {
+        kPIDUnknown = 0,
+        kPIDHandled,
+        kPIDIgnored,
+    };
+    uint8_t mPIDFilter[8192];
+
+    bool isPIDHandled(unsigned PID);
+    void invalidatePIDFilter();
+
     sp<AMessage> mSampleAesKeyItem;
 
     void parseProgramAssociationTable(ABitReader *br);
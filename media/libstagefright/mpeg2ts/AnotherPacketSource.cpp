@@ -31,6 +31,8 @@
 #include <media/stagefright/Utils.h>
 #include <utils/Vector.h>
 
+#include <algorithm>
+
 #include <inttypes.h>
 
 namespace android {
@@ -46,7 +48,10 @@ AnotherPacketSource::AnotherPacketSource(const sp<MetaData> &meta)
       mEstimatedBufferDurationUs(-1),
       mEOSResult(OK),
       mLatestEnqueuedMeta(NULL),
-      mLatestDequeuedMeta(NULL) {
+      mLatestDequeuedMeta(NULL),
+      mBufferedBytes(0),
+      mDataBufferCount(0),
+      mBufferedDurationUs(0) {
     setFormat(meta);
 
     mDiscontinuitySegments.push_back(DiscontinuitySegment());
@@ -95,11 +100,10 @@ sp<MetaData> AnotherPacketSource::getFormat() {
         return mFormat;
     }
 
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
+    std::deque<sp<ABuffer> >::iterator it = mBuffers.begin();
     while (it != mBuffers.end()) {
         sp<ABuffer> buffer = *it;
-        int32_t discontinuity;
-        if (!buffer->meta()->findInt32("discontinuity", &discontinuity)) {
+        if (!IsDiscontinuity(buffer)) {
             sp<RefBase> object;
             if (buffer->meta()->findObject("format", &object)) {
                 setFormat(static_cast<MetaData*>(object.get()));
@@ -121,8 +125,9 @@ status_t AnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
     }
 
     if (!mBuffers.empty()) {
-        *buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        *buffer = mBuffers.front();
+        mBuffers.pop_front();
+        onBufferRemovedLocked(*buffer);
 
         int32_t discontinuity;
         if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
@@ -130,6 +135,8 @@ status_t AnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
                 mFormat.clear();
             }
 
+            const DiscontinuitySegment &seg = *mDiscontinuitySegments.begin();
+            mBufferedDurationUs -= seg.mMaxEnqueTimeUs - seg.mMaxDequeTimeUs;
             mDiscontinuitySegments.erase(mDiscontinuitySegments.begin());
             // CHECK(!mDiscontinuitySegments.empty());
             return INFO_DISCONTINUITY;
@@ -142,6 +149,7 @@ status_t AnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
         mLatestDequeuedMeta = (*buffer)->meta()->dup();
         CHECK(mLatestDequeuedMeta->findInt64("timeUs", &timeUs));
         if (timeUs > seg.mMaxDequeTimeUs) {
+            mBufferedDurationUs -= timeUs - seg.mMaxDequeTimeUs;
             seg.mMaxDequeTimeUs = timeUs;
         }
 
@@ -160,6 +168,7 @@ void AnotherPacketSource::requeueAccessUnit(const sp<ABuffer> &buffer) {
     // TODO: update corresponding book keeping info.
     Mutex::Autolock autoLock(mLock);
     mBuffers.push_front(buffer);
+    onBufferQueuedLocked(buffer);
 }
 
 status_t AnotherPacketSource::read(
@@ -173,8 +182,9 @@ status_t AnotherPacketSource::read(
 
     if (!mBuffers.empty()) {
 
-        const sp<ABuffer> buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        const sp<ABuffer> buffer = mBuffers.front();
+        mBuffers.pop_front();
+        onBufferRemovedLocked(buffer);
 
         int32_t discontinuity;
         if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
@@ -182,6 +192,8 @@ status_t AnotherPacketSource::read(
                 mFormat.clear();
             }
 
+            const DiscontinuitySegment &seg = *mDiscontinuitySegments.begin();
+            mBufferedDurationUs -= seg.mMaxEnqueTimeUs - seg.mMaxDequeTimeUs;
             mDiscontinuitySegments.erase(mDiscontinuitySegments.begin());
             // CHECK(!mDiscontinuitySegments.empty());
             return INFO_DISCONTINUITY;
@@ -199,6 +211,7 @@ status_t AnotherPacketSource::read(
         // CHECK(!mDiscontinuitySegments.empty());
         DiscontinuitySegment &seg = *mDiscontinuitySegments.begin();
         if (timeUs > seg.mMaxDequeTimeUs) {
+            mBufferedDurationUs -= timeUs - seg.mMaxDequeTimeUs;
             seg.mMaxDequeTimeUs = timeUs;
         }
 
@@ -270,6 +283,40 @@ bool AnotherPacketSource::wasFormatChange(
     return false;
 }
 
+// static
+bool AnotherPacketSource::IsDiscontinuity(const sp<ABuffer> &buffer) {
+    int32_t discontinuity;
+    return buffer->meta()->findInt32("discontinuity", &discontinuity);
+}
+
+void AnotherPacketSource::onBufferQueuedLocked(const sp<ABuffer> &buffer) {
+    mBufferedBytes += buffer->size();
+    if (!IsDiscontinuity(buffer)) {
+        ++mDataBufferCount;
+    }
+}
+
+void AnotherPacketSource::onBufferRemovedLocked(const sp<ABuffer> &buffer) {
+    mBufferedBytes -= buffer->size();
+    if (!IsDiscontinuity(buffer)) {
+        --mDataBufferCount;
+    }
+}
+
+// Recomputes mBufferedDurationUs after segments were edited other than by
+// queueing or dequeueing a single access unit.
+void AnotherPacketSource::updateBufferedDurationLocked() {
+    mBufferedDurationUs = 0;
+    for (List<DiscontinuitySegment>::iterator it = mDiscontinuitySegments.begin();
+            it != mDiscontinuitySegments.end();
+            ++it) {
+        const DiscontinuitySegment &seg = *it;
+        // dequeued access units should be a subset of enqueued access units
+        // CHECK(seg.maxEnqueTimeUs >= seg.mMaxDequeTimeUs);
+        mBufferedDurationUs += (seg.mMaxEnqueTimeUs - seg.mMaxDequeTimeUs);
+    }
+}
+
 void AnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
     int32_t damaged;
     if (buffer->meta()->findInt32("damaged", &damaged) && damaged) {
@@ -279,6 +326,7 @@ void AnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
 
     Mutex::Autolock autoLock(mLock);
     mBuffers.push_back(buffer);
+    onBufferQueuedLocked(buffer);
     mCondition.signal();
 
     int32_t discontinuity;
@@ -301,12 +349,14 @@ void AnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
 
     // CHECK(!mDiscontinuitySegments.empty());
     DiscontinuitySegment &tailSeg = *(--mDiscontinuitySegments.end());
+    mBufferedDurationUs -= tailSeg.mMaxEnqueTimeUs - tailSeg.mMaxDequeTimeUs;
     if (lastQueuedTimeUs > tailSeg.mMaxEnqueTimeUs) {
         tailSeg.mMaxEnqueTimeUs = lastQueuedTimeUs;
     }
     if (tailSeg.mMaxDequeTimeUs == -1) {
         tailSeg.mMaxDequeTimeUs = lastQueuedTimeUs;
     }
+    mBufferedDurationUs += tailSeg.mMaxEnqueTimeUs - tailSeg.mMaxDequeTimeUs;
 
     if (mLatestEnqueuedMeta == NULL) {
         mLatestEnqueuedMeta = buffer->meta()->dup();
@@ -330,10 +380,13 @@ void AnotherPacketSource::clear() {
     Mutex::Autolock autoLock(mLock);
 
     mBuffers.clear();
+    mBufferedBytes = 0;
+    mDataBufferCount = 0;
     mEOSResult = OK;
 
     mDiscontinuitySegments.clear();
     mDiscontinuitySegments.push_back(DiscontinuitySegment());
+    mBufferedDurationUs = 0;
 
     mFormat = NULL;
     mLatestEnqueuedMeta = NULL;
@@ -349,19 +402,14 @@ void AnotherPacketSource::queueDiscontinuity(
 
     if (discard) {
         // Leave only discontinuities in the queue.
-        List<sp<ABuffer> >::iterator it = mBuffers.begin();
-        while (it != mBuffers.end()) {
-            sp<ABuffer> oldBuffer = *it;
-
-            int32_t oldDiscontinuityType;
-            if (!oldBuffer->meta()->findInt32(
-                        "discontinuity", &oldDiscontinuityType)) {
-                it = mBuffers.erase(it);
-                continue;
-            }
-
-            ++it;
-        }
+        mBuffers.erase(
+                std::remove_if(mBuffers.begin(), mBuffers.end(),
+                        [](const sp<ABuffer> &oldBuffer) {
+                            return !IsDiscontinuity(oldBuffer);
+                        }),
+                mBuffers.end());
+        mBufferedBytes = 0;
+        mDataBufferCount = 0;
 
         for (List<DiscontinuitySegment>::iterator it2 = mDiscontinuitySegments.begin();
                 it2 != mDiscontinuitySegments.end();
@@ -369,6 +417,7 @@ void AnotherPacketSource::queueDiscontinuity(
             DiscontinuitySegment &seg = *it2;
             seg.clear();
         }
+        mBufferedDurationUs = 0;
 
     }
 
@@ -387,6 +436,7 @@ void AnotherPacketSource::queueDiscontinuity(
     buffer->meta()->setMessage("extra", extra);
 
     mBuffers.push_back(buffer);
+    onBufferQueuedLocked(buffer);
     mCondition.signal();
 }
 
@@ -418,12 +468,8 @@ bool AnotherPacketSource::hasDataBufferAvailable(status_t *finalResult) {
     if (!mEnabled) {
         return false;
     }
-    List<sp<ABuffer> >::iterator it;
-    for (it = mBuffers.begin(); it != mBuffers.end(); it++) {
-        int32_t discontinuity;
-        if (!(*it)->meta()->findInt32("discontinuity", &discontinuity)) {
-            return true;
-        }
+    if (mDataBufferCount > 0) {
+        return true;
     }
 
     *finalResult = mEOSResult;
@@ -447,18 +493,12 @@ size_t AnotherPacketSource::getAvailableBufferCount(status_t *finalResult) {
 int64_t AnotherPacketSource::getBufferedDurationUs(status_t *finalResult) {
     Mutex::Autolock autoLock(mLock);
     *finalResult = mEOSResult;
+    return mBufferedDurationUs;
+}
 
-    int64_t durationUs = 0;
-    for (List<DiscontinuitySegment>::iterator it = mDiscontinuitySegments.begin();
-            it != mDiscontinuitySegments.end();
-            ++it) {
-        const DiscontinuitySegment &seg = *it;
-        // dequeued access units should be a subset of enqueued access units
-        // CHECK(seg.maxEnqueTimeUs >= seg.mMaxDequeTimeUs);
-        durationUs += (seg.mMaxEnqueTimeUs - seg.mMaxDequeTimeUs);
-    }
-
-    return durationUs;
+size_t AnotherPacketSource::getBufferedBytes() {
+    Mutex::Autolock autoLock(mLock);
+    return mBufferedBytes;
 }
 
 int64_t AnotherPacketSource::getEstimatedBufferDurationUs() {
@@ -468,7 +508,7 @@ int64_t AnotherPacketSource::getEstimatedBufferDurationUs() {
     }
 
     SortedVector<int64_t> maxTimesUs;
-    List<sp<ABuffer> >::iterator it;
+    std::deque<sp<ABuffer> >::iterator it;
     int64_t t1 = 0, t2 = 0;
     for (it = mBuffers.begin(); it != mBuffers.end(); ++it) {
         int64_t timeUs = 0;
@@ -495,7 +535,7 @@ status_t AnotherPacketSource::nextBufferTime(int64_t *timeUs) {
         return mEOSResult != OK ? mEOSResult : -EWOULDBLOCK;
     }
 
-    sp<ABuffer> buffer = *mBuffers.begin();
+    sp<ABuffer> buffer = mBuffers.front();
     CHECK(buffer->meta()->findInt64("timeUs", timeUs));
 
     return OK;
@@ -537,11 +577,10 @@ sp<AMessage> AnotherPacketSource::getMetaAfterLastDequeued(int64_t delayUs) {
     int64_t lastUs = -1;
     int64_t durationUs = 0;
 
-    List<sp<ABuffer> >::iterator it;
+    std::deque<sp<ABuffer> >::iterator it;
     for (it = mBuffers.begin(); it != mBuffers.end(); ++it) {
         const sp<ABuffer> &buffer = *it;
-        int32_t discontinuity;
-        if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
+        if (IsDiscontinuity(buffer)) {
             durationUs += lastUs - firstUs;
             firstUs = -1;
             lastUs = -1;
@@ -582,7 +621,7 @@ void AnotherPacketSource::trimBuffersAfterMeta(
     ALOGV("trimBuffersAfterMeta: discontinuitySeq %d, timeUs %lld",
             stopTime.mSeq, (long long)stopTime.mTimeUs);
 
-    List<sp<ABuffer> >::iterator it;
+    std::deque<sp<ABuffer> >::iterator it;
     List<DiscontinuitySegment >::iterator it2;
     sp<AMessage> newLatestEnqueuedMeta = NULL;
     int64_t newLastQueuedTimeUs = 0;
@@ -605,6 +644,9 @@ void AnotherPacketSource::trimBuffersAfterMeta(
         newLastQueuedTimeUs = curTime.mTimeUs;
     }
 
+    for (std::deque<sp<ABuffer> >::iterator it3 = it; it3 != mBuffers.end(); ++it3) {
+        onBufferRemovedLocked(*it3);
+    }
     mBuffers.erase(it, mBuffers.end());
     mLatestEnqueuedMeta = newLatestEnqueuedMeta;
     mLastQueuedTimeUs = newLastQueuedTimeUs;
@@ -616,6 +658,7 @@ void AnotherPacketSource::trimBuffersAfterMeta(
         seg.clear();
     }
     mDiscontinuitySegments.erase(++it2, mDiscontinuitySegments.end());
+    updateBufferedDurationLocked();
 }
 
 /*
@@ -641,11 +684,10 @@ sp<AMessage> AnotherPacketSource::trimBuffersBeforeMeta(
     sp<MetaData> format;
     bool isAvc = false;
 
-    List<sp<ABuffer> >::iterator it;
+    std::deque<sp<ABuffer> >::iterator it;
     for (it = mBuffers.begin(); it != mBuffers.end(); ++it) {
         const sp<ABuffer> &buffer = *it;
-        int32_t discontinuity;
-        if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
+        if (IsDiscontinuity(buffer)) {
             mDiscontinuitySegments.erase(mDiscontinuitySegments.begin());
             // CHECK(!mDiscontinuitySegments.empty());
             format = NULL;
@@ -675,6 +717,9 @@ sp<AMessage> AnotherPacketSource::trimBuffersBeforeMeta(
             break;
         }
     }
+    for (std::deque<sp<ABuffer> >::iterator it3 = mBuffers.begin(); it3 != it; ++it3) {
+        onBufferRemovedLocked(*it3);
+    }
     mBuffers.erase(mBuffers.begin(), it);
     mLatestDequeuedMeta = NULL;
 
@@ -685,6 +730,7 @@ sp<AMessage> AnotherPacketSource::trimBuffersBeforeMeta(
     } else {
         seg.clear();
     }
+    updateBufferedDurationLocked();
 
     return firstMeta;
 }
@@ -23,6 +23,8 @@
 #include <utils/threads.h>
 #include <utils/List.h>
 
+#include <deque>
+
 #include "ATSParser.h"
 
 namespace android {
@@ -57,6 +59,13 @@ struct AnotherPacketSource : public MediaSource {
     // presentation timestamps since the last discontinuity (if any).
     int64_t getBufferedDurationUs(status_t *finalResult);
 
+    // Returns the total size of the queued access units.
+    size_t getBufferedBytes();
+
+    // The queries above are answered from running totals that are kept up
+    // to date as access units are queued and removed, so they are cheap
+    // enough to be polled on every buffering check.
+
     // Returns the difference between the two largest timestamps queued
     int64_t getEstimatedBufferDurationUs();
 
@@ -117,13 +126,23 @@ private:
     sp<MetaData> mFormat;
     int64_t mLastQueuedTimeUs;
     int64_t mEstimatedBufferDurationUs;
-    List<sp<ABuffer> > mBuffers;
+    std::deque<sp<ABuffer> > mBuffers;
     status_t mEOSResult;
     sp<AMessage> mLatestEnqueuedMeta;
     sp<AMessage> mLatestDequeuedMeta;
 
+    // Running totals over mBuffers and mDiscontinuitySegments
+    size_t mBufferedBytes;
+    size_t mDataBufferCount;
+    int64_t mBufferedDurationUs;
+
     bool wasFormatChange(int32_t discontinuityType) const;
 
+    static bool IsDiscontinuity(const sp<ABuffer> &buffer);
+    void onBufferQueuedLocked(const sp<ABuffer> &buffer);
+    void onBufferRemovedLocked(const sp<ABuffer> &buffer);
+    void updateBufferedDurationLocked();
+
     DISALLOW_EVIL_CONSTRUCTORS(AnotherPacketSource);
 };
 
@@ -49,6 +49,11 @@ struct ATSParser::CasManager : public RefBase {
 
     bool isCAPid(unsigned pid);
 
+    // Whether parsePID() would consume packets of |pid| (ECMs).
+    bool handlesPID(unsigned pid) const {
+        return mCAPidToSessionIdMap.indexOfKey(pid) >= 0;
+    }
+
     bool parsePID(ABitReader *br, unsigned pid);
 
 private:
@@ -235,43 +235,6 @@ static bool IsSeeminglyValidADTSHeader(
     return true;
 }
 
-static bool IsSeeminglyValidMPEGAudioHeader(const uint8_t *ptr, size_t size) {
-    if (size < 3) {
-        // Not enough data to verify header.
-        return false;
-    }
-
-    if (ptr[0] != 0xff || (ptr[1] >> 5) != 0x07) {
-        return false;
-    }
-
-    unsigned ID = (ptr[1] >> 3) & 3;
-
-    if (ID == 1) {
-        return false;  // reserved
-    }
-
-    unsigned layer = (ptr[1] >> 1) & 3;
-
-    if (layer == 0) {
-        return false;  // reserved
-    }
-
-    unsigned bitrateIndex = (ptr[2] >> 4);
-
-    if (bitrateIndex == 0x0f) {
-        return false;  // reserved
-    }
-
-    unsigned samplingRateIndex = (ptr[2] >> 2) & 3;
-
-    if (samplingRateIndex == 3) {
-        return false;  // reserved
-    }
-
-    return true;
-}
-
 status_t ElementaryStreamQueue::appendData(
         const void *data, size_t size, int64_t timeUs,
         int32_t payloadOffset, uint32_t pesScramblingControl) {
@@ -293,17 +256,11 @@ status_t ElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
-
-                if (startOffset < 0) {
+                const uint8_t *startCode = findStartCode(ptr, size);
+                if (startCode == NULL) {
                     return ERROR_MALFORMED;
                 }
+                ssize_t startOffset = startCode - ptr;
 
                 if (mFormat == NULL && startOffset > 0) {
                     ALOGI("found something resembling an H.264/MPEG syncword "
@@ -326,17 +283,11 @@ status_t ElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
-
-                if (startOffset < 0) {
+                const uint8_t *startCode = findStartCode(ptr, size);
+                if (startCode == NULL) {
                     return ERROR_MALFORMED;
                 }
+                ssize_t startOffset = startCode - ptr;
 
                 if (startOffset > 0) {
                     ALOGI("found something resembling an H.264/MPEG syncword "
@@ -422,13 +373,7 @@ status_t ElementaryStreamQueue::appendData(
             {
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i < size; ++i) {
-                    if (IsSeeminglyValidMPEGAudioHeader(&ptr[i], size - i)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
+                ssize_t startOffset = FindMPEGAudioSyncWord(ptr, size);
 
                 if (startOffset < 0) {
                     return ERROR_MALFORMED;
@@ -615,6 +560,30 @@ sp<ABuffer> ElementaryStreamQueue::dequeueScrambledAccessUnit() {
     return scrambledAccessUnit;
 }
 
+sp<ABuffer> ElementaryStreamQueue::takeAccessUnit(
+        size_t offset, size_t size, size_t consumed) {
+    CHECK_LE(offset + size, consumed);
+    CHECK_LE(consumed, mBuffer->size());
+
+    size_t remaining = mBuffer->size() - consumed;
+    sp<ABuffer> buffer = new ABuffer(mBuffer->capacity());
+    if (buffer->base() == NULL) {
+        // fall back to copying out the access unit
+        sp<ABuffer> accessUnit = new ABuffer(size);
+        memcpy(accessUnit->data(), mBuffer->data() + offset, size);
+        memmove(mBuffer->data(), mBuffer->data() + consumed, remaining);
+        mBuffer->setRange(0, remaining);
+        return accessUnit;
+    }
+
+    sp<ABuffer> accessUnit = mBuffer->slice(offset, size);
+    memcpy(buffer->data(), mBuffer->data() + consumed, remaining);
+    buffer->setRange(0, remaining);
+    mBuffer = buffer;
+
+    return accessUnit;
+}
+
 sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
     if ((mFlags & kFlag_AlignedData) && mMode == H264 && !isScrambled()) {
         if (mRangeInfos.empty()) {
@@ -624,16 +593,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
         RangeInfo info = *mRangeInfos.begin();
         mRangeInfos.erase(mRangeInfos.begin());
 
-        sp<ABuffer> accessUnit = new ABuffer(info.mLength);
-        memcpy(accessUnit->data(), mBuffer->data(), info.mLength);
+        sp<ABuffer> accessUnit = takeAccessUnit(0, info.mLength, info.mLength);
         accessUnit->meta()->setInt64("timeUs", info.mTimestampUs);
 
-        memmove(mBuffer->data(),
-                mBuffer->data() + info.mLength,
-                mBuffer->size() - info.mLength);
-
-        mBuffer->setRange(0, mBuffer->size() - info.mLength);
-
         if (mFormat == NULL) {
             mFormat = new MetaData;
             if (!MakeAVCCodecSpecificData(*mFormat, accessUnit->data(), accessUnit->size())) {
@@ -718,19 +680,12 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAC3() {
     }
     mAUIndex++;
 
-    sp<ABuffer> accessUnit = new ABuffer(syncStartPos + payloadSize);
-    memcpy(accessUnit->data(), mBuffer->data(), syncStartPos + payloadSize);
+    sp<ABuffer> accessUnit = takeAccessUnit(
+            0, syncStartPos + payloadSize, syncStartPos + payloadSize);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + syncStartPos + payloadSize,
-            mBuffer->size() - syncStartPos - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - syncStartPos - payloadSize);
-
     return accessUnit;
 }
 
@@ -776,14 +731,14 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(payloadSize);
-    memcpy(accessUnit->data(), mBuffer->data() + 4, payloadSize);
-
     int64_t timeUs = fetchTimestamp(payloadSize + 4);
     if (timeUs < 0ll) {
         ALOGE("Negative timeUs");
         return NULL;
     }
+
+    // byte-swapped in place below, which is fine as mBuffer lets go of it
+    sp<ABuffer> accessUnit = takeAccessUnit(4, payloadSize, 4 + payloadSize);
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
@@ -792,13 +747,6 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         ptr[i] = ntohs(ptr[i]);
     }
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + 4 + payloadSize,
-            mBuffer->size() - 4 - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - 4 - payloadSize);
-
     return accessUnit;
 }
 
@@ -952,12 +900,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
 
     int64_t timeUs = fetchTimestamp(offset);
 
-    sp<ABuffer> accessUnit = new ABuffer(offset);
-    memcpy(accessUnit->data(), mBuffer->data(), offset);
-
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    sp<ABuffer> accessUnit = takeAccessUnit(0, offset, offset);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
@@ -1239,14 +1182,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
 
     unsigned layer = 4 - ((header >> 17) & 3);
 
-    sp<ABuffer> accessUnit = new ABuffer(frameSize);
-    memcpy(accessUnit->data(), data, frameSize);
-
-    memmove(mBuffer->data(),
-            mBuffer->data() + frameSize,
-            mBuffer->size() - frameSize);
-
-    mBuffer->setRange(0, mBuffer->size() - frameSize);
+    sp<ABuffer> accessUnit = takeAccessUnit(0, frameSize, frameSize);
 
     int64_t timeUs = fetchTimestamp(frameSize);
     if (timeUs < 0ll) {
@@ -1362,10 +1298,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
 
     size_t offset = 0;
     while (offset + 3 < size) {
-        if (memcmp(&data[offset], "\x00\x00\x01", 3)) {
-            ++offset;
-            continue;
+        const uint8_t *startCode = findStartCode(&data[offset], size - offset);
+        if (startCode == NULL || startCode + 3 >= data + size) {
+            break;
         }
+        offset = startCode - data;
 
         pprevStartCode = prevStartCode;
         prevStartCode = currentStartCode;
@@ -1445,14 +1382,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
             if (!sawPictureStart) {
                 sawPictureStart = true;
             } else {
-                sp<ABuffer> accessUnit = new ABuffer(offset);
-                memcpy(accessUnit->data(), data, offset);
-
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                sp<ABuffer> accessUnit = takeAccessUnit(0, offset, offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 if (timeUs < 0ll) {
@@ -1509,13 +1439,9 @@ static ssize_t getNextChunkSize(
         return -EAGAIN;
     }
 
-    size_t offset = 4;
-    while (offset + 2 < size) {
-        if (!memcmp(&data[offset], kStartCode, 3)) {
-            return offset;
-        }
-
-        ++offset;
+    const uint8_t *next = findStartCode(&data[4], size - 4);
+    if (next != NULL) {
+        return next - data;
     }
 
     return -EAGAIN;
@@ -1644,12 +1570,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
                     offset += chunkSize;
 
-                    sp<ABuffer> accessUnit = new ABuffer(offset);
-                    memcpy(accessUnit->data(), data, offset);
-
-                    memmove(data, &data[offset], size - offset);
-                    size -= offset;
-                    mBuffer->setRange(0, size);
+                    sp<ABuffer> accessUnit = takeAccessUnit(0, offset, offset);
+                    data = mBuffer->data();
+                    size = mBuffer->size();
 
                     int64_t timeUs = fetchTimestamp(offset);
                     if (timeUs < 0ll) {
@@ -1715,13 +1638,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMetadata() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(size);
     int64_t timeUs = fetchTimestamp(size);
+    sp<ABuffer> accessUnit = takeAccessUnit(0, size, size);
     accessUnit->meta()->setInt64("timeUs", timeUs);
 
-    memcpy(accessUnit->data(), mBuffer->data(), size);
-    mBuffer->setRange(0, 0);
-
     if (mFormat == NULL) {
         mFormat = new MetaData;
         mFormat->setCString(kKeyMIMEType, MEDIA_MIMETYPE_DATA_TIMED_ID3);
@@ -138,6 +138,12 @@ protected:
 
     sp<ABuffer> dequeueScrambledAccessUnit();
 
+    // Removes the first |consumed| bytes from mBuffer and returns the
+    // |size| bytes at |offset| among them as an access unit. The access unit
+    // shares the old buffer's storage; only the bytes after |consumed| are
+    // copied into a new buffer.
+    sp<ABuffer> takeAccessUnit(size_t offset, size_t size, size_t consumed);
+
 private:
     DISALLOW_EVIL_CONSTRUCTORS(ElementaryStreamQueue);
 };
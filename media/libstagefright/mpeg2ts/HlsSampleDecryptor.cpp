@@ -109,30 +109,40 @@ size_t HlsSampleDecryptor::processNal(uint8_t *nalData, size_t nalSize) {
         size_t offset = VIDEO_CLEAR_LEAD;
         size_t remainingBytes = nalSize - VIDEO_CLEAR_LEAD;
 
-        // a copy of initVec as decryptBlock updates it
-        unsigned char AESInitVec[AES_BLOCK_SIZE];
-        memcpy(AESInitVec, mAESInitVec, AES_BLOCK_SIZE);
-
-        while (remainingBytes > 0) {
-            // encrypted_block: protected block uses 10% skip encryption
-            if (remainingBytes > AES_BLOCK_SIZE) {
-                uint8_t *encrypted = nalData + offset;
-                status_t ret = decryptBlock(encrypted, AES_BLOCK_SIZE, AESInitVec);
-                if (ret != OK) {
-                    ALOGE("processNal failed with %d", ret);
-                    return nalSize; // revisit this
-                }
-
-                offset += AES_BLOCK_SIZE;
-                remainingBytes -= AES_BLOCK_SIZE;
+        // The encrypted blocks form one CBC chain across the clear blocks in
+        // between, so gather them, decrypt the chain in a single call and
+        // scatter the plain text back.
+        size_t numBlocks = 0;
+        for (size_t remaining = remainingBytes; remaining > AES_BLOCK_SIZE;) {
+            ++numBlocks;
+            remaining -= AES_BLOCK_SIZE;
+            remaining -= std::min(remaining, (size_t)(9 * AES_BLOCK_SIZE));
+        }
+
+        if (numBlocks > 0) {
+            mBlockScratch.resize(numBlocks * AES_BLOCK_SIZE);
+            uint8_t *blocks = mBlockScratch.editArray();
+
+            for (size_t i = 0; i < numBlocks; ++i) {
+                memcpy(blocks + i * AES_BLOCK_SIZE,
+                        nalData + offset + i * 10 * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
             }
 
-            // unencrypted_block
-            size_t clearBytes = std::min(remainingBytes, (size_t)(9 * AES_BLOCK_SIZE));
+            // a copy of initVec as decryptBlock updates it
+            unsigned char AESInitVec[AES_BLOCK_SIZE];
+            memcpy(AESInitVec, mAESInitVec, AES_BLOCK_SIZE);
+
+            status_t ret = decryptBlock(blocks, numBlocks * AES_BLOCK_SIZE, AESInitVec);
+            if (ret != OK) {
+                ALOGE("processNal failed with %d", ret);
+                return nalSize; // revisit this
+            }
 
-            offset += clearBytes;
-            remainingBytes -= clearBytes;
-        } // while
+            for (size_t i = 0; i < numBlocks; ++i) {
+                memcpy(nalData + offset + i * 10 * AES_BLOCK_SIZE,
+                        blocks + i * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+            }
+        }
 
     } else { // isEncrypted == false
         ALOGV("processNal[%d]: Unencrypted NALU  (%p)/%zu", nalType, nalData, nalSize);
@@ -55,6 +55,9 @@ private:
     uint8_t mAESInitVec[AES_BLOCK_SIZE];
     bool mValidKeyInfo;
 
+    // encrypted video blocks of one NAL unit, gathered for a single decrypt
+    Vector<uint8_t> mBlockScratch;
+
     DISALLOW_EVIL_CONSTRUCTORS(HlsSampleDecryptor);
 };
 
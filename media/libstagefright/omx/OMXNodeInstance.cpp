@@ -19,6 +19,10 @@
 #include <utils/Log.h>
 
 #include <inttypes.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
 
 #include <media/stagefright/omx/OMXNodeInstance.h>
 #include <media/stagefright/omx/OMXMaster.h>
@@ -216,6 +220,26 @@ static inline const char *portString(OMX_U32 portIndex) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Callbacks may be held back for up to media.omx.cb_window_us microseconds, so that they reach
+// the observer in fewer and larger batches. Events and full queues are never held back.
+// If media.omx.cb_threads is set, all nodes in the process share that many dispatcher threads
+// instead of running one each. Both are off by default.
+
+struct CallbackDispatchConfig {
+    nsecs_t mWindowNs;
+    int32_t mNumSharedThreads;
+};
+
+static const CallbackDispatchConfig &getCallbackDispatchConfig() {
+    static const CallbackDispatchConfig config = {
+        (nsecs_t)std::max(property_get_int32("media.omx.cb_window_us", 0), 0) * 1000,
+        std::max(property_get_int32("media.omx.cb_threads", 0), 0),
+    };
+    return config;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // This provides the underlying Thread used by CallbackDispatcher.
 // Note that deriving CallbackDispatcher from Thread does not work.
 
@@ -235,6 +259,38 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// A dispatcher thread shared by the CallbackDispatchers of several nodes. Each dispatcher is
+// served by a single shared thread, so the callbacks of a node stay in order.
+
+struct OMXNodeInstance::SharedCallbackThread : public Thread {
+    SharedCallbackThread() : Thread(false /* canCallJava */), mDispatching(NULL) {
+    }
+
+    // Returns one of the shared threads, in turn.
+    static sp<SharedCallbackThread> get();
+
+    // Queues |dispatcher| to have its pending messages dispatched, right away if |urgent|,
+    // otherwise after the batching window.
+    void schedule(const sp<CallbackDispatcher> &dispatcher, bool urgent);
+
+    // Waits until |dispatcher| is no longer being dispatched, unless called from this thread.
+    void waitIdle(CallbackDispatcher *dispatcher);
+
+private:
+    Mutex mLock;
+    Condition mChanged;
+    // dispatchers with pending messages, and the time at which to dispatch them
+    std::list<std::pair<sp<CallbackDispatcher>, nsecs_t> > mReady;
+    CallbackDispatcher *mDispatching;
+
+    bool threadLoop() override;
+
+    SharedCallbackThread(const SharedCallbackThread &);
+    SharedCallbackThread &operator=(const SharedCallbackThread &);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 struct OMXNodeInstance::CallbackDispatcher : public RefBase {
     explicit CallbackDispatcher(const sp<OMXNodeInstance> &owner);
 
@@ -244,8 +300,14 @@ struct OMXNodeInstance::CallbackDispatcher : public RefBase {
     // is posted with |realTime| set to true.
     void post(const omx_message &msg, bool realTime = true);
 
+    // Drops the pending messages and stops dispatching to the owner.
+    void stop();
+
     bool loop();
 
+    // Dispatches the pending messages, on behalf of a SharedCallbackThread.
+    void dispatchPending();
+
 protected:
     virtual ~CallbackDispatcher();
 
@@ -263,10 +325,14 @@ private:
 
     sp<OMXNodeInstance> const mOwner;
     bool mDone;
+    bool mUrgent;       // a message that must not wait for the batching window is queued
+    bool mScheduled;    // queued on mShared
     Condition mQueueChanged;
     std::list<omx_message> mQueue;
 
-    sp<CallbackDispatcherThread> mThread;
+    const nsecs_t mWindowNs;
+    sp<CallbackDispatcherThread> mThread;   // if not shared
+    sp<SharedCallbackThread> mShared;       // if shared
 
     void dispatch(std::list<omx_message> &messages);
 
@@ -276,12 +342,22 @@ private:
 
 OMXNodeInstance::CallbackDispatcher::CallbackDispatcher(const sp<OMXNodeInstance> &owner)
     : mOwner(owner),
-      mDone(false) {
-    mThread = new CallbackDispatcherThread(this);
-    mThread->run("OMXCallbackDisp", ANDROID_PRIORITY_FOREGROUND);
+      mDone(false),
+      mUrgent(false),
+      mScheduled(false),
+      mWindowNs(getCallbackDispatchConfig().mWindowNs) {
+    mShared = SharedCallbackThread::get();
+    if (mShared == NULL) {
+        mThread = new CallbackDispatcherThread(this);
+        mThread->run("OMXCallbackDisp", ANDROID_PRIORITY_FOREGROUND);
+    }
 }
 
 OMXNodeInstance::CallbackDispatcher::~CallbackDispatcher() {
+    if (mThread == NULL) {
+        return;
+    }
+
     {
         Mutex::Autolock autoLock(mLock);
 
@@ -300,12 +376,51 @@ OMXNodeInstance::CallbackDispatcher::~CallbackDispatcher() {
 }
 
 void OMXNodeInstance::CallbackDispatcher::post(const omx_message &msg, bool realTime) {
-    Mutex::Autolock autoLock(mLock);
+    // only buffer completions may wait for the batching window
+    const bool urgent = realTime
+            && msg.type != omx_message::EMPTY_BUFFER_DONE
+            && msg.type != omx_message::FILL_BUFFER_DONE;
+    bool schedule = false;
+    bool scheduleNow = false;
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mDone) {
+            return;
+        }
+
+        mQueue.push_back(msg);
+        const bool full = mQueue.size() >= kMaxQueueSize;
+        if (mShared != NULL) {
+            scheduleNow = urgent || full;
+            if ((realTime || full) && (!mScheduled || scheduleNow)) {
+                mScheduled = true;
+                schedule = true;
+            }
+        } else {
+            mUrgent = mUrgent || urgent;
+            if (realTime || full) {
+                mQueueChanged.signal();
+            }
+        }
+    }
 
-    mQueue.push_back(msg);
-    if (realTime || mQueue.size() >= kMaxQueueSize) {
+    if (schedule) {
+        mShared->schedule(this, scheduleNow);
+    }
+}
+
+void OMXNodeInstance::CallbackDispatcher::stop() {
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        mDone = true;
+        mQueue.clear();
         mQueueChanged.signal();
     }
+
+    if (mShared != NULL) {
+        mShared->waitIdle(this);
+    }
 }
 
 void OMXNodeInstance::CallbackDispatcher::dispatch(std::list<omx_message> &messages) {
@@ -316,6 +431,25 @@ void OMXNodeInstance::CallbackDispatcher::dispatch(std::list<omx_message> &messa
     mOwner->onMessages(messages);
 }
 
+void OMXNodeInstance::CallbackDispatcher::dispatchPending() {
+    std::list<omx_message> messages;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        mScheduled = false;
+        if (mDone) {
+            return;
+        }
+
+        messages.swap(mQueue);
+    }
+
+    if (!messages.empty()) {
+        dispatch(messages);
+    }
+}
+
 bool OMXNodeInstance::CallbackDispatcher::loop() {
     for (;;) {
         std::list<omx_message> messages;
@@ -326,10 +460,23 @@ bool OMXNodeInstance::CallbackDispatcher::loop() {
                 mQueueChanged.wait(mLock);
             }
 
+            // give more messages a chance to join this batch
+            if (mWindowNs > 0) {
+                const nsecs_t deadlineNs = systemTime() + mWindowNs;
+                while (!mDone && !mUrgent && mQueue.size() < kMaxQueueSize) {
+                    const nsecs_t remainingNs = deadlineNs - systemTime();
+                    if (remainingNs <= 0
+                            || mQueueChanged.waitRelative(mLock, remainingNs) == TIMED_OUT) {
+                        break;
+                    }
+                }
+            }
+
             if (mDone) {
                 break;
             }
 
+            mUrgent = false;
             messages.swap(mQueue);
         }
 
@@ -347,6 +494,94 @@ bool OMXNodeInstance::CallbackDispatcherThread::threadLoop() {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// static
+sp<OMXNodeInstance::SharedCallbackThread> OMXNodeInstance::SharedCallbackThread::get() {
+    static Mutex sLock;
+    static std::vector<sp<SharedCallbackThread> > sThreads;
+    static size_t sNext = 0;
+
+    const size_t numThreads = getCallbackDispatchConfig().mNumSharedThreads;
+    if (numThreads == 0) {
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(sLock);
+    if (sThreads.size() < numThreads) {
+        sp<SharedCallbackThread> thread = new SharedCallbackThread;
+        thread->run("OMXCallbackShared", ANDROID_PRIORITY_FOREGROUND);
+        sThreads.push_back(thread);
+    }
+    sp<SharedCallbackThread> thread = sThreads[sNext];
+    sNext = (sNext + 1) % numThreads;
+    return thread;
+}
+
+void OMXNodeInstance::SharedCallbackThread::schedule(
+        const sp<CallbackDispatcher> &dispatcher, bool urgent) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (auto it = mReady.begin(); it != mReady.end(); ++it) {
+        if (it->first == dispatcher) {
+            // already queued: only need to move it forward
+            mReady.erase(it);
+            break;
+        }
+    }
+    if (urgent) {
+        mReady.push_front(std::make_pair(dispatcher, (nsecs_t)0));
+    } else {
+        mReady.push_back(std::make_pair(
+                dispatcher, systemTime() + getCallbackDispatchConfig().mWindowNs));
+    }
+    mChanged.signal();
+}
+
+void OMXNodeInstance::SharedCallbackThread::waitIdle(CallbackDispatcher *dispatcher) {
+    if (gettid() == getTid()) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    while (mDispatching == dispatcher) {
+        mChanged.wait(mLock);
+    }
+}
+
+bool OMXNodeInstance::SharedCallbackThread::threadLoop() {
+    sp<CallbackDispatcher> dispatcher;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (mReady.empty()) {
+            mChanged.wait(mLock);
+        }
+
+        // the front has the earliest dispatch time, as urgent dispatchers are queued in front
+        const nsecs_t waitNs = mReady.front().second - systemTime();
+        if (waitNs > 0) {
+            mChanged.waitRelative(mLock, waitNs);
+            return true;
+        }
+
+        dispatcher = mReady.front().first;
+        mReady.pop_front();
+        mDispatching = dispatcher.get();
+    }
+
+    dispatcher->dispatchPending();
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mDispatching = NULL;
+        mChanged.broadcast();
+    }
+
+    // the last reference to |dispatcher| may be released here, outside of mLock
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 OMXNodeInstance::OMXNodeInstance(
         Omx *owner, const sp<IOMXObserver> &observer, const char *name)
     : mOwner(owner),
@@ -513,6 +748,7 @@ status_t OMXNodeInstance::freeNode() {
     }
     status_t err = mOwner->freeNode(this);
 
+    mDispatcher->stop();
     mDispatcher.clear();
     mOMXBufferSource.clear();
 
@@ -31,6 +31,8 @@ SimpleSoftOMXComponent::SimpleSoftOMXComponent(
         OMX_PTR appData,
         OMX_COMPONENTTYPE **component)
     : SoftOMXComponent(name, callbacks, appData, component),
+      mPendingGeneration(0),
+      mPostedGeneration(-1),
       mLooper(new ALooper),
       mHandler(new AHandlerReflector<SimpleSoftOMXComponent>(this)),
       mState(OMX_StateLoaded),
@@ -57,6 +59,9 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::sendCommand(
         OMX_COMMANDTYPE cmd, OMX_U32 param, OMX_PTR data) {
     CHECK(data == NULL);
 
+    Mutex::Autolock autoLock(mPendingLock);
+    ++mPendingGeneration;
+
     sp<AMessage> msg = new AMessage(kWhatSendCommand, mHandler);
     msg->setInt32("cmd", cmd);
     msg->setInt32("param", param);
@@ -334,22 +339,38 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::freeBuffer(
 
 OMX_ERRORTYPE SimpleSoftOMXComponent::emptyThisBuffer(
         OMX_BUFFERHEADERTYPE *buffer) {
-    sp<AMessage> msg = new AMessage(kWhatEmptyThisBuffer, mHandler);
-    msg->setPointer("header", buffer);
-    msg->post();
+    queueBuffer(buffer, true /* isInput */);
 
     return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE SimpleSoftOMXComponent::fillThisBuffer(
         OMX_BUFFERHEADERTYPE *buffer) {
-    sp<AMessage> msg = new AMessage(kWhatFillThisBuffer, mHandler);
-    msg->setPointer("header", buffer);
-    msg->post();
+    queueBuffer(buffer, false /* isInput */);
 
     return OMX_ErrorNone;
 }
 
+void SimpleSoftOMXComponent::queueBuffer(
+        OMX_BUFFERHEADERTYPE *header, bool isInput) {
+    Mutex::Autolock autoLock(mPendingLock);
+
+    PendingBuffer pending;
+    pending.mHeader = header;
+    pending.mIsInput = isInput;
+    pending.mGeneration = mPendingGeneration;
+    mPendingBuffers.push_back(pending);
+
+    // Only the first buffer of a batch needs to wake up the looper.
+    if (mPostedGeneration != mPendingGeneration) {
+        mPostedGeneration = mPendingGeneration;
+
+        sp<AMessage> msg = new AMessage(kWhatBuffersQueued, mHandler);
+        msg->setInt32("generation", mPendingGeneration);
+        msg->post();
+    }
+}
+
 OMX_ERRORTYPE SimpleSoftOMXComponent::getState(OMX_STATETYPE *state) {
     Mutex::Autolock autoLock(mLock);
 
@@ -373,46 +394,75 @@ void SimpleSoftOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
-        case kWhatEmptyThisBuffer:
-        case kWhatFillThisBuffer:
+        case kWhatBuffersQueued:
         {
-            OMX_BUFFERHEADERTYPE *header;
-            CHECK(msg->findPointer("header", (void **)&header));
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            onBuffersQueued(generation);
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
 
-            CHECK(mState == OMX_StateExecuting && mTargetState == mState);
+void SimpleSoftOMXComponent::onBuffersQueued(int32_t generation) {
+    List<PendingBuffer> buffers;
+    {
+        Mutex::Autolock autoLock(mPendingLock);
+        while (!mPendingBuffers.empty()
+                && mPendingBuffers.begin()->mGeneration <= generation) {
+            buffers.push_back(*mPendingBuffers.begin());
+            mPendingBuffers.erase(mPendingBuffers.begin());
+        }
+        if (mPostedGeneration == generation) {
+            mPostedGeneration = -1;
+        }
+    }
 
-            bool found = false;
-            size_t portIndex = (kWhatEmptyThisBuffer == msgType)?
-                    header->nInputPortIndex: header->nOutputPortIndex;
-            PortInfo *port = &mPorts.editItemAt(portIndex);
+    CHECK(mState == OMX_StateExecuting && mTargetState == mState);
 
-            for (size_t j = 0; j < port->mBuffers.size(); ++j) {
-                BufferInfo *buffer = &port->mBuffers.editItemAt(j);
+    Vector<bool> filled;
+    filled.insertAt(false, 0, mPorts.size());
 
-                if (buffer->mHeader == header) {
-                    CHECK(!buffer->mOwnedByUs);
+    for (List<PendingBuffer>::iterator it = buffers.begin(); it != buffers.end(); ++it) {
+        OMX_BUFFERHEADERTYPE *header = it->mHeader;
 
-                    buffer->mOwnedByUs = true;
+        bool found = false;
+        size_t portIndex = it->mIsInput ?
+                header->nInputPortIndex: header->nOutputPortIndex;
+        PortInfo *port = &mPorts.editItemAt(portIndex);
 
-                    CHECK((msgType == kWhatEmptyThisBuffer
-                            && port->mDef.eDir == OMX_DirInput)
-                            || (port->mDef.eDir == OMX_DirOutput));
+        for (size_t j = 0; j < port->mBuffers.size(); ++j) {
+            BufferInfo *buffer = &port->mBuffers.editItemAt(j);
 
-                    port->mQueue.push_back(buffer);
-                    onQueueFilled(portIndex);
+            if (buffer->mHeader == header) {
+                CHECK(!buffer->mOwnedByUs);
 
-                    found = true;
-                    break;
-                }
-            }
+                buffer->mOwnedByUs = true;
 
-            CHECK(found);
-            break;
+                CHECK((it->mIsInput && port->mDef.eDir == OMX_DirInput)
+                        || (port->mDef.eDir == OMX_DirOutput));
+
+                port->mQueue.push_back(buffer);
+                filled.editItemAt(portIndex) = true;
+
+                found = true;
+                break;
+            }
         }
 
-        default:
-            TRESPASS();
-            break;
+        CHECK(found);
+    }
+
+    // Let the codec work through everything that arrived, one port at a time.
+    for (size_t i = 0; i < filled.size(); ++i) {
+        if (filled[i]) {
+            onQueueFilled(i);
+        }
     }
 }
 
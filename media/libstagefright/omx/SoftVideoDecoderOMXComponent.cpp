@@ -29,8 +29,15 @@
 #include <media/stagefright/foundation/MediaDefs.h>
 #include <media/hardware/HardwareAPI.h>
 
+#include <cutils/properties.h>
+#include <unistd.h>
+
 namespace android {
 
+// Streams up to this many pixels per thread are decoded with one thread per share, i.e.
+// 480p uses 2 threads, 720p 4 threads and 1080p and up the whole thread budget.
+static const uint32_t kPixelsPerDecoderThread = 640 * 360;
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -69,13 +76,46 @@ SoftVideoDecoderOMXComponent::SoftVideoDecoderOMXComponent(
         mComponentRole(componentRole),
         mCodingType(codingType),
         mProfileLevels(profileLevels),
-        mNumProfileLevels(numProfileLevels) {
+        mNumProfileLevels(numProfileLevels),
+        mThreadBudget(1) {
 
     // init all the color aspects to be Unspecified.
     memset(&mDefaultColorAspects, 0, sizeof(ColorAspects));
     memset(&mBitstreamColorAspects, 0, sizeof(ColorAspects));
     memset(&mFinalColorAspects, 0, sizeof(ColorAspects));
     memset(&mHdrStaticInfo, 0, sizeof(HDRStaticInfo));
+
+    // media.sw.video.dec.threads limits the threads of each software decoder instance
+    // (0: all online CPUs), and media.sw.video.dec.low_power halves that budget.
+    size_t numCores = GetCPUCoreCount();
+    int32_t budget = property_get_int32("media.sw.video.dec.threads", 0);
+    mThreadBudget = (budget > 0 && (size_t)budget < numCores) ? (size_t)budget : numCores;
+    if (property_get_bool("media.sw.video.dec.low_power", false)) {
+        mThreadBudget = max(mThreadBudget / 2, (size_t)1);
+    }
+    ALOGV("%s: decoder thread budget %zu of %zu cores", name, mThreadBudget, numCores);
+}
+
+// static
+size_t SoftVideoDecoderOMXComponent::GetCPUCoreCount() {
+    long cpuCoreCount = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    // _SC_NPROC_ONLN must be defined...
+    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
+#endif
+    CHECK(cpuCoreCount >= 1);
+    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
+    return (size_t)cpuCoreCount;
+}
+
+size_t SoftVideoDecoderOMXComponent::getDecoderThreadCount(
+        uint32_t width, uint32_t height, size_t maxThreads) const {
+    uint64_t pixels = (uint64_t)width * height;
+    uint64_t wanted = (pixels + kPixelsPerDecoderThread - 1) / kPixelsPerDecoderThread;
+    size_t threads = (size_t)min(wanted, (uint64_t)mThreadBudget);
+    return max(min(threads, maxThreads), (size_t)1);
 }
 
 void SoftVideoDecoderOMXComponent::initPorts(
@@ -119,6 +119,7 @@ struct OMXNodeInstance : public BnOMXNode {
 
 private:
     struct CallbackDispatcherThread;
+    struct SharedCallbackThread;
     struct CallbackDispatcher;
 
     Mutex mLock;
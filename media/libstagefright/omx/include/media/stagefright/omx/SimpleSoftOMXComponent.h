@@ -21,6 +21,7 @@
 #include "SoftOMXComponent.h"
 
 #include <media/stagefright/foundation/AHandlerReflector.h>
+#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
 #include <utils/Vector.h>
@@ -88,12 +89,27 @@ protected:
 private:
     enum {
         kWhatSendCommand,
-        kWhatEmptyThisBuffer,
-        kWhatFillThisBuffer,
+        kWhatBuffersQueued,
+    };
+
+    // A buffer handed to us by emptyThisBuffer/fillThisBuffer that the
+    // looper has not picked up yet.
+    struct PendingBuffer {
+        OMX_BUFFERHEADERTYPE *mHeader;
+        bool mIsInput;
+        int32_t mGeneration;
     };
 
     Mutex mLock;
 
+    // Buffers are batched here so that a burst of them costs a single
+    // message. The generation is bumped by every command, so that buffers
+    // queued after a command are only processed after it.
+    Mutex mPendingLock;
+    List<PendingBuffer> mPendingBuffers;
+    int32_t mPendingGeneration;
+    int32_t mPostedGeneration;
+
     sp<ALooper> mLooper;
     sp<AHandlerReflector<SimpleSoftOMXComponent> > mHandler;
 
@@ -139,6 +155,9 @@ private:
 
     virtual OMX_ERRORTYPE getState(OMX_STATETYPE *state);
 
+    void queueBuffer(OMX_BUFFERHEADERTYPE *header, bool isInput);
+    void onBuffersQueued(int32_t generation);
+
     void onSendCommand(OMX_COMMANDTYPE cmd, OMX_U32 param);
     void onChangeState(OMX_STATETYPE state);
     void onPortEnable(OMX_U32 portIndex, bool enable);
@@ -106,6 +106,20 @@ protected:
     uint32_t outputBufferWidth();
     uint32_t outputBufferHeight();
 
+    static size_t GetCPUCoreCount();
+
+    // Multi-threading policy shared by the software decoders. Returns the number of
+    // threads to decode a |width| x |height| stream with: one for small streams, growing
+    // with the frame size up to the per-instance thread budget, and never more than
+    // |maxThreads|.
+    size_t getDecoderThreadCount(
+            uint32_t width, uint32_t height, size_t maxThreads = SIZE_MAX) const;
+
+    // Number of threads a single decoder instance may use at most, regardless of the
+    // stream size. Decoders whose threading is bounded by the bitstream (e.g. VP9 tiles)
+    // may use this directly.
+    size_t getDecoderThreadBudget() const { return mThreadBudget; }
+
     enum CropSettingsMode {
         kCropUnSet = 0,
         kCropSet,
@@ -175,6 +189,8 @@ private:
     const CodecProfileLevel *mProfileLevels;
     size_t mNumProfileLevels;
 
+    size_t mThreadBudget;
+
     DISALLOW_EVIL_CONSTRUCTORS(SoftVideoDecoderOMXComponent);
 };
 
@@ -129,15 +129,23 @@ void AAVCAssembler::addSingleNALUnit(const sp<ABuffer> &buffer) {
     hexdump(buffer->data(), buffer->size());
 #endif
 
+    NALUnit unit;
+    unit.push(buffer);
+    appendNALUnit(unit);
+}
+
+void AAVCAssembler::appendNALUnit(const NALUnit &unit) {
+    CHECK(!unit.isEmpty());
+
     uint32_t rtpTime;
-    CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
+    CHECK(unit[0]->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
 
     if (!mNALUnits.empty() && rtpTime != mAccessUnitRTPTime) {
         submitAccessUnit();
     }
     mAccessUnitRTPTime = rtpTime;
 
-    mNALUnits.push_back(buffer);
+    mNALUnits.push_back(unit);
 }
 
 bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
@@ -159,8 +167,7 @@ bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
             return false;
         }
 
-        sp<ABuffer> unit = new ABuffer(nalSize);
-        memcpy(unit->data(), &data[2], nalSize);
+        sp<ABuffer> unit = buffer->slice(&data[2] - buffer->data(), nalSize);
 
         CopyTimes(unit, buffer);
 
@@ -212,7 +219,6 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
     uint32_t nri = (data[0] >> 5) & 3;
 
     uint32_t expectedSeqNo = (uint32_t)buffer->int32Data() + 1;
-    size_t totalSize = size - 2;
     size_t totalCount = 1;
     bool complete = false;
 
@@ -257,7 +263,6 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
                 return MALFORMED_PACKET;
             }
 
-            totalSize += size - 2;
             ++totalCount;
 
             expectedSeqNo = expectedSeqNo + 1;
@@ -280,16 +285,13 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
 
     // We found all the fragments that make up the complete NAL unit.
 
-    // Leave room for the header. So far totalSize did not include the
-    // header byte.
-    ++totalSize;
-
-    sp<ABuffer> unit = new ABuffer(totalSize);
-    CopyTimes(unit, *queue->begin());
-
-    unit->data()[0] = (nri << 5) | nalType;
+    // Rather than copying the fragments into a contiguous NAL unit here,
+    // keep them as they are with the FU indicator and header stripped, the
+    // access unit is laid out in one go once it is complete. The NAL header
+    // byte takes the place of the FU header in the first fragment.
+    NALUnit unit;
+    unit.setCapacity(totalCount);
 
-    size_t offset = 1;
     List<sp<ABuffer> >::iterator it = queue->begin();
     for (size_t i = 0; i < totalCount; ++i) {
         const sp<ABuffer> &buffer = *it;
@@ -299,15 +301,18 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
         hexdump(buffer->data(), buffer->size());
 #endif
 
-        memcpy(unit->data() + offset, buffer->data() + 2, buffer->size() - 2);
-        offset += buffer->size() - 2;
+        if (i == 0) {
+            buffer->data()[1] = (nri << 5) | nalType;
+            buffer->setRange(buffer->offset() + 1, buffer->size() - 1);
+        } else {
+            buffer->setRange(buffer->offset() + 2, buffer->size() - 2);
+        }
+        unit.push(buffer);
 
         it = queue->erase(it);
     }
 
-    unit->setRange(0, totalSize);
-
-    addSingleNALUnit(unit);
+    appendNALUnit(unit);
 
     ALOGV("successfully assembled a NAL unit from fragments.");
 
@@ -320,24 +325,29 @@ void AAVCAssembler::submitAccessUnit() {
     ALOGV("Access unit complete (%zu nal units)", mNALUnits.size());
 
     size_t totalSize = 0;
-    for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
+    for (List<NALUnit>::iterator it = mNALUnits.begin();
          it != mNALUnits.end(); ++it) {
-        totalSize += 4 + (*it)->size();
+        totalSize += 4;
+        for (size_t i = 0; i < it->size(); ++i) {
+            totalSize += it->itemAt(i)->size();
+        }
     }
 
     sp<ABuffer> accessUnit = new ABuffer(totalSize);
     size_t offset = 0;
-    for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
+    for (List<NALUnit>::iterator it = mNALUnits.begin();
          it != mNALUnits.end(); ++it) {
         memcpy(accessUnit->data() + offset, "\x00\x00\x00\x01", 4);
         offset += 4;
 
-        sp<ABuffer> nal = *it;
-        memcpy(accessUnit->data() + offset, nal->data(), nal->size());
-        offset += nal->size();
+        for (size_t i = 0; i < it->size(); ++i) {
+            const sp<ABuffer> &piece = it->itemAt(i);
+            memcpy(accessUnit->data() + offset, piece->data(), piece->size());
+            offset += piece->size();
+        }
     }
 
-    CopyTimes(accessUnit, *mNALUnits.begin());
+    CopyTimes(accessUnit, mNALUnits.begin()->itemAt(0));
 
 #if 0
     printf(mAccessUnitDamaged ? "X" : ".");
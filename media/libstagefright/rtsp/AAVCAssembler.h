@@ -22,6 +22,7 @@
 
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -45,9 +46,14 @@ private:
     bool mNextExpectedSeqNoValid;
     uint32_t mNextExpectedSeqNo;
     bool mAccessUnitDamaged;
-    List<sp<ABuffer> > mNALUnits;
+
+    // The pieces making up a NAL unit, more than one if it arrived in
+    // FU-A fragments.
+    typedef Vector<sp<ABuffer> > NALUnit;
+    List<NALUnit> mNALUnits;
 
     AssemblyStatus addNALUnit(const sp<ARTPSource> &source);
+    void appendNALUnit(const NALUnit &unit);
     void addSingleNALUnit(const sp<ABuffer> &buffer);
     AssemblyStatus addFragmentedNALUnit(List<sp<ABuffer> > *queue);
     bool addSingleTimeAggregationPacket(const sp<ABuffer> &buffer);
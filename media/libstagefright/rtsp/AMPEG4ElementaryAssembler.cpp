@@ -350,8 +350,7 @@ ARTPAssembler::AssemblyStatus AMPEG4ElementaryAssembler::addPacket(
                 return MALFORMED_PACKET;
             }
 
-            sp<ABuffer> accessUnit = new ABuffer(header.mSize);
-            memcpy(accessUnit->data(), buffer->data() + offset, header.mSize);
+            sp<ABuffer> accessUnit = buffer->slice(offset, header.mSize);
 
             offset += header.mSize;
 
@@ -121,6 +121,13 @@ sp<ABuffer> ARTPAssembler::MakeADTSCompoundFromAACFrames(
 // static
 sp<ABuffer> ARTPAssembler::MakeCompoundFromPackets(
         const List<sp<ABuffer> > &packets) {
+    if (packets.size() == 1) {
+        const sp<ABuffer> &packet = *packets.begin();
+        sp<ABuffer> accessUnit = packet->slice(0, packet->size());
+        CopyTimes(accessUnit, packet);
+        return accessUnit;
+    }
+
     size_t totalSize = 0;
     for (List<sp<ABuffer> >::const_iterator it = packets.begin();
          it != packets.end(); ++it) {
@@ -26,9 +26,11 @@
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AEpollReactor.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
+#include <utils/Vector.h>
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -50,11 +52,29 @@ static uint64_t u64at(const uint8_t *data) {
 }
 
 // static
-const int64_t ARTPConnection::kSelectTimeoutUs = 1000ll;
+const int64_t ARTPConnection::kReceiverReportCheckIntervalUs = 1000000ll;
+
+// Datagrams read off a socket before giving other streams a turn.
+// static
+const size_t ARTPConnection::kMaxPacketsPerEvent = 64;
+
+// static
+const size_t ARTPConnection::kMaxPacketsPerBatch = 16;
+
+// RTP packets are normally sized to fit the path MTU, a stream that
+// turns out to send larger datagrams gets the full UDP size from then on.
+static const size_t kRTPBufferSize = 2048;
+static const size_t kMaxRTPBufferSize = 65536;
+
+// Buffers are handed to ARTPSource's queue and come back to the pool once
+// the assembler lets go of them.
+static const size_t kMaxPooledBuffers = 512;
 
 struct ARTPConnection::StreamInfo {
     int mRTPSocket;
     int mRTCPSocket;
+    int32_t mRTPToken;
+    int32_t mRTCPToken;
     sp<ASessionDescription> mSessionDesc;
     size_t mIndex;
     sp<AMessage> mNotifyMsg;
@@ -65,15 +85,25 @@ struct ARTPConnection::StreamInfo {
     struct sockaddr_in mRemoteRTCPAddr;
 
     bool mIsInjected;
+
+    size_t mRTPBufferSize;
+    Vector<sp<ABuffer> > mRTPBufferPool;
+    size_t mNextPooledBuffer;
 };
 
 ARTPConnection::ARTPConnection(uint32_t flags)
     : mFlags(flags),
-      mPollEventPending(false),
+      mReactor(AEpollReactor::GetShared()),
+      mReceiverReportEventPending(false),
       mLastReceiverReportTimeUs(-1) {
+    CHECK(mReactor != NULL);
 }
 
 ARTPConnection::~ARTPConnection() {
+    for (List<StreamInfo>::iterator it = mStreams.begin();
+         it != mStreams.end(); ++it) {
+        unregisterSockets(&*it);
+    }
 }
 
 void ARTPConnection::addStream(
@@ -165,9 +195,15 @@ void ARTPConnection::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
-        case kWhatPollStreams:
+        case kWhatSocketEvent:
+        {
+            onSocketEvent(msg);
+            break;
+        }
+
+        case kWhatSendReceiverReports:
         {
-            onPollStreams();
+            onSendReceiverReports();
             break;
         }
 
@@ -211,8 +247,43 @@ void ARTPConnection::onAddStream(const sp<AMessage> &msg) {
     info->mNumRTPPacketsReceived = 0;
     memset(&info->mRemoteRTCPAddr, 0, sizeof(info->mRemoteRTCPAddr));
 
+    info->mRTPToken = info->mRTCPToken = -1;
+
+    info->mRTPBufferSize = kRTPBufferSize;
+    info->mNextPooledBuffer = 0;
+
     if (!injected) {
-        postPollEvent();
+        sp<AMessage> notify = new AMessage(kWhatSocketEvent, this);
+
+        status_t err = mReactor->addFd(
+                info->mRTPSocket, AEpollReactor::kEventReadable,
+                notify, &info->mRTPToken);
+        if (err == OK) {
+            err = mReactor->addFd(
+                    info->mRTCPSocket, AEpollReactor::kEventReadable,
+                    notify, &info->mRTCPToken);
+        }
+        if (err != OK) {
+            ALOGE("failed to watch RTP/RTCP sockets (%d)", err);
+        }
+
+        postReceiverReportEvent();
+    }
+}
+
+void ARTPConnection::unregisterSockets(StreamInfo *info) {
+    if (info->mIsInjected) {
+        return;
+    }
+
+    // The sockets may have been closed already, which is fine.
+    if (info->mRTPToken >= 0) {
+        mReactor->removeFd(info->mRTPToken);
+        info->mRTPToken = -1;
+    }
+    if (info->mRTCPToken >= 0) {
+        mReactor->removeFd(info->mRTCPToken);
+        info->mRTCPToken = -1;
     }
 }
 
@@ -231,84 +302,69 @@ void ARTPConnection::onRemoveStream(const sp<AMessage> &msg) {
         return;
     }
 
+    unregisterSockets(&*it);
     mStreams.erase(it);
 }
 
-void ARTPConnection::postPollEvent() {
-    if (mPollEventPending) {
+void ARTPConnection::postReceiverReportEvent() {
+    if (mReceiverReportEventPending) {
         return;
     }
 
-    sp<AMessage> msg = new AMessage(kWhatPollStreams, this);
-    msg->post();
+    sp<AMessage> msg = new AMessage(kWhatSendReceiverReports, this);
+    msg->post(kReceiverReportCheckIntervalUs);
 
-    mPollEventPending = true;
+    mReceiverReportEventPending = true;
 }
 
-void ARTPConnection::onPollStreams() {
-    mPollEventPending = false;
+void ARTPConnection::onSocketEvent(const sp<AMessage> &msg) {
+    int32_t token;
+    CHECK(msg->findInt32("token", &token));
 
-    if (mStreams.empty()) {
-        return;
+    List<StreamInfo>::iterator it = mStreams.begin();
+    while (it != mStreams.end()
+           && (it->mIsInjected
+               || (it->mRTPToken != token && it->mRTCPToken != token))) {
+        ++it;
     }
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = kSelectTimeoutUs;
-
-    fd_set rs;
-    FD_ZERO(&rs);
-
-    int maxSocket = -1;
-    for (List<StreamInfo>::iterator it = mStreams.begin();
-         it != mStreams.end(); ++it) {
-        if ((*it).mIsInjected) {
-            continue;
-        }
+    if (it == mStreams.end()) {
+        // stream was removed in the meantime.
+        return;
+    }
 
-        FD_SET(it->mRTPSocket, &rs);
-        FD_SET(it->mRTCPSocket, &rs);
+    bool receiveRTP = (it->mRTPToken == token);
 
-        if (it->mRTPSocket > maxSocket) {
-            maxSocket = it->mRTPSocket;
-        }
-        if (it->mRTCPSocket > maxSocket) {
-            maxSocket = it->mRTCPSocket;
+    // Notifications are edge-triggered, so read until the socket is
+    // drained, or rely on the reactor to report it again once rearmed.
+    status_t err = OK;
+    size_t numPackets = 0;
+    while (numPackets < kMaxPacketsPerEvent) {
+        size_t n = 1;
+        err = receiveRTP ? receiveRTPBatch(&*it, &n) : receive(&*it, false);
+        if (err == -EAGAIN || err == -ECONNRESET) {
+            break;
         }
+        numPackets += n;
     }
 
-    if (maxSocket == -1) {
+    if (err == -ECONNRESET) {
+        // socket failure, this stream is dead, Jim.
+
+        ALOGW("failed to receive RTP/RTCP datagram.");
+        unregisterSockets(&*it);
+        mStreams.erase(it);
         return;
     }
 
-    int res = select(maxSocket + 1, &rs, NULL, NULL, &tv);
-
-    if (res > 0) {
-        List<StreamInfo>::iterator it = mStreams.begin();
-        while (it != mStreams.end()) {
-            if ((*it).mIsInjected) {
-                ++it;
-                continue;
-            }
-
-            status_t err = OK;
-            if (FD_ISSET(it->mRTPSocket, &rs)) {
-                err = receive(&*it, true);
-            }
-            if (err == OK && FD_ISSET(it->mRTCPSocket, &rs)) {
-                err = receive(&*it, false);
-            }
+    mReactor->rearm(token);
+}
 
-            if (err == -ECONNRESET) {
-                // socket failure, this stream is dead, Jim.
+void ARTPConnection::onSendReceiverReports() {
+    mReceiverReportEventPending = false;
 
-                ALOGW("failed to receive RTP/RTCP datagram.");
-                it = mStreams.erase(it);
-                continue;
-            }
-
-            ++it;
-        }
+    if (mStreams.empty()) {
+        return;
     }
 
     int64_t nowUs = ALooper::GetNowUs();
@@ -358,6 +414,7 @@ void ARTPConnection::onPollStreams() {
                     ALOGW("failed to send RTCP receiver report (%s).",
                          n == 0 ? "connection gone" : strerror(errno));
 
+                    unregisterSockets(s);
                     it = mStreams.erase(it);
                     continue;
                 }
@@ -372,7 +429,7 @@ void ARTPConnection::onPollStreams() {
     }
 
     if (!mStreams.empty()) {
-        postPollEvent();
+        postReceiverReportEvent();
     }
 }
 
@@ -393,11 +450,15 @@ status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
             receiveRTP ? s->mRTPSocket : s->mRTCPSocket,
             buffer->data(),
             buffer->capacity(),
-            0,
+            MSG_DONTWAIT,
             remoteAddrLen > 0 ? (struct sockaddr *)&s->mRemoteRTCPAddr : NULL,
             remoteAddrLen > 0 ? &remoteAddrLen : NULL);
     } while (nbytes < 0 && errno == EINTR);
 
+    if (nbytes < 0 && errno == EAGAIN) {
+        return -EAGAIN;
+    }
+
     if (nbytes <= 0) {
         return -ECONNRESET;
     }
@@ -416,6 +477,96 @@ status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
     return err;
 }
 
+sp<ABuffer> ARTPConnection::acquireRTPBuffer(StreamInfo *s) {
+    Vector<sp<ABuffer> > &pool = s->mRTPBufferPool;
+
+    // Round robin, so that the buffers released first are checked first.
+    for (size_t i = 0; i < pool.size(); ++i) {
+        size_t index = (s->mNextPooledBuffer + i) % pool.size();
+        const sp<ABuffer> &buffer = pool.itemAt(index);
+
+        if (buffer->getStrongCount() == 1
+                && buffer->capacity() >= s->mRTPBufferSize) {
+            s->mNextPooledBuffer = (index + 1) % pool.size();
+
+            buffer->setRange(0, buffer->capacity());
+            buffer->setInt32Data(0);
+            buffer->meta()->clear();
+            return buffer;
+        }
+    }
+
+    sp<ABuffer> buffer = new ABuffer(s->mRTPBufferSize);
+    if (pool.size() < kMaxPooledBuffers) {
+        pool.push(buffer);
+    } else {
+        // The jitter buffer is holding on to everything, replace a buffer
+        // that is too small if there is one, otherwise don't pool it.
+        for (size_t i = 0; i < pool.size(); ++i) {
+            if (pool.itemAt(i)->capacity() < s->mRTPBufferSize) {
+                pool.editItemAt(i) = buffer;
+                break;
+            }
+        }
+    }
+
+    return buffer;
+}
+
+status_t ARTPConnection::receiveRTPBatch(StreamInfo *s, size_t *numPackets) {
+    ALOGV("receiving RTP");
+
+    CHECK(!s->mIsInjected);
+
+    *numPackets = 0;
+
+    sp<ABuffer> buffers[kMaxPacketsPerBatch];
+    struct iovec iov[kMaxPacketsPerBatch];
+    struct mmsghdr msgs[kMaxPacketsPerBatch];
+    memset(msgs, 0, sizeof(msgs));
+
+    for (size_t i = 0; i < kMaxPacketsPerBatch; ++i) {
+        buffers[i] = acquireRTPBuffer(s);
+        iov[i].iov_base = buffers[i]->data();
+        iov[i].iov_len = buffers[i]->capacity();
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int n;
+    do {
+        n = recvmmsg(s->mRTPSocket, msgs, kMaxPacketsPerBatch, MSG_DONTWAIT, NULL);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0 && errno == EAGAIN) {
+        return -EAGAIN;
+    }
+
+    if (n <= 0) {
+        return -ECONNRESET;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            ALOGW("RTP packet larger than %zu bytes, dropping it.",
+                    buffers[i]->capacity());
+            s->mRTPBufferSize = kMaxRTPBufferSize;
+            continue;
+        }
+
+        if (msgs[i].msg_len == 0) {
+            return -ECONNRESET;
+        }
+
+        buffers[i]->setRange(0, msgs[i].msg_len);
+        parseRTP(s, buffers[i]);
+    }
+
+    *numPackets = n;
+
+    return OK;
+}
+
 status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
     if (s->mNumRTPPacketsReceived++ == 0) {
         sp<AMessage> notify = s->mNotifyMsg->dup();
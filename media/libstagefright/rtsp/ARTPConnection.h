@@ -24,6 +24,7 @@
 namespace android {
 
 struct ABuffer;
+struct AEpollReactor;
 struct ARTPSource;
 struct ASessionDescription;
 
@@ -61,26 +62,39 @@ private:
     enum {
         kWhatAddStream,
         kWhatRemoveStream,
-        kWhatPollStreams,
+        kWhatSocketEvent,
         kWhatInjectPacket,
+        kWhatSendReceiverReports,
     };
 
-    static const int64_t kSelectTimeoutUs;
+    static const int64_t kReceiverReportCheckIntervalUs;
+    static const size_t kMaxPacketsPerEvent;
+    static const size_t kMaxPacketsPerBatch;
 
     uint32_t mFlags;
 
     struct StreamInfo;
     List<StreamInfo> mStreams;
 
-    bool mPollEventPending;
+    // Tells us about incoming datagrams on the sockets of all streams.
+    sp<AEpollReactor> mReactor;
+
+    bool mReceiverReportEventPending;
     int64_t mLastReceiverReportTimeUs;
     void onRemoveStream(const sp<AMessage> &msg);
-    void onPollStreams();
+    void onSocketEvent(const sp<AMessage> &msg);
     void onInjectPacket(const sp<AMessage> &msg);
     void onSendReceiverReports();
 
+    void unregisterSockets(StreamInfo *info);
+
     status_t receive(StreamInfo *info, bool receiveRTP);
 
+    // Reads up to kMaxPacketsPerBatch RTP packets with a single call,
+    // into buffers recycled from the stream's pool.
+    status_t receiveRTPBatch(StreamInfo *info, size_t *numPackets);
+    sp<ABuffer> acquireRTPBuffer(StreamInfo *info);
+
     status_t parseRTP(StreamInfo *info, const sp<ABuffer> &buffer);
     status_t parseRTCP(StreamInfo *info, const sp<ABuffer> &buffer);
     status_t parseSR(StreamInfo *info, const uint8_t *data, size_t size);
@@ -88,7 +102,7 @@ private:
 
     sp<ARTPSource> findSource(StreamInfo *info, uint32_t id);
 
-    void postPollEvent();
+    void postReceiverReportEvent();
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPConnection);
 };
@@ -20,6 +20,7 @@
 
 #include "ARTPWriter.h"
 
+#include <errno.h>
 #include <fcntl.h>
 
 #include <media/MediaSource.h>
@@ -40,6 +41,9 @@ namespace android {
 // static const size_t kMaxPacketSize = 65507;  // maximum payload in UDP over IP
 static const size_t kMaxPacketSize = 1500;
 
+// Number of RTP packets handed to a single sendmmsg() call.
+static const size_t kMaxPacketsPerFlush = 32;
+
 static int UniformRand(int limit) {
     return ((double)rand() * limit) / RAND_MAX;
 }
@@ -114,12 +118,17 @@ bool ARTPWriter::reachedEOS() {
     return (mFlags & kFlagEOS) != 0;
 }
 
-status_t ARTPWriter::start(MetaData * /* params */) {
+status_t ARTPWriter::start(MetaData *params) {
     Mutex::Autolock autoLock(mLock);
     if (mFlags & kFlagStarted) {
         return INVALID_OPERATION;
     }
 
+    int32_t bitRate;
+    if (params != NULL && params->findInt32(kKeyBitRate, &bitRate) && bitRate > 0) {
+        setPacingRate(bitRate);
+    }
+
     mFlags &= ~kFlagEOS;
     mSourceID = rand();
     mSeqNo = UniformRand(65536);
@@ -287,6 +296,9 @@ void ARTPWriter::onRead(const sp<AMessage> &msg) {
         } else if (mMode == AMR_NB || mMode == AMR_WB) {
             sendAMRData(mediaBuf);
         }
+
+        // All packets of a frame go out together.
+        flushRTP();
     }
 
     mediaBuf->release();
@@ -316,6 +328,73 @@ void ARTPWriter::send(const sp<ABuffer> &buffer, bool isRTCP) {
 
     CHECK_EQ(n, (ssize_t)buffer->size());
 
+    logPacket(buffer, isRTCP);
+}
+
+void ARTPWriter::queueRTP(const sp<ABuffer> &buffer) {
+    mPendingRTPPackets.push(buffer);
+}
+
+void ARTPWriter::flushRTP() {
+    size_t index = 0;
+    while (index < mPendingRTPPackets.size()) {
+        struct iovec iov[kMaxPacketsPerFlush];
+        struct mmsghdr msgs[kMaxPacketsPerFlush];
+        memset(msgs, 0, sizeof(msgs));
+
+        size_t count = mPendingRTPPackets.size() - index;
+        if (count > kMaxPacketsPerFlush) {
+            count = kMaxPacketsPerFlush;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            const sp<ABuffer> &buffer = mPendingRTPPackets.itemAt(index + i);
+
+            iov[i].iov_base = buffer->data();
+            iov[i].iov_len = buffer->size();
+
+            msgs[i].msg_hdr.msg_name = &mRTPAddr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(mRTPAddr);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n;
+        do {
+            n = sendmmsg(mSocket, msgs, count, 0);
+        } while (n < 0 && errno == EINTR);
+
+        CHECK_GT(n, 0);
+
+        for (int i = 0; i < n; ++i) {
+            const sp<ABuffer> &buffer = mPendingRTPPackets.itemAt(index + i);
+            CHECK_EQ(msgs[i].msg_len, (unsigned)buffer->size());
+
+            logPacket(buffer, false /* isRTCP */);
+        }
+
+        // A partial batch is followed by another call for the rest.
+        index += n;
+    }
+
+    mPendingRTPPackets.clear();
+}
+
+void ARTPWriter::setPacingRate(int32_t bitRate) {
+#ifdef SO_MAX_PACING_RATE
+    // Lets the kernel spread out the packets of a frame if the qdisc
+    // supports pacing, with some headroom for bitrate fluctuations.
+    uint32_t bytesPerSecond = (uint32_t)bitRate / 8 * 2;
+    if (setsockopt(mSocket, SOL_SOCKET, SO_MAX_PACING_RATE,
+                &bytesPerSecond, sizeof(bytesPerSecond)) < 0) {
+        ALOGV("pacing not available (%s)", strerror(errno));
+    }
+#else
+    (void)bitRate;
+#endif
+}
+
+void ARTPWriter::logPacket(const sp<ABuffer> &buffer, bool isRTCP) {
 #if LOG_TO_FILES
     int fd = isRTCP ? mRTCPFd : mRTPFd;
 
@@ -324,6 +403,9 @@ void ARTPWriter::send(const sp<ABuffer> &buffer, bool isRTCP) {
     write(fd, &ms, sizeof(ms));
     write(fd, &length, sizeof(length));
     write(fd, buffer->data(), buffer->size());
+#else
+    (void)buffer;
+    (void)isRTCP;
 #endif
 }
 
@@ -579,9 +661,9 @@ void ARTPWriter::sendAVCData(MediaBufferBase *mediaBuf) {
     const uint8_t *mediaData =
         (const uint8_t *)mediaBuf->data() + mediaBuf->range_offset();
 
-    sp<ABuffer> buffer = new ABuffer(kMaxPacketSize);
-    if (mediaBuf->range_length() + 12 <= buffer->capacity()) {
+    if (mediaBuf->range_length() + 12 <= kMaxPacketSize) {
         // The data fits into a single packet
+        sp<ABuffer> buffer = new ABuffer(kMaxPacketSize);
         uint8_t *data = buffer->data();
         data[0] = 0x80;
         data[1] = (1 << 7) | PT;  // M-bit
@@ -601,7 +683,7 @@ void ARTPWriter::sendAVCData(MediaBufferBase *mediaBuf) {
 
         buffer->setRange(0, mediaBuf->range_length() + 12);
 
-        send(buffer, false /* isRTCP */);
+        queueRTP(buffer);
 
         ++mSeqNo;
         ++mNumRTPSent;
@@ -614,6 +696,9 @@ void ARTPWriter::sendAVCData(MediaBufferBase *mediaBuf) {
 
         bool firstPacket = true;
         while (offset < mediaBuf->range_length()) {
+            // Packets are queued until the whole frame has been packetized.
+            sp<ABuffer> buffer = new ABuffer(kMaxPacketSize);
+
             size_t size = mediaBuf->range_length() - offset;
             bool lastPacket = true;
             if (size + 12 + 2 > buffer->capacity()) {
@@ -648,7 +733,7 @@ void ARTPWriter::sendAVCData(MediaBufferBase *mediaBuf) {
 
             buffer->setRange(0, 14 + size);
 
-            send(buffer, false /* isRTCP */);
+            queueRTP(buffer);
 
             ++mSeqNo;
             ++mNumRTPSent;
@@ -714,7 +799,7 @@ void ARTPWriter::sendH263Data(MediaBufferBase *mediaBuf) {
 
         buffer->setRange(0, remaining + 14);
 
-        send(buffer, false /* isRTCP */);
+        queueRTP(buffer);
 
         ++mSeqNo;
         ++mNumRTPSent;
@@ -822,7 +907,7 @@ void ARTPWriter::sendAMRData(MediaBufferBase *mediaBuf) {
 
     buffer->setRange(0, dstOffset);
 
-    send(buffer, false /* isRTCP */);
+    queueRTP(buffer);
 
     ++mSeqNo;
     ++mNumRTPSent;
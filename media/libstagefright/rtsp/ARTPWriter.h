@@ -23,6 +23,7 @@
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/base64.h>
 #include <media/stagefright/MediaWriter.h>
+#include <utils/Vector.h>
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -120,6 +121,15 @@ private:
 
     void send(const sp<ABuffer> &buffer, bool isRTCP);
 
+    // RTP packets of the current frame, sent with as few syscalls as
+    // possible by flushRTP().
+    Vector<sp<ABuffer> > mPendingRTPPackets;
+    void queueRTP(const sp<ABuffer> &buffer);
+    void flushRTP();
+
+    void setPacingRate(int32_t bitRate);
+    void logPacket(const sp<ABuffer> &buffer, bool isRTCP);
+
     DISALLOW_EVIL_CONSTRUCTORS(ARTPWriter);
 };
 
@@ -22,6 +22,7 @@
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AEpollReactor.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/base64.h>
 #include <media/stagefright/MediaErrors.h>
@@ -38,9 +39,6 @@
 
 namespace android {
 
-// static
-const int64_t ARTSPConnection::kSelectTimeoutUs = 1000ll;
-
 // static
 const AString ARTSPConnection::sUserAgent =
     AStringPrintf("User-Agent: %s\r\n", MakeUserAgent().c_str());
@@ -53,12 +51,16 @@ ARTSPConnection::ARTSPConnection(bool uidValid, uid_t uid)
       mSocket(-1),
       mConnectionID(0),
       mNextCSeq(0),
-      mReceiveResponseEventPending(false) {
+      mReceiveResponseEventPending(false),
+      mReactor(AEpollReactor::GetShared()),
+      mSocketToken(-1) {
+    CHECK(mReactor != NULL);
 }
 
 ARTSPConnection::~ARTSPConnection() {
     if (mSocket >= 0) {
         ALOGE("Connection is still open, closing the socket.");
+        unwatchSocket();
         if (mUIDValid) {
             HTTPBase::UnRegisterSocketUserTag(mSocket);
             HTTPBase::UnRegisterSocketUserMark(mSocket);
@@ -114,7 +116,7 @@ void ARTSPConnection::onMessageReceived(const sp<AMessage> &msg) {
             break;
 
         case kWhatReceiveResponse:
-            onReceiveResponse();
+            onReceiveResponse(msg);
             break;
 
         case kWhatObserveBinaryData:
@@ -214,6 +216,7 @@ void ARTSPConnection::onConnect(const sp<AMessage> &msg) {
     ++mConnectionID;
 
     if (mState != DISCONNECTED) {
+        unwatchSocket();
         if (mUIDValid) {
             HTTPBase::UnRegisterSocketUserTag(mSocket);
             HTTPBase::UnRegisterSocketUserMark(mSocket);
@@ -295,7 +298,7 @@ void ARTSPConnection::performConnect(const sp<AMessage> &reply,
             sp<AMessage> msg = new AMessage(kWhatCompleteConnection, this);
             msg->setMessage("reply", reply);
             msg->setInt32("connection-id", mConnectionID);
-            msg->post();
+            watchSocket(AEpollReactor::kEventWritable, msg);
             return;
         }
 
@@ -320,6 +323,7 @@ void ARTSPConnection::performConnect(const sp<AMessage> &reply,
 }
 
 void ARTSPConnection::performDisconnect() {
+    unwatchSocket();
     if (mUIDValid) {
         HTTPBase::UnRegisterSocketUserTag(mSocket);
         HTTPBase::UnRegisterSocketUserMark(mSocket);
@@ -365,24 +369,20 @@ void ARTSPConnection::onCompleteConnection(const sp<AMessage> &msg) {
         return;
     }
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = kSelectTimeoutUs;
-
-    fd_set ws;
-    FD_ZERO(&ws);
-    FD_SET(mSocket, &ws);
-
-    int res = select(mSocket + 1, NULL, &ws, NULL, &tv);
-    CHECK_GE(res, 0);
-
-    if (res == 0) {
-        // Timed out. Not yet connected.
+    int32_t token;
+    if (!msg->findInt32("token", &token)) {
+        // Posted directly, wait for the socket to become writable.
+        watchSocket(AEpollReactor::kEventWritable, msg);
+        return;
+    }
 
-        msg->post();
+    if (token != mSocketToken) {
         return;
     }
 
+    // Either connected or failed, we'll watch for incoming data from now on.
+    unwatchSocket();
+
     int err;
     socklen_t optionLen = sizeof(err);
     CHECK_EQ(getsockopt(mSocket, SOL_SOCKET, SO_ERROR, &err, &optionLen), 0);
@@ -399,6 +399,7 @@ void ARTSPConnection::performCompleteConnection(const sp<AMessage> &msg, int err
         reply->setInt32("result", -err);
 
         mState = DISCONNECTED;
+        unwatchSocket();
         if (mUIDValid) {
             HTTPBase::UnRegisterSocketUserTag(mSocket);
             HTTPBase::UnRegisterSocketUserMark(mSocket);
@@ -484,38 +485,35 @@ void ARTSPConnection::onSendRequest(const sp<AMessage> &msg) {
     mPendingRequests.add(cseq, reply);
 }
 
-void ARTSPConnection::onReceiveResponse() {
-    mReceiveResponseEventPending = false;
+void ARTSPConnection::onReceiveResponse(const sp<AMessage> &msg) {
+    int32_t token;
+    CHECK(msg->findInt32("token", &token));
 
-    if (mState != CONNECTED) {
+    if (mState != CONNECTED || token != mSocketToken) {
+        // stale, from a previous connection.
         return;
     }
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = kSelectTimeoutUs;
-
-    fd_set rs;
-    FD_ZERO(&rs);
-    FD_SET(mSocket, &rs);
-
-    int res = select(mSocket + 1, &rs, NULL, NULL, &tv);
+    MakeSocketBlocking(mSocket, true);
 
-    if (res == 1) {
-        MakeSocketBlocking(mSocket, true);
+    bool success = receiveRTSPReponse();
 
-        bool success = receiveRTSPReponse();
+    if (mState != CONNECTED) {
+        // receiving failed and disconnected.
+        return;
+    }
 
-        MakeSocketBlocking(mSocket, false);
+    MakeSocketBlocking(mSocket, false);
 
-        if (!success) {
-            // Something horrible, irreparable has happened.
-            flushPendingRequests();
-            return;
-        }
+    if (!success) {
+        // Something horrible, irreparable has happened.
+        unwatchSocket();
+        flushPendingRequests();
+        return;
     }
 
-    postReceiveReponseEvent();
+    // Reported again right away if more data is already waiting.
+    mReactor->rearm(mSocketToken);
 }
 
 void ARTSPConnection::flushPendingRequests() {
@@ -534,12 +532,32 @@ void ARTSPConnection::postReceiveReponseEvent() {
         return;
     }
 
-    sp<AMessage> msg = new AMessage(kWhatReceiveResponse, this);
-    msg->post();
+    watchSocket(
+            AEpollReactor::kEventReadable,
+            new AMessage(kWhatReceiveResponse, this));
 
     mReceiveResponseEventPending = true;
 }
 
+void ARTSPConnection::watchSocket(
+        uint32_t events, const sp<AMessage> &notify) {
+    unwatchSocket();
+
+    status_t err = mReactor->addFd(mSocket, events, notify, &mSocketToken);
+    if (err != OK) {
+        ALOGE("failed to watch rtsp socket (%d)", err);
+        mSocketToken = -1;
+    }
+}
+
+void ARTSPConnection::unwatchSocket() {
+    if (mSocketToken >= 0) {
+        mReactor->removeFd(mSocketToken);
+        mSocketToken = -1;
+    }
+    mReceiveResponseEventPending = false;
+}
+
 status_t ARTSPConnection::receive(void *data, size_t size) {
     size_t offset = 0;
     while (offset < size) {
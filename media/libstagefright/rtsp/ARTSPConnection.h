@@ -24,6 +24,7 @@
 namespace android {
 
 struct ABuffer;
+struct AEpollReactor;
 
 struct ARTSPResponse : public RefBase {
     unsigned long mStatusCode;
@@ -77,8 +78,6 @@ protected:
         DIGEST
     };
 
-    static const int64_t kSelectTimeoutUs;
-
     static const AString sUserAgent;
 
     bool mUIDValid;
@@ -92,6 +91,11 @@ protected:
     int32_t mNextCSeq;
     bool mReceiveResponseEventPending;
 
+    // Watches mSocket, for completion of the connection and then for
+    // incoming data.
+    sp<AEpollReactor> mReactor;
+    int32_t mSocketToken;
+
     KeyedVector<int32_t, sp<AMessage> > mPendingRequests;
 
     sp<AMessage> mObserveBinaryMessage;
@@ -102,10 +106,12 @@ protected:
     void onDisconnect(const sp<AMessage> &msg);
     void onCompleteConnection(const sp<AMessage> &msg);
     void onSendRequest(const sp<AMessage> &msg);
-    void onReceiveResponse();
+    void onReceiveResponse(const sp<AMessage> &msg);
 
     void flushPendingRequests();
     void postReceiveReponseEvent();
+    void watchSocket(uint32_t events, const sp<AMessage> &notify);
+    void unwatchSocket();
 
     // Return false iff something went unrecoverably wrong.
     bool receiveRTSPReponse();
@@ -147,7 +147,12 @@ struct MyHandler : public AHandler {
           mKeepAliveGeneration(0),
           mPausing(false),
           mPauseGeneration(0),
-          mPlayResponseParsed(false) {
+          mPlayResponseParsed(false),
+          mFastStart(property_get_bool("media.rtsp.fast-start", false)),
+          mSetupGeneration(0),
+          mNumPendingSetups(0),
+          mPipelinedSetupFailed(false),
+          mProvisionalTime(false) {
         mConn = AVMediaServiceFactory::get()->createARTSPConnection(
                 mUIDValid, uid);
         mRTPConn = AVMediaServiceFactory::get()->createARTPConnection();
@@ -657,6 +662,13 @@ struct MyHandler : public AHandler {
 
             case 'setu':
             {
+                int32_t generation;
+                CHECK(msg->findInt32("generation", &generation));
+                if (generation != mSetupGeneration) {
+                    ALOGV("stale SETUP response ignored.");
+                    break;
+                }
+
                 size_t index;
                 CHECK(msg->findSize("index", &index));
 
@@ -755,6 +767,32 @@ struct MyHandler : public AHandler {
                     }
                 }
 
+                if (mNumPendingSetups > 0) {
+                    // Response to one of the pipelined SETUP requests. On
+                    // failure its track is left in place, the fallback
+                    // below tears down all of them.
+                    --mNumPendingSetups;
+                    if (result != OK) {
+                        mPipelinedSetupFailed = true;
+                    }
+
+                    if (mNumPendingSetups == 0) {
+                        if (mPipelinedSetupFailed) {
+                            ALOGW("Pipelined SETUP failed, reconnecting "
+                                 "without fast start.");
+
+                            mFastStart = false;
+
+                            sp<AMessage> msg = new AMessage('abor', this);
+                            msg->setInt32("reconnect", true);
+                            msg->post();
+                        } else {
+                            sendPlayRequest();
+                        }
+                    }
+                    break;
+                }
+
                 if (result != OK) {
                     if (track) {
                         if (!track->mUsingInterleavedTCP) {
@@ -776,24 +814,13 @@ struct MyHandler : public AHandler {
 
                 ++index;
                 if (result == OK && index < mSessionDesc->countTracks()) {
-                    setupTrack(index);
+                    if (mFastStart) {
+                        setupRemainingTracks(index);
+                    } else {
+                        setupTrack(index);
+                    }
                 } else if (mSetupTracksSuccessful) {
-                    ++mKeepAliveGeneration;
-                    postKeepAlive();
-
-                    AString request = "PLAY ";
-                    request.append(mControlURL);
-                    request.append(" RTSP/1.0\r\n");
-
-                    request.append("Session: ");
-                    request.append(mSessionID);
-                    request.append("\r\n");
-
-                    AVMediaServiceUtils::get()->appendRange(&request);
-                    request.append("\r\n");
-
-                    sp<AMessage> reply = new AMessage('play', this);
-                    mConn->sendRequest(request.c_str(), reply);
+                    sendPlayRequest();
                 } else {
                     sp<AMessage> reply = new AMessage('disc', this);
                     mConn->disconnect(reply);
@@ -902,9 +929,13 @@ struct MyHandler : public AHandler {
                 }
                 mTracks.clear();
                 mSetupTracksSuccessful = false;
+                ++mSetupGeneration;
+                mNumPendingSetups = 0;
+                mPipelinedSetupFailed = false;
                 mSeekPending = false;
                 mFirstAccessUnit = true;
                 mAllTracksHaveTime = false;
+                mProvisionalTime = false;
                 mNTPAnchorUs = -1;
                 mMediaAnchorUs = -1;
                 mNumAccessUnitsReceived = 0;
@@ -1262,9 +1293,11 @@ struct MyHandler : public AHandler {
 
                     info->mRTPAnchor = 0;
                     info->mNTPAnchorUs = -1;
+                    info->mProvisionalTime = false;
                 }
 
                 mAllTracksHaveTime = false;
+                mProvisionalTime = false;
                 mNTPAnchorUs = -1;
 
                 // Start new timeoutgeneration to avoid getting timeout
@@ -1564,6 +1597,9 @@ private:
 
         uint32_t mRTPAnchor;
         int64_t mNTPAnchorUs;
+        // The anchor was picked locally in fast start mode and is not
+        // yet backed by a sender report.
+        bool mProvisionalTime;
         int32_t mTimeScale;
         bool mEOSReceived;
 
@@ -1617,6 +1653,57 @@ private:
 
     bool mPlayResponseParsed;
 
+    // Fast start: SETUP requests after the first one are pipelined, and
+    // tracks are presented on a provisional clock until sender reports
+    // establish the real one.
+    bool mFastStart;
+    int32_t mSetupGeneration;
+    size_t mNumPendingSetups;
+    bool mPipelinedSetupFailed;
+    bool mProvisionalTime;
+
+    bool isTrackSupported(size_t index) {
+        sp<APacketSource> source = new APacketSource(mSessionDesc, index);
+        return source->initCheck() == OK;
+    }
+
+    // Sends SETUP for the tracks from |index| on without waiting for the
+    // responses, stopping at the first unsupported one just like the
+    // sequential setup does.
+    void setupRemainingTracks(size_t index) {
+        for (; index < mSessionDesc->countTracks(); ++index) {
+            if (!isTrackSupported(index)) {
+                ALOGW("Unsupported format. Ignoring track #%zu.", index);
+                break;
+            }
+            setupTrack(index);
+            ++mNumPendingSetups;
+        }
+
+        if (mNumPendingSetups == 0) {
+            sendPlayRequest();
+        }
+    }
+
+    void sendPlayRequest() {
+        ++mKeepAliveGeneration;
+        postKeepAlive();
+
+        AString request = "PLAY ";
+        request.append(mControlURL);
+        request.append(" RTSP/1.0\r\n");
+
+        request.append("Session: ");
+        request.append(mSessionID);
+        request.append("\r\n");
+
+        AVMediaServiceUtils::get()->appendRange(&request);
+        request.append("\r\n");
+
+        sp<AMessage> reply = new AMessage('play', this);
+        mConn->sendRequest(request.c_str(), reply);
+    }
+
     void setupTrack(size_t index) {
         sp<APacketSource> source =
             new APacketSource(mSessionDesc, index);
@@ -1625,6 +1712,7 @@ private:
             ALOGW("Unsupported format. Ignoring track #%zu.", index);
 
             sp<AMessage> reply = new AMessage('setu', this);
+            reply->setInt32("generation", mSetupGeneration);
             reply->setSize("index", index);
             reply->setInt32("result", ERROR_UNSUPPORTED);
             reply->post();
@@ -1649,6 +1737,7 @@ private:
         info->mRTCPSocket = -1;
         info->mRTPAnchor = 0;
         info->mNTPAnchorUs = -1;
+        info->mProvisionalTime = false;
         info->mNormalPlayTimeRTP = 0;
         info->mNormalPlayTimeUs = 0ll;
 
@@ -1713,6 +1802,7 @@ private:
         request.append("\r\n");
 
         sp<AMessage> reply = new AMessage('setu', this);
+        reply->setInt32("generation", mSetupGeneration);
         reply->setSize("index", index);
         reply->setSize("track-index", mTracks.size() - 1);
         mConn->sendRequest(request.c_str(), reply);
@@ -1743,8 +1833,24 @@ private:
     }
 
     void fakeTimestamps() {
+        if (mProvisionalTime) {
+            // Tracks are already presented on the provisional clock, keep
+            // it rather than making them jump.
+            mProvisionalTime = false;
+            for (size_t i = 0; i < mTracks.size(); ++i) {
+                TrackInfo *track = &mTracks.editItemAt(i);
+                if (track->mNTPAnchorUs < 0) {
+                    onTimeUpdate(i, 0, 0ll);
+                }
+                track->mProvisionalTime = false;
+            }
+            onTrackTimeEstablished();
+            return;
+        }
+
         mNTPAnchorUs = -1ll;
         for (size_t i = 0; i < mTracks.size(); ++i) {
+            mTracks.editItemAt(i).mProvisionalTime = false;
             onTimeUpdate(i, 0, 0ll);
         }
     }
@@ -1753,13 +1859,46 @@ private:
         TrackInfo *track;
         for (size_t i = 0; i < mTracks.size(); ++i) {
             track = &mTracks.editItemAt(i);
-            if (track->mPackets.empty()) {
+            // Provisionally timed tracks have had their packets sent on.
+            if (track->mPackets.empty() && !track->mProvisionalTime) {
                 return false;
             }
         }
         return true;
     }
 
+    // In fast start mode a live track does not wait for a sender report:
+    // its first queued access unit is placed at the current media time on
+    // a provisional clock, which onTimeUpdate() later moves onto the
+    // server's clock. Returns true if the track can be timestamped now.
+    bool setProvisionalTime(int32_t trackIndex) {
+        if (!mFastStart || mSeekable) {
+            return false;
+        }
+
+        TrackInfo *track = &mTracks.editItemAt(trackIndex);
+        if (track->mNTPAnchorUs >= 0) {
+            return true;
+        }
+
+        if (mNTPAnchorUs < 0) {
+            mNTPAnchorUs = 0;
+            mMediaAnchorUs = mLastMediaTimeUs;
+            mProvisionalTime = true;
+        }
+
+        uint32_t rtpTime;
+        CHECK((*track->mPackets.begin())->meta()->findInt32(
+                    "rtp-time", (int32_t *)&rtpTime));
+
+        track->mRTPAnchor = rtpTime;
+        track->mNTPAnchorUs = mNTPAnchorUs + mLastMediaTimeUs - mMediaAnchorUs;
+        track->mProvisionalTime = true;
+
+        ALOGI("track %d started on provisional time.", trackIndex);
+        return true;
+    }
+
     void handleFirstAccessUnit() {
         if (mFirstAccessUnit) {
             sp<AMessage> msg = mNotify->dup();
@@ -1788,19 +1927,55 @@ private:
 
         TrackInfo *track = &mTracks.editItemAt(trackIndex);
 
+        if (mProvisionalTime) {
+            if (!track->mProvisionalTime) {
+                // Nothing relates this report to the provisional clock
+                // yet, so start the track on it as of now.
+                track->mRTPAnchor = rtpTime;
+                track->mNTPAnchorUs = mNTPAnchorUs + mLastMediaTimeUs - mMediaAnchorUs;
+                track->mProvisionalTime = true;
+                return;
+            }
+
+            // Shift the provisional clock onto the server's so that this
+            // track's media time carries on without a jump. The other
+            // tracks are reconciled by their own sender reports.
+            int64_t anchorNTPUs = ntpTimeUs
+                - (((int64_t)rtpTime - (int64_t)track->mRTPAnchor) * 1000000ll)
+                    / track->mTimeScale;
+            int64_t offsetUs = anchorNTPUs - track->mNTPAnchorUs;
+
+            mNTPAnchorUs += offsetUs;
+            for (size_t i = 0; i < mTracks.size(); ++i) {
+                TrackInfo *info = &mTracks.editItemAt(i);
+                if (info->mProvisionalTime) {
+                    info->mNTPAnchorUs += offsetUs;
+                }
+            }
+            mProvisionalTime = false;
+
+            ALOGI("Provisional time moved onto the server clock by track %d.",
+                 trackIndex);
+        }
+
         track->mRTPAnchor = rtpTime;
         track->mNTPAnchorUs = ntpTimeUs;
+        track->mProvisionalTime = false;
 
         if (mNTPAnchorUs < 0) {
             mNTPAnchorUs = ntpTimeUs;
             mMediaAnchorUs = mLastMediaTimeUs;
         }
 
+        onTrackTimeEstablished();
+    }
+
+    void onTrackTimeEstablished() {
         if (!mAllTracksHaveTime) {
             bool allTracksHaveTime = (mTracks.size() > 0);
             for (size_t i = 0; i < mTracks.size(); ++i) {
                 TrackInfo *track = &mTracks.editItemAt(i);
-                if (track->mNTPAnchorUs < 0) {
+                if (track->mNTPAnchorUs < 0 || track->mProvisionalTime) {
                     allTracksHaveTime = false;
                     break;
                 }
@@ -1899,7 +2074,7 @@ private:
 
         handleFirstAccessUnit();
 
-        if (!mAllTracksHaveTime) {
+        if (!mAllTracksHaveTime && !setProvisionalTime(trackIndex)) {
             ALOGV("storing accessUnit, no time established yet");
             return;
         }
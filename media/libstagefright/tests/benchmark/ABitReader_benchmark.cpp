@@ -0,0 +1,220 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ABitReader_benchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <media/stagefright/foundation/ABitReader.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+// Set ABITREADER_BENCHMARK_TS to the path of a transport stream capture to run
+// the TS benchmarks on real data; otherwise pseudo-random packets are used.
+static const char *kTsCaptureEnv = "ABITREADER_BENCHMARK_TS";
+static const size_t kTsPacketSize = 188;
+static const size_t kNumSyntheticPackets = 8192;
+
+// The reader as it was before the 64-bit reservoir: refills 32 bits a byte at
+// a time. Kept out-of-line like the library implementation was.
+class LegacyBitReader {
+public:
+    LegacyBitReader(const uint8_t *data, size_t size)
+        : mData(data), mSize(size), mReservoir(0), mNumBitsLeft(0) {
+    }
+
+    __attribute__((noinline)) uint32_t getBits(size_t n) {
+        uint32_t result = 0;
+        while (n > 0) {
+            if (mNumBitsLeft == 0) {
+                CHECK(fillReservoir());
+            }
+            size_t m = n < mNumBitsLeft ? n : mNumBitsLeft;
+            result = (result << m) | (mReservoir >> (32 - m));
+            mReservoir = m < 32 ? mReservoir << m : 0;
+            mNumBitsLeft -= m;
+            n -= m;
+        }
+        return result;
+    }
+
+    __attribute__((noinline)) void skipBits(size_t n) {
+        while (n > 32) {
+            getBits(32);
+            n -= 32;
+        }
+        if (n > 0) {
+            getBits(n);
+        }
+    }
+
+    uint32_t getUE() {
+        size_t numZeroes = 0;
+        while (getBits(1) == 0) {
+            ++numZeroes;
+        }
+        return getBits(numZeroes) + (1u << numZeroes) - 1;
+    }
+
+private:
+    const uint8_t *mData;
+    size_t mSize;
+    uint32_t mReservoir;
+    size_t mNumBitsLeft;
+
+    __attribute__((noinline)) bool fillReservoir() {
+        if (mSize == 0) {
+            return false;
+        }
+        mReservoir = 0;
+        size_t i;
+        for (i = 0; mSize > 0 && i < 4; ++i) {
+            mReservoir = (mReservoir << 8) | *mData++;
+            --mSize;
+        }
+        mNumBitsLeft = 8 * i;
+        mReservoir <<= 32 - mNumBitsLeft;
+        return true;
+    }
+};
+
+static const std::vector<uint8_t> &TsData() {
+    static std::vector<uint8_t> *sData = NULL;
+    if (sData != NULL) {
+        return *sData;
+    }
+    sData = new std::vector<uint8_t>;
+
+    const char *path = getenv(kTsCaptureEnv);
+    int fd = path != NULL ? open(path, O_RDONLY) : -1;
+    if (fd >= 0) {
+        uint8_t packet[kTsPacketSize];
+        while (read(fd, packet, sizeof(packet)) == (ssize_t)sizeof(packet)) {
+            if (packet[0] == 0x47) {
+                sData->insert(sData->end(), packet, packet + sizeof(packet));
+            }
+        }
+        close(fd);
+    }
+
+    if (sData->empty()) {
+        srand(1);
+        sData->resize(kNumSyntheticPackets * kTsPacketSize);
+        for (size_t i = 0; i < sData->size(); ++i) {
+            (*sData)[i] = (i % kTsPacketSize) == 0 ? 0x47 : rand();
+        }
+    }
+    return *sData;
+}
+
+// Parses the TS packet header, adaptation field header and, if present, the
+// PES header fields the way ATSParser does.
+template<class Reader>
+static uint32_t ParseTsPacket(Reader *br) {
+    uint32_t sum = br->getBits(8);      // sync_byte
+    br->skipBits(1);                    // transport_error_indicator
+    sum += br->getBits(1);              // payload_unit_start_indicator
+    br->skipBits(1);                    // transport_priority
+    sum += br->getBits(13);             // PID
+    sum += br->getBits(2);              // transport_scrambling_control
+    uint32_t adaptation = br->getBits(2);
+    sum += br->getBits(4);              // continuity_counter
+    if (adaptation & 2) {
+        uint32_t length = br->getBits(8);
+        if (length > 0) {
+            sum += br->getBits(1);      // discontinuity_indicator
+            br->skipBits(2);
+            uint32_t pcrFlag = br->getBits(1);
+            br->skipBits(4);
+            if (pcrFlag) {
+                sum += br->getBits(32); // program_clock_reference_base
+                sum += br->getBits(1);
+                br->skipBits(6);
+                sum += br->getBits(9);  // program_clock_reference_extension
+            }
+        }
+    }
+    return sum;
+}
+
+template<class Reader>
+static void BM_TsHeaders(benchmark::State &state) {
+    const std::vector<uint8_t> &data = TsData();
+    while (state.KeepRunning()) {
+        uint32_t sum = 0;
+        for (size_t offset = 0; offset + kTsPacketSize <= data.size();
+                offset += kTsPacketSize) {
+            Reader br(&data[offset], kTsPacketSize);
+            sum += ParseTsPacket(&br);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+// Exp-Golomb codes with small values, as found in SPS and slice headers.
+static const std::vector<uint8_t> &GolombData() {
+    static std::vector<uint8_t> *sData = NULL;
+    if (sData == NULL) {
+        sData = new std::vector<uint8_t>(1 << 16);
+        srand(2);
+        for (size_t i = 0; i < sData->size(); ++i) {
+            // bias towards set bits so that most codes are short
+            (*sData)[i] = rand() | rand();
+        }
+    }
+    return *sData;
+}
+
+static void BM_LegacyUE(benchmark::State &state) {
+    const std::vector<uint8_t> &data = GolombData();
+    while (state.KeepRunning()) {
+        LegacyBitReader br(data.data(), data.size());
+        uint32_t sum = 0;
+        for (size_t i = 0; i < data.size(); ++i) {
+            sum += br.getUE();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+static void BM_ABitReaderUE(benchmark::State &state) {
+    const std::vector<uint8_t> &data = GolombData();
+    while (state.KeepRunning()) {
+        ABitReader br(data.data(), data.size());
+        uint32_t sum = 0, x;
+        for (size_t i = 0; i < data.size(); ++i) {
+            CHECK(br.getUEGraceful(&x));
+            sum += x;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_TsHeaders, LegacyBitReader);
+BENCHMARK_TEMPLATE(BM_TsHeaders, ABitReader);
+BENCHMARK(BM_LegacyUE);
+BENCHMARK(BM_ABitReaderUE);
+
+}  // namespace android
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ALooper_benchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <utils/threads.h>
+
+namespace android {
+
+// Measures the cost of posting a message on a looper that already has a number
+// of pending delayed events (e.g. renderer or live session timers) and the
+// latency until that message is dispatched.
+struct LooperBenchHandler : public AHandler {
+    enum {
+        kWhatPing = 'ping',
+        kWhatTimer = 'timr',
+    };
+
+    LooperBenchHandler() : mPings(0) { }
+
+    void waitForPings(uint32_t count) {
+        Mutex::Autolock autoLock(mLock);
+        while (mPings < count) {
+            mCondition.wait(mLock);
+        }
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        if (msg->what() == kWhatPing) {
+            Mutex::Autolock autoLock(mLock);
+            ++mPings;
+            mCondition.signal();
+        }
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    uint32_t mPings;
+};
+
+struct LooperFixture {
+    explicit LooperFixture(int64_t pendingEvents) {
+        mLooper = new ALooper;
+        mLooper->setName("ALooper_benchmark");
+        mHandler = new LooperBenchHandler;
+        mLooper->registerHandler(mHandler);
+        mLooper->start();
+
+        // spread far-future timers so that they never fire during the run but
+        // exercise ordered insertion
+        for (int64_t i = 0; i < pendingEvents; ++i) {
+            sp<AMessage> msg = new AMessage(LooperBenchHandler::kWhatTimer, mHandler);
+            msg->post(3600000000ll + (i * 7919) % 1000000);
+        }
+    }
+
+    ~LooperFixture() {
+        mLooper->unregisterHandler(mHandler->id());
+        mLooper->stop();
+    }
+
+    sp<ALooper> mLooper;
+    sp<LooperBenchHandler> mHandler;
+};
+
+static void BM_ALooper_PostDelayed(benchmark::State &state) {
+    LooperFixture fixture(state.range(0));
+    int64_t i = 0;
+    while (state.KeepRunning()) {
+        sp<AMessage> msg = new AMessage(LooperBenchHandler::kWhatTimer, fixture.mHandler);
+        msg->post(3600000000ll + (i++ * 104729) % 1000000);
+    }
+}
+
+static void BM_ALooper_PostDispatch(benchmark::State &state) {
+    LooperFixture fixture(state.range(0));
+    uint32_t count = 0;
+    while (state.KeepRunning()) {
+        sp<AMessage> msg = new AMessage(LooperBenchHandler::kWhatPing, fixture.mHandler);
+        msg->post();
+        fixture.mHandler->waitForPings(++count);
+    }
+}
+
+BENCHMARK(BM_ALooper_PostDelayed)->RangeMultiplier(10)->Range(10, 10000);
+BENCHMARK(BM_ALooper_PostDispatch)->RangeMultiplier(10)->Range(10, 10000);
+
+}  // namespace android
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AMessage_benchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+namespace android {
+
+// Item names like those of a decoder output format.
+static const char *kItemNames[] = {
+    "mime", "width", "height", "stride", "slice-height", "color-format",
+    "crop-left", "crop-top", "crop-right", "crop-bottom", "color-range",
+    "color-standard", "color-transfer", "frame-rate", "max-input-size",
+    "priority", "operating-rate", "rotation-degrees", "sar-width",
+    "sar-height", "durationUs", "profile", "level", "bitrate",
+    "channel-count", "sample-rate", "pcm-encoding", "encoder-delay",
+    "encoder-padding", "is-adts", "aac-profile", "language",
+};
+static const size_t kNumItemNames = sizeof(kItemNames) / sizeof(kItemNames[0]);
+
+static sp<AMessage> MakeFormat(size_t numItems) {
+    sp<AMessage> msg = new AMessage;
+    msg->setString(kItemNames[0], "video/avc");
+    for (size_t i = 1; i < numItems && i < kNumItemNames; ++i) {
+        msg->setInt32(kItemNames[i], i);
+    }
+    return msg;
+}
+
+// The per-buffer pattern in the codec path: a few items set and looked up
+// on a message that is reused.
+static void BM_AMessage_SetFind(benchmark::State &state) {
+    sp<AMessage> msg = MakeFormat(state.range(0));
+    int64_t timeUs = 0;
+    while (state.KeepRunning()) {
+        msg->setInt64("timeUs", timeUs);
+        msg->setInt32("flags", timeUs & 1);
+        msg->setSize("size", 4096);
+
+        int64_t t;
+        int32_t flags;
+        size_t size;
+        CHECK(msg->findInt64("timeUs", &t));
+        CHECK(msg->findInt32("flags", &flags));
+        CHECK(msg->findSize("size", &size));
+        benchmark::DoNotOptimize(t + flags + size);
+        timeUs += 33333;
+    }
+}
+
+// Lookups of items at the end of a message, and of missing items, which
+// both have to look at every item.
+static void BM_AMessage_FindLast(benchmark::State &state) {
+    sp<AMessage> msg = MakeFormat(state.range(0));
+    const char *last = kItemNames[std::min((size_t)state.range(0), kNumItemNames) - 1];
+    while (state.KeepRunning()) {
+        int32_t value = 0;
+        benchmark::DoNotOptimize(msg->findInt32(last, &value));
+        benchmark::DoNotOptimize(msg->findInt32("not-there", &value));
+        benchmark::DoNotOptimize(value);
+    }
+}
+
+static void BM_AMessage_Dup(benchmark::State &state) {
+    sp<AMessage> msg = MakeFormat(state.range(0));
+    while (state.KeepRunning()) {
+        sp<AMessage> copy = msg->dup();
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+
+BENCHMARK(BM_AMessage_SetFind)->Arg(1)->Arg(8)->Arg(32);
+BENCHMARK(BM_AMessage_FindLast)->Arg(8)->Arg(32);
+BENCHMARK(BM_AMessage_Dup)->Arg(1)->Arg(8)->Arg(32);
+
+}  // namespace android
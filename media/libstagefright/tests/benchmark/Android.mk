@@ -0,0 +1,43 @@
+# Build the media primitives benchmark.
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := media_primitives_benchmark
+
+LOCAL_SRC_FILES := \
+	ABitReader_benchmark.cpp \
+	ALooper_benchmark.cpp \
+	AMessage_benchmark.cpp \
+	AudioMixer_benchmark.cpp \
+	AudioResampler_benchmark.cpp \
+	BenchmarkMain.cpp \
+	ColorConverter_benchmark.cpp \
+	MediaBufferGroup_benchmark.cpp \
+	SampleTable_benchmark.cpp \
+	avc_utils_benchmark.cpp \
+
+LOCAL_STATIC_LIBRARIES := \
+	libmp4extractor_fuzzing \
+	libstagefright_esds \
+	libstagefright_id3 \
+
+LOCAL_SHARED_LIBRARIES := \
+	libaudioprocessing \
+	libaudioutils \
+	libcutils \
+	liblog \
+	libmediaextractor \
+	libstagefright \
+	libstagefright_foundation \
+	libutils \
+
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils) \
+	frameworks/av/include \
+	frameworks/av/media/extractors/mp4 \
+	frameworks/native/include/media/openmax \
+
+LOCAL_CFLAGS += -Werror -Wall
+LOCAL_CLANG := true
+
+include $(BUILD_NATIVE_BENCHMARK)
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUDIO_BENCHMARK_PROVIDER_H_
+#define AUDIO_BENCHMARK_PROVIDER_H_
+
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+#include <audio_utils/primitives.h>
+#include <media/AudioBufferProvider.h>
+#include <system/audio.h>
+
+namespace android {
+
+// Endless source of a sine tone for the mixer and resampler benchmarks. It
+// loops over one second of audio and never runs dry.
+class AudioBenchmarkProvider : public AudioBufferProvider {
+public:
+    AudioBenchmarkProvider(audio_format_t format, uint32_t channels, uint32_t sampleRate)
+        : mFrameSize(channels * audio_bytes_per_sample(format)),
+          mNumFrames(sampleRate),
+          mSampleRate(sampleRate),
+          mChannels(channels),
+          mPosition(0) {
+        std::vector<float> tone(mNumFrames * channels);
+        for (size_t i = 0; i < mNumFrames; ++i) {
+            for (size_t c = 0; c < channels; ++c) {
+                tone[i * channels + c] = 0.5f * sinf(2.0f * M_PI * 1000.0f * i / sampleRate);
+            }
+        }
+        mData.resize(mNumFrames * mFrameSize);
+        if (format == AUDIO_FORMAT_PCM_FLOAT) {
+            memcpy(mData.data(), tone.data(), mData.size());
+        } else {
+            memcpy_to_i16_from_float((int16_t *)mData.data(), tone.data(), tone.size());
+        }
+    }
+
+    uint32_t getSampleRate() const { return mSampleRate; }
+    uint32_t getNumChannels() const { return mChannels; }
+
+    virtual status_t getNextBuffer(Buffer *buffer) {
+        size_t available = mNumFrames - mPosition;
+        if (buffer->frameCount > available) {
+            buffer->frameCount = available;
+        }
+        buffer->raw = mData.data() + mPosition * mFrameSize;
+        return OK;
+    }
+
+    virtual void releaseBuffer(Buffer *buffer) {
+        mPosition += buffer->frameCount;
+        if (mPosition >= mNumFrames) {
+            mPosition = 0;
+        }
+        buffer->frameCount = 0;
+    }
+
+private:
+    const size_t mFrameSize;
+    const size_t mNumFrames;
+    const uint32_t mSampleRate;
+    const uint32_t mChannels;
+    std::vector<uint8_t> mData;
+    size_t mPosition;
+};
+
+}  // namespace android
+
+#endif  // AUDIO_BENCHMARK_PROVIDER_H_
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AudioMixer_benchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+#include <media/AudioMixer.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+#include "AudioBenchmarkProvider.h"
+
+namespace android {
+
+static const size_t kMixerFrameCount = 960;    // 20 ms at 48 kHz
+static const uint32_t kMixerSampleRate = 48000;
+
+// One process() call of a mixer with range(0) stereo tracks, which selects
+// the process hook: a single 16-bit track at the output rate takes the
+// dedicated fast path, several take the generic ones. range(1) makes the
+// tracks 44.1 kHz so that they are resampled, range(2) makes them float.
+static void BM_AudioMixer(benchmark::State &state) {
+    const size_t numTracks = state.range(0);
+    const uint32_t trackRate = state.range(1) ? 44100 : kMixerSampleRate;
+    const audio_format_t format =
+            state.range(2) ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
+    const audio_format_t mixerFormat = format;
+    const audio_channel_mask_t channelMask = AUDIO_CHANNEL_OUT_STEREO;
+
+    std::vector<std::unique_ptr<AudioBenchmarkProvider>> providers;
+    std::vector<uint8_t> output(kMixerFrameCount * 2 * audio_bytes_per_sample(mixerFormat));
+    AudioMixer mixer(kMixerFrameCount, kMixerSampleRate);
+    float volume = AudioMixer::UNITY_GAIN_FLOAT / numTracks;
+
+    for (size_t i = 0; i < numTracks; ++i) {
+        providers.emplace_back(new AudioBenchmarkProvider(format, 2 /* channels */, trackRate));
+
+        const int name = i;
+        CHECK_EQ(mixer.create(name, channelMask, format, AUDIO_SESSION_OUTPUT_MIX),
+                (status_t)OK);
+        mixer.setBufferProvider(name, providers[i].get());
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
+                (void *)output.data());
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MIXER_FORMAT,
+                (void *)(uintptr_t)mixerFormat);
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::FORMAT,
+                (void *)(uintptr_t)format);
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MIXER_CHANNEL_MASK,
+                (void *)(uintptr_t)channelMask);
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::CHANNEL_MASK,
+                (void *)(uintptr_t)channelMask);
+        mixer.setParameter(name, AudioMixer::RESAMPLE, AudioMixer::SAMPLE_RATE,
+                (void *)(uintptr_t)trackRate);
+        mixer.setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0, &volume);
+        mixer.setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1, &volume);
+        mixer.enable(name);
+    }
+
+    while (state.KeepRunning()) {
+        mixer.process();
+    }
+    state.SetItemsProcessed(state.iterations() * kMixerFrameCount * numTracks);
+}
+
+static void MixerArgs(benchmark::internal::Benchmark *b) {
+    for (int numTracks : { 1, 4, 16 }) {
+        for (int resample : { 0, 1 }) {
+            for (int useFloat : { 0, 1 }) {
+                b->Args({numTracks, resample, useFloat});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_AudioMixer)->Apply(MixerArgs);
+
+}  // namespace android
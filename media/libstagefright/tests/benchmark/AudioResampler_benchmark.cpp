@@ -0,0 +1,80 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AudioResampler_benchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <media/AudioResampler.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+#include "AudioBenchmarkProvider.h"
+
+namespace android {
+
+static const size_t kOutputFrames = 960;    // 20 ms at 48 kHz
+static const int32_t kOutputRate = 48000;
+
+// Stereo 44.1 kHz to 48 kHz, the common case in the mixer, at each quality.
+// range(0) is the src_quality, range(1) selects float rather than 16-bit input.
+static void BM_AudioResampler(benchmark::State &state) {
+    const AudioResampler::src_quality quality =
+            (AudioResampler::src_quality)state.range(0);
+    const bool useFloat = state.range(1) != 0;
+    const audio_format_t format = useFloat ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
+
+    AudioBenchmarkProvider provider(format, 2 /* channels */, 44100);
+    std::unique_ptr<AudioResampler> resampler(
+            AudioResampler::create(format, 2 /* channels */, kOutputRate, quality));
+    resampler->setSampleRate(44100);
+    resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
+
+    std::vector<int32_t> output(kOutputFrames * 2);
+    while (state.KeepRunning()) {
+        memset(output.data(), 0, output.size() * sizeof(output[0]));
+        CHECK_EQ(resampler->resample(output.data(), kOutputFrames, &provider), kOutputFrames);
+    }
+    state.SetItemsProcessed(state.iterations() * kOutputFrames);
+}
+
+static void ResamplerArgs(benchmark::internal::Benchmark *b) {
+    static const AudioResampler::src_quality kQualities[] = {
+        AudioResampler::LOW_QUALITY,
+        AudioResampler::MED_QUALITY,
+        AudioResampler::HIGH_QUALITY,
+        AudioResampler::VERY_HIGH_QUALITY,
+        AudioResampler::DYN_LOW_QUALITY,
+        AudioResampler::DYN_MED_QUALITY,
+        AudioResampler::DYN_HIGH_QUALITY,
+    };
+    for (AudioResampler::src_quality quality : kQualities) {
+        b->Args({quality, 0});
+        // only the dynamic resamplers take float input
+        if (quality >= AudioResampler::DYN_LOW_QUALITY) {
+            b->Args({quality, 1});
+        }
+    }
+}
+
+BENCHMARK(BM_AudioResampler)->Apply(ResamplerArgs);
+
+}  // namespace android
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include <vector>
+
+// Reports in JSON unless --benchmark_format is given, so that runs on different
+// builds can be collected and compared by tools.
+int main(int argc, char **argv) {
+    static char kJsonFormat[] = "--benchmark_format=json";
+
+    std::vector<char *> args(argv, argv + argc);
+    bool hasFormat = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strncmp(argv[i], "--benchmark_format", strlen("--benchmark_format"))) {
+            hasFormat = true;
+        }
+    }
+    if (!hasFormat) {
+        args.insert(args.begin() + 1, kJsonFormat);
+    }
+
+    int numArgs = args.size();
+    args.push_back(NULL);
+
+    benchmark::Initialize(&numArgs, args.data());
+    if (benchmark::ReportUnrecognizedArguments(numArgs, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ColorConverter_benchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+// One 1080p frame through convert() for each supported pair of formats,
+// on the calling thread only (range(0) == 1) or on all cores (range(0) == 0).
+template<OMX_COLOR_FORMATTYPE kSrc, OMX_COLOR_FORMATTYPE kDst>
+static void BM_ColorConverter(benchmark::State &state) {
+    static const size_t kWidth = 1920;
+    static const size_t kHeight = 1080;
+
+    ColorConverter converter(kSrc, kDst);
+    CHECK(converter.isValid());
+    if (state.range(0) == 0) {
+        converter.setMaxThreads(SIZE_MAX);
+    }
+
+    // large enough for any of the formats at 4 bytes per pixel
+    std::vector<uint8_t> src(kWidth * kHeight * 4);
+    std::vector<uint8_t> dst(kWidth * kHeight * 4);
+    srand(1);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = rand();
+    }
+
+    while (state.KeepRunning()) {
+        CHECK_EQ(converter.convert(
+                src.data(), kWidth, kHeight, 0, 0, kWidth - 1, kHeight - 1,
+                dst.data(), kWidth, kHeight, 0, 0, kWidth - 1, kHeight - 1),
+                (status_t)OK);
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth * kHeight);
+}
+
+BENCHMARK_TEMPLATE(BM_ColorConverter,
+        OMX_COLOR_FormatYUV420Planar, OMX_COLOR_Format16bitRGB565)->Arg(1)->Arg(0);
+BENCHMARK_TEMPLATE(BM_ColorConverter,
+        OMX_COLOR_FormatYUV420Planar, OMX_COLOR_Format32BitRGBA8888)->Arg(1)->Arg(0);
+BENCHMARK_TEMPLATE(BM_ColorConverter,
+        OMX_COLOR_FormatYUV420Planar, OMX_COLOR_Format32bitBGRA8888)->Arg(1)->Arg(0);
+BENCHMARK_TEMPLATE(BM_ColorConverter,
+        OMX_COLOR_FormatYUV420Planar16, OMX_COLOR_Format32BitRGBA8888)->Arg(1)->Arg(0);
+BENCHMARK_TEMPLATE(BM_ColorConverter,
+        OMX_COLOR_FormatYUV420Planar16, OMX_COLOR_FormatYUV444Y410)->Arg(1)->Arg(0);
+BENCHMARK_TEMPLATE(BM_ColorConverter,
+        OMX_COLOR_FormatYUV420SemiPlanar, OMX_COLOR_Format16bitRGB565)->Arg(1)->Arg(0);
+BENCHMARK_TEMPLATE(BM_ColorConverter,
+        OMX_COLOR_FormatCbYCrY, OMX_COLOR_Format16bitRGB565)->Arg(1)->Arg(0);
+
+}  // namespace android
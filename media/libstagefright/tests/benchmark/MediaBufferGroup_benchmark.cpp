@@ -0,0 +1,77 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaBufferGroup_benchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include <media/stagefright/MediaBufferBase.h>
+#include <media/stagefright/MediaBufferGroup.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+static const size_t kBufferSize = 64 * 1024;
+
+// An extractor source reading one sample at a time: acquire a buffer from
+// the group, hand it on and have it released.
+static void BM_MediaBufferGroup_AcquireRelease(benchmark::State &state) {
+    MediaBufferGroup group(state.range(0), kBufferSize);
+    while (state.KeepRunning()) {
+        MediaBufferBase *buffer;
+        CHECK_EQ(group.acquire_buffer(&buffer), (status_t)OK);
+        buffer->set_range(0, kBufferSize / 2);
+        buffer->release();
+    }
+}
+
+// A decoder keeping a number of input buffers in flight.
+static void BM_MediaBufferGroup_InFlight(benchmark::State &state) {
+    const size_t numBuffers = state.range(0);
+    MediaBufferGroup group(numBuffers, kBufferSize);
+    std::vector<MediaBufferBase *> buffers(numBuffers);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < numBuffers; ++i) {
+            CHECK_EQ(group.acquire_buffer(&buffers[i], true /* nonBlocking */), (status_t)OK);
+        }
+        for (size_t i = 0; i < numBuffers; ++i) {
+            buffers[i]->release();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * numBuffers);
+}
+
+// Requests for a given size, as done by sources with varying sample sizes.
+static void BM_MediaBufferGroup_AcquireSized(benchmark::State &state) {
+    MediaBufferGroup group(state.range(0), kBufferSize, state.range(0) * 2);
+    size_t requestedSize = 1024;
+    while (state.KeepRunning()) {
+        MediaBufferBase *buffer;
+        CHECK_EQ(group.acquire_buffer(&buffer, false /* nonBlocking */, requestedSize),
+                (status_t)OK);
+        buffer->release();
+        requestedSize = requestedSize * 3 % kBufferSize + 1;
+    }
+}
+
+BENCHMARK(BM_MediaBufferGroup_AcquireRelease)->Arg(1)->Arg(8)->Arg(32);
+BENCHMARK(BM_MediaBufferGroup_InFlight)->Arg(4)->Arg(16)->Arg(32);
+BENCHMARK(BM_MediaBufferGroup_AcquireSized)->Arg(4)->Arg(16);
+
+}  // namespace android
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SampleTable_benchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <media/DataSourceBase.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ByteUtils.h>
+
+#include "SampleTable.h"
+
+namespace android {
+
+static const uint32_t kTimescale = 90000;
+static const uint32_t kSampleDelta = 3000;      // 30 fps
+static const uint32_t kSyncInterval = 60;       // a sync sample every 2 seconds
+static const uint32_t kSamplesPerChunk = 10;
+
+// Serves the sample table boxes from memory.
+class TableSource : public DataSourceBase {
+public:
+    TableSource() { }
+    virtual ~TableSource() { }
+
+    virtual status_t initCheck() const {
+        return OK;
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (offset < 0 || (size_t)offset >= mData.size()) {
+            return 0;
+        }
+        size = std::min(size, mData.size() - (size_t)offset);
+        memcpy(data, &mData[offset], size);
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        *size = mData.size();
+        return OK;
+    }
+
+    // Appends a full box payload (version and flags, then |values|) and
+    // returns its offset.
+    off64_t addBox(const std::vector<uint32_t> &values) {
+        off64_t offset = mData.size();
+        appendU32(0);
+        for (uint32_t value : values) {
+            appendU32(value);
+        }
+        return offset;
+    }
+
+    size_t boxSize(off64_t offset) const {
+        return mData.size() - offset;
+    }
+
+private:
+    std::vector<uint8_t> mData;
+
+    void appendU32(uint32_t value) {
+        mData.push_back(value >> 24);
+        mData.push_back(value >> 16);
+        mData.push_back(value >> 8);
+        mData.push_back(value);
+    }
+};
+
+// A video track of range(0) samples, described the way a typical muxer
+// writes it.
+struct TableFixture {
+    explicit TableFixture(uint32_t numSamples) : mNumSamples(numSamples) {
+        srand(numSamples);
+
+        uint32_t numChunks = (numSamples + kSamplesPerChunk - 1) / kSamplesPerChunk;
+        std::vector<uint32_t> stco = { numChunks };
+        for (uint32_t i = 0; i < numChunks; ++i) {
+            stco.push_back(1000 + i * kSamplesPerChunk * 20000);
+        }
+
+        std::vector<uint32_t> stsz = { 0 /* sample size */, numSamples };
+        for (uint32_t i = 0; i < numSamples; ++i) {
+            stsz.push_back(i % kSyncInterval == 0 ? 60000 : 2000 + rand() % 15000);
+        }
+
+        std::vector<uint32_t> stss;
+        for (uint32_t i = 0; i < numSamples; i += kSyncInterval) {
+            stss.push_back(i + 1);
+        }
+        stss.insert(stss.begin(), stss.size());
+
+        mTable = new SampleTable(&mSource);
+
+        off64_t offset = mSource.addBox(stco);
+        CHECK_EQ(mTable->setChunkOffsetParams(
+                FOURCC('s', 't', 'c', 'o'), offset, mSource.boxSize(offset)), (status_t)OK);
+        offset = mSource.addBox({ 1, 1 /* first chunk */, kSamplesPerChunk, 1 });
+        CHECK_EQ(mTable->setSampleToChunkParams(offset, mSource.boxSize(offset)), (status_t)OK);
+        offset = mSource.addBox(stsz);
+        CHECK_EQ(mTable->setSampleSizeParams(
+                FOURCC('s', 't', 's', 'z'), offset, mSource.boxSize(offset)), (status_t)OK);
+        offset = mSource.addBox({ 1, numSamples, kSampleDelta });
+        CHECK_EQ(mTable->setTimeToSampleParams(offset, mSource.boxSize(offset)), (status_t)OK);
+        offset = mSource.addBox(stss);
+        CHECK_EQ(mTable->setSyncSampleParams(offset, mSource.boxSize(offset)), (status_t)OK);
+    }
+
+    int64_t durationUs() const {
+        return (int64_t)mNumSamples * kSampleDelta * 1000000ll / kTimescale;
+    }
+
+    TableSource mSource;
+    // declared after the source, which it reads from, so it goes first
+    sp<SampleTable> mTable;
+    const uint32_t mNumSamples;
+};
+
+// A seek: the sample at a random time, then the sync sample before it.
+static void BM_SampleTable_Seek(benchmark::State &state) {
+    TableFixture fixture(state.range(0));
+    // the first lookup builds the sorted sample time table
+    uint32_t sampleIndex;
+    CHECK_EQ(fixture.mTable->findSampleAtTime(
+            0, 1000000, kTimescale, &sampleIndex, SampleTable::kFlagBefore), (status_t)OK);
+
+    int64_t durationUs = fixture.durationUs();
+    while (state.KeepRunning()) {
+        int64_t seekTimeUs = ((int64_t)rand() * 7919) % durationUs;
+        uint32_t syncSampleIndex;
+        CHECK_EQ(fixture.mTable->findSampleAtTime(
+                seekTimeUs, 1000000, kTimescale, &sampleIndex, SampleTable::kFlagClosest),
+                (status_t)OK);
+        CHECK_EQ(fixture.mTable->findSyncSampleNear(
+                sampleIndex, &syncSampleIndex, SampleTable::kFlagBefore), (status_t)OK);
+        benchmark::DoNotOptimize(syncSampleIndex);
+    }
+}
+
+// Reading the sample metadata in order, as during playback.
+static void BM_SampleTable_SequentialMetaData(benchmark::State &state) {
+    TableFixture fixture(state.range(0));
+    uint32_t sampleIndex = 0;
+    while (state.KeepRunning()) {
+        off64_t offset;
+        size_t size;
+        uint32_t compositionTime;
+        bool isSyncSample;
+        CHECK_EQ(fixture.mTable->getMetaDataForSample(
+                sampleIndex, &offset, &size, &compositionTime, &isSyncSample), (status_t)OK);
+        benchmark::DoNotOptimize(offset + size + compositionTime + isSyncSample);
+        if (++sampleIndex == fixture.mNumSamples) {
+            sampleIndex = 0;
+        }
+    }
+}
+
+// Reading the metadata of the sync sample at a seek target, which makes the
+// sample iterator start over.
+static void BM_SampleTable_RandomMetaData(benchmark::State &state) {
+    TableFixture fixture(state.range(0));
+    while (state.KeepRunning()) {
+        uint32_t sampleIndex = ((uint32_t)rand() % fixture.mNumSamples)
+                / kSyncInterval * kSyncInterval;
+        off64_t offset;
+        size_t size;
+        uint32_t compositionTime;
+        CHECK_EQ(fixture.mTable->getMetaDataForSample(
+                sampleIndex, &offset, &size, &compositionTime), (status_t)OK);
+        benchmark::DoNotOptimize(offset + size + compositionTime);
+    }
+}
+
+BENCHMARK(BM_SampleTable_Seek)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_SampleTable_SequentialMetaData)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_SampleTable_RandomMetaData)->Arg(1000)->Arg(100000);
+
+}  // namespace android
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "avc_utils_benchmark"
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/avc_utils.h>
+
+namespace android {
+
+static const size_t kStreamSize = 4 << 20;
+
+// An Annex B byte stream of NAL units of |nalSize| bytes. The payload has no
+// zero bytes, so the only start codes are the real ones.
+static std::vector<uint8_t> MakeByteStream(size_t nalSize) {
+    std::vector<uint8_t> data;
+    data.reserve(kStreamSize + nalSize + 4);
+    srand(nalSize);
+    while (data.size() < kStreamSize) {
+        static const uint8_t kStartCode[] = { 0x00, 0x00, 0x00, 0x01 };
+        data.insert(data.end(), kStartCode, kStartCode + sizeof(kStartCode));
+        data.push_back(data.size() < 64 ? 0x65 : 0x41);   // IDR first, then non-IDR slices
+        for (size_t i = 1; i < nalSize; ++i) {
+            data.push_back(1 + rand() % 255);
+        }
+    }
+    return data;
+}
+
+static void BM_GetNextNALUnit(benchmark::State &state) {
+    std::vector<uint8_t> stream = MakeByteStream(state.range(0));
+    while (state.KeepRunning()) {
+        const uint8_t *data = stream.data();
+        size_t size = stream.size();
+        const uint8_t *nalStart;
+        size_t nalSize;
+        size_t numNALUnits = 0;
+        while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
+            ++numNALUnits;
+        }
+        benchmark::DoNotOptimize(numNALUnits);
+    }
+    state.SetBytesProcessed(state.iterations() * stream.size());
+}
+
+static void BM_FindStartCode(benchmark::State &state) {
+    std::vector<uint8_t> stream = MakeByteStream(state.range(0));
+    while (state.KeepRunning()) {
+        const uint8_t *data = stream.data();
+        const uint8_t *end = data + stream.size();
+        size_t numStartCodes = 0;
+        const uint8_t *startCode;
+        while ((startCode = findStartCode(data, end - data)) != NULL) {
+            ++numStartCodes;
+            data = startCode + 3;
+        }
+        benchmark::DoNotOptimize(numStartCodes);
+    }
+    state.SetBytesProcessed(state.iterations() * stream.size());
+}
+
+BENCHMARK(BM_GetNextNALUnit)->Arg(64)->Arg(1400)->Arg(65536);
+BENCHMARK(BM_FindStartCode)->Arg(64)->Arg(1400)->Arg(65536);
+
+}  // namespace android
@@ -18,6 +18,8 @@
 #include <media/stagefright/foundation/ByteUtils.h>
 #include <media/stagefright/MediaErrors.h>
 
+#include <string.h>
+
 namespace android {
 
 TextDescriptions::TextDescriptions() {
@@ -505,4 +507,94 @@ status_t TextDescriptions::extract3GPPGlobalDescriptions(
     return OK;
 }
 
+TextDescriptionsCache::TextDescriptionsCache(size_t maxCues)
+    : mMaxCues(maxCues > 0 ? maxCues : 1),
+      mHasGlobal(false) {
+}
+
+TextDescriptionsCache::~TextDescriptionsCache() {
+}
+
+status_t TextDescriptionsCache::getParcelOfDescriptions(
+        const uint8_t *data, ssize_t size,
+        uint32_t flags, int timeMs, Parcel *parcel) {
+    if (size < 0) {
+        return TextDescriptions::getParcelOfDescriptions(
+                data, size, flags, timeMs, parcel);
+    }
+
+    if (flags & TextDescriptions::GLOBAL_DESCRIPTIONS) {
+        if (mHasGlobal && Matches(mGlobal, data, size, flags)) {
+            Restore(mGlobal, parcel);
+            return mGlobal.mStatus;
+        }
+        status_t err = TextDescriptions::getParcelOfDescriptions(
+                data, size, flags, timeMs, parcel);
+        Store(data, size, flags, err, *parcel, &mGlobal);
+        mHasGlobal = true;
+        return err;
+    }
+
+    // The start time is part of the parcel, so the index only needs to be
+    // checked for an exact match: O(log n) in KeyedVector.
+    ssize_t index = mCues.indexOfKey(timeMs);
+    if (index >= 0 && Matches(mCues.valueAt(index), data, size, flags)) {
+        const Cue &cue = mCues.valueAt(index);
+        Restore(cue, parcel);
+        return cue.mStatus;
+    }
+
+    status_t err = TextDescriptions::getParcelOfDescriptions(
+            data, size, flags, timeMs, parcel);
+
+    if (index < 0 && mCues.size() >= mMaxCues) {
+        // drop the cue farthest away from the playback position
+        size_t last = mCues.size() - 1;
+        if ((int64_t)timeMs - mCues.keyAt(0) > (int64_t)mCues.keyAt(last) - timeMs) {
+            mCues.removeItemsAt(0);
+        } else {
+            mCues.removeItemsAt(last);
+        }
+    }
+    Cue cue;
+    Store(data, size, flags, err, *parcel, &cue);
+    mCues.add(timeMs, cue);
+    return err;
+}
+
+void TextDescriptionsCache::clear() {
+    mHasGlobal = false;
+    mGlobal.mSample.clear();
+    mGlobal.mDescriptions.clear();
+    mCues.clear();
+}
+
+// static
+bool TextDescriptionsCache::Matches(
+        const Cue &cue, const uint8_t *data, ssize_t size, uint32_t flags) {
+    return cue.mFlags == flags
+            && cue.mSample.size() == (size_t)size
+            && (size == 0 || !memcmp(cue.mSample.data(), data, size));
+}
+
+// static
+void TextDescriptionsCache::Restore(const Cue &cue, Parcel *parcel) {
+    parcel->freeData();
+    if (!cue.mDescriptions.empty()) {
+        parcel->setData(cue.mDescriptions.data(), cue.mDescriptions.size());
+        parcel->setDataPosition(cue.mPosition);
+    }
+}
+
+// static
+void TextDescriptionsCache::Store(
+        const uint8_t *data, ssize_t size, uint32_t flags,
+        status_t status, const Parcel &parcel, Cue *cue) {
+    cue->mFlags = flags;
+    cue->mStatus = status;
+    cue->mSample.assign(data, data + size);
+    cue->mDescriptions.assign(parcel.data(), parcel.data() + parcel.dataSize());
+    cue->mPosition = parcel.dataPosition();
+}
+
 }  // namespace android
@@ -20,6 +20,10 @@
 
 #include <binder/Parcel.h>
 #include <media/stagefright/foundation/ABase.h>
+#include <utils/KeyedVector.h>
+#include <utils/RefBase.h>
+
+#include <vector>
 
 namespace android {
 
@@ -80,5 +84,54 @@ private:
     DISALLOW_EVIL_CONSTRUCTORS(TextDescriptions);
 };
 
+// Remembers the descriptions parsed for the samples of a text track, indexed
+// by their start time, so that a sample delivered again (e.g. after a seek
+// back) is not parsed again. A cue is only reused if the sample bytes and
+// flags are identical. Not thread-safe; use from a single looper.
+struct TextDescriptionsCache : public RefBase {
+    enum {
+        kDefaultMaxCues = 256,
+    };
+
+    explicit TextDescriptionsCache(size_t maxCues = kDefaultMaxCues);
+
+    // Same as TextDescriptions::getParcelOfDescriptions().
+    status_t getParcelOfDescriptions(
+            const uint8_t *data, ssize_t size,
+            uint32_t flags, int timeMs, Parcel *parcel);
+
+    void clear();
+
+protected:
+    virtual ~TextDescriptionsCache();
+
+private:
+    struct Cue {
+        uint32_t mFlags;
+        status_t mStatus;
+        std::vector<uint8_t> mSample;
+        std::vector<uint8_t> mDescriptions;
+        size_t mPosition;
+    };
+
+    const size_t mMaxCues;
+
+    // global descriptions carry no start time; a track has only one
+    bool mHasGlobal;
+    Cue mGlobal;
+
+    // local descriptions, keyed by start time in ms
+    KeyedVector<int, Cue> mCues;
+
+    static bool Matches(
+            const Cue &cue, const uint8_t *data, ssize_t size, uint32_t flags);
+    static void Restore(const Cue &cue, Parcel *parcel);
+    static void Store(
+            const uint8_t *data, ssize_t size, uint32_t flags,
+            status_t status, const Parcel &parcel, Cue *cue);
+
+    DISALLOW_EVIL_CONSTRUCTORS(TextDescriptionsCache);
+};
+
 }  // namespace android
 #endif  // TEXT_DESCRIPTIONS_H_
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ARRAYBLOCKINGQUEUE_H_
+#define ARRAYBLOCKINGQUEUE_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Mutex.h>
+#include <utils/Condition.h>
+
+#include <atomic>
+
+namespace android {
+
+// A bounded queue between exactly one producer and one consumer thread.
+// Elements are handed over through a ring without taking a lock; the lock
+// is only used to sleep when the ring is empty (consumer) or full (producer)
+// and to wake the other side up from that.
+template<typename T, size_t CAPACITY>
+class ArrayBlockingQueue {
+    T mItems[CAPACITY];
+    std::atomic<size_t> mHead;  // next to take, consumer owned
+    std::atomic<size_t> mTail;  // next to push, producer owned
+    std::atomic<bool> mConsumerWaiting;
+    std::atomic<bool> mProducerWaiting;
+    Mutex mLock;
+    Condition mCondition;
+
+    void waitForContent(size_t head) {
+        Mutex::Autolock autolock(mLock);
+        mConsumerWaiting = true;
+        while (mTail.load() == head) {
+            mCondition.wait(mLock);
+        }
+        mConsumerWaiting = false;
+    }
+
+    void waitForSpace(size_t tail) {
+        Mutex::Autolock autolock(mLock);
+        mProducerWaiting = true;
+        while (tail - mHead.load() == CAPACITY) {
+            mCondition.wait(mLock);
+        }
+        mProducerWaiting = false;
+    }
+
+    void wake() {
+        Mutex::Autolock autolock(mLock);
+        mCondition.broadcast();
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(ArrayBlockingQueue);
+
+public:
+    ArrayBlockingQueue()
+        : mHead(0),
+          mTail(0),
+          mConsumerWaiting(false),
+          mProducerWaiting(false) {
+    }
+
+    ~ArrayBlockingQueue() {
+    }
+
+    bool empty() {
+        return mTail.load() == mHead.load();
+    }
+
+    // Neither side may be using the queue.
+    void clear() {
+        for (size_t i = 0; i < CAPACITY; ++i) {
+            mItems[i] = T();
+        }
+        mHead = 0;
+        mTail = 0;
+    }
+
+    // Consumer only.
+    T peek() {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if (mTail.load(std::memory_order_acquire) == head) {
+            waitForContent(head);
+        }
+        return mItems[head % CAPACITY];
+    }
+
+    // Consumer only.
+    T take() {
+        T e = peek();
+        size_t head = mHead.load(std::memory_order_relaxed);
+        mItems[head % CAPACITY] = T();
+        mHead.store(head + 1);
+        if (mProducerWaiting.load()) {
+            wake();
+        }
+        return e;
+    }
+
+    // Producer only, waits while the queue is full.
+    void push(const T &e) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == CAPACITY) {
+            waitForSpace(tail);
+        }
+        mItems[tail % CAPACITY] = e;
+        mTail.store(tail + 1);
+        if (mConsumerWaiting.load()) {
+            wake();
+        }
+    }
+};
+
+} /* namespace android */
+#endif /* ARRAYBLOCKINGQUEUE_H_ */
@@ -36,6 +36,35 @@ sp<ABuffer> toABuffer(MediaBufferBase *mbuf) {
 
 namespace android {
 
+WebmFrameBufferPool::WebmFrameBufferPool()
+    : mNext(0) {
+}
+
+sp<ABuffer> WebmFrameBufferPool::acquire(size_t size) {
+    // Frames are written out in the order they are queued, so the oldest
+    // buffer is the first to come back.
+    for (size_t i = 0; i < mBuffers.size(); ++i) {
+        size_t index = (mNext + i) % mBuffers.size();
+        sp<ABuffer> &buffer = mBuffers.editItemAt(index);
+        if (buffer->getStrongCount() != 1) {
+            continue;
+        }
+        if (buffer->capacity() < size) {
+            // Leave some room for the frames to come.
+            buffer = new ABuffer(size + size / 4);
+        }
+        buffer->setRange(0, size);
+        mNext = (index + 1) % mBuffers.size();
+        return buffer;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(size);
+    if (mBuffers.size() < kMaxBuffers) {
+        mBuffers.push_back(buffer);
+    }
+    return buffer;
+}
+
 const sp<WebmFrame> WebmFrame::EOS = new WebmFrame();
 
 WebmFrame::WebmFrame()
@@ -54,6 +83,14 @@ WebmFrame::WebmFrame(int type, bool key, uint64_t absTimecode, MediaBufferBase *
       mEos(false) {
 }
 
+WebmFrame::WebmFrame(int type, bool key, uint64_t absTimecode, const sp<ABuffer> &data)
+    : mType(type),
+      mKey(key),
+      mAbsTimecode(absTimecode),
+      mData(data),
+      mEos(false) {
+}
+
 sp<WebmElement> WebmFrame::SimpleBlock(uint64_t baseTimecode) const {
     return new WebmSimpleBlock(
             mType == kVideoType ? kVideoTrackNum : kAudioTrackNum,
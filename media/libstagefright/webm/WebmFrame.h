@@ -19,8 +19,29 @@
 
 #include "WebmElement.h"
 
+#include <utils/Vector.h>
+
 namespace android {
 
+// Recycles the frame data buffers of a single source, a buffer is free again
+// once the frame and the block it was written in are gone. Only to be used
+// from the source's thread.
+struct WebmFrameBufferPool {
+    WebmFrameBufferPool();
+
+    sp<ABuffer> acquire(size_t size);
+
+private:
+    enum {
+        kMaxBuffers = 64,
+    };
+
+    Vector<sp<ABuffer> > mBuffers;
+    size_t mNext;
+
+    DISALLOW_EVIL_CONSTRUCTORS(WebmFrameBufferPool);
+};
+
 struct WebmFrame : LightRefBase<WebmFrame> {
 public:
     const int mType;
@@ -31,6 +52,7 @@ public:
 
     WebmFrame();
     WebmFrame(int type, bool key, uint64_t absTimecode, MediaBufferBase *buf);
+    WebmFrame(int type, bool key, uint64_t absTimecode, const sp<ABuffer> &data);
     ~WebmFrame() {}
 
     sp<WebmElement> SimpleBlock(uint64_t baseTimecode) const;
@@ -24,7 +24,10 @@
 #include <media/stagefright/foundation/ADebug.h>
 
 #include <utils/Log.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
 
 using namespace webm;
 
@@ -61,7 +64,7 @@ status_t WebmFrameThread::stop() {
 
 WebmFrameSourceThread::WebmFrameSourceThread(
     int type,
-    LinkedBlockingQueue<const sp<WebmFrame> >& sink)
+    WebmFrameQueue& sink)
     : mType(type), mSink(sink) {
 }
 
@@ -78,21 +81,25 @@ WebmFrameSinkThread::WebmFrameSinkThread(
       mVideoFrames(videoThread->mSink),
       mAudioFrames(audioThread->mSink),
       mCues(cues),
-      mDone(true) {
+      mDone(true),
+      mClusterBuffer(NULL),
+      mClusterBufferSize(0) {
 }
 
 WebmFrameSinkThread::WebmFrameSinkThread(
         const int& fd,
         const uint64_t& off,
-        LinkedBlockingQueue<const sp<WebmFrame> >& videoSource,
-        LinkedBlockingQueue<const sp<WebmFrame> >& audioSource,
+        WebmFrameQueue& videoSource,
+        WebmFrameQueue& audioSource,
         List<sp<WebmElement> >& cues)
     : mFd(fd),
       mSegmentDataStart(off),
       mVideoFrames(videoSource),
       mAudioFrames(audioSource),
       mCues(cues),
-      mDone(true) {
+      mDone(true),
+      mClusterBuffer(NULL),
+      mClusterBufferSize(0) {
 }
 
 // Initializes a webm cluster with its starting timecode.
@@ -122,14 +129,40 @@ void WebmFrameSinkThread::initCluster(
     children.push_back(clusterTimecode);
 }
 
+WebmFrameSinkThread::~WebmFrameSinkThread() {
+    WebmFrameThread::stop();
+    delete[] mClusterBuffer;
+    mClusterBuffer = NULL;
+}
+
 void WebmFrameSinkThread::writeCluster(List<sp<WebmElement> >& children) {
     // children must contain at least one simpleblock and its timecode
     CHECK_GE(children.size(), 2u);
 
-    uint64_t size;
     sp<WebmElement> cluster = new WebmMaster(kMkvCluster, children);
-    cluster->write(mFd, size);
+    uint64_t size = cluster->totalSize();
+    if (size > mClusterBufferSize) {
+        delete[] mClusterBuffer;
+        // Leave some room for the clusters to come.
+        mClusterBufferSize = size + size / 4;
+        mClusterBuffer = new uint8_t[mClusterBufferSize];
+    }
+    cluster->serializeInto(mClusterBuffer);
     children.clear();
+
+    const uint8_t *data = mClusterBuffer;
+    while (size > 0) {
+        ssize_t n = ::write(mFd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ALOGE("failed to write cluster; errno = %d", errno);
+            break;
+        }
+        data += n;
+        size -= n;
+    }
 }
 
 // Write out (possibly multiple) webm cluster(s) from frames split on video key frames.
@@ -254,7 +287,7 @@ void WebmFrameMediaSourceThread::clearFlags() {
 WebmFrameMediaSourceThread::WebmFrameMediaSourceThread(
         const sp<MediaSource>& source,
         int type,
-        LinkedBlockingQueue<const sp<WebmFrame> >& sink,
+        WebmFrameQueue& sink,
         uint64_t timeCodeScale,
         int64_t startTimeRealUs,
         int32_t startTimeOffsetMs,
@@ -375,11 +408,15 @@ void WebmFrameMediaSourceThread::run() {
 
         int32_t isSync = false;
         md.findInt32(kKeyIsSyncFrame, &isSync);
+        sp<ABuffer> data = mBufferPool.acquire(buffer->range_length());
+        memcpy(data->data(),
+                (const uint8_t *)buffer->data() + buffer->range_offset(),
+                buffer->range_length());
         const sp<WebmFrame> f = new WebmFrame(
             mType,
             isSync,
             timestampUs * 1000 / mTimeCodeScale,
-            buffer);
+            data);
         mSink.push(f);
 
         ALOGV(
@@ -18,7 +18,7 @@
 #define WEBMFRAMETHREAD_H_
 
 #include "WebmFrame.h"
-#include "LinkedBlockingQueue.h"
+#include "ArrayBlockingQueue.h"
 
 #include <media/MediaSource.h>
 #include <media/stagefright/FileSource.h>
@@ -30,6 +30,10 @@
 
 namespace android {
 
+// About 15 seconds of 30fps video, the sink waits for a frame of each type
+// before it writes either.
+typedef ArrayBlockingQueue<sp<WebmFrame>, 512> WebmFrameQueue;
+
 class WebmFrameThread : public LightRefBase<WebmFrameThread> {
 public:
     virtual void run() = 0;
@@ -66,8 +70,8 @@ public:
     WebmFrameSinkThread(
             const int& fd,
             const uint64_t& off,
-            LinkedBlockingQueue<const sp<WebmFrame> >& videoSource,
-            LinkedBlockingQueue<const sp<WebmFrame> >& audioSource,
+            WebmFrameQueue& videoSource,
+            WebmFrameQueue& audioSource,
             List<sp<WebmElement> >& cues);
 
     void run();
@@ -76,16 +80,21 @@ public:
     }
     status_t start();
     status_t stop();
+    ~WebmFrameSinkThread();
 
 private:
     const int& mFd;
     const uint64_t& mSegmentDataStart;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mVideoFrames;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mAudioFrames;
+    WebmFrameQueue& mVideoFrames;
+    WebmFrameQueue& mAudioFrames;
     List<sp<WebmElement> >& mCues;
 
     volatile bool mDone;
 
+    // Clusters are serialized here before being written out.
+    uint8_t *mClusterBuffer;
+    size_t mClusterBufferSize;
+
     static void initCluster(
             List<const sp<WebmFrame> >& frames,
             uint64_t& clusterTimecodeL,
@@ -98,11 +107,11 @@ private:
 
 class WebmFrameSourceThread : public WebmFrameThread {
 public:
-    WebmFrameSourceThread(int type, LinkedBlockingQueue<const sp<WebmFrame> >& sink);
+    WebmFrameSourceThread(int type, WebmFrameQueue& sink);
     virtual int64_t getDurationUs() = 0;
 protected:
     const int mType;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mSink;
+    WebmFrameQueue& mSink;
 
     friend class WebmFrameSinkThread;
 };
@@ -111,7 +120,7 @@ protected:
 
 class WebmFrameEmptySourceThread : public WebmFrameSourceThread {
 public:
-    WebmFrameEmptySourceThread(int type, LinkedBlockingQueue<const sp<WebmFrame> >& sink)
+    WebmFrameEmptySourceThread(int type, WebmFrameQueue& sink)
         : WebmFrameSourceThread(type, sink) {
     }
     void run() { mSink.push(WebmFrame::EOS); }
@@ -125,7 +134,7 @@ public:
     WebmFrameMediaSourceThread(
             const sp<MediaSource>& source,
             int type,
-            LinkedBlockingQueue<const sp<WebmFrame> >& sink,
+            WebmFrameQueue& sink,
             uint64_t timeCodeScale,
             int64_t startTimeRealUs,
             int32_t startTimeOffsetMs,
@@ -152,6 +161,7 @@ private:
     volatile bool mStarted;
     volatile bool mReachedEOS;
     int64_t mTrackDurationUs;
+    WebmFrameBufferPool mBufferPool;
 
     void clearFlags();
 };
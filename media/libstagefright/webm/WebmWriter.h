@@ -19,7 +19,6 @@
 
 #include "WebmConstants.h"
 #include "WebmFrameThread.h"
-#include "LinkedBlockingQueue.h"
 
 #include <media/MediaSource.h>
 #include <media/stagefright/MediaWriter.h>
@@ -88,7 +87,7 @@ private:
         sp<MediaSource> mSource;
         sp<WebmElement> mTrackEntry;
         sp<WebmFrameSourceThread> mThread;
-        LinkedBlockingQueue<const sp<WebmFrame> > mSink;
+        WebmFrameQueue mSink;
 
         WebmStream()
             : mType(kInvalidType),
@@ -566,16 +566,27 @@ int MtpFfsHandle::sendFile(mtp_file_range mfr) {
 
     advise(mfr.fd);
 
-    struct aiocb aio;
-    aio.aio_fildes = mfr.fd;
-    struct aiocb *aiol[] = {&aio};
+    // Disk reads run up to NUM_IO_BUFS - 1 chunks ahead of the usb write in flight,
+    // so a slow read doesn't stall the usb link.
+    struct aiocb aio[NUM_IO_BUFS];
     int ret = 0;
     int length, num_read;
-    unsigned i = 0;
+    unsigned read_i = 0;        // Buffer of the oldest outstanding disk read
+    unsigned num_reads = 0;     // Number of outstanding disk reads
+    unsigned write_i = 0;       // Buffer of the outstanding usb write
+    uint64_t read_length, read_offset;
     struct io_event ioevs[AIO_BUFS_MAX];
     bool error = false;
     bool has_write = false;
 
+    // All submitted reads must be waited on before returning.
+    auto waitReads = [&](unsigned count) {
+        for (unsigned j = 0; j < count; j++) {
+            struct aiocb *aiol[] = {&aio[(read_i + j) % NUM_IO_BUFS]};
+            aio_suspend(aiol, 1, nullptr);
+        }
+    };
+
     // Send the header data
     mtp_data_header *header = reinterpret_cast<mtp_data_header*>(mIobuf[0].bufs.data());
     header->length = htole32(given_length);
@@ -594,55 +605,68 @@ int MtpFfsHandle::sendFile(mtp_file_range mfr) {
     file_length -= init_read_len;
     offset += init_read_len;
     ret = init_read_len + sizeof(mtp_data_header);
+    read_length = file_length;
+    read_offset = offset;
 
     // Break down the file into pieces that fit in buffers
     while(file_length > 0 || has_write) {
-        if (file_length > 0) {
-            // Queue up a read from disk.
-            length = std::min(static_cast<uint64_t>(MAX_FILE_CHUNK_SIZE), file_length);
-            aio_prepare(&aio, mIobuf[i].bufs.data(), length, offset);
-            aio_read(&aio);
+        // Queue up reads from disk, skipping the buffer being written to usb.
+        while (read_length > 0 && num_reads < NUM_IO_BUFS - 1) {
+            unsigned j = (read_i + num_reads) % NUM_IO_BUFS;
+            length = std::min(static_cast<uint64_t>(MAX_FILE_CHUNK_SIZE), read_length);
+            aio[j].aio_fildes = mfr.fd;
+            aio_prepare(&aio[j], mIobuf[j].bufs.data(), length, read_offset);
+            aio_read(&aio[j]);
+            read_length -= length;
+            read_offset += length;
+            num_reads++;
         }
 
         if (has_write) {
             // Wait for usb write. Cancel unwritten portion if there's an error.
             int num_events = 0;
-            if (waitEvents(&mIobuf[(i-1)%NUM_IO_BUFS], mIobuf[(i-1)%NUM_IO_BUFS].actual, ioevs,
+            if (waitEvents(&mIobuf[write_i], mIobuf[write_i].actual, ioevs,
                         &num_events) != ret) {
                 error = true;
-                cancelEvents(mIobuf[(i-1)%NUM_IO_BUFS].iocb.data(), ioevs, num_events,
-                        mIobuf[(i-1)%NUM_IO_BUFS].actual);
+                cancelEvents(mIobuf[write_i].iocb.data(), ioevs, num_events,
+                        mIobuf[write_i].actual);
             }
             has_write = false;
         }
 
         if (file_length > 0) {
-            // Wait for the previous read to finish
-            aio_suspend(aiol, 1, nullptr);
-            num_read = aio_return(&aio);
-            if (static_cast<size_t>(num_read) < aio.aio_nbytes) {
-                errno = num_read == -1 ? aio_error(&aio) : EIO;
+            // Wait for the oldest read to finish
+            waitReads(1);
+            num_read = aio_return(&aio[read_i]);
+            if (static_cast<size_t>(num_read) < aio[read_i].aio_nbytes) {
+                errno = num_read == -1 ? aio_error(&aio[read_i]) : EIO;
                 PLOG(ERROR) << "Mtp error reading from disk";
+                read_i = (read_i + 1) % NUM_IO_BUFS;
+                waitReads(num_reads - 1);
                 cancelTransaction();
                 return -1;
             }
 
             file_length -= num_read;
-            offset += num_read;
 
             if (error) {
+                read_i = (read_i + 1) % NUM_IO_BUFS;
+                waitReads(num_reads - 1);
                 return -1;
             }
 
             // Queue up a write to usb.
-            if (iobufSubmit(&mIobuf[i], mBulkIn, num_read, false) == -1) {
+            if (iobufSubmit(&mIobuf[read_i], mBulkIn, num_read, false) == -1) {
+                read_i = (read_i + 1) % NUM_IO_BUFS;
+                waitReads(num_reads - 1);
                 return -1;
             }
+            write_i = read_i;
+            read_i = (read_i + 1) % NUM_IO_BUFS;
+            num_reads--;
             has_write = true;
             ret = num_read;
         }
-
-        i = (i + 1) % NUM_IO_BUFS;
     }
 
     if (ret % packet_size == 0) {
@@ -29,7 +29,9 @@
 
 namespace android {
 
-constexpr int NUM_IO_BUFS = 2;
+// Buffers for file transfers. Sending a file keeps one buffer on the usb endpoint
+// while the rest are read ahead from disk.
+constexpr unsigned NUM_IO_BUFS = 3;
 
 struct io_buffer {
     std::vector<struct iocb> iocbs;     // Holds memory for all iocbs. Not used directly.
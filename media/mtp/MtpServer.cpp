@@ -101,6 +101,10 @@ static const MtpEventCode kSupportedEventCodes[] = {
     MTP_EVENT_DEVICE_PROP_CHANGED,
 };
 
+// Bounds on the object cache; it is emptied when full
+static const size_t kMaxCachedObjectInfos = 65536;
+static const size_t kMaxCachedObjectLists = 256;
+
 MtpServer::MtpServer(IMtpDatabase* database, int controlFd, bool ptp,
                     const char *deviceInfoManufacturer,
                     const char *deviceInfoModel,
@@ -117,7 +121,9 @@ MtpServer::MtpServer(IMtpDatabase* database, int controlFd, bool ptp,
         mSendObjectHandle(kInvalidObjectHandle),
         mSendObjectFormat(0),
         mSendObjectFileSize(0),
-        mSendObjectModifiedTime(0)
+        mSendObjectModifiedTime(0),
+        mPrefetchNext(0),
+        mCacheGeneration(0)
 {
     bool ffs_ok = access(FFS_MTP_EP0, W_OK) == 0;
     if (ffs_ok) {
@@ -135,6 +141,7 @@ void MtpServer::addStorage(MtpStorage* storage) {
     std::lock_guard<std::mutex> lg(mMutex);
 
     mStorages.push_back(storage);
+    invalidateObjectCache();
     sendStoreAdded(storage->getStorageID());
 }
 
@@ -144,6 +151,7 @@ void MtpServer::removeStorage(MtpStorage* storage) {
     if (iter != mStorages.end()) {
         sendStoreRemoved(storage->getStorageID());
         mStorages.erase(iter);
+        invalidateObjectCache();
     }
 }
 
@@ -251,11 +259,13 @@ void MtpServer::run() {
 
 void MtpServer::sendObjectAdded(MtpObjectHandle handle) {
     ALOGV("sendObjectAdded %d\n", handle);
+    invalidateObjectCache(handle);
     sendEvent(MTP_EVENT_OBJECT_ADDED, handle);
 }
 
 void MtpServer::sendObjectRemoved(MtpObjectHandle handle) {
     ALOGV("sendObjectRemoved %d\n", handle);
+    invalidateObjectCache(handle);
     sendEvent(MTP_EVENT_OBJECT_REMOVED, handle);
 }
 
@@ -312,6 +322,16 @@ void MtpServer::removeEditObject(MtpObjectHandle handle) {
     ALOGE("ObjectEdit not found in removeEditObject");
 }
 
+void MtpServer::invalidateObjectCache(MtpObjectHandle handle) {
+    std::lock_guard<std::mutex> lg(mCacheMutex);
+    mCacheGeneration++;
+    mObjectListCache.clear();
+    if (handle == kInvalidObjectHandle)
+        mObjectInfoCache.clear();
+    else
+        mObjectInfoCache.erase(handle);
+}
+
 void MtpServer::commitEdit(ObjectEdit* edit) {
     mDatabase->rescanFile((const char *)edit->mPath, edit->mHandle, edit->mFormat);
 }
@@ -339,6 +359,31 @@ bool MtpServer::handleRequest() {
 
     ALOGV("got command %s (%x)", MtpDebug::getOperationCodeName(operation), operation);
 
+    switch (operation) {
+        case MTP_OPERATION_GET_DEVICE_INFO:
+        case MTP_OPERATION_GET_STORAGE_IDS:
+        case MTP_OPERATION_GET_STORAGE_INFO:
+        case MTP_OPERATION_GET_NUM_OBJECTS:
+        case MTP_OPERATION_GET_OBJECT_HANDLES:
+        case MTP_OPERATION_GET_OBJECT_INFO:
+        case MTP_OPERATION_GET_OBJECT:
+        case MTP_OPERATION_GET_THUMB:
+        case MTP_OPERATION_GET_PARTIAL_OBJECT:
+        case MTP_OPERATION_GET_PARTIAL_OBJECT_64:
+        case MTP_OPERATION_GET_OBJECT_PROPS_SUPPORTED:
+        case MTP_OPERATION_GET_OBJECT_PROP_DESC:
+        case MTP_OPERATION_GET_OBJECT_PROP_VALUE:
+        case MTP_OPERATION_GET_OBJECT_PROP_LIST:
+        case MTP_OPERATION_GET_OBJECT_REFERENCES:
+        case MTP_OPERATION_GET_DEVICE_PROP_DESC:
+        case MTP_OPERATION_GET_DEVICE_PROP_VALUE:
+            break;
+        default:
+            // Anything else may create, modify or remove objects
+            invalidateObjectCache();
+            break;
+    }
+
     switch (operation) {
         case MTP_OPERATION_GET_DEVICE_INFO:
             response = doGetDeviceInfo();
@@ -512,6 +557,8 @@ MtpResponseCode MtpServer::doCloseSession() {
         return MTP_RESPONSE_SESSION_NOT_OPEN;
     mSessionID = 0;
     mSessionOpen = false;
+    mPrefetchHandles.clear();
+    mPrefetchNext = 0;
     return MTP_RESPONSE_OK;
 }
 
@@ -578,10 +625,29 @@ MtpResponseCode MtpServer::doGetObjectHandles() {
     if (!hasStorage(storageID))
         return MTP_RESPONSE_INVALID_STORAGE_ID;
 
+    auto key = std::make_tuple(storageID, format, parent);
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lg(mCacheMutex);
+        auto iter = mObjectListCache.find(key);
+        if (iter != mObjectListCache.end()) {
+            mData.putAUInt32(&iter->second);
+            return MTP_RESPONSE_OK;
+        }
+        generation = mCacheGeneration;
+    }
+
     MtpObjectHandleList* handles = mDatabase->getObjectList(storageID, format, parent);
     if (handles == NULL)
         return MTP_RESPONSE_INVALID_OBJECT_HANDLE;
     mData.putAUInt32(handles);
+
+    std::lock_guard<std::mutex> lg(mCacheMutex);
+    if (generation == mCacheGeneration) {
+        if (mObjectListCache.size() >= kMaxCachedObjectLists)
+            mObjectListCache.clear();
+        mObjectListCache[key].swap(*handles);
+    }
     delete handles;
     return MTP_RESPONSE_OK;
 }
@@ -717,7 +783,19 @@ MtpResponseCode MtpServer::doGetObjectPropList() {
             handle, MtpDebug::getFormatCodeName(format),
             MtpDebug::getObjectPropCodeName(property), groupCode, depth);
 
-    return mDatabase->getObjectPropertyList(handle, format, property, groupCode, depth, mData);
+    MtpResponseCode result = mDatabase->getObjectPropertyList(handle, format, property,
+            groupCode, depth, mData);
+    if (result == MTP_RESPONSE_OK && depth == 1 && handle != 0 && handle != 0xFFFFFFFF) {
+        // The host is listing a folder, likely before copying its contents.
+        MtpObjectHandleList* handles = mDatabase->getObjectList(0xFFFFFFFF, 0, handle);
+        mPrefetchHandles.clear();
+        mPrefetchNext = 0;
+        if (handles != NULL) {
+            mPrefetchHandles.swap(*handles);
+            delete handles;
+        }
+    }
+    return result;
 }
 
 MtpResponseCode MtpServer::doGetObjectInfo() {
@@ -726,41 +804,62 @@ MtpResponseCode MtpServer::doGetObjectInfo() {
     if (mRequest.getParameterCount() < 1)
         return MTP_RESPONSE_INVALID_PARAMETER;
     MtpObjectHandle handle = mRequest.getParameter(1);
-    MtpObjectInfo info(handle);
-    MtpResponseCode result = mDatabase->getObjectInfo(handle, info);
-    if (result == MTP_RESPONSE_OK) {
-        char    date[20];
-
-        mData.putUInt32(info.mStorageID);
-        mData.putUInt16(info.mFormat);
-        mData.putUInt16(info.mProtectionStatus);
-
-        // if object is being edited the database size may be out of date
-        uint32_t size = info.mCompressedSize;
-        ObjectEdit* edit = getEditObject(handle);
-        if (edit)
-            size = (edit->mSize > 0xFFFFFFFFLL ? 0xFFFFFFFF : (uint32_t)edit->mSize);
-        mData.putUInt32(size);
-
-        mData.putUInt16(info.mThumbFormat);
-        mData.putUInt32(info.mThumbCompressedSize);
-        mData.putUInt32(info.mThumbPixWidth);
-        mData.putUInt32(info.mThumbPixHeight);
-        mData.putUInt32(info.mImagePixWidth);
-        mData.putUInt32(info.mImagePixHeight);
-        mData.putUInt32(info.mImagePixDepth);
-        mData.putUInt32(info.mParent);
-        mData.putUInt16(info.mAssociationType);
-        mData.putUInt32(info.mAssociationDesc);
-        mData.putUInt32(info.mSequenceNumber);
-        mData.putString(info.mName);
-        formatDateTime(info.mDateCreated, date, sizeof(date));
-        mData.putString(date);   // date created
-        formatDateTime(info.mDateModified, date, sizeof(date));
-        mData.putString(date);   // date modified
-        mData.putEmptyString();   // keywords
+
+    std::unique_ptr<MtpObjectInfo> newInfo;
+    const MtpObjectInfo* infoPtr;
+    std::unique_lock<std::mutex> lock(mCacheMutex);
+    auto iter = mObjectInfoCache.find(handle);
+    if (iter != mObjectInfoCache.end()) {
+        infoPtr = iter->second.get();
+    } else {
+        uint32_t generation = mCacheGeneration;
+        lock.unlock();
+        newInfo.reset(new MtpObjectInfo(handle));
+        MtpResponseCode result = mDatabase->getObjectInfo(handle, *newInfo);
+        if (result != MTP_RESPONSE_OK)
+            return result;
+        infoPtr = newInfo.get();
+        lock.lock();
+        // Don't cache the result if objects changed while it was fetched
+        if (generation == mCacheGeneration) {
+            if (mObjectInfoCache.size() >= kMaxCachedObjectInfos)
+                mObjectInfoCache.clear();
+            mObjectInfoCache[handle] = std::move(newInfo);
+        }
     }
-    return result;
+    const MtpObjectInfo& info = *infoPtr;
+
+    char    date[20];
+
+    mData.putUInt32(info.mStorageID);
+    mData.putUInt16(info.mFormat);
+    mData.putUInt16(info.mProtectionStatus);
+
+    // if object is being edited the database size may be out of date
+    uint32_t size = info.mCompressedSize;
+    ObjectEdit* edit = getEditObject(handle);
+    if (edit)
+        size = (edit->mSize > 0xFFFFFFFFLL ? 0xFFFFFFFF : (uint32_t)edit->mSize);
+    mData.putUInt32(size);
+
+    mData.putUInt16(info.mThumbFormat);
+    mData.putUInt32(info.mThumbCompressedSize);
+    mData.putUInt32(info.mThumbPixWidth);
+    mData.putUInt32(info.mThumbPixHeight);
+    mData.putUInt32(info.mImagePixWidth);
+    mData.putUInt32(info.mImagePixHeight);
+    mData.putUInt32(info.mImagePixDepth);
+    mData.putUInt32(info.mParent);
+    mData.putUInt16(info.mAssociationType);
+    mData.putUInt32(info.mAssociationDesc);
+    mData.putUInt32(info.mSequenceNumber);
+    mData.putString(info.mName);
+    formatDateTime(info.mDateCreated, date, sizeof(date));
+    mData.putString(date);   // date created
+    formatDateTime(info.mDateModified, date, sizeof(date));
+    mData.putString(date);   // date modified
+    mData.putEmptyString();   // keywords
+    return MTP_RESPONSE_OK;
 }
 
 MtpResponseCode MtpServer::doGetObject() {
@@ -789,6 +888,8 @@ MtpResponseCode MtpServer::doGetObject() {
     mfr.command = mRequest.getOperationCode();
     mfr.transaction_id = mRequest.getTransactionID();
 
+    prefetchObjects(handle);
+
     // then transfer the file
     int ret = mHandle->sendFile(mfr);
     if (ret < 0) {
@@ -813,6 +914,35 @@ MtpResponseCode MtpServer::doGetObject() {
     return result;
 }
 
+void MtpServer::prefetchObjects(MtpObjectHandle handle) {
+    static constexpr size_t kPrefetchObjects = 4;
+    static constexpr off_t kPrefetchBytes = 1 << 20;
+
+    auto it = std::find(mPrefetchHandles.begin(), mPrefetchHandles.end(), handle);
+    if (it == mPrefetchHandles.end())
+        return;
+    size_t index = it - mPrefetchHandles.begin();
+    size_t end = std::min(index + 1 + kPrefetchObjects, mPrefetchHandles.size());
+    mPrefetchNext = std::max(mPrefetchNext, index + 1);
+
+    // Ask the kernel to start reading the beginning of the next few files, so it
+    // overlaps with sending this one. Large files are read ahead by sendFile itself.
+    for (; mPrefetchNext < end; mPrefetchNext++) {
+        MtpStringBuffer pathBuf;
+        int64_t fileLength;
+        MtpObjectFormat format;
+        if (mDatabase->getObjectFilePath(mPrefetchHandles[mPrefetchNext], pathBuf, fileLength,
+                    format) != MTP_RESPONSE_OK || format == MTP_FORMAT_ASSOCIATION)
+            continue;
+        int fd = open((const char *)pathBuf, O_RDONLY);
+        if (fd < 0)
+            continue;
+        posix_fadvise(fd, 0, std::min(static_cast<off_t>(fileLength), kPrefetchBytes),
+                POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+}
+
 MtpResponseCode MtpServer::doGetThumb() {
     if (mRequest.getParameterCount() < 1)
         return MTP_RESPONSE_INVALID_PARAMETER;
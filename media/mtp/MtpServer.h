@@ -26,13 +26,17 @@
 #include "MtpUtils.h"
 #include "IMtpHandle.h"
 
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <tuple>
+#include <unordered_map>
 
 namespace android {
 
 class IMtpDatabase;
+class MtpObjectInfo;
 class MtpStorage;
 
 class MtpServer {
@@ -76,6 +80,26 @@ private:
 
     std::mutex          mMutex;
 
+    // Children of the folder listed by the last GetObjectPropList, in the order
+    // hosts usually fetch them. GetObject reads ahead the objects following the
+    // one being sent so that copying a directory of small files doesn't wait on
+    // the disk for each object.
+    MtpObjectHandleList mPrefetchHandles;
+    // Index in mPrefetchHandles of the next object to read ahead
+    size_t              mPrefetchNext;
+
+    // Object info and handle lists returned by the database, so that a host
+    // enumerating a large library doesn't cost a database call per request.
+    // Entries are dropped when objects are added or removed, and before any
+    // operation that may modify objects.
+    std::mutex          mCacheMutex;
+    // Incremented on every invalidation, so that results fetched from the
+    // database while an invalidation happened are not cached
+    uint32_t            mCacheGeneration;
+    std::unordered_map<MtpObjectHandle, std::unique_ptr<MtpObjectInfo>> mObjectInfoCache;
+    std::map<std::tuple<MtpStorageID, MtpObjectFormat, MtpObjectHandle>, MtpObjectHandleList>
+                        mObjectListCache;
+
     // represents an MTP object that is being edited using the android extensions
     // for direct editing (BeginEditObject, SendPartialObject, TruncateObject and EndEditObject)
     class ObjectEdit {
@@ -130,6 +154,11 @@ private:
 
     bool                handleRequest();
 
+    void                prefetchObjects(MtpObjectHandle handle);
+
+    // Drop cached lists, and the info for the given object or for all objects
+    void                invalidateObjectCache(MtpObjectHandle handle = kInvalidObjectHandle);
+
     MtpResponseCode     doGetDeviceInfo();
     MtpResponseCode     doOpenSession();
     MtpResponseCode     doCloseSession();
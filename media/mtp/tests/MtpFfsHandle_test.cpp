@@ -15,6 +15,7 @@
  */
 #define LOG_TAG "MtpFfsHandle_test.cpp"
 
+#include <algorithm>
 #include <android-base/unique_fd.h>
 #include <android-base/test_utils.h>
 #include <fcntl.h>
@@ -22,7 +23,9 @@
 #include <memory>
 #include <random>
 #include <string>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 #include <log/log.h>
 
 #include "MtpDescriptors.h"
@@ -34,6 +37,7 @@ namespace android {
 constexpr int TEST_PACKET_SIZE = 500;
 constexpr int SMALL_MULT = 30;
 constexpr int MED_MULT = 510;
+constexpr int LARGE_MULT = 15000;
 
 static const std::string dummyDataStr =
     "/*\n * Copyright 2015 The Android Open Source Project\n *\n * Licensed un"
@@ -309,6 +313,46 @@ TYPED_TEST(MtpFfsHandleTest, testSendFileMed) {
     EXPECT_EQ(header->transaction_id, static_cast<unsigned int>(1337));
 }
 
+TYPED_TEST(MtpFfsHandleTest, testSendFileLarge) {
+    mtp_file_range mfr;
+    mfr.command = 42;
+    mfr.transaction_id = 1337;
+    mfr.offset = 0;
+    // Large enough to cycle through every io buffer more than once
+    int size = TEST_PACKET_SIZE * LARGE_MULT;
+    std::vector<char> data(size);
+    std::vector<char> buf(size + sizeof(mtp_data_header));
+
+    mfr.length = size;
+    mfr.fd = this->dummy_file.fd;
+    std::mt19937 gen(42);
+    for (int i = 0; i < size; i++)
+        data[i] = static_cast<char>(gen());
+
+    EXPECT_EQ(write(this->dummy_file.fd, data.data(), size), size);
+
+    // The file is larger than the pipe, so drain it while sending.
+    std::thread reader([&]() {
+        size_t total = 0;
+        while (total < buf.size()) {
+            ssize_t ret = read(this->bulk_in, buf.data() + total, buf.size() - total);
+            if (ret <= 0)
+                break;
+            total += ret;
+        }
+        EXPECT_EQ(total, buf.size());
+    });
+    EXPECT_EQ(this->handle->sendFile(mfr), 0);
+    reader.join();
+
+    struct mtp_data_header *header = reinterpret_cast<struct mtp_data_header*>(buf.data());
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), buf.begin() + sizeof(mtp_data_header)));
+    EXPECT_EQ(header->length, static_cast<unsigned int>(size + sizeof(mtp_data_header)));
+    EXPECT_EQ(header->type, static_cast<unsigned int>(2));
+    EXPECT_EQ(header->command, static_cast<unsigned int>(42));
+    EXPECT_EQ(header->transaction_id, static_cast<unsigned int>(1337));
+}
+
 TYPED_TEST(MtpFfsHandleTest, testSendFileMedPartial) {
     std::stringstream ss;
     mtp_file_range mfr;
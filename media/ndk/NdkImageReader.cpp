@@ -585,6 +585,25 @@ AImageReader::acquireLatestImage(/*out*/AImage** image, /*out*/int* acquireFence
     }
 }
 
+media_status_t
+AImageReader::acquireNextImages(/*out*/AImage** images, /*out*/int* acquireFenceFds,
+        int32_t maxImages, /*out*/int32_t* numImages) {
+    Mutex::Autolock _l(mLock);
+    *numImages = 0;
+    media_status_t ret = AMEDIA_OK;
+    for (int32_t i = 0; i < maxImages; i++) {
+        images[i] = nullptr;
+        ret = acquireImageLocked(&images[i],
+                (acquireFenceFds != nullptr) ? &acquireFenceFds[i] : nullptr);
+        if (images[i] == nullptr) {
+            break;
+        }
+        (*numImages)++;
+    }
+    // Running out of queued buffers or image slots only ends the batch early
+    return (*numImages > 0) ? AMEDIA_OK : ret;
+}
+
 EXPORT
 media_status_t AImageReader_new(
         int32_t width, int32_t height, int32_t format, int32_t maxImages,
@@ -751,6 +770,19 @@ media_status_t AImageReader_acquireLatestImageAsync(
     return reader->acquireLatestImage(image, acquireFenceFd);
 }
 
+EXPORT
+media_status_t AImageReader_acquireNextImages(
+    AImageReader* reader, /*out*/AImage** images, /*out*/int* acquireFenceFds,
+    int32_t maxImages, /*out*/int32_t* numImages) {
+    ALOGV("%s", __FUNCTION__);
+    if (reader == nullptr || images == nullptr || numImages == nullptr || maxImages <= 0) {
+        ALOGE("%s: invalid argument. reader %p, images %p, maxImages %d, numImages %p",
+                __FUNCTION__, reader, images, maxImages, numImages);
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    return reader->acquireNextImages(images, acquireFenceFds, maxImages, numImages);
+}
+
 EXPORT
 media_status_t AImageReader_setImageListener(
         AImageReader* reader, AImageReader_ImageListener* listener) {
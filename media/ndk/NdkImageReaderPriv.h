@@ -68,6 +68,9 @@ struct AImageReader : public RefBase {
 
     media_status_t acquireNextImage(/*out*/AImage** image, /*out*/int* fenceFd);
     media_status_t acquireLatestImage(/*out*/AImage** image, /*out*/int* fenceFd);
+    // Acquire up to maxImages queued images in order while holding the reader lock once
+    media_status_t acquireNextImages(/*out*/AImage** images, /*out*/int* fenceFds,
+            int32_t maxImages, /*out*/int32_t* numImages);
 
     ANativeWindow* getWindow()    const { return mWindow.get(); };
     int32_t        getWidth()     const { return mWidth; };
@@ -15,6 +15,11 @@
  */
 
 #include <inttypes.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "NdkMediaCodec"
@@ -94,8 +99,42 @@ struct AMediaCodec {
     mutable Mutex mAsyncCallbackLock;
     AMediaCodecOnAsyncNotifyCallback mAsyncCallback;
     void *mAsyncCallbackUserData;
+
+    // Polled event delivery: the looper thread appends to the ring and signals
+    // mEventFd, the client drains it with AMediaCodec_getEvents. Head is only
+    // written by the looper thread and tail only by the client.
+    int mEventFd;
+    std::unique_ptr<AMediaCodecEvent[]> mEvents;
+    std::atomic<uint32_t> mEventHead;
+    std::atomic<uint32_t> mEventTail;
 };
 
+// Far more than the buffers a codec can have outstanding, each of which has at
+// most one pending event
+static const uint32_t kMaxCodecEvents = 512;
+
+// Returns true if the event was handed to the event queue instead of a callback.
+// Caller must hold mAsyncCallbackLock.
+static bool queueCodecEventLocked(AMediaCodec *codec, const AMediaCodecEvent &event) {
+    if (codec->mEventFd < 0) {
+        return false;
+    }
+    uint32_t head = codec->mEventHead.load(std::memory_order_relaxed);
+    uint32_t tail = codec->mEventTail.load(std::memory_order_acquire);
+    if (head - tail >= kMaxCodecEvents) {
+        ALOGE("Event queue full, dropping event type %d", event.type);
+        return true;
+    }
+    codec->mEvents[head % kMaxCodecEvents] = event;
+    codec->mEventHead.store(head + 1, std::memory_order_release);
+
+    uint64_t signal = 1;
+    if (write(codec->mEventFd, &signal, sizeof(signal)) != sizeof(signal)) {
+        ALOGW("Failed to signal codec event: %s", strerror(errno));
+    }
+    return true;
+}
+
 CodecHandler::CodecHandler(AMediaCodec *codec) {
     mCodec = codec;
 }
@@ -154,6 +193,12 @@ void CodecHandler::onMessageReceived(const sp<AMessage> &msg) {
                      }
 
                      Mutex::Autolock _l(mCodec->mAsyncCallbackLock);
+                     AMediaCodecEvent event = {};
+                     event.type = AMEDIACODEC_EVENT_INPUT_AVAILABLE;
+                     event.index = index;
+                     if (queueCodecEventLocked(mCodec, event)) {
+                         break;
+                     }
                      if (mCodec->mAsyncCallbackUserData != NULL
                          || mCodec->mAsyncCallback.onAsyncInputAvailable != NULL) {
                          mCodec->mAsyncCallback.onAsyncInputAvailable(
@@ -201,6 +246,13 @@ void CodecHandler::onMessageReceived(const sp<AMessage> &msg) {
                          (uint32_t)flags};
 
                      Mutex::Autolock _l(mCodec->mAsyncCallbackLock);
+                     AMediaCodecEvent event = {};
+                     event.type = AMEDIACODEC_EVENT_OUTPUT_AVAILABLE;
+                     event.index = index;
+                     event.info = bufferInfo;
+                     if (queueCodecEventLocked(mCodec, event)) {
+                         break;
+                     }
                      if (mCodec->mAsyncCallbackUserData != NULL
                          || mCodec->mAsyncCallback.onAsyncOutputAvailable != NULL) {
                          mCodec->mAsyncCallback.onAsyncOutputAvailable(
@@ -221,9 +273,14 @@ void CodecHandler::onMessageReceived(const sp<AMessage> &msg) {
                          break;
                      }
 
-                     AMediaFormat *aMediaFormat = AMediaFormat_fromMsg(&format);
-
                      Mutex::Autolock _l(mCodec->mAsyncCallbackLock);
+                     AMediaCodecEvent event = {};
+                     event.type = AMEDIACODEC_EVENT_FORMAT_CHANGED;
+                     if (queueCodecEventLocked(mCodec, event)) {
+                         break;
+                     }
+
+                     AMediaFormat *aMediaFormat = AMediaFormat_fromMsg(&format);
                      if (mCodec->mAsyncCallbackUserData != NULL
                          || mCodec->mAsyncCallback.onAsyncFormatChanged != NULL) {
                          mCodec->mAsyncCallback.onAsyncFormatChanged(
@@ -253,6 +310,13 @@ void CodecHandler::onMessageReceived(const sp<AMessage> &msg) {
                            err, actionCode, detail.c_str());
 
                      Mutex::Autolock _l(mCodec->mAsyncCallbackLock);
+                     AMediaCodecEvent event = {};
+                     event.type = AMEDIACODEC_EVENT_ERROR;
+                     event.error = translate_error(err);
+                     event.actionCode = actionCode;
+                     if (queueCodecEventLocked(mCodec, event)) {
+                         break;
+                     }
                      if (mCodec->mAsyncCallbackUserData != NULL
                          || mCodec->mAsyncCallback.onAsyncError != NULL) {
                          mCodec->mAsyncCallback.onAsyncError(
@@ -332,6 +396,9 @@ static AMediaCodec * createAMediaCodec(const char *name, bool name_is_type, bool
 
     mData->mAsyncCallback = {};
     mData->mAsyncCallbackUserData = NULL;
+    mData->mEventFd = -1;
+    mData->mEventHead = 0;
+    mData->mEventTail = 0;
 
     return mData;
 }
@@ -366,6 +433,9 @@ media_status_t AMediaCodec_delete(AMediaCodec *mData) {
             mData->mLooper->stop();
             mData->mLooper.clear();
         }
+        if (mData->mEventFd >= 0) {
+            close(mData->mEventFd);
+        }
         delete mData;
     }
     return AMEDIA_OK;
@@ -443,6 +513,76 @@ media_status_t AMediaCodec_setAsyncNotifyCallback(
 }
 
 
+EXPORT
+media_status_t AMediaCodec_enableEventQueue(AMediaCodec *mData, int *eventFd) {
+    if (eventFd == NULL) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    {
+        Mutex::Autolock _l(mData->mAsyncCallbackLock);
+        if (mData->mEventFd >= 0) {
+            *eventFd = mData->mEventFd;
+            return AMEDIA_OK;
+        }
+    }
+
+    if (mData->mAsyncNotify == NULL) {
+        mData->mAsyncNotify = new AMessage(kWhatAsyncNotify, mData->mHandler);
+        status_t err = mData->mCodec->setCallback(mData->mAsyncNotify);
+        if (err != OK) {
+            ALOGE("enableEventQueue: err(%d), failed to set async callback", err);
+            mData->mAsyncNotify.clear();
+            return translate_error(err);
+        }
+    }
+
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) {
+        ALOGE("enableEventQueue: failed to create eventfd: %s", strerror(errno));
+        return AMEDIA_ERROR_UNKNOWN;
+    }
+
+    Mutex::Autolock _l(mData->mAsyncCallbackLock);
+    mData->mEvents.reset(new AMediaCodecEvent[kMaxCodecEvents]);
+    mData->mEventHead = 0;
+    mData->mEventTail = 0;
+    mData->mEventFd = fd;
+    *eventFd = fd;
+
+    return AMEDIA_OK;
+}
+
+EXPORT
+ssize_t AMediaCodec_getEvents(AMediaCodec *mData, AMediaCodecEvent *events, size_t maxEvents) {
+    if (mData->mEventFd < 0) {
+        return AMEDIA_ERROR_INVALID_OPERATION;
+    }
+    if (events == NULL && maxEvents > 0) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+
+    // Clear the wakeup before looking at the ring, so an event queued after this
+    // point signals the eventfd again.
+    uint64_t signals;
+    read(mData->mEventFd, &signals, sizeof(signals));
+
+    uint32_t tail = mData->mEventTail.load(std::memory_order_relaxed);
+    uint32_t head = mData->mEventHead.load(std::memory_order_acquire);
+    size_t count = 0;
+    while (tail != head && count < maxEvents) {
+        events[count++] = mData->mEvents[tail % kMaxCodecEvents];
+        tail++;
+    }
+    mData->mEventTail.store(tail, std::memory_order_release);
+
+    if (tail != head) {
+        // Keep the eventfd readable for the events left behind
+        uint64_t signal = 1;
+        write(mData->mEventFd, &signal, sizeof(signal));
+    }
+    return count;
+}
+
 EXPORT
 media_status_t AMediaCodec_releaseCrypto(AMediaCodec *mData) {
     return translate_error(mData->mCodec->releaseCrypto());
@@ -416,6 +416,27 @@ int64_t AMediaExtractor_getCachedDuration(AMediaExtractor *ex) {
     return -1;
 }
 
+EXPORT
+media_status_t AMediaExtractor_setPrefetchDepth(AMediaExtractor *ex, size_t depth) {
+    if (ex->mImpl->setPrefetchDepth(depth) != OK) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    return AMEDIA_OK;
+}
+
+EXPORT
+media_status_t AMediaExtractor_getPrefetchStats(AMediaExtractor *ex, size_t trackIdx,
+        size_t *queuedSamples, size_t *depth, int64_t *underruns) {
+    if (queuedSamples == NULL || depth == NULL || underruns == NULL) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    status_t err = ex->mImpl->getPrefetchStats(trackIdx, queuedSamples, depth, underruns);
+    if (err != OK) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    return AMEDIA_OK;
+}
+
 EXPORT
 media_status_t AMediaExtractor_getSampleFormat(AMediaExtractor *ex, AMediaFormat *fmt) {
     if (fmt == NULL) {
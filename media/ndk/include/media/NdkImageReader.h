@@ -463,6 +463,49 @@ media_status_t AImageReader_setBufferRemovedListener(
 
 #endif /* __ANDROID_API__ >= 26 */
 
+#if __ANDROID_API__ >= 28
+
+/**
+ * Acquire several {@link AImage}s from the image reader's queue in one call.
+ *
+ * <p>Images are acquired in queue order, exactly as a sequence of
+ * {@link AImageReader_acquireNextImageAsync} calls would return them, but the reader is only
+ * locked once for the whole batch. Acquisition stops early when the queue runs out of images
+ * or when maxImages images are already acquired; as long as at least one image was acquired
+ * the call succeeds. Each returned image must be released with {@link AImage_delete} or
+ * {@link AImage_deleteAsync} like any other acquired image.</p>
+ *
+ * <p>Together with {@link AImage_getHardwareBuffer}, which hands out the underlying buffer
+ * without mapping it for CPU access, this lets burst and vision pipelines drain the queue
+ * without any per-image locking.</p>
+ *
+ * @param reader The image reader of interest.
+ * @param images Array of at least maxImages entries that receives the acquired images.
+ * @param acquireFenceFds Optional array of at least maxImages entries that receives a sync
+ *         fence fd for each acquired image, with the same meaning as in
+ *         {@link AImageReader_acquireNextImageAsync}. Pass NULL to wait for each image to be
+ *         ready before it is returned.
+ * @param maxImages The most images to acquire. Must be greater than 0.
+ * @param numImages Receives the number of images acquired.
+ *
+ * @return <ul>
+ *         <li>{@link AMEDIA_OK} if at least one image was acquired.</li>
+ *         <li>{@link AMEDIA_ERROR_INVALID_PARAMETER} if reader, images or numImages is NULL, or
+ *                 maxImages is not positive.</li>
+ *         <li>{@link AMEDIA_IMGREADER_MAX_IMAGES_ACQUIRED} if no image could be acquired
+ *                 because the number of concurrently acquired images has reached the limit.</li>
+ *         <li>{@link AMEDIA_IMGREADER_NO_BUFFER_AVAILABLE} if there are no buffers currently
+ *                 available in the reader queue.</li>
+ *         <li>{@link AMEDIA_ERROR_UNKNOWN} if the method fails for some other reasons.</li></ul>
+ *
+ * @see AImageReader_acquireNextImageAsync
+ */
+media_status_t AImageReader_acquireNextImages(
+        AImageReader* reader, /*out*/AImage** images, /*out*/int* acquireFenceFds,
+        int32_t maxImages, /*out*/int32_t* numImages);
+
+#endif /* __ANDROID_API__ >= 28 */
+
 __END_DECLS
 
 #endif //_NDK_IMAGE_READER_H
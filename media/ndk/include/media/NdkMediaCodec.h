@@ -112,6 +112,28 @@ struct AMediaCodecOnAsyncNotifyCallback {
       AMediaCodecOnAsyncError           onAsyncError;
 };
 
+enum {
+    AMEDIACODEC_EVENT_INPUT_AVAILABLE = 1,
+    AMEDIACODEC_EVENT_OUTPUT_AVAILABLE = 2,
+    AMEDIACODEC_EVENT_FORMAT_CHANGED = 3,
+    AMEDIACODEC_EVENT_ERROR = 4,
+};
+
+/**
+ * An asynchronous codec event, as returned by AMediaCodec_getEvents.
+ * The fields carry the same values as the arguments of the matching
+ * AMediaCodecOnAsyncNotifyCallback function. For AMEDIACODEC_EVENT_FORMAT_CHANGED
+ * the new format is read with AMediaCodec_getOutputFormat.
+ */
+struct AMediaCodecEvent {
+    int32_t type;                   // AMEDIACODEC_EVENT_*
+    int32_t index;                  // input or output buffer index
+    AMediaCodecBufferInfo info;     // output buffer information
+    media_status_t error;           // error code for AMEDIACODEC_EVENT_ERROR
+    int32_t actionCode;             // action code for AMEDIACODEC_EVENT_ERROR
+};
+typedef struct AMediaCodecEvent AMediaCodecEvent;
+
 #if __ANDROID_API__ >= 21
 
 /**
@@ -379,6 +401,30 @@ media_status_t AMediaCodec_setAsyncNotifyCallback(
         AMediaCodecOnAsyncNotifyCallback callback,
         void *userdata);
 
+/**
+ * Switch the codec to asynchronous mode with polled event delivery, as an
+ * alternative to AMediaCodec_setAsyncNotifyCallback. Events are queued inside
+ * the codec instead of being delivered on an NDK internal thread, and the
+ * returned eventfd becomes readable whenever events are waiting, so it can be
+ * added to the client's own poll() or epoll() loop. Drain the events with
+ * AMediaCodec_getEvents.
+ *
+ * Call this before AMediaCodec_configure(). The same restrictions as for
+ * AMediaCodec_setAsyncNotifyCallback apply to the rest of the API. Once enabled,
+ * callbacks set with AMediaCodec_setAsyncNotifyCallback are no longer called.
+ * The eventfd is owned by the codec and closed by AMediaCodec_delete.
+ */
+media_status_t AMediaCodec_enableEventQueue(AMediaCodec*, /*out*/int *eventFd);
+
+/**
+ * Copy up to maxEvents queued events into events, oldest first, and clear the
+ * readable state of the eventfd returned by AMediaCodec_enableEventQueue unless
+ * more events remain. Returns the number of events copied, or
+ * AMEDIA_ERROR_INVALID_OPERATION if the event queue is not enabled.
+ * Must only be called from one thread at a time.
+ */
+ssize_t AMediaCodec_getEvents(AMediaCodec*, AMediaCodecEvent *events, size_t maxEvents);
+
 /**
  * Release the crypto if applicable.
  */
@@ -216,6 +216,34 @@ media_status_t AMediaExtractor_getSampleFormat(AMediaExtractor *ex, AMediaFormat
 
 #endif /* __ANDROID_API__ >= 28 */
 
+#if __ANDROID_API__ >= 29
+
+/**
+ * Sets the number of samples read ahead of the application for each track
+ * selected after this call. Every such track is read on its own thread, so
+ * waiting for the samples of one track is not delayed by the I/O of another.
+ * A depth of 0 (the default) disables prefetching.
+ *
+ * Returns AMEDIA_OK on success or AMEDIA_ERROR_INVALID_PARAMETER if |depth|
+ * is too large.
+ */
+media_status_t AMediaExtractor_setPrefetchDepth(AMediaExtractor *ex, size_t depth);
+
+/**
+ * Returns the prefetch queue statistics of selected track |trackIdx|.
+ * |queuedSamples| is the number of samples read but not yet consumed, |depth|
+ * the configured prefetch depth (0 if the track is not prefetched) and
+ * |underruns| the number of times the application had to wait for a sample
+ * because the queue was empty.
+ *
+ * Returns AMEDIA_OK on success or AMEDIA_ERROR_INVALID_PARAMETER if the
+ * track is not selected.
+ */
+media_status_t AMediaExtractor_getPrefetchStats(AMediaExtractor *ex, size_t trackIdx,
+        size_t *queuedSamples, size_t *depth, int64_t *underruns);
+
+#endif /* __ANDROID_API__ >= 29 */
+
 #endif /* __ANDROID_API__ >= 21 */
 
 __END_DECLS
@@ -25,6 +25,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <audio_utils/string.h>
+#include <utils/AndroidThreads.h>
+#include <utils/ThreadDefs.h>
+#include <utils/Timers.h>
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
@@ -56,20 +59,21 @@ bool BufLogSingleton::instanceExists() {
 // BufLog
 // ------------------------------
 
-BufLog::BufLog() {
+BufLog::BufLog() : mExit(false) {
     memset(mStreams, 0, sizeof(mStreams));
+    mWriterThread = std::thread(&BufLog::writerLoop, this);
 }
 
 BufLog::~BufLog() {
-    android::Mutex::Autolock autoLock(mLock);
-
-    for (unsigned int id = 0; id < BUFLOG_MAXSTREAMS; id++) {
-        BufLogStream *pBLStream = mStreams[id];
-        if (pBLStream != NULL) {
-            delete pBLStream ;
-            mStreams[id] = NULL;
-        }
+    {
+        android::Mutex::Autolock autoLock(mLock);
+        mExit = true;
+        mCond.signal();
     }
+    if (mWriterThread.joinable()) {
+        mWriterThread.join();
+    }
+    reset();
 }
 
 size_t BufLog::write(int streamid, const char *tag, int format, int channels,
@@ -89,21 +93,57 @@ size_t BufLog::write(int streamid, const char *tag, int format, int channels,
 }
 
 void BufLog::reset() {
-    android::Mutex::Autolock autoLock(mLock);
+    BufLogStream *streams[BUFLOG_MAXSTREAMS];
+    {
+        // Detach the streams first so that write() cannot reach them anymore.
+        android::Mutex::Autolock autoLock(mLock);
+        memcpy(streams, mStreams, sizeof(streams));
+        memset(mStreams, 0, sizeof(mStreams));
+    }
+    // Wait for the writer thread to be done with them.
+    android::Mutex::Autolock drainLock(mDrainLock);
     ALOGV("Resetting all BufLogs");
     int count = 0;
 
     for (unsigned int id = 0; id < BUFLOG_MAXSTREAMS; id++) {
-        BufLogStream *pBLStream = mStreams[id];
+        BufLogStream *pBLStream = streams[id];
         if (pBLStream != NULL) {
             delete pBLStream;
-            mStreams[id] = NULL;
             count++;
         }
     }
     ALOGV("Reset %d BufLogs", count);
 }
 
+void BufLog::writerLoop() {
+    androidSetThreadPriority(0, ANDROID_PRIORITY_BACKGROUND);
+    pthread_setname_np(pthread_self(), "BufLogWriter");
+
+    for (;;) {
+        {
+            android::Mutex::Autolock autoLock(mLock);
+            if (!mExit) {
+                mCond.waitRelative(mLock, ms2ns(BUFLOG_DRAIN_PERIOD_MS));
+            }
+            if (mExit) {
+                break;
+            }
+        }
+        // File I/O is done without mLock so that write() never waits for the disk.
+        android::Mutex::Autolock drainLock(mDrainLock);
+        BufLogStream *streams[BUFLOG_MAXSTREAMS];
+        {
+            android::Mutex::Autolock autoLock(mLock);
+            memcpy(streams, mStreams, sizeof(streams));
+        }
+        for (unsigned int id = 0; id < BUFLOG_MAXSTREAMS; id++) {
+            if (streams[id] != NULL) {
+                streams[id]->drain();
+            }
+        }
+    }
+}
+
 // ------------------------------
 // BufLogStream
 // ------------------------------
@@ -113,10 +153,11 @@ BufLogStream::BufLogStream(unsigned int id,
         unsigned int format,
         unsigned int channels,
         unsigned int samplingRate,
-        size_t maxBytes = 0) : mId(id), mFormat(format), mChannels(channels),
-                mSamplingRate(samplingRate), mMaxBytes(maxBytes) {
-    mByteCount = 0l;
-    mPaused = false;
+        size_t maxBytes = 0) : mPaused(false), mFinalized(false), mId(id), mFormat(format),
+                mChannels(channels), mSamplingRate(samplingRate), mMaxBytes(maxBytes),
+                mByteCount(0), mQueuedBytes(0), mFileCreated(false), mFile(NULL),
+                mRing(new uint8_t[BUFLOG_RING_SIZE]), mFront(0), mRear(0), mDroppedBytes(0),
+                mReportedDroppedBytes(0) {
     if (tag != NULL) {
         (void)audio_utils_strlcpy(mTag, tag);
     } else {
@@ -125,7 +166,7 @@ BufLogStream::BufLogStream(unsigned int id,
     ALOGV("Creating BufLogStream id:%d tag:%s format:%#x ch:%d sr:%d maxbytes:%zu", mId, mTag,
             mFormat, mChannels, mSamplingRate, mMaxBytes);
 
-    //open file (s), info about tag, format, etc.
+    //info about tag, format, etc. The file itself is created by the writer thread.
     //timestamp
     char timeStr[16];   //size 16: format %Y%m%d%H%M%S 14 chars + string null terminator
     struct timeval tv;
@@ -133,17 +174,9 @@ BufLogStream::BufLogStream(unsigned int id,
     struct tm tm;
     localtime_r(&tv.tv_sec, &tm);
     strftime(timeStr, sizeof(timeStr), "%Y%m%d%H%M%S", &tm);
-    char logPath[BUFLOG_MAX_PATH_SIZE];
-    snprintf(logPath, BUFLOG_MAX_PATH_SIZE, "%s/%s_%d_%s_%d_%d_%d.raw", BUFLOG_BASE_PATH, timeStr,
+    snprintf(mPath, BUFLOG_MAX_PATH_SIZE, "%s/%s_%d_%s_%d_%d_%d.raw", BUFLOG_BASE_PATH, timeStr,
             mId, mTag, mFormat, mChannels, mSamplingRate);
-    ALOGV("data output: %s", logPath);
-
-    mFile = fopen(logPath, "wb");
-    if (mFile != NULL) {
-        ALOGV("Success creating file at: %p", mFile);
-    } else {
-        ALOGE("Error: could not create file BufLogStream %s", strerror(errno));
-    }
+    ALOGV("data output: %s", mPath);
 }
 
 void BufLogStream::closeStream_l() {
@@ -156,27 +189,34 @@ void BufLogStream::closeStream_l() {
 
 BufLogStream::~BufLogStream() {
     ALOGV("Destroying BufLogStream id:%d tag:%s", mId, mTag);
-    android::Mutex::Autolock autoLock(mLock);
-    closeStream_l();
+    finalize();
 }
 
 size_t BufLogStream::write(const void *buf, size_t size) {
 
     size_t bytes = 0;
-    if (!mPaused && mFile != NULL) {
+    if (!mPaused && !mFinalized) {
         if (size > 0 && buf != NULL) {
-            android::Mutex::Autolock autoLock(mLock);
             if (mMaxBytes > 0) {
-                size = MIN(size, mMaxBytes - mByteCount);
+                size = MIN(size, mMaxBytes - mQueuedBytes);
             }
-            bytes = fwrite(buf, 1, size, mFile);
-            mByteCount += bytes;
-            if (mMaxBytes > 0 && mMaxBytes == mByteCount) {
-                closeStream_l();
+            const size_t rear = mRear.load(std::memory_order_relaxed);
+            const size_t front = mFront.load(std::memory_order_acquire);
+            if (size > BUFLOG_RING_SIZE - (rear - front)) {
+                // drop the whole buffer rather than a part of it to keep the file frame aligned
+                mDroppedBytes.fetch_add(size, std::memory_order_relaxed);
+                return 0;
             }
+            const size_t index = rear & (BUFLOG_RING_SIZE - 1);
+            const size_t part1 = MIN(size, BUFLOG_RING_SIZE - index);
+            memcpy(&mRing[index], buf, part1);
+            memcpy(&mRing[0], (const uint8_t *)buf + part1, size - part1);
+            mRear.store(rear + size, std::memory_order_release);
+            mQueuedBytes += size;
+            bytes = size;
         }
-        ALOGV("wrote %zu/%zu bytes to BufLogStream %d tag:%s. Total Bytes: %zu", bytes, size, mId,
-                mTag, mByteCount);
+        ALOGV("queued %zu/%zu bytes to BufLogStream %d tag:%s. Total Bytes: %zu", bytes, size, mId,
+                mTag, mQueuedBytes);
     } else {
         ALOGV("Warning: trying to write to %s BufLogStream id:%d tag:%s",
                 mPaused ? "paused" : "closed", mId, mTag);
@@ -184,13 +224,51 @@ size_t BufLogStream::write(const void *buf, size_t size) {
     return bytes;
 }
 
+void BufLogStream::drain() {
+    android::Mutex::Autolock autoLock(mLock);
+    drain_l();
+}
+
+void BufLogStream::drain_l() {
+    const size_t rear = mRear.load(std::memory_order_acquire);
+    size_t front = mFront.load(std::memory_order_relaxed);
+    if (front != rear && !mFileCreated) {
+        mFileCreated = true;
+        mFile = fopen(mPath, "wb");
+        if (mFile != NULL) {
+            ALOGV("Success creating file at: %p", mFile);
+        } else {
+            ALOGE("Error: could not create file BufLogStream %s", strerror(errno));
+        }
+    }
+    while (front != rear) {
+        const size_t index = front & (BUFLOG_RING_SIZE - 1);
+        const size_t chunk = MIN(rear - front, BUFLOG_RING_SIZE - index);
+        if (mFile != NULL) {
+            mByteCount += fwrite(&mRing[index], 1, chunk, mFile);
+        }
+        front += chunk;
+    }
+    mFront.store(front, std::memory_order_release);
+    if (mMaxBytes > 0 && mByteCount >= mMaxBytes) {
+        closeStream_l();
+    }
+
+    const size_t dropped = mDroppedBytes.load(std::memory_order_relaxed);
+    if (dropped != mReportedDroppedBytes) {
+        ALOGW("BufLogStream id:%d tag:%s dropped %zu bytes, writer thread too slow",
+                mId, mTag, dropped - mReportedDroppedBytes);
+        mReportedDroppedBytes = dropped;
+    }
+}
+
 bool BufLogStream::setPause(bool pause) {
-    bool old = mPaused;
-    mPaused = pause;
-    return old;
+    return mPaused.exchange(pause);
 }
 
 void BufLogStream::finalize() {
     android::Mutex::Autolock autoLock(mLock);
+    mFinalized = true;
+    drain_l();
     closeStream_l();
 }
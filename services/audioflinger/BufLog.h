@@ -23,6 +23,12 @@
  * are named following this format:
  *   YYYYMMDDHHMMSS_id_format_channels_samplingrate.raw
  *
+ * BUFLOG(..) only copies the buffer into a per stream ring of BUFLOG_RING_SIZE bytes and never
+ * blocks on file I/O, so it can be placed anywhere in the mixer or effect pipeline.
+ * A low priority writer thread drains the rings to disk every BUFLOG_DRAIN_PERIOD_MS.
+ * Buffers that do not fit in the ring are dropped and counted.
+ * Each stream must only be written from one thread at a time.
+ *
  * Normally we strip BUFLOG dumps from release builds.
  * You can modify this (for example with "#define BUFLOG_NDEBUG 0"
  * at the top of your source file) to change that behavior.
@@ -100,15 +106,21 @@
 #endif
 
 
+#include <atomic>
+#include <memory>
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/types.h>
+#include <thread>
+#include <utils/Condition.h>
 #include <utils/Mutex.h>
 
 //BufLog configuration
 #define BUFLOGSTREAM_MAX_TAGSIZE    32
 #define BUFLOG_BASE_PATH            "/data/misc/audioserver"
 #define BUFLOG_MAX_PATH_SIZE        300
+#define BUFLOG_RING_SIZE            (1 << 20)   // bytes queued per stream, must be a power of 2
+#define BUFLOG_DRAIN_PERIOD_MS      50
 
 class BufLogStream {
 public:
@@ -120,11 +132,16 @@ public:
             size_t maxBytes);
     ~BufLogStream();
 
-    // write buffer to stream
+    // queue buffer for the writer thread. Never blocks: if the ring is full the buffer is
+    // dropped and counted.
     //  buf:  pointer to buffer
     //  size: number of bytes to write
+    //  return value: number of bytes queued.
     size_t          write(const void *buf, size_t size);
 
+    // write the queued data to the file, opening it on first use. Called by the writer thread.
+    void            drain();
+
     // pause/resume stream
     //  pause: true = paused, false = not paused
     //  return value: previous state of stream (paused or not).
@@ -135,17 +152,29 @@ public:
     void            finalize();
 
 private:
-    bool                mPaused;
+    std::atomic<bool>   mPaused;
+    std::atomic<bool>   mFinalized;
     const unsigned int  mId;
     char                mTag[BUFLOGSTREAM_MAX_TAGSIZE + 1];
     const unsigned int  mFormat;
     const unsigned int  mChannels;
     const unsigned int  mSamplingRate;
     const size_t        mMaxBytes;
-    size_t              mByteCount;
+    size_t              mByteCount;     // bytes written to the file
+    size_t              mQueuedBytes;   // bytes accepted by write(), bounded by mMaxBytes
+    char                mPath[BUFLOG_MAX_PATH_SIZE];
+    bool                mFileCreated;
     FILE                *mFile;
-    mutable android::Mutex mLock;
+    mutable android::Mutex mLock;   // serializes drain() and finalize()
 
+    // single producer, single consumer ring of queued bytes
+    std::unique_ptr<uint8_t[]> mRing;
+    std::atomic<size_t> mFront;     // advanced by the writer thread
+    std::atomic<size_t> mRear;      // advanced by write()
+    std::atomic<size_t> mDroppedBytes;
+    size_t              mReportedDroppedBytes;
+
+    void            drain_l();
     void            closeStream_l();
 };
 
@@ -182,8 +211,14 @@ public:
 
 protected:
     static const unsigned int BUFLOG_MAXSTREAMS = 16;
-    BufLogStream    *mStreams[BUFLOG_MAXSTREAMS];
+    BufLogStream    *mStreams[BUFLOG_MAXSTREAMS];   // protected by mLock
     mutable android::Mutex mLock;
+    android::Mutex  mDrainLock;     // held by the writer thread while draining streams
+    android::Condition mCond;
+    bool            mExit;
+    std::thread     mWriterThread;
+
+    void            writerLoop();
 };
 
 class BufLogSingleton {
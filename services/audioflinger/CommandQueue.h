@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_COMMAND_QUEUE_H
+#define ANDROID_AUDIO_COMMAND_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <sys/types.h>
+
+namespace android {
+
+// A bounded queue of commands from any number of threads to a single thread.
+// Neither side ever blocks: push() fails when the queue is full and pop() when it is empty.
+// Each slot carries a sequence number telling whether it is free for the producer
+// claiming the position, or published for the consumer.
+template<typename T, size_t N>
+class CommandQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+public:
+    CommandQueue() : mPushPosition(0), mPopPosition(0) {
+        for (size_t i = 0; i < N; ++i) {
+            mSlots[i].mSequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread. Returns false if the queue is full.
+    bool push(const T& command) {
+        size_t position = mPushPosition.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;) {
+            slot = &mSlots[position & (N - 1)];
+            const ssize_t diff = (ssize_t)slot->mSequence.load(std::memory_order_acquire)
+                    - (ssize_t)position;
+            if (diff == 0) {
+                if (mPushPosition.compare_exchange_weak(position, position + 1,
+                        std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = mPushPosition.load(std::memory_order_relaxed);
+            }
+        }
+        slot->mCommand = command;
+        slot->mSequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only, one thread at a time. Returns false if the queue is empty.
+    bool pop(T *command) {
+        const size_t position = mPopPosition.load(std::memory_order_relaxed);
+        Slot *slot = &mSlots[position & (N - 1)];
+        if (slot->mSequence.load(std::memory_order_acquire) != position + 1) {
+            return false;
+        }
+        *command = slot->mCommand;
+        slot->mCommand = T();
+        slot->mSequence.store(position + N, std::memory_order_release);
+        mPopPosition.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer only, one thread at a time.
+    bool empty() const {
+        const size_t position = mPopPosition.load(std::memory_order_relaxed);
+        return mSlots[position & (N - 1)].mSequence.load(std::memory_order_seq_cst)
+                != position + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> mSequence;
+        T                   mCommand;
+    };
+
+    Slot                mSlots[N];
+    std::atomic<size_t> mPushPosition;
+    std::atomic<size_t> mPopPosition;
+};
+
+} // namespace android
+
+#endif // ANDROID_AUDIO_COMMAND_QUEUE_H
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_COST_METER_H
+#define ANDROID_AUDIO_COST_METER_H
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+
+namespace android {
+
+// The processing time of a track or an effect over its last kSamples sampled buffers.
+// add() is called by the thread doing the processing, getStats() may be called
+// concurrently, typically by dump(), and then sees a window that is being overwritten.
+class CostMeter {
+public:
+    static constexpr size_t kSamples = 128;
+
+    // Every kSamplePeriod buffers are timed by the playback thread and the effect chains.
+    static constexpr uint32_t kSamplePeriod = 16;
+
+    struct Stats {
+        size_t mCount;      // number of samples, at most kSamples
+        float  mAverageUs;
+        float  mP99Us;
+    };
+
+    CostMeter() : mCount(0) {
+        for (auto &sample : mSamplesNs) {
+            sample.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns true when this completed a window of kSamples samples.
+    bool add(int64_t ns) {
+        const size_t count = mCount.load(std::memory_order_relaxed);
+        mSamplesNs[count % kSamples].store(
+                (uint32_t)std::min(std::max(ns, (int64_t)0), (int64_t)UINT32_MAX),
+                std::memory_order_relaxed);
+        mCount.store(count + 1, std::memory_order_release);
+        return (count + 1) % kSamples == 0;
+    }
+
+    Stats getStats() const {
+        const size_t count = std::min(mCount.load(std::memory_order_acquire), (size_t)kSamples);
+        Stats stats = {count, 0.f, 0.f};
+        if (count == 0) {
+            return stats;
+        }
+        uint32_t samples[kSamples];
+        uint64_t sum = 0;
+        for (size_t i = 0; i < count; ++i) {
+            samples[i] = mSamplesNs[i].load(std::memory_order_relaxed);
+            sum += samples[i];
+        }
+        const size_t p99 = count * 99 / 100;
+        std::nth_element(samples, samples + p99, samples + count);
+        stats.mAverageUs = sum * 1e-3f / count;
+        stats.mP99Us = samples[p99] * 1e-3f;
+        return stats;
+    }
+
+private:
+    std::atomic<size_t> mCount;                   // total samples added
+    std::atomic<uint32_t> mSamplesNs[kSamples];
+};
+
+} // namespace android
+
+#endif // ANDROID_AUDIO_COST_METER_H
@@ -286,7 +286,7 @@ bool AudioFlinger::EffectModule::updateState() {
     return started;
 }
 
-void AudioFlinger::EffectModule::process()
+void AudioFlinger::EffectModule::process(bool *int16Pending, bool deferOutput)
 {
     Mutex::Autolock _l(mLock);
 
@@ -395,7 +395,15 @@ void AudioFlinger::EffectModule::process()
                         * mOutChannelCountRequested * mConfig.outputCfg.buffer.frameCount);
                 outBuffer = mOutConversionBuffer;
             }
-            if (!mSupportsFloat) { // convert input to int16_t as effect doesn't support float.
+            if (mInPlaceBuffer != 0) {
+                // the chain's int16 buffer may still hold the output of the previous effect
+                if (int16Pending == nullptr || !*int16Pending) {
+                    memcpy_to_i16_from_float(
+                            mInPlaceBuffer->audioBuffer()->s16,
+                            mInBuffer->audioBuffer()->f32,
+                            inChannelCount * mConfig.inputCfg.buffer.frameCount);
+                }
+            } else if (!mSupportsFloat) { // convert input to int16_t as effect doesn't support float.
                 if (!auxType) {
                     if (mInConversionBuffer.get() == nullptr) {
                         ALOGW("%s: mInConversionBuffer is null, bypassing", __func__);
@@ -422,7 +430,20 @@ void AudioFlinger::EffectModule::process()
 #endif
             ret = mEffectInterface->process();
 #ifdef FLOAT_EFFECT_CHAIN
-            if (!mSupportsFloat) { // convert output int16_t back to float.
+            if (mInPlaceBuffer != 0) {
+                // left in int16 if the next effect processes in the same buffer
+                if (int16Pending != nullptr && deferOutput) {
+                    *int16Pending = true;
+                } else {
+                    memcpy_to_float_from_i16(
+                            mOutBuffer->audioBuffer()->f32,
+                            mInPlaceBuffer->audioBuffer()->s16,
+                            outChannelCount * mConfig.outputCfg.buffer.frameCount);
+                    if (int16Pending != nullptr) {
+                        *int16Pending = false;
+                    }
+                }
+            } else if (!mSupportsFloat) { // convert output int16_t back to float.
                 sp<EffectBufferHalInterface> target =
                         mOutChannelCountRequested != outChannelCount
                         ? mOutConversionBuffer : mOutBuffer;
@@ -1041,6 +1062,7 @@ void AudioFlinger::EffectModule::setInBuffer(const sp<EffectBufferHalInterface>&
             ALOGE("%s cannot create mInConversionBuffer", __func__);
         }
     }
+    updateInPlaceBuffer();
 #endif
 }
 
@@ -1087,9 +1109,61 @@ void AudioFlinger::EffectModule::setOutBuffer(const sp<EffectBufferHalInterface>
             ALOGE("%s cannot create mOutConversionBuffer", __func__);
         }
     }
+    updateInPlaceBuffer();
 #endif
 }
 
+#ifdef FLOAT_EFFECT_CHAIN
+void AudioFlinger::EffectModule::updateInPlaceBuffer()
+{
+    // An int16 insert effect whose input and output are the same float buffer converts
+    // into the chain's int16 buffer and processes there in place. Consecutive such
+    // effects then skip the conversions between them, see EffectChain::process_l().
+    const uint32_t inChannelCount =
+            audio_channel_count_from_out_mask(mConfig.inputCfg.channels);
+    const uint32_t outChannelCount =
+            audio_channel_count_from_out_mask(mConfig.outputCfg.channels);
+    const size_t frameCount = mConfig.inputCfg.buffer.frameCount;
+    sp<EffectBufferHalInterface> buffer;
+    if (!mSupportsFloat
+            && (mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT
+            && mConfig.outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE
+            && mInBuffer != 0 && mOutBuffer != 0
+            && mInBuffer->audioBuffer()->raw == mOutBuffer->audioBuffer()->raw
+            && inChannelCount == outChannelCount
+            && mInChannelCountRequested == inChannelCount
+            && mOutChannelCountRequested == outChannelCount
+            && frameCount == mConfig.outputCfg.buffer.frameCount) {
+        sp<EffectChain> chain = mChain.promote();
+        if (chain != 0) {
+            buffer = chain->int16Buffer();
+        }
+        if (buffer != 0 && buffer->getSize() < frameCount * inChannelCount * sizeof(int16_t)) {
+            buffer.clear();
+        }
+    }
+    if (buffer == mInPlaceBuffer) {
+        return;
+    }
+    if (buffer != 0) {
+        buffer->setFrameCount(frameCount);
+        mEffectInterface->setInBuffer(buffer);
+        mEffectInterface->setOutBuffer(buffer);
+    } else {
+        // back to the buffers chosen by setInBuffer() and setOutBuffer()
+        mEffectInterface->setInBuffer(
+                mInConversionBuffer != 0 && (!mSupportsFloat
+                        || mInChannelCountRequested != inChannelCount)
+                ? mInConversionBuffer : mInBuffer);
+        mEffectInterface->setOutBuffer(
+                mOutConversionBuffer != 0 && (!mSupportsFloat
+                        || mOutChannelCountRequested != outChannelCount)
+                ? mOutConversionBuffer : mOutBuffer);
+    }
+    mInPlaceBuffer = buffer;
+}
+#endif
+
 status_t AudioFlinger::EffectModule::setVolume(uint32_t *left, uint32_t *right, bool controller)
 {
     Mutex::Autolock _l(mLock);
@@ -1437,6 +1511,10 @@ void AudioFlinger::EffectModule::dump(int fd, const Vector<String16>& args __unu
             dumpInOutBuffer(false /* isInput */, mOutConversionBuffer).c_str());
 #endif
 
+    const CostMeter::Stats cost = mProcessCost.getStats();
+    result.appendFormat("\t\t- Process cost: avg %.1f us p99 %.1f us per buffer (%zu samples)\n",
+            cost.mAverageUs, cost.mP99Us, cost.mCount);
+
     result.appendFormat("\t\t%zu Clients:\n", mHandles.size());
     result.append("\t\t\t  Pid Priority Ctrl Locked client server\n");
     char buffer[256];
@@ -1840,7 +1918,7 @@ void AudioFlinger::EffectHandle::dumpToBuffer(char* buffer, size_t size)
 AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
                                         audio_session_t sessionId)
     : mThread(thread), mSessionId(sessionId), mActiveTrackCnt(0), mTrackCnt(0), mTailBufferCount(0),
-      mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
+      mProcessCount(0), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
       mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX)
 {
     mStrategy = AudioSystem::getStrategyForStream(AUDIO_STREAM_MUSIC);
@@ -1965,9 +2043,39 @@ void AudioFlinger::EffectChain::process_l()
         if (mInBuffer->audioBuffer()->raw != mOutBuffer->audioBuffer()->raw) {
             mOutBuffer->update();
         }
+        const bool timed = mProcessCount++ % CostMeter::kSamplePeriod == 0;
+#ifdef FLOAT_EFFECT_CHAIN
+        // true while mInt16Buffer holds samples not converted back to mInBuffer yet:
+        // consecutive effects processing in place in mInt16Buffer stay in int16.
+        bool int16Pending = false;
+        const auto flushInt16Buffer = [&]() {
+            memcpy_to_float_from_i16(mInBuffer->audioBuffer()->f32,
+                    mInt16Buffer->audioBuffer()->s16,
+                    thread->frameCount() * thread->channelCount());
+            int16Pending = false;
+        };
+#endif
         for (size_t i = 0; i < size; i++) {
+            const nsecs_t start = timed ? systemTime() : 0;
+#ifdef FLOAT_EFFECT_CHAIN
+            if (int16Pending && !mEffects[i]->processesInPlace(mInt16Buffer)) {
+                flushInt16Buffer();
+            }
+            const bool deferOutput =
+                    i + 1 < size && mEffects[i + 1]->processesInPlace(mInt16Buffer);
+            mEffects[i]->process(&int16Pending, deferOutput);
+#else
             mEffects[i]->process();
+#endif
+            if (timed) {
+                mEffects[i]->processCost().add(systemTime() - start);
+            }
         }
+#ifdef FLOAT_EFFECT_CHAIN
+        if (int16Pending) {
+            flushInt16Buffer();
+        }
+#endif
         mInBuffer->commit();
         if (mInBuffer->audioBuffer()->raw != mOutBuffer->audioBuffer()->raw) {
             mOutBuffer->commit();
@@ -2107,6 +2215,18 @@ status_t AudioFlinger::EffectChain::addEffect_ll(const sp<EffectModule>& effect)
             }
         }
 
+#ifdef FLOAT_EFFECT_CHAIN
+        // for the insert effects that turn out to be int16 only, see
+        // EffectModule::updateInPlaceBuffer()
+        const size_t int16Size = thread->frameCount()
+                * std::max((uint32_t)FCC_2, thread->channelCount()) * sizeof(int16_t);
+        if (mInt16Buffer == 0 || mInt16Buffer->getSize() < int16Size) {
+            mInt16Buffer.clear();
+            (void)thread->mAudioFlinger->mEffectsFactoryHal->allocateBuffer(
+                    int16Size, &mInt16Buffer);
+        }
+#endif
+
         // always read samples from chain input buffer
         effect->setInBuffer(mInBuffer);
 
@@ -61,7 +61,9 @@ public:
     };
 
     int         id() const { return mId; }
-    void process();
+    // int16Pending and deferOutput let the EffectChain keep the samples in int16
+    // from one int16 effect to the next, see EffectChain::process_l().
+    void process(bool *int16Pending = nullptr, bool deferOutput = false);
     bool updateState();
     status_t command(uint32_t cmdCode,
                      uint32_t cmdSize,
@@ -135,6 +137,15 @@ public:
 
     void             dump(int fd, const Vector<String16>& args);
 
+    // time spent in process(), sampled by the EffectChain
+    CostMeter&       processCost() { return mProcessCost; }
+
+#ifdef FLOAT_EFFECT_CHAIN
+    // true if this effect converts to and processes in place in the given int16 buffer
+    bool             processesInPlace(const sp<EffectBufferHalInterface>& buffer) const
+                        { return buffer != 0 && mInPlaceBuffer == buffer; }
+#endif
+
 private:
     friend class AudioFlinger;      // for mHandles
     bool                mPinned;
@@ -147,6 +158,10 @@ private:
     status_t start_l();
     status_t stop_l();
     status_t remove_effect_from_hal_l();
+#ifdef FLOAT_EFFECT_CHAIN
+    // called once the buffers are set, shares the int16 buffer of the chain when possible
+    void     updateInPlaceBuffer();
+#endif
 
 mutable Mutex               mLock;      // mutex for process, commands and handles list protection
     wp<ThreadBase>      mThread;    // parent thread
@@ -168,6 +183,7 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
     bool     mSuspended;            // effect is suspended: temporarily disabled by framework
     bool     mOffloaded;            // effect is currently offloaded to the audio DSP
     wp<AudioFlinger>    mAudioFlinger;
+    CostMeter           mProcessCost;
 
 #ifdef FLOAT_EFFECT_CHAIN
     bool    mSupportsFloat;         // effect supports float processing
@@ -175,6 +191,8 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
     sp<EffectBufferHalInterface> mOutConversionBuffer;
     uint32_t mInChannelCountRequested;
     uint32_t mOutChannelCountRequested;
+    // the int16 buffer of the chain, if this is an int16 insert effect processing in place
+    sp<EffectBufferHalInterface> mInPlaceBuffer;
 #endif
 };
 
@@ -325,6 +343,10 @@ public:
     effect_buffer_t *outBuffer() const {
         return mOutBuffer != 0 ? reinterpret_cast<effect_buffer_t*>(mOutBuffer->ptr()) : NULL;
     }
+#ifdef FLOAT_EFFECT_CHAIN
+    // the int16 buffer shared by the int16 insert effects processing in place
+    sp<EffectBufferHalInterface> int16Buffer() const { return mInt16Buffer; }
+#endif
 
     void incTrackCnt() { android_atomic_inc(&mTrackCnt); }
     void decTrackCnt() { android_atomic_dec(&mTrackCnt); }
@@ -409,6 +431,9 @@ private:
              audio_session_t mSessionId; // audio session ID
              sp<EffectBufferHalInterface> mInBuffer;  // chain input buffer
              sp<EffectBufferHalInterface> mOutBuffer; // chain output buffer
+#ifdef FLOAT_EFFECT_CHAIN
+             sp<EffectBufferHalInterface> mInt16Buffer; // see int16Buffer()
+#endif
 
     // 'volatile' here means these are accessed with atomic operations instead of mutex
     volatile int32_t mActiveTrackCnt;    // number of active tracks connected
@@ -416,6 +441,7 @@ private:
 
              int32_t mTailBufferCount;   // current effect tail buffer count
              int32_t mMaxTailBuffers;    // maximum effect tail buffers
+             uint32_t mProcessCount;     // process_l() calls, to sample the effects cost
              int mVolumeCtrlIdx;         // index of insert effect having control over volume
              uint32_t mLeftVolume;       // previous volume on left channel
              uint32_t mRightVolume;      // previous volume on right channel
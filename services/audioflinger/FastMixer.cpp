@@ -47,9 +47,12 @@ namespace android {
 
 /*static*/ const FastMixerState FastMixer::sInitial;
 
-FastMixer::FastMixer() : FastThread("cycle_ms", "load_us"),
-    // mFastTrackNames
-    // mGenerations
+FastMixer::FastMixer(unsigned maxFastTracks) : FastThread("cycle_ms", "load_us"),
+    mMaxFastTracks(maxFastTracks),
+    mBufferProviders(NULL),
+    mVolumeProviders(NULL),
+    mGenerations(NULL),
+    mTrackArrays(NULL),
     mOutputSink(NULL),
     mOutputSinkGen(0),
     mMixer(NULL),
@@ -77,10 +80,22 @@ FastMixer::FastMixer() : FastThread("cycle_ms", "load_us"),
     // We assume that the channel mask must be a valid positional channel mask.
     mSinkChannelMask = audio_channel_out_mask_from_count(mSinkChannelCount);
 
-    unsigned i;
-    for (i = 0; i < FastMixerState::sMaxFastTracks; ++i) {
-        mGenerations[i] = 0;
-    }
+    LOG_ALWAYS_FATAL_IF(maxFastTracks < FastMixerState::kMinFastTracks
+            || maxFastTracks > FastMixerState::kMaxFastTracks,
+            "invalid maxFastTracks %u", maxFastTracks);
+    static const size_t kCacheLine = 64;
+    const size_t pointersSize =
+            (maxFastTracks * sizeof(void *) + kCacheLine - 1) & ~(kCacheLine - 1);
+    const size_t generationsSize =
+            (maxFastTracks * sizeof(int) + kCacheLine - 1) & ~(kCacheLine - 1);
+    const size_t size = 2 * pointersSize + generationsSize;
+    LOG_ALWAYS_FATAL_IF(posix_memalign(&mTrackArrays, kCacheLine, size) != 0,
+            "cannot allocate %zu bytes of fast track state", size);
+    memset(mTrackArrays, 0, size);
+    uint8_t *arrays = (uint8_t *) mTrackArrays;
+    mBufferProviders = (ExtendedAudioBufferProvider **) arrays;
+    mVolumeProviders = (VolumeProvider **) (arrays + pointersSize);
+    mGenerations = (int *) (arrays + 2 * pointersSize);
 #ifdef FAST_THREAD_STATISTICS
     mOldLoad.tv_sec = 0;
     mOldLoad.tv_nsec = 0;
@@ -89,6 +104,7 @@ FastMixer::FastMixer() : FastThread("cycle_ms", "load_us"),
 
 FastMixer::~FastMixer()
 {
+    free(mTrackArrays);
 }
 
 FastMixerStateQueue* FastMixer::sq()
@@ -148,7 +164,7 @@ void FastMixer::onStateChange()
 
     // handle state change here, but since we want to diff the state,
     // we're prepared for previous == &sInitial the first time through
-    unsigned previousTrackMask;
+    uint64_t previousTrackMask;
 
     // check for change in output HAL configuration
     NBAIO_Format previousFormat = mFormat;
@@ -225,30 +241,33 @@ void FastMixer::onStateChange()
     }
 
     // check for change in active track set
-    const unsigned currentTrackMask = current->mTrackMask;
+    const uint64_t currentTrackMask = current->mTrackMask;
+    dumpState->mMaxFastTracks = mMaxFastTracks;
     dumpState->mTrackMask = currentTrackMask;
     if (current->mFastTracksGen != mFastTracksGen) {
         ALOG_ASSERT(mMixerBuffer != NULL);
 
         // process removed tracks first to avoid running out of track names
-        unsigned removedTracks = previousTrackMask & ~currentTrackMask;
+        uint64_t removedTracks = previousTrackMask & ~currentTrackMask;
         while (removedTracks != 0) {
-            int i = __builtin_ctz(removedTracks);
-            removedTracks &= ~(1 << i);
+            int i = __builtin_ctzll(removedTracks);
+            removedTracks &= ~(1ULL << i);
             const FastTrack* fastTrack = &current->mFastTracks[i];
             ALOG_ASSERT(fastTrack->mBufferProvider == NULL);
             if (mMixer != NULL) {
                 mMixer->destroy(i);
             }
             // don't reset track dump state, since other side is ignoring it
+            mBufferProviders[i] = NULL;
+            mVolumeProviders[i] = NULL;
             mGenerations[i] = fastTrack->mGeneration;
         }
 
         // now process added tracks
-        unsigned addedTracks = currentTrackMask & ~previousTrackMask;
+        uint64_t addedTracks = currentTrackMask & ~previousTrackMask;
         while (addedTracks != 0) {
-            int i = __builtin_ctz(addedTracks);
-            addedTracks &= ~(1 << i);
+            int i = __builtin_ctzll(addedTracks);
+            addedTracks &= ~(1ULL << i);
             const FastTrack* fastTrack = &current->mFastTracks[i];
             AudioBufferProvider *bufferProvider = fastTrack->mBufferProvider;
             if (mMixer != NULL) {
@@ -278,15 +297,17 @@ void FastMixer::onStateChange()
                         (void *)(uintptr_t)mSinkChannelMask);
                 mMixer->enable(name);
             }
+            mBufferProviders[i] = fastTrack->mBufferProvider;
+            mVolumeProviders[i] = fastTrack->mVolumeProvider;
             mGenerations[i] = fastTrack->mGeneration;
         }
 
         // finally process (potentially) modified tracks; these use the same slot
         // but may have a different buffer provider or volume provider
-        unsigned modifiedTracks = currentTrackMask & previousTrackMask;
+        uint64_t modifiedTracks = currentTrackMask & previousTrackMask;
         while (modifiedTracks != 0) {
-            int i = __builtin_ctz(modifiedTracks);
-            modifiedTracks &= ~(1 << i);
+            int i = __builtin_ctzll(modifiedTracks);
+            modifiedTracks &= ~(1ULL << i);
             const FastTrack* fastTrack = &current->mFastTracks[i];
             if (fastTrack->mGeneration != mGenerations[i]) {
                 // this track was actually modified
@@ -314,13 +335,15 @@ void FastMixer::onStateChange()
                             (void *)(uintptr_t)mSinkChannelMask);
                     // already enabled
                 }
+                mBufferProviders[i] = fastTrack->mBufferProvider;
+                mVolumeProviders[i] = fastTrack->mVolumeProvider;
                 mGenerations[i] = fastTrack->mGeneration;
             }
         }
 
         mFastTracksGen = current->mFastTracksGen;
 
-        dumpState->mNumTracks = popcount(currentTrackMask);
+        dumpState->mNumTracks = __builtin_popcountll(currentTrackMask);
     }
 }
 
@@ -346,15 +369,16 @@ void FastMixer::onWork()
         bool anyEnabledTracks = false;
 
         // for each track, update volume and check for underrun
-        unsigned currentTrackMask = current->mTrackMask;
+        uint64_t currentTrackMask = current->mTrackMask;
         while (currentTrackMask != 0) {
-            int i = __builtin_ctz(currentTrackMask);
-            currentTrackMask &= ~(1 << i);
-            const FastTrack* fastTrack = &current->mFastTracks[i];
+            int i = __builtin_ctzll(currentTrackMask);
+            currentTrackMask &= ~(1ULL << i);
+            ExtendedAudioBufferProvider * const bufferProvider = mBufferProviders[i];
+            VolumeProvider * const volumeProvider = mVolumeProviders[i];
 
             const int64_t trackFramesWrittenButNotPresented =
                 mNativeFramesWrittenButNotPresented;
-            const int64_t trackFramesWritten = fastTrack->mBufferProvider->framesReleased();
+            const int64_t trackFramesWritten = bufferProvider->framesReleased();
             ExtendedTimestamp perTrackTimestamp(mTimestamp);
 
             // Can't provide an ExtendedTimestamp before first frame presented.
@@ -368,11 +392,11 @@ void FastMixer::onWork()
                 perTrackTimestamp.mTimeNs[ExtendedTimestamp::LOCATION_KERNEL] = -1;
             }
             perTrackTimestamp.mPosition[ExtendedTimestamp::LOCATION_SERVER] = trackFramesWritten;
-            fastTrack->mBufferProvider->onTimestamp(perTrackTimestamp);
+            bufferProvider->onTimestamp(perTrackTimestamp);
 
             const int name = i;
-            if (fastTrack->mVolumeProvider != NULL) {
-                gain_minifloat_packed_t vlr = fastTrack->mVolumeProvider->getVolumeLR();
+            if (volumeProvider != NULL) {
+                gain_minifloat_packed_t vlr = volumeProvider->getVolumeLR();
                 float vlf = float_from_gain(gain_minifloat_unpack_left(vlr));
                 float vrf = float_from_gain(gain_minifloat_unpack_right(vlr));
 
@@ -383,13 +407,19 @@ void FastMixer::onWork()
             // takes a tryLock, which can block
             // up to 1 ms.  If enough active tracks all blocked in sequence, this would result
             // in the overall fast mix cycle being delayed.  Should use a non-blocking FIFO.
-            size_t framesReady = fastTrack->mBufferProvider->framesReady();
+            size_t framesReady = bufferProvider->framesReady();
             if (ATRACE_ENABLED()) {
                 // I wish we had formatted trace names
                 char traceName[16];
                 strcpy(traceName, "fRdy");
-                traceName[4] = i + (i < 10 ? '0' : 'A' - 10);
-                traceName[5] = '\0';
+                if (i < 10) {
+                    traceName[4] = '0' + i;
+                    traceName[5] = '\0';
+                } else {
+                    traceName[4] = '0' + i / 10;
+                    traceName[5] = '0' + i % 10;
+                    traceName[6] = '\0';
+                }
                 ATRACE_INT(traceName, framesReady);
             }
             FastTrackDump *ftDump = &dumpState->mTracks[i];
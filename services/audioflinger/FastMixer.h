@@ -32,7 +32,8 @@ typedef StateQueue<FastMixerState> FastMixerStateQueue;
 class FastMixer : public FastThread {
 
 public:
-            FastMixer();
+    // maxFastTracks is the number of fast track slots, at most FastMixerState::kMaxFastTracks.
+    explicit FastMixer(unsigned maxFastTracks);
     virtual ~FastMixer();
 
             FastMixerStateQueue* sq();
@@ -57,8 +58,14 @@ private:
     static const FastMixerState sInitial;
 
     FastMixerState  mPreIdle;   // copy of state before we went into idle
-    int             mGenerations[FastMixerState::kMaxFastTracks];
-                                // last observed mFastTracks[i].mGeneration
+    const unsigned  mMaxFastTracks;
+    // Per fast track state, one cache line aligned array of mMaxFastTracks entries per field
+    // instead of reading each FastTrack, so that onWork() only touches the lines it needs.
+    // The providers are copied from mFastTracks[i] whenever its generation changes.
+    ExtendedAudioBufferProvider** mBufferProviders;
+    VolumeProvider** mVolumeProviders;
+    int*            mGenerations;       // last observed mFastTracks[i].mGeneration
+    void*           mTrackArrays;       // the allocation holding the arrays above
     NBAIO_Sink*     mOutputSink;
     int             mOutputSinkGen;
     AudioMixer*     mMixer;
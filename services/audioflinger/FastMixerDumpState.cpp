@@ -34,7 +34,7 @@ FastMixerDumpState::FastMixerDumpState() : FastThreadDumpState(),
     mWriteSequence(0), mFramesWritten(0),
     mNumTracks(0), mWriteErrors(0),
     mSampleRate(0), mFrameCount(0),
-    mTrackMask(0)
+    mMaxFastTracks(0), mTrackMask(0)
 {
 }
 
@@ -90,7 +90,7 @@ void FastMixerDumpState::dump(int fd) const
     }
     // statistics for monotonic (wall clock) time, thread raw CPU load in time, CPU clock frequency,
     // and adjusted CPU load in MHz normalized for CPU clock frequency
-    CentralTendencyStatistics wall, loadNs;
+    CentralTendencyStatistics wall, loadNs, wakeupLatencyNs;
 #ifdef CPU_FREQUENCY_STATISTICS
     CentralTendencyStatistics kHz, loadMHz;
     uint32_t previousCpukHz = 0;
@@ -110,6 +110,10 @@ void FastMixerDumpState::dump(int fd) const
         wall.sample(wallNs);
         uint32_t sampleLoadNs = mLoadNs[i];
         loadNs.sample(sampleLoadNs);
+        uint32_t sampleWakeupLatencyNs = mWakeupLatencyNs[i];
+        if (sampleWakeupLatencyNs != kWakeupLatencyUnknown) {
+            wakeupLatencyNs.sample(sampleWakeupLatencyNs);
+        }
 #ifdef CPU_FREQUENCY_STATISTICS
         uint32_t sampleCpukHz = mCpukHz[i];
         // skip bad kHz samples
@@ -135,6 +139,13 @@ void FastMixerDumpState::dump(int fd) const
                     "      mean=%.0f min=%.0f max=%.0f stddev=%.0f\n",
                     loadNs.mean()*1e-3, loadNs.minimum()*1e-3, loadNs.maximum()*1e-3,
                     loadNs.stddev()*1e-3);
+        if (wakeupLatencyNs.n()) {
+            dprintf(fd, "    wake-up latency in us per mix cycle:\n"
+                        "      mean=%.0f min=%.0f max=%.0f stddev=%.0f\n",
+                        wakeupLatencyNs.mean()*1e-3, wakeupLatencyNs.minimum()*1e-3,
+                        wakeupLatencyNs.maximum()*1e-3, wakeupLatencyNs.stddev()*1e-3);
+        }
+        dprintf(fd, "    CPU migrations: %u\n", mCpuMigrations);
     } else {
         dprintf(fd, "  No FastMixer statistics available currently\n");
     }
@@ -170,11 +181,11 @@ void FastMixerDumpState::dump(int fd) const
     // then we might display an obsolete track or omit an active track.
     // Instead we always display all tracks, with an indication
     // of whether we think the track is active.
-    uint32_t trackMask = mTrackMask;
-    dprintf(fd, "  Fast tracks: sMaxFastTracks=%u activeMask=%#x\n",
-            FastMixerState::sMaxFastTracks, trackMask);
+    uint64_t trackMask = mTrackMask;
+    dprintf(fd, "  Fast tracks: maxFastTracks=%u activeMask=%#llx\n",
+            mMaxFastTracks, (unsigned long long) trackMask);
     dprintf(fd, "  Index Active Full Partial Empty  Recent Ready    Written\n");
-    for (uint32_t i = 0; i < FastMixerState::sMaxFastTracks; ++i, trackMask >>= 1) {
+    for (uint32_t i = 0; i < mMaxFastTracks; ++i, trackMask >>= 1) {
         bool isActive = trackMask & 1;
         const FastTrackDump *ftDump = &mTracks[i];
         const FastTrackUnderruns& underruns = ftDump->mUnderruns;
@@ -72,7 +72,8 @@ struct FastMixerDumpState : FastThreadDumpState {
     uint32_t mWriteErrors;      // total number of write() errors
     uint32_t mSampleRate;
     size_t   mFrameCount;
-    uint32_t mTrackMask;        // mask of active tracks
+    uint32_t mMaxFastTracks;    // number of fast tracks of the thread
+    uint64_t mTrackMask;        // mask of active tracks
     FastTrackDump   mTracks[FastMixerState::kMaxFastTracks];
 };
 
@@ -37,22 +37,13 @@ FastMixerState::FastMixerState() : FastThreadState(),
     mFastTracksGen(0), mTrackMask(0), mOutputSink(NULL), mOutputSinkGen(0),
     mFrameCount(0), mTeeSink(NULL)
 {
-    int ok = pthread_once(&sMaxFastTracksOnce, sMaxFastTracksInit);
-    if (ok != 0) {
-        ALOGE("%s pthread_once failed: %d", __func__, ok);
-    }
+    static_assert(kMaxFastTracks <= sizeof(mTrackMask) * 8, "mTrackMask too small");
 }
 
 FastMixerState::~FastMixerState()
 {
 }
 
-// static
-unsigned FastMixerState::sMaxFastTracks = kDefaultFastTracks;
-
-// static
-pthread_once_t FastMixerState::sMaxFastTracksOnce = PTHREAD_ONCE_INIT;
-
 // static
 const char *FastMixerState::commandToString(Command command)
 {
@@ -69,17 +60,26 @@ const char *FastMixerState::commandToString(Command command)
 }
 
 // static
-void FastMixerState::sMaxFastTracksInit()
+unsigned FastMixerState::getMaxFastTracks()
 {
-    char value[PROPERTY_VALUE_MAX];
-    if (property_get("ro.audio.max_fast_tracks", value, NULL) > 0) {
-        char *endptr;
-        unsigned long ul = strtoul(value, &endptr, 0);
-        if (*endptr == '\0' && kMinFastTracks <= ul && ul <= kMaxFastTracks) {
-            sMaxFastTracks = (unsigned) ul;
+    // Read for every new thread rather than once, af.max_fast_tracks lets an output
+    // opened later, e.g. for a low latency game audio stack, be given more tracks.
+    unsigned maxFastTracks = kDefaultFastTracks;
+    static const char * const properties[] = {"af.max_fast_tracks", "ro.audio.max_fast_tracks"};
+    for (const char *property : properties) {
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get(property, value, NULL) > 0) {
+            char *endptr;
+            unsigned long ul = strtoul(value, &endptr, 0);
+            if (*endptr == '\0' && kMinFastTracks <= ul && ul <= kMaxFastTracks) {
+                maxFastTracks = (unsigned) ul;
+                break;
+            }
+            ALOGW("ignoring %s=%s", property, value);
         }
     }
-    ALOGI("sMaxFastTracks = %u", sMaxFastTracks);
+    ALOGV("maxFastTracks = %u", maxFastTracks);
+    return maxFastTracks;
 }
 
 }   // namespace android
@@ -54,18 +54,25 @@ struct FastMixerState : FastThreadState {
                 FastMixerState();
     /*virtual*/ ~FastMixerState();
 
-    // These are the minimum, maximum, and default values for maximum number of fast tracks
+    // These are the minimum, maximum, and default values for maximum number of fast tracks.
+    // kMaxFastTracks is the capacity of a state, each thread uses the number of fast tracks
+    // configured when it is created, see getMaxFastTracks().
     static const unsigned kMinFastTracks = 2;
-    static const unsigned kMaxFastTracks = 32;
+    static const unsigned kMaxFastTracks = 64;
     static const unsigned kDefaultFastTracks = 8;
 
-    static unsigned sMaxFastTracks;             // Configured maximum number of fast tracks
-    static pthread_once_t sMaxFastTracksOnce;   // Protects initializer for sMaxFastTracks
+    // Configured maximum number of fast tracks for a thread created now.
+    static unsigned getMaxFastTracks();
+
+    // Mask with bits [0, count) set.
+    static uint64_t trackMaskOf(unsigned count) {
+        return count >= 64 ? ~0ULL : (1ULL << count) - 1;
+    }
 
     // all pointer fields use raw pointers; objects are owned and ref-counted by the normal mixer
     FastTrack   mFastTracks[kMaxFastTracks];
     int         mFastTracksGen; // increment when any mFastTracks[i].mGeneration is incremented
-    unsigned    mTrackMask;     // bit i is set if and only if mFastTracks[i] is active
+    uint64_t    mTrackMask;     // bit i is set if and only if mFastTracks[i] is active
     NBAIO_Sink* mOutputSink;    // HAL output device, must already be negotiated
     int         mOutputSinkGen; // increment when mOutputSink is assigned
     size_t      mFrameCount;    // number of frames per fast mix buffer
@@ -83,9 +90,6 @@ struct FastMixerState : FastThreadState {
     // never returns NULL; asserts if command is invalid
     static const char *commandToString(Command command);
 
-    // initialize sMaxFastTracks
-    static void sMaxFastTracksInit();
-
 };  // struct FastMixerState
 
 }   // namespace android
@@ -58,6 +58,7 @@ FastThread::FastThread(const char *cycleMs, const char *loadUs) : Thread(false /
     mOldLoadValid(false),
     mBounds(0),
     mFull(false),
+    // mSchedStats
     // mTcu
 #endif
     mColdGen(0),
@@ -101,11 +102,17 @@ bool FastThread::threadLoop()
             if (mSleepNs > 0) {
                 ALOG_ASSERT(mSleepNs < 1000000000);
                 const struct timespec req = {0, mSleepNs};
+#ifdef FAST_THREAD_STATISTICS
+                mSchedStats.willSleep(mSleepNs);
+#endif
                 nanosleep(&req, NULL);
             } else {
                 sched_yield();
             }
         }
+#ifdef FAST_THREAD_STATISTICS
+        mSchedStats.didWake();
+#endif
         // default to long sleep for next cycle
         mSleepNs = FAST_DEFAULT_NS;
 
@@ -189,6 +196,7 @@ bool FastThread::threadLoop()
 #ifdef FAST_THREAD_STATISTICS
                 mBounds = 0;
                 mFull = false;
+                mSchedStats.reset();
 #endif
                 mOldTsValid = !clock_gettime(CLOCK_MONOTONIC, &mOldTs);
                 mTimestampStatus = INVALID_OPERATION;
@@ -340,12 +348,18 @@ bool FastThread::threadLoop()
                     // or with respect to store #4 below
                     mDumpState->mMonotonicNs[i] = monotonicNs;
                     mDumpState->mLoadNs[i] = loadNs;
+                    // wake-up latency of this cycle, if it slept for a known duration
+                    const int64_t latencyNs = mSchedStats.lastWakeupLatencyNs();
+                    mDumpState->mWakeupLatencyNs[i] = latencyNs < 0 ?
+                            FastThreadDumpState::kWakeupLatencyUnknown :
+                            latencyNs < 4000000000LL ? (uint32_t) latencyNs : 3999999999U;
 #ifdef CPU_FREQUENCY_STATISTICS
                     mDumpState->mCpukHz[i] = kHz;
 #endif
                     // this store #4 is not atomic with respect to stores #1, #2, #3 above, but
                     // the newest open & oldest closed halves are atomic with respect to each other
                     mDumpState->mBounds = mBounds;
+                    mDumpState->mCpuMigrations = mSchedStats.migrations();
                     ATRACE_INT(mCycleMs, monotonicNs / 1000000);
                     ATRACE_INT(mLoadUs, loadNs / 1000);
                 }
@@ -18,6 +18,9 @@
 #define ANDROID_AUDIO_FAST_THREAD_H
 
 #include "Configuration.h"
+#ifdef FAST_THREAD_STATISTICS
+#include <cpustats/ThreadSchedStats.h>
+#endif
 #ifdef CPU_FREQUENCY_STATISTICS
 #include <cpustats/ThreadCpuUsage.h>
 #endif
@@ -71,6 +74,7 @@ protected:
     bool            mOldLoadValid;  // whether oldLoad is valid
     uint32_t        mBounds;
     bool            mFull;          // whether we have collected at least mSamplingN samples
+    ThreadSchedStats mSchedStats;   // wake-up latency and CPU migrations
 #ifdef CPU_FREQUENCY_STATISTICS
     ThreadCpuUsage  mTcu;           // for reading the current CPU clock frequency in kHz
 #endif
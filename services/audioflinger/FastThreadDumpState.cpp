@@ -24,7 +24,7 @@ FastThreadDumpState::FastThreadDumpState() :
     /* mMeasuredWarmupTs({0, 0}), */
     mWarmupCycles(0)
 #ifdef FAST_THREAD_STATISTICS
-    , mSamplingN(0), mBounds(0)
+    , mSamplingN(0), mBounds(0), mCpuMigrations(0)
 #endif
 {
     mMeasuredWarmupTs.tv_sec = 0;
@@ -49,6 +49,7 @@ void FastThreadDumpState::increaseSamplingN(uint32_t samplingN)
     // so clearing reduces chance for dumpsys to read random uninitialized samples
     memset(&mMonotonicNs[mSamplingN], 0, sizeof(mMonotonicNs[0]) * additional);
     memset(&mLoadNs[mSamplingN], 0, sizeof(mLoadNs[0]) * additional);
+    memset(&mWakeupLatencyNs[mSamplingN], 0xFF, sizeof(mWakeupLatencyNs[0]) * additional);
 #ifdef CPU_FREQUENCY_STATISTICS
     memset(&mCpukHz[mSamplingN], 0, sizeof(mCpukHz[0]) * additional);
 #endif
@@ -57,6 +57,10 @@ struct FastThreadDumpState {
     // The elements in the *Ns arrays are in units of nanoseconds <= 3999999999.
     uint32_t mMonotonicNs[kSamplingN];  // delta monotonic (wall clock) time
     uint32_t mLoadNs[kSamplingN];       // delta CPU load in time
+    // wake-up latency before the cycle, or kWakeupLatencyUnknown if it did not sleep
+    uint32_t mWakeupLatencyNs[kSamplingN];
+    static const uint32_t kWakeupLatencyUnknown = ~0U;
+    uint32_t mCpuMigrations;            // total number of CPU migrations since cold idle
 #ifdef CPU_FREQUENCY_STATISTICS
     uint32_t mCpukHz[kSamplingN];       // absolute CPU clock frequency in kHz, bits 0-3 are CPU#
 #endif
@@ -20,7 +20,9 @@
 //#define LOG_NDEBUG 0
 
 #include "Configuration.h"
+#include <math.h>
 #include <utils/Log.h>
+#include <audio_utils/format.h>
 #include <audio_utils/primitives.h>
 
 #include "AudioFlinger.h"
@@ -44,6 +46,9 @@
 
 namespace android {
 
+// time to wait after a read error of a direct patch before reading again
+static const useconds_t kDirectPatchErrorSleepUs = 5000;
+
 /* List connected audio ports and their attributes */
 status_t AudioFlinger::listAudioPorts(unsigned int *num_ports,
                                 struct audio_port *ports)
@@ -174,7 +179,8 @@ status_t AudioFlinger::PatchPanel::createAudioPatch(const struct audio_patch *pa
                 if ((removedPatch->mRecordPatchHandle
                         != AUDIO_PATCH_HANDLE_NONE) ||
                         (removedPatch->mPlaybackPatchHandle !=
-                                AUDIO_PATCH_HANDLE_NONE)) {
+                                AUDIO_PATCH_HANDLE_NONE) ||
+                        (removedPatch->mDirectPatchThread != 0)) {
                     clearPatchConnections(removedPatch);
                 }
                 // 2) if the new patch and old patch source or sink are devices from different
@@ -252,6 +258,16 @@ status_t AudioFlinger::PatchPanel::createAudioPatch(const struct audio_patch *pa
                 ((patch->sinks[0].type == AUDIO_PORT_TYPE_DEVICE) &&
                  ((patch->sinks[0].ext.device.hw_module != srcModule) ||
                   !audioHwDevice->supportsAudioPatches()))) {
+                // a single source device to a single sink device: try to connect the streams
+                // directly, and only use a record and a playback thread if it is not possible
+                if (patch->num_sources == 1 && patch->num_sinks == 1) {
+                    status = createDirectPatch(newPatch, patch);
+                    if (status == NO_ERROR) {
+                        break;
+                    }
+                    ALOGV("createAudioPatch() no direct patch, status %d", status);
+                    status = NO_ERROR;
+                }
                 if (patch->num_sources == 2) {
                     if (patch->sources[1].type != AUDIO_PORT_TYPE_MIX ||
                             (patch->num_sinks != 0 && patch->sinks[0].ext.device.hw_module !=
@@ -524,6 +540,11 @@ void AudioFlinger::PatchPanel::clearPatchConnections(Patch *patch)
     ALOGV("clearPatchConnections() patch->mRecordPatchHandle %d patch->mPlaybackPatchHandle %d",
           patch->mRecordPatchHandle, patch->mPlaybackPatchHandle);
 
+    if (patch->mDirectPatchThread != 0) {
+        patch->mDirectPatchThread->exit();
+        patch->mDirectPatchThread.clear();
+    }
+
     if (patch->mPatchRecord != 0) {
         patch->mPatchRecord->stop();
     }
@@ -568,6 +589,237 @@ void AudioFlinger::PatchPanel::clearPatchConnections(Patch *patch)
 
 }
 
+status_t AudioFlinger::PatchPanel::createDirectPatch(Patch *patch,
+                                                     const struct audio_patch *audioPatch)
+{
+    sp<AudioFlinger> audioflinger = mAudioFlinger.promote();
+    if (audioflinger == 0) {
+        return NO_INIT;
+    }
+    const struct audio_port_config *source = &audioPatch->sources[0];
+    const struct audio_port_config *sink = &audioPatch->sinks[0];
+    AudioHwDevice *inHwDev = audioflinger->findSuitableHwDev_l(source->ext.device.hw_module,
+                                                               source->ext.device.type);
+    AudioHwDevice *outHwDev = audioflinger->findSuitableHwDev_l(sink->ext.device.hw_module,
+                                                                sink->ext.device.type);
+    if (inHwDev == NULL || outHwDev == NULL) {
+        return BAD_VALUE;
+    }
+
+    // open the output stream with the sink device properties if provided or the HAL default,
+    // then the input stream with the source device properties if provided or the output ones.
+    audio_config_t outConfig = AUDIO_CONFIG_INITIALIZER;
+    if (sink->config_mask & AUDIO_PORT_CONFIG_SAMPLE_RATE) {
+        outConfig.sample_rate = sink->sample_rate;
+    }
+    if (sink->config_mask & AUDIO_PORT_CONFIG_CHANNEL_MASK) {
+        outConfig.channel_mask = sink->channel_mask;
+    }
+    if (sink->config_mask & AUDIO_PORT_CONFIG_FORMAT) {
+        outConfig.format = sink->format;
+    }
+    audio_io_handle_t output = audioflinger->nextUniqueId(AUDIO_UNIQUE_ID_USE_OUTPUT);
+    sp<StreamOutHalInterface> outStream;
+    status_t status = outHwDev->hwDevice()->openOutputStream(output, sink->ext.device.type,
+            AUDIO_OUTPUT_FLAG_NONE, &outConfig, sink->ext.device.address, &outStream);
+    if (status != NO_ERROR || outStream == 0) {
+        return status != NO_ERROR ? status : NO_INIT;
+    }
+    outStream->getAudioProperties(
+            &outConfig.sample_rate, &outConfig.channel_mask, &outConfig.format);
+
+    audio_config_t inConfig = AUDIO_CONFIG_INITIALIZER;
+    inConfig.sample_rate = (source->config_mask & AUDIO_PORT_CONFIG_SAMPLE_RATE) ?
+            source->sample_rate : outConfig.sample_rate;
+    inConfig.channel_mask = (source->config_mask & AUDIO_PORT_CONFIG_CHANNEL_MASK) ?
+            source->channel_mask :
+            audio_channel_in_mask_from_count(audio_channel_count_from_out_mask(
+                    outConfig.channel_mask));
+    inConfig.format = (source->config_mask & AUDIO_PORT_CONFIG_FORMAT) ?
+            source->format : outConfig.format;
+    audio_io_handle_t input = audioflinger->nextUniqueId(AUDIO_UNIQUE_ID_USE_INPUT);
+    sp<StreamInHalInterface> inStream;
+    status = inHwDev->hwDevice()->openInputStream(input, source->ext.device.type, &inConfig,
+            AUDIO_INPUT_FLAG_NONE, source->ext.device.address, AUDIO_SOURCE_MIC, &inStream);
+    if (status != NO_ERROR || inStream == 0) {
+        return status != NO_ERROR ? status : NO_INIT;
+    }
+    inStream->getAudioProperties(&inConfig.sample_rate, &inConfig.channel_mask, &inConfig.format);
+
+    // there is no resampler on this path
+    if (inConfig.sample_rate != outConfig.sample_rate ||
+            !audio_is_linear_pcm(inConfig.format) || !audio_is_linear_pcm(outConfig.format)) {
+        ALOGV("createDirectPatch() cannot connect input %u Hz format %#x to output %u Hz "
+              "format %#x", inConfig.sample_rate, inConfig.format,
+              outConfig.sample_rate, outConfig.format);
+        return INVALID_OPERATION;
+    }
+
+    // the sink gain, in millibels, is applied by the patch
+    float gain = 1.0f;
+    if ((sink->config_mask & AUDIO_PORT_CONFIG_GAIN) &&
+            (sink->gain.mode & AUDIO_GAIN_MODE_JOINT)) {
+        gain = powf(10.0f, sink->gain.values[0] / 2000.0f);
+    }
+
+    sp<DirectPatchThread> thread =
+            new DirectPatchThread(inHwDev, inStream, outHwDev, outStream, gain);
+    status = thread->initCheck();
+    if (status != NO_ERROR) {
+        return status;
+    }
+
+    // route the streams as the record and playback threads would
+    struct audio_port_config mixConfig = {};
+    mixConfig.type = AUDIO_PORT_TYPE_MIX;
+    mixConfig.config_mask = AUDIO_PORT_CONFIG_SAMPLE_RATE | AUDIO_PORT_CONFIG_CHANNEL_MASK |
+            AUDIO_PORT_CONFIG_FORMAT;
+    if (inHwDev->supportsAudioPatches()) {
+        mixConfig.role = AUDIO_PORT_ROLE_SINK;
+        mixConfig.ext.mix.handle = input;
+        mixConfig.ext.mix.hw_module = inHwDev->handle();
+        mixConfig.ext.mix.usecase.source = AUDIO_SOURCE_MIC;
+        mixConfig.sample_rate = inConfig.sample_rate;
+        mixConfig.channel_mask = inConfig.channel_mask;
+        mixConfig.format = inConfig.format;
+        status = inHwDev->hwDevice()->createAudioPatch(1, source, 1, &mixConfig,
+                                                       &thread->mInHalHandle);
+    } else {
+        AudioParameter param = AudioParameter();
+        param.addInt(String8(AudioParameter::keyRouting), (int)source->ext.device.type);
+        param.addInt(String8(AudioParameter::keyInputSource), (int)AUDIO_SOURCE_MIC);
+        status = inStream->setParameters(param.toString());
+    }
+    if (status == NO_ERROR) {
+        if (outHwDev->supportsAudioPatches()) {
+            mixConfig.role = AUDIO_PORT_ROLE_SOURCE;
+            mixConfig.ext.mix.handle = output;
+            mixConfig.ext.mix.hw_module = outHwDev->handle();
+            mixConfig.ext.mix.usecase.stream = AUDIO_STREAM_DEFAULT;
+            mixConfig.sample_rate = outConfig.sample_rate;
+            mixConfig.channel_mask = outConfig.channel_mask;
+            mixConfig.format = outConfig.format;
+            status = outHwDev->hwDevice()->createAudioPatch(1, &mixConfig, 1, sink,
+                                                            &thread->mOutHalHandle);
+        } else {
+            AudioParameter param = AudioParameter();
+            param.addInt(String8(AudioParameter::keyRouting), (int)sink->ext.device.type);
+            status = outStream->setParameters(param.toString());
+        }
+    }
+    if (status == NO_ERROR) {
+        status = thread->run("DirectPatch", ANDROID_PRIORITY_URGENT_AUDIO);
+    }
+    if (status != NO_ERROR) {
+        thread->exit();
+        return status;
+    }
+    ALOGV("createDirectPatch() %u Hz input format %#x channels %#x output format %#x "
+          "channels %#x gain %f", inConfig.sample_rate, inConfig.format, inConfig.channel_mask,
+          outConfig.format, outConfig.channel_mask, gain);
+    patch->mDirectPatchThread = thread;
+    return NO_ERROR;
+}
+
+AudioFlinger::PatchPanel::DirectPatchThread::DirectPatchThread(
+        AudioHwDevice *inHwDev, const sp<StreamInHalInterface>& input,
+        AudioHwDevice *outHwDev, const sp<StreamOutHalInterface>& output, float gain)
+    :   Thread(false /*canCallJava*/),
+        mInHalHandle(AUDIO_PATCH_HANDLE_NONE), mOutHalHandle(AUDIO_PATCH_HANDLE_NONE),
+        mInHwDev(inHwDev), mInput(input), mOutHwDev(outHwDev), mOutput(output), mGain(gain),
+        mStatus(NO_INIT), mConvert(false), mBuffer(NULL)
+{
+    uint32_t sampleRate;
+    audio_channel_mask_t inChannelMask, outChannelMask;
+    size_t bufferSize;
+    if (mInput->getAudioProperties(&sampleRate, &inChannelMask, &mInFormat) != NO_ERROR ||
+            mOutput->getAudioProperties(&sampleRate, &outChannelMask, &mOutFormat) != NO_ERROR ||
+            mInput->getFrameSize(&mInFrameSize) != NO_ERROR || mInFrameSize == 0 ||
+            mInput->getBufferSize(&bufferSize) != NO_ERROR) {
+        return;
+    }
+    mInChannelCount = audio_channel_count_from_in_mask(inChannelMask);
+    mOutChannelCount = audio_channel_count_from_out_mask(outChannelMask);
+    mFrameCount = bufferSize / mInFrameSize;
+    mConvert = mInFormat != mOutFormat || mInChannelCount != mOutChannelCount || mGain != 1.0f;
+
+    // when converting, large enough for the period in float with the most channels
+    size_t size = bufferSize;
+    if (mConvert) {
+        size = std::max(size,
+                mFrameCount * std::max(mInChannelCount, mOutChannelCount) * sizeof(float));
+    }
+    mBuffer = malloc(size);
+    mStatus = mFrameCount != 0 && mBuffer != NULL ? NO_ERROR : NO_MEMORY;
+}
+
+AudioFlinger::PatchPanel::DirectPatchThread::~DirectPatchThread()
+{
+    free(mBuffer);
+}
+
+void AudioFlinger::PatchPanel::DirectPatchThread::exit()
+{
+    requestExitAndWait();
+    if (mInHalHandle != AUDIO_PATCH_HANDLE_NONE) {
+        mInHwDev->hwDevice()->releaseAudioPatch(mInHalHandle);
+        mInHalHandle = AUDIO_PATCH_HANDLE_NONE;
+    }
+    if (mOutHalHandle != AUDIO_PATCH_HANDLE_NONE) {
+        mOutHwDev->hwDevice()->releaseAudioPatch(mOutHalHandle);
+        mOutHalHandle = AUDIO_PATCH_HANDLE_NONE;
+    }
+    mInput->standby();
+    mOutput->standby();
+}
+
+bool AudioFlinger::PatchPanel::DirectPatchThread::threadLoop()
+{
+    // the read blocks for one period, which paces the loop
+    size_t bytesRead = 0;
+    status_t status = mInput->read(mBuffer, mFrameCount * mInFrameSize, &bytesRead);
+    const size_t frameCount = bytesRead / mInFrameSize;
+    if (status != NO_ERROR || frameCount == 0) {
+        ALOGW_IF(status != NO_ERROR, "DirectPatchThread read error %d", status);
+        // do not spin on a failing HAL
+        usleep(kDirectPatchErrorSleepUs);
+        return true;
+    }
+
+    size_t bytes = frameCount * mInFrameSize;
+    if (mConvert) {
+        // in place: the conversion to float goes from the end of the buffer
+        float *buffer = (float *)mBuffer;
+        memcpy_by_audio_format(buffer, AUDIO_FORMAT_PCM_FLOAT, mBuffer, mInFormat,
+                               frameCount * mInChannelCount);
+        if (mInChannelCount != mOutChannelCount) {
+            adjust_channels(buffer, mInChannelCount, buffer, mOutChannelCount, sizeof(float),
+                            frameCount * mInChannelCount * sizeof(float));
+        }
+        const size_t sampleCount = frameCount * mOutChannelCount;
+        if (mGain != 1.0f) {
+            for (size_t i = 0; i < sampleCount; i++) {
+                buffer[i] *= mGain;
+            }
+        }
+        memcpy_by_audio_format(mBuffer, mOutFormat, buffer, AUDIO_FORMAT_PCM_FLOAT, sampleCount);
+        bytes = sampleCount * audio_bytes_per_sample(mOutFormat);
+    }
+
+    const char *data = (const char *)mBuffer;
+    while (bytes > 0 && !exitPending()) {
+        size_t written = 0;
+        status = mOutput->write(data, bytes, &written);
+        if (status != NO_ERROR || written == 0) {
+            ALOGW_IF(status != NO_ERROR, "DirectPatchThread write error %d", status);
+            break;
+        }
+        data += written;
+        bytes -= written;
+    }
+    return true;
+}
+
 /* Disconnect a patch */
 status_t AudioFlinger::PatchPanel::releaseAudioPatch(audio_patch_handle_t handle)
 {
@@ -604,7 +856,8 @@ status_t AudioFlinger::PatchPanel::releaseAudioPatch(audio_patch_handle_t handle
             }
 
             if (removedPatch->mRecordPatchHandle != AUDIO_PATCH_HANDLE_NONE ||
-                    removedPatch->mPlaybackPatchHandle != AUDIO_PATCH_HANDLE_NONE) {
+                    removedPatch->mPlaybackPatchHandle != AUDIO_PATCH_HANDLE_NONE ||
+                    removedPatch->mDirectPatchThread != 0) {
                 clearPatchConnections(removedPatch);
                 break;
             }
@@ -23,6 +23,7 @@ class PatchPanel : public RefBase {
 public:
 
     class Patch;
+    class DirectPatchThread;
 
     explicit PatchPanel(const sp<AudioFlinger>& audioFlinger);
     virtual ~PatchPanel();
@@ -52,6 +53,49 @@ public:
                                     const struct audio_patch *audioPatch);
     void clearPatchConnections(Patch *patch);
 
+    /* Connect a source device to a sink device of another HW module without mixing */
+    status_t createDirectPatch(Patch *patch, const struct audio_patch *audioPatch);
+
+    // Software patch between two devices with the same sampling rate: the input and output
+    // streams are opened directly on the HALs and each period read is written as soon as it
+    // is converted in place to the output format, channel count and gain if needed.
+    // Compared to a RecordThread and a PlaybackThread connected by a PatchRecord and a
+    // PatchTrack, this adds a single period of latency and no mix cycle.
+    class DirectPatchThread : public Thread {
+    public:
+        DirectPatchThread(AudioHwDevice *inHwDev, const sp<StreamInHalInterface>& input,
+                          AudioHwDevice *outHwDev, const sp<StreamOutHalInterface>& output,
+                          float gain);
+        virtual ~DirectPatchThread();
+
+        status_t initCheck() const { return mStatus; }
+
+        /* Routing of the streams when the HALs support audio patches */
+        audio_patch_handle_t mInHalHandle;
+        audio_patch_handle_t mOutHalHandle;
+
+        /* Stops the transfer, releases the routing and puts the streams in standby */
+        void exit();
+
+    private:
+        virtual bool threadLoop();
+
+        AudioHwDevice * const           mInHwDev;
+        const sp<StreamInHalInterface>  mInput;
+        AudioHwDevice * const           mOutHwDev;
+        const sp<StreamOutHalInterface> mOutput;
+        const float                     mGain;
+        status_t                        mStatus;
+        audio_format_t                  mInFormat;
+        audio_format_t                  mOutFormat;
+        uint32_t                        mInChannelCount;
+        uint32_t                        mOutChannelCount;
+        size_t                          mInFrameSize;
+        size_t                          mFrameCount;    // frames read per period
+        bool                            mConvert;       // format, channels or gain differ
+        void                           *mBuffer;        // read and converted in place
+    };
+
     class Patch {
     public:
         explicit Patch(const struct audio_patch *patch) :
@@ -81,6 +125,9 @@ public:
         // handle for audio patch connecting playback thread output to sink device
         // created by createPatchConnections() and released by clearPatchConnections()
         audio_patch_handle_t            mPlaybackPatchHandle;
+        // thread created by createDirectPatch() and released by clearPatchConnections() when
+        // the software patch does not need a record and a playback thread
+        sp<DirectPatchThread>           mDirectPatchThread;
 
     };
 
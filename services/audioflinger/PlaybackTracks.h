@@ -48,6 +48,9 @@ public:
                              audio_session_t triggerSession = AUDIO_SESSION_NONE);
     virtual void        stop();
             void        pause();
+            // stop() and pause() as applied by the thread, must be called with its lock held
+            void        stop_l(PlaybackThread *playbackThread);
+            void        pause_l(PlaybackThread *playbackThread);
 
             void        flush();
             void        destroy();
@@ -159,6 +162,9 @@ public:
 
     int fastIndex() const { return mFastIndex; }
 
+    // time spent by the normal mixer on this track, sampled by the MixerThread
+    CostMeter& mixCost() { return mMixCost; }
+
 protected:
 
     // FILLED state is used for suppressing volume ramp at begin of playing
@@ -208,6 +214,7 @@ private:
     audio_output_flags_t mFlags;
     // If the last track change was notified to the client with readAndClearHasChanged
     std::atomic_flag     mChangeNotified = ATOMIC_FLAG_INIT;
+    CostMeter           mMixCost;
 };  // end of Track
 
 
@@ -115,7 +115,21 @@ int SpdifStreamOut::standby()
 
 ssize_t SpdifStreamOut::writeDataBurst(const void* buffer, size_t bytes)
 {
-    return AudioStreamOut::write(buffer, bytes);
+    // The encoder hands over one complete data burst and reuses its burst buffer as soon
+    // as we return, so a short write from the HAL would drop the end of the burst
+    // and the receiver would lose sync. Keep writing until the whole burst is accepted.
+    const uint8_t *data = (const uint8_t *) buffer;
+    size_t bytesWritten = 0;
+    while (bytesWritten < bytes) {
+        ssize_t ret = AudioStreamOut::write(data + bytesWritten, bytes - bytesWritten);
+        if (ret <= 0) {
+            ALOGW_IF(bytesWritten > 0, "writeDataBurst() burst truncated at %zu of %zu bytes,"
+                    " status %zd", bytesWritten, bytes, ret);
+            return bytesWritten > 0 ? (ssize_t) bytesWritten : ret;
+        }
+        bytesWritten += ret;
+    }
+    return bytesWritten;
 }
 
 ssize_t SpdifStreamOut::write(const void* buffer, size_t numBytes)
@@ -25,6 +25,7 @@
 #include <fcntl.h>
 #include <linux/futex.h>
 #include <sys/stat.h>
+#include <sched.h>
 #include <sys/syscall.h>
 #include <cutils/properties.h>
 #include <media/AudioParameter.h>
@@ -181,6 +182,16 @@ static const enum {
 static const int kPriorityAudioApp = 2;
 static const int kPriorityFastMixer = 3;
 static const int kPriorityFastCapture = 3;
+static const int kPriorityMixerWorker = 2;
+
+// Partitioned mixing for MixerThread, see AudioMixer::setParallelMix().
+// It is off unless af.mixer.parallel_tracks gives the track count to engage at.
+static const char * const kParallelMixTracksProperty = "af.mixer.parallel_tracks";
+static const char * const kParallelMixWorkersProperty = "af.mixer.parallel_workers";
+// comma separated cpus to pin the workers to, e.g. "2,3"
+static const char * const kParallelMixCpusProperty = "af.mixer.parallel_cpus";
+static const int kParallelMixWorkersDefault = 2;
+static const int kParallelMixWorkersMax = 7;
 
 // IAudioFlinger::createTrack() has an in/out parameter 'pFrameCount' for the total size of the
 // track buffer in shared memory.  Zero on input means to use a default value.  For fast tracks,
@@ -1681,8 +1692,18 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         mWriteAckSequence(0),
         mDrainSequence(0),
         mScreenState(AudioFlinger::mScreenState),
+        mUnderrunPrediction(false),
+        mProcessNsAvg(-1),
+        mPipeFramesBeforeWrite(-1),
+        mPipeFramesPrevious(-1),
+        mPipeDeepened(false),
+        mPipeHealthyNs(0),
+        mPipeDeepenedStartNs(0),
+        mPipeDeepenedTotalNs(0),
+        mPipeDeepenCount(0),
+        mMaxFastTracks(FastMixerState::getMaxFastTracks()),
         // index 0 is reserved for normal mixer's submix
-        mFastTrackAvailMask(((1 << FastMixerState::sMaxFastTracks) - 1) & ~1),
+        mFastTrackAvailMask(FastMixerState::trackMaskOf(mMaxFastTracks) & ~1ULL),
         mHwSupportsPause(false), mHwPaused(false), mFlushPending(false), mHwSupportsSuspend(false),
         mLeftVolFloat(-1.0), mRightVolFloat(-1.0)
 {
@@ -1726,7 +1747,9 @@ AudioFlinger::PlaybackThread::~PlaybackThread()
     mAudioFlinger->unregisterWriter(mNBLogWriter);
     free(mSinkBuffer);
     free(mMixerBuffer);
-    free(mEffectBuffer);
+    if (mEffectBufferHal == 0) {
+        free(mEffectBuffer);
+    }
 }
 
 void AudioFlinger::PlaybackThread::dump(int fd, const Vector<String16>& args)
@@ -1817,7 +1840,7 @@ void AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String16>&
     dprintf(fd, "  Sink buffer : %p\n", mSinkBuffer);
     dprintf(fd, "  Mixer buffer: %p\n", mMixerBuffer);
     dprintf(fd, "  Effect buffer: %p\n", mEffectBuffer);
-    dprintf(fd, "  Fast track availMask=%#x\n", mFastTrackAvailMask);
+    dprintf(fd, "  Fast track availMask=%#llx\n", (unsigned long long) mFastTrackAvailMask);
     dprintf(fd, "  Standby delay ns=%lld\n", (long long)mStandbyDelayNs);
     AudioStreamOut *output = mOutput;
     audio_output_flags_t flags = output != NULL ? output->flags : AUDIO_OUTPUT_FLAG_NONE;
@@ -1951,10 +1974,11 @@ sp<AudioFlinger::PlaybackThread::Track> AudioFlinger::PlaybackThread::createTrac
         ALOGV("AUDIO_OUTPUT_FLAG_FAST denied: sharedBuffer=%p frameCount=%zu "
                 "mFrameCount=%zu format=%#x mFormat=%#x isLinear=%d channelMask=%#x "
                 "sampleRate=%u mSampleRate=%u "
-                "hasFastMixer=%d tid=%d fastTrackAvailMask=%#x",
+                "hasFastMixer=%d tid=%d fastTrackAvailMask=%#llx",
                 sharedBuffer.get(), frameCount, mFrameCount, format, mFormat,
                 audio_is_linear_pcm(format),
-                channelMask, sampleRate, mSampleRate, hasFastMixer(), tid, mFastTrackAvailMask);
+                channelMask, sampleRate, mSampleRate, hasFastMixer(), tid,
+                (unsigned long long) mFastTrackAvailMask);
         *flags = (audio_output_flags_t)(*flags & ~AUDIO_OUTPUT_FLAG_FAST);
       }
     }
@@ -2375,9 +2399,9 @@ void AudioFlinger::PlaybackThread::removeTrack_l(const sp<Track>& track)
     mTracks.remove(track);
     if (track->isFastTrack()) {
         int index = track->mFastIndex;
-        ALOG_ASSERT(0 < index && index < (int)FastMixerState::sMaxFastTracks);
-        ALOG_ASSERT(!(mFastTrackAvailMask & (1 << index)));
-        mFastTrackAvailMask |= 1 << index;
+        ALOG_ASSERT(0 < index && index < (int)mMaxFastTracks);
+        ALOG_ASSERT(!(mFastTrackAvailMask & (1ULL << index)));
+        mFastTrackAvailMask |= 1ULL << index;
         // redundant as track is about to be destroyed, for dumpsys only
         track->mFastIndex = -1;
     }
@@ -2387,6 +2411,47 @@ void AudioFlinger::PlaybackThread::removeTrack_l(const sp<Track>& track)
     }
 }
 
+bool AudioFlinger::PlaybackThread::queueTrackCommand(Track *track, TrackCommand::Type type)
+{
+    TrackCommand command;
+    command.mType = type;
+    command.mTrack = track;
+    if (!mTrackCommands.push(command)) {
+        return false;
+    }
+    // A threadLoop() that is mixing sees the command within a cycle, it only needs a wake up
+    // if it is waiting for work. As it sets mWaitingForWork before it checks the queue
+    // one last time, either it sees the command or the command sees it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mWaitingForWork.load()) {
+        Mutex::Autolock _l(mLock);
+        broadcast_l();
+    }
+    return true;
+}
+
+// processTrackCommands_l() must be called with ThreadBase::mLock held
+void AudioFlinger::PlaybackThread::processTrackCommands_l(Vector< sp<Track> > *tracks)
+{
+    TrackCommand command;
+    while (mTrackCommands.pop(&command)) {
+        sp<Track> track = command.mTrack.promote();
+        if (track == 0) {
+            continue;
+        }
+        // the Track destructor takes mLock, the caller drops these references after it.
+        tracks->add(track);
+        switch (command.mType) {
+        case TrackCommand::PAUSE:
+            track->pause_l(this);
+            break;
+        case TrackCommand::STOP:
+            track->stop_l(this);
+            break;
+        }
+    }
+}
+
 String8 AudioFlinger::PlaybackThread::getParameters(const String8& keys)
 {
     Mutex::Autolock _l(mLock);
@@ -2578,6 +2643,10 @@ void AudioFlinger::PlaybackThread::readOutputParameters_l()
     mThreadThrottleEndMs = 0;
     mHalfBufferMs = mNormalFrameCount * 1000 / (2 * mSampleRate);
 
+    // Check if we want to deepen the FastMixer pipe ahead of predicted underruns
+    mUnderrunPrediction = mType == MIXER
+            && property_get_bool("af.thread.underrun_predict", true /* default_value */);
+
     // mSinkBuffer is the sink buffer.  Size is always multiple-of-16 frames.
     // Originally this was int16_t[] array, need to remove legacy implications.
     free(mSinkBuffer);
@@ -2597,13 +2666,26 @@ void AudioFlinger::PlaybackThread::readOutputParameters_l()
                 * audio_bytes_per_sample(mMixerBufferFormat);
         (void)posix_memalign(&mMixerBuffer, 32, mMixerBufferSize);
     }
-    free(mEffectBuffer);
+    if (mEffectBufferHal == 0) {
+        free(mEffectBuffer);
+    }
+    // effect chains still using the previous buffer keep it alive until moved below
+    mEffectBufferHal.clear();
     mEffectBuffer = NULL;
     if (mEffectBufferEnabled) {
         mEffectBufferFormat = EFFECT_BUFFER_FORMAT;
         mEffectBufferSize = mNormalFrameCount * mChannelCount
                 * audio_bytes_per_sample(mEffectBufferFormat);
-        (void)posix_memalign(&mEffectBuffer, 32, mEffectBufferSize);
+        if (mAudioFlinger->mEffectsFactoryHal != 0 &&
+                mAudioFlinger->mEffectsFactoryHal->allocateBuffer(
+                        mEffectBufferSize, &mEffectBufferHal) == OK) {
+            mEffectBuffer = mEffectBufferHal->audioBuffer()->raw;
+        } else {
+            ALOGW("%s: cannot allocate the effect buffer in HAL memory, effects will copy it",
+                    __func__);
+            mEffectBufferHal.clear();
+            (void)posix_memalign(&mEffectBuffer, 32, mEffectBufferSize);
+        }
     }
 
     // force reconfiguration of effect chains and engines to take new buffer size and audio
@@ -2846,11 +2928,13 @@ ssize_t AudioFlinger::PlaybackThread::threadLoop_write()
         uint32_t screenState = AudioFlinger::mScreenState;
         if (screenState != mScreenState) {
             mScreenState = screenState;
-            MonoPipe *pipe = (MonoPipe *)mPipeSink.get();
-            if (pipe != NULL) {
-                pipe->setAvgFrames((mScreenState & 1) ?
-                        (pipe->maxFrames() * 7) / 8 : mNormalFrameCount * 2);
-            }
+            updatePipeSetpoint();
+        }
+        if (mUnderrunPrediction && mNormalSink == mPipeSink) {
+            mPipeFramesPrevious = mPipeFramesBeforeWrite;
+            const ssize_t avail = mPipeSink->availableToWrite();
+            mPipeFramesBeforeWrite = avail >= 0 ?
+                    (ssize_t) ((MonoPipe *)mPipeSink.get())->maxFrames() - avail : -1;
         }
         ssize_t framesWritten = mNormalSink->write((char *)mSinkBuffer + offset, count);
         ATRACE_END();
@@ -2889,6 +2973,69 @@ ssize_t AudioFlinger::PlaybackThread::threadLoop_write()
     return bytesWritten;
 }
 
+void AudioFlinger::PlaybackThread::updatePipeSetpoint()
+{
+    MonoPipe *pipe = (MonoPipe *)mPipeSink.get();
+    if (pipe != NULL) {
+        pipe->setAvgFrames((mScreenState & 1) || mPipeDeepened ?
+                (pipe->maxFrames() * 7) / 8 : mNormalFrameCount * 2);
+    }
+}
+
+// Called by threadLoop() after each normal mixer write to mPipeSink
+void AudioFlinger::PlaybackThread::predictUnderrun(nsecs_t processNs, nsecs_t writeNs)
+{
+    const nsecs_t periodNs = seconds(mNormalFrameCount) / mSampleRate;
+    // exponential moving average with a weight of 1/8 for the newest cycle
+    mProcessNsAvg = mProcessNsAvg < 0 ? processNs : mProcessNsAvg + (processNs - mProcessNsAvg) / 8;
+
+    // The FastMixer is draining the pipe faster than we refill it: there was at least a normal
+    // period queued at the previous write, and now there is less than half of one.
+    const bool draining = mPipeFramesPrevious >= (ssize_t)mNormalFrameCount
+            && mPipeFramesBeforeWrite >= 0
+            && mPipeFramesBeforeWrite < (ssize_t)mNormalFrameCount / 2;
+    // MonoPipe::write() blocks for about one period by design, so only a write much longer
+    // than that means this thread was not scheduled in time.
+    const bool trouble = draining
+            || processNs > periodNs * 3 / 4
+            || mProcessNsAvg > periodNs / 2
+            || writeNs > periodNs * 2;
+
+    if (!mPipeDeepened) {
+        if (trouble) {
+            ATRACE_NAME("predicted underrun");
+            mPipeDeepened = true;
+            mPipeHealthyNs = 0;
+            mPipeDeepenedStartNs = systemTime();
+            mPipeDeepenCount++;
+            updatePipeSetpoint();
+            ALOGD("mixer(%p) predicted underrun, deepening pipe: mix %.2f ms (avg %.2f ms) "
+                    "write %.2f ms, %zd frames queued",
+                    this, processNs * 1e-6, mProcessNsAvg * 1e-6, writeNs * 1e-6,
+                    mPipeFramesBeforeWrite);
+        }
+    } else if (trouble || mProcessNsAvg > periodNs / 4) {
+        mPipeHealthyNs = 0;
+    } else if ((mPipeHealthyNs += periodNs) >= kPipeRecoverNs) {
+        mPipeDeepened = false;
+        mPipeDeepenedTotalNs += systemTime() - mPipeDeepenedStartNs;
+        updatePipeSetpoint();
+        ALOGD("mixer(%p) recovered, restoring pipe setpoint", this);
+    }
+}
+
+void AudioFlinger::PlaybackThread::resetUnderrunPrediction()
+{
+    if (mPipeDeepened) {
+        mPipeDeepened = false;
+        mPipeDeepenedTotalNs += systemTime() - mPipeDeepenedStartNs;
+        updatePipeSetpoint();
+    }
+    mProcessNsAvg = -1;
+    mPipeFramesBeforeWrite = -1;
+    mPipeFramesPrevious = -1;
+}
+
 void AudioFlinger::PlaybackThread::threadLoop_drain()
 {
     bool supportsDrain = false;
@@ -2983,13 +3130,18 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
 {
     audio_session_t session = chain->sessionId();
     sp<EffectBufferHalInterface> halInBuffer, halOutBuffer;
-    status_t result = mAudioFlinger->mEffectsFactoryHal->mirrorBuffer(
-            mEffectBufferEnabled ? mEffectBuffer : mSinkBuffer,
-            mEffectBufferEnabled ? mEffectBufferSize : mSinkBufferSize,
-            &halInBuffer);
-    if (result != OK) return result;
+    if (mEffectBufferEnabled && mEffectBufferHal != 0) {
+        // The effect buffer is already in HAL memory: all chains process it in place.
+        halInBuffer = mEffectBufferHal;
+    } else {
+        status_t result = mAudioFlinger->mEffectsFactoryHal->mirrorBuffer(
+                mEffectBufferEnabled ? mEffectBuffer : mSinkBuffer,
+                mEffectBufferEnabled ? mEffectBufferSize : mSinkBufferSize,
+                &halInBuffer);
+        if (result != OK) return result;
+    }
     halOutBuffer = halInBuffer;
-    effect_buffer_t *buffer = reinterpret_cast<effect_buffer_t*>(halInBuffer->externalData());
+    effect_buffer_t *buffer = reinterpret_cast<effect_buffer_t*>(halInBuffer->ptr());
     ALOGV("addEffectChain_l() %p on thread %p for session %d", chain.get(), this, session);
     if (session > AUDIO_SESSION_OUTPUT_MIX) {
         // Only one effect chain can be present in direct output thread and it uses
@@ -3182,12 +3334,15 @@ bool AudioFlinger::PlaybackThread::threadLoop()
         cpuStats.sample(myName);
 
         Vector< sp<EffectChain> > effectChains;
+        // released after mLock, see processTrackCommands_l()
+        Vector< sp<Track> > commandedTracks;
 
         { // scope for mLock
 
             Mutex::Autolock _l(mLock);
 
             processConfigEvents_l();
+            processTrackCommands_l(&commandedTracks);
 
             // See comment at declaration of logString for why this is done under mLock
             if (logString != NULL) {
@@ -3330,10 +3485,18 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                         break;
                     }
 
+                    // see queueTrackCommand()
+                    mWaitingForWork.store(true);
+                    if (!mTrackCommands.empty()) {
+                        mWaitingForWork.store(false);
+                        continue;
+                    }
+
                     releaseWakeLock_l();
                     // wait until we have something to do...
                     ALOGV("%s going to sleep", myName.string());
                     mWaitWorkCV.wait(mLock);
+                    mWaitingForWork.store(false);
                     ALOGV("%s waking up", myName.string());
                     acquireWakeLock_l();
 
@@ -3347,6 +3510,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                     mSleepTimeUs = mIdleSleepTimeUs;
                     if (mType == MIXER) {
                         sleepTimeShift = 0;
+                        resetUnderrunPrediction();
                     }
 
                     continue;
@@ -3368,6 +3532,8 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             lockEffectChains_l(effectChains);
         } // mLock scope ends
 
+        // start of mix and effects processing, for underrun prediction
+        const nsecs_t processStartNs = mUnderrunPrediction ? systemTime() : 0;
         if (mBytesRemaining == 0) {
             mCurrentWriteLength = 0;
             if (mMixerStatus == MIXER_TRACKS_READY) {
@@ -3492,6 +3658,11 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                         }
                     }
 
+                    if (mUnderrunPrediction && mNormalSink == mPipeSink
+                            && mMixerStatus == MIXER_TRACKS_READY && ret > 0) {
+                        predictUnderrun(mLastWriteTime - processStartNs, delta);
+                    }
+
                     if (mThreadThrottle
                             && mMixerStatus == MIXER_TRACKS_READY // we are mixing (active tracks)
                             && ret > 0) {                         // we wrote something
@@ -3804,7 +3975,9 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         // mAudioMixer below
         // mFastMixer below
         mFastMixerFutex(0),
-        mMasterMono(false)
+        mMasterMono(false),
+        mMixCount(0),
+        mDirectPassCandidateName(-1)
         // mOutputSink below
         // mPipeSink below
         // mNormalSink below
@@ -3815,6 +3988,10 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
             mSampleRate, mChannelMask, mChannelCount, mFormat, mFrameSize, mFrameCount,
             mNormalFrameCount);
     mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+    {
+        Mutex::Autolock _l(mLock);
+        setUpParallelMix_l();
+    }
 
     if (type == DUPLICATING) {
         // The Duplicating thread uses the AudioMixer and delivers data to OutputTracks
@@ -3917,7 +4094,7 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
 #endif
 
         // create fast mixer and configure it initially with just one fast track for our submix
-        mFastMixer = new FastMixer();
+        mFastMixer = new FastMixer(mMaxFastTracks);
         FastMixerStateQueue *sq = mFastMixer->sq();
 #ifdef STATE_QUEUE_DUMP
         sq->setObserverDump(&mStateQueueObserverDump);
@@ -3984,6 +4161,47 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
     mIdleTimeOffsetUs = 0;
 }
 
+void AudioFlinger::MixerThread::setUpParallelMix_l()
+{
+    const int32_t minTracks = property_get_int32(kParallelMixTracksProperty, 0);
+    if (minTracks <= 0) {
+        return;
+    }
+    const int32_t numWorkers = property_get_int32(kParallelMixWorkersProperty,
+            kParallelMixWorkersDefault);
+    if (numWorkers <= 0 || numWorkers > kParallelMixWorkersMax) {
+        ALOGW("ignoring %s=%d", kParallelMixWorkersProperty, numWorkers);
+        return;
+    }
+
+    std::vector<int> cpus;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get(kParallelMixCpusProperty, value, NULL) > 0) {
+        const char *s = value;
+        while (*s != '\0' && cpus.size() < (size_t)numWorkers) {
+            char *end;
+            const long cpu = strtol(s, &end, 10);
+            if (end == s || cpu < 0 || cpu >= CPU_SETSIZE || (*end != ',' && *end != '\0')) {
+                ALOGW("ignoring malformed %s=%s", kParallelMixCpusProperty, value);
+                cpus.clear();
+                break;
+            }
+            cpus.push_back((int)cpu);
+            s = *end == ',' ? end + 1 : end;
+        }
+    }
+
+    status_t status = mAudioMixer->setParallelMix(minTracks, numWorkers, cpus);
+    if (status != NO_ERROR) {
+        ALOGW("cannot set up parallel mix: %d", status);
+        return;
+    }
+    for (const pid_t tid : mAudioMixer->parallelMixTids()) {
+        sendPrioConfigEvent_l(getpid_cached, tid, kPriorityMixerWorker, false /*forApp*/);
+    }
+    ALOGI("parallel mix of %d tracks or more on %d workers", minTracks, numWorkers);
+}
+
 AudioFlinger::MixerThread::~MixerThread()
 {
     if (mFastMixer != 0) {
@@ -4166,7 +4384,12 @@ void AudioFlinger::PlaybackThread::onAsyncError()
 void AudioFlinger::MixerThread::threadLoop_mix()
 {
     // mix buffers...
-    mAudioMixer->process();
+    if (mDirectPassTrack != 0) {
+        threadLoop_directPass();
+    } else {
+        mAudioMixer->process();
+        updateMixCost();
+    }
     mCurrentWriteLength = mSinkBufferSize;
     // increase sleep time progressively when application underrun condition clears.
     // Only increase sleep time if the mixer is ready for two consecutive times to avoid
@@ -4181,6 +4404,60 @@ void AudioFlinger::MixerThread::threadLoop_mix()
 
 }
 
+// updateMixCost() must be called right after mAudioMixer->process(), from the threadLoop()
+void AudioFlinger::MixerThread::updateMixCost()
+{
+    mMixCount++;
+    if (mTimedTracks.isEmpty()) {
+        return;
+    }
+    for (size_t i = 0; i < mTimedTracks.size(); i++) {
+        sp<Track> track = mTimedTracks[i].promote();
+        if (track == 0) {
+            continue;
+        }
+        if (track->mixCost().add(mAudioMixer->getTrackMixNs(track->name()))) {
+            // a full window, also have it in the NBLog
+            const CostMeter::Stats cost = track->mixCost().getStats();
+            LOGT("track %d mix cost avg %f us p99 %f us",
+                    track->name(), cost.mAverageUs, cost.mP99Us);
+        }
+    }
+    mTimedTracks.clear();
+    mAudioMixer->setTrackTiming(false);
+}
+
+void AudioFlinger::MixerThread::threadLoop_directPass()
+{
+    const sp<Track> track = mDirectPassTrack;
+    // Write to the sink directly unless the mix buffer must still feed the output mix
+    // effects or the mono blend, in which case threadLoop() converts it as usual.
+    const bool toMixerBuffer = mMixerBufferValid && (mEffectBufferValid || requireMonoBlend());
+    void *dst = toMixerBuffer ? mMixerBuffer : mSinkBuffer;
+    const audio_format_t dstFormat = toMixerBuffer ? mMixerBufferFormat : mFormat;
+    const size_t dstFrameSize = mChannelCount * audio_bytes_per_sample(dstFormat);
+
+    size_t framesDone = 0;
+    while (framesDone < mNormalFrameCount) {
+        AudioBufferProvider::Buffer buffer;
+        buffer.frameCount = mNormalFrameCount - framesDone;
+        if (track->getNextBuffer(&buffer) != NO_ERROR || buffer.frameCount == 0) {
+            break;
+        }
+        memcpy_by_audio_format((uint8_t *)dst + framesDone * dstFrameSize, dstFormat,
+                buffer.raw, track->format(), buffer.frameCount * mChannelCount);
+        framesDone += buffer.frameCount;
+        track->releaseBuffer(&buffer);
+    }
+    if (framesDone < mNormalFrameCount) {
+        memset((uint8_t *)dst + framesDone * dstFrameSize, 0,
+                (mNormalFrameCount - framesDone) * dstFrameSize);
+    }
+    if (!toMixerBuffer) {
+        mMixerBufferValid = false;
+    }
+}
+
 void AudioFlinger::MixerThread::threadLoop_sleepTime()
 {
     // If no tracks are ready, sleep once for the duration of an output
@@ -4250,9 +4527,15 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
     size_t count = mActiveTracks.size();
     size_t mixedTracks = 0;
     size_t tracksWithEffect = 0;
+    sp<Track> directPassTrack;
+    // the mix of the tracks enabled below is timed for one in kSamplePeriod buffers
+    const bool timeTracks = mMixCount % CostMeter::kSamplePeriod == 0;
+    mTimedTracks.clear();
+    mAudioMixer->setTrackTiming(timeTracks);
     // counts only _active_ fast tracks
     size_t fastTracks = 0;
-    uint32_t resetMask = 0; // bit mask of fast tracks that need to be reset
+    // fast tracks that need to be reset, more than fit in a mask may be active
+    Vector< sp<Track> > tracksToReset;
 
     float masterVolume = mMasterVolume;
     bool masterMute = mMasterMute;
@@ -4300,8 +4583,8 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
             // at the identical fast mixer slot within the same normal mix cycle,
             // is impossible because the slot isn't marked available until the end of each cycle.
             int j = track->mFastIndex;
-            ALOG_ASSERT(0 < j && j < (int)FastMixerState::sMaxFastTracks);
-            ALOG_ASSERT(!(mFastTrackAvailMask & (1 << j)));
+            ALOG_ASSERT(0 < j && j < (int)mMaxFastTracks);
+            ALOG_ASSERT(!(mFastTrackAvailMask & (1ULL << j)));
             FastTrack *fastTrack = &state->mFastTracks[j];
 
             // Determine whether the track is currently in underrun condition,
@@ -4398,7 +4681,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                     // Can't reset directly, as fast mixer is still polling this track
                     //   track->reset();
                     // So instead mark this track as needing to be reset after push with ack
-                    resetMask |= 1 << i;
+                    tracksToReset.add(t);
                 }
                 isActive = false;
                 break;
@@ -4409,7 +4692,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
 
             if (isActive) {
                 // was it previously inactive?
-                if (!(state->mTrackMask & (1 << j))) {
+                if (!(state->mTrackMask & (1ULL << j))) {
                     ExtendedAudioBufferProvider *eabp = track;
                     VolumeProvider *vp = track;
                     fastTrack->mBufferProvider = eabp;
@@ -4417,7 +4700,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                     fastTrack->mChannelMask = track->mChannelMask;
                     fastTrack->mFormat = track->mFormat;
                     fastTrack->mGeneration++;
-                    state->mTrackMask |= 1 << j;
+                    state->mTrackMask |= 1ULL << j;
                     didModify = true;
                     // no acknowledgement required for newly active tracks
                 }
@@ -4437,10 +4720,10 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 ++fastTracks;
             } else {
                 // was it previously active?
-                if (state->mTrackMask & (1 << j)) {
+                if (state->mTrackMask & (1ULL << j)) {
                     fastTrack->mBufferProvider = NULL;
                     fastTrack->mGeneration++;
-                    state->mTrackMask &= ~(1 << j);
+                    state->mTrackMask &= ~(1ULL << j);
                     didModify = true;
                     // If any fast tracks were removed, we must wait for acknowledgement
                     // because we're about to decrement the last sp<> on those tracks.
@@ -4452,8 +4735,9 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                     // FastTrack state hasn't had time to update.
                     // TODO Remove the ALOGW when this theory is confirmed.
                     ALOGW("fast track %d should have been active; "
-                            "mState=%d, mTrackMask=%#x, recentUnderruns=%u, isShared=%d",
-                            j, track->mState, state->mTrackMask, recentUnderruns,
+                            "mState=%d, mTrackMask=%#llx, recentUnderruns=%u, isShared=%d",
+                            j, track->mState, (unsigned long long) state->mTrackMask,
+                            recentUnderruns,
                             track->sharedBuffer() != 0);
                     // Since the FastMixer state already has the track inactive, do nothing here.
                 }
@@ -4498,8 +4782,10 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
         const uint32_t sampleRate = track->mAudioTrackServerProxy->getSampleRate();
         AudioPlaybackRate playbackRate = track->mAudioTrackServerProxy->getPlaybackRate();
 
-        desiredFrames = sourceFramesNeededWithTimestretch(
+        // track frames consumed by one mix buffer
+        const size_t mixSourceFrames = sourceFramesNeededWithTimestretch(
                 sampleRate, mNormalFrameCount, mSampleRate, playbackRate.mSpeed);
+        desiredFrames = mixSourceFrames;
         // TODO: ONLY USED FOR LEGACY RESAMPLERS, remove when they are removed.
         // add frames already consumed but not yet released by the resampler
         // because mAudioTrackServerProxy->framesReady() will include these frames
@@ -4564,6 +4850,11 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 param = AudioMixer::RAMP_VOLUME;
             }
 
+            // the volume, send level and playback rate are applied together,
+            // as last set by the client
+            const AudioTrackMixParameters mixParameters =
+                    track->mAudioTrackServerProxy->getMixParameters();
+
             // compute volume for this track
             uint32_t vl, vr;       // in U8.24 integer format
             float vlf, vrf, vaf;   // in [0.0, 1.0] float format
@@ -4578,8 +4869,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                     track->setPaused();
                 }
             } else {
-                sp<AudioTrackServerProxy> proxy = track->mAudioTrackServerProxy;
-                gain_minifloat_packed_t vlr = proxy->getVolumeLR();
+                gain_minifloat_packed_t vlr = mixParameters.mVolumeLR;
                 vlf = float_from_gain(gain_minifloat_unpack_left(vlr));
                 vrf = float_from_gain(gain_minifloat_unpack_right(vlr));
                 // track volumes come from shared memory, so can't be trusted and must be clamped
@@ -4591,8 +4881,11 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                     ALOGV("Track right volume out of range: %.3g", vrf);
                     vrf = GAIN_FLOAT_UNITY;
                 }
+                // The shapers are evaluated at the end of the buffer about to be mixed, so that
+                // with a volume ramp the mixer follows their curves linearly across the buffer
+                // rather than stepping to the value at its start one buffer late.
                 const float vh = track->getVolumeHandler()->getVolume(
-                        track->mAudioTrackServerProxy->framesReleased()).first;
+                        track->mAudioTrackServerProxy->framesReleased(), mixSourceFrames).first;
                 // now apply the master volume and stream type volume and shaper volume
                 vlf *= v * vh;
                 vrf *= v * vh;
@@ -4602,7 +4895,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 vl = (uint32_t) (scaleto8_24 * vlf);
                 vr = (uint32_t) (scaleto8_24 * vrf);
                 // vl and vr are now in U8.24 format
-                uint16_t sendLevel = proxy->getSendLevel_U4_12();
+                uint16_t sendLevel = mixParameters.mSendLevel;
                 // send level comes from shared memory and so may be corrupt
                 if (sendLevel > MAX_GAIN_INT) {
                     ALOGV("Track send level out of range: %04X", sendLevel);
@@ -4653,6 +4946,9 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
             // XXX: these things DON'T need to be done each time
             mAudioMixer->setBufferProvider(name, track);
             mAudioMixer->enable(name);
+            if (timeTracks) {
+                mTimedTracks.add(track);
+            }
 
             mAudioMixer->setParameter(name, param, AudioMixer::VOLUME0, &vlf);
             mAudioMixer->setParameter(name, param, AudioMixer::VOLUME1, &vrf);
@@ -4683,13 +4979,25 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 AudioMixer::SAMPLE_RATE,
                 (void *)(uintptr_t)reqSampleRate);
 
-            AudioPlaybackRate playbackRate = track->mAudioTrackServerProxy->getPlaybackRate();
+            AudioPlaybackRate playbackRate = mixParameters.mPlaybackRate;
             mAudioMixer->setParameter(
                 name,
                 AudioMixer::TIMESTRETCH,
                 AudioMixer::PLAYBACK_RATE,
                 &playbackRate);
 
+            // A duplicated OutputTrack is already mixed by the DuplicatingThread; if it needs
+            // no gain, resampling, remix or effects here it can bypass mAudioMixer.
+            if (track->isOutputTrack()
+                    && (track->mainBuffer() == mSinkBuffer
+                            || track->mainBuffer() == mMixerBuffer)
+                    && vlf == GAIN_FLOAT_UNITY && vrf == GAIN_FLOAT_UNITY && vaf == 0.0f
+                    && track->channelMask() == mChannelMask
+                    && reqSampleRate == mSampleRate
+                    && isAudioPlaybackRateEqual(playbackRate, AUDIO_PLAYBACK_RATE_DEFAULT)) {
+                directPassTrack = track;
+            }
+
             /*
              * Select the appropriate output buffer for the track.
              *
@@ -4834,11 +5142,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
 #endif
 
     // Now perform the deferred reset on fast tracks that have stopped
-    while (resetMask != 0) {
-        size_t i = __builtin_ctz(resetMask);
-        ALOG_ASSERT(i < count);
-        resetMask &= ~(1 << i);
-        sp<Track> track = mActiveTracks[i];
+    for (const sp<Track> &track : tracksToReset) {
         ALOG_ASSERT(track->isFastTrack() && track->isStopped());
         track->reset();
     }
@@ -4858,6 +5162,16 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
     // remove all the tracks that need to be...
     removeTracks_l(*tracksToRemove);
 
+    // Bypass the mixer only when the OutputTrack is the sole contributor to this buffer.
+    const int directPassName = (directPassTrack != 0 && mixedTracks == 1 && fastTracks == 0)
+            ? directPassTrack->name() : -1;
+    if (directPassName != -1 && directPassName == mDirectPassCandidateName) {
+        mDirectPassTrack = directPassTrack;
+    } else {
+        mDirectPassTrack.clear();
+    }
+    mDirectPassCandidateName = directPassName;
+
     if (getEffectChain_l(AUDIO_SESSION_OUTPUT_MIX) != 0) {
         mEffectBufferValid = true;
     }
@@ -5019,6 +5333,7 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
             readOutputParameters_l();
             delete mAudioMixer;
             mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+            setUpParallelMix_l();
             for (const auto &track : mTracks) {
                 const int name = track->name();
                 status_t status = mAudioMixer->create(
@@ -5046,6 +5361,17 @@ void AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>& ar
     dprintf(fd, "  Thread throttle time (msecs): %u\n", mThreadThrottleTimeMs);
     dprintf(fd, "  AudioMixer tracks: %s\n", mAudioMixer->trackNames().c_str());
     dprintf(fd, "  Master mono: %s\n", mMasterMono ? "on" : "off");
+    dprintf(fd, "  Duplicated direct pass: %s\n", mDirectPassTrack != 0 ? "on" : "off");
+    if (mUnderrunPrediction && mPipeSink != 0) {
+        nsecs_t deepenedNs = mPipeDeepenedTotalNs;
+        if (mPipeDeepened) {
+            deepenedNs += systemTime() - mPipeDeepenedStartNs;
+        }
+        dprintf(fd, "  Underrun prediction: pipe %s, deepened %u times for %.3f s,"
+                " avg mix %.2f ms\n",
+                mPipeDeepened ? "deepened" : "normal", mPipeDeepenCount, deepenedNs * 1e-9,
+                mProcessNsAvg < 0 ? 0. : mProcessNsAvg * 1e-6);
+    }
 
     if (hasFastMixer()) {
         dprintf(fd, "  FastMixer thread %p tid=%d", mFastMixer.get(), mFastMixer->getTid());
@@ -6133,6 +6459,7 @@ void AudioFlinger::DuplicatingThread::threadLoop_mix()
     // mix buffers...
     if (outputsReady(outputTracks)) {
         mAudioMixer->process();
+        updateMixCost();
     } else {
         if (mMixerBufferValid) {
             memset(mMixerBuffer, 0, mMixerBufferSize);
@@ -6826,6 +7153,19 @@ reacquire_wakelock:
 
         size = activeTracks.size();
 
+        // Conversions done during this pass: a track converting the same way from the same
+        // position in mRsmpInBuffer copies the output instead of converting again.
+        struct SharedConversion {
+            const RecordBufferConverter *converter;
+            int32_t front;
+            size_t frames;
+            const void *data;
+        };
+        static constexpr size_t kMaxSharedConversions = 4;
+        SharedConversion sharedConversions[kMaxSharedConversions];
+        size_t sharedConversionCount;   // not initialized here, a goto jumps over
+        sharedConversionCount = 0;
+
         // loop over each active track
         for (size_t i = 0; i < size; i++) {
             activeTrack = activeTracks[i];
@@ -6871,9 +7211,36 @@ reacquire_wakelock:
                 framesOut = min(framesOut,
                         destinationFramesPossible(
                                 framesIn, mSampleRate, activeTrack->mSampleRate));
-                // process frames from the RecordThread buffer provider to the RecordTrack buffer
-                framesOut = activeTrack->mRecordBufferConverter->convert(
-                        activeTrack->mSink.raw, activeTrack->mResamplerBufferProvider, framesOut);
+                const int32_t front = activeTrack->mResamplerBufferProvider->getFront();
+                const SharedConversion *shared = NULL;
+                for (size_t j = 0; j < sharedConversionCount; j++) {
+                    if (sharedConversions[j].front == front
+                            && sharedConversions[j].converter->isSharableWith(
+                                    *activeTrack->mRecordBufferConverter)) {
+                        shared = &sharedConversions[j];
+                        break;
+                    }
+                }
+                if (shared != NULL) {
+                    // same rate in and out: as many frames consumed as produced
+                    framesOut = min(framesOut, shared->frames);
+                    memcpy(activeTrack->mSink.raw, shared->data,
+                            framesOut * activeTrack->mRecordBufferConverter->getDstFrameSize());
+                    activeTrack->mResamplerBufferProvider->skip(framesOut);
+                } else {
+                    // process frames from the RecordThread buffer provider to the
+                    // RecordTrack buffer
+                    framesOut = activeTrack->mRecordBufferConverter->convert(
+                            activeTrack->mSink.raw, activeTrack->mResamplerBufferProvider,
+                            framesOut);
+                    // a silenced track's buffer is cleared below, it can't be shared
+                    if (framesOut > 0 && !activeTrack->isSilenced()
+                            && sharedConversionCount < kMaxSharedConversions) {
+                        sharedConversions[sharedConversionCount++] = {
+                                activeTrack->mRecordBufferConverter, front, framesOut,
+                                activeTrack->mSink.raw };
+                    }
+                }
 
                 if (framesOut > 0 && (overrun == OVERRUN_UNKNOWN)) {
                     overrun = OVERRUN_FALSE;
@@ -7518,6 +7885,13 @@ void AudioFlinger::RecordThread::ResamplerBufferProvider::sync(
     }
 }
 
+// AudioBufferProvider interface
+void AudioFlinger::RecordThread::ResamplerBufferProvider::skip(size_t frames)
+{
+    ALOG_ASSERT(mRsmpInUnrel == 0);
+    mRsmpInFront += frames;
+}
+
 // AudioBufferProvider interface
 status_t AudioFlinger::RecordThread::ResamplerBufferProvider::getNextBuffer(
         AudioBufferProvider::Buffer* buffer)
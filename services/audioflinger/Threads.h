@@ -856,6 +856,11 @@ protected:
     // Due to constraints on mNormalFrameCount, the buffer size is a multiple of 16 frames.
     void*                           mEffectBuffer;
 
+    // Effect HAL shared memory holding mEffectBuffer, so that all effect chains of the thread
+    // process it in place instead of copying it in and out of a mirror every cycle.
+    // Null when it could not be allocated, mEffectBuffer is then from posix_memalign().
+    sp<EffectBufferHalInterface>    mEffectBufferHal;
+
     // Size of mEffectsBuffer in bytes: mNormalFrameCount * #channels * sampsize.
     size_t                          mEffectBufferSize;
 
@@ -927,6 +932,26 @@ private:
     bool        destroyTrack_l(const sp<Track>& track);
     void        removeTrack_l(const sp<Track>& track);
 
+    // Track pause() and stop() requests from binder threads are queued and applied at
+    // the top of the next threadLoop() cycle, so that the binder threads don't wait for
+    // mLock, which the threadLoop() holds while it prepares the tracks of each cycle.
+    struct TrackCommand {
+        enum Type { PAUSE, STOP };
+        Type        mType = PAUSE;
+        wp<Track>   mTrack;
+    };
+    static const size_t kTrackCommandQueueSize = 64;
+
+    // returns false if the queue is full, the caller then applies the command under mLock
+    bool        queueTrackCommand(Track *track, TrackCommand::Type type);
+    // Applies the queued commands, must be called with mLock held before any other
+    // change to the state of the tracks so that they stay in order. The tracks commanded
+    // are added to tracks, which must only be cleared once mLock is released.
+    void        processTrackCommands_l(Vector< sp<Track> > *tracks);
+
+    CommandQueue<TrackCommand, kTrackCommandQueueSize> mTrackCommands;
+    std::atomic_bool mWaitingForWork{false};   // threadLoop() is waiting on mWaitWorkCV
+
     void        readOutputParameters_l();
     void        updateMetadata_l() final;
     virtual void sendMetadataToBackend_l(const StreamOutHalInterface::SourceMetadata& metadata);
@@ -1061,6 +1086,24 @@ private:
     sp<NBAIO_Source>        mTeeSource;
 #endif
     uint32_t                mScreenState;   // cached copy of gScreenState
+
+    // Lookahead underrun prediction, for a normal mixer writing to the FastMixer via mPipeSink.
+    // When the mix time trends towards the normal period, or the FastMixer is draining the pipe
+    // faster than it is refilled, the pipe setpoint is deepened as if the screen were off,
+    // and restored once the mix time has stayed low for kPipeRecoverNs.
+    static const nsecs_t    kPipeRecoverNs = 2000000000LL;
+                void        updatePipeSetpoint();
+                void        predictUnderrun(nsecs_t processNs, nsecs_t writeNs);
+                void        resetUnderrunPrediction();
+    bool                    mUnderrunPrediction;    // from property af.thread.underrun_predict
+    nsecs_t                 mProcessNsAvg;          // smoothed mix and effects time, or -1
+    ssize_t                 mPipeFramesBeforeWrite; // pipe fill at start of last write, or -1
+    ssize_t                 mPipeFramesPrevious;    // same for the write before, or -1
+    bool                    mPipeDeepened;
+    nsecs_t                 mPipeHealthyNs;         // time without trouble while deepened
+    nsecs_t                 mPipeDeepenedStartNs;
+    nsecs_t                 mPipeDeepenedTotalNs;   // excluding the current deepening
+    uint32_t                mPipeDeepenCount;
     // TODO: add comment and adjust size as needed
     static const size_t     kFastMixerLogSize = 8 * 1024;
     sp<NBLog::Writer>       mFastMixerNBLogWriter;
@@ -1072,8 +1115,10 @@ public:
                                 { FastTrackUnderruns dummy; return dummy; }
 
 protected:
+                // number of fast track slots, including the normal mixer's submix, fixed at creation
+                const unsigned mMaxFastTracks;
                 // accessed by both binder threads and within threadLoop(), lock on mutex needed
-                unsigned    mFastTrackAvailMask;    // bit i set if fast track [i] is available
+                uint64_t    mFastTrackAvailMask;    // bit i set if fast track [i] is available
                 bool        mHwSupportsPause;
                 bool        mHwPaused;
                 bool        mFlushPending;
@@ -1129,6 +1174,13 @@ protected:
                                    audio_patch_handle_t *handle);
     virtual     status_t    releaseAudioPatch_l(const audio_patch_handle_t handle);
 
+                // records the time spent on each track by the last timed mAudioMixer->process()
+                void        updateMixCost();
+
+                // replaces mAudioMixer->process() when prepareTracks_l() selected
+                // mDirectPassTrack: converts its frames straight into the sink buffer.
+                void        threadLoop_directPass();
+
                 AudioMixer* mAudioMixer;    // normal mixer
 private:
                 // one-time initialization, no locks required
@@ -1149,10 +1201,26 @@ private:
                 int64_t     mIdleTimeOffsetUs;
 
                 std::atomic_bool mMasterMono;
+
+                // accessible only within the threadLoop(), no locks required
+                uint32_t    mMixCount;          // buffers mixed, every kSamplePeriod-th is timed
+                Vector< wp<Track> > mTimedTracks; // tracks whose mix is timed in this buffer
+
+                // accessible only within the threadLoop(), no locks required
+                // Non-0 when the only track to mix is a DuplicatingThread OutputTrack already in
+                // this thread's channel mask and sample rate at unity gain; the mixer pass is
+                // then skipped. The track must have been eligible for two consecutive buffers
+                // so that any volume ramp started by mAudioMixer has completed.
+                sp<Track>   mDirectPassTrack;
+                int         mDirectPassCandidateName; // eligible in the previous buffer, or -1
+
+                // enables partitioned mixing on mAudioMixer if configured, see
+                // kParallelMix* in Threads.cpp.
+                void        setUpParallelMix_l();
 public:
     virtual     bool        hasFastMixer() const { return mFastMixer != 0; }
     virtual     FastTrackUnderruns getFastTrackUnderruns(size_t fastIndex) const {
-                              ALOG_ASSERT(fastIndex < FastMixerState::sMaxFastTracks);
+                              ALOG_ASSERT(fastIndex < mMaxFastTracks);
                               return mFastMixerDumpState.mTracks[fastIndex].mUnderruns;
                             }
 
@@ -1364,6 +1432,12 @@ public:
 
         virtual void sync(size_t *framesAvailable = NULL, bool *hasOverrun = NULL);
 
+        // next frame to be provided, as a rolling counter of the RecordThread data buffer
+        int32_t getFront() const { return mRsmpInFront; }
+
+        // advances by frames without providing them, they must be available after sync()
+        void skip(size_t frames);
+
         // AudioBufferProvider interface
         virtual status_t    getNextBuffer(AudioBufferProvider::Buffer* buffer);
         virtual void        releaseBuffer(AudioBufferProvider::Buffer* buffer);
@@ -444,14 +444,14 @@ AudioFlinger::PlaybackThread::Track::Track(
         // static fast tracks (SoundPool) immediately after stopping.
         //mAudioTrackServerProxy->framesReadyIsCalledByMultipleThreads();
         ALOG_ASSERT(thread->mFastTrackAvailMask != 0);
-        int i = __builtin_ctz(thread->mFastTrackAvailMask);
-        ALOG_ASSERT(0 < i && i < (int)FastMixerState::sMaxFastTracks);
+        int i = __builtin_ctzll(thread->mFastTrackAvailMask);
+        ALOG_ASSERT(0 < i && i < (int)thread->mMaxFastTracks);
         // FIXME This is too eager.  We allocate a fast track index before the
         //       fast track becomes active.  Since fast tracks are a scarce resource,
         //       this means we are potentially denying other more important fast tracks from
         //       being created.  It would be better to allocate the index dynamically.
         mFastIndex = i;
-        thread->mFastTrackAvailMask &= ~(1 << i);
+        thread->mFastTrackAvailMask &= ~(1ULL << i);
     }
     mName = TRACK_NAME_PENDING;
 }
@@ -493,8 +493,10 @@ void AudioFlinger::PlaybackThread::Track::destroy()
         bool wasActive = false;
         sp<ThreadBase> thread = mThread.promote();
         if (thread != 0) {
+            Vector< sp<Track> > commandedTracks; // released after mLock
             Mutex::Autolock _l(thread->mLock);
             PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
+            playbackThread->processTrackCommands_l(&commandedTracks);
             wasActive = playbackThread->destroyTrack_l(this);
         }
         if (isExternalTrack() && !wasActive) {
@@ -509,7 +511,7 @@ void AudioFlinger::PlaybackThread::Track::destroy()
                   "  Format Chn mask  SRate "
                   "ST  L dB  R dB  VS dB "
                   "  Server FrmCnt  FrmRdy F Underruns  Flushed "
-                  "Main Buf  Aux Buf\n");
+                  "Main Buf  Aux Buf  MixAvg  MixP99\n");
 }
 
 void AudioFlinger::PlaybackThread::Track::appendDump(String8& result, bool active)
@@ -593,11 +595,14 @@ void AudioFlinger::PlaybackThread::Track::appendDump(String8& result, bool activ
             ? 'r' /* buffer reduced */: bufferSizeInFrames > mFrameCount
                     ? 'e' /* error */ : ' ' /* identical */;
 
+    // mix cost in microseconds per buffer, only sampled for tracks of the normal mixer
+    const CostMeter::Stats mixCost = mMixCost.getStats();
+
     result.appendFormat("%7s %6u %7u %2s 0x%03X "
                            "%08X %08X %6u "
                            "%2u %5.2g %5.2g %5.2g%c "
                            "%08X %6zu%c %6zu %c %9u%c %7u "
-                           "%08zX %08zX\n",
+                           "%08zX %08zX %7.1f %7.1f\n",
             active ? "yes" : "no",
             (mClient == 0) ? getpid_cached : mClient->pid(),
             mSessionId,
@@ -624,7 +629,10 @@ void AudioFlinger::PlaybackThread::Track::appendDump(String8& result, bool activ
             (unsigned)mAudioTrackServerProxy->framesFlushed() % 10000000,
 
             (size_t)mMainBuffer, // use %zX as %p appends 0x
-            (size_t)mAuxBuffer   // use %zX as %p appends 0x
+            (size_t)mAuxBuffer,  // use %zX as %p appends 0x
+
+            mixCost.mAverageUs,
+            mixCost.mP99Us
             );
 }
 
@@ -725,7 +733,11 @@ status_t AudioFlinger::PlaybackThread::Track::start(AudioSystem::sync_event_t ev
                 return PERMISSION_DENIED;
             }
         }
+        Vector< sp<Track> > commandedTracks; // released after mLock
         Mutex::Autolock _lth(thread->mLock);
+        // a pause() or stop() still queued must not apply after this start()
+        PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
+        playbackThread->processTrackCommands_l(&commandedTracks);
         track_state state = mState;
         // here the track could be either new, or restarted
         // in both cases "unstop" the track
@@ -752,7 +764,6 @@ status_t AudioFlinger::PlaybackThread::Track::start(AudioSystem::sync_event_t ev
                 && (state == IDLE || state == STOPPED || state == FLUSHED)) {
             mFrameMap.reset();
         }
-        PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
         if (isFastTrack()) {
             // refresh fast track underruns on start because that field is never cleared
             // by the fast mixer; furthermore, the same track can be recycled, i.e. start
@@ -798,30 +809,43 @@ void AudioFlinger::PlaybackThread::Track::stop()
     ALOGV("stop(%d), calling pid %d", mName, IPCThreadState::self()->getCallingPid());
     sp<ThreadBase> thread = mThread.promote();
     if (thread != 0) {
+        PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
+        // offloaded and direct tracks are stopped right away, as their stop reaches the HAL
+        if (!isOffloaded() && !isDirect()
+                && playbackThread->queueTrackCommand(this, PlaybackThread::TrackCommand::STOP)) {
+            return;
+        }
+        Vector< sp<Track> > commandedTracks; // released after mLock
         Mutex::Autolock _l(thread->mLock);
-        track_state state = mState;
-        if (state == RESUMING || state == ACTIVE || state == PAUSING || state == PAUSED) {
-            // If the track is not active (PAUSED and buffers full), flush buffers
-            PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
-            if (playbackThread->mActiveTracks.indexOf(this) < 0) {
-                reset();
-                mState = STOPPED;
-            } else if (!isFastTrack() && !isOffloaded() && !isDirect()) {
-                mState = STOPPED;
-            } else {
-                // For fast tracks prepareTracks_l() will set state to STOPPING_2
-                // presentation is complete
-                // For an offloaded track this starts a drain and state will
-                // move to STOPPING_2 when drain completes and then STOPPED
-                mState = STOPPING_1;
-                if (isOffloaded()) {
-                    mRetryCount = PlaybackThread::kMaxTrackStopRetriesOffload;
-                }
+        playbackThread->processTrackCommands_l(&commandedTracks);
+        stop_l(playbackThread);
+    }
+}
+
+// must be called with thread lock held
+void AudioFlinger::PlaybackThread::Track::stop_l(PlaybackThread *playbackThread)
+{
+    track_state state = mState;
+    if (state == RESUMING || state == ACTIVE || state == PAUSING || state == PAUSED) {
+        // If the track is not active (PAUSED and buffers full), flush buffers
+        if (playbackThread->mActiveTracks.indexOf(this) < 0) {
+            reset();
+            mState = STOPPED;
+        } else if (!isFastTrack() && !isOffloaded() && !isDirect()) {
+            mState = STOPPED;
+        } else {
+            // For fast tracks prepareTracks_l() will set state to STOPPING_2
+            // presentation is complete
+            // For an offloaded track this starts a drain and state will
+            // move to STOPPING_2 when drain completes and then STOPPED
+            mState = STOPPING_1;
+            if (isOffloaded()) {
+                mRetryCount = PlaybackThread::kMaxTrackStopRetriesOffload;
             }
-            playbackThread->broadcast_l();
-            ALOGV("not stopping/stopped => stopping/stopped (%d) on thread %p", mName,
-                    playbackThread);
         }
+        playbackThread->broadcast_l();
+        ALOGV("not stopping/stopped => stopping/stopped (%d) on thread %p", mName,
+                playbackThread);
     }
 }
 
@@ -830,29 +854,42 @@ void AudioFlinger::PlaybackThread::Track::pause()
     ALOGV("pause(%d), calling pid %d", mName, IPCThreadState::self()->getCallingPid());
     sp<ThreadBase> thread = mThread.promote();
     if (thread != 0) {
-        Mutex::Autolock _l(thread->mLock);
         PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
-        switch (mState) {
-        case STOPPING_1:
-        case STOPPING_2:
-            if (!isOffloaded()) {
-                /* nothing to do if track is not offloaded */
-                break;
-            }
-
-            // Offloaded track was draining, we need to carry on draining when resumed
-            mResumeToStopping = true;
-            // fall through...
-        case ACTIVE:
-        case RESUMING:
-            mState = PAUSING;
-            ALOGV("ACTIVE/RESUMING => PAUSING (%d) on thread %p", mName, thread.get());
-            playbackThread->broadcast_l();
-            break;
+        // offloaded and direct tracks are paused right away, as their pause reaches the HAL
+        if (!isOffloaded() && !isDirect()
+                && playbackThread->queueTrackCommand(this, PlaybackThread::TrackCommand::PAUSE)) {
+            return;
+        }
+        Vector< sp<Track> > commandedTracks; // released after mLock
+        Mutex::Autolock _l(thread->mLock);
+        playbackThread->processTrackCommands_l(&commandedTracks);
+        pause_l(playbackThread);
+    }
+}
 
-        default:
+// must be called with thread lock held
+void AudioFlinger::PlaybackThread::Track::pause_l(PlaybackThread *playbackThread)
+{
+    switch (mState) {
+    case STOPPING_1:
+    case STOPPING_2:
+        if (!isOffloaded()) {
+            /* nothing to do if track is not offloaded */
             break;
         }
+
+        // Offloaded track was draining, we need to carry on draining when resumed
+        mResumeToStopping = true;
+        // fall through...
+    case ACTIVE:
+    case RESUMING:
+        mState = PAUSING;
+        ALOGV("ACTIVE/RESUMING => PAUSING (%d) on thread %p", mName, playbackThread);
+        playbackThread->broadcast_l();
+        break;
+
+    default:
+        break;
     }
 }
 
@@ -861,8 +898,11 @@ void AudioFlinger::PlaybackThread::Track::flush()
     ALOGV("flush(%d)", mName);
     sp<ThreadBase> thread = mThread.promote();
     if (thread != 0) {
+        Vector< sp<Track> > commandedTracks; // released after mLock
         Mutex::Autolock _l(thread->mLock);
         PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
+        // flush() is only valid once the pause() or stop() before it has been applied
+        playbackThread->processTrackCommands_l(&commandedTracks);
 
         // Flush the ring buffer now if the track is not active in the PlaybackThread.
         // Otherwise the flush would not be done until the track is resumed.
@@ -21,7 +21,8 @@ LOCAL_SRC_FILES:= \
     src/AudioSourceDescriptor.cpp \
     src/VolumeCurve.cpp \
     src/TypeConverter.cpp \
-    src/AudioSession.cpp
+    src/AudioSession.cpp \
+    src/RoutingDecisionCache.cpp
 
 LOCAL_SHARED_LIBRARIES := \
     libcutils \
@@ -40,7 +41,9 @@ LOCAL_C_INCLUDES := \
 
 ifeq ($(USE_XML_AUDIO_POLICY_CONF), 1)
 
-LOCAL_SRC_FILES += src/Serializer.cpp
+LOCAL_SRC_FILES += \
+    src/Serializer.cpp \
+    src/BinarySerializer.cpp
 
 LOCAL_SHARED_LIBRARIES += libicuuc libxml2
 
@@ -67,3 +70,36 @@ LOCAL_CFLAGS := -Wall -Werror
 LOCAL_MODULE := libaudiopolicycomponents
 
 include $(BUILD_STATIC_LIBRARY)
+
+ifeq ($(USE_XML_AUDIO_POLICY_CONF), 1)
+
+# Compiles audio_policy_configuration.xml into the blob loaded at boot instead of the XML.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := tools/audio_policy_compiler.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libmedia \
+    libutils \
+    liblog \
+    libicuuc \
+    libxml2
+
+LOCAL_STATIC_LIBRARIES := \
+    libaudiopolicycomponents
+
+LOCAL_C_INCLUDES := \
+    frameworks/av/services/audiopolicy/common/include \
+    frameworks/av/services/audiopolicy \
+    frameworks/av/services/audiopolicy/utilities
+
+LOCAL_CFLAGS := -Wall -Werror
+
+LOCAL_MODULE := audio_policy_compiler
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
+endif #ifeq ($(USE_XML_AUDIO_POLICY_CONF), 1)
@@ -55,6 +55,8 @@ public:
         }
     }
 
+    const VolumeCurvesCollection *getVolumes() const { return mVolumeCurves; }
+
     void setHwModules(const HwModuleCollection &hwModules)
     {
         mHwModules = hwModules;
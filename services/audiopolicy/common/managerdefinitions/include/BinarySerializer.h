@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "AudioPolicyConfig.h"
+#include <utils/Errors.h>
+#include <string>
+#include <vector>
+
+namespace android {
+
+// Precompiled form of the audio policy configuration, to spare the XML parsing at boot.
+// A blob is compiled from an XML file by audio_policy_compiler and installed next to it.
+// It records the size and content hash of the XML file and of the files it includes, and
+// is only used while all of them are unchanged: deserialize() returns INVALID_OPERATION for
+// a stale blob and NAME_NOT_FOUND when there is none, then PolicySerializer must be used.
+class PolicyBinarySerializer
+{
+private:
+    static const uint32_t gMagic;
+    static const uint32_t gVersion; /**< bumped whenever the blob layout changes. */
+
+public:
+    /** Returns the path of the blob compiled from configFile. */
+    static std::string getBlobPath(const char *configFile);
+
+    /**
+     * Writes config, as just deserialized by PolicySerializer, to blobFile.
+     * sourceFiles are the XML file and the files it includes.
+     */
+    status_t serialize(const AudioPolicyConfig &config,
+                       const std::vector<std::string> &sourceFiles, const char *blobFile);
+
+    /** Fills config from the blob compiled from configFile, if there is an up to date one. */
+    status_t deserialize(const char *configFile, AudioPolicyConfig &config);
+};
+
+} // namespace android
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <system/audio.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+// Memoizes the routing decisions made for each new track: the device selected for a
+// strategy and the mixed output selected for a device.
+// Entries are stamped with the generation in which they were stored. invalidate() starts
+// a new generation and must be called whenever a condition the decisions depend on changes,
+// e.g. available devices, phone state, forced usages, open outputs or stream activity.
+class RoutingDecisionCache
+{
+public:
+    RoutingDecisionCache() : mGeneration(0), mHits(0), mMisses(0) {}
+
+    void invalidate() { mGeneration++; }
+
+    bool getDeviceForStrategy(uint32_t strategy, audio_devices_t *device);
+    void putDeviceForStrategy(uint32_t strategy, audio_devices_t device);
+
+    // flags are the output flags after the adjustments made by getOutputForDevice()
+    bool getMixedOutput(audio_devices_t device, audio_output_flags_t flags,
+                        audio_format_t format, audio_io_handle_t *output);
+    void putMixedOutput(audio_devices_t device, audio_output_flags_t flags,
+                        audio_format_t format, audio_io_handle_t output);
+
+    status_t dump(int fd) const;
+
+private:
+    struct OutputKey {
+        audio_devices_t mDevice;
+        audio_output_flags_t mFlags;
+        audio_format_t mFormat;
+
+        bool operator<(const OutputKey &other) const {
+            if (mDevice != other.mDevice) return mDevice < other.mDevice;
+            if (mFlags != other.mFlags) return mFlags < other.mFlags;
+            return mFormat < other.mFormat;
+        }
+    };
+
+    template <typename T>
+    struct Entry {
+        T mValue;
+        uint32_t mGeneration;
+    };
+
+    // Counts a hit or a miss, returns true and the value on a hit.
+    template <typename K, typename T>
+    bool lookup(const std::map<K, Entry<T>> &entries, const K &key, T *value);
+
+    std::map<uint32_t, Entry<audio_devices_t>> mDevices;
+    std::map<OutputKey, Entry<audio_io_handle_t>> mOutputs;
+    uint32_t mGeneration;
+    uint64_t mHits;
+    uint64_t mMisses;
+};
+
+} // namespace android
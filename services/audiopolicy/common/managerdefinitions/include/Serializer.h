@@ -23,6 +23,7 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 struct _xmlNode;
 struct _xmlDoc;
@@ -225,7 +226,11 @@ private:
 
 public:
     PolicySerializer();
-    status_t deserialize(const char *str, AudioPolicyConfig &config);
+    /**
+     * If sourceFiles is not null, the parsed file and the files it includes are appended to it.
+     */
+    status_t deserialize(const char *str, AudioPolicyConfig &config,
+                         std::vector<std::string> *sourceFiles = nullptr);
 
 private:
     typedef AudioPolicyConfig Element;
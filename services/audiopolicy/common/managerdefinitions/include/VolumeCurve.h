@@ -26,6 +26,7 @@
 #include <cutils/config_utils.h>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace android {
 
@@ -55,16 +56,28 @@ public:
     device_category getDeviceCategory() const { return mDeviceCategory; }
     audio_stream_type_t getStreamType() const { return mStreamType; }
 
-    void add(const CurvePoint &point) { mCurvePoints.add(point); }
+    void add(const CurvePoint &point) { mCurvePoints.add(point); mDbTable.clear(); }
+    const SortedVector<CurvePoint> &getCurvePoints() const { return mCurvePoints; }
 
     float volIndexToDb(int indexInUi, int volIndexMin, int volIndexMax) const;
 
     void dump(int fd) const;
 
 private:
+    // Largest UI index range for which volIndexToDb() results are tabulated.
+    static const int kMaxDbTableSize = 1024;
+
+    float computeVolIndexToDb(int indexInUi, int volIndexMin, int volIndexMax) const;
+
     SortedVector<CurvePoint> mCurvePoints;
     device_category mDeviceCategory;
     audio_stream_type_t mStreamType;
+
+    // volIndexToDb() for every UI index from mDbTableIndexMin to mDbTableIndexMax, built on
+    // first use for the stream's index range and dropped when the curve changes.
+    mutable std::vector<float> mDbTable;
+    mutable int mDbTableIndexMin = 0;
+    mutable int mDbTableIndexMax = 0;
 };
 
 // Volume Curves for a given use case indexed by device category
@@ -0,0 +1,644 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "APM::BinarySerializer"
+//#define LOG_NDEBUG 0
+
+#include "BinarySerializer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+using std::string;
+
+namespace android {
+
+// Layout of a blob, all integers being little endian uint32 unless noted, and strings a
+// length followed by the characters:
+//
+// header:  magic, version, source count, then per source: path, size, content hash (uint64).
+//          The first source is the XML file itself. Paths are relative to its directory
+//          unless they are outside of it.
+// modules: count, then per module: name, hal version major, minor,
+//          mix ports: count, then per port: name, role, flags, max open count,
+//                     max active count, profiles, gains,
+//          device ports: count, then per port: tag name, type, address, profiles, gains,
+//          routes: count, then per route: type, sink tag name, source count, source tag names,
+//          attached devices: count, tag names,
+//          default output device tag name, empty if not declared by this module.
+// profiles: count, then per profile: format, dynamic flags, channel mask count, channel masks,
+//           sampling rate count, sampling rates.
+// gains:   count, then per gain: mode, channel mask, min, max, default and step values in mB,
+//          min and max ramps in ms.
+// volumes: count, then per curve: stream, device category, point count, index and
+//          attenuation of each point.
+// global:  speaker drc enabled.
+const uint32_t PolicyBinarySerializer::gMagic = 0x42435041; // "APCB"
+const uint32_t PolicyBinarySerializer::gVersion = 1;
+
+static const uint32_t gDynamicFormatFlag = 0x1;
+static const uint32_t gDynamicChannelsFlag = 0x2;
+static const uint32_t gDynamicRateFlag = 0x4;
+
+namespace {
+
+// Read only mapping of a whole file.
+class MappedFile
+{
+public:
+    explicit MappedFile(const char *path) : mData(NULL), mSize(0)
+    {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                mData = static_cast<const uint8_t *>(data);
+                mSize = st.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (mData != NULL) {
+            munmap(const_cast<uint8_t *>(mData), mSize);
+        }
+    }
+
+    bool isValid() const { return mData != NULL; }
+    const uint8_t *data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    const uint8_t *mData;
+    size_t mSize;
+};
+
+class BlobWriter
+{
+public:
+    void writeUint32(uint32_t value)
+    {
+        for (size_t i = 0; i < sizeof(value); i++) {
+            mData.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void writeUint64(uint64_t value)
+    {
+        writeUint32(static_cast<uint32_t>(value));
+        writeUint32(static_cast<uint32_t>(value >> 32));
+    }
+
+    void writeString(const char *str)
+    {
+        size_t length = strlen(str);
+        writeUint32(length);
+        mData.insert(mData.end(), str, str + length);
+    }
+
+    const std::vector<uint8_t> &getData() const { return mData; }
+
+private:
+    std::vector<uint8_t> mData;
+};
+
+// Every read is bounds checked: once past the end, reads return zeroes or empty strings and
+// hasFailed() is true.
+class BlobReader
+{
+public:
+    BlobReader(const uint8_t *data, size_t size)
+        : mData(data), mSize(size), mOffset(0), mFailed(false) {}
+
+    uint32_t readUint32()
+    {
+        if (!canRead(sizeof(uint32_t))) {
+            return 0;
+        }
+        uint32_t value = 0;
+        for (size_t i = 0; i < sizeof(value); i++) {
+            value |= static_cast<uint32_t>(mData[mOffset++]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t readUint64()
+    {
+        uint64_t low = readUint32();
+        return low | (static_cast<uint64_t>(readUint32()) << 32);
+    }
+
+    String8 readString()
+    {
+        uint32_t length = readUint32();
+        if (!canRead(length)) {
+            return String8();
+        }
+        String8 value(reinterpret_cast<const char *>(mData + mOffset), length);
+        mOffset += length;
+        return value;
+    }
+
+    // Every element of a collection takes 4 bytes at least, which bounds the count of a
+    // corrupted blob.
+    uint32_t readCount()
+    {
+        uint32_t count = readUint32();
+        if (!mFailed && count > (mSize - mOffset) / sizeof(uint32_t)) {
+            mFailed = true;
+        }
+        return mFailed ? 0 : count;
+    }
+
+    bool hasFailed() const { return mFailed; }
+    bool isAtEnd() const { return mOffset == mSize; }
+
+private:
+    bool canRead(size_t bytes)
+    {
+        if (!mFailed && mSize - mOffset < bytes) {
+            mFailed = true;
+        }
+        return !mFailed;
+    }
+
+    const uint8_t *mData;
+    const size_t mSize;
+    size_t mOffset;
+    bool mFailed;
+};
+
+} // namespace
+
+// FNV-1a
+static uint64_t hashContent(const uint8_t *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static string getDirectory(const string &path)
+{
+    size_t slash = path.rfind('/');
+    return slash == string::npos ? string(".") : path.substr(0, slash);
+}
+
+static bool containsDevice(const DeviceVector &devices, const sp<DeviceDescriptor> &device)
+{
+    for (size_t i = 0; i < devices.size(); i++) {
+        if (devices[i] == device) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void writeProfiles(BlobWriter &writer, const AudioProfileVector &profiles)
+{
+    writer.writeUint32(profiles.size());
+    for (size_t i = 0; i < profiles.size(); i++) {
+        const sp<AudioProfile> &profile = profiles[i];
+        writer.writeUint32(profile->getFormat());
+        writer.writeUint32((profile->isDynamicFormat() ? gDynamicFormatFlag : 0) |
+                           (profile->isDynamicChannels() ? gDynamicChannelsFlag : 0) |
+                           (profile->isDynamicRate() ? gDynamicRateFlag : 0));
+        const ChannelsVector &channelMasks = profile->getChannels();
+        writer.writeUint32(channelMasks.size());
+        for (size_t j = 0; j < channelMasks.size(); j++) {
+            writer.writeUint32(channelMasks[j]);
+        }
+        const SampleRateVector &samplingRates = profile->getSampleRates();
+        writer.writeUint32(samplingRates.size());
+        for (size_t j = 0; j < samplingRates.size(); j++) {
+            writer.writeUint32(samplingRates[j]);
+        }
+    }
+}
+
+static void writeGains(BlobWriter &writer, const AudioGainCollection &gains)
+{
+    writer.writeUint32(gains.size());
+    for (size_t i = 0; i < gains.size(); i++) {
+        const sp<AudioGain> &gain = gains[i];
+        writer.writeUint32(gain->getMode());
+        writer.writeUint32(gain->getChannelMask());
+        writer.writeUint32(gain->getMinValueInMb());
+        writer.writeUint32(gain->getMaxValueInMb());
+        writer.writeUint32(gain->getDefaultValueInMb());
+        writer.writeUint32(gain->getStepValueInMb());
+        writer.writeUint32(gain->getMinRampInMs());
+        writer.writeUint32(gain->getMaxRampInMs());
+    }
+}
+
+static void writeModule(BlobWriter &writer, const sp<HwModule> &module,
+                        const AudioPolicyConfig &config)
+{
+    writer.writeString(module->getName());
+    writer.writeUint32(module->getHalVersionMajor());
+    writer.writeUint32(module->getHalVersionMinor());
+
+    IOProfileCollection mixPorts;
+    mixPorts.appendVector(module->getOutputProfiles());
+    mixPorts.appendVector(module->getInputProfiles());
+    writer.writeUint32(mixPorts.size());
+    for (size_t i = 0; i < mixPorts.size(); i++) {
+        const sp<IOProfile> &mixPort = mixPorts[i];
+        writer.writeString(mixPort->getName().string());
+        writer.writeUint32(mixPort->getRole());
+        writer.writeUint32(mixPort->getFlags());
+        writer.writeUint32(mixPort->maxOpenCount);
+        writer.writeUint32(mixPort->maxActiveCount);
+        writeProfiles(writer, mixPort->getAudioProfiles());
+        writeGains(writer, mixPort->getGains());
+    }
+
+    const DeviceVector &devicePorts = module->getDeclaredDevices();
+    writer.writeUint32(devicePorts.size());
+    for (size_t i = 0; i < devicePorts.size(); i++) {
+        const sp<DeviceDescriptor> &devicePort = devicePorts[i];
+        writer.writeString(devicePort->getTagName().string());
+        writer.writeUint32(devicePort->type());
+        writer.writeString(devicePort->mAddress.string());
+        writeProfiles(writer, devicePort->getAudioProfiles());
+        writeGains(writer, devicePort->mGains);
+    }
+
+    const AudioRouteVector &routes = module->getRoutes();
+    writer.writeUint32(routes.size());
+    for (size_t i = 0; i < routes.size(); i++) {
+        const sp<AudioRoute> &route = routes[i];
+        writer.writeUint32(route->getType());
+        writer.writeString(route->getSink()->getTagName().string());
+        const AudioPortVector &sources = route->getSources();
+        writer.writeUint32(sources.size());
+        for (size_t j = 0; j < sources.size(); j++) {
+            writer.writeString(sources[j]->getTagName().string());
+        }
+    }
+
+    DeviceVector attachedDevices;
+    for (size_t i = 0; i < devicePorts.size(); i++) {
+        if (containsDevice(config.getAvailableOutputDevices(), devicePorts[i]) ||
+                containsDevice(config.getAvailableInputDevices(), devicePorts[i])) {
+            attachedDevices.add(devicePorts[i]);
+        }
+    }
+    writer.writeUint32(attachedDevices.size());
+    for (size_t i = 0; i < attachedDevices.size(); i++) {
+        writer.writeString(attachedDevices[i]->getTagName().string());
+    }
+
+    const sp<DeviceDescriptor> &defaultOutputDevice = config.getDefaultOutputDevice();
+    writer.writeString(containsDevice(devicePorts, defaultOutputDevice) ?
+            defaultOutputDevice->getTagName().string() : "");
+}
+
+static AudioProfileVector readProfiles(BlobReader &reader)
+{
+    AudioProfileVector profiles;
+    uint32_t count = reader.readCount();
+    for (uint32_t i = 0; i < count; i++) {
+        audio_format_t format = static_cast<audio_format_t>(reader.readUint32());
+        uint32_t dynamicFlags = reader.readUint32();
+        ChannelsVector channelMasks;
+        uint32_t channelMaskCount = reader.readCount();
+        for (uint32_t j = 0; j < channelMaskCount; j++) {
+            channelMasks.add(static_cast<audio_channel_mask_t>(reader.readUint32()));
+        }
+        SampleRateVector samplingRates;
+        uint32_t samplingRateCount = reader.readCount();
+        for (uint32_t j = 0; j < samplingRateCount; j++) {
+            samplingRates.add(reader.readUint32());
+        }
+        sp<AudioProfile> profile = new AudioProfile(format, channelMasks, samplingRates);
+        profile->setDynamicFormat((dynamicFlags & gDynamicFormatFlag) != 0);
+        profile->setDynamicChannels((dynamicFlags & gDynamicChannelsFlag) != 0);
+        profile->setDynamicRate((dynamicFlags & gDynamicRateFlag) != 0);
+        profiles.add(profile);
+    }
+    return profiles;
+}
+
+// gainIndex numbers the gains of the whole configuration, as PolicySerializer does.
+static AudioGainCollection readGains(BlobReader &reader, uint32_t &gainIndex)
+{
+    AudioGainCollection gains;
+    uint32_t count = reader.readCount();
+    for (uint32_t i = 0; i < count; i++) {
+        sp<AudioGain> gain = new AudioGain(gainIndex++, true);
+        gain->setMode(static_cast<audio_gain_mode_t>(reader.readUint32()));
+        gain->setChannelMask(static_cast<audio_channel_mask_t>(reader.readUint32()));
+        gain->setMinValueInMb(static_cast<int32_t>(reader.readUint32()));
+        gain->setMaxValueInMb(static_cast<int32_t>(reader.readUint32()));
+        gain->setDefaultValueInMb(static_cast<int32_t>(reader.readUint32()));
+        gain->setStepValueInMb(reader.readUint32());
+        gain->setMinRampInMs(reader.readUint32());
+        gain->setMaxRampInMs(reader.readUint32());
+        gains.add(gain);
+    }
+    return gains;
+}
+
+static status_t readModule(BlobReader &reader, uint32_t &gainIndex, sp<HwModule> &module,
+                           DeviceVector &attachedDevices, sp<DeviceDescriptor> &defaultOutputDevice)
+{
+    String8 name = reader.readString();
+    uint32_t versionMajor = reader.readUint32();
+    uint32_t versionMinor = reader.readUint32();
+    module = new HwModule(name.string(), versionMajor, versionMinor);
+
+    IOProfileCollection mixPorts;
+    uint32_t count = reader.readCount();
+    for (uint32_t i = 0; i < count; i++) {
+        String8 portName = reader.readString();
+        audio_port_role_t role = static_cast<audio_port_role_t>(reader.readUint32());
+        if (role != AUDIO_PORT_ROLE_SOURCE && role != AUDIO_PORT_ROLE_SINK) {
+            ALOGE("%s: invalid role %d for %s", __FUNCTION__, role, portName.string());
+            return BAD_VALUE;
+        }
+        sp<IOProfile> mixPort = new IOProfile(portName, role);
+        // flags first as setFlags() may change maxActiveCount
+        mixPort->setFlags(reader.readUint32());
+        mixPort->maxOpenCount = reader.readUint32();
+        mixPort->maxActiveCount = reader.readUint32();
+        mixPort->setAudioProfiles(readProfiles(reader));
+        mixPort->setGains(readGains(reader, gainIndex));
+        mixPorts.add(mixPort);
+    }
+    module->setProfiles(mixPorts);
+
+    DeviceVector devicePorts;
+    count = reader.readCount();
+    for (uint32_t i = 0; i < count; i++) {
+        String8 tagName = reader.readString();
+        audio_devices_t type = static_cast<audio_devices_t>(reader.readUint32());
+        sp<DeviceDescriptor> devicePort = new DeviceDescriptor(type, tagName);
+        devicePort->mAddress = reader.readString();
+        devicePort->setAudioProfiles(readProfiles(reader));
+        devicePort->mGains = readGains(reader, gainIndex);
+        devicePorts.add(devicePort);
+    }
+    module->setDeclaredDevices(devicePorts);
+
+    AudioRouteVector routes;
+    count = reader.readCount();
+    for (uint32_t i = 0; i < count; i++) {
+        sp<AudioRoute> route =
+                new AudioRoute(static_cast<audio_route_type_t>(reader.readUint32()));
+        String8 sinkName = reader.readString();
+        sp<AudioPort> sink = module->findPortByTagName(sinkName);
+        if (sink == NULL) {
+            ALOGE("%s: no sink found with name=%s", __FUNCTION__, sinkName.string());
+            return BAD_VALUE;
+        }
+        route->setSink(sink);
+        AudioPortVector sources;
+        uint32_t sourceCount = reader.readCount();
+        for (uint32_t j = 0; j < sourceCount; j++) {
+            String8 sourceName = reader.readString();
+            sp<AudioPort> source = module->findPortByTagName(sourceName);
+            if (source == NULL) {
+                ALOGE("%s: no source found with name=%s", __FUNCTION__, sourceName.string());
+                return BAD_VALUE;
+            }
+            sources.add(source);
+        }
+        sink->addRoute(route);
+        for (size_t j = 0; j < sources.size(); j++) {
+            sources[j]->addRoute(route);
+        }
+        route->setSources(sources);
+        routes.add(route);
+    }
+    module->setRoutes(routes);
+
+    count = reader.readCount();
+    for (uint32_t i = 0; i < count; i++) {
+        String8 tagName = reader.readString();
+        sp<DeviceDescriptor> device = devicePorts.getDeviceFromTagName(tagName);
+        if (device == 0) {
+            ALOGE("%s: no attached device found with name=%s", __FUNCTION__, tagName.string());
+            return BAD_VALUE;
+        }
+        attachedDevices.add(device);
+    }
+
+    String8 defaultOutputDeviceName = reader.readString();
+    if (!defaultOutputDeviceName.isEmpty() && defaultOutputDevice == 0) {
+        defaultOutputDevice = devicePorts.getDeviceFromTagName(defaultOutputDeviceName);
+    }
+    return reader.hasFailed() ? BAD_VALUE : NO_ERROR;
+}
+
+string PolicyBinarySerializer::getBlobPath(const char *configFile)
+{
+    string path(configFile);
+    static const string xmlSuffix(".xml");
+    if (path.size() > xmlSuffix.size() &&
+            path.compare(path.size() - xmlSuffix.size(), xmlSuffix.size(), xmlSuffix) == 0) {
+        path.resize(path.size() - xmlSuffix.size());
+    }
+    return path + ".bin";
+}
+
+status_t PolicyBinarySerializer::serialize(const AudioPolicyConfig &config,
+                                           const std::vector<string> &sourceFiles,
+                                           const char *blobFile)
+{
+    if (sourceFiles.empty()) {
+        return BAD_VALUE;
+    }
+    BlobWriter writer;
+    writer.writeUint32(gMagic);
+    writer.writeUint32(gVersion);
+
+    const string directory = getDirectory(sourceFiles[0]) + "/";
+    writer.writeUint32(sourceFiles.size());
+    for (const auto &sourceFile : sourceFiles) {
+        MappedFile source(sourceFile.c_str());
+        if (!source.isValid()) {
+            ALOGE("%s: could not read %s", __FUNCTION__, sourceFile.c_str());
+            return BAD_VALUE;
+        }
+        string path = sourceFile;
+        if (path.compare(0, directory.size(), directory) == 0) {
+            path = path.substr(directory.size());
+        }
+        writer.writeString(path.c_str());
+        writer.writeUint32(source.size());
+        writer.writeUint64(hashContent(source.data(), source.size()));
+    }
+
+    const HwModuleCollection modules = config.getHwModules();
+    writer.writeUint32(modules.size());
+    for (size_t i = 0; i < modules.size(); i++) {
+        writeModule(writer, modules[i], config);
+    }
+
+    std::vector<sp<VolumeCurve> > curves;
+    const VolumeCurvesCollection *volumes = config.getVolumes();
+    for (size_t i = 0; volumes != nullptr && i < volumes->size(); i++) {
+        const VolumeCurvesForStream &curvesForStream = volumes->valueAt(i);
+        for (size_t j = 0; j < curvesForStream.size(); j++) {
+            curves.push_back(curvesForStream.valueAt(j));
+        }
+    }
+    writer.writeUint32(curves.size());
+    for (const auto &curve : curves) {
+        writer.writeUint32(curve->getStreamType());
+        writer.writeUint32(curve->getDeviceCategory());
+        const SortedVector<CurvePoint> &points = curve->getCurvePoints();
+        writer.writeUint32(points.size());
+        for (size_t i = 0; i < points.size(); i++) {
+            writer.writeUint32(points[i].mIndex);
+            writer.writeUint32(points[i].mAttenuationInMb);
+        }
+    }
+
+    writer.writeUint32(config.isSpeakerDrcEnabled());
+
+    FILE *file = fopen(blobFile, "wb");
+    if (file == NULL) {
+        ALOGE("%s: could not open %s: %s", __FUNCTION__, blobFile, strerror(errno));
+        return BAD_VALUE;
+    }
+    const std::vector<uint8_t> &data = writer.getData();
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    if (fclose(file) != 0 || !written) {
+        ALOGE("%s: could not write %s", __FUNCTION__, blobFile);
+        unlink(blobFile);
+        return BAD_VALUE;
+    }
+    return NO_ERROR;
+}
+
+status_t PolicyBinarySerializer::deserialize(const char *configFile, AudioPolicyConfig &config)
+{
+    const string blobFile = getBlobPath(configFile);
+    MappedFile blob(blobFile.c_str());
+    if (!blob.isValid()) {
+        ALOGV("%s: no %s", __FUNCTION__, blobFile.c_str());
+        return NAME_NOT_FOUND;
+    }
+    BlobReader reader(blob.data(), blob.size());
+    if (reader.readUint32() != gMagic || reader.readUint32() != gVersion) {
+        ALOGW("%s: %s has an unknown format", __FUNCTION__, blobFile.c_str());
+        return INVALID_OPERATION;
+    }
+
+    // Check the sources before building anything: a stale blob is the common failure.
+    const string configPath(configFile);
+    const string directory = getDirectory(configPath);
+    uint32_t sourceCount = reader.readCount();
+    for (uint32_t i = 0; i < sourceCount; i++) {
+        const String8 path = reader.readString();
+        const uint32_t size = reader.readUint32();
+        const uint64_t hash = reader.readUint64();
+        if (reader.hasFailed()) {
+            break;
+        }
+        if (i == 0 && path != String8(configPath.substr(configPath.rfind('/') + 1).c_str())) {
+            ALOGW("%s: %s was not compiled from %s", __FUNCTION__, blobFile.c_str(), configFile);
+            return INVALID_OPERATION;
+        }
+        string sourceFile(path.string());
+        if (sourceFile.empty() || sourceFile[0] != '/') {
+            sourceFile = directory + "/" + sourceFile;
+        }
+        MappedFile source(sourceFile.c_str());
+        if (!source.isValid() || source.size() != size ||
+                hashContent(source.data(), source.size()) != hash) {
+            ALOGW("%s: %s is stale, %s changed", __FUNCTION__, blobFile.c_str(),
+                  sourceFile.c_str());
+            return INVALID_OPERATION;
+        }
+    }
+    if (sourceCount == 0 || reader.hasFailed()) {
+        ALOGE("%s: %s is corrupted", __FUNCTION__, blobFile.c_str());
+        return BAD_VALUE;
+    }
+
+    // Build everything aside so that a corrupted blob leaves config untouched.
+    uint32_t gainIndex = 0;
+    HwModuleCollection modules;
+    DeviceVector attachedDevices;
+    sp<DeviceDescriptor> defaultOutputDevice;
+    uint32_t moduleCount = reader.readCount();
+    for (uint32_t i = 0; i < moduleCount; i++) {
+        sp<HwModule> module;
+        if (readModule(reader, gainIndex, module, attachedDevices,
+                       defaultOutputDevice) != NO_ERROR) {
+            ALOGE("%s: %s is corrupted", __FUNCTION__, blobFile.c_str());
+            return BAD_VALUE;
+        }
+        modules.add(module);
+    }
+
+    VolumeCurvesCollection volumes;
+    uint32_t curveCount = reader.readCount();
+    for (uint32_t i = 0; i < curveCount; i++) {
+        uint32_t stream = reader.readUint32();
+        uint32_t deviceCategory = reader.readUint32();
+        if (stream >= AUDIO_STREAM_CNT || deviceCategory >= DEVICE_CATEGORY_CNT) {
+            ALOGE("%s: %s is corrupted", __FUNCTION__, blobFile.c_str());
+            return BAD_VALUE;
+        }
+        sp<VolumeCurve> curve = new VolumeCurve(static_cast<device_category>(deviceCategory),
+                                                static_cast<audio_stream_type_t>(stream));
+        uint32_t pointCount = reader.readCount();
+        for (uint32_t j = 0; j < pointCount; j++) {
+            uint32_t index = reader.readUint32();
+            curve->add(CurvePoint(index, static_cast<int32_t>(reader.readUint32())));
+        }
+        volumes.add(curve);
+    }
+
+    bool isSpeakerDrcEnabled = reader.readUint32() != 0;
+    if (reader.hasFailed() || !reader.isAtEnd()) {
+        ALOGE("%s: %s is corrupted", __FUNCTION__, blobFile.c_str());
+        return BAD_VALUE;
+    }
+
+    config.setHwModules(modules);
+    for (size_t i = 0; i < attachedDevices.size(); i++) {
+        config.addAvailableDevice(attachedDevices[i]);
+    }
+    if (defaultOutputDevice != 0 && config.getDefaultOutputDevice() == 0) {
+        config.setDefaultOutputDevice(defaultOutputDevice);
+    }
+    config.setVolumes(volumes);
+    config.setSpeakerDrcEnabled(isSpeakerDrcEnabled);
+    ALOGV("%s: loaded %s", __FUNCTION__, blobFile.c_str());
+    return NO_ERROR;
+}
+
+} // namespace android
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "APM::RoutingDecisionCache"
+//#define LOG_NDEBUG 0
+
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "RoutingDecisionCache.h"
+#include <utils/Log.h>
+#include <utils/String8.h>
+
+namespace android {
+
+template <typename K, typename T>
+bool RoutingDecisionCache::lookup(const std::map<K, Entry<T>> &entries, const K &key, T *value)
+{
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.mGeneration != mGeneration) {
+        mMisses++;
+        return false;
+    }
+    mHits++;
+    *value = it->second.mValue;
+    return true;
+}
+
+bool RoutingDecisionCache::getDeviceForStrategy(uint32_t strategy, audio_devices_t *device)
+{
+    return lookup(mDevices, strategy, device);
+}
+
+void RoutingDecisionCache::putDeviceForStrategy(uint32_t strategy, audio_devices_t device)
+{
+    mDevices[strategy] = {device, mGeneration};
+}
+
+bool RoutingDecisionCache::getMixedOutput(audio_devices_t device, audio_output_flags_t flags,
+                                          audio_format_t format, audio_io_handle_t *output)
+{
+    return lookup(mOutputs, OutputKey{device, flags, format}, output);
+}
+
+void RoutingDecisionCache::putMixedOutput(audio_devices_t device, audio_output_flags_t flags,
+                                          audio_format_t format, audio_io_handle_t output)
+{
+    ALOGV("putMixedOutput() device %08x flags %#x format %#x output %d",
+          device, flags, format, output);
+    mOutputs[OutputKey{device, flags, format}] = {output, mGeneration};
+}
+
+status_t RoutingDecisionCache::dump(int fd) const
+{
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    String8 result;
+
+    const uint64_t lookups = mHits + mMisses;
+    snprintf(buffer, SIZE, "\nRouting decision cache:\n"
+             " Generation: %u\n Hits: %" PRIu64 " Misses: %" PRIu64 " Hit rate: %.1f%%\n",
+             mGeneration, mHits, mMisses, lookups > 0 ? 100.0 * mHits / lookups : 0.0);
+    result.append(buffer);
+    for (const auto &device : mDevices) {
+        if (device.second.mGeneration == mGeneration) {
+            snprintf(buffer, SIZE, " - strategy %u: device %08x\n",
+                     device.first, device.second.mValue);
+            result.append(buffer);
+        }
+    }
+    for (const auto &output : mOutputs) {
+        if (output.second.mGeneration == mGeneration) {
+            snprintf(buffer, SIZE, " - device %08x flags %#x format %#x: output %d\n",
+                     output.first.mDevice, output.first.mFlags, output.first.mFormat,
+                     output.second.mValue);
+            result.append(buffer);
+        }
+    }
+    write(fd, result.string(), result.size());
+    return NO_ERROR;
+}
+
+} // namespace android
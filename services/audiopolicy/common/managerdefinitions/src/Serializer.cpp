@@ -21,10 +21,12 @@
 #include <media/convert.h>
 #include "TypeConverter.h"
 #include <libxml/parser.h>
+#include <libxml/parserInternals.h>
 #include <libxml/xinclude.h>
 #include <string>
 #include <sstream>
 #include <istream>
+#include <algorithm>
 
 using std::string;
 
@@ -595,7 +597,23 @@ PolicySerializer::PolicySerializer() : mRootElementName(rootName)
     ALOGV("%s: Version=%s Root=%s", __FUNCTION__, mVersion.c_str(), mRootElementName.c_str());
 }
 
-status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig &config)
+// Records the files loaded while resolving XIncludes, for PolicySerializer::deserialize()
+// callers asking for them. Not thread safe, as is the libxml entity loader.
+static xmlExternalEntityLoader gDefaultEntityLoader = NULL;
+static std::vector<string> *gIncludedFiles = NULL;
+
+static xmlParserInputPtr recordingEntityLoader(const char *url, const char *id,
+                                               xmlParserCtxtPtr ctxt)
+{
+    if (url != NULL && std::find(gIncludedFiles->begin(), gIncludedFiles->end(),
+                                 string(url)) == gIncludedFiles->end()) {
+        gIncludedFiles->push_back(url);
+    }
+    return gDefaultEntityLoader(url, id, ctxt);
+}
+
+status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig &config,
+                                       std::vector<string> *sourceFiles)
 {
     xmlDocPtr doc;
     doc = xmlParseFile(configFile);
@@ -609,9 +627,19 @@ status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig
         xmlFreeDoc(doc);
         return BAD_VALUE;
     }
+    if (sourceFiles != nullptr) {
+        sourceFiles->push_back(configFile);
+        gIncludedFiles = sourceFiles;
+        gDefaultEntityLoader = xmlGetExternalEntityLoader();
+        xmlSetExternalEntityLoader(recordingEntityLoader);
+    }
     if (xmlXIncludeProcess(doc) < 0) {
          ALOGE("%s: libxml failed to resolve XIncludes on %s document.", __FUNCTION__, configFile);
     }
+    if (sourceFiles != nullptr) {
+        xmlSetExternalEntityLoader(gDefaultEntityLoader);
+        gIncludedFiles = NULL;
+    }
 
     if (xmlStrcmp(cur->name, (const xmlChar *) mRootElementName.c_str()))  {
         ALOGE("%s: No %s root element found in xml data %s.", __FUNCTION__, mRootElementName.c_str(),
@@ -23,6 +23,29 @@
 namespace android {
 
 float VolumeCurve::volIndexToDb(int indexInUi, int volIndexMin, int volIndexMax) const
+{
+    if (volIndexMax <= volIndexMin || volIndexMax - volIndexMin >= kMaxDbTableSize) {
+        return computeVolIndexToDb(indexInUi, volIndexMin, volIndexMax);
+    }
+    if (mDbTable.empty() || mDbTableIndexMin != volIndexMin || mDbTableIndexMax != volIndexMax) {
+        mDbTable.resize(volIndexMax - volIndexMin + 1);
+        for (int index = volIndexMin; index <= volIndexMax; index++) {
+            mDbTable[index - volIndexMin] =
+                    computeVolIndexToDb(index, volIndexMin, volIndexMax);
+        }
+        mDbTableIndexMin = volIndexMin;
+        mDbTableIndexMax = volIndexMax;
+    }
+    // out of range indices are remapped to the min or max index, as computed
+    if (indexInUi < volIndexMin) {
+        indexInUi = volIndexMin;
+    } else if (indexInUi > volIndexMax) {
+        indexInUi = volIndexMax;
+    }
+    return mDbTable[indexInUi - volIndexMin];
+}
+
+float VolumeCurve::computeVolIndexToDb(int indexInUi, int volIndexMin, int volIndexMax) const
 {
     ALOG_ASSERT(!mCurvePoints.isEmpty(), "Invalid volume curve");
 
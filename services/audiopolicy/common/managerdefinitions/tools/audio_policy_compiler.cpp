@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiles an audio policy configuration XML file into the blob read by
+// PolicyBinarySerializer, then checks that the blob loads back.
+// The XML file and the files it includes must be laid out as they are on the device,
+// the blob is written next to the XML file unless another path is given.
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <BinarySerializer.h>
+#include <Serializer.h>
+
+using namespace android;
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s <audio_policy_configuration.xml> [<output.bin>]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *configFile = argv[1];
+    const std::string blobFile =
+            argc == 3 ? argv[2] : PolicyBinarySerializer::getBlobPath(configFile);
+
+    HwModuleCollection hwModules;
+    DeviceVector availableOutputDevices;
+    DeviceVector availableInputDevices;
+    sp<DeviceDescriptor> defaultOutputDevice;
+    VolumeCurvesCollection volumes;
+    AudioPolicyConfig config(hwModules, availableOutputDevices, availableInputDevices,
+                             defaultOutputDevice, &volumes);
+
+    PolicySerializer serializer;
+    std::vector<std::string> sourceFiles;
+    if (serializer.deserialize(configFile, config, &sourceFiles) != NO_ERROR) {
+        fprintf(stderr, "could not parse %s\n", configFile);
+        return 1;
+    }
+
+    PolicyBinarySerializer binarySerializer;
+    if (binarySerializer.serialize(config, sourceFiles, blobFile.c_str()) != NO_ERROR) {
+        fprintf(stderr, "could not write %s\n", blobFile.c_str());
+        return 1;
+    }
+
+    // Only a blob next to the XML file can be checked, as this is where it is looked for.
+    if (blobFile == PolicyBinarySerializer::getBlobPath(configFile)) {
+        HwModuleCollection loadedHwModules;
+        DeviceVector loadedOutputDevices;
+        DeviceVector loadedInputDevices;
+        sp<DeviceDescriptor> loadedDefaultOutputDevice;
+        VolumeCurvesCollection loadedVolumes;
+        AudioPolicyConfig loadedConfig(loadedHwModules, loadedOutputDevices, loadedInputDevices,
+                                       loadedDefaultOutputDevice, &loadedVolumes);
+        if (binarySerializer.deserialize(configFile, loadedConfig) != NO_ERROR ||
+                loadedHwModules.size() != hwModules.size() ||
+                loadedOutputDevices.size() != availableOutputDevices.size() ||
+                loadedInputDevices.size() != availableInputDevices.size()) {
+            fprintf(stderr, "%s does not load back\n", blobFile.c_str());
+            return 1;
+        }
+    }
+
+    printf("%s: %zu modules from %zu files\n", blobFile.c_str(), hwModules.size(),
+           sourceFiles.size());
+    return 0;
+}
@@ -46,6 +46,7 @@
 #include <ConfigParsingUtils.h>
 #include <StreamDescriptor.h>
 #endif
+#include <BinarySerializer.h>
 #include <Serializer.h>
 #include "TypeConverter.h"
 #include <policy.h>
@@ -166,6 +167,7 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(audio_devices_t device,
             }
             // Propagate device availability to Engine
             mEngine->setDeviceConnectionState(devDesc, state);
+            mRoutingDecisionCache.invalidate();
 
             // outputs should never be empty here
             ALOG_ASSERT(outputs.size() != 0, "setDeviceConnectionState():"
@@ -193,6 +195,7 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(audio_devices_t device,
 
             // Propagate device availability to Engine
             mEngine->setDeviceConnectionState(devDesc, state);
+            mRoutingDecisionCache.invalidate();
             } break;
 
         default:
@@ -287,6 +290,7 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(audio_devices_t device,
 
             // Propagate device availability to Engine
             mEngine->setDeviceConnectionState(devDesc, state);
+            mRoutingDecisionCache.invalidate();
         } break;
 
         // handle input device disconnection
@@ -306,6 +310,7 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(audio_devices_t device,
 
             // Propagate device availability to Engine
             mEngine->setDeviceConnectionState(devDesc, state);
+            mRoutingDecisionCache.invalidate();
         } break;
 
         default:
@@ -552,6 +557,7 @@ void AudioPolicyManager::setPhoneState(audio_mode_t state)
     // store previous phone state for management of sonification strategy below
     int oldState = mEngine->getPhoneState();
 
+    mRoutingDecisionCache.invalidate();
     if (mEngine->setPhoneState(state) != NO_ERROR) {
         ALOGW("setPhoneState() invalid or same state %d", state);
         return;
@@ -676,6 +682,7 @@ void AudioPolicyManager::setForceUse(audio_policy_force_use_t usage,
         return;
     }
 
+    mRoutingDecisionCache.invalidate();
     if (mEngine->setForceUse(usage, config) != NO_ERROR) {
         ALOGW("setForceUse() could not set force cfg %d for usage %d", config, usage);
         return;
@@ -862,10 +869,21 @@ status_t AudioPolicyManager::getOutputForAttr(const audio_attributes_t *attr,
     if (*selectedDeviceId != AUDIO_PORT_HANDLE_NONE) {
         deviceDesc = mAvailableOutputDevices.getDeviceFromId(*selectedDeviceId);
     }
+    if (deviceDesc != 0 || mOutputRoutes.hasRoute(session)) {
+        mRoutingDecisionCache.invalidate();
+    }
     mOutputRoutes.addRoute(session, *stream, SessionRoute::SOURCE_TYPE_NA, deviceDesc, uid);
 
     routing_strategy strategy = (routing_strategy) getStrategyForAttr(&attributes);
-    audio_devices_t device = getDeviceForStrategy(strategy, false /*fromCache*/);
+    // sonification respectful routing depends on how long ago music stopped: not cached
+    const bool cacheDevice = strategy != STRATEGY_SONIFICATION_RESPECTFUL;
+    audio_devices_t device;
+    if (!cacheDevice || !mRoutingDecisionCache.getDeviceForStrategy(strategy, &device)) {
+        device = getDeviceForStrategy(strategy, false /*fromCache*/);
+        if (cacheDevice) {
+            mRoutingDecisionCache.putDeviceForStrategy(strategy, device);
+        }
+    }
 
     if ((attributes.flags & AUDIO_FLAG_HW_AV_SYNC) != 0) {
         *flags = (audio_output_flags_t)(*flags | AUDIO_OUTPUT_FLAG_HW_AV_SYNC);
@@ -1036,13 +1054,17 @@ non_direct_output:
 
     // for non direct outputs, only PCM is supported
     if (audio_is_linear_pcm(config->format)) {
-        // get which output is suitable for the specified stream. The actual
-        // routing change will happen when startOutput() will be called
-        SortedVector<audio_io_handle_t> outputs = getOutputsForDevice(device, mOutputs);
-
         // at this stage we should ignore the DIRECT flag as no direct output could be found earlier
         *flags = (audio_output_flags_t)(*flags & ~AUDIO_OUTPUT_FLAG_DIRECT);
-        output = selectOutput(outputs, *flags, config->format);
+
+        // the choice only depends on the open outputs, cached until one is added or removed
+        if (!mRoutingDecisionCache.getMixedOutput(device, *flags, config->format, &output)) {
+            // get which output is suitable for the specified stream. The actual
+            // routing change will happen when startOutput() will be called
+            SortedVector<audio_io_handle_t> outputs = getOutputsForDevice(device, mOutputs);
+            output = selectOutput(outputs, *flags, config->format);
+            mRoutingDecisionCache.putMixedOutput(device, *flags, config->format, output);
+        }
     }
     ALOGW_IF((output == 0), "getOutputForDevice() could not find output for stream %d, "
             "sampling rate %d, format %#x, channels %#x, flags %#x",
@@ -1152,6 +1174,9 @@ status_t AudioPolicyManager::startOutput(audio_io_handle_t output,
 
     // Routing?
     mOutputRoutes.incRouteActivity(session);
+    if (mOutputRoutes.hasRoute(session)) {
+        mRoutingDecisionCache.invalidate();
+    }
 
     audio_devices_t newDevice;
     AudioMix *policyMix = NULL;
@@ -1236,6 +1261,7 @@ status_t AudioPolicyManager::startSource(const sp<AudioOutputDescriptor>& output
     // NOTE that the usage count is the same for duplicated output and hardware output which is
     // necessary for a correct control of hardware output routing by startOutput() and stopOutput()
     outputDesc->changeRefCount(stream, 1);
+    checkRoutingDecisionsForActivity(outputDesc, stream);
 
     if (stream == AUDIO_STREAM_MUSIC) {
         selectOutputForMusicEffects();
@@ -1367,6 +1393,9 @@ status_t AudioPolicyManager::stopOutput(audio_io_handle_t output,
     if (outputDesc->mRefCount[stream] > 0) {
         int activityCount = mOutputRoutes.decRouteActivity(session);
         forceDeviceUpdate = (mOutputRoutes.hasRoute(session) && (activityCount == 0));
+        if (mOutputRoutes.hasRoute(session)) {
+            mRoutingDecisionCache.invalidate();
+        }
 
         if (forceDeviceUpdate) {
             checkStrategyRoute(getStrategy(stream), AUDIO_IO_HANDLE_NONE);
@@ -1396,6 +1425,7 @@ status_t AudioPolicyManager::stopSource(const sp<AudioOutputDescriptor>& outputD
     if (outputDesc->mRefCount[stream] > 0) {
         // decrement usage count of this stream on the output
         outputDesc->changeRefCount(stream, -1);
+        checkRoutingDecisionsForActivity(outputDesc, stream);
 
         // store time at which the stream was stopped - see isStreamActive()
         if (outputDesc->mRefCount[stream] == 0 || forceDeviceUpdate) {
@@ -1461,6 +1491,9 @@ void AudioPolicyManager::releaseOutput(audio_io_handle_t output,
     }
 
     // Routing
+    if (mOutputRoutes.hasRoute(session)) {
+        mRoutingDecisionCache.invalidate();
+    }
     mOutputRoutes.removeRoute(session);
 
     sp<SwAudioOutputDescriptor> desc = mOutputs.valueAt(index);
@@ -2491,6 +2524,7 @@ bool AudioPolicyManager::isSourceActive(audio_source_t source) const
 
 status_t AudioPolicyManager::registerPolicyMixes(const Vector<AudioMix>& mixes)
 {
+    mRoutingDecisionCache.invalidate();
     ALOGV("registerPolicyMixes() %zu mix(es)", mixes.size());
     status_t res = NO_ERROR;
 
@@ -2587,6 +2621,7 @@ status_t AudioPolicyManager::registerPolicyMixes(const Vector<AudioMix>& mixes)
 
 status_t AudioPolicyManager::unregisterPolicyMixes(Vector<AudioMix> mixes)
 {
+    mRoutingDecisionCache.invalidate();
     ALOGV("unregisterPolicyMixes() num mixes %zu", mixes.size());
     status_t res = NO_ERROR;
     sp<HwModule> rSubmixModule;
@@ -2685,6 +2720,7 @@ status_t AudioPolicyManager::dump(int fd)
     mEffects.dump(fd);
     mAudioPatches.dump(fd);
     mPolicyMixes.dump(fd);
+    mRoutingDecisionCache.dump(fd);
 
     return NO_ERROR;
 }
@@ -3313,6 +3349,7 @@ void AudioPolicyManager::clearSessionRoutes(uid_t uid)
             mOutputRoutes.removeItemsAt(i);
             if (route->mDeviceDescriptor != 0) {
                 affectedStrategies.add(getStrategy(route->mStreamType));
+                mRoutingDecisionCache.invalidate();
             }
         }
     }
@@ -3911,9 +3948,14 @@ static status_t deserializeAudioPolicyXmlConfig(AudioPolicyConfig &config) {
 
     for (const char* fileName : fileNames) {
         for (int i = 0; i < kConfigLocationListSize; i++) {
-            PolicySerializer serializer;
             snprintf(audioPolicyXmlConfigFile, sizeof(audioPolicyXmlConfigFile),
                      "%s/%s", kConfigLocationList[i], fileName);
+            // The precompiled configuration is only used while it matches the XML
+            PolicyBinarySerializer binarySerializer;
+            if (binarySerializer.deserialize(audioPolicyXmlConfigFile, config) == NO_ERROR) {
+                return NO_ERROR;
+            }
+            PolicySerializer serializer;
             ret = serializer.deserialize(audioPolicyXmlConfigFile, config);
             if (ret == NO_ERROR) {
                 return ret;
@@ -4203,6 +4245,7 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output,
                                    const sp<SwAudioOutputDescriptor>& outputDesc)
 {
     mOutputs.add(output, outputDesc);
+    mRoutingDecisionCache.invalidate();
     applyStreamVolumes(outputDesc, AUDIO_DEVICE_NONE, 0 /* delayMs */, true /* force */);
     updateMono(output); // update mono status when adding to output list
     selectOutputForMusicEffects();
@@ -4212,6 +4255,7 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output,
 void AudioPolicyManager::removeOutput(audio_io_handle_t output)
 {
     mOutputs.removeItem(output);
+    mRoutingDecisionCache.invalidate();
     selectOutputForMusicEffects();
 }
 
@@ -5116,6 +5160,26 @@ void AudioPolicyManager::updateDevicesAndOutputs()
         mDeviceForStrategy[i] = getDeviceForStrategy((routing_strategy)i, false /*fromCache*/);
     }
     mPreviousOutputs = mOutputs;
+    mRoutingDecisionCache.invalidate();
+}
+
+void AudioPolicyManager::checkRoutingDecisionsForActivity(
+        const sp<AudioOutputDescriptor>& outputDesc, audio_stream_type_t stream)
+{
+    // The engines only look at the activity of these streams, and of outputs with a
+    // compressed format, to select the device of the strategies in the cache.
+    switch (stream) {
+    case AUDIO_STREAM_VOICE_CALL:
+    case AUDIO_STREAM_RING:
+    case AUDIO_STREAM_ALARM:
+        break;
+    default:
+        if (audio_is_linear_pcm(outputDesc->mFormat)) {
+            return;
+        }
+        break;
+    }
+    mRoutingDecisionCache.invalidate();
 }
 
 uint32_t AudioPolicyManager::checkDeviceMuteStrategies(const sp<AudioOutputDescriptor>& outputDesc,
@@ -5238,6 +5302,10 @@ uint32_t AudioPolicyManager::setOutputDevice(const sp<AudioOutputDescriptor>& ou
 
     if (device != AUDIO_DEVICE_NONE) {
         outputDesc->mDevice = device;
+        // the engines avoid devices that compressed outputs are active on
+        if (device != prevDevice && !audio_is_linear_pcm(outputDesc->mFormat)) {
+            mRoutingDecisionCache.invalidate();
+        }
     }
 
     // if the outputs are not materially active, there is no need to mute.
@@ -46,6 +46,7 @@
 #include <AudioPolicyMix.h>
 #include <EffectDescriptor.h>
 #include <SoundTriggerSession.h>
+#include <RoutingDecisionCache.h>
 #include <SessionRoute.h>
 #include <VolumeCurve.h>
 
@@ -431,6 +432,11 @@ protected:
          // Must be called after checkOutputForAllStrategies()
         void updateDevicesAndOutputs();
 
+        // invalidates mRoutingDecisionCache if the activity of this stream on this output
+        // can change the device selected for a strategy
+        void checkRoutingDecisionsForActivity(const sp<AudioOutputDescriptor>& outputDesc,
+                                              audio_stream_type_t stream);
+
         // selects the most appropriate device on input for current state
         audio_devices_t getNewInputDevice(const sp<AudioInputDescriptor>& inputDesc);
 
@@ -558,6 +564,8 @@ protected:
 
         bool    mLimitRingtoneVolume;        // limit ringtone volume to music volume if headset connected
         audio_devices_t mDeviceForStrategy[NUM_STRATEGIES];
+        // devices and mixed outputs selected by getOutputForAttr()
+        RoutingDecisionCache mRoutingDecisionCache;
         float   mLastVoiceVolume;            // last voice volume value sent to audio HAL
         bool    mA2dpSuspended;  // true if A2DP output is suspended
 
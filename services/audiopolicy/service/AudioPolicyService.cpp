@@ -23,6 +23,7 @@
 #define __STDC_LIMIT_MACROS
 #include <stdint.h>
 
+#include <algorithm>
 #include <sys/time.h>
 #include <binder/IServiceManager.h>
 #include <utils/Log.h>
@@ -637,7 +638,7 @@ void AudioPolicyService::UidPolicy::updateUidLocked(std::unordered_map<uid_t, bo
 
 AudioPolicyService::AudioCommandThread::AudioCommandThread(String8 name,
                                                            const wp<AudioPolicyService>& service)
-    : Thread(false), mName(name), mService(service)
+    : Thread(false), mName(name), mService(service), mExecutedCount(0), mMergedCount(0)
 {
     mpToneGenerator = NULL;
 }
@@ -669,9 +670,11 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
             nsecs_t curTime = systemTime();
             // commands are sorted by increasing time stamp: execute them from index 0 and up
             if (mAudioCommands[0]->mTime <= curTime) {
-                sp<AudioCommand> command = mAudioCommands[0];
-                mAudioCommands.removeAt(0);
+                size_t index = nextCommandIndex_l(curTime);
+                sp<AudioCommand> command = mAudioCommands[index];
+                mAudioCommands.removeAt(index);
                 mLastCommand = command;
+                mLatencyNs[mExecutedCount++ % kLatencyWindow] = curTime - command->mTime;
 
                 switch (command->mCommand) {
                 case START_TONE: {
@@ -831,13 +834,12 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                 default:
                     ALOGW("AudioCommandThread() unknown command %d", command->mCommand);
                 }
-                {
-                    Mutex::Autolock _l(command->mLock);
-                    if (command->mWaitStatus) {
-                        command->mWaitStatus = false;
-                        command->mCond.signal();
-                    }
+                completeCommand(command);
+                for (size_t i = 0; i < command->mMergedCommands.size(); i++) {
+                    command->mMergedCommands[i]->mStatus = command->mStatus;
+                    completeCommand(command->mMergedCommands[i]);
                 }
+                command->mMergedCommands.clear();
                 waitTime = -1;
                 // release mLock before releasing strong reference on the service as
                 // AudioPolicyService destructor calls AudioCommandThread::exit() which
@@ -905,6 +907,19 @@ status_t AudioPolicyService::AudioCommandThread::dump(int fd)
     } else {
         result.append("     none\n");
     }
+    const size_t latencyCount =
+            mExecutedCount < kLatencyWindow ? mExecutedCount : kLatencyWindow;
+    nsecs_t latencySumNs = 0;
+    nsecs_t latencyMaxNs = 0;
+    for (size_t i = 0; i < latencyCount; i++) {
+        latencySumNs += mLatencyNs[i];
+        latencyMaxNs = std::max(latencyMaxNs, mLatencyNs[i]);
+    }
+    snprintf(buffer, SIZE, "- Executed %zu, merged %zu\n"
+             "- Queue latency over last %zu: average %.1f ms, max %.1f ms\n",
+             mExecutedCount, mMergedCount, latencyCount,
+             latencyCount == 0 ? 0. : latencySumNs / 1e6 / latencyCount, latencyMaxNs / 1e6);
+    result.append(buffer);
 
     write(fd, result.string(), result.size());
 
@@ -1141,6 +1156,128 @@ status_t AudioPolicyService::AudioCommandThread::sendCommand(sp<AudioCommand>& c
     return command->mStatus;
 }
 
+void AudioPolicyService::AudioCommandThread::completeCommand(const sp<AudioCommand>& command)
+{
+    Mutex::Autolock _l(command->mLock);
+    if (command->mWaitStatus) {
+        command->mWaitStatus = false;
+        command->mCond.signal();
+    }
+}
+
+// static
+bool AudioPolicyService::AudioCommandThread::isNotificationCommand(int command)
+{
+    switch (command) {
+    case UPDATE_AUDIOPORT_LIST:
+    case UPDATE_AUDIOPATCH_LIST:
+    case DYN_POLICY_MIX_STATE_UPDATE:
+    case RECORDING_CONFIGURATION_UPDATE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// static
+bool AudioPolicyService::AudioCommandThread::isRoutingCommand(int command)
+{
+    switch (command) {
+    case SET_PARAMETERS:
+    case START_OUTPUT:
+    case STOP_OUTPUT:
+    case RELEASE_OUTPUT:
+    case CREATE_AUDIO_PATCH:
+    case RELEASE_AUDIO_PATCH:
+    case SET_AUDIOPORT_CONFIG:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// nextCommandIndex_l() must be called with mLock held and mAudioCommands[0] due
+size_t AudioPolicyService::AudioCommandThread::nextCommandIndex_l(nsecs_t curTime) const
+{
+    // Notifications make binder calls to every client: let the commands which affect audio
+    // go first. Notifications keep their order with respect to each other.
+    for (size_t i = 0; i < mAudioCommands.size() && mAudioCommands[i]->mTime <= curTime; i++) {
+        if (!isNotificationCommand(mAudioCommands[i]->mCommand)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+// mergeCommand_l() must be called with mLock held, for a command without delay.
+// An immediate command supersedes a pending one with the same key, unless a routing command
+// is queued between them: the pending command then carries the new value, or the union of
+// the parameters, and completes the new command when executed.
+// Returns true if the command was merged and must not be inserted.
+bool AudioPolicyService::AudioCommandThread::mergeCommand_l(sp<AudioCommand>& command)
+{
+    for (ssize_t i = (ssize_t)mAudioCommands.size() - 1; i >= 0; i--) {
+        sp<AudioCommand> command2 = mAudioCommands[i];
+        if (command2->mCommand == command->mCommand) {
+            bool merged = true;
+            switch (command->mCommand) {
+            case SET_VOLUME: {
+                VolumeData *data = (VolumeData *)command->mParam.get();
+                VolumeData *data2 = (VolumeData *)command2->mParam.get();
+                merged = data->mIO == data2->mIO && data->mStream == data2->mStream;
+                if (merged) {
+                    ALOGV("Merging volume command on output %d for stream %d",
+                            data->mIO, data->mStream);
+                    command2->mParam = command->mParam;
+                }
+            } break;
+
+            case SET_VOICE_VOLUME:
+                ALOGV("Merging voice volume command");
+                command2->mParam = command->mParam;
+                break;
+
+            case SET_PARAMETERS: {
+                ParametersData *data = (ParametersData *)command->mParam.get();
+                ParametersData *data2 = (ParametersData *)command2->mParam.get();
+                merged = data->mIO == data2->mIO;
+                if (merged) {
+                    AudioParameter param = AudioParameter(data->mKeyValuePairs);
+                    AudioParameter param2 = AudioParameter(data2->mKeyValuePairs);
+                    for (size_t j = 0; j < param.size(); j++) {
+                        String8 key;
+                        String8 value;
+                        param.getAt(j, key, value);
+                        param2.remove(key);
+                        param2.add(key, value);
+                    }
+                    data2->mKeyValuePairs = param2.toString();
+                    ALOGV("Merging parameter command into %s", data2->mKeyValuePairs.string());
+                }
+            } break;
+
+            case UPDATE_AUDIOPORT_LIST:
+            case UPDATE_AUDIOPATCH_LIST:
+                break;
+
+            default:
+                merged = false;
+                break;
+            }
+            if (merged) {
+                command->mTime = command2->mTime;
+                command2->mMergedCommands.add(command);
+                mMergedCount++;
+                return true;
+            }
+        }
+        if (isRoutingCommand(command2->mCommand)) {
+            break;
+        }
+    }
+    return false;
+}
+
 // insertCommand_l() must be called with mLock held
 void AudioPolicyService::AudioCommandThread::insertCommand_l(sp<AudioCommand>& command, int delayMs)
 {
@@ -1153,6 +1290,13 @@ void AudioPolicyService::AudioCommandThread::insertCommand_l(sp<AudioCommand>& c
         acquire_wake_lock(PARTIAL_WAKE_LOCK, mName.string());
     }
 
+    // Without delayed commands pending, the filtering below has nothing to do but pending
+    // commands which are due can absorb this one.
+    if (delayMs == 0 && !mAudioCommands.isEmpty() &&
+            mAudioCommands.top()->mTime <= command->mTime && mergeCommand_l(command)) {
+        return;
+    }
+
     // check same pending commands with later time stamps and eliminate them
     for (i = (ssize_t)mAudioCommands.size()-1; i >= 0; i--) {
         sp<AudioCommand> command2 = mAudioCommands[i];
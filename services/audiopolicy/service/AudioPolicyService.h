@@ -389,6 +389,18 @@ private:
     private:
         class AudioCommandData;
 
+        // number of executed commands over which the queue latency is reported by dump()
+        static const size_t kLatencyWindow = 64;
+
+        // Client notifications yield to the other commands which are due.
+        static bool isNotificationCommand(int command);
+        // Commands which must not be reordered with one another.
+        static bool isRoutingCommand(int command);
+
+        bool        mergeCommand_l(sp<AudioCommand>& command);
+        size_t      nextCommandIndex_l(nsecs_t curTime) const;
+        void        completeCommand(const sp<AudioCommand>& command);
+
         // descriptor for requested tone playback event
         class AudioCommand: public RefBase {
 
@@ -405,6 +417,8 @@ private:
             status_t mStatus; // command status
             bool mWaitStatus; // true if caller is waiting for status
             sp<AudioCommandData> mParam;     // command specific parameter data
+            // commands collapsed into this one, completed with its status
+            Vector< sp<AudioCommand> > mMergedCommands;
         };
 
         class AudioCommandData: public RefBase {
@@ -497,6 +511,9 @@ private:
         sp<AudioCommand> mLastCommand;      // last processed command (used by dump)
         String8 mName;                      // string used by wake lock fo delayed commands
         wp<AudioPolicyService> mService;
+        nsecs_t mLatencyNs[kLatencyWindow]; // time from due to executed of the last commands
+        size_t mExecutedCount;              // commands executed
+        size_t mMergedCount;                // commands collapsed into a pending one
     };
 
     class AudioPolicyClient : public AudioPolicyClientInterface
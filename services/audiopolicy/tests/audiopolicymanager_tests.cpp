@@ -21,6 +21,7 @@
 
 #include "AudioPolicyTestClient.h"
 #include "AudioPolicyTestManager.h"
+#include "VolumeCurve.h"
 
 using namespace android;
 
@@ -194,3 +195,57 @@ TEST_F(AudioPolicyManagerTest, CreateAudioPatchFromMix) {
 }
 
 // TODO: Add patch creation tests that involve already existing patch
+
+TEST_F(AudioPolicyManagerTest, GetOutputForAttrRepeated) {
+    // Routing decisions are cached, creating the same track again must give the same result.
+    audio_attributes_t attr = {};
+    attr.usage = AUDIO_USAGE_MEDIA;
+    attr.content_type = AUDIO_CONTENT_TYPE_MUSIC;
+    audio_config_t config = AUDIO_CONFIG_INITIALIZER;
+    config.sample_rate = 48000;
+    config.format = AUDIO_FORMAT_PCM_16_BIT;
+    config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+    audio_io_handle_t firstOutput = AUDIO_IO_HANDLE_NONE;
+    for (int i = 0; i < 3; i++) {
+        audio_io_handle_t output = AUDIO_IO_HANDLE_NONE;
+        audio_session_t session = (audio_session_t) (i + 1);
+        audio_stream_type_t stream = AUDIO_STREAM_DEFAULT;
+        audio_output_flags_t flags = AUDIO_OUTPUT_FLAG_NONE;
+        audio_port_handle_t selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+        audio_port_handle_t portId = AUDIO_PORT_HANDLE_NONE;
+        ASSERT_EQ(NO_ERROR, mManager->getOutputForAttr(&attr, &output, session, &stream,
+                42 /*uid*/, &config, &flags, &selectedDeviceId, &portId));
+        ASSERT_NE(AUDIO_IO_HANDLE_NONE, output);
+        ASSERT_EQ(AUDIO_STREAM_MUSIC, stream);
+        if (i == 0) {
+            firstOutput = output;
+        } else {
+            ASSERT_EQ(firstOutput, output);
+        }
+        ASSERT_EQ(NO_ERROR, mManager->startOutput(output, stream, session));
+        ASSERT_EQ(NO_ERROR, mManager->stopOutput(output, stream, session));
+        mManager->releaseOutput(output, stream, session);
+    }
+}
+
+TEST(VolumeCurveTest, IndexToDbFollowsRangeAndCurve) {
+    sp<VolumeCurve> curve = new VolumeCurve(DEVICE_CATEGORY_SPEAKER, AUDIO_STREAM_MUSIC);
+    curve->add(CurvePoint(1, -4950));
+    curve->add(CurvePoint(33, -3350));
+    curve->add(CurvePoint(66, -1700));
+    curve->add(CurvePoint(100, 0));
+
+    EXPECT_FLOAT_EQ(-49.5f, curve->volIndexToDb(1, 0, 100));
+    EXPECT_FLOAT_EQ(-25.0f, curve->volIndexToDb(50, 0, 100));
+    EXPECT_FLOAT_EQ(0.0f, curve->volIndexToDb(100, 0, 100));
+    // out of range indices are clamped
+    EXPECT_FLOAT_EQ(0.0f, curve->volIndexToDb(150, 0, 100));
+
+    // a different index range for the same curve
+    EXPECT_FLOAT_EQ(-37.5f, curve->volIndexToDb(50, 0, 200));
+    EXPECT_FLOAT_EQ(-25.0f, curve->volIndexToDb(100, 0, 200));
+
+    // adding a point changes the curve
+    curve->add(CurvePoint(50, -1000));
+    EXPECT_NEAR(-10.0f, curve->volIndexToDb(50, 0, 100), 0.01f);
+}
@@ -56,7 +56,8 @@ LOCAL_SRC_FILES :=  \
     utils/CameraTraces.cpp \
     utils/AutoConditionLock.cpp \
     utils/TagMonitor.cpp \
-    utils/LatencyHistogram.cpp
+    utils/LatencyHistogram.cpp \
+    utils/CaptureLatencyTracker.cpp
 
 LOCAL_SHARED_LIBRARIES:= \
     libui \
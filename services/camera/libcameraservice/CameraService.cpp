@@ -991,8 +991,22 @@ void CameraService::finishConnectLocked(const sp<BasicClient>& client,
     }
 }
 
+status_t CameraService::queryProcessStates(int clientPid,
+        /*out*/ProcessStates* processStates) const {
+    processStates->pids = mActiveClientManager.getAllOwners();
+    processStates->pids.push_back(clientPid);
+    processStates->states.resize(processStates->pids.size());
+    processStates->scores.resize(processStates->pids.size());
+    processStates->queryTimeNs = systemTime();
+
+    return ProcessInfoService::getProcessStatesScoresFromPids(
+            processStates->pids.size(), &processStates->pids[0],
+            /*out*/&processStates->states[0], /*out*/&processStates->scores[0]);
+}
+
 status_t CameraService::handleEvictionsLocked(const String8& cameraId, int clientPid,
         apiLevel effectiveApiLevel, const sp<IBinder>& remoteCallback, const String8& packageName,
+        const ProcessStates& prefetched,
         /*out*/
         sp<BasicClient>* client,
         std::shared_ptr<resource_policy::ClientDescriptor<String8, sp<BasicClient>>>* partial) {
@@ -1026,18 +1040,28 @@ status_t CameraService::handleEvictionsLocked(const String8& cameraId, int clien
         std::vector<int> ownerPids(mActiveClientManager.getAllOwners());
         ownerPids.push_back(clientPid);
 
-        std::vector<int> priorityScores(ownerPids.size());
-        std::vector<int> states(ownerPids.size());
-
-        // Get priority scores of all active PIDs
-        status_t err = ProcessInfoService::getProcessStatesScoresFromPids(
-                ownerPids.size(), &ownerPids[0], /*out*/&states[0],
-                /*out*/&priorityScores[0]);
-        if (err != OK) {
-            ALOGE("%s: Priority score query failed: %d",
-                  __FUNCTION__, err);
-            return err;
+        // Get priority scores of all active PIDs, reusing the ones queried before
+        // mServiceLock was taken if they are still current
+        ProcessStates processStates;
+        bool prefetchHit = prefetched.pids == ownerPids &&
+                systemTime() - prefetched.queryTimeNs < kProcessStatePrefetchMaxAgeNs;
+        if (prefetchHit) {
+            processStates = prefetched;
+        } else {
+            status_t err = queryProcessStates(clientPid, &processStates);
+            if (err != OK) {
+                ALOGE("%s: Priority score query failed: %d",
+                      __FUNCTION__, err);
+                return err;
+            }
+            ownerPids = processStates.pids;
+        }
+        {
+            Mutex::Autolock l(mConnectStatsLock);
+            (prefetchHit ? mProcessStatePrefetchHits : mProcessStatePrefetchMisses)++;
         }
+        const std::vector<int>& priorityScores = processStates.scores;
+        const std::vector<int>& states = processStates.states;
 
         // Update all active clients' priorities
         std::map<int,resource_policy::ClientPriority> pidToPriorityMap;
@@ -1286,9 +1310,20 @@ Status CameraService::connectHelper(const sp<CALLBACK>& cameraCb, const String8&
             (halVersion == -1) ? "default" : std::to_string(halVersion).c_str(),
             static_cast<int>(effectiveApiLevel));
 
+    const nsecs_t connectStartNs = systemTime();
+
+    // Query process states before taking mServiceLock, so that the activity manager call
+    // does not serialize other connects unless the active clients change meanwhile.
+    ProcessStates prefetchedStates;
+    if (queryProcessStates(clientPid == USE_CALLING_PID ? getCallingPid() : clientPid,
+            &prefetchedStates) != OK) {
+        prefetchedStates = ProcessStates();
+    }
+
     sp<CLIENT> client = nullptr;
     {
         // Acquire mServiceLock and prevent other clients from connecting
+        const nsecs_t lockStartNs = systemTime();
         std::unique_ptr<AutoConditionLock> lock =
                 AutoConditionLock::waitAndAcquire(mServiceLockWrapper, DEFAULT_CONNECT_TIMEOUT_NS);
 
@@ -1299,6 +1334,7 @@ Status CameraService::connectHelper(const sp<CALLBACK>& cameraCb, const String8&
                     "Cannot open camera %s for \"%s\" (PID %d): Too many other clients connecting",
                     cameraId.string(), clientName8.string(), clientPid);
         }
+        recordConnectPhase(CONNECT_PHASE_LOCK_WAIT, systemTime() - lockStartNs);
 
         // Enforce client permissions and do basic sanity checks
         if(!(ret = validateConnectLocked(cameraId, clientName8,
@@ -1319,9 +1355,10 @@ Status CameraService::connectHelper(const sp<CALLBACK>& cameraCb, const String8&
 
         sp<BasicClient> clientTmp = nullptr;
         std::shared_ptr<resource_policy::ClientDescriptor<String8, sp<BasicClient>>> partial;
+        const nsecs_t evictionStartNs = systemTime();
         if ((err = handleEvictionsLocked(cameraId, originalClientPid, effectiveApiLevel,
-                IInterface::asBinder(cameraCb), clientName8, /*out*/&clientTmp,
-                /*out*/&partial)) != NO_ERROR) {
+                IInterface::asBinder(cameraCb), clientName8, prefetchedStates,
+                /*out*/&clientTmp, /*out*/&partial)) != NO_ERROR) {
             switch (err) {
                 case -ENODEV:
                     return STATUS_ERROR_FMT(ERROR_DISCONNECTED,
@@ -1338,6 +1375,8 @@ Status CameraService::connectHelper(const sp<CALLBACK>& cameraCb, const String8&
             }
         }
 
+        recordConnectPhase(CONNECT_PHASE_EVICTION, systemTime() - evictionStartNs);
+
         if (clientTmp.get() != nullptr) {
             // Handle special case for API1 MediaRecorder where the existing client is returned
             device = static_cast<CLIENT*>(clientTmp.get());
@@ -1355,6 +1394,7 @@ Status CameraService::connectHelper(const sp<CALLBACK>& cameraCb, const String8&
                     "Unable to get camera device \"%s\" facing", cameraId.string());
         }
 
+        const nsecs_t openStartNs = systemTime();
         sp<BasicClient> tmp = nullptr;
         if(!(ret = makeClient(this, cameraCb, clientPackageName,
                 cameraId, api1CameraId, facing,
@@ -1396,6 +1436,7 @@ Status CameraService::connectHelper(const sp<CALLBACK>& cameraCb, const String8&
                             strerror(-err), err);
             }
         }
+        recordConnectPhase(CONNECT_PHASE_DEVICE_OPEN, systemTime() - openStartNs);
 
         // Update shim paremeters for legacy clients
         if (effectiveApiLevel == API_1) {
@@ -1421,6 +1462,7 @@ Status CameraService::connectHelper(const sp<CALLBACK>& cameraCb, const String8&
         } else {
             // Otherwise, add client to active clients list
             finishConnectLocked(client, partial);
+            recordConnectPhase(CONNECT_PHASE_TOTAL, systemTime() - connectStartNs);
         }
     } // lock is destroyed, allow further connect calls
 
@@ -1430,6 +1472,30 @@ Status CameraService::connectHelper(const sp<CALLBACK>& cameraCb, const String8&
     return ret;
 }
 
+void CameraService::recordConnectPhase(ConnectPhase phase, nsecs_t durationNs) {
+    Mutex::Autolock l(mConnectStatsLock);
+    ConnectPhaseStats& stats = mConnectPhaseStats[phase];
+    stats.count++;
+    stats.totalNs += durationNs;
+    stats.maxNs = std::max(stats.maxNs, durationNs);
+}
+
+void CameraService::dumpConnectStats(int fd) {
+    static const char* const kPhaseNames[CONNECT_PHASE_COUNT] = {
+        "Lock wait", "Eviction", "Device open", "Total"
+    };
+    Mutex::Autolock l(mConnectStatsLock);
+    dprintf(fd, "Connect timing (count, avg ms, max ms):\n");
+    for (int i = 0; i < CONNECT_PHASE_COUNT; i++) {
+        const ConnectPhaseStats& stats = mConnectPhaseStats[i];
+        dprintf(fd, "    %-12s %" PRId64 ", %.2f, %.2f\n", kPhaseNames[i], stats.count,
+                stats.count == 0 ? 0. : stats.totalNs / (stats.count * 1e6),
+                stats.maxNs / 1e6);
+    }
+    dprintf(fd, "    Process states queried before locking: %" PRId64 " used, %" PRId64
+            " re-queried\n", mProcessStatePrefetchHits, mProcessStatePrefetchMisses);
+}
+
 Status CameraService::setTorchMode(const String16& cameraId, bool enabled,
         const sp<IBinder>& clientBinder) {
     Mutex::Autolock lock(mServiceLock);
@@ -2712,6 +2778,7 @@ status_t CameraService::dump(int fd, const Vector<String16>& args) {
     String8 activeClientString = mActiveClientManager.toString();
     dprintf(fd, "Active Camera Clients:\n%s", activeClientString.string());
     dprintf(fd, "Allowed user IDs: %s\n", toString(mAllowedUsers).string());
+    dumpConnectStats(fd);
 
     dumpEventLog(fd);
 
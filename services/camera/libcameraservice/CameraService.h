@@ -82,6 +82,9 @@ public:
     // 1 second busy timeout when other clients are disconnecting
     static const nsecs_t DEFAULT_DISCONNECT_TIMEOUT_NS = 1000000000;
 
+    // Process states queried before taking mServiceLock are reused for up to 50 ms
+    static const nsecs_t kProcessStatePrefetchMaxAgeNs = 50000000;
+
     // Default number of messages to store in eviction log
     static const size_t DEFAULT_EVENT_LOG_LENGTH = 100;
 
@@ -573,14 +576,53 @@ private:
     binder::Status validateClientPermissionsLocked(const String8& cameraId, const String8& clientName8,
             /*inout*/int& clientUid, /*inout*/int& clientPid, /*out*/int& originalClientPid) const;
 
+    // Process states and priority scores of the active client owners, with the connecting
+    // client's PID last, as returned by the activity manager at queryTimeNs.
+    struct ProcessStates {
+        std::vector<int> pids;
+        std::vector<int> states;
+        std::vector<int> scores;
+        nsecs_t queryTimeNs = 0;
+    };
+
+    // Query the process states of all active client owners and clientPid. The active client
+    // list is read from a snapshot, so this may be called without mServiceLock.
+    status_t queryProcessStates(int clientPid, /*out*/ProcessStates* processStates) const;
+
     // Handle active client evictions, and update service state.
-    // Only call with with mServiceLock held.
+    // Only call with with mServiceLock held. prefetched is used instead of querying the
+    // process states again if it is recent and covers the same PIDs.
     status_t handleEvictionsLocked(const String8& cameraId, int clientPid,
         apiLevel effectiveApiLevel, const sp<IBinder>& remoteCallback, const String8& packageName,
+        const ProcessStates& prefetched,
         /*out*/
         sp<BasicClient>* client,
         std::shared_ptr<resource_policy::ClientDescriptor<String8, sp<BasicClient>>>* partial);
 
+    // Phases of connectHelper() timed for dumpsys
+    enum ConnectPhase {
+        CONNECT_PHASE_LOCK_WAIT,   // waiting for mServiceLock
+        CONNECT_PHASE_EVICTION,    // conflict evaluation and evictions
+        CONNECT_PHASE_DEVICE_OPEN, // creating and initializing the client
+        CONNECT_PHASE_TOTAL,       // whole successful connect
+        CONNECT_PHASE_COUNT,
+    };
+
+    struct ConnectPhaseStats {
+        int64_t count = 0;
+        nsecs_t totalNs = 0;
+        nsecs_t maxNs = 0;
+    };
+
+    void recordConnectPhase(ConnectPhase phase, nsecs_t durationNs);
+    void dumpConnectStats(int fd);
+
+    // Guards mConnectPhaseStats and the prefetch counters
+    Mutex mConnectStatsLock;
+    ConnectPhaseStats mConnectPhaseStats[CONNECT_PHASE_COUNT];
+    int64_t mProcessStatePrefetchHits = 0;
+    int64_t mProcessStatePrefetchMisses = 0;
+
     // Single implementation shared between the various connect calls
     template<class CALLBACK, class CLIENT>
     binder::Status connectHelper(const sp<CALLBACK>& cameraCb, const String8& cameraId,
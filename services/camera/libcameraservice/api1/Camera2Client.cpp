@@ -384,6 +384,8 @@ status_t Camera2Client::dumpClient(int fd, const Vector<String16>& args) {
 
     mCaptureSequencer->dump(fd, args);
 
+    mJpegProcessor->dump(fd, args);
+
     mFrameProcessor->dump(fd, args);
 
     mZslProcessor->dump(fd, args);
@@ -18,6 +18,7 @@
 #define ATRACE_TAG ATRACE_TAG_CAMERA
 //#define LOG_NDEBUG 0
 
+#include <inttypes.h>
 #include <netinet/in.h>
 
 #include <binder/MemoryBase.h>
@@ -44,7 +45,9 @@ JpegProcessor::JpegProcessor(
         mId(client->getCameraId()),
         mCaptureDone(false),
         mCaptureSuccess(false),
-        mCaptureStreamId(NO_STREAM) {
+        mCaptureStreamId(NO_STREAM),
+        mLastJpegSize(0),
+        mLastJpegCopyDuration(0) {
 }
 
 JpegProcessor::~JpegProcessor() {
@@ -219,7 +222,13 @@ int JpegProcessor::getStreamId() const {
     return mCaptureStreamId;
 }
 
-void JpegProcessor::dump(int /*fd*/, const Vector<String16>& /*args*/) const {
+void JpegProcessor::dump(int fd, const Vector<String16>& /*args*/) const {
+    Mutex::Autolock l(mInputMutex);
+    String8 result = String8::format("    JPEG capture heap: %zu bytes, last JPEG: %zu bytes "
+            "copied in %" PRId64 " us\n",
+            (mCaptureHeap != 0) ? mCaptureHeap->getSize() : 0, mLastJpegSize,
+            ns2us(mLastJpegCopyDuration));
+    write(fd, result.string(), result.size());
 }
 
 bool JpegProcessor::threadLoop() {
@@ -294,12 +303,17 @@ status_t JpegProcessor::processNewCapture(bool captureSuccess) {
             jpegSize = heapSize;
         }
 
-        // TODO: Optimize this to avoid memcopy
+        // The BLOB buffer is gralloc memory that cannot be handed to the client as
+        // IMemory, so the copy stays; only the JPEG payload is copied, and the
+        // buffer goes back to the HAL as soon as it is done.
+        nsecs_t copyStart = systemTime();
         captureBuffer = new MemoryBase(mCaptureHeap, 0, jpegSize);
         void* captureMemory = mCaptureHeap->getBase();
         memcpy(captureMemory, imgBuffer.data, jpegSize);
 
         mCaptureConsumer->unlockBuffer(imgBuffer);
+        mLastJpegSize = jpegSize;
+        mLastJpegCopyDuration = systemTime() - copyStart;
     }
 
     sp<CaptureSequencer> sequencer = mSequencer.promote();
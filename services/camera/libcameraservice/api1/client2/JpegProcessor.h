@@ -79,6 +79,11 @@ class JpegProcessor:
     sp<Surface>        mCaptureWindow;
     sp<MemoryHeapBase> mCaptureHeap;
 
+    // Size of the last JPEG handed to the client and how long the copy out of
+    // the BLOB buffer took
+    size_t             mLastJpegSize;
+    nsecs_t            mLastJpegCopyDuration;
+
     virtual bool threadLoop();
 
     status_t processNewCapture(bool captureSuccess);
@@ -26,6 +26,7 @@
 #endif
 
 #include <inttypes.h>
+#include <algorithm>
 
 #include <utils/Log.h>
 #include <utils/Trace.h>
@@ -133,6 +134,7 @@ ZslProcessor::ZslProcessor(
         mId(client->getCameraId()),
         mZslStreamId(NO_STREAM),
         mInputStreamId(NO_STREAM),
+        mObservedPipelineDepth(0),
         mFrameListHead(0),
         mHasFocuser(false),
         mInputBuffer(nullptr),
@@ -168,6 +170,7 @@ ZslProcessor::ZslProcessor(
     // Need to keep buffer queue longer than metadata queue because sometimes buffer arrives
     // earlier than metadata which causes the buffer corresponding to oldest metadata being
     // removed.
+    mMaxPipelineDepth = pipelineMaxDepth;
     mFrameListDepth = pipelineMaxDepth;
     mBufferQueueDepth = mFrameListDepth + 1;
 
@@ -203,6 +206,11 @@ void ZslProcessor::onResultAvailable(const CaptureResult &result) {
 
     ALOGVV("Got preview metadata for frame %d with timestamp %" PRId64, frameNumber, timestamp);
 
+    entry = result.mMetadata.find(ANDROID_REQUEST_PIPELINE_DEPTH);
+    if (entry.count > 0 && entry.data.u8[0] > mObservedPipelineDepth) {
+        mObservedPipelineDepth = entry.data.u8[0];
+    }
+
     if (mState != RUNNING) return;
 
     // Corresponding buffer has been cleared. No need to push into mFrameList
@@ -244,6 +252,8 @@ status_t ZslProcessor::updateStream(const Parameters &params) {
     }
 
     if (mZslStreamId == NO_STREAM) {
+        updateQueueDepthLocked();
+
         // Create stream for HAL production
         // TODO: Sort out better way to select resolution for ZSL
 
@@ -674,6 +684,26 @@ void ZslProcessor::clearZslResultQueueLocked() {
     mFrameList.insertAt(0, mFrameListDepth);
 }
 
+void ZslProcessor::updateQueueDepthLocked() {
+    // Until preview results tell us how deep the pipeline actually runs, keep
+    // enough frames for the worst case the HAL advertises. Once known, one frame
+    // of slack on top of the observed latency is enough to find a candidate, and
+    // every ZSL buffer not kept in the ring is a full-size buffer saved.
+    size_t frameListDepth = mMaxPipelineDepth;
+    if (mObservedPipelineDepth > 0) {
+        frameListDepth = std::min(mMaxPipelineDepth, mObservedPipelineDepth + 1);
+    }
+    if (frameListDepth == mFrameListDepth) return;
+
+    ALOGV("%s: Camera %d: ZSL frame list depth %zu -> %zu (observed pipeline depth %zu)",
+            __FUNCTION__, mId, mFrameListDepth, frameListDepth, mObservedPipelineDepth);
+    mFrameListDepth = frameListDepth;
+    mBufferQueueDepth = mFrameListDepth + 1;
+    clearZslResultQueueLocked();
+    mZslQueue.clear();
+    mZslQueue.insertAt(0, mBufferQueueDepth);
+}
+
 void ZslProcessor::dump(int fd, const Vector<String16>& /*args*/) const {
     Mutex::Autolock l(mInputMutex);
     if (!mLatestCapturedRequest.isEmpty()) {
@@ -684,6 +714,9 @@ void ZslProcessor::dump(int fd, const Vector<String16>& /*args*/) const {
         String8 result("    Latest ZSL capture request: none yet\n");
         write(fd, result.string(), result.size());
     }
+    String8 depths = String8::format("    ZSL frame list depth: %zu (max pipeline depth %zu, "
+            "observed %zu)\n", mFrameListDepth, mMaxPipelineDepth, mObservedPipelineDepth);
+    write(fd, depths.string(), depths.size());
     dumpZslQueue(fd);
 }
 
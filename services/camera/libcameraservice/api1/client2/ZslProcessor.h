@@ -123,6 +123,9 @@ class ZslProcessor :
     };
 
     static const int32_t kDefaultMaxPipelineDepth = 4;
+    size_t mMaxPipelineDepth;
+    // Deepest pipeline reported by preview results so far, 0 if none seen yet
+    size_t mObservedPipelineDepth;
     size_t mBufferQueueDepth;
     size_t mFrameListDepth;
     Vector<CameraMetadata> mFrameList;
@@ -151,6 +154,9 @@ class ZslProcessor :
 
     void clearZslResultQueueLocked();
 
+    // Size the buffer and metadata rings for the observed capture latency
+    void updateQueueDepthLocked();
+
     void dumpZslQueue(int id) const;
 
     nsecs_t getCandidateTimestampLocked(size_t* metadataIdx) const;
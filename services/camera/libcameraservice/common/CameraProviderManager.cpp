@@ -22,6 +22,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <future>
 #include <inttypes.h>
 #include <hidl/ServiceManagement.h>
 #include <functional>
@@ -67,9 +68,14 @@ status_t CameraProviderManager::initialize(wp<CameraProviderManager::StatusListe
         return INVALID_OPERATION;
     }
 
-    // See if there's a passthrough HAL, but let's not complain if there's not
-    addProviderLocked(kLegacyProviderName, /*expected*/ false);
-    addProviderLocked(kExternalProviderName, /*expected*/ false);
+    // See if there's a passthrough HAL, but let's not complain if there's not.
+    // The providers are independent, so enumerate them in parallel; an external provider with
+    // USB cameras attached can take a while to report characteristics.
+    nsecs_t start = systemTime();
+    addProvidersLocked({kLegacyProviderName, kExternalProviderName}, /*expected*/ false);
+    mInitializeDuration = systemTime() - start;
+    ALOGI("%s: Camera providers initialized in %" PRId64 " ms", __FUNCTION__,
+            ns2ms(mInitializeDuration));
 
     return OK;
 }
@@ -353,6 +359,8 @@ hardware::Return<void> CameraProviderManager::onRegistration(
 status_t CameraProviderManager::dump(int fd, const Vector<String16>& args) {
     std::lock_guard<std::mutex> lock(mInterfaceMutex);
 
+    dprintf(fd, "Camera provider initialization time: %" PRId64 " ms\n",
+            ns2ms(mInitializeDuration));
     for (auto& provider : mProviders) {
         provider->dump(fd, args);
     }
@@ -424,37 +432,68 @@ bool CameraProviderManager::isLogicalCamera(const CameraMetadata& staticInfo,
 }
 
 status_t CameraProviderManager::addProviderLocked(const std::string& newProvider, bool expected) {
-    for (const auto& providerInfo : mProviders) {
-        if (providerInfo->mProviderName == newProvider) {
+    return addProvidersLocked({newProvider}, expected);
+}
+
+status_t CameraProviderManager::addProvidersLocked(const std::vector<std::string>& newProviders,
+        bool expected) {
+    status_t result = OK;
+    std::vector<sp<ProviderInfo>> providerInfos;
+    for (const auto& newProvider : newProviders) {
+        bool registered = false;
+        for (const auto& providerInfo : mProviders) {
+            if (providerInfo->mProviderName == newProvider) {
+                registered = true;
+                break;
+            }
+        }
+        if (registered) {
             ALOGW("%s: Camera provider HAL with name '%s' already registered", __FUNCTION__,
                     newProvider.c_str());
-            return ALREADY_EXISTS;
+            if (result == OK) result = ALREADY_EXISTS;
+            continue;
         }
-    }
 
-    sp<provider::V2_4::ICameraProvider> interface;
-    interface = mServiceProxy->getService(newProvider);
+        sp<provider::V2_4::ICameraProvider> interface;
+        interface = mServiceProxy->getService(newProvider);
 
-    if (interface == nullptr) {
-        if (expected) {
-            ALOGE("%s: Camera provider HAL '%s' is not actually available", __FUNCTION__,
-                    newProvider.c_str());
-            return BAD_VALUE;
-        } else {
-            return OK;
+        if (interface == nullptr) {
+            if (expected) {
+                ALOGE("%s: Camera provider HAL '%s' is not actually available", __FUNCTION__,
+                        newProvider.c_str());
+                if (result == OK) result = BAD_VALUE;
+            }
+            continue;
         }
+
+        providerInfos.push_back(new ProviderInfo(newProvider, interface, this));
     }
 
-    sp<ProviderInfo> providerInfo =
-            new ProviderInfo(newProvider, interface, this);
-    status_t res = providerInfo->initialize();
-    if (res != OK) {
-        return res;
+    // Only enumerate on separate threads when there is more than one provider to wait for
+    std::vector<status_t> initResults(providerInfos.size(), OK);
+    if (providerInfos.size() == 1) {
+        initResults[0] = providerInfos[0]->initialize();
+    } else if (providerInfos.size() > 1) {
+        std::vector<std::future<status_t>> pending;
+        for (auto& providerInfo : providerInfos) {
+            pending.push_back(std::async(std::launch::async,
+                    [providerInfo]() { return providerInfo->initialize(); }));
+        }
+        for (size_t i = 0; i < pending.size(); i++) {
+            initResults[i] = pending[i].get();
+        }
     }
 
-    mProviders.push_back(providerInfo);
+    for (size_t i = 0; i < providerInfos.size(); i++) {
+        if (initResults[i] != OK) {
+            if (result == OK) result = initResults[i];
+            continue;
+        }
+        providerInfos[i]->removeDevicesAlreadyRegisteredLocked();
+        mProviders.push_back(providerInfos[i]);
+    }
 
-    return OK;
+    return result;
 }
 
 status_t CameraProviderManager::removeProvider(const std::string& provider) {
@@ -509,6 +548,7 @@ CameraProviderManager::ProviderInfo::ProviderInfo(
 }
 
 status_t CameraProviderManager::ProviderInfo::initialize() {
+    nsecs_t start = systemTime();
     status_t res = parseProviderName(mProviderName, &mType, &mId);
     if (res != OK) {
         ALOGE("%s: Invalid provider name, ignoring", __FUNCTION__);
@@ -574,13 +614,29 @@ status_t CameraProviderManager::ProviderInfo::initialize() {
         }
     }
 
-    ALOGI("Camera provider %s ready with %zu camera devices",
-            mProviderName.c_str(), mDevices.size());
+    mInitializeDuration = systemTime() - start;
+    ALOGI("Camera provider %s ready with %zu camera devices in %" PRId64 " ms",
+            mProviderName.c_str(), mDevices.size(), ns2ms(mInitializeDuration));
 
     mInitialized = true;
     return OK;
 }
 
+void CameraProviderManager::ProviderInfo::removeDevicesAlreadyRegisteredLocked() {
+    std::vector<std::string> duplicates;
+    for (auto& deviceInfo : mDevices) {
+        if (mManager->isValidDeviceLocked(deviceInfo->mId, deviceInfo->mVersion.get_major())) {
+            ALOGE("%s: Device %s: ID %s is already in use for device major version %d",
+                    __FUNCTION__, deviceInfo->mName.c_str(), deviceInfo->mId.c_str(),
+                    deviceInfo->mVersion.get_major());
+            duplicates.push_back(deviceInfo->mId);
+        }
+    }
+    for (auto& id : duplicates) {
+        removeDevice(id);
+    }
+}
+
 const std::string& CameraProviderManager::ProviderInfo::getType() const {
     return mType;
 }
@@ -664,6 +720,7 @@ status_t CameraProviderManager::ProviderInfo::dump(int fd, const Vector<String16
     dprintf(fd, "== Camera Provider HAL %s (v2.4, %s) static info: %zu devices: ==\n",
             mProviderName.c_str(), mInterface->isRemote() ? "remote" : "passthrough",
             mDevices.size());
+    dprintf(fd, "  Initialization time: %" PRId64 " ms\n", ns2ms(mInitializeDuration));
 
     for (auto& device : mDevices) {
         dprintf(fd, "== Camera HAL device %s (v%d.%d) static information: ==\n", device->mName.c_str(),
@@ -26,6 +26,7 @@
 #include <camera/CameraMetadata.h>
 #include <camera/CameraBase.h>
 #include <utils/Errors.h>
+#include <utils/Timers.h>
 #include <android/hardware/camera/common/1.0/types.h>
 #include <android/hardware/camera/provider/2.4/ICameraProvider.h>
 //#include <android/hardware/camera/provider/2.4/ICameraProviderCallbacks.h>
@@ -265,6 +266,10 @@ private:
 
         const std::string& getType() const;
 
+        // Drop devices whose ID is already served by a registered provider. Used when
+        // providers were enumerated in parallel and couldn't check against each other.
+        void removeDevicesAlreadyRegisteredLocked();
+
         status_t addDevice(const std::string& name,
                 hardware::camera::common::V1_0::CameraDeviceStatus initialStatus =
                 hardware::camera::common::V1_0::CameraDeviceStatus::PRESENT,
@@ -373,6 +378,9 @@ private:
 
         bool mInitialized = false;
 
+        // Time taken by initialize(), including device enumeration
+        nsecs_t mInitializeDuration = 0;
+
         // Templated method to instantiate the right kind of DeviceInfo and call the
         // right CameraProvider getCameraDeviceInterface_* method.
         template<class DeviceInfoT>
@@ -409,6 +417,13 @@ private:
 
     status_t addProviderLocked(const std::string& newProvider, bool expected = true);
 
+    // Add several providers, enumerating their devices in parallel. Returns the first error.
+    status_t addProvidersLocked(const std::vector<std::string>& newProviders,
+            bool expected = true);
+
+    // Time taken to add the providers known at initialize()
+    nsecs_t mInitializeDuration = 0;
+
     status_t removeProvider(const std::string& provider);
     sp<StatusListener> getStatusListener() const;
 
@@ -20,6 +20,7 @@
 
 #include <gui/ISurfaceComposer.h>
 #include <private/gui/ComposerService.h>
+#include <ui/PixelFormat.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include "utils/CameraTraces.h"
@@ -29,7 +30,12 @@ namespace android {
 
 namespace camera3 {
 
-Camera3BufferManager::Camera3BufferManager() {
+Camera3BufferManager::Camera3BufferManager() :
+        mCurrentBufferBytes(0),
+        mPeakBufferBytes(0),
+        mBufferByteNs(0),
+        mStatsStartTime(systemTime()),
+        mLastStatsUpdateTime(mStatsStartTime) {
 }
 
 Camera3BufferManager::~Camera3BufferManager() {
@@ -152,6 +158,7 @@ status_t Camera3BufferManager::unregisterStream(int streamId, int streamSetId) {
     if (handOutBufferCounts.size() == 0 && infoMap.size() == 0) {
         mStreamSetMap.removeItem(streamSetId);
     }
+    updateMemoryStatsLocked();
 
     return OK;
 }
@@ -162,6 +169,7 @@ void Camera3BufferManager::notifyBufferRemoved(int streamId, int streamSetId) {
     size_t& attachedBufferCount =
             streamSet.attachedBufferCountMap.editValueFor(streamId);
     attachedBufferCount--;
+    updateMemoryStatsLocked();
 }
 
 status_t Camera3BufferManager::checkAndFreeBufferOnOtherStreamsLocked(
@@ -197,10 +205,7 @@ status_t Camera3BufferManager::checkAndFreeBufferOnOtherStreamsLocked(
 
     // This will drop the reference to one free buffer, which will effectively free one
     // buffer (from the free buffer list) for the inactive streams.
-    size_t totalAllocatedBufferCount = 0;
-    for (size_t i = 0; i < streamSet.attachedBufferCountMap.size(); i++) {
-        totalAllocatedBufferCount += streamSet.attachedBufferCountMap[i];
-    }
+    size_t totalAllocatedBufferCount = getTotalAttachedBufferCount(streamSet);
     if (totalAllocatedBufferCount > streamSet.allocatedBufferWaterMark) {
         ALOGV("Stream %d: Freeing buffer: detach", firstOtherStreamId);
         sp<Camera3OutputStream> stream =
@@ -230,6 +235,7 @@ status_t Camera3BufferManager::checkAndFreeBufferOnOtherStreamsLocked(
             size_t& otherAttachedBufferCount =
                     streamSet.attachedBufferCountMap.editValueFor(firstOtherStreamId);
             otherAttachedBufferCount--;
+            updateMemoryStatsLocked();
         }
     }
 
@@ -292,6 +298,7 @@ status_t Camera3BufferManager::getBufferForStream(int streamId, int streamSetId,
         // Increase the hand-out and attached buffer counts for tracking purposes.
         bufferCount++;
         attachedBufferCount++;
+        updateMemoryStatsLocked();
         // Update the water mark to be the max hand-out buffer count + 1. An additional buffer is
         // added to reduce the chance of buffer allocation during stream steady state, especially
         // for cases where one stream is active, the other stream may request some buffers randomly.
@@ -306,17 +313,27 @@ status_t Camera3BufferManager::getBufferForStream(int streamId, int streamSetId,
         // Proactively free buffers for other streams if the current number of allocated buffers
         // exceeds the water mark. This only for Gralloc V1, for V2, this logic can also be handled
         // in returnBufferForStream() if we want to free buffer more quickly.
-        // TODO: probably should find out all the inactive stream IDs, and free the firstly found
-        // buffers for them.
-        res = checkAndFreeBufferOnOtherStreamsLocked(streamId, streamSetId);
-        if (res != OK) {
-            return res;
-        }
-        // Since we just allocated one new buffer above, try free one more buffer from other streams
-        // to prevent total buffer count from growing
-        res = checkAndFreeBufferOnOtherStreamsLocked(streamId, streamSetId);
-        if (res != OK) {
-            return res;
+        // Keep freeing idle buffers of the other streams until the set is back under its water
+        // mark, rather than at most two, so a stream that went inactive hands back everything it
+        // no longer needs. Each pass frees at most one buffer; stop once a pass makes no progress.
+        // Note that streamSet may be reallocated while mLock is dropped inside the call.
+        size_t maxPasses = kMaxBufferCount;
+        while (maxPasses-- > 0) {
+            size_t attachedBefore =
+                    getTotalAttachedBufferCount(mStreamSetMap.valueFor(streamSetId));
+            res = checkAndFreeBufferOnOtherStreamsLocked(streamId, streamSetId);
+            if (res != OK) {
+                return res;
+            }
+            if (!checkIfStreamRegisteredLocked(streamId, streamSetId)) {
+                break;
+            }
+            const StreamSet& currentSet = mStreamSetMap.valueFor(streamSetId);
+            size_t attachedAfter = getTotalAttachedBufferCount(currentSet);
+            if (attachedAfter >= attachedBefore ||
+                    attachedAfter <= currentSet.allocatedBufferWaterMark) {
+                break;
+            }
         }
     } else {
         // TODO: implement this.
@@ -422,6 +439,7 @@ status_t Camera3BufferManager::onBuffersRemoved(int streamId, int streamSetId, s
 
         totalHandoutCount -= count;
         totalAttachedCount -= count;
+        updateMemoryStatsLocked();
         ALOGV("%s: Stream %d set %d: Buffer count now %zu, attached buffer count now %zu",
                 __FUNCTION__, streamId, streamSetId, totalHandoutCount, totalAttachedCount);
     } else {
@@ -438,6 +456,14 @@ void Camera3BufferManager::dump(int fd, const Vector<String16>& args) const {
     (void) args;
     String8 lines;
     lines.appendFormat("      Total stream sets: %zu\n", mStreamSetMap.size());
+    nsecs_t now = systemTime();
+    nsecs_t elapsed = now - mStatsStartTime;
+    double averageBytes = (elapsed > 0) ?
+            (mBufferByteNs + double(mCurrentBufferBytes) * (now - mLastStatsUpdateTime)) /
+            elapsed : mCurrentBufferBytes;
+    lines.appendFormat("      Estimated buffer memory: current %zu KB, peak %zu KB,"
+            " average %.0f KB\n", mCurrentBufferBytes / 1024, mPeakBufferBytes / 1024,
+            averageBytes / 1024);
     for (size_t i = 0; i < mStreamSetMap.size(); i++) {
         lines.appendFormat("        Stream set %d has below streams:\n", mStreamSetMap.keyAt(i));
         for (size_t j = 0; j < mStreamSetMap[i].streamInfoMap.size(); j++) {
@@ -465,6 +491,47 @@ void Camera3BufferManager::dump(int fd, const Vector<String16>& args) const {
     write(fd, lines.string(), lines.size());
 }
 
+size_t Camera3BufferManager::getTotalAttachedBufferCount(const StreamSet& streamSet) {
+    size_t total = 0;
+    for (size_t i = 0; i < streamSet.attachedBufferCountMap.size(); i++) {
+        total += streamSet.attachedBufferCountMap[i];
+    }
+    return total;
+}
+
+size_t Camera3BufferManager::estimateBufferSize(const StreamInfo& info) {
+    size_t pixels = static_cast<size_t>(info.width) * info.height;
+    ssize_t bpp = bytesPerPixel(static_cast<PixelFormat>(info.format));
+    if (bpp > 0) {
+        return pixels * bpp;
+    }
+    // YUV and implementation defined formats; assume 4:2:0 subsampling.
+    return pixels * 3 / 2;
+}
+
+void Camera3BufferManager::updateMemoryStatsLocked() {
+    nsecs_t now = systemTime();
+    mBufferByteNs += double(mCurrentBufferBytes) * (now - mLastStatsUpdateTime);
+    mLastStatsUpdateTime = now;
+
+    size_t totalBytes = 0;
+    for (size_t i = 0; i < mStreamSetMap.size(); i++) {
+        const StreamSet& streamSet = mStreamSetMap[i];
+        for (size_t j = 0; j < streamSet.attachedBufferCountMap.size(); j++) {
+            ssize_t infoIdx = streamSet.streamInfoMap.indexOfKey(
+                    streamSet.attachedBufferCountMap.keyAt(j));
+            if (infoIdx != NAME_NOT_FOUND) {
+                totalBytes += streamSet.attachedBufferCountMap[j] *
+                        estimateBufferSize(streamSet.streamInfoMap[infoIdx]);
+            }
+        }
+    }
+    mCurrentBufferBytes = totalBytes;
+    if (totalBytes > mPeakBufferBytes) {
+        mPeakBufferBytes = totalBytes;
+    }
+}
+
 bool Camera3BufferManager::checkIfStreamRegisteredLocked(int streamId, int streamSetId) const {
     ssize_t setIdx = mStreamSetMap.indexOfKey(streamSetId);
     if (setIdx == NAME_NOT_FOUND) {
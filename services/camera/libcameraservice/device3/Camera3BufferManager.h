@@ -305,6 +305,32 @@ private:
      * free one if so.
      */
     status_t checkAndFreeBufferOnOtherStreamsLocked(int streamId, int streamSetId);
+
+    /**
+     * Total count of the buffers attached to all streams of a stream set.
+     */
+    static size_t getTotalAttachedBufferCount(const StreamSet& streamSet);
+
+    /**
+     * Rough size in bytes of one buffer for the given stream, used for memory statistics only.
+     */
+    static size_t estimateBufferSize(const StreamInfo& info);
+
+    /**
+     * Recompute the estimated memory held by attached buffers and update the peak and
+     * time-weighted average. Must be called with mLock held after attached counts change.
+     */
+    void updateMemoryStatsLocked();
+
+    /**
+     * Estimated buffer memory statistics across all stream sets, guarded by mLock.
+     */
+    size_t mCurrentBufferBytes;
+    size_t mPeakBufferBytes;
+    // Integral of mCurrentBufferBytes over time, in byte-nanoseconds.
+    double mBufferByteNs;
+    nsecs_t mStatsStartTime;
+    nsecs_t mLastStatsUpdateTime;
 };
 
 } // namespace camera3
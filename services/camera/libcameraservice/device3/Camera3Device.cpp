@@ -83,6 +83,7 @@ Camera3Device::Camera3Device(const String8 &id):
     ATRACE_CALL();
     camera3_callback_ops::notify = &sNotify;
     camera3_callback_ops::process_capture_result = &sProcessCaptureResult;
+    mLatencyTracker = std::make_shared<CaptureLatencyTracker>();
     ALOGV("%s: Created device for camera %s", __FUNCTION__, mId.string());
 }
 
@@ -204,7 +205,8 @@ status_t Camera3Device::initializeCommonLocked() {
         sessionParamKeys.insertArrayAt(sessionKeysEntry.data.i32, 0, sessionKeysEntry.count);
     }
     /** Start up request queue thread */
-    mRequestThread = new RequestThread(this, mStatusTracker, mInterface, sessionParamKeys);
+    mRequestThread = new RequestThread(this, mStatusTracker, mInterface, sessionParamKeys,
+            mLatencyTracker);
     res = mRequestThread->run(String8::format("C3Dev-%s-ReqQueue", mId.string()).string());
     if (res != OK) {
         SET_ERR_L("Unable to start request queue thread: %s (%d)",
@@ -607,6 +609,9 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
                 mTagMonitor.disableMonitoring();
             }
         }
+        if (args[i] == CaptureLatencyTracker::kLatencyOption && i + 1 < n) {
+            mLatencyTracker->setEnabled(String8(args[i + 1]) == "on");
+        }
     }
 
     String8 lines;
@@ -630,6 +635,8 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
                 StreamConfigurationMode::CONSTRAINED_HIGH_SPEED_MODE) ? "CONSTRAINED_HIGH_SPEED" :
             "CUSTOM";
     lines.appendFormat("    Operation mode: %s (%d) \n", mode, mOperatingMode);
+    lines.appendFormat("    Last HAL configuration time: %" PRId64 " us\n",
+            ns2us(mLastConfigureDuration));
 
     if (mInputStream != NULL) {
         write(fd, lines.string(), lines.size());
@@ -703,6 +710,7 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
     }
 
     mTagMonitor.dumpMonitoredMetadata(fd);
+    mLatencyTracker->dump(fd);
 
     if (mInterface->valid()) {
         lines = String8("     HAL device dump:\n");
@@ -951,9 +959,15 @@ hardware::Return<void> Camera3Device::processCaptureResult(
 
 status_t Camera3Device::readOneCameraMetadataLocked(
         uint64_t fmqResultSize, hardware::camera::device::V3_2::CameraMetadata& resultMetadata,
-        const hardware::camera::device::V3_2::CameraMetadata& result) {
+        const hardware::camera::device::V3_2::CameraMetadata& result,
+        std::vector<uint8_t>* fmqBuffer) {
     if (fmqResultSize > 0) {
-        resultMetadata.resize(fmqResultSize);
+        if (fmqBuffer != nullptr) {
+            fmqBuffer->resize(fmqResultSize);
+            resultMetadata.setToExternal(fmqBuffer->data(), fmqResultSize);
+        } else {
+            resultMetadata.resize(fmqResultSize);
+        }
         if (mResultMetadataQueue == nullptr) {
             return NO_MEMORY; // logged in initialize()
         }
@@ -992,7 +1006,8 @@ void Camera3Device::processOneCaptureResultLocked(
 
     // Read and validate the result metadata.
     hardware::camera::device::V3_2::CameraMetadata resultMetadata;
-    res = readOneCameraMetadataLocked(result.fmqResultSize, resultMetadata, result.result);
+    res = readOneCameraMetadataLocked(result.fmqResultSize, resultMetadata, result.result,
+            &mResultMetadataBuffer);
     if (res != OK) {
         ALOGE("%s: Frame %d: Failed to read capture result metadata",
                 __FUNCTION__, result.frameNumber);
@@ -1912,6 +1927,8 @@ status_t Camera3Device::getNextResult(CaptureResult *frame) {
     frame->mMetadata.acquire(result.mMetadata);
     frame->mPhysicalMetadatas = std::move(result.mPhysicalMetadatas);
     mResultQueue.erase(mResultQueue.begin());
+    mLatencyTracker->record(CaptureLatencyTracker::CLIENT_DELIVERY,
+            static_cast<uint32_t>(frame->mResultExtras.frameNumber));
 
     return OK;
 }
@@ -2344,6 +2361,59 @@ void Camera3Device::cancelStreamsConfigurationLocked() {
     if (res != OK) {
         ALOGE("%s: Camera %s: Preparer thread failed to resume!", __FUNCTION__, mId.string());
     }
+    mConfiguredStreamFingerprint.clear();
+}
+
+std::vector<int64_t> Camera3Device::getStreamConfigFingerprintLocked(int operatingMode) const {
+    std::vector<int64_t> fingerprint;
+    fingerprint.reserve(1 + 5 * ((mInputStream != nullptr) + mOutputStreams.size()));
+    fingerprint.push_back(operatingMode);
+
+    auto addStream = [&fingerprint](const sp<Camera3StreamInterface>& stream) {
+        fingerprint.push_back(stream->getId());
+        fingerprint.push_back(stream->getWidth());
+        fingerprint.push_back(stream->getHeight());
+        fingerprint.push_back(stream->isFormatOverridden() ?
+                stream->getOriginalFormat() : stream->getFormat());
+        fingerprint.push_back(stream->isDataSpaceOverridden() ?
+                stream->getOriginalDataSpace() : stream->getDataSpace());
+    };
+    if (mInputStream != nullptr) {
+        addStream(mInputStream);
+    }
+    for (size_t i = 0; i < mOutputStreams.size(); i++) {
+        addStream(mOutputStreams[i]);
+    }
+
+    return fingerprint;
+}
+
+bool Camera3Device::isSameMetadata(const CameraMetadata& lhs,
+        const CameraMetadata& rhs) {
+    if (lhs.isEmpty() || rhs.isEmpty() || lhs.entryCount() != rhs.entryCount()) {
+        return false;
+    }
+
+    const camera_metadata_t *lhsBuffer = lhs.getAndLock();
+    const camera_metadata_t *rhsBuffer = rhs.getAndLock();
+    bool same = true;
+    size_t entryCount = get_camera_metadata_entry_count(lhsBuffer);
+    for (size_t i = 0; same && i < entryCount; i++) {
+        camera_metadata_ro_entry_t lhsEntry, rhsEntry;
+        if (get_camera_metadata_ro_entry(lhsBuffer, i, &lhsEntry) != OK ||
+                get_camera_metadata_ro_entry(rhsBuffer, i, &rhsEntry) != OK) {
+            same = false;
+            break;
+        }
+        same = (lhsEntry.tag == rhsEntry.tag) && (lhsEntry.type == rhsEntry.type) &&
+                (lhsEntry.count == rhsEntry.count) &&
+                (memcmp(lhsEntry.data.u8, rhsEntry.data.u8,
+                        lhsEntry.count * camera_metadata_type_size[lhsEntry.type]) == 0);
+    }
+    lhs.unlock(lhsBuffer);
+    rhs.unlock(rhsBuffer);
+
+    return same;
 }
 
 bool Camera3Device::reconfigureCamera(const CameraMetadata& sessionParams) {
@@ -2408,6 +2478,22 @@ status_t Camera3Device::configureStreamsLocked(int operatingMode,
         return OK;
     }
 
+    // Streams are only ever created with a new id, so an unchanged fingerprint means
+    // the HAL already holds exactly this configuration and the streams are still
+    // configured; only a change of session parameters would require going to the HAL.
+    std::vector<int64_t> fingerprint = getStreamConfigFingerprintLocked(operatingMode);
+    if (mStatus == STATUS_CONFIGURED && mDeletedStreams.size() == 0 &&
+            fingerprint == mConfiguredStreamFingerprint &&
+            ((sessionParams.isEmpty() && mSessionParams.isEmpty()) ||
+             isSameMetadata(sessionParams, mSessionParams))) {
+        ALOGV("%s: Camera %s: Skipping config, stream configuration unchanged",
+                __FUNCTION__, mId.string());
+        mNeedConfig = false;
+        return OK;
+    }
+    mConfiguredStreamFingerprint.clear();
+    nsecs_t configureStart = systemTime();
+
     // Workaround for device HALv3.2 or older spec bug - zero streams requires
     // adding a dummy stream instead.
     // TODO: Bug: 17321404 for fixing the HAL spec and removing this workaround.
@@ -2557,8 +2643,13 @@ status_t Camera3Device::configureStreamsLocked(int operatingMode,
 
     internalUpdateStatusLocked((mDummyStreamId == NO_STREAM) ?
             STATUS_CONFIGURED : STATUS_UNCONFIGURED);
+    if (mDummyStreamId == NO_STREAM) {
+        mConfiguredStreamFingerprint = std::move(fingerprint);
+    }
+    mLastConfigureDuration = systemTime() - configureStart;
 
-    ALOGV("%s: Camera %s: Stream configuration complete", __FUNCTION__, mId.string());
+    ALOGV("%s: Camera %s: Stream configuration complete in %" PRId64 " us", __FUNCTION__,
+            mId.string(), ns2us(mLastConfigureDuration));
 
     // tear down the deleted streams after configure streams.
     mDeletedStreams.clear();
@@ -2911,9 +3002,12 @@ void Camera3Device::insertResultLocked(CaptureResult *result,
         return;
     }
 
-    // Valid result, insert into queue
+    // Valid result, move it into the queue rather than cloning the metadata buffer
     List<CaptureResult>::iterator queuedResult =
-            mResultQueue.insert(mResultQueue.end(), CaptureResult(*result));
+            mResultQueue.insert(mResultQueue.end(), CaptureResult());
+    queuedResult->mResultExtras = result->mResultExtras;
+    queuedResult->mMetadata.acquire(result->mMetadata);
+    queuedResult->mPhysicalMetadatas = std::move(result->mPhysicalMetadatas);
     ALOGVV("%s: result requestId = %" PRId32 ", frameNumber = %" PRId64
            ", burstId = %" PRId32, __FUNCTION__,
            queuedResult->mResultExtras.requestId,
@@ -2970,7 +3064,7 @@ void Camera3Device::sendCaptureResult(CameraMetadata &pendingMetadata,
 
     CaptureResult captureResult;
     captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = pendingMetadata;
+    captureResult.mMetadata.acquire(pendingMetadata);
     captureResult.mPhysicalMetadatas = physicalMetadatas;
 
     // Append any previous partials to form a complete result
@@ -3037,6 +3131,19 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
         return;
     }
 
+    if (mLatencyTracker->isEnabled()) {
+        if (result->result != NULL) {
+            mLatencyTracker->record(
+                    (mUsePartialResult && result->partial_result < mNumPartialResults) ?
+                    CaptureLatencyTracker::PARTIAL_RESULT : CaptureLatencyTracker::FINAL_RESULT,
+                    frameNumber);
+        }
+        for (uint32_t i = 0; i < result->num_output_buffers; i++) {
+            mLatencyTracker->record(CaptureLatencyTracker::BUFFER_RETURN, frameNumber,
+                    Camera3Stream::cast(result->output_buffers[i].stream)->getId());
+        }
+    }
+
     bool isPartialResult = false;
     CameraMetadata collectedPartialResult;
     bool hasInputBufferInRequest = false;
@@ -3048,6 +3155,9 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
     // arrives. Update the in-flight status and remove the in-flight entry if
     // all result data and shutter timestamp have been received.
     nsecs_t shutterTimestamp = 0;
+    // Output buffers that can go straight back to their streams. They are returned after
+    // mInFlightLock is dropped so a slow consumer doesn't stall other HAL callbacks.
+    bool returnBuffersAfterUnlock = false;
 
     {
         Mutex::Autolock l(mInFlightLock);
@@ -3161,8 +3271,7 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
             request.pendingOutputBuffers.appendArray(result->output_buffers,
                 result->num_output_buffers);
         } else {
-            returnOutputBuffers(result->output_buffers,
-                result->num_output_buffers, shutterTimestamp);
+            returnBuffersAfterUnlock = (result->num_output_buffers > 0);
         }
 
         if (result->result != NULL && !isPartialResult) {
@@ -3185,8 +3294,19 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
         }
 
         removeInFlightRequestIfReadyLocked(idx);
+
+        if (returnBuffersAfterUnlock) {
+            // Taken before mInFlightLock is released to keep per-stream return order.
+            mOutputBufferReturnLock.lock();
+        }
     } // scope for mInFlightLock
 
+    if (returnBuffersAfterUnlock) {
+        returnOutputBuffers(result->output_buffers,
+            result->num_output_buffers, shutterTimestamp);
+        mOutputBufferReturnLock.unlock();
+    }
+
     if (result->input_buffer != NULL) {
         if (hasInputBufferInRequest) {
             Camera3Stream *stream =
@@ -3322,6 +3442,10 @@ void Camera3Device::notifyShutter(const camera3_shutter_msg_t &msg,
         sp<NotificationListener> listener) {
     ATRACE_CALL();
     ssize_t idx;
+    Vector<camera3_stream_buffer_t> buffersToReturn;
+    nsecs_t shutterTimestamp = 0;
+
+    mLatencyTracker->record(CaptureLatencyTracker::SHUTTER, msg.frame_number);
 
     // Set timestamp for the request in the in-flight tracking
     // and get the request ID to send upstream
@@ -3368,13 +3492,23 @@ void Camera3Device::notifyShutter(const camera3_shutter_msg_t &msg,
                     r.collectedPartialResult, msg.frame_number,
                     r.hasInputBuffer, r.physicalMetadatas);
             }
-            returnOutputBuffers(r.pendingOutputBuffers.array(),
-                r.pendingOutputBuffers.size(), r.shutterTimestamp);
+            buffersToReturn = r.pendingOutputBuffers;
+            shutterTimestamp = r.shutterTimestamp;
             r.pendingOutputBuffers.clear();
 
             removeInFlightRequestIfReadyLocked(idx);
+
+            if (!buffersToReturn.isEmpty()) {
+                // Taken before mInFlightLock is released to keep per-stream return order.
+                mOutputBufferReturnLock.lock();
+            }
         }
     }
+    if (!buffersToReturn.isEmpty()) {
+        returnOutputBuffers(buffersToReturn.array(), buffersToReturn.size(),
+                shutterTimestamp);
+        mOutputBufferReturnLock.unlock();
+    }
     if (idx < 0) {
         SET_ERR("Shutter notification for non-existent frame number %d",
                 msg.frame_number);
@@ -4065,7 +4199,8 @@ void Camera3Device::HalInterface::onBufferFreed(
 
 Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
         sp<StatusTracker> statusTracker,
-        sp<HalInterface> interface, const Vector<int32_t>& sessionParamKeys) :
+        sp<HalInterface> interface, const Vector<int32_t>& sessionParamKeys,
+        std::shared_ptr<CaptureLatencyTracker> latencyTracker) :
         Thread(/*canCallJava*/false),
         mParent(parent),
         mStatusTracker(statusTracker),
@@ -4084,6 +4219,7 @@ Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
         mPrepareVideoStream(false),
         mConstrainedMode(false),
         mRequestLatency(kRequestLatencyBinSize),
+        mLatencyTracker(latencyTracker),
         mSessionParamKeys(sessionParamKeys),
         mLatestSessionParams(sessionParamKeys.size()) {
     mStatusId = statusTracker->addComponent();
@@ -4360,11 +4496,15 @@ bool Camera3Device::RequestThread::sendRequestsBatch() {
     ATRACE_CALL();
     status_t res;
     size_t batchSize = mNextRequests.size();
-    std::vector<camera3_capture_request_t*> requests(batchSize);
+    // Reuse the pointer array between batches; its capacity settles at the batch size.
+    std::vector<camera3_capture_request_t*>& requests = mBatchHalRequests;
+    requests.resize(batchSize);
     uint32_t numRequestProcessed = 0;
     for (size_t i = 0; i < batchSize; i++) {
         requests[i] = &mNextRequests.editItemAt(i).halRequest;
         ATRACE_ASYNC_BEGIN("frame capture", mNextRequests[i].halRequest.frame_number);
+        mLatencyTracker->record(CaptureLatencyTracker::SUBMIT,
+                mNextRequests[i].halRequest.frame_number);
     }
 
     res = mInterface->processBatchCaptureRequests(requests, &numRequestProcessed);
@@ -4435,6 +4575,8 @@ bool Camera3Device::RequestThread::sendRequestsOneByOne() {
     for (auto& nextRequest : mNextRequests) {
         // Submit request and block until ready for next one
         ATRACE_ASYNC_BEGIN("frame capture", nextRequest.halRequest.frame_number);
+        mLatencyTracker->record(CaptureLatencyTracker::SUBMIT,
+                nextRequest.halRequest.frame_number);
         res = mInterface->processCaptureRequest(&nextRequest.halRequest);
 
         if (res != OK) {
@@ -4773,6 +4915,26 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
              *   are O(logn). Sidenote, sorting a sorted metadata is nop.
              */
             captureRequest->mSettingsList.begin()->metadata.sort();
+            const CameraMetadata& settings = captureRequest->mSettingsList.begin()->metadata;
+
+            // A different CaptureRequest object frequently carries exactly the same settings,
+            // e.g. when a client re-submits an identical repeating request or alternates
+            // between two repeating requests with equal controls. The HAL keeps the latest
+            // settings it was given, so skip handing it an identical copy. Requests with
+            // physical camera settings are always sent in full.
+            if (!triggersMixedIn && mPrevRequest != nullptr &&
+                    captureRequest->mSettingsList.size() == 1 &&
+                    mPrevRequest->mSettingsList.size() == 1 &&
+                    isSameMetadata(settings, mPrevSettings)) {
+                newRequest = false;
+                mPrevRequest = captureRequest;
+                ALOGVV("%s: Request settings are NEW but identical to the latest given",
+                        __FUNCTION__);
+            }
+        }
+
+        if (newRequest) {
+            mPrevSettings = captureRequest->mSettingsList.begin()->metadata;
             halRequest->settings = captureRequest->mSettingsList.begin()->metadata.getAndLock();
             mPrevRequest = captureRequest;
             ALOGVV("%s: Request settings are NEW", __FUNCTION__);
@@ -4799,10 +4961,11 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
 
         if (captureRequest->mSettingsList.size() > 1) {
             halRequest->num_physcam_settings = captureRequest->mSettingsList.size() - 1;
-            halRequest->physcam_id = new const char* [halRequest->num_physcam_settings];
+            nextRequest.physCamIds.resize(halRequest->num_physcam_settings);
+            halRequest->physcam_id = nextRequest.physCamIds.data();
             if (newRequest) {
-                halRequest->physcam_settings =
-                    new const camera_metadata* [halRequest->num_physcam_settings];
+                nextRequest.physCamSettings.resize(halRequest->num_physcam_settings);
+                halRequest->physcam_settings = nextRequest.physCamSettings.data();
             } else {
                 halRequest->physcam_settings = nullptr;
             }
@@ -5007,17 +5170,15 @@ void Camera3Device::RequestThread::cleanupPhysicalSettings(sp<CaptureRequest> re
     }
 
     if (halRequest->num_physcam_settings > 0) {
-        if (halRequest->physcam_id != nullptr) {
-            delete [] halRequest->physcam_id;
-            halRequest->physcam_id = nullptr;
-        }
+        // The id and settings arrays are owned by the NextRequest and reused across
+        // batches; only drop the references here.
+        halRequest->physcam_id = nullptr;
         if (halRequest->physcam_settings != nullptr) {
             auto it = ++(request->mSettingsList.begin());
             size_t i = 0;
             for (; it != request->mSettingsList.end(); it++, i++) {
                 it->metadata.unlock(halRequest->physcam_settings[i]);
             }
-            delete [] halRequest->physcam_settings;
             halRequest->physcam_settings = nullptr;
         }
     }
@@ -5207,6 +5368,7 @@ sp<Camera3Device::CaptureRequest>
     // request if so. Can't use 'NULL request == repeat' across configure calls.
     if (mReconfigured) {
         mPrevRequest.clear();
+        mPrevSettings.clear();
         mReconfigured = false;
     }
 
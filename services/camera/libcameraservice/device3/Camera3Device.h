@@ -46,6 +46,7 @@
 #include "device3/DistortionMapper.h"
 #include "utils/TagMonitor.h"
 #include "utils/LatencyHistogram.h"
+#include "utils/CaptureLatencyTracker.h"
 #include <camera_metadata_hidden.h>
 
 using android::camera3::OutputStreamInfo;
@@ -256,6 +257,9 @@ class Camera3Device :
 
     // FMQ to write result on. Must be guarded by mProcessCaptureResultLock.
     std::unique_ptr<ResultMetadataQueue> mResultMetadataQueue;
+    // Reused storage for logical result metadata read from mResultMetadataQueue, so a
+    // result doesn't need a fresh allocation. Must be guarded by mProcessCaptureResultLock.
+    std::vector<uint8_t> mResultMetadataBuffer;
 
     /**** Scope for mLock ****/
 
@@ -416,6 +420,12 @@ class Camera3Device :
     int                        mNextStreamId;
     bool                       mNeedConfig;
 
+    // Fingerprint of the stream configuration the HAL was last configured with; empty
+    // when the HAL is not configured
+    std::vector<int64_t>       mConfiguredStreamFingerprint;
+    // How long the last HAL stream configuration took
+    nsecs_t                    mLastConfigureDuration = 0;
+
     int                        mDummyStreamId;
 
     // Whether to send state updates upstream
@@ -495,9 +505,12 @@ class Camera3Device :
             const hardware::camera::device::V3_2::CaptureResult& result,
             const hardware::hidl_vec<
             hardware::camera::device::V3_4::PhysicalCameraMetadata> physicalCameraMetadatas);
+    // Read one metadata buffer, from the FMQ if fmqResultSize is non-zero. If fmqBuffer is
+    // given, FMQ data is read into it and resultMetadata refers to it without owning it.
     status_t readOneCameraMetadataLocked(uint64_t fmqResultSize,
             hardware::camera::device::V3_2::CameraMetadata& resultMetadata,
-            const hardware::camera::device::V3_2::CameraMetadata& result);
+            const hardware::camera::device::V3_2::CameraMetadata& result,
+            std::vector<uint8_t>* fmqBuffer = nullptr);
 
     // Handle one notify message
     void notify(const hardware::camera::device::V3_2::NotifyMsg& msg);
@@ -605,6 +618,18 @@ class Camera3Device :
      */
     void               cancelStreamsConfigurationLocked();
 
+    /**
+     * Describe the operating mode and current stream set, so that a configuration
+     * identical to the one the HAL already has can be skipped.
+     */
+    std::vector<int64_t> getStreamConfigFingerprintLocked(int operatingMode) const;
+
+    /**
+     * Whether two metadata buffers hold the same entries, in the same order, with the
+     * same values.
+     */
+    static bool        isSameMetadata(const CameraMetadata& lhs, const CameraMetadata& rhs);
+
     /**
      * Add a dummy stream to the current stream set as a workaround for
      * not allowing 0 streams in the camera HAL spec.
@@ -697,7 +722,8 @@ class Camera3Device :
 
         RequestThread(wp<Camera3Device> parent,
                 sp<camera3::StatusTracker> statusTracker,
-                sp<HalInterface> interface, const Vector<int32_t>& sessionParamKeys);
+                sp<HalInterface> interface, const Vector<int32_t>& sessionParamKeys,
+                std::shared_ptr<CaptureLatencyTracker> latencyTracker);
         ~RequestThread();
 
         void     setNotificationListener(wp<NotificationListener> listener);
@@ -810,6 +836,9 @@ class Camera3Device :
             sp<CaptureRequest>              captureRequest;
             camera3_capture_request_t       halRequest;
             Vector<camera3_stream_buffer_t> outputBuffers;
+            // Backing storage for halRequest.physcam_id/physcam_settings.
+            std::vector<const char*>        physCamIds;
+            std::vector<const camera_metadata_t*> physCamSettings;
             bool                            submitted;
         };
 
@@ -888,6 +917,8 @@ class Camera3Device :
         // on the request queue. Read-only even with mRequestLock held, outside
         // of threadLoop
         Vector<NextRequest> mNextRequests;
+        // HAL request pointers for mNextRequests, reused across batches.
+        std::vector<camera3_capture_request_t*> mBatchHalRequests;
 
         // To protect flush() and sending a request batch to HAL.
         Mutex              mFlushLock;
@@ -902,6 +933,9 @@ class Camera3Device :
         Condition          mPausedSignal;
 
         sp<CaptureRequest> mPrevRequest;
+        // Copy of the settings last handed to the HAL, used to detect a new request
+        // object carrying identical settings.
+        CameraMetadata     mPrevSettings;
         int32_t            mPrevTriggers;
 
         uint32_t           mFrameNumber;
@@ -930,6 +964,8 @@ class Camera3Device :
         static const int32_t kRequestLatencyBinSize = 40; // in ms
         CameraLatencyHistogram mRequestLatency;
 
+        std::shared_ptr<CaptureLatencyTracker> mLatencyTracker;
+
         Vector<int32_t>    mSessionParamKeys;
         CameraMetadata     mLatestSessionParams;
     };
@@ -1030,6 +1066,10 @@ class Camera3Device :
                                           // mExpectedInflightDuration
     InFlightMap            mInFlightMap;
     nsecs_t                mExpectedInflightDuration = 0;
+    // Serializes returning completed output buffers to their streams outside of
+    // mInFlightLock. Acquired while mInFlightLock is still held so buffers reach
+    // each stream in the order the in-flight state was updated.
+    Mutex                  mOutputBufferReturnLock;
     int                    mInFlightStatusId;
 
 
@@ -1152,7 +1192,8 @@ class Camera3Device :
             const CaptureResultExtras &resultExtras, uint32_t frameNumber);
 
     // Send a total capture result given the pending metadata and result extras,
-    // partial results, and the frame number to the result queue.
+    // partial results, and the frame number to the result queue. The contents of
+    // pendingMetadata are moved into the queued result.
     void sendCaptureResult(CameraMetadata &pendingMetadata,
             CaptureResultExtras &resultExtras,
             CameraMetadata &collectedPartialResult, uint32_t frameNumber,
@@ -1193,6 +1234,12 @@ class Camera3Device :
     // - dumpsys -m 3a is a shortcut for ae/af/awbMode, State, and Triggers
     TagMonitor mTagMonitor;
 
+    // Per-frame capture stage timestamps, shared with the request thread
+    // - Enabled with the -l on option to dumpsys or the camera.capture_latency.trace
+    //   property
+    // - Disabled with -l off
+    std::shared_ptr<CaptureLatencyTracker> mLatencyTracker;
+
     void monitorMetadata(TagMonitor::eventSource source, int64_t frameNumber,
             nsecs_t timestamp, const CameraMetadata& metadata);
 
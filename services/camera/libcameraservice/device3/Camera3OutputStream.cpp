@@ -307,6 +307,9 @@ void Camera3OutputStream::dump(int fd, const Vector<String16> &args) const {
     String8 lines;
     lines.appendFormat("    Stream[%d]: Output\n", mId);
     lines.appendFormat("      Consumer name: %s\n", mConsumerName.string());
+    lines.appendFormat("      Dequeue stalls: %zu, prefetched buffers used: %zu%s\n",
+            mDequeueStallCount, mPrefetchedBufferCount,
+            mPrefetcher != nullptr ? " (prefetching)" : "");
     write(fd, lines.string(), lines.size());
 
     Camera3IOStreamBase::dump(fd, args);
@@ -358,6 +361,12 @@ status_t Camera3OutputStream::configureQueueLocked() {
         mConsumer->setDequeueTimeout(kDequeueBufferTimeout);
     }
 
+    // A prefetch thread blocked in dequeueBuffer must be able to time out on disconnect, and
+    // buffers from the buffer manager are attached rather than dequeued.
+    stopPrefetcherLocked();
+    mPrefetchAllowed = !mUseBufferManager &&
+            !(isConsumedByHWComposer() || isConsumedByHWTexture());
+
     return OK;
 }
 
@@ -537,7 +546,14 @@ status_t Camera3OutputStream::getBufferLockedCommon(ANativeWindowBuffer** anb, i
             return res;
         }
     }
-    if (!gotBufferFromManager) {
+    bool prefetched = false;
+    if (!gotBufferFromManager && mPrefetcher != nullptr) {
+        prefetched = mPrefetcher->takeBuffer(anb, fenceFd);
+        if (prefetched) {
+            mPrefetchedBufferCount++;
+        }
+    }
+    if (!gotBufferFromManager && !prefetched) {
         /**
          * Release the lock briefly to avoid deadlock for below scenario:
          * Thread 1: StreamingProcessor::startStream -> Camera3Stream::isConfiguring().
@@ -558,6 +574,15 @@ status_t Camera3OutputStream::getBufferLockedCommon(ANativeWindowBuffer** anb, i
         mDequeueBufferLatency.add(dequeueStart, dequeueEnd);
 
         mLock.lock();
+        if (dequeueEnd - dequeueStart > kDequeueStallThreshold) {
+            mDequeueStallCount++;
+            if (mPrefetcher == nullptr && mPrefetchAllowed && mState == STATE_CONFIGURED) {
+                ALOGV("%s: Stream %d: dequeueBuffer stalled, starting prefetch", __FUNCTION__,
+                        mId);
+                mPrefetcher = new BufferPrefetcher(mConsumer, mId);
+                mPrefetcher->run(String8::format("C3Dev-%d-Prefetch", mId).string());
+            }
+        }
         if (res != OK) {
             ALOGE("%s: Stream %d: Can't dequeue next output buffer: %s (%d)",
                     __FUNCTION__, mId, strerror(-res), res);
@@ -584,12 +609,107 @@ status_t Camera3OutputStream::getBufferLockedCommon(ANativeWindowBuffer** anb, i
         }
     }
 
+    // Dequeue the next buffer ahead if a dequeued slot is still free once this buffer
+    // is handed out.
+    if (res == OK && mPrefetcher != nullptr &&
+            getHandoutOutputBufferCountLocked() + 2 <= camera3_stream::max_buffers) {
+        mPrefetcher->requestBuffer();
+    }
+
     return res;
 }
 
+void Camera3OutputStream::stopPrefetcherLocked() {
+    if (mPrefetcher != nullptr) {
+        mPrefetcher->stop();
+        mPrefetcher.clear();
+    }
+}
+
+Camera3OutputStream::BufferPrefetcher::BufferPrefetcher(const sp<Surface>& consumer,
+        int streamId) :
+        Thread(/*canCallJava*/false),
+        mConsumer(consumer),
+        mStreamId(streamId) {
+}
+
+void Camera3OutputStream::BufferPrefetcher::requestBuffer() {
+    Mutex::Autolock l(mLock);
+    if (mBuffer == nullptr && !mDequeueing) {
+        mRequested = true;
+        mCondition.signal();
+    }
+}
+
+bool Camera3OutputStream::BufferPrefetcher::takeBuffer(ANativeWindowBuffer** anb,
+        int* fenceFd) {
+    Mutex::Autolock l(mLock);
+    mRequested = false;
+    while (mDequeueing) {
+        mCondition.wait(mLock);
+    }
+    if (mBuffer == nullptr) {
+        return false;
+    }
+    *anb = mBuffer;
+    *fenceFd = mFenceFd;
+    mBuffer = nullptr;
+    mFenceFd = -1;
+    return true;
+}
+
+void Camera3OutputStream::BufferPrefetcher::stop() {
+    {
+        Mutex::Autolock l(mLock);
+        mStopping = true;
+        mCondition.broadcast();
+    }
+    requestExitAndWait();
+
+    Mutex::Autolock l(mLock);
+    if (mBuffer != nullptr) {
+        mConsumer->cancelBuffer(mConsumer.get(), mBuffer, mFenceFd);
+        mBuffer = nullptr;
+        mFenceFd = -1;
+    }
+}
+
+bool Camera3OutputStream::BufferPrefetcher::threadLoop() {
+    {
+        Mutex::Autolock l(mLock);
+        while (!mRequested && !mStopping) {
+            mCondition.wait(mLock);
+        }
+        if (mStopping) {
+            return false;
+        }
+        mRequested = false;
+        mDequeueing = true;
+    }
+
+    ANativeWindowBuffer* anb = nullptr;
+    int fenceFd = -1;
+    status_t res = mConsumer->dequeueBuffer(mConsumer.get(), &anb, &fenceFd);
+
+    Mutex::Autolock l(mLock);
+    mDequeueing = false;
+    mCondition.broadcast();
+    if (res != OK) {
+        // The next getBuffer call dequeues by itself and handles the error
+        ALOGV("%s: Stream %d: Can't prefetch output buffer: %s (%d)", __FUNCTION__,
+                mStreamId, strerror(-res), res);
+        return !mStopping;
+    }
+    mBuffer = anb;
+    mFenceFd = fenceFd;
+    return !mStopping;
+}
+
 status_t Camera3OutputStream::disconnectLocked() {
     status_t res;
 
+    stopPrefetcherLocked();
+
     if ((res = Camera3IOStreamBase::disconnectLocked()) != OK) {
         return res;
     }
@@ -18,6 +18,9 @@
 #define ANDROID_SERVERS_CAMERA3_OUTPUT_STREAM_H
 
 #include <utils/RefBase.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Thread.h>
 #include <gui/IProducerListener.h>
 #include <gui/Surface.h>
 
@@ -303,6 +306,51 @@ class Camera3OutputStream :
     static const int32_t kDequeueLatencyBinSize = 5; // in ms
     CameraLatencyHistogram mDequeueBufferLatency;
 
+    /**
+     * Dequeues one buffer from the consumer ahead of the next getBuffer call, on its own
+     * thread, so that a consumer that is slow to release buffers does not stall request
+     * submission. The stream and the prefetcher never dequeue at the same time.
+     */
+    class BufferPrefetcher : public Thread {
+      public:
+        BufferPrefetcher(const sp<Surface>& consumer, int streamId);
+
+        // Ask for the next buffer to be dequeued ahead.
+        void requestBuffer();
+
+        // Take the prefetched buffer. Waits for a dequeue that is already in progress, and
+        // drops a request that has not started. Returns false if no buffer is available.
+        bool takeBuffer(ANativeWindowBuffer** anb, int* fenceFd);
+
+        // Stop the thread and cancel any buffer it still holds.
+        void stop();
+
+      private:
+        virtual bool threadLoop();
+
+        sp<Surface> mConsumer;
+        int mStreamId;
+        Mutex mLock;
+        Condition mCondition;
+        bool mRequested = false;
+        bool mDequeueing = false;
+        bool mStopping = false;
+        ANativeWindowBuffer* mBuffer = nullptr;
+        int mFenceFd = -1;
+    };
+
+    // Dequeues slower than this are counted as stalls and turn on prefetching
+    static const nsecs_t kDequeueStallThreshold = 2000000; // 2 ms
+
+    // Whether this stream may prefetch: it owns its consumer queue and dequeue has a timeout
+    bool mPrefetchAllowed = false;
+    // Started after the first dequeue stall, stopped on disconnect
+    sp<BufferPrefetcher> mPrefetcher;
+    size_t mDequeueStallCount = 0;
+    size_t mPrefetchedBufferCount = 0;
+
+    void stopPrefetcherLocked();
+
 }; // class Camera3OutputStream
 
 } // namespace camera3
@@ -54,6 +54,8 @@ public:
             const std::vector<size_t> &removedSurfaceIds,
             KeyedVector<sp<Surface>, size_t> *outputMap/*out*/);
 
+    virtual void dump(int fd, const Vector<String16> &args) const;
+
 private:
 
     static const size_t kMaxOutputs = 4;
@@ -33,11 +33,14 @@
 #include <utils/Trace.h>
 
 #include <cutils/atomic.h>
+#include <cutils/properties.h>
 
 #include "Camera3StreamSplitter.h"
 
 namespace android {
 
+const char* Camera3StreamSplitter::kMaxOutputLagProperty = "camera.stream_splitter.max_output_lag";
+
 status_t Camera3StreamSplitter::connect(const std::unordered_map<size_t, sp<Surface>> &surfaces,
         uint64_t consumerUsage, uint64_t producerUsage, size_t halMaxBuffers, uint32_t width,
         uint32_t height, android::PixelFormat format, sp<Surface>* consumer) {
@@ -137,6 +140,8 @@ void Camera3StreamSplitter::disconnect() {
     mOutputs.clear();
     mOutputSlots.clear();
     mConsumerBufferCount.clear();
+    mOutputMaxLag.clear();
+    mOutputStats.clear();
 
     mConsumer->consumerDisconnect();
 
@@ -233,6 +238,12 @@ status_t Camera3StreamSplitter::addOutputLocked(size_t surfaceId, const sp<Surfa
         outputQueue->setDequeueTimeout(kDequeueBufferTimeout);
     }
 
+    size_t maxLag = 0;
+    if (!(usage & (GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_HW_TEXTURE |
+            GRALLOC_USAGE_HW_VIDEO_ENCODER))) {
+        maxLag = static_cast<size_t>(std::max(0, property_get_int32(kMaxOutputLagProperty, 0)));
+    }
+
     res = gbp->allowAllocation(false);
     if (res != OK) {
         SP_LOGE("%s: Failed to turn off allocation for outputQueue", __FUNCTION__);
@@ -242,6 +253,8 @@ status_t Camera3StreamSplitter::addOutputLocked(size_t surfaceId, const sp<Surfa
     // Add new entry into mOutputs
     mOutputs[surfaceId] = gbp;
     mConsumerBufferCount[surfaceId] = maxConsumerBuffers;
+    mOutputMaxLag[surfaceId] = maxLag;
+    mOutputStats[surfaceId] = OutputStats();
     mNotifiers[gbp] = listener;
     mOutputSlots[gbp] = std::make_unique<OutputSlots>(totalBufferCount);
 
@@ -317,6 +330,8 @@ status_t Camera3StreamSplitter::removeOutputLocked(size_t surfaceId) {
         SP_LOGE("%s: Cached consumer buffer count mismatch!", __FUNCTION__);
     }
     mConsumerBufferCount[surfaceId] = 0;
+    mOutputMaxLag.erase(surfaceId);
+    mOutputStats.erase(surfaceId);
 
     return res;
 }
@@ -370,6 +385,7 @@ status_t Camera3StreamSplitter::outputBufferLocked(const sp<IGraphicBufferProduc
     if (queueOutput.bufferReplaced) {
         onBufferReplacedLocked(output, surfaceId);
     }
+    mOutputStats[surfaceId].queuedCount++;
 
     return res;
 }
@@ -401,10 +417,32 @@ status_t Camera3StreamSplitter::attachBufferToOutputs(ANativeWindowBuffer* anb,
     sp<GraphicBuffer> gb(static_cast<GraphicBuffer*>(anb));
     uint64_t bufferId = gb->getId();
 
+    // Skip this frame for outputs that have fallen too far behind, unless that would
+    // leave the buffer with no output at all.
+    std::vector<size_t> outputIds;
+    outputIds.reserve(surface_ids.size());
+    for (auto& surface_id : surface_ids) {
+        size_t maxLag = mOutputMaxLag[surface_id];
+        if (maxLag == 0 || getPendingBufferCountLocked(surface_id) < maxLag) {
+            outputIds.push_back(surface_id);
+        }
+    }
+    if (outputIds.empty()) {
+        outputIds = surface_ids;
+    } else if (outputIds.size() < surface_ids.size()) {
+        for (auto& surface_id : surface_ids) {
+            if (std::find(outputIds.begin(), outputIds.end(), surface_id) == outputIds.end()) {
+                SP_LOGV("%s: Output %zu is lagging, skipping buffer %" PRId64, __FUNCTION__,
+                        surface_id, bufferId);
+                mOutputStats[surface_id].droppedCount++;
+            }
+        }
+    }
+
     // Initialize buffer tracker for this input buffer
-    auto tracker = std::make_unique<BufferTracker>(gb, surface_ids);
+    auto tracker = std::make_unique<BufferTracker>(gb, outputIds);
 
-    for (auto& surface_id : surface_ids) {
+    for (auto& surface_id : outputIds) {
         sp<IGraphicBufferProducer>& gbp = mOutputs[surface_id];
         if (gbp.get() == nullptr) {
             //Output surface got likely removed by client.
@@ -498,6 +536,7 @@ void Camera3StreamSplitter::onFrameAvailable(const BufferItem& /*item*/) {
 
     SP_LOGV("%s: BufferTracker for buffer %" PRId64 ", number of requests %zu",
            __FUNCTION__, bufferItem.mGraphicBuffer->getId(), tracker.requestedSurfaces().size());
+    tracker.setQueueTime(systemTime());
     for (const auto id : tracker.requestedSurfaces()) {
 
         if (mOutputs[id] == nullptr) {
@@ -656,6 +695,14 @@ void Camera3StreamSplitter::returnOutputBufferLocked(const sp<Fence>& fence,
         tracker.mergeFence(fence);
     }
 
+    if (tracker.getQueueTime() > 0) {
+        OutputStats& stats = mOutputStats[surfaceId];
+        nsecs_t holdTime = systemTime() - tracker.getQueueTime();
+        stats.totalHoldTime += holdTime;
+        stats.maxHoldTime = std::max(stats.maxHoldTime, holdTime);
+        stats.releasedCount++;
+    }
+
     auto detachBuffer = mDetachedBuffers.find(buffer->getId());
     bool detach = (detachBuffer != mDetachedBuffers.end());
     if (detach) {
@@ -705,6 +752,35 @@ void Camera3StreamSplitter::onAbandonedLocked() {
     SP_LOGV("One of my outputs has abandoned me");
 }
 
+size_t Camera3StreamSplitter::getPendingBufferCountLocked(size_t surfaceId) const {
+    size_t count = 0;
+    for (const auto& it : mBuffers) {
+        if (it.second == nullptr) {
+            continue;
+        }
+        const auto& surfaces = it.second->requestedSurfaces();
+        if (std::find(surfaces.begin(), surfaces.end(), surfaceId) != surfaces.end()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void Camera3StreamSplitter::dump(int fd) {
+    Mutex::Autolock lock(mMutex);
+    String8 lines;
+    for (const auto& it : mOutputStats) {
+        const OutputStats& stats = it.second;
+        lines.appendFormat("      Shared output %d: max lag %zu, queued %zu, skipped %zu,"
+                " avg hold %.1f ms, max hold %.1f ms\n", it.first, mOutputMaxLag[it.first],
+                stats.queuedCount, stats.droppedCount,
+                stats.releasedCount > 0 ?
+                        stats.totalHoldTime / 1e6 / stats.releasedCount : 0.0,
+                stats.maxHoldTime / 1e6);
+    }
+    write(fd, lines.string(), lines.size());
+}
+
 int Camera3StreamSplitter::getSlotForOutputLocked(const sp<IGraphicBufferProducer>& gbp,
         const sp<GraphicBuffer>& gb) {
     auto& outputSlots = *mOutputSlots[gbp];
@@ -745,7 +821,7 @@ void Camera3StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who
 Camera3StreamSplitter::BufferTracker::BufferTracker(
         const sp<GraphicBuffer>& buffer, const std::vector<size_t>& requestedSurfaces)
       : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mRequestedSurfaces(requestedSurfaces),
-        mReferenceCount(requestedSurfaces.size()) {}
+        mReferenceCount(requestedSurfaces.size()), mQueueTime(0) {}
 
 void Camera3StreamSplitter::BufferTracker::mergeFence(const sp<Fence>& with) {
     mMergedFence = Fence::merge(String8("Camera3StreamSplitter"), mMergedFence, with);
@@ -91,6 +91,9 @@ public:
     // Disconnect the buffer queue from output surfaces.
     void disconnect();
 
+    // Dump per-output delivery statistics.
+    void dump(int fd);
+
 private:
     // From IConsumerListener
     //
@@ -174,6 +177,10 @@ private:
         const sp<GraphicBuffer>& getBuffer() const { return mBuffer; }
         const sp<Fence>& getMergedFence() const { return mMergedFence; }
 
+        // Time at which the buffer was queued to the outputs, 0 if not queued yet.
+        nsecs_t getQueueTime() const { return mQueueTime; }
+        void setQueueTime(nsecs_t time) { mQueueTime = time; }
+
         void mergeFence(const sp<Fence>& with);
 
         // Returns the new value
@@ -196,6 +203,7 @@ private:
         // which output is the buffer sent to.
         std::vector<size_t> mRequestedSurfaces;
         size_t mReferenceCount;
+        nsecs_t mQueueTime;
     };
 
     // Must be accessed through RefBase
@@ -214,6 +222,9 @@ private:
     // Get unique name for the buffer queue consumer
     String8 getUniqueConsumerName();
 
+    // Number of tracked buffers that are in flight to, queued on, or held by the given output.
+    size_t getPendingBufferCountLocked(size_t surfaceId) const;
+
     // Helper function to get the BufferQueue slot where a particular buffer is attached to.
     int getSlotForOutputLocked(const sp<IGraphicBufferProducer>& gbp,
             const sp<GraphicBuffer>& gb);
@@ -228,6 +239,11 @@ private:
 
     static const nsecs_t kDequeueBufferTimeout   = s2ns(1); // 1 sec
 
+    // Outputs that aren't composer, GPU or video encoder consumers (e.g. CPU image
+    // analysis) may have frames skipped once this many buffers are pending on them, so
+    // a slow consumer doesn't hold back the other outputs. 0 disables skipping.
+    static const char* kMaxOutputLagProperty;
+
     Mutex mMutex;
 
     sp<IGraphicBufferProducer> mProducer;
@@ -244,6 +260,20 @@ private:
     //Map surface ids -> consumer buffer count
     std::unordered_map<int, size_t > mConsumerBufferCount;
 
+    //Map surface ids -> max pending buffers before frames are skipped, 0 for never
+    std::unordered_map<int, size_t > mOutputMaxLag;
+
+    struct OutputStats {
+        size_t queuedCount = 0;
+        size_t droppedCount = 0;
+        // Time from queueing to an output until the output releases it
+        nsecs_t totalHoldTime = 0;
+        nsecs_t maxHoldTime = 0;
+        size_t releasedCount = 0;
+    };
+    //Map surface ids -> delivery statistics
+    std::unordered_map<int, OutputStats> mOutputStats;
+
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
     // objects (which are mostly for counting how many outputs have released the
     // buffer, but also contain merged release fences).
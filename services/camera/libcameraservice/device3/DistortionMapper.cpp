@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 
 #include "device3/DistortionMapper.h"
 
@@ -55,7 +56,8 @@ constexpr std::array<uint32_t, 2> DistortionMapper::kResultPointsToCorrect = {
 };
 
 
-DistortionMapper::DistortionMapper() : mValidMapping(false), mValidGrids(false) {
+DistortionMapper::DistortionMapper() : mValidMapping(false), mValidGrids(false),
+        mBinMinX(0), mBinMinY(0), mBinInvWidth(0), mBinInvHeight(0) {
 }
 
 bool DistortionMapper::isDistortionSupported(const CameraMetadata &result) {
@@ -241,7 +243,7 @@ status_t DistortionMapper::mapRawToCorrected(int32_t *coordPairs, int coordCount
     }
 
     for (int i = 0; i < coordCount * 2; i += 2) {
-        const GridQuad *quad = findEnclosingQuad(coordPairs + i, mDistortedGrid);
+        const GridQuad *quad = findEnclosingDistortedQuad(coordPairs + i);
         if (quad == nullptr) {
             ALOGE("Raw to corrected mapping failure: No quad found for (%d, %d)",
                     *(coordPairs + i), *(coordPairs + i + 1));
@@ -385,47 +387,119 @@ status_t DistortionMapper::buildGrids() {
         }
     }
 
+    buildDistortedGridBins();
+
     mValidGrids = true;
     return OK;
 }
 
+void DistortionMapper::buildDistortedGridBins() {
+    float minX = std::numeric_limits<float>::max();
+    float minY = std::numeric_limits<float>::max();
+    float maxX = std::numeric_limits<float>::lowest();
+    float maxY = std::numeric_limits<float>::lowest();
+    for (const GridQuad& quad : mDistortedGrid) {
+        for (size_t k = 0; k < quad.coords.size(); k += 2) {
+            minX = std::min(minX, quad.coords[k]);
+            maxX = std::max(maxX, quad.coords[k]);
+            minY = std::min(minY, quad.coords[k + 1]);
+            maxY = std::max(maxY, quad.coords[k + 1]);
+        }
+    }
+
+    mBinMinX = minX;
+    mBinMinY = minY;
+    mBinInvWidth = kBinCount / std::max(maxX - minX, kFloatFuzz);
+    mBinInvHeight = kBinCount / std::max(maxY - minY, kFloatFuzz);
+
+    mDistortedGridBins.assign(kBinCount * kBinCount, std::vector<const GridQuad*>());
+    auto binIndex = [](float v) {
+        return static_cast<size_t>(std::min(std::max(v, 0.f), kBinCount - 1.f));
+    };
+    for (const GridQuad& quad : mDistortedGrid) {
+        float qMinX = quad.coords[0], qMaxX = quad.coords[0];
+        float qMinY = quad.coords[1], qMaxY = quad.coords[1];
+        for (size_t k = 2; k < quad.coords.size(); k += 2) {
+            qMinX = std::min(qMinX, quad.coords[k]);
+            qMaxX = std::max(qMaxX, quad.coords[k]);
+            qMinY = std::min(qMinY, quad.coords[k + 1]);
+            qMaxY = std::max(qMaxY, quad.coords[k + 1]);
+        }
+        size_t x0 = binIndex((qMinX - mBinMinX) * mBinInvWidth);
+        size_t x1 = binIndex((qMaxX - mBinMinX) * mBinInvWidth);
+        size_t y0 = binIndex((qMinY - mBinMinY) * mBinInvHeight);
+        size_t y1 = binIndex((qMaxY - mBinMinY) * mBinInvHeight);
+        for (size_t by = y0; by <= y1; by++) {
+            for (size_t bx = x0; bx <= x1; bx++) {
+                mDistortedGridBins[by * kBinCount + bx].push_back(&quad);
+            }
+        }
+    }
+}
+
+const DistortionMapper::GridQuad* DistortionMapper::findEnclosingDistortedQuad(
+        const int32_t pt[2]) const {
+    float bx = (pt[0] - mBinMinX) * mBinInvWidth;
+    float by = (pt[1] - mBinMinY) * mBinInvHeight;
+    if (mDistortedGridBins.empty() || bx < 0 || by < 0 || bx >= kBinCount || by >= kBinCount) {
+        // Outside of every quad's bounding box; let the exhaustive search decide
+        return findEnclosingQuad(pt, mDistortedGrid);
+    }
+
+    // Any quad containing the point has a bounding box overlapping the point's bin, and the
+    // candidates keep grid order, so this finds the same quad as the exhaustive search.
+    const auto& candidates =
+            mDistortedGridBins[static_cast<size_t>(by) * kBinCount + static_cast<size_t>(bx)];
+    for (const GridQuad* quad : candidates) {
+        if (quadContains(pt, *quad)) {
+            return quad;
+        }
+    }
+    return nullptr;
+}
+
 const DistortionMapper::GridQuad* DistortionMapper::findEnclosingQuad(
         const int32_t pt[2], const std::vector<GridQuad>& grid) {
-    const float x = pt[0];
-    const float y = pt[1];
-
     for (const GridQuad& quad : grid) {
-        const float &x1 = quad.coords[0];
-        const float &y1 = quad.coords[1];
-        const float &x2 = quad.coords[2];
-        const float &y2 = quad.coords[3];
-        const float &x3 = quad.coords[4];
-        const float &y3 = quad.coords[5];
-        const float &x4 = quad.coords[6];
-        const float &y4 = quad.coords[7];
-
-        // Point-in-quad test:
-
-        // Quad has corners P1-P4; if P is within the quad, then it is on the same side of all the
-        // edges (or on top of one of the edges or corners), traversed in a consistent direction.
-        // This means that the cross product of edge En = Pn->P(n+1 mod 4) and line Ep = Pn->P must
-        // have the same sign (or be zero) for all edges.
-        // For clockwise traversal, the sign should be negative or zero for Ep x En, indicating that
-        // En is to the left of Ep, or overlapping.
-        float s1 = (x - x1) * (y2 - y1) - (y - y1) * (x2 - x1);
-        if (s1 > 0) continue;
-        float s2 = (x - x2) * (y3 - y2) - (y - y2) * (x3 - x2);
-        if (s2 > 0) continue;
-        float s3 = (x - x3) * (y4 - y3) - (y - y3) * (x4 - x3);
-        if (s3 > 0) continue;
-        float s4 = (x - x4) * (y1 - y4) - (y - y4) * (x1 - x4);
-        if (s4 > 0) continue;
-
-        return &quad;
+        if (quadContains(pt, quad)) {
+            return &quad;
+        }
     }
     return nullptr;
 }
 
+bool DistortionMapper::quadContains(const int32_t pt[2], const GridQuad& quad) {
+    const float x = pt[0];
+    const float y = pt[1];
+
+    const float &x1 = quad.coords[0];
+    const float &y1 = quad.coords[1];
+    const float &x2 = quad.coords[2];
+    const float &y2 = quad.coords[3];
+    const float &x3 = quad.coords[4];
+    const float &y3 = quad.coords[5];
+    const float &x4 = quad.coords[6];
+    const float &y4 = quad.coords[7];
+
+    // Point-in-quad test:
+
+    // Quad has corners P1-P4; if P is within the quad, then it is on the same side of all the
+    // edges (or on top of one of the edges or corners), traversed in a consistent direction.
+    // This means that the cross product of edge En = Pn->P(n+1 mod 4) and line Ep = Pn->P must
+    // have the same sign (or be zero) for all edges.
+    // For clockwise traversal, the sign should be negative or zero for Ep x En, indicating that
+    // En is to the left of Ep, or overlapping.
+    float s1 = (x - x1) * (y2 - y1) - (y - y1) * (x2 - x1);
+    if (s1 > 0) return false;
+    float s2 = (x - x2) * (y3 - y2) - (y - y2) * (x3 - x2);
+    if (s2 > 0) return false;
+    float s3 = (x - x3) * (y4 - y3) - (y - y3) * (x4 - x3);
+    if (s3 > 0) return false;
+    float s4 = (x - x4) * (y1 - y4) - (y - y4) * (x1 - x4);
+    if (s4 > 0) return false;
+    return true;
+}
+
 float DistortionMapper::calculateUorV(const int32_t pt[2], const GridQuad& quad, bool calculateU) {
     const float x = pt[0];
     const float y = pt[1];
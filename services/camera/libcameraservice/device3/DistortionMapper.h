@@ -116,6 +116,9 @@ class DistortionMapper {
     static const GridQuad* findEnclosingQuad(
             const int32_t pt[2], const std::vector<GridQuad>& grid);
 
+    // Whether the point is within the quad, or on one of its edges or corners
+    static bool quadContains(const int32_t pt[2], const GridQuad& quad);
+
     // Calculate 'horizontal' interpolation coordinate for the point and the quad
     // Assumes the point P is within the quad Q.
     // Given quad with points P1-P4, and edges E12-E41, and considering the edge segments as
@@ -156,6 +159,13 @@ class DistortionMapper {
     // Utility to create reverse mapping grids
     status_t buildGrids();
 
+    // Utility to bucket the distorted grid quads by bounding box, so that the enclosing quad
+    // for a raw point only needs to be searched among a few candidates
+    void buildDistortedGridBins();
+
+    // Same result as findEnclosingQuad(pt, mDistortedGrid), using the bins
+    const GridQuad* findEnclosingDistortedQuad(const int32_t pt[2]) const;
+
 
     bool mValidMapping;
     bool mValidGrids;
@@ -175,6 +185,13 @@ class DistortionMapper {
     std::vector<GridQuad> mCorrectedGrid;
     std::vector<GridQuad> mDistortedGrid;
 
+    // Number of bins in each dimension over the distorted grid's bounding box
+    constexpr static size_t kBinCount = kGridSize;
+    // Candidate quads for each bin, in mDistortedGrid order
+    std::vector<std::vector<const GridQuad*>> mDistortedGridBins;
+    float mBinMinX, mBinMinY;
+    float mBinInvWidth, mBinInvHeight;
+
 }; // class DistortionMapper
 
 } // namespace camera3
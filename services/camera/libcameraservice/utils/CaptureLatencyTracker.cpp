@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CaptureLatencyTracker"
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include <cutils/properties.h>
+#include <utils/Log.h>
+#include <utils/String8.h>
+
+#include "CaptureLatencyTracker.h"
+
+namespace android {
+
+const String16 CaptureLatencyTracker::kLatencyOption = String16("-l");
+
+CaptureLatencyTracker::CaptureLatencyTracker() :
+        mEnabled(property_get_bool("camera.capture_latency.trace", false)),
+        mNextEvent(0),
+        mEvents(new Event[kMaxEvents]) {
+    for (size_t i = 0; i < kMaxEvents; i++) {
+        mEvents[i].sequence.store(0, std::memory_order_relaxed);
+        mEvents[i].key.store(0, std::memory_order_relaxed);
+        mEvents[i].timestamp.store(0, std::memory_order_relaxed);
+    }
+}
+
+void CaptureLatencyTracker::setEnabled(bool enabled) {
+    mEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void CaptureLatencyTracker::recordEvent(Stage stage, uint32_t frameNumber, int streamId,
+        nsecs_t timestamp) {
+    uint64_t sequence = mNextEvent.fetch_add(1, std::memory_order_relaxed);
+    Event& event = mEvents[sequence % kMaxEvents];
+
+    event.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    uint64_t key = static_cast<uint64_t>(frameNumber) |
+            (static_cast<uint64_t>(streamId & 0xFFFFFF) << 32) |
+            (static_cast<uint64_t>(stage) << 56);
+    event.key.store(key, std::memory_order_relaxed);
+    event.timestamp.store(timestamp, std::memory_order_relaxed);
+    event.sequence.store(sequence + 1, std::memory_order_release);
+}
+
+void CaptureLatencyTracker::dump(int fd) const {
+    struct Snapshot {
+        uint64_t sequence;
+        uint64_t key;
+        nsecs_t timestamp;
+    };
+    std::vector<Snapshot> events;
+    events.reserve(kMaxEvents);
+    for (size_t i = 0; i < kMaxEvents; i++) {
+        const Event& event = mEvents[i];
+        uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+        if (sequence == 0) continue;
+        Snapshot snapshot = {sequence, event.key.load(std::memory_order_relaxed),
+                event.timestamp.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event.sequence.load(std::memory_order_relaxed) != sequence) continue;
+        events.push_back(snapshot);
+    }
+
+    String8 lines;
+    lines.appendFormat("    Capture latency trace: %s, %zu events\n",
+            isEnabled() ? "enabled" : "disabled", events.size());
+    if (events.empty()) {
+        write(fd, lines.string(), lines.size());
+        return;
+    }
+
+    std::sort(events.begin(), events.end(),
+            [](const Snapshot& a, const Snapshot& b) { return a.sequence < b.sequence; });
+
+    // Latency of each (stage, stream) relative to the frame's submission
+    std::unordered_map<uint32_t, nsecs_t> submitTimes;
+    std::map<std::pair<int, int>, std::vector<nsecs_t>> latencies;
+    for (const auto& event : events) {
+        uint32_t frameNumber = static_cast<uint32_t>(event.key);
+        // Sign-extend the 24-bit stream id
+        int streamId = static_cast<int32_t>(static_cast<uint32_t>(event.key >> 24) & 0xFFFFFF00)
+                >> 8;
+        Stage stage = static_cast<Stage>(event.key >> 56);
+        if (stage == SUBMIT) {
+            submitTimes[frameNumber] = event.timestamp;
+            continue;
+        }
+        auto submit = submitTimes.find(frameNumber);
+        if (submit == submitTimes.end() || event.timestamp < submit->second) continue;
+        latencies[std::make_pair(static_cast<int>(stage), streamId)].push_back(
+                event.timestamp - submit->second);
+    }
+
+    lines.appendFormat("      %-16s %6s %8s %8s %8s %8s  (us since submit)\n",
+            "stage", "count", "p50", "p90", "p99", "max");
+    for (auto& entry : latencies) {
+        std::vector<nsecs_t>& samples = entry.second;
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&samples](size_t p) {
+            return ns2us(samples[(samples.size() - 1) * p / 100]);
+        };
+        String8 name(getStageName(static_cast<Stage>(entry.first.first)));
+        if (entry.first.first == BUFFER_RETURN) {
+            name.appendFormat(" %d", entry.first.second);
+        }
+        lines.appendFormat("      %-16s %6zu %8" PRId64 " %8" PRId64 " %8" PRId64 " %8" PRId64
+                "\n", name.string(), samples.size(), percentile(50), percentile(90),
+                percentile(99), ns2us(samples.back()));
+    }
+    write(fd, lines.string(), lines.size());
+}
+
+const char* CaptureLatencyTracker::getStageName(Stage stage) {
+    switch (stage) {
+        case SUBMIT:
+            return "submit";
+        case SHUTTER:
+            return "shutter";
+        case PARTIAL_RESULT:
+            return "partial result";
+        case FINAL_RESULT:
+            return "final result";
+        case BUFFER_RETURN:
+            return "buffer stream";
+        case CLIENT_DELIVERY:
+            return "client delivery";
+        default:
+            return "unknown";
+    }
+}
+
+}; //namespace android
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SERVERS_CAMERA_CAPTURE_LATENCY_TRACKER_H_
+#define ANDROID_SERVERS_CAMERA_CAPTURE_LATENCY_TRACKER_H_
+
+#include <atomic>
+#include <memory>
+
+#include <utils/String16.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/**
+ * Per-frame timestamps of the stages a capture goes through, from submission
+ * to the HAL until the result is handed to the client.
+ *
+ * Events are written to a fixed-size ring without taking locks, so recording
+ * is cheap enough for the request and result paths. Each slot carries a
+ * sequence number that readers use to discard slots overwritten while being
+ * read. The dump summarizes the latency of each stage relative to submission
+ * as percentiles, which tells whether delay builds up in the HAL or in the
+ * framework.
+ */
+class CaptureLatencyTracker {
+  public:
+    // Dump argument: "-l on" / "-l off" enables or disables tracing
+    static const String16 kLatencyOption;
+
+    enum Stage {
+        SUBMIT,
+        SHUTTER,
+        PARTIAL_RESULT,
+        FINAL_RESULT,
+        BUFFER_RETURN,
+        CLIENT_DELIVERY,
+        STAGE_COUNT
+    };
+
+    // Tracing starts out enabled if the camera.capture_latency.trace property is set
+    CaptureLatencyTracker();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+    // Record that a frame reached a stage now; streamId only applies to BUFFER_RETURN
+    void record(Stage stage, uint32_t frameNumber, int streamId = -1) {
+        if (isEnabled()) {
+            recordEvent(stage, frameNumber, streamId, systemTime());
+        }
+    }
+
+    // Print per-stage latency percentiles for the frames still in the ring
+    void dump(int fd) const;
+
+  private:
+    static const size_t kMaxEvents = 2048;
+
+    struct Event {
+        // Zero while the slot is empty or being written, otherwise the event's
+        // position in the overall event stream plus one
+        std::atomic<uint64_t> sequence;
+        // Frame number in the low 32 bits, stream id in the next 24, stage in the top 8
+        std::atomic<uint64_t> key;
+        std::atomic<int64_t> timestamp;
+    };
+
+    void recordEvent(Stage stage, uint32_t frameNumber, int streamId, nsecs_t timestamp);
+
+    static const char* getStageName(Stage stage);
+
+    std::atomic<bool> mEnabled;
+    std::atomic<uint64_t> mNextEvent;
+    std::unique_ptr<Event[]> mEvents;
+}; // class CaptureLatencyTracker
+
+}; // namespace android
+
+#endif // ANDROID_SERVERS_CAMERA_CAPTURE_LATENCY_TRACKER_H_
@@ -355,27 +355,36 @@ protected:
     ~ClientManager();
 
 private:
+    typedef std::vector<std::shared_ptr<ClientDescriptor<KEY, VALUE>>> ClientList;
 
     /**
-     * Return a vector of the ClientDescriptors that would be evicted by adding the given
-     * ClientDescriptor.  If returnIncompatibleClients is set to true, instead, return the
-     * vector of ClientDescriptors that are higher priority than the incoming client and
-     * either conflict with this client, or contribute to the resource cost if that would
+     * Return a vector of the ClientDescriptors in the given list that would be evicted by
+     * adding the given ClientDescriptor.  If returnIncompatibleClients is set to true, instead,
+     * return the vector of ClientDescriptors that are higher priority than the incoming client
+     * and either conflict with this client, or contribute to the resource cost if that would
      * prevent the incoming client from being added.
      *
      * This may return the ClientDescriptor passed in.
      */
-    std::vector<std::shared_ptr<ClientDescriptor<KEY, VALUE>>> wouldEvictLocked(
+    std::vector<std::shared_ptr<ClientDescriptor<KEY, VALUE>>> wouldEvictFrom(
+            const ClientList& clients,
             const std::shared_ptr<ClientDescriptor<KEY, VALUE>>& client,
             bool returnIncompatibleClients = false) const;
 
-    int64_t getCurrentCostLocked() const;
+    static int64_t getCurrentCost(const ClientList& clients);
+
+    /**
+     * Return the current client list. The list is never modified once published, so it can
+     * be walked without holding mLock; writers publish a modified copy under mLock instead.
+     */
+    std::shared_ptr<const ClientList> getSnapshot() const;
 
     mutable Mutex mLock;
     mutable Condition mRemovedCondition;
     int32_t mMaxCost;
-    // LRU ordered, most recent at end
-    std::vector<std::shared_ptr<ClientDescriptor<KEY, VALUE>>> mClients;
+    // LRU ordered, most recent at end. Replaced, never modified, under mLock.
+    // Descriptor priorities are still updated in place by updatePriorities().
+    std::shared_ptr<const ClientList> mClients;
     std::shared_ptr<LISTENER> mListener;
 }; // class ClientManager
 
@@ -384,7 +393,8 @@ ClientManager<KEY, VALUE, LISTENER>::ClientManager() :
         ClientManager(DEFAULT_MAX_COST) {}
 
 template<class KEY, class VALUE, class LISTENER>
-ClientManager<KEY, VALUE, LISTENER>::ClientManager(int32_t totalCost) : mMaxCost(totalCost) {}
+ClientManager<KEY, VALUE, LISTENER>::ClientManager(int32_t totalCost) : mMaxCost(totalCost),
+        mClients(std::make_shared<const ClientList>()) {}
 
 template<class KEY, class VALUE, class LISTENER>
 ClientManager<KEY, VALUE, LISTENER>::~ClientManager() {}
@@ -393,21 +403,20 @@ template<class KEY, class VALUE, class LISTENER>
 std::vector<std::shared_ptr<ClientDescriptor<KEY, VALUE>>>
 ClientManager<KEY, VALUE, LISTENER>::wouldEvict(
         const std::shared_ptr<ClientDescriptor<KEY, VALUE>>& client) const {
-    Mutex::Autolock lock(mLock);
-    return wouldEvictLocked(client);
+    return wouldEvictFrom(*getSnapshot(), client);
 }
 
 template<class KEY, class VALUE, class LISTENER>
 std::vector<std::shared_ptr<ClientDescriptor<KEY, VALUE>>>
 ClientManager<KEY, VALUE, LISTENER>::getIncompatibleClients(
         const std::shared_ptr<ClientDescriptor<KEY, VALUE>>& client) const {
-    Mutex::Autolock lock(mLock);
-    return wouldEvictLocked(client, /*returnIncompatibleClients*/true);
+    return wouldEvictFrom(*getSnapshot(), client, /*returnIncompatibleClients*/true);
 }
 
 template<class KEY, class VALUE, class LISTENER>
 std::vector<std::shared_ptr<ClientDescriptor<KEY, VALUE>>>
-ClientManager<KEY, VALUE, LISTENER>::wouldEvictLocked(
+ClientManager<KEY, VALUE, LISTENER>::wouldEvictFrom(
+        const ClientList& clients,
         const std::shared_ptr<ClientDescriptor<KEY, VALUE>>& client,
         bool returnIncompatibleClients) const {
 
@@ -424,12 +433,12 @@ ClientManager<KEY, VALUE, LISTENER>::wouldEvictLocked(
     ClientPriority priority = client->getPriority();
     int32_t owner = client->getOwnerId();
 
-    int64_t totalCost = getCurrentCostLocked() + cost;
+    int64_t totalCost = getCurrentCost(clients) + cost;
 
     // Determine the MRU of the owners tied for having the highest priority
     int32_t highestPriorityOwner = owner;
     ClientPriority highestPriority = priority;
-    for (const auto& i : mClients) {
+    for (const auto& i : clients) {
         ClientPriority curPriority = i->getPriority();
         if (curPriority <= highestPriority) {
             highestPriority = curPriority;
@@ -443,7 +452,7 @@ ClientManager<KEY, VALUE, LISTENER>::wouldEvictLocked(
     }
 
     // Build eviction list of clients to remove
-    for (const auto& i : mClients) {
+    for (const auto& i : clients) {
         const KEY& curKey = i->getKey();
         int32_t curCost = i->getCost();
         ClientPriority curPriority = i->getPriority();
@@ -503,12 +512,13 @@ std::vector<std::shared_ptr<ClientDescriptor<KEY, VALUE>>>
 ClientManager<KEY, VALUE, LISTENER>::addAndEvict(
         const std::shared_ptr<ClientDescriptor<KEY, VALUE>>& client) {
     Mutex::Autolock lock(mLock);
-    auto evicted = wouldEvictLocked(client);
+    auto evicted = wouldEvictFrom(*mClients, client);
     auto it = evicted.begin();
     if (it != evicted.end() && *it == client) {
         return evicted;
     }
 
+    auto clients = std::make_shared<ClientList>(*mClients);
     auto iter = evicted.cbegin();
 
     if (iter != evicted.cend()) {
@@ -516,18 +526,19 @@ ClientManager<KEY, VALUE, LISTENER>::addAndEvict(
         if (mListener != nullptr) mListener->onClientRemoved(**iter);
 
         // Remove evicted clients from list
-        mClients.erase(std::remove_if(mClients.begin(), mClients.end(),
+        clients->erase(std::remove_if(clients->begin(), clients->end(),
             [&iter] (std::shared_ptr<ClientDescriptor<KEY, VALUE>>& curClientPtr) {
                 if (curClientPtr->getKey() == (*iter)->getKey()) {
                     iter++;
                     return true;
                 }
                 return false;
-            }), mClients.end());
+            }), clients->end());
     }
 
     if (mListener != nullptr) mListener->onClientAdded(*client);
-    mClients.push_back(client);
+    clients->push_back(client);
+    mClients = clients;
     mRemovedCondition.broadcast();
 
     return evicted;
@@ -536,15 +547,14 @@ ClientManager<KEY, VALUE, LISTENER>::addAndEvict(
 template<class KEY, class VALUE, class LISTENER>
 std::vector<std::shared_ptr<ClientDescriptor<KEY, VALUE>>>
 ClientManager<KEY, VALUE, LISTENER>::getAll() const {
-    Mutex::Autolock lock(mLock);
-    return mClients;
+    return *getSnapshot();
 }
 
 template<class KEY, class VALUE, class LISTENER>
 std::vector<KEY> ClientManager<KEY, VALUE, LISTENER>::getAllKeys() const {
-    Mutex::Autolock lock(mLock);
-    std::vector<KEY> keys(mClients.size());
-    for (const auto& i : mClients) {
+    auto clients = getSnapshot();
+    std::vector<KEY> keys(clients->size());
+    for (const auto& i : *clients) {
         keys.push_back(i->getKey());
     }
     return keys;
@@ -552,9 +562,9 @@ std::vector<KEY> ClientManager<KEY, VALUE, LISTENER>::getAllKeys() const {
 
 template<class KEY, class VALUE, class LISTENER>
 std::vector<int32_t> ClientManager<KEY, VALUE, LISTENER>::getAllOwners() const {
-    Mutex::Autolock lock(mLock);
+    auto clients = getSnapshot();
     std::set<int32_t> owners;
-    for (const auto& i : mClients) {
+    for (const auto& i : *clients) {
         owners.emplace(i->getOwnerId());
     }
     return std::vector<int32_t>(owners.begin(), owners.end());
@@ -564,7 +574,7 @@ template<class KEY, class VALUE, class LISTENER>
 void ClientManager<KEY, VALUE, LISTENER>::updatePriorities(
         const std::map<int32_t,ClientPriority>& ownerPriorityList) {
     Mutex::Autolock lock(mLock);
-    for (auto& i : mClients) {
+    for (auto& i : *mClients) {
         auto j = ownerPriorityList.find(i->getOwnerId());
         if (j != ownerPriorityList.end()) {
             i->setPriority(j->second);
@@ -575,8 +585,8 @@ void ClientManager<KEY, VALUE, LISTENER>::updatePriorities(
 template<class KEY, class VALUE, class LISTENER>
 std::shared_ptr<ClientDescriptor<KEY, VALUE>> ClientManager<KEY, VALUE, LISTENER>::get(
         const KEY& key) const {
-    Mutex::Autolock lock(mLock);
-    for (const auto& i : mClients) {
+    auto clients = getSnapshot();
+    for (const auto& i : *clients) {
         if (i->getKey() == key) return i;
     }
     return std::shared_ptr<ClientDescriptor<KEY, VALUE>>(nullptr);
@@ -586,11 +596,11 @@ template<class KEY, class VALUE, class LISTENER>
 void ClientManager<KEY, VALUE, LISTENER>::removeAll() {
     Mutex::Autolock lock(mLock);
     if (mListener != nullptr) {
-        for (const auto& i : mClients) {
+        for (const auto& i : *mClients) {
             mListener->onClientRemoved(*i);
         }
     }
-    mClients.clear();
+    mClients = std::make_shared<const ClientList>();
     mRemovedCondition.broadcast();
 }
 
@@ -602,7 +612,8 @@ std::shared_ptr<ClientDescriptor<KEY, VALUE>> ClientManager<KEY, VALUE, LISTENER
     std::shared_ptr<ClientDescriptor<KEY, VALUE>> ret;
 
     // Remove evicted clients from list
-    mClients.erase(std::remove_if(mClients.begin(), mClients.end(),
+    auto clients = std::make_shared<ClientList>(*mClients);
+    clients->erase(std::remove_if(clients->begin(), clients->end(),
         [this, &key, &ret] (std::shared_ptr<ClientDescriptor<KEY, VALUE>>& curClientPtr) {
             if (curClientPtr->getKey() == key) {
                 if (mListener != nullptr) mListener->onClientRemoved(*curClientPtr);
@@ -610,7 +621,8 @@ std::shared_ptr<ClientDescriptor<KEY, VALUE>> ClientManager<KEY, VALUE, LISTENER
                 return true;
             }
             return false;
-        }), mClients.end());
+        }), clients->end());
+    mClients = clients;
 
     mRemovedCondition.broadcast();
     return ret;
@@ -630,7 +642,7 @@ status_t ClientManager<KEY, VALUE, LISTENER>::waitUntilRemoved(
 
     while (!isRemoved) {
         isRemoved = true;
-        for (const auto& i : mClients) {
+        for (const auto& i : *mClients) {
             if (i == client) {
                 isRemoved = false;
             }
@@ -659,26 +671,35 @@ void ClientManager<KEY, VALUE, LISTENER>::remove(
         const std::shared_ptr<ClientDescriptor<KEY, VALUE>>& value) {
     Mutex::Autolock lock(mLock);
     // Remove evicted clients from list
-    mClients.erase(std::remove_if(mClients.begin(), mClients.end(),
+    auto clients = std::make_shared<ClientList>(*mClients);
+    clients->erase(std::remove_if(clients->begin(), clients->end(),
         [this, &value] (std::shared_ptr<ClientDescriptor<KEY, VALUE>>& curClientPtr) {
             if (curClientPtr == value) {
                 if (mListener != nullptr) mListener->onClientRemoved(*curClientPtr);
                 return true;
             }
             return false;
-        }), mClients.end());
+        }), clients->end());
+    mClients = clients;
     mRemovedCondition.broadcast();
 }
 
 template<class KEY, class VALUE, class LISTENER>
-int64_t ClientManager<KEY, VALUE, LISTENER>::getCurrentCostLocked() const {
+int64_t ClientManager<KEY, VALUE, LISTENER>::getCurrentCost(const ClientList& clients) {
     int64_t totalCost = 0;
-    for (const auto& x : mClients) {
+    for (const auto& x : clients) {
             totalCost += x->getCost();
     }
     return totalCost;
 }
 
+template<class KEY, class VALUE, class LISTENER>
+std::shared_ptr<const typename ClientManager<KEY, VALUE, LISTENER>::ClientList>
+ClientManager<KEY, VALUE, LISTENER>::getSnapshot() const {
+    Mutex::Autolock lock(mLock);
+    return mClients;
+}
+
 // --------------------------------------------------------------------------------
 
 }; // namespace resource_policy
@@ -88,6 +88,9 @@ static const int kMaxRecords    = 0;
 
 static const char *kServiceName = "media.metrics";
 
+// where finalized records are persisted
+static const char *kStoreDirectory = "/data/misc/mediametrics";
+
 void MediaAnalyticsService::instantiate() {
     defaultServiceManager()->addService(
             String16(kServiceName), new MediaAnalyticsService());
@@ -108,8 +111,9 @@ MediaAnalyticsService::MediaAnalyticsService()
     mItemsDiscardedCount = 0;
 
     mLastSessionID = 0;
-    // recover any persistency we set up
-    // etc
+
+    // recovers the records persisted before we were last restarted
+    mStore.reset(new MediaAnalyticsStore(kStoreDirectory));
 }
 
 MediaAnalyticsService::~MediaAnalyticsService() {
@@ -132,23 +136,45 @@ MediaAnalyticsItem::SessionID_t MediaAnalyticsService::generateUniqueSessionID()
     return (++mLastSessionID);
 }
 
+// we control these, generally not trusting user input
+static nsecs_t submissionTime() {
+    nsecs_t now = systemTime(SYSTEM_TIME_REALTIME);
+    // round nsecs to seconds
+    return ((now + 500000000) / 1000000000) * 1000000000;
+}
+
 // caller surrenders ownership of 'item'
 MediaAnalyticsItem::SessionID_t MediaAnalyticsService::submit(MediaAnalyticsItem *item, bool forcenew)
 {
     UNUSED(forcenew);
 
+    return submitInternal(item, IPCThreadState::self()->getCallingPid(),
+                          IPCThreadState::self()->getCallingUid(), submissionTime());
+}
+
+// caller surrenders ownership of the items
+void MediaAnalyticsService::submitBatch(const std::vector<MediaAnalyticsItem *> &items)
+{
+    // the whole batch comes from one caller at one time
+    int pid = IPCThreadState::self()->getCallingPid();
+    int uid = IPCThreadState::self()->getCallingUid();
+    nsecs_t now = submissionTime();
+
+    for (MediaAnalyticsItem *item : items) {
+        submitInternal(item, pid, uid, now);
+    }
+}
+
+// caller surrenders ownership of 'item'
+MediaAnalyticsItem::SessionID_t MediaAnalyticsService::submitInternal(MediaAnalyticsItem *item,
+        int pid, int uid, nsecs_t now)
+{
     // fill in a sessionID if we do not yet have one
     if (item->getSessionID() <= MediaAnalyticsItem::SessionIDNone) {
         item->setSessionID(generateUniqueSessionID());
     }
 
-    // we control these, generally not trusting user input
-    nsecs_t now = systemTime(SYSTEM_TIME_REALTIME);
-    // round nsecs to seconds
-    now = ((now + 500000000) / 1000000000) * 1000000000;
     item->setTimestamp(now);
-    int pid = IPCThreadState::self()->getCallingPid();
-    int uid = IPCThreadState::self()->getCallingUid();
 
     int uid_given = item->getUid();
     int pid_given = item->getPid();
@@ -218,6 +244,7 @@ MediaAnalyticsItem::SessionID_t MediaAnalyticsService::submit(MediaAnalyticsItem
 
     // save the new record
     MediaAnalyticsItem::SessionID_t id = item->getSessionID();
+    mStore->append(item);
     saveItem(item);
     mItemsFinalized++;
     return id;
@@ -250,6 +277,8 @@ status_t MediaAnalyticsService::dump(int fd, const Vector<String16>& args)
     String16 helpOption("-help");
     String16 onlyOption("-only");
     std::string only;
+    String16 summaryOption("-summary");
+    bool summary = false;
     int n = args.size();
 
     for (int i = 0; i < n; i++) {
@@ -298,6 +327,8 @@ status_t MediaAnalyticsService::dump(int fd, const Vector<String16>& args)
                 String8 value(args[i]);
                 only = value.string();
             }
+        } else if (args[i] == summaryOption) {
+            summary = true;
         } else if (args[i] == helpOption) {
             result.append("Recognized parameters:\n");
             result.append("-help        this help message\n");
@@ -306,6 +337,7 @@ status_t MediaAnalyticsService::dump(int fd, const Vector<String16>& args)
             result.append("-only X      process records for component X\n");
             result.append("-since X     include records since X\n");
             result.append("             (X is milliseconds since the UNIX epoch)\n");
+            result.append("-summary     aggregates of the records stored on disk\n");
             write(fd, result.string(), result.size());
             return NO_ERROR;
         }
@@ -322,7 +354,11 @@ status_t MediaAnalyticsService::dump(int fd, const Vector<String16>& args)
 
     dumpHeaders(result, ts_since);
 
-    dumpRecent(result, ts_since, only.c_str());
+    if (summary) {
+        dumpSummaries(result, ts_since, only.c_str());
+    } else {
+        dumpRecent(result, ts_since, only.c_str());
+    }
 
 
     if (clear) {
@@ -369,6 +405,7 @@ void MediaAnalyticsService::dumpHeaders(String8 &result, nsecs_t ts_since)
             " (by Count: %" PRId64 " by Expiration: %" PRId64 ")\n",
          mItemsDiscarded, mItemsDiscardedCount, mItemsDiscardedExpire);
     result.append(buffer);
+    mStore->dumpStats(result);
     if (ts_since != 0) {
         snprintf(buffer, SIZE,
             "Emitting Queue entries more recent than: %" PRId64 "\n",
@@ -377,6 +414,15 @@ void MediaAnalyticsService::dumpHeaders(String8 &result, nsecs_t ts_since)
     }
 }
 
+// aggregates of the persisted records
+void MediaAnalyticsService::dumpSummaries(String8 &result, nsecs_t ts_since, const char * only)
+{
+    if (only != NULL && *only == '\0') {
+        only = NULL;
+    }
+    mStore->dumpSummary(result, ts_since, only);
+}
+
 // the recent, detailed queues
 void MediaAnalyticsService::dumpRecent(String8 &result, nsecs_t ts_since, const char * only)
 {
@@ -20,6 +20,9 @@
 
 #include <arpa/inet.h>
 
+#include <memory>
+#include <vector>
+
 #include <utils/threads.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
@@ -28,6 +31,8 @@
 
 #include <media/IMediaAnalyticsService.h>
 
+#include "MediaAnalyticsStore.h"
+
 namespace android {
 
 class MediaAnalyticsService : public BnMediaAnalyticsService
@@ -37,6 +42,8 @@ class MediaAnalyticsService : public BnMediaAnalyticsService
 
     // on this side, caller surrenders ownership
     virtual int64_t submit(MediaAnalyticsItem *item, bool forcenew);
+    // on this side, caller surrenders ownership of the items
+    virtual void submitBatch(const std::vector<MediaAnalyticsItem *> &items);
 
     static  void            instantiate();
     virtual status_t        dump(int fd, const Vector<String16>& args);
@@ -47,6 +54,10 @@ class MediaAnalyticsService : public BnMediaAnalyticsService
  private:
     MediaAnalyticsItem::SessionID_t generateUniqueSessionID();
 
+    // sanitizes, validates and saves one record from the given caller
+    MediaAnalyticsItem::SessionID_t submitInternal(MediaAnalyticsItem *item,
+                                                   int pid, int uid, nsecs_t now);
+
     // statistics about our analytics
     int64_t mItemsSubmitted;
     int64_t mItemsFinalized;
@@ -79,6 +90,9 @@ class MediaAnalyticsService : public BnMediaAnalyticsService
     List<MediaAnalyticsItem *> mItems;
     void saveItem(MediaAnalyticsItem *);
 
+    // finalized records on disk, kept across restarts
+    std::unique_ptr<MediaAnalyticsStore> mStore;
+
     // support for generating output
     int mDumpProto;
     int mDumpProtoDefault;
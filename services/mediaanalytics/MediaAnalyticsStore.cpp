@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaAnalyticsStore"
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <binder/Parcel.h>
+
+#include "MediaAnalyticsStore.h"
+
+namespace android {
+
+// first word of every segment
+static const uint32_t kSegmentMagic = 0x3153414d; // "MAS1"
+
+// precedes each record in a segment
+struct RecordHeader {
+    uint32_t length;    // of the parcel data that follows
+    uint32_t checksum;  // of the parcel data that follows
+};
+
+// FNV-1a
+static uint32_t checksum(const uint8_t *data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool writeFully(int fd, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = TEMP_FAILURE_RETRY(write(fd, data, length));
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+MediaAnalyticsStore::MediaAnalyticsStore(const char *directory,
+                                         size_t maxSegmentBytes, size_t maxPending)
+        : mCurrentPath(std::string(directory) + "/records.cur"),
+          mPreviousPath(std::string(directory) + "/records.old"),
+          mMaxSegmentBytes(maxSegmentBytes),
+          mMaxPending(maxPending),
+          mFd(-1),
+          mSegmentBytes(0),
+          mExiting(false),
+          mRecordsStored(0),
+          mRecordsWritten(0),
+          mRecordsDropped(0),
+          mWriteErrors(0) {
+    mThread = std::thread(&MediaAnalyticsStore::threadLoop, this);
+}
+
+MediaAnalyticsStore::~MediaAnalyticsStore() {
+    {
+        Mutex::Autolock _l(mLock);
+        mExiting = true;
+        mCondition.signal();
+    }
+    mThread.join();
+}
+
+bool MediaAnalyticsStore::append(MediaAnalyticsItem *item) {
+    MediaAnalyticsItem *copy = item->dup();
+    if (copy == NULL) {
+        return false;
+    }
+
+    Mutex::Autolock _l(mLock);
+    if (mPending.size() >= mMaxPending) {
+        mRecordsDropped++;
+        delete copy;
+        return false;
+    }
+    mPending.push_back(copy);
+    mCondition.signal();
+    return true;
+}
+
+void MediaAnalyticsStore::threadLoop() {
+    Rollups rollups;
+    int64_t records = 0;
+    loadSegment(mPreviousPath, &rollups, &records);
+    mSegmentBytes = loadSegment(mCurrentPath, &rollups, &records);
+    openSegment();
+    {
+        Mutex::Autolock _l(mLock);
+        mRollups.swap(rollups);
+        mRecordsStored = records;
+    }
+    ALOGV("loaded %" PRId64 " records", records);
+
+    while (true) {
+        std::deque<MediaAnalyticsItem *> items;
+        {
+            Mutex::Autolock _l(mLock);
+            while (mPending.empty() && !mExiting) {
+                mCondition.wait(mLock);
+            }
+            if (mPending.empty()) {
+                break;
+            }
+            items.swap(mPending);
+        }
+
+        bool written = writeRecords(items);
+        {
+            Mutex::Autolock _l(mLock);
+            if (written) {
+                for (MediaAnalyticsItem *item : items) {
+                    addToRollups(item, &mRollups);
+                }
+                mRecordsStored += items.size();
+                mRecordsWritten += items.size();
+            } else {
+                mWriteErrors += items.size();
+            }
+        }
+        for (MediaAnalyticsItem *item : items) {
+            delete item;
+        }
+
+        if (written && mSegmentBytes >= (off_t) mMaxSegmentBytes) {
+            rotate();
+        }
+    }
+
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+bool MediaAnalyticsStore::openSegment() {
+    mFd = open(mCurrentPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (mFd < 0) {
+        ALOGE("unable to open %s: %s", mCurrentPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    // drop anything past the last intact record
+    if (ftruncate(mFd, mSegmentBytes) != 0) {
+        ALOGE("unable to truncate %s: %s", mCurrentPath.c_str(), strerror(errno));
+    }
+    if (mSegmentBytes == 0) {
+        if (!writeFully(mFd, (const uint8_t *) &kSegmentMagic, sizeof(kSegmentMagic))) {
+            ALOGE("unable to write %s: %s", mCurrentPath.c_str(), strerror(errno));
+            close(mFd);
+            mFd = -1;
+            return false;
+        }
+        mSegmentBytes = sizeof(kSegmentMagic);
+    }
+    return true;
+}
+
+void MediaAnalyticsStore::rotate() {
+    close(mFd);
+    mFd = -1;
+    if (rename(mCurrentPath.c_str(), mPreviousPath.c_str()) != 0) {
+        ALOGE("unable to rename %s: %s", mCurrentPath.c_str(), strerror(errno));
+    }
+    mSegmentBytes = 0;
+    openSegment();
+
+    // the records that just rolled off are gone from disk; rebuild from what remains
+    Rollups rollups;
+    int64_t records = 0;
+    loadSegment(mPreviousPath, &rollups, &records);
+    Mutex::Autolock _l(mLock);
+    mRollups.swap(rollups);
+    mRecordsStored = records;
+}
+
+bool MediaAnalyticsStore::writeRecords(const std::deque<MediaAnalyticsItem *> &items) {
+    if (mFd < 0) {
+        return false;
+    }
+
+    // one write per batch
+    std::vector<uint8_t> buffer;
+    for (MediaAnalyticsItem *item : items) {
+        Parcel parcel;
+        item->writeToParcel(&parcel);
+        RecordHeader header;
+        header.length = parcel.dataSize();
+        header.checksum = checksum(parcel.data(), parcel.dataSize());
+        const uint8_t *headerBytes = (const uint8_t *) &header;
+        buffer.insert(buffer.end(), headerBytes, headerBytes + sizeof(header));
+        buffer.insert(buffer.end(), parcel.data(), parcel.data() + parcel.dataSize());
+    }
+
+    if (!writeFully(mFd, buffer.data(), buffer.size())) {
+        ALOGE("unable to write %s: %s", mCurrentPath.c_str(), strerror(errno));
+        // don't leave a torn record in front of later ones
+        if (ftruncate(mFd, mSegmentBytes) != 0) {
+            ALOGE("unable to truncate %s: %s", mCurrentPath.c_str(), strerror(errno));
+        }
+        return false;
+    }
+    mSegmentBytes += buffer.size();
+    return true;
+}
+
+off_t MediaAnalyticsStore::loadSegment(const std::string &path, Rollups *rollups,
+                                       int64_t *records) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    std::vector<uint8_t> data;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data.resize(st.st_size);
+        size_t got = 0;
+        while (got < data.size()) {
+            ssize_t n = TEMP_FAILURE_RETRY(read(fd, data.data() + got, data.size() - got));
+            if (n <= 0) {
+                break;
+            }
+            got += n;
+        }
+        data.resize(got);
+    }
+    close(fd);
+
+    uint32_t magic;
+    if (data.size() < sizeof(magic)) {
+        return 0;
+    }
+    memcpy(&magic, data.data(), sizeof(magic));
+    if (magic != kSegmentMagic) {
+        ALOGW("ignoring %s: bad magic %#x", path.c_str(), magic);
+        return 0;
+    }
+
+    size_t offset = sizeof(magic);
+    while (data.size() - offset >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        memcpy(&header, data.data() + offset, sizeof(header));
+        const uint8_t *payload = data.data() + offset + sizeof(header);
+        if (header.length == 0 ||
+                header.length > data.size() - offset - sizeof(header) ||
+                header.checksum != checksum(payload, header.length)) {
+            ALOGW("%s: dropping %zu bytes after offset %zu",
+                  path.c_str(), data.size() - offset, offset);
+            break;
+        }
+
+        Parcel parcel;
+        parcel.setData(payload, header.length);
+        MediaAnalyticsItem item;
+        if (item.readFromParcel(parcel) != 0) {
+            break;
+        }
+        addToRollups(&item, rollups);
+        (*records)++;
+        offset += sizeof(header) + header.length;
+    }
+    return offset;
+}
+
+void MediaAnalyticsStore::addToRollups(MediaAnalyticsItem *item, Rollups *rollups) {
+    nsecs_t bucket = item->getTimestamp() / kRollupIntervalNs * kRollupIntervalNs;
+    Rollup &rollup = (*rollups)[item->getKey()][bucket];
+    rollup.records++;
+
+    for (size_t i = 0; i < item->mPropCount; i++) {
+        const MediaAnalyticsItem::Prop *prop = &item->mProps[i];
+        double value;
+        switch (prop->mType) {
+            case MediaAnalyticsItem::kTypeInt32:
+                value = prop->u.int32Value;
+                break;
+            case MediaAnalyticsItem::kTypeInt64:
+                value = prop->u.int64Value;
+                break;
+            case MediaAnalyticsItem::kTypeDouble:
+                value = prop->u.doubleValue;
+                break;
+            case MediaAnalyticsItem::kTypeRate:
+                if (prop->u.rate.duration == 0) {
+                    continue;
+                }
+                value = prop->u.rate.count / (double) prop->u.rate.duration;
+                break;
+            default:
+                // strings don't aggregate
+                continue;
+        }
+
+        auto it = rollup.attributes.find(prop->mName);
+        if (it == rollup.attributes.end()) {
+            rollup.attributes[prop->mName] = {1, value, value, value};
+        } else {
+            Aggregate &aggregate = it->second;
+            aggregate.count++;
+            aggregate.sum += value;
+            aggregate.min = std::min(aggregate.min, value);
+            aggregate.max = std::max(aggregate.max, value);
+        }
+    }
+}
+
+void MediaAnalyticsStore::query(nsecs_t since, const char *only, Summary *summary) {
+    Mutex::Autolock _l(mLock);
+    for (const auto &keyRollups : mRollups) {
+        if (only != NULL && keyRollups.first != only) {
+            continue;
+        }
+        for (const auto &bucket : keyRollups.second) {
+            if (bucket.first + kRollupIntervalNs <= since) {
+                continue;
+            }
+            Rollup &merged = (*summary)[keyRollups.first];
+            merged.records += bucket.second.records;
+            for (const auto &attribute : bucket.second.attributes) {
+                const Aggregate &from = attribute.second;
+                auto it = merged.attributes.find(attribute.first);
+                if (it == merged.attributes.end()) {
+                    merged.attributes[attribute.first] = from;
+                } else {
+                    Aggregate &to = it->second;
+                    to.count += from.count;
+                    to.sum += from.sum;
+                    to.min = std::min(to.min, from.min);
+                    to.max = std::max(to.max, from.max);
+                }
+            }
+        }
+    }
+}
+
+void MediaAnalyticsStore::dumpStats(String8 &result) {
+    Mutex::Autolock _l(mLock);
+    result.appendFormat("Stored Records: %8" PRId64 " (Written: %" PRId64
+                        " Dropped: %" PRId64 " Write Errors: %" PRId64 ")\n",
+                        mRecordsStored, mRecordsWritten, mRecordsDropped, mWriteErrors);
+}
+
+void MediaAnalyticsStore::dumpSummary(String8 &result, nsecs_t since, const char *only) {
+    Summary summary;
+    query(since, only, &summary);
+
+    result.append("\nSummary of Stored Records:\n");
+    if (summary.empty()) {
+        result.append("empty\n");
+        return;
+    }
+    for (const auto &keyRollup : summary) {
+        result.appendFormat("%s: %" PRId64 " records\n",
+                            keyRollup.first.c_str(), keyRollup.second.records);
+        for (const auto &attribute : keyRollup.second.attributes) {
+            const Aggregate &aggregate = attribute.second;
+            result.appendFormat("    %s: count %" PRId64 " min %g mean %g max %g\n",
+                                attribute.first.c_str(), aggregate.count, aggregate.min,
+                                aggregate.sum / aggregate.count, aggregate.max);
+        }
+    }
+}
+
+} // namespace android
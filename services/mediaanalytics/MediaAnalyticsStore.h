@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_MEDIAANALYTICSSTORE_H
+#define ANDROID_MEDIAANALYTICSSTORE_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <thread>
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include <media/MediaAnalyticsItem.h>
+
+namespace android {
+
+// Append-only on-disk log of finalized records, so that they survive a
+// restart of the service, plus per-key rollups of their numeric attributes.
+//
+// Records are written in the MediaAnalyticsItem parcel format, each framed
+// by its length and a checksum, so a torn write at the end of a segment is
+// detected and dropped on the next load. The log is split into a current
+// and a previous segment; when the current one reaches maxSegmentBytes it
+// replaces the previous one, which bounds the disk use to twice that.
+//
+// The rollups cover exactly the records held on disk, bucketed by hour,
+// and are rebuilt from the log on startup and after each rotation.
+//
+// All file I/O happens on a writer thread; append() only copies the record
+// onto a bounded queue and never blocks the submitting client.
+class MediaAnalyticsStore {
+ public:
+    static const size_t kDefaultMaxSegmentBytes = 2 * 1024 * 1024;
+    static const size_t kDefaultMaxPending = 1000;
+    static const nsecs_t kRollupIntervalNs = 3600 * (1000*1000*1000ll);
+
+    // Summary of the values one attribute took
+    struct Aggregate {
+        int64_t count;
+        double sum;
+        double min;
+        double max;
+    };
+
+    // Summary of the records with one key
+    struct Rollup {
+        int64_t records;
+        std::map<std::string, Aggregate> attributes;
+    };
+
+    // key -> rollup
+    typedef std::map<std::string, Rollup> Summary;
+
+    MediaAnalyticsStore(const char *directory,
+                        size_t maxSegmentBytes = kDefaultMaxSegmentBytes,
+                        size_t maxPending = kDefaultMaxPending);
+    ~MediaAnalyticsStore();
+
+    // Queue a copy of 'item' for writing; caller keeps ownership.
+    // Returns false if the queue was full and the record was dropped.
+    bool append(MediaAnalyticsItem *item);
+
+    // Rollups of the stored records newer than 'since' (at hour granularity),
+    // limited to key 'only' if it is not NULL.
+    void query(nsecs_t since, const char *only, Summary *summary);
+
+    void dumpStats(String8 &result);
+    void dumpSummary(String8 &result, nsecs_t since, const char *only);
+
+ private:
+    // key -> start of hour -> rollup
+    typedef std::map<std::string, std::map<nsecs_t, Rollup>> Rollups;
+
+    void threadLoop();
+
+    // (re)opens the current segment, dropping any torn record at its end
+    bool openSegment();
+    void rotate();
+    bool writeRecords(const std::deque<MediaAnalyticsItem *> &items);
+
+    // returns # of valid bytes at the start of the segment at 'path'
+    static off_t loadSegment(const std::string &path, Rollups *rollups, int64_t *records);
+    static void addToRollups(MediaAnalyticsItem *item, Rollups *rollups);
+
+    const std::string mCurrentPath;
+    const std::string mPreviousPath;
+    const size_t mMaxSegmentBytes;
+    const size_t mMaxPending;
+
+    // only touched by the writer thread
+    int mFd;
+    off_t mSegmentBytes;
+
+    Mutex mLock;
+    Condition mCondition;
+    // guarded by mLock
+    std::deque<MediaAnalyticsItem *> mPending;
+    bool mExiting;
+    Rollups mRollups;
+    int64_t mRecordsStored;
+    int64_t mRecordsWritten;
+    int64_t mRecordsDropped;
+    int64_t mWriteErrors;
+
+    std::thread mThread;
+};
+
+} // namespace android
+
+#endif // ANDROID_MEDIAANALYTICSSTORE_H
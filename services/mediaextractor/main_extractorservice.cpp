@@ -26,6 +26,7 @@
 
 #include <android-base/logging.h>
 #include <android-base/properties.h>
+#include <media/stagefright/MediaExtractorFactory.h>
 #include <utils/misc.h>
 
 // from LOCAL_C_INCLUDES
@@ -72,5 +73,10 @@ int main(int argc __unused, char** argv)
     }
 
     ProcessState::self()->startThreadPool();
+
+    // load the extractor plugins now rather than on the first request; a
+    // request that comes in meanwhile waits for this to finish
+    MediaExtractorFactory::PreloadPlugins();
+
     IPCThreadState::self()->joinThreadPool();
 }
@@ -131,6 +131,11 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
                 }
             }
             mLock.unlock();
+        } else if (!strcmp(arg0.string(), "-b")) {
+            // raw merged entries for tools/nblog_analyzer, e.g.
+            // adb shell dumpsys media.log -b > trace.nblog
+            mMergeReader.dumpBinary(fd);
+            return NO_ERROR;
         }
     }
     mMergeReader.dump(fd);
@@ -23,6 +23,7 @@
 #include <binder/IServiceManager.h>
 #include <dirent.h>
 #include <media/stagefright/ProcessInfo.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -78,13 +79,14 @@ static bool hasResourceType(MediaResource::Type type, const Vector<MediaResource
     return false;
 }
 
-static bool hasResourceType(MediaResource::Type type, const ResourceInfos& infos) {
-    for (size_t i = 0; i < infos.size(); ++i) {
-        if (hasResourceType(type, infos[i].resources)) {
-            return true;
+static uint64_t getVideoCodecLoad(const Vector<MediaResource>& resources) {
+    uint64_t load = 0;
+    for (size_t i = 0; i < resources.size(); ++i) {
+        if (resources[i].mType == MediaResource::kVideoCodecLoad) {
+            load += resources[i].mValue;
         }
     }
-    return false;
+    return load;
 }
 
 static ResourceInfos& getResourceInfosForEdit(
@@ -147,12 +149,16 @@ status_t ResourceManagerService::dump(int fd, const Vector<String16>& /* args */
     PidResourceInfosMap mapCopy;
     bool supportsMultipleSecureCodecs;
     bool supportsSecureWithNonSecureCodec;
+    uint64_t maxVideoCodecLoad;
+    uint64_t videoCodecLoad;
     String8 serviceLog;
     {
         Mutex::Autolock lock(mLock);
         mapCopy = mMap;  // Shadow copy, real copy will happen on write.
         supportsMultipleSecureCodecs = mSupportsMultipleSecureCodecs;
         supportsSecureWithNonSecureCodec = mSupportsSecureWithNonSecureCodec;
+        maxVideoCodecLoad = mMaxVideoCodecLoad;
+        videoCodecLoad = mVideoCodecLoad;
         serviceLog = mServiceLog->toString("    " /* linePrefix */);
     }
 
@@ -166,6 +172,9 @@ status_t ResourceManagerService::dump(int fd, const Vector<String16>& /* args */
     snprintf(buffer, SIZE, "    SupportsSecureWithNonSecureCodec: %d\n",
             supportsSecureWithNonSecureCodec);
     result.append(buffer);
+    snprintf(buffer, SIZE, "    MaxVideoCodecLoad: %llu (in use: %llu)\n",
+            (unsigned long long)maxVideoCodecLoad, (unsigned long long)videoCodecLoad);
+    result.append(buffer);
 
     result.append("  Processes:\n");
     for (size_t i = 0; i < mapCopy.size(); ++i) {
@@ -204,7 +213,9 @@ ResourceManagerService::ResourceManagerService(sp<ProcessInfoInterface> processI
       mServiceLog(new ServiceLog()),
       mSupportsMultipleSecureCodecs(true),
       mSupportsSecureWithNonSecureCodec(true),
-      mCpuBoostCount(0) {}
+      mCpuBoostCount(0),
+      mMaxVideoCodecLoad(0),
+      mVideoCodecLoad(0) {}
 
 ResourceManagerService::~ResourceManagerService() {}
 
@@ -220,6 +231,8 @@ void ResourceManagerService::config(const Vector<MediaResourcePolicy> &policies)
             mSupportsMultipleSecureCodecs = (value == "true");
         } else if (type == kPolicySupportsSecureWithNonSecureCodec) {
             mSupportsSecureWithNonSecureCodec = (value == "true");
+        } else if (type == kPolicyMaxVideoCodecLoad) {
+            mMaxVideoCodecLoad = strtoull(value.string(), NULL, 10);
         }
     }
 }
@@ -241,7 +254,26 @@ void ResourceManagerService::addResource(
     ResourceInfos& infos = getResourceInfosForEdit(pid, mMap);
     ResourceInfo& info = getResourceInfoForEdit(clientId, client, infos);
     // TODO: do the merge instead of append.
-    info.resources.appendVector(resources);
+    for (size_t i = 0; i < resources.size(); ++i) {
+        if (!hasResourceType(resources[i].mType, info.resources)) {
+            addToTypeIndex_l(pid, resources[i].mType);
+        } else if (resources[i].mType == MediaResource::kVideoCodecLoad) {
+            // A session has a single load, which is re-reported on every start.
+            for (size_t j = 0; j < info.resources.size(); ++j) {
+                if (info.resources[j].mType == MediaResource::kVideoCodecLoad) {
+                    mVideoCodecLoad -= info.resources[j].mValue;
+                    info.resources.editItemAt(j).mValue = resources[i].mValue;
+                    break;
+                }
+            }
+            mVideoCodecLoad += resources[i].mValue;
+            continue;
+        }
+        if (resources[i].mType == MediaResource::kVideoCodecLoad) {
+            mVideoCodecLoad += resources[i].mValue;
+        }
+        info.resources.push_back(resources[i]);
+    }
 
     for (size_t i = 0; i < resources.size(); ++i) {
         if (resources[i].mType == MediaResource::kCpuBoost && !info.cpuBoost) {
@@ -292,6 +324,8 @@ void ResourceManagerService::removeResource(int pid, int64_t clientId, bool chec
                 }
             }
             IInterface::asBinder(infos[j].client)->unlinkToDeath(infos[j].deathNotifier);
+            removeFromTypeIndex_l(pid, infos[j]);
+            mVideoCodecLoad -= getVideoCodecLoad(infos[j].resources);
             j = infos.removeAt(j);
             found = true;
             break;
@@ -326,9 +360,11 @@ bool ResourceManagerService::reclaimResource(
             ALOGE("Rejected reclaimResource call with invalid callingPid.");
             return false;
         }
+        mPriorityCache.clear();
         const MediaResource *secureCodec = NULL;
         const MediaResource *nonSecureCodec = NULL;
         const MediaResource *graphicMemory = NULL;
+        const MediaResource *videoCodecLoad = NULL;
         for (size_t i = 0; i < resources.size(); ++i) {
             MediaResource::Type type = resources[i].mType;
             if (resources[i].mType == MediaResource::kSecureCodec) {
@@ -337,6 +373,8 @@ bool ResourceManagerService::reclaimResource(
                 nonSecureCodec = &resources[i];
             } else if (type == MediaResource::kGraphicMemory) {
                 graphicMemory = &resources[i];
+            } else if (type == MediaResource::kVideoCodecLoad) {
+                videoCodecLoad = &resources[i];
             }
         }
 
@@ -361,6 +399,13 @@ bool ResourceManagerService::reclaimResource(
             }
         }
 
+        if (clients.size() == 0 && videoCodecLoad != NULL
+                && isVideoCodecLoadExceeded_l(videoCodecLoad->mValue)) {
+            // the new session is predicted not to fit next to the running ones, free the
+            // busiest codec of the lowest priority process before the allocation fails.
+            getClientForResource_l(callingPid, videoCodecLoad, &clients);
+        }
+
         if (clients.size() == 0) {
             // if no secure/non-secure codec conflict, run second pass to handle other resources.
             getClientForResource_l(callingPid, graphicMemory, &clients);
@@ -410,6 +455,8 @@ bool ResourceManagerService::reclaimResource(
             ResourceInfos &infos = mMap.editValueAt(i);
             for (size_t j = 0; j < infos.size();) {
                 if (infos[j].client == failedClient) {
+                    removeFromTypeIndex_l(mMap.keyAt(i), infos[j]);
+                    mVideoCodecLoad -= getVideoCodecLoad(infos[j].resources);
                     j = infos.removeAt(j);
                     found = true;
                 } else {
@@ -431,17 +478,20 @@ bool ResourceManagerService::reclaimResource(
 bool ResourceManagerService::getAllClients_l(
         int callingPid, MediaResource::Type type, Vector<sp<IResourceManagerClient>> *clients) {
     Vector<sp<IResourceManagerClient>> temp;
-    for (size_t i = 0; i < mMap.size(); ++i) {
-        ResourceInfos &infos = mMap.editValueAt(i);
+    ssize_t typeIndex = mTypePids.indexOfKey(type);
+    const size_t numPids = typeIndex < 0 ? 0 : mTypePids.valueAt(typeIndex).size();
+    for (size_t i = 0; i < numPids; ++i) {
+        int pid = mTypePids.valueAt(typeIndex).keyAt(i);
+        if (!isCallingPriorityHigher_l(callingPid, pid)) {
+            // some higher/equal priority process owns the resource,
+            // this request can't be fulfilled.
+            ALOGE("getAllClients_l: can't reclaim resource %s from pid %d",
+                    asString(type), pid);
+            return false;
+        }
+        const ResourceInfos &infos = mMap.valueFor(pid);
         for (size_t j = 0; j < infos.size(); ++j) {
             if (hasResourceType(type, infos[j].resources)) {
-                if (!isCallingPriorityHigher_l(callingPid, mMap.keyAt(i))) {
-                    // some higher/equal priority process owns the resource,
-                    // this request can't be fulfilled.
-                    ALOGE("getAllClients_l: can't reclaim resource %s from pid %d",
-                            asString(type), mMap.keyAt(i));
-                    return false;
-                }
                 temp.push_back(infos[j].client);
             }
         }
@@ -459,7 +509,7 @@ bool ResourceManagerService::getLowestPriorityBiggestClient_l(
     int lowestPriorityPid;
     int lowestPriority;
     int callingPriority;
-    if (!mProcessInfo->getPriority(callingPid, &callingPriority)) {
+    if (!getPriority_l(callingPid, &callingPriority)) {
         ALOGE("getLowestPriorityBiggestClient_l: can't get process priority for pid %d",
                 callingPid);
         return false;
@@ -483,18 +533,16 @@ bool ResourceManagerService::getLowestPriorityPid_l(
         MediaResource::Type type, int *lowestPriorityPid, int *lowestPriority) {
     int pid = -1;
     int priority = -1;
-    for (size_t i = 0; i < mMap.size(); ++i) {
-        if (mMap.valueAt(i).size() == 0) {
-            // no client on this process.
-            continue;
-        }
-        if (!hasResourceType(type, mMap.valueAt(i))) {
-            // doesn't have the requested resource type
-            continue;
-        }
-        int tempPid = mMap.keyAt(i);
+    ssize_t typeIndex = mTypePids.indexOfKey(type);
+    if (typeIndex < 0) {
+        // no process has the requested resource type
+        return false;
+    }
+    const PidClientCountMap &pids = mTypePids.valueAt(typeIndex);
+    for (size_t i = 0; i < pids.size(); ++i) {
+        int tempPid = pids.keyAt(i);
         int tempPriority;
-        if (!mProcessInfo->getPriority(tempPid, &tempPriority)) {
+        if (!getPriority_l(tempPid, &tempPriority)) {
             ALOGV("getLowestPriorityPid_l: can't get priority of pid %d, skipped", tempPid);
             // TODO: remove this pid from mMap?
             continue;
@@ -514,18 +562,75 @@ bool ResourceManagerService::getLowestPriorityPid_l(
 
 bool ResourceManagerService::isCallingPriorityHigher_l(int callingPid, int pid) {
     int callingPidPriority;
-    if (!mProcessInfo->getPriority(callingPid, &callingPidPriority)) {
+    if (!getPriority_l(callingPid, &callingPidPriority)) {
         return false;
     }
 
     int priority;
-    if (!mProcessInfo->getPriority(pid, &priority)) {
+    if (!getPriority_l(pid, &priority)) {
         return false;
     }
 
     return (callingPidPriority < priority);
 }
 
+bool ResourceManagerService::isVideoCodecLoadExceeded_l(uint64_t load) const {
+    return mMaxVideoCodecLoad > 0 && mVideoCodecLoad + load > mMaxVideoCodecLoad;
+}
+
+bool ResourceManagerService::getPriority_l(int pid, int *priority) {
+    ssize_t index = mPriorityCache.indexOfKey(pid);
+    if (index >= 0) {
+        *priority = mPriorityCache.valueAt(index);
+        return true;
+    }
+    if (!mProcessInfo->getPriority(pid, priority)) {
+        return false;
+    }
+    mPriorityCache.add(pid, *priority);
+    return true;
+}
+
+void ResourceManagerService::addToTypeIndex_l(int pid, MediaResource::Type type) {
+    ssize_t typeIndex = mTypePids.indexOfKey(type);
+    if (typeIndex < 0) {
+        typeIndex = mTypePids.add(type, PidClientCountMap());
+    }
+    PidClientCountMap &pids = mTypePids.editValueAt(typeIndex);
+    ssize_t pidIndex = pids.indexOfKey(pid);
+    if (pidIndex < 0) {
+        pids.add(pid, 1);
+    } else {
+        ++pids.editValueAt(pidIndex);
+    }
+}
+
+void ResourceManagerService::removeFromTypeIndex_l(int pid, const ResourceInfo &info) {
+    const Vector<MediaResource> &resources = info.resources;
+    for (size_t i = 0; i < resources.size(); ++i) {
+        MediaResource::Type type = resources[i].mType;
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; ++j) {
+            seen = (resources[j].mType == type);
+        }
+        if (seen) {
+            continue;
+        }
+        ssize_t typeIndex = mTypePids.indexOfKey(type);
+        if (typeIndex < 0) {
+            continue;
+        }
+        PidClientCountMap &pids = mTypePids.editValueAt(typeIndex);
+        ssize_t pidIndex = pids.indexOfKey(pid);
+        if (pidIndex >= 0 && --pids.editValueAt(pidIndex) == 0) {
+            pids.removeItemsAt(pidIndex);
+        }
+        if (pids.isEmpty()) {
+            mTypePids.removeItemsAt(typeIndex);
+        }
+    }
+}
+
 bool ResourceManagerService::getBiggestClient_l(
         int pid, MediaResource::Type type, sp<IResourceManagerClient> *client) {
     ssize_t index = mMap.indexOfKey(pid);
@@ -538,7 +643,7 @@ bool ResourceManagerService::getBiggestClient_l(
     uint64_t largestValue = 0;
     const ResourceInfos &infos = mMap.valueAt(index);
     for (size_t i = 0; i < infos.size(); ++i) {
-        Vector<MediaResource> resources = infos[i].resources;
+        const Vector<MediaResource> &resources = infos[i].resources;
         for (size_t j = 0; j < resources.size(); ++j) {
             if (resources[j].mType == type) {
                 if (resources[j].mValue > largestValue) {
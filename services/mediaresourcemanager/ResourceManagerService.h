@@ -43,6 +43,9 @@ struct ResourceInfo {
 
 typedef Vector<ResourceInfo> ResourceInfos;
 typedef KeyedVector<int, ResourceInfos> PidResourceInfosMap;
+// pid -> # of clients in that process holding a given resource type
+typedef KeyedVector<int, int> PidClientCountMap;
+typedef KeyedVector<MediaResource::Type, PidClientCountMap> TypePidsMap;
 
 class ResourceManagerService
     : public BinderService<ResourceManagerService>,
@@ -102,6 +105,16 @@ private:
 
     bool isCallingPriorityHigher_l(int callingPid, int pid);
 
+    // Looks up the priority of pid, at most once per reclaimResource call.
+    bool getPriority_l(int pid, int *priority);
+
+    // Returns true if a new session adding 'load' would exceed mMaxVideoCodecLoad.
+    bool isVideoCodecLoadExceeded_l(uint64_t load) const;
+
+    // Keep mTypePids in sync with the resources held by each client.
+    void addToTypeIndex_l(int pid, MediaResource::Type type);
+    void removeFromTypeIndex_l(int pid, const ResourceInfo &info);
+
     // A helper function basically calls getLowestPriorityBiggestClient_l and add the result client
     // to the given Vector.
     void getClientForResource_l(
@@ -111,9 +124,19 @@ private:
     sp<ProcessInfoInterface> mProcessInfo;
     sp<ServiceLog> mServiceLog;
     PidResourceInfosMap mMap;
+    // index of the pids holding each resource type, so that reclaim only
+    // visits the processes that can actually give the resource back
+    TypePidsMap mTypePids;
+    // pid -> priority, cleared at the start of every reclaimResource call
+    // since process priorities change without notice
+    KeyedVector<int, int> mPriorityCache;
     bool mSupportsMultipleSecureCodecs;
     bool mSupportsSecureWithNonSecureCodec;
     int32_t mCpuBoostCount;
+    // video codec load the device can sustain (0 if unknown), and the sum of
+    // the kVideoCodecLoad resources currently held
+    uint64_t mMaxVideoCodecLoad;
+    uint64_t mVideoCodecLoad;
 };
 
 // ----------------------------------------------------------------------------
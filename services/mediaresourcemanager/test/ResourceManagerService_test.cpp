@@ -232,6 +232,58 @@ protected:
         EXPECT_EQ(1u, infos2.size());
         // mTestClient2 has been removed.
         EXPECT_EQ(mTestClient3, infos2[0].client);
+
+        int pid;
+        int priority;
+        // mTestClient2 was the only client with MediaResource::kNonSecureCodec.
+        EXPECT_FALSE(mService->getLowestPriorityPid_l(
+                MediaResource::kNonSecureCodec, &pid, &priority));
+
+        // Removing mTestClient1 leaves kTestPid2 as the only secure codec owner.
+        mService->removeResource(kTestPid1, getId(mTestClient1));
+        EXPECT_TRUE(mService->getLowestPriorityPid_l(
+                MediaResource::kSecureCodec, &pid, &priority));
+        EXPECT_EQ(kTestPid2, pid);
+    }
+
+    void testReclaimResourceVideoCodecLoad() {
+        Vector<MediaResourcePolicy> policies;
+        policies.push_back(
+                MediaResourcePolicy(
+                        String8(kPolicyMaxVideoCodecLoad),
+                        String8("1000")));
+        mService->config(policies);
+        EXPECT_EQ(1000u, mService->mMaxVideoCodecLoad);
+
+        Vector<MediaResource> resources1;
+        resources1.push_back(MediaResource(MediaResource::kVideoCodecLoad, 600));
+        mService->addResource(kTestPid1, getId(mTestClient1), mTestClient1, resources1);
+        Vector<MediaResource> resources2;
+        resources2.push_back(MediaResource(MediaResource::kVideoCodecLoad, 300));
+        mService->addResource(kTestPid2, getId(mTestClient2), mTestClient2, resources2);
+        // re-reporting the load of a session replaces it
+        mService->addResource(kTestPid2, getId(mTestClient2), mTestClient2, resources2);
+        EXPECT_EQ(900u, mService->mVideoCodecLoad);
+
+        Vector<MediaResource> request;
+        request.push_back(MediaResource(MediaResource::kVideoCodecLoad, 100));
+        // fits, nothing to reclaim
+        EXPECT_FALSE(mService->reclaimResource(kHighPriorityPid, request));
+        verifyClients(false /* c1 */, false /* c2 */, false /* c3 */);
+
+        request.editItemAt(0).mValue = 500;
+        // priority too low
+        EXPECT_FALSE(mService->reclaimResource(kLowPriorityPid, request));
+        verifyClients(false /* c1 */, false /* c2 */, false /* c3 */);
+
+        // reclaim the session of the lowest priority process
+        EXPECT_TRUE(mService->reclaimResource(kHighPriorityPid, request));
+        verifyClients(true /* c1 */, false /* c2 */, false /* c3 */);
+        EXPECT_EQ(300u, mService->mVideoCodecLoad);
+
+        // fits now
+        EXPECT_FALSE(mService->reclaimResource(kHighPriorityPid, request));
+        verifyClients(false /* c1 */, false /* c2 */, false /* c3 */);
     }
 
     void testGetAllClients() {
@@ -521,6 +573,10 @@ TEST_F(ResourceManagerServiceTest, reclaimResource) {
     testReclaimResourceNonSecure();
 }
 
+TEST_F(ResourceManagerServiceTest, reclaimResourceVideoCodecLoad) {
+    testReclaimResourceVideoCodecLoad();
+}
+
 TEST_F(ResourceManagerServiceTest, getAllClients_l) {
     testGetAllClients();
 }
@@ -18,12 +18,15 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <assert.h>
+#include <chrono>
 #include <functional>
 #include <map>
 #include <mutex>
 #include <sstream>
 #include <utility/AAudioUtilities.h>
+#include <utility/AudioClock.h>
 
 #include "AAudioEndpointManager.h"
 #include "AAudioServiceEndpointShared.h"
@@ -42,6 +45,35 @@ AAudioEndpointManager::AAudioEndpointManager()
         , mExclusiveStreams() {
 }
 
+AAudioEndpointManager::~AAudioEndpointManager() {
+    {
+        std::lock_guard<std::mutex> lock(mSharedLock);
+        mCacheThreadExit = true;
+    }
+    mCacheCondition.notify_all();
+    if (mCacheThread.joinable()) {
+        mCacheThread.join();
+    }
+}
+
+void AAudioEndpointManager::LatencyHistogram::add(int64_t nanoseconds) {
+    const int64_t millis = nanoseconds / AAUDIO_NANOS_PER_MILLISECOND;
+    int32_t bin = 0;
+    while (bin < kNumBins - 1 && millis >= (1LL << bin)) {
+        bin++;
+    }
+    mBins[bin]++;
+}
+
+std::string AAudioEndpointManager::LatencyHistogram::dump() const {
+    std::stringstream result;
+    for (int32_t bin = 0; bin < kNumBins - 1; bin++) {
+        result << " <" << (1 << bin) << ":" << mBins[bin];
+    }
+    result << " >=" << (1 << (kNumBins - 2)) << ":" << mBins[kNumBins - 1] << " msec";
+    return result.str();
+}
+
 std::string AAudioEndpointManager::dump() const {
     std::stringstream result;
     int index = 0;
@@ -76,6 +108,7 @@ std::string AAudioEndpointManager::dump() const {
         result << "  ExclusiveFoundCount:   " << mExclusiveFoundCount << "\n";
         result << "  ExclusiveOpenCount:    " << mExclusiveOpenCount << "\n";
         result << "  ExclusiveCloseCount:   " << mExclusiveCloseCount << "\n";
+        result << "  ExclusiveOpenLatency: " << mExclusiveOpenLatency.dump() << "\n";
         result << "\n";
 
         if (isExclusiveLocked) {
@@ -94,6 +127,10 @@ std::string AAudioEndpointManager::dump() const {
     result << "  SharedFoundCount:      " << mSharedFoundCount << "\n";
     result << "  SharedOpenCount:       " << mSharedOpenCount << "\n";
     result << "  SharedCloseCount:      " << mSharedCloseCount << "\n";
+    result << "  SharedCachedCount:     " << mCachedSharedEndpoints.size() << "\n";
+    result << "  SharedReuseCount:      " << mSharedReuseCount << "\n";
+    result << "  SharedExpireCount:     " << mSharedExpireCount << "\n";
+    result << "  SharedOpenLatency:    " << mSharedOpenLatency.dump() << "\n";
     result << "\n";
 
     if (isSharedLocked) {
@@ -134,6 +171,17 @@ sp<AAudioServiceEndpointShared> AAudioEndpointManager::findSharedEndpoint_l(
         }
     }
 
+    // Take a cached endpoint back into use.
+    if (endpoint.get() != nullptr && endpoint->getOpenCount() <= 0) {
+        for (auto it = mCachedSharedEndpoints.begin(); it != mCachedSharedEndpoints.end(); ++it) {
+            if (it->endpoint == endpoint) {
+                mCachedSharedEndpoints.erase(it);
+                mSharedReuseCount++;
+                break;
+            }
+        }
+    }
+
     ALOGV("findSharedEndpoint_l(), found %p for device = %d, sessionId = %d",
           endpoint.get(), configuration.getDeviceId(), configuration.getSessionId());
     return endpoint;
@@ -143,7 +191,14 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::openEndpoint(AAudioService &aud
                                         const aaudio::AAudioStreamRequest &request,
                                         aaudio_sharing_mode_t sharingMode) {
     if (sharingMode == AAUDIO_SHARING_MODE_EXCLUSIVE) {
-        return openExclusiveEndpoint(audioService, request);
+        sp<AAudioServiceEndpoint> endpoint = openExclusiveEndpoint(audioService, request);
+        // The device may still be held by an unused shared endpoint in the cache.
+        // Streams opened in the service are opened with mSharedLock held.
+        if (endpoint.get() == nullptr && !request.isInService()
+                && releaseCachedEndpoints() > 0) {
+            endpoint = openExclusiveEndpoint(audioService, request);
+        }
+        return endpoint;
     } else {
         return openSharedEndpoint(audioService, request);
     }
@@ -171,6 +226,7 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::openExclusiveEndpoint(
               endpointMMap.get(), configuration.getDeviceId());
         endpoint = endpointMMap;
 
+        const int64_t startNanos = AudioClock::getNanoseconds();
         aaudio_result_t result = endpoint->open(request);
         if (result != AAUDIO_OK) {
             ALOGE("openExclusiveEndpoint(), open failed");
@@ -178,6 +234,7 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::openExclusiveEndpoint(
         } else {
             mExclusiveStreams.push_back(endpointMMap);
             mExclusiveOpenCount++;
+            mExclusiveOpenLatency.add(AudioClock::getNanoseconds() - startNanos);
         }
     }
 
@@ -201,7 +258,9 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::openSharedEndpoint(
     sp<AAudioServiceEndpointShared> endpoint = findSharedEndpoint_l(configuration);
 
     // If we can't find an existing one then open a new one.
-    if (endpoint.get() == nullptr) {
+    // Retry once if an unused cached endpoint might be holding the device.
+    bool canRetry = !mCachedSharedEndpoints.empty();
+    while (endpoint.get() == nullptr) {
         // we must call openStream with audioserver identity
         int64_t token = IPCThreadState::self()->clearCallingIdentity();
         switch (direction) {
@@ -216,17 +275,25 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::openSharedEndpoint(
         }
 
         if (endpoint.get() != nullptr) {
+            const int64_t startNanos = AudioClock::getNanoseconds();
             aaudio_result_t result = endpoint->open(request);
             if (result != AAUDIO_OK) {
                 endpoint.clear();
             } else {
                 mSharedStreams.push_back(endpoint);
                 mSharedOpenCount++;
+                mSharedOpenLatency.add(AudioClock::getNanoseconds() - startNanos);
             }
         }
         ALOGV("%s(), created endpoint %p, requested device = %d, dir = %d",
               __func__, endpoint.get(), configuration.getDeviceId(), (int)direction);
         IPCThreadState::self()->restoreCallingIdentity(token);
+
+        if (endpoint.get() != nullptr || !canRetry
+                || releaseCachedEndpoints_l(INT64_MAX) == 0) {
+            break;
+        }
+        canRetry = false;
     }
 
     if (endpoint.get() != nullptr) {
@@ -277,8 +344,18 @@ void AAudioEndpointManager::closeSharedEndpoint(sp<AAudioServiceEndpoint> servic
     int32_t newRefCount = serviceEndpoint->getOpenCount() - 1;
     serviceEndpoint->setOpenCount(newRefCount);
 
-    // If no longer in use then actually close it.
+    // If no longer in use then keep it warm for a while or actually close it.
     if (newRefCount <= 0) {
+        const int32_t cacheMillis = AAudioProperty_getEndpointCacheMillis();
+        if (cacheMillis > 0 && serviceEndpoint->isConnected()) {
+            for (const auto &ep : mSharedStreams) {
+                if (ep == serviceEndpoint) {
+                    cacheSharedEndpoint_l(ep, cacheMillis);
+                    return;
+                }
+            }
+        }
+
         mSharedStreams.erase(
                 std::remove(mSharedStreams.begin(), mSharedStreams.end(), serviceEndpoint),
                 mSharedStreams.end());
@@ -289,3 +366,63 @@ void AAudioEndpointManager::closeSharedEndpoint(sp<AAudioServiceEndpoint> servic
               __func__, serviceEndpoint.get(), serviceEndpoint->getDeviceId());
     }
 }
+
+void AAudioEndpointManager::cacheSharedEndpoint_l(sp<AAudioServiceEndpointShared> endpoint,
+                                                  int32_t cacheMillis) {
+    const int64_t releaseTimeNanos = AudioClock::getNanoseconds()
+            + cacheMillis * AAUDIO_NANOS_PER_MILLISECOND;
+    mCachedSharedEndpoints.push_back({endpoint, releaseTimeNanos});
+    if (!mCacheThread.joinable()) {
+        mCacheThread = std::thread(&AAudioEndpointManager::runCacheThread, this);
+    }
+    mCacheCondition.notify_all();
+    ALOGV("%s() %p for device %d for %d msec",
+          __func__, endpoint.get(), endpoint->getDeviceId(), cacheMillis);
+}
+
+int32_t AAudioEndpointManager::releaseCachedEndpoints() {
+    std::lock_guard<std::mutex> lock(mSharedLock);
+    return releaseCachedEndpoints_l(INT64_MAX);
+}
+
+int32_t AAudioEndpointManager::releaseCachedEndpoints_l(int64_t releaseTimeNanos) {
+    int32_t released = 0;
+    for (auto it = mCachedSharedEndpoints.begin(); it != mCachedSharedEndpoints.end();) {
+        if (it->releaseTimeNanos > releaseTimeNanos) {
+            ++it;
+            continue;
+        }
+        sp<AAudioServiceEndpointShared> endpoint = it->endpoint;
+        it = mCachedSharedEndpoints.erase(it);
+        mSharedStreams.erase(
+                std::remove(mSharedStreams.begin(), mSharedStreams.end(), endpoint),
+                mSharedStreams.end());
+
+        endpoint->close();
+        mSharedCloseCount++;
+        released++;
+        ALOGV("%s() %p for device %d",
+              __func__, endpoint.get(), endpoint->getDeviceId());
+    }
+    return released;
+}
+
+void AAudioEndpointManager::runCacheThread() {
+    std::unique_lock<std::mutex> lock(mSharedLock);
+    while (!mCacheThreadExit) {
+        if (mCachedSharedEndpoints.empty()) {
+            mCacheCondition.wait(lock);
+            continue;
+        }
+        int64_t nextReleaseNanos = INT64_MAX;
+        for (const auto &cached : mCachedSharedEndpoints) {
+            nextReleaseNanos = std::min(nextReleaseNanos, cached.releaseTimeNanos);
+        }
+        const int64_t nowNanos = AudioClock::getNanoseconds();
+        if (nextReleaseNanos > nowNanos) {
+            mCacheCondition.wait_for(lock, std::chrono::nanoseconds(nextReleaseNanos - nowNanos));
+        } else {
+            mSharedExpireCount += releaseCachedEndpoints_l(nowNanos);
+        }
+    }
+}
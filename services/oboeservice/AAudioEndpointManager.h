@@ -17,8 +17,10 @@
 #ifndef AAUDIO_AAUDIO_ENDPOINT_MANAGER_H
 #define AAUDIO_AAUDIO_ENDPOINT_MANAGER_H
 
+#include <condition_variable>
 #include <map>
 #include <mutex>
+#include <thread>
 #include <utils/Singleton.h>
 
 #include "binding/AAudioServiceMessage.h"
@@ -32,7 +34,7 @@ namespace aaudio {
 class AAudioEndpointManager : public android::Singleton<AAudioEndpointManager> {
 public:
     AAudioEndpointManager();
-    ~AAudioEndpointManager() = default;
+    ~AAudioEndpointManager();
 
     /**
      * Returns information about the state of the this class.
@@ -61,7 +63,25 @@ public:
 
     void closeEndpoint(android::sp<AAudioServiceEndpoint> serviceEndpoint);
 
+    /**
+     * Close the shared endpoints that are only kept open by the endpoint cache,
+     * for example because their device is needed by an EXCLUSIVE stream.
+     *
+     * @return number of endpoints closed
+     */
+    int32_t releaseCachedEndpoints();
+
 private:
+    // Counts open latencies in power-of-two millisecond bins.
+    class LatencyHistogram {
+    public:
+        void add(int64_t nanoseconds);
+        std::string dump() const;
+    private:
+        static constexpr int32_t kNumBins = 10; // < 1, < 2, < 4 ... < 256, >= 256 msec
+        int32_t mBins[kNumBins] = {};
+    };
+
     android::sp<AAudioServiceEndpoint> openExclusiveEndpoint(android::AAudioService &aaudioService,
                                                  const aaudio::AAudioStreamRequest &request);
 
@@ -77,6 +97,14 @@ private:
     void closeExclusiveEndpoint(android::sp<AAudioServiceEndpoint> serviceEndpoint);
     void closeSharedEndpoint(android::sp<AAudioServiceEndpoint> serviceEndpoint);
 
+    // Keep an unused shared endpoint open until cacheMillis have elapsed.
+    void cacheSharedEndpoint_l(android::sp<AAudioServiceEndpointShared> endpoint,
+                               int32_t cacheMillis);
+    // Close cached endpoints whose release time is at or before releaseTimeNanos.
+    int32_t releaseCachedEndpoints_l(int64_t releaseTimeNanos);
+    // Body of mCacheThread.
+    void runCacheThread();
+
     // Use separate locks because opening a Shared endpoint requires opening an Exclusive one.
     // That could cause a recursive lock.
     // Lock mSharedLock before mExclusiveLock.
@@ -84,6 +112,17 @@ private:
     mutable std::mutex                                     mSharedLock;
     std::vector<android::sp<AAudioServiceEndpointShared>>  mSharedStreams;
 
+    // Shared endpoints with no streams, still listed in mSharedStreams so they can be reused.
+    // Guarded by mSharedLock.
+    struct CachedEndpoint {
+        android::sp<AAudioServiceEndpointShared> endpoint;
+        int64_t releaseTimeNanos;
+    };
+    std::vector<CachedEndpoint>                            mCachedSharedEndpoints;
+    std::condition_variable                                mCacheCondition;
+    std::thread                                            mCacheThread; // started on first use
+    bool                                                   mCacheThreadExit = false;
+
     mutable std::mutex                                     mExclusiveLock;
     std::vector<android::sp<AAudioServiceEndpointMMAP>>    mExclusiveStreams;
 
@@ -97,6 +136,11 @@ private:
     int32_t mSharedFoundCount     = 0;
     int32_t mSharedOpenCount      = 0;
     int32_t mSharedCloseCount     = 0;
+    int32_t mSharedReuseCount     = 0; // number of times we REUSED a cached shared endpoint
+    int32_t mSharedExpireCount    = 0; // number of cached shared endpoints closed after expiring
+
+    LatencyHistogram mExclusiveOpenLatency;
+    LatencyHistogram mSharedOpenLatency;
 };
 } /* namespace aaudio */
 
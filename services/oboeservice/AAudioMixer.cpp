@@ -46,7 +46,7 @@ void AAudioMixer::allocate(int32_t samplesPerFrame, int32_t framesPerBurst) {
 }
 
 void AAudioMixer::clear() {
-    memset(mOutputBuffer, 0, mBufferSizeInBytes);
+    mSamplesMixed = 0;
 }
 
 int32_t AAudioMixer::mix(int streamIndex, FifoBuffer *fifo, bool allowUnderflow) {
@@ -91,7 +91,7 @@ int32_t AAudioMixer::mix(int streamIndex, FifoBuffer *fifo, bool allowUnderflow)
             if (framesToMixFromPart > framesAvailableFromPart) {
                 framesToMixFromPart = framesAvailableFromPart;
             }
-            mixPart(destination, (float *)wrappingBuffer.data[partIndex],
+            mixPart(destination, (const float *)wrappingBuffer.data[partIndex],
                     framesToMixFromPart);
 
             destination += framesToMixFromPart * mSamplesPerFrame;
@@ -108,14 +108,48 @@ int32_t AAudioMixer::mix(int streamIndex, FifoBuffer *fifo, bool allowUnderflow)
     return (framesDesired - framesLeft); // framesRead
 }
 
-void AAudioMixer::mixPart(float *destination, float *source, int32_t numFrames) {
-    int32_t numSamples = numFrames * mSamplesPerFrame;
-    // TODO maybe optimize using SIMD
-    for (int sampleIndex = 0; sampleIndex < numSamples; sampleIndex++) {
-        *destination++ += *source++;
+// Add source to destination. The buffers do not overlap and the loop is unrolled
+// so that the compiler can vectorize it with NEON or SSE.
+static void accumulate(float * __restrict destination, const float * __restrict source,
+                       int32_t numSamples) {
+    int32_t sampleIndex = 0;
+    for (; sampleIndex + 4 <= numSamples; sampleIndex += 4) {
+        destination[sampleIndex] += source[sampleIndex];
+        destination[sampleIndex + 1] += source[sampleIndex + 1];
+        destination[sampleIndex + 2] += source[sampleIndex + 2];
+        destination[sampleIndex + 3] += source[sampleIndex + 3];
+    }
+    for (; sampleIndex < numSamples; sampleIndex++) {
+        destination[sampleIndex] += source[sampleIndex];
+    }
+}
+
+void AAudioMixer::mixPart(float *destination, const float *source, int32_t numFrames) {
+    const int32_t numSamples = numFrames * mSamplesPerFrame;
+    const int32_t offset = destination - mOutputBuffer;
+
+    // Add to what earlier streams wrote, and copy past it rather than adding to zeros.
+    int32_t numSamplesToAdd = mSamplesMixed - offset;
+    if (numSamplesToAdd > numSamples) {
+        numSamplesToAdd = numSamples;
+    } else if (numSamplesToAdd < 0) {
+        numSamplesToAdd = 0;
+    }
+    accumulate(destination, source, numSamplesToAdd);
+    if (numSamplesToAdd < numSamples) {
+        memcpy(destination + numSamplesToAdd, source + numSamplesToAdd,
+               (numSamples - numSamplesToAdd) * sizeof(float));
+        mSamplesMixed = offset + numSamples;
     }
 }
 
 float *AAudioMixer::getOutputBuffer() {
+    // Clear what no stream wrote, for example when all of them underflowed.
+    const int32_t samplesPerBuffer = mSamplesPerFrame * mFramesPerBurst;
+    if (mSamplesMixed < samplesPerBuffer) {
+        memset(mOutputBuffer + mSamplesMixed, 0,
+               (samplesPerBuffer - mSamplesMixed) * sizeof(float));
+        mSamplesMixed = samplesPerBuffer;
+    }
     return mOutputBuffer;
 }
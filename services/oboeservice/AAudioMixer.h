@@ -29,6 +29,11 @@ public:
 
     void allocate(int32_t samplesPerFrame, int32_t framesPerBurst);
 
+    /**
+     * Start a new burst. The output buffer is not cleared here: the first stream mixed
+     * is copied instead of added, and only the part that no stream covered is cleared
+     * by getOutputBuffer().
+     */
     void clear();
 
     /**
@@ -40,17 +45,21 @@ public:
      */
     int32_t mix(int streamIndex, android::FifoBuffer *fifo, bool allowUnderflow);
 
+    /**
+     * @return the mix of the streams since clear(), a full burst
+     */
     float *getOutputBuffer();
 
     int32_t getFramesPerBurst() const { return mFramesPerBurst; }
 
 private:
-    void mixPart(float *destination, float *source, int32_t numFrames);
+    void mixPart(float *destination, const float *source, int32_t numFrames);
 
     float   *mOutputBuffer = nullptr;
     int32_t  mSamplesPerFrame = 0;
     int32_t  mFramesPerBurst = 0;
     int32_t  mBufferSizeInBytes = 0;
+    int32_t  mSamplesMixed = 0;     // samples at the start of mOutputBuffer written since clear()
 };
 
 #endif //AAUDIO_AAUDIO_MIXER_H
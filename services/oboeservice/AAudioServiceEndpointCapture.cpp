@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <map>
 #include <mutex>
@@ -61,6 +62,13 @@ void *AAudioServiceEndpointCapture::callbackLoop() {
     aaudio_result_t result = AAUDIO_OK;
     int64_t timeoutNanos = getStreamInternal()->calculateReasonableTimeout();
 
+    // Unless the data has to be converted, copy it from the MMAP buffer straight into
+    // the client FIFOs, from inside read(), rather than through mDistributionBuffer.
+    const bool needsConversion = mStreamInternalCapture.needsFormatConversion();
+    if (!needsConversion) {
+        mStreamInternalCapture.setFrameConsumer(this);
+    }
+
     // result might be a frame count
     while (mCallbackEnabled.load() && getStreamInternal()->isActive() && (result >= 0)) {
 
@@ -77,54 +85,78 @@ void *AAudioServiceEndpointCapture::callbackLoop() {
             break;
         }
 
-        // Distribute data to each active stream.
-        { // brackets are for lock_guard
-
-            std::lock_guard <std::mutex> lock(mLockStreams);
-            for (const auto clientStream : mRegisteredStreams) {
-                if (clientStream->isRunning()) {
-                    int64_t clientFramesWritten = 0;
-                    sp<AAudioServiceStreamShared> streamShared =
-                            static_cast<AAudioServiceStreamShared *>(clientStream.get());
-
-                    {
-                        // Lock the AudioFifo to protect against close.
-                        std::lock_guard <std::mutex> lock(streamShared->getAudioDataQueueLock());
-
-                        FifoBuffer *fifo = streamShared->getAudioDataFifoBuffer_l();
-                        if (fifo != nullptr) {
-
-                            // Determine offset between framePosition in client's stream
-                            // vs the underlying MMAP stream.
-                            clientFramesWritten = fifo->getWriteCounter();
-                            // There are two indices that refer to the same frame.
-                            int64_t positionOffset = mmapFramesRead - clientFramesWritten;
-                            streamShared->setTimestampPositionOffset(positionOffset);
-
-                            // Is the buffer too full to write a burst?
-                            if (fifo->getFifoControllerBase()->getEmptyFramesAvailable() <
-                                    getFramesPerBurst()) {
-                                streamShared->incrementXRunCount();
-                            } else {
-                                fifo->write(mDistributionBuffer, getFramesPerBurst());
-                            }
-                            clientFramesWritten = fifo->getWriteCounter();
-                        }
-                    }
+        if (needsConversion) {
+            WrappingBuffer parts;
+            parts.data[0] = mDistributionBuffer;
+            parts.numFrames[0] = getFramesPerBurst();
+            parts.data[1] = nullptr;
+            parts.numFrames[1] = 0;
+            distributeFrames(parts, getFramesPerBurst(), mmapFramesRead);
+        }
+    }
 
-                    if (clientFramesWritten > 0) {
-                        // This timestamp represents the completion of data being written into the
-                        // client buffer. It is sent to the client and used in the timing model
-                        // to decide when data will be available to read.
-                        Timestamp timestamp(clientFramesWritten, AudioClock::getNanoseconds());
-                        streamShared->markTransferTime(timestamp);
-                    }
+    mStreamInternalCapture.setFrameConsumer(nullptr);
+
+    ALOGD("callbackLoop() exiting");
+    return NULL; // TODO review
+}
 
+void AAudioServiceEndpointCapture::onFramesCaptured(const WrappingBuffer &parts,
+                                                    int32_t numFrames) {
+    // The read index has not been advanced yet so this is the position of the first frame.
+    distributeFrames(parts, numFrames, getStreamInternal()->getFramesRead());
+}
+
+void AAudioServiceEndpointCapture::distributeFrames(const WrappingBuffer &parts,
+                                                    int32_t numFrames,
+                                                    int64_t mmapFramesRead) {
+    std::lock_guard <std::mutex> lock(mLockStreams);
+    for (const auto clientStream : mRegisteredStreams) {
+        if (clientStream->isRunning()) {
+            int64_t clientFramesWritten = 0;
+            sp<AAudioServiceStreamShared> streamShared =
+                    static_cast<AAudioServiceStreamShared *>(clientStream.get());
+
+            {
+                // Lock the AudioFifo to protect against close.
+                std::lock_guard <std::mutex> lock(streamShared->getAudioDataQueueLock());
+
+                FifoBuffer *fifo = streamShared->getAudioDataFifoBuffer_l();
+                if (fifo != nullptr) {
+
+                    // Determine offset between framePosition in client's stream
+                    // vs the underlying MMAP stream.
+                    clientFramesWritten = fifo->getWriteCounter();
+                    // There are two indices that refer to the same frame.
+                    int64_t positionOffset = mmapFramesRead - clientFramesWritten;
+                    streamShared->setTimestampPositionOffset(positionOffset);
+
+                    // Is the buffer too full to write the frames?
+                    if (fifo->getFifoControllerBase()->getEmptyFramesAvailable() < numFrames) {
+                        streamShared->incrementXRunCount();
+                    } else {
+                        int32_t framesLeft = numFrames;
+                        for (int partIndex = 0; framesLeft > 0 && partIndex < WrappingBuffer::SIZE;
+                                partIndex++) {
+                            int32_t framesToWrite = std::min(framesLeft,
+                                                             parts.numFrames[partIndex]);
+                            if (framesToWrite <= 0) break;
+                            fifo->write(parts.data[partIndex], framesToWrite);
+                            framesLeft -= framesToWrite;
+                        }
+                    }
+                    clientFramesWritten = fifo->getWriteCounter();
                 }
             }
+
+            if (clientFramesWritten > 0) {
+                // This timestamp represents the completion of data being written into the
+                // client buffer. It is sent to the client and used in the timing model
+                // to decide when data will be available to read.
+                Timestamp timestamp(clientFramesWritten, AudioClock::getNanoseconds());
+                streamShared->markTransferTime(timestamp);
+            }
+
         }
     }
-
-    ALOGD("callbackLoop() exiting");
-    return NULL; // TODO review
 }
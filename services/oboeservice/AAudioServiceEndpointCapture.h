@@ -25,7 +25,8 @@
 
 namespace aaudio {
 
-class AAudioServiceEndpointCapture : public AAudioServiceEndpointShared {
+class AAudioServiceEndpointCapture : public AAudioServiceEndpointShared,
+                                     public CaptureFrameConsumer {
 public:
     explicit AAudioServiceEndpointCapture(android::AAudioService &audioService);
     virtual ~AAudioServiceEndpointCapture();
@@ -35,7 +36,14 @@ public:
 
     void *callbackLoop() override;
 
+    // Implement CaptureFrameConsumer
+    void onFramesCaptured(const android::WrappingBuffer &parts, int32_t numFrames) override;
+
 private:
+    // Write the frames into the FIFO of each running client stream.
+    void distributeFrames(const android::WrappingBuffer &parts, int32_t numFrames,
+                          int64_t mmapFramesRead);
+
     AudioStreamInternalCapture  mStreamInternalCapture;
     uint8_t                    *mDistributionBuffer = nullptr;
 };
@@ -41,6 +41,9 @@ using namespace aaudio;   // TODO just import names needed
 
 #define BURSTS_PER_BUFFER_DEFAULT   2
 
+// When tuning, only reduce the buffer size after this many bursts of lower recommendations.
+#define BURSTS_PER_LATENCY_DECREASE 2000
+
 AAudioServiceEndpointPlay::AAudioServiceEndpointPlay(AAudioService &audioService)
         : mStreamInternalPlay(audioService, true) {
     ALOGD("%s(%p) created", __func__, this);
@@ -153,9 +156,34 @@ void *AAudioServiceEndpointPlay::callbackLoop() {
                   result, getFramesPerBurst());
             break;
         }
+
+        if (mLatencyTuningEnabled) {
+            tuneLatency();
+        }
     }
 
     ALOGD("%s() exiting, enabled = %d, state = %d, result = %d <<<<<<<<<<<<< MIXER",
           __func__, mCallbackEnabled.load(), getStreamInternal()->getState(), result);
     return NULL; // TODO review
 }
+
+void AAudioServiceEndpointPlay::tuneLatency() {
+    AudioStreamInternal *stream = getStreamInternal();
+    if (!stream->isRecommendedBufferSizeKnown()) {
+        return;
+    }
+    const int32_t recommended = stream->getRecommendedBufferSize();
+    const int32_t current = stream->getBufferSize();
+    // Grow at once to avoid glitches, but shrink only when the jitter stayed low for a while.
+    if (recommended > current
+            || (recommended < current
+                && ++mBurstsSinceLatencyTuned >= BURSTS_PER_LATENCY_DECREASE)) {
+        ALOGD("%s() buffer size %d => %d frames, jitter %lld micros", __func__,
+              current, recommended,
+              (long long) (stream->getJitterNanos() / AAUDIO_NANOS_PER_MICROSECOND));
+        stream->setBufferSize(recommended);
+        mBurstsSinceLatencyTuned = 0;
+    } else if (recommended >= current) {
+        mBurstsSinceLatencyTuned = 0;
+    }
+}
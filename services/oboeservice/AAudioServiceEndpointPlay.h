@@ -46,8 +46,12 @@ public:
     void *callbackLoop() override;
 
 private:
+    // Follow the buffer size recommended by the timing model of the MMAP stream.
+    void tuneLatency();
+
     AudioStreamInternalPlay  mStreamInternalPlay; // for playing output of mixer
-    bool                     mLatencyTuningEnabled = false; // TODO implement tuning
+    bool                     mLatencyTuningEnabled = false; // see tuneLatency()
+    int32_t                  mBurstsSinceLatencyTuned = 0;
     AAudioMixer              mMixer;    //
 };
 
@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Offline analysis of the merged NBLog entries exported by
+//     adb shell dumpsys media.log -b > trace.nblog
+// See NBLog::MergeReader::dumpBinary() for the file format.
+//
+// For every author (MixerThread, FastMixer, RecordThread, ...) this prints the distribution
+// of the periods between its histogram timestamps, the warmup times after each audio state
+// change, and the glitches, which are the periods longer than a factor of the median.
+// The glitches are then correlated across authors, with the log lines around them.
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Keep in sync with NBLog::Event
+enum Event : uint8_t {
+    EVENT_RESERVED,
+    EVENT_STRING,
+    EVENT_TIMESTAMP,
+    EVENT_INTEGER,
+    EVENT_FLOAT,
+    EVENT_PID,
+    EVENT_AUTHOR,
+    EVENT_START_FMT,
+    EVENT_HASH,
+    EVENT_HISTOGRAM_ENTRY_TS,
+    EVENT_AUDIO_STATE,
+    EVENT_END_FMT,
+    EVENT_UPPER_BOUND,
+};
+
+static const char kExportMagic[4] = {'N', 'B', 'L', 'G'};
+static const uint32_t kExportVersion = 1;
+
+// [type][length][data ... ][length]
+static const size_t kEntryOverhead = 3;
+
+// Offsets in NBLog::HistTsEntryWithAuthor
+static const size_t kHistTsOffset = 8;
+static const size_t kHistAuthorOffset = 16;
+
+struct LogLine {
+    int64_t     mTs;
+    int         mAuthor;
+    std::string mText;
+};
+
+struct Glitch {
+    int64_t mTs;        // timestamp ending the long period
+    int     mAuthor;
+    double  mPeriodMs;
+};
+
+struct Author {
+    std::string             mName;
+    std::vector<int64_t>    mTimestamps;    // histogram timestamps
+    std::vector<int64_t>    mStateChanges;  // audio state change timestamps
+};
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-t factor] [-w ms] [-c csv] trace.nblog\n"
+            "    -t  a period over factor times the median is a glitch, default 1.5\n"
+            "    -w  glitches and log lines within ms of each other are correlated, default 10\n"
+            "    -c  also write author,timestamp_ns,period_ms of every period to csv\n",
+            name);
+}
+
+template<typename T>
+static T readValue(const uint8_t *p)
+{
+    T value;
+    memcpy(&value, p, sizeof(value));   // entries are not aligned
+    return value;
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> *data)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        perror(path);
+        return false;
+    }
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        data->insert(data->end(), buffer, buffer + n);
+    }
+    fclose(f);
+    return true;
+}
+
+// Formats the arguments of a format entry the way NBLog::Reader::handleFormat() does.
+static std::string formatLine(const std::string &fmt, const std::vector<const uint8_t *> &args)
+{
+    std::string text;
+    size_t arg = 0;
+    char buffer[64];
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        if (fmt[i] != '%' || i + 1 == fmt.size()) {
+            text += fmt[i];
+            continue;
+        }
+        const char c = fmt[++i];
+        if (c == '%') {
+            text += '%';
+            continue;
+        }
+        if (arg == args.size()) {
+            text += "<missing>";
+            continue;
+        }
+        const uint8_t *entry = args[arg++];
+        const uint8_t *data = entry + 2;
+        switch (entry[0]) {
+        case EVENT_STRING:
+            text.append((const char *) data, entry[1]);
+            break;
+        case EVENT_TIMESTAMP: {
+            const int64_t ts = readValue<int64_t>(data);
+            snprintf(buffer, sizeof(buffer), "[%d.%03d]", (int) (ts / 1000000000),
+                    (int) ((ts / 1000000) % 1000));
+            text += buffer;
+        } break;
+        case EVENT_INTEGER:
+            snprintf(buffer, sizeof(buffer), "<%d>", readValue<int>(data));
+            text += buffer;
+            break;
+        case EVENT_FLOAT:
+            snprintf(buffer, sizeof(buffer), "<%f>", readValue<float>(data));
+            text += buffer;
+            break;
+        case EVENT_PID:
+            snprintf(buffer, sizeof(buffer), "<PID: %d, name: ", readValue<pid_t>(data));
+            text += buffer;
+            text.append((const char *) data + sizeof(pid_t), entry[1] - sizeof(pid_t));
+            text += ">";
+            break;
+        default:
+            text += "<unknown>";
+            break;
+        }
+    }
+    return text;
+}
+
+static bool parse(const std::vector<uint8_t> &file, std::vector<Author> *authors,
+        std::vector<LogLine> *lines)
+{
+    size_t pos = 0;
+    auto need = [&file, &pos](size_t size) {
+        if (file.size() - pos < size) {
+            fprintf(stderr, "truncated file at offset %zu\n", pos);
+            return false;
+        }
+        return true;
+    };
+
+    if (!need(sizeof(kExportMagic) + 2 * sizeof(uint32_t)) ||
+            memcmp(file.data(), kExportMagic, sizeof(kExportMagic)) != 0) {
+        fprintf(stderr, "not an NBLog export\n");
+        return false;
+    }
+    pos += sizeof(kExportMagic);
+    const uint32_t version = readValue<uint32_t>(&file[pos]);
+    pos += sizeof(version);
+    if (version != kExportVersion) {
+        fprintf(stderr, "unsupported version %u\n", version);
+        return false;
+    }
+    const uint32_t count = readValue<uint32_t>(&file[pos]);
+    pos += sizeof(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!need(1) || !need(1 + file[pos])) {
+            return false;
+        }
+        Author author;
+        author.mName.assign((const char *) &file[pos + 1], file[pos]);
+        pos += 1 + file[pos];
+        authors->push_back(author);
+    }
+    if (!need(sizeof(uint32_t))) {
+        return false;
+    }
+    const uint32_t size = readValue<uint32_t>(&file[pos]);
+    pos += sizeof(size);
+    if (!need(size)) {
+        return false;
+    }
+
+    const uint8_t *entry = &file[pos];
+    const uint8_t *end = entry + size;
+    auto validAuthor = [authors](int author) {
+        return author >= 0 && (size_t) author < authors->size();
+    };
+    while (end - entry >= (ptrdiff_t) kEntryOverhead) {
+        const uint8_t type = entry[0];
+        const uint8_t length = entry[1];
+        if (end - entry < (ptrdiff_t) (length + kEntryOverhead) || entry[2 + length] != length ||
+                type == EVENT_RESERVED || type >= EVENT_UPPER_BOUND) {
+            fprintf(stderr, "corrupt entry at offset %zu\n", pos + (entry - &file[pos]));
+            return false;
+        }
+        const uint8_t *data = entry + 2;
+        switch (type) {
+        case EVENT_HISTOGRAM_ENTRY_TS:
+        case EVENT_AUDIO_STATE: {
+            if (length < kHistAuthorOffset + sizeof(int)) {
+                break;
+            }
+            const int64_t ts = readValue<int64_t>(data + kHistTsOffset);
+            const int author = readValue<int>(data + kHistAuthorOffset);
+            if (!validAuthor(author)) {
+                break;
+            }
+            if (type == EVENT_HISTOGRAM_ENTRY_TS) {
+                (*authors)[author].mTimestamps.push_back(ts);
+            } else {
+                (*authors)[author].mStateChanges.push_back(ts);
+            }
+        } break;
+        case EVENT_START_FMT: {
+            // START_FMT, TIMESTAMP, HASH, AUTHOR, arguments..., END_FMT
+            LogLine line = {0, -1, std::string()};
+            const std::string fmt((const char *) data, length);
+            std::vector<const uint8_t *> args;
+            entry += length + kEntryOverhead;
+            while (end - entry >= (ptrdiff_t) kEntryOverhead && entry[0] != EVENT_END_FMT &&
+                    end - entry >= (ptrdiff_t) (entry[1] + kEntryOverhead)) {
+                switch (entry[0]) {
+                case EVENT_TIMESTAMP:
+                    if (line.mTs == 0) {
+                        line.mTs = readValue<int64_t>(entry + 2);
+                    } else {
+                        args.push_back(entry);
+                    }
+                    break;
+                case EVENT_HASH:
+                    break;
+                case EVENT_AUTHOR:
+                    line.mAuthor = readValue<int>(entry + 2);
+                    break;
+                default:
+                    args.push_back(entry);
+                    break;
+                }
+                entry += entry[1] + kEntryOverhead;
+            }
+            if (end - entry < (ptrdiff_t) kEntryOverhead || entry[0] != EVENT_END_FMT) {
+                return true;    // the last entry is incomplete
+            }
+            if (validAuthor(line.mAuthor)) {
+                line.mText = formatLine(fmt, args);
+                lines->push_back(line);
+            }
+        } break;
+        default:
+            break;
+        }
+        entry += entry[1] + kEntryOverhead;
+    }
+    return true;
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    return sorted[std::min(sorted.size() - 1, (size_t) (p / 100. * sorted.size()))];
+}
+
+// Prints a text histogram of the periods, with bins as wide as a tenth of the median.
+static void printHistogram(const std::vector<double> &sorted, double median)
+{
+    static const int kBarWidth = 50;
+    const double binMs = std::max(median / 10., 0.01);
+    std::map<int, size_t> bins;
+    size_t maxCount = 0;
+    for (double period : sorted) {
+        maxCount = std::max(maxCount, ++bins[(int) (period / binMs)]);
+    }
+    for (const auto &bin : bins) {
+        const int bar = (int) ((bin.second * kBarWidth + maxCount - 1) / maxCount);
+        printf("    %8.2f ms %8zu %.*s\n", bin.first * binMs, bin.second, bar,
+                "##################################################");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double glitchFactor = 1.5;
+    double windowMs = 10.;
+    const char *csvPath = nullptr;
+    int ch;
+    while ((ch = getopt(argc, argv, "t:w:c:")) != -1) {
+        switch (ch) {
+        case 't':
+            glitchFactor = atof(optarg);
+            break;
+        case 'w':
+            windowMs = atof(optarg);
+            break;
+        case 'c':
+            csvPath = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 != argc || glitchFactor <= 1. || windowMs < 0.) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> file;
+    std::vector<Author> authors;
+    std::vector<LogLine> lines;
+    if (!readFile(argv[optind], &file) || !parse(file, &authors, &lines)) {
+        return EXIT_FAILURE;
+    }
+
+    FILE *csv = nullptr;
+    if (csvPath != nullptr) {
+        csv = fopen(csvPath, "w");
+        if (csv == nullptr) {
+            perror(csvPath);
+            return EXIT_FAILURE;
+        }
+        fprintf(csv, "author,timestamp_ns,period_ms\n");
+    }
+
+    std::vector<Glitch> glitches;
+    for (size_t a = 0; a < authors.size(); ++a) {
+        Author &author = authors[a];
+        std::sort(author.mTimestamps.begin(), author.mTimestamps.end());
+        std::sort(author.mStateChanges.begin(), author.mStateChanges.end());
+        printf("%s: %zu timestamps, %zu audio state changes\n", author.mName.c_str(),
+                author.mTimestamps.size(), author.mStateChanges.size());
+
+        // periods between timestamps, not across an audio state change,
+        // and warmup times from a state change to the next timestamp
+        std::vector<std::pair<int64_t, double>> periods;
+        std::vector<double> warmups;
+        size_t state = 0;
+        for (size_t i = 0; i < author.mTimestamps.size(); ++i) {
+            const int64_t ts = author.mTimestamps[i];
+            bool restarted = i == 0;
+            int64_t stateChange = -1;
+            while (state < author.mStateChanges.size() && author.mStateChanges[state] <= ts) {
+                stateChange = author.mStateChanges[state++];
+                restarted = true;
+            }
+            if (stateChange >= 0) {
+                warmups.push_back((ts - stateChange) * 1e-6);
+            }
+            if (!restarted) {
+                const double periodMs = (ts - author.mTimestamps[i - 1]) * 1e-6;
+                periods.push_back(std::make_pair(ts, periodMs));
+                if (csv != nullptr) {
+                    fprintf(csv, "%s,%lld,%.6f\n", author.mName.c_str(), (long long) ts,
+                            periodMs);
+                }
+            }
+        }
+        if (periods.empty()) {
+            printf("\n");
+            continue;
+        }
+
+        std::vector<double> sorted;
+        double sum = 0;
+        for (const auto &period : periods) {
+            sorted.push_back(period.second);
+            sum += period.second;
+        }
+        std::sort(sorted.begin(), sorted.end());
+        const double mean = sum / sorted.size();
+        double variance = 0;
+        for (double period : sorted) {
+            variance += (period - mean) * (period - mean);
+        }
+        variance /= sorted.size();
+        const double median = percentile(sorted, 50);
+
+        size_t authorGlitches = 0;
+        for (const auto &period : periods) {
+            if (period.second > glitchFactor * median) {
+                glitches.push_back(Glitch{period.first, (int) a, period.second});
+                ++authorGlitches;
+            }
+        }
+
+        printf("  periods: %zu, mean %.3f ms, stddev %.3f ms\n", sorted.size(), mean,
+                sqrt(variance));
+        printf("  p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f ms\n", median,
+                percentile(sorted, 90), percentile(sorted, 99), percentile(sorted, 99.9),
+                sorted.back());
+        printf("  jitter (p99 - p50): %.3f ms, glitches over %.3f ms: %zu\n",
+                percentile(sorted, 99) - median, glitchFactor * median, authorGlitches);
+        if (!warmups.empty()) {
+            std::sort(warmups.begin(), warmups.end());
+            printf("  warmups: %zu, p50 %.3f  max %.3f ms\n", warmups.size(),
+                    percentile(warmups, 50), warmups.back());
+        }
+        printHistogram(sorted, median);
+        printf("\n");
+    }
+    if (csv != nullptr) {
+        fclose(csv);
+    }
+
+    // correlate the glitches across authors, with the log lines around them
+    std::sort(glitches.begin(), glitches.end(),
+            [](const Glitch &a, const Glitch &b) { return a.mTs < b.mTs; });
+    std::sort(lines.begin(), lines.end(),
+            [](const LogLine &a, const LogLine &b) { return a.mTs < b.mTs; });
+    const int64_t windowNs = (int64_t) (windowMs * 1e6);
+    std::map<std::pair<int, int>, size_t> correlated;
+    printf("glitches (window %.1f ms):\n", windowMs);
+    for (size_t i = 0; i < glitches.size(); ++i) {
+        const Glitch &glitch = glitches[i];
+        printf("  [%lld.%06lld] %s: %.3f ms\n", (long long) (glitch.mTs / 1000000000),
+                (long long) ((glitch.mTs / 1000) % 1000000),
+                authors[glitch.mAuthor].mName.c_str(), glitch.mPeriodMs);
+        for (size_t j = 0; j < glitches.size(); ++j) {
+            const Glitch &other = glitches[j];
+            if (other.mAuthor == glitch.mAuthor ||
+                    llabs(other.mTs - glitch.mTs) > windowNs) {
+                continue;
+            }
+            printf("      with %s: %.3f ms at %+.3f ms\n",
+                    authors[other.mAuthor].mName.c_str(), other.mPeriodMs,
+                    (other.mTs - glitch.mTs) * 1e-6);
+            if (j > i) {
+                ++correlated[std::make_pair(std::min(glitch.mAuthor, other.mAuthor),
+                        std::max(glitch.mAuthor, other.mAuthor))];
+            }
+        }
+        // log lines during the long period and shortly after it
+        auto line = std::lower_bound(lines.begin(), lines.end(),
+                glitch.mTs - (int64_t) (glitch.mPeriodMs * 1e6),
+                [](const LogLine &l, int64_t ts) { return l.mTs < ts; });
+        for (; line != lines.end() && line->mTs <= glitch.mTs + windowNs; ++line) {
+            printf("      %+.3f ms %s: %s\n", (line->mTs - glitch.mTs) * 1e-6,
+                    authors[line->mAuthor].mName.c_str(), line->mText.c_str());
+        }
+    }
+    if (!correlated.empty()) {
+        printf("\ncorrelated glitch pairs:\n");
+        for (const auto &pair : correlated) {
+            printf("  %s / %s: %zu\n", authors[pair.first.first].mName.c_str(),
+                    authors[pair.first.second].mName.c_str(), pair.second);
+        }
+    }
+    return EXIT_SUCCESS;
+}